@@ -65,6 +65,35 @@ function cmd_help() {
     echo "  clear-cache"
     echo "      Clears the TTS audio cache directory."
     echo ""
+    echo "  tts-stats"
+    echo "      Shows TTS cache hits and misses and time-to-first-audio histograms."
+    echo ""
+    echo "  speech-latency"
+    echo "      Shows how long recent announcements spent in each stage, queue to ack."
+    echo ""
+    echo "  radio-latency"
+    echo "      Shows how long each kind of Hamlib call took, and waited for the radio."
+    echo ""
+    echo "  boot-times [N]"
+    echo "      Shows how long each start-up phase took in the last N starts (default 3)."
+    echo ""
+    echo "  alloc-stats"
+    echo "      Shows live heap bytes and allocation rates per subsystem and process."
+    echo "      Needs Firmware and Software2 built with make ALLOC_TRACK=1."
+    echo ""
+    echo "  stats [-p] [-l [ADDRESS:]PORT]"
+    echo "      Shows the runtime metrics of every process: queue depths and drops,"
+    echo "      underruns, TTS cache hits, Hamlib call times, polls and CPU per thread."
+    echo "      -p: Prometheus text format. -l: serve that over HTTP on PORT for a"
+    echo "      Prometheus server to scrape (127.0.0.1 unless ADDRESS is given)."
+    echo ""
+    echo "  trace [-n N|-a|-k] [PROCESS...]"
+    echo "      Shows the newest N trace events (default 200) of all processes as one"
+    echo "      timeline: keys, audio requests and acks, TTS and speech queue events."
+    echo "      PROCESS limits it to firmware, keypad, audio or hampod."
+    echo "      -k: time from each key to the first sound of its answer, per key and"
+    echo "      hop by hop, with the N slowest keys (default 10)."
+    echo ""
     echo "  reset [--yes|-y]"
     echo "      Performs a hard reset of system state, clearing logs and stale processes."
     echo "      Also resets the hampod.conf configuration file to factory defaults."
@@ -202,6 +231,153 @@ function cmd_clear_cache() {
     fi
 }
 
+function cmd_tts_stats() {
+    print_header "HAMPOD CLI - TTS Statistics"
+    # Rewritten by the Firmware audio process after each request (at most
+    # once a second); see AUDIO_TTS_STATS_FILE in Firmware/audio_firmware.h
+    local stats_file="/dev/shm/hampod_tts_stats"
+    if [ ! -f "$stats_file" ]; then
+        print_error "No statistics yet. Is HAMPOD running and has it spoken?"
+        exit 3
+    fi
+    if ! pgrep -x firmware.elf > /dev/null 2>&1; then
+        echo -e "${YELLOW}Firmware is not running; these are from its last run.${NC}"
+    fi
+    echo "As of $(date -r "$stats_file" '+%Y-%m-%d %H:%M:%S'):"
+    cat "$stats_file"
+}
+
+function cmd_speech_latency() {
+    print_header "HAMPOD CLI - Speech Latency"
+    # Written by the Software2 process on SIGUSR1; see SPEECH_LATENCY_FILE
+    # in Software2/include/speech.h
+    local report_file="/dev/shm/hampod_speech_latency"
+    rm -f "$report_file"
+    if ! pkill -USR1 -x hampod > /dev/null 2>&1; then
+        print_error "HAMPOD is not running."
+        exit 3
+    fi
+    local tries=0
+    while [ ! -f "$report_file" ] && [ $tries -lt 20 ]; do
+        sleep 0.1
+        tries=$((tries + 1))
+    done
+    if [ ! -f "$report_file" ]; then
+        print_error "HAMPOD did not write a report."
+        exit 3
+    fi
+    cat "$report_file"
+}
+
+function cmd_radio_latency() {
+    print_header "HAMPOD CLI - Radio Latency"
+    # Written by the Software2 process on SIGUSR1; see RADIO_TRACE_FILE
+    # in Software2/include/radio_trace.h
+    local report_file="/dev/shm/hampod_radio_latency"
+    rm -f "$report_file"
+    if ! pkill -USR1 -x hampod > /dev/null 2>&1; then
+        print_error "HAMPOD is not running."
+        exit 3
+    fi
+    local tries=0
+    while [ ! -f "$report_file" ] && [ $tries -lt 20 ]; do
+        sleep 0.1
+        tries=$((tries + 1))
+    done
+    if [ ! -f "$report_file" ]; then
+        print_error "HAMPOD did not write a report."
+        exit 3
+    fi
+    cat "$report_file"
+}
+
+function cmd_stats() {
+    # Every process keeps its registry in /dev/shm (Firmware/hampod_metrics.h)
+    local dumper="$FIRMWARE_DIR/metrics_dump"
+    if [ ! -x "$dumper" ]; then
+        print_error "metrics_dump not built. Run make in $FIRMWARE_DIR."
+        exit 3
+    fi
+    if [ $# -eq 0 ]; then
+        print_header "HAMPOD CLI - Metrics"
+    fi
+    "$dumper" "$@"
+}
+
+function cmd_trace() {
+    print_header "HAMPOD CLI - Trace"
+    # The rings are kept in /dev/shm by every process (Firmware/hampod_trace.h),
+    # so this also works after HAMPOD has stopped
+    local dumper="$FIRMWARE_DIR/trace_dump"
+    if [ ! -x "$dumper" ]; then
+        print_error "trace_dump not built. Run make in $FIRMWARE_DIR."
+        exit 3
+    fi
+    "$dumper" "$@"
+}
+
+function cmd_alloc_stats() {
+    print_header "HAMPOD CLI - Allocation Stats"
+    # Written by each process on SIGUSR2 in ALLOC_TRACK builds; see
+    # Firmware/hampod_alloc.h. Other builds ignore the signal.
+    local report_dir="/dev/shm"
+    rm -f "$report_dir"/hampod_alloc.*
+    local signalled=0
+    pkill -USR2 -x firmware.elf > /dev/null 2>&1 && signalled=1
+    pkill -USR2 -x hampod > /dev/null 2>&1 && signalled=1
+    if [ $signalled -eq 0 ]; then
+        print_error "HAMPOD is not running."
+        exit 3
+    fi
+    sleep 0.5
+    local found=0
+    for process in firmware keypad audio hampod; do
+        local report_file="$report_dir/hampod_alloc.$process"
+        if [ -f "$report_file" ]; then
+            echo -e "${GREEN}$process${NC}"
+            cat "$report_file"
+            echo ""
+            found=1
+        fi
+    done
+    if [ $found -eq 0 ]; then
+        print_error "No reports. Rebuild Firmware and Software2 with make ALLOC_TRACK=1."
+        exit 3
+    fi
+}
+
+function cmd_boot_times() {
+    print_header "HAMPOD CLI - Boot Times"
+    # Appended by every process as its start-up phases end; see
+    # Firmware/hampod_boot.h
+    local log_file="${HAMPOD_BOOT_LOG:-/var/tmp/hampod_boot.log}"
+    local count="${1:-3}"
+    if [[ ! "$count" =~ ^[0-9]+$ ]] || [ "$count" -lt 1 ]; then
+        print_error "N must be a positive number."
+        exit 2
+    fi
+    if [ ! -f "$log_file" ] && [ ! -f "$log_file.old" ]; then
+        print_error "No boot log at $log_file. Has HAMPOD started since it was updated?"
+        exit 3
+    fi
+    # Each start opens with Firmware's "start" line; times are shown from it
+    cat "$log_file.old" "$log_file" 2>/dev/null | awk -v count="$count" '
+        NF == 4 && $2 == "firmware" && $3 == "start" { boots++; start[boots] = $1 }
+        NF == 4 && boots > 0 {
+            lines[boots] = lines[boots] sprintf("  %+7d ms  %-9s %-17s %6d ms\n",
+                                                $1 - start[boots], $2, $3, $4)
+        }
+        END {
+            if (boots == 0) { print "No starts logged yet."; exit }
+            first = boots - count + 1
+            if (first < 1) first = 1
+            for (b = first; b <= boots; b++) {
+                printf "Start %d of %d: when each phase ended, and what it took\n", b, boots
+                printf "%s\n", lines[b]
+            }
+        }'
+}
+
 function cmd_reset() {
     print_header "HAMPOD CLI - Hard Reset"
     echo -e "${YELLOW}Warning: This will forcefully stop HAMPOD and clear all temporary system state, including configuration.${NC}"
@@ -428,6 +604,27 @@ case "$COMMAND" in
     clear-cache)
         cmd_clear_cache
         ;;
+    tts-stats)
+        cmd_tts_stats
+        ;;
+    speech-latency)
+        cmd_speech_latency
+        ;;
+    radio-latency)
+        cmd_radio_latency
+        ;;
+    boot-times)
+        cmd_boot_times "$@"
+        ;;
+    alloc-stats)
+        cmd_alloc_stats
+        ;;
+    stats)
+        cmd_stats "$@"
+        ;;
+    trace)
+        cmd_trace "$@"
+        ;;
     reset)
         cmd_reset "$@"
         ;;
@@ -496,6 +496,15 @@ main() {
     else
         print_error "Firmware build may have issues - firmware.elf not found"
     fi
+
+    # Prebuilt TTS cache packs (BUILD.md), so speech is fast from first boot
+    if ls tts_packs/*.hpk >/dev/null 2>&1 && [ -x tts_pack ]; then
+        if ./tts_pack install tts_packs/*.hpk; then
+            print_success "TTS cache packs installed"
+        else
+            print_info "Some TTS cache packs could not be installed"
+        fi
+    fi
     
     # -------------------------------------------------------------------------
     # Step 6: Build HAL Integration Tests
@@ -145,8 +145,11 @@ install_persist_helper() {
 # ============================================================================
 # HAMPOD Persistent Write Helper
 # ============================================================================
-# Writes a file persistently, works in overlay or normal mode.
-# Usage: hampod_persist_write <source_file> <destination_path>
+# Writes a file or directory persistently, works in overlay or normal mode.
+# Usage: hampod_persist_write <source> <destination_path>
+#
+# A directory replaces the one at the destination whole, swapped in once
+# it is completely copied.
 #
 # When overlay is active, this temporarily remounts the lower filesystem
 # to write the file, then remounts it read-only.
@@ -156,10 +159,20 @@ SOURCE="$1"
 DEST="$2"
 
 if [ -z "$SOURCE" ] || [ -z "$DEST" ]; then
-    echo "Usage: hampod_persist_write <source_file> <destination_path>"
+    echo "Usage: hampod_persist_write <source> <destination_path>"
     exit 1
 fi
 
+# Copy SOURCE to $1
+copy_source() {
+    if [ -d "$SOURCE" ]; then
+        rm -rf "$1.new" && cp -a "$SOURCE" "$1.new" &&
+            rm -rf "$1" && mv "$1.new" "$1"
+    else
+        cp "$SOURCE" "$1"
+    fi
+}
+
 # Convert relative paths to absolute
 if [[ "$SOURCE" != /* ]]; then
     SOURCE="$(pwd)/$SOURCE"
@@ -168,8 +181,8 @@ if [[ "$DEST" != /* ]]; then
     DEST="$(pwd)/$DEST"
 fi
 
-if [ ! -f "$SOURCE" ]; then
-    echo "Error: Source file not found: $SOURCE"
+if [ ! -e "$SOURCE" ]; then
+    echo "Error: Source not found: $SOURCE"
     exit 1
 fi
 
@@ -210,11 +223,11 @@ if mount | grep -q "on / type overlay"; then
     DEST_DIR=$(dirname "${LOWER_DIR}${DEST}")
     mkdir -p "$DEST_DIR" 2>/dev/null || true
     
-    if cp "$SOURCE" "${LOWER_DIR}${DEST}"; then
-        echo "File written persistently to $DEST"
+    if copy_source "${LOWER_DIR}${DEST}"; then
+        echo "Written persistently to $DEST"
         RESULT=0
     else
-        echo "Error: Failed to write file"
+        echo "Error: Failed to write $DEST"
         RESULT=1
     fi
     
@@ -224,11 +237,10 @@ if mount | grep -q "on / type overlay"; then
     exit $RESULT
 else
     # Normal mode - just copy
-    cp "$SOURCE" "$DEST"
-    if [ $? -eq 0 ]; then
-        echo "File written to $DEST"
+    if copy_source "$DEST"; then
+        echo "Written to $DEST"
     else
-        echo "Error: Failed to write file"
+        echo "Error: Failed to write $DEST"
         exit 1
     fi
 fi
@@ -345,6 +357,8 @@ enable_protection() {
     echo -e "${YELLOW}║${NC}                                                              ${YELLOW}║${NC}"
     echo -e "${YELLOW}║${NC} To save config changes permanently, use:                     ${YELLOW}║${NC}"
     echo -e "${YELLOW}║${NC}   hampod_persist_write <source> <destination>                ${YELLOW}║${NC}"
+    echo -e "${YELLOW}║${NC} run_hampod.sh uses it to keep the TTS cache hot set, and in  ${YELLOW}║${NC}"
+    echo -e "${YELLOW}║${NC} [storage] tmpfs mode the cache written back on shutdown.     ${YELLOW}║${NC}"
     echo -e "${YELLOW}╚══════════════════════════════════════════════════════════════╝${NC}"
     echo ""
     
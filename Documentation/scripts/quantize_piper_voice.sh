@@ -0,0 +1,52 @@
+#!/bin/bash
+# HAMPOD Piper Voice Quantizer
+# Makes an INT8-quantized copy of a Piper voice model, which runs faster
+# on the CPUs of a Pi 3 or Zero 2 W at some cost in voice quality. Use it
+# from hampod.conf ([tts] model = models/<name>.int8.onnx); if it does not
+# start, the Firmware falls back to the built-in model.
+#
+# Usage: ./quantize_piper_voice.sh [model.onnx]
+#   model.onnx  Voice to quantize (default: Firmware/models/en_US-lessac-low.onnx)
+#
+# Needs Python 3 with onnxruntime (pip install onnxruntime). The copy is
+# written beside the model as <name>.int8.onnx, with its .onnx.json.
+#
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" 2>/dev/null && pwd)" || SCRIPT_DIR="$PWD"
+MODEL="${1:-$SCRIPT_DIR/../../Firmware/models/en_US-lessac-low.onnx}"
+
+if [ ! -f "$MODEL" ]; then
+    echo "ERROR: No model at $MODEL"
+    echo "Run ./install_piper.sh first, or name the model to quantize."
+    exit 1
+fi
+if [ ! -f "$MODEL.json" ]; then
+    echo "ERROR: No voice config at $MODEL.json"
+    exit 1
+fi
+if ! python3 -c "import onnxruntime.quantization" 2>/dev/null; then
+    echo "ERROR: Python's onnxruntime is not installed"
+    echo "Install it with: pip install onnxruntime"
+    exit 1
+fi
+
+OUTPUT="${MODEL%.onnx}.int8.onnx"
+echo "=== HAMPOD Piper Voice Quantizer ==="
+echo "Model:  $MODEL"
+echo "Output: $OUTPUT"
+
+# Dynamic quantization: weights stored as INT8, activations quantized at
+# run time, so no calibration set is needed
+python3 - "$MODEL" "$OUTPUT" <<'EOF'
+import sys
+from onnxruntime.quantization import QuantType, quantize_dynamic
+
+quantize_dynamic(sys.argv[1], sys.argv[2], weight_type=QuantType.QUInt8)
+EOF
+cp "$MODEL.json" "$OUTPUT.json"
+
+echo ""
+echo "Done: $(du -h "$MODEL" | cut -f1) -> $(du -h "$OUTPUT" | cut -f1)"
+echo "Compare the two with Speech_Comparison/tts_benchmark:"
+echo "  HAMPOD_TTS_VOICES=default=$OUTPUT ./tts_benchmark"
@@ -41,6 +41,16 @@ echo "pound" | "$PIPER_PATH/piper" --model "$MODEL_PATH" --output_file "$OUTPUT_
 # NOTE: DTMF files are NOT regenerated - they are actual DTMF tone audio files,
 # not speech. The DTMF*.wav files should be left as-is.
 
+# Optionally store the speech clips as IMA-ADPCM, a quarter of the size;
+# the firmware decodes them when it loads pregen_audio
+if [ "$HAMPOD_CLIPS_COMPRESS" = "1" ] && command -v sox >/dev/null; then
+    for name in 0 1 2 3 4 5 6 7 8 9 A B C D POINT POUND; do
+        echo "Compressing: $name"
+        sox "$OUTPUT_DIR/$name.wav" -e ima-adpcm "$OUTPUT_DIR/$name.tmp.wav" &&
+            mv "$OUTPUT_DIR/$name.tmp.wav" "$OUTPUT_DIR/$name.wav"
+    done
+fi
+
 echo
 echo "Done! Audio files regenerated with Piper TTS."
 echo "Note: DTMF tone files were not modified (they are actual tones, not speech)."
@@ -83,6 +83,7 @@ sudo rm -f "$FIRMWARE_DIR/Speaker_i" "$FIRMWARE_DIR/Speaker_o" 2>/dev/null || tr
 sudo rm -f "$FIRMWARE_DIR/Keypad_i" "$FIRMWARE_DIR/Keypad_o" 2>/dev/null || true
 # Clean up log files that may be owned by root from previous sudo runs
 sudo rm -f /tmp/firmware.log /tmp/hampod_output.txt /tmp/hampod_debug.log 2>/dev/null || true
+sudo rm -f /dev/shm/hampod/*.log /dev/shm/hampod/*.txt 2>/dev/null || true
 echo "  Done."
 
 # -----------------------------------------------------------------------------
@@ -133,7 +134,98 @@ if [ -f "$CONF_FILE" ]; then
     fi
 fi
 
-sudo ./firmware.elf $FIRMWARE_ARGS > /tmp/firmware.log 2>&1 &
+# Scheduling profile ([scheduling]); firmware.elf applies and logs it
+sched_value() {
+    sed -n '/^\[scheduling\]/,/^\[/p' "$CONF_FILE" 2>/dev/null | grep "^$1" | head -1 | cut -d'=' -f2 | sed 's/#.*//' | tr -d ' '
+}
+RT_AUDIO=$(sched_value audio_priority)
+RT_KEYPAD=$(sched_value keypad_priority)
+IO_CPUS=$(sched_value io_cpus)
+TTS_CPUS=$(sched_value tts_cpus)
+VOICE_CPUS=$(sched_value voice_cpus)
+MLOCK=$(sched_value mlock)
+MEMORY_PROFILE=$(sched_value memory_profile)
+IDLE_MODE=$(sched_value idle_mode)
+WATCHDOG_MS=$(sched_value watchdog_ms)
+CPU_BOOST_MS=$(sched_value cpu_boost_ms)
+CPU_IDLE_GOVERNOR=$(sched_value cpu_idle_governor)
+[ -n "$RT_AUDIO" ] && [ "$RT_AUDIO" != "0" ] && FIRMWARE_ARGS="$FIRMWARE_ARGS --rt-audio $RT_AUDIO"
+[ -n "$RT_KEYPAD" ] && [ "$RT_KEYPAD" != "0" ] && FIRMWARE_ARGS="$FIRMWARE_ARGS --rt-keypad $RT_KEYPAD"
+[ -n "$IO_CPUS" ] && FIRMWARE_ARGS="$FIRMWARE_ARGS --io-cpus $IO_CPUS"
+[ -n "$TTS_CPUS" ] && FIRMWARE_ARGS="$FIRMWARE_ARGS --tts-cpus $TTS_CPUS"
+[ -n "$VOICE_CPUS" ] && FIRMWARE_ARGS="$FIRMWARE_ARGS --voice-cpus $VOICE_CPUS"
+[ "$MLOCK" = "1" ] && FIRMWARE_ARGS="$FIRMWARE_ARGS --mlock"
+[ "$MEMORY_PROFILE" = "low" ] && FIRMWARE_ARGS="$FIRMWARE_ARGS --memory-profile low"
+[ "$IDLE_MODE" = "1" ] && FIRMWARE_ARGS="$FIRMWARE_ARGS --idle-mode"
+[ -n "$WATCHDOG_MS" ] && FIRMWARE_ARGS="$FIRMWARE_ARGS --watchdog-ms $WATCHDOG_MS"
+if [ -n "$CPU_BOOST_MS" ] && [ "$CPU_BOOST_MS" != "0" ]; then
+    FIRMWARE_ARGS="$FIRMWARE_ARGS --cpu-boost $CPU_BOOST_MS"
+    [ -n "$CPU_IDLE_GOVERNOR" ] && FIRMWARE_ARGS="$FIRMWARE_ARGS --cpu-idle-governor $CPU_IDLE_GOVERNOR"
+    echo "  CPU boost: performance for ${CPU_BOOST_MS} ms after a key, ${CPU_IDLE_GOVERNOR:-schedutil} otherwise"
+fi
+if [ -n "$RT_AUDIO$RT_KEYPAD$IO_CPUS$TTS_CPUS" ]; then
+    echo "  Scheduling: audio=${RT_AUDIO:-0} keypad=${RT_KEYPAD:-0} io_cpus=${IO_CPUS:-any} tts_cpus=${TTS_CPUS:-any} mlock=${MLOCK:-0} memory=${MEMORY_PROFILE:-normal} idle=${IDLE_MODE:-0}"
+fi
+
+# Voice registry ([voices]: name = model path), one --voice option each
+VOICES=$(sed -n '/^\[voices\]/,/^\[/p' "$CONF_FILE" 2>/dev/null | grep '^[A-Za-z0-9_-]* *=' | sed 's/#.*//' | tr -d ' ')
+for VOICE in $VOICES; do
+    FIRMWARE_ARGS="$FIRMWARE_ARGS --voice $VOICE"
+    echo "  Voice: $VOICE"
+done
+
+# Piper model and accelerator ([tts]); an unusable one falls back at init
+tts_value() {
+    sed -n '/^\[tts\]/,/^\[/p' "$CONF_FILE" 2>/dev/null | grep "^$1" | head -1 | cut -d'=' -f2 | sed 's/#.*//' | tr -d ' '
+}
+TTS_MODEL=$(tts_value model)
+TTS_ACCEL=$(tts_value accelerator)
+if [ -n "$TTS_MODEL" ]; then
+    FIRMWARE_ARGS="$FIRMWARE_ARGS --voice default=$TTS_MODEL"
+    echo "  TTS model: $TTS_MODEL"
+fi
+if [ -n "$TTS_ACCEL" ]; then
+    FIRMWARE_ARGS="$FIRMWARE_ARGS --tts-accel $TTS_ACCEL"
+    echo "  TTS accelerator: $TTS_ACCEL"
+fi
+
+# Spoken commands ([voice_input]); ignored by a Firmware built without them
+voice_input_value() {
+    sed -n '/^\[voice_input\]/,/^\[/p' "$CONF_FILE" 2>/dev/null | grep "^$1" | head -1 | cut -d'=' -f2 | sed 's/#.*//' | tr -d ' '
+}
+VOICE_MODEL=$(voice_input_value model)
+VOICE_DEVICE=$(voice_input_value device)
+if [ -n "$VOICE_MODEL" ]; then
+    FIRMWARE_ARGS="$FIRMWARE_ARGS --voice-model $VOICE_MODEL"
+    [ -n "$VOICE_DEVICE" ] && FIRMWARE_ARGS="$FIRMWARE_ARGS --voice-device $VOICE_DEVICE"
+    echo "  Voice input: $VOICE_MODEL"
+fi
+
+# Remote station ([remote])
+REMOTE_ADDRESS=$(sed -n '/^\[remote\]/,/^\[/p' "$CONF_FILE" 2>/dev/null | grep "^address" | head -1 | cut -d'=' -f2 | sed 's/#.*//' | tr -d ' ')
+if [ -n "$REMOTE_ADDRESS" ]; then
+    FIRMWARE_ARGS="$FIRMWARE_ARGS --remote $REMOTE_ADDRESS"
+    echo "  Remote station: $REMOTE_ADDRESS"
+fi
+
+# Runtime storage ([storage]): in tmpfs mode the logs and the TTS cache
+# live in RAM, and Firmware writes the cache back to the card in batches.
+# The pipes stay where they are: their data never touches the card.
+storage_value() {
+    sed -n '/^\[storage\]/,/^\[/p' "$CONF_FILE" 2>/dev/null | grep "^$1" | head -1 | cut -d'=' -f2 | sed 's/#.*//' | tr -d ' '
+}
+TMPFS_MODE=$(storage_value tmpfs)
+WRITEBACK_S=$(storage_value writeback_s)
+LOG_DIR=/tmp
+if [ "$TMPFS_MODE" = "1" ]; then
+    LOG_DIR=/dev/shm/hampod
+    sudo mkdir -p "$LOG_DIR/tts"
+    FIRMWARE_ARGS="$FIRMWARE_ARGS --tmpfs-cache $LOG_DIR/tts"
+    [ -n "$WRITEBACK_S" ] && FIRMWARE_ARGS="$FIRMWARE_ARGS --writeback-s $WRITEBACK_S"
+    echo "  tmpfs mode: cache and logs in $LOG_DIR, written back every ${WRITEBACK_S:-300} s"
+fi
+
+sudo ./firmware.elf $FIRMWARE_ARGS > "$LOG_DIR/firmware.log" 2>&1 &
 FIRMWARE_PID=$!
 echo "  Firmware PID: $FIRMWARE_PID"
 
@@ -148,7 +240,7 @@ done
 
 if [ ! -p "Firmware_o" ]; then
     echo -e "${RED}  ERROR: Firmware_o pipe not created${NC}"
-    echo "  Check /tmp/firmware.log for errors"
+    echo "  Check $LOG_DIR/firmware.log for errors"
     sudo kill $FIRMWARE_PID 2>/dev/null || true
     exit 1
 fi
@@ -176,9 +268,34 @@ cd "$SOFTWARE2_DIR"
 cleanup() {
     echo ""
     echo -e "${YELLOW}Shutting down HAMPOD...${NC}"
-    sudo kill $FIRMWARE_PID 2>/dev/null || true
+    # SIGINT lets the audio process save the TTS cache's hot set (the
+    # phrases heard most, loaded into RAM at the next start), and in tmpfs
+    # mode write the cache back, on its way out
+    sudo killall -INT firmware.elf 2>/dev/null || true
+    for i in $(seq 1 50); do
+        pgrep -x firmware.elf > /dev/null || break
+        sleep 0.1
+    done
     sudo killall -9 firmware.elf piper aplay 2>/dev/null || true
     echo "  Firmware stopped."
+
+    # With power-down protection on, the cache directory is in RAM: write
+    # the hot set, or in tmpfs mode the written-back cache, through to the
+    # card so the next boot starts warm
+    if mount | grep -q "on / type overlay" &&
+       command -v hampod_persist_write > /dev/null; then
+        local cache_dir
+        cache_dir="$(sudo sh -c \
+            'echo "${HAMPOD_TTS_CACHE_DIR:-$HOME/.cache/hampod/tts}"')"
+        if [ "$TMPFS_MODE" = "1" ] && sudo test -d "$cache_dir/tmpfs"; then
+            sudo hampod_persist_write "$cache_dir/tmpfs" "$cache_dir/tmpfs" \
+                > /dev/null && echo "  TTS cache saved to the SD card."
+        elif sudo test -f "$cache_dir/hotset.bin"; then
+            sudo hampod_persist_write "$cache_dir/hotset.bin" \
+                "$cache_dir/hotset.bin" > /dev/null &&
+                echo "  TTS cache hot set saved to the SD card."
+        fi
+    fi
     echo -e "${GREEN}Goodbye!${NC}"
 }
 trap cleanup EXIT
@@ -189,4 +306,4 @@ if [ "$DEBUG_MODE" = true ]; then
     HAMPOD_ARGS="--debug"
 fi
 
-sudo ./bin/hampod $HAMPOD_ARGS 2>&1 | tee /tmp/hampod_output.txt
+sudo ./bin/hampod $HAMPOD_ARGS 2>&1 | tee "$LOG_DIR/hampod_output.txt"
@@ -96,5 +96,11 @@ else
     exit 1
 fi
 
+# 6. Add any prebuilt TTS cache packs (entries already cached are skipped)
+if ls tts_packs/*.hpk > /dev/null 2>&1; then
+    echo "Installing TTS cache packs..."
+    ./tts_pack install tts_packs/*.hpk || echo "Some TTS cache packs could not be installed."
+fi
+
 print_success "HAMPOD has been successfully updated!"
 echo "You can now run 'hampod start' to launch the system."
@@ -6,19 +6,971 @@
 
 #include "audio_firmware.h"
 #include "hal/hal_audio.h"
+#include "hal/hal_audio_clips.h"
+#include "hal/hal_cw.h"
+#include "hal/hal_remote.h"
 #include "hal/hal_tts.h"
+#include "hal/hal_tts_cache.h"
+#include "hal/hal_tts_fragments.h"
+#include "hampod_alloc.h"
+#include "hampod_boot.h"
+#include "hampod_channel.h"
+#include "hampod_cpufreq.h"
+#include "hampod_metrics.h"
+#include "hampod_sched.h"
+#include "hampod_trace.h"
+#include <ctype.h>
+#include <dirent.h>
+#include <time.h>
 
 extern pid_t controller_pid;
+extern Shm_audio_ring *audio_shm_ring; /* NULL unless --shm-audio */
+extern int direct_channels;            /* --direct */
+extern int local_beep_fds[2];          /* Key-down beeps from the keypad */
+#ifdef HAMPOD_THREADED
+extern int audio_channel_fds[2];       /* Speaker_i/o, make THREADED=1 */
+#endif
+extern Sched_profile sched_profile;    /* [scheduling] options */
 unsigned char audio_running = 1;
 pthread_mutex_t audio_queue_lock;
-pthread_mutex_t audio_queue_available;
+pthread_cond_t audio_queue_ready; /* Signalled (under the lock) on enqueue */
+static unsigned char audio_ring_pending = 0; /* Guarded by audio_queue_lock */
+/* Set by an interrupt so a speak sequence stops after the current segment */
+static volatile unsigned char audio_sequence_cancelled = 0;
+/* Speech epoch of the latest interrupt (0 until Software sends one) and of
+ * the request being played (0 when idle or unstamped). Guarded by
+ * audio_queue_lock. */
+static unsigned char audio_epoch = 0;
+static unsigned char audio_playing_epoch = 0;
 pthread_mutex_t audio_lock;
 
-void audio_process() {
+/* When the request being played started (boot_clock_ms()), 0 when idle,
+ * and the watchdog's steps in the current stall (AUDIO_WATCHDOG_ENV) */
+static _Atomic long long audio_request_started_ms = 0;
+static _Atomic int audio_watchdog_steps = 0;
+
+/* Software's direct channel (--direct), -1 while nobody is connected */
+static int audio_direct_listen_fd = -1;
+static volatile int audio_direct_fd = -1;
+
+static void audio_io_loop(int i_pipe, int o_pipe, Packet_queue *queue,
+                          unsigned short origin);
+
+static int audio_run_request(char audio_type_byte, char *remaining_string);
+
+/* Keypad echo clips ('e' requests), copied out of the clip library at
+ * start-up: the I/O thread plays them, and hal_audio_clips.h must only be
+ * used from the main loop's thread */
+typedef struct {
+  char path[32]; /* As sent, e.g. "pregen_audio/5" */
+  int16_t *samples;
+  size_t num_samples;
+} Echo_clip;
+
+static const char *const echo_clip_names[] = {"0", "1", "2", "3", "4", "5",
+                                              "6", "7", "8", "9", "POINT"};
+#define ECHO_CLIPS (int)(sizeof(echo_clip_names) / sizeof(echo_clip_names[0]))
+static Echo_clip echo_clips[ECHO_CLIPS];
+static int echo_clip_count = 0;
+
+static void audio_load_echo_clips(void) {
+  for (int i = 0; i < ECHO_CLIPS; i++) {
+    Echo_clip *clip = &echo_clips[echo_clip_count];
+    snprintf(clip->path, sizeof(clip->path), "pregen_audio/%s",
+             echo_clip_names[i]);
+    const int16_t *samples;
+    size_t num_samples;
+    if (hal_audio_clips_find(clip->path, &samples, &num_samples) != 0) {
+      continue;
+    }
+    clip->samples = hampod_malloc(ALLOC_AUDIO, num_samples * sizeof(int16_t));
+    if (clip->samples == NULL) {
+      continue;
+    }
+    memcpy(clip->samples, samples, num_samples * sizeof(int16_t));
+    clip->num_samples = num_samples;
+    echo_clip_count++;
+  }
+  AUDIO_PRINTF("Keypad echo: %d clips in RAM\n", echo_clip_count);
+}
+
+static const Echo_clip *audio_find_echo_clip(const char *path) {
+  for (int i = 0; i < echo_clip_count; i++) {
+    if (strcmp(echo_clips[i].path, path) == 0) {
+      return &echo_clips[i];
+    }
+  }
+  return NULL;
+}
+
+/* DTMF clips ("pregen_audio/DTMF5", "pregen_audio/DTMFPOUND") are
+ * synthesized rather than read from pregen_audio. Returns 0 with the
+ * tone if path names one. */
+static int audio_dtmf_tone(const char *path, HalTone *tone) {
+  const char *name = strrchr(path, '/');
+  name = name != NULL ? name + 1 : path;
+  if (strncmp(name, "DTMF", 4) != 0) {
+    return -1;
+  }
+  name += 4;
+  char key = '\0';
+  if (strcmp(name, "ASTERISK") == 0) {
+    key = '*';
+  } else if (strcmp(name, "POUND") == 0) {
+    key = '#';
+  } else if (name[0] != '\0' && name[1] == '\0') {
+    key = name[0];
+  }
+  return hal_tone_dtmf(key, 0, tone);
+}
+
+static void audio_free_echo_clips(void) {
+  for (int i = 0; i < echo_clip_count; i++) {
+    hampod_free(echo_clips[i].samples);
+  }
+  echo_clip_count = 0;
+}
+
+/* The 't' reply after its leading 0 (AUDIO_TTS_STATS_REPLY_INTS) */
+static void audio_tts_stats_ints(int *out) {
+  HalTtsStats stats;
+  hal_tts_get_stats(&stats);
+  *out++ = (int)stats.cache.ram_hits;
+  *out++ = (int)stats.cache.disk_hits;
+  *out++ = (int)stats.cache.streamed;
+  *out++ = (int)stats.cache.misses;
+  *out++ = (int)stats.cache.entries;
+  *out++ = (int)stats.cache.evicted;
+  *out++ = (int)(stats.cache.disk_bytes / 1024);
+  *out++ = (int)(stats.cache.ram_bytes / 1024);
+  for (int i = 0; i < HAL_TTS_LATENCY_BUCKETS; i++) {
+    *out++ = (int)stats.first_audio_hit[i];
+  }
+  for (int i = 0; i < HAL_TTS_LATENCY_BUCKETS; i++) {
+    *out++ = (int)stats.first_audio_miss[i];
+  }
+}
+
+/* Bring the metrics the HALs count themselves up to date */
+static void audio_publish_metrics(void) {
+  AudioStats audio = {0};
+  hal_audio_get_stats(&audio);
+  hampod_metric_set(METRIC_AUDIO_UNDERRUNS, audio.underruns);
+  hampod_metric_set(METRIC_AUDIO_BUFFER_MS, audio.buffer_ms);
+  hampod_metric_set(METRIC_AUDIO_REOPENS, audio.reopens);
+  HalTtsStats tts;
+  hal_tts_get_stats(&tts);
+  hampod_metric_set(METRIC_TTS_RAM_HITS, tts.cache.ram_hits);
+  hampod_metric_set(METRIC_TTS_DISK_HITS, tts.cache.disk_hits);
+  hampod_metric_set(METRIC_TTS_MISSES, tts.cache.misses);
+  hampod_metric_set(METRIC_TTS_CRASHES, tts.crashes);
+}
+
+/* Rewrite AUDIO_TTS_STATS_FILE, unless it was written this second */
+static void audio_publish_tts_stats(void) {
+  static time_t published = 0;
+  time_t now = time(NULL);
+  if (now == published) {
+    return;
+  }
+  published = now;
+
+  static const char *const names[] = {"ram_hits", "disk_hits", "streamed",
+                                      "misses",   "entries",   "evicted",
+                                      "disk_kb",  "ram_kb"};
+  int ints[AUDIO_TTS_STATS_REPLY_INTS - 1];
+  audio_tts_stats_ints(ints);
+  FILE *f = fopen(AUDIO_TTS_STATS_FILE ".tmp", "w");
+  if (f == NULL) {
+    return;
+  }
+  const int counters = sizeof(names) / sizeof(names[0]);
+  for (int i = 0; i < counters; i++) {
+    fprintf(f, "%s %d\n", names[i], ints[i]);
+  }
+  /* Histogram buckets are labelled by their upper limit in ms */
+  static const char *const limits[HAL_TTS_LATENCY_BUCKETS] = {
+      "25", "50", "100", "200", "400", "800", "1600", "inf"};
+  for (int kind = 0; kind < 2; kind++) {
+    fprintf(f, "first_audio_%s_ms", kind == 0 ? "hit" : "miss");
+    for (int i = 0; i < HAL_TTS_LATENCY_BUCKETS; i++) {
+      fprintf(f, " <%s:%d", limits[i],
+              ints[counters + kind * HAL_TTS_LATENCY_BUCKETS + i]);
+    }
+    fprintf(f, "\n");
+  }
+  HalTtsStats stats;
+  hal_tts_get_stats(&stats);
+  if (stats.model.bytes > 0) {
+    static const char *const modes[] = {"cached", "kept", "locked"};
+    fprintf(f, "model_mode %s\n", modes[stats.model.mode]);
+    fprintf(f, "model_kb %zu\n", stats.model.bytes / 1024);
+    fprintf(f, "model_resident_kb %zu\n", stats.model.resident_bytes / 1024);
+    fprintf(f, "model_refaults %lu\n", stats.model.refaults);
+  }
+  fprintf(f, "engine_crashes %lu\n", stats.crashes);
+  fprintf(f, "engine_failovers %lu\n", stats.failovers);
+  fclose(f);
+  rename(AUDIO_TTS_STATS_FILE ".tmp", AUDIO_TTS_STATS_FILE);
+}
+
+/* Ack a request on fd. An info query ('q') also gets the playback
+ * statistics, after the card number so older readers still find it, and
+ * a TTS statistics query ('t') gets hal_tts_get_stats(). Anything else gets
+ * the times of its stages (AUDIO_ACK_REPLY_INTS), received_us on. */
+static void audio_write_ack(int fd, unsigned short tag, char type,
+                            int result, unsigned int received_us) {
+  audio_publish_tts_stats();
+  audio_publish_metrics();
+  if (type == 't') {
+    int reply[AUDIO_TTS_STATS_REPLY_INTS] = {result};
+    audio_tts_stats_ints(reply + 1);
+    frame_write(fd, AUDIO, tag, reply, sizeof(reply));
+    return;
+  }
+  if (type == 'q') {
+    AudioStats stats = {0};
+    hal_audio_get_stats(&stats);
+    int reply[AUDIO_INFO_REPLY_INTS] = {result,
+                                        (int)stats.underruns,
+                                        (int)stats.buffer_ms,
+                                        (int)stats.min_fill_ms,
+                                        (int)stats.resizes};
+    frame_write(fd, AUDIO, tag, reply, sizeof(reply));
+    return;
+  }
+  unsigned int speak_us;
+  unsigned int first_audio_us;
+  hal_tts_request_times(&speak_us, &first_audio_us);
+  hampod_trace(TRACE_AUDIO_ACK, tag, (uint32_t)result, 0);
+  hampod_metric_add(METRIC_AUDIO_REQUESTS, 1);
+  int reply[AUDIO_ACK_REPLY_INTS] = {result, (int)received_us, (int)speak_us,
+                                     (int)first_audio_us,
+                                     (int)frame_clock_us()};
+  frame_write(fd, AUDIO, tag, reply, sizeof(reply));
+}
+
+/* Played requests ('f') waiting for their HAL marker
+ * (hal_audio_queue_marker()), indexed by marker id: where to ack and with
+ * what tag. Guarded by audio_played_lock. */
+#define AUDIO_PLAYED_MAX 8
+
+typedef struct {
+  int used;
+  int fd;
+  unsigned short tag;
+  unsigned int received_us;
+} Played_wait;
+
+static Played_wait audio_played[AUDIO_PLAYED_MAX];
+static pthread_mutex_t audio_played_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Leave the ack of a played request to audio_played_thread, which sends it
+ * once everything queued before it has been heard or cut off. Returns 0,
+ * or -1 if it is to be acked now (no free slot, or interrupted). */
+static int audio_ack_when_played(int fd, unsigned short tag,
+                                 unsigned int received_us) {
+  int result = -1;
+  pthread_mutex_lock(&audio_played_lock);
+  for (int i = 0; i < AUDIO_PLAYED_MAX; i++) {
+    if (!audio_played[i].used) {
+      audio_played[i] = (Played_wait){1, fd, tag, received_us};
+      if (hal_audio_queue_marker((unsigned int)i) == 0) {
+        result = 0;
+      } else {
+        audio_played[i].used = 0;
+      }
+      break;
+    }
+  }
+  pthread_mutex_unlock(&audio_played_lock);
+  return result;
+}
+
+/* Acks played requests as the playback thread gets to their markers */
+static void *audio_played_thread(void *arg) {
+  (void)arg;
+  hampod_metrics_name_thread("audio-played");
+  unsigned int id;
+  while (hal_audio_wait_marker(&id) == 0) {
+    if (id >= AUDIO_PLAYED_MAX) {
+      continue;
+    }
+    pthread_mutex_lock(&audio_played_lock);
+    Played_wait wait = audio_played[id];
+    audio_played[id].used = 0;
+    pthread_mutex_unlock(&audio_played_lock);
+    if (wait.used) {
+      int reply[AUDIO_ACK_REPLY_INTS] = {0, (int)wait.received_us, 0, 0,
+                                         (int)frame_clock_us()};
+      frame_write(wait.fd, AUDIO, wait.tag, reply, sizeof(reply));
+    }
+  }
+  return NULL;
+}
+
+/* Speak sequence ('m'): segments separated by AUDIO_SEQ_SEPARATOR, each a
+ * kind byte and its data - 'd' text, 'w' words spoken one cached word at a
+ * time (hal_tts_fragments.h), 'p' clip path, 'b' beep (k/h/e), 'o' tone
+ * (hal_tone_parse()), 'g' silence in ms or 'v' the voice the rest of it
+ * is spoken in (hal_tts_select_voice()). A leading 'x' is a deadline, a
+ * frame_clock_us() value: a readout that comes up after it is stale, and
+ * is skipped with AUDIO_RESULT_EXPIRED before anything is synthesized.
+ * Runs of text segments are joined and sent to Piper as one utterance,
+ * so the end-of-utterance timeout is paid once per run instead of once
+ * per segment. RAM clips, tones and gaps go on the HAL segment queue, so
+ * they play back-to-back with the speech around them without waiting for
+ * ring space. The whole sequence gets a single ack. */
+static int audio_run_sequence(char *segments) {
+  char text[MAXSTRINGSIZE];
+  size_t text_len = 0;
+  int result = 0;
+
+  hal_audio_clear_interrupt();
+  audio_sequence_cancelled = 0;
+
+  char *segment = segments;
+  while (segment != NULL && !audio_sequence_cancelled) {
+    char *next = strchr(segment, AUDIO_SEQ_SEPARATOR);
+    if (next != NULL) {
+      *next++ = '\0';
+    }
+
+    char kind = segment[0];
+    char *data = kind != '\0' ? segment + 1 : segment;
+    if (kind == 'd') {
+      size_t len = strlen(data);
+      if (text_len + len + 2 <= sizeof(text)) {
+        if (text_len > 0) {
+          text[text_len++] = ' ';
+        }
+        memcpy(text + text_len, data, len + 1);
+        text_len += len;
+      }
+      segment = next;
+      continue;
+    }
+
+    if (text_len > 0) {
+      AUDIO_PRINTF("Sequence TTS: %s\n", text);
+      if (hal_tts_speak(text, NULL) != 0) {
+        result = -1;
+      }
+      text_len = 0;
+    }
+    if (audio_sequence_cancelled) {
+      break;
+    }
+
+    HalTone tone;
+    if (kind == 'p' && audio_dtmf_tone(data, &tone) == 0) {
+      if (hal_audio_queue_tone(&tone) != 0) {
+        result = -1;
+      }
+    } else if (kind == 'p' && hal_audio_clips_queue(data) == 0) {
+      /* Clip in RAM: queued as a segment, gapless after what came before */
+    } else if (kind == 'o') {
+      if (hal_tone_parse(data, &tone) != 0 ||
+          hal_audio_queue_tone(&tone) != 0) {
+        result = -1;
+      }
+    } else if (kind == 'p' || kind == 'b') {
+      if (audio_run_request(kind, data) != 0) {
+        result = -1;
+      }
+    } else if (kind == 'w') {
+      AUDIO_PRINTF("Sequence words: %s\n", data);
+      if (hal_tts_speak_fragments(data) != 0) {
+        result = -1;
+      }
+    } else if (kind == 'x') {
+      unsigned int deadline = (unsigned int)strtoul(data, NULL, 10);
+      if ((int)(frame_clock_us() - deadline) >= 0) { /* Wraps, like acks */
+        AUDIO_PRINTF("Sequence expired, skipped\n");
+        hampod_metric_add(METRIC_AUDIO_EXPIRED, 1);
+        result = AUDIO_RESULT_EXPIRED;
+        break;
+      }
+    } else if (kind == 'v') {
+      /* An unknown voice speaks in the default one rather than failing */
+      hal_tts_select_voice(data);
+    } else if (kind == 'g') {
+      long ms = strtol(data, NULL, 10);
+      if (ms < 0) {
+        ms = 0;
+      } else if (ms > AUDIO_SEQ_GAP_MAX_MS) {
+        ms = AUDIO_SEQ_GAP_MAX_MS;
+      }
+      if (hal_audio_queue_silence((unsigned int)ms) != 0) {
+        result = -1;
+      }
+    } else if (kind != '\0') {
+      AUDIO_PRINTF("Sequence: unknown segment kind %c\n", kind);
+      result = -1;
+    }
+    segment = next;
+  }
+
+  if (text_len > 0 && !audio_sequence_cancelled) {
+    AUDIO_PRINTF("Sequence TTS: %s\n", text);
+    if (hal_tts_speak(text, NULL) != 0) {
+      result = -1;
+    }
+  }
+  hal_tts_select_voice(NULL); /* Other requests speak in the default */
+  return result;
+}
+
+/* The library clip a character is spelled with, if it has one: digits,
+ * letters (unless spelled phonetically), "POINT" and "POUND" */
+static int audio_spell_clip(char c, int phonetic, char *path, size_t len) {
+  const char *name;
+  char single[2] = {(char)toupper((unsigned char)c), '\0'};
+  if (isdigit((unsigned char)c) || (isalpha((unsigned char)c) && !phonetic)) {
+    name = single;
+  } else if (c == '.') {
+    name = "POINT";
+  } else if (c == '#') {
+    name = "POUND";
+  } else {
+    return -1;
+  }
+  snprintf(path, len, "pregen_audio/%s", name);
+  return 0;
+}
+
+/* Spell request ('s', AUDIO_SPELL_GAP_DEFAULT_MS): each character plays
+ * on its own, from the clip library if it has it and otherwise as a cached
+ * vocabulary word (hal_tts_spell_word()), with the gap between characters
+ * and twice it at a space, all on the segment queue. Nothing goes to the
+ * synthesizer as a whole, so a callsign spells with the same timing every
+ * time. */
+static int audio_spell(char *payload) {
+  int phonetic = 0;
+  long gap_ms = AUDIO_SPELL_GAP_DEFAULT_MS;
+  char *text = payload;
+  if ((payload[0] == 'l' || payload[0] == 'n') &&
+      isdigit((unsigned char)payload[1])) {
+    char *end;
+    long ms = strtol(payload + 1, &end, 10);
+    if (*end == ':') {
+      phonetic = payload[0] == 'n';
+      gap_ms = ms > AUDIO_SEQ_GAP_MAX_MS ? AUDIO_SEQ_GAP_MAX_MS : ms;
+      text = end + 1;
+    }
+  }
+
+  hal_audio_clear_interrupt();
+  audio_sequence_cancelled = 0;
+  int result = 0;
+  int spelled = 0;
+  for (const char *c = text; *c != '\0' && !audio_sequence_cancelled; c++) {
+    if (*c == ' ') {
+      if (spelled && hal_audio_queue_silence((unsigned int)gap_ms) != 0) {
+        result = -1;
+      }
+      continue;
+    }
+    char clip[32];
+    const char *word = hal_tts_spell_word(*c, phonetic);
+    if (audio_spell_clip(*c, phonetic, clip, sizeof(clip)) != 0 ||
+        hal_audio_clips_queue(clip) != 0) {
+      if (word == NULL) {
+        continue; /* Not spelled */
+      }
+      if (hal_tts_speak_fragments(word) != 0) {
+        result = -1;
+      }
+    }
+    if (c[1] != '\0' && hal_audio_queue_silence((unsigned int)gap_ms) != 0) {
+      result = -1;
+    }
+    spelled = 1;
+  }
+  return result;
+}
+
+/* Carry out one queued audio request and return the value to ack with.
+ * Shared by the Speaker_i queue and the shared-memory ring. */
+static int audio_run_request(char audio_type_byte, char *remaining_string) {
   char buffer[MAXSTRINGSIZE];
+  int system_result;
+  if (audio_type_byte == 'd') {
+    /* New TTS request - clear interrupt so this can play */
+    hal_audio_clear_interrupt();
+    AUDIO_PRINTF("TTS speak (direct): %s\n", remaining_string);
+    system_result = hal_tts_speak(remaining_string, NULL);
+  } else if (audio_type_byte == 's') {
+    AUDIO_PRINTF("Spell: %s\n", remaining_string);
+    system_result = audio_spell(remaining_string);
+  } else if (audio_type_byte == 'p') {
+    /* Playing audio file - clear interrupt so this can play */
+    hal_audio_clear_interrupt();
+    // strcpy(buffer, "aplay '");
+    // strcat(remaining_string, ".wav'");
+    // strcat(buffer, remaining_string);
+    AUDIO_PRINTF("Now playing %s with HAL\n", remaining_string);
+    /* DTMF is synthesized, pregenerated clips are already in RAM and
+     * anything else is read */
+    HalTone dtmf;
+    if (audio_dtmf_tone(remaining_string, &dtmf) == 0) {
+      system_result = hal_audio_queue_tone(&dtmf);
+    } else {
+      system_result = hal_audio_clips_play(remaining_string);
+    }
+    if (system_result != 0) {
+      sprintf(buffer, "%s.wav", remaining_string);
+      // system_result = system(buffer);
+      system_result = hal_audio_play_file(buffer);
+    }
+  } else if (audio_type_byte == 'b') {
+    /* Beep request: remaining_string is beep type ('k'=keypress, 'h'=hold,
+     * 'e'=error) */
+    hal_audio_clear_interrupt(); /* Clear interrupt so beep can play */
+    BeepType beep_type;
+    switch (remaining_string[0]) {
+    case 'k':
+      beep_type = BEEP_KEYPRESS;
+      break;
+    case 'h':
+      beep_type = BEEP_HOLD;
+      break;
+    case 'e':
+      beep_type = BEEP_ERROR;
+      break;
+    default:
+      AUDIO_PRINTF("Unknown beep type: %c\n", remaining_string[0]);
+      beep_type = BEEP_KEYPRESS;
+    }
+    system_result = audio_play_beep(beep_type);
+  } else if (audio_type_byte == 'm') {
+    AUDIO_PRINTF("Speak sequence\n");
+    system_result = audio_run_sequence(remaining_string);
+  } else if (audio_type_byte == 'i') {
+    /* Interrupt request */
+    AUDIO_PRINTF("Interrupting audio playback\n");
+    audio_sequence_cancelled = 1;
+    hal_audio_interrupt();
+    hal_tts_interrupt();
+    system_result = 0;
+  } else if (audio_type_byte == 'q') {
+    /* Query audio device info - return card number */
+    AUDIO_PRINTF("Querying audio device info\n");
+    system_result = hal_audio_get_card_number();
+    AUDIO_PRINTF("Returning card number: %d\n", system_result);
+  } else if (audio_type_byte == 'r') {
+    /* Say a recent announcement again: "r1" the last, "r2" the one
+     * before; its audio was kept, so nothing is synthesized */
+    hal_audio_clear_interrupt();
+    AUDIO_PRINTF("Replay: %s\n", remaining_string);
+    system_result = hal_tts_replay(atoi(remaining_string));
+  } else if (audio_type_byte == 't') {
+    /* TTS statistics, sent with the ack */
+    AUDIO_PRINTF("Querying TTS statistics\n");
+    system_result = 0;
+  } else if (audio_type_byte == 'f') {
+    /* Played: nothing to do, the ack waits (audio_ack_when_played()) */
+    system_result = 0;
+  } else {
+    AUDIO_PRINTF("Audio error. Unrecognized packet data %c%s\n",
+                 audio_type_byte, remaining_string);
+    system_result = -1;
+  }
+  return system_result;
+}
+
+/* Move to a new speech epoch and stop what is playing if it predates it.
+ * Requests already queued from before are skipped when they come up.
+ * Call with audio_queue_lock held. */
+static void audio_enter_epoch(unsigned char epoch) {
+  audio_epoch = epoch;
+  if (audio_playing_epoch == 0 ||
+      frame_epoch_newer(epoch, audio_playing_epoch)) {
+    audio_sequence_cancelled = 1;
+    hal_audio_interrupt();
+    hal_tts_interrupt();
+  }
+}
+
+/* A request stamped with a later epoch than the last interrupt seen means
+ * that interrupt is still on its way (it took another path, or Software
+ * sent it on the pipe while the request used the ring): act on it now.
+ * Call with audio_queue_lock held. */
+static void audio_note_epoch(unsigned char epoch) {
+  if (epoch != 0 && audio_epoch != 0 && frame_epoch_newer(epoch, audio_epoch)) {
+    AUDIO_PRINTF("Request from epoch %d ahead of its interrupt\n", epoch);
+    audio_enter_epoch(epoch);
+  }
+}
+
+/* Whether a request stamped with epoch may start; if so it becomes the
+ * playing request. Unstamped requests always play. Call with
+ * audio_queue_lock held. */
+static int audio_begin_request(unsigned char epoch) {
+  audio_note_epoch(epoch);
+  if (epoch != 0 && audio_epoch != 0 && frame_epoch_newer(audio_epoch, epoch)) {
+    AUDIO_PRINTF("Skipping request from interrupted epoch %d\n", epoch);
+    return 0;
+  }
+  audio_playing_epoch = epoch;
+  return 1;
+}
+
+/* Start timing a request, and mark where its audio starts so its first
+ * sound is traced (hal_audio_mark_sound()) */
+static void audio_start_request(unsigned short tag) {
+  hal_tts_request_begin();
+  hampod_trace(TRACE_AUDIO_BEGIN, tag, 0, 0);
+  hal_audio_mark_sound(tag);
+}
+
+/* Play everything pending in the shared-memory ring. Each slot's text is
+ * used in place and acked on Speaker_o like a pipe request. */
+static void audio_serve_shm_ring(Shm_audio_ring *ring, int output_pipe_fd) {
+  Shm_audio_slot *slot;
+  while (audio_running && (slot = shm_ring_peek(ring)) != NULL) {
+    unsigned short tag = slot->tag;
+    char type = slot->type;
+    unsigned int received_us = frame_clock_us(); /* Not stamped when posted */
+    cpufreq_boost();
+    hampod_trace(TRACE_AUDIO_REQUEST, (unsigned char)type, tag, 0);
+    pthread_mutex_lock(&audio_queue_lock);
+    int play = audio_begin_request(slot->epoch);
+    pthread_mutex_unlock(&audio_queue_lock);
+    hal_tts_set_backlog((int)(atomic_load(&ring->head) -
+                              atomic_load(&ring->tail) - 1));
+    audio_start_request(tag);
+    int system_result = play ? audio_run_request(slot->type, slot->text) : -1;
+    shm_ring_pop(ring);
+    pthread_mutex_lock(&audio_queue_lock);
+    audio_playing_epoch = 0;
+    pthread_mutex_unlock(&audio_queue_lock);
+    AUDIO_PRINTF("Sending back value of %x\n", system_result);
+    audio_write_ack(output_pipe_fd, tag, type, system_result, received_us);
+  }
+}
+
+/* Turn shared-memory ring posts into audio_queue_ready wakeups, so the main
+ * loop has a single thing to sleep on. */
+static void *audio_ring_waker(void *arg) {
+  Shm_audio_ring *ring = (Shm_audio_ring *)arg;
+  while (audio_running) {
+    if (shm_ring_wait(ring, -1) != 0) {
+      continue;
+    }
+    pthread_mutex_lock(&audio_queue_lock);
+    audio_ring_pending = 1;
+    pthread_cond_signal(&audio_queue_ready);
+    pthread_mutex_unlock(&audio_queue_lock);
+  }
+  return NULL;
+}
+
+/* Serve one direct Software connection at a time on the audio socket.
+ * Requests share the Speaker_i queue; replies go back on the socket. */
+static void *audio_direct_thread(void *arg) {
+  Packet_queue *queue = (Packet_queue *)arg;
+  while (audio_running) {
+    Transport link;
+    if (transport_accept(audio_direct_listen_fd, &link) != 0) {
+      break;
+    }
+    AUDIO_IO_PRINTF("Direct channel connected\n");
+    audio_direct_fd = link.tx_fd;
+    audio_io_loop(link.rx_fd, link.tx_fd, queue, PACKET_FLAG_DIRECT);
+    audio_direct_fd = -1;
+    transport_close(&link);
+    AUDIO_IO_PRINTF("Direct channel closed\n");
+  }
+  return NULL;
+}
+
+/* Play the key-down beeps the keypad process asks for (local key beep).
+ * Same as the BEEP BYPASS, minus the packet and the ack. */
+static void *audio_local_beep_thread(void *arg) {
+  (void)arg;
+  char kind;
+  while (audio_running && read(local_beep_fds[0], &kind, 1) == 1) {
+    AUDIO_IO_PRINTF("LOCAL BEEP: Playing beep '%c'\n", kind);
+    hal_audio_play_beep(BEEP_KEYPRESS);
+  }
+  return NULL;
+}
+
+/* Resident memory of a process in kB, or 0 if it cannot be read */
+static long audio_rss_kb(pid_t pid) {
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/%d/statm", (int)pid);
+  FILE *f = fopen(path, "r");
+  long pages = 0;
+  if (f != NULL) {
+    long size;
+    if (fscanf(f, "%ld %ld", &size, &pages) != 2) {
+      pages = 0;
+    }
+    fclose(f);
+  }
+  return pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+/* Log what the audio process and the Piper workers it started hold once
+ * start-up is done: with the model loaded, the warm-up run and the clips
+ * in, this is what memory_profile has to fit */
+static void audio_report_memory(void) {
+  long own_kb = audio_rss_kb(getpid());
+  long helpers_kb = 0;
+  int helpers = 0;
+  DIR *proc = opendir("/proc");
+  struct dirent *entry;
+  while (proc != NULL && (entry = readdir(proc)) != NULL) {
+    char *end;
+    long pid = strtol(entry->d_name, &end, 10);
+    if (!isdigit((unsigned char)entry->d_name[0]) || *end != '\0') {
+      continue; /* Not a process */
+    }
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%ld/stat", pid);
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+      continue;
+    }
+    /* pid (comm) state ppid: comm may hold spaces, so skip to its ')' */
+    char line[512];
+    int ppid = -1;
+    if (fgets(line, sizeof(line), f) != NULL) {
+      char *end = strrchr(line, ')');
+      if (end == NULL || sscanf(end + 1, " %*c %d", &ppid) != 1) {
+        ppid = -1;
+      }
+    }
+    fclose(f);
+    if (ppid == (int)getpid()) {
+      helpers_kb += audio_rss_kb((pid_t)pid);
+      helpers++;
+    }
+  }
+  if (proc != NULL) {
+    closedir(proc);
+  }
+  printf("Audio memory after start-up: %ld MB, %d TTS process(es) %ld MB, "
+         "total %ld MB (memory profile %s)\n",
+         own_kb / 1024, helpers, helpers_kb / 1024,
+         (own_kb + helpers_kb) / 1024,
+         sched_profile.low_memory ? "low" : "normal");
+}
+
+/* Start-up step: read the TTS cache index */
+static void *audio_open_cache(void *arg) {
+  (void)arg;
+  long long started = boot_clock_ms();
+  if (hal_tts_cache_init() != 0) {
+    AUDIO_PRINTF("TTS cache unavailable, speech will not be cached\n");
+  }
+  boot_log_phase("audio", "cache-init", started);
+  return NULL;
+}
+
+/* On the way out (SIGINT ends the process with exit()): what was heard
+ * most goes back into RAM at the next start, and in tmpfs mode the store
+ * is copied to the card */
+static void audio_save_cache(void) {
+  int saved = hal_tts_cache_save_hotset();
+  if (saved >= 0) {
+    AUDIO_PRINTF("Saved %d cache entries as the hot set\n", saved);
+  }
+  hal_tts_cache_writeback();
+}
+
+/* Take the watchdog's next step on a request stalled for stalled_ms */
+static void audio_watchdog_step(int step, long long stalled_ms) {
+  static const char *const step_names[] = {"interrupt", "restart TTS",
+                                           "reopen PCM"};
+  long long started = boot_clock_ms();
+  int result = 0;
+  if (step == 0) {
+    audio_sequence_cancelled = 1;
+    hal_audio_interrupt();
+    hal_tts_interrupt();
+  } else if (step == 1) {
+    hal_tts_restart();
+  } else {
+    result = hal_audio_reopen();
+  }
+  hampod_metric_add(METRIC_WATCHDOG_ACTIONS, 1);
+  HAMPOD_LOG(2, "Audio watchdog: no progress for %lld ms, %s %s (%lld ms)\n",
+             stalled_ms, step_names[step], result == 0 ? "done" : "failed",
+             boot_clock_ms() - started);
+}
+
+/* Watchdog thread (see AUDIO_WATCHDOG_ENV in audio_firmware.h). Each
+ * step waits a further stall_ms without progress after the last, and the
+ * steps start over only once the audio has moved and stall_ms more have
+ * passed without another, so a fault that ends each request early (a hung
+ * engine that the interrupt only cuts short) still escalates. */
+static void *audio_watchdog_thread(void *arg) {
+  int stall_ms = *(int *)arg;
+  hampod_metrics_name_thread("audio-watchdog");
+  unsigned long long progress = hal_audio_progress();
+  long long moved_ms = boot_clock_ms();
+  long long step_ms = 0; /* When the last step was taken */
+  struct timespec tick = {0, AUDIO_WATCHDOG_TICK_MS * 1000000L};
+  while (audio_running) {
+    nanosleep(&tick, NULL);
+    long long now = boot_clock_ms();
+    unsigned long long seen = hal_audio_progress();
+    long long request_ms = atomic_load(&audio_request_started_ms);
+    int steps = atomic_load(&audio_watchdog_steps);
+    if (seen != progress) {
+      progress = seen;
+      moved_ms = now;
+    }
+    if (steps > 0 && moved_ms > step_ms && now - step_ms >= 2LL * stall_ms) {
+      HAMPOD_LOG(1, "Audio watchdog: recovered, audio moved %lld ms after "
+                    "the last step\n",
+                 moved_ms - step_ms);
+      atomic_store(&audio_watchdog_steps, 0);
+      steps = 0;
+    }
+    if (request_ms == 0 && !hal_audio_is_playing()) {
+      moved_ms = now; /* Idle: nothing is due to move */
+      continue;
+    }
+    long long stalled = moved_ms;
+    if (request_ms > stalled) {
+      stalled = request_ms; /* A request's wait starts when it does */
+    }
+    long long since = steps > 0 && step_ms > stalled ? step_ms : stalled;
+    /* A stall that outlasts every step is left to Software's link check */
+    if (steps < 3 && now - since >= stall_ms) {
+      audio_watchdog_step(steps, now - stalled);
+      step_ms = boot_clock_ms();
+      atomic_store(&audio_watchdog_steps, steps + 1);
+    }
+  }
+  return NULL;
+}
+
+/* Start-up step: load the voice model and run its warm-up */
+static void *audio_init_tts(void *arg) {
+  (void)arg;
+  int tts_first, tts_last;
+  if (sched_parse_cpus(sched_profile.tts_cpus, &tts_first, &tts_last) == 0) {
+    hal_tts_set_cpus(tts_first, tts_last);
+  }
+
+  /* A process locked in RAM (--mlock) keeps the model file locked too, so
+   * a Piper restart never reads it back from the SD card */
+  if (sched_profile.mlock) {
+    hal_tts_set_model_residency(HAL_TTS_MODEL_LOCKED);
+  }
+
+  long long started = boot_clock_ms();
+  if (hal_tts_init() != 0) {
+    AUDIO_PRINTF("Failed to initialize TTS HAL\n");
+  } else {
+    AUDIO_PRINTF("TTS HAL initialized: %s\n", hal_tts_get_impl_name());
+  }
+  long long load_ms, warm_ms;
+  hal_tts_init_times(&load_ms, &warm_ms);
+  if (load_ms > 0 || warm_ms > 0) {
+    boot_log_span("audio", "piper-start", started, started + load_ms);
+    boot_log_phase("audio", "warm-up", boot_clock_ms() - warm_ms);
+  } else {
+    boot_log_phase("audio", "tts-init", started);
+  }
+  return NULL;
+}
+
+void audio_process() {
+  AUDIO_PRINTF("Audio process launched\n");
+#ifndef HAMPOD_THREADED
+  hampod_alloc_dump_on_signal("audio");
+  hampod_trace_open("audio");
+  hampod_metrics_open("audio");
+  hampod_log_start();
+#endif
+
+#ifndef HAMPOD_THREADED
+  if (local_beep_fds[1] != -1) {
+    close(local_beep_fds[1]); /* The keypad process writes it */
+  }
+#endif
+
+  /* Bring up audio and TTS (including the TTS warm-up) before opening
+   * the pipes. Firmware waits on them before it sends Software the 'R'
+   * ready packet, so the first announcement is not slowed by start-up.
+   * The cache index, the voice model and the sound card share nothing,
+   * so they come up side by side: start-up takes as long as the model
+   * load, not the sum of the three. */
+  if (sched_profile.mlock) {
+    sched_lock_memory("Audio process"); /* No page faults mid-playback */
+  }
+
+  pthread_t cache_thread, tts_thread;
+  int cache_started =
+      pthread_create(&cache_thread, NULL, audio_open_cache, NULL) == 0;
+  if (!cache_started) {
+    audio_open_cache(NULL);
+  }
+  int tts_started =
+      pthread_create(&tts_thread, NULL, audio_init_tts, NULL) == 0;
+
+  long long phase_started = boot_clock_ms();
+  if (hal_audio_init() != 0) {
+    AUDIO_PRINTF("Failed to initialize audio HAL\n");
+  } else {
+    AUDIO_PRINTF("Audio HAL initialized\n");
+    hal_audio_set_rt_priority(sched_profile.audio_priority);
+  }
+  if (sched_profile.idle_mode) {
+    /* Keep-alive silence wakes the playback thread every few ms */
+    hal_audio_set_keep_alive(IDLE_MODE_KEEPALIVE_S);
+  }
+  boot_log_phase("audio", "audio-open", phase_started);
+
+  if (getenv(HAL_REMOTE_ENV) != NULL) {
+#ifdef USE_REMOTE_AUDIO
+    if (hal_audio_stream_start() != 0) {
+      AUDIO_PRINTF("Remote audio stream not started\n");
+    }
+#else
+    fprintf(stderr, "Remote audio is not built in (make REMOTE_AUDIO=opus)\n");
+#endif
+  }
+
+  phase_started = boot_clock_ms();
+  if (hal_audio_clips_load("pregen_audio") == -1) {
+    AUDIO_PRINTF("Pregen clips not loaded, playing them from disk\n");
+  }
+  audio_load_echo_clips();
+  boot_log_phase("audio", "clips", phase_started);
+
+  if (tts_started) {
+    pthread_join(tts_thread, NULL);
+  } else {
+    audio_init_tts(NULL);
+  }
+  if (cache_started) {
+    pthread_join(cache_thread, NULL);
+  }
+  atexit(audio_save_cache);
+  audio_report_memory();
+
+  /* Listen before opening the pipes: once Firmware has both pipe ends it
+   * tells Software it is ready, and Software connects straight away */
+  if (direct_channels) {
+    audio_direct_listen_fd =
+        transport_listen_seqpacket(TRANSPORT_AUDIO_SOCKET_NAME);
+  }
 
-  AUDIO_PRINTF("Audio process launched\nConnecting to input/output pipes\n");
+  AUDIO_PRINTF("Connecting to input/output pipes\n");
 
+#ifdef HAMPOD_THREADED
+  int input_pipe_fd = audio_channel_fds[0];
+  int output_pipe_fd = audio_channel_fds[1];
+  channel_connect(input_pipe_fd);
+  channel_connect(output_pipe_fd);
+#else
   int input_pipe_fd = open(AUDIO_I, O_RDONLY);
   if (input_pipe_fd == -1) {
     perror("open");
@@ -32,20 +984,13 @@ void audio_process() {
     // kill(controller_pid, SIGINT);
     exit(0);
   }
+#endif
 
   AUDIO_PRINTF("Pipes successfully connected\nCreating input queue\n");
 
-  if (hal_audio_init() != 0) {
-    AUDIO_PRINTF("Failed to initialize audio HAL\n");
-  } else {
-    AUDIO_PRINTF("Audio HAL initialized\n");
-  }
-
-  if (hal_tts_init() != 0) {
-    AUDIO_PRINTF("Failed to initialize TTS HAL\n");
-  } else {
-    AUDIO_PRINTF("TTS HAL initialized: %s\n", hal_tts_get_impl_name());
-  }
+  /* Firmware sends the ready packet once both pipes are open: catch up on
+   * what start-up left for later */
+  hal_tts_begin_upkeep();
 
   AUDIO_PRINTF("Creating input queue\n");
 
@@ -58,10 +1003,10 @@ void audio_process() {
     // kill(controller_pid, SIGINT);
     exit(1);
   }
-  AUDIO_PRINTF("Initializing queue availibility mutex lock\n");
+  AUDIO_PRINTF("Initializing queue condition variable\n");
 
-  if (pthread_mutex_init(&audio_queue_available, NULL) != 0) {
-    perror("pthread_mutex_init");
+  if (pthread_cond_init(&audio_queue_ready, NULL) != 0) {
+    perror("pthread_cond_init");
     // kill(controller_pid, SIGINT);
     exit(1);
   }
@@ -79,99 +1024,117 @@ void audio_process() {
     // kill(controller_pid, SIGINT);
     exit(1);
   }
-  usleep(500000); // Half sec sleep to let child thread take control
+  if (audio_direct_listen_fd != -1) {
+    pthread_t direct_thread;
+    AUDIO_PRINTF("Launching direct channel thread\n");
+    if (pthread_create(&direct_thread, NULL, audio_direct_thread,
+                       (void *)input_queue) != 0) {
+      perror("Audio direct channel thread failed");
+      exit(1);
+    }
+    pthread_detach(direct_thread);
+  }
+  if (local_beep_fds[0] != -1) {
+    pthread_t local_beep;
+    AUDIO_PRINTF("Launching local beep thread\n");
+    if (pthread_create(&local_beep, NULL, audio_local_beep_thread, NULL) !=
+        0) {
+      perror("Audio local beep thread failed");
+      exit(1);
+    }
+    pthread_detach(local_beep);
+  }
+  pthread_t ring_waker;
+  if (audio_shm_ring != NULL) {
+    AUDIO_PRINTF("Launching shared-memory ring waker thread\n");
+    if (pthread_create(&ring_waker, NULL, audio_ring_waker,
+                       (void *)audio_shm_ring) != 0) {
+      perror("Audio ring waker thread failed");
+      exit(1);
+    }
+    pthread_detach(ring_waker);
+  }
+
+  pthread_t played_thread;
+  if (pthread_create(&played_thread, NULL, audio_played_thread, NULL) != 0) {
+    perror("Audio played thread failed");
+    exit(1);
+  }
+  pthread_detach(played_thread);
+
+  const char *watchdog_env = getenv(AUDIO_WATCHDOG_ENV);
+  static int watchdog_ms = AUDIO_WATCHDOG_DEFAULT_MS;
+  if (watchdog_env != NULL) {
+    watchdog_ms = atoi(watchdog_env);
+  }
+  if (watchdog_ms > 0) {
+    pthread_t watchdog;
+    AUDIO_PRINTF("Launching watchdog thread (%d ms)\n", watchdog_ms);
+    if (pthread_create(&watchdog, NULL, audio_watchdog_thread,
+                       (void *)&watchdog_ms) != 0) {
+      perror("Audio watchdog thread failed");
+    } else {
+      pthread_detach(watchdog);
+    }
+  }
 
   while (audio_running) {
-    pthread_mutex_lock(&audio_queue_available);
+    /* Sleep until the IO thread queues a packet or the ring has work */
     pthread_mutex_lock(&audio_queue_lock);
-    if (is_empty(input_queue)) {
-      pthread_mutex_unlock(&audio_queue_available);
-      pthread_mutex_unlock(&audio_queue_lock);
-      usleep(500);
-      continue;
+    while (audio_running && is_empty(input_queue) && !audio_ring_pending) {
+      pthread_cond_wait(&audio_queue_ready, &audio_queue_lock);
     }
     Inst_packet *received_packet = dequeue(input_queue);
+    hampod_metric_set(METRIC_AUDIO_QUEUE_DEPTH, queue_depth(input_queue));
+    int serve_ring = 0;
+    int play = 0;
+    if (received_packet == NULL) {
+      serve_ring = audio_ring_pending;
+      audio_ring_pending = 0;
+    } else {
+      play = audio_begin_request(FRAME_EPOCH(received_packet->flags));
+      /* Lets TTS answer short prompts faster while a burst is waiting */
+      hal_tts_set_backlog(queue_depth(input_queue));
+    }
     pthread_mutex_unlock(&audio_queue_lock);
-    pthread_mutex_unlock(&audio_queue_available);
-    char *requested_string = calloc(1, received_packet->data_len + 0x10);
-    strcpy(requested_string, (char *)received_packet->data);
-    char audio_type_byte = requested_string[0];
-    char *remaining_string = requested_string + 1;
-    int system_result;
-    unsigned short packet_tag = received_packet->tag;
-    char default_directory[0x100];
-    getcwd(default_directory, sizeof(default_directory));
-    if (audio_type_byte == 'd') {
-      /* New TTS request - clear interrupt so this can play */
-      hal_audio_clear_interrupt();
-      AUDIO_PRINTF("TTS speak (direct): %s\n", remaining_string);
-      system_result = hal_tts_speak(remaining_string, NULL);
-    } else if (audio_type_byte == 's') {
-      /* New TTS request - clear interrupt so this can play */
-      hal_audio_clear_interrupt();
-      AUDIO_PRINTF("TTS speak (save): %s\n", remaining_string);
-      /* For Piper persistent mode, we ignore output_file and speak directly */
-      system_result = hal_tts_speak(remaining_string, NULL);
-    } else if (audio_type_byte == 'p') {
-      /* Playing audio file - clear interrupt so this can play */
-      hal_audio_clear_interrupt();
-      // strcpy(buffer, "aplay '");
-      // strcat(remaining_string, ".wav'");
-      // strcat(buffer, remaining_string);
-      sprintf(buffer, "%s.wav", remaining_string);
-      AUDIO_PRINTF("Now playing %s with HAL\n", remaining_string);
-      // system_result = system(buffer);
-      system_result = hal_audio_play_file(buffer);
-    } else if (audio_type_byte == 'b') {
-      /* Beep request: remaining_string is beep type ('k'=keypress, 'h'=hold,
-       * 'e'=error) */
-      hal_audio_clear_interrupt(); /* Clear interrupt so beep can play */
-      BeepType beep_type;
-      switch (remaining_string[0]) {
-      case 'k':
-        beep_type = BEEP_KEYPRESS;
-        break;
-      case 'h':
-        beep_type = BEEP_HOLD;
-        break;
-      case 'e':
-        beep_type = BEEP_ERROR;
-        break;
-      default:
-        AUDIO_PRINTF("Unknown beep type: %c\n", remaining_string[0]);
-        beep_type = BEEP_KEYPRESS;
+
+    if (received_packet == NULL) {
+      if (serve_ring) {
+        audio_serve_shm_ring(audio_shm_ring, output_pipe_fd);
       }
-      system_result = audio_play_beep(beep_type);
-    } else if (audio_type_byte == 'i') {
-      /* Interrupt request */
-      AUDIO_PRINTF("Interrupting audio playback\n");
-      hal_audio_interrupt();
-      hal_tts_interrupt();
-      system_result = 0;
-    } else if (audio_type_byte == 'q') {
-      /* Query audio device info - return card number */
-      AUDIO_PRINTF("Querying audio device info\n");
-      system_result = hal_audio_get_card_number();
-      AUDIO_PRINTF("Returning card number: %d\n", system_result);
-    } else {
-      AUDIO_PRINTF("Audio error. Unrecognized packet data %s\n",
-                   requested_string);
-      system_result = -1;
+      continue;
     }
-    Inst_packet *packet_to_send = create_inst_packet(
-        AUDIO, sizeof(int), (unsigned char *)&system_result, packet_tag);
-    AUDIO_PRINTF("Sending back value of %x\n", system_result);
-    write(output_pipe_fd, packet_to_send,
-          8); // Packet_to_send is a pointer, so would this not just be sending
-              // back the address of it.
-    write(
-        output_pipe_fd, packet_to_send->data,
-        sizeof(
-            int)); // while earlier you did have this be sizeof(int) would it
-                   // not be safer to just use the size value of packet_to_send
-    free(requested_string);
-    destroy_inst_packet(&packet_to_send);
-    destroy_inst_packet(&received_packet);
+    /* Queue slots are NUL-terminated, so the text is used in place */
+    char *requested_string = (char *)received_packet->data;
+    unsigned short packet_tag = received_packet->tag;
+    int system_result = -1;
+    audio_start_request(packet_tag);
+    if (play) {
+      atomic_store(&audio_request_started_ms, boot_clock_ms());
+      system_result = audio_run_request(
+          received_packet->data_len > 0 ? requested_string[0] : '\0',
+          received_packet->data_len > 0 ? requested_string + 1
+                                        : requested_string);
+      atomic_store(&audio_request_started_ms, 0);
+    }
+    /* A long request arrives as several fragments; ack the last one only.
+     * A played request's ack waits for the audio queued before it. */
+    int reply_fd = (received_packet->flags & PACKET_FLAG_DIRECT)
+                       ? audio_direct_fd
+                       : output_pipe_fd;
+    char type = received_packet->data_len > 0 ? requested_string[0] : '\0';
+    if (!(received_packet->flags & FRAME_FLAG_MORE) && reply_fd != -1 &&
+        !(play && type == 'f' &&
+          audio_ack_when_played(reply_fd, packet_tag,
+                                received_packet->received_us) == 0)) {
+      AUDIO_PRINTF("Sending back value of %x\n", system_result);
+      audio_write_ack(reply_fd, packet_tag, type, system_result,
+                      received_packet->received_us);
+    }
+    pthread_mutex_lock(&audio_queue_lock);
+    audio_playing_epoch = 0;
+    release_packet(input_queue, &received_packet);
+    pthread_mutex_unlock(&audio_queue_lock);
   }
 
   pthread_join(audio_io_buffer, NULL);
@@ -179,96 +1142,144 @@ void audio_process() {
   close(input_pipe_fd);
   close(output_pipe_fd); // Graceful closing is always nice :)
 
+  hal_cw_stop(); /* Its capture follows the audio device */
+  hal_audio_clips_cleanup();
   hal_audio_cleanup();
+#ifdef USE_REMOTE_AUDIO
+  hal_audio_stream_stop(); /* The playback thread feeds it until here */
+#endif
+  audio_free_echo_clips(); /* The mixer may play them until here */
   return;
 }
 
 void *audio_io_thread(void *arg) {
   AUDIO_IO_PRINTF("Audio IO thread created\n");
+  hampod_metrics_name_thread("audio-io");
 
   audio_io_packet *io_args = (audio_io_packet *)arg;
-  int i_pipe = io_args->pipe_fd;
-  int o_pipe = io_args->output_pipe_fd;
-  Packet_queue *queue = io_args->queue;
-  unsigned char buffer[256];
+  audio_io_loop(io_args->pipe_fd, io_args->output_pipe_fd, io_args->queue, 0);
+  return NULL;
+}
+
+/* Read requests from i_pipe until it closes. Bypassed requests are acked on
+ * o_pipe right here; the rest are queued with origin in their flags so the
+ * main loop knows where to ack. */
+static void audio_io_loop(int i_pipe, int o_pipe, Packet_queue *queue,
+                          unsigned short origin) {
+  unsigned char buffer[FRAME_MAX_DATA];
+  Frame_reader reader;
+  frame_reader_init(&reader, i_pipe);
 
   AUDIO_IO_PRINTF("Input pipe = %d, output pipe = %d, queue ptr = %p\n", i_pipe,
                   o_pipe, (void *)queue);
 
-  while (audio_running) {
-    pthread_mutex_lock(&audio_queue_lock);
-    int queue_empty = is_empty(queue);
-    pthread_mutex_unlock(&audio_queue_lock);
-    if (queue_empty) {
-      // KEYPAD_IO_PRINTF("Making queue inaccessible\n");
-      pthread_mutex_lock(&audio_queue_available);
-    }
-
-    Packet_type type;
-    unsigned short size;
-    unsigned short tag;
-    ssize_t bytes_read;
-
-    /* Read packet header with error checking */
-    bytes_read = read(i_pipe, &type, sizeof(Packet_type));
-    if (bytes_read <= 0) {
-      AUDIO_IO_PRINTF("Pipe closed or read error (type), exiting thread\n");
-      break;
-    }
-
-    bytes_read = read(i_pipe, &size, sizeof(unsigned short));
-    if (bytes_read <= 0) {
-      AUDIO_IO_PRINTF("Pipe closed or read error (size), exiting thread\n");
-      break;
-    }
+  /* Fragmented request currently arriving, and whether an interrupt cut it
+   * off (its remaining fragments are then dropped as they come in) */
+  unsigned short stream_tag = 0;
+  int stream_open = 0;
+  int stream_dropped = 0;
 
-    bytes_read = read(i_pipe, &tag, sizeof(unsigned short));
-    if (bytes_read <= 0) {
-      AUDIO_IO_PRINTF("Pipe closed or read error (tag), exiting thread\n");
-      break;
+  while (audio_running) {
+    Frame_header header;
+    int read_result = frame_read(&reader, &header, buffer, sizeof(buffer));
+    if (read_result == FRAME_DROPPED) {
+      HAMPOD_LOG(1, "Audio: request of %u bytes dropped\n", header.data_len);
+      continue;
     }
-
-    bytes_read = read(i_pipe, buffer, size);
-    if (bytes_read <= 0) {
-      AUDIO_IO_PRINTF("Pipe closed or read error (data), exiting thread\n");
+    if (read_result != 0) {
+      AUDIO_IO_PRINTF("Pipe closed or read error, exiting thread\n");
       break;
     }
+    Packet_type type = (Packet_type)header.type;
+    unsigned short size = header.data_len;
+    unsigned short tag = header.tag;
 
     AUDIO_IO_PRINTF("Found packet with type %d, size %d\n", type, size);
     AUDIO_IO_PRINTF("Buffer holds: %s: with size %d\n", buffer, size);
 
+    if (type == CONFIG) {
+      if (size >= 2 && buffer[0] == CONFIG_AUDIO_VOLUME) {
+        hal_audio_set_volume(buffer[1]);
+        AUDIO_IO_PRINTF("CONFIG: Volume %d%%\n", hal_audio_get_volume());
+        unsigned char ack[2] = {CONFIG_AUDIO_VOLUME,
+                                (unsigned char)hal_audio_get_volume()};
+        frame_write(o_pipe, CONFIG, tag, ack, 2);
+      } else if (size >= 2 && buffer[0] == CONFIG_AUDIO_SPEED) {
+        int speed_result = hal_tts_set_speed(buffer[1] / 100.0f);
+        AUDIO_IO_PRINTF("CONFIG: Speed %.2f, result %d\n", buffer[1] / 100.0f,
+                        speed_result);
+        unsigned char ack[2] = {CONFIG_AUDIO_SPEED,
+                                speed_result == 0 ? buffer[1] : 0};
+        frame_write(o_pipe, CONFIG, tag, ack, 2);
+      } else if (size >= 2 && buffer[0] == CONFIG_AUDIO_TTS_RAM) {
+        hal_tts_cache_set_ram_budget((uint64_t)buffer[1] * 1024 * 1024);
+        AUDIO_IO_PRINTF("CONFIG: TTS cache RAM %dMB\n", buffer[1]);
+        unsigned char ack[2] = {CONFIG_AUDIO_TTS_RAM, buffer[1]};
+        frame_write(o_pipe, CONFIG, tag, ack, 2);
+      } else if (size >= 2 && buffer[0] == CONFIG_AUDIO_PRIORITY) {
+        int priority_result = hal_audio_set_rt_priority(buffer[1]);
+        AUDIO_IO_PRINTF("CONFIG: Playback priority %d, result %d\n",
+                        buffer[1], priority_result);
+        unsigned char ack[2] = {CONFIG_AUDIO_PRIORITY,
+                                priority_result == 0 ? buffer[1] : 0xFF};
+        frame_write(o_pipe, CONFIG, tag, ack, 2);
+      }
+      continue;
+    }
+
     if (type != AUDIO) {
       AUDIO_IO_PRINTF("Packet not supported for Audio firmware\n");
       continue;
     }
+    cpufreq_boost();
+    hampod_trace(TRACE_AUDIO_REQUEST, size > 0 ? (unsigned char)buffer[0] : 0,
+                 tag, 0);
 
     /* ===== INTERRUPT BYPASS =====
      * Handle interrupt packets ('i') immediately without queueing.
      * This allows interrupts to take effect even when TTS is blocking.
+     * An interrupt stamped with an epoch only stops requests from earlier
+     * epochs; speech Software queued after it may already be here.
      */
     if (size > 0 && buffer[0] == 'i') {
       AUDIO_IO_PRINTF("INTERRUPT BYPASS: Handling interrupt immediately\n");
-      hal_audio_interrupt();
-      hal_tts_interrupt();
+      unsigned char epoch = FRAME_EPOCH(header.flags);
+      hampod_trace(TRACE_AUDIO_INTERRUPT, epoch, 0, 0);
+      if (stream_open) {
+        stream_dropped = 1;
+        stream_open = 0;
+      }
 
-      /* Clear any queued audio packets so they don't play after interrupt */
       pthread_mutex_lock(&audio_queue_lock);
-      clear_queue(queue);
+      if (epoch != 0) {
+        /* Unconditional: a restarted Software counts from 1 again */
+        audio_enter_epoch(epoch);
+        AUDIO_IO_PRINTF("INTERRUPT BYPASS: Now at epoch %d\n", epoch);
+      } else {
+        /* Clear any queued audio packets so they don't play after interrupt */
+        audio_sequence_cancelled = 1;
+        hal_audio_interrupt();
+        hal_tts_interrupt();
+        clear_queue(queue);
+        AUDIO_IO_PRINTF("INTERRUPT BYPASS: Cleared audio queue\n");
+      }
       pthread_mutex_unlock(&audio_queue_lock);
-      AUDIO_IO_PRINTF("INTERRUPT BYPASS: Cleared audio queue\n");
 
       /* Send acknowledgment directly to output pipe */
       int ack_result = 0;
-      Inst_packet *ack_packet = create_inst_packet(
-          AUDIO, sizeof(int), (unsigned char *)&ack_result, tag);
-      write(o_pipe, ack_packet, 8);
-      write(o_pipe, ack_packet->data, sizeof(int));
-      destroy_inst_packet(&ack_packet);
-
-      /* Release queue lock if we held it, then skip normal queue processing */
-      if (queue_empty) {
-        pthread_mutex_unlock(&audio_queue_available);
-      }
+      frame_write(o_pipe, AUDIO, tag, &ack_result, sizeof(int));
+
+      /* Skip normal queue processing */
+      continue;
+    }
+
+    /* ===== HEARTBEAT BYPASS =====
+     * Software's link check ('a'): answered here, whatever the main loop
+     * is stuck on, with the watchdog's steps in the current stall.
+     */
+    if (size > 0 && buffer[0] == 'a') {
+      int steps = atomic_load(&audio_watchdog_steps);
+      frame_write(o_pipe, AUDIO, tag, &steps, sizeof(int));
       continue;
     }
 
@@ -280,8 +1291,8 @@ void *audio_io_thread(void *arg) {
     if (size > 0 && buffer[0] == 'b') {
       AUDIO_IO_PRINTF("BEEP BYPASS: Playing beep immediately\n");
 
-      /* Clear interrupt to allow beep to play */
-      hal_audio_clear_interrupt();
+      /* The beep is mixed over whatever plays, so it neither waits for nor
+       * clears an interrupt */
 
       /* Determine beep type from second character */
       BeepType beep_type = BEEP_KEYPRESS;
@@ -303,60 +1314,183 @@ void *audio_io_thread(void *arg) {
       AUDIO_IO_PRINTF("BEEP BYPASS: Beep returned %d\n", beep_result);
 
       /* Send acknowledgment directly to output pipe */
-      Inst_packet *ack_packet = create_inst_packet(
-          AUDIO, sizeof(int), (unsigned char *)&beep_result, tag);
-      write(o_pipe, ack_packet, 8);
-      write(o_pipe, ack_packet->data, sizeof(int));
-      destroy_inst_packet(&ack_packet);
-
-      /* Release queue lock if we held it, then skip normal queue processing */
-      if (queue_empty) {
-        pthread_mutex_unlock(&audio_queue_available);
+      frame_write(o_pipe, AUDIO, tag, &beep_result, sizeof(int));
+
+      /* Skip normal queue processing */
+      continue;
+    }
+
+    /* ===== ECHO BYPASS =====
+     * Keypad echo ('e'): a clip such as "pregen_audio/5", mixed in at once
+     * like a beep and cutting off the echo before it, so typed digits keep
+     * up with the fingers. A clip not preloaded is played in turn as a
+     * 'p' request instead.
+     */
+    if (size > 1 && buffer[0] == 'e') {
+      buffer[size - 1] = '\0';
+      const Echo_clip *clip = audio_find_echo_clip((char *)&buffer[1]);
+      HalTone dtmf;
+      if (audio_dtmf_tone((char *)&buffer[1], &dtmf) == 0) {
+        AUDIO_IO_PRINTF("ECHO BYPASS: DTMF %s\n", (char *)&buffer[1]);
+        int echo_result = hal_audio_play_tone(&dtmf);
+        frame_write(o_pipe, AUDIO, tag, &echo_result, sizeof(int));
+        continue;
       }
+      if (clip != NULL) {
+        AUDIO_IO_PRINTF("ECHO BYPASS: %s\n", clip->path);
+        int echo_result =
+            hal_audio_play_echo(clip->samples, clip->num_samples);
+        frame_write(o_pipe, AUDIO, tag, &echo_result, sizeof(int));
+        continue;
+      }
+      buffer[0] = 'p';
+    }
+
+    /* ===== WARM BYPASS =====
+     * Words of a readout Software expects to ask for soon ('w'), e.g. the
+     * read-back of a frequency still being typed. Synthesized into the
+     * cache in the background (hal_tts_fragments_anticipate()); nothing
+     * plays, so it neither waits in nor clears the queue.
+     */
+    if (size > 1 && buffer[0] == 'w') {
+      buffer[size - 1] = '\0';
+      AUDIO_IO_PRINTF("WARM BYPASS: %s\n", (char *)&buffer[1]);
+      hal_tts_fragments_anticipate((char *)&buffer[1]);
+      int warm_result = 0;
+      frame_write(o_pipe, AUDIO, tag, &warm_result, sizeof(int));
       continue;
     }
 
-    /* ===== SPEED SETTING BYPASS =====
-     * Handle speed packets ('s') immediately without queueing.
-     * Format: "s1.0" where 1.0 is the speed value.
+    /* ===== TONE BYPASS =====
+     * Handle tuning tone packets ('t') immediately without queueing.
+     * Format: "t880" sets the pitch in Hz, "t0" turns the tone off. They
+     * come several times a second and must not wait behind speech.
      */
-    if (size > 1 && buffer[0] == 's') {
-      float speed = atof((char *)&buffer[1]);
-      AUDIO_IO_PRINTF("SPEED BYPASS: Setting speed to %.2f\n", speed);
+    if (size > 1 && buffer[0] == 't') {
+      int hz = atoi((char *)&buffer[1]);
+      AUDIO_IO_PRINTF("TONE BYPASS: Setting tone to %d Hz\n", hz);
 
-      int speed_result = hal_tts_set_speed(speed);
-      AUDIO_IO_PRINTF("SPEED BYPASS: Result %d\n", speed_result);
+      int tone_result = hal_audio_set_tone(hz);
 
       /* Send acknowledgment directly to output pipe */
-      Inst_packet *ack_packet = create_inst_packet(
-          AUDIO, sizeof(int), (unsigned char *)&speed_result, tag);
-      write(o_pipe, ack_packet, 8);
-      write(o_pipe, ack_packet->data, sizeof(int));
-      destroy_inst_packet(&ack_packet);
-
-      /* Release queue lock if we held it, then skip normal queue processing */
-      if (queue_empty) {
-        pthread_mutex_unlock(&audio_queue_available);
+      frame_write(o_pipe, AUDIO, tag, &tone_result, sizeof(int));
+
+      /* Skip normal queue processing */
+      continue;
+    }
+
+    /* ===== ONE-SHOT TONE BYPASS =====
+     * A synthesized tone ('o') mixed in at once like a beep, for cues
+     * such as error-tone variations. Format: "o697+1209/200" (see
+     * hal_tone_parse()).
+     */
+    if (size > 1 && buffer[0] == 'o') {
+      buffer[size - 1] = '\0';
+      HalTone tone;
+      int tone_result = hal_tone_parse((char *)&buffer[1], &tone) == 0
+                            ? hal_audio_play_tone(&tone)
+                            : -1;
+      AUDIO_IO_PRINTF("ONE-SHOT TONE BYPASS: %s returned %d\n",
+                      (char *)&buffer[1], tone_result);
+      frame_write(o_pipe, AUDIO, tag, &tone_result, sizeof(int));
+      continue;
+    }
+
+    /* ===== BEEP TONE BYPASS =====
+     * Set the tone a beep type plays ('c'), from hampod.conf. Format:
+     * "ck1000/50/50" for the keypress beep (h hold, e error); no tone
+     * restores the default.
+     */
+    if (size > 1 && buffer[0] == 'c') {
+      buffer[size - 1] = '\0';
+      const char *spec = size > 2 ? (char *)&buffer[2] : "";
+      int beep_result = -1;
+      BeepType beep_type = buffer[1] == 'h'   ? BEEP_HOLD
+                           : buffer[1] == 'e' ? BEEP_ERROR
+                                              : BEEP_KEYPRESS;
+      HalTone tone;
+      if (buffer[1] == 'k' || buffer[1] == 'h' || buffer[1] == 'e') {
+        if (spec[0] == '\0') {
+          beep_result = hal_audio_set_beep(beep_type, NULL);
+        } else if (hal_tone_parse(spec, &tone) == 0) {
+          beep_result = hal_audio_set_beep(beep_type, &tone);
+        }
+      }
+      AUDIO_IO_PRINTF("BEEP TONE BYPASS: %c '%s' returned %d\n", buffer[1],
+                      spec, beep_result);
+      frame_write(o_pipe, AUDIO, tag, &beep_result, sizeof(int));
+      continue;
+    }
+
+    /* ===== CW BYPASS =====
+     * Start ("k1") or stop ("k0") the CW decoder, or poll it ("k") for
+     * the text decoded since the last poll (AUDIO_CW_REPLY_INTS, then the
+     * text). Software polls a few times a second while it runs.
+     */
+    if (size > 1 && buffer[0] == 'k') {
+      if (buffer[1] == '1' || buffer[1] == '0') {
+        int cw_result = 0;
+        if (buffer[1] == '1') {
+          cw_result = hal_cw_start();
+        } else {
+          hal_cw_stop();
+        }
+        AUDIO_IO_PRINTF("CW BYPASS: %c returned %d\n", buffer[1], cw_result);
+        frame_write(o_pipe, AUDIO, tag, &cw_result, sizeof(int));
+        continue;
       }
+      char cw_reply[AUDIO_CW_REPLY_INTS * sizeof(int) + AUDIO_CW_TEXT_MAX];
+      int status[AUDIO_CW_REPLY_INTS] = {hal_cw_is_running() ? 0 : -1};
+      hal_cw_get_status(&status[1], &status[2]);
+      memcpy(cw_reply, status, sizeof(status));
+      size_t cw_len = hal_cw_take_text(cw_reply + sizeof(status),
+                                       AUDIO_CW_TEXT_MAX);
+      frame_write(o_pipe, AUDIO, tag, cw_reply, sizeof(status) + cw_len + 1);
       continue;
     }
 
-    Inst_packet *queued_packet = create_inst_packet(type, size, buffer, tag);
+    if (stream_dropped && tag != stream_tag) {
+      stream_dropped = 0; /* Its tail never came (dropped upstream) */
+    }
+    if (stream_dropped && tag == stream_tag) {
+      AUDIO_IO_PRINTF("Dropping fragment of interrupted request %d\n", tag);
+      stream_dropped = (header.flags & FRAME_FLAG_MORE) != 0;
+      continue;
+    }
+    if (header.flags & FRAME_FLAG_MORE) {
+      stream_tag = tag;
+      stream_open = 1;
+      stream_dropped = 0;
+    } else if (stream_open && tag == stream_tag) {
+      stream_open = 0;
+    }
 
     AUDIO_IO_PRINTF("Locking queue\n");
     pthread_mutex_lock(&audio_queue_lock);
+    audio_note_epoch(FRAME_EPOCH(header.flags));
 
     AUDIO_IO_PRINTF("Queueing packet\n");
-    enqueue(queue, queued_packet);
+    if (enqueue(queue, type, size, buffer, tag, header.flags | origin) != 0) {
+      /* Refused, not dropped: the rest of a long request goes too */
+      AUDIO_IO_PRINTF("Queue full (depth %d), refused tag %d\n",
+                      queue_depth(queue), tag);
+      hampod_metric_add(METRIC_AUDIO_BUSY, 1);
+      hampod_trace(TRACE_AUDIO_ACK, tag, (uint32_t)AUDIO_RESULT_BUSY, 0);
+      unsigned int now_us = frame_clock_us();
+      int busy[AUDIO_ACK_REPLY_INTS] = {AUDIO_RESULT_BUSY, (int)now_us, 0, 0,
+                                        (int)now_us};
+      frame_write(o_pipe, AUDIO, tag, busy, sizeof(busy));
+      if (header.flags & FRAME_FLAG_MORE) {
+        stream_dropped = 1;
+        stream_open = 0;
+      }
+    }
+    hampod_metric_set(METRIC_AUDIO_QUEUE_DEPTH, queue_depth(queue));
 
-    AUDIO_IO_PRINTF("Releasing queue & making it accessible\n");
+    AUDIO_IO_PRINTF("Releasing queue & waking main thread\n");
+    pthread_cond_signal(&audio_queue_ready);
     pthread_mutex_unlock(&audio_queue_lock);
-    if (queue_empty) {
-      pthread_mutex_unlock(&audio_queue_available);
-    }
-    usleep(100);
   }
-  return NULL;
 }
 
 void firmwareStartAudio() {
@@ -389,13 +1523,8 @@ int firmwarePlayAudio(void *text) {
   pthread_mutex_lock(&audio_lock);
   getcwd(default_directory, sizeof(default_directory));
   if (audio_type_byte == 'd') {
-    AUDIO_PRINTF("Festival tts without saving file");
-    chdir("/tmp");
-    sprintf(buffer, "echo '%s' | text2wave -o output.wav", remaining_string);
-    system_result = system(buffer);
-    // system_result = system("aplay output.wav");
-    system_result = hal_audio_play_file("output.wav");
-    chdir(default_directory);
+    AUDIO_PRINTF("TTS without saving file\n");
+    system_result = hal_tts_speak(remaining_string, NULL);
   } else if (audio_type_byte == 's') {
     AUDIO_PRINTF("Festival tts %s with saving file\n", remaining_string);
     chdir("../Firmware/pregen_audio");
@@ -435,8 +1564,8 @@ int firmwarePlayAudio(void *text) {
 int audio_play_beep(BeepType type) {
   AUDIO_PRINTF("audio_play_beep: Playing beep type %d\n", type);
 
-  /* Use new low-latency HAL function (plays from RAM cache) */
-  int result = hal_audio_play_beep(type);
+  /* Queued beeps keep their place among speech (plays from RAM cache) */
+  int result = hal_audio_queue_beep(type);
 
   if (result != 0) {
     AUDIO_PRINTF("audio_play_beep: Failed to play beep type %d\n", type);
@@ -12,7 +12,11 @@
 #include <unistd.h>
 
 #include "hampod_firm_packet.h"
+#include "hampod_frame.h"
+#include "hampod_log.h"
 #include "hampod_queue.h"
+#include "hampod_shm_ring.h"
+#include "hampod_transport.h"
 
 #define HASHING_PRIME 183373
 #define PRIME2 17
@@ -22,23 +26,98 @@
 #define AUDIO_O "../Firmware/Speaker_o"
 #define AUDIO_I "../Firmware/Speaker_i"
 
+/* Speak sequence ('m') requests */
+#define AUDIO_SEQ_SEPARATOR '\x1e' /* ASCII record separator */
+#define AUDIO_SEQ_GAP_MAX_MS 2000
+
+/* Spell ('s') requests: "<style><gap ms>:<text>", style 'l' for letter
+ * names or 'n' for NATO phonetics; bare text spells letters */
+#define AUDIO_SPELL_GAP_DEFAULT_MS 150
+
+/* CONFIG 0x03 <0-100>: output volume. The audio process applies it as a
+ * software gain in the playback thread (hal_audio_set_volume()) and
+ * answers with CONFIG_AUDIO_VOLUME and the volume now in effect. */
+#define CONFIG_AUDIO_VOLUME 0x03
+
+/* CONFIG 0x04 <10-200>: speech speed times 100 (hal_tts_set_speed()),
+ * taking effect from the next utterance. Answered with CONFIG_AUDIO_SPEED
+ * and the value, or 0 if the speed could not be set. */
+#define CONFIG_AUDIO_SPEED 0x04
+
+/* CONFIG 0x05 <0-255>: RAM budget of the TTS cache in MB
+ * (hal_tts_cache_set_ram_budget()); lowering it evicts at once. Answered
+ * with CONFIG_AUDIO_TTS_RAM and the value. */
+#define CONFIG_AUDIO_TTS_RAM 0x05
+
+/* CONFIG 0x06 <0-99>: SCHED_FIFO priority of the playback thread
+ * (hal_audio_set_rt_priority()), 0 for normal scheduling. Answered with
+ * CONFIG_AUDIO_PRIORITY and the value, or 0xFF if it was refused. */
+#define CONFIG_AUDIO_PRIORITY 0x06
+
+/* Ack of a speak/play request: the result, then when the audio process
+ * received it, started synthesizing it, had its first audio out (those two
+ * for TTS only) and finished it, as frame_clock_us() values (0 if it did
+ * not happen), so Software can tell where the time went */
+#define AUDIO_ACK_REPLY_INTS 5
+/* Result of a speak/play request there was no room to queue. It is
+ * answered at once rather than dropped, so Software slows down instead of
+ * waiting for an ack that never comes. */
+#define AUDIO_RESULT_BUSY (-2)
+/* Result of a sequence whose deadline ('x' segment) had passed when it
+ * came up: nothing was synthesized or played */
+#define AUDIO_RESULT_EXPIRED (-3)
+/* Other requests are acked once their audio is queued, while it still
+ * plays. A played request ('f') is acked, with result 0, only once the
+ * audio queued before it has been heard or cut off. */
+
+/* Info query ('q') reply: card number, underruns, ALSA buffer ms, lowest
+ * buffer fill ms and buffer resizes, as ints (see hal_audio_get_stats()) */
+#define AUDIO_INFO_REPLY_INTS 5
+
+/* TTS statistics query ('t') reply: 0, then cache RAM hits, disk hits,
+ * streamed hits, misses, entries, evictions, disk KB and RAM KB, then the
+ * time-to-first-audio histograms of hits and of misses
+ * (HAL_TTS_LATENCY_BUCKETS each), as ints (see hal_tts_get_stats()) */
+#define AUDIO_TTS_STATS_REPLY_INTS 25
+/* The same as text, rewritten at most once a second after a request, for
+ * `hampod tts-stats` */
+#define AUDIO_TTS_STATS_FILE "/dev/shm/hampod_tts_stats"
+
+/* CW decoder ('k', hal_cw.h): "k1" starts decoding the radio's receive
+ * audio and "k0" stops it, answered with 0 or -1. A bare "k" is a poll,
+ * answered with 0 if the decoder runs (-1 if not), its speed in wpm and
+ * its pitch in Hz as ints, then the text decoded since the last poll,
+ * NUL-terminated and at most AUDIO_CW_TEXT_MAX bytes with the NUL */
+#define AUDIO_CW_REPLY_INTS 3
+#define AUDIO_CW_TEXT_MAX 200
+
+/* Watchdog: while a request is being played (or the playback thread has
+ * audio), the audio must keep moving (hal_audio_progress()). After
+ * HAMPOD_WATCHDOG_MS without progress (0 turns the watchdog off) it
+ * interrupts the request, after twice that restarts the TTS engine and
+ * after three times reopens the PCM; progress starts over. A heartbeat
+ * ('a') is answered by the I/O thread at once, however stuck the request,
+ * with the steps taken in the current stall as an int (0 when healthy). */
+#define AUDIO_WATCHDOG_ENV "HAMPOD_WATCHDOG_MS"
+#define AUDIO_WATCHDOG_DEFAULT_MS 3000
+#define AUDIO_WATCHDOG_TICK_MS 100
+
 #define AUDIO_THREAD_COLOR "\033[0;34mAudio - Main: "
 #define AUDIO_IO_THREAD_COLOR "\033[0;32mAudio - IO: "
 
+/* Queued for the logger thread (hampod_log.h), never printed in place */
 #ifdef DEBUG
 #define AUDIO_PRINTF(...)                                                      \
   do {                                                                         \
     if (DEBUG) {                                                               \
-      printf(AUDIO_THREAD_COLOR);                                              \
-      printf(__VA_ARGS__);                                                     \
+      HAMPOD_LOG(1, AUDIO_THREAD_COLOR __VA_ARGS__);                           \
     }                                                                          \
   } while (0)
 
 #define AUDIO_IO_PRINTF(...)                                                   \
   do {                                                                         \
     if (DEBUG) {                                                               \
-      printf(AUDIO_IO_THREAD_COLOR);                                           \
-      printf(__VA_ARGS__);                                                     \
+      HAMPOD_LOG(1, AUDIO_IO_THREAD_COLOR __VA_ARGS__);                        \
     }                                                                          \
   } while (0)
 #else
@@ -65,17 +144,14 @@ typedef struct audio_io_packet {
 /**
  * @brief Play a beep sound directly (low-latency, no pipe IPC)
  *
- * This function plays a pre-generated beep audio file using the HAL.
- * It is thread-safe and can be called from any process/thread.
+ * This function plays a synthesized beep (hal_audio_synth.h) using the
+ * HAL, so no beep files are needed; its tone is set with a 'c' request.
+ * It is thread-safe and can be called from any process/thread. The beep
+ * is queued behind audio already playing, as a queued 'b' request or a
+ * sequence segment expects; the BEEP BYPASS mixes its beep in instead.
  *
  * @param type The type of beep to play
  * @return 0 on success, -1 on error
- *
- * @note Requires beep audio files to exist in pregen_audio/:
- *       - beep_keypress.wav
- *       - beep_hold.wav
- *       - beep_error.wav
- *       Generate these with: ./Firmware/pregen_audio/generate_beeps.sh
  */
 int audio_play_beep(BeepType type);
 
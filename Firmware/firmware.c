@@ -3,13 +3,31 @@
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 #include "audio_firmware.h"
+#include "hampod_alloc.h"
+#include "hampod_boot.h"
+#include "hampod_channel.h"
+#include "hampod_cpufreq.h"
+#include "hampod_log.h"
+#include "hampod_metrics.h"
 #include "hal/hal_keypad.h"
+#include "hal/hal_remote.h"
+#include "hal/hal_voice.h"
+#include "hampod_frame.h"
+#include "hampod_lanes.h"
 #include "hampod_queue.h"
+#include "hampod_sched.h"
+#include "hampod_session.h"
+#include "hampod_trace.h"
+#include "hampod_shm_ring.h"
+#include "hampod_transport.h"
 #include "keypad_firmware.h"
 
 #define INPUT_PIPE "Firmware_i"
@@ -26,16 +44,14 @@
 #define FIRMWARE_PRINTF(...)                                                   \
   do {                                                                         \
     if (DEBUG) {                                                               \
-      printf(FIRMWARE_THREAD_COLOR);                                           \
-      printf(__VA_ARGS__);                                                     \
+      HAMPOD_LOG(1, FIRMWARE_THREAD_COLOR __VA_ARGS__);                        \
     }                                                                          \
   } while (0)
 
 #define FIRMWARE_IO_PRINTF(...)                                                \
   do {                                                                         \
     if (DEBUG) {                                                               \
-      printf(FIRMWARE_IO_THREAD_COLOR);                                        \
-      printf(__VA_ARGS__);                                                     \
+      HAMPOD_LOG(1, FIRMWARE_IO_THREAD_COLOR __VA_ARGS__);                     \
     }                                                                          \
   } while (0)
 #else
@@ -47,41 +63,246 @@
 #endif
 
 typedef struct Buff_input {
-  int pipe_fd;
-  Packet_queue *queue;
+  Packet_queue **lanes; /* LANE_COUNT queues */
+  int session;          /* hampod_session.h index */
+  int rx_fd;            /* The session's link */
+  int socket;           /* The link is a socket, so the client may leave */
 } Buff_input;
 
 typedef struct Audio_thread_input {
-  int output_pipe_fd;
   int audio_output_fd;
 } Audio_thread_input;
 
+typedef struct Keypad_thread_input {
+  int keypad_output_fd;
+} Keypad_thread_input;
+
+/* Link to Software: FIFO pair, or a seqpacket socket with --socket that
+ * serves several clients at once, each a session (hampod_session.h) with
+ * a reader thread of its own. Replies go out through the session table. */
+int software_listen_fd = -1;
+Buff_input session_inputs[SESSION_MAX];
+
+/* Speak/play request ring shared with Software2 (--shm-audio). Created
+ * before the audio process is forked so it inherits the mapping. */
+Shm_audio_ring *audio_shm_ring = NULL;
+
+/* --direct: the keypad and audio processes also accept Software on their
+ * own sockets, so neither subsystem's traffic queues behind the other's
+ * here. The controller still owns startup, CONFIG and the main link. */
+int direct_channels = 0;
+
+/* Key-down beep channel, keypad process -> audio process. A datagram
+ * socketpair created before the forks so both inherit it; each one-byte
+ * datagram is a beep kind ('k'). Lets the keypad beep without a round trip
+ * through Software (CONFIG 0x02). */
+int local_beep_fds[2] = {-1, -1};
+
+/* The keypad process's request pipe (or channel). The main loop forwards
+ * queued KEYPAD packets to it; the session readers send LANE_DIRECT ones
+ * themselves. Each frame is one write, so the two never interleave. */
+int keypad_request_fd = -1;
+
+#ifdef HAMPOD_THREADED
+/* make THREADED=1: the keypad and audio subsystems run as threads of this
+ * process, and Keypad_i/o and Speaker_i/o are in-memory channels
+ * (hampod_channel.h) instead of FIFOs. {in, out}, as seen from here. */
+int keypad_channel_fds[2] = {-1, -1};
+int audio_channel_fds[2] = {-1, -1};
+#endif
+
+/* [scheduling] from hampod.conf, passed in by run_hampod.sh as --rt-audio,
+ * --rt-keypad, --io-cpus, --tts-cpus, --voice-cpus, --mlock,
+ * --memory-profile, --idle-mode, --cpu-boost and --cpu-idle-governor. All
+ * off by default. Its watchdog_ms comes as --watchdog-ms, for the audio
+ * process's watchdog. */
+Sched_profile sched_profile = {0, 0, "", "", "", 0, 0, 0, 0, ""};
+
 pthread_mutex_t queue_lock;
-pthread_mutex_t queue_available;
-pthread_mutex_t pipe_lock;
+pthread_cond_t queue_ready; /* Signalled (under queue_lock) on enqueue */
 char running = 1;
 
 pid_t controller_pid;
 
 void *io_buffer_thread(void *arg);
 
+void *session_accept_thread(void *arg);
+
 void *audio_waiter(void *arg);
 
+void *keypad_waiter(void *arg);
+
 void sigsegv_handler(int signum);
 
+#ifdef HAMPOD_THREADED
+static void *keypad_thread(void *arg) {
+  (void)arg;
+  hampod_metrics_name_thread("keypad");
+  keypad_process();
+  return NULL;
+}
+
+static void *audio_thread(void *arg) {
+  (void)arg;
+  hampod_metrics_name_thread("audio");
+  audio_process();
+  return NULL;
+}
+#endif
+
 void sigint_handler(int signum);
 
 void sigint_handler(int signum);
 
+/* Caller holds queue_lock */
+static int lanes_empty(Packet_queue **lanes) {
+  for (int lane = 0; lane < LANE_COUNT; lane++) {
+    if (!is_empty(lanes[lane])) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/* Serve a newly connected client: a session, its reader thread and 'R'.
+ * Returns 0, or -1 if it was turned away. */
+static int start_session(const Transport *link, Packet_queue **lanes) {
+  int index = session_open(link);
+  if (index == -1) {
+    HAMPOD_LOG(1, "Firmware: %d sessions open, client turned away\n",
+               SESSION_MAX);
+    Transport refused = *link;
+    transport_close(&refused);
+    return -1;
+  }
+  session_inputs[index].lanes = lanes;
+  session_inputs[index].session = index;
+  session_inputs[index].rx_fd = link->rx_fd;
+  session_inputs[index].socket = link->kind == TRANSPORT_SEQPACKET;
+
+  pthread_t reader;
+  if (pthread_create(&reader, NULL, io_buffer_thread,
+                     (void *)&session_inputs[index]) != 0) {
+    perror("Session thread failed");
+    session_close(index);
+    return -1;
+  }
+  pthread_detach(reader);
+
+  FIRMWARE_PRINTF("Session %d open (%d in all)\n", index, session_count());
+  unsigned char ok_signal = 'R';
+  session_send(index, session_generation(index), CONFIG, 0, &ok_signal,
+               sizeof(char));
+  return 0;
+}
+
+/* memory_profile = low: size the audio process's consumers for a 512 MB
+ * board. They are set as the defaults of the variables the HAL reads, so
+ * the children inherit them and an explicit setting still wins. */
+static void apply_low_memory_profile(void) {
+  char value[32];
+  snprintf(value, sizeof(value), "%d", MEMORY_LOW_PIPER_WORKERS);
+  setenv("HAMPOD_PIPER_WORKERS", value, 0);
+  snprintf(value, sizeof(value), "%llu",
+           (unsigned long long)MEMORY_LOW_TTS_RAM_MB * 1024 * 1024);
+  setenv("HAMPOD_TTS_CACHE_RAM", value, 0);
+  snprintf(value, sizeof(value), "%llu",
+           (unsigned long long)MEMORY_LOW_TTS_DISK_MB * 1024 * 1024);
+  setenv("HAMPOD_TTS_CACHE_MAX_SIZE", value, 0);
+  /* Pinning a model the size of a tenth of RAM would push the rest to
+   * swap; keeping it resident leaves the kernel room under pressure */
+  setenv("HAMPOD_TTS_MODEL", "keep", 0);
+  /* A standby Piper would hold a second copy of the model, as would
+   * every extra voice kept loaded */
+  setenv("HAMPOD_PIPER_SPARE", "0", 0);
+  setenv("HAMPOD_TTS_VOICE_PRELOAD", "0", 0);
+  printf("Memory profile low: %s Piper worker(s), TTS cache %s bytes in "
+         "RAM and %s on disk, model %s, spare Piper %s, preloaded voices "
+         "%s\n",
+         getenv("HAMPOD_PIPER_WORKERS"), getenv("HAMPOD_TTS_CACHE_RAM"),
+         getenv("HAMPOD_TTS_CACHE_MAX_SIZE"), getenv("HAMPOD_TTS_MODEL"),
+         getenv("HAMPOD_PIPER_SPARE"), getenv("HAMPOD_TTS_VOICE_PRELOAD"));
+}
+
 int main(int argc, char *argv[]) {
   setbuf(stdout, NULL);
+  hampod_log_start(); /* The children start their own after fork() */
+  boot_log_begin();
+  long long boot_started = boot_clock_ms();
+  hampod_alloc_dump_on_signal("firmware"); /* The children rename theirs */
+  hampod_trace_open("firmware"); /* and open their own rings */
+  hampod_metrics_open("firmware");
 
   /* Parse command-line arguments */
+  int use_socket = 0;
+  int use_shm_audio = 0;
+  char voices[1024] = ""; /* --voice name=model, for HAMPOD_TTS_VOICES */
   for (int i = 1; i < argc; i++) {
     if (strcmp(argv[i], "--phone-layout") == 0) {
       hal_keypad_set_phone_layout(1);
+    } else if (strcmp(argv[i], "--socket") == 0) {
+      use_socket = 1;
+    } else if (strcmp(argv[i], "--shm-audio") == 0) {
+      use_shm_audio = 1;
+    } else if (strcmp(argv[i], "--direct") == 0) {
+      direct_channels = 1;
+    } else if (strcmp(argv[i], "--rt-audio") == 0 && i + 1 < argc) {
+      sched_profile.audio_priority = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--rt-keypad") == 0 && i + 1 < argc) {
+      sched_profile.keypad_priority = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--io-cpus") == 0 && i + 1 < argc) {
+      snprintf(sched_profile.io_cpus, SCHED_CPUS_MAX, "%s", argv[++i]);
+    } else if (strcmp(argv[i], "--tts-cpus") == 0 && i + 1 < argc) {
+      snprintf(sched_profile.tts_cpus, SCHED_CPUS_MAX, "%s", argv[++i]);
+    } else if (strcmp(argv[i], "--voice-cpus") == 0 && i + 1 < argc) {
+      snprintf(sched_profile.voice_cpus, SCHED_CPUS_MAX, "%s", argv[++i]);
+    } else if (strcmp(argv[i], "--voice-model") == 0 && i + 1 < argc) {
+      setenv(HAL_VOICE_MODEL_ENV, argv[++i], 0); /* Read by the keypad */
+    } else if (strcmp(argv[i], "--voice-device") == 0 && i + 1 < argc) {
+      setenv(HAL_VOICE_DEVICE_ENV, argv[++i], 0);
+    } else if (strcmp(argv[i], "--remote") == 0 && i + 1 < argc) {
+      setenv(HAL_REMOTE_ENV, argv[++i], 0); /* Audio and keypad read it */
+    } else if (strcmp(argv[i], "--keypad-replay") == 0 && i + 1 < argc) {
+      setenv(HAL_KEYPAD_REPLAY_ENV, argv[++i], 0); /* Read by the keypad */
+    } else if (strcmp(argv[i], "--tmpfs-cache") == 0 && i + 1 < argc) {
+      setenv("HAMPOD_TTS_CACHE_TMPFS", argv[++i], 0); /* Read by the cache */
+    } else if (strcmp(argv[i], "--writeback-s") == 0 && i + 1 < argc) {
+      setenv("HAMPOD_TTS_CACHE_WRITEBACK", argv[++i], 0);
+    } else if (strcmp(argv[i], "--mlock") == 0) {
+      sched_profile.mlock = 1;
+    } else if (strcmp(argv[i], "--memory-profile") == 0 && i + 1 < argc) {
+      sched_profile.low_memory = strcmp(argv[++i], "low") == 0;
+    } else if (strcmp(argv[i], "--idle-mode") == 0) {
+      sched_profile.idle_mode = 1;
+    } else if (strcmp(argv[i], "--cpu-boost") == 0 && i + 1 < argc) {
+      sched_profile.cpu_boost_ms = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--cpu-idle-governor") == 0 && i + 1 < argc) {
+      snprintf(sched_profile.cpu_idle_governor,
+               sizeof(sched_profile.cpu_idle_governor), "%s", argv[++i]);
+    } else if (strcmp(argv[i], "--tts-accel") == 0 && i + 1 < argc) {
+      setenv("HAMPOD_TTS_ACCEL", argv[++i], 0); /* Read by Piper */
+    } else if (strcmp(argv[i], "--watchdog-ms") == 0 && i + 1 < argc) {
+      setenv(AUDIO_WATCHDOG_ENV, argv[++i], 0); /* Read by the audio side */
+    } else if (strcmp(argv[i], "--voice") == 0 && i + 1 < argc) {
+      size_t used = strlen(voices);
+      snprintf(voices + used, sizeof(voices) - used, "%s%s",
+               used > 0 ? "," : "", argv[++i]);
     }
   }
+  if (voices[0] != '\0') {
+    setenv("HAMPOD_TTS_VOICES", voices, 0); /* The audio process reads it */
+  }
+  if (sched_profile.low_memory) {
+    apply_low_memory_profile();
+  }
+
+  /* I/O threads and the keypad and audio processes stay off the Piper
+   * cores; the audio process widens its own mask for Piper below */
+  sched_pin_cpus(sched_profile.io_cpus, "Firmware I/O");
+
+  /* Before the forks: the keypad and audio processes ask for the boost */
+  cpufreq_boost_init(sched_profile.cpu_boost_ms,
+                     sched_profile.cpu_idle_governor);
 
 #ifdef DEBUG
   printf("\033[0;32mHampod Firmware Version 0.8\n");
@@ -111,56 +332,145 @@ int main(int argc, char *argv[]) {
     exit(1);
   }
 
-  FIRMWARE_PRINTF("Now creating Firmware_o pipe\n");
+  if (use_socket || direct_channels) {
+    /* A vanished client must not kill us mid-write; we re-accept instead.
+     * Set before forking so the subsystem processes inherit it. */
+    signal(SIGPIPE, SIG_IGN);
+  }
 
-  unlink(OUTPUT_PIPE); /* Remove stale pipe if exists */
-  if (mkfifo(OUTPUT_PIPE, 0666) == -1) {
-    perror("mkfifo");
-    exit(1);
+  /* Everything the children need is created first and both are forked
+   * before anything blocks, so the keypad and audio HAL init run side by
+   * side and alongside the wait for Software. Each child opens its pipes
+   * only once its HAL is up, so the blocking open() of a child's pipes
+   * returns exactly when that child is ready; 'R' goes out as soon as
+   * both have and Software is connected, with no fixed delays. */
+  long long phase_started = boot_clock_ms();
+  if (use_socket) {
+    /* Software may connect from here on; the connection waits in the
+     * backlog until both children are ready */
+    FIRMWARE_PRINTF("Listening on %s\n", TRANSPORT_SOCKET_NAME);
+    software_listen_fd = transport_listen_seqpacket(TRANSPORT_SOCKET_NAME);
+    if (software_listen_fd == -1) {
+      exit(1);
+    }
+  } else {
+    FIRMWARE_PRINTF("Creating Firmware_o and Firmware_i pipes\n");
+
+    unlink(OUTPUT_PIPE); /* Remove stale pipe if exists */
+    if (mkfifo(OUTPUT_PIPE, 0666) == -1) {
+      perror("mkfifo");
+      exit(1);
+    }
+    unlink(INPUT_PIPE); /* Remove stale pipe if exists */
+    if (mkfifo(INPUT_PIPE, 0666) == -1) {
+      perror("mkfifo");
+      exit(1);
+    }
   }
-  int output_pipe_fd = open(OUTPUT_PIPE, O_WRONLY);
-  if (output_pipe_fd == -1) {
-    perror("open");
-    exit(1);
+  if (socketpair(AF_UNIX, SOCK_DGRAM, 0, local_beep_fds) == -1) {
+    perror("socketpair");
+    local_beep_fds[0] = local_beep_fds[1] = -1;
   }
 
-  FIRMWARE_PRINTF("Firmware_o created, now creating Firmware_i\n");
+#ifdef HAMPOD_THREADED
+  FIRMWARE_PRINTF("Creating keypad and audio channels\n");
 
-  unlink(INPUT_PIPE); /* Remove stale pipe if exists */
-  if (mkfifo(INPUT_PIPE, 0666) == -1) {
+  channel_install();
+  keypad_channel_fds[0] = channel_create();
+  keypad_channel_fds[1] = channel_create();
+  audio_channel_fds[0] = channel_create();
+  audio_channel_fds[1] = channel_create();
+#else
+  FIRMWARE_PRINTF("Creating Keypad_i and Keypad_o pipes\n");
+
+  unlink(KEYPAD_IN); /* Remove stale pipe if exists */
+  if (mkfifo(KEYPAD_IN, 0666) == -1) {
     perror("mkfifo");
     exit(1);
   }
-  int input_pipe_fd = open(INPUT_PIPE, O_RDONLY);
-  if (input_pipe_fd == -1) {
-    perror("open");
+  unlink(KEYPAD_OUT); /* Remove stale pipe if exists */
+  if (mkfifo(KEYPAD_OUT, 0666) == -1) {
+    perror("mkfifo");
     exit(1);
   }
 
-  FIRMWARE_PRINTF("Firmware_i created\n");
-  FIRMWARE_PRINTF("Creating Keypad_i pipe\n");
+  FIRMWARE_PRINTF("Creating Audio_i and Audio_o pipes\n");
 
-  unlink(KEYPAD_IN); /* Remove stale pipe if exists */
-  if (mkfifo(KEYPAD_IN, 0666) == -1) {
+  unlink(AUDIO_IN); /* Remove stale pipe if exists */
+  if (mkfifo(AUDIO_IN, 0666) == -1) {
     perror("mkfifo");
     exit(1);
   }
+  unlink(AUDIO_OUT); /* Remove stale pipe if exists */
+  if (mkfifo(AUDIO_OUT, 0666) == -1) {
+    perror("mkfifo");
+    exit(1);
+  }
+#endif
 
-  FIRMWARE_PRINTF("Keypad_i created\n");
-  FIRMWARE_PRINTF("Creating Keypad_o pipe\n");
+  if (use_shm_audio) {
+    audio_shm_ring = shm_ring_create(SHM_RING_NAME);
+    if (audio_shm_ring == NULL) {
+      perror("shm_ring_create");
+      printf("Audio requests will use Speaker_i only\n");
+    } else {
+      FIRMWARE_PRINTF("Audio request ring %s created\n", SHM_RING_NAME);
+    }
+  }
 
-  unlink(KEYPAD_OUT); /* Remove stale pipe if exists */
-  if (mkfifo(KEYPAD_OUT, 0666) == -1) {
-    perror("mkfifo");
+  boot_log_phase("firmware", "fifos", phase_started);
+
+  phase_started = boot_clock_ms();
+#ifdef HAMPOD_THREADED
+  /* Same order and the same readiness signal as the forks below */
+  pthread_t keypad_subsystem;
+  if (pthread_create(&keypad_subsystem, NULL, keypad_thread, NULL) != 0) {
+    perror("Keypad thread failed");
     exit(1);
   }
+  pthread_detach(keypad_subsystem);
+  boot_log_phase("firmware", "thread-keypad", phase_started);
 
+  phase_started = boot_clock_ms();
+  pthread_t audio_subsystem;
+  if (pthread_create(&audio_subsystem, NULL, audio_thread, NULL) != 0) {
+    perror("Audio thread failed");
+    exit(1);
+  }
+  pthread_detach(audio_subsystem);
+  boot_log_phase("firmware", "thread-audio", phase_started);
+#else
   pid_t keypad_pid = fork();
 
   if (keypad_pid == 0) {
+    if (software_listen_fd != -1) {
+      close(software_listen_fd);
+    }
     keypad_process();
   }
+  boot_log_phase("firmware", "fork-keypad", phase_started);
+
+  phase_started = boot_clock_ms();
+  pid_t audio_pid = fork();
+
+  if (audio_pid == 0) {
+    if (software_listen_fd != -1) {
+      close(software_listen_fd);
+    }
+    audio_process();
+  }
+  boot_log_phase("firmware", "fork-audio", phase_started);
+#endif
+
+  FIRMWARE_PRINTF("Waiting for the keypad process\n");
+  long long forked = boot_clock_ms();
 
+#ifdef HAMPOD_THREADED
+  int keypad_in_pipe_fd = keypad_channel_fds[0];
+  int keypad_out_pipe_fd = keypad_channel_fds[1];
+  channel_wait_connected(keypad_in_pipe_fd);
+  channel_wait_connected(keypad_out_pipe_fd);
+#else
   int keypad_in_pipe_fd = open(KEYPAD_IN, O_WRONLY);
   if (keypad_in_pipe_fd == -1) {
     perror("open");
@@ -172,31 +482,18 @@ int main(int argc, char *argv[]) {
     perror("open");
     exit(1);
   }
+#endif
+  keypad_request_fd = keypad_in_pipe_fd;
 
-  FIRMWARE_PRINTF("Keypad_o created\n");
-  FIRMWARE_PRINTF("Creating Audio_i pipe\n");
-
-  unlink(AUDIO_IN); /* Remove stale pipe if exists */
-  if (mkfifo(AUDIO_IN, 0666) == -1) {
-    perror("mkfifo");
-    exit(1);
-  }
-
-  FIRMWARE_PRINTF("Audio_i created\n");
-  FIRMWARE_PRINTF("Creating Audio_o pipe\n");
-
-  unlink(AUDIO_OUT); /* Remove stale pipe if exists */
-  if (mkfifo(AUDIO_OUT, 0666) == -1) {
-    perror("mkfifo");
-    exit(1);
-  }
-
-  pid_t audio_pid = fork();
-
-  if (audio_pid == 0) {
-    audio_process();
-  }
+  boot_log_phase("firmware", "keypad-ready", forked);
+  FIRMWARE_PRINTF("Keypad ready, waiting for the audio process\n");
 
+#ifdef HAMPOD_THREADED
+  int audio_in_pipe_fd = audio_channel_fds[0];
+  int audio_out_pipe_fd = audio_channel_fds[1];
+  channel_wait_connected(audio_in_pipe_fd);
+  channel_wait_connected(audio_out_pipe_fd);
+#else
   int audio_in_pipe_fd = open(AUDIO_IN, O_WRONLY);
   if (audio_in_pipe_fd == -1) {
     perror("open");
@@ -209,52 +506,68 @@ int main(int argc, char *argv[]) {
     exit(1);
   }
 
-  FIRMWARE_PRINTF("Audio_o created\n");
+  /* Only the two children use the beep channel */
+  if (local_beep_fds[0] != -1) {
+    close(local_beep_fds[0]);
+    close(local_beep_fds[1]);
+  }
+#endif
+
+  boot_log_phase("firmware", "audio-ready", forked);
+  FIRMWARE_PRINTF("Audio ready, waiting for Software\n");
+  phase_started = boot_clock_ms();
+
+  Transport software_link = {TRANSPORT_FIFO, -1, -1};
+  if (use_socket) {
+    if (transport_accept(software_listen_fd, &software_link) != 0) {
+      exit(1);
+    }
+  } else {
+    int output_pipe_fd = open(OUTPUT_PIPE, O_WRONLY);
+    if (output_pipe_fd == -1) {
+      perror("open");
+      exit(1);
+    }
+    int input_pipe_fd = open(INPUT_PIPE, O_RDONLY);
+    if (input_pipe_fd == -1) {
+      perror("open");
+      exit(1);
+    }
+    software_link.kind = TRANSPORT_FIFO;
+    software_link.rx_fd = input_pipe_fd;
+    software_link.tx_fd = output_pipe_fd;
+  }
+  boot_log_phase("firmware", "software-connect", phase_started);
+  FIRMWARE_PRINTF("Software connected\n");
   FIRMWARE_PRINTF("Creating instruction queue\n");
 
-  Packet_queue *instruction_queue = create_packet_queue();
+  Packet_queue *instruction_lanes[LANE_COUNT];
+  for (int lane = 0; lane < LANE_COUNT; lane++) {
+    instruction_lanes[lane] = create_packet_queue();
+  }
 
   FIRMWARE_PRINTF("Instruction queue created\n");
   FIRMWARE_PRINTF("Creating queue mutex lock\n");
   FIRMWARE_PRINTF("Creating I\\O buffer thread\n");
 
-  pthread_t io_buffer;
-  Buff_input thread_input;
-  thread_input.pipe_fd = input_pipe_fd;
-  thread_input.queue = instruction_queue;
-
   Audio_thread_input audio_pipes;
-  audio_pipes.output_pipe_fd = output_pipe_fd;
   audio_pipes.audio_output_fd = audio_out_pipe_fd;
 
-  if (pthread_mutex_init(&queue_lock, NULL) != 0) {
-    perror("pthread_mutex_init");
-    exit(1);
-  }
+  Keypad_thread_input keypad_pipes;
+  keypad_pipes.keypad_output_fd = keypad_out_pipe_fd;
 
-  if (pthread_mutex_init(&queue_available, NULL) != 0) {
+  if (pthread_mutex_init(&queue_lock, NULL) != 0) {
     perror("pthread_mutex_init");
     exit(1);
   }
 
-  if (pthread_mutex_init(&pipe_lock, NULL) != 0) {
-    perror("pthread_mutex_init");
+  if (pthread_cond_init(&queue_ready, NULL) != 0) {
+    perror("pthread_cond_init");
     exit(1);
   }
 
   FIRMWARE_PRINTF("Queue lock initialized\n");
 
-  if (pthread_create(&io_buffer, NULL, io_buffer_thread,
-                     (void *)&thread_input) != 0) {
-    perror("Buffer thread failed");
-    exit(1);
-  }
-
-  FIRMWARE_PRINTF("1 second delay so thread can lock the queue\n");
-
-  usleep(1000000);
-
-  FIRMWARE_PRINTF("1 second delay over\n");
   FIRMWARE_PRINTF("Starting audio response waiter thread\n");
   pthread_t audio_waiter_thread;
   if (pthread_create(&audio_waiter_thread, NULL, audio_waiter,
@@ -263,18 +576,45 @@ int main(int argc, char *argv[]) {
     exit(1);
   }
 
+  /* Keypad replies and pushed key events both arrive on Keypad_o */
+  FIRMWARE_PRINTF("Starting keypad response waiter thread\n");
+  pthread_t keypad_waiter_thread;
+  if (pthread_create(&keypad_waiter_thread, NULL, keypad_waiter,
+                     (void *)&keypad_pipes) != 0) {
+    perror("Keypad waiter thread failed");
+    exit(1);
+  }
+
   FIRMWARE_PRINTF("Sending ok packet to software\n");
-  unsigned char ok_signal = 'R';
-  Inst_packet *ready_packet = create_inst_packet(CONFIG, 1, &ok_signal, 0);
-  write(output_pipe_fd, ready_packet, 8);
-  write(output_pipe_fd, ready_packet->data, sizeof(char));
+  if (start_session(&software_link, instruction_lanes) != 0) {
+    exit(1);
+  }
+  boot_log_phase("firmware", "ready-sent", boot_started);
+
+  /* Later clients are served alongside the first */
+  if (use_socket) {
+    pthread_t accept_thread;
+    if (pthread_create(&accept_thread, NULL, session_accept_thread,
+                       (void *)instruction_lanes) != 0) {
+      perror("Session accept thread failed");
+      exit(1);
+    }
+    pthread_detach(accept_thread);
+  }
+
   while (running) {
-    pthread_mutex_lock(&queue_available);
+    /* Sleep until the IO thread queues something */
     pthread_mutex_lock(&queue_lock);
-
-    Inst_packet *received_packet = dequeue(instruction_queue);
+    while (running && lanes_empty(instruction_lanes)) {
+      pthread_cond_wait(&queue_ready, &queue_lock);
+    }
+    Packet_queue *lane_queue = NULL;
+    Inst_packet *received_packet = NULL;
+    for (int lane = 0; lane < LANE_COUNT && received_packet == NULL; lane++) {
+      lane_queue = instruction_lanes[lane];
+      received_packet = dequeue(lane_queue);
+    }
     pthread_mutex_unlock(&queue_lock);
-    pthread_mutex_unlock(&queue_available);
     if (received_packet != NULL) {
       FIRMWARE_PRINTF("Queue is open\n");
       FIRMWARE_PRINTF("Packet is %p\n", received_packet);
@@ -288,32 +628,35 @@ int main(int argc, char *argv[]) {
 
     Packet_type type = received_packet->type;
     // unsigned short data_size = received_packet->data_len;
-    if (type == KEYPAD && received_packet->data[0] == 'r') {
-      FIRMWARE_PRINTF("Got a READ keypad packet\n");
-      write(keypad_in_pipe_fd, received_packet, 8);
-      write(keypad_in_pipe_fd, received_packet->data, 1);
-      FIRMWARE_PRINTF("Packet sent, now waiting for a response\n");
-      Packet_type keypad_back;
-      unsigned short keypad_back_size;
-      unsigned short keypad_back_tag;
-      char read_key;
-      read(keypad_out_pipe_fd, &keypad_back, sizeof(Packet_type));
-      read(keypad_out_pipe_fd, &keypad_back_size, sizeof(unsigned short));
-      read(keypad_out_pipe_fd, &keypad_back_tag, sizeof(unsigned short));
-      read(keypad_out_pipe_fd, &read_key, sizeof(char));
-      FIRMWARE_PRINTF("Keypad sent back %x\n", read_key);
-      pthread_mutex_lock(&pipe_lock);
-      write(output_pipe_fd, &type, sizeof(Packet_type));
-      unsigned short return_size = 1;
-      write(output_pipe_fd, &return_size, sizeof(unsigned short));
-      write(output_pipe_fd, &keypad_back_tag, sizeof(unsigned short));
-      write(output_pipe_fd, &read_key, sizeof(char));
-      pthread_mutex_unlock(&pipe_lock);
+    if (type == KEYPAD) {
+      /* 'r' reads and 's' subscriptions; keypad_waiter relays the reply */
+      FIRMWARE_PRINTF("Got a keypad packet '%c'\n", received_packet->data[0]);
+      frame_write(keypad_in_pipe_fd, received_packet->type,
+                  received_packet->tag, received_packet->data,
+                  received_packet->data_len);
     }
     if (type == AUDIO) {
       FIRMWARE_PRINTF("Got a audio packet\n");
-      write(audio_in_pipe_fd, received_packet, 8);
-      write(audio_in_pipe_fd, received_packet->data, received_packet->data_len);
+      int speech = lane_queue == instruction_lanes[LANE_BULK] ||
+                   lane_queue == instruction_lanes[LANE_BACKGROUND];
+      int owner = speech ? session_tag_owner(received_packet->tag) : -1;
+      if (owner >= 0 && session_should_preempt(owner)) {
+        /* Higher-priority speech cuts off a lower-priority session's */
+        FIRMWARE_PRINTF("Session %d preempts lower-priority speech\n", owner);
+        unsigned char interrupt = 'i';
+        frame_write(audio_in_pipe_fd, AUDIO, session_internal_tag(),
+                    &interrupt, 1);
+        session_clear_speech();
+      }
+      frame_write_flags(audio_in_pipe_fd, received_packet->type,
+                        received_packet->flags, received_packet->tag,
+                        received_packet->data, received_packet->data_len);
+      if (owner >= 0) {
+        session_note_speech(received_packet->tag);
+      } else if (lane_queue == instruction_lanes[LANE_INTERRUPT] &&
+                 FRAME_EPOCH(received_packet->flags) == 0) {
+        session_clear_speech(); /* The audio process dropped all of it */
+      }
       FIRMWARE_PRINTF("Packet sent to audio process\n");
     }
     if (type == CONFIG) {
@@ -324,18 +667,40 @@ int main(int argc, char *argv[]) {
         if (sub_cmd == 0x01) {
           FIRMWARE_PRINTF(
               "CONFIG: Pushing phone layout config to keypad process\n");
-          write(keypad_in_pipe_fd, received_packet, 8);
-          write(keypad_in_pipe_fd, received_packet->data,
-                received_packet->data_len);
+          frame_write(keypad_in_pipe_fd, received_packet->type,
+                      received_packet->tag, received_packet->data,
+                      received_packet->data_len);
+        } else if (sub_cmd == CONFIG_LOCAL_KEY_BEEP) {
+          FIRMWARE_PRINTF(
+              "CONFIG: Pushing local key beep config to keypad process\n");
+          frame_write(keypad_in_pipe_fd, received_packet->type,
+                      received_packet->tag, received_packet->data,
+                      received_packet->data_len);
+        } else if (sub_cmd == CONFIG_AUDIO_VOLUME ||
+                   sub_cmd == CONFIG_AUDIO_SPEED ||
+                   sub_cmd == CONFIG_AUDIO_TTS_RAM ||
+                   sub_cmd == CONFIG_AUDIO_PRIORITY) {
+          FIRMWARE_PRINTF("CONFIG: Pushing 0x%02X to audio process\n",
+                          sub_cmd);
+          frame_write(audio_in_pipe_fd, received_packet->type,
+                      received_packet->tag, received_packet->data,
+                      received_packet->data_len);
         }
       }
     }
-    destroy_inst_packet(&received_packet);
+    pthread_mutex_lock(&queue_lock);
+    release_packet(lane_queue, &received_packet);
+    pthread_mutex_unlock(&queue_lock);
+  }
+  for (int lane = 0; lane < LANE_COUNT; lane++) {
+    destroy_queue(instruction_lanes[lane]);
+  }
+  for (int index = 0; index < SESSION_MAX; index++) {
+    session_close(index);
+  }
+  if (audio_shm_ring != NULL) {
+    shm_ring_destroy(audio_shm_ring, SHM_RING_NAME);
   }
-  pthread_join(io_buffer, NULL);
-  destroy_queue(instruction_queue);
-  close(output_pipe_fd);
-  close(input_pipe_fd);
   return 0;
 }
 
@@ -344,112 +709,224 @@ int main(int argc, char *argv[]) {
 void *io_buffer_thread(void *arg) {
 
   FIRMWARE_IO_PRINTF("I\\O thread created\n");
+  hampod_metrics_name_thread("firmware-io");
 
   Buff_input *function_input = (Buff_input *)arg;
-  int i_pipe = function_input->pipe_fd;
-  Packet_queue *queue = function_input->queue;
-  unsigned char buffer[256];
-
-  FIRMWARE_IO_PRINTF("Input pipe = %d, queue_ptr = %p\n", i_pipe, queue);
+  int session = function_input->session;
+  int i_pipe = function_input->rx_fd;
+  int is_socket = function_input->socket;
+  Packet_queue **lanes = function_input->lanes;
+  unsigned int generation = session_generation(session);
+  unsigned char buffer[FRAME_MAX_DATA];
+  Frame_reader reader;
+  frame_reader_init(&reader, i_pipe);
+
+  FIRMWARE_IO_PRINTF("Session %d: input pipe = %d, lanes = %p\n", session,
+                     i_pipe, (void *)lanes);
 
   while (running) {
 
-    FIRMWARE_IO_PRINTF("Locking the queue\n");
-
-    pthread_mutex_lock(&queue_lock);
-    int queue_empty = is_empty(queue);
-    pthread_mutex_unlock(&queue_lock);
-
-    if (queue_empty) {
-      pthread_mutex_lock(&queue_available);
-    }
-
     FIRMWARE_IO_PRINTF("Waiting for input...\n");
 
-    Packet_type packet_type;
-    unsigned short size;
-    unsigned short tag;
-    ssize_t bytes_read;
-
-    /* Read packet header with error checking */
-    bytes_read = read(i_pipe, &packet_type, sizeof(Packet_type));
-    if (bytes_read <= 0) {
-      FIRMWARE_IO_PRINTF("Pipe closed or read error (type), exiting thread\n");
-      break;
-    }
-
-    bytes_read = read(i_pipe, &size, 2);
-    if (bytes_read <= 0) {
-      FIRMWARE_IO_PRINTF("Pipe closed or read error (size), exiting thread\n");
-      break;
-    }
-
-    bytes_read = read(i_pipe, &tag, sizeof(unsigned short));
-    if (bytes_read <= 0) {
-      FIRMWARE_IO_PRINTF("Pipe closed or read error (tag), exiting thread\n");
-      break;
+    Frame_header header;
+    int read_result = frame_read(&reader, &header, buffer, sizeof(buffer));
+    if (read_result == FRAME_DROPPED) {
+      HAMPOD_LOG(1, "Firmware: session %d sent a corrupt frame, dropped\n",
+                 session);
+      continue;
     }
-
-    bytes_read = read(i_pipe, buffer, size);
-    if (bytes_read <= 0) {
-      FIRMWARE_IO_PRINTF("Pipe closed or read error (data), exiting thread\n");
+    if (read_result != 0) {
+      if (is_socket) {
+        /* Client went away; the accept thread serves the next one */
+        FIRMWARE_IO_PRINTF("Session %d disconnected\n", session);
+        if (session_close(session)) {
+          /* Key events go back to the keypad's ring */
+          unsigned char unsubscribe[2] = {KEYPAD_SUBSCRIBE, 0};
+          pthread_mutex_lock(&queue_lock);
+          enqueue(lanes[LANE_KEYPAD], KEYPAD, sizeof(unsubscribe),
+                  unsubscribe, session_internal_tag(), 0);
+          pthread_cond_signal(&queue_ready);
+          pthread_mutex_unlock(&queue_lock);
+        }
+        return NULL;
+      }
+      FIRMWARE_IO_PRINTF("Pipe closed or read error, exiting thread\n");
       break;
     }
+    Packet_type packet_type = (Packet_type)header.type;
+    unsigned short size = header.data_len;
+    unsigned short flags = header.flags;
+    Session_priority priority = session_priority(session);
 
     FIRMWARE_IO_PRINTF("Found packet with type %d, size %d\n", packet_type,
                        size);
     FIRMWARE_IO_PRINTF("Buffer holds:%s: with size %lu\n", buffer,
                        sizeof(buffer));
 
-    Inst_packet *new_packet =
-        create_inst_packet(packet_type, size, buffer, tag);
+    /* Answered here: the session's own priority, an unsubscribe from a
+     * session another has taken the keypad from, and an interrupt that
+     * would cut off higher-priority speech */
+    if (packet_type == CONFIG && size >= 2 &&
+        buffer[0] == CONFIG_SESSION_PRIORITY) {
+      unsigned char ack[2] = {
+          CONFIG_SESSION_PRIORITY,
+          (unsigned char)session_set_priority(session, buffer[1])};
+      session_send(session, generation, CONFIG, header.tag, ack, 2);
+      continue;
+    }
+    if (packet_type == KEYPAD && size > 0 && buffer[0] == KEYPAD_SUBSCRIBE &&
+        !session_subscribe(session, size > 1 ? buffer[1] != 0 : 1)) {
+      unsigned char ack = KEYPAD_SUBSCRIBE_ACK;
+      session_send(session, generation, KEYPAD, header.tag, &ack, 1);
+      continue;
+    }
+    if (packet_type == AUDIO && size > 0 && buffer[0] == 'i' &&
+        session_outranked(session)) {
+      FIRMWARE_IO_PRINTF("Session %d may not interrupt\n", session);
+      int refused = -1;
+      session_send(session, generation, AUDIO, header.tag, &refused,
+                   sizeof(refused));
+      continue;
+    }
 
-    FIRMWARE_IO_PRINTF("Queueing the new packet\n");
-    pthread_mutex_lock(&queue_lock);
-    enqueue(queue, new_packet);
+    Instruction_lane lane = classify_packet(packet_type, buffer, size);
+    if (lane == LANE_DIRECT) {
+      frame_write(keypad_request_fd, packet_type, header.tag, buffer, size);
+      continue;
+    }
+
+    /* Only the main session's speech epochs mean anything to the audio
+     * process; the others' requests play whatever epoch it is at */
+    Instruction_lane speech_lane = LANE_BULK;
+    if (priority != SESSION_PRIORITY_MAIN) {
+      flags &= ~FRAME_EPOCH_MASK;
+      speech_lane = LANE_BACKGROUND;
+      if (lane == LANE_BULK) {
+        lane = LANE_BACKGROUND;
+      }
+    }
+    unsigned short tag = session_map_tag(session, header.tag,
+                                         (flags & FRAME_FLAG_MORE) != 0);
 
-    FIRMWARE_IO_PRINTF("Releasing queue\n");
+    FIRMWARE_IO_PRINTF("Queueing the new packet in lane %d\n", lane);
+    pthread_mutex_lock(&queue_lock);
+    if (lane == LANE_INTERRUPT) {
+      /* The interrupt overtakes queued speech, so drop that speech here
+       * like the audio process drops its own queue */
+      clear_queue(lanes[speech_lane]);
+    }
+    int refused = enqueue(lanes[lane], packet_type, size, buffer, tag,
+                          flags) != 0;
+    if (refused) {
+      HAMPOD_LOG(1,
+                 "Firmware: instruction lane %d full (depth %d), refused "
+                 "packet tag %u\n",
+                 lane, queue_depth(lanes[lane]), tag);
+    }
 
+    FIRMWARE_IO_PRINTF("Waking main thread\n");
+    pthread_cond_signal(&queue_ready);
     pthread_mutex_unlock(&queue_lock);
-    if (queue_empty) {
-      FIRMWARE_IO_PRINTF("Queue was not empty\n");
-      pthread_mutex_unlock(&queue_available);
+
+    /* Audio requests are answered busy rather than left without an ack
+     * (an earlier fragment of a long one only cuts its speech short) */
+    unsigned short client_tag;
+    unsigned int route_generation;
+    if (refused && packet_type == AUDIO && !(flags & FRAME_FLAG_MORE) &&
+        session_route(tag, &client_tag, &route_generation) == session) {
+      hampod_metric_add(METRIC_AUDIO_BUSY, 1);
+      int busy[AUDIO_ACK_REPLY_INTS] = {AUDIO_RESULT_BUSY};
+      session_send(session, route_generation, AUDIO, client_tag, busy,
+                   sizeof(busy));
     }
-    usleep(100);
+  }
+  return NULL;
+}
+
+/* Accepts the clients after the first (--socket), each a new session */
+void *session_accept_thread(void *arg) {
+  hampod_metrics_name_thread("firmware-accept");
+  Packet_queue **lanes = (Packet_queue **)arg;
+  while (running) {
+    Transport link;
+    if (transport_accept(software_listen_fd, &link) != 0) {
+      sleep(1); /* Out of descriptors, say; try again */
+      continue;
+    }
+    start_session(&link, lanes);
   }
   return NULL;
 }
 
 void *audio_waiter(void *arg) {
   FIRMWARE_PRINTF("Audio waiter thread started\n");
+  hampod_metrics_name_thread("audio-waiter");
   Audio_thread_input *input = (Audio_thread_input *)arg;
-  int output_pipe_fd = input->output_pipe_fd;
-  int audio_out_pipe_fd = input->audio_output_fd;
+  Frame_reader reader;
+  frame_reader_init(&reader, input->audio_output_fd);
 
   while (running) {
-    Packet_type audio_back;
-    unsigned short audio_back_size;
-    int return_code;
-    unsigned short audio_back_tag;
-
-    if (read(audio_out_pipe_fd, &audio_back, sizeof(Packet_type)) <= 0)
-      break;
-    if (read(audio_out_pipe_fd, &audio_back_size, sizeof(unsigned short)) <= 0)
-      break;
-    if (read(audio_out_pipe_fd, &audio_back_tag, sizeof(unsigned short)) <= 0)
-      break;
-    if (read(audio_out_pipe_fd, &return_code, sizeof(int)) <= 0)
+    Frame_header audio_back;
+    /* Acks are an int; the info query reply carries statistics after it */
+    int reply[FRAME_MAX_DATA / sizeof(int)];
+
+    int read_result = frame_read(&reader, &audio_back, reply, sizeof(reply));
+    if (read_result == FRAME_DROPPED) {
+      HAMPOD_LOG(1, "Firmware: audio reply of %u bytes dropped\n",
+                 audio_back.data_len);
+      continue;
+    }
+    if (read_result != 0)
       break;
 
-    FIRMWARE_PRINTF("audio sent back %x for tag %d\n", return_code,
-                    audio_back_tag);
+    FIRMWARE_PRINTF("audio sent back %x for tag %d\n", reply[0],
+                    audio_back.tag);
+
+    /* Back to the session that asked, under its own tag. Single-frame
+     * writes are atomic, so this cannot interleave with keypad replies. */
+    unsigned short client_tag;
+    unsigned int generation;
+    int session = session_route(audio_back.tag, &client_tag, &generation);
+    if (session >= 0) {
+      session_send(session, generation, audio_back.type, client_tag, reply,
+                   audio_back.data_len);
+    }
+  }
+  return NULL;
+}
+
+void *keypad_waiter(void *arg) {
+  FIRMWARE_PRINTF("Keypad waiter thread started\n");
+  hampod_metrics_name_thread("keypad-waiter");
+  Keypad_thread_input *input = (Keypad_thread_input *)arg;
+  Frame_reader reader;
+  frame_reader_init(&reader, input->keypad_output_fd);
+
+  while (running) {
+    Frame_header keypad_back;
+    unsigned char data[FRAME_MAX_DATA];
+
+    int read_result = frame_read(&reader, &keypad_back, data, sizeof(data));
+    if (read_result == FRAME_DROPPED) {
+      HAMPOD_LOG(1, "Firmware: keypad reply of %u bytes dropped\n",
+                 keypad_back.data_len);
+      continue;
+    }
+    if (read_result != 0)
+      break;
 
-    pthread_mutex_lock(&pipe_lock);
-    write(output_pipe_fd, &audio_back, sizeof(Packet_type));
-    write(output_pipe_fd, &audio_back_size, sizeof(unsigned short));
-    write(output_pipe_fd, &audio_back_tag, sizeof(unsigned short));
-    write(output_pipe_fd, &return_code, sizeof(int));
-    pthread_mutex_unlock(&pipe_lock);
+    FIRMWARE_PRINTF("Keypad sent back %x for tag %d\n", data[0],
+                    keypad_back.tag);
+    unsigned short client_tag = keypad_back.tag;
+    unsigned int generation;
+    int session = keypad_back.tag == KEYPAD_PUSH_TAG
+                      ? session_route_push(&generation)
+                      : session_route(keypad_back.tag, &client_tag,
+                                      &generation);
+    if (session >= 0) {
+      session_send(session, generation, keypad_back.type, client_tag, data,
+                   keypad_back.data_len);
+    }
   }
   return NULL;
 }
@@ -459,6 +936,9 @@ void *audio_waiter(void *arg) {
 void sigint_handler(int signum) {
   printf("\033[0;31mTERMINATING FIRMWARE\n");
   running = 0;
+  if (getpid() == controller_pid && audio_shm_ring != NULL) {
+    shm_unlink(SHM_RING_NAME);
+  }
   exit(0);
 }
 
@@ -15,6 +15,15 @@
  *
  * Detects and configures the audio output device.
  * Must be called before any other HAL audio functions.
+ * Set HAMPOD_ALSA_MMAP=1 to open the device with mmap access; the
+ * read/write transfer is used if the device does not support it.
+ *
+ * The device picked is saved (HAMPOD_AUDIO_DEVICE_FILE, by default
+ * ~/.cache/hampod/audio_device) and reused next time if it is still on
+ * the same card and port, skipping the enumeration. If it is unplugged
+ * later it is reopened as soon as a sound card comes back.
+ * HAMPOD_AUDIO_DEVICE names an ALSA device to use instead, as
+ * hal_audio_set_device() does; "null" discards the audio.
  *
  * @return 0 on success, negative error code on failure
  */
@@ -24,7 +33,8 @@ int hal_audio_init(void);
  * @brief Set audio output device explicitly
  *
  * Allows manual configuration of the audio device if auto-detection
- * is insufficient or a specific device is required.
+ * is insufficient or a specific device is required. A device set here is
+ * reopened after a replug but no longer picked automatically.
  *
  * @param device_name ALSA device name (e.g., "plughw:CARD=Device,DEV=0")
  * @return 0 on success, negative error code on failure
@@ -44,7 +54,11 @@ const char *hal_audio_get_device(void);
  * @brief Play an audio file
  *
  * Plays the specified WAV file through the configured audio device.
- * This function blocks until playback completes.
+ * The samples are queued for the playback thread; this function returns
+ * once they are queued, before playback completes. Any PCM or float WAV is
+ * converted to the pipeline format in-process (see hal_audio_convert.h),
+ * so it can be interrupted like speech; only files the converter cannot
+ * read, or playback without a PCM device, fall back to aplay, which blocks.
  *
  * @param filepath Absolute or relative path to WAV file
  * @return 0 on success, negative error code on failure
@@ -80,7 +94,9 @@ const char *hal_audio_get_impl_name(void);
 /**
  * @brief Write raw PCM samples to the audio pipeline
  *
- * Writes 16-bit signed samples directly to the persistent aplay process.
+ * Queues 16-bit signed samples in the PCM ring read by the playback
+ * thread, waiting only while the ring is full. Samples written after
+ * hal_audio_interrupt() are dropped until hal_audio_clear_interrupt().
  * Sample rate and format must match pipeline configuration (16kHz mono).
  *
  * @param samples Pointer to 16-bit signed samples
@@ -89,11 +105,19 @@ const char *hal_audio_get_impl_name(void);
  */
 int hal_audio_write_raw(const int16_t *samples, size_t num_samples);
 
+/**
+ * @brief Number of samples hal_audio_write_raw() takes without waiting
+ *
+ * @return Free space in the PCM ring, in samples
+ */
+size_t hal_audio_ring_free(void);
+
 /**
  * @brief Interrupt current audio playback
  *
- * Sets an interrupt flag that will cause streaming playback to stop
- * at the next chunk boundary (approximately 50ms).
+ * Flushes everything queued in the PCM ring and the segment queue and
+ * drops the ALSA buffer, and sets an interrupt flag so producers stop
+ * queueing audio.
  */
 void hal_audio_interrupt(void);
 
@@ -108,10 +132,30 @@ void hal_audio_clear_interrupt(void);
 /**
  * @brief Check if audio is currently playing
  *
- * @return 1 if playing, 0 otherwise
+ * @return 1 while the playback thread has audio to play, 0 otherwise
  */
 int hal_audio_is_playing(void);
 
+/**
+ * @brief Heartbeat of the playback pipeline
+ *
+ * A count that moves whenever audio is queued or written to the device,
+ * so a watchdog can tell a pipeline that is stuck from one that is busy.
+ *
+ * @return The count; only whether it changed means anything
+ */
+unsigned long long hal_audio_progress(void);
+
+/**
+ * @brief Close and reopen the PCM device, to get past a stuck one
+ *
+ * A playback thread stuck in a write is aborted first (snd_pcm_drop()).
+ * What was in the ALSA buffer is lost; the PCM ring is kept.
+ *
+ * @return 0 once the device is open again, -1 otherwise
+ */
+int hal_audio_reopen(void);
+
 /**
  * @brief Check if the audio pipeline is ready for streaming
  *
@@ -119,31 +163,251 @@ int hal_audio_is_playing(void);
  */
 int hal_audio_pipeline_ready(void);
 
+/**
+ * @brief Run the playback thread under SCHED_FIFO
+ *
+ * Call after hal_audio_init(); may be called again to change it. Needs
+ * CAP_SYS_NICE or an rtprio limit; on
+ * failure playback carries on at normal priority.
+ *
+ * @param priority SCHED_FIFO priority (1-99); 0 for normal scheduling
+ * @return 0 on success, -1 on error
+ */
+int hal_audio_set_rt_priority(int priority);
+
+/* ============================================================================
+ * Segment Queue API (gapless sequences)
+ * ============================================================================
+ *
+ * Segments play back-to-back from their own buffers, with no gap between
+ * them, and in order with audio written to the PCM ring: a segment starts
+ * once everything written before it has played. Queueing never waits for
+ * the ring, so a whole announcement (clips, cached speech, silences) can
+ * be queued at once and the speech synthesized behind it. At most 64
+ * segments are queued at a time. Like ring audio, segments queued after
+ * hal_audio_interrupt() are dropped until hal_audio_clear_interrupt().
+ */
+
+/**
+ * @brief Queue a copy of PCM samples (16kHz mono s16)
+ *
+ * @return 0 on success, -1 if the queue is full or out of memory
+ */
+int hal_audio_queue_samples(const int16_t *samples, size_t num_samples);
+
+/**
+ * @brief Queue PCM samples played from the caller's buffer, without a copy
+ *
+ * For buffers shared with a cache: the playback thread calls
+ * release(samples) once they are played or cancelled, so the buffer must
+ * stay valid and unchanged until then. release() must be thread-safe and
+ * must not call back into the audio HAL.
+ *
+ * @return 0 on success (release() will be called), -1 if the queue is
+ *         full (the caller keeps the buffer)
+ */
+int hal_audio_queue_shared(const int16_t *samples, size_t num_samples,
+                           void (*release)(const int16_t *samples));
+
+/**
+ * @brief Queue ms of silence (no buffer is allocated)
+ *
+ * @return 0 on success, -1 if the queue is full
+ */
+int hal_audio_queue_silence(unsigned int ms);
+
+/**
+ * @brief Queue a WAV file, converted to the pipeline format up front
+ *
+ * @param filepath WAV file (any format hal_audio_convert.h reads)
+ * @return 0 on success, -1 if the file cannot be read or the queue is full
+ */
+int hal_audio_queue_file(const char *filepath);
+
+/**
+ * @brief Queue a marker behind everything queued so far
+ *
+ * Plays nothing. Once the audio queued before it (ring and segments) has
+ * played, or been dropped by hal_audio_interrupt() or
+ * hal_audio_cancel_all(), hal_audio_wait_marker() returns id.
+ *
+ * @param id Handed back by hal_audio_wait_marker()
+ * @return 0 on success, -1 if interrupted, the queue is full or playback
+ *         is stopped (nothing will be handed back)
+ */
+int hal_audio_queue_marker(unsigned int id);
+
+/**
+ * @brief Wait for the next marker to be played up to
+ *
+ * Markers come back in the order they were queued. The playback thread
+ * only notes a marker once the audio before it is written to the device;
+ * this then waits out what the device still holds, so by the time it
+ * returns the audio has been heard. A cancelled marker comes back at once.
+ *
+ * @param id Receives the marker's id
+ * @return 0 on success, -1 once playback is stopped (hal_audio_cleanup())
+ */
+int hal_audio_wait_marker(unsigned int *id);
+
+/**
+ * @brief Trace when the next sound queued reaches ALSA
+ *
+ * The first sample above a silence threshold queued after this call
+ * (samples, shared buffers or files; beeps are mixed in and do not count)
+ * is recorded as TRACE_AUDIO_SOUND with tag once the playback thread has
+ * written it. A later call replaces the mark.
+ *
+ * @param tag Tag of the request about to queue its audio
+ */
+void hal_audio_mark_sound(unsigned short tag);
+
+/**
+ * @brief Cancel everything queued, segments and ring audio, and return
+ *
+ * The ALSA buffer is dropped by the playback thread straight after.
+ * Unlike hal_audio_interrupt() no interrupt flag is set, so audio queued
+ * afterwards plays; producers mid-write keep going.
+ */
+void hal_audio_cancel_all(void);
+
 /* ============================================================================
- * RAM-Cached Beep API (for low-latency beeps)
+ * Beep and Tone API (for low-latency beeps)
  * ============================================================================
+ *
+ * Beeps and tones are synthesized as they play (hal_audio_synth.h), so
+ * they need no files and any pitch, length and level can be set.
  */
 
+#include "hal_audio_synth.h"
+
 /**
  * @brief Beep type enumeration
  */
 typedef enum {
-  BEEP_KEYPRESS, /**< Short beep on key press */
-  BEEP_HOLD,     /**< Lower-pitch beep for key hold */
-  BEEP_ERROR     /**< Error/invalid key beep */
+  BEEP_KEYPRESS, /**< Short beep on key press (1000Hz, 50ms) */
+  BEEP_HOLD,     /**< Lower-pitch beep for key hold (700Hz, 50ms) */
+  BEEP_ERROR     /**< Error/invalid key beep (400Hz, 100ms) */
 } BeepType;
 
 /**
- * @brief Play a beep from RAM cache
+ * @brief Play a beep
  *
- * Plays a pre-loaded beep sound with minimal latency (no file I/O).
- * Beep sounds are loaded into RAM at hal_audio_init().
+ * The beep's tone is synthesized into whatever is playing (or into
+ * silence), starting within one mix chunk; this call returns without
+ * waiting for it. Interrupts do not cut it off.
  *
  * @param type Type of beep to play
  * @return 0 on success, -1 on failure
  */
 int hal_audio_play_beep(BeepType type);
 
+/**
+ * @brief Play a one-shot tone over whatever plays, like a beep
+ *
+ * For DTMF pairs, error-tone variations and other cues. At most four
+ * beeps and tones sound at once; a fifth replaces the one furthest along.
+ *
+ * @param tone The tone (see hal_tone_parse())
+ * @return 0 on success, -1 if playback is not running
+ */
+int hal_audio_play_tone(const HalTone *tone);
+
+/**
+ * @brief Set the tone a beep type plays
+ *
+ * Takes effect from the next beep; one sounding carries on.
+ *
+ * @param type Beep to change
+ * @param tone Its new tone, or NULL for the default
+ * @return 0 on success, -1 for an unknown type
+ */
+int hal_audio_set_beep(BeepType type, const HalTone *tone);
+
+/**
+ * @brief Play a short clip over whatever plays, cutting off the last one
+ *
+ * For keypad echo, e.g. a digit as it is typed: mixed in like a beep, so
+ * it starts within one mix chunk and interrupts do not cut it off. A
+ * newer echo replaces one still playing.
+ *
+ * @param samples 16kHz mono s16 samples, valid until hal_audio_cleanup()
+ * @param num_samples Number of samples
+ * @return 0 on success, -1 if playback is not running
+ */
+int hal_audio_play_echo(const int16_t *samples, size_t num_samples);
+
+/**
+ * @brief Queue a beep in line with other audio
+ *
+ * Queued as a segment (see hal_audio_queue_samples()): it plays after the
+ * audio queued before it and before the audio queued after it.
+ *
+ * @param type Type of beep to queue
+ * @return 0 on success, -1 on failure
+ */
+int hal_audio_queue_beep(BeepType type);
+
+/**
+ * @brief Queue a tone in line with other audio, as hal_audio_queue_beep()
+ *
+ * @return 0 on success, -1 on failure
+ */
+int hal_audio_queue_tone(const HalTone *tone);
+
+/* ============================================================================
+ * Volume API
+ * ============================================================================
+ */
+
+/**
+ * @brief Set the output volume
+ *
+ * A software gain applied to everything the playback thread writes,
+ * beeps included, so the result is the same on every audio dongle and
+ * no mixer control is touched. The gain follows an audio taper
+ * (percent squared) and ramps to the new level over one 10ms period.
+ * Starts at 100 (unity).
+ *
+ * @param percent Volume, 0-100 (clamped)
+ * @return 0 on success
+ */
+int hal_audio_set_volume(int percent);
+
+/**
+ * @brief Get the volume last set with hal_audio_set_volume()
+ *
+ * @return Volume, 0-100
+ */
+int hal_audio_get_volume(void);
+
+/**
+ * @brief Set the tuning tone
+ *
+ * A continuous sine mixed into the output like a beep, over speech or
+ * silence, for an audible meter. Call again to move the pitch; it glides
+ * there within one 10ms period. A tone not set again within 2 seconds
+ * fades out on its own.
+ *
+ * @param hz Pitch, clamped to 100-4000 Hz, or 0 to turn the tone off
+ * @return 0 on success, -1 if playback is not running
+ */
+int hal_audio_set_tone(int hz);
+
+/**
+ * @brief Set how long the PCM is kept running after the last audio
+ *
+ * While the keep-alive lasts the playback thread feeds silence between
+ * utterances (and straight after an interrupt), so a USB dongle never
+ * has to wake up again and the first syllable is not clipped. The
+ * silence is taken back when new audio arrives, so it adds no delay.
+ * Defaults to 300 seconds.
+ *
+ * @param seconds Keep-alive after the last audio, 0 to let the PCM stop
+ * @return 0 on success
+ */
+int hal_audio_set_keep_alive(int seconds);
+
 /* ============================================================================
  * Device Info API (for volume control and change detection)
  * ============================================================================
@@ -153,7 +417,6 @@ int hal_audio_play_beep(BeepType type);
  * @brief Get the selected ALSA card number
  *
  * Returns the card number of the detected audio device.
- * Used by Software2 for volume control via amixer.
  *
  * @return Card number (0-255), or -1 if not initialized
  */
@@ -169,4 +432,27 @@ int hal_audio_get_card_number(void);
  */
 const char *hal_audio_get_port_path(void);
 
+/** Playback health, for tuning the ALSA buffer on each Pi model */
+typedef struct {
+  unsigned int underruns;   /* Device starved while audio was queued */
+  unsigned int buffer_ms;   /* Current ALSA buffer size */
+  unsigned int min_fill_ms; /* Lowest fill before a write, last window */
+  unsigned int resizes;     /* Buffer size changes since start */
+  unsigned int reopens;     /* Device reopened after a replug or glitch */
+} AudioStats;
+
+/**
+ * @brief Get playback statistics
+ *
+ * The ALSA buffer adapts to the machine: it starts at 200ms, grows a step
+ * after each underrun and shrinks a step (to 40ms at the least) after 5s
+ * of playback whose worst wakeup delay would still fit in the smaller
+ * buffer. Resizes happen only while the buffer is empty, so nothing
+ * queued is lost. Interrupt and first-sample latency follow the size.
+ *
+ * @param stats Receives the statistics
+ * @return 0 on success, -1 if not initialized
+ */
+int hal_audio_get_stats(AudioStats *stats);
+
 #endif /* HAL_AUDIO_H */
@@ -0,0 +1,148 @@
+/**
+ * @file hal_audio_adpcm.c
+ * @brief IMA-ADPCM encoder and decoder (WAV block layout, mono)
+ */
+
+#include "hal_audio_adpcm.h"
+
+static const int16_t step_table[89] = {
+    7,     8,     9,     10,    11,    12,    13,    14,    16,    17,
+    19,    21,    23,    25,    28,    31,    34,    37,    41,    45,
+    50,    55,    60,    66,    73,    80,    88,    97,    107,   118,
+    130,   143,   157,   173,   190,   209,   230,   253,   279,   307,
+    337,   371,   408,   449,   494,   544,   598,   658,   724,   796,
+    876,   963,   1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+    2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,
+    5894,  6484,  7132,  7845,  8630,  9493,  10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+
+static const int8_t index_table[16] = {-1, -1, -1, -1, 2, 4, 6, 8,
+                                       -1, -1, -1, -1, 2, 4, 6, 8};
+
+typedef struct {
+  int32_t predictor;
+  int index;
+} AdpcmState;
+
+/* Apply one nibble to the state; returns the new sample */
+static inline int16_t expand(AdpcmState *s, unsigned nibble) {
+  int step = step_table[s->index];
+  int diff = step >> 3;
+  if (nibble & 1) {
+    diff += step >> 2;
+  }
+  if (nibble & 2) {
+    diff += step >> 1;
+  }
+  if (nibble & 4) {
+    diff += step;
+  }
+  s->predictor += (nibble & 8) ? -diff : diff;
+  if (s->predictor > 32767) {
+    s->predictor = 32767;
+  } else if (s->predictor < -32768) {
+    s->predictor = -32768;
+  }
+  s->index += index_table[nibble];
+  if (s->index < 0) {
+    s->index = 0;
+  } else if (s->index > 88) {
+    s->index = 88;
+  }
+  return (int16_t)s->predictor;
+}
+
+/* The nibble that best moves the state towards sample, applied */
+static unsigned compress(AdpcmState *s, int16_t sample) {
+  int step = step_table[s->index];
+  int diff = sample - s->predictor;
+  unsigned nibble = 0;
+  if (diff < 0) {
+    nibble = 8;
+    diff = -diff;
+  }
+  if (diff >= step) {
+    nibble |= 4;
+    diff -= step;
+  }
+  if (diff >= step >> 1) {
+    nibble |= 2;
+    diff -= step >> 1;
+  }
+  if (diff >= step >> 2) {
+    nibble |= 1;
+  }
+  expand(s, nibble); /* Track what the decoder will see */
+  return nibble;
+}
+
+size_t hal_adpcm_block_samples(size_t block_bytes) {
+  return block_bytes >= 4 ? 1 + (block_bytes - 4) * 2 : 0;
+}
+
+size_t hal_adpcm_encoded_bytes(size_t num_samples) {
+  size_t full = num_samples / ADPCM_BLOCK_SAMPLES;
+  size_t rest = num_samples % ADPCM_BLOCK_SAMPLES;
+  return full * ADPCM_BLOCK_BYTES + (rest > 0 ? 4 + rest / 2 : 0);
+}
+
+void hal_adpcm_encode(const int16_t *in, size_t num_samples, uint8_t *out) {
+  AdpcmState s = {0, 0};
+  while (num_samples > 0) {
+    size_t n = num_samples < ADPCM_BLOCK_SAMPLES ? num_samples
+                                                 : ADPCM_BLOCK_SAMPLES;
+    /* The state carries over, so the step size need not ramp up again */
+    s.predictor = in[0];
+    out[0] = (uint8_t)(in[0] & 0xFF);
+    out[1] = (uint8_t)((uint16_t)in[0] >> 8);
+    out[2] = (uint8_t)s.index;
+    out[3] = 0;
+    uint8_t *data = out + 4;
+    for (size_t i = 1; i < n; i += 2) {
+      unsigned low = compress(&s, in[i]);
+      unsigned high = i + 1 < n ? compress(&s, in[i + 1]) : 0;
+      *data++ = (uint8_t)(low | (high << 4));
+    }
+    out = data;
+    in += n;
+    num_samples -= n;
+  }
+}
+
+size_t hal_adpcm_decode_block(const uint8_t *block, size_t block_bytes,
+                              int16_t *out, size_t max_samples) {
+  size_t n = hal_adpcm_block_samples(block_bytes);
+  if (n > max_samples) {
+    n = max_samples;
+  }
+  if (n == 0) {
+    return 0;
+  }
+  AdpcmState s;
+  s.predictor = (int16_t)(block[0] | (block[1] << 8));
+  s.index = block[2] <= 88 ? block[2] : 88;
+  out[0] = (int16_t)s.predictor;
+  const uint8_t *data = block + 4;
+  size_t i = 1;
+  for (; i + 1 < n; i += 2) {
+    uint8_t byte = *data++;
+    out[i] = expand(&s, byte & 0x0F);
+    out[i + 1] = expand(&s, byte >> 4);
+  }
+  if (i < n) {
+    out[i] = expand(&s, *data & 0x0F);
+  }
+  return n;
+}
+
+void hal_adpcm_decode(const uint8_t *in, size_t num_samples, int16_t *out) {
+  while (num_samples > 0) {
+    size_t n = num_samples < ADPCM_BLOCK_SAMPLES ? num_samples
+                                                 : ADPCM_BLOCK_SAMPLES;
+    size_t bytes = n == ADPCM_BLOCK_SAMPLES ? ADPCM_BLOCK_BYTES : 4 + n / 2;
+    hal_adpcm_decode_block(in, bytes, out, n);
+    in += bytes;
+    out += n;
+    num_samples -= n;
+  }
+}
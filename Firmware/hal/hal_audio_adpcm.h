@@ -0,0 +1,67 @@
+#ifndef HAL_AUDIO_ADPCM_H
+#define HAL_AUDIO_ADPCM_H
+
+/**
+ * @file hal_audio_adpcm.h
+ * @brief IMA-ADPCM, 4 bits per sample, for compact stored speech
+ *
+ * The WAV flavour of IMA-ADPCM (format tag 0x11), mono: audio is cut into
+ * blocks that each start with the exact first sample and step index, then
+ * carry two samples per byte, low nibble first. A block decodes on its
+ * own, so damage never spreads past it. Storage is a quarter of s16 PCM,
+ * and decoding is a table lookup and a few adds per sample, far cheaper
+ * than playing the audio back.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Block size this module encodes with (the usual one for 16kHz WAVs) */
+#define ADPCM_BLOCK_BYTES 256
+/** Samples in a full block: the header sample plus two per data byte */
+#define ADPCM_BLOCK_SAMPLES (1 + (ADPCM_BLOCK_BYTES - 4) * 2)
+
+/**
+ * @brief Samples held by a mono block of block_bytes bytes
+ * @return The count, or 0 if block_bytes is too short for a header
+ */
+size_t hal_adpcm_block_samples(size_t block_bytes);
+
+/**
+ * @brief Bytes hal_adpcm_encode() writes for num_samples
+ *
+ * Full ADPCM_BLOCK_BYTES blocks, then one shorter block with the rest.
+ */
+size_t hal_adpcm_encoded_bytes(size_t num_samples);
+
+/**
+ * @brief Encode samples to ADPCM
+ *
+ * @param in Samples to encode
+ * @param num_samples Number of samples
+ * @param out Output, hal_adpcm_encoded_bytes(num_samples) long
+ */
+void hal_adpcm_encode(const int16_t *in, size_t num_samples, uint8_t *out);
+
+/**
+ * @brief Decode one mono block
+ *
+ * @param block The block, starting with its 4-byte header
+ * @param block_bytes Its length
+ * @param out Receives at most max_samples samples
+ * @param max_samples Room in out
+ * @return Number of samples written
+ */
+size_t hal_adpcm_decode_block(const uint8_t *block, size_t block_bytes,
+                              int16_t *out, size_t max_samples);
+
+/**
+ * @brief Decode what hal_adpcm_encode() wrote
+ *
+ * @param in Encoded data, hal_adpcm_encoded_bytes(num_samples) long
+ * @param num_samples Number of samples it holds
+ * @param out Receives num_samples samples
+ */
+void hal_adpcm_decode(const uint8_t *in, size_t num_samples, int16_t *out);
+
+#endif /* HAL_AUDIO_ADPCM_H */
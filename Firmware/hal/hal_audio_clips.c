@@ -0,0 +1,249 @@
+/**
+ * @file hal_audio_clips.c
+ * @brief RAM-resident pregenerated clip library
+ *
+ * Clips are converted to the pipeline format as they are loaded (see
+ * hal_audio_convert.h). Lookups hash the clip name (the file name without
+ * ".wav") into chained buckets.
+ */
+
+#include "hal_audio_clips.h"
+#include "hal_audio.h"
+#include "hal_audio_convert.h"
+#include "../hampod_alloc.h"
+#include <dirent.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#define CLIP_BUCKETS 128 /* Power of two */
+#define CLIP_WATCH_MASK                                                        \
+  (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_DELETE_SELF)
+
+typedef struct Clip {
+  struct Clip *next; /* Bucket chain */
+  char *name;        /* File name without ".wav" */
+  int16_t *samples;  /* Converted to 16kHz mono s16 */
+  size_t num_samples;
+} Clip;
+
+static Clip *clip_buckets[CLIP_BUCKETS];
+static char clip_dir[PATH_MAX] = {0};
+static int clip_count = 0;
+static int clip_watch_fd = -1;
+
+/* DJB2 Hash function */
+static uint32_t clip_hash(const char *str) {
+  uint32_t hash = 5381;
+  int c;
+  while ((c = *str++)) {
+    hash = ((hash << 5) + hash) + c; /* hash * 33 + c */
+  }
+  return hash;
+}
+
+static Clip **clip_slot(const char *name) {
+  Clip **slot = &clip_buckets[clip_hash(name) & (CLIP_BUCKETS - 1)];
+  while (*slot != NULL && strcmp((*slot)->name, name) != 0) {
+    slot = &(*slot)->next;
+  }
+  return slot;
+}
+
+static void clip_free(Clip *clip) {
+  hampod_free(clip->samples);
+  hampod_free(clip->name);
+  hampod_free(clip);
+}
+
+static void clip_remove(const char *name) {
+  Clip **slot = clip_slot(name);
+  if (*slot != NULL) {
+    Clip *gone = *slot;
+    *slot = gone->next;
+    clip_free(gone);
+    clip_count--;
+  }
+}
+
+/**
+ * @brief (Re)load one clip by file name; drops it if it no longer loads
+ */
+static void clip_load_file(const char *file_name) {
+  size_t len = strlen(file_name);
+  if (len <= 4 || strcmp(file_name + len - 4, ".wav") != 0) {
+    return;
+  }
+
+  char name[NAME_MAX + 1];
+  memcpy(name, file_name, len - 4);
+  name[len - 4] = '\0';
+
+  char filepath[PATH_MAX];
+  if (snprintf(filepath, sizeof(filepath), "%s/%s", clip_dir, file_name) >=
+      (int)sizeof(filepath)) {
+    return;
+  }
+
+  int16_t *samples;
+  size_t num_samples;
+  if (hal_audio_convert_file(filepath, &samples, &num_samples) != 0) {
+    clip_remove(name);
+    return;
+  }
+
+  Clip **slot = clip_slot(name);
+  if (*slot != NULL) {
+    hampod_free((*slot)->samples);
+    (*slot)->samples = samples;
+    (*slot)->num_samples = num_samples;
+    return;
+  }
+
+  Clip *clip = hampod_malloc(ALLOC_AUDIO, sizeof(Clip));
+  char *name_copy = hampod_strdup(ALLOC_AUDIO, name);
+  if (clip == NULL || name_copy == NULL) {
+    hampod_free(clip);
+    hampod_free(name_copy);
+    hampod_free(samples);
+    return;
+  }
+  clip->samples = samples;
+  clip->num_samples = num_samples;
+  clip->name = name_copy;
+  clip->next = NULL;
+  *slot = clip;
+  clip_count++;
+}
+
+static void clip_free_all(void) {
+  for (int i = 0; i < CLIP_BUCKETS; i++) {
+    while (clip_buckets[i] != NULL) {
+      Clip *next = clip_buckets[i]->next;
+      clip_free(clip_buckets[i]);
+      clip_buckets[i] = next;
+    }
+  }
+  clip_count = 0;
+}
+
+static int clip_scan(void) {
+  DIR *dir = opendir(clip_dir);
+  if (dir == NULL) {
+    return -1;
+  }
+  struct dirent *ent;
+  while ((ent = readdir(dir)) != NULL) {
+    clip_load_file(ent->d_name);
+  }
+  closedir(dir);
+  return clip_count;
+}
+
+/**
+ * @brief Apply the file changes the inotify watch has seen since last time
+ */
+static void clip_apply_changes(void) {
+  if (clip_watch_fd == -1) {
+    return;
+  }
+
+  char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  ssize_t len;
+  while ((len = read(clip_watch_fd, buf, sizeof(buf))) > 0) {
+    for (char *p = buf; p < buf + len;) {
+      struct inotify_event *ie = (struct inotify_event *)p;
+      if (ie->mask & IN_Q_OVERFLOW) {
+        printf("HAL Clips: Watch overflowed, reloading %s\n", clip_dir);
+        clip_free_all();
+        clip_scan();
+      } else if (ie->len > 0 && (ie->mask & (IN_MOVED_FROM | IN_DELETE))) {
+        char name[NAME_MAX + 1];
+        size_t name_len = strlen(ie->name);
+        if (name_len > 4 && strcmp(ie->name + name_len - 4, ".wav") == 0) {
+          memcpy(name, ie->name, name_len - 4);
+          name[name_len - 4] = '\0';
+          clip_remove(name);
+        }
+      } else if (ie->len > 0) {
+        clip_load_file(ie->name);
+      }
+      p += sizeof(struct inotify_event) + ie->len;
+    }
+  }
+}
+
+int hal_audio_clips_load(const char *dir) {
+  hal_audio_clips_cleanup();
+  if (dir == NULL || snprintf(clip_dir, sizeof(clip_dir), "%s", dir) >=
+                         (int)sizeof(clip_dir)) {
+    clip_dir[0] = '\0';
+    return -1;
+  }
+
+  /* Watch before scanning so no change slips in between */
+  clip_watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (clip_watch_fd != -1 &&
+      inotify_add_watch(clip_watch_fd, clip_dir, CLIP_WATCH_MASK) == -1) {
+    close(clip_watch_fd);
+    clip_watch_fd = -1;
+  }
+  if (clip_watch_fd == -1) {
+    fprintf(stderr, "HAL Clips: Cannot watch %s, changes need a restart\n",
+            clip_dir);
+  }
+
+  if (clip_scan() == -1) {
+    fprintf(stderr, "HAL Clips: Cannot read %s\n", clip_dir);
+    return -1;
+  }
+  printf("HAL Clips: Loaded %d clips from %s\n", clip_count, clip_dir);
+  return clip_count;
+}
+
+int hal_audio_clips_find(const char *path, const int16_t **samples,
+                         size_t *num_samples) {
+  size_t dir_len = strlen(clip_dir);
+  if (path == NULL || dir_len == 0 || strncmp(path, clip_dir, dir_len) != 0 ||
+      path[dir_len] != '/') {
+    return -1;
+  }
+
+  clip_apply_changes();
+  Clip *clip = *clip_slot(path + dir_len + 1);
+  if (clip == NULL) {
+    return -1;
+  }
+  *samples = clip->samples;
+  *num_samples = clip->num_samples;
+  return 0;
+}
+
+int hal_audio_clips_play(const char *path) {
+  const int16_t *samples;
+  size_t num_samples;
+  if (hal_audio_clips_find(path, &samples, &num_samples) != 0) {
+    return -1;
+  }
+  return hal_audio_write_raw(samples, num_samples);
+}
+
+int hal_audio_clips_queue(const char *path) {
+  const int16_t *samples;
+  size_t num_samples;
+  if (hal_audio_clips_find(path, &samples, &num_samples) != 0) {
+    return -1;
+  }
+  return hal_audio_queue_samples(samples, num_samples);
+}
+
+void hal_audio_clips_cleanup(void) {
+  if (clip_watch_fd != -1) {
+    close(clip_watch_fd);
+    clip_watch_fd = -1;
+  }
+  clip_free_all();
+}
@@ -0,0 +1,78 @@
+#ifndef HAL_AUDIO_CLIPS_H
+#define HAL_AUDIO_CLIPS_H
+
+/**
+ * @file hal_audio_clips.h
+ * @brief RAM-resident library of pregenerated audio clips
+ *
+ * Every WAV clip in one directory (Firmware/pregen_audio) is read into RAM
+ * once, indexed by name in a hash table, so playing a digit, letter or
+ * DTMF clip is a copy from memory into the audio HAL's PCM ring - no
+ * fopen, header parsing or SD card reads per request.
+ *
+ * The directory is watched with inotify: clips rewritten, added or removed
+ * (e.g. by regenerate_audio_piper.sh) are reloaded on the next lookup.
+ * Clips are converted to the pipeline format (16kHz mono 16-bit) on load,
+ * so the 44.1kHz DTMF clips play the same way; files the converter cannot
+ * read are left to hal_audio_play_file().
+ *
+ * Not thread-safe: call every function from the same thread.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Load every clip in a directory and start watching it
+ *
+ * Replaces any library loaded before.
+ *
+ * @param dir Clip directory, as it appears in play requests
+ *            (e.g. "pregen_audio")
+ * @return Number of clips loaded, or -1 if the directory cannot be read
+ */
+int hal_audio_clips_load(const char *dir);
+
+/**
+ * @brief Look up a clip
+ *
+ * Applies pending changes from the directory watch first.
+ *
+ * @param path Clip path without ".wav", as sent in a 'p' request
+ *             (e.g. "pregen_audio/5")
+ * @param samples Receives a pointer to the clip's samples, valid until the
+ *                next call into this module
+ * @param num_samples Receives the number of samples
+ * @return 0 if the clip is in the library, -1 otherwise
+ */
+int hal_audio_clips_find(const char *path, const int16_t **samples,
+                         size_t *num_samples);
+
+/**
+ * @brief Play a clip from the library
+ *
+ * @param path Clip path without ".wav" (see hal_audio_clips_find())
+ * @return 0 if the clip was queued, -1 if it is not in the library or the
+ *         audio pipeline refused it (play it with hal_audio_play_file())
+ */
+int hal_audio_clips_play(const char *path);
+
+/**
+ * @brief Queue a clip from the library as a segment
+ *
+ * Unlike hal_audio_clips_play() this never waits for ring space; the clip
+ * plays gaplessly after whatever was queued before it (see the segment
+ * queue in hal_audio.h).
+ *
+ * @param path Clip path without ".wav" (see hal_audio_clips_find())
+ * @return 0 if the clip was queued, -1 if it is not in the library or the
+ *         segment queue refused it
+ */
+int hal_audio_clips_queue(const char *path);
+
+/**
+ * @brief Free every clip and stop watching the directory
+ */
+void hal_audio_clips_cleanup(void);
+
+#endif /* HAL_AUDIO_CLIPS_H */
@@ -0,0 +1,305 @@
+/**
+ * @file hal_audio_convert.c
+ * @brief WAV parsing and conversion to 16kHz mono s16
+ *
+ * Conversion runs in two steps: decode each frame to one mono s16 sample
+ * (sample width, encoding and channel count), then resample from the
+ * clip's rate. The resampler keeps the last sample and its phase between
+ * calls so chunk boundaries are seamless.
+ */
+
+#include "hal_audio_convert.h"
+#include "hal_audio_adpcm.h"
+#include "../hampod_alloc.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#define WAV_ENCODING_EXTENSIBLE 0xFFFE
+#define CONVERT_FILE_FRAMES 4096
+
+static uint32_t read_le32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t read_le16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+
+int hal_wav_read_header(FILE *f, WavFormat *fmt) {
+  uint8_t riff[12];
+  if (fread(riff, 1, sizeof(riff), f) != sizeof(riff) ||
+      memcmp(riff, "RIFF", 4) != 0 || memcmp(riff + 8, "WAVE", 4) != 0) {
+    return -1;
+  }
+
+  int have_fmt = 0;
+  uint8_t chunk[8];
+  while (fread(chunk, 1, sizeof(chunk), f) == sizeof(chunk)) {
+    uint32_t chunk_len = read_le32(chunk + 4);
+
+    if (memcmp(chunk, "fmt ", 4) == 0 && chunk_len >= 16) {
+      /* Extensible headers carry the real encoding in the sub-format */
+      uint8_t body[26];
+      size_t want = chunk_len < sizeof(body) ? chunk_len : sizeof(body);
+      if (fread(body, 1, want, f) != want) {
+        return -1;
+      }
+      fmt->encoding = read_le16(body);
+      if (fmt->encoding == WAV_ENCODING_EXTENSIBLE && want >= 26) {
+        fmt->encoding = read_le16(body + 24);
+      }
+      fmt->channels = read_le16(body + 2);
+      fmt->sample_rate = read_le32(body + 4);
+      fmt->block_align = read_le16(body + 12);
+      fmt->bits_per_sample = read_le16(body + 14);
+      have_fmt = 1;
+      chunk_len -= want;
+    } else if (memcmp(chunk, "data", 4) == 0) {
+      if (!have_fmt) {
+        return -1;
+      }
+      fmt->data_size = chunk_len;
+
+      int bits = fmt->bits_per_sample;
+      int pcm_ok = fmt->encoding == WAV_ENCODING_PCM &&
+                   (bits == 8 || bits == 16 || bits == 24 || bits == 32);
+      int float_ok = fmt->encoding == WAV_ENCODING_FLOAT && bits == 32;
+      int adpcm_ok = fmt->encoding == WAV_ENCODING_IMA_ADPCM && bits == 4 &&
+                     fmt->channels == 1 && fmt->block_align > 4;
+      if (!(pcm_ok || float_ok || adpcm_ok) || fmt->channels == 0 ||
+          fmt->sample_rate == 0) {
+        return -1;
+      }
+      return 0;
+    }
+
+    /* Chunks are padded to an even length */
+    if (fseek(f, (long)chunk_len + (chunk_len & 1), SEEK_CUR) != 0) {
+      return -1;
+    }
+  }
+  return -1;
+}
+
+int hal_audio_converter_init(AudioConverter *conv, const WavFormat *fmt) {
+  memset(conv, 0, sizeof(*conv));
+  if (fmt->channels == 0 || fmt->sample_rate == 0) {
+    return -1;
+  }
+  conv->format = *fmt;
+  if (fmt->encoding == WAV_ENCODING_IMA_ADPCM) {
+    if (fmt->channels != 1 || fmt->block_align <= 4) {
+      return -1;
+    }
+    conv->frame_bytes = fmt->block_align;
+    conv->frame_samples = hal_adpcm_block_samples(fmt->block_align);
+    return 0;
+  }
+  if (fmt->bits_per_sample % 8 != 0) {
+    return -1;
+  }
+  conv->frame_bytes = (size_t)fmt->channels * (fmt->bits_per_sample / 8);
+  conv->frame_samples = 1;
+  return 0;
+}
+
+size_t hal_audio_converter_max_out(const AudioConverter *conv, size_t frames) {
+  return (size_t)((uint64_t)frames * conv->frame_samples * AUDIO_CONVERT_RATE /
+                  conv->format.sample_rate) +
+         2;
+}
+
+/* One sample of any supported encoding, as s16 */
+static int32_t decode_sample(const uint8_t *p, uint16_t encoding, int bits) {
+  if (encoding == WAV_ENCODING_FLOAT) {
+    float v;
+    memcpy(&v, p, sizeof(v));
+    if (v >= 1.0f) {
+      return 32767;
+    }
+    if (v <= -1.0f) {
+      return -32768;
+    }
+    return (int32_t)(v * 32767.0f);
+  }
+
+  switch (bits) {
+  case 8: /* Unsigned */
+    return ((int32_t)p[0] - 128) << 8;
+  case 16:
+    return (int16_t)read_le16(p);
+  case 24: /* Keep the top 16 bits */
+    return (int16_t)read_le16(p + 1);
+  default: /* 32 */
+    return (int16_t)read_le16(p + 2);
+  }
+}
+
+static void downmix_stereo_s16(const int16_t *in, size_t frames,
+                               int16_t *out) {
+  size_t i = 0;
+#if defined(__ARM_NEON)
+  for (; i + 8 <= frames; i += 8) {
+    int16x8x2_t lr = vld2q_s16(in + 2 * i);
+    vst1q_s16(out + i, vhaddq_s16(lr.val[0], lr.val[1]));
+  }
+#endif
+  for (; i < frames; i++) {
+    out[i] = (int16_t)(((int32_t)in[2 * i] + in[2 * i + 1]) >> 1);
+  }
+}
+
+/* Decode frames to frame_samples mono s16 samples each */
+static void decode_mono(const AudioConverter *conv, const uint8_t *in,
+                        size_t frames, int16_t *out) {
+  const WavFormat *fmt = &conv->format;
+  if (fmt->encoding == WAV_ENCODING_IMA_ADPCM) {
+    for (size_t i = 0; i < frames; i++) {
+      out += hal_adpcm_decode_block(in, conv->frame_bytes, out,
+                                    conv->frame_samples);
+      in += conv->frame_bytes;
+    }
+    return;
+  }
+  if (fmt->encoding == WAV_ENCODING_PCM && fmt->bits_per_sample == 16) {
+    if (fmt->channels == 1) {
+      memcpy(out, in, frames * sizeof(int16_t));
+      return;
+    }
+    if (fmt->channels == 2) {
+      downmix_stereo_s16((const int16_t *)in, frames, out);
+      return;
+    }
+  }
+
+  size_t sample_bytes = fmt->bits_per_sample / 8;
+  for (size_t i = 0; i < frames; i++) {
+    int32_t sum = 0;
+    for (int ch = 0; ch < fmt->channels; ch++) {
+      sum += decode_sample(in, fmt->encoding, fmt->bits_per_sample);
+      in += sample_bytes;
+    }
+    out[i] = (int16_t)(sum / fmt->channels);
+  }
+}
+
+/* Linear interpolation to AUDIO_CONVERT_RATE, continuing the last call */
+static size_t resample(AudioConverter *conv, const int16_t *in, size_t n,
+                       int16_t *out) {
+  const int64_t unit = AUDIO_CONVERT_RATE;
+  const int64_t step = conv->format.sample_rate;
+  if (n == 0) {
+    return 0;
+  }
+  if (!conv->primed) {
+    conv->prev = in[0];
+    conv->primed = 1;
+  }
+
+  /* Position q counts from prev, which sits just before in[0] */
+  size_t written = 0;
+  int64_t q = conv->phase + unit;
+  for (int64_t j = q / unit; j < (int64_t)n; j = q / unit) {
+    int32_t frac = (int32_t)(q % unit);
+    int32_t a = j == 0 ? conv->prev : in[j - 1];
+    int32_t b = in[j];
+    out[written++] = (int16_t)(a + (b - a) * frac / unit);
+    q += step;
+  }
+
+  conv->phase = q - unit - (int64_t)n * unit;
+  conv->prev = in[n - 1];
+  return written;
+}
+
+long hal_audio_convert(AudioConverter *conv, const uint8_t *in, size_t frames,
+                       int16_t *out) {
+  size_t n = frames * conv->frame_samples;
+  if (conv->format.sample_rate == AUDIO_CONVERT_RATE) {
+    decode_mono(conv, in, frames, out);
+    return (long)n;
+  }
+
+  if (conv->scratch_len < n) {
+    int16_t *scratch =
+        hampod_realloc(ALLOC_AUDIO, conv->scratch, n * sizeof(int16_t));
+    if (scratch == NULL) {
+      return -1;
+    }
+    conv->scratch = scratch;
+    conv->scratch_len = n;
+  }
+  decode_mono(conv, in, frames, conv->scratch);
+  return (long)resample(conv, conv->scratch, n, out);
+}
+
+void hal_audio_converter_free(AudioConverter *conv) {
+  hampod_free(conv->scratch);
+  conv->scratch = NULL;
+  conv->scratch_len = 0;
+}
+
+int hal_audio_convert_file(const char *filepath, int16_t **samples,
+                           size_t *num_samples) {
+  FILE *f = fopen(filepath, "rb");
+  if (f == NULL) {
+    return -1;
+  }
+
+  WavFormat fmt;
+  AudioConverter conv;
+  if (hal_wav_read_header(f, &fmt) != 0 ||
+      hal_audio_converter_init(&conv, &fmt) != 0) {
+    fclose(f);
+    return -1;
+  }
+
+  /* Streamed WAVs can claim more data than the file holds */
+  long data_start = ftell(f);
+  if (fseek(f, 0, SEEK_END) == 0) {
+    long file_end = ftell(f);
+    if (data_start >= 0 && file_end >= data_start &&
+        (uint64_t)(file_end - data_start) < fmt.data_size) {
+      fmt.data_size = (uint32_t)(file_end - data_start);
+    }
+    fseek(f, data_start, SEEK_SET);
+  }
+
+  uint8_t *chunk =
+      hampod_malloc(ALLOC_AUDIO, CONVERT_FILE_FRAMES * conv.frame_bytes);
+  size_t total_frames = fmt.data_size / conv.frame_bytes;
+  size_t capacity = hal_audio_converter_max_out(&conv, total_frames);
+  int16_t *out = hampod_malloc(ALLOC_AUDIO, capacity * sizeof(int16_t));
+  size_t have = 0;
+  size_t frames_left = total_frames;
+  int rc = chunk != NULL && out != NULL ? 0 : -1;
+
+  while (rc == 0 && frames_left > 0) {
+    size_t want =
+        frames_left < CONVERT_FILE_FRAMES ? frames_left : CONVERT_FILE_FRAMES;
+    size_t got = fread(chunk, conv.frame_bytes, want, f);
+    if (got == 0) {
+      break; /* Truncated file: keep what was read */
+    }
+    long n = hal_audio_convert(&conv, chunk, got, out + have);
+    if (n < 0) {
+      rc = -1;
+      break;
+    }
+    have += (size_t)n;
+    frames_left -= got;
+  }
+
+  hampod_free(chunk);
+  hal_audio_converter_free(&conv);
+  fclose(f);
+  if (rc != 0) {
+    hampod_free(out);
+    return -1;
+  }
+  *samples = out;
+  *num_samples = have;
+  return 0;
+}
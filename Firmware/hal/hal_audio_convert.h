@@ -0,0 +1,100 @@
+#ifndef HAL_AUDIO_CONVERT_H
+#define HAL_AUDIO_CONVERT_H
+
+/**
+ * @file hal_audio_convert.h
+ * @brief WAV parsing and conversion to the audio pipeline format
+ *
+ * The playback pipeline runs at 16kHz mono signed 16-bit. This module
+ * reads WAV headers by walking the RIFF chunks (so LIST/fact chunks and
+ * WAVE_FORMAT_EXTENSIBLE headers are fine) and converts any PCM, float
+ * or mono IMA-ADPCM clip to that format in-process: 8/24/32-bit and float
+ * samples to s16, ADPCM blocks through hal_audio_adpcm.h, multi-channel to
+ * mono, and any sample rate to 16kHz by linear interpolation.
+ *
+ * The converter is streaming, so a file can be converted chunk by chunk
+ * as it is read. On ARM the stereo s16 downmix uses NEON.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define AUDIO_CONVERT_RATE 16000
+
+/** Sample encodings hal_wav_read_header() accepts */
+#define WAV_ENCODING_PCM 1
+#define WAV_ENCODING_FLOAT 3
+#define WAV_ENCODING_IMA_ADPCM 0x11 /* Mono only */
+
+typedef struct {
+  uint16_t encoding; /* WAV_ENCODING_* */
+  uint16_t channels;
+  uint32_t sample_rate;
+  uint16_t bits_per_sample; /* 8, 16, 24 or 32; 4 for ADPCM */
+  uint32_t data_size;       /* Bytes of sample data */
+  uint16_t block_align;     /* Bytes per ADPCM block; unused for PCM */
+} WavFormat;
+
+/**
+ * @brief Parse a WAV header and position the file at the sample data
+ *
+ * @param f File open for reading, at offset 0
+ * @param fmt Receives the format
+ * @return 0 on success, -1 if not a WAV file or the encoding is not
+ *         supported
+ */
+int hal_wav_read_header(FILE *f, WavFormat *fmt);
+
+typedef struct {
+  WavFormat format;
+  size_t frame_bytes; /* Bytes per input frame (all channels) */
+  size_t frame_samples; /* Mono samples a frame decodes to (an ADPCM
+                         * block is one frame) */
+  int64_t phase;      /* Next output position, in 1/16000 input frames */
+  int16_t prev;       /* Last mono sample of the previous chunk */
+  int primed;         /* prev is valid */
+  int16_t *scratch;   /* Mono samples before resampling */
+  size_t scratch_len;
+} AudioConverter;
+
+/**
+ * @brief Set up a converter for one stream
+ *
+ * @return 0 on success, -1 if the format is not supported
+ */
+int hal_audio_converter_init(AudioConverter *conv, const WavFormat *fmt);
+
+/**
+ * @brief Largest number of samples hal_audio_convert() writes for frames
+ */
+size_t hal_audio_converter_max_out(const AudioConverter *conv, size_t frames);
+
+/**
+ * @brief Convert whole input frames to 16kHz mono s16
+ *
+ * @param in Input bytes, frames * frame_bytes long
+ * @param frames Number of input frames
+ * @param out Output buffer, hal_audio_converter_max_out() samples long
+ * @return Number of samples written, or -1 if out of memory
+ */
+long hal_audio_convert(AudioConverter *conv, const uint8_t *in, size_t frames,
+                       int16_t *out);
+
+/**
+ * @brief Free a converter's buffers
+ */
+void hal_audio_converter_free(AudioConverter *conv);
+
+/**
+ * @brief Read a whole WAV file converted to 16kHz mono s16
+ *
+ * @param filepath WAV file
+ * @param samples Receives a malloc'd buffer; the caller frees it
+ * @param num_samples Receives the number of samples
+ * @return 0 on success, -1 on failure
+ */
+int hal_audio_convert_file(const char *filepath, int16_t **samples,
+                           size_t *num_samples);
+
+#endif /* HAL_AUDIO_CONVERT_H */
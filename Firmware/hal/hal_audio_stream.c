@@ -0,0 +1,245 @@
+/**
+ * @file hal_audio_stream.c
+ * @brief Opus/RTP stream of what the audio HAL plays, for a remote station
+ *
+ * The playback thread copies every chunk it plays into a ring here and
+ * moves on; the encoder thread takes 20 ms frames from it, encodes them
+ * and sends one RTP packet each. Opus in its VoIP mode at 24 kbit/s,
+ * complexity 3, costs a few percent of one Pi 4 core, beside Piper.
+ *
+ * The playback thread runs ahead of the speaker by the ALSA buffer, so
+ * the encoder paces its packets to real time, at most STREAM_LEAD_MS
+ * early: the remote station's jitter buffer then only has to cover the
+ * network. A partial frame at the end of a phrase is padded with silence
+ * once nothing more has come for a frame time. In-band FEC lets the
+ * receiver rebuild a lost packet from the one after it.
+ */
+
+#include "hal_remote.h"
+#include "../hampod_metrics.h"
+#include <errno.h>
+#include <netinet/ip.h>
+#include <opus/opus.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define STREAM_RING_SAMPLES 16384 /* About 1 s; power of two */
+#define STREAM_RING_MASK (STREAM_RING_SAMPLES - 1)
+#define STREAM_LEAD_MS 40         /* Sent at most this far ahead of time */
+#define STREAM_BITRATE 24000
+#define STREAM_COMPLEXITY 3
+#define STREAM_LOSS_PERCENT 10    /* Tunes how much FEC the encoder adds */
+#define STREAM_TOS 0xB8           /* DSCP EF: low-latency queue en route */
+
+static int16_t stream_ring[STREAM_RING_SAMPLES];
+static _Atomic uint32_t stream_head = 0;     /* Next sample feed fills */
+static _Atomic uint32_t stream_tail = 0;     /* Next sample encoded */
+static _Atomic uint32_t stream_flush_to = 0; /* Interrupt: skip to here */
+static sem_t stream_data;                    /* Posted by feed and stop */
+
+static _Atomic int stream_running = 0;
+static pthread_t stream_thread;
+static OpusEncoder *encoder = NULL;
+static int stream_fd = -1;
+
+static long long monotonic_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void sleep_until_us(long long when) {
+  struct timespec ts = {when / 1000000, (when % 1000000) * 1000};
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+  }
+}
+
+/* Wait for more audio, or at most timeout_us if it is >= 0 */
+static void wait_for_audio(long long timeout_us) {
+  if (timeout_us < 0) {
+    while (sem_wait(&stream_data) == -1 && errno == EINTR) {
+    }
+    return;
+  }
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  long long ns = ts.tv_nsec + timeout_us * 1000;
+  ts.tv_sec += ns / 1000000000;
+  ts.tv_nsec = ns % 1000000000;
+  while (sem_timedwait(&stream_data, &ts) == -1 && errno == EINTR) {
+  }
+}
+
+static void *stream_thread_func(void *arg) {
+  int16_t frame[REMOTE_FRAME_SAMPLES];
+  unsigned char packet[REMOTE_PACKET_MAX];
+  uint16_t seq = (uint16_t)rand();
+  uint32_t ssrc = (uint32_t)rand() << 1 ^ (uint32_t)rand();
+  uint32_t rtp_base = (uint32_t)rand();
+  long long epoch = monotonic_us();
+  long long spurt_start = 0; /* When the current run of packets began */
+  long long sent = 0;        /* Frames sent in it */
+  (void)arg;
+  hampod_metrics_name_thread("audio-stream");
+
+  while (atomic_load(&stream_running)) {
+    uint32_t flush_to = atomic_load(&stream_flush_to);
+    uint32_t tail = atomic_load_explicit(&stream_tail, memory_order_relaxed);
+    if ((int32_t)(flush_to - tail) > 0) {
+      tail = flush_to;
+      atomic_store_explicit(&stream_tail, tail, memory_order_release);
+    }
+    uint32_t queued =
+        atomic_load_explicit(&stream_head, memory_order_acquire) - tail;
+
+    if (queued < REMOTE_FRAME_SAMPLES) {
+      if (queued == 0) {
+        wait_for_audio(-1);
+        continue;
+      }
+      /* The end of a phrase: pad it once nothing more comes */
+      uint32_t before = queued;
+      wait_for_audio(REMOTE_FRAME_MS * 1000);
+      queued = atomic_load_explicit(&stream_head, memory_order_acquire) - tail;
+      if (queued != before || (int32_t)(atomic_load(&stream_flush_to) -
+                                        tail) > 0) {
+        continue;
+      }
+    }
+
+    size_t take = queued < REMOTE_FRAME_SAMPLES ? queued : REMOTE_FRAME_SAMPLES;
+    for (size_t i = 0; i < take; i++) {
+      frame[i] = stream_ring[(tail + i) & STREAM_RING_MASK];
+    }
+    memset(&frame[take], 0, (REMOTE_FRAME_SAMPLES - take) * sizeof(int16_t));
+    atomic_store_explicit(&stream_tail, tail + (uint32_t)take,
+                          memory_order_release);
+
+    /* A new run of packets after a pause starts on the clock, marked */
+    long long now = monotonic_us();
+    int marker = now > spurt_start + (sent + 1) * REMOTE_FRAME_MS * 1000;
+    if (marker) {
+      spurt_start = now;
+      sent = 0;
+    }
+    long long due = spurt_start + sent * REMOTE_FRAME_MS * 1000;
+    if (due - STREAM_LEAD_MS * 1000 > now) {
+      sleep_until_us(due - STREAM_LEAD_MS * 1000);
+    }
+    uint32_t timestamp =
+        rtp_base +
+        (uint32_t)((spurt_start - epoch) * (REMOTE_RTP_CLOCK / 1000) / 1000) +
+        (uint32_t)(sent * REMOTE_RTP_CLOCK * REMOTE_FRAME_MS / 1000);
+
+    int len = opus_encode(encoder, frame, REMOTE_FRAME_SAMPLES,
+                          &packet[REMOTE_RTP_HEADER_LEN],
+                          REMOTE_PACKET_MAX - REMOTE_RTP_HEADER_LEN);
+    sent++;
+    if (len < 0) {
+      fprintf(stderr, "HAL Stream: Encode failed: %s\n", opus_strerror(len));
+      continue;
+    }
+    hal_remote_rtp_header(packet, marker, seq++, timestamp, ssrc);
+    if (send(stream_fd, packet, REMOTE_RTP_HEADER_LEN + (size_t)len,
+             MSG_DONTWAIT) == -1) {
+      hampod_metric_add(METRIC_REMOTE_DROPS, 1); /* Refused, or no route */
+    } else {
+      hampod_metric_add(METRIC_REMOTE_FRAMES, 1);
+    }
+  }
+  return NULL;
+}
+
+int hal_audio_stream_start(void) {
+  struct sockaddr_in peer;
+  const char *spec = getenv(HAL_REMOTE_ENV);
+  if (spec == NULL || hal_remote_parse_address(spec, &peer) != 0) {
+    fprintf(stderr, "HAL Stream: No remote station (%s)\n",
+            spec != NULL ? spec : "unset");
+    return -1;
+  }
+
+  int err;
+  encoder = opus_encoder_create(REMOTE_SAMPLE_RATE, 1,
+                                OPUS_APPLICATION_VOIP, &err);
+  if (encoder == NULL) {
+    fprintf(stderr, "HAL Stream: Encoder failed: %s\n", opus_strerror(err));
+    return -1;
+  }
+  opus_encoder_ctl(encoder, OPUS_SET_BITRATE(STREAM_BITRATE));
+  opus_encoder_ctl(encoder, OPUS_SET_COMPLEXITY(STREAM_COMPLEXITY));
+  opus_encoder_ctl(encoder, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
+  opus_encoder_ctl(encoder, OPUS_SET_INBAND_FEC(1));
+  opus_encoder_ctl(encoder, OPUS_SET_PACKET_LOSS_PERC(STREAM_LOSS_PERCENT));
+
+  int tos = STREAM_TOS;
+  stream_fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (stream_fd == -1 ||
+      connect(stream_fd, (struct sockaddr *)&peer, sizeof(peer)) != 0) {
+    perror("HAL Stream: Socket");
+    hal_audio_stream_stop();
+    return -1;
+  }
+  setsockopt(stream_fd, IPPROTO_IP, IP_TOS, &tos, sizeof(tos));
+
+  sem_init(&stream_data, 0, 0);
+  srand((unsigned int)(monotonic_us() ^ getpid()));
+  atomic_store(&stream_running, 1);
+  if (pthread_create(&stream_thread, NULL, stream_thread_func, NULL) != 0) {
+    atomic_store(&stream_running, 0);
+    sem_destroy(&stream_data);
+    hal_audio_stream_stop();
+    return -1;
+  }
+  printf("HAL Stream: Streaming to %s\n", spec);
+  return 0;
+}
+
+void hal_audio_stream_feed(const int16_t *samples, size_t count) {
+  if (!atomic_load_explicit(&stream_running, memory_order_relaxed)) {
+    return;
+  }
+  uint32_t head = atomic_load_explicit(&stream_head, memory_order_relaxed);
+  uint32_t tail = atomic_load_explicit(&stream_tail, memory_order_acquire);
+  if (head - tail + count > STREAM_RING_SAMPLES) {
+    /* The encoder fell a second behind; the remote end hears a gap */
+    hampod_metric_add(METRIC_REMOTE_DROPS, 1);
+    return;
+  }
+  for (size_t i = 0; i < count; i++) {
+    stream_ring[(head + i) & STREAM_RING_MASK] = samples[i];
+  }
+  atomic_store_explicit(&stream_head, head + (uint32_t)count,
+                        memory_order_release);
+  sem_post(&stream_data);
+}
+
+void hal_audio_stream_flush(void) {
+  if (atomic_load_explicit(&stream_running, memory_order_relaxed)) {
+    atomic_store(&stream_flush_to, atomic_load(&stream_head));
+    sem_post(&stream_data);
+  }
+}
+
+void hal_audio_stream_stop(void) {
+  if (atomic_exchange(&stream_running, 0)) {
+    sem_post(&stream_data);
+    pthread_join(stream_thread, NULL);
+    sem_destroy(&stream_data);
+  }
+  if (stream_fd != -1) {
+    close(stream_fd);
+    stream_fd = -1;
+  }
+  if (encoder != NULL) {
+    opus_encoder_destroy(encoder);
+    encoder = NULL;
+  }
+}
@@ -0,0 +1,198 @@
+/**
+ * @file hal_audio_synth.c
+ * @brief Tone synthesis for beeps, DTMF and tuning tones
+ *
+ * The sine table is built once by the recurrence
+ * sin((n+1)w) = 2cos(w)sin(nw) - sin((n-1)w) over a quarter turn and
+ * mirrored, so no libm is needed. Oscillators are 32-bit phase
+ * accumulators whose top bits index the table.
+ */
+
+#include "hal_audio_synth.h"
+#include "../hampod_alloc.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TONE_TABLE_BITS 10
+#define TONE_TABLE_SIZE (1 << TONE_TABLE_BITS)
+#define TONE_FULL_SCALE 32767
+
+/* cos and sin of one table step, 2pi/1024 */
+#define TONE_STEP_COS 0.9999811752826011
+#define TONE_STEP_SIN 0.006135884649154475
+
+/* One entry past a full turn, so interpolation never wraps */
+static int16_t sine_table[TONE_TABLE_SIZE + 1];
+static pthread_once_t table_once = PTHREAD_ONCE_INIT;
+
+static void tone_build_table(void) {
+  const int quarter = TONE_TABLE_SIZE / 4;
+  const int half = TONE_TABLE_SIZE / 2;
+  double prev = -TONE_STEP_SIN; /* sin(-w) */
+  double cur = 0.0;
+  for (int n = 0; n <= quarter; n++) {
+    int16_t v = (int16_t)(cur * TONE_FULL_SCALE + 0.5);
+    sine_table[n] = v;
+    sine_table[half - n] = v;
+    sine_table[half + n] = (int16_t)-v;
+    sine_table[TONE_TABLE_SIZE - n] = (int16_t)-v;
+    double next = 2.0 * TONE_STEP_COS * cur - prev;
+    prev = cur;
+    cur = next;
+  }
+}
+
+void hal_tone_init(void) { pthread_once(&table_once, tone_build_table); }
+
+/* Read a decimal number at *p, moving past it. Returns -1 if none. */
+static long tone_number(const char **p) {
+  char *end;
+  long value = strtol(*p, &end, 10);
+  if (end == *p || value < 0) {
+    return -1;
+  }
+  *p = end;
+  return value;
+}
+
+int hal_tone_parse(const char *text, HalTone *tone) {
+  if (text == NULL || tone == NULL) {
+    return -1;
+  }
+  /* hz, hz2, ms, level, ramp */
+  long values[5] = {0, 0, HAL_TONE_DEFAULT_MS, HAL_TONE_DEFAULT_LEVEL,
+                    HAL_TONE_DEFAULT_RAMP_MS};
+  const char *p = text;
+  while (*p == ' ' || *p == '\t') {
+    p++;
+  }
+  if ((values[0] = tone_number(&p)) < 0) {
+    return -1;
+  }
+  if (*p == '+') {
+    p++;
+    if ((values[1] = tone_number(&p)) < 0) {
+      return -1;
+    }
+  }
+  for (int i = 2; i < 5 && *p == '/'; i++) {
+    p++;
+    if ((values[i] = tone_number(&p)) < 0) {
+      return -1;
+    }
+  }
+  while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+    p++;
+  }
+
+  if (*p != '\0' || values[0] < HAL_TONE_MIN_HZ ||
+      values[0] > HAL_TONE_MAX_HZ ||
+      (values[1] != 0 &&
+       (values[1] < HAL_TONE_MIN_HZ || values[1] > HAL_TONE_MAX_HZ)) ||
+      values[2] < 1 || values[2] > HAL_TONE_MAX_MS || values[3] > 100 ||
+      values[4] > UINT8_MAX) {
+    return -1;
+  }
+  tone->hz = (uint16_t)values[0];
+  tone->hz2 = (uint16_t)values[1];
+  tone->ms = (uint16_t)values[2];
+  tone->level = (uint8_t)values[3];
+  tone->ramp_ms = (uint8_t)values[4];
+  return 0;
+}
+
+int hal_tone_dtmf(char key, unsigned int ms, HalTone *tone) {
+  static const char keys[] = "123A456B789C*0#D";
+  static const uint16_t rows[] = {697, 770, 852, 941};
+  static const uint16_t cols[] = {1209, 1336, 1477, 1633};
+
+  const char *found = key != '\0' ? strchr(keys, key) : NULL;
+  if (found == NULL || tone == NULL) {
+    return -1;
+  }
+  int index = (int)(found - keys);
+  if (ms == 0) {
+    ms = HAL_TONE_DTMF_MS;
+  } else if (ms > HAL_TONE_MAX_MS) {
+    ms = HAL_TONE_MAX_MS;
+  }
+  tone->hz = rows[index / 4];
+  tone->hz2 = cols[index % 4];
+  tone->ms = (uint16_t)ms;
+  tone->level = HAL_TONE_DEFAULT_LEVEL;
+  tone->ramp_ms = HAL_TONE_DEFAULT_RAMP_MS;
+  return 0;
+}
+
+int32_t hal_tone_sine(uint32_t phase, int32_t level) {
+  uint32_t index = phase >> (32 - TONE_TABLE_BITS);
+  int32_t frac = (int32_t)((phase >> (16 - TONE_TABLE_BITS)) & 0xFFFF);
+  int32_t a = sine_table[index];
+  int32_t b = sine_table[index + 1];
+  int32_t s = a + (((b - a) * frac) >> 16);
+  return (int32_t)(((int64_t)s * level) >> 15);
+}
+
+void hal_tone_start(HalToneVoice *voice, const HalTone *tone) {
+  hal_tone_init();
+  memset(voice, 0, sizeof(*voice));
+  voice->step = (uint32_t)(((uint64_t)tone->hz << 32) / HAL_TONE_RATE);
+  voice->step2 = (uint32_t)(((uint64_t)tone->hz2 << 32) / HAL_TONE_RATE);
+  voice->peak = TONE_FULL_SCALE * tone->level / 100;
+  if (tone->hz2 != 0) {
+    voice->peak /= 2; /* The pair peaks at the level */
+  }
+  voice->length = (size_t)tone->ms * HAL_TONE_RATE / 1000;
+  voice->ramp = (size_t)tone->ramp_ms * HAL_TONE_RATE / 1000;
+  if (voice->ramp > voice->length / 2) {
+    voice->ramp = voice->length / 2;
+  }
+}
+
+size_t hal_tone_mix(HalToneVoice *voice, int16_t *out, size_t count) {
+  size_t n = voice->length - voice->pos;
+  if (n > count) {
+    n = count;
+  }
+  for (size_t i = 0; i < n; i++, voice->pos++) {
+    int32_t amp = voice->peak;
+    size_t left = voice->length - voice->pos;
+    if (voice->pos < voice->ramp) {
+      amp = (int32_t)((int64_t)amp * (int64_t)(voice->pos + 1) /
+                      (int64_t)voice->ramp);
+    } else if (left <= voice->ramp) {
+      amp = (int32_t)((int64_t)amp * (int64_t)left / (int64_t)voice->ramp);
+    }
+
+    voice->phase += voice->step;
+    int32_t sum = (int32_t)out[i] + hal_tone_sine(voice->phase, amp);
+    if (voice->step2 != 0) {
+      voice->phase2 += voice->step2;
+      sum += hal_tone_sine(voice->phase2, amp);
+    }
+    if (sum > INT16_MAX) {
+      sum = INT16_MAX;
+    } else if (sum < INT16_MIN) {
+      sum = INT16_MIN;
+    }
+    out[i] = (int16_t)sum;
+  }
+  return voice->length - voice->pos;
+}
+
+int hal_tone_render(const HalTone *tone, int16_t **samples,
+                    size_t *num_samples) {
+  HalToneVoice voice;
+  hal_tone_start(&voice, tone);
+  int16_t *out =
+      hampod_calloc(ALLOC_AUDIO, voice.length > 0 ? voice.length : 1,
+                    sizeof(int16_t));
+  if (out == NULL) {
+    return -1;
+  }
+  hal_tone_mix(&voice, out, voice.length);
+  *samples = out;
+  *num_samples = voice.length;
+  return 0;
+}
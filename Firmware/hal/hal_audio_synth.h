@@ -0,0 +1,114 @@
+#ifndef HAL_AUDIO_SYNTH_H
+#define HAL_AUDIO_SYNTH_H
+
+/**
+ * @file hal_audio_synth.h
+ * @brief Tone synthesis for beeps, DTMF and tuning tones
+ *
+ * A table-lookup sine oscillator (one or two of them, summed, for a DTMF
+ * pair) shaped by a linear attack/release envelope, at the pipeline
+ * format (16kHz mono s16). Tones are described by a HalTone rather than
+ * recorded, so any pitch, length and level plays without a file; the
+ * audio HAL renders them straight into its mixer, a chunk at a time.
+ *
+ * A tone is written as text in hampod.conf and in audio requests:
+ *
+ *     HZ[+HZ2][/MS[/LEVEL[/RAMP]]]
+ *
+ * e.g. "1000/50/50" (1 kHz for 50 ms at half scale) or "697+1209/200".
+ * LEVEL is the peak in percent of full scale and RAMP the attack and
+ * release in ms; left out they default to HAL_TONE_DEFAULT_*.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HAL_TONE_RATE 16000
+#define HAL_TONE_MIN_HZ 20
+#define HAL_TONE_MAX_HZ 7900 /* Below Nyquist at 16kHz */
+#define HAL_TONE_MAX_MS 10000
+
+#define HAL_TONE_DEFAULT_MS 100
+#define HAL_TONE_DEFAULT_LEVEL 50
+#define HAL_TONE_DEFAULT_RAMP_MS 5
+#define HAL_TONE_DTMF_MS 200
+
+typedef struct {
+  uint16_t hz;      /* First oscillator */
+  uint16_t hz2;     /* Second oscillator, summed with the first; 0 for none */
+  uint16_t ms;      /* Length, envelope included */
+  uint8_t level;    /* Peak, percent of full scale */
+  uint8_t ramp_ms;  /* Attack and release, at most half the length */
+} HalTone;
+
+/** A tone being rendered; see hal_tone_start() */
+typedef struct {
+  uint32_t phase, phase2; /* A full turn is 2^32 */
+  uint32_t step, step2;   /* Phase advance per sample */
+  int32_t peak;           /* Per oscillator */
+  size_t pos;             /* Next sample */
+  size_t length;
+  size_t ramp;
+} HalToneVoice;
+
+/**
+ * @brief Build the sine table
+ *
+ * hal_tone_start() and hal_tone_render() build it themselves; call this
+ * before using hal_tone_sine() on its own (hal_audio_init() does). Later
+ * calls do nothing.
+ */
+void hal_tone_init(void);
+
+/**
+ * @brief Parse a tone written as HZ[+HZ2][/MS[/LEVEL[/RAMP]]]
+ *
+ * @param text The tone; leading and trailing spaces are ignored
+ * @param tone Receives the tone
+ * @return 0 on success, -1 if text is not a tone or out of range
+ */
+int hal_tone_parse(const char *text, HalTone *tone);
+
+/**
+ * @brief The DTMF pair of a key
+ *
+ * @param key 0-9, A-D, * or #
+ * @param ms Length, 0 for HAL_TONE_DTMF_MS
+ * @param tone Receives the tone, at HAL_TONE_DEFAULT_LEVEL
+ * @return 0 on success, -1 if key has no DTMF pair
+ */
+int hal_tone_dtmf(char key, unsigned int ms, HalTone *tone);
+
+/**
+ * @brief Sine of a phase (a full turn is 2^32), scaled to level
+ *
+ * Linear interpolation between the entries of a 1024-point table, within
+ * 0.02% of a true sine.
+ */
+int32_t hal_tone_sine(uint32_t phase, int32_t level);
+
+/**
+ * @brief Start rendering a tone
+ */
+void hal_tone_start(HalToneVoice *voice, const HalTone *tone);
+
+/**
+ * @brief Sum the next samples of a tone into out, saturating at the int16
+ *        range
+ *
+ * @param count Samples of out to mix into; fewer are used if the tone ends
+ * @return Samples of the tone left after these
+ */
+size_t hal_tone_mix(HalToneVoice *voice, int16_t *out, size_t count);
+
+/**
+ * @brief Render a whole tone into a new buffer
+ *
+ * @param samples Receives the buffer, to free with hampod_free()
+ * @param num_samples Receives its length
+ * @return 0 on success, -1 if out of memory
+ */
+int hal_tone_render(const HalTone *tone, int16_t **samples,
+                    size_t *num_samples);
+
+#endif /* HAL_AUDIO_SYNTH_H */
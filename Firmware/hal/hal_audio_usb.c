@@ -8,28 +8,113 @@
  * Phase 3: Direct ALSA Implementation
  * - Uses snd_pcm_* API instead of popen("aplay")
  * - snd_pcm_drop() for immediate interrupt
- * - RAM-cached beep support
+ * - Synthesized beeps (hal_audio_synth.h)
+ *
+ * Playback thread: only one thread calls snd_pcm_writei(). TTS, the TTS
+ * cache, clips and silence are copied into a PCM ring and return as soon
+ * as they are queued, so synthesis runs ahead of playback instead of
+ * stalling whenever the ALSA buffer is full. An interrupt flushes the ring
+ * and drops the ALSA buffer. Beeps are synthesized into the output as it
+ * is written, so they never block or restart the PCM. A tuning tone is a
+ * continuous sine mixed in the same way, its pitch following a target
+ * Software updates many times a second.
+ *
+ * With HAMPOD_ALSA_MMAP=1 the device is opened for mmap access and the
+ * playback thread builds each chunk directly in the ALSA buffer
+ * (snd_pcm_mmap_begin/commit) instead of in a local buffer handed to
+ * snd_pcm_writei(). Devices that refuse mmap fall back to read/write.
+ *
+ * Keep-alive: for a while after the last audio (and right after an
+ * interrupt drop) the thread keeps a little silence queued so the PCM
+ * never stops. USB dongles take a while to start streaming again, which
+ * clips the first syllable; a running PCM only costs buffer latency. The
+ * queued silence is rewound when real audio arrives, and audio starting
+ * from silence is faded in over a few milliseconds.
+ *
+ * Remote station (USE_REMOTE_AUDIO): every chunk built is also handed to
+ * the Opus stream (hal_remote.h) after it is mixed, and an interrupt
+ * drops what the stream has not sent yet.
+ *
+ * Device selection: the device chosen last is remembered (card and USB
+ * port, in HAMPOD_AUDIO_DEVICE_FILE) and only checked in sysfs at the
+ * next start; the full enumeration runs if it is gone. A device monitor
+ * thread listens for sound card uevents: an unplugged device is closed
+ * and, when a card comes back, picked and reopened at once, so audio
+ * returns after a USB glitch without restarting Firmware.
  */
 
+#define _GNU_SOURCE /* pipe2 */
+
 #include "hal_audio.h"
+#include "hal_audio_convert.h"
+#include "hal_audio_synth.h"
+#include "hal_remote.h"
 #include "hal_usb_util.h"
+#include "../hampod_alloc.h"
+#include "../hampod_log.h"
+#include "../hampod_metrics.h"
+#include "../hampod_trace.h"
 #include <alsa/asoundlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 /* Default audio device - uses system default which should be configured for
  * dmix */
 static char audio_device[256] = "default";
 static int initialized = 0;
 
-/* Selected audio device info (from USB enumeration) */
-static AudioDeviceInfo selected_audio_device = {0};
+/* Selected audio device info (from USB enumeration); card -1 for none */
+static AudioDeviceInfo selected_audio_device = {.card_number = -1};
+
+/* Where the selected device is remembered across restarts, relative to
+ * $HOME unless set */
+#define AUDIO_DEVICE_FILE_ENV "HAMPOD_AUDIO_DEVICE_FILE"
+#define AUDIO_DEVICE_FILE_DEFAULT ".cache/hampod/audio_device"
+
+/* ALSA device to use instead of picking one, such as "null" (ALSA's null
+ * plugin: discards the audio, for soak tests without a sound card) */
+#define AUDIO_DEVICE_ENV "HAMPOD_AUDIO_DEVICE"
+
+/* 0 once hal_audio_set_device() has named the device: it is then only
+ * reopened, never picked again */
+static int device_auto = 1;
+
+/* Device monitor thread: reopens a lost device. A card that has just
+ * appeared may not be openable yet, so it is tried a few times; without
+ * uevents a lost device is retried on a timer. */
+#define AUDIO_DEVICE_ADD_TRIES 20
+#define AUDIO_DEVICE_ADD_WAIT_MS 25
+#define AUDIO_DEVICE_RETRY_MS 2000
+static pthread_t monitor_thread;
+static _Atomic int monitor_running = 0;
+static int monitor_fd = -1;                  /* Uevent socket, or -1 */
+static int monitor_wake[2] = {-1, -1};       /* Written to stop the thread */
+static _Atomic unsigned int stat_reopens = 0;
+/* Samples written to the device (hal_audio_progress()) */
+static _Atomic unsigned long long stat_written = 0;
+/* How long hal_audio_reopen() waits for the playback thread's write */
+#define AUDIO_REOPEN_WAIT_MS 200
 
 /* Direct ALSA PCM handle (replaces popen/aplay pipeline) */
 static snd_pcm_t *pcm_handle = NULL;
 
+/* Environment variable that asks for mmap access, and whether we got it */
+#define AUDIO_MMAP_ENV "HAMPOD_ALSA_MMAP"
+static int pcm_mmap = 0;
+
 /* Audio playback state for interrupt support */
 static volatile int audio_interrupted = 0;
 static volatile int audio_playing = 0;
@@ -43,146 +128,191 @@ static volatile int audio_playing = 0;
 #define AUDIO_CHUNK_BYTES                                                      \
   (AUDIO_CHUNK_SAMPLES * AUDIO_CHANNELS * AUDIO_BYTES_PER_SAMPLE)
 
-/* ============================================================================
- * RAM-Cached Beeps (Phase 2)
- * ============================================================================
- */
+/* PCM ring feeding the playback thread: ~2 s at 16kHz mono. The playback
+ * thread is the only consumer and reads it without locking; producers are
+ * serialised by ring_write_lock and publish under ring_lock, which also
+ * carries the sleep/wake condition variables for both ends. */
+#define AUDIO_RING_SAMPLES 32768 /* Power of two */
+#define AUDIO_RING_MASK (AUDIO_RING_SAMPLES - 1)
+
+static int16_t pcm_ring[AUDIO_RING_SAMPLES];
+static _Atomic uint32_t ring_head = 0;     /* Next sample producers fill */
+static _Atomic uint32_t ring_tail = 0;     /* Next sample the thread plays */
+static _Atomic uint32_t ring_flush_to = 0; /* Interrupt: skip up to here */
+static pthread_mutex_t ring_write_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t ring_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ring_data = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t ring_space = PTHREAD_COND_INITIALIZER;
+
+/* Segment queue: pieces of PCM played straight from their own buffers,
+ * so queueing one never waits for ring space. Each starts once the ring
+ * has been played up to its ring_pos, so segments and ring audio play in
+ * the order they were queued. Producers add at seg_head under ring_lock;
+ * only the playback thread retires and frees segments. */
+#define AUDIO_SEGMENT_MAX 64
 
-/* Beep file paths (relative to Firmware directory) */
-#ifndef BEEP_BASE_PATH
-#define BEEP_BASE_PATH "pregen_audio/"
-#endif
-
-#define BEEP_KEYPRESS_PATH BEEP_BASE_PATH "beep_keypress.wav"
-#define BEEP_HOLD_PATH BEEP_BASE_PATH "beep_hold.wav"
-#define BEEP_ERROR_PATH BEEP_BASE_PATH "beep_error.wav"
-
-/* Structure for caching audio in RAM */
 typedef struct {
-  int16_t *samples;   /* PCM data in memory */
-  size_t num_samples; /* Number of samples */
-  int loaded;         /* 1 if successfully loaded, 0 otherwise */
-} CachedAudio;
-
-/* Cached beep sounds */
-static CachedAudio beep_keypress = {0};
-static CachedAudio beep_hold = {0};
-static CachedAudio beep_error = {0};
-
-/**
- * @brief Load a WAV file into the cache
- *
- * Reads the WAV file, validates format, and stores PCM data in memory.
- *
- * @param filepath Path to WAV file
- * @param cache Pointer to CachedAudio structure to fill
- * @return 0 on success, -1 on failure
- */
-static int load_wav_to_cache(const char *filepath, CachedAudio *cache) {
-  FILE *wav_file;
-  uint8_t header[44];
-  uint32_t data_size;
-  uint32_t sample_rate;
-  uint16_t num_channels;
-  uint16_t bits_per_sample;
-  size_t samples_read;
-
-  if (cache == NULL)
-    return -1;
-
-  /* Clear existing cache */
-  if (cache->samples != NULL) {
-    free(cache->samples);
-    cache->samples = NULL;
-  }
-  cache->num_samples = 0;
-  cache->loaded = 0;
-
-  /* Open WAV file */
-  wav_file = fopen(filepath, "rb");
-  if (wav_file == NULL) {
-    fprintf(stderr, "HAL Audio: Cannot open beep file: %s\n", filepath);
-    return -1;
-  }
-
-  /* Read and parse WAV header */
-  if (fread(header, 1, 44, wav_file) != 44) {
-    fprintf(stderr, "HAL Audio: Failed to read WAV header: %s\n", filepath);
-    fclose(wav_file);
-    return -1;
-  }
-
-  /* Verify RIFF header */
-  if (memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0) {
-    fprintf(stderr, "HAL Audio: Not a valid WAV file: %s\n", filepath);
-    fclose(wav_file);
-    return -1;
-  }
-
-  /* Parse header fields */
-  num_channels = header[22] | (header[23] << 8);
-  sample_rate =
-      header[24] | (header[25] << 8) | (header[26] << 16) | (header[27] << 24);
-  bits_per_sample = header[34] | (header[35] << 8);
-  data_size =
-      header[40] | (header[41] << 8) | (header[42] << 16) | (header[43] << 24);
-
-  /* Validate format */
-  if (sample_rate != AUDIO_SAMPLE_RATE || num_channels != AUDIO_CHANNELS ||
-      bits_per_sample != 16) {
-    fprintf(stderr,
-            "HAL Audio: Beep format mismatch (rate=%u, ch=%u, bits=%u): %s\n",
-            sample_rate, num_channels, bits_per_sample, filepath);
-    fclose(wav_file);
-    return -1;
-  }
-
-  /* Allocate memory for samples */
-  cache->num_samples = data_size / 2; /* 16-bit = 2 bytes per sample */
-  cache->samples = (int16_t *)malloc(data_size);
-  if (cache->samples == NULL) {
-    fprintf(stderr, "HAL Audio: Failed to allocate memory for beep: %s\n",
-            filepath);
-    fclose(wav_file);
-    return -1;
+  int16_t *samples; /* Owned unless release is set; NULL for silence */
+  void (*release)(const int16_t *samples); /* Returns a borrowed buffer */
+  size_t num_samples;
+  size_t pos;        /* Next sample to play (playback thread) */
+  uint32_t ring_pos; /* Ring position it plays at */
+  int marker;        /* A hal_audio_queue_marker() marker, no audio */
+  unsigned int marker_id;
+} AudioSegment;
+
+static AudioSegment segments[AUDIO_SEGMENT_MAX];
+static uint32_t seg_head = 0;     /* Next slot producers fill */
+static uint32_t seg_tail = 0;     /* Oldest segment not yet retired */
+static uint32_t seg_flush_to = 0; /* Cancel: retire up to here */
+
+/* Markers the playback thread has reached or cancelled, oldest first, for
+ * hal_audio_wait_marker(). Queued and done markers together never pass
+ * AUDIO_SEGMENT_MAX. Guarded by ring_lock. */
+typedef struct {
+  unsigned int id;
+  int cancelled;
+} AudioMarker;
+
+static AudioMarker markers_done[AUDIO_SEGMENT_MAX];
+static uint32_t markers_done_head = 0;
+static uint32_t markers_done_tail = 0;
+static unsigned int markers_queued = 0;
+static pthread_cond_t marker_reached = PTHREAD_COND_INITIALIZER;
+
+static void segment_free(AudioSegment *seg) {
+  if (seg->release != NULL) {
+    seg->release(seg->samples);
+  } else {
+    hampod_free(seg->samples);
   }
+  seg->samples = NULL;
+  seg->release = NULL;
+}
 
-  /* Read PCM data */
-  samples_read = fread(cache->samples, 2, cache->num_samples, wav_file);
-  fclose(wav_file);
+/* Playback thread, and the lock it holds around its ALSA calls so the
+ * device can be reopened under it */
+static pthread_t playback_thread;
+static int playback_running = 0; /* Guarded by ring_lock */
+static pthread_mutex_t pcm_lock = PTHREAD_MUTEX_INITIALIZER;
 
-  if (samples_read != cache->num_samples) {
-    fprintf(stderr, "HAL Audio: Incomplete read (got %zu of %zu): %s\n",
-            samples_read, cache->num_samples, filepath);
-    free(cache->samples);
-    cache->samples = NULL;
-    cache->num_samples = 0;
-    return -1;
-  }
+/* ============================================================================
+ * Synthesized Beeps
+ * ============================================================================
+ */
 
-  cache->loaded = 1;
-  printf("HAL Audio: Cached beep: %s (%zu samples, %zu ms)\n", filepath,
-         cache->num_samples, (cache->num_samples * 1000) / AUDIO_SAMPLE_RATE);
-  return 0;
-}
+/* The tones generate_beeps.sh used to record, with a 5ms envelope */
+#define BEEP_DEFAULT_TONES                                                     \
+  {[BEEP_KEYPRESS] = {1000, 0, 50, 50, HAL_TONE_DEFAULT_RAMP_MS},              \
+   [BEEP_HOLD] = {700, 0, 50, 50, HAL_TONE_DEFAULT_RAMP_MS},                   \
+   [BEEP_ERROR] = {400, 0, 100, 50, HAL_TONE_DEFAULT_RAMP_MS}}
+#define BEEP_TYPES (BEEP_ERROR + 1)
+
+static const HalTone beep_defaults[BEEP_TYPES] = BEEP_DEFAULT_TONES;
+/* As set with hal_audio_set_beep(), guarded by ring_lock */
+static HalTone beep_tones[BEEP_TYPES] = BEEP_DEFAULT_TONES;
+
+/* Beep mixer: the playback thread writes in 10ms chunks and sums every
+ * active beep voice into each one (into silence when nothing else plays),
+ * so a beep starts within a chunk of being requested. Beeps and other
+ * one-shot tones are synthesized as they are mixed. New ones wait in
+ * beep_pending (guarded by ring_lock) until the thread picks them up; the
+ * voices themselves belong to the thread. */
+#define AUDIO_MIX_VOICES 4
+#define AUDIO_MIX_MS 10
+#define AUDIO_MIX_SAMPLES ((AUDIO_SAMPLE_RATE * AUDIO_MIX_MS) / 1000)
 
-/**
- * @brief Free cached audio memory
- */
-static void free_cached_audio(CachedAudio *cache) {
-  if (cache != NULL && cache->samples != NULL) {
-    free(cache->samples);
-    cache->samples = NULL;
-    cache->num_samples = 0;
-    cache->loaded = 0;
-  }
-}
+typedef struct {
+  const int16_t *samples; /* NULL for a synthesized tone */
+  size_t num_samples;
+  size_t pos;         /* Next sample to mix */
+  HalToneVoice synth; /* The tone, when samples is NULL */
+  int echo;           /* Keypad echo: the next echo replaces it */
+} MixVoice;
+
+static HalTone beep_pending[AUDIO_MIX_VOICES];
+static int beep_pending_count = 0;
+/* Keypad echo waiting for the thread (ring_lock), only the newest kept */
+static const int16_t *echo_pending_samples = NULL;
+static size_t echo_pending_count = 0;
+static MixVoice mix_voices[AUDIO_MIX_VOICES];
+static int mix_voice_count = 0;
+
+/* Tuning tone: a sine voice whose pitch glides to the target across each
+ * chunk and which fades in and out over one chunk, so neither a pitch
+ * change nor on/off clicks. The target is set from any thread; a target
+ * not refreshed for AUDIO_TONE_TIMEOUT_MS counts as off, so a tone is
+ * never left on by a Software that went away. Phase, pitch and level
+ * belong to the playback thread. */
+#define AUDIO_TONE_LEVEL 6000 /* Peak, about -15dBFS */
+#define AUDIO_TONE_TIMEOUT_MS 2000
+#define AUDIO_TONE_MIN_HZ 100
+#define AUDIO_TONE_MAX_HZ 4000
+static _Atomic int tone_target_hz = 0;
+static _Atomic long long tone_set_ms = 0;
+static uint32_t tone_phase = 0; /* A full turn is 2^32 */
+static int tone_hz = 0;
+static int32_t tone_level = 0;
+
+/* Set by an interrupt: the playback thread drops the ALSA buffer before
+ * its next write. Guarded by ring_lock. */
+static int pcm_drop_pending = 0;
+
+/* Software volume: Q15 gain on the mixed output. The target is set from
+ * any thread; the playback thread ramps its current gain towards it over
+ * one mix chunk. */
+#define AUDIO_GAIN_UNITY 32768
+static _Atomic int audio_volume = 100;
+static _Atomic int32_t gain_target = AUDIO_GAIN_UNITY;
+static int32_t gain_current = AUDIO_GAIN_UNITY; /* Playback thread only */
+
+/* Adaptive ALSA buffer: one step up after an underrun, one step down after
+ * a window of streamed audio whose worst wakeup delay (buffer size minus
+ * the lowest fill seen before a write) is under half the smaller size.
+ * Thread state is guarded by pcm_lock. */
+static const unsigned int buffer_steps_ms[] = {40, 60, 100, 150, 200, 300, 400};
+#define AUDIO_BUFFER_STEPS                                                     \
+  ((int)(sizeof(buffer_steps_ms) / sizeof(buffer_steps_ms[0])))
+#define AUDIO_BUFFER_DEFAULT_STEP 4 /* 200ms */
+#define AUDIO_ADAPT_WINDOW_SAMPLES (AUDIO_SAMPLE_RATE * 5)
+static int buffer_step = AUDIO_BUFFER_DEFAULT_STEP;
+static snd_pcm_uframes_t pcm_buffer_frames = 0; /* As granted by the device */
+static int pcm_streaming = 0; /* Last write left more audio to play */
+static size_t window_samples = 0;
+static snd_pcm_sframes_t window_min_fill = -1;
+
+static _Atomic unsigned int stat_underruns = 0;
+static _Atomic unsigned int stat_resizes = 0;
+static _Atomic unsigned int stat_buffer_ms = 0;
+static _Atomic unsigned int stat_min_fill_ms = 0;
+
+/* Keep-alive silence and ramp-in. Thread state is guarded by pcm_lock. */
+#define AUDIO_KEEPALIVE_DEFAULT_S 300
+#define AUDIO_KEEPALIVE_FILL_SAMPLES (AUDIO_SAMPLE_RATE * 40 / 1000)
+#define AUDIO_KEEPALIVE_TICK_MS 20
+#define AUDIO_RAMP_IN_SAMPLES (AUDIO_SAMPLE_RATE * 5 / 1000)
+static _Atomic int keep_alive_s = AUDIO_KEEPALIVE_DEFAULT_S;
+static struct timespec last_audio_time = {0}; /* Playback thread only */
+static snd_pcm_uframes_t silence_queued = 0;  /* Since the last audio */
+static int ramp_in_next = 1; /* Next audio starts from silence */
+static size_t ramp_in_pos = AUDIO_RAMP_IN_SAMPLES;
+
+/* Sound mark (hal_audio_mark_sound()): the first sample above
+ * AUDIO_SOUND_LEVEL queued from ring position mark_pos or segment mark_seg
+ * on is traced with mark_tag once written. Set under ring_lock; a new
+ * mark_gen arms it and the playback thread disarms it by catching up. */
+#define AUDIO_SOUND_LEVEL 256 /* About -42dBFS */
+static uint32_t mark_pos = 0;
+static uint32_t mark_seg = 0;
+static unsigned short mark_tag = 0;
+static uint32_t mark_gen = 0;
+static uint32_t mark_done_gen = 0; /* Playback thread only */
 
 /**
  * @brief Open the ALSA PCM device for direct audio output
  *
  * Uses snd_pcm_* API for low latency and interruptible playback.
- * Buffer size: 200ms total, 50ms periods - allows interrupt within 50ms
+ * Buffer size: the current adaptive step (200ms to start), in 4 periods
  *
  * @return 0 on success, -1 on failure
  */
@@ -209,9 +339,22 @@ static int open_pcm_device(void) {
   snd_pcm_hw_params_malloc(&hw_params);
   snd_pcm_hw_params_any(pcm_handle, hw_params);
 
-  /* Set access type: interleaved read/write */
-  err = snd_pcm_hw_params_set_access(pcm_handle, hw_params,
-                                     SND_PCM_ACCESS_RW_INTERLEAVED);
+  /* Set access type: interleaved mmap if asked for, else read/write */
+  const char *mmap_env = getenv(AUDIO_MMAP_ENV);
+  pcm_mmap = mmap_env != NULL && strcmp(mmap_env, "1") == 0;
+  if (pcm_mmap) {
+    err = snd_pcm_hw_params_set_access(pcm_handle, hw_params,
+                                       SND_PCM_ACCESS_MMAP_INTERLEAVED);
+    if (err < 0) {
+      fprintf(stderr, "HAL Audio: No mmap access (%s), using read/write\n",
+              snd_strerror(err));
+      pcm_mmap = 0;
+    }
+  }
+  if (!pcm_mmap) {
+    err = snd_pcm_hw_params_set_access(pcm_handle, hw_params,
+                                       SND_PCM_ACCESS_RW_INTERLEAVED);
+  }
   if (err < 0) {
     fprintf(stderr, "HAL Audio: Cannot set access type: %s\n",
             snd_strerror(err));
@@ -244,8 +387,8 @@ static int open_pcm_device(void) {
             AUDIO_SAMPLE_RATE);
   }
 
-  /* Set buffer size: 200ms = 3200 samples at 16kHz */
-  buffer_frames = AUDIO_SAMPLE_RATE / 5; /* 200ms */
+  /* Set buffer size: 200ms = 3200 samples at 16kHz to start */
+  buffer_frames = AUDIO_SAMPLE_RATE * buffer_steps_ms[buffer_step] / 1000;
   err = snd_pcm_hw_params_set_buffer_size_near(pcm_handle, hw_params,
                                                &buffer_frames);
   if (err < 0) {
@@ -254,7 +397,7 @@ static int open_pcm_device(void) {
     goto error;
   }
 
-  /* Set period size: 50ms = 800 samples (4 periods per buffer) */
+  /* Set period size: 50ms = 800 samples at first (4 periods per buffer) */
   period_frames = buffer_frames / 4;
   err = snd_pcm_hw_params_set_period_size_near(pcm_handle, hw_params,
                                                &period_frames, NULL);
@@ -280,10 +423,15 @@ static int open_pcm_device(void) {
     goto error;
   }
 
+  snd_pcm_hw_params_get_buffer_size(hw_params, &buffer_frames);
+  pcm_buffer_frames = buffer_frames;
+  atomic_store(&stat_buffer_ms, buffer_frames * 1000 / AUDIO_SAMPLE_RATE);
+
   snd_pcm_hw_params_free(hw_params);
   printf("HAL Audio: ALSA PCM device opened (device=%s, rate=%u, buffer=%lu, "
-         "period=%lu)\n",
-         audio_device, rate, buffer_frames, period_frames);
+         "period=%lu, access=%s)\n",
+         audio_device, rate, buffer_frames, period_frames,
+         pcm_mmap ? "mmap" : "rw");
   return 0;
 
 error:
@@ -293,47 +441,1153 @@ error:
     snd_pcm_close(pcm_handle);
     pcm_handle = NULL;
   }
-  return -1;
+  pcm_mmap = 0;
+  return -1;
+}
+
+/**
+ * @brief Close the ALSA PCM device
+ */
+static void close_pcm_device(void) {
+  if (pcm_handle != NULL) {
+    snd_pcm_drain(pcm_handle);
+    snd_pcm_close(pcm_handle);
+    pcm_handle = NULL;
+    pcm_mmap = 0;
+    printf("HAL Audio: PCM device closed\n");
+  }
+}
+
+/* ============================================================================
+ * PCM Ring and Playback Thread
+ * ============================================================================
+ */
+
+/**
+ * @brief Reopen the PCM device with the buffer size of another step
+ *
+ * Call with pcm_lock held, only while the ALSA buffer holds nothing worth
+ * keeping. Returns to the old size if the device refuses the new one.
+ *
+ * @return 0 on success, -1 if the device could not be reopened
+ */
+static int pcm_resize(int step) {
+  int old_step = buffer_step;
+  unsigned int old_ms = atomic_load(&stat_buffer_ms);
+  snd_pcm_drop(pcm_handle);
+  snd_pcm_close(pcm_handle);
+  pcm_handle = NULL;
+
+  buffer_step = step;
+  if (open_pcm_device() != 0) {
+    buffer_step = old_step;
+    if (open_pcm_device() != 0) {
+      return -1;
+    }
+  }
+  HAMPOD_LOG(1, "HAL Audio: Buffer %u -> %u ms (%u underruns)\n", old_ms,
+             atomic_load(&stat_buffer_ms), atomic_load(&stat_underruns));
+  atomic_fetch_add(&stat_resizes, 1);
+  window_samples = 0;
+  window_min_fill = -1;
+  return 0;
+}
+
+/**
+ * @brief Whether the last window was healthy enough to shrink the buffer
+ */
+static int shrink_due(void) {
+  if (buffer_step == 0 || window_samples < AUDIO_ADAPT_WINDOW_SAMPLES ||
+      window_min_fill < 0) {
+    return 0;
+  }
+  snd_pcm_sframes_t worst_wait =
+      (snd_pcm_sframes_t)pcm_buffer_frames - window_min_fill;
+  snd_pcm_sframes_t smaller =
+      AUDIO_SAMPLE_RATE * buffer_steps_ms[buffer_step - 1] / 1000;
+  return worst_wait * 2 < smaller;
+}
+
+/**
+ * @brief Note how full the ALSA buffer is before a streaming write
+ *
+ * Call with pcm_lock held. The first write after running dry is skipped:
+ * the buffer was meant to be empty.
+ */
+static void measure_fill(size_t samples) {
+  snd_pcm_sframes_t fill = 0;
+  if (!pcm_streaming || pcm_handle == NULL ||
+      snd_pcm_delay(pcm_handle, &fill) < 0) {
+    return;
+  }
+  if (window_min_fill < 0 || fill < window_min_fill) {
+    window_min_fill = fill < 0 ? 0 : fill;
+    atomic_store(&stat_min_fill_ms,
+                 (unsigned int)(window_min_fill * 1000 / AUDIO_SAMPLE_RATE));
+  }
+  window_samples += samples;
+}
+
+/**
+ * @brief Recover from a write error, resizing the buffer at an xrun
+ *
+ * Call with pcm_lock held. An xrun while audio was still queued is an
+ * underrun and grows the buffer a step; an xrun after running dry is the
+ * normal end of playback, and its empty buffer is when a due shrink is
+ * taken. A device that was unplugged is closed.
+ *
+ * @return 0 once writing can continue, negative error code otherwise
+ */
+static int playback_recover(int err) {
+  if (err == -EPIPE) {
+    if (pcm_streaming) {
+      atomic_fetch_add(&stat_underruns, 1);
+      if (buffer_step + 1 < AUDIO_BUFFER_STEPS &&
+          pcm_resize(buffer_step + 1) == 0) {
+        return 0;
+      }
+      window_samples = 0;
+      window_min_fill = -1;
+    } else if (shrink_due() && pcm_resize(buffer_step - 1) == 0) {
+      return 0;
+    }
+  }
+  if (pcm_handle == NULL) {
+    return -ENODEV;
+  }
+  err = snd_pcm_recover(pcm_handle, err, 0);
+  if (err == -ENODEV ||
+      snd_pcm_state(pcm_handle) == SND_PCM_STATE_DISCONNECTED) {
+    /* Unplugged: the device monitor reopens it when it is back */
+    HAMPOD_LOG(2, "HAL Audio: Device %s is gone\n", audio_device);
+    snd_pcm_close(pcm_handle);
+    pcm_handle = NULL;
+    pcm_mmap = 0;
+    return -ENODEV;
+  }
+  return err;
+}
+
+/**
+ * @brief Write samples to ALSA from the playback thread
+ *
+ * Call with pcm_lock held. A device left dropped is prepared again first.
+ *
+ * @return 0 on success, -1 on failure
+ */
+static int playback_write(const int16_t *samples, size_t num_samples) {
+  if (pcm_handle == NULL) {
+    return -1;
+  }
+  if (snd_pcm_state(pcm_handle) == SND_PCM_STATE_SETUP) {
+    snd_pcm_prepare(pcm_handle); /* Dropped by an interrupt */
+  }
+
+  while (num_samples > 0) {
+    snd_pcm_sframes_t frames = snd_pcm_writei(pcm_handle, samples, num_samples);
+    if (frames < 0) {
+      if (snd_pcm_state(pcm_handle) == SND_PCM_STATE_SETUP) {
+        snd_pcm_prepare(pcm_handle);
+        return 0;
+      }
+      frames = playback_recover((int)frames);
+      if (frames < 0) {
+        HAMPOD_LOG(2, "HAL Audio: Write failed: %s\n", snd_strerror(frames));
+        return -1;
+      }
+      continue;
+    }
+    samples += frames;
+    num_samples -= frames;
+  }
+  return 0;
+}
+
+/**
+ * @brief Oldest unplayed ring position, after any interrupt flush
+ *
+ * Playback thread only.
+ */
+static uint32_t ring_consume_from(void) {
+  uint32_t tail = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+  uint32_t flush_to =
+      atomic_load_explicit(&ring_flush_to, memory_order_acquire);
+  if ((int32_t)(flush_to - tail) > 0) {
+    tail = flush_to;
+    atomic_store_explicit(&ring_tail, tail, memory_order_release);
+  }
+  return tail;
+}
+
+/**
+ * @brief Retire played and cancelled segments and return the next one
+ *
+ * A marker is retired, and handed to hal_audio_wait_marker(), once the
+ * ring has been played up to it. Call with ring_lock held, from the
+ * playback thread.
+ *
+ * @param tail Next ring sample to play
+ * @return Oldest segment still to play or marker still to reach, or NULL
+ *         if none is queued
+ */
+static AudioSegment *segment_consume_from(uint32_t tail) {
+  while (seg_tail != seg_head) {
+    AudioSegment *seg = &segments[seg_tail % AUDIO_SEGMENT_MAX];
+    int cancelled = (int32_t)(seg_flush_to - seg_tail) > 0;
+    if (!cancelled && (seg->marker ? (int32_t)(tail - seg->ring_pos) < 0
+                                   : seg->pos < seg->num_samples)) {
+      return seg;
+    }
+    if (seg->marker) {
+      AudioMarker *done =
+          &markers_done[markers_done_head++ % AUDIO_SEGMENT_MAX];
+      done->id = seg->marker_id;
+      done->cancelled = cancelled;
+      seg->marker = 0;
+      markers_queued--;
+      pthread_cond_broadcast(&marker_reached);
+    }
+    segment_free(seg);
+    seg_tail++;
+  }
+  return NULL;
+}
+
+/**
+ * @brief Where a voice is, in samples mixed
+ */
+static size_t *mix_voice_pos(MixVoice *voice) {
+  return voice->samples != NULL ? &voice->pos : &voice->synth.pos;
+}
+
+/**
+ * @brief A voice to start a new sound on
+ *
+ * With every voice busy, the one furthest along is replaced.
+ */
+static MixVoice *mix_free_voice(void) {
+  int slot = mix_voice_count;
+  if (slot == AUDIO_MIX_VOICES) {
+    slot = 0;
+    for (int v = 1; v < mix_voice_count; v++) {
+      if (*mix_voice_pos(&mix_voices[v]) >
+          *mix_voice_pos(&mix_voices[slot])) {
+        slot = v;
+      }
+    }
+  } else {
+    mix_voice_count++;
+  }
+  return &mix_voices[slot];
+}
+
+/**
+ * @brief Start mixing the beeps and echo requested since the last chunk
+ *
+ * Call with ring_lock held. A new echo takes over the voice of the one
+ * still playing, cutting it off.
+ */
+static void mix_take_beeps(void) {
+  for (int i = 0; i < beep_pending_count; i++) {
+    MixVoice *voice = mix_free_voice();
+    voice->samples = NULL;
+    hal_tone_start(&voice->synth, &beep_pending[i]);
+    voice->echo = 0;
+  }
+  beep_pending_count = 0;
+
+  if (echo_pending_samples != NULL) {
+    MixVoice *voice = NULL;
+    for (int v = 0; v < mix_voice_count && voice == NULL; v++) {
+      if (mix_voices[v].echo) {
+        voice = &mix_voices[v];
+      }
+    }
+    if (voice == NULL) {
+      voice = mix_free_voice();
+    }
+    voice->samples = echo_pending_samples;
+    voice->num_samples = echo_pending_count;
+    voice->pos = 0;
+    voice->echo = 1;
+    echo_pending_samples = NULL;
+  }
+}
+
+/**
+ * @brief Sum the active beep voices into out, saturating at the int16 range
+ *
+ * Voices that reach their end are retired.
+ */
+static void mix_beeps(int16_t *out, size_t count) {
+  int v = 0;
+  while (v < mix_voice_count) {
+    MixVoice *voice = &mix_voices[v];
+    if (voice->samples == NULL) {
+      if (hal_tone_mix(&voice->synth, out, count) == 0) {
+        mix_voices[v] = mix_voices[--mix_voice_count];
+      } else {
+        v++;
+      }
+      continue;
+    }
+    size_t n = voice->num_samples - voice->pos;
+    if (n > count) {
+      n = count;
+    }
+    for (size_t i = 0; i < n; i++) {
+      int32_t sum = (int32_t)out[i] + voice->samples[voice->pos + i];
+      if (sum > INT16_MAX) {
+        sum = INT16_MAX;
+      } else if (sum < INT16_MIN) {
+        sum = INT16_MIN;
+      }
+      out[i] = (int16_t)sum;
+    }
+    voice->pos += n;
+    if (voice->pos >= voice->num_samples) {
+      mix_voices[v] = mix_voices[--mix_voice_count];
+    } else {
+      v++;
+    }
+  }
+}
+
+static long long monotonic_ms(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Tone pitch wanted now, 0 for off or a target gone stale
+ */
+static int tone_target(void) {
+  int hz = atomic_load_explicit(&tone_target_hz, memory_order_relaxed);
+  if (hz > 0 && monotonic_ms() - atomic_load(&tone_set_ms) >
+                    AUDIO_TONE_TIMEOUT_MS) {
+    return 0;
+  }
+  return hz;
+}
+
+/**
+ * @brief Whether a beep or the tone still needs chunks written
+ *
+ * Playback thread only (or with ring_lock held, for the beep count).
+ */
+static int mix_active(void) {
+  return mix_voice_count > 0 || tone_level > 0 || tone_target() > 0;
+}
+
+/**
+ * @brief Sum the tuning tone into out, saturating at the int16 range
+ *
+ * Pitch and level move linearly from where the last chunk left them to
+ * the current target.
+ */
+static void mix_tone(int16_t *out, size_t count) {
+  int target = tone_target();
+  int32_t start_hz = tone_level > 0 ? tone_hz : target;
+  int32_t end_hz = target > 0 ? target : start_hz; /* Fade out in pitch */
+  int32_t start_level = tone_level;
+  int32_t end_level = target > 0 ? AUDIO_TONE_LEVEL : 0;
+
+  for (size_t i = 0; i < count; i++) {
+    int64_t step = (int64_t)(i + 1);
+    int32_t hz =
+        start_hz + (int32_t)((end_hz - start_hz) * step / (int64_t)count);
+    int32_t level = start_level + (int32_t)((end_level - start_level) * step /
+                                            (int64_t)count);
+    tone_phase += (uint32_t)(((uint64_t)hz << 32) / AUDIO_SAMPLE_RATE);
+    int32_t sum = (int32_t)out[i] + hal_tone_sine(tone_phase, level);
+    if (sum > INT16_MAX) {
+      sum = INT16_MAX;
+    } else if (sum < INT16_MIN) {
+      sum = INT16_MIN;
+    }
+    out[i] = (int16_t)sum;
+  }
+  tone_hz = end_hz;
+  tone_level = end_level;
+}
+
+/**
+ * @brief Scale the mixed output by the volume gain
+ *
+ * A changed volume is ramped linearly across this chunk so it does not
+ * click; a steady gain below unity is a rounding Q15 multiply.
+ */
+static void apply_gain(int16_t *out, size_t count) {
+  int32_t target = atomic_load_explicit(&gain_target, memory_order_relaxed);
+
+  if (target != gain_current) {
+    int32_t start = gain_current;
+    for (size_t i = 0; i < count; i++) {
+      int32_t gain = start + (int32_t)((target - start) * (int64_t)(i + 1) /
+                                       (int64_t)count);
+      out[i] = (int16_t)((out[i] * gain + 16384) >> 15);
+    }
+    gain_current = target;
+    return;
+  }
+
+  if (gain_current == AUDIO_GAIN_UNITY) {
+    return;
+  }
+  if (gain_current == 0) {
+    memset(out, 0, count * sizeof(int16_t));
+    return;
+  }
+
+  size_t i = 0;
+#if defined(__ARM_NEON)
+  int16x8_t gain = vdupq_n_s16((int16_t)gain_current);
+  for (; i + 8 <= count; i += 8) {
+    vst1q_s16(out + i, vqrdmulhq_s16(vld1q_s16(out + i), gain));
+  }
+#endif
+  for (; i < count; i++) {
+    out[i] = (int16_t)((out[i] * gain_current + 16384) >> 15);
+  }
+}
+
+/* The audio of one output chunk: count frames from up to two spans (the
+ * ring wraps, a segment is one span), followed by silence */
+typedef struct {
+  const int16_t *span[2];
+  size_t span_len[2];
+  size_t count;
+} ChunkSource;
+
+/**
+ * @brief Build frames [from, from + n) of an output chunk
+ *
+ * Frames past the source's count are silence; active beeps and the tone
+ * are mixed in and the volume gain applied.
+ */
+static void fill_chunk(int16_t *out, const ChunkSource *src, size_t from,
+                       size_t n) {
+  size_t audio = from < src->count ? src->count - from : 0;
+  if (audio > n) {
+    audio = n;
+  }
+  size_t at = from;
+  size_t done = 0;
+  for (int i = 0; i < 2 && done < audio; i++) {
+    if (at >= src->span_len[i]) {
+      at -= src->span_len[i];
+      continue;
+    }
+    size_t k = src->span_len[i] - at;
+    if (k > audio - done) {
+      k = audio - done;
+    }
+    memcpy(out + done, src->span[i] + at, k * sizeof(int16_t));
+    done += k;
+    at = 0;
+  }
+  memset(out + audio, 0, (n - audio) * sizeof(int16_t));
+
+  if (mix_voice_count > 0) {
+    mix_beeps(out, n);
+  }
+  if (tone_level > 0 || tone_target() > 0) {
+    mix_tone(out, n);
+  }
+  apply_gain(out, n);
+
+  for (size_t i = 0; i < audio && ramp_in_pos < AUDIO_RAMP_IN_SAMPLES;
+       i++, ramp_in_pos++) {
+    out[i] = (int16_t)(out[i] * (int32_t)ramp_in_pos / AUDIO_RAMP_IN_SAMPLES);
+  }
+#ifdef USE_REMOTE_AUDIO
+  hal_audio_stream_feed(out, n);
+#endif
+}
+
+/**
+ * @brief Build a chunk directly in the mmap'd ALSA buffer
+ *
+ * Call with pcm_lock held. Same contract as playback_write(), but the
+ * chunk is filled in place, so there is no local copy and no writei().
+ * Mono S16 interleaved areas are contiguous, one int16_t per frame.
+ *
+ * @return 0 on success, -1 on failure
+ */
+static int playback_write_mmap(const ChunkSource *src, size_t mixed) {
+  if (pcm_handle == NULL) {
+    return -1;
+  }
+  if (snd_pcm_state(pcm_handle) == SND_PCM_STATE_SETUP) {
+    snd_pcm_prepare(pcm_handle); /* Dropped by an interrupt */
+  }
+
+  size_t done = 0;
+  while (done < mixed) {
+    snd_pcm_sframes_t avail = snd_pcm_avail_update(pcm_handle);
+    if (avail < 0) {
+      int err = playback_recover((int)avail);
+      if (err < 0) {
+        HAMPOD_LOG(2, "HAL Audio: Write failed: %s\n", snd_strerror(err));
+        return -1;
+      }
+      continue;
+    }
+    if (avail == 0) {
+      /* Buffer full: it only drains once started */
+      if (snd_pcm_state(pcm_handle) == SND_PCM_STATE_PREPARED) {
+        snd_pcm_start(pcm_handle);
+      }
+      snd_pcm_wait(pcm_handle, 100);
+      continue;
+    }
+
+    const snd_pcm_channel_area_t *areas;
+    snd_pcm_uframes_t offset;
+    snd_pcm_uframes_t frames = mixed - done;
+    if (frames > (snd_pcm_uframes_t)avail) {
+      frames = (snd_pcm_uframes_t)avail;
+    }
+    int err = snd_pcm_mmap_begin(pcm_handle, &areas, &offset, &frames);
+    if (err < 0) {
+      if (playback_recover(err) < 0) {
+        HAMPOD_LOG(2, "HAL Audio: mmap failed: %s\n", snd_strerror(err));
+        return -1;
+      }
+      continue;
+    }
+
+    int16_t *out = (int16_t *)((char *)areas[0].addr +
+                               (areas[0].first + offset * areas[0].step) / 8);
+    fill_chunk(out, src, done, frames);
+
+    snd_pcm_sframes_t committed =
+        snd_pcm_mmap_commit(pcm_handle, offset, frames);
+    if (committed < 0 || (snd_pcm_uframes_t)committed != frames) {
+      /* The frames are lost with the xrun; carry on with the rest */
+      err = committed < 0 ? (int)committed : -EPIPE;
+      if (playback_recover(err) < 0) {
+        HAMPOD_LOG(2, "HAL Audio: Commit failed: %s\n", snd_strerror(err));
+        return -1;
+      }
+    }
+    done += frames;
+  }
+  return 0;
+}
+
+/**
+ * @brief Drop the ALSA buffer for an interrupt
+ *
+ * Call with pcm_lock held. Beep samples still in the buffer would be lost
+ * with it, so each beep voice is wound back by what had not been heard
+ * yet - a keypress beep survives the interrupt its key press caused.
+ */
+static void playback_drop(void) {
+#ifdef USE_REMOTE_AUDIO
+  hal_audio_stream_flush();
+#endif
+  if (pcm_handle == NULL) {
+    return;
+  }
+  snd_pcm_sframes_t delay = 0;
+  if (snd_pcm_delay(pcm_handle, &delay) < 0 || delay < 0) {
+    delay = 0;
+  }
+  snd_pcm_drop(pcm_handle);
+  snd_pcm_prepare(pcm_handle);
+  pcm_streaming = 0;
+  silence_queued = 0;
+  ramp_in_next = 1;
+  if (shrink_due()) {
+    pcm_resize(buffer_step - 1); /* The buffer is empty now */
+  }
+
+  for (int v = 0; v < mix_voice_count; v++) {
+    size_t *pos = mix_voice_pos(&mix_voices[v]);
+    *pos = *pos > (size_t)delay ? *pos - (size_t)delay : 0;
+  }
+}
+
+/**
+ * @brief Whether the keep-alive still holds the PCM open
+ *
+ * Playback thread only.
+ */
+static int keep_alive_due(void) {
+  int seconds = atomic_load(&keep_alive_s);
+  if (seconds <= 0 || last_audio_time.tv_sec == 0) {
+    return 0;
+  }
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec - last_audio_time.tv_sec < seconds;
+}
+
+/**
+ * @brief Top the ALSA buffer up with silence so the PCM keeps running
+ *
+ * Call with pcm_lock held.
+ */
+static void keep_alive_feed(void) {
+  static const int16_t silence[AUDIO_KEEPALIVE_FILL_SAMPLES];
+  if (pcm_handle == NULL) {
+    return;
+  }
+  snd_pcm_sframes_t fill = 0;
+  if (snd_pcm_delay(pcm_handle, &fill) < 0 || fill < 0) {
+    fill = 0; /* Stopped or ran dry: writing recovers it */
+  }
+  if (fill >= AUDIO_KEEPALIVE_FILL_SAMPLES) {
+    return;
+  }
+
+  size_t frames = AUDIO_KEEPALIVE_FILL_SAMPLES - (size_t)fill;
+  static const ChunkSource none = {{NULL, NULL}, {0, 0}, 0};
+  int rc = pcm_mmap ? playback_write_mmap(&none, frames)
+                    : playback_write(silence, frames);
+  if (rc == 0) {
+    silence_queued += frames;
+    ramp_in_next = 1;
+  }
+  if (pcm_handle != NULL &&
+      snd_pcm_state(pcm_handle) == SND_PCM_STATE_PREPARED) {
+    snd_pcm_start(pcm_handle);
+  }
+}
+
+/**
+ * @brief Take back keep-alive silence that has not played yet
+ *
+ * Call with pcm_lock held, before writing real audio, so it plays next
+ * instead of after the silence. One mix chunk is left to cover the write.
+ */
+static void keep_alive_rewind(void) {
+  if (silence_queued == 0 || pcm_handle == NULL) {
+    return;
+  }
+  snd_pcm_sframes_t back = snd_pcm_rewindable(pcm_handle);
+  if (back > (snd_pcm_sframes_t)silence_queued) {
+    back = (snd_pcm_sframes_t)silence_queued;
+  }
+  back -= AUDIO_MIX_SAMPLES;
+  if (back > 0) {
+    snd_pcm_rewind(pcm_handle, (snd_pcm_uframes_t)back);
+  }
+  silence_queued = 0;
+}
+
+/**
+ * @brief Playback thread: move ring audio, with beeps mixed in, into ALSA
+ *
+ * Runs until hal_audio_cleanup(), playing out what is left in the ring
+ * (and any beep still sounding) before it exits. While the tone is on it
+ * keeps writing chunks, paced by the device.
+ */
+/**
+ * @brief Whether the chunk has a sample above AUDIO_SOUND_LEVEL at or
+ *        after frame skip
+ */
+static int chunk_has_sound(const ChunkSource *src, size_t skip) {
+  for (int i = 0; i < 2; i++) {
+    for (size_t n = skip; n < src->span_len[i]; n++) {
+      int sample = src->span[i][n];
+      if (sample > AUDIO_SOUND_LEVEL || sample < -AUDIO_SOUND_LEVEL) {
+        return 1;
+      }
+    }
+    skip = skip > src->span_len[i] ? skip - src->span_len[i] : 0;
+  }
+  return 0;
+}
+
+static void *playback_thread_func(void *arg) {
+  int16_t mix_buffer[AUDIO_MIX_SAMPLES];
+  (void)arg;
+  hampod_metrics_name_thread("audio-playback");
+
+  for (;;) {
+    pthread_mutex_lock(&ring_lock);
+    uint32_t tail = ring_consume_from();
+    AudioSegment *seg = segment_consume_from(tail);
+    mix_take_beeps();
+    int feed_silence = 0;
+    while (playback_running && !pcm_drop_pending && !mix_active() &&
+           seg == NULL &&
+           atomic_load_explicit(&ring_head, memory_order_acquire) == tail) {
+      audio_playing = 0;
+      if (keep_alive_due()) {
+        struct timespec wake;
+        clock_gettime(CLOCK_REALTIME, &wake);
+        wake.tv_nsec += AUDIO_KEEPALIVE_TICK_MS * 1000000L;
+        if (wake.tv_nsec >= 1000000000L) {
+          wake.tv_sec++;
+          wake.tv_nsec -= 1000000000L;
+        }
+        if (pthread_cond_timedwait(&ring_data, &ring_lock, &wake) ==
+            ETIMEDOUT) {
+          hampod_metric_add(METRIC_IDLE_WAKEUPS, 1);
+          feed_silence = 1;
+          break;
+        }
+      } else {
+        pthread_cond_wait(&ring_data, &ring_lock);
+      }
+      tail = ring_consume_from();
+      seg = segment_consume_from(tail);
+      mix_take_beeps();
+    }
+    int drop = pcm_drop_pending;
+    pcm_drop_pending = 0;
+    int stopping = !playback_running;
+    uint32_t head = atomic_load_explicit(&ring_head, memory_order_acquire);
+    int later_segments = seg != NULL && seg_head - seg_tail > 1;
+    uint32_t seg_index = seg_tail;
+    uint32_t gen = mark_gen;
+    uint32_t sound_pos = mark_pos;
+    uint32_t sound_seg = mark_seg;
+    unsigned short sound_tag = mark_tag;
+    pthread_mutex_unlock(&ring_lock);
+
+    if (drop) {
+      pthread_mutex_lock(&pcm_lock);
+      playback_drop();
+      pthread_mutex_unlock(&pcm_lock);
+    }
+    /* Stopping, the tone is dropped and only beeps play out */
+    if (head == tail && seg == NULL &&
+        (stopping ? mix_voice_count == 0 : !mix_active())) {
+      if (stopping) {
+        break; /* Stopped and nothing left to play */
+      }
+      if (feed_silence || (drop && keep_alive_due())) {
+        pthread_mutex_lock(&pcm_lock);
+        keep_alive_feed();
+        pthread_mutex_unlock(&pcm_lock);
+      }
+      continue;
+    }
+    audio_playing = 1;
+
+    /* Play one chunk, of the due segment or else of the ring, so
+     * producers can refill the ring while this one plays and an interrupt
+     * or beep gets in between chunks */
+    ChunkSource src = {{NULL, NULL}, {0, 0}, 0};
+    uint32_t count = 0;    /* Ring samples consumed */
+    size_t seg_frames = 0; /* Segment samples consumed */
+    size_t mixed;
+    if (seg != NULL && (int32_t)(tail - seg->ring_pos) >= 0) {
+      seg_frames = seg->num_samples - seg->pos;
+      if (seg_frames > AUDIO_MIX_SAMPLES) {
+        seg_frames = AUDIO_MIX_SAMPLES;
+      }
+      if (seg->samples != NULL) {
+        src.span[0] = seg->samples + seg->pos;
+        src.span_len[0] = seg_frames;
+        src.count = seg_frames;
+      }
+      mixed = seg_frames;
+    } else {
+      count = head - tail;
+      if (count > AUDIO_MIX_SAMPLES) {
+        count = AUDIO_MIX_SAMPLES;
+      }
+      if (seg != NULL && count > seg->ring_pos - tail) {
+        count = seg->ring_pos - tail; /* The segment plays next */
+      }
+      uint32_t offset = tail & AUDIO_RING_MASK;
+      size_t first = count;
+      if (first > AUDIO_RING_SAMPLES - offset) {
+        first = AUDIO_RING_SAMPLES - offset;
+      }
+      src.span[0] = &pcm_ring[offset];
+      src.span_len[0] = first;
+      src.span[1] = pcm_ring;
+      src.span_len[1] = count - first;
+      src.count = count;
+      /* A beep or the tone plays over silence once the ring runs short */
+      mixed = mix_active() && seg == NULL ? AUDIO_MIX_SAMPLES : count;
+    }
+
+    pthread_mutex_lock(&pcm_lock);
+    keep_alive_rewind();
+    if (pcm_handle != NULL && snd_pcm_state(pcm_handle) == SND_PCM_STATE_XRUN) {
+      ramp_in_next = 1; /* Ran dry */
+    }
+    if (ramp_in_next && src.count > 0) {
+      ramp_in_pos = 0;
+      ramp_in_next = 0;
+    }
+    measure_fill(mixed);
+    int written;
+    if (pcm_mmap) {
+      written = playback_write_mmap(&src, mixed);
+    } else {
+      fill_chunk(mix_buffer, &src, 0, mixed);
+      written = playback_write(mix_buffer, mixed);
+    }
+    if (seg_frames > 0 && seg->samples == NULL) {
+      ramp_in_next = 1; /* Audio after a gap starts from silence */
+    }
+    if (written == 0) {
+      atomic_fetch_add_explicit(&stat_written, mixed, memory_order_relaxed);
+    }
+
+    /* Ran dry: make sure a short tail below the start threshold plays */
+    pcm_streaming = mix_active() || later_segments ||
+                    (seg != NULL && seg->pos + seg_frames < seg->num_samples) ||
+                    atomic_load_explicit(&ring_head, memory_order_acquire) !=
+                        tail + count;
+    if (pcm_handle != NULL && !pcm_streaming &&
+        snd_pcm_state(pcm_handle) == SND_PCM_STATE_PREPARED) {
+      snd_pcm_start(pcm_handle);
+    }
+    pthread_mutex_unlock(&pcm_lock);
+    if (src.count > 0 && written == 0 && gen != mark_done_gen) {
+      /* The marked request's audio is what follows the mark */
+      int after = seg_frames > 0
+                      ? (int32_t)(seg_index - sound_seg) >= 0
+                      : (int32_t)(tail + count - sound_pos) > 0;
+      size_t skip = seg_frames == 0 && (int32_t)(sound_pos - tail) > 0
+                        ? sound_pos - tail
+                        : 0;
+      if (after && chunk_has_sound(&src, skip)) {
+        hampod_trace(TRACE_AUDIO_SOUND, sound_tag, 0, 0);
+        mark_done_gen = gen;
+      }
+    }
+    if (src.count > 0) {
+      clock_gettime(CLOCK_MONOTONIC, &last_audio_time);
+    } else if (written != 0) {
+      /* No device to pace a tone: don't spin until it is back */
+      struct timespec pause = {0, AUDIO_MIX_MS * 1000000L};
+      nanosleep(&pause, NULL);
+    }
+    if (seg_frames > 0) {
+      seg->pos += seg_frames;
+    }
+
+    /* Producers may refill the chunk's ring space now */
+    atomic_store_explicit(&ring_tail, tail + count, memory_order_release);
+    pthread_mutex_lock(&ring_lock);
+    pthread_cond_broadcast(&ring_space);
+    pthread_mutex_unlock(&ring_lock);
+  }
+
+  audio_playing = 0;
+  return NULL;
+}
+
+/**
+ * @brief Queue samples for the playback thread
+ *
+ * Waits for room while the ring is full. Samples written after an
+ * interrupt (until hal_audio_clear_interrupt()) are silently dropped.
+ *
+ * @return 0 on success, -1 if the playback thread is not running
+ */
+static int ring_write(const int16_t *samples, size_t num_samples) {
+  int result = 0;
+
+  pthread_mutex_lock(&ring_write_lock);
+  while (num_samples > 0 && !audio_interrupted) {
+    uint32_t head = atomic_load_explicit(&ring_head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring_tail, memory_order_acquire);
+    uint32_t space = AUDIO_RING_SAMPLES - (head - tail);
+    if (space == 0) {
+      pthread_mutex_lock(&ring_lock);
+      while (playback_running && !audio_interrupted &&
+             atomic_load_explicit(&ring_tail, memory_order_acquire) == tail) {
+        pthread_cond_wait(&ring_space, &ring_lock);
+      }
+      int stopped = !playback_running;
+      pthread_mutex_unlock(&ring_lock);
+      if (stopped) {
+        result = -1;
+        break;
+      }
+      continue;
+    }
+
+    uint32_t offset = head & AUDIO_RING_MASK;
+    uint32_t count = num_samples < space ? (uint32_t)num_samples : space;
+    if (count > AUDIO_RING_SAMPLES - offset) {
+      count = AUDIO_RING_SAMPLES - offset;
+    }
+    memcpy(&pcm_ring[offset], samples, count * sizeof(int16_t));
+
+    /* Publish under ring_lock so an interrupt's flush point can never
+     * land in front of samples it meant to drop */
+    pthread_mutex_lock(&ring_lock);
+    if (!playback_running) {
+      result = -1;
+    } else if (!audio_interrupted) {
+      atomic_store_explicit(&ring_head, head + count, memory_order_release);
+      pthread_cond_signal(&ring_data);
+    }
+    pthread_mutex_unlock(&ring_lock);
+    if (result != 0) {
+      break;
+    }
+    samples += count;
+    num_samples -= count;
+  }
+  pthread_mutex_unlock(&ring_write_lock);
+  return result;
 }
 
 /**
- * @brief Close the ALSA PCM device
+ * @brief Add a segment to the queue, taking ownership of samples
+ *
+ * samples is NULL for silence. With release set the buffer is borrowed:
+ * release() is called instead of free() once it is done with, and on
+ * failure the caller keeps it. Segments queued after an interrupt (until
+ * hal_audio_clear_interrupt()) are dropped, as ring audio is.
+ *
+ * @return 0 on success, -1 if the queue is full or playback is stopped
  */
-static void close_pcm_device(void) {
-  if (pcm_handle != NULL) {
-    snd_pcm_drain(pcm_handle);
-    snd_pcm_close(pcm_handle);
-    pcm_handle = NULL;
-    printf("HAL Audio: PCM device closed\n");
+static int segment_push(int16_t *samples, size_t num_samples,
+                        void (*release)(const int16_t *samples)) {
+  int result = 0;
+  pthread_mutex_lock(&ring_lock);
+  if (!playback_running) {
+    result = -1;
+  } else if (seg_head - seg_tail == AUDIO_SEGMENT_MAX) {
+    HAMPOD_LOG(2, "HAL Audio: Segment queue full\n");
+    result = -1;
+  } else if (!audio_interrupted) {
+    AudioSegment *seg = &segments[seg_head % AUDIO_SEGMENT_MAX];
+    seg->samples = samples;
+    seg->release = release;
+    seg->num_samples = num_samples;
+    seg->pos = 0;
+    seg->ring_pos = atomic_load_explicit(&ring_head, memory_order_relaxed);
+    seg->marker = 0;
+    seg_head++;
+    samples = NULL;
+    pthread_cond_signal(&ring_data);
+  }
+  pthread_mutex_unlock(&ring_lock);
+  if (release == NULL) {
+    hampod_free(samples);
+  } else if (samples != NULL && result == 0) {
+    release(samples); /* Dropped after an interrupt */
+  }
+  return result;
+}
+
+/**
+ * @brief Drop everything queued, and the ALSA buffer with it
+ *
+ * Call with ring_lock held.
+ */
+static void flush_queued(void) {
+  atomic_store_explicit(&ring_flush_to,
+                        atomic_load_explicit(&ring_head, memory_order_relaxed),
+                        memory_order_release);
+  seg_flush_to = seg_head;
+  pcm_drop_pending = 1;
+  pthread_cond_broadcast(&ring_data);  /* Playback thread skips the rest */
+  pthread_cond_broadcast(&ring_space); /* Producers stop waiting */
+}
+
+/**
+ * @brief Path of the file the selected device is remembered in
+ */
+static void device_file_path(char *path, size_t len) {
+  const char *env = getenv(AUDIO_DEVICE_FILE_ENV);
+  const char *home = getenv("HOME");
+  if (env != NULL && env[0] != '\0') {
+    snprintf(path, len, "%s", env);
+  } else {
+    snprintf(path, len, "%s/%s", home != NULL ? home : "/tmp",
+             AUDIO_DEVICE_FILE_DEFAULT);
   }
 }
 
 /**
- * @brief Detect USB audio device using enumeration utility
+ * @brief Pick the audio device, trying the last one first
  *
- * Uses hal_usb_find_audio to find the best audio device with this priority:
+ * The device selected last (this run, or saved by an earlier one) is only
+ * checked in sysfs. If it is gone, whatever is now on its USB port comes
+ * first (a re-plugged dongle gets a new card number), and otherwise
+ * hal_usb_find_audio() with this priority:
  * 1. "USB2.0 Device" (preferred external speaker)
  * 2. Any USB audio device
  * 3. Headphones
  * 4. Default
  *
- * @return 0 on success, -1 on failure
+ * @param rescan Enumerate even if the last device is still there, to move
+ *               to a better one that has just been plugged in
+ * @return 0 on success, -1 if there is no audio device
  */
-static int detect_usb_audio(void) {
+static int select_audio_device(int rescan) {
+  AudioDeviceInfo last = selected_audio_device;
   AudioDeviceInfo result;
+  char path[256];
+
+  device_file_path(path, sizeof(path));
+  if (last.card_number < 0 && hal_usb_load_audio(path, &last) != 0) {
+    last.card_number = -1;
+  }
+
+  if (!rescan && hal_usb_check_audio(&last) == 0) {
+    result = last;
+  } else if (!(last.is_usb &&
+               hal_usb_find_audio_at_port(last.usb_port, &result) == 0) &&
+             hal_usb_find_audio("USB2.0 Device", &result) != 0) {
+    fprintf(stderr, "HAL Audio: No audio devices found\n");
+    return -1;
+  }
+
+  selected_audio_device = result;
+  strncpy(audio_device, result.device_path, sizeof(audio_device) - 1);
+  audio_device[sizeof(audio_device) - 1] = '\0';
+  if (result.card_number != last.card_number ||
+      strcmp(result.usb_port, last.usb_port) != 0) {
+    hal_usb_save_audio(path, &result);
+  }
+  return 0;
+}
 
-  /* Use the USB enumeration utility with "USB2.0 Device" as preferred */
-  if (hal_usb_find_audio("USB2.0 Device", &result) == 0) {
-    /* Copy the selected device info */
-    selected_audio_device = result;
-    strncpy(audio_device, result.device_path, sizeof(audio_device) - 1);
-    audio_device[sizeof(audio_device) - 1] = '\0';
+/**
+ * @brief Reopen the device after it went away, picking it again first
+ *
+ * Call with pcm_lock held. A device named by hal_audio_set_device() is
+ * only reopened. An open device is left alone unless the pick moves to
+ * another one.
+ *
+ * @return 0 once a device is open, -1 otherwise
+ */
+static int pcm_reselect(int rescan) {
+  char old_device[sizeof(audio_device)];
+  snprintf(old_device, sizeof(old_device), "%s", audio_device);
+  if (device_auto && select_audio_device(rescan) != 0) {
+    return -1;
+  }
+  int moved = strcmp(old_device, audio_device) != 0;
+  if (pcm_handle != NULL && !moved) {
     return 0;
   }
 
-  /* No audio device found */
-  fprintf(stderr, "HAL Audio: No audio devices found\n");
-  return -1;
+  if (pcm_handle != NULL) {
+    snd_pcm_drop(pcm_handle);
+    snd_pcm_close(pcm_handle);
+    pcm_handle = NULL;
+    pcm_mmap = 0;
+  }
+  if (moved) {
+    buffer_step = AUDIO_BUFFER_DEFAULT_STEP; /* Relearn for this device */
+    window_samples = 0;
+    window_min_fill = -1;
+  }
+  if (open_pcm_device() != 0) {
+    return -1;
+  }
+  atomic_fetch_add(&stat_reopens, 1);
+  printf("HAL Audio: Device reopened: %s\n", audio_device);
+  return 0;
+}
+
+/**
+ * @brief Device monitor thread: close an unplugged device, reopen it
+ *        when a sound card appears
+ */
+static void *device_monitor_func(void *arg) {
+  (void)arg;
+  struct pollfd fds[2] = {{monitor_wake[0], POLLIN, 0},
+                          {monitor_fd, POLLIN, 0}};
+  int nfds = monitor_fd >= 0 ? 2 : 1;
+
+  while (atomic_load(&monitor_running)) {
+    int ready = poll(fds, nfds, AUDIO_DEVICE_RETRY_MS);
+    if (!atomic_load(&monitor_running)) {
+      break;
+    }
+
+    HalUsbEvent event = HAL_USB_EVENT_NONE;
+    int card = -1;
+    if (ready > 0 && nfds > 1 && (fds[1].revents & POLLIN)) {
+      event = hal_usb_monitor_read(monitor_fd, &card);
+    }
+
+    pthread_mutex_lock(&pcm_lock);
+    if (event == HAL_USB_EVENT_REMOVE && pcm_handle != NULL &&
+        card == selected_audio_device.card_number) {
+      fprintf(stderr, "HAL Audio: Card %d unplugged\n", card);
+      snd_pcm_drop(pcm_handle);
+      snd_pcm_close(pcm_handle);
+      pcm_handle = NULL;
+      pcm_mmap = 0;
+    }
+    int lost = pcm_handle == NULL;
+    int fallback = !selected_audio_device.is_usb;
+    pthread_mutex_unlock(&pcm_lock);
+
+    if (event == HAL_USB_EVENT_ADD && (lost || (device_auto && fallback))) {
+      /* Its PCM node comes a moment after the card */
+      for (int i = 0; i < AUDIO_DEVICE_ADD_TRIES; i++) {
+        pthread_mutex_lock(&pcm_lock);
+        int rc = pcm_reselect(!lost);
+        pthread_mutex_unlock(&pcm_lock);
+        if (rc == 0 || !atomic_load(&monitor_running)) {
+          break;
+        }
+        struct timespec pause = {0, AUDIO_DEVICE_ADD_WAIT_MS * 1000000L};
+        nanosleep(&pause, NULL);
+      }
+    } else if (ready == 0 && lost && monitor_fd < 0) {
+      pthread_mutex_lock(&pcm_lock);
+      pcm_reselect(0);
+      pthread_mutex_unlock(&pcm_lock);
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief Start the device monitor thread
+ */
+static void device_monitor_start(void) {
+  if (pipe2(monitor_wake, O_CLOEXEC | O_NONBLOCK) != 0) {
+    fprintf(stderr, "HAL Audio: No device monitor (pipe failed)\n");
+    return;
+  }
+  monitor_fd = hal_usb_monitor_open();
+  if (monitor_fd < 0) {
+    fprintf(stderr, "HAL Audio: No uevents, retrying a lost device every "
+                    "%d ms\n",
+            AUDIO_DEVICE_RETRY_MS);
+  }
+  atomic_store(&monitor_running, 1);
+  if (pthread_create(&monitor_thread, NULL, device_monitor_func, NULL) !=
+      0) {
+    fprintf(stderr, "HAL Audio: Cannot start device monitor thread\n");
+    atomic_store(&monitor_running, 0);
+  }
+}
+
+/**
+ * @brief Stop the device monitor thread
+ */
+static void device_monitor_stop(void) {
+  if (atomic_exchange(&monitor_running, 0)) {
+    if (write(monitor_wake[1], "x", 1) < 0) {
+      /* Full pipe: the thread is being woken anyway */
+    }
+    pthread_join(monitor_thread, NULL);
+  }
+  if (monitor_fd >= 0) {
+    close(monitor_fd);
+    monitor_fd = -1;
+  }
+  for (int i = 0; i < 2; i++) {
+    if (monitor_wake[i] >= 0) {
+      close(monitor_wake[i]);
+      monitor_wake[i] = -1;
+    }
+  }
 }
 
 /* ============================================================================
@@ -346,8 +1600,14 @@ int hal_audio_init(void) {
     return 0; /* Already initialized */
   }
 
-  /* Attempt to detect USB audio device */
-  if (detect_usb_audio() != 0) {
+  /* A device named in the environment, else reuse the last device if it
+   * is still there, else enumerate */
+  const char *forced = getenv(AUDIO_DEVICE_ENV);
+  if (forced != NULL && forced[0] != '\0') {
+    snprintf(audio_device, sizeof(audio_device), "%s", forced);
+    device_auto = 0;
+    printf("HAL Audio: Device from %s: %s\n", AUDIO_DEVICE_ENV, audio_device);
+  } else if (select_audio_device(0) != 0) {
     fprintf(stderr, "HAL Audio: Using default device: %s\n", audio_device);
     /* Continue anyway with default, don't fail */
   } else {
@@ -358,20 +1618,24 @@ int hal_audio_init(void) {
   if (open_pcm_device() != 0) {
     fprintf(stderr,
             "HAL Audio: Failed to open PCM device, audio will not work\n");
-    /* Don't fail - we'll try again on first write */
+    /* Don't fail - the device monitor opens it when a card appears */
   }
 
-  /* Load beep sounds into RAM cache */
-  printf("HAL Audio: Loading beep sounds...\n");
-  if (load_wav_to_cache(BEEP_KEYPRESS_PATH, &beep_keypress) != 0) {
-    fprintf(stderr, "HAL Audio: Warning - keypress beep not loaded\n");
-  }
-  if (load_wav_to_cache(BEEP_HOLD_PATH, &beep_hold) != 0) {
-    fprintf(stderr, "HAL Audio: Warning - hold beep not loaded\n");
-  }
-  if (load_wav_to_cache(BEEP_ERROR_PATH, &beep_error) != 0) {
-    fprintf(stderr, "HAL Audio: Warning - error beep not loaded\n");
+  /* Beeps and the tuning tone are synthesized from the sine table */
+  hal_tone_init();
+
+  /* Start the playback thread that owns snd_pcm_writei() */
+  pthread_mutex_lock(&ring_lock);
+  playback_running = 1;
+  pthread_mutex_unlock(&ring_lock);
+  if (pthread_create(&playback_thread, NULL, playback_thread_func, NULL) !=
+      0) {
+    fprintf(stderr, "HAL Audio: Cannot start playback thread\n");
+    playback_running = 0;
+    close_pcm_device();
+    return -1;
   }
+  device_monitor_start();
 
   initialized = 1;
   return 0;
@@ -382,13 +1646,21 @@ int hal_audio_set_device(const char *device_name) {
     return -1;
   }
 
+  pthread_mutex_lock(&pcm_lock);
   strncpy(audio_device, device_name, sizeof(audio_device) - 1);
   audio_device[sizeof(audio_device) - 1] = '\0';
+  device_auto = 0;
+  pthread_mutex_unlock(&pcm_lock);
 
   /* Restart PCM device with new device if already initialized */
   if (initialized && pcm_handle != NULL) {
+    pthread_mutex_lock(&pcm_lock);
     close_pcm_device();
+    buffer_step = AUDIO_BUFFER_DEFAULT_STEP; /* Relearn for this device */
+    window_samples = 0;
+    window_min_fill = -1;
     open_pcm_device();
+    pthread_mutex_unlock(&pcm_lock);
   }
 
   printf("HAL Audio: Device set to: %s\n", audio_device);
@@ -405,8 +1677,6 @@ const char *hal_audio_get_device(void) { return audio_device; }
  * @return 0 on success, -1 on failure
  */
 int hal_audio_write_raw(const int16_t *samples, size_t num_samples) {
-  snd_pcm_sframes_t frames;
-
   if (!initialized || pcm_handle == NULL) {
     fprintf(stderr, "HAL Audio: PCM device not available\n");
     return -1;
@@ -421,32 +1691,146 @@ int hal_audio_write_raw(const int16_t *samples, size_t num_samples) {
     return 0; /* Silently drop audio - we're being interrupted */
   }
 
-  /* Write samples to ALSA PCM device */
-  frames = snd_pcm_writei(pcm_handle, samples, num_samples);
+  /* Queue for the playback thread */
+  return ring_write(samples, num_samples);
+}
 
-  if (frames < 0) {
-    /* Try to recover from underrun or other errors */
-    frames = snd_pcm_recover(pcm_handle, frames, 0);
-    if (frames < 0) {
-      fprintf(stderr, "HAL Audio: Write failed: %s\n", snd_strerror(frames));
-      return -1;
-    }
+size_t hal_audio_ring_free(void) {
+  uint32_t head = atomic_load_explicit(&ring_head, memory_order_acquire);
+  uint32_t tail = atomic_load_explicit(&ring_tail, memory_order_acquire);
+  return AUDIO_RING_SAMPLES - (head - tail);
+}
+
+int hal_audio_queue_samples(const int16_t *samples, size_t num_samples) {
+  if (!initialized || samples == NULL || num_samples == 0) {
+    return initialized ? 0 : -1;
+  }
+  int16_t *copy = hampod_malloc(ALLOC_AUDIO, num_samples * sizeof(int16_t));
+  if (copy == NULL) {
+    return -1;
+  }
+  memcpy(copy, samples, num_samples * sizeof(int16_t));
+  return segment_push(copy, num_samples, NULL);
+}
+
+int hal_audio_queue_shared(const int16_t *samples, size_t num_samples,
+                           void (*release)(const int16_t *samples)) {
+  if (!initialized || samples == NULL || num_samples == 0 ||
+      release == NULL) {
+    return -1;
+  }
+  return segment_push((int16_t *)samples, num_samples, release);
+}
+
+int hal_audio_queue_silence(unsigned int ms) {
+  if (!initialized) {
+    return -1;
+  }
+  size_t num_samples = (size_t)ms * AUDIO_SAMPLE_RATE / 1000;
+  return num_samples > 0 ? segment_push(NULL, num_samples, NULL) : 0;
+}
+
+int hal_audio_queue_file(const char *filepath) {
+  if (!initialized) {
+    return -1;
+  }
+  int16_t *samples;
+  size_t num_samples;
+  if (hal_audio_convert_file(filepath, &samples, &num_samples) != 0) {
+    fprintf(stderr, "HAL Audio: Cannot queue %s\n", filepath);
+    return -1;
+  }
+  if (num_samples == 0) {
+    hampod_free(samples);
+    return 0;
+  }
+  return segment_push(samples, num_samples, NULL);
+}
+
+int hal_audio_queue_marker(unsigned int id) {
+  int result = 0;
+  pthread_mutex_lock(&ring_lock);
+  if (!playback_running || audio_interrupted ||
+      seg_head - seg_tail == AUDIO_SEGMENT_MAX ||
+      markers_queued + (markers_done_head - markers_done_tail) >=
+          AUDIO_SEGMENT_MAX) {
+    result = -1;
+  } else {
+    AudioSegment *seg = &segments[seg_head % AUDIO_SEGMENT_MAX];
+    seg->samples = NULL;
+    seg->release = NULL;
+    seg->num_samples = 0;
+    seg->pos = 0;
+    seg->ring_pos = atomic_load_explicit(&ring_head, memory_order_relaxed);
+    seg->marker = 1;
+    seg->marker_id = id;
+    seg_head++;
+    markers_queued++;
+    pthread_cond_signal(&ring_data);
+  }
+  pthread_mutex_unlock(&ring_lock);
+  return result;
+}
+
+int hal_audio_wait_marker(unsigned int *id) {
+  pthread_mutex_lock(&ring_lock);
+  while (playback_running && markers_done_head == markers_done_tail) {
+    pthread_cond_wait(&marker_reached, &ring_lock);
+  }
+  if (markers_done_head == markers_done_tail) {
+    pthread_mutex_unlock(&ring_lock);
+    return -1;
+  }
+  AudioMarker marker = markers_done[markers_done_tail++ % AUDIO_SEGMENT_MAX];
+  pthread_mutex_unlock(&ring_lock);
+  *id = marker.id;
+  if (marker.cancelled) {
+    return 0;
   }
 
+  /* Everything before it has been written to the device; wait out what
+   * the device still holds. That may include audio queued after the
+   * marker, so this errs on the late side. */
+  snd_pcm_sframes_t delay = 0;
+  pthread_mutex_lock(&pcm_lock);
+  if (pcm_handle == NULL || snd_pcm_delay(pcm_handle, &delay) < 0 ||
+      delay < 0) {
+    delay = 0;
+  } else if (delay > (snd_pcm_sframes_t)pcm_buffer_frames) {
+    delay = (snd_pcm_sframes_t)pcm_buffer_frames;
+  }
+  pthread_mutex_unlock(&pcm_lock);
+  long long ns = (long long)delay * 1000000000LL / AUDIO_SAMPLE_RATE;
+  struct timespec wait = {(time_t)(ns / 1000000000LL),
+                          (long)(ns % 1000000000LL)};
+  nanosleep(&wait, NULL);
   return 0;
 }
 
+void hal_audio_mark_sound(unsigned short tag) {
+  pthread_mutex_lock(&ring_lock);
+  mark_pos = atomic_load_explicit(&ring_head, memory_order_relaxed);
+  mark_seg = seg_head;
+  mark_tag = tag;
+  mark_gen++;
+  pthread_mutex_unlock(&ring_lock);
+}
+
+void hal_audio_cancel_all(void) {
+  pthread_mutex_lock(&ring_lock);
+  flush_queued();
+  pthread_mutex_unlock(&ring_lock);
+}
+
 int hal_audio_play_file(const char *filepath) {
   FILE *wav_file;
-  uint8_t header[44];
-  uint32_t data_size;
-  uint32_t sample_rate;
-  uint16_t num_channels;
-  uint16_t bits_per_sample;
+  WavFormat format;
+  AudioConverter conv;
   uint8_t *chunk_buffer;
-  size_t bytes_remaining;
-  size_t bytes_to_read;
-  size_t bytes_read;
+  int16_t *converted;
+  size_t chunk_frames;
+  size_t frames_remaining;
+  size_t frames_read;
 
   if (!initialized) {
     fprintf(stderr, "HAL Audio: Not initialized\n");
@@ -464,47 +1848,11 @@ int hal_audio_play_file(const char *filepath) {
     return -1;
   }
 
-  /* Read WAV header (44 bytes for standard WAV) */
-  if (fread(header, 1, 44, wav_file) != 44) {
-    fprintf(stderr, "HAL Audio: Failed to read WAV header: %s\n", filepath);
-    fclose(wav_file);
-    return -1;
-  }
-
-  /* Verify RIFF header */
-  if (memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0) {
-    fprintf(stderr, "HAL Audio: Not a valid WAV file: %s\n", filepath);
-    fclose(wav_file);
-    return -1;
-  }
-
-  /* Parse WAV header fields (little-endian) */
-  num_channels = header[22] | (header[23] << 8);
-  sample_rate =
-      header[24] | (header[25] << 8) | (header[26] << 16) | (header[27] << 24);
-  bits_per_sample = header[34] | (header[35] << 8);
-  data_size =
-      header[40] | (header[41] << 8) | (header[42] << 16) | (header[43] << 24);
-
-  /* Validate format matches our pipeline configuration */
-  if (sample_rate != AUDIO_SAMPLE_RATE) {
-    fprintf(stderr, "HAL Audio: Sample rate mismatch (%u vs %d): %s\n",
-            sample_rate, AUDIO_SAMPLE_RATE, filepath);
-    /* Fall back to system() for non-matching files */
-    fclose(wav_file);
-    goto fallback_system;
-  }
-
-  if (num_channels != AUDIO_CHANNELS) {
-    fprintf(stderr, "HAL Audio: Channel mismatch (%u vs %d): %s\n",
-            num_channels, AUDIO_CHANNELS, filepath);
-    fclose(wav_file);
-    goto fallback_system;
-  }
-
-  if (bits_per_sample != 16) {
-    fprintf(stderr, "HAL Audio: Bit depth mismatch (%u vs 16): %s\n",
-            bits_per_sample, filepath);
+  /* Walk the RIFF chunks to the sample data */
+  if (hal_wav_read_header(wav_file, &format) != 0 ||
+      hal_audio_converter_init(&conv, &format) != 0) {
+    fprintf(stderr, "HAL Audio: Unsupported or invalid WAV file: %s\n",
+            filepath);
     fclose(wav_file);
     goto fallback_system;
   }
@@ -515,51 +1863,59 @@ int hal_audio_play_file(const char *filepath) {
     goto fallback_system;
   }
 
-  /* Allocate chunk buffer */
-  chunk_buffer = (uint8_t *)malloc(AUDIO_CHUNK_BYTES);
-  if (chunk_buffer == NULL) {
+  /* About one pipeline chunk of input, in whole frames */
+  chunk_frames = (size_t)((uint64_t)AUDIO_CHUNK_SAMPLES * format.sample_rate /
+                          AUDIO_SAMPLE_RATE / conv.frame_samples);
+  if (chunk_frames == 0) {
+    chunk_frames = 1;
+  }
+  chunk_buffer = (uint8_t *)hampod_malloc(ALLOC_AUDIO,
+                                          chunk_frames * conv.frame_bytes);
+  converted = (int16_t *)hampod_malloc(
+      ALLOC_AUDIO,
+      hal_audio_converter_max_out(&conv, chunk_frames) * sizeof(int16_t));
+  if (chunk_buffer == NULL || converted == NULL) {
     fprintf(stderr, "HAL Audio: Failed to allocate chunk buffer\n");
+    hampod_free(chunk_buffer);
+    hampod_free(converted);
     fclose(wav_file);
     return -1;
   }
 
-  /* Stream audio data in chunks */
-  audio_playing = 1;
+  /* Queue audio data in chunks for the playback thread */
   audio_interrupted = 0;
-  bytes_remaining = data_size;
+  frames_remaining = format.data_size / conv.frame_bytes;
 
-  while (bytes_remaining > 0 && !audio_interrupted) {
-    bytes_to_read = (bytes_remaining > AUDIO_CHUNK_BYTES) ? AUDIO_CHUNK_BYTES
-                                                          : bytes_remaining;
-    bytes_read = fread(chunk_buffer, 1, bytes_to_read, wav_file);
+  while (frames_remaining > 0 && !audio_interrupted) {
+    frames_read = fread(chunk_buffer, conv.frame_bytes,
+                        frames_remaining > chunk_frames ? chunk_frames
+                                                        : frames_remaining,
+                        wav_file);
 
-    if (bytes_read == 0) {
+    if (frames_read == 0) {
       break; /* EOF or error */
     }
 
-    /* Write to ALSA PCM device */
-    snd_pcm_sframes_t frames =
-        snd_pcm_writei(pcm_handle, chunk_buffer, bytes_read / 2);
-
-    if (frames < 0) {
-      frames = snd_pcm_recover(pcm_handle, frames, 0);
-      if (frames < 0) {
-        fprintf(stderr, "HAL Audio: Write error during streaming\n");
-        break;
-      }
+    long samples = hal_audio_convert(&conv, chunk_buffer, frames_read,
+                                     converted);
+    if (samples < 0 || ring_write(converted, (size_t)samples) != 0) {
+      fprintf(stderr, "HAL Audio: Write error during streaming\n");
+      break;
     }
 
-    bytes_remaining -= bytes_read;
+    frames_remaining -= frames_read;
   }
 
-  audio_playing = 0;
   audio_interrupted = 0;
-  free(chunk_buffer);
+  hampod_free(chunk_buffer);
+  hampod_free(converted);
+  hal_audio_converter_free(&conv);
   fclose(wav_file);
   return 0;
 
 fallback_system: {
-  /* Fallback to system() call for non-matching formats */
+  /* Fallback to aplay for encodings the converter cannot read, or when
+   * there is no PCM device open */
   char command[1024];
   int result;
 
@@ -581,34 +1937,26 @@ fallback_system: {
 /**
  * @brief Interrupt current audio playback immediately
  *
- * Uses snd_pcm_drop() to immediately stop playback and discard any
- * buffered audio. This provides true interrupt capability.
+ * Flushes the PCM ring and has the playback thread snd_pcm_drop() the
+ * ALSA buffer before its next chunk (within ~10ms), discarding any
+ * buffered speech. This provides true interrupt capability. Beeps keep
+ * playing.
  */
 void hal_audio_interrupt(void) {
+  pthread_mutex_lock(&ring_lock);
   audio_interrupted = 1;
-
-  /* Immediately stop playback and discard buffer */
-  if (pcm_handle != NULL) {
-    snd_pcm_drop(pcm_handle);
-  }
+  flush_queued();
+  pthread_mutex_unlock(&ring_lock);
 }
 
 /**
- * @brief Clear the interrupt flag and prepare device for new audio
+ * @brief Clear the interrupt flag so new audio is queued again
  *
  * This should be called at the start of a new audio operation
- * to reset from a previous interrupt. Only calls snd_pcm_prepare() if
- * we were actually interrupted (after snd_pcm_drop was called).
+ * to reset from a previous interrupt. The playback thread prepares the
+ * device again itself after dropping it.
  */
-void hal_audio_clear_interrupt(void) {
-  /* Only call snd_pcm_prepare if we were actually interrupted.
-   * This prevents clearing the buffer when transitioning between
-   * audio packets (e.g., beep -> TTS) without an interrupt. */
-  if (audio_interrupted && pcm_handle != NULL) {
-    snd_pcm_prepare(pcm_handle);
-  }
-  audio_interrupted = 0;
-}
+void hal_audio_clear_interrupt(void) { audio_interrupted = 0; }
 
 /**
  * @brief Check if audio is currently playing
@@ -617,6 +1965,54 @@ void hal_audio_clear_interrupt(void) {
  */
 int hal_audio_is_playing(void) { return audio_playing; }
 
+unsigned long long hal_audio_progress(void) {
+  pthread_mutex_lock(&ring_lock);
+  uint32_t segments = seg_head;
+  pthread_mutex_unlock(&ring_lock);
+  return atomic_load_explicit(&stat_written, memory_order_relaxed) +
+         atomic_load_explicit(&ring_head, memory_order_relaxed) + segments;
+}
+
+/* Lock pcm_lock, waiting at most AUDIO_REOPEN_WAIT_MS */
+static int pcm_lock_within(void) {
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_nsec += AUDIO_REOPEN_WAIT_MS * 1000000L;
+  if (deadline.tv_nsec >= 1000000000L) {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000L;
+  }
+  return pthread_mutex_timedlock(&pcm_lock, &deadline);
+}
+
+int hal_audio_reopen(void) {
+  if (!initialized) {
+    return -1;
+  }
+  if (pcm_lock_within() != 0) {
+    /* The playback thread holds it in a write that does not return: drop
+     * the PCM under it (alsa-lib's PCM calls lock the handle themselves)
+     * so the write fails and lets go */
+    snd_pcm_t *stuck = pcm_handle;
+    if (stuck != NULL) {
+      snd_pcm_drop(stuck);
+    }
+    if (pcm_lock_within() != 0) {
+      fprintf(stderr, "HAL Audio: Playback thread stuck, not reopened\n");
+      return -1;
+    }
+  }
+  if (pcm_handle != NULL) {
+    snd_pcm_drop(pcm_handle);
+    snd_pcm_close(pcm_handle);
+    pcm_handle = NULL;
+    pcm_mmap = 0;
+  }
+  int rc = pcm_reselect(0);
+  pthread_mutex_unlock(&pcm_lock);
+  return rc;
+}
+
 /**
  * @brief Check if pipeline is ready for streaming
  *
@@ -626,11 +2022,41 @@ int hal_audio_pipeline_ready(void) {
   return (initialized && pcm_handle != NULL) ? 1 : 0;
 }
 
+int hal_audio_set_rt_priority(int priority) {
+  if (!initialized) {
+    return priority == 0 ? 0 : -1;
+  }
+  struct sched_param param = {.sched_priority = priority};
+  int err = pthread_setschedparam(playback_thread,
+                                  priority > 0 ? SCHED_FIFO : SCHED_OTHER,
+                                  &param);
+  if (err != 0) {
+    fprintf(stderr, "HAL Audio: Cannot run playback at SCHED_FIFO %d: %s\n",
+            priority, strerror(err));
+    return -1;
+  }
+  if (priority > 0) {
+    printf("HAL Audio: Playback thread at SCHED_FIFO %d\n", priority);
+  }
+  return 0;
+}
+
 void hal_audio_cleanup(void) {
-  /* Free cached beeps */
-  free_cached_audio(&beep_keypress);
-  free_cached_audio(&beep_hold);
-  free_cached_audio(&beep_error);
+  device_monitor_stop();
+
+  /* Let the playback thread finish what is queued, then stop it */
+  if (initialized) {
+    pthread_mutex_lock(&ring_lock);
+    playback_running = 0;
+    pthread_cond_broadcast(&ring_data);
+    pthread_cond_broadcast(&ring_space);
+    pthread_cond_broadcast(&marker_reached);
+    pthread_mutex_unlock(&ring_lock);
+    pthread_join(playback_thread, NULL);
+  }
+  for (; seg_tail != seg_head; seg_tail++) {
+    segment_free(&segments[seg_tail % AUDIO_SEGMENT_MAX]);
+  }
 
   close_pcm_device();
   initialized = 0;
@@ -638,81 +2064,173 @@ void hal_audio_cleanup(void) {
 }
 
 /**
- * @brief Play a beep from RAM cache
+ * @brief Hand a tone to the mixer and return right away
+ *
+ * @return 0 on success, -1 if playback is not running
+ */
+static int mix_start_tone(const HalTone *tone) {
+  pthread_mutex_lock(&ring_lock);
+  if (!playback_running) {
+    pthread_mutex_unlock(&ring_lock);
+    return -1;
+  }
+  if (beep_pending_count < AUDIO_MIX_VOICES) {
+    beep_pending[beep_pending_count++] = *tone;
+  }
+  pthread_cond_signal(&ring_data);
+  pthread_mutex_unlock(&ring_lock);
+  return 0;
+}
+
+/**
+ * @brief The tone of a beep type
+ *
+ * @return 0 on success, -1 (with a message) for an unknown type
+ */
+static int beep_tone(BeepType type, HalTone *tone) {
+  if ((int)type < 0 || type >= BEEP_TYPES) {
+    fprintf(stderr, "HAL Audio: Unknown beep type: %d\n", type);
+    return -1;
+  }
+  pthread_mutex_lock(&ring_lock);
+  *tone = beep_tones[type];
+  pthread_mutex_unlock(&ring_lock);
+  return 0;
+}
+
+/**
+ * @brief Play a beep
  *
- * Plays a pre-loaded beep sound with minimal latency.
+ * Synthesizes the beep into the output with minimal latency and returns
+ * without waiting for it.
  *
  * @param type Type of beep to play (BEEP_KEYPRESS, BEEP_HOLD, BEEP_ERROR)
  * @return 0 on success, -1 on failure
  */
 int hal_audio_play_beep(BeepType type) {
-  CachedAudio *beep = NULL;
-
-  printf("HAL Audio: play_beep called, type=%d\n", type);
-
-  switch (type) {
-  case BEEP_KEYPRESS:
-    beep = &beep_keypress;
-    break;
-  case BEEP_HOLD:
-    beep = &beep_hold;
-    break;
-  case BEEP_ERROR:
-    beep = &beep_error;
-    break;
-  default:
-    fprintf(stderr, "HAL Audio: Unknown beep type: %d\n", type);
+  hampod_trace(TRACE_BEEP, (uint32_t)type, 0, 0);
+
+  HalTone tone;
+  if (beep_tone(type, &tone) != 0) {
     return -1;
   }
+  return mix_start_tone(&tone);
+}
 
-  if (!beep->loaded || beep->samples == NULL) {
-    fprintf(stderr, "HAL Audio: Beep not loaded (type=%d)\n", type);
+int hal_audio_play_tone(const HalTone *tone) {
+  if (tone == NULL) {
     return -1;
   }
+  return mix_start_tone(tone);
+}
 
-  if (!initialized || pcm_handle == NULL) {
-    fprintf(stderr, "HAL Audio: PCM device not ready for beep\n");
+int hal_audio_set_beep(BeepType type, const HalTone *tone) {
+  if ((int)type < 0 || type >= BEEP_TYPES) {
     return -1;
   }
+  pthread_mutex_lock(&ring_lock);
+  beep_tones[type] = tone != NULL ? *tone : beep_defaults[type];
+  pthread_mutex_unlock(&ring_lock);
+  return 0;
+}
 
-  /* Write beep samples directly to ALSA (fast, no file I/O) */
-  snd_pcm_sframes_t frames =
-      snd_pcm_writei(pcm_handle, beep->samples, beep->num_samples);
-
-  if (frames < 0) {
-    frames = snd_pcm_recover(pcm_handle, frames, 0);
-    if (frames < 0) {
-      fprintf(stderr, "HAL Audio: Beep write error: %s\n",
-              snd_strerror(frames));
-      return -1;
-    }
-    /* After recovery, we need to write again */
-    frames = snd_pcm_writei(pcm_handle, beep->samples, beep->num_samples);
-    if (frames < 0) {
-      fprintf(stderr, "HAL Audio: Beep write after recovery failed: %s\n",
-              snd_strerror(frames));
-      return -1;
-    }
+int hal_audio_play_echo(const int16_t *samples, size_t num_samples) {
+  if (samples == NULL || num_samples == 0) {
+    return -1;
   }
 
-  /* Ensure playback has started - device may be in prepared state */
-  snd_pcm_state_t state = snd_pcm_state(pcm_handle);
-  if (state == SND_PCM_STATE_PREPARED) {
-    snd_pcm_start(pcm_handle);
+  pthread_mutex_lock(&ring_lock);
+  if (!playback_running) {
+    pthread_mutex_unlock(&ring_lock);
+    return -1;
   }
+  echo_pending_samples = samples;
+  echo_pending_count = num_samples;
+  pthread_cond_signal(&ring_data);
+  pthread_mutex_unlock(&ring_lock);
+  return 0;
+}
 
-  /* Drain to ensure beep plays completely before returning.
-   * This prevents TTS from starting before the beep is heard. */
-  snd_pcm_drain(pcm_handle);
-  snd_pcm_prepare(pcm_handle); /* Prepare for next audio */
+/**
+ * @brief Queue a beep as a segment, behind the audio already queued
+ *
+ * @param type Type of beep to queue (BEEP_KEYPRESS, BEEP_HOLD, BEEP_ERROR)
+ * @return 0 on success, -1 on failure
+ */
+int hal_audio_queue_beep(BeepType type) {
+  HalTone tone;
+  if (beep_tone(type, &tone) != 0) {
+    return -1;
+  }
+  return hal_audio_queue_tone(&tone);
+}
 
-  return 0;
+int hal_audio_queue_tone(const HalTone *tone) {
+  if (!initialized || tone == NULL) {
+    return -1;
+  }
+  int16_t *samples;
+  size_t num_samples;
+  if (hal_tone_render(tone, &samples, &num_samples) != 0) {
+    return -1;
+  }
+  return segment_push(samples, num_samples, NULL);
 }
 
 const char *hal_audio_get_impl_name(void) {
   return "USB Audio (Direct ALSA PCM)";
 }
 
+int hal_audio_set_volume(int percent) {
+  if (percent < 0) {
+    percent = 0;
+  } else if (percent > 100) {
+    percent = 100;
+  }
+  atomic_store(&audio_volume, percent);
+  /* Audio taper: 50% is about -12dB */
+  atomic_store(&gain_target, AUDIO_GAIN_UNITY * percent * percent / 10000);
+  return 0;
+}
+
+int hal_audio_get_volume(void) { return atomic_load(&audio_volume); }
+
+int hal_audio_set_tone(int hz) {
+  if (hz > 0 && hz < AUDIO_TONE_MIN_HZ) {
+    hz = AUDIO_TONE_MIN_HZ;
+  } else if (hz > AUDIO_TONE_MAX_HZ) {
+    hz = AUDIO_TONE_MAX_HZ;
+  } else if (hz < 0) {
+    hz = 0;
+  }
+  atomic_store(&tone_set_ms, monotonic_ms());
+  atomic_store(&tone_target_hz, hz);
+
+  /* Wake an idle playback thread to start the tone */
+  pthread_mutex_lock(&ring_lock);
+  int running = playback_running;
+  pthread_cond_signal(&ring_data);
+  pthread_mutex_unlock(&ring_lock);
+  return running || hz == 0 ? 0 : -1;
+}
+
+int hal_audio_set_keep_alive(int seconds) {
+  atomic_store(&keep_alive_s, seconds < 0 ? 0 : seconds);
+  return 0;
+}
+
+int hal_audio_get_stats(AudioStats *stats) {
+  if (!initialized || stats == NULL) {
+    return -1;
+  }
+  stats->underruns = atomic_load(&stat_underruns);
+  stats->buffer_ms = atomic_load(&stat_buffer_ms);
+  stats->min_fill_ms = atomic_load(&stat_min_fill_ms);
+  stats->resizes = atomic_load(&stat_resizes);
+  stats->reopens = atomic_load(&stat_reopens);
+  return 0;
+}
+
 int hal_audio_get_card_number(void) {
   if (!initialized) {
     return -1;
@@ -0,0 +1,65 @@
+#ifndef HAL_CW_H
+#define HAL_CW_H
+
+#include <stddef.h>
+
+/**
+ * @file hal_cw.h
+ * @brief Hardware Abstraction Layer for decoding CW off the air
+ *
+ * Radios with a USB sound card (the IC-7300, FT-991A, TS-890 and most
+ * newer rigs) send their receive audio to the card's input. While the
+ * decoder runs, a capture thread reads that input at HAL_CW_RATE mono,
+ * ALSA resampling whatever the card gives, and decodes the Morse in it
+ * (hal_cw_decoder.h). The text decoded is kept until it is taken, so the
+ * audio process can answer Software's polls.
+ *
+ * The input is on the same card as the speech output, so by default it is
+ * opened on hal_audio_get_device() and follows the card when it is
+ * replugged. HAL_CW_DEVICE_ENV names another device, e.g. a separate
+ * interface between the rig and the Pi.
+ *
+ * Decoding is off until asked for; nothing is captured otherwise.
+ */
+
+/** ALSA capture device, the audio output's card if unset */
+#define HAL_CW_DEVICE_ENV "HAMPOD_CW_DEVICE"
+/** Decoded text kept for the next poll; older text is dropped */
+#define HAL_CW_TEXT_MAX 256
+
+/**
+ * @brief Open the receive audio and start decoding
+ *
+ * @return 0 on success or if already running, -1 if there is no audio
+ *         device or it has no input
+ */
+int hal_cw_start(void);
+
+/**
+ * @brief Stop decoding and close the receive audio
+ */
+void hal_cw_stop(void);
+
+/**
+ * @brief Whether the decoder is running
+ */
+int hal_cw_is_running(void);
+
+/**
+ * @brief Take the text decoded since the last call
+ *
+ * @param out Receives the text, NUL-terminated; a space follows each word
+ * @param size Size of out; text that does not fit stays for the next call
+ * @return The length of the text taken
+ */
+size_t hal_cw_take_text(char *out, size_t size);
+
+/**
+ * @brief What the decoder is following
+ *
+ * @param wpm Receives the sending speed, in words per minute
+ * @param pitch_hz Receives the pitch of the signal, in Hz
+ */
+void hal_cw_get_status(int *wpm, int *pitch_hz);
+
+#endif /* HAL_CW_H */
@@ -0,0 +1,187 @@
+/**
+ * @file hal_cw_alsa.c
+ * @brief ALSA capture of the radio's receive audio for the CW decoder
+ *
+ * The capture thread reads 64 ms at a time, so it wakes about fifteen
+ * times a second, and feeds the decoder. If the card goes away (the rig
+ * is switched off or unplugged) the thread closes it and tries again every
+ * second on whatever device the audio HAL is using by then.
+ */
+
+#include "hal_cw.h"
+#include "hal_audio.h"
+#include "hal_cw_decoder.h"
+#include "../hampod_metrics.h"
+#include <alsa/asoundlib.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CW_READ_BLOCKS 8        /* 64 ms per read */
+#define CW_LATENCY_US 500000    /* Room for Piper to hold the CPUs */
+#define CW_REOPEN_US 1000000
+
+static snd_pcm_t *capture = NULL;
+static volatile int running = 0;
+static pthread_t capture_thread;
+static HalCwDecoder decoder;
+
+/* Text decoded and not yet taken, oldest at text_head; also guards the
+ * status read from the decoder */
+static char text[HAL_CW_TEXT_MAX];
+static size_t text_head = 0;
+static size_t text_len = 0;
+static int status_wpm = 0;
+static int status_pitch = 0;
+static pthread_mutex_t text_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* The configured device, or the audio output's card */
+static const char *cw_device(void) {
+  const char *device = getenv(HAL_CW_DEVICE_ENV);
+  if (device == NULL || device[0] == '\0') {
+    device = hal_audio_get_device();
+  }
+  return device;
+}
+
+static int open_capture(void) {
+  const char *device = cw_device();
+  if (device == NULL || strcmp(device, "null") == 0) {
+    return -1;
+  }
+  int err = snd_pcm_open(&capture, device, SND_PCM_STREAM_CAPTURE, 0);
+  if (err < 0) {
+    fprintf(stderr, "HAL CW: Cannot open receive audio %s: %s\n", device,
+            snd_strerror(err));
+    capture = NULL;
+    return -1;
+  }
+  /* Resampled by ALSA from whatever the card captures */
+  err = snd_pcm_set_params(capture, SND_PCM_FORMAT_S16_LE,
+                           SND_PCM_ACCESS_RW_INTERLEAVED, 1, HAL_CW_RATE, 1,
+                           CW_LATENCY_US);
+  if (err < 0) {
+    fprintf(stderr, "HAL CW: Cannot set up receive audio %s: %s\n", device,
+            snd_strerror(err));
+    snd_pcm_close(capture);
+    capture = NULL;
+    return -1;
+  }
+  fprintf(stderr, "HAL CW: Decoding receive audio on %s\n", device);
+  return 0;
+}
+
+/* Keep decoded text, dropping the oldest when it is full */
+static void text_append(const char *s, size_t n) {
+  pthread_mutex_lock(&text_lock);
+  for (size_t i = 0; i < n; i++) {
+    if (text_len == HAL_CW_TEXT_MAX) {
+      text_head = (text_head + 1) % HAL_CW_TEXT_MAX;
+      text_len--;
+    }
+    text[(text_head + text_len++) % HAL_CW_TEXT_MAX] = s[i];
+  }
+  status_wpm = hal_cw_decoder_wpm(&decoder);
+  status_pitch = hal_cw_decoder_pitch(&decoder);
+  pthread_mutex_unlock(&text_lock);
+}
+
+static void *capture_thread_func(void *arg) {
+  (void)arg;
+  hampod_metrics_name_thread("cw-capture");
+
+  int16_t chunk[CW_READ_BLOCKS * HAL_CW_BLOCK];
+  char decoded[CW_READ_BLOCKS * 2]; /* A letter and a space per block */
+
+  while (running) {
+    if (capture == NULL) {
+      usleep(CW_REOPEN_US);
+      if (running && open_capture() == 0) {
+        hal_cw_decoder_init(&decoder);
+      }
+      continue;
+    }
+    snd_pcm_sframes_t got =
+        snd_pcm_readi(capture, chunk, CW_READ_BLOCKS * HAL_CW_BLOCK);
+    if (got < 0) {
+      if (snd_pcm_recover(capture, (int)got, 1) < 0) {
+        fprintf(stderr, "HAL CW: Capture failed: %s\n",
+                snd_strerror((int)got));
+        snd_pcm_close(capture);
+        capture = NULL;
+      }
+      continue;
+    }
+    size_t n = hal_cw_decoder_feed(&decoder, chunk, (size_t)got, decoded,
+                                   sizeof(decoded));
+    text_append(decoded, n);
+  }
+  return NULL;
+}
+
+int hal_cw_start(void) {
+  if (running) {
+    return 0;
+  }
+  if (open_capture() != 0) {
+    return -1;
+  }
+  hal_cw_decoder_init(&decoder);
+  pthread_mutex_lock(&text_lock);
+  text_head = 0;
+  text_len = 0;
+  status_wpm = hal_cw_decoder_wpm(&decoder);
+  status_pitch = hal_cw_decoder_pitch(&decoder);
+  pthread_mutex_unlock(&text_lock);
+
+  running = 1;
+  if (pthread_create(&capture_thread, NULL, capture_thread_func, NULL) != 0) {
+    fprintf(stderr, "HAL CW: Cannot start capture\n");
+    running = 0;
+    snd_pcm_close(capture);
+    capture = NULL;
+    return -1;
+  }
+  return 0;
+}
+
+void hal_cw_stop(void) {
+  if (!running) {
+    return;
+  }
+  running = 0;
+  /* The capture thread is at most one read (64 ms) or reopen away */
+  pthread_join(capture_thread, NULL);
+  if (capture != NULL) {
+    snd_pcm_close(capture);
+    capture = NULL;
+  }
+  fprintf(stderr, "HAL CW: Decoder stopped\n");
+}
+
+int hal_cw_is_running(void) { return running; }
+
+size_t hal_cw_take_text(char *out, size_t size) {
+  if (size == 0) {
+    return 0;
+  }
+  pthread_mutex_lock(&text_lock);
+  size_t n = text_len < size - 1 ? text_len : size - 1;
+  for (size_t i = 0; i < n; i++) {
+    out[i] = text[(text_head + i) % HAL_CW_TEXT_MAX];
+  }
+  out[n] = '\0';
+  text_head = (text_head + n) % HAL_CW_TEXT_MAX;
+  text_len -= n;
+  pthread_mutex_unlock(&text_lock);
+  return n;
+}
+
+void hal_cw_get_status(int *wpm, int *pitch_hz) {
+  pthread_mutex_lock(&text_lock);
+  *wpm = status_wpm;
+  *pitch_hz = status_pitch;
+  pthread_mutex_unlock(&text_lock);
+}
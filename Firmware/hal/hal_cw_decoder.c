@@ -0,0 +1,269 @@
+/**
+ * @file hal_cw_decoder.c
+ * @brief Goertzel filter bank and adaptive Morse timing
+ */
+
+#include "hal_cw_decoder.h"
+#include <math.h>
+#include <string.h>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#define CW_BLOCK_MS (HAL_CW_BLOCK * 1000 / HAL_CW_RATE)
+#define CW_DEBOUNCE 2          /* Blocks the key must hold a new state */
+#define CW_AVERAGE_RATE 0.02f  /* Pitch averages: about a second */
+#define CW_PITCH_SWITCH 1.25f  /* Another pitch must be this much stronger */
+#define CW_FLOOR_RATE 0.05f    /* Noise floor: mean while the key is up */
+#define CW_PEAK_DECAY 0.995f   /* Per block: about 3 dB a second */
+#define CW_SNR 12.0f           /* Peak over floor for a signal (11 dB) */
+#define CW_MIN_POWER 1e-6f     /* About -60 dBFS */
+#define CW_DOT_RATE 0.25f      /* How fast the dot length follows marks */
+#define CW_GAP_RATE 0.125f     /* ...and the gaps inside letters */
+#define CW_DOT_MIN_MS 20.0f    /* 60 wpm */
+#define CW_DOT_MAX_MS 240.0f   /* 5 wpm */
+#define CW_DOT_START_MS 60.0f  /* 20 wpm */
+
+static const struct {
+  const char *code;
+  char letter;
+} morse[] = {
+    {".-", 'A'},      {"-...", 'B'},    {"-.-.", 'C'},    {"-..", 'D'},
+    {".", 'E'},       {"..-.", 'F'},    {"--.", 'G'},     {"....", 'H'},
+    {"..", 'I'},      {".---", 'J'},    {"-.-", 'K'},     {".-..", 'L'},
+    {"--", 'M'},      {"-.", 'N'},      {"---", 'O'},     {".--.", 'P'},
+    {"--.-", 'Q'},    {".-.", 'R'},     {"...", 'S'},     {"-", 'T'},
+    {"..-", 'U'},     {"...-", 'V'},    {".--", 'W'},     {"-..-", 'X'},
+    {"-.--", 'Y'},    {"--..", 'Z'},    {"-----", '0'},   {".----", '1'},
+    {"..---", '2'},   {"...--", '3'},   {"....-", '4'},   {".....", '5'},
+    {"-....", '6'},   {"--...", '7'},   {"---..", '8'},   {"----.", '9'},
+    {".-.-.-", '.'},  {"--..--", ','},  {"..--..", '?'},  {"-..-.", '/'},
+    {"-...-", '='},   {".-.-.", '+'},   {"-....-", '-'},  {".--.-.", '@'},
+};
+#define MORSE_COUNT (sizeof(morse) / sizeof(morse[0]))
+
+void hal_cw_decoder_init(HalCwDecoder *d) {
+  memset(d, 0, sizeof(*d));
+  for (int b = 0; b < HAL_CW_BINS; b++) {
+    double hz = HAL_CW_PITCH_LOW + b * HAL_CW_PITCH_STEP;
+    d->coeff[b] = (float)(2.0 * cos(2.0 * M_PI * hz / HAL_CW_RATE));
+  }
+  d->pitch = (600 - HAL_CW_PITCH_LOW) / HAL_CW_PITCH_STEP; /* Common */
+  d->floor = -1.0f; /* Set from the first block */
+  d->dot_ms = CW_DOT_START_MS;
+}
+
+/* Samples to floats of +-1 */
+static void scale_samples(const int16_t *in, size_t n, float *out) {
+  size_t i = 0;
+#if defined(__ARM_NEON)
+  const float32x4_t scale = vdupq_n_f32(1.0f / 32768.0f);
+  for (; i + 8 <= n; i += 8) {
+    int16x8_t s = vld1q_s16(in + i);
+    float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(s)));
+    float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(s)));
+    vst1q_f32(out + i, vmulq_f32(lo, scale));
+    vst1q_f32(out + i + 4, vmulq_f32(hi, scale));
+  }
+#endif
+  for (; i < n; i++) {
+    out[i] = in[i] / 32768.0f;
+  }
+}
+
+/* Power of one block at every pitch, as the squared amplitude of a sine
+ * there */
+static void goertzel_bank(const float *coeff, const float *x, float *power) {
+#if defined(__ARM_NEON)
+  enum { VECTORS = HAL_CW_BINS / 4 };
+  float32x4_t c[VECTORS], s1[VECTORS], s2[VECTORS];
+  for (int v = 0; v < VECTORS; v++) {
+    c[v] = vld1q_f32(coeff + 4 * v);
+    s1[v] = vdupq_n_f32(0.0f);
+    s2[v] = s1[v];
+  }
+  for (int i = 0; i < HAL_CW_BLOCK; i++) {
+    float32x4_t in = vdupq_n_f32(x[i]);
+    for (int v = 0; v < VECTORS; v++) {
+      float32x4_t s0 = vsubq_f32(vmlaq_f32(in, c[v], s1[v]), s2[v]);
+      s2[v] = s1[v];
+      s1[v] = s0;
+    }
+  }
+  for (int v = 0; v < VECTORS; v++) {
+    float32x4_t p = vmlaq_f32(vmulq_f32(s1[v], s1[v]), s2[v], s2[v]);
+    p = vmlsq_f32(p, vmulq_f32(c[v], s1[v]), s2[v]);
+    vst1q_f32(power + 4 * v, p);
+  }
+#else
+  float s1[HAL_CW_BINS] = {0};
+  float s2[HAL_CW_BINS] = {0};
+  for (int i = 0; i < HAL_CW_BLOCK; i++) {
+    for (int b = 0; b < HAL_CW_BINS; b++) {
+      float s0 = x[i] + coeff[b] * s1[b] - s2[b];
+      s2[b] = s1[b];
+      s1[b] = s0;
+    }
+  }
+  for (int b = 0; b < HAL_CW_BINS; b++) {
+    power[b] = s1[b] * s1[b] + s2[b] * s2[b] - coeff[b] * s1[b] * s2[b];
+  }
+#endif
+  const float scale = 4.0f / ((float)HAL_CW_BLOCK * HAL_CW_BLOCK);
+  for (int b = 0; b < HAL_CW_BINS; b++) {
+    power[b] *= scale;
+  }
+}
+
+static size_t emit(char c, char *out, size_t size) {
+  if (size == 0) {
+    return 0;
+  }
+  *out = c;
+  return 1;
+}
+
+/* The letter keyed so far, if it is one */
+static size_t end_letter(HalCwDecoder *d, char *out, size_t size) {
+  size_t written = 0;
+  if (d->code_len <= HAL_CW_CODE_MAX) {
+    d->code[d->code_len] = '\0';
+    for (size_t i = 0; i < MORSE_COUNT; i++) {
+      if (strcmp(morse[i].code, d->code) == 0) {
+        written = emit(morse[i].letter, out, size);
+        d->any_letter = 1;
+        break;
+      }
+    }
+  }
+  d->code_len = 0;
+  return written;
+}
+
+static void mark_ended(HalCwDecoder *d, int ms) {
+  char element;
+  if (ms < 2.0f * d->dot_ms) {
+    element = '.';
+    d->dot_ms += (ms - d->dot_ms) * CW_DOT_RATE;
+  } else {
+    element = '-';
+    d->dot_ms += (ms / 3.0f - d->dot_ms) * CW_DOT_RATE;
+  }
+  if (d->dot_ms < CW_DOT_MIN_MS) {
+    d->dot_ms = CW_DOT_MIN_MS;
+  } else if (d->dot_ms > CW_DOT_MAX_MS) {
+    d->dot_ms = CW_DOT_MAX_MS;
+  }
+  if (d->code_len < HAL_CW_CODE_MAX) {
+    d->code[d->code_len] = element;
+  }
+  if (d->code_len <= HAL_CW_CODE_MAX) {
+    d->code_len++; /* One past the end: not a letter */
+  }
+  d->letter_ended = 0;
+  d->word_ended = 0;
+}
+
+static void gap_ended(HalCwDecoder *d, int ms) {
+  if (d->code_len > 0 && ms < 2.0f * d->dot_ms) {
+    d->dot_ms += (ms - d->dot_ms) * CW_GAP_RATE; /* Inside a letter */
+  }
+}
+
+/* Letter and word ends while the key is up */
+static size_t gap_running(HalCwDecoder *d, char *out, size_t size) {
+  size_t written = 0;
+  if (!d->letter_ended && d->code_len > 0 && d->run_ms >= 2.0f * d->dot_ms) {
+    written += end_letter(d, out, size);
+    d->letter_ended = 1;
+  }
+  if (!d->word_ended && d->any_letter && d->run_ms >= 5.0f * d->dot_ms) {
+    written += emit(' ', out + written, size - written);
+    d->word_ended = 1;
+    d->any_letter = 0;
+  }
+  return written;
+}
+
+/* Measure the block just filled and time the key */
+static size_t decode_block(HalCwDecoder *d, char *out, size_t size) {
+  float power[HAL_CW_BINS];
+  goertzel_bank(d->coeff, d->samples, power);
+
+  int best = d->pitch;
+  for (int b = 0; b < HAL_CW_BINS; b++) {
+    d->average[b] += (power[b] - d->average[b]) * CW_AVERAGE_RATE;
+    if (d->average[b] > d->average[best]) {
+      best = b;
+    }
+  }
+  if (d->average[best] > d->average[d->pitch] * CW_PITCH_SWITCH) {
+    d->pitch = best;
+  }
+
+  float level = power[d->pitch];
+  if (d->floor < 0.0f) {
+    d->floor = level;
+  }
+  d->peak = level > d->peak ? level : d->peak * CW_PEAK_DECAY;
+  if (d->peak < d->floor) {
+    d->peak = d->floor;
+  }
+  int signal = d->peak > CW_MIN_POWER && d->peak > d->floor * CW_SNR;
+  float threshold =
+      d->floor + (d->peak - d->floor) * (d->key_down ? 0.35f : 0.5f);
+  int down = signal && level > threshold;
+  if (!down && !d->key_down) {
+    d->floor += (level - d->floor) * CW_FLOOR_RATE; /* Only noise */
+  }
+
+  size_t written = 0;
+  d->run_ms += CW_BLOCK_MS;
+  if (down == d->key_down) {
+    d->pending = 0;
+  } else if (++d->pending >= CW_DEBOUNCE) {
+    int started = d->pending * CW_BLOCK_MS;
+    int ended = d->run_ms - started;
+    if (d->key_down) {
+      mark_ended(d, ended);
+    } else {
+      gap_ended(d, ended);
+    }
+    d->key_down = down;
+    d->run_ms = started;
+    d->pending = 0;
+  }
+  if (!d->key_down) {
+    written = gap_running(d, out, size);
+  }
+  return written;
+}
+
+size_t hal_cw_decoder_feed(HalCwDecoder *d, const int16_t *samples,
+                           size_t num_samples, char *out, size_t size) {
+  size_t written = 0;
+  while (num_samples > 0) {
+    size_t n = HAL_CW_BLOCK - (size_t)d->filled;
+    if (n > num_samples) {
+      n = num_samples;
+    }
+    scale_samples(samples, n, d->samples + d->filled);
+    d->filled += (int)n;
+    samples += n;
+    num_samples -= n;
+    if (d->filled == HAL_CW_BLOCK) {
+      written += decode_block(d, out + written, size - written);
+      d->filled = 0;
+    }
+  }
+  return written;
+}
+
+int hal_cw_decoder_wpm(const HalCwDecoder *d) {
+  return (int)(1200.0f / d->dot_ms + 0.5f);
+}
+
+int hal_cw_decoder_pitch(const HalCwDecoder *d) {
+  return HAL_CW_PITCH_LOW + d->pitch * HAL_CW_PITCH_STEP;
+}
@@ -0,0 +1,90 @@
+#ifndef HAL_CW_DECODER_H
+#define HAL_CW_DECODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @file hal_cw_decoder.h
+ * @brief Morse code decoder for the radio's receive audio
+ *
+ * Takes HAL_CW_RATE mono samples and gives the text keyed in them. Every
+ * HAL_CW_BLOCK samples (8 ms) a bank of Goertzel filters measures
+ * HAL_CW_BINS pitches from HAL_CW_PITCH_LOW up, HAL_CW_PITCH_STEP apart,
+ * which covers the CW offsets radios are set to. The strongest pitch over
+ * the last second or so is followed, so the operator need not tune
+ * exactly.
+ *
+ * The key is down while the level at that pitch is well above a noise
+ * floor the decoder keeps learning, relative to the recent peak, with
+ * hysteresis so a fading signal does not chatter. Marks shorter than
+ * twice the dot length are dots and longer ones dashes; the dot length
+ * follows the sender, from every mark and from the gaps inside letters.
+ * A gap of twice the dot length ends a letter, five dot lengths a word.
+ *
+ * The filter bank is the only real work: with NEON (Pi 3 and later in
+ * 64-bit) it runs four pitches per instruction, and either way costs far
+ * less than a percent of one core, so it can run beside Piper.
+ *
+ * Not thread safe: one thread feeds a decoder.
+ */
+
+#define HAL_CW_RATE 8000
+#define HAL_CW_BLOCK 64          /* 8 ms, three blocks per dot at 45 wpm */
+#define HAL_CW_BINS 16           /* A multiple of 4 */
+#define HAL_CW_PITCH_LOW 400     /* Hz */
+#define HAL_CW_PITCH_STEP 50     /* Hz, so 400 to 1150 Hz */
+#define HAL_CW_CODE_MAX 7        /* Longest code, in dots and dashes */
+
+/**
+ * @brief Decoder state; zero it with hal_cw_decoder_init()
+ */
+typedef struct {
+  float coeff[HAL_CW_BINS];   /* Goertzel coefficient per pitch */
+  float samples[HAL_CW_BLOCK]; /* Current block, scaled to +-1 */
+  int filled;                 /* Samples in it */
+  float average[HAL_CW_BINS]; /* Power per pitch, smoothed */
+  int pitch;                  /* Bin followed */
+  float floor;                /* Noise floor at that pitch */
+  float peak;                 /* Recent signal peak */
+  int key_down;
+  int run_ms;                 /* How long the key has been as it is */
+  int pending;                /* Blocks the key has seemed the other way */
+  float dot_ms;               /* Dot length of the sender */
+  char code[HAL_CW_CODE_MAX + 1]; /* Dots and dashes of this letter */
+  int code_len;
+  int letter_ended;           /* The gap running has ended the letter */
+  int word_ended;             /* ...and the word */
+  int any_letter;             /* Something was decoded since the last word */
+} HalCwDecoder;
+
+/**
+ * @brief Start decoding afresh, at 20 wpm until the sender is timed
+ */
+void hal_cw_decoder_init(HalCwDecoder *d);
+
+/**
+ * @brief Decode samples
+ *
+ * @param d The decoder
+ * @param samples HAL_CW_RATE mono samples, any number
+ * @param num_samples How many
+ * @param out Receives the letters decoded, and a space after each word
+ *        (not NUL-terminated)
+ * @param size Room in out; letters that do not fit are lost
+ * @return The number of characters written to out
+ */
+size_t hal_cw_decoder_feed(HalCwDecoder *d, const int16_t *samples,
+                           size_t num_samples, char *out, size_t size);
+
+/**
+ * @brief Sending speed, from the dot length, in words per minute
+ */
+int hal_cw_decoder_wpm(const HalCwDecoder *d);
+
+/**
+ * @brief Pitch being followed, in Hz
+ */
+int hal_cw_decoder_pitch(const HalCwDecoder *d);
+
+#endif /* HAL_CW_DECODER_H */
@@ -11,6 +11,29 @@
 
 #include <stdint.h>
 
+/**
+ * @brief Replay a recorded keypad trace instead of reading the keypads
+ *
+ * Names a file of struct input_event as read from a keypad's event
+ * device. hal_keypad_init() then opens no device and feeds the trace's
+ * events in at their recorded spacing, for repeatable tests and latency
+ * benchmarks of the 0/00, repeat and hold handling.
+ */
+#define HAL_KEYPAD_REPLAY_ENV "HAMPOD_KEYPAD_REPLAY"
+
+/**
+ * @brief Keypad event actions
+ *
+ * Releases and holds are reported with valid = 0 so that callers which only
+ * look at `valid` (the polled 'r' path) keep seeing presses and repeats
+ * only.
+ */
+#define KEYPAD_ACTION_NONE 0    /**< No event */
+#define KEYPAD_ACTION_PRESS 1   /**< Key went down */
+#define KEYPAD_ACTION_RELEASE 2 /**< Key came up */
+#define KEYPAD_ACTION_REPEAT 3  /**< Kernel auto-repeat while held */
+#define KEYPAD_ACTION_HOLD 4    /**< Held for the hold threshold */
+
 /**
  * @brief Keypad event structure
  *
@@ -22,6 +45,8 @@ typedef struct {
   int raw_code; /**< Raw keycode from device (implementation-specific) */
   unsigned char
       valid; /**< 1 if valid single key, 0 if invalid/multiple/no key */
+  unsigned char action;  /**< KEYPAD_ACTION_* for this event */
+  uint64_t timestamp_us; /**< Kernel event time in microseconds, 0 if none */
 } KeypadEvent;
 
 /**
@@ -30,7 +55,11 @@ typedef struct {
  * Opens and configures the keypad device for reading.
  * Must be called before any other HAL keypad functions.
  *
- * @return 0 on success, negative error code on failure
+ * Keypads plugged in (or re-plugged) later are picked up by
+ * hal_keypad_wait(), so a failed init can still be followed by reads.
+ * With HAL_KEYPAD_REPLAY_ENV set, the trace it names is the only keypad.
+ *
+ * @return 0 on success, negative error code if no keypad is open yet
  */
 int hal_keypad_init(void);
 
@@ -44,6 +73,29 @@ int hal_keypad_init(void);
  */
 KeypadEvent hal_keypad_read(void);
 
+/**
+ * @brief Wait for a keypad event (blocking)
+ *
+ * Sleeps in epoll on every keypad device until an event (press, release,
+ * repeat or hold) is available, then returns it. In phone layout a pending
+ * 0/00 decision wakes the wait when its window closes, so a single '0'
+ * is reported without any further input.
+ *
+ * @param timeout_ms Maximum time to wait, 0 to poll, negative to wait
+ *                   forever
+ * @return The event, or one with action KEYPAD_ACTION_NONE on timeout or
+ *         after hal_keypad_wake()
+ */
+KeypadEvent hal_keypad_wait(int timeout_ms);
+
+/**
+ * @brief Make hal_keypad_wait() return early
+ *
+ * Safe to call from another thread. If nobody is waiting, the next
+ * hal_keypad_wait() returns immediately instead.
+ */
+void hal_keypad_wake(void);
+
 /**
  * @brief Cleanup keypad resources
  *
@@ -62,6 +114,17 @@ void hal_keypad_cleanup(void);
  */
 const char *hal_keypad_get_impl_name(void);
 
+/**
+ * @brief Set the hold threshold
+ *
+ * Once a key has been down this long, the next read reports one
+ * KEYPAD_ACTION_HOLD for it, stamped press time + threshold.
+ * hal_keypad_wait() wakes up for it on its own.
+ *
+ * @param ms Threshold in milliseconds, 0 to turn hold events off (default)
+ */
+void hal_keypad_set_hold_threshold(int ms);
+
 /**
  * @brief Set keypad layout mode
  *
@@ -8,23 +8,46 @@
  * Supports two layout modes selectable at runtime:
  *   - Calculator (default): 7-8-9 on top row, matching key labels
  *   - Phone: 1-2-3 on top row, positional mapping to original HAMPOD layout
+ *
+ * Keypads are hotplugged: an inotify watch on /dev/input/by-id sits in the
+ * same epoll set as the devices, so hal_keypad_wait() opens a re-plugged
+ * keypad as soon as udev creates its link. Unplugged devices are closed
+ * when they report ENODEV / EPOLLHUP.
+ *
+ * With HAL_KEYPAD_REPLAY_ENV set, a recorded trace stands in for the
+ * keypads (see keypad_replay_open()), so the 0/00, repeat and hold logic
+ * can be run and timed without pressing keys.
  */
 
 #include "hal_keypad.h"
+#include <errno.h>
 #include <fcntl.h>
 #include <glob.h>
 #include <linux/input.h>
+#include <poll.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
 #include <sys/time.h>
+#include <time.h>
 #include <unistd.h>
 
 /* Implementation constants */
-#define KEYPAD_DEVICE_PATTERN "/dev/input/by-id/*-kbd*"
+#define KEYPAD_DEVICE_DIR "/dev/input/by-id"
+#define KEYPAD_INPUT_DIR "/dev/input"
+#define KEYPAD_DEVICE_PATTERN KEYPAD_DEVICE_DIR "/*-kbd*"
 #define KEYPAD_EVENT_PATTERN "/dev/input/event*"
 
-/* 0/00 disambiguation window (measured: 16-24ms between events) */
+/* 0/00 disambiguation window (measured: 16-24ms between events). This is
+ * the ceiling; each keypad's window shrinks to its own measured '00' gap
+ * plus KP0_GAP_MARGIN_US once it has sent a few '00' presses. */
 #define KP0_DISAMBIG_WINDOW_US 30000
+#define KP0_WINDOW_MIN_US 8000
+#define KP0_GAP_MARGIN_US 5000
 
 /* Runtime layout mode: 0 = calculator (default), 1 = phone */
 static int g_phone_layout = 0;
@@ -32,8 +55,28 @@ static int g_phone_layout = 0;
 /* File descriptors for all matching keypad devices */
 #define MAX_KEYPADS 16
 static int keypad_fds[MAX_KEYPADS];
+static char keypad_paths[MAX_KEYPADS][256]; /* Path each fd was opened from */
+
+/* What each keypad's '00' key looks like, learned from its kernel
+ * timestamps. 0 = nothing measured yet. Estimates jump up to a larger
+ * sample at once and decay slowly towards smaller ones. */
+typedef struct {
+  uint32_t gap_us;     /* First KP0 press -> second KP0 press */
+  uint32_t release_us; /* First KP0 press -> its release */
+} Kp0Profile;
+static Kp0Profile kp0_profile[MAX_KEYPADS];
 static int num_keypads = 0;
 
+/* epoll set over keypad_fds[] plus wake_fd and hotplug_fd, for
+ * hal_keypad_wait() */
+static int epoll_fd = -1;
+static int wake_fd = -1;
+
+/* inotify on KEYPAD_DEVICE_DIR (or on /dev/input until by-id appears) */
+static int hotplug_fd = -1;
+static int hotplug_wd = -1;
+static int hotplug_dir_ready = 0; /* 1 once KEYPAD_DEVICE_DIR is watched */
+
 /* Debouncing state for '00' key (calculator mode) */
 static struct {
   int last_key;
@@ -43,9 +86,16 @@ static struct {
 
 /* Key hold tracking state */
 static struct {
-  char held_key; /* Currently held key character, '-' for none */
-  int held_code; /* Raw keycode of held key, -1 for none */
-} hold_state = {'-', -1};
+  char held_key;         /* Currently held key character, '-' for none */
+  int held_code;         /* Raw keycode of held key, -1 for none */
+  int fd_idx;            /* Keypad it is held on */
+  uint64_t press_us;     /* Kernel time of the press */
+  uint64_t press_mono_us; /* Monotonic time the press was reported */
+  int hold_sent;         /* 1 once KEYPAD_ACTION_HOLD went out */
+} hold_state = {'-', -1, -1, 0, 0, 0};
+
+/* Report KEYPAD_ACTION_HOLD after this long, 0 = off */
+static int hold_threshold_ms = 0;
 
 /*
  * Phone-mode 0/00 key disambiguation state.
@@ -58,10 +108,30 @@ static struct {
  */
 static struct {
   int pending;              /* 1 if waiting to determine 0 vs 00 */
-  struct timeval wall_time; /* Wall-clock time when pending was set */
+  uint64_t armed_us;        /* Monotonic time when pending was set */
   int raw_code;             /* Saved raw keycode */
   int source_fd_idx;        /* FD index of the pending keypress */
-} kp0_defer = {0, {0, 0}, 0, -1};
+  struct timeval ev_time;   /* Kernel time of the deferred press */
+  int released;             /* 1 if the KP0 release was drained meanwhile */
+  struct timeval release_time; /* Kernel time of that release */
+} kp0_defer = {0, 0, 0, -1, {0, 0}, 0, {0, 0}};
+
+/* Release that must be reported on the next read (after a deferred press) */
+static struct {
+  int pending;
+  char key;
+  int raw_code;
+  struct timeval time;
+} deferred_release = {0, '-', -1, {0, 0}};
+
+/* Trace replay: the trace file, the pipe end that stands in for its
+ * keypad, and the thread feeding it */
+static struct {
+  int active;
+  int trace_fd;
+  int write_fd;
+  pthread_t thread;
+} replay = {0, -1, -1};
 
 /* Stash for events read during 0/00 disambiguation */
 static struct input_event stashed_ev;
@@ -207,6 +277,344 @@ static int find_usb_keypads(char paths[MAX_KEYPADS][256]) {
   return count;
 }
 
+/**
+ * @brief Convert an evdev timestamp to microseconds
+ */
+static uint64_t timeval_to_us(struct timeval tv) {
+  return (uint64_t)tv.tv_sec * 1000000ULL + (uint64_t)tv.tv_usec;
+}
+
+/**
+ * @brief Current CLOCK_MONOTONIC time in microseconds
+ */
+static uint64_t monotonic_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+/**
+ * @brief Fold one measurement into a learned '00' estimate
+ */
+static void kp0_learn(uint32_t *estimate, uint64_t sample_us) {
+  if (sample_us >= KP0_DISAMBIG_WINDOW_US) {
+    return; /* Outside the window: not a '00' key */
+  }
+  if (*estimate == 0 || sample_us > *estimate) {
+    *estimate = (uint32_t)sample_us;
+  } else {
+    *estimate = (*estimate * 7 + (uint32_t)sample_us) / 8;
+  }
+}
+
+/**
+ * @brief 0/00 window for keypad idx: its '00' gap plus margin, clamped
+ */
+static uint64_t kp0_window_us(int idx) {
+  if (idx < 0 || idx >= num_keypads || kp0_profile[idx].gap_us == 0) {
+    return KP0_DISAMBIG_WINDOW_US;
+  }
+  uint64_t window = (uint64_t)kp0_profile[idx].gap_us + KP0_GAP_MARGIN_US;
+  if (window < KP0_WINDOW_MIN_US) {
+    window = KP0_WINDOW_MIN_US;
+  }
+  return window > KP0_DISAMBIG_WINDOW_US ? KP0_DISAMBIG_WINDOW_US : window;
+}
+
+/**
+ * @brief Start hold tracking for a press that is being reported
+ */
+static void hold_start(char key, int code, int fd_idx, uint64_t press_us) {
+  hold_state.held_key = key;
+  hold_state.held_code = code;
+  hold_state.fd_idx = fd_idx;
+  hold_state.press_us = press_us;
+  hold_state.press_mono_us = monotonic_us();
+  hold_state.hold_sent = 0;
+}
+
+/**
+ * @brief Microseconds until the held key becomes a hold, -1 if none due
+ */
+static int64_t hold_remaining_us(void) {
+  if (hold_threshold_ms <= 0 || hold_state.held_key == '-' ||
+      hold_state.hold_sent) {
+    return -1;
+  }
+  uint64_t due_us =
+      hold_state.press_mono_us + (uint64_t)hold_threshold_ms * 1000ULL;
+  uint64_t now_us = monotonic_us();
+  return now_us >= due_us ? 0 : (int64_t)(due_us - now_us);
+}
+
+/**
+ * @brief 1 if any keypad has unread events
+ */
+static int keypad_input_pending(void) {
+  struct pollfd fds[MAX_KEYPADS];
+  for (int i = 0; i < num_keypads; i++) {
+    fds[i].fd = keypad_fds[i];
+    fds[i].events = POLLIN;
+  }
+  return poll(fds, num_keypads, 0) > 0;
+}
+
+/**
+ * @brief Create the epoll set and its wake eventfd
+ *
+ * Done before looking for devices so hal_keypad_wake() works even when
+ * no keypad is plugged in.
+ */
+static void keypad_epoll_setup(void) {
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd == -1) {
+    perror("HAL Keypad: epoll_create1");
+    return;
+  }
+  wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (wake_fd != -1) {
+    struct epoll_event ev = {.events = EPOLLIN, .data.fd = wake_fd};
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev);
+  } else {
+    perror("HAL Keypad: eventfd");
+  }
+
+  hotplug_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (hotplug_fd != -1) {
+    struct epoll_event ev = {.events = EPOLLIN, .data.fd = hotplug_fd};
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, hotplug_fd, &ev);
+  } else {
+    perror("HAL Keypad: inotify_init1");
+  }
+}
+
+/**
+ * @brief Watch KEYPAD_DEVICE_DIR, or /dev/input while it does not exist
+ *
+ * udev only creates by-id once the first USB input device shows up.
+ */
+static void hotplug_watch(void) {
+  if (hotplug_fd == -1 || hotplug_dir_ready) {
+    return;
+  }
+  int wd = inotify_add_watch(hotplug_fd, KEYPAD_DEVICE_DIR,
+                             IN_CREATE | IN_DELETE | IN_MOVED_TO |
+                                 IN_MOVED_FROM | IN_DELETE_SELF);
+  if (wd != -1) {
+    if (hotplug_wd != -1 && hotplug_wd != wd) {
+      inotify_rm_watch(hotplug_fd, hotplug_wd);
+    }
+    hotplug_wd = wd;
+    hotplug_dir_ready = 1;
+    return;
+  }
+  if (hotplug_wd == -1) {
+    hotplug_wd = inotify_add_watch(hotplug_fd, KEYPAD_INPUT_DIR, IN_CREATE);
+  }
+}
+
+/**
+ * @brief Open one keypad device and add it to the epoll set
+ */
+static void keypad_add_fd(int fd, const char *path);
+
+static int keypad_open_device(const char *path) {
+  if (num_keypads >= MAX_KEYPADS) {
+    return -1;
+  }
+  int fd = open(path, O_RDONLY | O_NONBLOCK);
+  if (fd < 0) {
+    perror("HAL Keypad: Failed to open device");
+    return -1;
+  }
+  keypad_add_fd(fd, path);
+  printf("HAL Keypad: Opened USB keypad %d at %s\n", num_keypads - 1, path);
+  return 0;
+}
+
+/**
+ * @brief Add an open, non-blocking event fd as the next keypad
+ */
+static void keypad_add_fd(int fd, const char *path) {
+  if (epoll_fd != -1) {
+    struct epoll_event ev = {.events = EPOLLIN, .data.fd = fd};
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+      perror("HAL Keypad: epoll_ctl");
+    }
+  }
+  keypad_fds[num_keypads] = fd;
+  memset(&kp0_profile[num_keypads], 0, sizeof(kp0_profile[num_keypads]));
+  strncpy(keypad_paths[num_keypads], path, 255);
+  keypad_paths[num_keypads][255] = '\0';
+  num_keypads++;
+}
+
+/**
+ * @brief Feed the trace to the pipe, each event at its recorded time
+ *
+ * Events keep their recorded spacing from the first one, on absolute
+ * CLOCK_MONOTONIC deadlines so a late wakeup does not shift the rest, and
+ * are stamped with the recorded offsets from the time the replay started:
+ * what the HAL decides from kernel timestamps comes out the same on every
+ * run.
+ */
+static void *keypad_replay_thread(void *arg) {
+  const char *path = arg;
+  struct input_event ev;
+  uint64_t first_us = 0;
+  uint64_t start_mono_us = monotonic_us();
+  struct timeval start_real;
+  gettimeofday(&start_real, NULL);
+  uint64_t start_real_us = timeval_to_us(start_real);
+  int count = 0;
+
+  while (read(replay.trace_fd, &ev, sizeof(ev)) == sizeof(ev)) {
+    uint64_t ev_us = timeval_to_us(ev.time);
+    if (count == 0) {
+      first_us = ev_us;
+    }
+    uint64_t offset_us = ev_us > first_us ? ev_us - first_us : 0;
+    uint64_t due_us = start_mono_us + offset_us;
+    struct timespec due = {.tv_sec = (time_t)(due_us / 1000000ULL),
+                           .tv_nsec = (long)(due_us % 1000000ULL) * 1000L};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) ==
+           EINTR) {
+    }
+    ev.time.tv_sec = (time_t)((start_real_us + offset_us) / 1000000ULL);
+    ev.time.tv_usec = (suseconds_t)((start_real_us + offset_us) % 1000000ULL);
+    if (write(replay.write_fd, &ev, sizeof(ev)) != sizeof(ev)) {
+      break;
+    }
+    count++;
+  }
+  /* The write end stays open: a hangup would read as an unplug */
+  printf("HAL Keypad: Replayed %d events from %s\n", count, path);
+  return NULL;
+}
+
+/**
+ * @brief Stand a recorded trace in for the keypads
+ *
+ * The trace is a file of struct input_event as read from a keypad's
+ * event device (`cat /dev/input/by-id/...-kbd > trace` records one).
+ * Its events go through a pipe that is read as the only keypad, so the
+ * rest of the HAL runs exactly as it does live.
+ */
+static int keypad_replay_open(const char *path) {
+  static char trace_path[256];
+  snprintf(trace_path, sizeof(trace_path), "%s", path);
+  int fds[2];
+  replay.trace_fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (replay.trace_fd < 0) {
+    perror("HAL Keypad: Failed to open replay trace");
+    return -1;
+  }
+  if (pipe(fds) != 0) {
+    perror("HAL Keypad: pipe");
+    close(replay.trace_fd);
+    replay.trace_fd = -1;
+    return -1;
+  }
+  fcntl(fds[0], F_SETFL, O_NONBLOCK);
+  replay.write_fd = fds[1];
+  keypad_add_fd(fds[0], trace_path);
+  if (pthread_create(&replay.thread, NULL, keypad_replay_thread,
+                     trace_path) != 0) {
+    perror("HAL Keypad: Failed to start replay");
+    return -1; /* hal_keypad_cleanup() closes the rest */
+  }
+  replay.active = 1;
+  printf("HAL Keypad: Replaying %s (layout: %s)\n", path,
+         g_phone_layout ? "phone" : "calculator");
+  return 0;
+}
+
+/**
+ * @brief Close keypad idx (unplugged) and condense the arrays
+ */
+static void keypad_close_device(int idx) {
+  printf("HAL Keypad: Keypad %d at %s removed\n", idx, keypad_paths[idx]);
+  close(keypad_fds[idx]); /* Also drops it from the epoll set */
+
+  /* A half-resolved 0/00 on that device is gone with it */
+  if (kp0_defer.source_fd_idx == idx) {
+    kp0_defer.pending = 0;
+    has_stashed_ev = 0;
+  } else if (kp0_defer.source_fd_idx > idx) {
+    kp0_defer.source_fd_idx--;
+  }
+
+  /* A key held on it will never see its release: report one now */
+  if (hold_state.held_key != '-' && hold_state.fd_idx == idx) {
+    deferred_release.pending = 1;
+    deferred_release.key = hold_state.held_key;
+    deferred_release.raw_code = hold_state.held_code;
+    gettimeofday(&deferred_release.time, NULL);
+  } else if (hold_state.fd_idx > idx) {
+    hold_state.fd_idx--;
+  }
+
+  for (int i = idx; i < num_keypads - 1; i++) {
+    keypad_fds[i] = keypad_fds[i + 1];
+    memcpy(keypad_paths[i], keypad_paths[i + 1], sizeof(keypad_paths[i]));
+    kp0_profile[i] = kp0_profile[i + 1];
+  }
+  num_keypads--;
+}
+
+/**
+ * @brief Open every keypad that matches but is not open yet
+ */
+static void keypad_rescan(void) {
+  char paths[MAX_KEYPADS][256];
+  int count = find_usb_keypads(paths);
+  for (int i = 0; i < count; i++) {
+    int known = 0;
+    for (int j = 0; j < num_keypads; j++) {
+      if (strcmp(paths[i], keypad_paths[j]) == 0) {
+        known = 1;
+        break;
+      }
+    }
+    if (!known) {
+      keypad_open_device(paths[i]);
+    }
+  }
+}
+
+/**
+ * @brief Drain inotify and pick up added or removed keypads
+ */
+static void hotplug_handle(void) {
+  char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  int changed = 0;
+  ssize_t len;
+  while ((len = read(hotplug_fd, buf, sizeof(buf))) > 0) {
+    for (char *p = buf; p < buf + len;) {
+      struct inotify_event *ie = (struct inotify_event *)p;
+      if ((ie->mask & (IN_DELETE_SELF | IN_IGNORED)) &&
+          ie->wd == hotplug_wd) {
+        hotplug_dir_ready = 0; /* by-id went away, watch /dev/input again */
+        hotplug_wd = -1;
+      }
+      changed = 1;
+      p += sizeof(struct inotify_event) + ie->len;
+    }
+  }
+  if (!changed) {
+    return;
+  }
+  hotplug_watch();
+
+  /* Links that vanished: close their fds even if no ENODEV was seen yet */
+  for (int i = num_keypads - 1; i >= 0; i--) {
+    if (access(keypad_paths[i], F_OK) != 0) {
+      keypad_close_device(i);
+    }
+  }
+  keypad_rescan();
+}
+
 /**
  * @brief Map keycode to HAMPOD symbol using the active keymap
  */
@@ -224,43 +632,32 @@ static char map_keycode_to_symbol(int keycode) {
 /* HAL Implementation Functions */
 
 int hal_keypad_init(void) {
-  char device_paths[MAX_KEYPADS][256];
-  num_keypads = find_usb_keypads(device_paths);
-
-  if (num_keypads == 0) {
-    fprintf(stderr, "HAL Keypad: No USB keypad devices found\n");
-    return -1;
+  if (epoll_fd == -1) {
+    keypad_epoll_setup();
   }
-
-  int success = 0;
-  for (int i = 0; i < num_keypads; i++) {
-    keypad_fds[i] = open(device_paths[i], O_RDONLY | O_NONBLOCK);
-    if (keypad_fds[i] >= 0) {
-      printf("HAL Keypad: Opened USB keypad %d at %s\n", i, device_paths[i]);
-      success++;
-    } else {
-      perror("HAL Keypad: Failed to open device");
-    }
+  const char *trace = getenv(HAL_KEYPAD_REPLAY_ENV);
+  if (trace != NULL && trace[0] != '\0') {
+    return keypad_replay_open(trace); /* No devices, no hotplug */
   }
+  /* Watch first, so a keypad plugged in during the scan is not missed */
+  hotplug_watch();
+  keypad_rescan();
 
-  if (success == 0) {
+  if (num_keypads == 0) {
+    fprintf(stderr, "HAL Keypad: No USB keypad devices found%s\n",
+            hotplug_fd != -1 ? ", waiting for one to be plugged in" : "");
     return -1;
   }
 
-  // Condense the fd array
-  int j = 0;
-  for (int i = 0; i < num_keypads; i++) {
-    if (keypad_fds[i] >= 0) {
-      keypad_fds[j++] = keypad_fds[i];
-    }
-  }
-  num_keypads = j;
-
   printf("HAL Keypad: Initialized %d USB keypads (layout: %s)\n", num_keypads,
          g_phone_layout ? "phone" : "calculator");
   return 0;
 }
 
+void hal_keypad_set_hold_threshold(int ms) {
+  hold_threshold_ms = ms > 0 ? ms : 0;
+}
+
 void hal_keypad_set_phone_layout(int phone_layout) {
   g_phone_layout = phone_layout ? 1 : 0;
   printf("HAL Keypad: Layout set to %s\n",
@@ -273,10 +670,36 @@ KeypadEvent hal_keypad_read(void) {
   ssize_t bytes_read = -1;
   int current_fd_idx = -1;
 
+  /* ── Release owed from a resolved 0/00 press (or an unplug) ──────── */
+  if (deferred_release.pending) {
+    deferred_release.pending = 0;
+    event.key = deferred_release.key;
+    event.raw_code = deferred_release.raw_code;
+    event.action = KEYPAD_ACTION_RELEASE;
+    event.timestamp_us = timeval_to_us(deferred_release.time);
+    if (hold_state.held_code == deferred_release.raw_code) {
+      hold_state.held_key = '-';
+      hold_state.held_code = -1;
+    }
+    return event;
+  }
+
   if (num_keypads == 0) {
     return event;
   }
 
+  /* ── Held key crossed the hold threshold ─────────────────────────── */
+  /* Unread input goes first: it may be a release from before the deadline */
+  if (hold_remaining_us() == 0 && !keypad_input_pending()) {
+    hold_state.hold_sent = 1;
+    event.key = hold_state.held_key;
+    event.raw_code = hold_state.held_code;
+    event.action = KEYPAD_ACTION_HOLD;
+    event.timestamp_us =
+        hold_state.press_us + (uint64_t)hold_threshold_ms * 1000ULL;
+    return event;
+  }
+
   /* ── Phone-mode: 0/00 disambiguation ────────────────────────────── */
   if (g_phone_layout && kp0_defer.pending) {
     /*
@@ -284,26 +707,65 @@ KeypadEvent hal_keypad_read(void) {
      * looking for the second KEY_KP0 press that indicates '00' key.
      * The '00' key sends: press, release, press, release — all within ~24ms.
      */
+    int idx = kp0_defer.source_fd_idx;
+    uint64_t press_ts = timeval_to_us(kp0_defer.ev_time);
+    uint64_t window_us = kp0_window_us(idx);
+    int decided = 0; /* 1 once the events already rule out '00' */
     if (!has_stashed_ev) {
       while (1) {
         bytes_read = read(keypad_fds[kp0_defer.source_fd_idx], &ev, sizeof(ev));
         if (bytes_read != sizeof(ev))
           break; /* Buffer empty */
 
+        /* Anything stamped past the window means the window is over,
+         * however late we got to read it */
+        uint64_t ev_ts = timeval_to_us(ev.time);
+        if (ev_ts >= press_ts + window_us &&
+            !(ev.type == EV_KEY && ev.value == 1)) {
+          decided = 1;
+          if (ev.type == EV_KEY && ev.value == 0 && ev.code == KEY_KP0) {
+            kp0_defer.released = 1;
+            kp0_defer.release_time = ev.time;
+          }
+          break;
+        }
+
         if (ev.type != EV_KEY)
           continue; /* Skip non-key events (SYN, etc) */
 
         if (ev.code == KEY_KP0 && ev.value == 1) {
           /* Found second KEY_KP0 press — this is the '00' key */
+          kp0_learn(&kp0_profile[idx].gap_us, ev_ts - press_ts);
+          if (kp0_defer.released) {
+            kp0_learn(&kp0_profile[idx].release_us,
+                      timeval_to_us(kp0_defer.release_time) - press_ts);
+          }
           kp0_defer.pending = 0;
           event.key = '0'; /* '00' maps to '0' in phone mode */
           event.raw_code = ev.code;
           event.valid = 1;
-          hold_state.held_key = event.key;
-          hold_state.held_code = ev.code;
+          event.action = KEYPAD_ACTION_PRESS;
+          event.timestamp_us = timeval_to_us(kp0_defer.ev_time);
+          hold_start(event.key, ev.code, kp0_defer.source_fd_idx,
+                     event.timestamp_us);
           return event;
         }
 
+        if (ev.code == KEY_KP0 && ev.value == 0) {
+          /* Remember the release so it can be reported after the press */
+          kp0_defer.released = 1;
+          kp0_defer.release_time = ev.time;
+          /* Held much longer than this keypad's '00' ever holds: a
+           * finger, not the double event */
+          if (kp0_profile[idx].release_us != 0 &&
+              ev_ts - press_ts >
+                  (uint64_t)kp0_profile[idx].release_us + KP0_GAP_MARGIN_US) {
+            decided = 1;
+            break;
+          }
+          continue;
+        }
+
         if (ev.value == 1) {
           /* A different key was pressed — stash it, resolve pending as '*' */
           stashed_ev = ev;
@@ -315,20 +777,25 @@ KeypadEvent hal_keypad_read(void) {
       }
     }
 
-    /* Check wall-clock timeout */
-    struct timeval now;
-    gettimeofday(&now, NULL);
-    long elapsed_us = (now.tv_sec - kp0_defer.wall_time.tv_sec) * 1000000L +
-                      (now.tv_usec - kp0_defer.wall_time.tv_usec);
+    /* Window over? hal_keypad_wait() sleeps until exactly this point */
+    uint64_t elapsed_us = monotonic_us() - kp0_defer.armed_us;
 
-    if (elapsed_us >= KP0_DISAMBIG_WINDOW_US || has_stashed_ev) {
-      /* Timeout or different key arrived: single '0' press → '*' */
+    if (elapsed_us >= window_us || has_stashed_ev || decided) {
+      /* Timeout, different key or a plain tap: single '0' press → '*' */
       kp0_defer.pending = 0;
       event.key = '*';
       event.raw_code = kp0_defer.raw_code;
       event.valid = 1;
-      hold_state.held_key = event.key;
-      hold_state.held_code = event.raw_code;
+      event.action = KEYPAD_ACTION_PRESS;
+      event.timestamp_us = timeval_to_us(kp0_defer.ev_time);
+      hold_start(event.key, event.raw_code, kp0_defer.source_fd_idx,
+                 event.timestamp_us);
+      if (kp0_defer.released) {
+        deferred_release.pending = 1;
+        deferred_release.key = event.key;
+        deferred_release.raw_code = event.raw_code;
+        deferred_release.time = kp0_defer.release_time;
+      }
       return event;
     }
 
@@ -351,20 +818,26 @@ KeypadEvent hal_keypad_read(void) {
         current_fd_idx = i;
         break;
       }
+      if (bytes_read == -1 && errno == ENODEV) {
+        keypad_close_device(i--); /* Unplugged */
+      }
     }
   }
 
   if (bytes_read == sizeof(ev) && ev.type == EV_KEY) {
+    event.timestamp_us = timeval_to_us(ev.time);
 
     if (ev.value == 1) { /* Key press down */
 
       /* Phone-mode: defer KEY_KP0 for 0/00 disambiguation */
       if (g_phone_layout && ev.code == KEY_KP0) {
         kp0_defer.pending = 1;
-        gettimeofday(&kp0_defer.wall_time, NULL);
+        kp0_defer.armed_us = monotonic_us();
         kp0_defer.raw_code = ev.code;
         kp0_defer.source_fd_idx = current_fd_idx; /* Store where it came from */
-        return event;                             /* Don't report yet */
+        kp0_defer.ev_time = ev.time;
+        kp0_defer.released = 0;
+        return event; /* Don't report yet */
       }
 
       /* Calculator-mode: debounce '00' key */
@@ -389,17 +862,21 @@ KeypadEvent hal_keypad_read(void) {
       char key_char = map_keycode_to_symbol(ev.code);
 
       /* Update hold state */
-      hold_state.held_key = key_char;
-      hold_state.held_code = ev.code;
+      hold_start(key_char, ev.code, current_fd_idx, event.timestamp_us);
 
       /* Return the press event */
       event.raw_code = ev.code;
       event.key = key_char;
       event.valid = (key_char != '-') ? 1 : 0;
+      event.action = event.valid ? KEYPAD_ACTION_PRESS : KEYPAD_ACTION_NONE;
 
     } else if (ev.value == 0) { /* Key release */
 
       if (ev.code == hold_state.held_code) {
+        /* Reported with valid = 0 so polling callers ignore it */
+        event.key = hold_state.held_key;
+        event.raw_code = ev.code;
+        event.action = KEYPAD_ACTION_RELEASE;
         hold_state.held_key = '-';
         hold_state.held_code = -1;
       }
@@ -410,6 +887,7 @@ KeypadEvent hal_keypad_read(void) {
         event.raw_code = hold_state.held_code;
         event.key = hold_state.held_key;
         event.valid = 1;
+        event.action = KEYPAD_ACTION_REPEAT;
       }
     }
   }
@@ -417,7 +895,105 @@ KeypadEvent hal_keypad_read(void) {
   return event;
 }
 
+KeypadEvent hal_keypad_wait(int timeout_ms) {
+  uint64_t deadline_us =
+      timeout_ms >= 0 ? monotonic_us() + (uint64_t)timeout_ms * 1000ULL : 0;
+
+  while (1) {
+    KeypadEvent event = hal_keypad_read();
+    if (event.action != KEYPAD_ACTION_NONE) {
+      return event;
+    }
+    if (deferred_release.pending || has_stashed_ev) {
+      continue; /* Already buffered, the next read reports it */
+    }
+
+    /* Sleep for the rest of the caller's timeout ... */
+    int wait_ms = -1;
+    uint64_t now_us = monotonic_us();
+    if (timeout_ms >= 0) {
+      if (now_us >= deadline_us) {
+        return event;
+      }
+      wait_ms = (int)((deadline_us - now_us + 999) / 1000);
+    }
+
+    /* ... or only until a pending 0/00 window closes or the held key
+     * becomes a hold, whichever is first */
+    if (g_phone_layout && kp0_defer.pending) {
+      uint64_t window_end_us =
+          kp0_defer.armed_us + kp0_window_us(kp0_defer.source_fd_idx);
+      int window_ms = now_us >= window_end_us
+                          ? 0
+                          : (int)((window_end_us - now_us + 999) / 1000);
+      if (wait_ms < 0 || window_ms < wait_ms) {
+        wait_ms = window_ms;
+      }
+    }
+    int64_t hold_us = hold_remaining_us();
+    if (hold_us >= 0) {
+      int hold_ms = (int)((hold_us + 999) / 1000);
+      if (wait_ms < 0 || hold_ms < wait_ms) {
+        wait_ms = hold_ms;
+      }
+    }
+
+    if (epoll_fd == -1) {
+      /* No epoll set: fall back to a short sleep so callers don't spin */
+      int nap_ms = (wait_ms < 0 || wait_ms > 10) ? 10 : wait_ms;
+      usleep((useconds_t)nap_ms * 1000);
+      continue;
+    }
+
+    struct epoll_event ready[MAX_KEYPADS + 1];
+    int n = epoll_wait(epoll_fd, ready, MAX_KEYPADS + 1, wait_ms);
+    if (n == -1 && errno != EINTR) {
+      perror("HAL Keypad: epoll_wait");
+      return event;
+    }
+    for (int i = 0; i < n; i++) {
+      if (ready[i].data.fd == hotplug_fd) {
+        hotplug_handle();
+        continue;
+      }
+      if (ready[i].events & (EPOLLERR | EPOLLHUP)) {
+        for (int k = 0; k < num_keypads; k++) {
+          if (keypad_fds[k] == ready[i].data.fd) {
+            keypad_close_device(k);
+            break;
+          }
+        }
+        continue;
+      }
+      if (ready[i].data.fd == wake_fd) {
+        uint64_t count;
+        if (read(wake_fd, &count, sizeof(count)) < 0) {
+          /* Already drained by another wakeup */
+        }
+        return event;
+      }
+    }
+  }
+}
+
+void hal_keypad_wake(void) {
+  uint64_t one = 1;
+  if (wake_fd != -1 && write(wake_fd, &one, sizeof(one)) < 0) {
+    /* Counter saturated: a wakeup is already pending */
+  }
+}
+
 void hal_keypad_cleanup(void) {
+  if (replay.active) {
+    pthread_cancel(replay.thread); /* Asleep until the next event */
+    pthread_join(replay.thread, NULL);
+    replay.active = 0;
+  }
+  if (replay.write_fd != -1) {
+    close(replay.write_fd);
+    close(replay.trace_fd);
+    replay.write_fd = replay.trace_fd = -1;
+  }
   for (int i = 0; i < num_keypads; i++) {
     if (keypad_fds[i] >= 0) {
       close(keypad_fds[i]);
@@ -425,7 +1001,24 @@ void hal_keypad_cleanup(void) {
     }
   }
   num_keypads = 0;
+  if (wake_fd != -1) {
+    close(wake_fd);
+    wake_fd = -1;
+  }
+  if (hotplug_fd != -1) {
+    close(hotplug_fd);
+    hotplug_fd = -1;
+    hotplug_wd = -1;
+    hotplug_dir_ready = 0;
+  }
+  if (epoll_fd != -1) {
+    close(epoll_fd);
+    epoll_fd = -1;
+  }
   printf("HAL Keypad: Cleaned up\n");
 }
 
-const char *hal_keypad_get_impl_name(void) { return "USB Numeric Keypad"; }
+const char *hal_keypad_get_impl_name(void) {
+  return replay.write_fd != -1 ? "USB Numeric Keypad (trace replay)"
+                               : "USB Numeric Keypad";
+}
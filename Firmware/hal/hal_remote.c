@@ -0,0 +1,348 @@
+/**
+ * @file hal_remote.c
+ * @brief Remote station protocol, jitter buffer and key receiver
+ *
+ * The key receiver thread sleeps in poll() on its socket and a stop pipe.
+ * A remote event's time is put on this machine's clock by the smallest
+ * offset seen between the two clocks (the fastest datagram), so press
+ * and release keep the spacing the operator gave them however the
+ * network delays each one; a hold stays a hold.
+ */
+
+#include "hal_remote.h"
+#include "../hampod_metrics.h"
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+/* ========================================================================
+ * Wire format
+ * ======================================================================== */
+
+static void put_u32(unsigned char *out, uint32_t v) {
+  for (int i = 0; i < 4; i++) {
+    out[i] = (unsigned char)(v >> (8 * i));
+  }
+}
+
+static uint32_t get_u32(const unsigned char *in) {
+  return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) |
+         ((uint32_t)in[3] << 24);
+}
+
+int hal_remote_parse_address(const char *spec, struct sockaddr_in *addr) {
+  char host[128];
+  const char *colon = spec != NULL ? strrchr(spec, ':') : NULL;
+  if (colon == NULL || colon == spec ||
+      (size_t)(colon - spec) >= sizeof(host)) {
+    return -1;
+  }
+  int port = atoi(colon + 1);
+  if (port <= 0 || port > 65535) {
+    return -1;
+  }
+  memcpy(host, spec, (size_t)(colon - spec));
+  host[colon - spec] = '\0';
+
+  struct addrinfo hints = {0};
+  struct addrinfo *found = NULL;
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_DGRAM;
+  if (getaddrinfo(host, NULL, &hints, &found) != 0 || found == NULL) {
+    return -1;
+  }
+  memcpy(addr, found->ai_addr, sizeof(*addr));
+  freeaddrinfo(found);
+  addr->sin_port = htons((uint16_t)port);
+  return 0;
+}
+
+size_t hal_remote_encode_keys(uint32_t session, const RemoteKeyEvent *events,
+                              int count, unsigned char *out) {
+  if (count > REMOTE_KEY_EVENTS) {
+    events += count - REMOTE_KEY_EVENTS; /* The newest */
+    count = REMOTE_KEY_EVENTS;
+  }
+  memcpy(out, REMOTE_KEY_MAGIC, 4);
+  put_u32(&out[4], session);
+  out[8] = (unsigned char)count;
+  unsigned char *p = &out[REMOTE_KEY_HEADER_LEN];
+  for (int i = 0; i < count; i++, p += REMOTE_KEY_EVENT_LEN) {
+    put_u32(p, events[i].seq);
+    put_u32(p + 4, (uint32_t)events[i].timestamp_us);
+    put_u32(p + 8, (uint32_t)(events[i].timestamp_us >> 32));
+    p[12] = (unsigned char)events[i].key;
+    p[13] = events[i].action;
+  }
+  return (size_t)(p - out);
+}
+
+int hal_remote_decode_keys(const unsigned char *data, size_t len,
+                           uint32_t *session, RemoteKeyEvent *events) {
+  if (len < REMOTE_KEY_HEADER_LEN || memcmp(data, REMOTE_KEY_MAGIC, 4) != 0) {
+    return -1;
+  }
+  int count = data[8];
+  if (count > REMOTE_KEY_EVENTS ||
+      len != REMOTE_KEY_HEADER_LEN + (size_t)count * REMOTE_KEY_EVENT_LEN) {
+    return -1;
+  }
+  *session = get_u32(&data[4]);
+  const unsigned char *p = &data[REMOTE_KEY_HEADER_LEN];
+  for (int i = 0; i < count; i++, p += REMOTE_KEY_EVENT_LEN) {
+    events[i].seq = get_u32(p);
+    events[i].timestamp_us = get_u32(p + 4) | ((uint64_t)get_u32(p + 8) << 32);
+    events[i].key = (char)p[12];
+    events[i].action = p[13];
+  }
+  return count;
+}
+
+void hal_remote_rtp_header(unsigned char *out, int marker, uint16_t seq,
+                           uint32_t timestamp, uint32_t ssrc) {
+  out[0] = 0x80; /* Version 2, no padding, extension or CSRCs */
+  out[1] = (unsigned char)((marker ? 0x80 : 0) | REMOTE_RTP_PAYLOAD_TYPE);
+  out[2] = (unsigned char)(seq >> 8);
+  out[3] = (unsigned char)seq;
+  for (int i = 0; i < 4; i++) {
+    out[4 + i] = (unsigned char)(timestamp >> (24 - 8 * i));
+    out[8 + i] = (unsigned char)(ssrc >> (24 - 8 * i));
+  }
+}
+
+int hal_remote_rtp_parse(const unsigned char *data, size_t len, int *marker,
+                         uint16_t *seq) {
+  if (len <= REMOTE_RTP_HEADER_LEN || (data[0] & 0xC0) != 0x80 ||
+      (data[1] & 0x7F) != REMOTE_RTP_PAYLOAD_TYPE) {
+    return -1;
+  }
+  /* Skip CSRCs and an extension, should another sender add them */
+  size_t offset = REMOTE_RTP_HEADER_LEN + 4 * (size_t)(data[0] & 0x0F);
+  if ((data[0] & 0x10) && offset + 4 <= len) {
+    offset += 4 + 4 * (((size_t)data[offset + 2] << 8) | data[offset + 3]);
+  }
+  if (offset >= len) {
+    return -1;
+  }
+  *marker = (data[1] & 0x80) != 0;
+  *seq = (uint16_t)((data[2] << 8) | data[3]);
+  return (int)offset;
+}
+
+/* ========================================================================
+ * Jitter buffer
+ * ======================================================================== */
+
+static int jitter_queued(const RemoteJitter *jb) {
+  int queued = 0;
+  for (int i = 0; i < REMOTE_JITTER_SLOTS; i++) {
+    queued += jb->len[i] > 0;
+  }
+  return queued;
+}
+
+void hal_remote_jitter_init(RemoteJitter *jb, int target_ms) {
+  memset(jb->len, 0, sizeof(jb->len));
+  jb->next = 0;
+  jb->synced = 0;
+  jb->playing = 0;
+  jb->target = target_ms / REMOTE_FRAME_MS;
+  if (jb->target < 1) {
+    jb->target = 1;
+  } else if (jb->target > REMOTE_JITTER_SLOTS / 2) {
+    jb->target = REMOTE_JITTER_SLOTS / 2;
+  }
+  jb->lost = 0;
+  jb->late = 0;
+}
+
+void hal_remote_jitter_put(RemoteJitter *jb, uint16_t seq, int marker,
+                           const unsigned char *payload, size_t len) {
+  if (len == 0 || len > REMOTE_PACKET_MAX) {
+    return;
+  }
+  int16_t ahead = (int16_t)(seq - jb->next);
+  if (!jb->synced || ahead >= REMOTE_JITTER_SLOTS ||
+      (marker && jitter_queued(jb) == 0 && ahead != 0)) {
+    memset(jb->len, 0, sizeof(jb->len));
+    jb->next = seq;
+    jb->synced = 1;
+    jb->playing = 0;
+  } else if (ahead < 0) {
+    jb->late++;
+    return;
+  }
+  int slot = seq % REMOTE_JITTER_SLOTS;
+  memcpy(jb->data[slot], payload, len);
+  jb->len[slot] = (uint16_t)len;
+  jb->seq[slot] = seq;
+}
+
+int hal_remote_jitter_peek(const RemoteJitter *jb, unsigned char *payload,
+                           size_t *len) {
+  int slot = jb->next % REMOTE_JITTER_SLOTS;
+  if (!jb->synced || jb->len[slot] == 0 || jb->seq[slot] != jb->next) {
+    return 0;
+  }
+  memcpy(payload, jb->data[slot], jb->len[slot]);
+  *len = jb->len[slot];
+  return 1;
+}
+
+int hal_remote_jitter_get(RemoteJitter *jb, unsigned char *payload,
+                          size_t *len) {
+  if (!jb->synced) {
+    return REMOTE_JITTER_WAIT;
+  }
+  int queued = jitter_queued(jb);
+  if (!jb->playing) {
+    if (queued < jb->target) {
+      return REMOTE_JITTER_WAIT;
+    }
+    jb->playing = 1;
+  }
+  if (hal_remote_jitter_peek(jb, payload, len)) {
+    jb->len[jb->next % REMOTE_JITTER_SLOTS] = 0;
+    jb->next++;
+    return REMOTE_JITTER_PACKET;
+  }
+  if (queued > 0) {
+    jb->next++;
+    jb->lost++;
+    return REMOTE_JITTER_MISSING;
+  }
+  jb->playing = 0; /* Ran dry: the sender paused, or the network did */
+  return REMOTE_JITTER_WAIT;
+}
+
+/* ========================================================================
+ * Key receiver (keypad process)
+ * ======================================================================== */
+
+static HalRemoteKeyHandler key_handler = NULL;
+static pthread_t key_thread;
+static int key_fd = -1;
+static int key_wake[2] = {-1, -1};
+static struct sockaddr_in key_peer;
+
+static uint64_t realtime_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static void *key_thread_func(void *arg) {
+  uint32_t session = 0;
+  uint32_t last_seq = 0;
+  int64_t offset_us = 0; /* Our clock minus the sender's */
+  int have_session = 0;
+  (void)arg;
+  hampod_metrics_name_thread("remote-keys");
+
+  for (;;) {
+    struct pollfd fds[2] = {{key_fd, POLLIN, 0}, {key_wake[0], POLLIN, 0}};
+    if (poll(fds, 2, -1) < 0 || fds[1].revents != 0) {
+      break;
+    }
+
+    unsigned char data[REMOTE_KEY_DATAGRAM_MAX + 1];
+    struct sockaddr_in from;
+    socklen_t from_len = sizeof(from);
+    ssize_t len = recvfrom(key_fd, data, sizeof(data), 0,
+                           (struct sockaddr *)&from, &from_len);
+    if (len <= 0 || from.sin_addr.s_addr != key_peer.sin_addr.s_addr) {
+      continue; /* Only the remote station may press our keys */
+    }
+    uint64_t now = realtime_us();
+    RemoteKeyEvent events[REMOTE_KEY_EVENTS];
+    uint32_t sender;
+    int count = hal_remote_decode_keys(data, (size_t)len, &sender, events);
+    if (count <= 0) {
+      continue;
+    }
+    if (!have_session || sender != session) {
+      session = sender; /* The remote station (re)started */
+      last_seq = 0;
+      offset_us = (int64_t)(now - events[count - 1].timestamp_us);
+      have_session = 1;
+    }
+
+    for (int i = 0; i < count; i++) {
+      if ((int32_t)(events[i].seq - last_seq) <= 0) {
+        continue; /* Repeated from an earlier datagram */
+      }
+      last_seq = events[i].seq;
+      int64_t offset = (int64_t)(now - events[i].timestamp_us);
+      if (offset < offset_us) {
+        offset_us = offset;
+      }
+      KeypadEvent event = {events[i].key, 0,
+                           events[i].action == KEYPAD_ACTION_PRESS ||
+                               events[i].action == KEYPAD_ACTION_REPEAT,
+                           events[i].action,
+                           (uint64_t)((int64_t)events[i].timestamp_us +
+                                      offset_us)};
+      hampod_metric_add(METRIC_REMOTE_KEYS, 1);
+      key_handler(event);
+    }
+  }
+  return NULL;
+}
+
+int hal_remote_keys_start(HalRemoteKeyHandler handler) {
+  const char *spec = getenv(HAL_REMOTE_ENV);
+  if (spec == NULL || handler == NULL ||
+      hal_remote_parse_address(spec, &key_peer) != 0) {
+    fprintf(stderr, "HAL Remote: No remote station (%s)\n",
+            spec != NULL ? spec : "unset");
+    return -1;
+  }
+
+  key_fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  struct sockaddr_in local = {0};
+  local.sin_family = AF_INET;
+  local.sin_addr.s_addr = htonl(INADDR_ANY);
+  local.sin_port = key_peer.sin_port;
+  if (key_fd == -1 ||
+      bind(key_fd, (struct sockaddr *)&local, sizeof(local)) != 0 ||
+      pipe(key_wake) != 0) {
+    perror("HAL Remote: Key socket");
+    hal_remote_keys_stop();
+    return -1;
+  }
+
+  key_handler = handler;
+  if (pthread_create(&key_thread, NULL, key_thread_func, NULL) != 0) {
+    hal_remote_keys_stop();
+    return -1;
+  }
+  printf("HAL Remote: Taking keys from %s\n", spec);
+  return 0;
+}
+
+void hal_remote_keys_stop(void) {
+  if (key_handler != NULL) {
+    char stop = 1;
+    if (write(key_wake[1], &stop, 1) == 1) {
+      pthread_join(key_thread, NULL);
+    }
+    key_handler = NULL;
+  }
+  for (int i = 0; i < 2; i++) {
+    if (key_wake[i] != -1) {
+      close(key_wake[i]);
+      key_wake[i] = -1;
+    }
+  }
+  if (key_fd != -1) {
+    close(key_fd);
+    key_fd = -1;
+  }
+}
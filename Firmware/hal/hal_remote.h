@@ -0,0 +1,211 @@
+#ifndef HAL_REMOTE_H
+#define HAL_REMOTE_H
+
+/**
+ * @file hal_remote.h
+ * @brief Hardware Abstraction Layer for a remote keypad and headset
+ *
+ * A remote station (remote_station.c) runs a keypad and a headset over
+ * the network. Two UDP flows, both on the port of HAMPOD_REMOTE:
+ *   - audio: what the audio process plays is also encoded as Opus, 20 ms
+ *     a packet, and sent to the remote station as RTP (RFC 3550/7587).
+ *     Nothing is sent while nothing plays; the first packet after a gap
+ *     carries the RTP marker bit. The receiver plays it out of a small
+ *     jitter buffer (RemoteJitter).
+ *   - keys: the remote station sends its key events to the keypad
+ *     process, which delivers them like its own keypad's. Each datagram
+ *     repeats the last few events, so one lost datagram loses no key.
+ *     Datagrams from any other host than the remote station are ignored.
+ *
+ * Keys are always built in. Audio needs libopus: make REMOTE_AUDIO=opus.
+ */
+
+#include "hal_keypad.h"
+#include <netinet/in.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Remote station, "host:port"; remote operation stays off unless set */
+#define HAL_REMOTE_ENV "HAMPOD_REMOTE"
+
+/* Audio stream */
+#define REMOTE_SAMPLE_RATE 16000 /* As the audio HAL plays it */
+#define REMOTE_FRAME_MS 20
+#define REMOTE_FRAME_SAMPLES (REMOTE_SAMPLE_RATE * REMOTE_FRAME_MS / 1000)
+#define REMOTE_RTP_CLOCK 48000 /* Opus RTP timestamps are always 48 kHz */
+#define REMOTE_RTP_PAYLOAD_TYPE 96
+#define REMOTE_RTP_HEADER_LEN 12
+#define REMOTE_PACKET_MAX 400 /* Header and one Opus frame */
+
+/* Key datagram: magic, the sender's session (u32 LE, random per run),
+ * event count, then count records of REMOTE_KEY_EVENT_LEN bytes, oldest
+ * first: sequence number (u32 LE), sender's event time in microseconds
+ * (u64 LE), key, KEYPAD_ACTION_* */
+#define REMOTE_KEY_MAGIC "HPK1"
+#define REMOTE_KEY_HEADER_LEN 9
+#define REMOTE_KEY_EVENTS 4
+#define REMOTE_KEY_EVENT_LEN 14
+#define REMOTE_KEY_DATAGRAM_MAX                                                \
+  (REMOTE_KEY_HEADER_LEN + REMOTE_KEY_EVENTS * REMOTE_KEY_EVENT_LEN)
+
+/** One key event of the remote keypad */
+typedef struct {
+  uint32_t seq;          /**< Counts up from 1 in each session */
+  uint64_t timestamp_us; /**< When it happened, on the sender's clock */
+  char key;
+  unsigned char action; /**< KEYPAD_ACTION_* */
+} RemoteKeyEvent;
+
+/**
+ * @brief Parse "host:port" (a name or an IPv4 address)
+ * @return 0 on success, -1 if it is malformed or the host is unknown
+ */
+int hal_remote_parse_address(const char *spec, struct sockaddr_in *addr);
+
+/**
+ * @brief Build a key datagram of count events (at most REMOTE_KEY_EVENTS)
+ * @return Its length in bytes
+ */
+size_t hal_remote_encode_keys(uint32_t session, const RemoteKeyEvent *events,
+                              int count, unsigned char *out);
+
+/**
+ * @brief Read a key datagram
+ * @return Number of events, or -1 if it is not a key datagram
+ */
+int hal_remote_decode_keys(const unsigned char *data, size_t len,
+                           uint32_t *session, RemoteKeyEvent *events);
+
+/**
+ * @brief Write an RTP header for our payload type and ssrc
+ */
+void hal_remote_rtp_header(unsigned char *out, int marker, uint16_t seq,
+                           uint32_t timestamp, uint32_t ssrc);
+
+/**
+ * @brief Read an RTP header
+ * @return Payload offset, or -1 if it is not one of our packets
+ */
+int hal_remote_rtp_parse(const unsigned char *data, size_t len, int *marker,
+                         uint16_t *seq);
+
+/* ========================================================================
+ * Jitter buffer (remote station side)
+ * ======================================================================== */
+
+#define REMOTE_JITTER_SLOTS 32 /* 640 ms of packets */
+
+/**
+ * @brief Playout buffer for the audio stream
+ *
+ * Packets are put by sequence number in any order; playout starts once
+ * target packets are queued (at start-up and whenever it ran dry) and
+ * then takes one packet per frame time. Sequence numbers run on across
+ * the sender's pauses, so a pause only means running dry. Not
+ * thread-safe.
+ */
+typedef struct {
+  unsigned char data[REMOTE_JITTER_SLOTS][REMOTE_PACKET_MAX];
+  uint16_t len[REMOTE_JITTER_SLOTS]; /**< 0 for an empty slot */
+  uint16_t seq[REMOTE_JITTER_SLOTS];
+  uint16_t next; /**< Sequence number played next */
+  int synced;    /**< next is known */
+  int playing;   /**< Playout started */
+  int target;    /**< Packets queued before playout starts */
+  int lost;      /**< Packets concealed, for statistics */
+  int late;      /**< Packets that came after their time */
+} RemoteJitter;
+
+/** Result of hal_remote_jitter_get() */
+#define REMOTE_JITTER_WAIT 0    /**< Nothing to play (yet) */
+#define REMOTE_JITTER_PACKET 1  /**< A packet was taken */
+#define REMOTE_JITTER_MISSING 2 /**< This one is lost: conceal it */
+
+/**
+ * @brief Empty the buffer
+ * @param target_ms Audio to queue before playout starts (>= one frame)
+ */
+void hal_remote_jitter_init(RemoteJitter *jb, int target_ms);
+
+/**
+ * @brief Queue a packet's Opus payload
+ *
+ * Packets already played are dropped. A marker packet while nothing is
+ * queued, or one too far ahead, starts the sequence over (the sender
+ * restarted).
+ */
+void hal_remote_jitter_put(RemoteJitter *jb, uint16_t seq, int marker,
+                           const unsigned char *payload, size_t len);
+
+/**
+ * @brief Take the next frame's packet, once per frame time
+ *
+ * @param payload Receives the Opus payload (REMOTE_PACKET_MAX bytes)
+ * @param len Receives its length
+ * @return REMOTE_JITTER_PACKET, REMOTE_JITTER_MISSING (a later packet is
+ *         queued, so this one is concealed) or REMOTE_JITTER_WAIT
+ */
+int hal_remote_jitter_get(RemoteJitter *jb, unsigned char *payload,
+                          size_t *len);
+
+/**
+ * @brief The packet hal_remote_jitter_get() takes next, left queued
+ *
+ * After REMOTE_JITTER_MISSING, lets the caller recover the lost frame
+ * from the next packet's forward error correction instead of concealing
+ * it.
+ *
+ * @return 1 if it is queued, 0 if not
+ */
+int hal_remote_jitter_peek(const RemoteJitter *jb, unsigned char *payload,
+                           size_t *len);
+
+/* ========================================================================
+ * Firmware side
+ * ======================================================================== */
+
+/**
+ * @brief Receives each remote key event, on the receiver thread
+ *
+ * The event's timestamp is already on this machine's realtime clock.
+ */
+typedef void (*HalRemoteKeyHandler)(KeypadEvent event);
+
+/**
+ * @brief Listen for the remote station's keys (keypad process)
+ * @return 0 on success, -1 if HAMPOD_REMOTE is unset or malformed or the
+ *         port could not be bound
+ */
+int hal_remote_keys_start(HalRemoteKeyHandler handler);
+
+/**
+ * @brief Stop listening for remote keys
+ */
+void hal_remote_keys_stop(void);
+
+/**
+ * @brief Start streaming what plays to the remote station (audio process)
+ *
+ * Only in builds with REMOTE_AUDIO=opus (USE_REMOTE_AUDIO).
+ *
+ * @return 0 on success, -1 if HAMPOD_REMOTE is unset or malformed or the
+ *         encoder could not be created
+ */
+int hal_audio_stream_start(void);
+
+/**
+ * @brief Hand played audio to the stream (playback thread, never blocks)
+ */
+void hal_audio_stream_feed(const int16_t *samples, size_t count);
+
+/**
+ * @brief Drop audio not yet sent, for an interrupt
+ */
+void hal_audio_stream_flush(void);
+
+/**
+ * @brief Stop streaming
+ */
+void hal_audio_stream_stop(void);
+
+#endif /* HAL_REMOTE_H */
@@ -0,0 +1,420 @@
+/**
+ * @file hal_tts.c
+ * @brief Routes the TTS HAL to the engines compiled in
+ *
+ * HAMPOD_TTS_ENGINE names the primary engine; unset, it is the one the
+ * build selected (TTS_ENGINE). HAMPOD_TTS_FALLBACK names a second engine
+ * for bursts: while HAMPOD_TTS_BACKLOG or more requests wait behind the
+ * current one, short prompts the primary has not cached go to the
+ * fallback, trading some quality for not adding to the wait. Unset, every
+ * request goes to the primary as before.
+ *
+ * While the SoC runs hot or synthesis falls behind (hal_tts_thermal.h),
+ * the engines run at a faster length scale than the one asked for.
+ *
+ * Text is put in its canonical form (hal_tts_normalize.h) before it
+ * reaches an engine, so every spelling of a phrase shares one cache entry.
+ *
+ * The audio of the last few requests that spoke is kept as it was handed
+ * to the audio HAL (hal_tts_note_utterance()), so hal_tts_replay() says
+ * one again at once, without the cache or an engine.
+ */
+
+#include "hal_tts.h"
+#include "hal_audio.h"
+#include "hal_tts_backend.h"
+#include "hal_tts_fragments.h"
+#include "hal_tts_normalize.h"
+#include "hal_tts_thermal.h"
+#include "hal_tts_warmup.h"
+#include "../hampod_metrics.h"
+#include "../hampod_trace.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Longest text (in characters) that may go to the fallback */
+#define HAL_TTS_URGENT_MAX 48
+/* Requests waiting before the fallback is used */
+#define HAL_TTS_BACKLOG_DEFAULT 2
+
+/* The first is the build's default primary */
+static const HalTtsBackend *const backends[] = {
+#ifdef USE_PIPER
+    &hal_tts_piper_backend,
+#endif
+#ifdef USE_LIBPIPER
+    &hal_tts_libpiper_backend,
+#endif
+    &hal_tts_festival_backend,
+};
+#define BACKEND_COUNT (sizeof(backends) / sizeof(backends[0]))
+
+static const HalTtsBackend *primary = NULL;
+static const HalTtsBackend *fallback = NULL; /* Once it has initialized */
+static const char *fallback_name = NULL;
+static int initialized = 0; /* The primary has initialized */
+static int backlog_threshold = HAL_TTS_BACKLOG_DEFAULT;
+static volatile int backlog = 0; /* From hal_tts_set_backlog() */
+
+/* Speed asked for by hal_tts_set_speed() (0 until then: the build's
+ * default), and whether the engines run faster than it because of heat */
+static float requested_speed = 0.0f;
+static int speed_scaled = 0;
+
+/* Time-to-first-audio histograms (hal_tts_get_stats()) */
+static const long long latency_limits[HAL_TTS_LATENCY_BUCKETS - 1] = {
+    25, 50, 100, 200, 400, 800, 1600};
+static unsigned long first_audio_hit[HAL_TTS_LATENCY_BUCKETS];
+static unsigned long first_audio_miss[HAL_TTS_LATENCY_BUCKETS];
+static unsigned long engine_crashes = 0;
+static unsigned long engine_failovers = 0;
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Stage times of the request being spoken (hal_tts_request_times()), set
+ * while it runs and read once it is done */
+static unsigned int request_speak_us = 0;
+static unsigned int request_first_audio_us = 0;
+
+/* Start-up times of the primary engine (hal_tts_init_times()) */
+static long long init_load_ms = 0;
+static long long init_warm_ms = 0;
+
+/* Audio of the last HAL_TTS_REPLAY_KEPT requests that spoke, newest at
+ * replay_head; a request's entry is started by its first utterance */
+typedef struct {
+  int16_t *samples;
+  size_t count;
+  size_t capacity;
+} ReplayEntry;
+static ReplayEntry replay_ring[HAL_TTS_REPLAY_KEPT];
+static int replay_head = -1;   /* None kept yet */
+static int replay_started = 0; /* The current request has its entry */
+static pthread_mutex_t replay_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const HalTtsBackend *find_backend(const char *name) {
+  for (size_t i = 0; i < BACKEND_COUNT; i++) {
+    if (strcmp(backends[i]->name, name) == 0) {
+      return backends[i];
+    }
+  }
+  return NULL;
+}
+
+/* Pick the engines from the environment; only the first call does work */
+static void select_backends(void) {
+  if (primary != NULL) {
+    return;
+  }
+  primary = backends[0];
+  const char *name = getenv("HAMPOD_TTS_ENGINE");
+  if (name != NULL && name[0] != '\0') {
+    const HalTtsBackend *chosen = find_backend(name);
+    if (chosen != NULL) {
+      primary = chosen;
+    } else {
+      fprintf(stderr, "HAL TTS: No engine named %s, using %s\n", name,
+              primary->name);
+    }
+  }
+
+  name = getenv("HAMPOD_TTS_FALLBACK");
+  if (name != NULL && name[0] != '\0' && strcmp(name, primary->name) != 0) {
+    fallback_name = name;
+  }
+  const char *threshold = getenv("HAMPOD_TTS_BACKLOG");
+  if (threshold != NULL && atoi(threshold) > 0) {
+    backlog_threshold = atoi(threshold);
+  }
+}
+
+int hal_tts_init(void) {
+  select_backends();
+  if (primary->init() != 0) {
+    return -1;
+  }
+
+  if (fallback_name != NULL && fallback == NULL) {
+    long long load_ms = init_load_ms, warm_ms = init_warm_ms;
+    const HalTtsBackend *engine = find_backend(fallback_name);
+    int result = engine != NULL ? engine->init() : -1;
+    hal_tts_note_init_times(load_ms, warm_ms); /* The primary's are wanted */
+    if (result != 0) {
+      fprintf(stderr, "HAL TTS: Fallback %s unavailable\n", fallback_name);
+    } else {
+      fallback = engine;
+      printf("HAL TTS: Short prompts go to %s while %d or more requests "
+             "wait\n",
+             fallback->impl_name(), backlog_threshold);
+    }
+  }
+  initialized = 1;
+  hal_tts_fragments_prime();
+  return 0;
+}
+
+/* Set the engines' speed, scaled while running hot */
+static int apply_speed(void) {
+  float speed = requested_speed;
+  if (speed <= 0.0f) {
+#ifdef PIPER_SPEED
+    speed = (float)atof(PIPER_SPEED);
+#else
+    speed = 1.0f;
+#endif
+  }
+  if (speed_scaled) {
+    speed *= hal_tts_thermal_scale();
+  }
+  if (fallback != NULL && fallback->set_speed != NULL) {
+    fallback->set_speed(speed);
+  }
+  int result = primary->set_speed != NULL ? primary->set_speed(speed) : -1;
+  if (initialized) {
+    hal_tts_fragments_prime(); /* The words are cached per speed */
+  }
+  return result;
+}
+
+static unsigned int clock_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  unsigned int us = (unsigned int)((unsigned long long)ts.tv_sec * 1000000ULL +
+                                   (unsigned long long)ts.tv_nsec / 1000ULL);
+  return us != 0 ? us : 1; /* 0 means "not yet" */
+}
+
+int hal_tts_speak(const char *text, const char *output_file) {
+  if (request_speak_us == 0) {
+    request_speak_us = clock_us();
+  }
+  hampod_trace(TRACE_TTS_SPEAK, text != NULL ? (uint32_t)strlen(text) : 0, 0,
+               0);
+  char canonical[HAL_TTS_NORMALIZE_MAX];
+  if (text != NULL) {
+    text = hal_tts_normalize(text, canonical, sizeof(canonical));
+  }
+  select_backends();
+  int hot = hal_tts_thermal_hot() && hal_tts_thermal_scale() != 1.0f;
+  if (hot != speed_scaled) {
+    speed_scaled = hot;
+    apply_speed();
+  }
+
+  const HalTtsBackend *engine = primary;
+  if (fallback != NULL && text != NULL && backlog >= backlog_threshold &&
+      strlen(text) <= HAL_TTS_URGENT_MAX &&
+      (primary->cached == NULL || !primary->cached(text))) {
+    printf("HAL TTS: %d requests waiting, using %s\n", backlog,
+           fallback->name);
+    engine = fallback;
+  }
+  hal_tts_fragments_note_speech(1);
+  int result = engine->speak(text, output_file);
+  hal_tts_fragments_note_speech(0);
+  return result;
+}
+
+int hal_tts_warm(const char *text) {
+  char canonical[HAL_TTS_NORMALIZE_MAX];
+  select_backends();
+  return primary->warm(hal_tts_normalize(text, canonical, sizeof(canonical)));
+}
+
+void hal_tts_interrupt(void) {
+  hampod_trace(TRACE_TTS_INTERRUPT, 0, 0, 0);
+  select_backends();
+  hal_tts_fragments_interrupt();
+  primary->interrupt();
+  if (fallback != NULL) {
+    fallback->interrupt();
+  }
+}
+
+void hal_tts_restart(void) {
+  select_backends();
+  if (primary->restart != NULL) {
+    primary->restart();
+  }
+}
+
+void hal_tts_cleanup(void) {
+  hal_tts_fragments_cleanup();
+  initialized = 0;
+  if (fallback != NULL) {
+    fallback->cleanup();
+    fallback = NULL;
+  }
+  if (primary != NULL) {
+    primary->cleanup();
+  }
+}
+
+const char *hal_tts_get_impl_name(void) {
+  select_backends();
+  return primary->impl_name();
+}
+
+int hal_tts_set_speed(float speed) {
+  select_backends();
+  requested_speed = speed;
+  return apply_speed();
+}
+
+int hal_tts_select_voice(const char *name) {
+  select_backends();
+  if (primary->select_voice != NULL) {
+    return primary->select_voice(name);
+  }
+  return name == NULL || name[0] == '\0' ? 0 : -1;
+}
+
+int hal_tts_set_cpus(int first_cpu, int last_cpu) {
+  select_backends();
+  const HalTtsBackend *engine = find_backend(
+      fallback_name != NULL ? fallback_name : primary->name);
+  if (engine != NULL && engine != primary && engine->set_cpus != NULL) {
+    engine->set_cpus(first_cpu, last_cpu);
+  }
+  return primary->set_cpus != NULL ? primary->set_cpus(first_cpu, last_cpu)
+                                   : -1;
+}
+
+void hal_tts_set_backlog(int pending) { backlog = pending; }
+
+void hal_tts_note_first_audio(int cached, long long ms) {
+  if (request_first_audio_us == 0) {
+    request_first_audio_us = clock_us();
+  }
+  hampod_trace(TRACE_TTS_FIRST_AUDIO, (uint32_t)ms, (uint32_t)cached, 0);
+  hampod_metric_observe_us(METRIC_TTS_FIRST_AUDIO, (uint64_t)ms * 1000);
+  int bucket = 0;
+  while (bucket < HAL_TTS_LATENCY_BUCKETS - 1 &&
+         ms >= latency_limits[bucket]) {
+    bucket++;
+  }
+  pthread_mutex_lock(&stats_lock);
+  (cached ? first_audio_hit : first_audio_miss)[bucket]++;
+  pthread_mutex_unlock(&stats_lock);
+}
+
+int hal_tts_is_primary(const HalTtsBackend *engine) {
+  select_backends();
+  return engine == primary;
+}
+
+void hal_tts_note_init_times(long long load_ms, long long warm_ms) {
+  init_load_ms = load_ms;
+  init_warm_ms = warm_ms;
+}
+
+void hal_tts_note_crash(int failed_over) {
+  pthread_mutex_lock(&stats_lock);
+  engine_crashes++;
+  engine_failovers += failed_over != 0;
+  pthread_mutex_unlock(&stats_lock);
+}
+
+void hal_tts_init_times(long long *load_ms, long long *warm_ms) {
+  *load_ms = init_load_ms;
+  *warm_ms = init_warm_ms;
+}
+
+void hal_tts_request_begin(void) {
+  request_speak_us = 0;
+  request_first_audio_us = 0;
+  pthread_mutex_lock(&replay_lock);
+  replay_started = 0;
+  pthread_mutex_unlock(&replay_lock);
+}
+
+void hal_tts_note_utterance(const int16_t *samples, size_t num_samples) {
+  if (samples == NULL || num_samples == 0) {
+    return;
+  }
+  pthread_mutex_lock(&replay_lock);
+  if (!replay_started) {
+    replay_head = (replay_head + 1) % HAL_TTS_REPLAY_KEPT;
+    replay_ring[replay_head].count = 0;
+    replay_started = 1;
+  }
+  ReplayEntry *entry = &replay_ring[replay_head];
+  if (num_samples > HAL_TTS_REPLAY_MAX_SAMPLES - entry->count) {
+    num_samples = HAL_TTS_REPLAY_MAX_SAMPLES - entry->count; /* What fits */
+  }
+  if (entry->count + num_samples > entry->capacity) {
+    size_t capacity = entry->capacity > 0 ? entry->capacity : 16000;
+    while (capacity < entry->count + num_samples) {
+      capacity *= 2;
+    }
+    if (capacity > HAL_TTS_REPLAY_MAX_SAMPLES) {
+      capacity = HAL_TTS_REPLAY_MAX_SAMPLES;
+    }
+    int16_t *grown = realloc(entry->samples, capacity * sizeof(int16_t));
+    if (grown == NULL) {
+      pthread_mutex_unlock(&replay_lock);
+      return; /* Replays what it has */
+    }
+    entry->samples = grown;
+    entry->capacity = capacity;
+  }
+  memcpy(entry->samples + entry->count, samples,
+         num_samples * sizeof(int16_t));
+  entry->count += num_samples;
+  pthread_mutex_unlock(&replay_lock);
+}
+
+int hal_tts_replay(int back) {
+  int result = -1;
+  pthread_mutex_lock(&replay_lock);
+  if (replay_head >= 0 && back >= 1 && back <= HAL_TTS_REPLAY_KEPT) {
+    const ReplayEntry *entry =
+        &replay_ring[(replay_head - (back - 1) + HAL_TTS_REPLAY_KEPT) %
+                     HAL_TTS_REPLAY_KEPT];
+    if (entry->count > 0) {
+      /* Copied onto the segment queue, so the entry may be replaced while
+       * it plays */
+      result = hal_audio_queue_samples(entry->samples, entry->count);
+    }
+  }
+  pthread_mutex_unlock(&replay_lock);
+  return result;
+}
+
+void hal_tts_request_times(unsigned int *speak_us,
+                           unsigned int *first_audio_us) {
+  *speak_us = request_speak_us;
+  *first_audio_us = request_first_audio_us;
+}
+
+void hal_tts_begin_upkeep(void) {
+#if defined(USE_PIPER) || defined(USE_LIBPIPER) || defined(USE_FESTIVAL)
+  hal_tts_cache_begin_upkeep();
+#endif
+}
+
+void hal_tts_set_model_residency(HalTtsModelResidency mode) {
+#if defined(USE_PIPER) || defined(USE_LIBPIPER)
+  hal_tts_warmup_set_residency(mode);
+#else
+  (void)mode;
+#endif
+}
+
+void hal_tts_get_stats(HalTtsStats *stats) {
+  memset(stats, 0, sizeof(*stats));
+#if defined(USE_PIPER) || defined(USE_LIBPIPER) || defined(USE_FESTIVAL)
+  hal_tts_cache_get_stats(&stats->cache);
+#endif
+#if defined(USE_PIPER) || defined(USE_LIBPIPER)
+  hal_tts_warmup_model_stats(&stats->model);
+#endif
+  pthread_mutex_lock(&stats_lock);
+  memcpy(stats->first_audio_hit, first_audio_hit, sizeof(first_audio_hit));
+  memcpy(stats->first_audio_miss, first_audio_miss, sizeof(first_audio_miss));
+  stats->crashes = engine_crashes;
+  stats->failovers = engine_failovers;
+  pthread_mutex_unlock(&stats_lock);
+}
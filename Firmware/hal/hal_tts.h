@@ -7,8 +7,36 @@
  *
  * This HAL provides a unified interface for different TTS implementations
  * (Festival, Piper) allowing the firmware to remain engine-agnostic.
+ * Several engines can be built in; hal_tts.c chooses between them at
+ * runtime (HAMPOD_TTS_ENGINE, HAMPOD_TTS_FALLBACK).
  */
 
+#include "hal_tts_cache.h"
+#include <stddef.h>
+
+/**
+ * @brief How the voice model's file pages are kept in RAM
+ *
+ * A Piper restart (a speed change, a crashed worker) reads the model file
+ * again, and on a small board pages evicted under memory pressure come
+ * back from the SD card, taking seconds.
+ */
+typedef enum {
+  HAL_TTS_MODEL_CACHED = 0, /**< Read in at start-up, then left to the OS */
+  HAL_TTS_MODEL_KEPT,       /**< Evicted pages faulted back in (every 10 s) */
+  HAL_TTS_MODEL_LOCKED      /**< mlock()ed; counts against RLIMIT_MEMLOCK */
+} HalTtsModelResidency;
+
+/**
+ * @brief Memory the voice model's file takes up
+ */
+typedef struct {
+  HalTtsModelResidency mode; /**< Mode in effect, after any fallback */
+  size_t bytes;              /**< Model file size; 0 in CACHED mode */
+  size_t resident_bytes;     /**< Of those, in RAM now */
+  unsigned long refaults;    /**< Evicted pages KEPT mode brought back */
+} HalTtsModelStats;
+
 /**
  * @brief Initialize TTS subsystem
  *
@@ -20,11 +48,40 @@
  */
 int hal_tts_init(void);
 
+/**
+ * @brief Choose how the voice model is kept in RAM (call before
+ *        hal_tts_init())
+ *
+ * HAMPOD_TTS_MODEL (cache, keep or lock) overrides it, as does
+ * HAMPOD_TTS_MLOCK=1 (lock). A lock that does not fit under
+ * RLIMIT_MEMLOCK, together with what the process has locked already, or
+ * that the kernel refuses, falls back to KEPT. Builds without Piper
+ * ignore it.
+ *
+ * @param mode Residency mode; CACHED by default
+ */
+void hal_tts_set_model_residency(HalTtsModelResidency mode);
+
+/**
+ * @brief How long hal_tts_init() took to start the engine and to warm it
+ *
+ * Both are 0 until an engine that reports them (the Piper ones) has been
+ * initialized.
+ *
+ * @param load_ms Receives the time to load the model and start the engine
+ * @param warm_ms Receives the time spent on the priming phrase
+ */
+void hal_tts_init_times(long long *load_ms, long long *warm_ms);
+
 /**
  * @brief Speak text
  *
  * Festival: Blocking - generates WAV and plays immediately.
  * Piper: Async - writes to persistent pipeline for immediate playback.
+ *        Returns once Piper has finished the text; audio the PCM ring
+ *        cannot take yet is left queued in RAM, so the next text can be
+ *        synthesized while this one plays. Long text is synthesized and
+ *        cached a phrase at a time (see hal_tts_phrase.h).
  *
  * @param text The text to speak
  * @param output_file Optional output file path (for caching). NULL for direct
@@ -33,6 +90,20 @@ int hal_tts_init(void);
  */
 int hal_tts_speak(const char *text, const char *output_file);
 
+/**
+ * @brief Synthesize text into the TTS cache without playing it
+ *
+ * For warming the cache in the background: blocks until done, so call it
+ * from a thread of its own. Piper runs it on a background worker when the
+ * pool has one, so foreground speech is not held up; with a single worker
+ * a hal_tts_speak() can wait for one phrase.
+ *
+ * @param text The text to synthesize
+ * @return 0 once the text is cached (or already was), -1 on failure or if
+ *         the engine cannot cache
+ */
+int hal_tts_warm(const char *text);
+
 /**
  * @brief Interrupt current speech
  *
@@ -41,6 +112,15 @@ int hal_tts_speak(const char *text, const char *output_file);
  */
 void hal_tts_interrupt(void);
 
+/**
+ * @brief Restart the speech engine, to get past one that is stuck
+ *
+ * Kills the engine process speaking in the foreground; the speech it was
+ * making ends with an error and the next is spoken by its replacement.
+ * Engines without a process of their own (libpiper) do nothing.
+ */
+void hal_tts_restart(void);
+
 /**
  * @brief Cleanup TTS resources
  *
@@ -58,12 +138,129 @@ const char *hal_tts_get_impl_name(void);
 /**
  * @brief Set speech speed
  *
- * Sets the speech rate for Piper TTS. If Piper is running, it will be
- * restarted with the new speed.
+ * Sets the speech rate for Piper TTS. The libpiper backend passes it with
+ * each utterance; the subprocess backend restarts Piper with it. Cached
+ * speech is kept per speed, so entries for other speeds stay valid.
  *
  * @param speed Speed multiplier (0.5 = faster, 1.0 = normal, 2.0 = slower)
  * @return 0 on success, -1 on failure
  */
 int hal_tts_set_speed(float speed);
 
+/**
+ * @brief Speak the calling thread's following text in another voice
+ *
+ * Voices come from the registry in HAMPOD_TTS_VOICES ("name=model.onnx,
+ * ..."), which firmware.elf fills from its --voice options. Each voice
+ * keeps its own cache entries, and switching does not restart anything:
+ * every voice runs a Piper of its own, started at init, or on first use
+ * (one extra voice at a time) with HAMPOD_TTS_VOICE_PRELOAD=0, which
+ * memory_profile = low sets. A fallback engine speaks in its own voice.
+ *
+ * @param name Voice name, or NULL or "" for the default voice
+ * @return 0 on success, -1 if there is no such voice (the default voice
+ *         is used)
+ */
+int hal_tts_select_voice(const char *name);
+
+/**
+ * @brief Keep synthesis to a range of CPU cores
+ *
+ * Call before hal_tts_init(). Piper's workers are pinned within the range
+ * instead of across all cores; libpiper starts its inference threads on
+ * it. Festival ignores it.
+ *
+ * @param first_cpu First core of the range
+ * @param last_cpu Last core of the range
+ * @return 0 on success, -1 if already initialized, the range is invalid
+ *         or the engine cannot pin
+ */
+int hal_tts_set_cpus(int first_cpu, int last_cpu);
+
+/**
+ * @brief Report how many speech requests are waiting behind this one
+ *
+ * With a fallback engine configured, short prompts go to it while the
+ * backlog is at least HAMPOD_TTS_BACKLOG (default 2), so a burst of
+ * announcements does not queue up behind the primary engine.
+ *
+ * @param pending Requests queued, not counting the one being spoken
+ */
+void hal_tts_set_backlog(int pending);
+
+/**
+ * @brief Buckets of the time-to-first-audio histograms: under 25, 50, 100,
+ *        200, 400, 800 and 1600 ms, then 1600 ms and over
+ */
+#define HAL_TTS_LATENCY_BUCKETS 8
+
+/**
+ * @brief Speech counters since start-up, for tuning in the field
+ */
+typedef struct {
+  HalTtsCacheStats cache; /**< All zero in builds without the cache */
+  /** Requests whose first phrase came from the cache, by time to audio */
+  unsigned long first_audio_hit[HAL_TTS_LATENCY_BUCKETS];
+  /** Requests whose first phrase was synthesized, by time to audio */
+  unsigned long first_audio_miss[HAL_TTS_LATENCY_BUCKETS];
+  HalTtsModelStats model; /**< All zero in builds without Piper */
+  unsigned long crashes;   /**< Engine processes that died */
+  unsigned long failovers; /**< Of those, replaced by a standby at once */
+} HalTtsStats;
+
+/**
+ * @brief Tell TTS the program is ready for requests
+ *
+ * Starts background upkeep held back so it does not slow start-up
+ * (hal_tts_cache_begin_upkeep()).
+ */
+void hal_tts_begin_upkeep(void);
+
+/* Announcements hal_tts_replay() can go back to, and the longest kept
+ * (20 s at 16 kHz); audio past that is not kept */
+#define HAL_TTS_REPLAY_KEPT 4
+#define HAL_TTS_REPLAY_MAX_SAMPLES (16000 * 20)
+
+/**
+ * @brief Start timing a request (hal_tts_request_times())
+ *
+ * The next speech after this starts a new entry for hal_tts_replay().
+ */
+void hal_tts_request_begin(void);
+
+/**
+ * @brief Say a recent announcement again, from the audio kept of it
+ *
+ * Queues the PCM of the back'th most recent request that spoke (1 is the
+ * last) on the audio segment queue, so it is heard at once, with no cache
+ * lookup or synthesis. A replay is not itself kept, so asking again
+ * repeats the same one. Of an announcement cut off while it was being
+ * synthesized, only the phrases already out are kept.
+ *
+ * @param back 1 for the last announcement, up to HAL_TTS_REPLAY_KEPT
+ * @return 0 if queued, -1 if none is kept that far back or the queue is
+ *         full
+ */
+int hal_tts_replay(int back);
+
+/**
+ * @brief When the request begun last started speaking and had its first
+ *        audio out
+ *
+ * Times are the low 32 bits of CLOCK_MONOTONIC in microseconds, or 0 if
+ * the request has not got that far (or spoke no TTS).
+ *
+ * @param speak_us Receives when hal_tts_speak() was first called
+ * @param first_audio_us Receives when its first audio was handed to the
+ *        audio HAL
+ */
+void hal_tts_request_times(unsigned int *speak_us,
+                           unsigned int *first_audio_us);
+
+/**
+ * @brief Read the speech counters
+ * @param stats Receives them
+ */
+void hal_tts_get_stats(HalTtsStats *stats);
+
 #endif /* HAL_TTS_H */
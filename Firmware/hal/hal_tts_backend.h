@@ -0,0 +1,87 @@
+#ifndef HAL_TTS_BACKEND_H
+#define HAL_TTS_BACKEND_H
+
+/**
+ * @file hal_tts_backend.h
+ * @brief Operations each TTS engine provides to the TTS HAL
+ *
+ * Every engine compiled in exports one of these; hal_tts.c picks the
+ * primary engine and an optional fallback at runtime and routes the
+ * hal_tts_* calls to them. The operations mean what the hal_tts_*
+ * function of the same name does (see hal_tts.h).
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct HalTtsBackend {
+  const char *name; /* Selects it: HAMPOD_TTS_ENGINE, HAMPOD_TTS_FALLBACK */
+  int (*init)(void);
+  int (*speak)(const char *text, const char *output_file);
+  int (*warm)(const char *text);
+  void (*interrupt)(void);
+  void (*cleanup)(void);
+  const char *(*impl_name)(void);
+  int (*set_speed)(float speed);         /* NULL: fixed speed */
+  int (*set_cpus)(int first, int last);  /* NULL: cannot pin */
+  int (*cached)(const char *text);       /* NULL: keeps no cache */
+  int (*select_voice)(const char *name); /* NULL: default voice only */
+  void (*restart)(void);                 /* NULL: nothing to restart */
+} HalTtsBackend;
+
+/**
+ * @brief Count the time from a request to its first audio
+ *
+ * Engines call this once per hal_tts_speak(), when the first audio of it
+ * is handed to the audio HAL (see hal_tts_get_stats()).
+ *
+ * @param cached The first phrase came from the cache
+ * @param ms Time since the request, in ms
+ */
+void hal_tts_note_first_audio(int cached, long long ms);
+
+/**
+ * @brief Keep a phrase's audio for hal_tts_replay()
+ *
+ * Engines call this for each phrase of a hal_tts_speak() they hand to the
+ * audio HAL whole: a cache hit, or a synthesis that finished. The samples
+ * are copied.
+ */
+void hal_tts_note_utterance(const int16_t *samples, size_t num_samples);
+
+/**
+ * @brief Record how long init took (see hal_tts_init_times())
+ *
+ * Engines that load a model call this from init.
+ *
+ * @param load_ms Time to load the model and start the engine
+ * @param warm_ms Time spent on the priming phrase
+ */
+void hal_tts_note_init_times(long long load_ms, long long warm_ms);
+
+/**
+ * @brief Count an engine process that died (see hal_tts_get_stats())
+ *
+ * @param failed_over A standby process took over at once
+ */
+void hal_tts_note_crash(int failed_over);
+
+/**
+ * @brief Check if an engine is the primary one
+ *
+ * The TTS cache holds one voice's speech, so only the primary engine
+ * caches; a fallback leaves it to the primary.
+ *
+ * @return 1 if engine is the primary, 0 if not
+ */
+int hal_tts_is_primary(const HalTtsBackend *engine);
+
+#ifdef USE_PIPER
+extern const HalTtsBackend hal_tts_piper_backend;
+#endif
+#ifdef USE_LIBPIPER
+extern const HalTtsBackend hal_tts_libpiper_backend;
+#endif
+extern const HalTtsBackend hal_tts_festival_backend;
+
+#endif /* HAL_TTS_BACKEND_H */
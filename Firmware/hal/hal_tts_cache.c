@@ -1,38 +1,401 @@
 #include "hal_tts_cache.h"
+#include "hal_audio_adpcm.h"
+#include "../hampod_alloc.h"
 #include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
 #define CACHE_DIR_ENV "HAMPOD_TTS_CACHE_DIR"
 #define CACHE_SIZE_ENV "HAMPOD_TTS_CACHE_MAX_SIZE"
+#define CACHE_RAM_ENV "HAMPOD_TTS_CACHE_RAM"
+#define CACHE_COMPRESS_ENV "HAMPOD_TTS_CACHE_COMPRESS"
+#define CACHE_TMPFS_ENV "HAMPOD_TTS_CACHE_TMPFS"
+#define CACHE_WRITEBACK_ENV "HAMPOD_TTS_CACHE_WRITEBACK"
 #define DEFAULT_CACHE_DIR ".cache/hampod/tts"
 #define DEFAULT_MAX_DISK_CACHE_SIZE                                            \
   (10ULL * 1024ULL * 1024ULL * 1024ULL) /* 10GB */
+/* About four minutes of speech; small next to a Zero 2 W's 512MB */
+#define DEFAULT_MAX_RAM_CACHE_SIZE (8ULL * 1024ULL * 1024ULL)
+/* The store's budget when it is worked on in RAM (HAMPOD_TTS_CACHE_TMPFS) */
+#define DEFAULT_MAX_TMPFS_CACHE_SIZE (64ULL * 1024ULL * 1024ULL)
+#define DEFAULT_WRITEBACK_PERIOD 300 /* Seconds */
 
 static char cache_dir_path[512] = {0};
 static uint64_t max_disk_cache_size = DEFAULT_MAX_DISK_CACHE_SIZE;
-static uint64_t current_cache_size = 0;
 static int cache_initialized = 0;
+static uint64_t cache_voice = 0; /* Model id (hal_tts_cache_set_voice()) */
+static char cache_voice_name[64] = ""; /* Its file name, for cache packs */
+/* Voice the calling thread speaks in instead (hal_tts_cache_select_voice());
+ * 0 for cache_voice */
+static __thread uint64_t thread_voice = 0;
+static int cache_compress = 0;    /* New entries are stored as ADPCM */
+
+/* Speech and background warming use the cache from different threads:
+ * init and the RAM tier are guarded by cache_lock, the packed store by
+ * store_lock (see below) */
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Speech captured on a cache miss is handed to a writer thread with its
+ * buffer, which is recycled for a later capture once written, so a miss
+ * neither allocates nor copies in steady state. The queue, spares and
+ * thread state are guarded by cache_lock. */
+#define CACHE_WRITE_QUEUE 8
+#define CACHE_SPARE_BUFFERS 2
+#define CACHE_BUFFER_SAMPLES (16000 * 10) /* 10 seconds to start with */
+
+typedef struct {
+  uint64_t key;
+  char *text; /* Copy, freed once written */
+  int16_t *samples;
+  size_t num_samples;
+  size_t capacity;
+} CacheWrite;
+
+typedef struct {
+  int16_t *samples;
+  size_t capacity;
+} CacheBuffer;
+
+/* A streamed entry to verify once released (see stream_open()) */
+#define CACHE_CHECK_QUEUE 8
+
+typedef struct {
+  uint64_t key;
+  unsigned segment;
+  uint32_t offset;
+} CacheCheck;
+
+static CacheWrite write_queue[CACHE_WRITE_QUEUE];
+static int write_head = 0;  /* Next job to write */
+static int write_count = 0; /* Jobs queued */
+static CacheBuffer spares[CACHE_SPARE_BUFFERS];
+static int spare_count = 0;
+static CacheCheck check_queue[CACHE_CHECK_QUEUE];
+static int check_count = 0;
+static pthread_t writer_thread;
+static int writer_running = 0;
+static int writer_stop = 0;
+static int evict_wanted = 0; /* The store passed its high-water mark */
+static int repair_wanted = 0; /* Segment sizes not known since start-up */
+static int upkeep_begun = 0;  /* hal_tts_cache_begin_upkeep() was called */
+static int hotset_wanted = 0; /* The saved hot set is not yet in RAM */
+static pthread_cond_t write_ready = PTHREAD_COND_INITIALIZER;
+
+/* RAM tier in front of the store: recently used entries, newest first,
+ * up to max_ram_cache_size bytes. Lookups hand out the entry's own
+ * samples with a reference held, so a hit neither reads the disk nor
+ * copies; an entry evicted while referenced is freed by its last release.
+ * Guarded by cache_lock. */
+#define RAM_BUCKETS 256 /* Power of two */
+
+typedef struct RamEntry {
+  struct RamEntry *next; /* Bucket chain */
+  struct RamEntry *newer;
+  struct RamEntry *older;
+  uint64_t key;     /* As in the store */
+  const char *text; /* Stored after the samples, to verify hits */
+  int refs;         /* Lookups not yet released, plus one while cached */
+  size_t bytes;     /* Allocated */
+  size_t num_samples;
+  int16_t samples[];
+} RamEntry;
+
+static RamEntry *ram_buckets[RAM_BUCKETS];
+static RamEntry *ram_newest = NULL;
+static RamEntry *ram_oldest = NULL;
+static uint64_t max_ram_cache_size = DEFAULT_MAX_RAM_CACHE_SIZE;
+static int ram_budget_set = 0; /* Set at run time; the environment's ignored */
+static uint64_t current_ram_size = 0;
+
+/* Packed store: every entry is appended to numbered segment files as its
+ * text followed by its PCM, and a memory-mapped open-addressing index maps
+ * its key (see entry_key()) to segment, offset and length. A hit is an
+ * index probe, a check of the stored text and a copy out of the mapped
+ * segment, with no per-entry file to open; writes only ever append.
+ * The index, mappings and size accounting are guarded by store_lock;
+ * appends and eviction are serialized by append_lock, taken before it.
+ *
+ * Each entry records when it was last used and how often (halved each
+ * time the store sees four uses per entry). Past STORE_EVICT_HIGH of the
+ * disk budget the writer thread deletes whole segments, those holding the
+ * least use per byte first, until the store is back under
+ * STORE_EVICT_LOW; entries of a deleted segment used more than most are
+ * copied forward into the one being appended to first.
+ *
+ * With HAMPOD_TTS_CACHE_COMPRESS set, new entries are stored as IMA-ADPCM
+ * (hal_audio_adpcm.h), a quarter of the size, and decoded into the RAM
+ * tier on a disk hit; PCM entries already stored stay readable.
+ *
+ * Segment sizes are kept in a journal beside the index (index.sizes): a
+ * record per change, rewritten compacted every STORE_SIZES_RECORDS
+ * records and on close, when it is marked clean. Start-up reads it rather
+ * than sizing every segment file; after an unclean shutdown the writer
+ * thread sizes them up again and drops entries pointing past their ends,
+ * but only once hal_tts_cache_begin_upkeep() says the program is ready. */
+#define STORE_INDEX_FILE "index.bin"
+#define STORE_SIZES_FILE "index.sizes"
+#define STORE_SIZES_MAGIC "HPTTSSZ1"
+#define STORE_SIZES_RECORDS 1024 /* Journal records before a rewrite */
+#define STORE_INDEX_MAGIC "HPTTSIX4"
+#define STORE_TEXT_MAX 4096 /* Bytes; longer texts are not stored */
+#define STORE_SEGMENT_FORMAT "seg_%04u.pcm"
+#define STORE_SEGMENT_MAX (16U * 1024U * 1024U) /* Bytes per segment */
+#define STORE_MAPPED_MAX 8   /* Segments mapped at a time */
+#define STORE_INDEX_SLOTS 4096 /* To start with; a power of two */
+#define STORE_SEGMENT_MIN (256U * 1024U) /* Smallest segment size limit */
+#define STORE_EVICT_HIGH 90 /* Percent of the budget that starts eviction */
+#define STORE_EVICT_LOW 75  /* Percent it ends at */
+#define STORE_HITS_MAX UINT16_MAX
+#define STORE_FORMAT_PCM 0   /* s16 samples */
+#define STORE_FORMAT_ADPCM 1 /* hal_adpcm_encode() of them */
+
+typedef struct {
+  char magic[8];
+  uint32_t capacity; /* Slots */
+  uint32_t count;    /* Slots in use */
+  uint32_t clock;    /* Counts stores and hits, for last_use */
+  uint32_t aged;     /* clock when the hit counts were last halved */
+} IndexHeader;
+
+typedef struct {
+  uint64_t key;      /* entry_key() */
+  uint32_t offset;   /* Bytes into the segment, where the text starts */
+  uint32_t num_samples;
+  uint32_t last_use; /* clock when last stored or hit */
+  uint16_t hits;     /* Since stored, halved as the store turns over */
+  uint16_t text_len; /* Bytes of text, stored before the PCM */
+  uint16_t segment;  /* Segment file number; 0 marks an empty slot */
+  uint16_t format;   /* STORE_FORMAT_* of the samples */
+  uint32_t sum;      /* payload_sum() of the stored samples */
+} IndexSlot;
+
+typedef struct {
+  char magic[8];
+  uint32_t clean;    /* Closed with the sizes matching the files */
+  uint32_t reserved;
+} SizesHeader;
+
+typedef struct {
+  uint32_t segment;
+  uint32_t check;    /* size_check() of the record */
+  uint64_t size;     /* Bytes; 0 once deleted */
+} SizesRecord;
 
-/* DJB2 Hash function */
-static uint32_t djb2_hash(const char *str) {
-  uint32_t hash = 5381;
-  int c;
-  while ((c = *str++)) {
-    hash = ((hash << 5) + hash) + c; /* hash * 33 + c */
+typedef struct {
+  unsigned segment; /* 0 if unused */
+  const char *data;
+  unsigned long last_use;
+} MappedSegment;
+
+static pthread_mutex_t store_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t append_lock = PTHREAD_MUTEX_INITIALIZER;
+static int index_fd = -1;
+static IndexHeader *index_header = NULL;
+static size_t index_size = 0; /* Bytes mapped */
+static uint64_t *segment_sizes = NULL; /* Bytes, by segment number */
+static unsigned segment_count = 0;      /* Highest segment number */
+static unsigned segment_slots = 0;      /* Allocated in segment_sizes */
+static MappedSegment mapped[STORE_MAPPED_MAX];
+static unsigned long map_clock = 0;
+static uint64_t current_cache_size = 0;
+static HalTtsCacheStats stats;
+static int append_fd = -1; /* Open on append_segment; append_lock */
+static unsigned append_segment = 0;
+/* The sizes journal; segment_sizes only change with append_lock held, so
+ * it is written under append_lock alone */
+static int sizes_fd = -1;
+static off_t sizes_end = 0;        /* Bytes of it in use */
+static unsigned sizes_records = 0; /* Records in it */
+static int sizes_known = 0;        /* segment_sizes match the files */
+
+/* tmpfs mode (HAMPOD_TTS_CACHE_TMPFS): the store is worked on in a
+ * directory in RAM and copied to writeback_dir, the cache directory's
+ * "tmpfs" directory on the card, every writeback_period seconds by the
+ * writer thread and on the way out (hal_tts_cache_writeback()). Segments
+ * only grow, so each copy adds what was appended since the last; one
+ * deleted and started again is copied whole. An empty working directory
+ * is seeded from the copy at start-up. mirror holds how much of each
+ * segment the copy has; it and the copy are guarded by append_lock. */
+typedef struct {
+  ino_t ino;      /* Of the working file the copy was made from */
+  uint64_t bytes; /* Of it in the copy */
+} MirrorSegment;
+
+static char writeback_dir[600] = ""; /* Empty unless in tmpfs mode */
+static unsigned writeback_period = DEFAULT_WRITEBACK_PERIOD;
+static time_t writeback_next = 0;    /* Next copy by the writer */
+static int writeback_done = 0;       /* The copy is of the store as... */
+static uint32_t writeback_clock = 0; /* ...its index clock... */
+static uint64_t writeback_size = 0;  /* ...and size were */
+static MirrorSegment *mirror = NULL; /* By segment number */
+static unsigned mirror_slots = 0;
+
+/* 64-bit FNV-1a, continued from hash over len bytes */
+static uint64_t fnv64(uint64_t hash, const void *data, size_t len) {
+  const unsigned char *p = data;
+  while (len-- > 0) {
+    hash = (hash ^ *p++) * 1099511628211ULL;
   }
   return hash;
 }
 
-/* Construct file path from hash */
-static void get_file_path(uint32_t hash, char *path, size_t path_len) {
-  snprintf(path, path_len, "%s/%08x.pcm", cache_dir_path, hash);
+#define FNV64_BASIS 14695981039346656037ULL
+
+/* Checksum of an entry's stored samples, checked on every read from the
+ * store: after a power cut, data the index points at may not have reached
+ * the card (or may be half there), and must not play as noise */
+static uint32_t payload_sum(const void *payload, size_t len) {
+  uint64_t hash = fnv64(FNV64_BASIS, payload, len);
+  return (uint32_t)(hash ^ (hash >> 32));
+}
+
+/* Bytes num_samples take up stored in format */
+static size_t payload_bytes(unsigned format, size_t num_samples) {
+  return format == STORE_FORMAT_ADPCM ? hal_adpcm_encoded_bytes(num_samples)
+                                      : num_samples * sizeof(int16_t);
+}
+
+static int speed_key(float speed) { return (int)(speed * 100.0f + 0.5f); }
+
+/* Key of text spoken by voice at speed: a hash over the text version,
+ * the voice, the speed and the text. The text is stored with the entry
+ * and compared on every hit, so a hash collision is a miss, never the
+ * wrong audio. */
+static uint64_t entry_key(const char *text, uint64_t voice, float speed) {
+  uint32_t version = HAL_TTS_CACHE_TEXT_VERSION;
+  uint16_t speed16 = (uint16_t)speed_key(speed);
+  uint64_t hash = fnv64(FNV64_BASIS, &version, sizeof(version));
+  hash = fnv64(hash, &voice, sizeof(voice));
+  hash = fnv64(hash, &speed16, sizeof(speed16));
+  return fnv64(hash, text, strlen(text));
+}
+
+static size_t ram_entry_bytes(const RamEntry *e) { return e->bytes; }
+
+static RamEntry *ram_entry_of(const int16_t *samples) {
+  return (RamEntry *)((char *)samples - offsetof(RamEntry, samples));
+}
+
+/* Allocate an entry for num_samples of text, holding one reference */
+static RamEntry *ram_new(uint64_t key, const char *text, size_t num_samples) {
+  size_t text_len = strlen(text);
+  size_t bytes =
+      sizeof(RamEntry) + num_samples * sizeof(int16_t) + text_len + 1;
+  RamEntry *e = hampod_malloc(ALLOC_TTS_CACHE, bytes);
+  if (e != NULL) {
+    e->next = e->newer = e->older = NULL;
+    e->key = key;
+    e->text = memcpy((char *)(e->samples + num_samples), text, text_len + 1);
+    e->refs = 1;
+    e->bytes = bytes;
+    e->num_samples = num_samples;
+  }
+  return e;
+}
+
+static void ram_unref(RamEntry *e) {
+  if (--e->refs == 0) {
+    hampod_free(e);
+  }
+}
+
+static RamEntry **ram_slot(uint64_t key, const char *text) {
+  RamEntry **slot = &ram_buckets[key & (RAM_BUCKETS - 1)];
+  while (*slot != NULL &&
+         ((*slot)->key != key || strcmp((*slot)->text, text) != 0)) {
+    slot = &(*slot)->next;
+  }
+  return slot;
+}
+
+static void ram_unlink_lru(RamEntry *e) {
+  if (e->newer != NULL) {
+    e->newer->older = e->older;
+  } else {
+    ram_newest = e->older;
+  }
+  if (e->older != NULL) {
+    e->older->newer = e->newer;
+  } else {
+    ram_oldest = e->newer;
+  }
+  e->newer = e->older = NULL;
+}
+
+static void ram_link_newest(RamEntry *e) {
+  e->older = ram_newest;
+  e->newer = NULL;
+  if (ram_newest != NULL) {
+    ram_newest->newer = e;
+  } else {
+    ram_oldest = e;
+  }
+  ram_newest = e;
+}
+
+/* Drop an entry from the tier; it lives on while lookups still hold it */
+static void ram_evict(RamEntry *e) {
+  RamEntry **slot = ram_slot(e->key, e->text);
+  *slot = e->next;
+  ram_unlink_lru(e);
+  current_ram_size -= ram_entry_bytes(e);
+  ram_unref(e);
+}
+
+/* Cache an entry as the newest, replacing any with its key. Call with
+ * cache_lock held; entries over the whole budget are not kept. */
+static void ram_insert(RamEntry *e) {
+  size_t bytes = ram_entry_bytes(e);
+  if (bytes > max_ram_cache_size) {
+    return;
+  }
+  RamEntry **slot = ram_slot(e->key, e->text);
+  if (*slot != NULL) {
+    ram_evict(*slot);
+  }
+  while (ram_oldest != NULL && current_ram_size + bytes > max_ram_cache_size) {
+    ram_evict(ram_oldest);
+  }
+  slot = ram_slot(e->key, e->text); /* Evictions may have moved it */
+  e->next = NULL;
+  *slot = e;
+  ram_link_newest(e);
+  current_ram_size += bytes;
+  e->refs++;
+}
+
+static void ram_evict_all(void) {
+  while (ram_oldest != NULL) {
+    ram_evict(ram_oldest);
+  }
+}
+
+/* Copy samples into the RAM tier */
+static void ram_store(uint64_t key, const char *text, const int16_t *samples,
+                      size_t num_samples) {
+  if (max_ram_cache_size == 0) {
+    return;
+  }
+  RamEntry *e = ram_new(key, text, num_samples);
+  if (e == NULL) {
+    return;
+  }
+  memcpy(e->samples, samples, num_samples * sizeof(int16_t));
+  pthread_mutex_lock(&cache_lock);
+  ram_insert(e);
+  ram_unref(e); /* The tier holds it now, if it fitted */
+  pthread_mutex_unlock(&cache_lock);
 }
 
 /* Recursive mkdir */
@@ -59,170 +422,2250 @@ static int mkdir_p(const char *path) {
   return 0;
 }
 
-/* Calculate initial total cache size */
-static void compute_cache_size(void) {
-  DIR *dir;
-  struct dirent *ent;
-  struct stat st;
-  char filepath[1024];
+static IndexSlot *index_slots(void) { return (IndexSlot *)(index_header + 1); }
 
-  current_cache_size = 0;
-  if ((dir = opendir(cache_dir_path)) != NULL) {
-    while ((ent = readdir(dir)) != NULL) {
-      if (strstr(ent->d_name, ".pcm")) {
-        snprintf(filepath, sizeof(filepath), "%s/%s", cache_dir_path,
-                 ent->d_name);
-        if (stat(filepath, &st) == 0) {
-          current_cache_size += st.st_size;
-        }
-      }
+static size_t index_bytes(uint32_t capacity) {
+  return sizeof(IndexHeader) + (size_t)capacity * sizeof(IndexSlot);
+}
+
+static void store_path(char *path, size_t len, const char *name) {
+  snprintf(path, len, "%s/%s", cache_dir_path, name);
+}
+
+static void segment_path(char *path, size_t len, unsigned segment) {
+  char name[32];
+  snprintf(name, sizeof(name), STORE_SEGMENT_FORMAT, segment);
+  store_path(path, len, name);
+}
+
+/* Create an empty index file of capacity slots at path and map it */
+static IndexHeader *index_create(const char *path, uint32_t capacity,
+                                 int *fd_out) {
+  int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd == -1) {
+    return NULL;
+  }
+  size_t bytes = index_bytes(capacity);
+  IndexHeader *header = MAP_FAILED;
+  if (ftruncate(fd, (off_t)bytes) == 0) {
+    header = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  if (header == MAP_FAILED) {
+    close(fd);
+    remove(path);
+    return NULL;
+  }
+  memcpy(header->magic, STORE_INDEX_MAGIC, sizeof(header->magic));
+  header->capacity = capacity;
+  header->count = 0;
+  header->clock = 0;
+  header->aged = 0;
+  *fd_out = fd;
+  return header;
+}
+
+/* Delete the segment files and any per-entry files of the old layout,
+ * which no entry of a new index can point at; call with store_lock held */
+static void remove_entry_files(void) {
+  DIR *dir = opendir(cache_dir_path);
+  struct dirent *ent;
+  char filepath[600];
+  int removed = 0;
+  while (dir != NULL && (ent = readdir(dir)) != NULL) {
+    size_t len = strlen(ent->d_name);
+    if (len > 4 && strcmp(ent->d_name + len - 4, ".pcm") == 0) {
+      store_path(filepath, sizeof(filepath), ent->d_name);
+      removed += remove(filepath) == 0;
     }
+  }
+  if (dir != NULL) {
     closedir(dir);
   }
+  if (removed > 0) {
+    printf("HAL TTS CACHE: Removed %d stale cache files\n", removed);
+  }
+  store_path(filepath, sizeof(filepath), STORE_SIZES_FILE);
+  remove(filepath);
+  if (segment_sizes != NULL) {
+    memset(segment_sizes, 0, segment_slots * sizeof(uint64_t));
+  }
+  segment_count = 0;
+  current_cache_size = 0;
+  sizes_known = 1; /* Nothing left to size */
 }
 
-int hal_tts_cache_init(void) {
-  const char *env_dir = getenv(CACHE_DIR_ENV);
-  if (env_dir) {
-    snprintf(cache_dir_path, sizeof(cache_dir_path), "%s", env_dir);
-  } else {
-    const char *home = getenv("HOME");
-    if (home) {
-      snprintf(cache_dir_path, sizeof(cache_dir_path), "%s/%s", home,
-               DEFAULT_CACHE_DIR);
-    } else {
-      snprintf(cache_dir_path, sizeof(cache_dir_path), "/tmp/%s",
-               DEFAULT_CACHE_DIR);
+/* Map the index, or start a new one if it is missing, damaged or of an
+ * older format, removing the entries it would have pointed at */
+static int index_open(void) {
+  char path[600];
+  store_path(path, sizeof(path), STORE_INDEX_FILE);
+
+  int fd = open(path, O_RDWR | O_CLOEXEC);
+  struct stat st;
+  if (fd != -1 && fstat(fd, &st) == 0 &&
+      (size_t)st.st_size >= sizeof(IndexHeader)) {
+    IndexHeader *header = mmap(NULL, (size_t)st.st_size,
+                               PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (header != MAP_FAILED) {
+      uint32_t capacity = header->capacity;
+      if (memcmp(header->magic, STORE_INDEX_MAGIC, sizeof(header->magic)) ==
+              0 &&
+          capacity > 0 && (capacity & (capacity - 1)) == 0 &&
+          index_bytes(capacity) == (size_t)st.st_size) {
+        index_fd = fd;
+        index_header = header;
+        index_size = (size_t)st.st_size;
+        return 0;
+      }
+      munmap(header, (size_t)st.st_size);
     }
   }
-
-  const char *env_size = getenv(CACHE_SIZE_ENV);
-  if (env_size) {
-    max_disk_cache_size = strtoull(env_size, NULL, 10);
+  if (fd != -1) {
+    close(fd);
+    fprintf(stderr, "HAL TTS CACHE: Index damaged or outdated, starting a "
+                    "new one\n");
   }
 
-  if (mkdir_p(cache_dir_path) != 0) {
-    fprintf(stderr, "HAL TTS CACHE: Failed to create cache directory %s\n",
-            cache_dir_path);
+  remove_entry_files();
+  index_header = index_create(path, STORE_INDEX_SLOTS, &index_fd);
+  if (index_header == NULL) {
+    fprintf(stderr, "HAL TTS CACHE: Cannot create %s\n", path);
     return -1;
   }
-
-  compute_cache_size();
-  cache_initialized = 1;
-  printf("HAL TTS CACHE: Initialized at %s, current size = %llu bytes, max "
-         "size = %llu bytes\n",
-         cache_dir_path, (unsigned long long)current_cache_size,
-         (unsigned long long)max_disk_cache_size);
+  index_size = index_bytes(STORE_INDEX_SLOTS);
   return 0;
 }
 
-int hal_tts_cache_lookup(const char *text, int16_t **samples,
-                         size_t *num_samples) {
-  if (!cache_initialized) {
-    if (hal_tts_cache_init() != 0)
-      return -1;
+/* Slot holding the key, or the empty slot it would go in */
+static IndexSlot *index_probe(uint64_t key) {
+  IndexSlot *slots = index_slots();
+  uint32_t mask = index_header->capacity - 1;
+  for (uint32_t i = (uint32_t)(key ^ (key >> 32)) & mask;;
+       i = (i + 1) & mask) {
+    IndexSlot *slot = &slots[i];
+    if (slot->segment == 0 || slot->key == key) {
+      return slot;
+    }
   }
+}
 
-  uint32_t hash = djb2_hash(text);
-  char filepath[512];
-  get_file_path(hash, filepath, sizeof(filepath));
+/* Double the index into a new file and swap it in; 0 on success */
+static int index_grow(void) {
+  char path[600];
+  char tmppath[608];
+  store_path(path, sizeof(path), STORE_INDEX_FILE);
+  snprintf(tmppath, sizeof(tmppath), "%s.tmp", path);
 
-  FILE *f = fopen(filepath, "rb");
-  if (!f)
-    return -1; // Cache miss
+  int fd;
+  IndexHeader *old = index_header;
+  IndexHeader *header = index_create(tmppath, old->capacity * 2, &fd);
+  if (header == NULL) {
+    return -1;
+  }
+  IndexSlot *old_slots = index_slots();
+  uint32_t old_capacity = old->capacity;
+  header->clock = old->clock;
+  header->aged = old->aged;
+  index_header = header;
+  for (uint32_t i = 0; i < old_capacity; i++) {
+    if (old_slots[i].segment != 0) {
+      *index_probe(old_slots[i].key) = old_slots[i];
+      header->count++;
+    }
+  }
+  msync(header, index_bytes(header->capacity), MS_SYNC);
+  if (rename(tmppath, path) != 0) {
+    munmap(header, index_bytes(header->capacity));
+    close(fd);
+    remove(tmppath);
+    index_header = old;
+    return -1;
+  }
+  munmap(old, index_size);
+  close(index_fd);
+  index_fd = fd;
+  index_size = index_bytes(header->capacity);
+  return 0;
+}
 
-  fseek(f, 0, SEEK_END);
-  long size = ftell(f);
-  fseek(f, 0, SEEK_SET);
+/* Take the slot out of the index, moving later slots of its run back so
+ * probes still find them; call with store_lock held */
+static void index_remove(IndexSlot *slot) {
+  IndexSlot *slots = index_slots();
+  uint32_t mask = index_header->capacity - 1;
+  uint32_t hole = (uint32_t)(slot - slots);
+  for (uint32_t i = (hole + 1) & mask; slots[i].segment != 0;
+       i = (i + 1) & mask) {
+    uint64_t key = slots[i].key;
+    uint32_t home = (uint32_t)(key ^ (key >> 32)) & mask;
+    /* Movable unless its home lies after the hole, up to i */
+    if (((i - home) & mask) >= ((i - hole) & mask)) {
+      slots[hole] = slots[i];
+      hole = i;
+    }
+  }
+  memset(&slots[hole], 0, sizeof(IndexSlot));
+  index_header->count--;
+}
 
-  if (size <= 0) {
-    fclose(f);
-    return -1;
+/* Record an entry; call with store_lock held */
+static void index_put(uint64_t key, size_t text_len, unsigned segment,
+                      uint32_t offset, size_t num_samples, unsigned format,
+                      uint32_t sum, unsigned hits) {
+  if ((index_header->count + 1) * 2 > index_header->capacity &&
+      index_grow() != 0) {
+    fprintf(stderr, "HAL TTS CACHE: Cannot grow the index\n");
+    if (index_header->count + 1 >= index_header->capacity) {
+      return; /* Keep one slot empty so probes end */
+    }
+  }
+  IndexSlot *slot = index_probe(key);
+  if (slot->segment == 0) {
+    index_header->count++;
   }
+  slot->key = key;
+  slot->offset = offset;
+  slot->num_samples = (uint32_t)num_samples;
+  slot->last_use = ++index_header->clock;
+  slot->hits = (uint16_t)hits;
+  slot->text_len = (uint16_t)text_len;
+  slot->format = (uint16_t)format;
+  slot->sum = sum;
+  slot->segment = (uint16_t)segment;
+}
 
-  *samples = (int16_t *)malloc(size);
-  if (!*samples) {
-    fclose(f);
-    return -1;
+/* Note a segment's size; call with store_lock held */
+static int segment_set_size(unsigned segment, uint64_t size) {
+  if (segment >= segment_slots) {
+    unsigned slots = segment_slots > 0 ? segment_slots : 16;
+    while (slots <= segment) {
+      slots *= 2;
+    }
+    uint64_t *sizes = hampod_realloc(ALLOC_TTS_CACHE, segment_sizes,
+                                     slots * sizeof(uint64_t));
+    if (sizes == NULL) {
+      return -1;
+    }
+    memset(sizes + segment_slots, 0,
+           (slots - segment_slots) * sizeof(uint64_t));
+    segment_sizes = sizes;
+    segment_slots = slots;
   }
+  segment_sizes[segment] = size;
+  if (segment > segment_count) {
+    segment_count = segment;
+  }
+  return 0;
+}
 
-  size_t read_bytes = fread(*samples, 1, size, f);
-  fclose(f);
+/* The segment's data, mapped; call with store_lock held */
+static const char *segment_data(unsigned segment) {
+  MappedSegment *victim = &mapped[0];
+  for (int i = 0; i < STORE_MAPPED_MAX; i++) {
+    if (mapped[i].segment == segment) {
+      mapped[i].last_use = ++map_clock;
+      return mapped[i].data;
+    }
+    if (mapped[i].last_use < victim->last_use) {
+      victim = &mapped[i];
+    }
+  }
 
-  if (read_bytes != (size_t)size) {
-    free(*samples);
-    *samples = NULL;
-    return -1;
+  char path[600];
+  segment_path(path, sizeof(path), segment);
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return NULL;
   }
+  /* Mapped at full size, so appends later on are readable through it */
+  void *data = mmap(NULL, STORE_SEGMENT_MAX, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return NULL;
+  }
+  if (victim->segment != 0) {
+    munmap((void *)victim->data, STORE_SEGMENT_MAX);
+  }
+  victim->segment = segment;
+  victim->data = data;
+  victim->last_use = ++map_clock;
+  return data;
+}
 
-  *num_samples = size / sizeof(int16_t);
-  return 0; // Hit
+static void segments_unmap(void) {
+  for (int i = 0; i < STORE_MAPPED_MAX; i++) {
+    if (mapped[i].segment != 0) {
+      munmap((void *)mapped[i].data, STORE_SEGMENT_MAX);
+    }
+    mapped[i].segment = 0;
+    mapped[i].last_use = 0;
+  }
 }
 
-void hal_tts_cache_release(int16_t *samples) {
-  if (samples) {
-    free(samples);
+/* Note a hit on the entry */
+static void slot_touch(IndexSlot *slot) {
+  slot->last_use = ++index_header->clock;
+  if (slot->hits < STORE_HITS_MAX) {
+    slot->hits++;
   }
 }
 
-int hal_tts_cache_store(const char *text, const int16_t *samples,
-                        size_t num_samples) {
-  if (!cache_initialized) {
-    if (hal_tts_cache_init() != 0)
-      return -1;
+/* The entry stored for text under key, if its data was written and its
+ * stored text is text, counting a hit on it if touch is set; call with
+ * store_lock held. Returns its stored samples in the mapped segment, or
+ * NULL, with their STORE_FORMAT_* in format and payload_sum() in sum if
+ * those are not NULL. */
+static const uint8_t *store_find(uint64_t key, const char *text,
+                                 size_t *num_samples, unsigned *format,
+                                 uint32_t *sum, int touch) {
+  if (index_header == NULL) {
+    return NULL;
+  }
+  IndexSlot *slot = index_probe(key);
+  size_t text_len = strlen(text);
+  if (slot->segment == 0 || slot->segment > segment_count ||
+      slot->text_len != text_len || slot->format > STORE_FORMAT_ADPCM ||
+      (uint64_t)slot->offset + text_len +
+              payload_bytes(slot->format, slot->num_samples) >
+          segment_sizes[slot->segment]) {
+    return NULL;
+  }
+  const char *data = segment_data(slot->segment);
+  if (data == NULL || memcmp(data + slot->offset, text, text_len) != 0) {
+    return NULL; /* Another text with the same key */
+  }
+  if (touch) {
+    slot_touch(slot);
+  }
+  *num_samples = slot->num_samples;
+  if (format != NULL) {
+    *format = slot->format;
+  }
+  if (sum != NULL) {
+    *sum = slot->sum;
   }
+  return (const uint8_t *)(data + slot->offset + text_len);
+}
 
-  size_t size_bytes = num_samples * sizeof(int16_t);
+/* Long PCM entries are played straight from their segment file: a hit
+ * maps just the entry, has the kernel read all of it ahead in order, and
+ * hands out the mapping, so playback starts once the first page is in
+ * rather than after the whole entry is read. An entry is only indexed
+ * once it is on the card, so its checksum is left to the writer thread,
+ * after release; an entry found damaged then is dropped before it can
+ * play again. Guarded by store_lock. */
+#define STORE_STREAM_MIN (16000 * 2) /* Samples; shorter entries are copied */
+#define STORE_STREAMS_MAX 8          /* Streams handed out at a time */
 
-  // MVP phase: enforce hard limit (simplistic)
-  if (current_cache_size + size_bytes > max_disk_cache_size) {
-    fprintf(stderr, "HAL TTS CACHE: Disk cache full\n");
-    return -1;
+typedef struct {
+  const int16_t *samples; /* NULL if unused */
+  void *map;
+  size_t map_len;
+  uint64_t key;
+  unsigned segment;
+  uint32_t offset;
+} StoreStream;
+
+static StoreStream streams[STORE_STREAMS_MAX];
+
+/* Map the samples of the PCM entry in slot for streaming; call with
+ * store_lock held. NULL if every stream is in use or mapping fails. */
+static const int16_t *stream_open(const IndexSlot *slot) {
+  StoreStream *stream = NULL;
+  for (int i = 0; i < STORE_STREAMS_MAX && stream == NULL; i++) {
+    if (streams[i].samples == NULL) {
+      stream = &streams[i];
+    }
+  }
+  if (stream == NULL) {
+    return NULL;
   }
 
-  uint32_t hash = djb2_hash(text);
-  char filepath[512];
-  get_file_path(hash, filepath, sizeof(filepath));
+  char path[600];
+  segment_path(path, sizeof(path), slot->segment);
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return NULL;
+  }
+  uint64_t start = (uint64_t)slot->offset + slot->text_len;
+  uint64_t map_start = start - start % (uint64_t)sysconf(_SC_PAGESIZE);
+  size_t len = (size_t)(start - map_start) +
+               (size_t)slot->num_samples * sizeof(int16_t);
+  void *map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, (off_t)map_start);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return NULL;
+  }
+  madvise(map, len, MADV_SEQUENTIAL);
+  madvise(map, len, MADV_WILLNEED); /* Start reading it all now */
 
-  FILE *f = fopen(filepath, "wb");
-  if (!f)
-    return -1;
+  stream->samples = (const int16_t *)((char *)map + (start - map_start));
+  stream->map = map;
+  stream->map_len = len;
+  stream->key = slot->key;
+  stream->segment = slot->segment;
+  stream->offset = slot->offset;
+  return stream->samples;
+}
 
-  size_t written = fwrite(samples, sizeof(int16_t), num_samples, f);
-  fclose(f);
+/* Unmap the stream handing out samples, filling in check for the writer;
+ * 0 if samples is not a stream's */
+static int stream_close(const int16_t *samples, CacheCheck *check) {
+  int found = 0;
+  pthread_mutex_lock(&store_lock);
+  for (int i = 0; i < STORE_STREAMS_MAX && !found; i++) {
+    if (streams[i].samples == samples) {
+      munmap(streams[i].map, streams[i].map_len);
+      check->key = streams[i].key;
+      check->segment = streams[i].segment;
+      check->offset = streams[i].offset;
+      streams[i].samples = NULL;
+      found = 1;
+    }
+  }
+  pthread_mutex_unlock(&store_lock);
+  return found;
+}
 
-  if (written == num_samples) {
-    current_cache_size += size_bytes;
-    return 0;
+/* Verify a streamed entry's samples, dropping the entry if they are
+ * damaged; skipped if it has since been evicted or replaced */
+static void store_check(const CacheCheck *check) {
+  pthread_mutex_lock(&store_lock);
+  IndexSlot *slot = index_header != NULL ? index_probe(check->key) : NULL;
+  if (slot != NULL && slot->segment == check->segment &&
+      slot->offset == check->offset) {
+    const char *data = segment_data(slot->segment);
+    size_t len = payload_bytes(slot->format, slot->num_samples);
+    if (data != NULL &&
+        payload_sum(data + slot->offset + slot->text_len, len) != slot->sum) {
+      fprintf(stderr, "HAL TTS CACHE: Damaged entry removed after playing\n");
+      index_remove(slot);
+    }
   }
+  pthread_mutex_unlock(&store_lock);
+}
 
-  // Cleanup on partial write
-  remove(filepath);
-  return -1;
+/* Count a hit served from the RAM tier against the stored entry */
+static void store_touch(uint64_t key) {
+  pthread_mutex_lock(&store_lock);
+  if (index_header != NULL) {
+    IndexSlot *slot = index_probe(key);
+    if (slot->segment != 0) {
+      slot_touch(slot);
+    }
+  }
+  pthread_mutex_unlock(&store_lock);
 }
 
-void hal_tts_cache_cleanup(void) { cache_initialized = 0; }
+/* Largest segment: an eighth of the budget, so eviction frees space in
+ * small steps, within STORE_SEGMENT_MIN and STORE_SEGMENT_MAX */
+static uint64_t segment_limit(void) {
+  uint64_t limit = max_disk_cache_size / 8;
+  if (limit < STORE_SEGMENT_MIN) {
+    limit = STORE_SEGMENT_MIN;
+  }
+  return limit < STORE_SEGMENT_MAX ? limit : STORE_SEGMENT_MAX;
+}
 
-int hal_tts_cache_clear(void) {
-  if (!cache_initialized) {
-    if (hal_tts_cache_init() != 0)
+/* Write all of len bytes to fd; 0 on success */
+static int write_all(int fd, const void *data, size_t len) {
+  size_t written = 0;
+  while (written < len) {
+    ssize_t n = write(fd, (const char *)data + written, len - written);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
       return -1;
+    }
+    written += (size_t)n;
   }
+  return 0;
+}
 
-  DIR *dir;
-  struct dirent *ent;
-  char filepath[1024];
+/* A segment number with nothing in it other than current, or 0 if all
+ * are taken; call with store_lock held */
+static unsigned segment_free(unsigned current) {
+  for (unsigned segment = 1; segment <= UINT16_MAX; segment++) {
+    if (segment != current &&
+        (segment > segment_count || segment_sizes[segment] == 0)) {
+      return segment;
+    }
+  }
+  return 0;
+}
 
-  if ((dir = opendir(cache_dir_path)) != NULL) {
-    while ((ent = readdir(dir)) != NULL) {
-      if (strstr(ent->d_name, ".pcm")) {
-        snprintf(filepath, sizeof(filepath), "%s/%s", cache_dir_path,
-                 ent->d_name);
-        remove(filepath);
+static uint32_t size_check(const SizesRecord *record) {
+  uint64_t hash = fnv64(FNV64_BASIS, &record->segment, sizeof(record->segment));
+  hash = fnv64(hash, &record->size, sizeof(record->size));
+  return (uint32_t)(hash ^ (hash >> 32));
+}
+
+static void size_record(SizesRecord *record, unsigned segment,
+                        uint64_t size) {
+  record->segment = segment;
+  record->size = size;
+  record->check = size_check(record);
+}
+
+/* Rewrite the journal as one record per segment in use, marked clean or
+ * not, and swap it in; call with append_lock held. 0 on success. */
+static int sizes_write(int clean) {
+  char path[600];
+  char tmppath[608];
+  store_path(path, sizeof(path), STORE_SIZES_FILE);
+  snprintf(tmppath, sizeof(tmppath), "%s.tmp", path);
+
+  size_t count = 0;
+  for (unsigned segment = 1; segment <= segment_count; segment++) {
+    count += segment_sizes[segment] > 0;
+  }
+  size_t bytes = sizeof(SizesHeader) + count * sizeof(SizesRecord);
+  char *data = hampod_calloc(ALLOC_TTS_CACHE, 1, bytes);
+  if (data == NULL) {
+    return -1;
+  }
+  SizesHeader *header = (SizesHeader *)data;
+  memcpy(header->magic, STORE_SIZES_MAGIC, sizeof(header->magic));
+  header->clean = (uint32_t)clean;
+  SizesRecord *record = (SizesRecord *)(header + 1);
+  for (unsigned segment = 1; segment <= segment_count; segment++) {
+    if (segment_sizes[segment] > 0) {
+      size_record(record++, segment, segment_sizes[segment]);
+    }
+  }
+
+  /* The old journal stays until the new one is whole on the card */
+  int fd = open(tmppath, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  int result = fd != -1 && write_all(fd, data, bytes) == 0 &&
+                       fdatasync(fd) == 0 && rename(tmppath, path) == 0
+                   ? 0
+                   : -1;
+  hampod_free(data);
+  if (result != 0) {
+    if (fd != -1) {
+      close(fd);
+      remove(tmppath);
+    }
+    return -1;
+  }
+  if (sizes_fd != -1) {
+    close(sizes_fd);
+  }
+  sizes_fd = fd;
+  sizes_end = (off_t)bytes;
+  sizes_records = (unsigned)count;
+  return 0;
+}
+
+/* Journal a segment's new size; call with append_lock held. Not synced: a
+ * record lost in a power cut is made up by the repair after it. */
+static void sizes_note(unsigned segment, uint64_t size) {
+  if (sizes_fd == -1) {
+    return;
+  }
+  SizesRecord record;
+  size_record(&record, segment, size);
+  if (pwrite(sizes_fd, &record, sizeof(record), sizes_end) ==
+      (ssize_t)sizeof(record)) {
+    sizes_end += (off_t)sizeof(record);
+    sizes_records++;
+  }
+  if (sizes_records > STORE_SIZES_RECORDS &&
+      sizes_records > 4 * segment_count) {
+    sizes_write(0);
+  }
+}
+
+/* Read the segment sizes back from the journal, and keep it open marked
+ * not clean; sizes_known is set only if it was closed clean and whole.
+ * Call with store_lock held, after index_open(). */
+static void sizes_open(void) {
+  char path[600];
+  store_path(path, sizeof(path), STORE_SIZES_FILE);
+  int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  struct stat st;
+  off_t end = 0;
+  if (fd != -1 && fstat(fd, &st) == 0 &&
+      (size_t)st.st_size >= sizeof(SizesHeader)) {
+    const SizesHeader *header =
+        mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (header != MAP_FAILED) {
+      if (memcmp(header->magic, STORE_SIZES_MAGIC, sizeof(header->magic)) ==
+          0) {
+        const SizesRecord *records = (const SizesRecord *)(header + 1);
+        size_t count =
+            ((size_t)st.st_size - sizeof(SizesHeader)) / sizeof(SizesRecord);
+        size_t i = 0;
+        /* Up to the first torn or unwritten record */
+        while (i < count && records[i].segment > 0 &&
+               records[i].segment <= UINT16_MAX &&
+               records[i].check == size_check(&records[i]) &&
+               segment_set_size(records[i].segment, records[i].size) == 0) {
+          i++;
+        }
+        end = (off_t)(sizeof(SizesHeader) + i * sizeof(SizesRecord));
+        sizes_records = (unsigned)i;
+        sizes_known = header->clean && end == st.st_size;
       }
+      munmap((void *)header, (size_t)st.st_size);
     }
-    closedir(dir);
   }
   current_cache_size = 0;
-  return 0;
+  for (unsigned segment = 1; segment <= segment_count; segment++) {
+    current_cache_size += segment_sizes[segment];
+  }
+  if (fd == -1) {
+    fprintf(stderr, "HAL TTS CACHE: Cannot open %s\n", path);
+    return;
+  }
+
+  /* Marked not clean on the card before anything changes */
+  SizesHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, STORE_SIZES_MAGIC, sizeof(header.magic));
+  if (end == 0) {
+    end = (off_t)sizeof(header);
+    sizes_records = 0;
+  }
+  if (ftruncate(fd, end) != 0 ||
+      pwrite(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+      fdatasync(fd) != 0) {
+    fprintf(stderr, "HAL TTS CACHE: Cannot write %s\n", path);
+    close(fd);
+    return;
+  }
+  sizes_fd = fd;
+  sizes_end = end;
+}
+
+/* Append an entry, its text and then its samples as stored in format, and
+ * index it with hits already counted; call with append_lock held. 0 on
+ * success. */
+static int append_locked(uint64_t key, const char *text, size_t text_len,
+                         const void *payload, size_t num_samples,
+                         unsigned format, unsigned hits) {
+  size_t len = payload_bytes(format, num_samples);
+  size_t size_bytes = text_len + len;
+  uint32_t sum = payload_sum(payload, len);
+  pthread_mutex_lock(&store_lock);
+  unsigned segment = append_segment != 0 ? append_segment
+                     : segment_count > 0 ? segment_count
+                                         : 1;
+  uint64_t limit = segment_limit();
+  pthread_mutex_unlock(&store_lock);
+
+  /* Appended at the end of the current segment, or of a free one */
+  off_t offset = -1;
+  while (offset == -1 && segment != 0) {
+    if (append_fd != -1 && append_segment != segment) {
+      close(append_fd);
+      append_fd = -1;
+    }
+    if (append_fd == -1) {
+      char path[600];
+      segment_path(path, sizeof(path), segment);
+      append_fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+      append_segment = segment;
+    }
+    if (append_fd == -1) {
+      break;
+    }
+    offset = lseek(append_fd, 0, SEEK_END);
+    /* One byte spare, to keep the samples 2-byte aligned */
+    if (offset != -1 && (uint64_t)offset + size_bytes + 1 > limit) {
+      offset = -1;
+      pthread_mutex_lock(&store_lock);
+      segment = segment_free(segment);
+      pthread_mutex_unlock(&store_lock);
+    }
+  }
+  if (offset == -1) {
+    return -1;
+  }
+
+  static const char pad = '\0';
+  off_t end = offset;
+  offset += (offset + (off_t)text_len) % 2;
+  /* On the card before the index points at it, so a power cut leaves at
+   * worst an entry that was never indexed */
+  if ((offset != end && write_all(append_fd, &pad, 1) != 0) ||
+      write_all(append_fd, text, text_len) != 0 ||
+      write_all(append_fd, payload, len) != 0 ||
+      fdatasync(append_fd) != 0) {
+    // Cleanup on partial write
+    if (ftruncate(append_fd, end) != 0) {
+      close(append_fd);
+      append_fd = -1;
+    }
+    return -1;
+  }
+
+  /* Data first, then the index entry pointing at it */
+  pthread_mutex_lock(&store_lock);
+  uint64_t before = segment <= segment_count ? segment_sizes[segment] : 0;
+  int result = index_header != NULL
+                   ? segment_set_size(segment, (uint64_t)offset + size_bytes)
+                   : -1;
+  if (result == 0) {
+    current_cache_size += (uint64_t)offset + size_bytes - before;
+    index_put(key, text_len, segment, (uint32_t)offset, num_samples, format,
+              sum, hits);
+  }
+  pthread_mutex_unlock(&store_lock);
+  if (result == 0) {
+    sizes_note(segment, (uint64_t)offset + size_bytes);
+  }
+  return result;
+}
+
+typedef struct {
+  uint64_t key;
+  unsigned hits;
+  size_t text_len;
+  size_t num_samples;
+  unsigned format;
+  char *data; /* Text, then samples as stored */
+} CarriedEntry;
+
+/* Worth of an entry: its hits, discounted by how long ago it was last
+ * used, measured in uses of the whole store */
+static double entry_value(const IndexSlot *slot) {
+  double age = (double)(index_header->clock - slot->last_use);
+  double count = index_header->count > 0 ? index_header->count : 1;
+  return (slot->hits + 1.0) / (1.0 + age / count);
+}
+
+static size_t entry_bytes(const IndexSlot *slot) {
+  return slot->text_len + payload_bytes(slot->format, slot->num_samples);
+}
+
+/* Whether an entry of a deleted segment is copied forward: used more than
+ * once, and worth more per byte than the store's average */
+static int entry_carried(const IndexSlot *slot, double average) {
+  return slot->hits > 1 &&
+         entry_value(slot) / (double)entry_bytes(slot) > average;
+}
+
+/* Delete the segment whose loss costs least per byte, first copying out
+ * its entries that entry_carried(), up to half its size. Call with
+ * append_lock and store_lock held; returns the number of entries copied
+ * out into carried (free each one's data), or -1 if there is nothing to
+ * delete. */
+static int evict_segment(CarriedEntry **carried) {
+  double *worth =
+      hampod_calloc(ALLOC_TTS_CACHE, segment_count + 1, sizeof(double));
+  if (worth == NULL) {
+    return -1;
+  }
+  IndexSlot *slots = index_slots();
+  double total = 0.0;
+  for (uint32_t i = 0; i < index_header->capacity; i++) {
+    if (slots[i].segment != 0) {
+      total += entry_value(&slots[i]);
+    }
+  }
+  /* A segment is worth what deleting it would lose: what is carried
+   * forward only costs the copy */
+  double average = total / (double)(current_cache_size + 1);
+  for (uint32_t i = 0; i < index_header->capacity; i++) {
+    if (slots[i].segment != 0 && slots[i].segment <= segment_count &&
+        !entry_carried(&slots[i], average)) {
+      worth[slots[i].segment] += entry_value(&slots[i]);
+    }
+  }
+  unsigned victim = 0;
+  double least = 0.0;
+  for (unsigned segment = 1; segment <= segment_count; segment++) {
+    double density = segment_sizes[segment] > 0
+                         ? worth[segment] / (double)segment_sizes[segment]
+                         : 0.0;
+    if (segment_sizes[segment] > 0 && segment != append_segment &&
+        (victim == 0 || density < least)) {
+      victim = segment;
+      least = density;
+    }
+  }
+  hampod_free(worth);
+  /* The segment being appended to goes last */
+  if (victim == 0 && append_segment != 0 && append_segment <= segment_count &&
+      segment_sizes[append_segment] > 0) {
+    victim = append_segment;
+  }
+  if (victim == 0) {
+    return -1;
+  }
+
+  size_t budget = victim != append_segment ? segment_sizes[victim] / 2 : 0;
+  const char *data = segment_data(victim);
+  int kept = 0;
+  int room = 0;
+  *carried = NULL;
+  for (uint32_t i = 0; i < index_header->capacity;) {
+    IndexSlot *slot = &slots[i];
+    if (slot->segment != victim) {
+      i++;
+      continue;
+    }
+    size_t bytes = entry_bytes(slot);
+    if (data != NULL && bytes <= budget && entry_carried(slot, average) &&
+        (uint64_t)slot->offset + bytes <= segment_sizes[victim]) {
+      if (kept == room) {
+        room = room > 0 ? room * 2 : 16;
+        CarriedEntry *more = hampod_realloc(ALLOC_TTS_CACHE, *carried,
+                                            room * sizeof(CarriedEntry));
+        if (more == NULL) {
+          room = kept;
+        } else {
+          *carried = more;
+        }
+      }
+      char *copy = kept < room ? hampod_malloc(ALLOC_TTS_CACHE, bytes) : NULL;
+      if (copy != NULL) {
+        memcpy(copy, data + slot->offset, bytes);
+        CarriedEntry *entry = &(*carried)[kept++];
+        entry->key = slot->key;
+        entry->hits = slot->hits;
+        entry->text_len = slot->text_len;
+        entry->num_samples = slot->num_samples;
+        entry->format = slot->format;
+        entry->data = copy;
+        budget -= bytes;
+      }
+    }
+    index_remove(slot); /* Another slot may have moved into i */
+    stats.evicted++;
+  }
+  stats.evicted -= (unsigned long)kept;
+
+  for (int i = 0; i < STORE_MAPPED_MAX; i++) {
+    if (mapped[i].segment == victim) {
+      munmap((void *)mapped[i].data, STORE_SEGMENT_MAX);
+      mapped[i].segment = 0;
+      mapped[i].last_use = 0;
+    }
+  }
+  if (append_segment == victim && append_fd != -1) {
+    close(append_fd);
+    append_fd = -1;
+  }
+  char path[600];
+  segment_path(path, sizeof(path), victim);
+  remove(path);
+  current_cache_size -= segment_sizes[victim];
+  segment_sizes[victim] = 0;
+  sizes_note(victim, 0);
+  return kept;
+}
+
+/* Delete segments until the store is at most target bytes; call with
+ * append_lock held */
+static void store_evict_locked(uint64_t target) {
+  pthread_mutex_lock(&store_lock);
+  if (index_header != NULL && current_cache_size > target &&
+      index_header->clock - index_header->aged >= 4 * index_header->count) {
+    /* Age the counts, so what was heard often long ago can go */
+    index_header->aged = index_header->clock;
+    IndexSlot *slots = index_slots();
+    for (uint32_t i = 0; i < index_header->capacity; i++) {
+      slots[i].hits /= 2;
+    }
+  }
+  while (index_header != NULL && current_cache_size > target) {
+    CarriedEntry *carried = NULL;
+    int kept = evict_segment(&carried);
+    pthread_mutex_unlock(&store_lock);
+    for (int i = 0; i < kept; i++) {
+      append_locked(carried[i].key, carried[i].data, carried[i].text_len,
+                    carried[i].data + carried[i].text_len,
+                    carried[i].num_samples, carried[i].format,
+                    carried[i].hits);
+      hampod_free(carried[i].data);
+    }
+    hampod_free(carried);
+    pthread_mutex_lock(&store_lock);
+    if (kept < 0) {
+      break;
+    }
+  }
+  pthread_mutex_unlock(&store_lock);
+}
+
+static uint64_t budget_percent(unsigned percent) {
+  return max_disk_cache_size / 100 * percent;
+}
+
+static void writer_start_locked(void);
+
+/* Append one entry to the store, evicting first if it would not fit the
+ * budget; 0 on success */
+static int write_entry(uint64_t key, const char *text, const int16_t *samples,
+                       size_t num_samples) {
+  unsigned format = cache_compress ? STORE_FORMAT_ADPCM : STORE_FORMAT_PCM;
+  size_t text_len = strlen(text);
+  size_t size_bytes = text_len + payload_bytes(format, num_samples);
+  pthread_mutex_lock(&store_lock);
+  int fits = size_bytes + 1 <= segment_limit();
+  int ready = index_header != NULL;
+  pthread_mutex_unlock(&store_lock);
+  if (num_samples == 0 || text_len > STORE_TEXT_MAX || !fits || !ready) {
+    return -1;
+  }
+
+  const void *payload = samples;
+  uint8_t *encoded = NULL;
+  if (format == STORE_FORMAT_ADPCM) {
+    encoded =
+        hampod_malloc(ALLOC_TTS_CACHE, payload_bytes(format, num_samples));
+    if (encoded == NULL) {
+      return -1;
+    }
+    hal_adpcm_encode(samples, num_samples, encoded);
+    payload = encoded;
+  }
+
+  pthread_mutex_lock(&append_lock);
+  pthread_mutex_lock(&store_lock);
+  int full = current_cache_size + size_bytes > max_disk_cache_size;
+  pthread_mutex_unlock(&store_lock);
+  if (full) {
+    /* The writer fell behind, or the budget is tight: make room here */
+    store_evict_locked(budget_percent(STORE_EVICT_LOW) > size_bytes
+                           ? budget_percent(STORE_EVICT_LOW) - size_bytes
+                           : 0);
+    pthread_mutex_lock(&store_lock);
+    full = current_cache_size + size_bytes > max_disk_cache_size;
+    pthread_mutex_unlock(&store_lock);
+  }
+  int result = full ? -1 : append_locked(key, text, text_len, payload,
+                                         num_samples, format, 0);
+  pthread_mutex_lock(&store_lock);
+  int high = current_cache_size > budget_percent(STORE_EVICT_HIGH);
+  pthread_mutex_unlock(&store_lock);
+  pthread_mutex_unlock(&append_lock);
+  hampod_free(encoded);
+  if (full) {
+    fprintf(stderr, "HAL TTS CACHE: Disk cache full\n");
+  }
+
+  if (high) {
+    pthread_mutex_lock(&cache_lock);
+    writer_start_locked();
+    if (writer_running && !evict_wanted) {
+      evict_wanted = 1;
+      pthread_cond_signal(&write_ready);
+    }
+    pthread_mutex_unlock(&cache_lock);
+  }
+  return result;
+}
+
+/* Size up the segment files again, as the journal may be behind them
+ * after an unclean shutdown, and drop entries pointing past the end of
+ * their segment; sizing is done holding append_lock alone, so lookups go
+ * on meanwhile. Run on the writer thread. */
+static void store_repair(void) {
+  DIR *dir;
+  struct dirent *ent;
+  struct stat st;
+  char filepath[600];
+  unsigned segment;
+  uint64_t *found = NULL; /* Bytes, by segment number */
+  unsigned found_slots = 0;
+
+  pthread_mutex_lock(&append_lock);
+  if ((dir = opendir(cache_dir_path)) != NULL) {
+    while ((ent = readdir(dir)) != NULL) {
+      if (sscanf(ent->d_name, "seg_%4u.pcm", &segment) != 1 || segment == 0 ||
+          segment > UINT16_MAX) {
+        continue;
+      }
+      store_path(filepath, sizeof(filepath), ent->d_name);
+      if (stat(filepath, &st) != 0) {
+        continue;
+      }
+      if (segment >= found_slots) {
+        unsigned slots = found_slots > 0 ? found_slots : 16;
+        while (slots <= segment) {
+          slots *= 2;
+        }
+        uint64_t *more =
+            hampod_realloc(ALLOC_TTS_CACHE, found, slots * sizeof(uint64_t));
+        if (more == NULL) {
+          continue;
+        }
+        memset(more + found_slots, 0,
+               (slots - found_slots) * sizeof(uint64_t));
+        found = more;
+        found_slots = slots;
+      }
+      found[segment] = (uint64_t)st.st_size;
+    }
+    closedir(dir);
+  }
+
+  int dropped = 0;
+  pthread_mutex_lock(&store_lock);
+  int open = index_header != NULL;
+  if (open) {
+    if (segment_sizes != NULL) {
+      memset(segment_sizes, 0, segment_slots * sizeof(uint64_t));
+    }
+    current_cache_size = 0;
+    for (segment = 1; segment < found_slots; segment++) {
+      if (found[segment] > 0 && segment_set_size(segment, found[segment]) == 0) {
+        current_cache_size += found[segment];
+      }
+    }
+    IndexSlot *slots = index_slots();
+    for (uint32_t i = 0; i < index_header->capacity;) {
+      IndexSlot *slot = &slots[i];
+      uint64_t size = slot->segment != 0 && slot->segment <= segment_count
+                          ? segment_sizes[slot->segment]
+                          : 0;
+      if (slot->segment == 0 ||
+          (uint64_t)slot->offset + entry_bytes(slot) <= size) {
+        i++;
+        continue;
+      }
+      index_remove(slot); /* Another slot may have moved into i */
+      dropped++;
+    }
+  }
+  uint64_t total = current_cache_size;
+  pthread_mutex_unlock(&store_lock);
+  hampod_free(found);
+  if (!open) {
+    pthread_mutex_unlock(&append_lock);
+    return;
+  }
+
+  sizes_known = 1;
+  sizes_write(0);
+  pthread_mutex_unlock(&append_lock);
+  printf("HAL TTS CACHE: Sized the store again after an unclean shutdown: "
+         "%llu bytes, %d broken entries dropped\n",
+         (unsigned long long)total, dropped);
+}
+
+/* Map the index and read the sizes journal; call with store_lock held */
+static int store_open(void) {
+  sizes_known = 0;
+  if (index_open() != 0) {
+    return -1;
+  }
+  sizes_open();
+  return 0;
+}
+
+/* Unmap and close the store, flushing the index; call with append_lock
+ * and store_lock held */
+static void store_close_locked(void) {
+  if (append_fd != -1) {
+    close(append_fd);
+    append_fd = -1;
+  }
+  segments_unmap();
+  if (index_header != NULL) {
+    msync(index_header, index_size, MS_SYNC);
+    munmap(index_header, index_size);
+    index_header = NULL;
+  }
+  /* After the index is on the card, so clean means both are */
+  if (sizes_fd != -1) {
+    sizes_write(sizes_known);
+    close(sizes_fd);
+    sizes_fd = -1;
+  }
+  if (index_fd != -1) {
+    close(index_fd);
+    index_fd = -1;
+  }
+  hampod_free(segment_sizes);
+  segment_sizes = NULL;
+  segment_slots = 0;
+  segment_count = 0;
+  append_segment = 0;
+}
+
+static void store_close(void) {
+  pthread_mutex_lock(&append_lock);
+  pthread_mutex_lock(&store_lock);
+  store_close_locked();
+  pthread_mutex_unlock(&store_lock);
+  pthread_mutex_unlock(&append_lock);
+}
+
+static void writeback_seed(void);
+
+/* Read the settings and open the store. Call with cache_lock held. */
+static int cache_open(void) {
+  const char *env_dir = getenv(CACHE_DIR_ENV);
+  if (env_dir) {
+    snprintf(cache_dir_path, sizeof(cache_dir_path), "%s", env_dir);
+  } else {
+    const char *home = getenv("HOME");
+    if (home) {
+      snprintf(cache_dir_path, sizeof(cache_dir_path), "%s/%s", home,
+               DEFAULT_CACHE_DIR);
+    } else {
+      snprintf(cache_dir_path, sizeof(cache_dir_path), "/tmp/%s",
+               DEFAULT_CACHE_DIR);
+    }
+  }
+
+  const char *env_size = getenv(CACHE_SIZE_ENV);
+  max_disk_cache_size = env_size != NULL ? strtoull(env_size, NULL, 10)
+                                         : DEFAULT_MAX_DISK_CACHE_SIZE;
+  const char *env_ram = getenv(CACHE_RAM_ENV);
+  if (env_ram && !ram_budget_set) {
+    max_ram_cache_size = strtoull(env_ram, NULL, 10);
+  }
+  const char *env_compress = getenv(CACHE_COMPRESS_ENV);
+  cache_compress = env_compress != NULL && strcmp(env_compress, "0") != 0;
+
+  /* tmpfs mode: the directory above becomes the copy's */
+  const char *env_tmpfs = getenv(CACHE_TMPFS_ENV);
+  writeback_dir[0] = '\0';
+  if (env_tmpfs != NULL && env_tmpfs[0] != '\0') {
+    snprintf(writeback_dir, sizeof(writeback_dir), "%s/tmpfs",
+             cache_dir_path);
+    snprintf(cache_dir_path, sizeof(cache_dir_path), "%s", env_tmpfs);
+    if (env_size == NULL) {
+      max_disk_cache_size = DEFAULT_MAX_TMPFS_CACHE_SIZE;
+    }
+    const char *env_period = getenv(CACHE_WRITEBACK_ENV);
+    writeback_period = env_period != NULL
+                           ? (unsigned)strtoul(env_period, NULL, 10)
+                           : DEFAULT_WRITEBACK_PERIOD;
+    writeback_next = time(NULL) + writeback_period;
+  }
+
+  if (mkdir_p(cache_dir_path) != 0) {
+    fprintf(stderr, "HAL TTS CACHE: Failed to create cache directory %s\n",
+            cache_dir_path);
+    return -1;
+  }
+
+  writeback_seed();
+  pthread_mutex_lock(&store_lock);
+  int result = store_open();
+  pthread_mutex_unlock(&store_lock);
+  if (result != 0) {
+    store_close();
+    return -1;
+  }
+
+  cache_initialized = 1;
+  repair_wanted = !sizes_known;
+  printf("HAL TTS CACHE: Initialized at %s, current size = %llu bytes, max "
+         "size = %llu bytes, RAM tier %llu bytes\n",
+         cache_dir_path, (unsigned long long)current_cache_size,
+         (unsigned long long)max_disk_cache_size,
+         (unsigned long long)max_ram_cache_size);
+  if (writeback_dir[0] != '\0') {
+    printf("HAL TTS CACHE: Working in RAM, written back to %s every %u "
+           "seconds\n",
+           writeback_dir, writeback_period);
+  }
+  return 0;
+}
+
+int hal_tts_cache_init(void) {
+  pthread_mutex_lock(&cache_lock);
+  int result = cache_initialized ? 0 : cache_open();
+  pthread_mutex_unlock(&cache_lock);
+  return result;
+}
+
+/* Initialise on first use; 0 once the cache is usable */
+static int cache_ready(void) { return hal_tts_cache_init(); }
+
+/* File name of a voice model */
+static const char *voice_name(const char *voice) {
+  const char *name = voice != NULL ? strrchr(voice, '/') : NULL;
+  return name != NULL ? name + 1 : voice != NULL ? voice : "";
+}
+
+/* Id of a voice model: its file name, and the size that tells retrained
+ * models apart */
+static uint64_t voice_id(const char *voice) {
+  if (voice == NULL) {
+    return 0;
+  }
+  struct stat st;
+  uint64_t size = stat(voice, &st) == 0 ? (uint64_t)st.st_size : 0;
+  const char *name = voice_name(voice);
+  uint64_t id = fnv64(FNV64_BASIS, name, strlen(name));
+  return fnv64(id, &size, sizeof(size));
+}
+
+/* The voice the calling thread's entries are under */
+static uint64_t current_voice(void) {
+  return thread_voice != 0 ? thread_voice : cache_voice;
+}
+
+void hal_tts_cache_set_voice(const char *voice) {
+  uint64_t id = voice_id(voice);
+  pthread_mutex_lock(&cache_lock);
+  snprintf(cache_voice_name, sizeof(cache_voice_name), "%s",
+           voice_name(voice));
+  if (id != cache_voice) {
+    cache_voice = id;
+    ram_evict_all(); /* The old voice's entries would only take up room */
+  }
+  pthread_mutex_unlock(&cache_lock);
+}
+
+void hal_tts_cache_select_voice(const char *voice) {
+  thread_voice = voice_id(voice);
+}
+
+int hal_tts_cache_lookup(const char *text, float speed,
+                         const int16_t **samples, size_t *num_samples) {
+  if (cache_ready() != 0)
+    return -1;
+
+  pthread_mutex_lock(&cache_lock);
+  uint64_t key = entry_key(text, current_voice(), speed);
+  RamEntry *e = *ram_slot(key, text);
+  if (e != NULL) {
+    ram_unlink_lru(e);
+    ram_link_newest(e);
+    e->refs++;
+    stats.ram_hits++;
+    pthread_mutex_unlock(&cache_lock);
+    store_touch(key);
+    *samples = e->samples;
+    *num_samples = e->num_samples;
+    return 0; // Hit in RAM
+  }
+  pthread_mutex_unlock(&cache_lock);
+
+  pthread_mutex_lock(&store_lock);
+  size_t stored_samples;
+  unsigned format;
+  uint32_t sum;
+  const uint8_t *data =
+      store_find(key, text, &stored_samples, &format, &sum, 1);
+  const int16_t *streamed =
+      data != NULL && format == STORE_FORMAT_PCM &&
+              stored_samples >= STORE_STREAM_MIN
+          ? stream_open(index_probe(key))
+          : NULL;
+  if (streamed != NULL) {
+    stats.disk_hits++;
+    stats.streamed++;
+    pthread_mutex_unlock(&store_lock);
+    *samples = streamed;
+    *num_samples = stored_samples;
+    return 0; // Hit, playing from the store
+  }
+  /* Checked before decoding: ADPCM of damaged data still decodes */
+  if (data != NULL &&
+      payload_sum(data, payload_bytes(format, stored_samples)) != sum) {
+    fprintf(stderr, "HAL TTS CACHE: Damaged entry for \"%s\", ignored\n",
+            text);
+    data = NULL;
+  }
+  e = data != NULL ? ram_new(key, text, stored_samples) : NULL;
+  if (e != NULL) {
+    if (format == STORE_FORMAT_ADPCM) {
+      hal_adpcm_decode(data, stored_samples, e->samples);
+    } else {
+      memcpy(e->samples, data, stored_samples * sizeof(int16_t));
+    }
+  }
+  if (e != NULL) {
+    stats.disk_hits++;
+  } else {
+    stats.misses++;
+  }
+  pthread_mutex_unlock(&store_lock);
+  if (e == NULL)
+    return -1; // Cache miss
+
+  /* Kept in RAM for next time, unless another thread got there first */
+  pthread_mutex_lock(&cache_lock);
+  if (*ram_slot(key, text) == NULL) {
+    ram_insert(e);
+  }
+  pthread_mutex_unlock(&cache_lock);
+
+  *samples = e->samples;
+  *num_samples = e->num_samples;
+  return 0; // Hit
+}
+
+int hal_tts_cache_contains(const char *text, float speed) {
+  if (cache_ready() != 0)
+    return 0;
+
+  pthread_mutex_lock(&cache_lock);
+  uint64_t key = entry_key(text, current_voice(), speed);
+  int in_ram = *ram_slot(key, text) != NULL;
+  pthread_mutex_unlock(&cache_lock);
+  if (in_ram)
+    return 1;
+
+  size_t num_samples;
+  pthread_mutex_lock(&store_lock);
+  int stored = store_find(key, text, &num_samples, NULL, NULL, 0) != NULL;
+  pthread_mutex_unlock(&store_lock);
+  return stored;
+}
+
+void hal_tts_cache_release(const int16_t *samples) {
+  CacheCheck check;
+  if (samples == NULL) {
+    return;
+  }
+  if (stream_close(samples, &check)) {
+    pthread_mutex_lock(&cache_lock);
+    if (cache_initialized) {
+      writer_start_locked();
+    }
+    if (writer_running && check_count < CACHE_CHECK_QUEUE) {
+      check_queue[check_count++] = check;
+      pthread_cond_signal(&write_ready);
+    }
+    pthread_mutex_unlock(&cache_lock);
+    return;
+  }
+  pthread_mutex_lock(&cache_lock);
+  ram_unref(ram_entry_of(samples));
+  pthread_mutex_unlock(&cache_lock);
+}
+
+int hal_tts_cache_store(const char *text, float speed,
+                        const int16_t *samples, size_t num_samples) {
+  if (cache_ready() != 0)
+    return -1;
+
+  pthread_mutex_lock(&cache_lock);
+  uint64_t key = entry_key(text, current_voice(), speed);
+  pthread_mutex_unlock(&cache_lock);
+  ram_store(key, text, samples, num_samples);
+  return write_entry(key, text, samples, num_samples);
+}
+
+int16_t *hal_tts_cache_buffer(size_t *capacity) {
+  pthread_mutex_lock(&cache_lock);
+  if (spare_count > 0) {
+    CacheBuffer spare = spares[--spare_count];
+    pthread_mutex_unlock(&cache_lock);
+    hampod_alloc_retag(spare.samples, ALLOC_TTS_CAPTURE);
+    *capacity = spare.capacity;
+    return spare.samples;
+  }
+  pthread_mutex_unlock(&cache_lock);
+
+  int16_t *samples =
+      hampod_malloc(ALLOC_TTS_CAPTURE, CACHE_BUFFER_SAMPLES * sizeof(int16_t));
+  *capacity = samples != NULL ? CACHE_BUFFER_SAMPLES : 0;
+  return samples;
+}
+
+void hal_tts_cache_recycle(int16_t *samples, size_t capacity) {
+  if (samples == NULL) {
+    return;
+  }
+  hampod_alloc_retag(samples, ALLOC_TTS_CACHE);
+  pthread_mutex_lock(&cache_lock);
+  if (spare_count < CACHE_SPARE_BUFFERS) {
+    spares[spare_count].samples = samples;
+    spares[spare_count].capacity = capacity;
+    spare_count++;
+    samples = NULL;
+  }
+  pthread_mutex_unlock(&cache_lock);
+  hampod_free(samples);
+}
+
+/* Write queued entries, then check streamed ones, then evict when asked
+ * to and repair once upkeep has begun, with neither queued, until told to
+ * stop with the queues empty */
+/* The writer's next copy to the card is due; call with cache_lock held */
+static int writeback_due(void) {
+  return writeback_dir[0] != '\0' && writeback_period > 0 &&
+         time(NULL) >= writeback_next;
+}
+
+static void *cache_writer(void *arg) {
+  (void)arg;
+  pthread_mutex_lock(&cache_lock);
+  for (;;) {
+    while (write_count == 0 && check_count == 0 && !writer_stop &&
+           !evict_wanted && !hotset_wanted &&
+           !(repair_wanted && upkeep_begun) && !writeback_due()) {
+      if (writeback_dir[0] != '\0' && writeback_period > 0) {
+        struct timespec at = {.tv_sec = writeback_next};
+        pthread_cond_timedwait(&write_ready, &cache_lock, &at);
+      } else {
+        pthread_cond_wait(&write_ready, &cache_lock);
+      }
+    }
+    if (write_count == 0 && check_count == 0 && writer_stop) {
+      break;
+    }
+    if (write_count == 0 && check_count > 0) {
+      CacheCheck check = check_queue[--check_count];
+      pthread_mutex_unlock(&cache_lock);
+      store_check(&check);
+      pthread_mutex_lock(&cache_lock);
+      continue;
+    }
+    if (write_count == 0 && hotset_wanted) {
+      hotset_wanted = 0;
+      pthread_mutex_unlock(&cache_lock);
+      int loaded = hal_tts_cache_load_hotset();
+      if (loaded > 0) {
+        printf("HAL TTS CACHE: %d entries of the hot set in RAM\n", loaded);
+      }
+      pthread_mutex_lock(&cache_lock);
+      continue;
+    }
+    if (write_count == 0 && evict_wanted) {
+      evict_wanted = 0;
+      pthread_mutex_unlock(&cache_lock);
+      pthread_mutex_lock(&append_lock);
+      store_evict_locked(budget_percent(STORE_EVICT_LOW));
+      pthread_mutex_unlock(&append_lock);
+      pthread_mutex_lock(&cache_lock);
+      continue;
+    }
+    if (write_count == 0 && writeback_due()) {
+      writeback_next = time(NULL) + writeback_period;
+      pthread_mutex_unlock(&cache_lock);
+      hal_tts_cache_writeback();
+      pthread_mutex_lock(&cache_lock);
+      continue;
+    }
+    if (write_count == 0) {
+      repair_wanted = 0;
+      pthread_mutex_unlock(&cache_lock);
+      store_repair();
+      pthread_mutex_lock(&cache_lock);
+      continue;
+    }
+    CacheWrite job = write_queue[write_head];
+    write_head = (write_head + 1) % CACHE_WRITE_QUEUE;
+    write_count--;
+    pthread_mutex_unlock(&cache_lock);
+
+    write_entry(job.key, job.text, job.samples, job.num_samples);
+    hampod_free(job.text);
+    hal_tts_cache_recycle(job.samples, job.capacity);
+
+    pthread_mutex_lock(&cache_lock);
+  }
+  pthread_mutex_unlock(&cache_lock);
+  return NULL;
+}
+
+/* Start the writer if it is not running; call with cache_lock held */
+static void writer_start_locked(void) {
+  if (!writer_running &&
+      pthread_create(&writer_thread, NULL, cache_writer, NULL) == 0) {
+    writer_running = 1;
+    writer_stop = 0;
+  }
+}
+
+int hal_tts_cache_store_owned(const char *text, float speed,
+                              int16_t *samples, size_t num_samples,
+                              size_t capacity) {
+  hampod_alloc_retag(samples, ALLOC_TTS_CACHE);
+  if (cache_ready() != 0) {
+    hal_tts_cache_recycle(samples, capacity);
+    return -1;
+  }
+
+  pthread_mutex_lock(&cache_lock);
+  uint64_t key = entry_key(text, current_voice(), speed);
+  pthread_mutex_unlock(&cache_lock);
+  /* In RAM at once, so a lookup before the entry is written still hits */
+  ram_store(key, text, samples, num_samples);
+
+  char *copy = hampod_strdup(ALLOC_TTS_CACHE, text);
+  pthread_mutex_lock(&cache_lock);
+  writer_start_locked();
+  if (copy != NULL && writer_running && write_count < CACHE_WRITE_QUEUE) {
+    CacheWrite *job =
+        &write_queue[(write_head + write_count) % CACHE_WRITE_QUEUE];
+    job->key = key;
+    job->text = copy;
+    job->samples = samples;
+    job->num_samples = num_samples;
+    job->capacity = capacity;
+    write_count++;
+    pthread_cond_signal(&write_ready);
+    pthread_mutex_unlock(&cache_lock);
+    return 0;
+  }
+  pthread_mutex_unlock(&cache_lock);
+
+  /* No writer or a backlog: write it here */
+  hampod_free(copy);
+  int result = write_entry(key, text, samples, num_samples);
+  hal_tts_cache_recycle(samples, capacity);
+  return result;
+}
+
+void hal_tts_cache_begin_upkeep(void) {
+  if (cache_ready() != 0) {
+    return;
+  }
+  pthread_mutex_lock(&cache_lock);
+  if (!upkeep_begun) {
+    hotset_wanted = max_ram_cache_size > 0; /* Once per run */
+  }
+  upkeep_begun = 1;
+  if (repair_wanted || hotset_wanted || writeback_dir[0] != '\0') {
+    writer_start_locked();
+    pthread_cond_signal(&write_ready);
+  }
+  pthread_mutex_unlock(&cache_lock);
+}
+
+/* Hot set (hotset.bin): the keys of the entries used most, hottest first,
+ * as many as fit the RAM budget, after a header. Written on the way out
+ * and read back into the RAM tier by the writer thread once the program
+ * is ready, so the prompts and readout words heard most are served from
+ * RAM from the first keypress rather than each read off the card once.
+ * Keys that no longer match a whole stored entry are skipped. */
+#define HOTSET_FILE "hotset.bin"
+#define HOTSET_MAGIC "HPTTSHS1"
+#define HOTSET_MAX 1024      /* Keys */
+#define HOTSET_LOCK_TRIES 50 /* 1 ms apart */
+
+typedef struct {
+  char magic[8];
+  uint32_t count;
+  uint32_t reserved;
+} HotsetHeader;
+
+typedef struct {
+  uint64_t key;
+  double value; /* entry_value() */
+} HotsetEntry;
+
+static int hotset_compare(const void *a, const void *b) {
+  double va = ((const HotsetEntry *)a)->value;
+  double vb = ((const HotsetEntry *)b)->value;
+  return va < vb ? 1 : va > vb ? -1 : 0;
+}
+
+/* Take lock, or give up after HOTSET_LOCK_TRIES ms: on the way out it may
+ * be held by the thread exit() runs on. 1 if taken. */
+static int lock_briefly(pthread_mutex_t *lock) {
+  for (int i = 0; i < HOTSET_LOCK_TRIES; i++) {
+    if (pthread_mutex_trylock(lock) == 0) {
+      return 1;
+    }
+    usleep(1000);
+  }
+  return 0;
+}
+
+int hal_tts_cache_save_hotset(void) {
+  if (!lock_briefly(&store_lock)) {
+    return -1;
+  }
+  if (index_header == NULL) {
+    pthread_mutex_unlock(&store_lock);
+    return -1;
+  }
+
+  IndexSlot *slots = index_slots();
+  HotsetEntry *ranked =
+      hampod_calloc(ALLOC_TTS_CACHE, index_header->count + 1, sizeof(*ranked));
+  if (ranked == NULL) {
+    pthread_mutex_unlock(&store_lock);
+    return -1;
+  }
+  size_t found = 0;
+  for (uint32_t i = 0; i < index_header->capacity; i++) {
+    if (slots[i].segment != 0 && slots[i].hits > 0 &&
+        found < index_header->count) {
+      ranked[found].key = slots[i].key;
+      ranked[found].value = entry_value(&slots[i]);
+      found++;
+    }
+  }
+  qsort(ranked, found, sizeof(*ranked), hotset_compare);
+
+  /* The hottest that fit the RAM tier, decoded */
+  uint64_t budget = max_ram_cache_size;
+  uint64_t bytes = 0;
+  size_t count = 0;
+  for (size_t i = 0; i < found && count < HOTSET_MAX; i++) {
+    const IndexSlot *slot = index_probe(ranked[i].key);
+    uint64_t size = sizeof(RamEntry) + slot->text_len + 1 +
+                    (uint64_t)slot->num_samples * sizeof(int16_t);
+    if (bytes + size <= budget) {
+      bytes += size;
+      ranked[count++].key = ranked[i].key;
+    }
+  }
+  pthread_mutex_unlock(&store_lock);
+
+  char path[600];
+  char tmppath[608];
+  store_path(path, sizeof(path), HOTSET_FILE);
+  if (count == 0) {
+    hampod_free(ranked);
+    remove(path); /* Nothing hot, or no RAM tier to load it into */
+    return 0;
+  }
+  snprintf(tmppath, sizeof(tmppath), "%s.tmp", path);
+  HotsetHeader header = {.count = (uint32_t)count};
+  memcpy(header.magic, HOTSET_MAGIC, sizeof(header.magic));
+  uint64_t *keys = (uint64_t *)ranked; /* Packed over the ranking */
+  for (size_t i = 0; i < count; i++) {
+    keys[i] = ranked[i].key;
+  }
+
+  int fd = open(tmppath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  int ok = fd != -1 && write_all(fd, &header, sizeof(header)) == 0 &&
+           write_all(fd, keys, count * sizeof(uint64_t)) == 0 &&
+           fdatasync(fd) == 0;
+  if (fd != -1) {
+    close(fd);
+  }
+  hampod_free(ranked);
+  if (!ok || rename(tmppath, path) != 0) {
+    remove(tmppath);
+    return -1;
+  }
+  return (int)count;
+}
+
+/* Copy the stored entry under key into the RAM tier, unless it is there
+ * already; 0 if it is there now */
+static int hotset_load_entry(uint64_t key) {
+  pthread_mutex_lock(&store_lock);
+  IndexSlot *slot = index_header != NULL ? index_probe(key) : NULL;
+  const char *data = NULL;
+  if (slot != NULL && slot->segment != 0 && slot->segment <= segment_count &&
+      slot->format <= STORE_FORMAT_ADPCM &&
+      (uint64_t)slot->offset + entry_bytes(slot) <=
+          segment_sizes[slot->segment]) {
+    data = segment_data(slot->segment);
+  }
+  size_t len = data != NULL ? payload_bytes(slot->format, slot->num_samples)
+                            : 0;
+  const char *stored = data != NULL ? data + slot->offset : NULL;
+  if (stored != NULL &&
+      payload_sum(stored + slot->text_len, len) != slot->sum) {
+    stored = NULL; /* Damaged; left for a lookup to report */
+  }
+  char text[STORE_TEXT_MAX + 1];
+  RamEntry *e = NULL;
+  if (stored != NULL && slot->text_len <= STORE_TEXT_MAX) {
+    memcpy(text, stored, slot->text_len);
+    text[slot->text_len] = '\0';
+    e = ram_new(key, text, slot->num_samples);
+  }
+  if (e != NULL) {
+    if (slot->format == STORE_FORMAT_ADPCM) {
+      hal_adpcm_decode((const uint8_t *)stored + slot->text_len,
+                       slot->num_samples, e->samples);
+    } else {
+      memcpy(e->samples, stored + slot->text_len,
+             slot->num_samples * sizeof(int16_t));
+    }
+  }
+  pthread_mutex_unlock(&store_lock);
+  if (e == NULL) {
+    return -1;
+  }
+
+  pthread_mutex_lock(&cache_lock);
+  if (*ram_slot(key, text) == NULL) {
+    ram_insert(e);
+  }
+  int cached = *ram_slot(key, text) != NULL;
+  ram_unref(e);
+  pthread_mutex_unlock(&cache_lock);
+  return cached ? 0 : -1;
+}
+
+int hal_tts_cache_load_hotset(void) {
+  if (cache_ready() != 0) {
+    return -1;
+  }
+  char path[600];
+  store_path(path, sizeof(path), HOTSET_FILE);
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) {
+    return 0; /* None saved yet */
+  }
+  HotsetHeader header;
+  uint64_t *keys = NULL;
+  if (fread(&header, sizeof(header), 1, f) == 1 &&
+      memcmp(header.magic, HOTSET_MAGIC, sizeof(header.magic)) == 0 &&
+      header.count <= HOTSET_MAX) {
+    keys = hampod_calloc(ALLOC_TTS_CACHE, header.count + 1, sizeof(*keys));
+  }
+  if (keys == NULL ||
+      fread(keys, sizeof(*keys), header.count, f) != header.count) {
+    fprintf(stderr, "HAL TTS CACHE: %s damaged, ignored\n", path);
+    hampod_free(keys);
+    fclose(f);
+    return -1;
+  }
+  fclose(f);
+
+  /* Coldest first, so the hottest end up newest in the LRU */
+  int loaded = 0;
+  for (uint32_t i = header.count; i > 0; i--) {
+    loaded += hotset_load_entry(keys[i - 1]) == 0;
+  }
+  hampod_free(keys);
+  return loaded;
+}
+
+/* tmpfs mode's copy on the card (see writeback_dir) */
+
+/* Note how much of a segment the copy on the card has; call with
+ * append_lock held, or before the store is open */
+static int mirror_set(unsigned segment, ino_t ino, uint64_t bytes) {
+  if (segment >= mirror_slots) {
+    unsigned slots = mirror_slots > 0 ? mirror_slots : 16;
+    while (slots <= segment) {
+      slots *= 2;
+    }
+    MirrorSegment *more =
+        hampod_realloc(ALLOC_TTS_CACHE, mirror, slots * sizeof(*more));
+    if (more == NULL) {
+      return -1;
+    }
+    memset(more + mirror_slots, 0, (slots - mirror_slots) * sizeof(*more));
+    mirror = more;
+    mirror_slots = slots;
+  }
+  mirror[segment].ino = ino;
+  mirror[segment].bytes = bytes;
+  return 0;
+}
+
+/* Copy bytes [from, to) of src to the same place in dst, which is started
+ * afresh if from is 0 and cut to to bytes, and sync it; 0 on success */
+static int copy_file_part(const char *src, const char *dst, uint64_t from,
+                          uint64_t to) {
+  int in = open(src, O_RDONLY | O_CLOEXEC);
+  if (in == -1) {
+    return -1;
+  }
+  int out = open(dst, O_WRONLY | O_CREAT | (from == 0 ? O_TRUNC : 0) |
+                          O_CLOEXEC,
+                 0644);
+  int result = out != -1 && lseek(out, (off_t)from, SEEK_SET) != -1 ? 0 : -1;
+  char buf[65536];
+  for (uint64_t at = from; result == 0 && at < to;) {
+    size_t want = to - at < sizeof(buf) ? (size_t)(to - at) : sizeof(buf);
+    ssize_t got = pread(in, buf, want, (off_t)at);
+    if (got <= 0 || write_all(out, buf, (size_t)got) != 0) {
+      result = -1;
+    }
+    at += got > 0 ? (uint64_t)got : 0;
+  }
+  if (result == 0 &&
+      (ftruncate(out, (off_t)to) != 0 || fdatasync(out) != 0)) {
+    result = -1;
+  }
+  if (out != -1) {
+    close(out);
+  }
+  close(in);
+  return result;
+}
+
+/* Copy a file of the copy on the card into the working directory; 0 on
+ * success, with its size added to bytes */
+static int seed_file(const char *name, uint64_t *bytes) {
+  char from[700];
+  char to[600];
+  struct stat st;
+  snprintf(from, sizeof(from), "%s/%s", writeback_dir, name);
+  store_path(to, sizeof(to), name);
+  if (stat(from, &st) != 0 ||
+      copy_file_part(from, to, 0, (uint64_t)st.st_size) != 0) {
+    return -1;
+  }
+  unsigned segment;
+  struct stat copied;
+  if (sscanf(name, "seg_%4u.pcm", &segment) == 1 && segment > 0 &&
+      stat(to, &copied) == 0) {
+    mirror_set(segment, copied.st_ino, (uint64_t)copied.st_size);
+  }
+  *bytes += (uint64_t)st.st_size;
+  return 0;
+}
+
+/* In tmpfs mode, start a working directory with no index (after a boot)
+ * from the copy on the card, the index last so a copy cut short is not
+ * used; call before store_open() */
+static void writeback_seed(void) {
+  char path[700];
+  struct stat st;
+  store_path(path, sizeof(path), STORE_INDEX_FILE);
+  if (writeback_dir[0] == '\0' || stat(path, &st) == 0) {
+    return;
+  }
+  DIR *dir = opendir(writeback_dir);
+  if (dir == NULL) {
+    return; /* Nothing written back yet */
+  }
+  struct dirent *ent;
+  uint64_t bytes = 0;
+  int files = 0;
+  int result = 0;
+  while (result == 0 && (ent = readdir(dir)) != NULL) {
+    unsigned segment;
+    if (strcmp(ent->d_name, STORE_SIZES_FILE) == 0 ||
+        strcmp(ent->d_name, HOTSET_FILE) == 0 ||
+        sscanf(ent->d_name, "seg_%4u.pcm", &segment) == 1) {
+      result = seed_file(ent->d_name, &bytes);
+      files++;
+    }
+  }
+  closedir(dir);
+  snprintf(path, sizeof(path), "%s/%s", writeback_dir, STORE_INDEX_FILE);
+  if (result == 0 && stat(path, &st) == 0) {
+    result = seed_file(STORE_INDEX_FILE, &bytes);
+    files++;
+  }
+  if (result != 0) {
+    fprintf(stderr, "HAL TTS CACHE: Cannot seed %s from %s, starting "
+                    "empty\n",
+            cache_dir_path, writeback_dir);
+    store_path(path, sizeof(path), STORE_INDEX_FILE);
+    remove(path); /* The segments go with the new index */
+    return;
+  }
+  printf("HAL TTS CACHE: Seeded %s from %s, %d files, %llu bytes\n",
+         cache_dir_path, writeback_dir, files, (unsigned long long)bytes);
+}
+
+/* Write data to path through a temporary file, so the old one stays until
+ * the new one is whole; 0 on success */
+static int replace_file(const char *path, const void *data, size_t bytes) {
+  char tmppath[720];
+  snprintf(tmppath, sizeof(tmppath), "%s.tmp", path);
+  int fd = open(tmppath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  int ok = fd != -1 && write_all(fd, data, bytes) == 0 && fdatasync(fd) == 0;
+  if (fd != -1) {
+    close(fd);
+  }
+  if (!ok || rename(tmppath, path) != 0) {
+    remove(tmppath);
+    return -1;
+  }
+  return 0;
+}
+
+/* Write the sizes journal and index snapshots to the copy, the journal
+ * first and marked not clean: a copy cut short between the two is then
+ * sized again after it is seeded, which in RAM is quick. 0 on success. */
+static int writeback_index(const char *index, size_t index_len,
+                           const uint64_t *sizes, unsigned count) {
+  size_t records = 0;
+  for (unsigned segment = 1; segment <= count; segment++) {
+    records += sizes[segment] > 0;
+  }
+  size_t bytes = sizeof(SizesHeader) + records * sizeof(SizesRecord);
+  char *data = hampod_calloc(ALLOC_TTS_CACHE, 1, bytes);
+  if (data == NULL) {
+    return -1;
+  }
+  SizesHeader *header = (SizesHeader *)data;
+  memcpy(header->magic, STORE_SIZES_MAGIC, sizeof(header->magic));
+  SizesRecord *record = (SizesRecord *)(header + 1);
+  for (unsigned segment = 1; segment <= count; segment++) {
+    if (sizes[segment] > 0) {
+      size_record(record++, segment, sizes[segment]);
+    }
+  }
+  char path[700];
+  snprintf(path, sizeof(path), "%s/%s", writeback_dir, STORE_SIZES_FILE);
+  int result = replace_file(path, data, bytes);
+  hampod_free(data);
+  snprintf(path, sizeof(path), "%s/%s", writeback_dir, STORE_INDEX_FILE);
+  return result == 0 ? replace_file(path, index, index_len) : -1;
+}
+
+/* Delete the copy's segments the store no longer has, and bring its hot
+ * set up to date; call with append_lock held */
+static void writeback_tidy(const uint64_t *sizes, unsigned count) {
+  char path[900];
+  DIR *dir = opendir(writeback_dir);
+  struct dirent *ent;
+  while (dir != NULL && (ent = readdir(dir)) != NULL) {
+    unsigned segment;
+    if (sscanf(ent->d_name, "seg_%4u.pcm", &segment) == 1 &&
+        (segment > count || sizes[segment] == 0)) {
+      snprintf(path, sizeof(path), "%s/%s", writeback_dir, ent->d_name);
+      remove(path);
+      if (segment < mirror_slots) {
+        mirror[segment].bytes = 0;
+      }
+    }
+  }
+  if (dir != NULL) {
+    closedir(dir);
+  }
+
+  char from[600];
+  struct stat st;
+  store_path(from, sizeof(from), HOTSET_FILE);
+  snprintf(path, sizeof(path), "%s/%s", writeback_dir, HOTSET_FILE);
+  if (stat(from, &st) != 0 ||
+      copy_file_part(from, path, 0, (uint64_t)st.st_size) != 0) {
+    remove(path);
+  }
+}
+
+int hal_tts_cache_writeback(void) {
+  if (writeback_dir[0] == '\0') {
+    return 0;
+  }
+  if (!lock_briefly(&append_lock)) {
+    return -1;
+  }
+  if (!lock_briefly(&store_lock)) {
+    pthread_mutex_unlock(&append_lock);
+    return -1;
+  }
+  if (index_header == NULL ||
+      (writeback_done && index_header->clock == writeback_clock &&
+       current_cache_size == writeback_size)) {
+    pthread_mutex_unlock(&store_lock);
+    pthread_mutex_unlock(&append_lock);
+    return 0; /* Nothing changed */
+  }
+
+  /* A snapshot; with append_lock held the segments stay as they are, but
+   * hits go on updating the index */
+  uint32_t clock = index_header->clock;
+  uint64_t total = current_cache_size;
+  unsigned count = segment_count;
+  size_t bytes = index_size;
+  char *index = hampod_malloc(ALLOC_TTS_CACHE, bytes);
+  uint64_t *sizes = hampod_calloc(ALLOC_TTS_CACHE, count + 1, sizeof(*sizes));
+  if (index != NULL && sizes != NULL) {
+    memcpy(index, index_header, bytes);
+    if (count > 0) {
+      memcpy(sizes, segment_sizes, (count + 1) * sizeof(*sizes));
+    }
+  }
+  pthread_mutex_unlock(&store_lock);
+
+  int result = index != NULL && sizes != NULL && mkdir_p(writeback_dir) == 0
+                   ? 0
+                   : -1;
+  uint64_t copied = 0;
+  for (unsigned segment = 1; result == 0 && segment <= count; segment++) {
+    char from[600];
+    char to[700];
+    struct stat st;
+    if (sizes[segment] == 0) {
+      continue;
+    }
+    segment_path(from, sizeof(from), segment);
+    snprintf(to, sizeof(to), "%s/" STORE_SEGMENT_FORMAT, writeback_dir,
+             segment);
+    if (stat(from, &st) != 0) {
+      result = -1;
+      break;
+    }
+    /* Only what was appended, unless it is another file now */
+    uint64_t start = segment < mirror_slots &&
+                             mirror[segment].ino == st.st_ino &&
+                             mirror[segment].bytes <= sizes[segment]
+                         ? mirror[segment].bytes
+                         : 0;
+    if (start < sizes[segment]) {
+      result = copy_file_part(from, to, start, sizes[segment]) == 0 &&
+                       mirror_set(segment, st.st_ino, sizes[segment]) == 0
+                   ? 0
+                   : -1;
+      copied += sizes[segment] - start;
+    }
+  }
+  if (result == 0) {
+    result = writeback_index(index, bytes, sizes, count);
+  }
+  if (result == 0) {
+    writeback_tidy(sizes, count);
+    writeback_done = 1;
+    writeback_clock = clock;
+    writeback_size = total;
+  }
+  pthread_mutex_unlock(&append_lock);
+  hampod_free(index);
+  hampod_free(sizes);
+
+  if (result != 0) {
+    fprintf(stderr, "HAL TTS CACHE: Cannot write back to %s\n",
+            writeback_dir);
+  } else {
+    printf("HAL TTS CACHE: Wrote back to %s, %llu bytes of segments\n",
+           writeback_dir, (unsigned long long)copied);
+  }
+  return result;
+}
+
+/* Cache packs (hal_tts_cache_export()): a header, then for each entry a
+ * PackEntry, its text and its s16 samples, in host byte order. Samples are
+ * stored decoded, so the target compresses them or not as it is set to. */
+#define PACK_MAGIC "HPTTSPK1"
+#define PACK_SAMPLES_MAX (16000U * 60U) /* Longer entries are damage */
+
+typedef struct {
+  char magic[8];
+  uint32_t text_version; /* HAL_TTS_CACHE_TEXT_VERSION */
+  uint32_t count;        /* Entries */
+  uint64_t voice;        /* voice_id() of the model */
+  uint16_t speed;        /* speed_key() */
+  uint16_t reserved;
+  char voice_name[60];   /* Model file name, for people */
+} PackHeader;
+
+typedef struct {
+  uint32_t num_samples;
+  uint16_t text_len;
+  uint16_t reserved;
+} PackEntry;
+
+int hal_tts_cache_export(const char *path, const char *voice, float speed,
+                         const char *const *texts, size_t count) {
+  if (cache_ready() != 0) {
+    return -1;
+  }
+  char tmp_path[1024];
+  snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+  FILE *f = fopen(tmp_path, "wb");
+  if (f == NULL) {
+    fprintf(stderr, "HAL TTS CACHE: Cannot write %s: %s\n", tmp_path,
+            strerror(errno));
+    return -1;
+  }
+
+  PackHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, PACK_MAGIC, sizeof(header.magic));
+  header.text_version = HAL_TTS_CACHE_TEXT_VERSION;
+  header.speed = (uint16_t)speed_key(speed);
+  pthread_mutex_lock(&cache_lock);
+  header.voice = voice != NULL ? voice_id(voice) : cache_voice;
+  snprintf(header.voice_name, sizeof(header.voice_name), "%.59s",
+           voice != NULL ? voice_name(voice) : cache_voice_name);
+  pthread_mutex_unlock(&cache_lock);
+  int ok = fwrite(&header, sizeof(header), 1, f) == 1;
+
+  /* Looked up under the pack's voice, as this thread's for a moment */
+  uint64_t saved_voice = thread_voice;
+  thread_voice = header.voice;
+  for (size_t i = 0; ok && i < count; i++) {
+    const int16_t *samples;
+    size_t num_samples;
+    size_t text_len = strlen(texts[i]);
+    if (text_len > STORE_TEXT_MAX ||
+        hal_tts_cache_lookup(texts[i], speed, &samples, &num_samples) != 0) {
+      continue; /* Not synthesized, or too long to have been stored */
+    }
+    PackEntry entry = {(uint32_t)num_samples, (uint16_t)text_len, 0};
+    ok = fwrite(&entry, sizeof(entry), 1, f) == 1 &&
+         fwrite(texts[i], 1, text_len, f) == text_len &&
+         fwrite(samples, sizeof(int16_t), num_samples, f) == num_samples;
+    hal_tts_cache_release(samples);
+    header.count++;
+  }
+  thread_voice = saved_voice;
+
+  ok = ok && fseek(f, 0, SEEK_SET) == 0 &&
+       fwrite(&header, sizeof(header), 1, f) == 1;
+  ok = fclose(f) == 0 && ok;
+  if (!ok || rename(tmp_path, path) != 0) {
+    fprintf(stderr, "HAL TTS CACHE: Cannot write %s\n", path);
+    remove(tmp_path);
+    return -1;
+  }
+  return (int)header.count;
+}
+
+int hal_tts_cache_import(const char *path) {
+  if (cache_ready() != 0) {
+    return -1;
+  }
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) {
+    fprintf(stderr, "HAL TTS CACHE: Cannot read %s: %s\n", path,
+            strerror(errno));
+    return -1;
+  }
+  PackHeader header;
+  if (fread(&header, sizeof(header), 1, f) != 1 ||
+      memcmp(header.magic, PACK_MAGIC, sizeof(header.magic)) != 0) {
+    fprintf(stderr, "HAL TTS CACHE: %s is not a cache pack\n", path);
+    fclose(f);
+    return -1;
+  }
+  if (header.text_version != HAL_TTS_CACHE_TEXT_VERSION) {
+    /* Its entries would never be looked up */
+    fprintf(stderr, "HAL TTS CACHE: %s is of text version %u, not %u\n",
+            path, header.text_version, HAL_TTS_CACHE_TEXT_VERSION);
+    fclose(f);
+    return -1;
+  }
+  header.voice_name[sizeof(header.voice_name) - 1] = '\0';
+  float speed = header.speed / 100.0f;
+
+  char text[STORE_TEXT_MAX + 1];
+  int16_t *samples = NULL;
+  size_t capacity = 0;
+  int added = 0;
+  uint32_t read = 0;
+  for (; read < header.count; read++) {
+    PackEntry entry;
+    if (fread(&entry, sizeof(entry), 1, f) != 1 ||
+        entry.text_len > STORE_TEXT_MAX || entry.num_samples == 0 ||
+        entry.num_samples > PACK_SAMPLES_MAX ||
+        fread(text, 1, entry.text_len, f) != entry.text_len) {
+      break;
+    }
+    text[entry.text_len] = '\0';
+    if (entry.num_samples > capacity) {
+      hampod_free(samples);
+      capacity = entry.num_samples;
+      samples = hampod_malloc(ALLOC_TTS_CACHE, capacity * sizeof(int16_t));
+      if (samples == NULL) {
+        capacity = 0;
+        break;
+      }
+    }
+    if (fread(samples, sizeof(int16_t), entry.num_samples, f) !=
+        entry.num_samples) {
+      break;
+    }
+
+    uint64_t key = entry_key(text, header.voice, speed);
+    size_t stored_samples;
+    pthread_mutex_lock(&store_lock);
+    int present = store_find(key, text, &stored_samples, NULL, NULL, 0) != NULL;
+    pthread_mutex_unlock(&store_lock);
+    if (!present && write_entry(key, text, samples, entry.num_samples) == 0) {
+      added++;
+    }
+  }
+  hampod_free(samples);
+  fclose(f);
+
+  if (read < header.count) {
+    fprintf(stderr, "HAL TTS CACHE: %s is damaged after %u entries\n", path,
+            read);
+    return -1;
+  }
+  printf("HAL TTS CACHE: %d of %u entries added from %s (%s, speed %.2f)\n",
+         added, header.count, path,
+         header.voice_name[0] != '\0' ? header.voice_name : "default voice",
+         speed);
+  return added;
+}
+
+void hal_tts_cache_get_stats(HalTtsCacheStats *out) {
+  pthread_mutex_lock(&cache_lock);
+  unsigned long ram_hits = stats.ram_hits;
+  uint64_t ram_bytes = current_ram_size;
+  pthread_mutex_unlock(&cache_lock);
+
+  pthread_mutex_lock(&store_lock);
+  *out = stats;
+  out->ram_hits = ram_hits;
+  out->ram_bytes = ram_bytes;
+  out->entries = index_header != NULL ? index_header->count : 0;
+  out->disk_bytes = current_cache_size;
+  pthread_mutex_unlock(&store_lock);
+}
+
+void hal_tts_cache_set_ram_budget(uint64_t bytes) {
+  pthread_mutex_lock(&cache_lock);
+  max_ram_cache_size = bytes;
+  ram_budget_set = 1;
+  while (ram_oldest != NULL && current_ram_size > max_ram_cache_size) {
+    ram_evict(ram_oldest);
+  }
+  pthread_mutex_unlock(&cache_lock);
+}
+
+void hal_tts_cache_cleanup(void) {
+  /* Finish the queued writes first */
+  pthread_mutex_lock(&cache_lock);
+  int joining = writer_running;
+  writer_stop = 1;
+  pthread_cond_signal(&write_ready);
+  pthread_mutex_unlock(&cache_lock);
+  if (joining) {
+    pthread_join(writer_thread, NULL);
+  }
+  hal_tts_cache_save_hotset();
+  hal_tts_cache_writeback();
+
+  pthread_mutex_lock(&cache_lock);
+  writer_running = 0;
+  evict_wanted = 0;
+  repair_wanted = 0;
+  hotset_wanted = 0;
+  while (spare_count > 0) {
+    hampod_free(spares[--spare_count].samples);
+  }
+  ram_evict_all();
+  store_close();
+  hampod_free(mirror);
+  mirror = NULL;
+  mirror_slots = 0;
+  writeback_done = 0;
+  cache_initialized = 0;
+  pthread_mutex_unlock(&cache_lock);
+}
+
+int hal_tts_cache_clear(void) {
+  if (cache_ready() != 0)
+    return -1;
+
+  DIR *dir;
+  struct dirent *ent;
+  char filepath[1024];
+
+  pthread_mutex_lock(&append_lock);
+  pthread_mutex_lock(&store_lock);
+  store_close_locked();
+  if ((dir = opendir(cache_dir_path)) != NULL) {
+    while ((ent = readdir(dir)) != NULL) {
+      if (strstr(ent->d_name, ".pcm") ||
+          strncmp(ent->d_name, STORE_INDEX_FILE,
+                  strlen(STORE_INDEX_FILE)) == 0 ||
+          strcmp(ent->d_name, HOTSET_FILE) == 0) {
+        snprintf(filepath, sizeof(filepath), "%s/%s", cache_dir_path,
+                 ent->d_name);
+        remove(filepath);
+      }
+    }
+    closedir(dir);
+  }
+  int result = store_open();
+  int known = sizes_known;
+  pthread_mutex_unlock(&store_lock);
+  pthread_mutex_unlock(&append_lock);
+  pthread_mutex_lock(&cache_lock);
+  ram_evict_all();
+  repair_wanted = !known;
+  if (repair_wanted && upkeep_begun) {
+    writer_start_locked();
+    pthread_cond_signal(&write_ready);
+  }
+  pthread_mutex_unlock(&cache_lock);
+  return result;
 }
@@ -4,41 +4,264 @@
 #include <stddef.h>
 #include <stdint.h>
 
+/*
+ * Entries live in a packed store in the cache directory: append-only
+ * segment files of text and PCM (seg_NNNN.pcm) and a memory-mapped hash
+ * index (index.bin). Entries are keyed by a 64-bit hash of the text
+ * version, voice, speed and text; the text is stored with each entry and
+ * checked on every hit, so a collision is a miss rather than the wrong
+ * audio. Files of earlier layouts are removed on first start.
+ */
+
+/**
+ * @brief Version of the text the engines are given
+ *
+ * Part of every key. Bump it when the same text starts being spoken
+ * differently (new text normalization, say), so old entries miss.
+ */
+#define HAL_TTS_CACHE_TEXT_VERSION 1
+
+/**
+ * @brief Cache counters, for diagnostics and tests
+ */
+typedef struct {
+  unsigned long ram_hits;  /**< Lookups served from the RAM tier */
+  unsigned long disk_hits; /**< Lookups served from the packed store */
+  unsigned long streamed;  /**< Of those, played straight from the store */
+  unsigned long misses;    /**< Lookups that found nothing */
+  unsigned long entries;   /**< Entries in the packed store */
+  unsigned long evicted;   /**< Entries deleted to stay within the budget */
+  uint64_t disk_bytes;     /**< Size of the segment files */
+  uint64_t ram_bytes;      /**< Size of the RAM tier */
+} HalTtsCacheStats;
+
 /**
  * @brief Initialize the TTS cache
+ *
+ * Reads the store's index. The other calls do this on first use; calling
+ * it at start-up, from any thread, gets it done before the first lookup.
+ * Does nothing once the cache is open.
+ *
  * @return 0 on success, -1 on failure
  */
 int hal_tts_cache_init(void);
 
+/**
+ * @brief Name the voice entries are stored and looked up under
+ *
+ * Entries of other voices miss, so changing the voice model does not play
+ * speech cached in the old one. The voice is told apart by its file name
+ * and, when the path can be read, its size, so a retrained model under
+ * the same name misses too.
+ *
+ * @param voice The voice model's path, or NULL for none
+ */
+void hal_tts_cache_set_voice(const char *voice);
+
+/**
+ * @brief Name the voice the calling thread's lookups and stores are under
+ *
+ * For speech in a voice other than the one hal_tts_cache_set_voice()
+ * named: each voice's entries stay apart and all of them stay valid, so
+ * switching back and forth plays cached speech in either at once.
+ *
+ * @param voice The voice model's path, or NULL for the default voice
+ */
+void hal_tts_cache_select_voice(const char *voice);
+
 /**
  * @brief Look up a phrase in the cache
+ *
+ * Entries are kept per speed, so changing speed leaves the others valid.
+ * Recently used entries stay in RAM (HAMPOD_TTS_CACHE_RAM bytes, 8MB by
+ * default) and are handed out without reading the disk or copying.
+ * Long entries (two seconds and more) are handed out as a mapping of the
+ * store, read ahead while they play, so they start without waiting for
+ * the whole entry to be read.
+ *
  * @param text The phrase to look up
- * @param samples Pointer to store the loaded PCM samples (dynamically
- * allocated)
+ * @param speed The length scale it is wanted at
+ * @param samples Pointer to store the PCM samples (shared and read-only;
+ * hold a reference until hal_tts_cache_release())
  * @param num_samples Pointer to store the number of samples
  * @return 0 on success (hit), -1 on miss/error
  */
-int hal_tts_cache_lookup(const char *text, int16_t **samples,
-                         size_t *num_samples);
+int hal_tts_cache_lookup(const char *text, float speed,
+                         const int16_t **samples, size_t *num_samples);
+
+/**
+ * @brief Check for a phrase without loading it
+ * @param text The phrase to look for
+ * @param speed The length scale it is wanted at
+ * @return 1 if an entry exists, 0 otherwise
+ */
+int hal_tts_cache_contains(const char *text, float speed);
 
 /**
  * @brief Release a cache entry previously returned by lookup
- * @param samples The pointer returned by lookup
+ *
+ * Safe from any thread, so it can be handed to hal_audio_queue_shared().
+ *
+ * @param samples The pointer returned by lookup (NULL is ignored)
  */
-void hal_tts_cache_release(int16_t *samples);
+void hal_tts_cache_release(const int16_t *samples);
 
 /**
  * @brief Store a phrase in the cache
  * @param text The phrase to store
+ * @param speed The length scale it was synthesized at
  * @param samples The PCM data
  * @param num_samples The number of samples
  * @return 0 on success, -1 on failure
  */
-int hal_tts_cache_store(const char *text, const int16_t *samples,
-                        size_t num_samples);
+int hal_tts_cache_store(const char *text, float speed,
+                        const int16_t *samples, size_t num_samples);
+
+/**
+ * @brief Get a buffer to capture speech into for hal_tts_cache_store_owned()
+ *
+ * Buffers already written to the cache are reused, so in steady state this
+ * does not allocate. The buffer may be grown with realloc().
+ *
+ * @param capacity Receives its size, in samples
+ * @return The buffer, or NULL if out of memory
+ */
+int16_t *hal_tts_cache_buffer(size_t *capacity);
+
+/**
+ * @brief Return a capture buffer that is not being stored
+ * @param samples The buffer (NULL is ignored)
+ * @param capacity Its size, in samples
+ */
+void hal_tts_cache_recycle(int16_t *samples, size_t capacity);
+
+/**
+ * @brief Store a phrase, handing over the capture buffer
+ *
+ * The entry is written by a background thread, which then recycles the
+ * buffer, so the caller does not wait for the disk. A lookup made before
+ * the write completes misses.
+ *
+ * @param text The phrase to store
+ * @param speed The length scale it was synthesized at
+ * @param samples A buffer from hal_tts_cache_buffer(); owned by the cache
+ *        from here on, even on failure
+ * @param num_samples The number of samples in it
+ * @param capacity Its size, in samples
+ * @return 0 if queued or stored, -1 on failure
+ */
+int hal_tts_cache_store_owned(const char *text, float speed,
+                              int16_t *samples, size_t num_samples,
+                              size_t capacity);
+
+/**
+ * @brief Write cached entries to a cache pack
+ *
+ * A cache pack carries entries of one voice model at one speed from the
+ * machine that synthesized them to others, which add them to their cache
+ * with hal_tts_cache_import(). They hit there if the same model (file name
+ * and size) is installed. Texts not in the cache are left out.
+ *
+ * @param path The pack file, replaced if it exists
+ * @param voice The voice model's path, or NULL for the voice named with
+ *        hal_tts_cache_set_voice()
+ * @param speed The length scale the entries were synthesized at
+ * @param texts The texts to write
+ * @param count How many there are
+ * @return The number of entries written, or -1 on failure
+ */
+int hal_tts_cache_export(const char *path, const char *voice, float speed,
+                         const char *const *texts, size_t count);
+
+/**
+ * @brief Add the entries of a cache pack to the cache
+ *
+ * Entries go into the packed store under the voice and speed the pack was
+ * made with; ones already cached are skipped.
+ *
+ * @param path The pack file (hal_tts_cache_export())
+ * @return The number of entries added, or -1 if the file is not a pack of
+ *         this text version or is damaged (entries before the damage are
+ *         kept)
+ */
+int hal_tts_cache_import(const char *path);
+
+/**
+ * @brief Start background upkeep held back from start-up
+ *
+ * Start-up reads the store's size accounting from a journal instead of
+ * sizing every segment file. If the cache was not closed cleanly, the
+ * files are sized up again and broken entries dropped, on the writer
+ * thread, once this is called; call it when the program is ready. The
+ * first call also reads the hot set saved on the way out last time
+ * (hal_tts_cache_save_hotset()) back into the RAM tier on that thread.
+ */
+void hal_tts_cache_begin_upkeep(void);
+
+/**
+ * @brief Save the hot set: the keys of the entries used most
+ *
+ * Ranked by use, discounted by how long ago they were last used, and as
+ * many as fit the RAM budget, to hotset.bin in the cache directory.
+ * hal_tts_cache_cleanup() calls it; so should a program that exits
+ * without it. Gives up rather than wait if the store stays busy, since
+ * it may run from exit() on a thread that holds it.
+ *
+ * @return The number of keys saved, or -1 on failure
+ */
+int hal_tts_cache_save_hotset(void);
+
+/**
+ * @brief Read the saved hot set's entries into the RAM tier
+ *
+ * Blocks; hal_tts_cache_begin_upkeep() runs it in the background. Keys
+ * no longer stored are skipped.
+ *
+ * @return The number of its entries now in RAM, 0 if none was saved, or
+ *         -1 if the file is damaged
+ */
+int hal_tts_cache_load_hotset(void);
+
+/**
+ * @brief Copy the store to the card, in tmpfs mode
+ *
+ * With HAMPOD_TTS_CACHE_TMPFS naming a directory in RAM, the store is
+ * worked on there, seeded at start-up from a copy in the "tmpfs"
+ * directory of the cache directory, and the budget is 64MB unless
+ * HAMPOD_TTS_CACHE_MAX_SIZE says otherwise. This brings the copy up to
+ * date, writing only what was appended since the last time, and the hot
+ * set. The writer thread calls it every HAMPOD_TTS_CACHE_WRITEBACK
+ * seconds (300 by default; 0 for only on the way out) once something
+ * changed, and hal_tts_cache_cleanup() after saving the hot set; a
+ * program that exits without it should call it too. Gives up rather than
+ * wait if the store stays busy, as hal_tts_cache_save_hotset() does.
+ *
+ * @return 0 on success or outside tmpfs mode, -1 on failure
+ */
+int hal_tts_cache_writeback(void);
+
+/**
+ * @brief Read the cache counters
+ * @param stats Receives them
+ */
+void hal_tts_cache_get_stats(HalTtsCacheStats *stats);
+
+/**
+ * @brief Change the RAM tier's budget while running
+ *
+ * Evicts the least recently used entries at once if the tier is over the
+ * new budget. Overrides HAMPOD_TTS_CACHE_RAM, including for a cache not
+ * yet initialized.
+ *
+ * @param bytes New budget; 0 keeps nothing in RAM
+ */
+void hal_tts_cache_set_ram_budget(uint64_t bytes);
 
 /**
  * @brief Clean up cache resources
+ *
+ * Waits for queued writes to finish, then saves the hot set and, in
+ * tmpfs mode, writes the store back (hal_tts_cache_writeback()).
  */
 void hal_tts_cache_cleanup(void);
 
@@ -2,18 +2,580 @@
  * @file hal_tts_festival.c
  * @brief Festival TTS implementation of the TTS HAL
  *
- * Uses Festival's text2wave command for speech synthesis.
+ * Keeps a Festival server (festival --server) running and talks to it over
+ * a local socket, so the voice is loaded once instead of by a text2wave
+ * process per utterance. Each phrase is sent as a Scheme command; the
+ * server answers with the waveform as raw 16kHz PCM, which goes straight
+ * to the audio HAL (no WAV file) and, when Festival is the primary engine,
+ * into the TTS cache, phrase by phrase as the Piper backends do.
+ *
+ * Festival's replies are framed: "WV\n" or "LP\n" followed by a waveform
+ * or Lisp text ending in the key "ft_StUfF_key" (an occurrence of the key
+ * in the data has an 'X' stuffed in before its last character), then
+ * "OK\n" or "ER\n" once the command is done. A server already listening
+ * on the port (HAMPOD_FESTIVAL_PORT, 1314 by default) is used as it is.
+ *
+ * Speech and hal_tts_warm() have a connection each; the server serves
+ * every connection from a process of its own, so warming does not hold up
+ * speech. An interrupted reply is not read to the end: its connection is
+ * dropped and the next phrase opens a new one. If the server does not
+ * start, each request runs text2wave as before.
  */
 
 #include "hal_audio.h"
-#include "hal_tts.h"
+#include "hal_tts_backend.h"
+#include "hal_tts_cache.h"
+#include "hal_tts_phrase.h"
+#include "hal_tts_thermal.h"
+#include "../hampod_alloc.h"
+#include "../hampod_trace.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* Port of the Festival server: HAMPOD_FESTIVAL_PORT, else this */
+#define FESTIVAL_PORT 1314
+/* How long the server may take to load its voice and start listening */
+#define FESTIVAL_START_TIMEOUT_MS 10000
+/* Longest wait for a reply to go on, e.g. a long phrase being synthesized */
+#define FESTIVAL_REPLY_TIMEOUT_MS 10000
+/* Reads wait in slices this long, so an interrupt is seen promptly */
+#define FESTIVAL_POLL_MS 20
+/* Ends every block of a reply (see the file comment) */
+#define FESTIVAL_STUFF_KEY "ft_StUfF_key"
+/* Festival runs at its voice's own rate; cached under this speed */
+#define FESTIVAL_SPEED 1.0f
+
+/* Run on each new connection, one command at a time: raw 16-bit
+ * waveforms at the pipeline's rate, and hampod_say, which synthesizes one
+ * phrase and sends it back */
+static const char *const festival_setup[] = {
+    "(Parameter.set 'Wavefiletype 'raw)\n",
+    "(define (hampod_say text)\n"
+    "  (let ((utt (utt.synth (eval (list 'Utterance 'Text text)))))\n"
+    "    (utt.wave.resample utt 16000)\n"
+    "    (utt.send.wave.client utt)\n"
+    "    t))\n",
+};
+#define FESTIVAL_SETUP_COUNT (sizeof(festival_setup) / sizeof(*festival_setup))
+
+/* A connection to the server, with its read buffer */
+typedef struct {
+  int fd; /* -1 while closed */
+  unsigned char buf[4096];
+  size_t pos;
+  size_t len;
+  pthread_mutex_t lock;
+} FestivalConn;
+
+/* A waveform being received; samples come from hal_tts_cache_buffer() */
+typedef struct {
+  int16_t *samples;
+  size_t capacity; /* In samples */
+  size_t bytes;
+} FestivalWave;
 
 static int initialized = 0;
+static int use_server = 0;      /* 0: text2wave per request */
+static int caching = 0;         /* Festival is the primary engine */
+static int server_port = FESTIVAL_PORT;
+static pid_t server_pid = -1;   /* Only a server we started */
+static const char *festival_voice = NULL; /* HAMPOD_FESTIVAL_VOICE */
+static char cache_voice[128];
+static volatile int tts_interrupted = 0;
+
+static FestivalConn speech_conn = {-1, {0}, 0, 0, PTHREAD_MUTEX_INITIALIZER};
+static FestivalConn warm_conn = {-1, {0}, 0, 0, PTHREAD_MUTEX_INITIALIZER};
+
+static long long now_ms(void) {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (long long)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+/* ============================================================================
+ * Server and connections
+ * ============================================================================
+ */
+
+/**
+ * @brief Connect to the server
+ * @return The socket, or -1 if nothing is listening
+ */
+static int connect_server(void) {
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons((uint16_t)server_port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/**
+ * @brief Check if the server we started is still running
+ */
+static int is_server_running(void) {
+  if (server_pid <= 0) {
+    return 0;
+  }
+  int status;
+  if (waitpid(server_pid, &status, WNOHANG) == 0) {
+    return 1;
+  }
+  server_pid = -1;
+  return 0;
+}
+
+/**
+ * @brief Start festival --server unless one is already listening
+ * @return 0 once the server takes connections, -1 if it cannot be started
+ */
+static int start_server(void) {
+  int fd = connect_server();
+  if (fd >= 0) {
+    close(fd);
+    if (server_pid <= 0) {
+      printf("HAL TTS: Using the Festival server on port %d\n", server_port);
+    }
+    return 0;
+  }
+
+  char port_command[48];
+  snprintf(port_command, sizeof(port_command), "(set! server_port %d)",
+           server_port);
+
+  server_pid = fork();
+  if (server_pid < 0) {
+    perror("HAL TTS: fork() failed");
+    return -1;
+  }
+  if (server_pid == 0) {
+    /* ===== CHILD PROCESS ===== */
+    /* Nothing of the firmware's (USB devices, sockets) stays open */
+    int max_fd = sysconf(_SC_OPEN_MAX);
+    if (max_fd < 0)
+      max_fd = 1024; /* Fallback */
+    for (int fd = 3; fd < max_fd; fd++) {
+      close(fd);
+    }
+    /* Festival logs every client; the firmware's log does not want it */
+    int null_fd = open("/dev/null", O_RDWR);
+    if (null_fd >= 0) {
+      dup2(null_fd, STDIN_FILENO);
+      dup2(null_fd, STDOUT_FILENO);
+      dup2(null_fd, STDERR_FILENO);
+      close(null_fd);
+    }
+    execlp("festival", "festival", port_command, "--server", NULL);
+    _exit(127);
+  }
+
+  /* ===== PARENT PROCESS ===== */
+  long long deadline = now_ms() + FESTIVAL_START_TIMEOUT_MS;
+  while (now_ms() < deadline) {
+    if (!is_server_running()) {
+      fprintf(stderr, "HAL TTS: Festival server exited on start-up\n");
+      return -1;
+    }
+    fd = connect_server();
+    if (fd >= 0) {
+      close(fd);
+      printf("HAL TTS: Started Festival server (pid=%d, port %d)\n",
+             server_pid, server_port);
+      return 0;
+    }
+    usleep(50000);
+  }
+  fprintf(stderr, "HAL TTS: Festival server did not start listening\n");
+  kill(server_pid, SIGTERM);
+  waitpid(server_pid, NULL, 0);
+  server_pid = -1;
+  return -1;
+}
+
+/**
+ * @brief Stop the server, if we started it
+ */
+static void stop_server(void) {
+  if (server_pid > 0) {
+    kill(server_pid, SIGTERM);
+    int status;
+    waitpid(server_pid, &status, 0);
+    printf("HAL TTS: Stopped Festival server (pid=%d, status=%d)\n",
+           server_pid, WEXITSTATUS(status));
+    server_pid = -1;
+  }
+}
+
+static void close_conn(FestivalConn *c) {
+  if (c->fd >= 0) {
+    close(c->fd);
+    c->fd = -1;
+  }
+  c->pos = 0;
+  c->len = 0;
+}
+
+static int send_all(FestivalConn *c, const char *data, size_t len) {
+  while (len > 0) {
+    ssize_t n = send(c->fd, data, len, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return -1;
+    }
+    data += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+/**
+ * @brief Read one byte of a reply
+ *
+ * @param interrupt Flag that abandons the wait when set, or NULL
+ * @return The byte, -1 on error, EOF or timeout, -2 if interrupted
+ */
+static int read_byte(FestivalConn *c, volatile int *interrupt) {
+  if (c->pos < c->len) {
+    return c->buf[c->pos++];
+  }
+  long long deadline = now_ms() + FESTIVAL_REPLY_TIMEOUT_MS;
+  for (;;) {
+    if (interrupt != NULL && *interrupt) {
+      return -2;
+    }
+    struct pollfd pfd = {c->fd, POLLIN, 0};
+    int ready = poll(&pfd, 1, FESTIVAL_POLL_MS);
+    if (ready < 0 && errno != EINTR) {
+      return -1;
+    }
+    if (ready > 0) {
+      ssize_t n = read(c->fd, c->buf, sizeof(c->buf));
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        return -1;
+      }
+      c->pos = 1;
+      c->len = (size_t)n;
+      return c->buf[0];
+    }
+    if (now_ms() >= deadline) {
+      fprintf(stderr, "HAL TTS: No reply from the Festival server\n");
+      return -1;
+    }
+  }
+}
 
-int hal_tts_init(void) {
+/* Append a byte of a waveform, growing the buffer for good if need be */
+static int wave_put(FestivalWave *wave, unsigned char byte) {
+  if (wave->bytes >= wave->capacity * sizeof(int16_t)) {
+    size_t new_capacity = wave->capacity * 2;
+    int16_t *grown = (int16_t *)hampod_realloc(
+        ALLOC_TTS_CAPTURE, wave->samples, new_capacity * sizeof(int16_t));
+    if (grown == NULL) {
+      return -1;
+    }
+    wave->samples = grown;
+    wave->capacity = new_capacity;
+  }
+  ((unsigned char *)wave->samples)[wave->bytes++] = byte;
+  return 0;
+}
+
+/**
+ * @brief Read one block of a reply, up to and without its end key
+ *
+ * @param wave Where the data goes, or NULL to skip it
+ * @return 0 on success, -1 on failure, -2 if interrupted
+ */
+static int read_block(FestivalConn *c, FestivalWave *wave,
+                      volatile int *interrupt) {
+  static const char key[] = FESTIVAL_STUFF_KEY;
+  size_t matched = 0;
+  while (key[matched] != '\0') {
+    int byte = read_byte(c, interrupt);
+    if (byte < 0) {
+      return byte;
+    }
+    if (byte == key[matched]) {
+      matched++;
+      continue;
+    }
+    /* Not the key after all: the part that matched is data. After all but
+     * the key's last character, an 'X' is the stuffing and is dropped. */
+    int stuffed = byte == 'X' && key[matched + 1] == '\0';
+    for (size_t i = 0; i < matched; i++) {
+      if (wave != NULL && wave_put(wave, (unsigned char)key[i]) != 0) {
+        return -1;
+      }
+    }
+    matched = 0;
+    if (!stuffed && byte == key[0]) {
+      matched = 1;
+    } else if (!stuffed && wave != NULL &&
+               wave_put(wave, (unsigned char)byte) != 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Read the reply to a command up to its "OK" or "ER"
+ *
+ * @param wave Receives the waveform, if the reply has one, or NULL
+ * @return 0 on "OK", -1 on "ER" or failure, -2 if interrupted
+ */
+static int read_reply(FestivalConn *c, FestivalWave *wave,
+                      volatile int *interrupt) {
+  for (;;) {
+    char ack[3];
+    for (int i = 0; i < 3; i++) {
+      int byte = read_byte(c, interrupt);
+      if (byte < 0) {
+        return byte;
+      }
+      ack[i] = (char)byte;
+    }
+    if (memcmp(ack, "OK\n", 3) == 0) {
+      return 0;
+    }
+    if (memcmp(ack, "ER\n", 3) == 0) {
+      return -1;
+    }
+    int result;
+    if (memcmp(ack, "WV\n", 3) == 0) {
+      result = read_block(c, wave, interrupt);
+    } else if (memcmp(ack, "LP\n", 3) == 0) {
+      result = read_block(c, NULL, interrupt); /* Command results */
+    } else {
+      fprintf(stderr, "HAL TTS: Festival server reply not understood\n");
+      return -1;
+    }
+    if (result != 0) {
+      return result;
+    }
+  }
+}
+
+/**
+ * @brief Send a command and read its reply
+ * @return As read_reply()
+ */
+static int run_command(FestivalConn *c, const char *command, FestivalWave *wave,
+                       volatile int *interrupt) {
+  if (send_all(c, command, strlen(command)) != 0) {
+    return -1;
+  }
+  return read_reply(c, wave, interrupt);
+}
+
+/**
+ * @brief Open a connection unless it is open, starting the server again if
+ *        it has died
+ *
+ * Call with the connection's lock held.
+ *
+ * @return 0 on success, -1 if the server cannot be reached
+ */
+static int ensure_conn(FestivalConn *c) {
+  if (c->fd >= 0) {
+    return 0;
+  }
+  c->fd = connect_server();
+  if (c->fd < 0) {
+    printf("HAL TTS: Festival server gone, restarting...\n");
+    if (server_pid > 0 && !is_server_running()) {
+      hal_tts_note_crash(0);
+      server_pid = -1;
+    }
+    if (start_server() != 0 || (c->fd = connect_server()) < 0) {
+      fprintf(stderr, "HAL TTS: Failed to reach the Festival server\n");
+      return -1;
+    }
+  }
+  c->pos = 0;
+  c->len = 0;
+
+  char voice_command[96];
+  if (festival_voice != NULL) {
+    snprintf(voice_command, sizeof(voice_command), "(voice_%s)\n",
+             festival_voice);
+    if (run_command(c, voice_command, NULL, NULL) != 0) {
+      fprintf(stderr, "HAL TTS: Festival has no voice %s\n", festival_voice);
+    }
+  }
+  for (size_t i = 0; i < FESTIVAL_SETUP_COUNT; i++) {
+    if (run_command(c, festival_setup[i], NULL, NULL) != 0) {
+      fprintf(stderr, "HAL TTS: Festival server setup failed\n");
+      close_conn(c);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Synthesize one phrase over a connection
+ *
+ * @param wave Filled with the waveform; samples is NULL on failure
+ * @return 0 on success, -1 on failure, -2 if interrupted
+ */
+static int synthesize(FestivalConn *c, const char *text, FestivalWave *wave,
+                      volatile int *interrupt) {
+  /* (hampod_say "text"), with quotes and backslashes escaped */
+  char command[2 * HAL_TTS_PHRASE_MAX + 32];
+  size_t len = 0;
+  len += (size_t)sprintf(command, "(hampod_say \"");
+  for (const char *p = text; *p != '\0' && len < sizeof(command) - 8; p++) {
+    if (*p == '"' || *p == '\\') {
+      command[len++] = '\\';
+    }
+    command[len++] = *p;
+  }
+  memcpy(command + len, "\")\n", 4);
+
+  wave->samples = hal_tts_cache_buffer(&wave->capacity);
+  wave->bytes = 0;
+  if (wave->samples == NULL) {
+    return -1;
+  }
+
+  pthread_mutex_lock(&c->lock);
+  int result = ensure_conn(c) == 0 ? run_command(c, command, wave, interrupt)
+                                   : -1;
+  if (result != 0) {
+    /* Whatever is left of the reply would be read as the next one's */
+    close_conn(c);
+  }
+  pthread_mutex_unlock(&c->lock);
+
+  if (result != 0) {
+    hal_tts_cache_recycle(wave->samples, wave->capacity);
+    wave->samples = NULL;
+  }
+  return result;
+}
+
+/* ============================================================================
+ * Speech
+ * ============================================================================
+ */
+
+/**
+ * @brief Speak one phrase from the cache, or else through the server
+ *
+ * @param start_time When the announcement was requested (ms)
+ * @param heard Set once the announcement's first audio is out
+ * @return 0 on success, 1 if interrupted, -1 on failure
+ */
+static int speak_phrase(const char *text, long long start_time, int *heard) {
+  const int16_t *cached = NULL;
+  size_t num_samples = 0;
+  if (caching && hal_tts_cache_lookup(text, FESTIVAL_SPEED, &cached,
+                                      &num_samples) == 0) {
+    hampod_trace(TRACE_TTS_CACHE_HIT, (uint32_t)num_samples, 0, 0);
+    if (!*heard) {
+      hal_tts_note_first_audio(1, now_ms() - start_time);
+      *heard = 1;
+    }
+    hal_tts_note_utterance(cached, num_samples);
+    if (hal_audio_queue_shared(cached, num_samples, hal_tts_cache_release) ==
+        0) {
+      return 0;
+    }
+    int result = hal_audio_write_raw(cached, num_samples);
+    hal_tts_cache_release(cached);
+    return result;
+  }
+
+  long long start = now_ms();
+  FestivalWave wave;
+  int result = synthesize(&speech_conn, text, &wave, &tts_interrupted);
+  if (result == -2) {
+    hampod_trace(TRACE_TTS_INTERRUPTED, 0, 0, 0);
+    return 1;
+  }
+  if (result != 0) {
+    return -1;
+  }
+
+  long long elapsed = now_ms() - start;
+  num_samples = wave.bytes / sizeof(int16_t);
+  hampod_trace(TRACE_TTS_SYNTHESIZED, (uint32_t)num_samples,
+               (uint32_t)elapsed, 0);
+  hal_tts_thermal_note(elapsed, num_samples);
+  if (!*heard) {
+    hal_tts_note_first_audio(0, now_ms() - start_time);
+    *heard = 1;
+  }
+
+  /* Queued as one segment, so the server starts on the next phrase while
+   * this one plays; written through the ring if the queue is full */
+  if (num_samples > 0 &&
+      hal_audio_queue_samples(wave.samples, num_samples) != 0 &&
+      hal_audio_write_raw(wave.samples, num_samples) != 0) {
+    fprintf(stderr, "HAL TTS: Audio write failed\n");
+  }
+  hal_tts_note_utterance(wave.samples, num_samples);
+  if (caching && num_samples > 0 &&
+      hal_tts_cache_store_owned(text, FESTIVAL_SPEED, wave.samples,
+                                num_samples, wave.capacity) == 0) {
+    hampod_trace(TRACE_TTS_CACHED, (uint32_t)num_samples, 0, 0);
+  } else if (!caching || num_samples == 0) {
+    hal_tts_cache_recycle(wave.samples, wave.capacity);
+  }
+  return 0;
+}
+
+/**
+ * @brief Speak text with text2wave, as before the server was used
+ */
+static int speak_text2wave(const char *text, const char *output_file) {
+  char command[1024];
+  const char *out = output_file ? output_file : "/tmp/hampod_speak.wav";
+
+  /* Generate speech with text2wave */
+  snprintf(command, sizeof(command),
+           "echo '%s' | text2wave -o '%s' 2>/dev/null", text, out);
+
+  long long start = now_ms();
+  int result = system(command);
+  if (result != 0) {
+    fprintf(stderr, "HAL TTS: text2wave failed\n");
+    return -1;
+  }
+
+  /* Play the generated file; it starts once the whole text is synthesized */
+  hal_tts_note_first_audio(0, now_ms() - start);
+  return hal_audio_play_file(out);
+}
+
+static int tts_init(void) {
   if (initialized)
     return 0;
 
@@ -29,43 +591,170 @@ int hal_tts_init(void) {
     return -1;
   }
 
-  printf("HAL TTS: Festival initialized\n");
+  const char *port = getenv("HAMPOD_FESTIVAL_PORT");
+  if (port != NULL && atoi(port) > 0 && atoi(port) < 65536) {
+    server_port = atoi(port);
+  }
+  festival_voice = getenv("HAMPOD_FESTIVAL_VOICE");
+  if (festival_voice != NULL && festival_voice[0] == '\0') {
+    festival_voice = NULL;
+  }
+
+  long long start = now_ms();
+  use_server = start_server() == 0;
+  if (!use_server) {
+    fprintf(stderr, "HAL TTS: No Festival server, using text2wave\n");
+  }
+
+  /* The cache holds one voice, so a fallback Festival leaves it to the
+   * primary engine's */
+  caching = use_server && hal_tts_is_primary(&hal_tts_festival_backend);
+  if (caching) {
+    snprintf(cache_voice, sizeof(cache_voice), "festival-%s",
+             festival_voice != NULL ? festival_voice : "default");
+    hal_tts_cache_set_voice(cache_voice);
+    hal_tts_cache_init();
+  }
+  if (use_server) {
+    hal_tts_note_init_times(now_ms() - start, 0);
+  }
+
+  printf("HAL TTS: Festival initialized (%s%s)\n",
+         use_server ? "server" : "text2wave",
+         caching ? ", cached" : "");
   initialized = 1;
   return 0;
 }
 
-int hal_tts_speak(const char *text, const char *output_file) {
+static int tts_speak(const char *text, const char *output_file) {
   if (!initialized) {
     fprintf(stderr, "HAL TTS: Not initialized\n");
     return -1;
   }
+  if (!use_server) {
+    return speak_text2wave(text, output_file);
+  }
 
-  char command[1024];
-  const char *out = output_file ? output_file : "/tmp/hampod_speak.wav";
+  /* As in the Piper backends, audio_interrupted is left for the firmware
+   * to clear */
+  tts_interrupted = 0;
+  if (!hal_audio_pipeline_ready()) {
+    fprintf(stderr, "HAL TTS: Audio pipeline not ready\n");
+    return -1;
+  }
 
-  /* Generate speech with text2wave */
-  snprintf(command, sizeof(command),
-           "echo '%s' | text2wave -o '%s' 2>/dev/null", text, out);
+  /* One phrase at a time (see hal_tts_phrase.h): the first plays while the
+   * server synthesizes the next */
+  long long start_time = now_ms();
+  char phrase[HAL_TTS_PHRASE_MAX + 1];
+  const char *start;
+  size_t len;
+  int heard = 0;
+  int result = 0;
+  while (result == 0 &&
+         (start = hal_tts_next_phrase(text, &len, &text)) != NULL) {
+    memcpy(phrase, start, len);
+    phrase[len] = '\0';
+    result = speak_phrase(phrase, start_time, &heard);
+  }
+  return result < 0 ? -1 : 0;
+}
 
-  int result = system(command);
-  if (result != 0) {
-    fprintf(stderr, "HAL TTS: text2wave failed\n");
+/**
+ * @brief Cache one phrase unless it already is
+ * @return 0 once it is cached, -1 on failure
+ */
+static int warm_phrase(const char *text) {
+  if (hal_tts_cache_contains(text, FESTIVAL_SPEED)) {
+    return 0;
+  }
+  FestivalWave wave;
+  if (synthesize(&warm_conn, text, &wave, NULL) != 0) {
     return -1;
   }
+  size_t num_samples = wave.bytes / sizeof(int16_t);
+  /* Written before returning, so the phrase is cached once this is */
+  int result = num_samples > 0 ? hal_tts_cache_store(text, FESTIVAL_SPEED,
+                                                     wave.samples, num_samples)
+                               : -1;
+  hal_tts_cache_recycle(wave.samples, wave.capacity);
+  if (result == 0) {
+    printf("HAL TTS: Warmed \"%s\" (%zu samples)\n", text, num_samples);
+  }
+  return result;
+}
 
-  /* Play the generated file */
-  return hal_audio_play_file(out);
+static int tts_warm(const char *text) {
+  if (!initialized || !caching || text == NULL ||
+      text[strspn(text, " \t\r\n")] == '\0') {
+    return -1;
+  }
+
+  /* Cached phrase by phrase, as tts_speak() looks it up */
+  char phrase[HAL_TTS_PHRASE_MAX + 1];
+  const char *start;
+  size_t len;
+  int result = 0;
+  while (result == 0 &&
+         (start = hal_tts_next_phrase(text, &len, &text)) != NULL) {
+    memcpy(phrase, start, len);
+    phrase[len] = '\0';
+    result = warm_phrase(phrase);
+  }
+  return result;
 }
 
-void hal_tts_interrupt(void) {
-  /* Festival doesn't use a persistent process, but we can signal
-   * hal_audio to stop playing the generated file. */
+static void tts_interrupt(void) {
+  /* The phrase being received is dropped with its connection (see the
+   * file comment); hal_audio stops what is queued or playing */
+  tts_interrupted = 1;
   hal_audio_interrupt();
 }
 
-void hal_tts_cleanup(void) {
+/* Only a server we started is killed; speech on it fails, and the next
+ * connection starts another */
+static void tts_restart(void) {
+  pid_t pid = server_pid;
+  if (pid > 0) {
+    printf("HAL TTS: Killing the Festival server (pid=%d)\n", pid);
+    kill(pid, SIGKILL);
+  }
+}
+
+static void tts_cleanup(void) {
+  pthread_mutex_lock(&speech_conn.lock);
+  close_conn(&speech_conn);
+  pthread_mutex_unlock(&speech_conn.lock);
+  pthread_mutex_lock(&warm_conn.lock);
+  close_conn(&warm_conn);
+  pthread_mutex_unlock(&warm_conn.lock);
+  stop_server();
+  if (caching) {
+    hal_tts_cache_cleanup();
+  }
+  caching = 0;
+  use_server = 0;
   initialized = 0;
   printf("HAL TTS: Festival cleaned up\n");
 }
 
-const char *hal_tts_get_impl_name(void) { return "Festival"; }
+static const char *tts_impl_name(void) {
+  return use_server ? "Festival (Server)" : "Festival";
+}
+
+static int tts_cached(const char *text) {
+  return caching && hal_tts_cache_contains(text, FESTIVAL_SPEED);
+}
+
+/* Festival runs at its voice's own speed, wherever the server lands */
+const HalTtsBackend hal_tts_festival_backend = {
+    .name = "festival",
+    .init = tts_init,
+    .speak = tts_speak,
+    .warm = tts_warm,
+    .interrupt = tts_interrupt,
+    .cleanup = tts_cleanup,
+    .impl_name = tts_impl_name,
+    .cached = tts_cached,
+    .restart = tts_restart,
+};
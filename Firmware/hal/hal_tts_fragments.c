@@ -0,0 +1,390 @@
+/**
+ * @file hal_tts_fragments.c
+ * @brief Word-at-a-time announcements, and the background pass that
+ * synthesizes their vocabulary and the prewarm manifest, and readouts
+ * synthesized ahead of being asked for
+ */
+
+#include "hal_tts_fragments.h"
+#include "hal_tts.h"
+#include "hal_tts_cache.h"
+#include "hal_tts_normalize.h"
+#include <ctype.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define FRAGMENT_WORD_MAX 64
+/* Quiet time before the background pass synthesizes its next entry */
+#define FRAGMENT_IDLE_MS 500
+
+#define PREWARM_ENV "HAMPOD_TTS_PREWARM"
+#define PREWARM_DEFAULT "tts_prewarm.txt" /* In Firmware's directory */
+#define PREWARM_MAX 512                   /* Prompts kept from it */
+
+/* Whole megahertz of the amateur bands a read-back can start with, for
+ * cache packs: 160 m to 6 m, 2 m, 1.25 m and 70 cm */
+static const int band_mhz[][2] = {{1, 54}, {144, 148}, {219, 225},
+                                  {420, 450}};
+#define BAND_RANGES (sizeof(band_mhz) / sizeof(band_mhz[0]))
+#define BAND_NUMBERS_MAX 128
+
+/* Words the number, unit, mode and meter readouts are made of */
+static const char *const vocabulary[] = {
+    "0",  "1",  "2",  "3",  "4",  "5",  "6",  "7",  "8",  "9",
+    "10", "14", "18", "21", "24", "28", "50", "point",
+    "megahertz", "kilohertz", "hertz",
+    "S0", "S1", "S2", "S3", "S4", "S5", "S6", "S7", "S8", "S9",
+    "plus", "minus", "dB", "watts", "off", "on",
+    "USB", "LSB", "CW", "AM", "FM", "RTTY",
+};
+#define VOCABULARY_SIZE (sizeof(vocabulary) / sizeof(vocabulary[0]))
+
+/* Words characters are spelled with (hal_tts_spell_word()): letter names,
+ * the NATO phonetic alphabet, then the punctuation of callsigns and
+ * keypad entries. Digits and "point" come from the vocabulary. */
+static const char *const spelling[] = {
+    "A", "B", "C", "D", "E", "F", "G", "H", "I", "J", "K", "L", "M",
+    "N", "O", "P", "Q", "R", "S", "T", "U", "V", "W", "X", "Y", "Z",
+    "Alfa", "Bravo", "Charlie", "Delta", "Echo", "Foxtrot", "Golf",
+    "Hotel", "India", "Juliett", "Kilo", "Lima", "Mike", "November",
+    "Oscar", "Papa", "Quebec", "Romeo", "Sierra", "Tango", "Uniform",
+    "Victor", "Whiskey", "X-ray", "Yankee", "Zulu",
+    "stroke", "dash", "star", "pound",
+};
+#define SPELLING_SIZE (sizeof(spelling) / sizeof(spelling[0]))
+#define SPELL_PHONETIC 26    /* Index of "Alfa" */
+#define SPELL_PUNCTUATION 52 /* Index of "stroke" */
+#define WORDS_SIZE (VOCABULARY_SIZE + SPELLING_SIZE)
+
+/* Prompts from the prewarm manifest, read once on the first prime (before
+ * the audio process changes directory) and kept until cleanup */
+static char *prompts[PREWARM_MAX];
+static size_t prompt_count = 0;
+static int prompts_loaded = 0;
+
+static volatile int fragments_interrupted = 0;
+static volatile int speech_active = 0;
+static volatile long long speech_ended_ms = 0;
+
+/* Background pass, guarded by prime_lock */
+static pthread_mutex_t prime_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t prime_thread;
+static int prime_started = 0; /* prime_thread exists and is not joined */
+static int prime_running = 0;
+static int prime_again = 0; /* Speed changed mid-pass: start over */
+static int prime_stop = 0;
+
+/* Anticipated readout (hal_tts_fragments_anticipate()), guarded by
+ * anticipate_lock */
+#define ANTICIPATE_MAX 256
+static pthread_mutex_t anticipate_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t anticipate_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t anticipate_thread;
+static int anticipate_started = 0;
+static int anticipate_stop = 0;
+static char anticipate_words[ANTICIPATE_MAX]; /* Not yet taken up */
+static int anticipate_pending = 0;
+
+int hal_tts_speak_fragments(const char *words) {
+  char word[FRAGMENT_WORD_MAX];
+  int result = 0;
+  fragments_interrupted = 0;
+  while (!fragments_interrupted) {
+    words += strspn(words, " ");
+    size_t len = strcspn(words, " ");
+    if (len == 0) {
+      break;
+    }
+    /* Cut to the buffer; a word that long would not repeat anyway */
+    memcpy(word, words, len < sizeof(word) ? len : sizeof(word) - 1);
+    word[len < sizeof(word) ? len : sizeof(word) - 1] = '\0';
+    words += len;
+    if (hal_tts_speak(word, NULL) != 0) {
+      result = -1;
+    }
+  }
+  return result;
+}
+
+const char *hal_tts_spell_word(char c, int phonetic) {
+  if (isdigit((unsigned char)c)) {
+    return vocabulary[c - '0'];
+  }
+  if (isalpha((unsigned char)c)) {
+    return spelling[(phonetic ? SPELL_PHONETIC : 0) +
+                    toupper((unsigned char)c) - 'A'];
+  }
+  switch (c) {
+  case '.':
+    return "point";
+  case '/':
+    return spelling[SPELL_PUNCTUATION];
+  case '-':
+    return spelling[SPELL_PUNCTUATION + 1];
+  case '*':
+    return spelling[SPELL_PUNCTUATION + 2];
+  case '#':
+    return spelling[SPELL_PUNCTUATION + 3];
+  default:
+    return NULL;
+  }
+}
+
+void hal_tts_fragments_interrupt(void) { fragments_interrupted = 1; }
+
+static long long now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void hal_tts_fragments_note_speech(int active) {
+  if (active) {
+    speech_active++;
+  } else if (speech_active > 0) {
+    speech_active--;
+    speech_ended_ms = now_ms();
+  }
+}
+
+/* Wait until nothing has been spoken for FRAGMENT_IDLE_MS; 0 once quiet,
+ * -1 if the pass is stopped or restarted meanwhile. Called without the
+ * lock. */
+static int wait_for_quiet(void) {
+  for (;;) {
+    pthread_mutex_lock(&prime_lock);
+    int cancelled = prime_stop || prime_again;
+    pthread_mutex_unlock(&prime_lock);
+    if (cancelled) {
+      return -1;
+    }
+    if (!speech_active && now_ms() - speech_ended_ms >= FRAGMENT_IDLE_MS) {
+      return 0;
+    }
+    usleep(50000);
+  }
+}
+
+/* Read the prewarm manifest: one prompt per line, blank lines and lines
+ * starting with '#' skipped. Missing is fine; "0" turns it off. */
+static void load_prompts(void) {
+  const char *path = getenv(PREWARM_ENV);
+  if (path == NULL || path[0] == '\0') {
+    path = PREWARM_DEFAULT;
+  }
+  FILE *f = strcmp(path, "0") != 0 ? fopen(path, "r") : NULL;
+  char line[256];
+  char canonical[HAL_TTS_NORMALIZE_MAX];
+  while (f != NULL && prompt_count < PREWARM_MAX &&
+         fgets(line, sizeof(line), f) != NULL) {
+    line[strcspn(line, "\r\n")] = '\0';
+    if (line[0] != '\0' && line[0] != '#') {
+      /* As it is cached, for cache packs */
+      prompts[prompt_count] =
+          strdup(hal_tts_normalize(line, canonical, sizeof(canonical)));
+      prompt_count += prompts[prompt_count] != NULL;
+    }
+  }
+  if (f != NULL) {
+    fclose(f);
+  }
+  prompts_loaded = 1;
+}
+
+static void *prime_thread_func(void *arg) {
+  (void)arg;
+  size_t next = 0;
+  size_t ready = 0;
+  size_t words_ready = 0;
+  size_t total = WORDS_SIZE + prompt_count;
+  speech_ended_ms = now_ms(); /* Let start-up speech go first */
+  pthread_mutex_lock(&prime_lock);
+  while (next < total && !prime_stop) {
+    if (prime_again) {
+      prime_again = 0;
+      next = 0;
+      ready = 0;
+    }
+    /* The vocabulary first: readouts use it most */
+    const char *text = next < VOCABULARY_SIZE ? vocabulary[next]
+                       : next < WORDS_SIZE    ? spelling[next - VOCABULARY_SIZE]
+                                              : prompts[next - WORDS_SIZE];
+    pthread_mutex_unlock(&prime_lock);
+    if (wait_for_quiet() == 0) {
+      /* An entry already cached at this speed costs a lookup */
+      if (hal_tts_warm(text) == 0) {
+        ready++;
+      }
+      next++;
+      if (next == WORDS_SIZE) {
+        words_ready = ready;
+      }
+    }
+    pthread_mutex_lock(&prime_lock);
+  }
+  int finished = next == total;
+  prime_running = 0;
+  pthread_mutex_unlock(&prime_lock);
+  if (finished) {
+    printf("HAL TTS: %zu of %zu announcement words and %zu of %zu prompts "
+           "ready\n",
+           words_ready, WORDS_SIZE, ready - words_ready, prompt_count);
+  }
+  return NULL;
+}
+
+void hal_tts_fragments_prime(void) {
+  pthread_mutex_lock(&prime_lock);
+  if (!prompts_loaded) {
+    load_prompts();
+  }
+  if (prime_running) {
+    prime_again = 1;
+  } else if (!prime_stop) {
+    if (prime_started) {
+      pthread_join(prime_thread, NULL); /* Finished its last pass */
+      prime_started = 0;
+    }
+    if (pthread_create(&prime_thread, NULL, prime_thread_func, NULL) == 0) {
+      prime_started = 1;
+      prime_running = 1;
+    } else {
+      fprintf(stderr, "HAL TTS: Cannot start announcement warm-up\n");
+    }
+  }
+  pthread_mutex_unlock(&prime_lock);
+}
+
+static void *anticipate_thread_func(void *arg) {
+  (void)arg;
+  char words[ANTICIPATE_MAX];
+  char word[FRAGMENT_WORD_MAX];
+  pthread_mutex_lock(&anticipate_lock);
+  while (!anticipate_stop) {
+    if (!anticipate_pending) {
+      pthread_cond_wait(&anticipate_cond, &anticipate_lock);
+      continue;
+    }
+    memcpy(words, anticipate_words, sizeof(words));
+    anticipate_pending = 0;
+
+    /* Word by word, giving up on these once newer ones come */
+    const char *next = words;
+    while (!anticipate_stop && !anticipate_pending) {
+      next += strspn(next, " ");
+      size_t len = strcspn(next, " ");
+      if (len == 0) {
+        break;
+      }
+      if (len >= sizeof(word)) {
+        len = sizeof(word) - 1;
+      }
+      memcpy(word, next, len);
+      word[len] = '\0';
+      next += strcspn(next, " ");
+      pthread_mutex_unlock(&anticipate_lock);
+      hal_tts_warm(word);
+      pthread_mutex_lock(&anticipate_lock);
+    }
+  }
+  pthread_mutex_unlock(&anticipate_lock);
+  return NULL;
+}
+
+void hal_tts_fragments_anticipate(const char *words) {
+  pthread_mutex_lock(&anticipate_lock);
+  if (!anticipate_started && !anticipate_stop) {
+    if (pthread_create(&anticipate_thread, NULL, anticipate_thread_func,
+                       NULL) == 0) {
+      anticipate_started = 1;
+    } else {
+      fprintf(stderr, "HAL TTS: Cannot start anticipation\n");
+    }
+  }
+  snprintf(anticipate_words, sizeof(anticipate_words), "%s", words);
+  anticipate_pending = 1;
+  pthread_cond_signal(&anticipate_cond);
+  pthread_mutex_unlock(&anticipate_lock);
+}
+
+static int in_vocabulary(const char *word) {
+  for (size_t i = 0; i < VOCABULARY_SIZE; i++) {
+    if (strcmp(vocabulary[i], word) == 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int hal_tts_fragments_build_pack(const char *path, float speed) {
+  hal_tts_fragments_cleanup(); /* Stops the background pass */
+  pthread_mutex_lock(&prime_lock);
+  load_prompts();
+  pthread_mutex_unlock(&prime_lock);
+
+  static char numbers[BAND_NUMBERS_MAX][4];
+  const char *texts[WORDS_SIZE + PREWARM_MAX + BAND_NUMBERS_MAX];
+  size_t count = 0;
+  for (size_t i = 0; i < WORDS_SIZE; i++) {
+    texts[count++] = i < VOCABULARY_SIZE ? vocabulary[i]
+                                         : spelling[i - VOCABULARY_SIZE];
+  }
+  for (size_t i = 0; i < prompt_count; i++) {
+    texts[count++] = prompts[i];
+  }
+  size_t band_count = 0;
+  for (size_t r = 0; r < BAND_RANGES; r++) {
+    for (int mhz = band_mhz[r][0];
+         mhz <= band_mhz[r][1] && band_count < BAND_NUMBERS_MAX; mhz++) {
+      snprintf(numbers[band_count], sizeof(numbers[0]), "%d", mhz);
+      if (!in_vocabulary(numbers[band_count])) {
+        texts[count++] = numbers[band_count++];
+      }
+    }
+  }
+
+  size_t ready = 0;
+  for (size_t i = 0; i < count; i++) {
+    ready += hal_tts_warm(texts[i]) == 0;
+  }
+  printf("HAL TTS: %zu of %zu pack entries synthesized\n", ready, count);
+  return hal_tts_cache_export(path, NULL, speed, texts, count);
+}
+
+void hal_tts_fragments_cleanup(void) {
+  pthread_mutex_lock(&anticipate_lock);
+  anticipate_stop = 1;
+  int anticipating = anticipate_started;
+  anticipate_started = 0;
+  pthread_cond_signal(&anticipate_cond);
+  pthread_mutex_unlock(&anticipate_lock);
+  if (anticipating) {
+    pthread_join(anticipate_thread, NULL);
+  }
+  pthread_mutex_lock(&anticipate_lock);
+  anticipate_stop = 0;
+  anticipate_pending = 0;
+  pthread_mutex_unlock(&anticipate_lock);
+
+  pthread_mutex_lock(&prime_lock);
+  prime_stop = 1;
+  int started = prime_started;
+  prime_started = 0;
+  pthread_mutex_unlock(&prime_lock);
+  if (started) {
+    pthread_join(prime_thread, NULL);
+  }
+  pthread_mutex_lock(&prime_lock);
+  prime_running = 0;
+  prime_again = 0;
+  prime_stop = 0;
+  while (prompt_count > 0) {
+    free(prompts[--prompt_count]);
+  }
+  prompts_loaded = 0;
+  pthread_mutex_unlock(&prime_lock);
+}
@@ -0,0 +1,102 @@
+#ifndef HAL_TTS_FRAGMENTS_H
+#define HAL_TTS_FRAGMENTS_H
+
+/**
+ * @file hal_tts_fragments.h
+ * @brief Announcements composed from separately cached words
+ *
+ * A readout like "14 point 2 5 0 0 0 megahertz" is rarely the same twice,
+ * so as a whole phrase it almost never hits the TTS cache. Spoken a word
+ * at a time, each word is a cache entry of its own in the current voice
+ * and speed, and the words play back to back on the audio segment queue.
+ * The common vocabulary (digits, units, modes, meter words) is synthesized
+ * in the background at start-up and after every speed change, so those
+ * readouts do not wait for the synthesizer at all. The same pass then
+ * synthesizes the fixed prompts listed in the prewarm manifest
+ * (HAMPOD_TTS_PREWARM, tts_prewarm.txt by default; generated from
+ * Software2's sources by Software2/gen_prewarm_manifest.sh), so a new unit
+ * answers from the cache from the first keypress. The background pass
+ * only synthesizes while nothing has been spoken for a moment, so it does
+ * not hold up speech when Piper runs a single process.
+ *
+ * The letters, the NATO phonetic alphabet and callsign punctuation are
+ * part of the vocabulary, so spelling (hal_tts_spell_word()) never waits
+ * for the synthesizer either.
+ */
+
+/**
+ * @brief Speak space-separated words one cache entry at a time
+ *
+ * Stops early after hal_tts_interrupt().
+ *
+ * @param words The words, e.g. "14 point 2 5 megahertz"
+ * @return 0 on success, -1 if a word failed
+ */
+int hal_tts_speak_fragments(const char *words);
+
+/**
+ * @brief (Re)synthesize the common vocabulary and prompts in the
+ * background
+ *
+ * Called by the TTS HAL once initialized and whenever the speed changes;
+ * a pass already running starts over.
+ */
+void hal_tts_fragments_prime(void);
+
+/**
+ * @brief Synthesize the words of a readout before it is asked for
+ *
+ * For a readout that can be guessed while the operator is still typing,
+ * such as the read-back of a frequency being entered: by the time it is
+ * spoken its words are in the cache. They are warmed one at a time on a
+ * thread of its own (hal_tts_warm()), without waiting for quiet, so this
+ * returns at once; words already cached cost a lookup. A newer call
+ * replaces words not yet reached. A guess that turns out wrong costs
+ * nothing but the synthesis: the real readout is synthesized as usual.
+ *
+ * @param words The words, e.g. "144 point 2 megahertz"
+ */
+void hal_tts_fragments_anticipate(const char *words);
+
+/**
+ * @brief Synthesize the background pass's vocabulary and prompts, and the
+ * whole megahertz of the amateur bands, into a cache pack
+ *
+ * For building a pack once on a fast machine (tts_pack), so units can be
+ * installed warm (hal_tts_cache_import()). The band numbers ("144",
+ * "432") are frequency read-backs that are otherwise synthesized on first
+ * use. Blocks until done. Stops the background pass first, since it would
+ * only be doing the same work.
+ *
+ * @param path The pack file
+ * @param speed The speed the engine is set to (hal_tts_set_speed())
+ * @return The number of entries written, or -1 on failure
+ */
+int hal_tts_fragments_build_pack(const char *path, float speed);
+
+/**
+ * @brief Tell the background pass that speech started (1) or ended (0)
+ */
+void hal_tts_fragments_note_speech(int active);
+
+/**
+ * @brief The word a character is spelled as
+ *
+ * @param c Character to spell
+ * @param phonetic Spell letters with the NATO phonetic alphabet
+ * @return A vocabulary word ("B", "Bravo", "7", "stroke"), or NULL for a
+ *         character that is not spelled (space, other punctuation)
+ */
+const char *hal_tts_spell_word(char c, int phonetic);
+
+/**
+ * @brief Stop hal_tts_speak_fragments() after the word being spoken
+ */
+void hal_tts_fragments_interrupt(void);
+
+/**
+ * @brief Stop the background pass and anticipation and wait for them
+ */
+void hal_tts_fragments_cleanup(void);
+
+#endif /* HAL_TTS_FRAGMENTS_H */
@@ -0,0 +1,503 @@
+/**
+ * @file hal_tts_libpiper.c
+ * @brief In-process Piper TTS implementation of the TTS HAL
+ *
+ * Links libpiper (Piper's C API over ONNX Runtime) instead of running the
+ * piper CLI: the voice is loaded once, each call passes its own
+ * length_scale, and PCM arrives sentence by sentence from
+ * piper_synthesize_next(), so the end of an utterance is known exactly and
+ * there are no pipes to copy through.
+ *
+ * Chunks are converted to the pipeline format with hal_audio_convert.h
+ * (libpiper produces float samples at the voice's rate) and written to
+ * the PCM ring, or queued as segments once the ring is full, so speak
+ * returns as soon as the last sentence is synthesized. Speech is cached
+ * through hal_tts_cache.h like the subprocess backend.
+ *
+ * Build with: make TTS_ENGINE=libpiper
+ */
+
+#define _GNU_SOURCE /* CPU_SET / sched_setaffinity */
+
+#include "hal_audio.h"
+#include "hal_audio_convert.h"
+#include "hal_tts_backend.h"
+#include "hal_tts_cache.h"
+#include "hal_tts_phrase.h"
+#include "hal_tts_thermal.h"
+#include "hal_tts_warmup.h"
+#include "../hampod_alloc.h"
+#include "../hampod_trace.h"
+#include <piper.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#ifndef PIPER_MODEL_PATH
+#define PIPER_MODEL_PATH "models/en_US-lessac-low.onnx"
+#endif
+
+/* eSpeak NG data libpiper phonemizes with; HAMPOD_ESPEAK_DATA overrides */
+#ifndef PIPER_ESPEAK_DATA_PATH
+#define PIPER_ESPEAK_DATA_PATH "/usr/share/espeak-ng-data"
+#endif
+#define PIPER_ESPEAK_DATA_ENV "HAMPOD_ESPEAK_DATA"
+
+/* Default speed - can be overridden by hal_tts_set_speed() */
+#ifndef PIPER_SPEED
+#define PIPER_SPEED "0.45"
+#endif
+
+static int initialized = 0;
+
+/* Cores for ONNX Runtime's threads (hal_tts_set_cpus()); -1 for any */
+static int tts_first_cpu = -1;
+static int tts_last_cpu = -1;
+static volatile int tts_interrupted = 0;
+
+/* One synthesizer, shared by speech and warming under synth_lock */
+static piper_synthesizer *synth = NULL;
+static pthread_mutex_t synth_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Conversion output for one chunk, grown as needed; under synth_lock */
+static int16_t *converted = NULL;
+static size_t converted_size = 0;
+
+/* Runtime length_scale, passed with each utterance; read unlocked by the
+ * cache lookups, which only pick an entry by it */
+static volatile float piper_length_scale = 0.0f;
+
+/* When the hal_tts_speak() being served started, and whether its first
+ * audio is out yet (hal_tts_note_first_audio()) */
+static long long speak_start = 0;
+static int speak_heard = 1;
+
+static long long now_ms(void) {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (long long)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+/**
+ * @brief Append samples to a growing capture buffer
+ *
+ * On out-of-memory the buffer is freed and capturing stops.
+ */
+static void capture_append(int16_t **buf, size_t *len, size_t *capacity,
+                           const int16_t *samples, size_t count) {
+  if (*buf == NULL) {
+    return;
+  }
+  if (*len + count > *capacity) {
+    size_t new_capacity = *capacity * 2;
+    while (new_capacity < *len + count) {
+      new_capacity *= 2;
+    }
+    int16_t *new_buf = hampod_realloc(ALLOC_TTS_CAPTURE, *buf,
+                                      new_capacity * sizeof(int16_t));
+    if (new_buf == NULL) {
+      hampod_free(*buf);
+      *buf = NULL; /* Stop capturing on out-of-memory */
+      return;
+    }
+    *buf = new_buf;
+    *capacity = new_capacity;
+  }
+  memcpy(*buf + *len, samples, count * sizeof(int16_t));
+  *len += count;
+}
+
+/**
+ * @brief Hand one converted chunk to the audio HAL without waiting
+ *
+ * Written to the ring while it has room, else queued as a segment (which
+ * plays in order with the ring); only a full segment queue waits.
+ *
+ * @return 0 on success, -1 on failure
+ */
+static int play_chunk(const int16_t *samples, size_t count) {
+  if (!speak_heard) {
+    hal_tts_note_first_audio(0, now_ms() - speak_start);
+    speak_heard = 1;
+  }
+  if (count <= hal_audio_ring_free() ||
+      hal_audio_queue_samples(samples, count) != 0) {
+    return hal_audio_write_raw(samples, count);
+  }
+  return 0;
+}
+
+/**
+ * @brief Synthesize text at a given speed, passing each converted chunk to
+ *        play_chunk() if play is set and collecting the whole utterance
+ *
+ * Call with synth_lock held.
+ *
+ * @param cancel Flag that stops synthesis between sentences, or NULL
+ * @param samples Receives the utterance in a buffer from
+ *        hal_tts_cache_buffer(), or NULL if it could not be kept
+ * @param buf_capacity Receives that buffer's size, in samples
+ * @return 0 on success, 1 if cancelled, -1 on failure
+ */
+static int synthesize(const char *text, float speed, int play,
+                      volatile int *cancel, int16_t **samples,
+                      size_t *num_samples, size_t *buf_capacity) {
+  piper_synthesize_options options = piper_default_synthesize_options(synth);
+  options.length_scale = speed;
+
+  *samples = NULL;
+  *num_samples = 0;
+  if (piper_synthesize_start(synth, text, &options) != PIPER_OK) {
+    fprintf(stderr, "HAL TTS: libpiper could not start \"%s\"\n", text);
+    return -1;
+  }
+
+  size_t capacity;
+  size_t len = 0;
+  int16_t *capture = hal_tts_cache_buffer(&capacity);
+  AudioConverter conv;
+  int conv_ready = 0;
+  int result = 0;
+
+  for (;;) {
+    if (cancel != NULL && *cancel) {
+      result = 1;
+      break;
+    }
+    piper_audio_chunk chunk;
+    int status = piper_synthesize_next(synth, &chunk);
+    if (status != PIPER_OK && status != PIPER_DONE) {
+      fprintf(stderr, "HAL TTS: libpiper synthesis failed (%d)\n", status);
+      result = -1;
+      break;
+    }
+
+    if (chunk.num_samples > 0) {
+      if (!conv_ready) {
+        WavFormat fmt = {WAV_ENCODING_FLOAT, 1, (uint32_t)chunk.sample_rate,
+                         32, 0};
+        if (hal_audio_converter_init(&conv, &fmt) != 0) {
+          result = -1;
+          break;
+        }
+        conv_ready = 1;
+      }
+      size_t max_out = hal_audio_converter_max_out(&conv, chunk.num_samples);
+      if (max_out > converted_size) {
+        /* Grow-only, kept between calls */
+        int16_t *grown = hampod_realloc(ALLOC_TTS_CAPTURE, converted,
+                                        max_out * sizeof(int16_t));
+        if (grown == NULL) {
+          result = -1;
+          break;
+        }
+        converted = grown;
+        converted_size = max_out;
+      }
+      long count = hal_audio_convert(&conv, (const uint8_t *)chunk.samples,
+                                     chunk.num_samples, converted);
+      if (count < 0) {
+        result = -1;
+        break;
+      }
+      if (play && play_chunk(converted, (size_t)count) != 0) {
+        fprintf(stderr, "HAL TTS: Audio write failed\n");
+        result = -1;
+        break;
+      }
+      capture_append(&capture, &len, &capacity, converted, (size_t)count);
+    }
+
+    if (status == PIPER_DONE || chunk.is_last) {
+      break;
+    }
+  }
+
+  if (conv_ready) {
+    hal_audio_converter_free(&conv);
+  }
+  if (result == 0 && capture != NULL && len > 0) {
+    *samples = capture;
+    *num_samples = len;
+    *buf_capacity = capacity;
+  } else {
+    hal_tts_cache_recycle(capture, capacity);
+  }
+  return result;
+}
+
+static int tts_init(void) {
+  if (initialized) {
+    return 0;
+  }
+
+  if (access(PIPER_MODEL_PATH, F_OK) != 0) {
+    fprintf(stderr, "\n");
+    fprintf(stderr, "===================================================\n");
+    fprintf(stderr, "ERROR: Piper voice model not found!\n");
+    fprintf(stderr, "Expected: %s\n", PIPER_MODEL_PATH);
+    fprintf(stderr, "===================================================\n");
+    fprintf(stderr, "To download the model, run:\n");
+    fprintf(stderr, "    ./Documentation/scripts/install_piper.sh\n");
+    fprintf(stderr, "===================================================\n");
+    return -1;
+  }
+
+  const char *espeak_data = getenv(PIPER_ESPEAK_DATA_ENV);
+  if (espeak_data == NULL) {
+    espeak_data = PIPER_ESPEAK_DATA_PATH;
+  }
+
+  long long start = now_ms();
+  hal_tts_cache_set_voice(PIPER_MODEL_PATH);
+  hal_tts_preload_model(PIPER_MODEL_PATH);
+  /* ONNX Runtime starts its thread pool here and the threads inherit
+   * this thread's affinity, so it is narrowed for the duration */
+  cpu_set_t saved;
+  int pinned = tts_first_cpu >= 0 &&
+               sched_getaffinity(0, sizeof(saved), &saved) == 0;
+  if (pinned) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (int cpu = tts_first_cpu; cpu <= tts_last_cpu; cpu++) {
+      CPU_SET(cpu, &cpus);
+    }
+    pinned = sched_setaffinity(0, sizeof(cpus), &cpus) == 0;
+  }
+  /* The voice config sits next to the model as <model>.json */
+  synth = piper_create(PIPER_MODEL_PATH, NULL, espeak_data);
+  if (pinned) {
+    sched_setaffinity(0, sizeof(saved), &saved);
+  }
+  if (synth == NULL) {
+    fprintf(stderr, "HAL TTS: libpiper could not load %s (espeak data %s)\n",
+            PIPER_MODEL_PATH, espeak_data);
+    return -1;
+  }
+  piper_length_scale = strtof(PIPER_SPEED, NULL);
+  long long loaded = now_ms();
+
+  /* Run the first, slow inference now rather than on the first
+   * announcement */
+  const char *warmup = hal_tts_warmup_text();
+  if (warmup != NULL) {
+    int16_t *samples;
+    size_t num_samples, capacity;
+    if (synthesize(warmup, piper_length_scale, 0, NULL, &samples,
+                   &num_samples, &capacity) == 0) {
+      hal_tts_cache_recycle(samples, capacity);
+    }
+  }
+
+  printf("HAL TTS: libpiper initialized (model=%s, speed=%s, warm-up %s "
+         "in %lld ms)\n",
+         PIPER_MODEL_PATH, PIPER_SPEED, warmup != NULL ? "done" : "skipped",
+         now_ms() - start);
+  hal_tts_note_init_times(loaded - start, now_ms() - loaded);
+  initialized = 1;
+  return 0;
+}
+
+/**
+ * @brief Speak one phrase from the cache, or else synthesize and cache it
+ * @return 0 on success, 1 if interrupted, -1 on failure
+ */
+static int speak_phrase(const char *text, float speed) {
+  const int16_t *cached = NULL;
+  size_t num_samples = 0;
+  if (hal_tts_cache_lookup(text, speed, &cached, &num_samples) == 0) {
+    hampod_trace(TRACE_TTS_CACHE_HIT, (uint32_t)num_samples, 0, 0);
+    if (!speak_heard) {
+      hal_tts_note_first_audio(1, now_ms() - speak_start);
+      speak_heard = 1;
+    }
+    hal_tts_note_utterance(cached, num_samples);
+    /* One segment played from the cache's buffer, so this returns at once;
+     * written through the ring if the segment queue is full */
+    if (hal_audio_queue_shared(cached, num_samples, hal_tts_cache_release) ==
+        0) {
+      return 0;
+    }
+    int result = hal_audio_write_raw(cached, num_samples);
+    hal_tts_cache_release(cached);
+    return result;
+  }
+
+  long long start = now_ms();
+  int16_t *samples = NULL;
+  size_t capacity;
+  pthread_mutex_lock(&synth_lock);
+  int result = synthesize(text, speed, 1, &tts_interrupted, &samples,
+                          &num_samples, &capacity);
+  pthread_mutex_unlock(&synth_lock);
+
+  if (result == 1) {
+    hampod_trace(TRACE_TTS_INTERRUPTED, 0, 0, 0);
+  } else if (result == 0) {
+    long long elapsed = now_ms() - start;
+    hampod_trace(TRACE_TTS_SYNTHESIZED, (uint32_t)num_samples,
+                 (uint32_t)elapsed, 0);
+    hal_tts_thermal_note(elapsed, num_samples);
+    hal_tts_note_utterance(samples, num_samples);
+    /* The capture buffer goes to the cache writer */
+    if (samples != NULL &&
+        hal_tts_cache_store_owned(text, speed, samples, num_samples,
+                                  capacity) == 0) {
+      hampod_trace(TRACE_TTS_CACHED, (uint32_t)num_samples, 0, 0);
+    }
+  }
+  return result;
+}
+
+static int tts_speak(const char *text, const char *output_file) {
+  (void)output_file; /* Ignored - we stream directly */
+
+  if (!initialized) {
+    if (tts_init() != 0) {
+      return -1;
+    }
+  }
+
+  /* Clear TTS interrupt flag for this new utterance; audio_interrupted is
+   * left for the firmware to clear, as in the subprocess backend */
+  tts_interrupted = 0;
+
+  if (!hal_audio_pipeline_ready()) {
+    fprintf(stderr, "HAL TTS: Audio pipeline not ready\n");
+    return -1;
+  }
+  speak_start = now_ms();
+  speak_heard = 0;
+
+  /* Phrase by phrase (see hal_tts_phrase.h), all at one speed */
+  float speed = piper_length_scale;
+  char phrase[HAL_TTS_PHRASE_MAX + 1];
+  const char *start;
+  size_t len;
+  int result = 0;
+  while (result == 0 &&
+         (start = hal_tts_next_phrase(text, &len, &text)) != NULL) {
+    memcpy(phrase, start, len);
+    phrase[len] = '\0';
+    result = speak_phrase(phrase, speed);
+  }
+  return result < 0 ? -1 : 0;
+}
+
+/**
+ * @brief Cache one phrase unless it already is
+ * @return 0 once it is cached, -1 on failure
+ */
+static int warm_phrase(const char *text, float speed) {
+  if (hal_tts_cache_contains(text, speed)) {
+    return 0;
+  }
+
+  int16_t *samples;
+  size_t num_samples;
+  size_t capacity;
+  pthread_mutex_lock(&synth_lock);
+  int result =
+      synthesize(text, speed, 0, NULL, &samples, &num_samples, &capacity);
+  pthread_mutex_unlock(&synth_lock);
+
+  if (result != 0 || samples == NULL) {
+    return -1;
+  }
+  /* Written before returning, so the phrase is cached once this is */
+  result = hal_tts_cache_store(text, speed, samples, num_samples);
+  hal_tts_cache_recycle(samples, capacity);
+  if (result == 0) {
+    printf("HAL TTS: Warmed \"%s\" (%zu samples)\n", text, num_samples);
+  }
+  return result;
+}
+
+static int tts_warm(const char *text) {
+  if (!initialized || text == NULL || text[strspn(text, " \t\r\n")] == '\0') {
+    return -1;
+  }
+
+  float speed = piper_length_scale;
+  char phrase[HAL_TTS_PHRASE_MAX + 1];
+  const char *start;
+  size_t len;
+  int result = 0;
+  while (result == 0 &&
+         (start = hal_tts_next_phrase(text, &len, &text)) != NULL) {
+    memcpy(phrase, start, len);
+    phrase[len] = '\0';
+    result = warm_phrase(phrase, speed);
+  }
+  return result;
+}
+
+static void tts_interrupt(void) {
+  /* Synthesis stops at the next sentence; what is queued is flushed */
+  tts_interrupted = 1;
+  hal_audio_interrupt();
+}
+
+static void tts_cleanup(void) {
+  pthread_mutex_lock(&synth_lock);
+  if (synth != NULL) {
+    piper_free(synth);
+    synth = NULL;
+  }
+  hampod_free(converted);
+  converted = NULL;
+  converted_size = 0;
+  pthread_mutex_unlock(&synth_lock);
+  hal_tts_release_model();
+  hal_tts_cache_cleanup();
+  initialized = 0;
+  printf("HAL TTS: libpiper cleaned up\n");
+}
+
+static const char *tts_impl_name(void) { return "Piper (libpiper)"; }
+
+static int tts_set_cpus(int first_cpu, int last_cpu) {
+  if (initialized || first_cpu < 0 || last_cpu < first_cpu) {
+    return -1;
+  }
+  tts_first_cpu = first_cpu;
+  tts_last_cpu = last_cpu;
+  printf("HAL TTS: libpiper threads kept to CPUs %d-%d\n", first_cpu,
+         last_cpu);
+  return 0;
+}
+
+static int tts_set_speed(float speed) {
+  /* Validate speed range (0.1 to 3.0 for experimentation) */
+  if (speed < 0.1f)
+    speed = 0.1f;
+  if (speed > 3.0f)
+    speed = 3.0f;
+
+  /* Takes effect from the next utterance with no model reload; cached
+   * speech is kept per speed, so nothing is cleared */
+  piper_length_scale = speed;
+  printf("HAL TTS: Setting speech speed to %.2f\n", speed);
+  return 0;
+}
+
+static int tts_cached(const char *text) {
+  return hal_tts_cache_contains(text, piper_length_scale);
+}
+
+const HalTtsBackend hal_tts_libpiper_backend = {
+    .name = "libpiper",
+    .init = tts_init,
+    .speak = tts_speak,
+    .warm = tts_warm,
+    .interrupt = tts_interrupt,
+    .cleanup = tts_cleanup,
+    .impl_name = tts_impl_name,
+    .set_speed = tts_set_speed,
+    .set_cpus = tts_set_cpus,
+    .cached = tts_cached,
+};
@@ -0,0 +1,294 @@
+/**
+ * @file hal_tts_normalize.c
+ * @brief Canonical text for the TTS cache and engines
+ */
+
+#include "hal_tts_normalize.h"
+#include <ctype.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+/* Longest canonical form memoized; a unit written out can make a text
+ * several times longer, and such texts are normalized each time */
+#define MEMO_CANONICAL (2 * HAL_TTS_NORMALIZE_MEMO_TEXT)
+
+/* Dropped from the end of a line, and not part of a word's core */
+#define END_PUNCTUATION ".,;:"
+#define WORD_PUNCTUATION ".,;:!?"
+
+typedef struct {
+  uint32_t hash;
+  char text[HAL_TTS_NORMALIZE_MEMO_TEXT];
+  char canonical[MEMO_CANONICAL];
+} MemoEntry;
+
+/* Direct mapped by hash; an entry with an empty text is unused */
+static MemoEntry memo[HAL_TTS_NORMALIZE_MEMO];
+static unsigned long memo_hits = 0;
+static unsigned long memo_misses = 0;
+static pthread_mutex_t memo_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Units written out after a number, matched in any case. W only counts
+ * written against the number: "K 1 W" is a spelled callsign. */
+static const struct {
+  const char *unit;
+  const char *word;
+  int apart; /* May follow the number after a space */
+} units[] = {
+    {"MHz", "megahertz", 1}, {"kHz", "kilohertz", 1}, {"Hz", "hertz", 1},
+    {"W", "watts", 0},       {"%", "percent", 1},     {"dB", "dB", 1},
+};
+#define UNIT_COUNT (sizeof(units) / sizeof(units[0]))
+
+/* The canonical form as it is built, cut short if it overflows */
+typedef struct {
+  char *out;
+  size_t size;
+  size_t len;
+  int overflow;
+} Writer;
+
+/* What the last word written was, for the word after it */
+enum { PREV_OTHER, PREV_NUMBER, PREV_POINT };
+
+static void put(Writer *w, const char *s, size_t n) {
+  if (w->len + n >= w->size) {
+    w->overflow = 1;
+    return;
+  }
+  memcpy(w->out + w->len, s, n);
+  w->len += n;
+  w->out[w->len] = '\0';
+}
+
+/* Write a word, after a space unless it starts a line */
+static void put_word(Writer *w, const char *s, size_t n) {
+  if (w->len > 0 && w->out[w->len - 1] != '\n') {
+    put(w, " ", 1);
+  }
+  put(w, s, n);
+}
+
+/* Drop end-of-line punctuation and spaces written last */
+static void end_line(Writer *w) {
+  while (w->len > 0 && (w->out[w->len - 1] == ' ' ||
+                        strchr(END_PUNCTUATION, w->out[w->len - 1]) != NULL)) {
+    w->out[--w->len] = '\0';
+  }
+}
+
+/* The unit s names, written out, or NULL */
+static const char *unit_word(const char *s, size_t n, int apart) {
+  for (size_t i = 0; i < UNIT_COUNT; i++) {
+    if (strlen(units[i].unit) == n && strncasecmp(s, units[i].unit, n) == 0 &&
+        (units[i].apart || !apart)) {
+      return units[i].word;
+    }
+  }
+  return NULL;
+}
+
+/* A callsign without its portable parts: a prefix of one to three letters
+ * and digits with a letter among them, a digit, and one to four letters
+ * ("W1AW", "2E0ABC", "VK2ABC") */
+static int is_callsign_base(const char *s, size_t n) {
+  size_t suffix = 0;
+  while (suffix < n && isalpha((unsigned char)s[n - 1 - suffix])) {
+    suffix++;
+  }
+  if (suffix < 1 || suffix > 4 || suffix + 2 > n ||
+      !isdigit((unsigned char)s[n - 1 - suffix])) {
+    return 0;
+  }
+  size_t prefix = n - 1 - suffix;
+  int letter = 0;
+  for (size_t i = 0; i < prefix; i++) {
+    letter |= isalpha((unsigned char)s[i]) != 0;
+  }
+  return prefix <= 3 && letter;
+}
+
+/* A callsign, with up to two portable parts ("VK2ABC/P", "F/G4ABC"), in
+ * capitals or in lower case */
+static int is_callsign(const char *s, size_t n) {
+  int upper = 0, lower = 0, slashes = 0, base = 0;
+  size_t start = 0;
+  for (size_t i = 0; i <= n; i++) {
+    if (i < n && s[i] != '/') {
+      if (!isalnum((unsigned char)s[i])) {
+        return 0;
+      }
+      upper |= isupper((unsigned char)s[i]) != 0;
+      lower |= islower((unsigned char)s[i]) != 0;
+      continue;
+    }
+    size_t len = i - start;
+    if (len < 1 || len > 6 || (i < n && ++slashes > 2)) {
+      return 0;
+    }
+    base |= is_callsign_base(s + start, len);
+    start = i + 1;
+  }
+  return base && !(upper && lower);
+}
+
+/* Write one space-separated word in its canonical form */
+static int put_token(Writer *w, const char *tok, size_t n, int prev) {
+  size_t core = n;
+  while (core > 0 && strchr(WORD_PUNCTUATION, tok[core - 1]) != NULL) {
+    core--;
+  }
+  const char *punct = tok + core;
+  size_t punct_len = n - core;
+  if (core == 0) {
+    put_word(w, tok, n);
+    return PREV_OTHER;
+  }
+
+  size_t whole = strspn(tok, "0123456789");
+  if (whole > 0) {
+    size_t end = whole;
+    size_t fraction = 0;
+    if (end + 1 < core && tok[end] == '.' &&
+        isdigit((unsigned char)tok[end + 1])) {
+      fraction = strspn(tok + end + 1, "0123456789");
+      end += 1 + fraction;
+    }
+    const char *unit = end < core ? unit_word(tok + end, core - end, 0) : NULL;
+    if (end == core || unit != NULL) {
+      if (prev == PREV_POINT && fraction == 0) {
+        for (size_t i = 0; i < whole; i++) {
+          put_word(w, tok + i, 1); /* "point 250" */
+        }
+      } else {
+        put_word(w, tok, whole);
+      }
+      if (fraction > 0) {
+        put_word(w, "point", 5);
+        for (size_t i = 0; i < fraction; i++) {
+          put_word(w, tok + whole + 1 + i, 1);
+        }
+      }
+      if (unit != NULL) {
+        put_word(w, unit, strlen(unit));
+      }
+      put(w, punct, punct_len);
+      return unit == NULL && punct_len == 0 ? PREV_NUMBER : PREV_OTHER;
+    }
+  }
+
+  const char *unit = prev == PREV_NUMBER ? unit_word(tok, core, 1) : NULL;
+  if (unit != NULL) {
+    put_word(w, unit, strlen(unit));
+    put(w, punct, punct_len);
+    return PREV_OTHER;
+  }
+
+  if (is_callsign(tok, core)) {
+    for (size_t i = 0; i < core; i++) {
+      char c = (char)toupper((unsigned char)tok[i]);
+      if (c == '/') {
+        put_word(w, "stroke", 6); /* As it is spelled */
+      } else {
+        put_word(w, &c, 1);
+      }
+    }
+    put(w, punct, punct_len);
+    return PREV_OTHER;
+  }
+
+  put_word(w, tok, n);
+  return core == 5 && strncmp(tok, "point", 5) == 0 && punct_len == 0
+             ? PREV_POINT
+             : PREV_OTHER;
+}
+
+static void normalize(const char *text, Writer *w) {
+  int prev = PREV_OTHER;
+  w->len = 0;
+  w->overflow = 0;
+  w->out[0] = '\0';
+  while (*text != '\0' && !w->overflow) {
+    if (*text == '\n') {
+      end_line(w);
+      if (w->len > 0 && w->out[w->len - 1] != '\n') {
+        put(w, "\n", 1);
+      }
+      prev = PREV_OTHER;
+      text++;
+      continue;
+    }
+    size_t gap = strspn(text, " \t\r");
+    if (gap > 0) {
+      text += gap;
+      continue;
+    }
+    size_t n = strcspn(text, " \t\r\n");
+    prev = put_token(w, text, n, prev);
+    text += n;
+  }
+  end_line(w);
+  while (w->len > 0 && w->out[w->len - 1] == '\n') {
+    w->out[--w->len] = '\0';
+    end_line(w);
+  }
+}
+
+static uint32_t fnv32(const char *text) {
+  uint32_t hash = 2166136261u;
+  for (; *text != '\0'; text++) {
+    hash = (hash ^ (unsigned char)*text) * 16777619u;
+  }
+  return hash;
+}
+
+const char *hal_tts_normalize(const char *text, char *out, size_t size) {
+  if (size == 0) {
+    return text;
+  }
+  size_t text_len = strlen(text);
+  MemoEntry *entry = NULL;
+  uint32_t hash = 0;
+  if (text_len < HAL_TTS_NORMALIZE_MEMO_TEXT) {
+    hash = fnv32(text);
+    entry = &memo[hash % HAL_TTS_NORMALIZE_MEMO];
+    pthread_mutex_lock(&memo_lock);
+    if (entry->hash == hash && entry->text[0] != '\0' &&
+        strcmp(entry->text, text) == 0) {
+      size_t len = strlen(entry->canonical);
+      int fits = len < size;
+      if (fits) {
+        memcpy(out, entry->canonical, len + 1);
+      }
+      memo_hits++;
+      pthread_mutex_unlock(&memo_lock);
+      return fits ? out : text;
+    }
+    memo_misses++;
+    pthread_mutex_unlock(&memo_lock);
+  }
+
+  Writer w = {out, size, 0, 0};
+  normalize(text, &w);
+  if (w.overflow || w.len == 0) {
+    return text; /* Blank or only punctuation: as it was */
+  }
+
+  if (entry != NULL && w.len < MEMO_CANONICAL) {
+    pthread_mutex_lock(&memo_lock);
+    entry->hash = hash;
+    memcpy(entry->text, text, text_len + 1);
+    memcpy(entry->canonical, out, w.len + 1);
+    pthread_mutex_unlock(&memo_lock);
+  }
+  return out;
+}
+
+void hal_tts_normalize_stats(unsigned long *hits, unsigned long *misses) {
+  pthread_mutex_lock(&memo_lock);
+  *hits = memo_hits;
+  *misses = memo_misses;
+  pthread_mutex_unlock(&memo_lock);
+}
@@ -0,0 +1,64 @@
+#ifndef HAL_TTS_NORMALIZE_H
+#define HAL_TTS_NORMALIZE_H
+
+#include <stddef.h>
+
+/**
+ * @file hal_tts_normalize.h
+ * @brief One spelling for text that is spoken the same way
+ *
+ * "14.250 MHz", "14 point 250 megahertz" and "14  point 2 5 0 megahertz."
+ * all say the same thing, but as text they are three cache keys and three
+ * runs of the synthesizer, each pronounced its own way. Every text the TTS
+ * HAL speaks or warms is first put in one canonical form, the one the
+ * word-at-a-time readouts (hal_tts_fragments.h) use:
+ *
+ *  - Runs of spaces and tabs are one space; blank lines go; the text is
+ *    trimmed.
+ *  - A decimal number is its whole part, "point" and its digits one by
+ *    one ("14.250" is "14 point 2 5 0"), as is a number after "point".
+ *  - A unit after a number is written out: MHz, kHz and Hz as megahertz,
+ *    kilohertz and hertz, % as percent, and dB in any case as dB, whether
+ *    or not a space comes between; W as watts only against the number
+ *    ("100W"), since "K 1 W" is a callsign spelled out.
+ *  - A callsign ("w1aw", "VK2ABC/P") is spelled: capital letters and
+ *    digits apart, a slash as "stroke".
+ *  - A full stop, comma, colon or semicolon at the end of a line is
+ *    dropped; a question or exclamation mark changes how it sounds and
+ *    stays.
+ *
+ * Case is otherwise left alone: the engines spell capitals ("USB") and
+ * read lower case as a word. Anything else the rules do not recognise,
+ * such as "192.168.1.5" or "12:30", is left as it is.
+ *
+ * Texts are normalized often and mostly repeat, so the results are kept
+ * in a small memo table (HAL_TTS_NORMALIZE_MEMO entries, for texts up to
+ * HAL_TTS_NORMALIZE_MEMO_TEXT bytes).
+ */
+
+#define HAL_TTS_NORMALIZE_MAX 1024        /* Longest canonical text */
+#define HAL_TTS_NORMALIZE_MEMO 128        /* Memo table entries */
+#define HAL_TTS_NORMALIZE_MEMO_TEXT 96    /* Longest text memoized */
+
+/**
+ * @brief Put text in its canonical form
+ *
+ * Thread safe.
+ *
+ * @param text The text
+ * @param out Receives the canonical form
+ * @param size Size of out, HAL_TTS_NORMALIZE_MAX for any text the audio
+ *        process is sent
+ * @return out, or text itself if its canonical form does not fit
+ */
+const char *hal_tts_normalize(const char *text, char *out, size_t size);
+
+/**
+ * @brief Memo table counters, for diagnostics and tests
+ *
+ * @param hits Receives the texts found in the memo table
+ * @param misses Receives the texts normalized
+ */
+void hal_tts_normalize_stats(unsigned long *hits, unsigned long *misses);
+
+#endif /* HAL_TTS_NORMALIZE_H */
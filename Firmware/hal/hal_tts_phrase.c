@@ -0,0 +1,51 @@
+/**
+ * @file hal_tts_phrase.c
+ * @brief Phrase boundaries for chunked synthesis
+ */
+
+#include "hal_tts_phrase.h"
+#include <string.h>
+
+static int is_space(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+const char *hal_tts_next_phrase(const char *text, size_t *len,
+                                const char **next) {
+  text += strspn(text, " \t\r\n");
+  if (*text == '\0') {
+    return NULL;
+  }
+
+  size_t last_space = 0;
+  size_t i;
+  for (i = 0; text[i] != '\0' && i < HAL_TTS_PHRASE_MAX; i++) {
+    char c = text[i];
+    if (c == '\n') {
+      break; /* Line break: always a phrase of its own */
+    }
+    if (is_space(c)) {
+      last_space = i;
+      continue;
+    }
+    if (text[i + 1] != '\0' && !is_space(text[i + 1])) {
+      continue; /* "14.250", "A,B" */
+    }
+    if (strchr(".!?;:", c) != NULL ||
+        (c == ',' && i + 1 >= HAL_TTS_PHRASE_MIN)) {
+      *len = i + 1;
+      *next = text + i + 1;
+      return text;
+    }
+  }
+
+  if (text[i] != '\0' && text[i] != '\n' && last_space > 0) {
+    i = last_space; /* Too long: break between words */
+  }
+  *next = text + i;
+  while (i > 0 && is_space(text[i - 1])) {
+    i--;
+  }
+  *len = i;
+  return text;
+}
@@ -0,0 +1,39 @@
+#ifndef HAL_TTS_PHRASE_H
+#define HAL_TTS_PHRASE_H
+
+#include <stddef.h>
+
+/**
+ * @file hal_tts_phrase.h
+ * @brief Splitting long announcements into phrases for synthesis
+ *
+ * The Piper backends synthesize and cache text one phrase at a time, so
+ * the first phrase of a help readout plays while the rest is still being
+ * synthesized and a phrase shared by several announcements is cached once.
+ *
+ * A phrase ends at a line break, at sentence punctuation (. ! ? ; :)
+ * followed by a space or the end of the text, or at a comma once it is
+ * HAL_TTS_PHRASE_MIN characters long; a run longer than HAL_TTS_PHRASE_MAX
+ * is broken at its last space. Short announcements ("14.250 megahertz")
+ * stay one phrase. Software2 joins queued prompts with line breaks, so each
+ * is still cached as it would be spoken alone.
+ */
+
+#define HAL_TTS_PHRASE_MIN 24  /* Shorter pieces run on past a comma */
+#define HAL_TTS_PHRASE_MAX 160 /* Longest phrase, in bytes */
+
+/**
+ * @brief Find the next phrase of text
+ *
+ * Leading whitespace is skipped. Call again from *next until it returns
+ * NULL.
+ *
+ * @param text Where to look from
+ * @param len Receives the phrase length (at most HAL_TTS_PHRASE_MAX)
+ * @param next Receives where the following phrase search starts
+ * @return Start of the phrase, or NULL if only whitespace is left
+ */
+const char *hal_tts_next_phrase(const char *text, size_t *len,
+                                const char **next);
+
+#endif /* HAL_TTS_PHRASE_H */
@@ -6,14 +6,57 @@
  * Keeps Piper running as a persistent subprocess for lower latency.
  * This makes TTS interruptible and avoids audio device conflicts.
  *
+ * Piper logs a "Real-time factor" line on stderr after it has written and
+ * flushed the last of a line's audio, so that line marks the end of each
+ * utterance: the audio still in the stdout pipe is all that is left of it.
+ * If this Piper build never logs the marker, a 100ms silence on stdout
+ * ends the utterance instead.
+ *
+ * On multi-core Pis several Piper processes run as a pool. Worker 0 is
+ * reserved for foreground speech (hal_tts_speak()); the others take
+ * background synthesis (hal_tts_warm()), each pinned to a core of its own
+ * at a low priority, so warming the cache does not slow down speech.
+ *
+ * Hot standby: where memory allows, a supervisor thread keeps a spare
+ * Piper started and primed like worker 0. If worker 0's Piper dies, the
+ * spare takes its place at once instead of the speech waiting for a model
+ * load, and a phrase cut short by the crash is sent to it again, its
+ * audio picking up where the dead one stopped (synthesis is
+ * deterministic). The supervisor then starts the next spare in the
+ * background.
+ *
+ * Voices: besides the default model, HAMPOD_TTS_VOICES may name others
+ * ("alert=models/a.onnx,de=models/de.onnx"; one named "default" replaces
+ * the built-in model). Each runs one Piper of its own at foreground
+ * priority, started and primed at init so hal_tts_select_voice() switches
+ * at once. With HAMPOD_TTS_VOICE_PRELOAD=0 they start on first use instead
+ * and only one of them runs at a time, for boards without the memory.
+ *
+ * Faster inference: the default voice may be an INT8-quantized copy of a
+ * model (Documentation/scripts/quantize_piper_voice.sh), which Piper runs
+ * like any other. HAMPOD_TTS_ACCEL=cuda has Piper run the model through
+ * ONNX Runtime's CUDA execution provider (--use-cuda), the one Piper's
+ * command line offers. If the foreground Piper does not come up that way,
+ * it falls back at init: first to the CPU, then from a replaced default
+ * voice to the built-in model.
+ *
  * Phase 2: Persistent Piper implementation
  */
 
+#define _GNU_SOURCE /* CPU_SET / sched_setaffinity */
+
 #include "hal_audio.h"
-#include "hal_tts.h"
+#include "hal_tts_backend.h"
 #include "hal_tts_cache.h"
+#include "hal_tts_phrase.h"
+#include "hal_tts_thermal.h"
+#include "hal_tts_warmup.h"
+#include "../hampod_alloc.h"
+#include "../hampod_trace.h"
 #include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
 #include <signal.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -34,67 +77,183 @@
 #define PIPER_SPEED "0.45"
 #endif
 
+/* Pool size: HAMPOD_PIPER_WORKERS, else PIPER_WORKERS, else 0 for one
+ * worker per ~2 cores (2 on a Pi 4 or 5, 1 on smaller boards) */
+#ifndef PIPER_WORKERS
+#define PIPER_WORKERS 0
+#endif
+#define PIPER_WORKERS_ENV "HAMPOD_PIPER_WORKERS"
+#define PIPER_MAX_WORKERS 4
+
+/* Hot standby (see the file comment): HAMPOD_PIPER_SPARE=0 turns it off.
+ * A spare holds another copy of the model, so it is only started while
+ * this much memory is available; otherwise that is checked again every
+ * PIPER_SPARE_RETRY_S, as is a spare that failed to start. */
+#define PIPER_SPARE_ENV "HAMPOD_PIPER_SPARE"
+#define PIPER_SPARE_MIN_FREE_MB 200
+#define PIPER_SPARE_RETRY_S 30
+
+/* Voice registry (see the file comment) */
+#define PIPER_VOICES_ENV "HAMPOD_TTS_VOICES"
+#define PIPER_VOICE_PRELOAD_ENV "HAMPOD_TTS_VOICE_PRELOAD"
+#define PIPER_MAX_VOICES 4
+#define PIPER_VOICE_NAME_MAX 16
+
+/* Execution provider: cpu (the default) or cuda */
+#define PIPER_ACCEL_ENV "HAMPOD_TTS_ACCEL"
+/* Primes a Piper on trial when warm-up is off */
+#define PIPER_PROBE_TEXT "ok"
+
+/* Scheduling priority of the foreground and background workers */
+#define PIPER_FOREGROUND_NICE -20
+#define PIPER_BACKGROUND_NICE 10
+
 /* Chunk size for streaming: 50ms at 16kHz mono = 800 samples = 1600 bytes */
 #define TTS_CHUNK_SAMPLES 800
 #define TTS_CHUNK_BYTES (TTS_CHUNK_SAMPLES * 2)
 
-/* Timeout for end-of-utterance detection (microseconds) */
+/* Piper's end-of-utterance log line (see the file comment) */
+#define PIPER_DONE_MARKER "Real-time factor:"
+
+/* No audio and no marker for this long means Piper is stuck */
+#define TTS_STALL_TIMEOUT_US 10000000 /* 10s */
+
+/* Silence that ends an utterance when Piper logs no marker (microseconds) */
 #define TTS_READ_TIMEOUT_US 100000 /* 100ms */
 
+/* wait_for_piper() results */
+#define PIPER_AUDIO_READY 1
+#define PIPER_LOG_READY 2
+
+/* One persistent Piper process. Its lock is held by whoever is using it,
+ * from the text going in to the last of the audio coming out. */
+typedef struct {
+  pid_t pid;          /* Piper process ID for cleanup */
+  const char *model;  /* Voice model it runs */
+  FILE *stdin_file;   /* Write text to Piper here */
+  int stdout_fd;      /* Read raw PCM from Piper here */
+  int stderr_fd;      /* Piper's log, scanned for markers */
+  int first_cpu;      /* CPUs it is pinned to; -1 for any */
+  int last_cpu;       /* Last CPU of that range */
+  int nice;           /* Scheduling priority */
+  int restart_due;    /* Speed changed while it was busy */
+  float speed;        /* Length scale it was started with */
+  int pending;        /* Lines sent whose marker is still due */
+  char log_line[256]; /* Partial stderr line */
+  size_t log_len;     /* Length of log_line */
+  pthread_mutex_t lock;
+} PiperWorker;
+
+/* A voice of the registry. Voice 0 is spoken by the pool; the others by
+ * a worker of their own, whose lock also guards loaded. */
+typedef struct {
+  char name[PIPER_VOICE_NAME_MAX];
+  char model[256];
+  PiperWorker worker; /* Unused for voice 0 */
+  int loaded;         /* worker runs (or is meant to, if it died) */
+} PiperVoice;
+
 /* Persistent Piper process state */
 static int initialized = 0;
-static volatile int tts_interrupted = 0;
+static volatile int tts_interrupted = 0; /* Foreground speech only */
 
-/* Runtime speech speed (can be changed via hal_tts_set_speed) */
-static char piper_speed[16] = PIPER_SPEED;
+static PiperWorker workers[PIPER_MAX_WORKERS];
+static int worker_count = 0;
+#define FOREGROUND_WORKER (&workers[0])
 
-/* Persistent Piper pipes and process ID */
-static FILE *piper_stdin = NULL; /* Write text to Piper here */
-static int piper_stdout_fd = -1; /* Read raw PCM from Piper here */
-static pid_t piper_pid = -1;     /* Piper process ID for cleanup */
+/* Runtime speech speed (can be changed via hal_tts_set_speed). Guarded
+ * by pool_lock, as is the background round-robin position. */
+static char piper_speed[16] = PIPER_SPEED;
+static int next_background = 0;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Piper logs PIPER_DONE_MARKER; cleared for good the first time it does
+ * not, since that is a property of the installed Piper */
+static volatile int piper_framed = 1;
+
+/* Pipers run on the CUDA provider (PIPER_ACCEL_ENV), until it fails */
+static int piper_cuda = 0;
+
+/* Cores the pool is kept to (hal_tts_set_cpus()); -1 for all of them */
+static int tts_first_cpu = -1;
+static int tts_last_cpu = -1;
+
+/* The spare Piper (pid -1 while there is none) and its supervisor. Guarded
+ * by spare_lock, taken before pool_lock when both are. */
+static PiperWorker spare = {.pid = -1, .stdout_fd = -1, .stderr_fd = -1};
+static pthread_mutex_t spare_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t spare_wanted = PTHREAD_COND_INITIALIZER;
+static pthread_t spare_thread;
+static int spare_running = 0;
+
+static PiperVoice voices[PIPER_MAX_VOICES];
+static int voice_count = 0;
+static int voices_preloaded = 1;    /* Not HAMPOD_TTS_VOICE_PRELOAD=0 */
+static __thread int thread_voice = 0; /* hal_tts_select_voice() */
+
+/* The speed new speech is wanted at, which picks its cache entries */
+static float current_speed(void) {
+  pthread_mutex_lock(&pool_lock);
+  float speed = strtof(piper_speed, NULL);
+  pthread_mutex_unlock(&pool_lock);
+  return speed;
+}
 
 /**
- * @brief Start the persistent Piper subprocess
+ * @brief Start a worker's persistent Piper subprocess
  *
  * Forks and execs Piper with stdin for text and stdout for raw PCM audio.
+ * Call with the worker's lock held (or before the pool is in use).
  *
  * @return 0 on success, -1 on failure
  */
-static int start_persistent_piper(void) {
+static int start_persistent_piper(PiperWorker *w) {
   int stdin_pipe[2];  /* Parent writes, child reads */
   int stdout_pipe[2]; /* Child writes, parent reads */
+  int stderr_pipe[2]; /* Child logs, parent scans for markers */
+  char speed[sizeof(piper_speed)];
+
+  pthread_mutex_lock(&pool_lock);
+  memcpy(speed, piper_speed, sizeof(speed));
+  pthread_mutex_unlock(&pool_lock);
+  w->speed = strtof(speed, NULL);
 
   /* Create pipes */
-  if (pipe(stdin_pipe) != 0 || pipe(stdout_pipe) != 0) {
+  if (pipe(stdin_pipe) != 0 || pipe(stdout_pipe) != 0 ||
+      pipe(stderr_pipe) != 0) {
     perror("HAL TTS: pipe() failed");
     return -1;
   }
 
   /* Fork */
-  piper_pid = fork();
+  w->pid = fork();
 
-  if (piper_pid < 0) {
+  if (w->pid < 0) {
     perror("HAL TTS: fork() failed");
     close(stdin_pipe[0]);
     close(stdin_pipe[1]);
     close(stdout_pipe[0]);
     close(stdout_pipe[1]);
+    close(stderr_pipe[0]);
+    close(stderr_pipe[1]);
     return -1;
   }
 
-  if (piper_pid == 0) {
+  if (w->pid == 0) {
     /* ===== CHILD PROCESS ===== */
 
     /* Close ALL inherited file descriptors (except the pipes we need)
      * This is CRITICAL - inherited handles to USB devices, sockets, or
-     * system files could cause unexpected behavior if kept open.
+     * system files could cause unexpected behavior if kept open. It also
+     * closes the other workers' pipes, so they see EOF when stopped.
      */
     int max_fd = sysconf(_SC_OPEN_MAX);
     if (max_fd < 0)
       max_fd = 1024; /* Fallback */
     for (int fd = 3; fd < max_fd; fd++) {
       /* Skip the pipe fds we need */
-      if (fd != stdin_pipe[0] && fd != stdout_pipe[1]) {
+      if (fd != stdin_pipe[0] && fd != stdout_pipe[1] &&
+          fd != stderr_pipe[1]) {
         close(fd);
       }
     }
@@ -109,24 +268,34 @@ static int start_persistent_piper(void) {
     close(stdout_pipe[0]); /* Close read end in child */
     close(stdout_pipe[1]);
 
-    /* Redirect stderr to /dev/null to suppress Piper's status messages */
-    int devnull = open("/dev/null", O_WRONLY);
-    if (devnull >= 0) {
-      dup2(devnull, STDERR_FILENO);
-      close(devnull);
+    /* Redirect stderr to the log pipe; its markers end each utterance */
+    dup2(stderr_pipe[1], STDERR_FILENO);
+    close(stderr_pipe[0]);
+    close(stderr_pipe[1]);
+
+    /* Keep the workers off each other's cores */
+    if (w->first_cpu >= 0) {
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      for (int cpu = w->first_cpu; cpu <= w->last_cpu; cpu++) {
+        CPU_SET(cpu, &cpus);
+      }
+      sched_setaffinity(0, sizeof(cpus), &cpus);
     }
-    /* Set maximum priority for low latency */
-    setpriority(PRIO_PROCESS, 0, -20);
+
+    /* Maximum priority for low latency; background workers yield */
+    setpriority(PRIO_PROCESS, 0, w->nice);
 
     /* Execute Piper with detailed performance optimizations:
      * - length_scale: Controlled by piper_speed (lower = faster)
      * - --noise_scale 0.0: Deterministic (no random sampling), faster
      * - --noise_scale_w 0.0: Deterministic pronunciation, faster
      * - --output_raw: Direct PCM output
+     * - --use-cuda: The accelerator, if HAMPOD_TTS_ACCEL asks for it
      */
-    execlp("piper", "piper", "--model", PIPER_MODEL_PATH, "--length_scale",
-           piper_speed, "--noise_scale", "0.0", "--noise_scale_w", "0.0",
-           "--output_raw", NULL);
+    execlp("piper", "piper", "--model", w->model, "--length_scale", speed,
+           "--noise_scale", "0.0", "--noise_scale_w", "0.0", "--output_raw",
+           piper_cuda ? "--use-cuda" : NULL, NULL);
 
     /* execlp only returns on error */
     perror("HAL TTS: execlp(piper) failed");
@@ -137,81 +306,711 @@ static int start_persistent_piper(void) {
   /* Close unused ends */
   close(stdin_pipe[0]);  /* Close read end of stdin pipe */
   close(stdout_pipe[1]); /* Close write end of stdout pipe */
+  close(stderr_pipe[1]); /* Close write end of stderr pipe */
 
   /* Wrap stdin pipe in FILE* for fprintf/fflush */
-  piper_stdin = fdopen(stdin_pipe[1], "w");
-  if (piper_stdin == NULL) {
+  w->stdin_file = fdopen(stdin_pipe[1], "w");
+  if (w->stdin_file == NULL) {
     perror("HAL TTS: fdopen() failed");
     close(stdin_pipe[1]);
     close(stdout_pipe[0]);
-    kill(piper_pid, SIGTERM);
-    waitpid(piper_pid, NULL, 0);
-    piper_pid = -1;
+    close(stderr_pipe[0]);
+    kill(w->pid, SIGTERM);
+    waitpid(w->pid, NULL, 0);
+    w->pid = -1;
     return -1;
   }
 
   /* Set line buffering for stdin to ensure text is sent immediately */
-  setvbuf(piper_stdin, NULL, _IOLBF, 0);
-
-  /* Store stdout file descriptor (we use raw fd for select() timeout) */
-  piper_stdout_fd = stdout_pipe[0];
-
-  printf("HAL TTS: Started persistent Piper process (pid=%d)\n", piper_pid);
+  setvbuf(w->stdin_file, NULL, _IOLBF, 0);
+
+  /* Store the output fds; both are read non-blocking after select() */
+  w->stdout_fd = stdout_pipe[0];
+  w->stderr_fd = stderr_pipe[0];
+  fcntl(w->stdout_fd, F_SETFL, fcntl(w->stdout_fd, F_GETFL, 0) | O_NONBLOCK);
+  fcntl(w->stderr_fd, F_SETFL, fcntl(w->stderr_fd, F_GETFL, 0) | O_NONBLOCK);
+  w->pending = 0;
+  w->log_len = 0;
+  w->restart_due = 0;
+
+  printf("HAL TTS: Started persistent Piper process (pid=%d)\n", w->pid);
   return 0;
 }
 
 /**
- * @brief Stop the persistent Piper subprocess
+ * @brief Stop a worker's persistent Piper subprocess
  */
-static void stop_persistent_piper(void) {
-  if (piper_stdin != NULL) {
-    fclose(piper_stdin);
-    piper_stdin = NULL;
+static void stop_persistent_piper(PiperWorker *w) {
+  if (w->stdin_file != NULL) {
+    fclose(w->stdin_file);
+    w->stdin_file = NULL;
+  }
+
+  if (w->stdout_fd >= 0) {
+    close(w->stdout_fd);
+    w->stdout_fd = -1;
   }
 
-  if (piper_stdout_fd >= 0) {
-    close(piper_stdout_fd);
-    piper_stdout_fd = -1;
+  if (w->stderr_fd >= 0) {
+    close(w->stderr_fd);
+    w->stderr_fd = -1;
   }
 
-  if (piper_pid > 0) {
+  if (w->pid > 0) {
     /* Send SIGTERM and wait */
-    kill(piper_pid, SIGTERM);
+    kill(w->pid, SIGTERM);
     int status;
-    waitpid(piper_pid, &status, 0);
-    printf("HAL TTS: Stopped Piper process (pid=%d, status=%d)\n", piper_pid,
+    waitpid(w->pid, &status, 0);
+    printf("HAL TTS: Stopped Piper process (pid=%d, status=%d)\n", w->pid,
            WEXITSTATUS(status));
-    piper_pid = -1;
+    w->pid = -1;
   }
 }
 
 /**
- * @brief Check if persistent Piper is running
+ * @brief Check if a worker's persistent Piper is running
  */
-static int is_piper_running(void) {
-  if (piper_pid <= 0) {
+static int is_piper_running(PiperWorker *w) {
+  if (w->pid <= 0) {
     return 0;
   }
   /* Check if process is still alive */
   int status;
-  pid_t result = waitpid(piper_pid, &status, WNOHANG);
+  pid_t result = waitpid(w->pid, &status, WNOHANG);
   if (result == 0) {
     return 1; /* Still running */
   }
   /* Process exited */
-  piper_pid = -1;
+  w->pid = -1;
   return 0;
 }
 
+/**
+ * @brief Hand the spare Piper to the foreground worker
+ *
+ * Call with the worker's lock held, its own Piper stopped. A spare that
+ * died meanwhile or runs at an old speed is thrown away. Either way the
+ * supervisor is asked for a new one.
+ *
+ * @return 0 if the worker now runs the spare, -1 if none was ready
+ */
+static int take_spare(PiperWorker *w) {
+  int taken = -1;
+  float speed = current_speed();
+  pthread_mutex_lock(&spare_lock);
+  if (spare.pid > 0 && is_piper_running(&spare) && spare.speed == speed) {
+    w->pid = spare.pid;
+    w->stdin_file = spare.stdin_file;
+    w->stdout_fd = spare.stdout_fd;
+    w->stderr_fd = spare.stderr_fd;
+    w->speed = spare.speed;
+    w->pending = 0;
+    w->log_len = 0;
+    w->restart_due = 0;
+    spare.pid = -1;
+    spare.stdin_file = NULL;
+    spare.stdout_fd = -1;
+    spare.stderr_fd = -1;
+    taken = 0;
+  } else {
+    stop_persistent_piper(&spare);
+  }
+  pthread_cond_signal(&spare_wanted);
+  pthread_mutex_unlock(&spare_lock);
+  return taken;
+}
+
+/**
+ * @brief Replace a worker's dead Piper, with the spare if one is ready
+ *
+ * Call with the worker's lock held. Only the foreground worker takes the
+ * spare, which runs on its cores at its priority; the others, and the
+ * foreground one without a spare, start a Piper and wait for its model.
+ *
+ * @return 0 on success, -1 if Piper cannot be started
+ */
+static int replace_piper(PiperWorker *w) {
+  stop_persistent_piper(w);
+  int failed_over = w == FOREGROUND_WORKER && take_spare(w) == 0;
+  hal_tts_note_crash(failed_over);
+  if (failed_over) {
+    printf("HAL TTS: Failed over to the spare Piper (pid=%d)\n", w->pid);
+    return 0;
+  }
+  if (start_persistent_piper(w) != 0) {
+    fprintf(stderr, "HAL TTS: Failed to restart Piper\n");
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Make sure a worker is running at the current speed
+ *
+ * Call with the worker's lock held.
+ *
+ * @return 0 on success, -1 if Piper cannot be started
+ */
+static int ensure_piper(PiperWorker *w) {
+  if (w->restart_due) {
+    printf("HAL TTS: Restarting Piper with new speed\n");
+  } else if (!is_piper_running(w)) {
+    printf("HAL TTS: Piper process died, restarting...\n");
+    return replace_piper(w);
+  } else {
+    return 0;
+  }
+  stop_persistent_piper(w);
+  if (start_persistent_piper(w) != 0) {
+    fprintf(stderr, "HAL TTS: Failed to restart Piper\n");
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Wait for Piper to write audio or log something
+ *
+ * @param timeout_us How long to wait
+ * @return PIPER_AUDIO_READY and/or PIPER_LOG_READY, 0 on timeout, -1 on
+ *         error
+ */
+static int wait_for_piper(PiperWorker *w, long timeout_us) {
+  fd_set read_fds;
+  struct timeval timeout;
+
+  FD_ZERO(&read_fds);
+  FD_SET(w->stdout_fd, &read_fds);
+  FD_SET(w->stderr_fd, &read_fds);
+  timeout.tv_sec = timeout_us / 1000000;
+  timeout.tv_usec = timeout_us % 1000000;
+
+  int max_fd = w->stdout_fd > w->stderr_fd ? w->stdout_fd : w->stderr_fd;
+  int result;
+  while ((result = select(max_fd + 1, &read_fds, NULL, NULL, &timeout)) < 0 &&
+         errno == EINTR) {
+  }
+  if (result <= 0) {
+    return result;
+  }
+  return (FD_ISSET(w->stdout_fd, &read_fds) ? PIPER_AUDIO_READY : 0) |
+         (FD_ISSET(w->stderr_fd, &read_fds) ? PIPER_LOG_READY : 0);
+}
+
+/**
+ * @brief Read what Piper has logged and settle the utterances it finished
+ *
+ * @return 0 on success, -1 if Piper closed its log
+ */
+static int read_piper_log(PiperWorker *w) {
+  char buf[512];
+  ssize_t len;
+  while ((len = read(w->stderr_fd, buf, sizeof(buf))) > 0) {
+    for (ssize_t i = 0; i < len; i++) {
+      if (buf[i] != '\n') {
+        if (w->log_len < sizeof(w->log_line) - 1) {
+          w->log_line[w->log_len++] = buf[i];
+        }
+        continue;
+      }
+      w->log_line[w->log_len] = '\0';
+      w->log_len = 0;
+      if (strstr(w->log_line, PIPER_DONE_MARKER) != NULL && w->pending > 0) {
+        w->pending--;
+      }
+    }
+  }
+  return len == 0 ? -1 : 0;
+}
+
+/**
+ * @brief Throw away whatever audio is waiting on Piper's stdout
+ */
+static void discard_piper_audio(PiperWorker *w) {
+  char drain_buf[4096];
+  while (read(w->stdout_fd, drain_buf, sizeof(drain_buf)) > 0) {
+    /* Discard the data */
+  }
+}
+
+/**
+ * @brief Stop relying on markers after Piper went quiet without one
+ */
+static void piper_framing_lost(PiperWorker *w) {
+  if (piper_framed) {
+    fprintf(stderr, "HAL TTS: No end-of-utterance marker from Piper, "
+                    "falling back to a 100ms silence timeout\n");
+    piper_framed = 0;
+  }
+  w->pending = 0;
+}
+
+/**
+ * @brief Skip the rest of any utterance that was interrupted
+ *
+ * Piper finishes a line before it reads the next, so once the markers of
+ * the lines already sent are in, everything on stdout belongs to them.
+ *
+ * @param cancel Flag that abandons the wait when set, or NULL
+ * @return 0 when Piper is idle, -1 if cancelled meanwhile
+ */
+static int skip_stale_audio(PiperWorker *w, volatile int *cancel) {
+  while (piper_framed && w->pending > 0) {
+    if (cancel != NULL && *cancel) {
+      return -1;
+    }
+    int ready = wait_for_piper(w, TTS_STALL_TIMEOUT_US);
+    if (ready <= 0) {
+      piper_framing_lost(w);
+      break;
+    }
+    if (ready & PIPER_AUDIO_READY) {
+      discard_piper_audio(w);
+    }
+    if ((ready & PIPER_LOG_READY) && read_piper_log(w) != 0) {
+      break;
+    }
+  }
+  discard_piper_audio(w);
+  return 0;
+}
+
+/**
+ * @brief Send one utterance to Piper as a single line
+ *
+ * Line breaks inside the text would make Piper speak (and log) several
+ * lines, so they are sent as spaces.
+ *
+ * @return 0 on success, -1 on failure
+ */
+static int send_to_piper(PiperWorker *w, const char *text) {
+  for (const char *p = text; *p != '\0'; p++) {
+    if (fputc(*p == '\n' || *p == '\r' ? ' ' : *p, w->stdin_file) == EOF) {
+      return -1;
+    }
+  }
+  if (fputc('\n', w->stdin_file) == EOF || fflush(w->stdin_file) != 0) {
+    return -1;
+  }
+  w->pending++;
+  return 0;
+}
+
+/**
+ * @brief Number of workers to run on this board
+ */
+static int pool_size(void) {
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  if (cpus < 1) {
+    cpus = 1;
+  }
+  const char *env = getenv(PIPER_WORKERS_ENV);
+  int count = env != NULL ? atoi(env) : PIPER_WORKERS;
+  if (count <= 0) {
+    count = cpus >= 4 ? 2 : 1;
+  }
+  return count > PIPER_MAX_WORKERS ? PIPER_MAX_WORKERS : count;
+}
+
+/**
+ * @brief Lay out the pool: background worker i gets the i-th core from
+ *        the top, the foreground worker all the cores below them
+ *
+ * With more workers than cores nothing is pinned; priorities still apply.
+ */
+static void plan_workers(int count) {
+  static int locks_ready = 0;
+  int lo = tts_first_cpu;
+  int hi = tts_last_cpu;
+  int pinned = lo >= 0; /* Kept to the cores hal_tts_set_cpus() gave */
+  if (!pinned) {
+    lo = 0;
+    hi = (int)sysconf(_SC_NPROCESSORS_ONLN) - 1;
+  }
+  int cpus = hi - lo + 1;
+  for (int i = 0; i < count; i++) {
+    PiperWorker *w = &workers[i];
+    w->pid = -1;
+    w->model = voices[0].model;
+    w->stdin_file = NULL;
+    w->stdout_fd = -1;
+    w->stderr_fd = -1;
+    w->nice = i == 0 ? PIPER_FOREGROUND_NICE : PIPER_BACKGROUND_NICE;
+    if (count == 1 || count > cpus) {
+      w->first_cpu = pinned ? lo : -1;
+      w->last_cpu = pinned ? hi : -1;
+    } else if (i == 0) {
+      w->first_cpu = lo;
+      w->last_cpu = hi - (count - 1);
+    } else {
+      w->first_cpu = w->last_cpu = hi + 1 - i;
+    }
+  }
+  if (!locks_ready) {
+    for (int i = 0; i < PIPER_MAX_WORKERS; i++) {
+      pthread_mutex_init(&workers[i].lock, NULL);
+    }
+    for (int v = 0; v < PIPER_MAX_VOICES; v++) {
+      pthread_mutex_init(&voices[v].worker.lock, NULL);
+    }
+    locks_ready = 1;
+  }
+}
+
 /* ============================================================================
  * Public API
  * ============================================================================
  */
 
-int hal_tts_init(void) {
+/**
+ * @brief Read one utterance from Piper into a capture buffer
+ *
+ * Call with the worker's lock held, after send_to_piper(). The buffer
+ * comes from hal_tts_cache_buffer(); give it back with
+ * hal_tts_cache_recycle() or hal_tts_cache_store_owned().
+ *
+ * @param buf_capacity Receives the buffer's size, in samples
+ * @return 0 on success, -1 on failure
+ */
+static int capture_utterance(PiperWorker *w, int16_t **samples,
+                             size_t *num_samples, size_t *buf_capacity) {
+  size_t capacity;
+  size_t len = 0;
+  int16_t *buf = hal_tts_cache_buffer(&capacity);
+  int16_t chunk[TTS_CHUNK_SAMPLES];
+
+  while (buf != NULL) {
+    long timeout_us =
+        piper_framed || len == 0 ? TTS_STALL_TIMEOUT_US : TTS_READ_TIMEOUT_US;
+    int ready = wait_for_piper(w, timeout_us);
+    if (ready <= 0) {
+      if (ready == 0 && piper_framed) {
+        piper_framing_lost(w);
+      }
+      break;
+    }
+    if ((ready & PIPER_LOG_READY) && read_piper_log(w) != 0) {
+      break;
+    }
+    int finished = piper_framed && w->pending == 0;
+
+    ssize_t bytes_read;
+    while ((bytes_read = read(w->stdout_fd, chunk, TTS_CHUNK_BYTES)) > 0) {
+      size_t samples_read = bytes_read / 2;
+      if (len + samples_read > capacity) {
+        int16_t *new_buf = hampod_realloc(ALLOC_TTS_CAPTURE, buf,
+                                          capacity * 2 * sizeof(int16_t));
+        if (new_buf == NULL) {
+          hampod_free(buf);
+          buf = NULL;
+          break;
+        }
+        buf = new_buf;
+        capacity *= 2;
+      }
+      memcpy(buf + len, chunk, samples_read * sizeof(int16_t));
+      len += samples_read;
+    }
+    if (bytes_read == 0 || finished) {
+      break;
+    }
+  }
+
+  if (buf == NULL || len == 0 || (piper_framed && w->pending > 0)) {
+    hal_tts_cache_recycle(buf, capacity);
+    return -1;
+  }
+  *samples = buf;
+  *num_samples = len;
+  *buf_capacity = capacity;
+  return 0;
+}
+
+/**
+ * @brief Synthesize the warm-up phrase on a worker and discard it
+ *
+ * Call with the worker's lock held, after starting it, so its first real
+ * utterance does not pay for ONNX graph setup.
+ *
+ * @return 0 on success, -1 if Piper gave no audio for it
+ */
+static int prime_worker(PiperWorker *w, const char *text) {
+  int16_t *samples;
+  size_t num_samples, capacity;
+  if (send_to_piper(w, text) == 0 &&
+      capture_utterance(w, &samples, &num_samples, &capacity) == 0) {
+    hal_tts_cache_recycle(samples, capacity);
+    return 0;
+  }
+  return -1;
+}
+
+/**
+ * @brief Give up what the foreground Piper did not start with
+ *
+ * The accelerator goes first, then a default voice that replaces the
+ * built-in model (a quantized one, say).
+ *
+ * @return 1 if there was something to give up, so init tries again
+ */
+static int fall_back(void) {
+  if (piper_cuda) {
+    piper_cuda = 0;
+    fprintf(stderr, "HAL TTS: Piper did not start on CUDA, using the CPU\n");
+    return 1;
+  }
+  if (strcmp(voices[0].model, PIPER_MODEL_PATH) != 0 &&
+      access(PIPER_MODEL_PATH, F_OK) == 0) {
+    fprintf(stderr, "HAL TTS: Piper did not start with %s, using %s\n",
+            voices[0].model, PIPER_MODEL_PATH);
+    snprintf(voices[0].model, sizeof(voices[0].model), "%s",
+             PIPER_MODEL_PATH);
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Whether there is memory for a spare Piper
+ *
+ * @return 1 if MemAvailable is at least PIPER_SPARE_MIN_FREE_MB (or cannot
+ *         be read), 0 otherwise
+ */
+static int spare_affordable(void) {
+  FILE *f = fopen("/proc/meminfo", "r");
+  if (f == NULL) {
+    return 1;
+  }
+  char line[128];
+  long available_kb = -1;
+  while (fgets(line, sizeof(line), f) != NULL &&
+         sscanf(line, "MemAvailable: %ld kB", &available_kb) != 1) {
+  }
+  fclose(f);
+  return available_kb < 0 || available_kb / 1024 >= PIPER_SPARE_MIN_FREE_MB;
+}
+
+/**
+ * @brief Supervisor thread: keep a primed spare Piper while one is wanted
+ *
+ * The spare is started and primed outside spare_lock, so taking it never
+ * waits for a model load.
+ */
+static void *spare_thread_func(void *arg) {
+  (void)arg;
+  int announced = 0;
+  pthread_mutex_lock(&spare_lock);
+  while (spare_running) {
+    if (spare.pid > 0) {
+      pthread_cond_wait(&spare_wanted, &spare_lock);
+      continue;
+    }
+    int started = 0;
+    PiperWorker fresh = {.pid = -1, .stdout_fd = -1, .stderr_fd = -1};
+    if (spare_affordable()) {
+      fresh.first_cpu = FOREGROUND_WORKER->first_cpu;
+      fresh.last_cpu = FOREGROUND_WORKER->last_cpu;
+      fresh.nice = FOREGROUND_WORKER->nice;
+      fresh.model = FOREGROUND_WORKER->model;
+      pthread_mutex_unlock(&spare_lock);
+      started = start_persistent_piper(&fresh) == 0;
+      if (started && hal_tts_warmup_text() != NULL) {
+        prime_worker(&fresh, hal_tts_warmup_text());
+      }
+      pthread_mutex_lock(&spare_lock);
+    } else if (!announced) {
+      printf("HAL TTS: Under %d MB free, no spare Piper for now\n",
+             PIPER_SPARE_MIN_FREE_MB);
+      announced = 1;
+    }
+
+    if (started && spare_running && fresh.speed == current_speed()) {
+      spare = fresh;
+      printf("HAL TTS: Spare Piper ready (pid=%d)\n", spare.pid);
+      announced = 0;
+    } else if (started) {
+      stop_persistent_piper(&fresh); /* Stopping, or the speed changed */
+    } else if (spare_running) {
+      struct timespec until;
+      clock_gettime(CLOCK_REALTIME, &until);
+      until.tv_sec += PIPER_SPARE_RETRY_S;
+      pthread_cond_timedwait(&spare_wanted, &spare_lock, &until);
+    }
+  }
+  pthread_mutex_unlock(&spare_lock);
+  return NULL;
+}
+
+/**
+ * @brief Start the supervisor, unless HAMPOD_PIPER_SPARE=0
+ */
+static void spare_start(void) {
+  const char *env = getenv(PIPER_SPARE_ENV);
+  if (env != NULL && strcmp(env, "0") == 0) {
+    printf("HAL TTS: No spare Piper (%s=0)\n", PIPER_SPARE_ENV);
+    return;
+  }
+  pthread_mutex_lock(&spare_lock);
+  spare_running = 1;
+  pthread_mutex_unlock(&spare_lock);
+  if (pthread_create(&spare_thread, NULL, spare_thread_func, NULL) != 0) {
+    fprintf(stderr, "HAL TTS: Cannot start the spare Piper supervisor\n");
+    spare_running = 0;
+  }
+}
+
+/**
+ * @brief Stop the supervisor and its spare
+ */
+static void spare_stop(void) {
+  pthread_mutex_lock(&spare_lock);
+  int running = spare_running;
+  spare_running = 0;
+  pthread_cond_signal(&spare_wanted);
+  pthread_mutex_unlock(&spare_lock);
+  if (running) {
+    pthread_join(spare_thread, NULL);
+  }
+  stop_persistent_piper(&spare);
+}
+
+/**
+ * @brief Read the voice registry (PIPER_VOICES_ENV); voice 0 is the default
+ *
+ * Entries whose model cannot be read are left out with a message.
+ */
+static void read_voices(void) {
+  snprintf(voices[0].name, sizeof(voices[0].name), "default");
+  snprintf(voices[0].model, sizeof(voices[0].model), "%s", PIPER_MODEL_PATH);
+  voice_count = 1;
+
+  const char *env = getenv(PIPER_VOICES_ENV);
+  char list[PIPER_MAX_VOICES * (PIPER_VOICE_NAME_MAX + 256)];
+  snprintf(list, sizeof(list), "%s", env != NULL ? env : "");
+  char *saved;
+  for (char *entry = strtok_r(list, ",", &saved); entry != NULL;
+       entry = strtok_r(NULL, ",", &saved)) {
+    char *model = strchr(entry, '=');
+    if (model == NULL || model == entry || model[1] == '\0' ||
+        model - entry >= PIPER_VOICE_NAME_MAX) {
+      fprintf(stderr, "HAL TTS: Ignoring voice \"%s\" (want name=model)\n",
+              entry);
+      continue;
+    }
+    *model++ = '\0';
+    int v = strcmp(entry, "default") == 0 ? 0 : voice_count;
+    if (v == PIPER_MAX_VOICES) {
+      fprintf(stderr, "HAL TTS: Only %d voices, ignoring %s\n",
+              PIPER_MAX_VOICES, entry);
+      continue;
+    }
+    if (access(model, R_OK) != 0) {
+      fprintf(stderr, "HAL TTS: Voice %s: no model at %s\n", entry, model);
+      continue;
+    }
+    snprintf(voices[v].name, sizeof(voices[v].name), "%s", entry);
+    snprintf(voices[v].model, sizeof(voices[v].model), "%s", model);
+    voice_count += v == voice_count;
+  }
+
+  const char *preload = getenv(PIPER_VOICE_PRELOAD_ENV);
+  voices_preloaded = preload == NULL || strcmp(preload, "0") != 0;
+}
+
+/**
+ * @brief Set up the other voices' workers like the foreground one
+ *
+ * Call after plan_workers(), before any of them starts.
+ */
+static void plan_voices(void) {
+  for (int v = 1; v < voice_count; v++) {
+    PiperWorker *w = &voices[v].worker;
+    w->pid = -1;
+    w->model = voices[v].model;
+    w->stdin_file = NULL;
+    w->stdout_fd = -1;
+    w->stderr_fd = -1;
+    w->first_cpu = FOREGROUND_WORKER->first_cpu;
+    w->last_cpu = FOREGROUND_WORKER->last_cpu;
+    w->nice = FOREGROUND_WORKER->nice;
+    voices[v].loaded = 0;
+  }
+}
+
+/**
+ * @brief Start a voice's Piper
+ *
+ * Call with its worker's lock held. Without preloading, the other voices
+ * that are not in use are stopped first, so only one of them holds a model
+ * in memory besides the default.
+ *
+ * @param prime Synthesize the warm-up phrase on it before returning
+ * @return 0 on success, -1 if its Piper cannot be started
+ */
+static int load_voice(int v, int prime) {
+  for (int i = 1; !voices_preloaded && i < voice_count; i++) {
+    PiperWorker *other = &voices[i].worker;
+    if (i == v || pthread_mutex_trylock(&other->lock) != 0) {
+      continue;
+    }
+    if (voices[i].loaded) {
+      stop_persistent_piper(other);
+      voices[i].loaded = 0;
+      printf("HAL TTS: Voice %s unloaded\n", voices[i].name);
+    }
+    pthread_mutex_unlock(&other->lock);
+  }
+
+  PiperWorker *w = &voices[v].worker;
+  if (start_persistent_piper(w) != 0) {
+    fprintf(stderr, "HAL TTS: Cannot start voice %s\n", voices[v].name);
+    return -1;
+  }
+  if (prime && hal_tts_warmup_text() != NULL) {
+    prime_worker(w, hal_tts_warmup_text());
+  }
+  voices[v].loaded = 1;
+  printf("HAL TTS: Voice %s loaded (%s)\n", voices[v].name, w->model);
+  return 0;
+}
+
+/**
+ * @brief Lock the worker that speaks a voice in the foreground, starting
+ *        the voice's Piper if it is not loaded
+ *
+ * @return The locked worker, or NULL if the voice cannot be started
+ */
+static PiperWorker *lock_voice_worker(int v) {
+  if (v == 0 || v >= voice_count) { /* Or gone since a restart */
+    pthread_mutex_lock(&FOREGROUND_WORKER->lock);
+    return FOREGROUND_WORKER;
+  }
+  PiperWorker *w = &voices[v].worker;
+  pthread_mutex_lock(&w->lock);
+  if (!voices[v].loaded && load_voice(v, 0) != 0) {
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+  }
+  return w;
+}
+
+/**
+ * @brief Stop the other voices' Pipers
+ */
+static void stop_voices(void) {
+  for (int v = 1; v < voice_count; v++) {
+    pthread_mutex_lock(&voices[v].worker.lock);
+    stop_persistent_piper(&voices[v].worker);
+    voices[v].loaded = 0;
+    pthread_mutex_unlock(&voices[v].worker.lock);
+  }
+}
+
+static int tts_init(void) {
   if (initialized) {
     return 0;
   }
+  read_voices();
 
   /* 1. Check if 'piper' is installed */
   if (system("which piper > /dev/null 2>&1") != 0) {
@@ -230,11 +1029,11 @@ int hal_tts_init(void) {
   }
 
   /* 2. Check if model file exists */
-  if (access(PIPER_MODEL_PATH, F_OK) != 0) {
+  if (access(voices[0].model, F_OK) != 0) {
     fprintf(stderr, "\n");
     fprintf(stderr, "===================================================\n");
     fprintf(stderr, "ERROR: Piper voice model not found!\n");
-    fprintf(stderr, "Expected: %s\n", PIPER_MODEL_PATH);
+    fprintf(stderr, "Expected: %s\n", voices[0].model);
     fprintf(stderr, "===================================================\n");
     fprintf(stderr, "To download the model, run:\n");
     fprintf(stderr, "    ./Documentation/scripts/install_piper.sh\n");
@@ -242,60 +1041,157 @@ int hal_tts_init(void) {
     return -1;
   }
 
-  /* 3. Start persistent Piper subprocess */
-  if (start_persistent_piper() != 0) {
-    fprintf(stderr, "HAL TTS: Failed to start persistent Piper\n");
-    return -1;
+  const char *accel = getenv(PIPER_ACCEL_ENV);
+  piper_cuda = accel != NULL && strcmp(accel, "cuda") == 0;
+  if (accel != NULL && accel[0] != '\0' && !piper_cuda &&
+      strcmp(accel, "cpu") != 0) {
+    fprintf(stderr, "HAL TTS: Unknown %s=%s, using the CPU\n",
+            PIPER_ACCEL_ENV, accel);
+  }
+
+  struct timeval tv_start;
+  struct timeval tv_started;
+  const char *warmup = hal_tts_warmup_text();
+  int count = pool_size();
+  for (;;) {
+    /* 3. Start the persistent Piper subprocesses; the pool shrinks to the
+     * workers that start, but the foreground one must. The model is read
+     * in first so each Piper loads it from RAM. */
+    gettimeofday(&tv_start, NULL);
+    hal_tts_cache_set_voice(voices[0].model);
+    hal_tts_preload_model(voices[0].model);
+    plan_workers(count);
+    plan_voices();
+    if (start_persistent_piper(FOREGROUND_WORKER) != 0) {
+      fprintf(stderr, "HAL TTS: Failed to start persistent Piper\n");
+      return -1;
+    }
+    worker_count = 1;
+    while (worker_count < count &&
+           start_persistent_piper(&workers[worker_count]) == 0) {
+      worker_count++;
+    }
+    gettimeofday(&tv_started, NULL);
+
+    /* 4. Prime every worker, so the first announcement after boot comes
+     * at steady-state latency. On the accelerator or a replaced model the
+     * foreground one is tried even with warm-up off, to fall back from
+     * them now rather than at the first announcement. */
+    int on_trial =
+        piper_cuda || strcmp(voices[0].model, PIPER_MODEL_PATH) != 0;
+    int primed = 0;
+    for (int i = 0; i < worker_count; i++) {
+      const char *text = warmup;
+      if (text == NULL && i == 0 && on_trial) {
+        text = PIPER_PROBE_TEXT;
+      }
+      if (text != NULL && prime_worker(&workers[i], text) != 0 && i == 0) {
+        primed = -1;
+      }
+    }
+    if ((primed == 0 && is_piper_running(FOREGROUND_WORKER)) ||
+        !fall_back()) {
+      break;
+    }
+    for (int i = 0; i < worker_count; i++) {
+      stop_persistent_piper(&workers[i]);
+    }
+    hal_tts_release_model();
   }
 
-  printf("HAL TTS: Piper initialized (model=%s, speed=%s, persistent=yes)\n",
-         PIPER_MODEL_PATH, PIPER_SPEED);
+  struct timeval tv_end;
+  gettimeofday(&tv_end, NULL);
+  long long warmup_ms = (tv_end.tv_sec - tv_start.tv_sec) * 1000LL +
+                        (tv_end.tv_usec - tv_start.tv_usec) / 1000;
+  printf("HAL TTS: Piper initialized (model=%s on %s, speed=%s, "
+         "persistent=yes, workers=%d, warm-up %s in %lld ms)\n",
+         voices[0].model, piper_cuda ? "CUDA" : "CPU", PIPER_SPEED,
+         worker_count, warmup != NULL ? "done" : "skipped", warmup_ms);
+  long long start_ms = (tv_started.tv_sec - tv_start.tv_sec) * 1000LL +
+                       (tv_started.tv_usec - tv_start.tv_usec) / 1000;
+  hal_tts_note_init_times(start_ms, warmup_ms - start_ms);
   initialized = 1;
+
+  /* 5. Load the other voices, so switching to one is instant */
+  for (int v = 1; v < voice_count; v++) {
+    if (!voices_preloaded) {
+      printf("HAL TTS: Voice %s loads on first use (%s=0)\n",
+             voices[v].name, PIPER_VOICE_PRELOAD_ENV);
+      continue;
+    }
+    pthread_mutex_lock(&voices[v].worker.lock);
+    load_voice(v, 1);
+    pthread_mutex_unlock(&voices[v].worker.lock);
+  }
+
+  /* 6. Keep a spare ready for a crash, started in the background */
+  spare_start();
   return 0;
 }
 
-int hal_tts_speak(const char *text, const char *output_file) {
-  (void)output_file; /* Ignored - we stream directly */
+/**
+ * @brief Send a phrase again after its Piper died while speaking it
+ *
+ * Call with the worker's lock held. The dead Piper is replaced (by the
+ * spare if one is ready) and the phrase sent from the start; the caller
+ * skips the audio that was heard already.
+ *
+ * @return 0 once the phrase is on its way, -1 if there is no Piper for it
+ */
+static int replay_phrase(PiperWorker *w, const char *text) {
+  if (replace_piper(w) != 0 || send_to_piper(w, text) != 0) {
+    return -1;
+  }
+  printf("HAL TTS: Replaying \"%s\" after a Piper crash\n", text);
+  return 0;
+}
 
+/**
+ * @brief Speak one phrase: from the cache, or else through the foreground
+ *        worker, caching what it synthesizes
+ *
+ * @param start_time When the announcement was requested (ms)
+ * @param heard Set once the announcement's first audio is out, so the time
+ *        to first speech is logged once
+ * @return 0 on success, 1 if interrupted, -1 on failure
+ */
+static int speak_phrase(const char *text, long long start_time, int *heard) {
   int16_t chunk_buffer[TTS_CHUNK_SAMPLES];
   ssize_t bytes_read;
   int received_any_audio = 0;
-
-  if (!initialized) {
-    if (hal_tts_init() != 0) {
-      return -1;
-    }
-  }
-
-  /* Clear TTS interrupt flag for this new utterance.
-   * NOTE: We don't clear audio_interrupted here - if we were just interrupted,
-   * the new TTS should still respect that. audio_interrupted will be cleared
-   * by the firmware when a new non-interrupt audio packet arrives.
-   */
-  tts_interrupted = 0;
-
-  struct timeval tv_start;
-  gettimeofday(&tv_start, NULL);
-  long long start_time =
-      (long long)tv_start.tv_sec * 1000 + tv_start.tv_usec / 1000;
+  size_t produced = 0;    /* Samples Piper gave for this phrase */
+  size_t replay_skip = 0; /* Of a replay's audio, what was already heard */
+  int replayed = 0;
 
   /* CHECK CACHE BEFORE PIPER SYNTHESIS */
-  int16_t *cached_samples = NULL;
+  const int16_t *cached_samples = NULL;
   size_t cached_num_samples = 0;
-  if (hal_tts_cache_lookup(text, &cached_samples, &cached_num_samples) == 0) {
+  if (hal_tts_cache_lookup(text, current_speed(), &cached_samples,
+                           &cached_num_samples) == 0) {
     /* Cache hit - play directly from RAM in chunks */
     size_t remaining = cached_num_samples;
-    int16_t *ptr = cached_samples;
+    const int16_t *ptr = cached_samples;
 
     struct timeval tv_now;
     gettimeofday(&tv_now, NULL);
     long long now_time =
         (long long)tv_now.tv_sec * 1000 + tv_now.tv_usec / 1000;
 
-    printf("HAL TTS: Cache hit for \"%s\"\n", text);
-    printf("HAL TTS: Time to first speech chunk: %lld ms\n",
-           now_time - start_time);
+    hampod_trace(TRACE_TTS_CACHE_HIT, (uint32_t)cached_num_samples, 0, 0);
+    if (!*heard) {
+      hal_tts_note_first_audio(1, now_time - start_time);
+      *heard = 1;
+    }
+    hal_tts_note_utterance(cached_samples, cached_num_samples);
+    /* One segment played from the cache's own buffer, so this returns at
+     * once and Piper can start on the next request while it plays; written
+     * in chunks if the queue is full */
     int cache_interrupted = 0;
+    if (hal_audio_queue_shared(cached_samples, cached_num_samples,
+                               hal_tts_cache_release) == 0) {
+      remaining = 0;
+      cached_samples = NULL; /* Released once played */
+    }
     while (remaining > 0) {
       if (tts_interrupted) {
         cache_interrupted = 1;
@@ -315,189 +1211,411 @@ int hal_tts_speak(const char *text, const char *output_file) {
     hal_tts_cache_release(cached_samples);
 
     if (cache_interrupted) {
-      printf("HAL TTS: Speech interrupted (cached)\n");
+      hampod_trace(TRACE_TTS_INTERRUPTED, 0, 0, 0);
+      return 1;
     }
     return 0;
   }
   /* CACHE MISS - CONTINUE WITH PIPER */
 
+  /* The foreground worker (or the voice's own) is ours alone unless the
+   * pool is one worker and hal_tts_warm() has it for a moment */
+  PiperWorker *w = lock_voice_worker(thread_voice);
+  if (w == NULL) {
+    return -1;
+  }
+
   /* Ensure Piper is still running, restart if needed */
-  if (!is_piper_running()) {
-    printf("HAL TTS: Piper process died, restarting...\n");
-    stop_persistent_piper();
-    if (start_persistent_piper() != 0) {
-      fprintf(stderr, "HAL TTS: Failed to restart Piper\n");
-      return -1;
-    }
+  if (ensure_piper(w) != 0) {
+    pthread_mutex_unlock(&w->lock);
+    return -1;
   }
 
   /* Ensure audio pipeline is ready */
   if (!hal_audio_pipeline_ready()) {
     fprintf(stderr, "HAL TTS: Audio pipeline not ready\n");
+    pthread_mutex_unlock(&w->lock);
     return -1;
   }
 
-  /* Clear TTS interrupt flag for this new utterance.
-   * NOTE: We don't clear audio_interrupted here - if we were just interrupted,
-   * the new TTS should still respect that. audio_interrupted will be cleared
-   * by the firmware when a new non-interrupt audio packet arrives.
-   */
-  tts_interrupted = 0;
+  /* Piper would start on this line only after an interrupted one */
+  if (skip_stale_audio(w, &tts_interrupted) != 0) {
+    hampod_trace(TRACE_TTS_INTERRUPTED, 0, 0, 0);
+    pthread_mutex_unlock(&w->lock);
+    return 1;
+  }
 
   /* Send text to Piper via stdin (with newline to trigger processing) */
-  if (fprintf(piper_stdin, "%s\n", text) < 0 || fflush(piper_stdin) != 0) {
+  struct timeval tv_sent;
+  gettimeofday(&tv_sent, NULL);
+  if (send_to_piper(w, text) != 0) {
     fprintf(stderr, "HAL TTS: Failed to write to Piper stdin\n");
+    pthread_mutex_unlock(&w->lock);
     return -1;
   }
 
-  /* Stream Piper output through audio HAL in chunks.
-   * Use select() with timeout to detect end of utterance. */
+  /* Stream Piper output through audio HAL in chunks until the marker is
+   * in and stdout is drained (see the file comment). */
 
-  size_t capture_capacity = 16000 * 2; /* Start with 2 seconds */
+  /* Captured for the cache in a recycled buffer that is handed to the
+   * cache writer afterwards (see hal_tts_cache_store_owned()) */
+  size_t capture_capacity;
   size_t capture_len = 0;
-  int16_t *capture_buf = (int16_t *)malloc(capture_capacity * sizeof(int16_t));
+  int16_t *capture_buf = hal_tts_cache_buffer(&capture_capacity);
 
   int was_interrupted = 0;
 
+  /* Once the ring is full the rest of the utterance waits in capture_buf
+   * from spill_from on and is queued as one segment when Piper is done, so
+   * Piper never waits for playback and the next request is synthesized
+   * while this one still plays */
+  int spilling = 0;
+  size_t spill_from = 0;
+
   for (;;) {
     if (tts_interrupted) {
       was_interrupted = 1;
       break;
     }
-    fd_set read_fds;
-    struct timeval timeout;
-
-    FD_ZERO(&read_fds);
-    FD_SET(piper_stdout_fd, &read_fds);
 
-    /* Timeout: 100ms - if no data within this period after receiving some
-     * audio, we assume the utterance is complete */
-    timeout.tv_sec = 0;
-    timeout.tv_usec = TTS_READ_TIMEOUT_US;
+    /* Without markers, silence after some audio ends the utterance */
+    long timeout_us = piper_framed || !received_any_audio
+                          ? TTS_STALL_TIMEOUT_US
+                          : TTS_READ_TIMEOUT_US;
+    int ready = wait_for_piper(w, timeout_us);
 
-    int select_result =
-        select(piper_stdout_fd + 1, &read_fds, NULL, NULL, &timeout);
-
-    if (select_result < 0) {
-      if (errno == EINTR) {
-        continue; /* Interrupted by signal, retry */
-      }
+    if (ready < 0) {
       perror("HAL TTS: select() error");
       break;
     }
 
-    if (select_result == 0) {
+    if (ready == 0) {
       /* Timeout - no data available */
-      if (received_any_audio) {
-        /* We've received audio and now timed out - utterance complete */
-        break;
+      if (piper_framed) {
+        piper_framing_lost(w);
       }
-      /* Still waiting for first audio data, continue waiting */
-      continue;
+      break;
     }
 
-    /* Data available - read it */
-    bytes_read = read(piper_stdout_fd, chunk_buffer, TTS_CHUNK_BYTES);
-
-    if (bytes_read <= 0) {
-      if (bytes_read < 0 && errno == EINTR) {
-        continue; /* Interrupted by signal, retry */
+    if ((ready & PIPER_LOG_READY) && read_piper_log(w) != 0) {
+      fprintf(stderr, "HAL TTS: Piper closed its log (Piper may have "
+                      "crashed)\n");
+      if (!replayed && replay_phrase(w, text) == 0) {
+        replayed = 1;
+        replay_skip = produced;
+        received_any_audio = 0;
+        continue;
       }
-      /* EOF or error - this shouldn't happen with persistent Piper */
-      fprintf(stderr, "HAL TTS: Read returned %zd (Piper may have crashed)\n",
-              bytes_read);
       break;
     }
+    int finished = piper_framed && w->pending == 0;
 
-    if (!received_any_audio) {
-      /* First audio chunk received */
-      struct timeval tv;
-      gettimeofday(&tv, NULL);
-      long long now = (long long)tv.tv_sec * 1000 + tv.tv_usec / 1000;
-      printf("HAL TTS: Time to first speech chunk: %lld ms\n",
-             now - start_time);
+    /* Read the audio; once the marker is in, all that is left is ours */
+    if (!(ready & PIPER_AUDIO_READY) && !finished) {
+      continue;
     }
-    received_any_audio = 1;
-
-    /* Capture PCM output for caching */
-    if (capture_buf) {
+    for (;;) {
+      if (tts_interrupted) {
+        was_interrupted = 1;
+        break;
+      }
+      bytes_read = read(w->stdout_fd, chunk_buffer, TTS_CHUNK_BYTES);
+      if (bytes_read <= 0) {
+        break;
+      }
       size_t samples_read = bytes_read / 2;
-      if (capture_len + samples_read > capture_capacity) {
-        capture_capacity *= 2;
-        int16_t *new_buf =
-            (int16_t *)realloc(capture_buf, capture_capacity * sizeof(int16_t));
-        if (new_buf) {
-          capture_buf = new_buf;
-        } else {
-          free(capture_buf);
-          capture_buf = NULL; /* Stop capturing on out-of-memory */
+      const int16_t *chunk = chunk_buffer;
+      if (replay_skip > 0) {
+        /* Heard before the crash */
+        size_t drop = samples_read < replay_skip ? samples_read : replay_skip;
+        replay_skip -= drop;
+        chunk += drop;
+        samples_read -= drop;
+        if (samples_read == 0) {
+          continue;
         }
       }
+      produced += samples_read;
+
+      if (!*heard) {
+        /* First audio chunk received */
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        long long now = (long long)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+        hal_tts_note_first_audio(0, now - start_time);
+        *heard = 1;
+      }
+      received_any_audio = 1;
+
+      /* Capture PCM output for caching */
       if (capture_buf) {
-        memcpy(capture_buf + capture_len, chunk_buffer, bytes_read);
-        capture_len += samples_read;
+        if (capture_len + samples_read > capture_capacity) {
+          /* Grown for good: the buffer keeps its size when recycled */
+          size_t new_capacity = capture_capacity * 2;
+          int16_t *new_buf = (int16_t *)hampod_realloc(
+              ALLOC_TTS_CAPTURE, capture_buf, new_capacity * sizeof(int16_t));
+          if (new_buf) {
+            capture_buf = new_buf;
+            capture_capacity = new_capacity;
+          } else {
+            /* Out of memory: play what was spilled, then stop capturing */
+            if (spilling) {
+              hal_audio_write_raw(capture_buf + spill_from,
+                                  capture_len - spill_from);
+              spilling = 0;
+            }
+            hampod_free(capture_buf);
+            capture_buf = NULL;
+          }
+        }
+        if (capture_buf) {
+          memcpy(capture_buf + capture_len, chunk,
+                 samples_read * sizeof(int16_t));
+          capture_len += samples_read;
+        }
+      }
+
+      if (!spilling && capture_buf != NULL &&
+          hal_audio_ring_free() < samples_read) {
+        spilling = 1;
+        spill_from = capture_len - samples_read;
+      }
+
+      /* Write chunk to audio HAL */
+      if (!spilling && hal_audio_write_raw(chunk, samples_read) != 0) {
+        fprintf(stderr, "HAL TTS: Audio write failed\n");
+        was_interrupted = 1;
+        break;
       }
     }
 
-    /* Write chunk to audio HAL */
-    if (hal_audio_write_raw(chunk_buffer, bytes_read / 2) != 0) {
-      fprintf(stderr, "HAL TTS: Audio write failed\n");
-      was_interrupted = 1;
+    if (was_interrupted) {
+      break;
+    }
+    if (bytes_read == 0) {
+      /* EOF - this shouldn't happen with persistent Piper */
+      fprintf(stderr, "HAL TTS: Read returned 0 (Piper may have crashed)\n");
+      if (!replayed && replay_phrase(w, text) == 0) {
+        replayed = 1;
+        replay_skip = produced;
+        received_any_audio = 0;
+        continue;
+      }
       break;
     }
+    if (finished) {
+      break;
+    }
+  }
+  pthread_mutex_unlock(&w->lock);
+
+  /* Playback does not hold Piper up (see spilling), so this is the
+   * synthesis time */
+  if (!was_interrupted && capture_len > 0) {
+    struct timeval tv_done;
+    gettimeofday(&tv_done, NULL);
+    hal_tts_thermal_note((tv_done.tv_sec - tv_sent.tv_sec) * 1000LL +
+                             (tv_done.tv_usec - tv_sent.tv_usec) / 1000,
+                         capture_len);
+  }
+
+  /* Plays after what is already in the ring */
+  if (spilling && !was_interrupted &&
+      hal_audio_queue_samples(capture_buf + spill_from,
+                              capture_len - spill_from) != 0 &&
+      hal_audio_write_raw(capture_buf + spill_from,
+                          capture_len - spill_from) != 0) {
+    fprintf(stderr, "HAL TTS: Audio write failed\n");
   }
 
   if (was_interrupted) {
-    printf("HAL TTS: Speech interrupted\n");
+    hampod_trace(TRACE_TTS_INTERRUPTED, 0, 0, 0);
   } else if (capture_buf && capture_len > 0) {
-    /* Successful playback, store to cache */
-    if (hal_tts_cache_store(text, capture_buf, capture_len) == 0) {
-      printf("HAL TTS: Cached \"%s\" (%zu samples)\n", text, capture_len);
+    hal_tts_note_utterance(capture_buf, capture_len);
+    /* Successful playback, store to cache under the speed Piper ran at;
+     * the buffer goes with it */
+    if (hal_tts_cache_store_owned(text, w->speed, capture_buf, capture_len,
+                                  capture_capacity) == 0) {
+      hampod_trace(TRACE_TTS_CACHED, (uint32_t)capture_len, 0, 0);
+    }
+    capture_buf = NULL;
+  }
+  hal_tts_cache_recycle(capture_buf, capture_capacity);
+
+  return was_interrupted;
+}
+
+static int tts_speak(const char *text, const char *output_file) {
+  (void)output_file; /* Ignored - we stream directly */
+
+  if (!initialized) {
+    if (tts_init() != 0) {
+      return -1;
     }
   }
 
-  if (capture_buf) {
-    free(capture_buf);
+  /* Clear TTS interrupt flag for this new utterance.
+   * NOTE: We don't clear audio_interrupted here - if we were just interrupted,
+   * the new TTS should still respect that. audio_interrupted will be cleared
+   * by the firmware when a new non-interrupt audio packet arrives.
+   */
+  tts_interrupted = 0;
+
+  struct timeval tv_start;
+  gettimeofday(&tv_start, NULL);
+  long long start_time =
+      (long long)tv_start.tv_sec * 1000 + tv_start.tv_usec / 1000;
+
+  /* One phrase at a time (see hal_tts_phrase.h): the first plays while
+   * Piper synthesizes the next, so time to first audio does not grow with
+   * the text. Blank text has no phrases, which Piper would not answer. */
+  char phrase[HAL_TTS_PHRASE_MAX + 1];
+  const char *start;
+  size_t len;
+  int heard = 0;
+  int result = 0;
+  while (result == 0 &&
+         (start = hal_tts_next_phrase(text, &len, &text)) != NULL) {
+    memcpy(phrase, start, len);
+    phrase[len] = '\0';
+    result = speak_phrase(phrase, start_time, &heard);
   }
+  return result < 0 ? -1 : 0;
+}
 
-  return 0;
+/**
+ * @brief Take a background worker, preferring one that is free
+ *
+ * With a single worker that is the foreground one, shared with speech.
+ */
+static PiperWorker *take_background_worker(void) {
+  if (worker_count == 1) {
+    pthread_mutex_lock(&FOREGROUND_WORKER->lock);
+    return FOREGROUND_WORKER;
+  }
+  for (int i = 1; i < worker_count; i++) {
+    if (pthread_mutex_trylock(&workers[i].lock) == 0) {
+      return &workers[i];
+    }
+  }
+  pthread_mutex_lock(&pool_lock);
+  PiperWorker *w = &workers[1 + next_background];
+  next_background = (next_background + 1) % (worker_count - 1);
+  pthread_mutex_unlock(&pool_lock);
+  pthread_mutex_lock(&w->lock);
+  return w;
+}
+
+/**
+ * @brief Cache one phrase on a background worker unless already cached
+ * @return 0 once it is cached, -1 on failure
+ */
+static int warm_phrase(const char *text) {
+  if (hal_tts_cache_contains(text, current_speed())) {
+    return 0;
+  }
+
+  int16_t *samples;
+  size_t num_samples;
+  PiperWorker *w = thread_voice != 0 ? lock_voice_worker(thread_voice)
+                                     : take_background_worker();
+  if (w == NULL) {
+    return -1;
+  }
+  int result = -1;
+  size_t capacity;
+  if (ensure_piper(w) == 0 && skip_stale_audio(w, NULL) == 0 &&
+      send_to_piper(w, text) == 0 &&
+      capture_utterance(w, &samples, &num_samples, &capacity) == 0) {
+    /* Written before returning, so the phrase is cached once this is */
+    result = hal_tts_cache_store(text, w->speed, samples, num_samples);
+    hal_tts_cache_recycle(samples, capacity);
+  }
+  pthread_mutex_unlock(&w->lock);
+
+  if (result == 0) {
+    printf("HAL TTS: Warmed \"%s\" (%zu samples)\n", text, num_samples);
+  }
+  return result;
 }
 
-void hal_tts_interrupt(void) {
+static int tts_warm(const char *text) {
+  if (!initialized || text == NULL || text[strspn(text, " \t\r\n")] == '\0') {
+    return -1;
+  }
+
+  /* Cached phrase by phrase, as hal_tts_speak() looks it up */
+  char phrase[HAL_TTS_PHRASE_MAX + 1];
+  const char *start;
+  size_t len;
+  int result = 0;
+  while (result == 0 &&
+         (start = hal_tts_next_phrase(text, &len, &text)) != NULL) {
+    memcpy(phrase, start, len);
+    phrase[len] = '\0';
+    result = warm_phrase(phrase);
+  }
+  return result;
+}
+
+static void tts_interrupt(void) {
   tts_interrupted = 1;
   /* Also interrupt the audio HAL to stop any buffered audio */
   hal_audio_interrupt();
-  printf("HAL TTS: Interrupt requested\n");
+  /* The rest of Piper's output for this utterance is skipped by the next
+   * hal_tts_speak(), which knows where it ends */
+}
 
-  /* Drain any buffered audio from Piper's stdout pipe.
-   * This prevents old audio from playing on the next TTS request.
-   * Limit iterations to prevent hangs during rapid interrupts. */
-  if (piper_stdout_fd >= 0) {
-    char drain_buf[4096];
-    int flags = fcntl(piper_stdout_fd, F_GETFL, 0);
-    fcntl(piper_stdout_fd, F_SETFL, flags | O_NONBLOCK);
-    int drain_count = 0;
-    while (read(piper_stdout_fd, drain_buf, sizeof(drain_buf)) > 0 &&
-           drain_count < 20) {
-      drain_count++;
-      /* Discard the data */
-    }
-    fcntl(piper_stdout_fd, F_SETFL, flags); /* Restore blocking mode */
+/* The foreground Piper is killed without its lock, which the stuck speak
+ * holds: the speak sees the pipes close, and the next one replaces it,
+ * from the spare if one is ready */
+static void tts_restart(void) {
+  pid_t pid = FOREGROUND_WORKER->pid;
+  if (initialized && pid > 0) {
+    printf("HAL TTS: Killing the foreground Piper (pid=%d)\n", pid);
+    kill(pid, SIGKILL);
   }
 }
 
-void hal_tts_cleanup(void) {
-  stop_persistent_piper();
+static void tts_cleanup(void) {
+  spare_stop();
+  stop_voices();
+  for (int i = 0; i < worker_count; i++) {
+    pthread_mutex_lock(&workers[i].lock);
+    stop_persistent_piper(&workers[i]);
+    pthread_mutex_unlock(&workers[i].lock);
+  }
+  worker_count = 0;
+  hal_tts_release_model();
   hal_tts_cache_cleanup();
   initialized = 0;
   printf("HAL TTS: Piper cleaned up\n");
 }
 
-const char *hal_tts_get_impl_name(void) {
-  return "Piper (Persistent Subprocess)";
+/* Names the model and provider too, so benchmark results say what ran */
+static const char *tts_impl_name(void) {
+  static char name[sizeof(voices[0].model) + 48];
+  if (!initialized) {
+    return "Piper (Persistent Subprocess)";
+  }
+  const char *model = strrchr(voices[0].model, '/');
+  snprintf(name, sizeof(name), "Piper (Persistent Subprocess) %s on %s",
+           model != NULL ? model + 1 : voices[0].model,
+           piper_cuda ? "CUDA" : "CPU");
+  return name;
+}
+
+static int tts_set_cpus(int first_cpu, int last_cpu) {
+  if (initialized || first_cpu < 0 || last_cpu < first_cpu) {
+    return -1;
+  }
+  tts_first_cpu = first_cpu;
+  tts_last_cpu = last_cpu;
+  printf("HAL TTS: Piper kept to CPUs %d-%d\n", first_cpu, last_cpu);
+  return 0;
 }
 
-int hal_tts_set_speed(float speed) {
+static int tts_set_speed(float speed) {
   /* Validate speed range (0.1 to 3.0 for experimentation) */
   if (speed < 0.1f)
     speed = 0.1f;
@@ -505,21 +1623,97 @@ int hal_tts_set_speed(float speed) {
     speed = 3.0f;
 
   /* Format speed as string */
+  pthread_mutex_lock(&pool_lock);
   snprintf(piper_speed, sizeof(piper_speed), "%.2f", speed);
-  printf("HAL TTS: Setting speech speed to %s\n", piper_speed);
-
-  /* If Piper is already running, restart it with new speed */
-  if (initialized && piper_pid > 0) {
+  pthread_mutex_unlock(&pool_lock);
+  printf("HAL TTS: Setting speech speed to %.2f\n", speed);
+
+  /* If Piper is already running, restart it with new speed. A worker in
+   * use restarts before its next request instead, so this never waits for
+   * speech to finish. */
+  int result = 0;
+  for (int i = 0; initialized && i < worker_count; i++) {
+    PiperWorker *w = &workers[i];
+    if (pthread_mutex_trylock(&w->lock) != 0) {
+      w->restart_due = 1;
+      continue;
+    }
     printf("HAL TTS: Restarting Piper with new speed\n");
-    stop_persistent_piper();
-    if (start_persistent_piper() != 0) {
+    stop_persistent_piper(w);
+    if (start_persistent_piper(w) != 0) {
       fprintf(stderr, "HAL TTS: Failed to restart Piper with new speed\n");
-      return -1;
+      result = -1;
+    } else if (hal_tts_warmup_text() != NULL) {
+      prime_worker(w, hal_tts_warmup_text());
+    }
+    pthread_mutex_unlock(&w->lock);
+  }
+
+  /* The other voices likewise; those not loaded start at the new speed */
+  for (int v = 1; initialized && v < voice_count; v++) {
+    PiperWorker *w = &voices[v].worker;
+    if (pthread_mutex_trylock(&w->lock) != 0) {
+      w->restart_due = 1;
+      continue;
     }
+    if (voices[v].loaded) {
+      stop_persistent_piper(w);
+      if (load_voice(v, 1) != 0) {
+        result = -1;
+      }
+    }
+    pthread_mutex_unlock(&w->lock);
   }
 
-  /* Clear the cache so old, slower/faster speech isn't regurgitated */
-  hal_tts_cache_clear();
+  /* The spare runs at the old speed: replace it */
+  pthread_mutex_lock(&spare_lock);
+  if (spare.pid > 0) {
+    stop_persistent_piper(&spare);
+    pthread_cond_signal(&spare_wanted);
+  }
+  pthread_mutex_unlock(&spare_lock);
 
-  return 0;
+  /* Cached speech is kept per speed, so nothing is cleared: phrases
+   * already heard at this speed still play at once */
+  return result;
 }
+
+static int tts_cached(const char *text) {
+  return hal_tts_cache_contains(text, current_speed());
+}
+
+static int tts_select_voice(const char *name) {
+  int v = 0;
+  int result = 0;
+  if (name != NULL && name[0] != '\0') {
+    while (v < voice_count && strcmp(voices[v].name, name) != 0) {
+      v++;
+    }
+    if (v == voice_count) {
+      fprintf(stderr, "HAL TTS: No voice named %s, using the default\n",
+              name);
+      v = 0;
+      result = -1;
+    }
+  }
+  if (v != thread_voice) {
+    thread_voice = v;
+    hal_tts_cache_select_voice(v != 0 ? voices[v].model : NULL);
+  }
+  return result;
+}
+
+const HalTtsBackend hal_tts_piper_backend = {
+    .name = "piper",
+    .init = tts_init,
+    .speak = tts_speak,
+    .warm = tts_warm,
+    .interrupt = tts_interrupt,
+    .cleanup = tts_cleanup,
+    .impl_name = tts_impl_name,
+    .set_speed = tts_set_speed,
+    .set_cpus = tts_set_cpus,
+    .cached = tts_cached,
+    .select_voice = tts_select_voice,
+    .restart = tts_restart,
+};
@@ -0,0 +1,133 @@
+/**
+ * @file hal_tts_thermal.c
+ * @brief SoC temperature, throttle state and real-time factor tracking
+ */
+
+#include "hal_tts_thermal.h"
+#include "hal_audio_convert.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define THERMAL_TEMP_PATH "/sys/class/thermal/thermal_zone0/temp"
+/* What "vcgencmd get_throttled" reports, on Raspberry Pi kernels */
+#define THERMAL_THROTTLED_PATH                                                 \
+  "/sys/devices/platform/soc/soc:firmware/get_throttled"
+#define THERMAL_THROTTLED_NOW 0xE /* Capped, throttled, soft temp limit */
+
+#define THERMAL_CHECK_MS 5000  /* Between sysfs reads */
+#define THERMAL_COOL_C 5       /* Below the hot mark before cooling off */
+#define THERMAL_COOL_RTF 0.75f /* Fraction of the RTF limit to cool off */
+#define THERMAL_RTF_WEIGHT 0.25f /* Of each new utterance in the average */
+
+#define DEFAULT_HOT_C 75
+#define DEFAULT_MAX_RTF 0.8f
+#define DEFAULT_HOT_SCALE 0.85f
+
+static pthread_mutex_t thermal_lock = PTHREAD_MUTEX_INITIALIZER;
+static int settings_read = 0;
+static int hot_c = DEFAULT_HOT_C;
+static float max_rtf = DEFAULT_MAX_RTF;
+static float hot_scale = DEFAULT_HOT_SCALE;
+
+static float rtf = 0.0f; /* Running average, 0 until measured */
+static int hot = 0;
+static long long last_check = -THERMAL_CHECK_MS;
+
+static long long now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Call with thermal_lock held */
+static void read_settings(void) {
+  if (settings_read) {
+    return;
+  }
+  settings_read = 1;
+  const char *env = getenv("HAMPOD_TTS_HOT_C");
+  if (env != NULL && atoi(env) > 0) {
+    hot_c = atoi(env);
+  }
+  env = getenv("HAMPOD_TTS_MAX_RTF");
+  if (env != NULL && atof(env) > 0) {
+    max_rtf = (float)atof(env);
+  }
+  env = getenv("HAMPOD_TTS_HOT_SCALE");
+  if (env != NULL && atof(env) > 0) {
+    hot_scale = (float)atof(env);
+  }
+}
+
+/* First number in a sysfs file; 0 on success */
+static int read_sysfs(const char *path, int base, unsigned long *value) {
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    return -1;
+  }
+  char line[32];
+  int result = fgets(line, sizeof(line), f) != NULL ? 0 : -1;
+  fclose(f);
+  if (result == 0) {
+    *value = strtoul(line, NULL, base);
+  }
+  return result;
+}
+
+void hal_tts_thermal_note(long long synth_ms, unsigned long num_samples) {
+  if (num_samples == 0) {
+    return;
+  }
+  float sample = (float)synth_ms * AUDIO_CONVERT_RATE / 1000.0f / num_samples;
+  pthread_mutex_lock(&thermal_lock);
+  rtf = rtf == 0.0f ? sample
+                    : rtf + THERMAL_RTF_WEIGHT * (sample - rtf);
+  pthread_mutex_unlock(&thermal_lock);
+}
+
+int hal_tts_thermal_hot(void) {
+  pthread_mutex_lock(&thermal_lock);
+  read_settings();
+  long long now = now_ms();
+  if (now - last_check < THERMAL_CHECK_MS) {
+    int result = hot;
+    pthread_mutex_unlock(&thermal_lock);
+    return result;
+  }
+  last_check = now;
+
+  /* Either file may be missing off a Pi; the RTF still counts */
+  unsigned long millideg = 0;
+  int temp = read_sysfs(THERMAL_TEMP_PATH, 10, &millideg) == 0
+                 ? (int)(millideg / 1000)
+                 : -1;
+  unsigned long throttled = 0;
+  read_sysfs(THERMAL_THROTTLED_PATH, 16, &throttled);
+  throttled &= THERMAL_THROTTLED_NOW;
+
+  int was_hot = hot;
+  if (!hot) {
+    hot = temp >= hot_c || throttled != 0 || rtf >= max_rtf;
+  } else {
+    hot = temp > hot_c - THERMAL_COOL_C || throttled != 0 ||
+          rtf > max_rtf * THERMAL_COOL_RTF;
+  }
+  if (hot != was_hot) {
+    printf("HAL TTS: %s (%d C, throttled 0x%lx, RTF %.2f), speech %s\n",
+           hot ? "Running hot" : "Cooled down", temp, throttled, rtf,
+           hot ? "sped up" : "back to normal");
+  }
+  int result = hot;
+  pthread_mutex_unlock(&thermal_lock);
+  return result;
+}
+
+float hal_tts_thermal_scale(void) {
+  pthread_mutex_lock(&thermal_lock);
+  read_settings();
+  float scale = hot_scale;
+  pthread_mutex_unlock(&thermal_lock);
+  return scale;
+}
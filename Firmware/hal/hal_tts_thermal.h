@@ -0,0 +1,47 @@
+#ifndef HAL_TTS_THERMAL_H
+#define HAL_TTS_THERMAL_H
+
+/**
+ * @file hal_tts_thermal.h
+ * @brief Watches SoC heat and synthesis speed for the TTS HAL
+ *
+ * A hot or throttled Pi synthesizes more slowly, so speech latency drifts
+ * up over a long session. The SoC temperature and firmware throttle flags
+ * are read from sysfs, and the backends report the real-time factor
+ * (synthesis time over audio time) of each utterance. While any of them
+ * is over its limit, hal_tts.c runs the engine at a faster length scale,
+ * and puts it back once all of them are comfortably under.
+ *
+ * Environment:
+ *   HAMPOD_TTS_HOT_C      Temperature in degrees C that counts as hot
+ *                         (default 75)
+ *   HAMPOD_TTS_MAX_RTF    Real-time factor that counts as too slow
+ *                         (default 0.8)
+ *   HAMPOD_TTS_HOT_SCALE  Length scale multiplier while hot (default
+ *                         0.85); 1 turns the scaling off
+ */
+
+/**
+ * @brief Report how long an utterance took to synthesize
+ * @param synth_ms Synthesis time in milliseconds
+ * @param num_samples Audio produced, in samples at the pipeline rate
+ */
+void hal_tts_thermal_note(long long synth_ms, unsigned long num_samples);
+
+/**
+ * @brief Check whether speech should be sped up
+ *
+ * Re-reads sysfs at most every few seconds, so it is cheap to call before
+ * every utterance.
+ *
+ * @return 1 while hot, throttled or too slow, 0 otherwise
+ */
+int hal_tts_thermal_hot(void);
+
+/**
+ * @brief The length scale multiplier to use while hot
+ * @return HAMPOD_TTS_HOT_SCALE, 1.0 if scaling is off
+ */
+float hal_tts_thermal_scale(void);
+
+#endif /* HAL_TTS_THERMAL_H */
@@ -0,0 +1,245 @@
+/**
+ * @file hal_tts_warmup.c
+ * @brief Model preloading and priming phrase for TTS start-up
+ */
+
+#define _GNU_SOURCE /* SCHED_IDLE */
+
+#include "hal_tts_warmup.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define WARMUP_TEXT_ENV "HAMPOD_TTS_WARMUP"
+#define WARMUP_MODEL_ENV "HAMPOD_TTS_MODEL"
+#define WARMUP_MLOCK_ENV "HAMPOD_TTS_MLOCK" /* "1": same as MODEL=lock */
+#define DEFAULT_WARMUP_TEXT "Ready."
+#define KEEP_INTERVAL_S 10 /* Between residency checks in keep mode */
+
+static HalTtsModelResidency residency = HAL_TTS_MODEL_CACHED;
+
+/* Model mapping, kept while the model is locked or kept resident */
+static void *model_map = NULL;
+static size_t model_size = 0;
+static HalTtsModelResidency model_mode = HAL_TTS_MODEL_CACHED;
+
+/* Keep mode: a thread that faults evicted pages back in */
+static pthread_t keeper_thread;
+static int keeper_started = 0;
+static int keeper_stop = 0;
+static unsigned long keeper_refaults = 0; /* Pages brought back */
+static pthread_mutex_t keeper_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t keeper_wake = PTHREAD_COND_INITIALIZER;
+
+const char *hal_tts_warmup_text(void) {
+  const char *text = getenv(WARMUP_TEXT_ENV);
+  if (text == NULL) {
+    return DEFAULT_WARMUP_TEXT;
+  }
+  if (text[0] == '\0' || strcmp(text, "0") == 0) {
+    return NULL;
+  }
+  return text;
+}
+
+void hal_tts_warmup_set_residency(HalTtsModelResidency mode) {
+  residency = mode;
+}
+
+/* The mode asked for: the environment over hal_tts_warmup_set_residency() */
+static HalTtsModelResidency wanted_residency(void) {
+  const char *mode = getenv(WARMUP_MODEL_ENV);
+  if (mode != NULL && strcmp(mode, "lock") == 0) {
+    return HAL_TTS_MODEL_LOCKED;
+  }
+  if (mode != NULL && strcmp(mode, "keep") == 0) {
+    return HAL_TTS_MODEL_KEPT;
+  }
+  if (mode != NULL && strcmp(mode, "cache") == 0) {
+    return HAL_TTS_MODEL_CACHED;
+  }
+  const char *lock = getenv(WARMUP_MLOCK_ENV);
+  if (lock != NULL && strcmp(lock, "1") == 0) {
+    return HAL_TTS_MODEL_LOCKED;
+  }
+  return residency;
+}
+
+/* Bytes this process has locked already (VmLck), or 0 if unknown */
+static size_t locked_bytes(void) {
+  FILE *f = fopen("/proc/self/status", "r");
+  if (f == NULL) {
+    return 0;
+  }
+  char line[128];
+  unsigned long kb = 0;
+  while (fgets(line, sizeof(line), f) != NULL) {
+    if (sscanf(line, "VmLck: %lu kB", &kb) == 1) {
+      break;
+    }
+  }
+  fclose(f);
+  return (size_t)kb * 1024;
+}
+
+/* Whether size more bytes fit under RLIMIT_MEMLOCK beside the locked
+ * ones. Measured before the mapping is made: under a whole-process
+ * mlockall() (--mlock) the mapping is locked as soon as it exists. */
+static int lock_fits(size_t size, size_t locked) {
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_MEMLOCK, &limit) != 0 ||
+      limit.rlim_cur == RLIM_INFINITY) {
+    return 1;
+  }
+  return locked <= limit.rlim_cur && size <= limit.rlim_cur - locked;
+}
+
+/* Fault in the pages of map that are not resident; returns how many */
+static unsigned long fault_in(void *map, size_t size) {
+  long page = sysconf(_SC_PAGESIZE);
+  size_t pages = (size + (size_t)page - 1) / (size_t)page;
+  unsigned char *vec = malloc(pages);
+  int known = vec != NULL && mincore(map, size, vec) == 0;
+
+  madvise(map, size, MADV_WILLNEED);
+  volatile const unsigned char *bytes = map;
+  unsigned int sum = 0;
+  unsigned long faulted = 0;
+  for (size_t i = 0; i < pages; i++) {
+    if (!known || !(vec[i] & 1)) {
+      sum += bytes[i * (size_t)page];
+      faulted++;
+    }
+  }
+  (void)sum;
+  free(vec);
+  return faulted;
+}
+
+static void *keeper_thread_func(void *arg) {
+  (void)arg;
+  /* Only spare CPU time: the check must never delay speech */
+  struct sched_param param = {.sched_priority = 0};
+  pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+
+  pthread_mutex_lock(&keeper_lock);
+  while (!keeper_stop) {
+    struct timespec wake;
+    clock_gettime(CLOCK_REALTIME, &wake);
+    wake.tv_sec += KEEP_INTERVAL_S;
+    pthread_cond_timedwait(&keeper_wake, &keeper_lock, &wake);
+    if (keeper_stop) {
+      break;
+    }
+    pthread_mutex_unlock(&keeper_lock);
+    unsigned long faulted = fault_in(model_map, model_size);
+    pthread_mutex_lock(&keeper_lock);
+    keeper_refaults += faulted;
+  }
+  pthread_mutex_unlock(&keeper_lock);
+  return NULL;
+}
+
+int hal_tts_preload_model(const char *path) {
+  hal_tts_release_model();
+
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return -1;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+    close(fd);
+    return -1;
+  }
+  size_t size = (size_t)st.st_size;
+  size_t locked = locked_bytes();
+  void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return -1;
+  }
+
+  /* Fault every page in now rather than on the first utterance */
+  fault_in(map, size);
+
+  HalTtsModelResidency mode = wanted_residency();
+  if (mode == HAL_TTS_MODEL_LOCKED) {
+    if (!lock_fits(size, locked)) {
+      fprintf(stderr, "HAL TTS: %zu bytes of %s exceed the memlock limit, "
+              "keeping the model resident instead\n", size, path);
+      mode = HAL_TTS_MODEL_KEPT;
+    } else if (mlock(map, size) != 0) {
+      perror("HAL TTS: mlock(model) failed, keeping it resident instead");
+      mode = HAL_TTS_MODEL_KEPT;
+    } else {
+      printf("HAL TTS: Locked %zu bytes of %s in RAM\n", size, path);
+    }
+  }
+  if (mode == HAL_TTS_MODEL_CACHED) {
+    munmap(map, size);
+    return 0;
+  }
+
+  model_map = map;
+  model_size = size;
+  model_mode = mode;
+  if (mode == HAL_TTS_MODEL_KEPT) {
+    keeper_stop = 0;
+    keeper_started =
+        pthread_create(&keeper_thread, NULL, keeper_thread_func, NULL) == 0;
+    printf("HAL TTS: Keeping %zu bytes of %s resident\n", size, path);
+  }
+  return 0;
+}
+
+void hal_tts_release_model(void) {
+  if (keeper_started) {
+    pthread_mutex_lock(&keeper_lock);
+    keeper_stop = 1;
+    pthread_cond_signal(&keeper_wake);
+    pthread_mutex_unlock(&keeper_lock);
+    pthread_join(keeper_thread, NULL);
+    keeper_started = 0;
+  }
+  if (model_map != NULL) {
+    munmap(model_map, model_size); /* Also unlocks */
+    model_map = NULL;
+    model_size = 0;
+    model_mode = HAL_TTS_MODEL_CACHED;
+  }
+}
+
+void hal_tts_warmup_model_stats(HalTtsModelStats *stats) {
+  memset(stats, 0, sizeof(*stats));
+  stats->mode = model_mode;
+  stats->bytes = model_size;
+  if (model_map == NULL) {
+    return;
+  }
+  long page = sysconf(_SC_PAGESIZE);
+  size_t pages = (model_size + (size_t)page - 1) / (size_t)page;
+  unsigned char *vec = malloc(pages);
+  if (vec != NULL && mincore(model_map, model_size, vec) == 0) {
+    for (size_t i = 0; i < pages; i++) {
+      if (vec[i] & 1) {
+        stats->resident_bytes += (size_t)page;
+      }
+    }
+    if (stats->resident_bytes > model_size) {
+      stats->resident_bytes = model_size;
+    }
+  }
+  free(vec);
+  pthread_mutex_lock(&keeper_lock);
+  stats->refaults = keeper_refaults;
+  pthread_mutex_unlock(&keeper_lock);
+}
@@ -0,0 +1,56 @@
+#ifndef HAL_TTS_WARMUP_H
+#define HAL_TTS_WARMUP_H
+
+#include "hal_tts.h"
+
+/**
+ * @file hal_tts_warmup.h
+ * @brief Start-up warm-up shared by the Piper TTS backends
+ *
+ * The first utterance after a voice loads pays for ONNX graph setup and
+ * for faulting in the model file. hal_tts_init() runs that cost itself:
+ * it reads the model into the page cache (optionally keeping or locking
+ * it there, see HalTtsModelResidency) and synthesizes a short priming
+ * phrase that is thrown away.
+ *
+ * Environment:
+ *   HAMPOD_TTS_WARMUP       Priming phrase; "0" or empty skips warm-up
+ *   HAMPOD_TTS_MODEL        cache, keep or lock (hal_tts_set_model_residency())
+ *   HAMPOD_TTS_MLOCK        "1" is the same as HAMPOD_TTS_MODEL=lock
+ */
+
+/**
+ * @brief The phrase to prime the synthesizer with
+ * @return The phrase, or NULL if warm-up is turned off
+ */
+const char *hal_tts_warmup_text(void);
+
+/**
+ * @brief hal_tts_set_model_residency() for the Piper builds
+ */
+void hal_tts_warmup_set_residency(HalTtsModelResidency mode);
+
+/**
+ * @brief Read a voice model into the page cache ahead of first use
+ *
+ * In KEPT or LOCKED mode the mapping stays until hal_tts_release_model(),
+ * locked or watched by a SCHED_IDLE thread that faults evicted pages back
+ * in; a lock the limits refuse is reported and falls back to KEPT.
+ *
+ * @param path The .onnx model file
+ * @return 0 on success, -1 if the file cannot be read
+ */
+int hal_tts_preload_model(const char *path);
+
+/**
+ * @brief Drop the mapping (and lock) taken by hal_tts_preload_model()
+ */
+void hal_tts_release_model(void);
+
+/**
+ * @brief Memory the model mapping takes up (see HalTtsStats)
+ * @param stats Receives it
+ */
+void hal_tts_warmup_model_stats(HalTtsModelStats *stats);
+
+#endif /* HAL_TTS_WARMUP_H */
@@ -8,9 +8,13 @@
 
 #include "hal_usb_util.h"
 #include <dirent.h>
+#include <errno.h>
+#include <linux/netlink.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 /**
@@ -270,3 +274,200 @@ int hal_usb_find_audio(const char *preferred_name, AudioDeviceInfo *result) {
 
   return 0;
 }
+
+/**
+ * Check a device found earlier against its card's sysfs entry only
+ */
+int hal_usb_check_audio(const AudioDeviceInfo *device) {
+  char path[64];
+  char port[128];
+
+  if (device == NULL || device->card_number < 0) {
+    return -1;
+  }
+
+  snprintf(path, sizeof(path), "/proc/asound/card%d", device->card_number);
+  if (access(path, F_OK) != 0) {
+    return -1;
+  }
+  if (!device->is_usb) {
+    return 0;
+  }
+  if (hal_usb_get_port_path(device->card_number, port, sizeof(port)) != 0 ||
+      strcmp(port, device->usb_port) != 0) {
+    return -1; /* Another card took the number */
+  }
+  return 0;
+}
+
+/**
+ * Find the device on a USB port by enumerating
+ */
+int hal_usb_find_audio_at_port(const char *usb_port, AudioDeviceInfo *result) {
+  AudioDeviceInfo devices[MAX_AUDIO_DEVICES];
+  int found = 0;
+
+  if (usb_port == NULL || usb_port[0] == '\0' || result == NULL) {
+    return -1;
+  }
+  if (hal_usb_enumerate_audio(devices, MAX_AUDIO_DEVICES, &found) != 0) {
+    return -1;
+  }
+  for (int i = 0; i < found; i++) {
+    if (devices[i].is_usb && strcmp(devices[i].usb_port, usb_port) == 0) {
+      *result = devices[i];
+      printf("HAL USB: Found device on %s: %s (%s)\n", usb_port,
+             result->card_name, result->device_path);
+      return 0;
+    }
+  }
+  return -1;
+}
+
+/**
+ * Save a device as "key value" lines: card, port, name
+ */
+int hal_usb_save_audio(const char *path, const AudioDeviceInfo *device) {
+  char tmp[512];
+
+  if (path == NULL || device == NULL) {
+    return -1;
+  }
+
+  /* Make the directories above the file, as mkdir -p would */
+  snprintf(tmp, sizeof(tmp), "%s", path);
+  for (char *slash = strchr(tmp + 1, '/'); slash != NULL;
+       slash = strchr(slash + 1, '/')) {
+    *slash = '\0';
+    if (mkdir(tmp, 0755) != 0 && errno != EEXIST) {
+      return -1;
+    }
+    *slash = '/';
+  }
+
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+  FILE *fp = fopen(tmp, "w");
+  if (fp == NULL) {
+    return -1;
+  }
+  fprintf(fp, "card %d\n", device->card_number);
+  fprintf(fp, "port %s\n", device->is_usb ? device->usb_port : "");
+  fprintf(fp, "name %s\n", device->card_name);
+  if (fclose(fp) != 0 || rename(tmp, path) != 0) {
+    unlink(tmp);
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Read a device saved by hal_usb_save_audio()
+ */
+int hal_usb_load_audio(const char *path, AudioDeviceInfo *device) {
+  char line[256];
+  int have_card = 0;
+
+  if (path == NULL || device == NULL) {
+    return -1;
+  }
+  FILE *fp = fopen(path, "r");
+  if (fp == NULL) {
+    return -1;
+  }
+
+  memset(device, 0, sizeof(AudioDeviceInfo));
+  device->card_number = -1;
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    line[strcspn(line, "\r\n")] = '\0';
+    if (strncmp(line, "card ", 5) == 0) {
+      have_card = sscanf(line + 5, "%d", &device->card_number) == 1;
+    } else if (strncmp(line, "port ", 5) == 0) {
+      snprintf(device->usb_port, sizeof(device->usb_port), "%s", line + 5);
+    } else if (strncmp(line, "name ", 5) == 0) {
+      snprintf(device->card_name, sizeof(device->card_name), "%s", line + 5);
+    }
+  }
+  fclose(fp);
+
+  if (!have_card || device->card_number < 0) {
+    return -1;
+  }
+  device->is_usb = device->usb_port[0] != '\0';
+  snprintf(device->device_path, sizeof(device->device_path), "plughw:%d,0",
+           device->card_number);
+  return 0;
+}
+
+/**
+ * Open a socket on the kernel's uevent broadcast
+ */
+int hal_usb_monitor_open(void) {
+  struct sockaddr_nl addr;
+  int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK,
+                  NETLINK_KOBJECT_UEVENT);
+  if (fd < 0) {
+    return -1;
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.nl_family = AF_NETLINK;
+  addr.nl_groups = 1; /* Kernel events */
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/**
+ * Read one uevent and tell whether it is a sound card coming or going
+ *
+ * An event is "ACTION@DEVPATH" followed by NUL-separated KEY=VALUE
+ * lines. A card is the sound device named cardN (its PCM and control
+ * nodes come with their own events, which are ignored).
+ */
+HalUsbEvent hal_usb_monitor_read(int fd, int *card) {
+  char buf[4096];
+  const char *action = NULL;
+  const char *subsystem = NULL;
+  const char *devpath = NULL;
+
+  if (card != NULL) {
+    *card = -1;
+  }
+  ssize_t len = recv(fd, buf, sizeof(buf) - 1, 0);
+  if (len <= 0) {
+    return HAL_USB_EVENT_NONE;
+  }
+  buf[len] = '\0';
+
+  for (char *field = buf; field < buf + len; field += strlen(field) + 1) {
+    if (strncmp(field, "ACTION=", 7) == 0) {
+      action = field + 7;
+    } else if (strncmp(field, "SUBSYSTEM=", 10) == 0) {
+      subsystem = field + 10;
+    } else if (strncmp(field, "DEVPATH=", 8) == 0) {
+      devpath = field + 8;
+    }
+  }
+  if (action == NULL || subsystem == NULL || devpath == NULL ||
+      strcmp(subsystem, "sound") != 0) {
+    return HAL_USB_EVENT_NONE;
+  }
+
+  const char *name = strrchr(devpath, '/');
+  int number;
+  if (name == NULL || sscanf(name, "/card%d", &number) != 1) {
+    return HAL_USB_EVENT_NONE;
+  }
+  if (card != NULL) {
+    *card = number;
+  }
+  if (strcmp(action, "add") == 0) {
+    return HAL_USB_EVENT_ADD;
+  }
+  if (strcmp(action, "remove") == 0) {
+    return HAL_USB_EVENT_REMOVE;
+  }
+  return HAL_USB_EVENT_NONE;
+}
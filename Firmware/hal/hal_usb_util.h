@@ -3,7 +3,9 @@
  * @brief USB Device Enumeration Utilities
  *
  * Provides functions to enumerate USB audio devices and get their
- * physical port paths for deterministic device selection.
+ * physical port paths for deterministic device selection, to re-check a
+ * device chosen before without enumerating again, and to hear of sound
+ * cards coming and going.
  */
 
 #ifndef HAL_USB_UTIL_H
@@ -60,4 +62,68 @@ int hal_usb_find_audio(const char *preferred_name, AudioDeviceInfo *result);
  */
 int hal_usb_get_port_path(int card_number, char *port_path, size_t len);
 
+/**
+ * Check that a device found earlier is still there
+ *
+ * Looks only at this card: it must exist and, for a USB device, still sit
+ * on the same port (a re-plugged dongle usually gets a new card number).
+ *
+ * @param device Device from hal_usb_find_audio() or hal_usb_load_audio()
+ * @return 0 if it can be opened as before, -1 otherwise
+ */
+int hal_usb_check_audio(const AudioDeviceInfo *device);
+
+/**
+ * Find the audio device on a USB port, whatever its card number now
+ *
+ * @param usb_port Port path, e.g. "/sys/bus/usb/devices/1-2"
+ * @param result Output: the device on that port
+ * @return 0 if found, -1 if nothing is plugged in there
+ */
+int hal_usb_find_audio_at_port(const char *usb_port, AudioDeviceInfo *result);
+
+/**
+ * Remember a selected device in a file, making its directory if needed
+ *
+ * @return 0 on success, -1 if the file could not be written
+ */
+int hal_usb_save_audio(const char *path, const AudioDeviceInfo *device);
+
+/**
+ * Read a device saved by hal_usb_save_audio()
+ *
+ * @return 0 on success, -1 if there is no readable saved device
+ */
+int hal_usb_load_audio(const char *path, AudioDeviceInfo *device);
+
+/**
+ * Sound card hotplug events, as hal_usb_monitor_read() reports them
+ */
+typedef enum {
+  HAL_USB_EVENT_NONE = 0, /* Nothing, or not a sound card */
+  HAL_USB_EVENT_ADD,      /* A sound card appeared */
+  HAL_USB_EVENT_REMOVE    /* A sound card went away */
+} HalUsbEvent;
+
+/**
+ * Listen for sound cards being plugged and unplugged
+ *
+ * Opens a kernel uevent socket (the events udev acts on), so no udev
+ * library is needed.
+ *
+ * @return Non-blocking socket to poll() and pass to hal_usb_monitor_read(),
+ *         or -1 if uevents are not available
+ */
+int hal_usb_monitor_open(void);
+
+/**
+ * Read one pending uevent
+ *
+ * @param fd Socket from hal_usb_monitor_open()
+ * @param card Output: the card number it is about, or -1 (may be NULL)
+ * @return What happened to a sound card; HAL_USB_EVENT_NONE for other
+ *         devices or when nothing is pending
+ */
+HalUsbEvent hal_usb_monitor_read(int fd, int *card);
+
 #endif /* HAL_USB_UTIL_H */
@@ -0,0 +1,50 @@
+#ifndef HAL_VOICE_H
+#define HAL_VOICE_H
+
+/**
+ * @file hal_voice.h
+ * @brief Hardware Abstraction Layer for spoken command input
+ *
+ * Listens on a microphone and turns spoken commands (hal_voice_grammar.h)
+ * into VoiceCommands for the keypad process, which delivers spoken keys
+ * like keypad events and pushes the other commands to Software.
+ *
+ * A voice activity detector gates everything: while nobody speaks only
+ * the capture thread runs, reading the microphone in 100 ms blocks and
+ * measuring their energy. An utterance is cut out between speech onset
+ * and 300 ms of quiet, and only then handed to the recognizer, so the
+ * recognizer's cores are free for Piper except while a command is being
+ * understood.
+ *
+ * Build with: make VOICE_INPUT=whisper (whisper.cpp, WHISPER_DIR)
+ */
+
+#include "hal_voice_grammar.h"
+
+/** Model file; voice input stays off unless it is set */
+#define HAL_VOICE_MODEL_ENV "HAMPOD_VOICE_MODEL"
+/** ALSA capture device, "default" if unset (e.g. "plughw:CARD=Device") */
+#define HAL_VOICE_DEVICE_ENV "HAMPOD_VOICE_DEVICE"
+
+/**
+ * @brief Receives each recognized command, on the recognizer thread
+ */
+typedef void (*HalVoiceHandler)(const VoiceCommand *cmd);
+
+/**
+ * @brief Load the model, open the microphone and start listening
+ *
+ * @param handler Called for every utterance that is a whole command
+ * @param cpus CPU range the recognizer is kept to ("3", "2-3"), "" for any;
+ *             it also runs at a lower priority than Piper
+ * @return 0 on success, -1 if voice input is not configured, the model
+ *         did not load or the microphone did not open
+ */
+int hal_voice_start(HalVoiceHandler handler, const char *cpus);
+
+/**
+ * @brief Stop listening and unload the model
+ */
+void hal_voice_stop(void);
+
+#endif /* HAL_VOICE_H */
@@ -0,0 +1,243 @@
+/**
+ * @file hal_voice_grammar.c
+ * @brief Matching recognized text against the voice command grammar
+ */
+
+#include "hal_voice_grammar.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_TOKENS 16
+#define TOKEN_MAX 16
+#define NUMBER_MAX 12 /* Digits (and a point) of one spoken number */
+
+typedef struct {
+  char text[MAX_TOKENS][TOKEN_MAX];
+  int count;
+} Tokens;
+
+static const char *const UNITS[] = {"zero", "one", "two",   "three", "four",
+                                    "five", "six", "seven", "eight", "nine"};
+static const char *const TEENS[] = {"ten",      "eleven",  "twelve",
+                                    "thirteen", "fourteen", "fifteen",
+                                    "sixteen",  "seventeen", "eighteen",
+                                    "nineteen"};
+static const char *const TENS[] = {"twenty", "thirty",  "forty", "fifty",
+                                   "sixty",  "seventy", "eighty", "ninety"};
+
+/* Dropped wherever they appear */
+static const char *const FILLERS[] = {
+    "set",  "go",        "to",        "the",  "please", "change",
+    "megahertz", "mhz",  "kilohertz", "khz",  "hertz",  "on",
+    "an"};
+
+static const struct {
+  const char *word;
+  const char *mode;
+} MODES[] = {{"usb", "USB"},    {"upper", "USB"},     {"lsb", "LSB"},
+             {"lower", "LSB"},  {"cw", "CW"},         {"morse", "CW"},
+             {"am", "AM"},      {"fm", "FM"},         {"rtty", "RTTY"},
+             {"teletype", "RTTY"}};
+
+static const struct {
+  const char *word;
+  char key;
+} KEYS[] = {{"star", '*'},  {"asterisk", '*'}, {"pound", '#'},
+            {"hash", '#'},  {"enter", '#'},    {"alpha", 'A'},
+            {"bravo", 'B'}, {"charlie", 'C'},  {"delta", 'D'},
+            {"a", 'A'},     {"b", 'B'},        {"c", 'C'},
+            {"d", 'D'}};
+
+static int word_index(const char *word, const char *const *list, int count) {
+  for (int i = 0; i < count; i++) {
+    if (strcmp(word, list[i]) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+#define LIST_INDEX(word, list)                                                 \
+  word_index(word, list, (int)(sizeof(list) / sizeof(list[0])))
+
+/* Words of the text, lowercased and without punctuation. A point between
+ * digits stays ("14.250"), fillers go and single letters in a row are
+ * joined into one word ("u s b" is "usb"). */
+static void tokenize(const char *text, Tokens *tokens) {
+  int spelled[MAX_TOKENS]; /* Word made of single letters */
+  char word[TOKEN_MAX];
+  int len = 0;
+  tokens->count = 0;
+
+  for (const char *p = text;; p++) {
+    int c = (unsigned char)*p;
+    if (isalnum(c) || (c == '.' && len > 0 &&
+                       isdigit((unsigned char)word[len - 1]) &&
+                       isdigit((unsigned char)p[1]))) {
+      if (len < TOKEN_MAX - 1) {
+        word[len++] = (char)tolower(c);
+      }
+      continue;
+    }
+    if (len > 0) {
+      word[len] = '\0';
+      int last = tokens->count - 1;
+      int letter = len == 1 && isalpha((unsigned char)word[0]);
+      if (letter && last >= 0 && spelled[last] &&
+          strlen(tokens->text[last]) < TOKEN_MAX - 1) {
+        strcat(tokens->text[last], word);
+      } else if (LIST_INDEX(word, FILLERS) < 0 &&
+                 tokens->count < MAX_TOKENS) {
+        spelled[tokens->count] = letter;
+        memcpy(tokens->text[tokens->count++], word, (size_t)len + 1);
+      }
+    }
+    len = 0;
+    if (c == '\0') {
+      break;
+    }
+  }
+}
+
+/* A single digit, as a word or a figure; -1 if it is not one */
+static int digit_value(const char *word) {
+  if (isdigit((unsigned char)word[0]) && word[1] == '\0') {
+    return word[0] - '0';
+  }
+  if (strcmp(word, "oh") == 0) {
+    return 0;
+  }
+  return LIST_INDEX(word, UNITS);
+}
+
+/* Read the number starting at tokens *at into digits ("14250", "7.074"),
+ * moving *at past it. Returns the number of characters, 0 if there is no
+ * number there or it does not fit. */
+static int read_number(const Tokens *tokens, int *at, char *digits) {
+  int len = 0;
+  int points = 0;
+  int i = *at;
+
+  for (; i < tokens->count; i++) {
+    const char *word = tokens->text[i];
+    char part[TOKEN_MAX];
+    int n;
+    if (isdigit((unsigned char)word[0])) {
+      snprintf(part, sizeof(part), "%s", word);
+      points += strchr(word, '.') != NULL;
+    } else if ((n = digit_value(word)) >= 0) {
+      snprintf(part, sizeof(part), "%d", n);
+    } else if ((n = LIST_INDEX(word, TEENS)) >= 0) {
+      snprintf(part, sizeof(part), "%d", 10 + n);
+    } else if ((n = LIST_INDEX(word, TENS)) >= 0) {
+      /* "twenty five" is 25, "fifty" alone 50 */
+      int unit = i + 1 < tokens->count ? digit_value(tokens->text[i + 1]) : -1;
+      if (unit > 0 && !isdigit((unsigned char)tokens->text[i + 1][0])) {
+        i++;
+      } else {
+        unit = 0;
+      }
+      snprintf(part, sizeof(part), "%d", 20 + 10 * n + unit);
+    } else if (strcmp(word, "point") == 0 || strcmp(word, "dot") == 0 ||
+               strcmp(word, "decimal") == 0) {
+      snprintf(part, sizeof(part), ".");
+      points++;
+    } else {
+      break;
+    }
+    if (points > 1 || len + strlen(part) > NUMBER_MAX) {
+      return 0;
+    }
+    strcpy(&digits[len], part);
+    len += (int)strlen(part);
+  }
+  *at = i;
+  return len;
+}
+
+/* Spoken frequency to Hz: the last three digits of a longer number
+ * without a point are kHz. Returns 0, or -1 if it is out of range. */
+static int frequency_hz(const char *digits, uint32_t *hz) {
+  size_t len = strlen(digits);
+  char mhz_text[NUMBER_MAX + 2];
+
+  if (strchr(digits, '.') == NULL && len > 3) {
+    memcpy(mhz_text, digits, len - 3);
+    mhz_text[len - 3] = '.';
+    strcpy(&mhz_text[len - 2], &digits[len - 3]);
+  } else {
+    snprintf(mhz_text, sizeof(mhz_text), "%s", digits);
+  }
+
+  double mhz = atof(mhz_text);
+  if (mhz < 0.1 || mhz > 500.0) { /* As Software2's frequency entry */
+    return -1;
+  }
+  *hz = (uint32_t)(mhz * 1000000.0 + 0.5);
+  return 0;
+}
+
+int hal_voice_parse(const char *text, VoiceCommand *cmd) {
+  Tokens tokens;
+  tokenize(text != NULL ? text : "", &tokens);
+  if (tokens.count < 2) {
+    return -1;
+  }
+
+  const char *verb = tokens.text[0];
+  const char *arg = tokens.text[1];
+  int at = 1;
+
+  if (strcmp(verb, "frequency") == 0 || strcmp(verb, "tune") == 0) {
+    char digits[NUMBER_MAX + 1];
+    if (read_number(&tokens, &at, digits) == 0 || at != tokens.count ||
+        frequency_hz(digits, &cmd->freq_hz) != 0) {
+      return -1;
+    }
+    cmd->kind = VOICE_CMD_FREQUENCY;
+    return 0;
+  }
+
+  if (strcmp(verb, "mode") == 0) {
+    int n = -1;
+    for (int i = 0; i < (int)(sizeof(MODES) / sizeof(MODES[0])); i++) {
+      if (strcmp(arg, MODES[i].word) == 0) {
+        n = i;
+      }
+    }
+    /* "upper sideband", "lower side band" */
+    at = 2;
+    while (at < tokens.count && (strcmp(tokens.text[at], "sideband") == 0 ||
+                                 strcmp(tokens.text[at], "side") == 0 ||
+                                 strcmp(tokens.text[at], "band") == 0)) {
+      at++;
+    }
+    if (n < 0 || at != tokens.count) {
+      return -1;
+    }
+    cmd->kind = VOICE_CMD_MODE;
+    snprintf(cmd->mode, sizeof(cmd->mode), "%s", MODES[n].mode);
+    return 0;
+  }
+
+  if ((strcmp(verb, "key") == 0 || strcmp(verb, "press") == 0) &&
+      tokens.count == 2) {
+    int digit = digit_value(arg);
+    cmd->key = digit >= 0 ? (char)('0' + digit) : '\0';
+    for (int i = 0; i < (int)(sizeof(KEYS) / sizeof(KEYS[0])); i++) {
+      if (strcmp(arg, KEYS[i].word) == 0) {
+        cmd->key = KEYS[i].key;
+      }
+    }
+    if (cmd->key == '\0') {
+      return -1;
+    }
+    cmd->kind = VOICE_CMD_KEY;
+    return 0;
+  }
+
+  return -1;
+}
@@ -0,0 +1,55 @@
+#ifndef HAL_VOICE_GRAMMAR_H
+#define HAL_VOICE_GRAMMAR_H
+
+#include <stdint.h>
+
+/**
+ * @file hal_voice_grammar.h
+ * @brief The spoken commands voice input accepts
+ *
+ * A recognized utterance is only acted on if it is one whole command of
+ * this small grammar; anything else (chatter, the radio, our own speech
+ * picked up by the microphone) is rejected:
+ *
+ *   frequency|tune <number>   "frequency 14 250", "tune seven oh seven four"
+ *   mode <name>               USB, LSB, CW, AM, FM, RTTY ("mode upper")
+ *   key|press <key>           "key 5", "press star", "key pound", "key alpha"
+ *
+ * Digits and number words may be mixed ("fourteen two fifty"). A number
+ * without a decimal point and longer than three digits has its last three
+ * digits as kHz, so "14 250" is 14.250 MHz and "144 390" is 144.390 MHz;
+ * a shorter one is whole MHz. Filler words ("set", "to", "please") and
+ * unit words ("megahertz") are ignored, and letters spelled apart are
+ * joined ("U S B").
+ */
+
+#define VOICE_CMD_NONE 0
+#define VOICE_CMD_KEY 1       /**< A keypad key, as if pressed */
+#define VOICE_CMD_FREQUENCY 2 /**< Tune to freq_hz */
+#define VOICE_CMD_MODE 3      /**< Operating mode, by name */
+
+#define VOICE_MODE_NAME_MAX 8
+
+/** Phrases the recognizer is primed with, so it expects the grammar */
+#define VOICE_GRAMMAR_PROMPT                                                   \
+  "frequency 14 250. tune 7 074. mode USB. mode LSB. mode CW. mode AM. "     \
+  "mode FM. mode RTTY. key 5. press star. key pound."
+
+typedef struct {
+  int kind;                        /**< VOICE_CMD_* */
+  char key;                        /**< VOICE_CMD_KEY: '0'-'9', 'A'-'D', ... */
+  uint32_t freq_hz;                /**< VOICE_CMD_FREQUENCY */
+  char mode[VOICE_MODE_NAME_MAX];  /**< VOICE_CMD_MODE: "USB", "CW", ... */
+  uint64_t spoken_us;              /**< When the speech ended (realtime) */
+} VoiceCommand;
+
+/**
+ * @brief Match recognized text against the grammar
+ *
+ * @param text What the recognizer heard, in any case and punctuation
+ * @param cmd Receives the command (spoken_us is left alone)
+ * @return 0 if text is one whole command, -1 otherwise
+ */
+int hal_voice_parse(const char *text, VoiceCommand *cmd);
+
+#endif /* HAL_VOICE_GRAMMAR_H */
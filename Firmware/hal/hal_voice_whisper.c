@@ -0,0 +1,389 @@
+/**
+ * @file hal_voice_whisper.c
+ * @brief whisper.cpp implementation of the voice input HAL
+ *
+ * Two threads. The capture thread reads 16 kHz mono from the microphone
+ * and runs an energy voice activity detector over 20 ms frames against a
+ * noise floor it keeps learning. While it is quiet it reads 100 ms at a
+ * time, so it wakes ten times a second and does almost nothing; once
+ * speech starts it reads frame by frame to catch the end promptly. The
+ * utterance, with 200 ms from before the onset, goes to the recognizer
+ * thread as soon as 300 ms of quiet follow it.
+ *
+ * The recognizer thread is kept to the voice CPUs at nice VOICE_NICE, so
+ * Piper wins any core they share, and sleeps until an utterance arrives.
+ * It runs whisper.cpp greedily with the encoder context cut down to the
+ * utterance (a command is a second or two, not whisper's 30 s window),
+ * primed with the grammar's phrases, and matches the text against the
+ * grammar. A small English model (tiny.en or base.en, quantized) answers
+ * well within a second on a Pi 5.
+ *
+ * One utterance is recognized at a time; speech that ends while the
+ * recognizer is busy is dropped.
+ */
+
+#define _GNU_SOURCE /* syscall(SYS_gettid) */
+
+#include "hal_voice.h"
+#include "../hampod_metrics.h"
+#include "../hampod_sched.h"
+#include <alsa/asoundlib.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <whisper.h>
+
+#define VOICE_RATE WHISPER_SAMPLE_RATE /* 16 kHz */
+#define VOICE_FRAME 320           /* 20 ms, the detector's step */
+#define VOICE_QUIET_READ 5        /* Frames read at once while quiet */
+#define VOICE_OPEN_FRAMES 3       /* 60 ms of speech starts an utterance */
+#define VOICE_HANGOVER_FRAMES 15  /* 300 ms of quiet ends it */
+#define VOICE_PREROLL_FRAMES 10   /* 200 ms kept from before the onset */
+#define VOICE_MIN_FRAMES 15       /* Shorter speech is a click or a cough */
+#define VOICE_MAX_FRAMES 200      /* 4 s; longer is not a command */
+#define VOICE_MAX_SAMPLES (VOICE_MAX_FRAMES * VOICE_FRAME)
+
+/* Speech is a frame whose mean square is VOICE_VAD_RATIO times the noise
+ * floor (9 dB) and above VOICE_VAD_MIN (about -50 dBFS) */
+#define VOICE_VAD_RATIO 8.0f
+#define VOICE_VAD_MIN 1e-5f
+
+#define VOICE_NICE 5            /* Recognizer priority, below Piper's 0 */
+#define VOICE_THREADS_DEFAULT 2 /* Without a CPU range */
+#define VOICE_MAX_TOKENS 24     /* The longest command is a few words */
+#define VOICE_TEXT_MAX 128
+
+static HalVoiceHandler voice_handler = NULL;
+static char voice_cpus[SCHED_CPUS_MAX];
+static struct whisper_context *whisper = NULL;
+static snd_pcm_t *capture = NULL;
+static volatile int running = 0;
+static pthread_t capture_thread;
+static pthread_t recognizer_thread;
+
+/* The capture thread fills one buffer while the recognizer reads the
+ * other; they swap when an utterance is handed over (ready_len > 0 until
+ * the recognizer is done with it) */
+static float buffers[2][VOICE_MAX_SAMPLES];
+static float *filling = buffers[0];
+static float *ready = buffers[1];
+static int ready_len = 0;
+static uint64_t ready_end_us = 0;
+static pthread_mutex_t ready_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ready_cond = PTHREAD_COND_INITIALIZER;
+
+/* Frames from just before an utterance, oldest at preroll_head */
+static float preroll[VOICE_PREROLL_FRAMES][VOICE_FRAME];
+static int preroll_head = 0;
+static int preroll_count = 0;
+
+static uint64_t realtime_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static uint64_t monotonic_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static void preroll_push(const float *frame) {
+  int slot = (preroll_head + preroll_count) % VOICE_PREROLL_FRAMES;
+  if (preroll_count == VOICE_PREROLL_FRAMES) {
+    preroll_head = (preroll_head + 1) % VOICE_PREROLL_FRAMES;
+  } else {
+    preroll_count++;
+  }
+  memcpy(preroll[slot], frame, sizeof(preroll[slot]));
+}
+
+/* Start an utterance in filling with the preroll; returns its length */
+static int preroll_take(void) {
+  int len = 0;
+  for (int i = 0; i < preroll_count; i++) {
+    memcpy(&filling[len], preroll[(preroll_head + i) % VOICE_PREROLL_FRAMES],
+           sizeof(preroll[0]));
+    len += VOICE_FRAME;
+  }
+  preroll_head = 0;
+  preroll_count = 0;
+  return len;
+}
+
+/* Hand a finished utterance to the recognizer, unless it is busy */
+static void hand_over(int len) {
+  pthread_mutex_lock(&ready_lock);
+  if (ready_len == 0) {
+    float *swap = ready;
+    ready = filling;
+    filling = swap;
+    ready_len = len;
+    ready_end_us = realtime_us();
+    pthread_cond_signal(&ready_cond);
+  } else {
+    fprintf(stderr, "HAL Voice: Still recognizing, utterance dropped\n");
+  }
+  pthread_mutex_unlock(&ready_lock);
+}
+
+static void *capture_thread_func(void *arg) {
+  (void)arg;
+  hampod_metrics_name_thread("voice-capture");
+
+  int16_t chunk[VOICE_QUIET_READ * VOICE_FRAME];
+  float frame[VOICE_FRAME];
+  float noise = 0.0f; /* Mean square of the background, 0 until known */
+  int in_speech = 0;
+  int speech_run = 0; /* Speech frames in a row before an utterance */
+  int quiet_run = 0;  /* Quiet frames in a row within one */
+  int len = 0;        /* Samples of the utterance in filling */
+
+  while (running) {
+    int want = in_speech ? VOICE_FRAME : VOICE_QUIET_READ * VOICE_FRAME;
+    snd_pcm_sframes_t got = snd_pcm_readi(capture, chunk, want);
+    if (got < 0) {
+      if (snd_pcm_recover(capture, (int)got, 1) < 0) {
+        fprintf(stderr, "HAL Voice: Capture failed: %s\n",
+                snd_strerror((int)got));
+        usleep(500000);
+      }
+      continue;
+    }
+
+    for (int f = 0; f + VOICE_FRAME <= got; f += VOICE_FRAME) {
+      float energy = 0.0f;
+      for (int i = 0; i < VOICE_FRAME; i++) {
+        frame[i] = chunk[f + i] / 32768.0f;
+        energy += frame[i] * frame[i];
+      }
+      energy /= VOICE_FRAME;
+      if (noise == 0.0f) {
+        noise = energy;
+      }
+      int speech = energy > VOICE_VAD_MIN && energy > noise * VOICE_VAD_RATIO;
+
+      if (!in_speech) {
+        /* The floor follows the background down at once, up slowly */
+        if (!speech) {
+          noise = energy < noise ? energy : noise + (energy - noise) / 16.0f;
+        }
+        preroll_push(frame);
+        speech_run = speech ? speech_run + 1 : 0;
+        if (speech_run >= VOICE_OPEN_FRAMES) {
+          in_speech = 1;
+          quiet_run = 0;
+          len = preroll_take();
+        }
+        continue;
+      }
+
+      memcpy(&filling[len], frame, sizeof(frame));
+      len += VOICE_FRAME;
+      quiet_run = speech ? 0 : quiet_run + 1;
+      if (quiet_run < VOICE_HANGOVER_FRAMES && len < VOICE_MAX_SAMPLES) {
+        continue;
+      }
+
+      if (len >= VOICE_MAX_SAMPLES && quiet_run == 0) {
+        /* Speech that never stops is a new background */
+        noise = energy;
+      } else if (len / VOICE_FRAME - quiet_run >= VOICE_MIN_FRAMES) {
+        hand_over(len);
+      }
+      in_speech = 0;
+      speech_run = 0;
+    }
+  }
+  return NULL;
+}
+
+/* Encoder positions for len samples: whisper's 1500 cover 30 s */
+static int audio_context(int len) {
+  int ctx = len / (VOICE_RATE * 30 / 1500) + 64;
+  return ctx < 1500 ? ctx : 1500;
+}
+
+/* Run whisper over one utterance; returns 0 with its text */
+static int recognize(const float *samples, int len, int threads, char *text) {
+  struct whisper_full_params params =
+      whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+  params.n_threads = threads;
+  params.language = "en";
+  params.no_context = true;
+  params.single_segment = true;
+  params.no_timestamps = true;
+  params.print_progress = false;
+  params.print_realtime = false;
+  params.print_timestamps = false;
+  params.print_special = false;
+  params.suppress_blank = true;
+  params.temperature_inc = 0.0f; /* No slow fallback decodes */
+  params.max_tokens = VOICE_MAX_TOKENS;
+  params.audio_ctx = audio_context(len);
+  params.initial_prompt = VOICE_GRAMMAR_PROMPT;
+
+  if (whisper_full(whisper, params, samples, len) != 0) {
+    fprintf(stderr, "HAL Voice: Recognition failed\n");
+    return -1;
+  }
+
+  text[0] = '\0';
+  for (int i = 0; i < whisper_full_n_segments(whisper); i++) {
+    strncat(text, whisper_full_get_segment_text(whisper, i),
+            VOICE_TEXT_MAX - strlen(text) - 1);
+  }
+  return 0;
+}
+
+static void *recognizer_thread_func(void *arg) {
+  (void)arg;
+  hampod_metrics_name_thread("voice-recog");
+
+  /* Whisper's worker threads inherit both */
+  int threads = VOICE_THREADS_DEFAULT;
+  int first, last;
+  if (sched_pin_cpus(voice_cpus, "Voice recognizer") == 0 &&
+      sched_parse_cpus(voice_cpus, &first, &last) == 0) {
+    threads = last - first + 1;
+  }
+  if (setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), VOICE_NICE) != 0) {
+    perror("HAL Voice: setpriority");
+  }
+
+  pthread_mutex_lock(&ready_lock);
+  while (running) {
+    if (ready_len == 0) {
+      pthread_cond_wait(&ready_cond, &ready_lock);
+      continue;
+    }
+    int len = ready_len;
+    uint64_t spoken_us = ready_end_us;
+    pthread_mutex_unlock(&ready_lock);
+
+    /* ready is ours until ready_len goes back to 0 */
+    uint64_t started = monotonic_us();
+    char text[VOICE_TEXT_MAX];
+    VoiceCommand cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    if (recognize(ready, len, threads, text) == 0) {
+      hampod_metric_observe_us(METRIC_VOICE_RECOGNITION,
+                               monotonic_us() - started);
+      if (hal_voice_parse(text, &cmd) == 0) {
+        fprintf(stderr, "HAL Voice: \"%s\"\n", text);
+        hampod_metric_add(METRIC_VOICE_COMMANDS, 1);
+        cmd.spoken_us = spoken_us;
+        voice_handler(&cmd);
+      } else {
+        fprintf(stderr, "HAL Voice: Not a command: \"%s\"\n", text);
+        hampod_metric_add(METRIC_VOICE_REJECTS, 1);
+      }
+    }
+
+    pthread_mutex_lock(&ready_lock);
+    ready_len = 0;
+  }
+  pthread_mutex_unlock(&ready_lock);
+  return NULL;
+}
+
+static int open_capture(const char *device) {
+  int err = snd_pcm_open(&capture, device, SND_PCM_STREAM_CAPTURE, 0);
+  if (err < 0) {
+    fprintf(stderr, "HAL Voice: Cannot open microphone %s: %s\n", device,
+            snd_strerror(err));
+    capture = NULL;
+    return -1;
+  }
+  /* Resampled by ALSA if the microphone cannot do 16 kHz mono */
+  err = snd_pcm_set_params(capture, SND_PCM_FORMAT_S16_LE,
+                           SND_PCM_ACCESS_RW_INTERLEAVED, 1, VOICE_RATE, 1,
+                           200000);
+  if (err < 0) {
+    fprintf(stderr, "HAL Voice: Cannot set up microphone %s: %s\n", device,
+            snd_strerror(err));
+    snd_pcm_close(capture);
+    capture = NULL;
+    return -1;
+  }
+  return 0;
+}
+
+/* Close the microphone and unload the model */
+static void voice_release(void) {
+  snd_pcm_close(capture);
+  capture = NULL;
+  whisper_free(whisper);
+  whisper = NULL;
+}
+
+/* Stop the recognizer thread, before or without the capture thread */
+static void stop_recognizer(void) {
+  pthread_mutex_lock(&ready_lock);
+  running = 0;
+  pthread_cond_broadcast(&ready_cond);
+  pthread_mutex_unlock(&ready_lock);
+  pthread_join(recognizer_thread, NULL);
+}
+
+int hal_voice_start(HalVoiceHandler handler, const char *cpus) {
+  const char *model = getenv(HAL_VOICE_MODEL_ENV);
+  const char *device = getenv(HAL_VOICE_DEVICE_ENV);
+  if (model == NULL || model[0] == '\0' || handler == NULL || running) {
+    return -1;
+  }
+  if (device == NULL || device[0] == '\0') {
+    device = "default";
+  }
+
+  struct whisper_context_params cparams = whisper_context_default_params();
+  cparams.use_gpu = false;
+  whisper = whisper_init_from_file_with_params(model, cparams);
+  if (whisper == NULL) {
+    fprintf(stderr, "HAL Voice: Cannot load model %s\n", model);
+    return -1;
+  }
+  if (open_capture(device) != 0) {
+    whisper_free(whisper);
+    whisper = NULL;
+    return -1;
+  }
+
+  voice_handler = handler;
+  snprintf(voice_cpus, sizeof(voice_cpus), "%s", cpus != NULL ? cpus : "");
+  ready_len = 0;
+  running = 1;
+  if (pthread_create(&recognizer_thread, NULL, recognizer_thread_func,
+                     NULL) != 0) {
+    fprintf(stderr, "HAL Voice: Cannot start the recognizer\n");
+    running = 0;
+    voice_release();
+    return -1;
+  }
+  if (pthread_create(&capture_thread, NULL, capture_thread_func, NULL) != 0) {
+    fprintf(stderr, "HAL Voice: Cannot start capture\n");
+    stop_recognizer();
+    voice_release();
+    return -1;
+  }
+
+  fprintf(stderr, "HAL Voice: Listening on %s with %s\n", device, model);
+  return 0;
+}
+
+void hal_voice_stop(void) {
+  if (!running) {
+    return;
+  }
+  stop_recognizer();
+  /* The capture thread is at most one read (100 ms) away */
+  pthread_join(capture_thread, NULL);
+  voice_release();
+}
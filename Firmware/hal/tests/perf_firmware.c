@@ -0,0 +1,389 @@
+/**
+ * @file perf_firmware.c
+ * @brief Performance tier: microbenchmarks of the Firmware hot paths
+ *
+ * Times the packet queue, framing over a socket, the shared-memory audio
+ * ring, TTS cache lookups from RAM and from the packed store, WAV
+ * conversion (resampling) and ADPCM decoding. Each result is the best of
+ * PERF_RUNS timed runs, in nanoseconds per operation; the best run is the
+ * one least disturbed by the rest of the system.
+ *
+ * The results are compared with the baseline stored for this kind of
+ * machine, perf_baselines/<model>.txt (the Pi's device-tree model, or the
+ * CPU's). A benchmark more than HAMPOD_PERF_TOLERANCE percent (default 25)
+ * slower than its baseline, also when measured a second time, fails the
+ * run. With no baseline yet, or with --save, the results are stored as the
+ * new baseline; commit it so the other units of that model are held to it.
+ *
+ * Usage: ./perf_firmware [--save]
+ */
+
+#include "../../hampod_frame.h"
+#include "../../hampod_queue.h"
+#include "../../hampod_shm_ring.h"
+#include "../hal_audio_adpcm.h"
+#include "../hal_audio_convert.h"
+#include "../hal_tts_cache.h"
+#include <ctype.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PERF_RUNS 7
+#define DEFAULT_TOLERANCE 25 /* Percent */
+#define BASELINE_DIR "perf_baselines"
+
+#define CACHE_PHRASES 64
+#define CACHE_SAMPLES 16000 /* One second each */
+#define CONVERT_FRAMES 4096
+#define ADPCM_SAMPLES 16000
+
+typedef struct {
+  const char *name;
+  long ops; /* Operations per timed run */
+  void (*run)(long ops);
+} Benchmark;
+
+/* ========================================================================
+ * Benchmarks
+ * ======================================================================== */
+
+static Packet_queue *queue;
+static int frame_fds[2];
+static Frame_reader frame_reader;
+static Shm_audio_ring *ring;
+static char cache_dir[] = "/tmp/hampod_perf_cache_XXXXXX";
+static AudioConverter converter_22k;
+static AudioConverter converter_44k;
+static uint8_t *convert_in;
+static int16_t *convert_out;
+static uint8_t adpcm_in[ADPCM_SAMPLES / 2 + 4];
+static int16_t adpcm_out[ADPCM_SAMPLES];
+
+/* Keeps the compiler from dropping work whose result is unused */
+static volatile long sink;
+
+static void run_queue(long ops) {
+  static const unsigned char data[] = "Radio connected";
+  for (long i = 0; i < ops; i++) {
+    enqueue(queue, AUDIO, sizeof(data), data, (unsigned short)i, 0);
+    Inst_packet *packet = dequeue(queue);
+    sink += packet->data_len;
+    release_packet(queue, &packet);
+  }
+}
+
+static void run_frame(long ops) {
+  static const char data[] = "dRadio connected";
+  unsigned char buffer[FRAME_MAX_DATA];
+  Frame_header header;
+  for (long i = 0; i < ops; i++) {
+    frame_write(frame_fds[0], AUDIO, (unsigned short)i, data, sizeof(data));
+    frame_read(&frame_reader, &header, buffer, sizeof(buffer));
+    sink += header.data_len;
+  }
+}
+
+static void run_shm_ring(long ops) {
+  for (long i = 0; i < ops; i++) {
+    shm_ring_push(ring, 'd', (unsigned short)i, 0, "Radio connected");
+    Shm_audio_slot *slot = shm_ring_peek(ring);
+    sink += slot->tag;
+    shm_ring_pop(ring);
+  }
+}
+
+static void cache_lookups(long ops) {
+  char text[32];
+  for (long i = 0; i < ops; i++) {
+    snprintf(text, sizeof(text), "phrase %ld", i % CACHE_PHRASES);
+    const int16_t *samples;
+    size_t num_samples;
+    if (hal_tts_cache_lookup(text, 1.0f, &samples, &num_samples) == 0) {
+      sink += samples[num_samples - 1];
+      hal_tts_cache_release(samples);
+    }
+  }
+}
+
+/* Store CACHE_PHRASES phrases of CACHE_SAMPLES samples each */
+static void cache_fill(void) {
+  static int16_t samples[CACHE_SAMPLES];
+  char text[32];
+  for (int i = 0; i < CACHE_PHRASES; i++) {
+    for (int s = 0; s < CACHE_SAMPLES; s++) {
+      samples[s] = (int16_t)(s * i);
+    }
+    snprintf(text, sizeof(text), "phrase %d", i);
+    hal_tts_cache_store(text, 1.0f, samples, CACHE_SAMPLES);
+  }
+}
+
+/* Reopen the cache with a RAM budget of ram_bytes */
+static void cache_reopen(const char *ram_bytes) {
+  hal_tts_cache_cleanup(); /* Waits for pending writes */
+  setenv("HAMPOD_TTS_CACHE_RAM", ram_bytes, 1);
+  hal_tts_cache_init();
+}
+
+static void run_cache_ram(long ops) { cache_lookups(ops); }
+
+static void run_cache_store(long ops) { cache_lookups(ops); }
+
+static void run_convert_22k(long ops) {
+  for (long i = 0; i < ops; i++) {
+    sink += hal_audio_convert(&converter_22k, convert_in, CONVERT_FRAMES,
+                              convert_out);
+  }
+}
+
+static void run_convert_44k(long ops) {
+  for (long i = 0; i < ops; i++) {
+    sink += hal_audio_convert(&converter_44k, convert_in, CONVERT_FRAMES,
+                              convert_out);
+  }
+}
+
+static void run_adpcm(long ops) {
+  for (long i = 0; i < ops; i++) {
+    hal_adpcm_decode(adpcm_in, ADPCM_SAMPLES, adpcm_out);
+    sink += adpcm_out[ADPCM_SAMPLES - 1];
+  }
+}
+
+/* ========================================================================
+ * Timing and baselines
+ * ======================================================================== */
+
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* Fewest ns per operation over PERF_RUNS runs, after one to warm up */
+static double measure(const Benchmark *bench) {
+  double best = 0;
+  bench->run(bench->ops);
+  for (int r = 0; r < PERF_RUNS; r++) {
+    double start = now_ns();
+    bench->run(bench->ops);
+    double ns = (now_ns() - start) / bench->ops;
+    if (r == 0 || ns < best) {
+      best = ns;
+    }
+  }
+  return best;
+}
+
+/* perf_baselines/<model>.txt, the model reduced to a file name */
+static void baseline_path(char *path, size_t len) {
+  char model[128] = "";
+  FILE *f = fopen("/proc/device-tree/model", "r");
+  if (f != NULL) {
+    if (fgets(model, sizeof(model), f) == NULL) {
+      model[0] = '\0';
+    }
+    fclose(f);
+  }
+  if (model[0] == '\0' && (f = fopen("/proc/cpuinfo", "r")) != NULL) {
+    char line[256];
+    while (fgets(line, sizeof(line), f) != NULL) {
+      char *colon = strchr(line, ':');
+      if (strncmp(line, "model name", 10) == 0 && colon != NULL) {
+        snprintf(model, sizeof(model), "%s", colon + 2);
+        break;
+      }
+    }
+    fclose(f);
+  }
+  if (model[0] == '\0') {
+    struct utsname name;
+    uname(&name);
+    snprintf(model, sizeof(model), "%s", name.machine);
+  }
+  for (char *c = model; *c != '\0'; c++) {
+    if (!isalnum((unsigned char)*c)) {
+      *c = *c == '\n' ? '\0' : '_';
+      if (*c == '\0') {
+        break;
+      }
+    }
+  }
+  snprintf(path, len, "%s/%s.txt", BASELINE_DIR, model);
+}
+
+/* The stored ns per operation of name, or 0 if it has none */
+static double baseline_of(FILE *f, const char *name) {
+  char line[128];
+  char stored[64];
+  double ns;
+  rewind(f);
+  while (fgets(line, sizeof(line), f) != NULL) {
+    if (sscanf(line, "%63s %lf", stored, &ns) == 2 &&
+        strcmp(stored, name) == 0) {
+      return ns;
+    }
+  }
+  return 0;
+}
+
+/* ========================================================================
+ * Main
+ * ======================================================================== */
+
+static const Benchmark benchmarks[] = {
+    {"queue_push_pop", 1000000, run_queue},
+    {"frame_write_read", 200000, run_frame},
+    {"shm_ring_push_pop", 2000000, run_shm_ring},
+    {"cache_lookup_ram", 200000, run_cache_ram},
+    {"cache_lookup_store", 1000, run_cache_store},
+    {"convert_22k_mono", 1000, run_convert_22k},
+    {"convert_44k_stereo", 1000, run_convert_44k},
+    {"adpcm_decode_1s", 300, run_adpcm},
+};
+#define BENCHMARKS (int)(sizeof(benchmarks) / sizeof(benchmarks[0]))
+
+static int setup(void) {
+  queue = create_packet_queue();
+  if (queue == NULL ||
+      socketpair(AF_UNIX, SOCK_SEQPACKET, 0, frame_fds) != 0) {
+    return -1;
+  }
+  frame_reader_init(&frame_reader, frame_fds[1]);
+
+  char ring_name[64];
+  snprintf(ring_name, sizeof(ring_name), "/hampod_perf_%d", (int)getpid());
+  ring = shm_ring_create(ring_name);
+  if (ring == NULL) {
+    return -1;
+  }
+  shm_unlink(ring_name); /* Stays mapped */
+
+  if (mkdtemp(cache_dir) == NULL) {
+    return -1;
+  }
+  setenv("HAMPOD_TTS_CACHE_DIR", cache_dir, 1);
+
+  WavFormat mono_22k = {WAV_ENCODING_PCM, 1, 22050, 16, 0, 0};
+  WavFormat stereo_44k = {WAV_ENCODING_PCM, 2, 44100, 16, 0, 0};
+  if (hal_audio_converter_init(&converter_22k, &mono_22k) != 0 ||
+      hal_audio_converter_init(&converter_44k, &stereo_44k) != 0) {
+    return -1;
+  }
+  convert_in = calloc(CONVERT_FRAMES, 4);
+  convert_out = calloc(hal_audio_converter_max_out(&converter_44k,
+                                                   CONVERT_FRAMES) +
+                           hal_audio_converter_max_out(&converter_22k,
+                                                       CONVERT_FRAMES),
+                       sizeof(int16_t));
+  if (convert_in == NULL || convert_out == NULL) {
+    return -1;
+  }
+  for (int i = 0; i < CONVERT_FRAMES * 2; i++) {
+    ((int16_t *)convert_in)[i] = (int16_t)(i * 37);
+  }
+  int16_t pcm[ADPCM_SAMPLES];
+  for (int i = 0; i < ADPCM_SAMPLES; i++) {
+    pcm[i] = (int16_t)(i * 53);
+  }
+  hal_adpcm_encode(pcm, ADPCM_SAMPLES, adpcm_in);
+  return 0;
+}
+
+static void teardown(void) {
+  hal_tts_cache_cleanup();
+  DIR *dir = opendir(cache_dir);
+  struct dirent *ent;
+  char path[512];
+  while (dir != NULL && (ent = readdir(dir)) != NULL) {
+    if (ent->d_name[0] != '.') {
+      snprintf(path, sizeof(path), "%s/%s", cache_dir, ent->d_name);
+      remove(path);
+    }
+  }
+  if (dir != NULL) {
+    closedir(dir);
+  }
+  rmdir(cache_dir);
+}
+
+int main(int argc, char *argv[]) {
+  int save = argc > 1 && strcmp(argv[1], "--save") == 0;
+  const char *tolerance_env = getenv("HAMPOD_PERF_TOLERANCE");
+  double tolerance =
+      (tolerance_env ? atof(tolerance_env) : DEFAULT_TOLERANCE) / 100.0;
+
+  printf("========================================\n");
+  printf("Firmware Performance Tier\n");
+  printf("========================================\n");
+  if (setup() != 0) {
+    perror("Setup failed");
+    return 1;
+  }
+
+  char path[256];
+  baseline_path(path, sizeof(path));
+  FILE *baseline = save ? NULL : fopen(path, "r");
+  printf("Baseline: %s%s\n\n", path,
+         baseline ? "" : (save ? " (saving)" : " (none yet, saving)"));
+  printf("%-22s %12s %12s %8s\n", "Benchmark", "ns/op", "Baseline", "Change");
+
+  double results[BENCHMARKS];
+  int failed = 0;
+  for (int b = 0; b < BENCHMARKS; b++) {
+    if (strcmp(benchmarks[b].name, "cache_lookup_ram") == 0) {
+      cache_reopen("100000000");
+      cache_fill();
+    } else if (strcmp(benchmarks[b].name, "cache_lookup_store") == 0) {
+      cache_reopen("0"); /* Every lookup reads the store */
+    }
+    results[b] = measure(&benchmarks[b]);
+    double stored = baseline ? baseline_of(baseline, benchmarks[b].name) : 0;
+    if (stored <= 0) {
+      printf("%-22s %12.1f %12s\n", benchmarks[b].name, results[b], "-");
+      continue;
+    }
+    double change = results[b] / stored - 1.0;
+    if (change > tolerance) {
+      /* Measure again before failing, in case something else ran */
+      double again = measure(&benchmarks[b]);
+      results[b] = again < results[b] ? again : results[b];
+      change = results[b] / stored - 1.0;
+    }
+    int regressed = change > tolerance;
+    printf("%-22s %12.1f %12.1f %+7.0f%%%s\n", benchmarks[b].name, results[b],
+           stored, change * 100, regressed ? "  REGRESSION" : "");
+    failed += regressed;
+  }
+  teardown();
+
+  if (baseline != NULL) {
+    fclose(baseline);
+  } else {
+    mkdir(BASELINE_DIR, 0755);
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+      perror(path);
+      return 1;
+    }
+    for (int b = 0; b < BENCHMARKS; b++) {
+      fprintf(f, "%s %.1f\n", benchmarks[b].name, results[b]);
+    }
+    fclose(f);
+    printf("\nSaved the baseline to %s\n", path);
+  }
+
+  printf("\n========================================\n");
+  printf("Results: %d of %d over baseline by more than %.0f%%\n", failed,
+         BENCHMARKS, tolerance * 100);
+  printf("========================================\n");
+  return failed > 0 ? 1 : 0;
+}
@@ -10,6 +10,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 /* Test result counters */
@@ -236,6 +237,127 @@ void test_audio_interrupt(void) {
   hal_audio_cleanup();
 }
 
+/**
+ * Test: Segment queue plays a gapless sequence and cancels at once
+ */
+void test_audio_segments(void) {
+  static int16_t tone[1600]; /* 100ms */
+
+  printf("\n=== Test: Segment Queue ===\n");
+
+  if (hal_audio_init() != 0) {
+    TEST_FAIL("init for segment test", "hal_audio_init failed");
+    return;
+  }
+  hal_audio_clear_interrupt(); /* Left set by the interrupt test */
+
+  for (int i = 0; i < 1600; i++) {
+    tone[i] = (i / 16) % 2 ? 8000 : -8000; /* 500Hz square wave */
+  }
+
+  if (hal_audio_queue_samples(tone, 1600) != 0 ||
+      hal_audio_queue_silence(100) != 0 ||
+      hal_audio_queue_samples(tone, 1600) != 0) {
+    TEST_FAIL("queue tone, silence, tone", "queueing failed");
+  } else {
+    TEST_PASS("queue tone, silence, tone");
+  }
+  usleep(50000);
+  if (!hal_audio_is_playing()) {
+    TEST_FAIL("is_playing with segments queued", "should be 1");
+  } else {
+    TEST_PASS("is_playing with segments queued");
+  }
+  usleep(400000);
+  if (hal_audio_is_playing()) {
+    TEST_FAIL("sequence finished", "still playing");
+  } else {
+    TEST_PASS("sequence finished");
+  }
+
+  int full = 0;
+  for (int i = 0; i < 100 && !full; i++) {
+    full = hal_audio_queue_silence(1000) != 0;
+  }
+  if (!full) {
+    TEST_FAIL("queue limit", "never refused a segment");
+  } else {
+    TEST_PASS("queue limit reached without blocking");
+  }
+
+  hal_audio_cancel_all();
+  usleep(50000);
+  if (hal_audio_is_playing()) {
+    TEST_FAIL("hal_audio_cancel_all", "still playing");
+  } else {
+    TEST_PASS("hal_audio_cancel_all");
+  }
+  if (hal_audio_queue_silence(10) != 0) {
+    TEST_FAIL("queue after cancel", "refused");
+  } else {
+    TEST_PASS("queue after cancel");
+  }
+
+  hal_audio_cleanup();
+}
+
+static long long monotonic_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * Test: A marker comes back once the audio before it has played, and at
+ * once when that audio is cancelled
+ */
+void test_audio_markers(void) {
+  printf("\n=== Test: Markers ===\n");
+
+  if (hal_audio_init() != 0) {
+    TEST_FAIL("init for marker test", "hal_audio_init failed");
+    return;
+  }
+  hal_audio_clear_interrupt();
+
+  unsigned int id = 0;
+  long long start = monotonic_ms();
+  if (hal_audio_queue_silence(300) != 0 || hal_audio_queue_marker(7) != 0) {
+    TEST_FAIL("queue silence and marker", "queueing failed");
+  } else if (hal_audio_wait_marker(&id) != 0 || id != 7) {
+    TEST_FAIL("marker after 300ms of silence", "wrong id or stopped");
+  } else if (monotonic_ms() - start < 250) {
+    TEST_FAIL("marker after 300ms of silence", "came back before it played");
+  } else {
+    TEST_PASS("marker after 300ms of silence");
+  }
+
+  if (hal_audio_queue_silence(2000) != 0 || hal_audio_queue_marker(8) != 0) {
+    TEST_FAIL("queue 2s and marker", "queueing failed");
+  } else {
+    usleep(100000);
+    start = monotonic_ms();
+    hal_audio_cancel_all();
+    if (hal_audio_wait_marker(&id) != 0 || id != 8) {
+      TEST_FAIL("cancelled marker", "wrong id or stopped");
+    } else if (monotonic_ms() - start > 200) {
+      TEST_FAIL("cancelled marker", "waited for the cancelled audio");
+    } else {
+      TEST_PASS("cancelled marker comes back at once");
+    }
+  }
+
+  hal_audio_interrupt();
+  if (hal_audio_queue_marker(9) == 0) {
+    TEST_FAIL("marker while interrupted", "was queued");
+  } else {
+    TEST_PASS("marker while interrupted refused");
+  }
+  hal_audio_clear_interrupt();
+
+  hal_audio_cleanup();
+}
+
 /* ============================================================================
  * Main
  * ============================================================================
@@ -255,6 +377,8 @@ int main(int argc, char *argv[]) {
   test_audio_play_file();
   test_audio_play_beep();
   test_audio_interrupt();
+  test_audio_segments();
+  test_audio_markers();
 
   /* Summary */
   printf("\n=============================================\n");
@@ -0,0 +1,160 @@
+/**
+ * @file test_hal_audio_clips.c
+ * @brief Unit tests for the RAM clip library
+ *
+ * Builds a throwaway clip directory in /tmp, so no audio device or
+ * pregen_audio checkout is needed.
+ */
+
+#include "../hal_audio_clips.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(cond, msg)                                                 \
+  do {                                                                         \
+    if (cond) {                                                                \
+      printf("  [PASS] %s\n", msg);                                            \
+      tests_passed++;                                                          \
+    } else {                                                                   \
+      printf("  [FAIL] %s\n", msg);                                            \
+      tests_failed++;                                                          \
+    }                                                                          \
+  } while (0)
+
+static char clip_dir[] = "/tmp/hampod_clips_XXXXXX";
+
+static void put_le32(unsigned char *p, unsigned int v) {
+  p[0] = v;
+  p[1] = v >> 8;
+  p[2] = v >> 16;
+  p[3] = v >> 24;
+}
+
+static void put_le16(unsigned char *p, unsigned int v) {
+  p[0] = v;
+  p[1] = v >> 8;
+}
+
+/* Write a canonical 44-byte-header WAV whose samples all equal value */
+static void write_wav(const char *name, int rate, int num_samples,
+                      short value) {
+  unsigned char header[44] = "RIFF....WAVEfmt ....................data";
+  put_le32(header + 4, 36 + num_samples * 2);
+  put_le32(header + 16, 16);
+  put_le16(header + 20, 1); /* PCM */
+  put_le16(header + 22, 1); /* Mono */
+  put_le32(header + 24, rate);
+  put_le32(header + 28, rate * 2);
+  put_le16(header + 32, 2);
+  put_le16(header + 34, 16);
+  put_le32(header + 40, num_samples * 2);
+
+  char path[128];
+  snprintf(path, sizeof(path), "%s/%s", clip_dir, name);
+  FILE *f = fopen(path, "wb");
+  fwrite(header, 1, sizeof(header), f);
+  for (int i = 0; i < num_samples; i++) {
+    unsigned char sample[2];
+    put_le16(sample, (unsigned short)value);
+    fwrite(sample, 1, 2, f);
+  }
+  fclose(f);
+}
+
+static int find(const char *name, const int16_t **samples, size_t *count) {
+  char path[128];
+  snprintf(path, sizeof(path), "%s/%s", clip_dir, name);
+  return hal_audio_clips_find(path, samples, count);
+}
+
+void test_load(void) {
+  printf("\n=== Test: Load Clip Directory ===\n");
+
+  write_wav("5.wav", 16000, 100, 5);
+  write_wav("dtmf_a.wav", 48000, 300, 7);
+
+  char path[128];
+  snprintf(path, sizeof(path), "%s/junk.wav", clip_dir);
+  FILE *f = fopen(path, "w");
+  fputs("not a wav file", f);
+  fclose(f);
+
+  TEST_ASSERT(hal_audio_clips_load(clip_dir) == 2,
+              "Only readable clips are loaded");
+
+  const int16_t *samples = NULL;
+  size_t count = 0;
+  TEST_ASSERT(find("5", &samples, &count) == 0, "Clip found by name");
+  TEST_ASSERT(count == 100 && samples[0] == 5 && samples[99] == 5,
+              "Clip samples match the file");
+  TEST_ASSERT(find("dtmf_a", &samples, &count) == 0 && count == 100 &&
+                  samples[0] == 7 && samples[99] == 7,
+              "48kHz clip resampled to 16kHz");
+  TEST_ASSERT(find("junk", &samples, &count) == -1,
+              "Unreadable clip left to the file path");
+  TEST_ASSERT(find("missing", &samples, &count) == -1,
+              "Unknown clip not found");
+  TEST_ASSERT(hal_audio_clips_find("elsewhere/5", &samples, &count) == -1,
+              "Clip path outside the directory not found");
+}
+
+void test_reload(void) {
+  printf("\n=== Test: Reload on Change ===\n");
+
+  const int16_t *samples = NULL;
+  size_t count = 0;
+
+  write_wav("5.wav", 16000, 50, 9);
+  TEST_ASSERT(find("5", &samples, &count) == 0 && count == 50 &&
+                  samples[0] == 9,
+              "Rewritten clip reloaded");
+
+  write_wav("new.wav", 16000, 10, 3);
+  TEST_ASSERT(find("new", &samples, &count) == 0 && count == 10,
+              "Added clip loaded");
+
+  char path[128];
+  snprintf(path, sizeof(path), "%s/dtmf_a.wav", clip_dir);
+  unlink(path);
+  TEST_ASSERT(find("dtmf_a", &samples, &count) == -1,
+              "Deleted clip dropped");
+}
+
+void test_cleanup(void) {
+  printf("\n=== Test: Cleanup ===\n");
+
+  const int16_t *samples = NULL;
+  size_t count = 0;
+  hal_audio_clips_cleanup();
+  TEST_ASSERT(find("5", &samples, &count) == -1, "Library empty after cleanup");
+}
+
+int main(void) {
+  printf("=============================================\n");
+  printf("  HAMPOD Audio Clip Library Unit Tests\n");
+  printf("=============================================\n");
+
+  if (mkdtemp(clip_dir) == NULL) {
+    perror("mkdtemp");
+    return 1;
+  }
+
+  test_load();
+  test_reload();
+  test_cleanup();
+
+  char cmd[64];
+  snprintf(cmd, sizeof(cmd), "rm -rf %s", clip_dir);
+  system(cmd);
+
+  printf("\n=============================================\n");
+  printf("  Results: %d passed, %d failed\n", tests_passed, tests_failed);
+  printf("=============================================\n");
+
+  return tests_failed > 0 ? 1 : 0;
+}
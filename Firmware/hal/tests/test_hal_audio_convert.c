@@ -0,0 +1,307 @@
+/**
+ * @file test_hal_audio_convert.c
+ * @brief Unit tests for WAV parsing and conversion to 16kHz mono s16
+ *
+ * Writes small WAV files to /tmp; no audio device is needed.
+ */
+
+#include "../hal_audio_adpcm.h"
+#include "../hal_audio_convert.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(cond, msg)                                                 \
+  do {                                                                         \
+    if (cond) {                                                                \
+      printf("  [PASS] %s\n", msg);                                            \
+      tests_passed++;                                                          \
+    } else {                                                                   \
+      printf("  [FAIL] %s\n", msg);                                            \
+      tests_failed++;                                                          \
+    }                                                                          \
+  } while (0)
+
+#define TEST_WAV "/tmp/hampod_convert_test.wav"
+
+static void put_le32(unsigned char *p, unsigned int v) {
+  p[0] = v;
+  p[1] = v >> 8;
+  p[2] = v >> 16;
+  p[3] = v >> 24;
+}
+
+static void put_le16(unsigned char *p, unsigned int v) {
+  p[0] = v;
+  p[1] = v >> 8;
+}
+
+/*
+ * Write TEST_WAV. extensible uses a WAVE_FORMAT_EXTENSIBLE fmt chunk and
+ * adds a LIST chunk before the data, as some editors do.
+ */
+static void write_wav(int encoding, int channels, int rate, int bits,
+                      const void *data, size_t data_bytes, int extensible) {
+  unsigned char fmt[40] = {0};
+  size_t fmt_len = extensible ? 40 : 16;
+  put_le16(fmt, extensible ? 0xFFFE : encoding);
+  put_le16(fmt + 2, channels);
+  put_le32(fmt + 4, rate);
+  put_le32(fmt + 8, rate * channels * bits / 8);
+  put_le16(fmt + 12, channels * bits / 8);
+  put_le16(fmt + 14, bits);
+  if (extensible) {
+    put_le16(fmt + 16, 22);
+    put_le16(fmt + 18, bits);
+    put_le16(fmt + 24, encoding); /* Sub-format GUID starts with the tag */
+  }
+
+  static const unsigned char list[] = "LIST\x04\x00\x00\x00INFO";
+  size_t list_len = extensible ? 12 : 0;
+
+  unsigned char head[12];
+  memcpy(head, "RIFF", 4);
+  put_le32(head + 4, 4 + 8 + fmt_len + list_len + 8 + data_bytes);
+  memcpy(head + 8, "WAVE", 4);
+
+  unsigned char chunk[8];
+  FILE *f = fopen(TEST_WAV, "wb");
+  fwrite(head, 1, sizeof(head), f);
+  memcpy(chunk, "fmt ", 4);
+  put_le32(chunk + 4, fmt_len);
+  fwrite(chunk, 1, 8, f);
+  fwrite(fmt, 1, fmt_len, f);
+  fwrite(list, 1, list_len, f);
+  memcpy(chunk, "data", 4);
+  put_le32(chunk + 4, data_bytes);
+  fwrite(chunk, 1, 8, f);
+  fwrite(data, 1, data_bytes, f);
+  fclose(f);
+}
+
+/* Every sample equals value */
+static int all_equal(const int16_t *samples, size_t count, int16_t value) {
+  for (size_t i = 0; i < count; i++) {
+    if (samples[i] != value) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+void test_native(void) {
+  printf("\n=== Test: Native Format ===\n");
+
+  int16_t data[100];
+  for (int i = 0; i < 100; i++) {
+    data[i] = (int16_t)(i * 100 - 5000);
+  }
+  write_wav(WAV_ENCODING_PCM, 1, 16000, 16, data, sizeof(data), 0);
+
+  int16_t *samples = NULL;
+  size_t count = 0;
+  TEST_ASSERT(hal_audio_convert_file(TEST_WAV, &samples, &count) == 0,
+              "16kHz mono s16 loads");
+  TEST_ASSERT(count == 100 && memcmp(samples, data, sizeof(data)) == 0,
+              "Samples unchanged");
+  free(samples);
+}
+
+void test_formats(void) {
+  printf("\n=== Test: Sample Formats ===\n");
+
+  int16_t *samples = NULL;
+  size_t count = 0;
+
+  int16_t stereo[2 * 64];
+  for (int i = 0; i < 64; i++) {
+    stereo[2 * i] = 1000;
+    stereo[2 * i + 1] = -200;
+  }
+  write_wav(WAV_ENCODING_PCM, 2, 16000, 16, stereo, sizeof(stereo), 0);
+  TEST_ASSERT(hal_audio_convert_file(TEST_WAV, &samples, &count) == 0 &&
+                  count == 64 && all_equal(samples, count, 400),
+              "Stereo s16 downmixed to the channel average");
+  free(samples);
+
+  unsigned char u8[32];
+  memset(u8, 0xC0, sizeof(u8));
+  write_wav(WAV_ENCODING_PCM, 1, 16000, 8, u8, sizeof(u8), 0);
+  TEST_ASSERT(hal_audio_convert_file(TEST_WAV, &samples, &count) == 0 &&
+                  count == 32 && all_equal(samples, count, 16384),
+              "Unsigned 8-bit widened");
+  free(samples);
+
+  unsigned char s24[3 * 10];
+  for (int i = 0; i < 10; i++) {
+    s24[3 * i] = 0x56;
+    s24[3 * i + 1] = 0x34;
+    s24[3 * i + 2] = 0x12;
+  }
+  write_wav(WAV_ENCODING_PCM, 1, 16000, 24, s24, sizeof(s24), 0);
+  TEST_ASSERT(hal_audio_convert_file(TEST_WAV, &samples, &count) == 0 &&
+                  count == 10 && all_equal(samples, count, 0x1234),
+              "24-bit keeps the top 16 bits");
+  free(samples);
+
+  float f32[2 * 10];
+  for (int i = 0; i < 20; i++) {
+    f32[i] = 0.5f;
+  }
+  write_wav(WAV_ENCODING_FLOAT, 2, 16000, 32, f32, sizeof(f32), 1);
+  TEST_ASSERT(hal_audio_convert_file(TEST_WAV, &samples, &count) == 0 &&
+                  count == 10 && all_equal(samples, count, 16383),
+              "Extensible float stereo with a LIST chunk");
+  free(samples);
+
+  unsigned char adpcm[16] = {0};
+  write_wav(2 /* MS ADPCM */, 1, 16000, 4, adpcm, sizeof(adpcm), 0);
+  TEST_ASSERT(hal_audio_convert_file(TEST_WAV, &samples, &count) == -1,
+              "Compressed encoding refused");
+}
+
+void test_resample(void) {
+  printf("\n=== Test: Resampling ===\n");
+
+  int16_t *samples = NULL;
+  size_t count = 0;
+
+  int16_t flat[441];
+  for (int i = 0; i < 441; i++) {
+    flat[i] = 1234;
+  }
+  write_wav(WAV_ENCODING_PCM, 1, 44100, 16, flat, sizeof(flat), 0);
+  TEST_ASSERT(hal_audio_convert_file(TEST_WAV, &samples, &count) == 0 &&
+                  count == 160 && all_equal(samples, count, 1234),
+              "10ms at 44.1kHz becomes 160 samples");
+  free(samples);
+
+  int16_t ramp[80];
+  for (int i = 0; i < 80; i++) {
+    ramp[i] = (int16_t)(i * 100);
+  }
+  write_wav(WAV_ENCODING_PCM, 1, 8000, 16, ramp, sizeof(ramp), 0);
+  TEST_ASSERT(hal_audio_convert_file(TEST_WAV, &samples, &count) == 0 &&
+                  count == 158 && samples[0] == 0 && samples[1] == 50 &&
+                  samples[2] == 100 && samples[157] == 7850,
+              "8kHz ramp interpolated between samples");
+  free(samples);
+}
+
+void test_adpcm(void) {
+  printf("\n=== Test: IMA-ADPCM ===\n");
+
+  enum { N = 2 * ADPCM_BLOCK_SAMPLES };
+  static int16_t tone[N];
+  for (int i = 0; i < N; i++) {
+    tone[i] = (int16_t)(8000.0 * sin(i * 2.0 * M_PI * 440.0 / 16000.0));
+  }
+  static uint8_t encoded[2 * ADPCM_BLOCK_BYTES];
+  TEST_ASSERT(hal_adpcm_encoded_bytes(N) == sizeof(encoded),
+              "Two full blocks hold 2 * ADPCM_BLOCK_SAMPLES");
+  hal_adpcm_encode(tone, N, encoded);
+
+  static int16_t decoded[N];
+  hal_adpcm_decode(encoded, N, decoded);
+  int worst = 0;
+  for (int i = 16; i < N; i++) { /* Once the step size has caught up */
+    int err = abs(decoded[i] - tone[i]);
+    worst = err > worst ? err : worst;
+  }
+  TEST_ASSERT(decoded[0] == tone[0] && decoded[ADPCM_BLOCK_SAMPLES] ==
+                                           tone[ADPCM_BLOCK_SAMPLES],
+              "Blocks start on the exact sample");
+  TEST_ASSERT(worst < 800, "Decoded tone tracks the original");
+
+  /* A short last block, of odd and of even length */
+  static int16_t tail[N];
+  for (size_t n = N - 3; n <= N - 2; n++) {
+    hal_adpcm_encode(tone, n, encoded);
+    hal_adpcm_decode(encoded, n, tail);
+    TEST_ASSERT(hal_adpcm_encoded_bytes(n) < sizeof(encoded) &&
+                    memcmp(tail, decoded, n * sizeof(int16_t)) == 0,
+                "Short last block decodes the same");
+  }
+
+  /* The same blocks as a WAV file (block_align patched in) */
+  hal_adpcm_encode(tone, N, encoded);
+  write_wav(WAV_ENCODING_IMA_ADPCM, 1, 16000, 4, encoded, sizeof(encoded), 0);
+  unsigned char align[2];
+  put_le16(align, ADPCM_BLOCK_BYTES);
+  FILE *f = fopen(TEST_WAV, "r+b");
+  fseek(f, 12 + 8 + 12, SEEK_SET);
+  fwrite(align, 1, sizeof(align), f);
+  fclose(f);
+
+  int16_t *samples = NULL;
+  size_t count = 0;
+  TEST_ASSERT(hal_audio_convert_file(TEST_WAV, &samples, &count) == 0 &&
+                  count == N &&
+                  memcmp(samples, decoded, sizeof(decoded)) == 0,
+              "IMA-ADPCM WAV decodes like hal_adpcm_decode()");
+  free(samples);
+
+  write_wav(WAV_ENCODING_IMA_ADPCM, 2, 16000, 4, encoded, sizeof(encoded), 0);
+  TEST_ASSERT(hal_audio_convert_file(TEST_WAV, &samples, &count) == -1,
+              "Stereo IMA-ADPCM refused");
+}
+
+void test_streaming(void) {
+  printf("\n=== Test: Chunked Conversion ===\n");
+
+  WavFormat fmt = {WAV_ENCODING_PCM, 2, 44100, 16, 0};
+  int16_t in[2 * 1000];
+  for (int i = 0; i < 1000; i++) {
+    in[2 * i] = (int16_t)(i * 30);
+    in[2 * i + 1] = (int16_t)(-i * 10);
+  }
+
+  AudioConverter whole, pieces;
+  TEST_ASSERT(hal_audio_converter_init(&whole, &fmt) == 0 &&
+                  hal_audio_converter_init(&pieces, &fmt) == 0,
+              "Converters initialised");
+
+  static int16_t one_shot[1000];
+  static int16_t chunked[1000];
+  long n_whole = hal_audio_convert(&whole, (const uint8_t *)in, 1000, one_shot);
+
+  long n_chunked = 0;
+  for (int start = 0; start < 1000; start += 7) {
+    int frames = 1000 - start < 7 ? 1000 - start : 7;
+    n_chunked += hal_audio_convert(&pieces, (const uint8_t *)(in + 2 * start),
+                                   frames, chunked + n_chunked);
+  }
+
+  TEST_ASSERT(n_whole > 0 && n_whole == n_chunked &&
+                  memcmp(one_shot, chunked, n_whole * sizeof(int16_t)) == 0,
+              "Chunk boundaries do not change the output");
+  TEST_ASSERT((size_t)n_whole <= hal_audio_converter_max_out(&whole, 1000),
+              "Output fits the advertised bound");
+
+  hal_audio_converter_free(&whole);
+  hal_audio_converter_free(&pieces);
+}
+
+int main(void) {
+  printf("=============================================\n");
+  printf("  HAMPOD Audio Conversion Unit Tests\n");
+  printf("=============================================\n");
+
+  test_native();
+  test_formats();
+  test_resample();
+  test_adpcm();
+  test_streaming();
+  unlink(TEST_WAV);
+
+  printf("\n=============================================\n");
+  printf("  Results: %d passed, %d failed\n", tests_passed, tests_failed);
+  printf("=============================================\n");
+
+  return tests_failed > 0 ? 1 : 0;
+}
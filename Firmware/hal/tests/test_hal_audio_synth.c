@@ -0,0 +1,169 @@
+/**
+ * @file test_hal_audio_synth.c
+ * @brief Unit tests for tone synthesis (beeps, DTMF, tuning tone sine)
+ *
+ * Pure computation; no audio device is needed.
+ */
+
+#include "../hal_audio_synth.h"
+#include "../../hampod_alloc.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(cond, msg)                                                 \
+  do {                                                                         \
+    if (cond) {                                                                \
+      printf("  [PASS] %s\n", msg);                                            \
+      tests_passed++;                                                          \
+    } else {                                                                   \
+      printf("  [FAIL] %s\n", msg);                                            \
+      tests_failed++;                                                          \
+    }                                                                          \
+  } while (0)
+
+static void test_parse(void) {
+  printf("\nTest: tone parsing\n");
+  HalTone tone;
+
+  TEST_ASSERT(hal_tone_parse("1000", &tone) == 0 && tone.hz == 1000 &&
+                  tone.hz2 == 0 && tone.ms == HAL_TONE_DEFAULT_MS &&
+                  tone.level == HAL_TONE_DEFAULT_LEVEL &&
+                  tone.ramp_ms == HAL_TONE_DEFAULT_RAMP_MS,
+              "Pitch alone takes the defaults");
+  TEST_ASSERT(hal_tone_parse(" 697+1209/200/40/10 ", &tone) == 0 &&
+                  tone.hz == 697 && tone.hz2 == 1209 && tone.ms == 200 &&
+                  tone.level == 40 && tone.ramp_ms == 10,
+              "Pair with length, level and ramp");
+  TEST_ASSERT(hal_tone_parse("400/100", &tone) == 0 && tone.ms == 100 &&
+                  tone.level == HAL_TONE_DEFAULT_LEVEL,
+              "Length without level");
+
+  TEST_ASSERT(hal_tone_parse("", &tone) != 0, "Empty text is refused");
+  TEST_ASSERT(hal_tone_parse("beep", &tone) != 0, "Words are refused");
+  TEST_ASSERT(hal_tone_parse("10", &tone) != 0, "Pitch below range");
+  TEST_ASSERT(hal_tone_parse("9000", &tone) != 0, "Pitch above Nyquist");
+  TEST_ASSERT(hal_tone_parse("1000/0", &tone) != 0, "Zero length");
+  TEST_ASSERT(hal_tone_parse("1000/50/101", &tone) != 0, "Level over 100");
+  TEST_ASSERT(hal_tone_parse("1000/50/50x", &tone) != 0, "Trailing text");
+  TEST_ASSERT(hal_tone_parse("1000+/50", &tone) != 0, "Missing second pitch");
+}
+
+static void test_dtmf(void) {
+  printf("\nTest: DTMF pairs\n");
+  HalTone tone;
+
+  TEST_ASSERT(hal_tone_dtmf('1', 0, &tone) == 0 && tone.hz == 697 &&
+                  tone.hz2 == 1209 && tone.ms == HAL_TONE_DTMF_MS,
+              "1 is 697+1209 Hz");
+  TEST_ASSERT(hal_tone_dtmf('0', 80, &tone) == 0 && tone.hz == 941 &&
+                  tone.hz2 == 1336 && tone.ms == 80,
+              "0 is 941+1336 Hz, length kept");
+  TEST_ASSERT(hal_tone_dtmf('#', 0, &tone) == 0 && tone.hz == 941 &&
+                  tone.hz2 == 1477,
+              "# is 941+1477 Hz");
+  TEST_ASSERT(hal_tone_dtmf('D', 0, &tone) == 0 && tone.hz == 941 &&
+                  tone.hz2 == 1633,
+              "D is 941+1633 Hz");
+  TEST_ASSERT(hal_tone_dtmf('E', 0, &tone) != 0, "E has no pair");
+  TEST_ASSERT(hal_tone_dtmf('\0', 0, &tone) != 0, "NUL has no pair");
+}
+
+static void test_sine(void) {
+  printf("\nTest: sine table\n");
+  hal_tone_init();
+
+  double worst = 0.0;
+  for (uint32_t i = 0; i < 4096; i++) {
+    uint32_t phase = i * 1048573u; /* Odd step, not on table entries */
+    double want = 30000.0 * sin(phase * (2.0 * M_PI / 4294967296.0));
+    double err = fabs(hal_tone_sine(phase, 30000) - want);
+    if (err > worst) {
+      worst = err;
+    }
+  }
+  printf("  Worst error %.2f of 30000\n", worst);
+  TEST_ASSERT(worst <= 6.0, "Within 0.02% of a true sine");
+  TEST_ASSERT(hal_tone_sine(0x40000000u, 10000) >= 9998,
+              "Quarter turn reaches the level");
+  TEST_ASSERT(hal_tone_sine(0xC0000000u, 10000) <= -9998,
+              "Three quarters reach minus the level");
+}
+
+/* Zero crossings going up, as a pitch in Hz */
+static double measured_hz(const int16_t *samples, size_t n) {
+  int crossings = 0;
+  for (size_t i = 1; i < n; i++) {
+    crossings += samples[i - 1] < 0 && samples[i] >= 0;
+  }
+  return crossings * (double)HAL_TONE_RATE / n;
+}
+
+static void test_render(void) {
+  printf("\nTest: rendering\n");
+  HalTone tone = {1000, 0, 50, 50, 5};
+  int16_t *samples = NULL;
+  size_t n = 0;
+
+  TEST_ASSERT(hal_tone_render(&tone, &samples, &n) == 0 && n == 800,
+              "50ms is 800 samples");
+  if (samples == NULL) {
+    return;
+  }
+  int peak = 0;
+  for (size_t i = 0; i < n; i++) {
+    peak = abs(samples[i]) > peak ? abs(samples[i]) : peak;
+  }
+  TEST_ASSERT(peak > 16000 && peak <= 16384, "Peak at half scale");
+  TEST_ASSERT(abs(samples[0]) < 500 && abs(samples[n - 1]) < 500,
+              "Envelope starts and ends near silence");
+  double hz = measured_hz(samples, n);
+  printf("  Measured %.0f Hz\n", hz);
+  TEST_ASSERT(hz > 960 && hz < 1040, "Pitch is 1000 Hz");
+  hampod_free(samples);
+
+  HalTone pair;
+  hal_tone_dtmf('5', 100, &pair);
+  TEST_ASSERT(hal_tone_render(&pair, &samples, &n) == 0 && n == 1600,
+              "DTMF 5 renders 100ms");
+  peak = 0;
+  for (size_t i = 0; i < n; i++) {
+    peak = abs(samples[i]) > peak ? abs(samples[i]) : peak;
+  }
+  TEST_ASSERT(peak > 12000 && peak <= 16384, "Pair peaks at the level");
+  hampod_free(samples);
+}
+
+static void test_mix(void) {
+  printf("\nTest: mixing\n");
+  HalTone tone = {500, 0, 20, 100, 0};
+  HalToneVoice voice;
+  hal_tone_start(&voice, &tone);
+
+  int16_t out[400];
+  for (int i = 0; i < 400; i++) {
+    out[i] = 30000;
+  }
+  size_t left = hal_tone_mix(&voice, out, 160);
+  TEST_ASSERT(left == 160, "Half the tone is left after 10ms");
+  TEST_ASSERT(out[8] == INT16_MAX, "Sum saturates at the int16 range");
+  left = hal_tone_mix(&voice, out + 160, 240);
+  TEST_ASSERT(left == 0 && out[399] == 30000,
+              "Ends after its length, leaving the rest alone");
+}
+
+int main(void) {
+  printf("=== Tone Synthesis Tests ===\n");
+  test_parse();
+  test_dtmf();
+  test_sine();
+  test_render();
+  test_mix();
+  printf("\n=== Results: %d passed, %d failed ===\n", tests_passed,
+         tests_failed);
+  return tests_failed > 0 ? 1 : 0;
+}
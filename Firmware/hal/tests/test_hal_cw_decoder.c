@@ -0,0 +1,205 @@
+/**
+ * @file test_hal_cw_decoder.c
+ * @brief Unit tests for the Morse decoder, on synthesized keyed tones
+ *
+ * Pure computation; no audio device is needed.
+ */
+
+#include "../hal_cw_decoder.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(cond, msg)                                                 \
+  do {                                                                         \
+    if (cond) {                                                                \
+      printf("  [PASS] %s\n", msg);                                            \
+      tests_passed++;                                                          \
+    } else {                                                                   \
+      printf("  [FAIL] %s\n", msg);                                            \
+      tests_failed++;                                                          \
+    }                                                                          \
+  } while (0)
+
+#define MAX_SAMPLES (HAL_CW_RATE * 60)
+#define RAMP_MS 5 /* Keying edges, as a rig shapes them */
+
+static int16_t audio[MAX_SAMPLES];
+static size_t audio_len;
+static double phase;
+
+/* Codes for the letters the tests send */
+static const char *code_of(char c) {
+  static const char *letters[] = {
+      ".-",   "-...", "-.-.", "-..",  ".",    "..-.", "--.",  "....", "..",
+      ".---", "-.-",  ".-..", "--",   "-.",   "---",  ".--.", "--.-", ".-.",
+      "...",  "-",    "..-",  "...-", ".--",  "-..-", "-.--", "--.."};
+  static const char *digits[] = {"-----", ".----", "..---", "...--",
+                                 "....-", ".....", "-....", "--...",
+                                 "---..", "----."};
+  if (c >= 'A' && c <= 'Z') {
+    return letters[c - 'A'];
+  }
+  if (c >= '0' && c <= '9') {
+    return digits[c - '0'];
+  }
+  return c == '?' ? "..--.." : c == '/' ? "-..-." : "";
+}
+
+/* Gaussian noise, for a noise floor of a given level */
+static double noise(void) {
+  double u = (rand() + 1.0) / (RAND_MAX + 2.0);
+  double v = (rand() + 1.0) / (RAND_MAX + 2.0);
+  return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * v);
+}
+
+/* Append ms of tone (or silence) with noise */
+static void key(double ms, int down, int hz, double level, double hiss) {
+  size_t n = (size_t)(ms * HAL_CW_RATE / 1000.0);
+  size_t ramp = RAMP_MS * HAL_CW_RATE / 1000;
+  for (size_t i = 0; i < n && audio_len < MAX_SAMPLES; i++) {
+    double envelope = 0.0;
+    if (down) {
+      envelope = 1.0;
+      if (i < ramp) {
+        envelope = 0.5 - 0.5 * cos(M_PI * i / ramp);
+      } else if (n - i < ramp) {
+        envelope = 0.5 - 0.5 * cos(M_PI * (n - i) / ramp);
+      }
+    }
+    double s = envelope * level * sin(phase) + hiss * noise();
+    phase += 2.0 * M_PI * hz / HAL_CW_RATE;
+    if (s > 1.0) {
+      s = 1.0;
+    } else if (s < -1.0) {
+      s = -1.0;
+    }
+    audio[audio_len++] = (int16_t)(s * 32767.0);
+  }
+}
+
+/* Synthesize text keyed at wpm, with letter and word spacing stretched by
+ * spacing (1.0 is exact) */
+static void send(const char *text, int wpm, int hz, double level,
+                 double hiss, double spacing) {
+  double dot = 1200.0 / wpm;
+  audio_len = 0;
+  phase = 0.0;
+  key(500, 0, hz, level, hiss); /* Some noise to learn the floor from */
+  for (const char *c = text; *c != '\0'; c++) {
+    if (*c == ' ') {
+      key(4 * dot * spacing, 0, hz, level, hiss); /* 7 with the letter's 3 */
+      continue;
+    }
+    for (const char *e = code_of(*c); *e != '\0'; e++) {
+      key(*e == '.' ? dot : 3 * dot, 1, hz, level, hiss);
+      key(dot, 0, hz, level, hiss);
+    }
+    key(2 * dot * spacing, 0, hz, level, hiss);
+  }
+  key(2000, 0, hz, level, hiss); /* Long enough to end the last word */
+}
+
+static char decoded[1024];
+static HalCwDecoder decoder;
+
+/* Decode the synthesized audio, fed in uneven pieces as capture gives it */
+static const char *decode(void) {
+  size_t len = 0;
+  size_t pieces[] = {160, 37, 441, 64, 1};
+  hal_cw_decoder_init(&decoder);
+  for (size_t at = 0, p = 0; at < audio_len; p++) {
+    size_t n = pieces[p % 5];
+    if (n > audio_len - at) {
+      n = audio_len - at;
+    }
+    len += hal_cw_decoder_feed(&decoder, audio + at, n, decoded + len,
+                               sizeof(decoded) - 1 - len);
+    at += n;
+  }
+  while (len > 0 && decoded[len - 1] == ' ') {
+    len--;
+  }
+  decoded[len] = '\0';
+  return decoded;
+}
+
+/* Whether the text sent decodes as itself */
+static int decodes(const char *text, int wpm, int hz, double level,
+                   double hiss) {
+  send(text, wpm, hz, level, hiss, 1.0);
+  int ok = strcmp(decode(), text) == 0;
+  if (!ok) {
+    printf("    %d wpm %d Hz: \"%s\" -> \"%s\"\n", wpm, hz, text, decoded);
+  }
+  return ok;
+}
+
+static void test_clean(void) {
+  printf("\nTest: clean signals\n");
+
+  TEST_ASSERT(decodes("CQ CQ DE W1AW K", 20, 600, 0.5, 0.0),
+              "20 wpm at 600 Hz");
+  TEST_ASSERT(decodes("PARIS PARIS", 20, 700, 0.1, 0.0),
+              "Quiet signal decodes the same");
+  TEST_ASSERT(decodes("THE QUICK BROWN FOX 73", 12, 500, 0.5, 0.0),
+              "Slow sender, timed from 20 wpm");
+  TEST_ASSERT(decodes("VK2ABC/P 599 TU", 35, 800, 0.5, 0.0),
+              "Fast sender");
+  TEST_ASSERT(decodes("QRL?", 18, 1100, 0.5, 0.0), "Pitch near the top");
+  TEST_ASSERT(decodes("0123456789", 20, 450, 0.5, 0.0), "Digits");
+}
+
+static void test_noise(void) {
+  printf("\nTest: noise\n");
+  srand(1);
+
+  TEST_ASSERT(decodes("CQ DX DE G4ABC", 20, 650, 0.3, 0.02),
+              "Signal well above the noise");
+  TEST_ASSERT(decodes("TEST DE K1ABC", 25, 750, 0.1, 0.02),
+              "Weaker signal in the same noise");
+
+  send("", 20, 600, 0.0, 0.05, 1.0);
+  key(10000, 0, 600, 0.0, 0.05);
+  TEST_ASSERT(decode()[0] == '\0', "Noise alone decodes as nothing");
+}
+
+static void test_timing(void) {
+  printf("\nTest: timing\n");
+
+  send("PARIS PARIS PARIS", 15, 600, 0.5, 0.0, 1.0);
+  decode();
+  int wpm = hal_cw_decoder_wpm(&decoder);
+  TEST_ASSERT(wpm >= 13 && wpm <= 17, "Speed measured from the sender");
+  TEST_ASSERT(hal_cw_decoder_pitch(&decoder) == 600, "Pitch found");
+
+  send("HELLO WORLD", 20, 600, 0.5, 0.0, 1.6);
+  TEST_ASSERT(strcmp(decode(), "HELLO WORLD") == 0,
+              "Farnsworth spacing between letters and words");
+
+  hal_cw_decoder_init(&decoder);
+  char small[2];
+  send("CQ CQ", 20, 600, 0.5, 0.0, 1.0);
+  size_t n = hal_cw_decoder_feed(&decoder, audio, audio_len, small, 2);
+  TEST_ASSERT(n == 2 && small[0] == 'C' && small[1] == 'Q',
+              "Letters past the room given are dropped");
+}
+
+int main(void) {
+  printf("========================================\n");
+  printf("CW Decoder Tests\n");
+  printf("========================================\n");
+
+  test_clean();
+  test_noise();
+  test_timing();
+
+  printf("\n========================================\n");
+  printf("Results: %d passed, %d failed\n", tests_passed, tests_failed);
+  printf("========================================\n");
+  return tests_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,220 @@
+/**
+ * @file test_hal_keypad_replay.c
+ * @brief Keypad HAL tests and latency benchmark from replayed traces
+ *
+ * Each test writes a trace of input events with known timing, replays it
+ * through the USB keypad HAL (HAMPOD_KEYPAD_REPLAY) and checks how the
+ * presses, '00' double events, releases and holds come out. No keypad is
+ * needed. The time each event took to be classified, from its stamp to
+ * hal_keypad_wait() returning it, is printed as the benchmark.
+ */
+
+#include "../hal_keypad.h"
+#include <linux/input.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(cond, msg)                                                 \
+  do {                                                                         \
+    if (cond) {                                                                \
+      printf("  [PASS] %s\n", msg);                                            \
+      tests_passed++;                                                          \
+    } else {                                                                   \
+      printf("  [FAIL] %s\n", msg);                                            \
+      tests_failed++;                                                          \
+    }                                                                          \
+  } while (0)
+
+#define TRACE_PATH "/tmp/hampod_keypad_trace.evdev"
+#define TRACE_MAX 32
+#define WAIT_MS 2000
+#define SLACK_MS 50 /* Allowed for scheduling on a busy machine */
+
+/* One recorded event: ms after the first, key code and value (1 press,
+ * 0 release, 2 repeat) */
+typedef struct {
+  int ms;
+  int code;
+  int value;
+} TraceStep;
+
+/* Events as they came out of the HAL, with their classification latency */
+static KeypadEvent events[TRACE_MAX];
+static long latency_us[TRACE_MAX];
+static int event_count;
+
+static uint64_t now_us(void) {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (uint64_t)tv.tv_sec * 1000000ULL + (uint64_t)tv.tv_usec;
+}
+
+/* Write steps as a trace, each key event followed by a SYN_REPORT */
+static void write_trace(const TraceStep *steps, int count) {
+  FILE *f = fopen(TRACE_PATH, "wb");
+  if (f == NULL) {
+    perror(TRACE_PATH);
+    exit(1);
+  }
+  for (int i = 0; i < count; i++) {
+    struct input_event ev = {0};
+    ev.time.tv_sec = 1000 + steps[i].ms / 1000;
+    ev.time.tv_usec = (steps[i].ms % 1000) * 1000;
+    ev.type = EV_KEY;
+    ev.code = (unsigned short)steps[i].code;
+    ev.value = steps[i].value;
+    fwrite(&ev, sizeof(ev), 1, f);
+    ev.type = EV_SYN;
+    ev.code = SYN_REPORT;
+    ev.value = 0;
+    fwrite(&ev, sizeof(ev), 1, f);
+  }
+  fclose(f);
+}
+
+/* Replay steps and collect the first expected events the HAL reports */
+static void replay(const TraceStep *steps, int count, int phone_layout,
+                   int hold_ms, int expected) {
+  write_trace(steps, count);
+  setenv(HAL_KEYPAD_REPLAY_ENV, TRACE_PATH, 1);
+  hal_keypad_set_phone_layout(phone_layout);
+  hal_keypad_set_hold_threshold(hold_ms);
+  event_count = 0;
+  if (hal_keypad_init() != 0) {
+    return;
+  }
+  while (event_count < expected) {
+    KeypadEvent event = hal_keypad_wait(WAIT_MS);
+    if (event.action == KEYPAD_ACTION_NONE) {
+      break;
+    }
+    latency_us[event_count] = (long)(now_us() - event.timestamp_us);
+    events[event_count++] = event;
+  }
+  hal_keypad_cleanup();
+  remove(TRACE_PATH);
+}
+
+static int is_event(int i, int action, char key) {
+  return i < event_count && events[i].action == action &&
+         events[i].key == key;
+}
+
+static void print_latency(const char *what, int i) {
+  if (i < event_count) {
+    printf("  %-36s %6.1f ms\n", what, latency_us[i] / 1000.0);
+  }
+}
+
+void test_press_release(void) {
+  printf("\n=== Test: Press and Release ===\n");
+  const TraceStep steps[] = {{0, KEY_KP5, 1}, {80, KEY_KP5, 0},
+                             {200, KEY_KP8, 1}, {260, KEY_KP8, 0}};
+  replay(steps, 4, 0, 0, 4);
+
+  TEST_ASSERT(event_count == 4, "Four events");
+  TEST_ASSERT(is_event(0, KEYPAD_ACTION_PRESS, '5') && events[0].valid,
+              "Press of 5");
+  TEST_ASSERT(is_event(1, KEYPAD_ACTION_RELEASE, '5') && !events[1].valid,
+              "Its release, not valid for polling callers");
+  TEST_ASSERT(event_count == 4 &&
+                  events[2].timestamp_us - events[0].timestamp_us == 200000,
+              "Recorded spacing kept in the stamps");
+  TEST_ASSERT(event_count > 0 && latency_us[0] < SLACK_MS * 1000L,
+              "Press reported at once");
+  print_latency("Press classified after", 0);
+}
+
+void test_double_zero(void) {
+  printf("\n=== Test: Phone Layout 0 and 00 ===\n");
+  /* The '00' key: two KP0 presses 20 ms apart */
+  const TraceStep double_zero[] = {{0, KEY_KP0, 1}, {8, KEY_KP0, 0},
+                                   {20, KEY_KP0, 1}, {28, KEY_KP0, 0}};
+  replay(double_zero, 4, 1, 0, 2);
+  TEST_ASSERT(is_event(0, KEYPAD_ACTION_PRESS, '0'), "00 key is 0");
+  TEST_ASSERT(is_event(1, KEYPAD_ACTION_RELEASE, '0'), "One release");
+  print_latency("00 classified after", 0);
+
+  /* The '0' key, a finger's tap */
+  const TraceStep tap[] = {{0, KEY_KP0, 1}, {90, KEY_KP0, 0}};
+  replay(tap, 2, 1, 0, 2);
+  TEST_ASSERT(is_event(0, KEYPAD_ACTION_PRESS, '*'), "0 key is *");
+  TEST_ASSERT(is_event(1, KEYPAD_ACTION_RELEASE, '*'), "Then its release");
+  TEST_ASSERT(event_count > 0 && latency_us[0] >= 8000 &&
+                  latency_us[0] < (30 + SLACK_MS) * 1000L,
+              "Decided when the 0/00 window closes");
+  print_latency("Single 0 classified after", 0);
+
+  /* Another key inside the window ends it at once */
+  const TraceStep then_five[] = {{0, KEY_KP0, 1}, {5, KEY_KP0, 0},
+                                 {12, KEY_KP5, 1}, {60, KEY_KP5, 0}};
+  replay(then_five, 4, 1, 0, 4);
+  TEST_ASSERT(is_event(0, KEYPAD_ACTION_PRESS, '*') &&
+                  is_event(2, KEYPAD_ACTION_PRESS, '5'),
+              "0 then 5: * and 5");
+}
+
+void test_calculator_double_zero(void) {
+  printf("\n=== Test: Calculator Layout 00 ===\n");
+  const TraceStep steps[] = {{0, KEY_KP0, 1}, {8, KEY_KP0, 0},
+                             {20, KEY_KP0, 1}, {28, KEY_KP0, 0},
+                             {300, KEY_KP5, 1}, {340, KEY_KP5, 0}};
+  replay(steps, 6, 0, 0, 4);
+  int zeros = 0;
+  for (int i = 0; i < event_count; i++) {
+    zeros += is_event(i, KEYPAD_ACTION_PRESS, '0');
+  }
+  TEST_ASSERT(zeros == 1, "Second KP0 of the 00 key suppressed");
+  TEST_ASSERT(is_event(0, KEYPAD_ACTION_PRESS, '0'), "Reported as one 0");
+}
+
+void test_hold(void) {
+  printf("\n=== Test: Hold and Repeat ===\n");
+  const TraceStep steps[] = {{0, KEY_KP5, 1}, {250, KEY_KP5, 2},
+                             {400, KEY_KP5, 0}};
+  replay(steps, 3, 0, 150, 4);
+
+  TEST_ASSERT(is_event(0, KEYPAD_ACTION_PRESS, '5'), "Press");
+  TEST_ASSERT(is_event(1, KEYPAD_ACTION_HOLD, '5') &&
+                  events[1].timestamp_us - events[0].timestamp_us == 150000,
+              "Hold stamped press + threshold");
+  TEST_ASSERT(event_count > 1 && latency_us[1] < SLACK_MS * 1000L,
+              "Hold reported when the threshold passes");
+  TEST_ASSERT(is_event(2, KEYPAD_ACTION_REPEAT, '5'), "Then the repeat");
+  TEST_ASSERT(is_event(3, KEYPAD_ACTION_RELEASE, '5'), "Then the release");
+  print_latency("Hold classified after", 1);
+
+  const TraceStep short_press[] = {{0, KEY_KP5, 1}, {100, KEY_KP5, 0}};
+  replay(short_press, 2, 0, 150, 2);
+  TEST_ASSERT(is_event(1, KEYPAD_ACTION_RELEASE, '5'),
+              "Released before the threshold: no hold");
+}
+
+void test_missing_trace(void) {
+  printf("\n=== Test: Missing Trace ===\n");
+  setenv(HAL_KEYPAD_REPLAY_ENV, "/nonexistent.evdev", 1);
+  TEST_ASSERT(hal_keypad_init() != 0, "Init fails");
+  hal_keypad_cleanup();
+}
+
+int main(void) {
+  printf("========================================\n");
+  printf("Keypad Trace Replay Tests\n");
+  printf("========================================\n");
+
+  test_press_release();
+  test_double_zero();
+  test_calculator_double_zero();
+  test_hold();
+  test_missing_trace();
+
+  printf("\n========================================\n");
+  printf("Results: %d passed, %d failed\n", tests_passed, tests_failed);
+  printf("========================================\n");
+  return tests_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,209 @@
+/**
+ * @file test_hal_remote.c
+ * @brief Unit tests for the remote station protocol and jitter buffer
+ */
+
+#include "../hal_remote.h"
+#include <stdio.h>
+#include <string.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(cond, msg)                                                 \
+  do {                                                                         \
+    if (cond) {                                                                \
+      printf("  [PASS] %s\n", msg);                                            \
+      tests_passed++;                                                          \
+    } else {                                                                   \
+      printf("  [FAIL] %s\n", msg);                                            \
+      tests_failed++;                                                          \
+    }                                                                          \
+  } while (0)
+
+static RemoteJitter jb;
+static unsigned char payload[REMOTE_PACKET_MAX];
+static size_t payload_len;
+
+/* A one-byte payload naming its packet, so playout order can be checked */
+static void put(uint16_t seq, int marker) {
+  unsigned char byte = (unsigned char)seq;
+  hal_remote_jitter_put(&jb, seq, marker, &byte, 1);
+}
+
+static int get(void) {
+  payload_len = 0;
+  return hal_remote_jitter_get(&jb, payload, &payload_len);
+}
+
+void test_address(void) {
+  printf("\n=== Test: Address Parsing ===\n");
+
+  struct sockaddr_in addr;
+  TEST_ASSERT(hal_remote_parse_address("192.168.1.20:5004", &addr) == 0 &&
+                  addr.sin_port == htons(5004) &&
+                  addr.sin_addr.s_addr == htonl(0xC0A80114),
+              "IPv4 address and port");
+  TEST_ASSERT(hal_remote_parse_address("192.168.1.20", &addr) != 0,
+              "Missing port refused");
+  TEST_ASSERT(hal_remote_parse_address("192.168.1.20:0", &addr) != 0,
+              "Port 0 refused");
+  TEST_ASSERT(hal_remote_parse_address("192.168.1.20:99999", &addr) != 0,
+              "Port out of range refused");
+}
+
+void test_keys(void) {
+  printf("\n=== Test: Key Datagrams ===\n");
+
+  RemoteKeyEvent sent[2] = {
+      {41, 1700000000123456ULL, '5', KEYPAD_ACTION_PRESS},
+      {42, 1700000000223456ULL, '5', KEYPAD_ACTION_RELEASE},
+  };
+  RemoteKeyEvent got[REMOTE_KEY_EVENTS];
+  unsigned char data[REMOTE_KEY_DATAGRAM_MAX];
+  uint32_t session = 0;
+
+  size_t len = hal_remote_encode_keys(0xDEADBEEF, sent, 2, data);
+  TEST_ASSERT(len == REMOTE_KEY_HEADER_LEN + 2 * REMOTE_KEY_EVENT_LEN,
+              "Length is header and two events");
+  TEST_ASSERT(hal_remote_decode_keys(data, len, &session, got) == 2 &&
+                  session == 0xDEADBEEF,
+              "Decodes two events of the session");
+  TEST_ASSERT(got[0].seq == 41 && got[0].timestamp_us == sent[0].timestamp_us &&
+                  got[0].key == '5' && got[0].action == KEYPAD_ACTION_PRESS &&
+                  got[1].seq == 42 && got[1].action == KEYPAD_ACTION_RELEASE,
+              "Events round-trip, oldest first");
+
+  TEST_ASSERT(hal_remote_decode_keys(data, len - 1, &session, got) == -1,
+              "Truncated datagram refused");
+  data[0] = 'X';
+  TEST_ASSERT(hal_remote_decode_keys(data, len, &session, got) == -1,
+              "Wrong magic refused");
+
+  unsigned char rtp[REMOTE_RTP_HEADER_LEN + 1] = {0};
+  hal_remote_rtp_header(rtp, 0, 7, 960, 1);
+  TEST_ASSERT(hal_remote_decode_keys(rtp, sizeof(rtp), &session, got) == -1,
+              "Audio packet is not a key datagram");
+}
+
+void test_rtp(void) {
+  printf("\n=== Test: RTP Header ===\n");
+
+  unsigned char packet[REMOTE_RTP_HEADER_LEN + 3] = {0};
+  int marker = 0;
+  uint16_t seq = 0;
+
+  hal_remote_rtp_header(packet, 1, 65535, 123456, 0x01020304);
+  TEST_ASSERT(packet[0] == 0x80 &&
+                  packet[1] == (0x80 | REMOTE_RTP_PAYLOAD_TYPE),
+              "Version 2, marker and payload type");
+  TEST_ASSERT(hal_remote_rtp_parse(packet, sizeof(packet), &marker, &seq) ==
+                      REMOTE_RTP_HEADER_LEN &&
+                  marker == 1 && seq == 65535,
+              "Parses back marker and sequence number");
+
+  hal_remote_rtp_header(packet, 0, 3, 0, 1);
+  TEST_ASSERT(hal_remote_rtp_parse(packet, sizeof(packet), &marker, &seq) ==
+                      REMOTE_RTP_HEADER_LEN &&
+                  marker == 0 && seq == 3,
+              "Unmarked packet");
+  TEST_ASSERT(hal_remote_rtp_parse(packet, REMOTE_RTP_HEADER_LEN, &marker,
+                                   &seq) == -1,
+              "Packet without payload refused");
+  packet[1] = 0;
+  TEST_ASSERT(hal_remote_rtp_parse(packet, sizeof(packet), &marker, &seq) == -1,
+              "Other payload type refused");
+}
+
+void test_jitter_order(void) {
+  printf("\n=== Test: Jitter Buffer Ordering ===\n");
+
+  hal_remote_jitter_init(&jb, 3 * REMOTE_FRAME_MS);
+  TEST_ASSERT(get() == REMOTE_JITTER_WAIT, "Empty buffer waits");
+
+  put(100, 1);
+  put(102, 0);
+  TEST_ASSERT(get() == REMOTE_JITTER_WAIT, "Waits until target is queued");
+  put(101, 0);
+  TEST_ASSERT(get() == REMOTE_JITTER_PACKET && payload[0] == 100 &&
+                  payload_len == 1,
+              "Playout starts at the first packet");
+  TEST_ASSERT(get() == REMOTE_JITTER_PACKET && payload[0] == 101,
+              "Reordered packet played in sequence");
+  TEST_ASSERT(get() == REMOTE_JITTER_PACKET && payload[0] == 102,
+              "Then the next");
+  TEST_ASSERT(get() == REMOTE_JITTER_WAIT, "Ran dry");
+
+  put(101, 0);
+  TEST_ASSERT(jb.late == 1 && get() == REMOTE_JITTER_WAIT,
+              "Packet already played dropped as late");
+}
+
+void test_jitter_loss(void) {
+  printf("\n=== Test: Jitter Buffer Loss ===\n");
+
+  hal_remote_jitter_init(&jb, REMOTE_FRAME_MS);
+  put(65535, 1);
+  put(1, 0); /* 0 lost, across the wrap */
+  TEST_ASSERT(get() == REMOTE_JITTER_PACKET && payload[0] == 0xFF,
+              "Plays the packet before the gap");
+  TEST_ASSERT(get() == REMOTE_JITTER_MISSING && jb.lost == 1,
+              "Missing packet reported for concealment");
+
+  hal_remote_jitter_init(&jb, REMOTE_FRAME_MS);
+  put(10, 1);
+  put(12, 0);
+  get();
+  TEST_ASSERT(hal_remote_jitter_peek(&jb, payload, &payload_len) == 0,
+              "Nothing to peek at for the lost packet itself");
+  TEST_ASSERT(get() == REMOTE_JITTER_MISSING &&
+                  hal_remote_jitter_peek(&jb, payload, &payload_len) == 1 &&
+                  payload[0] == 12,
+              "Peek finds the packet after the loss, for its FEC");
+  TEST_ASSERT(get() == REMOTE_JITTER_PACKET && payload[0] == 12,
+              "Peeked packet still played next");
+}
+
+void test_jitter_resync(void) {
+  printf("\n=== Test: Jitter Buffer Resync ===\n");
+
+  hal_remote_jitter_init(&jb, REMOTE_FRAME_MS);
+  put(500, 1);
+  get();
+  put(9000, 1);
+  TEST_ASSERT(get() == REMOTE_JITTER_PACKET && payload[0] == (9000 & 0xFF),
+              "Sender restart (marker on empty buffer) starts over");
+
+  put(9001 + REMOTE_JITTER_SLOTS, 0);
+  TEST_ASSERT(get() == REMOTE_JITTER_PACKET &&
+                  payload[0] == ((9001 + REMOTE_JITTER_SLOTS) & 0xFF),
+              "Packet too far ahead starts over");
+
+  hal_remote_jitter_init(&jb, REMOTE_FRAME_MS);
+  put(20, 1);
+  put(21, 0);
+  get();
+  put(22, 1); /* A new spurt, numbered on */
+  TEST_ASSERT(get() == REMOTE_JITTER_PACKET && payload[0] == 21 &&
+                  get() == REMOTE_JITTER_PACKET && payload[0] == 22,
+              "Marker while packets are queued keeps the sequence");
+}
+
+int main(void) {
+  printf("=============================================\n");
+  printf("  HAMPOD Remote Station Unit Tests\n");
+  printf("=============================================\n");
+
+  test_address();
+  test_keys();
+  test_rtp();
+  test_jitter_order();
+  test_jitter_loss();
+  test_jitter_resync();
+
+  printf("\n=============================================\n");
+  printf("  Results: %d passed, %d failed\n", tests_passed, tests_failed);
+  printf("=============================================\n");
+
+  return tests_failed > 0 ? 1 : 0;
+}
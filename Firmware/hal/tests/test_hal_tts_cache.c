@@ -0,0 +1,751 @@
+/**
+ * @file test_hal_tts_cache.c
+ * @brief Unit tests for the TTS cache's RAM tier and packed store
+ *
+ * Runs against a temporary cache directory. The cache counters tell RAM
+ * hits from store hits.
+ */
+
+#include "../hal_tts_cache.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(cond, msg)                                                 \
+  do {                                                                         \
+    if (cond) {                                                                \
+      printf("  [PASS] %s\n", msg);                                            \
+      tests_passed++;                                                          \
+    } else {                                                                   \
+      printf("  [FAIL] %s\n", msg);                                            \
+      tests_failed++;                                                          \
+    }                                                                          \
+  } while (0)
+
+#define TEST_SAMPLES 1000
+#define BIG_SAMPLES (3 * 1024 * 1024) /* 6MB: three span two segments */
+
+static char cache_dir[] = "/tmp/hampod_tts_cache_XXXXXX";
+
+/* Delete every file in a directory */
+static void remove_files_in(const char *path_dir) {
+  DIR *dir = opendir(path_dir);
+  struct dirent *ent;
+  char path[512];
+  while (dir != NULL && (ent = readdir(dir)) != NULL) {
+    if (ent->d_name[0] != '.') {
+      snprintf(path, sizeof(path), "%s/%s", path_dir, ent->d_name);
+      remove(path);
+    }
+  }
+  if (dir != NULL) {
+    closedir(dir);
+  }
+}
+
+/* Delete every file in the cache directory */
+static void remove_files(void) { remove_files_in(cache_dir); }
+
+/* Number of files in a directory whose name starts with prefix */
+static int count_files_in(const char *path_dir, const char *prefix) {
+  DIR *dir = opendir(path_dir);
+  struct dirent *ent;
+  int count = 0;
+  while (dir != NULL && (ent = readdir(dir)) != NULL) {
+    if (ent->d_name[0] != '.' &&
+        strncmp(ent->d_name, prefix, strlen(prefix)) == 0) {
+      count++;
+    }
+  }
+  if (dir != NULL) {
+    closedir(dir);
+  }
+  return count;
+}
+
+/* Number of files in the cache directory whose name starts with prefix */
+static int count_files(const char *prefix) {
+  return count_files_in(cache_dir, prefix);
+}
+
+/* Start over, empty, with a RAM budget of ram_bytes */
+static void reset_cache(const char *ram_bytes) {
+  hal_tts_cache_cleanup();
+  remove_files();
+  setenv("HAMPOD_TTS_CACHE_RAM", ram_bytes, 1);
+}
+
+static void store(const char *text, int16_t value) {
+  int16_t samples[TEST_SAMPLES];
+  for (int i = 0; i < TEST_SAMPLES; i++) {
+    samples[i] = value;
+  }
+  hal_tts_cache_store(text, 1.0f, samples, TEST_SAMPLES);
+}
+
+/* Where a lookup of text was served from, with its samples all equal to
+ * value: 'r' RAM, 'd' the packed store, 0 a miss or the wrong samples */
+static char lookup(const char *text, int16_t value) {
+  HalTtsCacheStats before;
+  HalTtsCacheStats after;
+  const int16_t *samples;
+  size_t num_samples;
+  hal_tts_cache_get_stats(&before);
+  if (hal_tts_cache_lookup(text, 1.0f, &samples, &num_samples) != 0) {
+    return 0;
+  }
+  hal_tts_cache_get_stats(&after);
+  int ok = num_samples == TEST_SAMPLES;
+  for (size_t i = 0; ok && i < num_samples; i++) {
+    ok = samples[i] == value;
+  }
+  hal_tts_cache_release(samples);
+  if (!ok) {
+    return 0;
+  }
+  return after.ram_hits > before.ram_hits ? 'r' : 'd';
+}
+
+void test_ram_hits(void) {
+  printf("\n=== Test: RAM Hits ===\n");
+  reset_cache("1000000");
+
+  store("Radio connected", 7);
+  TEST_ASSERT(lookup("Radio connected", 7) == 'r', "Stored phrase hits RAM");
+  TEST_ASSERT(hal_tts_cache_contains("Radio connected", 1.0f),
+              "Contains sees it");
+  TEST_ASSERT(!hal_tts_cache_contains("Radio connected", 1.5f),
+              "Other speeds are separate entries");
+
+  store("Shift", 3);
+  hal_tts_cache_cleanup();
+  TEST_ASSERT(lookup("Shift", 3) == 'd', "Read from the store after cleanup");
+  TEST_ASSERT(lookup("Shift", 3) == 'r', "Store hit is kept in RAM");
+
+  hal_tts_cache_clear();
+  TEST_ASSERT(lookup("Shift", 3) == 0 && lookup("Radio connected", 7) == 0,
+              "Clear empties both tiers");
+}
+
+void test_eviction(void) {
+  printf("\n=== Test: LRU Eviction ===\n");
+  /* Room for two entries, not three */
+  reset_cache("5000");
+
+  store("one", 1);
+  store("two", 2);
+  TEST_ASSERT(lookup("one", 1) == 'r', "Touch the older entry");
+  store("three", 3);
+  TEST_ASSERT(lookup("one", 1) == 'r' && lookup("three", 3) == 'r',
+              "Recently used entries stay");
+  TEST_ASSERT(lookup("two", 2) == 'd',
+              "Least recently used entry is evicted to the store");
+
+  reset_cache("100");
+  store("big", 4);
+  TEST_ASSERT(lookup("big", 4) == 'd',
+              "Entry over the whole budget is not kept in RAM");
+
+  reset_cache("0");
+  store("off", 5);
+  TEST_ASSERT(lookup("off", 5) == 'd' && lookup("off", 5) == 'd',
+              "Budget 0 keeps nothing in RAM");
+}
+
+void test_references(void) {
+  printf("\n=== Test: References ===\n");
+  reset_cache("5000");
+
+  store("held", 9);
+  const int16_t *held;
+  size_t num_samples;
+  TEST_ASSERT(hal_tts_cache_lookup("held", 1.0f, &held, &num_samples) == 0,
+              "Lookup takes a reference");
+
+  store("held", 8); /* Replaces it */
+  store("a", 1);
+  store("b", 2); /* Evicts everything older */
+  int intact = num_samples == TEST_SAMPLES;
+  for (size_t i = 0; intact && i < num_samples; i++) {
+    intact = held[i] == 9;
+  }
+  TEST_ASSERT(intact, "Held samples survive replacement and eviction");
+  hal_tts_cache_release(held);
+  hal_tts_cache_release(NULL);
+  TEST_ASSERT(lookup("held", 8) == 'd', "Replacement is in the store");
+}
+
+void test_store_owned(void) {
+  printf("\n=== Test: Store Owned ===\n");
+  reset_cache("1000000");
+
+  size_t capacity;
+  int16_t *buffer = hal_tts_cache_buffer(&capacity);
+  TEST_ASSERT(buffer != NULL && capacity >= TEST_SAMPLES, "Capture buffer");
+  for (int i = 0; buffer != NULL && i < TEST_SAMPLES; i++) {
+    buffer[i] = 6;
+  }
+  TEST_ASSERT(buffer != NULL && hal_tts_cache_store_owned(
+                                    "USB", 1.0f, buffer, TEST_SAMPLES,
+                                    capacity) == 0,
+              "Handed to the writer");
+  TEST_ASSERT(lookup("USB", 6) == 'r', "Hits at once, before it is written");
+  hal_tts_cache_cleanup(); /* Waits for the write */
+  TEST_ASSERT(lookup("USB", 6) == 'd', "Written to the store by cleanup");
+}
+
+void test_packed_store(void) {
+  printf("\n=== Test: Packed Store ===\n");
+  reset_cache("0");
+
+  char text[32];
+  for (int i = 0; i < 3000; i++) { /* Past the index's first size */
+    snprintf(text, sizeof(text), "phrase %d", i);
+    store(text, (int16_t)i);
+  }
+  hal_tts_cache_cleanup();
+  int found = 0;
+  for (int i = 0; i < 3000; i++) {
+    snprintf(text, sizeof(text), "phrase %d", i);
+    found += lookup(text, (int16_t)i) == 'd';
+  }
+  TEST_ASSERT(found == 3000, "Every entry found after the index grew");
+  TEST_ASSERT(count_files("index.bin") == 1 && count_files("seg_") == 1 &&
+                  count_files("index.sizes") == 1 && count_files("") == 3,
+              "One index, its sizes journal and one segment file, not one "
+              "file per entry");
+  HalTtsCacheStats stats;
+  hal_tts_cache_get_stats(&stats);
+  TEST_ASSERT(stats.entries == 3000 &&
+                  stats.disk_bytes > 3000ULL * TEST_SAMPLES * 2 &&
+                  stats.disk_bytes < 3000ULL * (TEST_SAMPLES * 2 + 16),
+              "Entry count and size accounted");
+
+  reset_cache("0");
+  int16_t *big = malloc(BIG_SAMPLES * sizeof(int16_t));
+  for (int e = 0; big != NULL && e < 3; e++) {
+    for (int i = 0; i < BIG_SAMPLES; i++) {
+      big[i] = (int16_t)(e + i);
+    }
+    snprintf(text, sizeof(text), "long %d", e);
+    hal_tts_cache_store(text, 1.0f, big, BIG_SAMPLES);
+  }
+  hal_tts_cache_cleanup();
+  int intact = big != NULL;
+  for (int e = 0; intact && e < 3; e++) {
+    const int16_t *samples;
+    size_t num_samples;
+    snprintf(text, sizeof(text), "long %d", e);
+    intact = hal_tts_cache_lookup(text, 1.0f, &samples, &num_samples) == 0 &&
+             num_samples == BIG_SAMPLES;
+    for (int i = 0; intact && i < BIG_SAMPLES; i++) {
+      intact = samples[i] == (int16_t)(e + i);
+    }
+    if (num_samples == BIG_SAMPLES) {
+      hal_tts_cache_release(samples);
+    }
+  }
+  free(big);
+  TEST_ASSERT(intact && count_files("seg_") == 2,
+              "Entries roll over into a second segment intact");
+}
+
+void test_voices(void) {
+  printf("\n=== Test: Voices ===\n");
+  reset_cache("1000000");
+
+  hal_tts_cache_set_voice("models/en_US-lessac-low.onnx");
+  store("Mode", 1);
+  hal_tts_cache_set_voice("/opt/voices/en_GB-alan-low.onnx");
+  TEST_ASSERT(lookup("Mode", 1) == 0, "Another voice misses");
+  store("Mode", 2);
+  hal_tts_cache_set_voice("en_US-lessac-low.onnx");
+  TEST_ASSERT(lookup("Mode", 1) == 'd',
+              "Back to the first voice (by file name) hits its entry");
+  hal_tts_cache_set_voice(NULL);
+}
+
+void test_keys(void) {
+  printf("\n=== Test: Keys ===\n");
+  reset_cache("0");
+
+  /* The same djb2 hash, which keyed the old layout */
+  store("Aa", 1);
+  store("B@", 2);
+  TEST_ASSERT(lookup("Aa", 1) == 'd' && lookup("B@", 2) == 'd',
+              "Texts with the same short hash are kept apart");
+
+  int16_t samples[TEST_SAMPLES];
+  for (int i = 0; i < TEST_SAMPLES; i++) {
+    samples[i] = 3;
+  }
+  hal_tts_cache_store("Aa", 1.25f, samples, TEST_SAMPLES);
+  hal_tts_cache_set_voice("en_GB-alan-low.onnx");
+  store("Aa", 4);
+  TEST_ASSERT(lookup("Aa", 4) == 'd', "Other voice has its own entry");
+  hal_tts_cache_set_voice(NULL);
+  const int16_t *found;
+  size_t num_samples;
+  int fast = hal_tts_cache_lookup("Aa", 1.25f, &found, &num_samples) == 0 &&
+             found[0] == 3;
+  if (fast) {
+    hal_tts_cache_release(found);
+  }
+  TEST_ASSERT(fast && lookup("Aa", 1) == 'd',
+              "Speed and voice variants coexist");
+  TEST_ASSERT(lookup("Aa ", 1) == 0 && lookup("A", 1) == 0,
+              "Texts must match exactly");
+}
+
+void test_verified_entries(void) {
+  printf("\n=== Test: Stored Entries Are Verified ===\n");
+  reset_cache("0");
+
+  store("Mode", 5);
+  hal_tts_cache_cleanup();
+  char path[512];
+  snprintf(path, sizeof(path), "%s/seg_0001.pcm", cache_dir);
+  FILE *f = fopen(path, "r+b");
+  if (f != NULL) {
+    fputc('N', f); /* The entry's text is at the start of the segment */
+    fclose(f);
+  }
+  TEST_ASSERT(f != NULL && lookup("Mode", 5) == 0,
+              "Entry whose stored text differs misses");
+  TEST_ASSERT(!hal_tts_cache_contains("Mode", 1.0f), "Contains agrees");
+
+  reset_cache("0");
+  store("Mode", 5);
+  hal_tts_cache_cleanup();
+  f = fopen(path, "r+b");
+  if (f != NULL) {
+    fseek(f, 100, SEEK_SET); /* Into the samples, as a torn write leaves */
+    fputc(0x55, f);
+    fclose(f);
+  }
+  TEST_ASSERT(f != NULL && lookup("Mode", 5) == 0,
+              "Entry whose samples were damaged misses");
+}
+
+void test_disk_budget(void) {
+  printf("\n=== Test: Disk Budget ===\n");
+  reset_cache("0");
+  setenv("HAMPOD_TTS_CACHE_MAX_SIZE", "2000000", 1);
+
+  char text[32];
+  for (int i = 0; i < 10; i++) {
+    snprintf(text, sizeof(text), "hot %d", i);
+    store(text, (int16_t)i);
+  }
+  int hot = 1;
+  for (int i = 0; i < 2000; i++) { /* Twice the budget */
+    snprintf(text, sizeof(text), "cold %d", i);
+    store(text, (int16_t)i);
+    for (int h = 0; i % 50 == 0 && h < 10; h++) {
+      snprintf(text, sizeof(text), "hot %d", h);
+      hot = hot && lookup(text, (int16_t)h) == 'd';
+    }
+  }
+  hal_tts_cache_cleanup();
+  for (int h = 0; h < 10; h++) {
+    snprintf(text, sizeof(text), "hot %d", h);
+    hot = hot && lookup(text, (int16_t)h) == 'd';
+  }
+  TEST_ASSERT(hot, "Entries heard often stay");
+  TEST_ASSERT(lookup("cold 0", 0) == 0 && lookup("cold 1999", 1999) == 'd',
+              "Old entries heard once go, new ones stay");
+
+  HalTtsCacheStats stats;
+  hal_tts_cache_get_stats(&stats);
+  TEST_ASSERT(stats.disk_bytes <= 2000000 && stats.evicted > 0,
+              "Store kept within the budget");
+  TEST_ASSERT(stats.entries + stats.evicted == 2010,
+              "Every entry indexed or counted as evicted");
+  unsetenv("HAMPOD_TTS_CACHE_MAX_SIZE");
+}
+
+void test_compressed(void) {
+  printf("\n=== Test: Compressed Entries ===\n");
+  reset_cache("0");
+
+  store("Radio connected", 7); /* Stored as PCM */
+  hal_tts_cache_cleanup();
+  setenv("HAMPOD_TTS_CACHE_COMPRESS", "1", 1);
+  HalTtsCacheStats before;
+  HalTtsCacheStats after;
+  hal_tts_cache_get_stats(&before);
+  store("Mode", 5);
+  hal_tts_cache_get_stats(&after);
+  TEST_ASSERT(after.disk_bytes - before.disk_bytes < TEST_SAMPLES,
+              "Compressed entry takes about a quarter of the room");
+  hal_tts_cache_cleanup();
+  TEST_ASSERT(lookup("Mode", 5) == 'd', "Compressed entry decodes");
+  TEST_ASSERT(lookup("Radio connected", 7) == 'd',
+              "Entries stored as PCM still read");
+
+  reset_cache("0");
+  store("Mode", 5);
+  hal_tts_cache_cleanup();
+  char path[512];
+  snprintf(path, sizeof(path), "%s/seg_0001.pcm", cache_dir);
+  FILE *f = fopen(path, "r+b");
+  if (f != NULL) {
+    fseek(f, 100, SEEK_SET);
+    fputc(0x55, f);
+    fclose(f);
+  }
+  TEST_ASSERT(f != NULL && lookup("Mode", 5) == 0,
+              "Damaged compressed entry misses");
+  unsetenv("HAMPOD_TTS_CACHE_COMPRESS");
+}
+
+void test_streamed(void) {
+  printf("\n=== Test: Streamed Entries ===\n");
+  reset_cache("1000000");
+
+  enum { LONG_SAMPLES = 16000 * 3 };
+  int16_t *long_samples = malloc(LONG_SAMPLES * sizeof(int16_t));
+  for (int i = 0; long_samples != NULL && i < LONG_SAMPLES; i++) {
+    long_samples[i] = (int16_t)i;
+  }
+  hal_tts_cache_store("Help text", 1.0f, long_samples, LONG_SAMPLES);
+  hal_tts_cache_cleanup();
+
+  HalTtsCacheStats before;
+  HalTtsCacheStats after;
+  const int16_t *samples;
+  size_t num_samples;
+  hal_tts_cache_get_stats(&before);
+  int hit = hal_tts_cache_lookup("Help text", 1.0f, &samples, &num_samples) == 0;
+  hal_tts_cache_get_stats(&after);
+  int intact = hit && num_samples == LONG_SAMPLES;
+  for (int i = 0; intact && i < LONG_SAMPLES; i++) {
+    intact = samples[i] == long_samples[i];
+  }
+  TEST_ASSERT(intact && after.streamed == before.streamed + 1,
+              "Long entry streamed from the store intact");
+  TEST_ASSERT(after.ram_bytes == before.ram_bytes,
+              "Streamed entry is not copied into RAM");
+  if (hit) {
+    hal_tts_cache_release(samples);
+  }
+
+  /* Damage it: it still streams once, then the check drops it */
+  hal_tts_cache_cleanup();
+  char path[512];
+  snprintf(path, sizeof(path), "%s/seg_0001.pcm", cache_dir);
+  FILE *f = fopen(path, "r+b");
+  if (f != NULL) {
+    fseek(f, 1000, SEEK_SET);
+    fputc(0x55, f);
+    fclose(f);
+  }
+  hit = hal_tts_cache_lookup("Help text", 1.0f, &samples, &num_samples) == 0;
+  if (hit) {
+    hal_tts_cache_release(samples);
+  }
+  hal_tts_cache_cleanup(); /* Waits for the check */
+  TEST_ASSERT(f != NULL && hit &&
+                  !hal_tts_cache_contains("Help text", 1.0f),
+              "Damaged streamed entry dropped after release");
+  free(long_samples);
+}
+
+/* Wait up to a second for the store to be sized at bytes */
+static int wait_disk_bytes(uint64_t bytes) {
+  HalTtsCacheStats stats;
+  for (int i = 0; i < 100; i++) {
+    hal_tts_cache_get_stats(&stats);
+    if (stats.disk_bytes == bytes) {
+      return 1;
+    }
+    usleep(10000);
+  }
+  return 0;
+}
+
+void test_sizes_journal(void) {
+  printf("\n=== Test: Sizes Journal ===\n");
+  reset_cache("0");
+
+  store("Radio connected", 7);
+  store("Mode", 5);
+  HalTtsCacheStats before;
+  HalTtsCacheStats after;
+  hal_tts_cache_get_stats(&before);
+  hal_tts_cache_cleanup();
+  hal_tts_cache_get_stats(&after);
+  TEST_ASSERT(before.disk_bytes > 0 && after.disk_bytes == before.disk_bytes,
+              "Size read back from the journal");
+
+  /* An unclean shutdown: the journal is lost */
+  hal_tts_cache_cleanup();
+  char path[512];
+  snprintf(path, sizeof(path), "%s/index.sizes", cache_dir);
+  remove(path);
+  hal_tts_cache_contains("Mode", 1.0f); /* Opens it again */
+  hal_tts_cache_get_stats(&after);
+  TEST_ASSERT(after.disk_bytes == 0, "Without it nothing is sized at start");
+  hal_tts_cache_begin_upkeep();
+  TEST_ASSERT(wait_disk_bytes(before.disk_bytes),
+              "Sized again in the background once upkeep begins");
+  TEST_ASSERT(lookup("Mode", 5) == 'd', "Entries kept by the repair");
+
+  /* Cut short: the entry written last points past the segment's end */
+  hal_tts_cache_cleanup();
+  snprintf(path, sizeof(path), "%s/seg_0001.pcm", cache_dir);
+  int cut = truncate(path, (off_t)before.disk_bytes - 1) == 0;
+  snprintf(path, sizeof(path), "%s/index.sizes", cache_dir);
+  remove(path);
+  hal_tts_cache_begin_upkeep();
+  TEST_ASSERT(cut && wait_disk_bytes(before.disk_bytes - 1) &&
+                  lookup("Radio connected", 7) == 'd' &&
+                  !hal_tts_cache_contains("Mode", 1.0f),
+              "Entry past the end dropped, the others kept");
+}
+
+static void write_file(const char *name, const void *data, size_t len) {
+  char path[512];
+  snprintf(path, sizeof(path), "%s/%s", cache_dir, name);
+  FILE *f = fopen(path, "wb");
+  if (f != NULL) {
+    fwrite(data, 1, len, f);
+    fclose(f);
+  }
+}
+
+void test_old_layouts(void) {
+  printf("\n=== Test: Old Layouts Are Removed ===\n");
+  reset_cache("0");
+
+  int16_t samples[TEST_SAMPLES] = {0};
+  write_file("0b8d53f8_100.pcm", samples, sizeof(samples));
+  write_file("0b8d53f8.pcm", samples, sizeof(samples));
+  TEST_ASSERT(lookup("Radio connected", 0) == 0 &&
+                  count_files("") == count_files("index.") &&
+                  count_files("index.bin") == 1,
+              "Files of one file per entry removed");
+
+  hal_tts_cache_cleanup();
+  char header[4096] = "HPTTSIX1";
+  write_file("index.bin", header, sizeof(header));
+  write_file("seg_0001.pcm", samples, sizeof(samples));
+  TEST_ASSERT(lookup("Radio connected", 0) == 0 && count_files("seg_") == 0,
+              "Segments of an older index removed");
+  HalTtsCacheStats stats;
+  hal_tts_cache_get_stats(&stats);
+  TEST_ASSERT(stats.disk_bytes == 0 && stats.entries == 0,
+              "Starts again empty");
+}
+
+void test_cache_packs(void) {
+  printf("\n=== Test: Cache Packs ===\n");
+  reset_cache("0");
+
+  char pack[512];
+  snprintf(pack, sizeof(pack), "%s.hpk", cache_dir); /* Outside the cache */
+  store("Mode", 5);
+  store("Shift", 3);
+  const char *const texts[] = {"Mode", "Shift", "Never spoken"};
+  TEST_ASSERT(hal_tts_cache_export(pack, NULL, 1.0f, texts, 3) == 2,
+              "Exports the cached texts, leaves out the rest");
+
+  reset_cache("0");
+  TEST_ASSERT(hal_tts_cache_import(pack) == 2, "Import adds every entry");
+  TEST_ASSERT(lookup("Mode", 5) == 'd' && lookup("Shift", 3) == 'd',
+              "Imported entries hit");
+  TEST_ASSERT(hal_tts_cache_import(pack) == 0,
+              "Entries already cached are skipped");
+
+  FILE *f = fopen(pack, "r+b");
+  if (f != NULL) {
+    fputc('X', f); /* The magic */
+    fclose(f);
+  }
+  TEST_ASSERT(f != NULL && hal_tts_cache_import(pack) == -1,
+              "Damaged pack refused");
+  TEST_ASSERT(hal_tts_cache_import("/nonexistent.hpk") == -1,
+              "Missing pack refused");
+  remove(pack);
+}
+
+void test_hotset(void) {
+  printf("\n=== Test: Hot Set ===\n");
+  reset_cache("1000000");
+
+  store("Mode", 5);
+  store("Shift", 3);
+  store("Never heard", 9);
+  lookup("Mode", 5);
+  lookup("Mode", 5);
+  lookup("Shift", 3);
+  TEST_ASSERT(hal_tts_cache_save_hotset() == 2,
+              "Entries used since stored are saved");
+  hal_tts_cache_cleanup(); /* Saves it again on the way out */
+  TEST_ASSERT(count_files("hotset.bin") == 1, "Hot set written");
+
+  TEST_ASSERT(hal_tts_cache_load_hotset() == 2, "Hot set loaded");
+  TEST_ASSERT(lookup("Mode", 5) == 'r' && lookup("Shift", 3) == 'r',
+              "Its entries hit RAM after a restart");
+  TEST_ASSERT(lookup("Never heard", 9) == 'd', "The rest are left on disk");
+
+  hal_tts_cache_cleanup();
+  setenv("HAMPOD_TTS_CACHE_RAM", "3000", 1); /* Room for one entry */
+  TEST_ASSERT(hal_tts_cache_save_hotset() == -1, "Nothing to save when closed");
+  hal_tts_cache_init();
+  TEST_ASSERT(hal_tts_cache_save_hotset() == 1,
+              "Only as much as the RAM budget holds");
+  TEST_ASSERT(hal_tts_cache_load_hotset() == 1 && lookup("Mode", 5) == 'r',
+              "The most used kept");
+
+  char path[512];
+  snprintf(path, sizeof(path), "%s/hotset.bin", cache_dir);
+  FILE *f = fopen(path, "r+b");
+  if (f != NULL) {
+    fputc('X', f); /* The magic */
+    fclose(f);
+  }
+  TEST_ASSERT(f != NULL && hal_tts_cache_load_hotset() == -1,
+              "Damaged hot set ignored");
+  hal_tts_cache_clear();
+  TEST_ASSERT(count_files("hotset.bin") == 0 &&
+                  hal_tts_cache_load_hotset() == 0,
+              "Clear removes it");
+}
+
+/* Wait up to a second for text to be written to the store */
+static int wait_stored(const char *text, int16_t value) {
+  for (int i = 0; i < 100; i++) {
+    if (lookup(text, value) == 'd') {
+      return 1;
+    }
+    usleep(10000);
+  }
+  return 0;
+}
+
+void test_tmpfs(void) {
+  printf("\n=== Test: tmpfs Mode ===\n");
+  reset_cache("0");
+  char work[] = "/tmp/hampod_tts_work_XXXXXX";
+  char copy[512];
+  char path[600];
+  struct stat st;
+  if (mkdtemp(work) == NULL) {
+    TEST_ASSERT(0, "Working directory made");
+    return;
+  }
+  snprintf(copy, sizeof(copy), "%s/tmpfs", cache_dir);
+  setenv("HAMPOD_TTS_CACHE_TMPFS", work, 1);
+  setenv("HAMPOD_TTS_CACHE_WRITEBACK", "0", 1); /* Only when called */
+
+  store("Frequency", 4);
+  store("Mode", 5);
+  hal_tts_cache_cleanup();
+  TEST_ASSERT(count_files_in(work, "seg_") == 1 && count_files("seg_") == 0,
+              "Store worked on in the tmpfs directory");
+  TEST_ASSERT(count_files_in(copy, "seg_") == 1 &&
+                  count_files_in(copy, "index.bin") == 1 &&
+                  count_files_in(copy, "index.sizes") == 1,
+              "Copied to the card on the way out");
+
+  remove_files_in(work); /* A reboot */
+  TEST_ASSERT(hal_tts_cache_init() == 0 && lookup("Frequency", 4) == 'd' &&
+                  lookup("Mode", 5) == 'd',
+              "Seeded from the copy");
+
+  store("Band", 6);
+  HalTtsCacheStats stats;
+  hal_tts_cache_get_stats(&stats);
+  snprintf(path, sizeof(path), "%s/seg_0001.pcm", copy);
+  TEST_ASSERT(wait_stored("Band", 6) && hal_tts_cache_writeback() == 0 &&
+                  stat(path, &st) == 0 &&
+                  (uint64_t)st.st_size == stats.disk_bytes,
+              "Written back while running, appends only");
+  TEST_ASSERT(hal_tts_cache_writeback() == 0, "Nothing to do unchanged");
+
+  hal_tts_cache_clear();
+  TEST_ASSERT(hal_tts_cache_writeback() == 0 &&
+                  count_files_in(copy, "seg_") == 0,
+              "Deleted segments deleted from the copy");
+
+  hal_tts_cache_cleanup();
+  remove_files_in(work);
+  rmdir(work);
+  remove_files_in(copy);
+  rmdir(copy);
+  unsetenv("HAMPOD_TTS_CACHE_TMPFS");
+  unsetenv("HAMPOD_TTS_CACHE_WRITEBACK");
+  hal_tts_cache_init();
+  TEST_ASSERT(hal_tts_cache_writeback() == 0 && count_files_in(copy, "") == 0,
+              "Nothing written back outside tmpfs mode");
+}
+
+/* Last: once set at run time, the environment's budget no longer applies */
+void test_ram_budget(void) {
+  printf("\n=== Test: RAM Budget at Run Time ===\n");
+  reset_cache("1000000");
+
+  store("one", 1);
+  store("two", 2);
+  hal_tts_cache_set_ram_budget(0);
+  HalTtsCacheStats stats;
+  hal_tts_cache_get_stats(&stats);
+  TEST_ASSERT(stats.ram_bytes == 0, "Lowering the budget evicts at once");
+  TEST_ASSERT(lookup("one", 1) == 'd' && lookup("one", 1) == 'd',
+              "Budget 0 keeps nothing in RAM");
+
+  hal_tts_cache_set_ram_budget(1000000);
+  store("three", 3);
+  TEST_ASSERT(lookup("three", 3) == 'r', "Raised budget keeps entries again");
+
+  reset_cache("0");
+  store("four", 4);
+  TEST_ASSERT(lookup("four", 4) == 'r',
+              "Run-time budget survives a restart of the cache");
+}
+
+int main(void) {
+  printf("========================================\n");
+  printf("TTS Cache Tests\n");
+  printf("========================================\n");
+
+  if (mkdtemp(cache_dir) == NULL) {
+    perror("mkdtemp");
+    return 1;
+  }
+  setenv("HAMPOD_TTS_CACHE_DIR", cache_dir, 1);
+
+  test_ram_hits();
+  test_eviction();
+  test_references();
+  test_store_owned();
+  test_packed_store();
+  test_voices();
+  test_keys();
+  test_verified_entries();
+  test_disk_budget();
+  test_compressed();
+  test_streamed();
+  test_sizes_journal();
+  test_old_layouts();
+  test_cache_packs();
+  test_hotset();
+  test_tmpfs();
+  test_ram_budget();
+
+  hal_tts_cache_cleanup();
+  remove_files();
+  rmdir(cache_dir);
+
+  printf("\n========================================\n");
+  printf("Results: %d passed, %d failed\n", tests_passed, tests_failed);
+  printf("========================================\n");
+  return tests_failed > 0 ? 1 : 0;
+}
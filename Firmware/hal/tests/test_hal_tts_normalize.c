@@ -0,0 +1,128 @@
+/**
+ * @file test_hal_tts_normalize.c
+ * @brief Unit tests for the canonical form of spoken text
+ */
+
+#include "../hal_tts_normalize.h"
+#include <stdio.h>
+#include <string.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(cond, msg)                                                 \
+  do {                                                                         \
+    if (cond) {                                                                \
+      printf("  [PASS] %s\n", msg);                                            \
+      tests_passed++;                                                          \
+    } else {                                                                   \
+      printf("  [FAIL] %s\n", msg);                                            \
+      tests_failed++;                                                          \
+    }                                                                          \
+  } while (0)
+
+static char canonical[HAL_TTS_NORMALIZE_MAX];
+
+/* Whether text normalizes to expected, and expected to itself */
+static int normalizes(const char *text, const char *expected) {
+  char again[HAL_TTS_NORMALIZE_MAX];
+  const char *result = hal_tts_normalize(text, canonical, sizeof(canonical));
+  int ok = strcmp(result, expected) == 0;
+  if (!ok) {
+    printf("    \"%s\" -> \"%s\"\n", text, result);
+  }
+  return ok &&
+         strcmp(hal_tts_normalize(result, again, sizeof(again)), result) == 0;
+}
+
+void test_whitespace(void) {
+  printf("\n=== Test: Whitespace and Punctuation ===\n");
+
+  TEST_ASSERT(normalizes("  Mode \t USB  ", "Mode USB"),
+              "Runs of spaces are one, text trimmed");
+  TEST_ASSERT(normalizes("Mode.", "Mode") && normalizes("Mode, ", "Mode"),
+              "Full stop and comma at the end dropped");
+  TEST_ASSERT(normalizes("Mode?", "Mode?") && normalizes("Mode!", "Mode!"),
+              "Question and exclamation marks stay");
+  TEST_ASSERT(normalizes("VFO A. Mode", "VFO A. Mode"),
+              "Punctuation inside a line stays");
+  TEST_ASSERT(normalizes("Mode.\n\n  Filter 2400. \n", "Mode\nFilter 2400"),
+              "Each line ends bare, blank lines go");
+  TEST_ASSERT(normalizes("Help", "Help"), "Plain text unchanged");
+}
+
+void test_numbers(void) {
+  printf("\n=== Test: Numbers and Units ===\n");
+
+  TEST_ASSERT(normalizes("14.250 MHz", "14 point 2 5 0 megahertz"),
+              "Decimal spelled as a readout, unit written out");
+  TEST_ASSERT(normalizes("14 point 250 megahertz", "14 point 2 5 0 megahertz"),
+              "Number after point spelled digit by digit");
+  TEST_ASSERT(normalizes("14 point 2 5 0 megahertz.",
+                         "14 point 2 5 0 megahertz"),
+              "Readout form unchanged");
+  TEST_ASSERT(normalizes("7.074mhz", "7 point 0 7 4 megahertz") &&
+                  normalizes("500 KHZ", "500 kilohertz"),
+              "Units in any case, with or without a space");
+  TEST_ASSERT(normalizes("S9 plus 20DB", "S9 plus 20 dB") &&
+                  normalizes("50%", "50 percent"),
+              "Decibels and percent");
+  TEST_ASSERT(normalizes("Power 100W", "Power 100 watts") &&
+                  normalizes("Power 100 W", "Power 100 W"),
+              "Watts only against the number");
+  TEST_ASSERT(normalizes("Frequency 7.", "Frequency 7"),
+              "Full stop after a number is not a decimal");
+  TEST_ASSERT(normalizes("Address 192.168.1.5", "Address 192.168.1.5") &&
+                  normalizes("At 12:30", "At 12:30"),
+              "Addresses and times left alone");
+}
+
+void test_callsigns(void) {
+  printf("\n=== Test: Callsigns ===\n");
+
+  TEST_ASSERT(normalizes("Calling W1AW", "Calling W 1 A W") &&
+                  normalizes("calling w1aw", "calling W 1 A W"),
+              "Callsign spelled in capitals");
+  TEST_ASSERT(normalizes("2E0ABC", "2 E 0 A B C"), "Prefix with a digit");
+  TEST_ASSERT(normalizes("VK2ABC/P.", "V K 2 A B C stroke P"),
+              "Portable suffix, slash as stroke");
+  TEST_ASSERT(normalizes("K1W", "K 1 W"), "Spelled W is not watts");
+  TEST_ASSERT(normalizes("FT8 S9 USB 2m Mp3s", "FT8 S9 USB 2m Mp3s"),
+              "Modes, meter words, bands and mixed case are not callsigns");
+}
+
+void test_memo(void) {
+  printf("\n=== Test: Memo Table ===\n");
+
+  unsigned long hits_before, misses_before, hits, misses;
+  hal_tts_normalize_stats(&hits_before, &misses_before);
+  hal_tts_normalize("Frequency 3.573 MHz", canonical, sizeof(canonical));
+  hal_tts_normalize("Frequency 3.573 MHz", canonical, sizeof(canonical));
+  hal_tts_normalize_stats(&hits, &misses);
+  TEST_ASSERT(misses == misses_before + 1 && hits == hits_before + 1 &&
+                  strcmp(canonical, "Frequency 3 point 5 7 3 megahertz") == 0,
+              "Repeated text served from the memo table");
+
+  char small[8];
+  const char *text = "14.250 MHz";
+  TEST_ASSERT(hal_tts_normalize(text, small, sizeof(small)) == text,
+              "Text whose canonical form does not fit is used as it is");
+  TEST_ASSERT(hal_tts_normalize(" . ", canonical, sizeof(canonical))[0] == ' ',
+              "Text with nothing to say is used as it is");
+}
+
+int main(void) {
+  printf("========================================\n");
+  printf("TTS Text Normalization Tests\n");
+  printf("========================================\n");
+
+  test_whitespace();
+  test_numbers();
+  test_callsigns();
+  test_memo();
+
+  printf("\n========================================\n");
+  printf("Results: %d passed, %d failed\n", tests_passed, tests_failed);
+  printf("========================================\n");
+  return tests_failed > 0 ? 1 : 0;
+}
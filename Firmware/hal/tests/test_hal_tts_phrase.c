@@ -0,0 +1,109 @@
+/**
+ * @file test_hal_tts_phrase.c
+ * @brief Unit tests for splitting announcements into synthesis phrases
+ */
+
+#include "../hal_tts_phrase.h"
+#include <stdio.h>
+#include <string.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(cond, msg)                                                 \
+  do {                                                                         \
+    if (cond) {                                                                \
+      printf("  [PASS] %s\n", msg);                                            \
+      tests_passed++;                                                          \
+    } else {                                                                   \
+      printf("  [FAIL] %s\n", msg);                                            \
+      tests_failed++;                                                          \
+    }                                                                          \
+  } while (0)
+
+#define MAX_PHRASES 16
+
+static char phrases[MAX_PHRASES][HAL_TTS_PHRASE_MAX + 1];
+
+/* Split text into phrases[]; returns the count */
+static int split(const char *text) {
+  const char *start;
+  size_t len;
+  int count = 0;
+  while (count < MAX_PHRASES &&
+         (start = hal_tts_next_phrase(text, &len, &text)) != NULL) {
+    memcpy(phrases[count], start, len);
+    phrases[count][len] = '\0';
+    count++;
+  }
+  return count;
+}
+
+void test_short_text(void) {
+  printf("\n=== Test: Short Announcements ===\n");
+
+  TEST_ASSERT(split("14.250 megahertz") == 1 &&
+                  strcmp(phrases[0], "14.250 megahertz") == 0,
+              "Decimal point does not split");
+  TEST_ASSERT(split("  Mode USB, filter 2400  ") == 1 &&
+                  strcmp(phrases[0], "Mode USB, filter 2400") == 0,
+              "Short clause runs on past a comma, whitespace trimmed");
+  TEST_ASSERT(split(" \t\n") == 0, "Blank text has no phrases");
+}
+
+void test_sentences(void) {
+  printf("\n=== Test: Sentence and Clause Boundaries ===\n");
+
+  TEST_ASSERT(split("VFO A. Frequency 7.074 megahertz! Mode? Data") == 4 &&
+                  strcmp(phrases[0], "VFO A.") == 0 &&
+                  strcmp(phrases[1], "Frequency 7.074 megahertz!") == 0 &&
+                  strcmp(phrases[2], "Mode?") == 0 &&
+                  strcmp(phrases[3], "Data") == 0,
+              "Split after sentence punctuation");
+  TEST_ASSERT(split("Press the one key to change the VFO, press two to go "
+                    "back") == 2 &&
+                  strcmp(phrases[0], "Press the one key to change the VFO,") ==
+                      0,
+              "Long clause splits at a comma");
+  TEST_ASSERT(split("Set mode\nPower\n 50 \n") == 3 &&
+                  strcmp(phrases[0], "Set mode") == 0 &&
+                  strcmp(phrases[1], "Power") == 0 &&
+                  strcmp(phrases[2], "50") == 0,
+              "Split at line breaks, without punctuation");
+}
+
+void test_long_run(void) {
+  printf("\n=== Test: Long Runs Without Punctuation ===\n");
+
+  char text[600] = "";
+  for (int i = 0; i < 100; i++) {
+    strcat(text, "word ");
+  }
+  int count = split(text);
+  int ok = count > 1;
+  size_t total = 0;
+  for (int i = 0; ok && i < count; i++) {
+    size_t len = strlen(phrases[i]);
+    ok = len > 0 && len <= HAL_TTS_PHRASE_MAX &&
+         phrases[i][len - 1] == 'd' && phrases[i][0] == 'w';
+    total += len;
+  }
+  TEST_ASSERT(ok, "Broken between words within HAL_TTS_PHRASE_MAX");
+  TEST_ASSERT(total == 100 * 4 + 100 - count, "No words lost");
+}
+
+int main(void) {
+  printf("=============================================\n");
+  printf("  HAMPOD TTS Phrase Splitting Unit Tests\n");
+  printf("=============================================\n");
+
+  test_short_text();
+  test_sentences();
+  test_long_run();
+
+  printf("\n=============================================\n");
+  printf("  Results: %d passed, %d failed\n", tests_passed, tests_failed);
+  printf("=============================================\n");
+
+  return tests_failed > 0 ? 1 : 0;
+}
@@ -5,7 +5,9 @@
 
 #include "../hal_usb_util.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 static int tests_passed = 0;
 static int tests_failed = 0;
@@ -112,6 +114,77 @@ void test_get_port_path(void) {
   printf("  [SKIP] No USB devices available to test port path\n");
 }
 
+void test_saved_device(void) {
+  printf("\n=== Test: Save and Reuse a Device ===\n");
+
+  char dir[] = "/tmp/hampod_usb_XXXXXX";
+  if (mkdtemp(dir) == NULL) {
+    printf("  [SKIP] No temporary directory\n");
+    return;
+  }
+  char path[128];
+  snprintf(path, sizeof(path), "%s/sub/audio_device", dir);
+
+  AudioDeviceInfo saved = {0};
+  saved.card_number = 3;
+  saved.is_usb = 1;
+  strcpy(saved.card_name, "USB2.0 Device");
+  strcpy(saved.usb_port, "/sys/bus/usb/devices/1-2");
+  strcpy(saved.device_path, "plughw:3,0");
+
+  AudioDeviceInfo loaded;
+  TEST_ASSERT(hal_usb_load_audio(path, &loaded) != 0,
+              "Nothing saved yet is refused");
+  TEST_ASSERT(hal_usb_save_audio(path, &saved) == 0,
+              "Device saved, directory made");
+  TEST_ASSERT(hal_usb_load_audio(path, &loaded) == 0 &&
+                  loaded.card_number == 3 && loaded.is_usb &&
+                  strcmp(loaded.usb_port, saved.usb_port) == 0 &&
+                  strcmp(loaded.card_name, saved.card_name) == 0 &&
+                  strcmp(loaded.device_path, "plughw:3,0") == 0,
+              "Saved device reads back");
+
+  saved.is_usb = 0;
+  saved.usb_port[0] = '\0';
+  hal_usb_save_audio(path, &saved);
+  TEST_ASSERT(hal_usb_load_audio(path, &loaded) == 0 && !loaded.is_usb,
+              "Device without a port reads back as not USB");
+
+  unlink(path);
+  snprintf(path, sizeof(path), "%s/sub", dir);
+  rmdir(path);
+  rmdir(dir);
+}
+
+void test_check_device(void) {
+  printf("\n=== Test: Check a Known Device ===\n");
+
+  AudioDeviceInfo gone = {0};
+  gone.card_number = 99;
+  TEST_ASSERT(hal_usb_check_audio(&gone) != 0, "Missing card is refused");
+  gone.card_number = -1;
+  TEST_ASSERT(hal_usb_check_audio(&gone) != 0, "No card is refused");
+  TEST_ASSERT(hal_usb_find_audio_at_port("/sys/bus/usb/devices/9-9.9",
+                                         &gone) != 0,
+              "Empty port has no device");
+
+  AudioDeviceInfo devices[MAX_AUDIO_DEVICES];
+  int found = 0;
+  if (hal_usb_enumerate_audio(devices, MAX_AUDIO_DEVICES, &found) != 0 ||
+      found == 0) {
+    printf("  [SKIP] No devices to check\n");
+    return;
+  }
+  TEST_ASSERT(hal_usb_check_audio(&devices[0]) == 0,
+              "Enumerated device checks out");
+  if (devices[0].is_usb) {
+    AudioDeviceInfo moved = devices[0];
+    strcpy(moved.usb_port, "/sys/bus/usb/devices/9-9.9");
+    TEST_ASSERT(hal_usb_check_audio(&moved) != 0,
+                "Card on another port is refused");
+  }
+}
+
 int main(void) {
   printf("=============================================\n");
   printf("  HAMPOD USB Utility Unit Tests\n");
@@ -121,6 +194,8 @@ int main(void) {
   test_find_audio_preferred();
   test_find_audio_any_usb();
   test_get_port_path();
+  test_saved_device();
+  test_check_device();
 
   printf("\n=============================================\n");
   printf("  Results: %d passed, %d failed\n", tests_passed, tests_failed);
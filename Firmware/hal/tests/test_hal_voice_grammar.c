@@ -0,0 +1,107 @@
+/**
+ * @file test_hal_voice_grammar.c
+ * @brief Unit tests for the voice command grammar
+ */
+
+#include "../hal_voice_grammar.h"
+#include <stdio.h>
+#include <string.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(cond, msg)                                                 \
+  do {                                                                         \
+    if (cond) {                                                                \
+      printf("  [PASS] %s\n", msg);                                            \
+      tests_passed++;                                                          \
+    } else {                                                                   \
+      printf("  [FAIL] %s\n", msg);                                            \
+      tests_failed++;                                                          \
+    }                                                                          \
+  } while (0)
+
+static VoiceCommand cmd;
+
+static int parse(const char *text) {
+  memset(&cmd, 0, sizeof(cmd));
+  return hal_voice_parse(text, &cmd);
+}
+
+void test_frequency(void) {
+  printf("\n=== Test: Frequency Commands ===\n");
+
+  TEST_ASSERT(parse("Frequency 14 250.") == 0 &&
+                  cmd.kind == VOICE_CMD_FREQUENCY && cmd.freq_hz == 14250000,
+              "Last three digits are kHz");
+  TEST_ASSERT(parse("frequency 14.250") == 0 && cmd.freq_hz == 14250000,
+              "Decimal point taken as written");
+  TEST_ASSERT(parse("tune seven oh seven four") == 0 &&
+                  cmd.freq_hz == 7074000,
+              "Digit words");
+  TEST_ASSERT(parse("Set frequency to fourteen two fifty megahertz") == 0 &&
+                  cmd.freq_hz == 14250000,
+              "Number words, fillers and units ignored");
+  TEST_ASSERT(parse("frequency 144 390") == 0 && cmd.freq_hz == 144390000,
+              "VHF frequency");
+  TEST_ASSERT(parse("frequency twenty one") == 0 && cmd.freq_hz == 21000000,
+              "Short number is whole MHz");
+  TEST_ASSERT(parse("frequency 900 000") != 0, "Out of range refused");
+  TEST_ASSERT(parse("frequency") != 0, "Missing number refused");
+}
+
+void test_mode(void) {
+  printf("\n=== Test: Mode Commands ===\n");
+
+  TEST_ASSERT(parse("Mode USB.") == 0 && cmd.kind == VOICE_CMD_MODE &&
+                  strcmp(cmd.mode, "USB") == 0,
+              "Mode by name");
+  TEST_ASSERT(parse("mode U.S.B.") == 0 && strcmp(cmd.mode, "USB") == 0,
+              "Spelled letters joined");
+  TEST_ASSERT(parse("mode lower sideband") == 0 &&
+                  strcmp(cmd.mode, "LSB") == 0,
+              "Sideband by its long name");
+  TEST_ASSERT(parse("mode a m") == 0 && strcmp(cmd.mode, "AM") == 0,
+              "Two letter mode spelled out");
+  TEST_ASSERT(parse("mode banana") != 0, "Unknown mode refused");
+}
+
+void test_keys(void) {
+  printf("\n=== Test: Key Commands ===\n");
+
+  TEST_ASSERT(parse("Key 5.") == 0 && cmd.kind == VOICE_CMD_KEY &&
+                  cmd.key == '5',
+              "Digit key");
+  TEST_ASSERT(parse("press star") == 0 && cmd.key == '*', "Star key");
+  TEST_ASSERT(parse("key pound") == 0 && cmd.key == '#', "Pound key");
+  TEST_ASSERT(parse("Key A.") == 0 && cmd.key == 'A', "Letter key");
+  TEST_ASSERT(parse("key seven") == 0 && cmd.key == '7', "Digit word key");
+}
+
+void test_rejects(void) {
+  printf("\n=== Test: Anything Else Is Rejected ===\n");
+
+  TEST_ASSERT(parse("") != 0, "Empty text");
+  TEST_ASSERT(parse("Thank you.") != 0, "Chatter");
+  TEST_ASSERT(parse("14.250 megahertz") != 0,
+              "Our own readout picked up by the microphone");
+  TEST_ASSERT(parse("mode USB and then some") != 0, "Trailing words");
+  TEST_ASSERT(parse("key 5 6") != 0, "Two keys");
+}
+
+int main(void) {
+  printf("=============================================\n");
+  printf("  HAMPOD Voice Command Grammar Unit Tests\n");
+  printf("=============================================\n");
+
+  test_frequency();
+  test_mode();
+  test_keys();
+  test_rejects();
+
+  printf("\n=============================================\n");
+  printf("  Results: %d passed, %d failed\n", tests_passed, tests_failed);
+  printf("=============================================\n");
+
+  return tests_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,157 @@
+/**
+ * @file test_instruction_lanes.c
+ * @brief Unit tests for the controller's instruction lanes
+ *
+ * Routes packets the way a session reader in firmware.c does: LANE_DIRECT
+ * straight to the keypad's request pipe, the rest into their lane. The
+ * keypad end adds up the credits granted like keypad_firmware.c.
+ */
+
+#include "../../hampod_frame.h"
+#include "../../hampod_lanes.h"
+#include "../../hampod_queue.h"
+#include "../../keypad_firmware.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(cond, msg)                                                 \
+  do {                                                                         \
+    if (cond) {                                                                \
+      printf("  [PASS] %s\n", msg);                                            \
+      tests_passed++;                                                          \
+    } else {                                                                   \
+      printf("  [FAIL] %s\n", msg);                                            \
+      tests_failed++;                                                          \
+    }                                                                          \
+  } while (0)
+
+static Packet_queue *lanes[LANE_COUNT];
+static int keypad_fds[2]; /* The keypad's request pipe {read, write} */
+static Frame_reader keypad_reader;
+
+/* Keypad side: credits left, and pushes held back for want of them */
+static int keypad_credits;
+static int keypad_held;
+static int keypad_pushed;
+
+/* Returns 0 if the packet was taken, -1 if its lane refused it */
+static int route(Packet_type type, const unsigned char *data,
+                 unsigned short size) {
+  Instruction_lane lane = classify_packet(type, data, size);
+  if (lane == LANE_DIRECT) {
+    return frame_write(keypad_fds[1], type, 0, data, size) == 0 ? 0 : -1;
+  }
+  return enqueue(lanes[lane], type, size, data, 0, 0);
+}
+
+static void grant(int credits) {
+  unsigned char data[3] = {KEYPAD_CREDIT, credits & 0xFF, credits >> 8};
+  TEST_ASSERT(route(KEYPAD, data, sizeof(data)) == 0, "Grant taken");
+}
+
+static void keypad_push(void) {
+  while (keypad_held > 0 && keypad_credits > 0) {
+    keypad_held--;
+    keypad_credits--;
+    keypad_pushed++;
+  }
+}
+
+/* Take that many requests off the keypad's request pipe, adding up the
+ * credits they grant */
+static void keypad_take_requests(int requests) {
+  Frame_header header;
+  unsigned char buffer[FRAME_MAX_DATA];
+  for (int i = 0; i < requests; i++) {
+    if (frame_read(&keypad_reader, &header, buffer, sizeof(buffer)) != 0) {
+      break;
+    }
+    if (header.type == KEYPAD && header.data_len >= 3 &&
+        buffer[0] == KEYPAD_CREDIT) {
+      keypad_credits += buffer[1] | (buffer[2] << 8);
+    }
+  }
+  keypad_push();
+}
+
+void test_classify(void) {
+  printf("\n=== Test: Lane Classification ===\n");
+
+  unsigned char interrupt = 'i';
+  unsigned char speak[] = "dRadio connected";
+  unsigned char read = 'r';
+  unsigned char subscribe[2] = {KEYPAD_SUBSCRIBE, 1};
+  unsigned char credit[3] = {KEYPAD_CREDIT, 8, 0};
+  unsigned char config[2] = {0x01, 0};
+
+  TEST_ASSERT(classify_packet(AUDIO, &interrupt, 1) == LANE_INTERRUPT,
+              "Interrupt in LANE_INTERRUPT");
+  TEST_ASSERT(classify_packet(AUDIO, speak, sizeof(speak)) == LANE_BULK,
+              "Speech in LANE_BULK");
+  TEST_ASSERT(classify_packet(CONFIG, config, 2) == LANE_CONTROL,
+              "CONFIG in LANE_CONTROL");
+  TEST_ASSERT(classify_packet(KEYPAD, &read, 1) == LANE_KEYPAD,
+              "Keypad read in LANE_KEYPAD");
+  TEST_ASSERT(classify_packet(KEYPAD, subscribe, 2) == LANE_KEYPAD,
+              "Subscription in LANE_KEYPAD");
+  TEST_ASSERT(classify_packet(KEYPAD, credit, 3) == LANE_DIRECT,
+              "Credit grant not queued");
+  TEST_ASSERT(classify_packet(KEYPAD, credit, 1) == LANE_KEYPAD,
+              "Short grant queued like any other keypad packet");
+}
+
+void test_grant_with_lane_full(void) {
+  printf("\n=== Test: Grant With LANE_KEYPAD Full ===\n");
+
+  /* Subscribed with 2 credits, 6 key events come, 2 go out */
+  keypad_credits = 2;
+  keypad_held = 6;
+  keypad_pushed = 0;
+  keypad_push();
+  TEST_ASSERT(keypad_pushed == 2 && keypad_held == 4,
+              "Pushes stop when the credits run out");
+
+  unsigned char read = 'r';
+  int taken = 0;
+  while (route(KEYPAD, &read, 1) == 0) {
+    taken++;
+  }
+  TEST_ASSERT(taken == PACKET_QUEUE_CAPACITY, "Keypad lane filled");
+  TEST_ASSERT(route(KEYPAD, &read, 1) != 0, "Full lane refuses a read");
+
+  grant(3);
+  grant(1);
+  keypad_take_requests(2);
+  TEST_ASSERT(keypad_pushed == 6 && keypad_held == 0,
+              "Pushes resume with every grant counted");
+  TEST_ASSERT(queue_depth(lanes[LANE_KEYPAD]) == PACKET_QUEUE_CAPACITY,
+              "Grants took no room in the lane");
+}
+
+int main(void) {
+  printf("=============================================\n");
+  printf("  HAMPOD Instruction Lane Unit Tests\n");
+  printf("=============================================\n");
+
+  for (int lane = 0; lane < LANE_COUNT; lane++) {
+    lanes[lane] = create_packet_queue();
+  }
+  if (pipe(keypad_fds) != 0) {
+    perror("pipe");
+    return 1;
+  }
+  frame_reader_init(&keypad_reader, keypad_fds[0]);
+
+  test_classify();
+  test_grant_with_lane_full();
+
+  printf("\n=============================================\n");
+  printf("  Results: %d passed, %d failed\n", tests_passed, tests_failed);
+  printf("=============================================\n");
+
+  return tests_failed > 0 ? 1 : 0;
+}
@@ -7,13 +7,18 @@
  * 2. hal_tts_speak() produces audio
  * 3. Multiple sequential speaks work (second should be faster)
  * 4. hal_tts_cleanup() terminates Piper
- * 5. Interrupt during persistent speak stops audio
+ * 5. Interrupt during persistent speak stops audio, and the next speak
+ *    starts after the interrupted utterance's leftover output
+ * 6. hal_tts_warm() caches text from a background thread while the
+ *    foreground speaks
+ * 7. Changing speed keeps the cached speech of the other speeds
  *
  * Part of Phase 2: Persistent Piper implementation
  */
 
 #include "../hal_audio.h"
 #include "../hal_tts.h"
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -236,6 +241,14 @@ void test_cleanup_terminates_piper(void) {
   hal_audio_cleanup();
 }
 
+/* How soon after hal_tts_interrupt() an interrupted speak must return */
+#define INTERRUPT_RETURN_MS 500
+
+static void *speak_thread(void *arg) {
+  hal_tts_speak((const char *)arg, NULL);
+  return NULL;
+}
+
 /**
  * Test 5: Verify interrupt during speak
  */
@@ -256,10 +269,28 @@ void test_interrupt_during_speak(void) {
   /* Start a long phrase */
   printf("  [INFO] Speaking long phrase then interrupting...\n");
 
-  /* This is a simplified test - in real usage the interrupt comes from another
-   * thread. Here we just ensure calling interrupt doesn't crash. */
+  /* The interrupt comes from another thread, as in the firmware */
+  pthread_t speaker;
+  long long start = current_time_ms();
+  pthread_create(&speaker, NULL, speak_thread,
+                 "This is a long phrase that should be interrupted before "
+                 "Piper gets to the end of it");
+  usleep(200000);
+  long long interrupted = current_time_ms();
   hal_tts_interrupt();
-  TEST_PASS("hal_tts_interrupt callable while initialized");
+  pthread_join(speaker, NULL);
+  long long stopped = current_time_ms();
+  printf("  [INFO] Speak returned %lld ms after it started, %lld ms after "
+         "the interrupt\n",
+         stopped - start, stopped - interrupted);
+  if (stopped - interrupted <= INTERRUPT_RETURN_MS) {
+    TEST_PASS("hal_tts_interrupt stops a speak in progress");
+  } else {
+    char msg[64];
+    snprintf(msg, sizeof(msg), "returned %lldms after it, limit %dms",
+             stopped - interrupted, INTERRUPT_RETURN_MS);
+    TEST_FAIL("hal_tts_interrupt stops a speak in progress", msg);
+  }
 
   /* Now speak after interrupt - should work */
   if (hal_tts_speak("after interrupt", NULL) == 0) {
@@ -274,11 +305,126 @@ void test_interrupt_during_speak(void) {
   hal_audio_cleanup();
 }
 
+static int warm_result = -1;
+
+static void *warm_thread(void *arg) {
+  warm_result = hal_tts_warm((const char *)arg);
+  return NULL;
+}
+
+/**
+ * Test 6: Verify background warming alongside foreground speech
+ */
+void test_warm_in_background(void) {
+  printf("\n=== Test: Background Warm ===\n");
+
+  if (hal_audio_init() != 0) {
+    TEST_FAIL("hal_audio_init", "failed");
+    return;
+  }
+
+  if (hal_tts_init() != 0) {
+    TEST_SKIP("hal_tts_init", "Piper may not be installed");
+    hal_audio_cleanup();
+    return;
+  }
+
+  /* A phrase no earlier run has cached */
+  char phrase[64];
+  snprintf(phrase, sizeof(phrase), "warmed phrase number %d", (int)getpid());
+
+  pthread_t warmer;
+  pthread_create(&warmer, NULL, warm_thread, phrase);
+  long long start = current_time_ms();
+  int spoke = hal_tts_speak("foreground speech", NULL);
+  printf("  [INFO] Foreground speak during warm took %lld ms\n",
+         current_time_ms() - start);
+  pthread_join(warmer, NULL);
+
+  if (spoke == 0 && warm_result == 0) {
+    TEST_PASS("warm and foreground speak both succeeded");
+  } else {
+    TEST_FAIL("warm alongside speak", "one of them failed");
+  }
+
+  start = current_time_ms();
+  hal_tts_speak(phrase, NULL);
+  long long hit_time = current_time_ms() - start;
+  printf("  [INFO] Speaking the warmed phrase took %lld ms\n", hit_time);
+  if (hit_time < 100) {
+    TEST_PASS("warmed phrase played from the cache");
+  } else {
+    TEST_FAIL("warmed phrase", "was synthesized again");
+  }
+
+  usleep(500000);
+
+  hal_tts_cleanup();
+  hal_audio_cleanup();
+}
+
 /* ============================================================================
  * Main
  * ============================================================================
  */
 
+void test_speed_change_keeps_cache(void) {
+  printf("\n=== Test: Cache Per Speed ===\n");
+
+  if (hal_audio_init() != 0) {
+    TEST_FAIL("hal_audio_init", "failed");
+    return;
+  }
+
+  if (hal_tts_init() != 0) {
+    TEST_SKIP("hal_tts_init", "Piper may not be installed");
+    hal_audio_cleanup();
+    return;
+  }
+
+  char phrase[64];
+  snprintf(phrase, sizeof(phrase), "speed phrase number %d", (int)getpid());
+
+  hal_tts_set_speed(1.0f);
+  if (hal_tts_warm(phrase) != 0) {
+    TEST_FAIL("hal_tts_warm", "failed");
+    hal_tts_cleanup();
+    hal_audio_cleanup();
+    return;
+  }
+
+  hal_tts_set_speed(0.8f);
+  long long start = current_time_ms();
+  hal_tts_speak(phrase, NULL);
+  long long other_speed_time = current_time_ms() - start;
+  printf("  [INFO] Speaking at the new speed took %lld ms\n",
+         other_speed_time);
+  if (other_speed_time >= 100) {
+    TEST_PASS("new speed synthesizes afresh");
+  } else {
+    TEST_FAIL("new speed", "played audio cached at the old speed");
+  }
+
+  usleep(500000);
+
+  hal_tts_set_speed(1.0f);
+  start = current_time_ms();
+  hal_tts_speak(phrase, NULL);
+  long long back_time = current_time_ms() - start;
+  printf("  [INFO] Speaking at the old speed again took %lld ms\n",
+         back_time);
+  if (back_time < 100) {
+    TEST_PASS("old speed still played from the cache");
+  } else {
+    TEST_FAIL("old speed", "cache entry was lost");
+  }
+
+  usleep(500000);
+
+  hal_tts_cleanup();
+  hal_audio_cleanup();
+}
+
 int main(int argc, char *argv[]) {
   printf("=============================================\n");
   printf("  HAMPOD Persistent Piper Unit Tests\n");
@@ -293,6 +439,8 @@ int main(int argc, char *argv[]) {
   test_persistent_latency_improvement();
   test_cleanup_terminates_piper();
   test_interrupt_during_speak();
+  test_warm_in_background();
+  test_speed_change_keeps_cache();
 
   /* Summary */
   printf("\n=============================================\n");
@@ -0,0 +1,230 @@
+#include "hampod_alloc.h"
+
+#ifdef HAMPOD_ALLOC_TRACK
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+/* In front of every block; the union keeps the block maximally aligned */
+typedef union Alloc_header {
+  struct {
+    size_t size;
+    unsigned int tag;
+  } h;
+  max_align_t align;
+} Alloc_header;
+
+typedef struct Alloc_counters {
+  atomic_ullong live_bytes;
+  atomic_ullong live_blocks;
+  atomic_ullong allocs;      /* Allocations made, reallocs included */
+  atomic_ullong alloc_bytes; /* Bytes they asked for */
+} Alloc_counters;
+
+static const char *const tag_names[ALLOC_TAGS] = {
+    "speech", "queue", "tts-capture", "tts-cache", "audio"};
+
+static Alloc_counters counters[ALLOC_TAGS];
+
+/* Report state, touched by the signal handler only */
+static char report_path[96];
+static char report_tmp[100];
+static unsigned long long last_allocs[ALLOC_TAGS];
+static unsigned long long last_bytes[ALLOC_TAGS];
+static long long last_report_ms = 0;
+static long long started_ms = 0;
+
+static Alloc_header *header_of(void *ptr) {
+  return (Alloc_header *)ptr - 1;
+}
+
+static void count_live(unsigned int tag, size_t size) {
+  atomic_fetch_add(&counters[tag].live_bytes, size);
+  atomic_fetch_add(&counters[tag].live_blocks, 1);
+}
+
+static void count_gone(unsigned int tag, size_t size) {
+  atomic_fetch_sub(&counters[tag].live_bytes, size);
+  atomic_fetch_sub(&counters[tag].live_blocks, 1);
+}
+
+static void count_in(unsigned int tag, size_t size) {
+  count_live(tag, size);
+  atomic_fetch_add(&counters[tag].allocs, 1);
+  atomic_fetch_add(&counters[tag].alloc_bytes, size);
+}
+
+void *hampod_malloc(Alloc_tag tag, size_t size) {
+  Alloc_header *header = malloc(sizeof(Alloc_header) + size);
+  if (header == NULL) {
+    return NULL;
+  }
+  header->h.size = size;
+  header->h.tag = tag;
+  count_in(tag, size);
+  return header + 1;
+}
+
+void *hampod_calloc(Alloc_tag tag, size_t count, size_t size) {
+  if (size != 0 && count > ((size_t)-1 - sizeof(Alloc_header)) / size) {
+    return NULL;
+  }
+  void *ptr = hampod_malloc(tag, count * size);
+  if (ptr != NULL) {
+    memset(ptr, 0, count * size);
+  }
+  return ptr;
+}
+
+void *hampod_realloc(Alloc_tag tag, void *ptr, size_t size) {
+  if (ptr == NULL) {
+    return hampod_malloc(tag, size);
+  }
+  Alloc_header *old = header_of(ptr);
+  unsigned int old_tag = old->h.tag;
+  size_t old_size = old->h.size;
+  Alloc_header *header = realloc(old, sizeof(Alloc_header) + size);
+  if (header == NULL) {
+    return NULL; /* The old block is still there, still counted */
+  }
+  count_gone(old_tag, old_size);
+  header->h.size = size;
+  header->h.tag = tag;
+  count_in(tag, size);
+  return header + 1;
+}
+
+char *hampod_strdup(Alloc_tag tag, const char *text) {
+  size_t size = strlen(text) + 1;
+  char *copy = hampod_malloc(tag, size);
+  if (copy != NULL) {
+    memcpy(copy, text, size);
+  }
+  return copy;
+}
+
+void hampod_free(void *ptr) {
+  if (ptr == NULL) {
+    return;
+  }
+  Alloc_header *header = header_of(ptr);
+  count_gone(header->h.tag, header->h.size);
+  free(header);
+}
+
+void hampod_alloc_retag(void *ptr, Alloc_tag tag) {
+  if (ptr == NULL) {
+    return;
+  }
+  Alloc_header *header = header_of(ptr);
+  if (header->h.tag == (unsigned int)tag) {
+    return;
+  }
+  count_gone(header->h.tag, header->h.size);
+  header->h.tag = tag;
+  count_live(tag, header->h.size); /* Moved, not allocated */
+}
+
+static long long clock_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Append text to line at *len; the handler cannot use stdio */
+static void put_text(char *line, size_t *len, size_t max, const char *text) {
+  while (*text != '\0' && *len + 1 < max) {
+    line[(*len)++] = *text++;
+  }
+}
+
+static void put_number(char *line, size_t *len, size_t max,
+                       unsigned long long value, int width) {
+  char digits[24];
+  int count = 0;
+  do {
+    digits[count++] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value > 0);
+  while (width-- > count && *len + 1 < max) {
+    line[(*len)++] = ' ';
+  }
+  while (count > 0 && *len + 1 < max) {
+    line[(*len)++] = digits[--count];
+  }
+}
+
+static void alloc_report(int sig) {
+  (void)sig;
+  int saved_errno = errno;
+  int fd = open(report_tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    errno = saved_errno;
+    return;
+  }
+
+  long long now = clock_ms();
+  long long span_ms = now - last_report_ms;
+  if (span_ms <= 0) {
+    span_ms = 1;
+  }
+  char line[160];
+  size_t len = 0;
+  put_text(line, &len, sizeof(line), "Up ");
+  put_number(line, &len, sizeof(line), (now - started_ms) / 1000, 0);
+  put_text(line, &len, sizeof(line), " s, rates over the last ");
+  put_number(line, &len, sizeof(line), span_ms / 1000, 0);
+  put_text(line, &len, sizeof(line),
+           " s\nTag            Live kB   Blocks      Allocs  Allocs/s   kB/s\n");
+  ssize_t ignored = write(fd, line, len);
+
+  for (int tag = 0; tag < ALLOC_TAGS; tag++) {
+    unsigned long long allocs = atomic_load(&counters[tag].allocs);
+    unsigned long long bytes = atomic_load(&counters[tag].alloc_bytes);
+    len = 0;
+    put_text(line, &len, sizeof(line), tag_names[tag]);
+    while (len < 12) {
+      line[len++] = ' ';
+    }
+    put_number(line, &len, sizeof(line),
+               atomic_load(&counters[tag].live_bytes) / 1024, 10);
+    put_number(line, &len, sizeof(line),
+               atomic_load(&counters[tag].live_blocks), 9);
+    put_number(line, &len, sizeof(line), allocs, 12);
+    put_number(line, &len, sizeof(line),
+               (allocs - last_allocs[tag]) * 1000 / span_ms, 10);
+    put_number(line, &len, sizeof(line),
+               (bytes - last_bytes[tag]) * 1000 / 1024 / span_ms, 7);
+    put_text(line, &len, sizeof(line), "\n");
+    ignored = write(fd, line, len);
+    last_allocs[tag] = allocs;
+    last_bytes[tag] = bytes;
+  }
+  (void)ignored;
+  close(fd);
+  rename(report_tmp, report_path);
+  last_report_ms = now;
+  errno = saved_errno;
+}
+
+void hampod_alloc_dump_on_signal(const char *process) {
+  snprintf(report_path, sizeof(report_path), "%s/hampod_alloc.%s",
+           ALLOC_REPORT_DIR, process);
+  snprintf(report_tmp, sizeof(report_tmp), "%s.tmp", report_path);
+  if (started_ms == 0) {
+    started_ms = last_report_ms = clock_ms();
+  }
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = alloc_report;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGUSR2, &action, NULL);
+}
+
+#endif
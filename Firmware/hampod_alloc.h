@@ -0,0 +1,92 @@
+/* Allocation accounting per subsystem, shared by Firmware and Software2
+ *
+ * The heap users worth watching in a soak test allocate through these
+ * wrappers with a tag naming the subsystem. Built with -DHAMPOD_ALLOC_TRACK
+ * (make ALLOC_TRACK=1 in Firmware and Software2) each block carries a small
+ * header with its size and tag, and per-tag counters keep live bytes and
+ * blocks and the running allocation totals. Without it the wrappers are
+ * plain malloc() and free() and cost nothing.
+ *
+ * Live bytes belong to whoever owns a block now: hampod_alloc_retag()
+ * moves a block that changes hands (a capture buffer the TTS cache takes
+ * over), and hampod_free() credits the tag the block holds, wherever it
+ * is called. A block from these wrappers must be freed with hampod_free(),
+ * and only those.
+ *
+ * SIGUSR2 writes a report to ALLOC_REPORT_DIR/hampod_alloc.<process>
+ * (`hampod alloc-stats`): per tag, live bytes and blocks, allocations
+ * made, and the allocation and byte rates since the previous report.
+ * Untracked builds ignore SIGUSR2.
+ *
+ * Unlike the other shared helpers this one is always its own object
+ * (hampod_alloc.o), as several translation units of each program use it.
+ */
+#ifndef HAMPOD_ALLOC
+#define HAMPOD_ALLOC
+
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ALLOC_REPORT_DIR "/dev/shm"
+
+typedef enum {
+  ALLOC_SPEECH,      /* Software2 speech queue */
+  ALLOC_QUEUE,       /* Firmware packet queues and heap packets */
+  ALLOC_TTS_CAPTURE, /* Speech being captured from Piper */
+  ALLOC_TTS_CACHE,   /* TTS cache entries, spares and write jobs */
+  ALLOC_AUDIO,       /* Audio HAL: clips, beeps, segments, conversion */
+  ALLOC_TAGS
+} Alloc_tag;
+
+#ifdef HAMPOD_ALLOC_TRACK
+
+void *hampod_malloc(Alloc_tag tag, size_t size);
+void *hampod_calloc(Alloc_tag tag, size_t count, size_t size);
+void *hampod_realloc(Alloc_tag tag, void *ptr, size_t size);
+char *hampod_strdup(Alloc_tag tag, const char *text);
+void hampod_free(void *ptr);
+
+/* Count a live block against tag from now on */
+void hampod_alloc_retag(void *ptr, Alloc_tag tag);
+
+/* Write reports for this process, named process, on SIGUSR2. Call again
+ * in a forked child to give it its own name. */
+void hampod_alloc_dump_on_signal(const char *process);
+
+#else
+
+static inline void *hampod_malloc(Alloc_tag tag, size_t size) {
+  (void)tag;
+  return malloc(size);
+}
+
+static inline void *hampod_calloc(Alloc_tag tag, size_t count, size_t size) {
+  (void)tag;
+  return calloc(count, size);
+}
+
+static inline void *hampod_realloc(Alloc_tag tag, void *ptr, size_t size) {
+  (void)tag;
+  return realloc(ptr, size);
+}
+
+static inline char *hampod_strdup(Alloc_tag tag, const char *text) {
+  (void)tag;
+  return strdup(text);
+}
+
+static inline void hampod_free(void *ptr) { free(ptr); }
+
+static inline void hampod_alloc_retag(void *ptr, Alloc_tag tag) {
+  (void)ptr;
+  (void)tag;
+}
+
+static inline void hampod_alloc_dump_on_signal(const char *process) {
+  (void)process;
+  signal(SIGUSR2, SIG_IGN); /* Asked for a report this build cannot give */
+}
+
+#endif
+#endif
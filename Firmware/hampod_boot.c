@@ -0,0 +1,57 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hampod_boot.h"
+
+static const char *boot_log_path(void) {
+  const char *path = getenv("HAMPOD_BOOT_LOG");
+  return path != NULL && path[0] != '\0' ? path : BOOT_LOG_DEFAULT;
+}
+
+long long boot_clock_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void boot_log_begin(void) {
+  const char *path = boot_log_path();
+  struct stat st;
+  if (stat(path, &st) == 0 && st.st_size > BOOT_LOG_MAX) {
+    char old[512];
+    snprintf(old, sizeof(old), "%s.old", path);
+    rename(path, old);
+  }
+  boot_log_phase("firmware", "start", boot_clock_ms());
+}
+
+void boot_log_phase(const char *process, const char *phase,
+                    long long started_ms) {
+  boot_log_span(process, phase, started_ms, boot_clock_ms());
+}
+
+void boot_log_span(const char *process, const char *phase,
+                   long long started_ms, long long ended_ms) {
+  char line[128];
+  int length = snprintf(line, sizeof(line), "%lld %s %s %lld\n", ended_ms,
+                        process, phase, ended_ms - started_ms);
+  if (length <= 0 || length >= (int)sizeof(line)) {
+    return;
+  }
+
+  int fd = open(boot_log_path(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC,
+                0666);
+  if (fd == -1) {
+    return;
+  }
+  /* Firmware runs as root and Software2 does not: both must append */
+  fchmod(fd, 0666);
+  if (write(fd, line, (size_t)length) != length) {
+    /* Nothing to do: the log is only a diagnostic */
+  }
+  close(fd);
+}
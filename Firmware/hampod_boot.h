@@ -0,0 +1,44 @@
+/* Start-up timing shared by Firmware and Software2
+ *
+ * Every process appends a line to the boot log as each of its start-up
+ * phases ends, so one start can be read back phase by phase across the
+ * controller, the keypad and audio processes and Software2 (hampod
+ * boot-times). A line is
+ *
+ *   <end_ms> <process> <phase> <duration_ms>
+ *
+ * with end_ms on CLOCK_MONOTONIC, which the processes share. Firmware's
+ * "firmware start" line opens each start. Each line is one write() to a
+ * file opened O_APPEND, so lines from different processes never mix.
+ *
+ * The log is HAMPOD_BOOT_LOG, by default /var/tmp/hampod_boot.log, which
+ * survives a reboot. Once it passes BOOT_LOG_MAX bytes, the next start
+ * moves it to <log>.old and begins a new one.
+ */
+#ifndef HAMPOD_BOOT
+#define HAMPOD_BOOT
+
+#define BOOT_LOG_DEFAULT "/var/tmp/hampod_boot.log"
+#define BOOT_LOG_MAX 32768
+
+/* Milliseconds on CLOCK_MONOTONIC, the clock the log is written in */
+long long boot_clock_ms(void);
+
+/* Start a new entry in the log: rotate it if it is full, then write the
+ * "firmware start" line. Called once, by the controller, first thing. */
+void boot_log_begin(void);
+
+/* Log that phase of process ended now, having begun at started_ms
+ * (boot_clock_ms()). Names are single words, e.g. "audio" "warm-up". A
+ * log that cannot be written is skipped silently. */
+void boot_log_phase(const char *process, const char *phase,
+                    long long started_ms);
+
+/* Same, for a phase that ended at ended_ms rather than now */
+void boot_log_span(const char *process, const char *phase,
+                   long long started_ms, long long ended_ms);
+
+#ifndef SHAREDLIB
+#include "hampod_boot.c"
+#endif
+#endif
@@ -0,0 +1,111 @@
+#include <pthread.h>
+#include <string.h>
+
+#include "hampod_channel.h"
+#include "hampod_queue.h"
+
+typedef struct Frame_channel {
+  Packet_queue *queue;
+  int connected;
+  pthread_cond_t readable;
+  pthread_cond_t writable;
+  pthread_cond_t connect;
+} Frame_channel;
+
+/* One lock for all: there are four channels and little contention */
+static pthread_mutex_t channel_lock = PTHREAD_MUTEX_INITIALIZER;
+static Frame_channel channels[CHANNEL_MAX];
+static int channel_count = 0;
+
+static const Frame_channel_ops channel_ops = {channel_write, channel_read};
+
+static Frame_channel *channel_at(int fd) {
+  int index = FRAME_CHANNEL_FD_BASE - fd;
+  if (index < 0 || index >= channel_count) {
+    return NULL;
+  }
+  return &channels[index];
+}
+
+void channel_install(void) { frame_set_channel_ops(&channel_ops); }
+
+int channel_create(void) {
+  pthread_mutex_lock(&channel_lock);
+  if (channel_count == CHANNEL_MAX) {
+    pthread_mutex_unlock(&channel_lock);
+    return -1;
+  }
+  Frame_channel *channel = &channels[channel_count];
+  channel->queue = create_packet_queue();
+  channel->connected = 0;
+  pthread_cond_init(&channel->readable, NULL);
+  pthread_cond_init(&channel->writable, NULL);
+  pthread_cond_init(&channel->connect, NULL);
+  int fd = FRAME_CHANNEL_FD_BASE - channel_count++;
+  pthread_mutex_unlock(&channel_lock);
+  return fd;
+}
+
+int channel_write(int fd, int type, unsigned short flags, unsigned short tag,
+                  const void *data, unsigned short data_len) {
+  Frame_channel *channel = channel_at(fd);
+  if (channel == NULL || data_len > FRAME_MAX_DATA) {
+    return -1;
+  }
+  pthread_mutex_lock(&channel_lock);
+  /* Full means every slot is taken, including the one being read */
+  while (channel->queue->count == PACKET_QUEUE_CAPACITY) {
+    pthread_cond_wait(&channel->writable, &channel_lock);
+  }
+  enqueue(channel->queue, (Packet_type)type, data_len, data, tag, flags);
+  pthread_cond_signal(&channel->readable);
+  pthread_mutex_unlock(&channel_lock);
+  return 0;
+}
+
+int channel_read(int fd, Frame_header *header, void *data, size_t data_cap) {
+  Frame_channel *channel = channel_at(fd);
+  if (channel == NULL) {
+    return -1;
+  }
+  pthread_mutex_lock(&channel_lock);
+  while (is_empty(channel->queue)) {
+    pthread_cond_wait(&channel->readable, &channel_lock);
+  }
+  Inst_packet *packet = dequeue(channel->queue);
+  header->type = (int)packet->type;
+  header->data_len = packet->data_len;
+  header->tag = packet->tag;
+  header->flags = packet->flags;
+  int result = packet->data_len > data_cap ? FRAME_DROPPED : 0;
+  if (result == 0 && packet->data_len > 0) {
+    memcpy(data, packet->data, packet->data_len);
+  }
+  release_packet(channel->queue, &packet);
+  pthread_cond_signal(&channel->writable);
+  pthread_mutex_unlock(&channel_lock);
+  return result;
+}
+
+void channel_connect(int fd) {
+  Frame_channel *channel = channel_at(fd);
+  if (channel == NULL) {
+    return;
+  }
+  pthread_mutex_lock(&channel_lock);
+  channel->connected = 1;
+  pthread_cond_broadcast(&channel->connect);
+  pthread_mutex_unlock(&channel_lock);
+}
+
+void channel_wait_connected(int fd) {
+  Frame_channel *channel = channel_at(fd);
+  if (channel == NULL) {
+    return;
+  }
+  pthread_mutex_lock(&channel_lock);
+  while (!channel->connected) {
+    pthread_cond_wait(&channel->connect, &channel_lock);
+  }
+  pthread_mutex_unlock(&channel_lock);
+}
@@ -0,0 +1,56 @@
+/* In-memory frame channels of the single-process build
+ *
+ * make THREADED=1 runs the keypad and audio subsystems as threads of the
+ * controller (firmware.c) instead of forked processes. Their Keypad_i/o
+ * and Speaker_i/o pipes become channels: bounded queues of whole frames
+ * (hampod_queue.h) behind a mutex, handed over without a system call.
+ *
+ * A channel is named by a pseudo fd at or below FRAME_CHANNEL_FD_BASE.
+ * channel_install() routes frame_write() and frame_read() on those to the
+ * channels (hampod_frame.h), so the subsystems keep their pipe code.
+ * Like a pipe, a write waits while the channel is full and a read waits
+ * until a frame arrives. Channels are never closed: they live as long as
+ * the process.
+ *
+ * channel_connect() and channel_wait_connected() stand in for the two
+ * blocking open()s of a FIFO: a subsystem connects its channels once its
+ * HAL is up, and the controller waits for that before telling Software it
+ * is ready.
+ */
+#ifndef HAMPOD_CHANNEL
+#define HAMPOD_CHANNEL
+
+#include <stddef.h>
+
+#include "hampod_frame.h"
+
+#define CHANNEL_MAX 4 /* Keypad and audio, one each way */
+
+/* Route frame_write() and frame_read() on channel fds to the channels.
+ * Called once, before any channel is used. */
+void channel_install(void);
+
+/* A new empty channel. Returns its fd, or -1 if CHANNEL_MAX are in use. */
+int channel_create(void);
+
+/* Queue one frame, waiting while the channel is full. Returns 0, or -1 if
+ * fd is not a channel or the frame is larger than FRAME_MAX_DATA. */
+int channel_write(int fd, int type, unsigned short flags, unsigned short tag,
+                  const void *data, unsigned short data_len);
+
+/* Take the oldest frame, waiting until there is one. As frame_read(), a
+ * payload larger than data_cap is dropped.
+ * Returns 0, FRAME_DROPPED if the payload did not fit, or -1 if fd is not
+ * a channel. */
+int channel_read(int fd, Frame_header *header, void *data, size_t data_cap);
+
+/* The subsystem end is ready, as its open() of the pipe was */
+void channel_connect(int fd);
+
+/* Wait until the subsystem has connected fd */
+void channel_wait_connected(int fd);
+
+#ifndef SHAREDLIB
+#include "hampod_channel.c"
+#endif
+#endif
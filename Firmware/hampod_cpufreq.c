@@ -0,0 +1,307 @@
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hampod_cpufreq.h"
+#include "hampod_trace.h"
+
+/* Shared with the forked keypad and audio processes */
+typedef struct Cpufreq_shared {
+  _Atomic uint64_t last_ns; /* Last key event or audio request */
+  _Atomic uint64_t asked_ns; /* When a boost was asked for; 0 if none is */
+  _Atomic int boosted;
+  _Atomic int stopping;
+} Cpufreq_shared;
+
+typedef struct Cpufreq_policy {
+  char name[16]; /* "policy0" */
+  char governor[CPUFREQ_GOVERNOR_MAX]; /* Found at start */
+} Cpufreq_policy;
+
+static Cpufreq_shared *shared = NULL;
+static int wake_fd = -1;
+static pid_t owner_pid;
+static pthread_t boost_thread;
+static Cpufreq_policy policies[CPUFREQ_POLICY_MAX];
+static int policy_count = 0;
+static char idle_governor[CPUFREQ_GOVERNOR_MAX];
+static uint64_t idle_ns;
+static int qos_fd = -1;
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/* Read a policy's sysfs file into buf, without the newline */
+static int read_policy(const Cpufreq_policy *policy, const char *file,
+                       char *buf, size_t size) {
+  char path[128];
+  snprintf(path, sizeof(path), "%s/%s/%s", CPUFREQ_SYSFS, policy->name,
+           file);
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    return -1;
+  }
+  int ok = fgets(buf, (int)size, f) != NULL;
+  fclose(f);
+  if (!ok) {
+    return -1;
+  }
+  buf[strcspn(buf, "\n")] = '\0';
+  return 0;
+}
+
+static int write_governor(const Cpufreq_policy *policy, const char *governor) {
+  char path[128];
+  snprintf(path, sizeof(path), "%s/%s/scaling_governor", CPUFREQ_SYSFS,
+           policy->name);
+  int fd = open(path, O_WRONLY);
+  if (fd == -1) {
+    return -1;
+  }
+  ssize_t len = (ssize_t)strlen(governor);
+  int rc = write(fd, governor, (size_t)len) == len ? 0 : -1;
+  close(fd);
+  return rc;
+}
+
+static void set_governors(const char *governor) {
+  for (int i = 0; i < policy_count; i++) {
+    write_governor(&policies[i], governor);
+  }
+}
+
+static long read_khz(const Cpufreq_policy *policy, const char *file) {
+  char buf[32];
+  return read_policy(policy, file, buf, sizeof(buf)) == 0 ? atol(buf) : -1;
+}
+
+/* Microseconds from asked until the first policy runs at its maximum, or
+ * CPUFREQ_RAMP_MAX_US if it does not get there */
+static uint32_t wait_full_speed(uint64_t asked) {
+  long max_khz = read_khz(&policies[0], "scaling_max_freq");
+  uint64_t waited = 0;
+  while (max_khz > 0 && waited < CPUFREQ_RAMP_MAX_US) {
+    if (read_khz(&policies[0], "scaling_cur_freq") >= max_khz) {
+      return (uint32_t)((now_ns() - asked) / 1000);
+    }
+    usleep(CPUFREQ_RAMP_POLL_US);
+    waited += CPUFREQ_RAMP_POLL_US;
+  }
+  return CPUFREQ_RAMP_MAX_US;
+}
+
+static void boost_up(uint64_t asked) {
+  atomic_store(&shared->boosted, 1);
+  set_governors(CPUFREQ_BOOST_GOVERNOR);
+  uint32_t governor_us = (uint32_t)((now_ns() - asked) / 1000);
+  if (qos_fd == -1) {
+    /* The request holds for as long as the file stays open */
+    qos_fd = open(CPUFREQ_QOS_PATH, O_WRONLY);
+    int32_t none = 0;
+    if (qos_fd != -1 && write(qos_fd, &none, sizeof(none)) != sizeof(none)) {
+      close(qos_fd);
+      qos_fd = -1;
+    }
+  }
+  hampod_trace(TRACE_CPU_BOOST, governor_us, wait_full_speed(asked), 0);
+}
+
+static void drop_down(uint64_t boosted_at) {
+  /* Cleared first: an event from here on asks for a new boost */
+  atomic_store(&shared->boosted, 0);
+  if (now_ns() - atomic_load(&shared->last_ns) < idle_ns) {
+    atomic_store(&shared->boosted, 1); /* One came in meanwhile */
+    return;
+  }
+  set_governors(idle_governor);
+  if (qos_fd != -1) {
+    close(qos_fd);
+    qos_fd = -1;
+  }
+  hampod_trace(TRACE_CPU_IDLE, (uint32_t)((now_ns() - boosted_at) / 1000000),
+               0, 0);
+}
+
+static void *boost_loop(void *arg) {
+  (void)arg;
+  uint64_t boosted_at = 0;
+  while (!atomic_load(&shared->stopping)) {
+    int timeout = -1;
+    if (atomic_load(&shared->boosted)) {
+      uint64_t idle_at = atomic_load(&shared->last_ns) + idle_ns;
+      uint64_t now = now_ns();
+      timeout = idle_at > now ? (int)((idle_at - now) / 1000000) + 1 : 0;
+    }
+    struct pollfd pfd = {.fd = wake_fd, .events = POLLIN};
+    int ready = poll(&pfd, 1, timeout);
+    if (ready < 0 && errno != EINTR) {
+      break;
+    }
+    if (ready > 0) {
+      uint64_t count;
+      if (read(wake_fd, &count, sizeof(count)) != sizeof(count)) {
+        continue;
+      }
+      uint64_t asked = atomic_exchange(&shared->asked_ns, 0);
+      if (asked != 0 && !atomic_load(&shared->boosted)) {
+        boost_up(asked);
+        boosted_at = asked;
+      }
+    } else if (ready == 0 && atomic_load(&shared->boosted) &&
+               now_ns() - atomic_load(&shared->last_ns) >= idle_ns) {
+      drop_down(boosted_at);
+    }
+  }
+  return NULL;
+}
+
+static void restore_governors(void) {
+  for (int i = 0; i < policy_count; i++) {
+    write_governor(&policies[i], policies[i].governor);
+  }
+}
+
+static int compare_policies(const void *a, const void *b) {
+  return strcmp(((const Cpufreq_policy *)a)->name,
+                ((const Cpufreq_policy *)b)->name);
+}
+
+/* Every cpufreq policy and the governor it runs now */
+static int find_policies(void) {
+  DIR *dir = opendir(CPUFREQ_SYSFS);
+  if (dir == NULL) {
+    return 0;
+  }
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL && policy_count < CPUFREQ_POLICY_MAX) {
+    Cpufreq_policy *policy = &policies[policy_count];
+    if (strncmp(entry->d_name, "policy", 6) != 0 ||
+        strlen(entry->d_name) >= sizeof(policy->name)) {
+      continue;
+    }
+    strcpy(policy->name, entry->d_name);
+    if (read_policy(policy, "scaling_governor", policy->governor,
+                    sizeof(policy->governor)) == 0) {
+      policy_count++;
+    }
+  }
+  closedir(dir);
+  qsort(policies, (size_t)policy_count, sizeof(policies[0]),
+        compare_policies);
+  return policy_count;
+}
+
+/* Whether the kernel offers governor, as a whole word */
+static int governor_available(const char *governor) {
+  char list[256];
+  if (read_policy(&policies[0], "scaling_available_governors", list,
+                  sizeof(list)) != 0) {
+    return 0;
+  }
+  for (char *word = strtok(list, " "); word != NULL;
+       word = strtok(NULL, " ")) {
+    if (strcmp(word, governor) == 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int cpufreq_boost_init(int idle_ms, const char *governor) {
+  if (idle_ms <= 0) {
+    return -1;
+  }
+  if (find_policies() == 0) {
+    printf("CPU boost: no cpufreq policies in %s, off\n", CPUFREQ_SYSFS);
+    return -1;
+  }
+  snprintf(idle_governor, sizeof(idle_governor), "%s",
+           governor != NULL && governor[0] != '\0' ? governor
+                                                       : CPUFREQ_IDLE_DEFAULT);
+  if (!governor_available(idle_governor)) {
+    printf("CPU boost: no %s governor, idling under %s\n", idle_governor,
+           CPUFREQ_IDLE_FALLBACK);
+    snprintf(idle_governor, sizeof(idle_governor), "%s",
+             CPUFREQ_IDLE_FALLBACK);
+  }
+  if (write_governor(&policies[0], idle_governor) != 0) {
+    printf("CPU boost: cannot set the governor (%s), off\n", strerror(errno));
+    return -1;
+  }
+
+  shared = mmap(NULL, sizeof(*shared), PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (shared == MAP_FAILED || wake_fd == -1) {
+    printf("CPU boost: cannot set up (%s), off\n", strerror(errno));
+    shared = NULL;
+    restore_governors();
+    return -1;
+  }
+  memset(shared, 0, sizeof(*shared));
+  idle_ns = (uint64_t)idle_ms * 1000000u;
+  owner_pid = getpid();
+  set_governors(idle_governor);
+  if (pthread_create(&boost_thread, NULL, boost_loop, NULL) != 0) {
+    printf("CPU boost: no thread, off\n");
+    shared = NULL;
+    restore_governors();
+    return -1;
+  }
+  atexit(cpufreq_boost_stop);
+  printf("CPU boost: %d policies idle under %s, %s for %d ms after a key "
+         "or speech\n",
+         policy_count, idle_governor, CPUFREQ_BOOST_GOVERNOR, idle_ms);
+  return 0;
+}
+
+void cpufreq_boost(void) {
+  if (shared == NULL) {
+    return;
+  }
+  uint64_t now = now_ns();
+  atomic_store(&shared->last_ns, now);
+  if (atomic_load(&shared->boosted)) {
+    return;
+  }
+  /* Only the first caller wakes the thread */
+  uint64_t none = 0;
+  if (atomic_compare_exchange_strong(&shared->asked_ns, &none, now)) {
+    uint64_t one = 1;
+    if (write(wake_fd, &one, sizeof(one)) != sizeof(one)) {
+      atomic_store(&shared->asked_ns, 0);
+    }
+  }
+}
+
+void cpufreq_boost_stop(void) {
+  if (shared == NULL || getpid() != owner_pid ||
+      atomic_exchange(&shared->stopping, 1)) {
+    return;
+  }
+  uint64_t one = 1;
+  if (write(wake_fd, &one, sizeof(one)) == sizeof(one) &&
+      !pthread_equal(pthread_self(), boost_thread)) {
+    pthread_join(boost_thread, NULL);
+  }
+  restore_governors();
+  if (qos_fd != -1) {
+    close(qos_fd);
+    qos_fd = -1;
+  }
+  printf("CPU boost: governors put back\n");
+}
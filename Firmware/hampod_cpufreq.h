@@ -0,0 +1,53 @@
+/* CPU frequency boost on key and speech events
+ *
+ * The install script pins the performance governor, which keeps every
+ * core at full speed for as long as the Pi is on. With cpu_boost_ms in
+ * [scheduling] set, Firmware takes the governor over instead: the cores
+ * idle under cpu_idle_governor (schedutil, or powersave on boards that do
+ * without it) and go to performance as soon as a key event or an audio
+ * request arrives, so the work that follows runs at full speed from its
+ * start. They drop back once cpu_boost_ms has passed without another one.
+ * While boosted, a zero request on /dev/cpu_dma_latency (PM QoS) also
+ * keeps the cores out of deep idle states.
+ *
+ * cpufreq_boost() may be called from the keypad and audio processes and
+ * any of their threads: it stamps shared memory and, when the cores are
+ * not boosted yet, wakes the controller's boost thread through an
+ * eventfd, which does the sysfs writes. Each ramp is recorded in the
+ * latency trace (TRACE_CPU_BOOST): how long the governor took to switch,
+ * and how long until the first policy ran at its maximum frequency.
+ *
+ * The governors found at start are put back on exit. Writing them needs
+ * root; without it the boost logs why and stays off.
+ */
+#ifndef HAMPOD_CPUFREQ
+#define HAMPOD_CPUFREQ
+
+#define CPUFREQ_SYSFS "/sys/devices/system/cpu/cpufreq"
+#define CPUFREQ_QOS_PATH "/dev/cpu_dma_latency"
+#define CPUFREQ_BOOST_GOVERNOR "performance"
+#define CPUFREQ_IDLE_DEFAULT "schedutil"
+#define CPUFREQ_IDLE_FALLBACK "powersave" /* When the idle one is missing */
+#define CPUFREQ_GOVERNOR_MAX 16 /* Length of a governor name, with the NUL */
+#define CPUFREQ_POLICY_MAX 8
+#define CPUFREQ_RAMP_POLL_US 200 /* Between scaling_cur_freq reads */
+#define CPUFREQ_RAMP_MAX_US 100000 /* Gives up waiting for full speed */
+
+/* Start the boost, idling under idle_governor and dropping back idle_ms
+ * after the last event. Call in the controller before the keypad and
+ * audio processes are forked. idle_ms <= 0 leaves the governors alone.
+ * Returns 0 if the boost runs, -1 if not. */
+int cpufreq_boost_init(int idle_ms, const char *idle_governor);
+
+/* A key event or an audio request arrived: run at full speed. Does
+ * nothing when the boost is off. */
+void cpufreq_boost(void);
+
+/* Stop the boost thread and put the original governors back. Called at
+ * exit by the process that started it. */
+void cpufreq_boost_stop(void);
+
+#ifndef SHAREDLIB
+#include "hampod_cpufreq.c"
+#endif
+#endif
@@ -1,13 +1,75 @@
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
+#include "hampod_alloc.h"
 #include "hampod_firm_packet.h"
 
+typedef struct Pool_slot {
+    Inst_packet packet; /* packet.data points at payload */
+    unsigned char payload[PACKET_POOL_DATA_MAX];
+    struct Pool_slot *next_free;
+} Pool_slot;
+
+static Pool_slot pool_slots[PACKET_POOL_SIZE];
+static Pool_slot *pool_free = NULL;
+static int pool_ready = 0;
+static Packet_pool_stats pool_stats = {0, 0, 0};
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* A pool slot for a payload of len bytes, or NULL to use the heap */
+static Inst_packet* pool_take(unsigned short len) {
+    if (len > PACKET_POOL_DATA_MAX) {
+        return NULL;
+    }
+    pthread_mutex_lock(&pool_lock);
+    if (!pool_ready) {
+        for (int i = PACKET_POOL_SIZE - 1; i >= 0; i--) {
+            pool_slots[i].packet.data = pool_slots[i].payload;
+            pool_slots[i].next_free = pool_free;
+            pool_free = &pool_slots[i];
+        }
+        pool_ready = 1;
+    }
+    Pool_slot *slot = pool_free;
+    if (slot != NULL) {
+        pool_free = slot->next_free;
+        pool_stats.in_use++;
+        if (pool_stats.in_use > pool_stats.high_water) {
+            pool_stats.high_water = pool_stats.in_use;
+        }
+    }
+    pthread_mutex_unlock(&pool_lock);
+    return slot != NULL ? &slot->packet : NULL;
+}
+
+/* Give a packet back to the pool; 0 if it came from the heap instead */
+static int pool_give(Inst_packet *packet) {
+    Pool_slot *slot = (Pool_slot *)packet; /* packet is the first member */
+    if (slot < pool_slots || slot >= pool_slots + PACKET_POOL_SIZE) {
+        return 0;
+    }
+    pthread_mutex_lock(&pool_lock);
+    slot->next_free = pool_free;
+    pool_free = slot;
+    pool_stats.in_use--;
+    pthread_mutex_unlock(&pool_lock);
+    return 1;
+}
+
 Inst_packet* create_inst_packet(Packet_type new_type, unsigned short new_len, unsigned char *new_data, unsigned short tag) {
-    Inst_packet *new = malloc(sizeof(Inst_packet));
+    Inst_packet *new = pool_take(new_len);
+    if (new == NULL) {
+        new = hampod_malloc(ALLOC_QUEUE, sizeof(Inst_packet));
+        new->data = hampod_malloc(ALLOC_QUEUE, new_len);
+        pthread_mutex_lock(&pool_lock);
+        pool_stats.heap_allocs++;
+        pthread_mutex_unlock(&pool_lock);
+    }
     new->type = new_type;
     new->data_len = new_len;
     new->tag = tag;
-    new->data = malloc(new_len);
+    new->flags = 0;
+    new->received_us = 0;
     memcpy(new->data, new_data, new_len);
     return new;
 }
@@ -17,9 +79,15 @@ void destroy_inst_packet(Inst_packet** packet){
         return;  /* Nothing to destroy */
     }
     Inst_packet* temp = *packet;
-    if (temp->data != NULL) {
-        free(temp->data);
+    if (!pool_give(temp)) {
+        hampod_free(temp->data);
+        hampod_free(temp);
     }
-    free(*packet);
     *packet = NULL;
 }
+
+void packet_pool_stats(Packet_pool_stats *stats) {
+    pthread_mutex_lock(&pool_lock);
+    *stats = pool_stats;
+    pthread_mutex_unlock(&pool_lock);
+}
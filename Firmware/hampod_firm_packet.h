@@ -12,11 +12,28 @@ typedef struct Inst_packet {
     Packet_type type;
     unsigned short data_len;
     unsigned short tag;
+    unsigned short flags; /* FRAME_FLAG_* bits from the frame header */
+    unsigned int received_us; /* frame_clock_us() when queued */
     unsigned char *data;
 } Inst_packet;
 
+/* create_inst_packet() takes packets from a per-process pool of
+ * PACKET_POOL_SIZE slots with room for PACKET_POOL_DATA_MAX payload bytes,
+ * so steady-state request/reply traffic never touches the heap. Larger
+ * payloads, or a request with every slot in use, fall back to malloc.
+ * The pool is thread-safe; destroy_inst_packet() returns either kind. */
+#define PACKET_POOL_SIZE 16
+#define PACKET_POOL_DATA_MAX 256
+
+typedef struct Packet_pool_stats {
+    unsigned int in_use;      /* Pool slots handed out now */
+    unsigned int high_water;  /* Most slots ever in use at once */
+    unsigned long heap_allocs; /* Packets that fell back to malloc */
+} Packet_pool_stats;
+
 Inst_packet* create_inst_packet(Packet_type new_type, unsigned short new_len, unsigned char *new_data, unsigned short tag);
 void destroy_inst_packet(Inst_packet** packet);
+void packet_pool_stats(Packet_pool_stats *stats);
 #ifndef SHAREDLIB
 #include "hampod_firm_packet.c"
 #endif
@@ -0,0 +1,129 @@
+#include <errno.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hampod_frame.h"
+
+static const Frame_channel_ops *channel_ops = NULL;
+
+void frame_set_channel_ops(const Frame_channel_ops *ops) { channel_ops = ops; }
+
+int frame_write(int fd, int type, unsigned short tag, const void *data,
+                unsigned short data_len) {
+  return frame_write_flags(fd, type, 0, tag, data, data_len);
+}
+
+int frame_write_flags(int fd, int type, unsigned short flags,
+                      unsigned short tag, const void *data,
+                      unsigned short data_len) {
+  if (data_len > FRAME_MAX_DATA || (data_len > 0 && data == NULL)) {
+    return -1;
+  }
+  if (fd <= FRAME_CHANNEL_FD_BASE && channel_ops != NULL) {
+    return channel_ops->write(fd, type, flags, tag, data, data_len);
+  }
+
+  Frame_header header;
+  header.type = (int)(((unsigned int)flags << 16) | (type & 0xFFFF));
+  header.data_len = data_len;
+  header.tag = tag;
+
+  struct iovec iov[2];
+  iov[0].iov_base = &header;
+  iov[0].iov_len = FRAME_HEADER_SIZE;
+  iov[1].iov_base = (void *)data;
+  iov[1].iov_len = data_len;
+
+  ssize_t total = FRAME_HEADER_SIZE + data_len;
+  ssize_t n;
+  do {
+    n = writev(fd, iov, data_len > 0 ? 2 : 1);
+  } while (n == -1 && errno == EINTR);
+
+  /* Frames are <= PIPE_BUF, so a pipe write is all-or-nothing */
+  return (n == total) ? 0 : -1;
+}
+
+int frame_epoch_newer(unsigned char a, unsigned char b) {
+  int ahead = ((int)a - (int)b + FRAME_EPOCH_MAX) % FRAME_EPOCH_MAX;
+  return ahead > 0 && ahead <= FRAME_EPOCH_MAX / 2;
+}
+
+unsigned int frame_clock_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned int)((unsigned long long)ts.tv_sec * 1000000ULL +
+                        (unsigned long long)ts.tv_nsec / 1000ULL);
+}
+
+void frame_reader_init(Frame_reader *reader, int fd) {
+  reader->fd = fd;
+  reader->start = 0;
+  reader->end = 0;
+}
+
+/* Make sure at least `need` unconsumed bytes are buffered */
+static int frame_fill(Frame_reader *reader, size_t need) {
+  while (reader->end - reader->start < need) {
+    if (FRAME_READER_BUF - reader->start < need) {
+      memmove(reader->buf, reader->buf + reader->start,
+              reader->end - reader->start);
+      reader->end -= reader->start;
+      reader->start = 0;
+    }
+
+    ssize_t n;
+    do {
+      n = read(reader->fd, reader->buf + reader->end,
+               FRAME_READER_BUF - reader->end);
+    } while (n == -1 && errno == EINTR);
+
+    if (n <= 0) {
+      return -1;
+    }
+    reader->end += (size_t)n;
+  }
+  return 0;
+}
+
+int frame_read(Frame_reader *reader, Frame_header *header, void *data,
+               size_t data_cap) {
+  if (reader->fd <= FRAME_CHANNEL_FD_BASE && channel_ops != NULL) {
+    return channel_ops->read(reader->fd, header, data, data_cap);
+  }
+  if (frame_fill(reader, FRAME_HEADER_SIZE) != 0) {
+    return -1;
+  }
+  memcpy(header, reader->buf + reader->start, FRAME_HEADER_SIZE);
+  header->flags = (unsigned short)((unsigned int)header->type >> 16);
+  header->type &= 0xFFFF;
+
+  if (header->data_len > FRAME_MAX_DATA) {
+    /* Corrupt header - drop everything buffered and resynchronise */
+    reader->start = 0;
+    reader->end = 0;
+    return FRAME_DROPPED;
+  }
+
+  size_t frame_len = FRAME_HEADER_SIZE + header->data_len;
+  if (frame_fill(reader, frame_len) != 0) {
+    return -1;
+  }
+
+  const unsigned char *payload = reader->buf + reader->start + FRAME_HEADER_SIZE;
+  reader->start += frame_len;
+  if (reader->start == reader->end) {
+    reader->start = 0;
+    reader->end = 0;
+  }
+
+  if (header->data_len > data_cap) {
+    return FRAME_DROPPED;
+  }
+  if (header->data_len > 0) {
+    memcpy(data, payload, header->data_len);
+  }
+  return 0;
+}
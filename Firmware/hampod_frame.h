@@ -0,0 +1,111 @@
+/* Framed packet I/O shared by Firmware and Software2
+ *
+ * Every packet on the HAMPOD pipes is an 8-byte header followed by
+ * data_len bytes of payload:
+ *   type (4 bytes) | data_len (2 bytes) | tag (2 bytes) | data
+ *
+ * The high 16 bits of type carry FRAME_FLAG_* bits. frame_read() splits
+ * them out into flags, so readers keep comparing type against packet types.
+ * A request too long for one frame is sent as several frames with the same
+ * tag, all but the last flagged FRAME_FLAG_MORE.
+ *
+ * frame_write() sends a whole frame with a single writev(). Frames are
+ * capped at PIPE_BUF, so the kernel writes them atomically and two
+ * writers sharing one pipe can never interleave partial frames.
+ *
+ * frame_read() pulls frames out of a per-fd Frame_reader buffer, which is
+ * refilled with one read() per call instead of one read() per field.
+ *
+ * This file deliberately does not depend on Packet_type so that Software2
+ * (which mirrors the packet types in comm.h) can share it.
+ */
+#ifndef HAMPOD_FRAME
+#define HAMPOD_FRAME
+
+#include <limits.h>
+#include <stddef.h>
+
+#define FRAME_HEADER_SIZE 8
+#define FRAME_MAX_SIZE PIPE_BUF
+#define FRAME_MAX_DATA (FRAME_MAX_SIZE - FRAME_HEADER_SIZE)
+#define FRAME_READER_BUF (2 * FRAME_MAX_SIZE)
+
+#define FRAME_FLAG_MORE 0x0001 /* More fragments with this tag follow */
+
+/* Audio requests carry a speech epoch in flag bits 8-14: 1..FRAME_EPOCH_MAX,
+ * or 0 for none. Software moves to the next epoch with every interrupt, and
+ * the audio process skips requests stamped before the latest one. */
+#define FRAME_EPOCH_SHIFT 8
+#define FRAME_EPOCH_MASK 0x7F00
+#define FRAME_EPOCH_MAX 127
+#define FRAME_EPOCH(flags)                                                     \
+  ((unsigned char)(((flags) & FRAME_EPOCH_MASK) >> FRAME_EPOCH_SHIFT))
+#define FRAME_FLAGS_EPOCH(epoch)                                               \
+  ((unsigned short)(((epoch) << FRAME_EPOCH_SHIFT) & FRAME_EPOCH_MASK))
+
+typedef struct Frame_header {
+  int type;
+  unsigned short data_len;
+  unsigned short tag;
+  unsigned short flags; /* Decoded from type, not a separate wire field */
+} Frame_header;
+
+typedef struct Frame_reader {
+  int fd;
+  size_t start; /* First unconsumed byte in buf */
+  size_t end;   /* One past the last valid byte in buf */
+  unsigned char buf[FRAME_READER_BUF];
+} Frame_reader;
+
+/* Fds at or below FRAME_CHANNEL_FD_BASE are not kernel fds but in-memory
+ * channels of the single-process Firmware build (hampod_channel.h). Once
+ * it installs its ops, frame_write() and frame_read() on them go to the
+ * channels; nothing else ever installs any. */
+#define FRAME_CHANNEL_FD_BASE (-1000)
+
+typedef struct Frame_channel_ops {
+  int (*write)(int fd, int type, unsigned short flags, unsigned short tag,
+               const void *data, unsigned short data_len);
+  int (*read)(int fd, Frame_header *header, void *data, size_t data_cap);
+} Frame_channel_ops;
+
+void frame_set_channel_ops(const Frame_channel_ops *ops);
+
+/* Write one frame to fd with a single writev().
+ * Returns 0 on success, -1 on error or if the frame exceeds FRAME_MAX_SIZE. */
+int frame_write(int fd, int type, unsigned short tag, const void *data,
+                unsigned short data_len);
+
+/* frame_write() with FRAME_FLAG_* bits set in the header. */
+int frame_write_flags(int fd, int type, unsigned short flags,
+                      unsigned short tag, const void *data,
+                      unsigned short data_len);
+
+/* Whether epoch a comes after epoch b (both non-zero). Epochs wrap after
+ * FRAME_EPOCH_MAX, so "after" means less than half the cycle ahead. */
+int frame_epoch_newer(unsigned char a, unsigned char b);
+
+/* Low 32 bits of CLOCK_MONOTONIC in microseconds, the clock of the times
+ * in audio acks. Wraps every 71 minutes: compare two by subtracting. */
+unsigned int frame_clock_us(void);
+
+/* Attach a reader to fd and reset its buffer. */
+void frame_reader_init(Frame_reader *reader, int fd);
+
+/* frame_read() result for a frame it dropped: a payload larger than the
+ * caller's buffer, or a corrupt header. The stream is still usable, so
+ * report it and read on. */
+#define FRAME_DROPPED (-2)
+
+/* Read the next frame. The payload is copied into data (at most data_cap
+ * bytes); a payload larger than data_cap is consumed so the stream stays
+ * in sync, and a corrupt header drops what is buffered to resynchronise.
+ * Returns 0 on success, FRAME_DROPPED for such a frame, or -1 on EOF or
+ * read error. */
+int frame_read(Frame_reader *reader, Frame_header *header, void *data,
+               size_t data_cap);
+
+#ifndef SHAREDLIB
+#include "hampod_frame.c"
+#endif
+#endif
@@ -0,0 +1,26 @@
+#include "hampod_lanes.h"
+#include "keypad_firmware.h"
+
+Instruction_lane classify_packet(Packet_type type, const unsigned char *data,
+                                 unsigned short size) {
+  if (type == AUDIO && size > 0) {
+    switch (data[0]) {
+    case 'i':
+      return LANE_INTERRUPT;
+    case 'b':
+    case 'e': /* Keypad echo, played by the audio process at once */
+    case 'q':
+    case 's': /* Speed change, applied as a bypass by the audio process */
+      return LANE_CONTROL;
+    default:
+      return LANE_BULK;
+    }
+  }
+  if (type == CONFIG) {
+    return LANE_CONTROL;
+  }
+  if (type == KEYPAD) {
+    return size >= 3 && data[0] == KEYPAD_CREDIT ? LANE_DIRECT : LANE_KEYPAD;
+  }
+  return LANE_BULK;
+}
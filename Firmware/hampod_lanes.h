@@ -0,0 +1,37 @@
+/* Priority classes of the controller's instruction queue
+ *
+ * Each session's reader thread sorts what Software sends into lanes, one
+ * Packet_queue (hampod_queue.h) each, and the main loop always forwards
+ * from the highest non-empty lane, so an interrupt or a beep never waits
+ * behind a backlog of TTS requests. A full lane refuses the packet.
+ *
+ * A few packets take no lane at all (LANE_DIRECT): the reader thread
+ * hands them to their subsystem at once. Those are the ones that must
+ * never be refused, because nothing resends them.
+ */
+#ifndef HAMPOD_LANES
+#define HAMPOD_LANES
+
+#include "hampod_firm_packet.h"
+
+/* Highest first */
+typedef enum {
+  LANE_DIRECT = -1, /* Not queued: keypad credit grants (KEYPAD_CREDIT) */
+  LANE_INTERRUPT,   /* AUDIO 'i' */
+  LANE_CONTROL,     /* Beeps, speed and device queries, CONFIG */
+  LANE_KEYPAD,      /* Keypad reads and subscriptions */
+  LANE_BULK,        /* Speak / play requests */
+  LANE_BACKGROUND,  /* The same from sessions below the main one */
+  LANE_COUNT
+} Instruction_lane;
+
+/* The lane a packet from the main session goes in. A credit grant adds to
+ * the keypad's credits, so one refused by a full LANE_KEYPAD would stall
+ * key pushes for good; it is LANE_DIRECT instead. */
+Instruction_lane classify_packet(Packet_type type, const unsigned char *data,
+                                 unsigned short size);
+
+#ifndef SHAREDLIB
+#include "hampod_lanes.c"
+#endif
+#endif
@@ -0,0 +1,227 @@
+#include "hampod_log.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+  _Atomic unsigned int seq; /* index + 1 once written, index + records free */
+  int fd;
+  int len;
+  char text[LOG_RECORD_LEN];
+} Log_record;
+
+static Log_record log_queue[LOG_QUEUE_RECORDS];
+static _Atomic unsigned int log_head = 0; /* Next record to claim */
+static unsigned int log_tail = 0;         /* Next record to write out */
+static _Atomic int log_dropped = 0;       /* Lost to a full queue */
+
+/* Set while this process's logger runs; cleared in a forked child */
+static _Atomic int log_running = 0;
+static sem_t log_ready; /* Posted for every record queued */
+static pthread_t log_thread;
+static pthread_once_t log_once = PTHREAD_ONCE_INIT;
+
+/* The one reader at a time: the logger, or hampod_log_flush(). Writers
+ * never take it. */
+static pthread_mutex_t log_reader = PTHREAD_MUTEX_INITIALIZER;
+
+static long long log_clock_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void log_write_all(int fd, const char *text, int len) {
+  while (len > 0) {
+    ssize_t n = write(fd, text, (size_t)len);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return;
+    }
+    text += n;
+    len -= (int)n;
+  }
+}
+
+/* Claim a record, or NULL if the queue is full */
+static Log_record *log_claim(unsigned int *index_out) {
+  unsigned int index = atomic_load_explicit(&log_head, memory_order_relaxed);
+  for (;;) {
+    Log_record *record = &log_queue[index & (LOG_QUEUE_RECORDS - 1)];
+    unsigned int seq = atomic_load_explicit(&record->seq, memory_order_acquire);
+    int diff = (int)(seq - index);
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&log_head, &index, index + 1,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed)) {
+        *index_out = index;
+        return record;
+      }
+    } else if (diff < 0) {
+      return NULL; /* Still holds a record LOG_QUEUE_RECORDS back */
+    } else {
+      index = atomic_load_explicit(&log_head, memory_order_relaxed);
+    }
+  }
+}
+
+/* Queue text for fd, or write it at once without a logger */
+static void log_put(int fd, const char *format, va_list args) {
+  if (!atomic_load_explicit(&log_running, memory_order_acquire)) {
+    char text[LOG_RECORD_LEN];
+    int len = vsnprintf(text, sizeof(text), format, args);
+    if (len >= (int)sizeof(text)) {
+      len = sizeof(text) - 1;
+    }
+    if (len > 0) {
+      log_write_all(fd, text, len);
+    }
+    return;
+  }
+
+  unsigned int index;
+  Log_record *record = log_claim(&index);
+  if (record == NULL) {
+    atomic_fetch_add(&log_dropped, 1);
+    return;
+  }
+  int len = vsnprintf(record->text, sizeof(record->text), format, args);
+  if (len >= (int)sizeof(record->text)) {
+    len = sizeof(record->text) - 1;
+    memcpy(&record->text[len - 4], "...\n", 4); /* Cut short */
+  }
+  record->fd = fd;
+  record->len = len > 0 ? len : 0;
+  atomic_store_explicit(&record->seq, index + 1, memory_order_release);
+  sem_post(&log_ready);
+}
+
+static void log_put_text(int fd, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  log_put(fd, format, args);
+  va_end(args);
+}
+
+void hampod_log(Log_site *site, int fd, const char *format, ...) {
+  long long now_ms = log_clock_ms();
+  long long window_ms = atomic_load(&site->window_ms);
+  if (window_ms == 0 || now_ms - window_ms >= LOG_INTERVAL_MS) {
+    if (atomic_compare_exchange_strong(&site->window_ms, &window_ms,
+                                       now_ms)) {
+      atomic_store(&site->count, 0);
+      int suppressed = atomic_exchange(&site->suppressed, 0);
+      if (suppressed > 0) {
+        log_put_text(fd, "(%d similar messages suppressed)\n", suppressed);
+      }
+    }
+  }
+  if (atomic_fetch_add(&site->count, 1) >= LOG_BURST) {
+    atomic_fetch_add(&site->suppressed, 1);
+    return;
+  }
+
+  va_list args;
+  va_start(args, format);
+  log_put(fd, format, args);
+  va_end(args);
+}
+
+/* Write out every record published so far. Caller holds log_reader. */
+static void log_drain_locked(void) {
+  for (;;) {
+    Log_record *record = &log_queue[log_tail & (LOG_QUEUE_RECORDS - 1)];
+    if (atomic_load_explicit(&record->seq, memory_order_acquire) !=
+        log_tail + 1) {
+      break;
+    }
+    log_write_all(record->fd, record->text, record->len);
+    atomic_store_explicit(&record->seq, log_tail + LOG_QUEUE_RECORDS,
+                          memory_order_release);
+    log_tail++;
+  }
+
+  int dropped = atomic_exchange(&log_dropped, 0);
+  if (dropped > 0) {
+    char text[64];
+    int len = snprintf(text, sizeof(text),
+                       "(%d log messages dropped, queue full)\n", dropped);
+    log_write_all(2, text, len);
+  }
+}
+
+static void *log_thread_func(void *arg) {
+  (void)arg;
+  prctl(PR_SET_NAME, "logger", 0, 0, 0);
+  /* Behind every thread that does real work */
+  setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 19);
+
+  while (atomic_load(&log_running)) {
+    while (sem_wait(&log_ready) != 0 && errno == EINTR) {
+    }
+    pthread_mutex_lock(&log_reader);
+    log_drain_locked();
+    pthread_mutex_unlock(&log_reader);
+  }
+  return NULL;
+}
+
+void hampod_log_flush(void) {
+  pthread_mutex_lock(&log_reader);
+  log_drain_locked();
+  pthread_mutex_unlock(&log_reader);
+}
+
+/* Empty the queue. Records a forked child inherits were the parent's to
+ * write, not its own. */
+static void log_reset(void) {
+  for (unsigned int i = 0; i < LOG_QUEUE_RECORDS; i++) {
+    atomic_store(&log_queue[i].seq, i);
+  }
+  atomic_store(&log_head, 0);
+  log_tail = 0;
+  atomic_store(&log_dropped, 0);
+}
+
+/* The parent's logger does not survive fork(): write at once until the
+ * child starts its own */
+static void log_after_fork(void) {
+  atomic_store(&log_running, 0);
+  pthread_mutex_init(&log_reader, NULL);
+  log_reset();
+}
+
+static void log_register(void) {
+  pthread_atfork(NULL, NULL, log_after_fork);
+  atexit(hampod_log_flush);
+}
+
+int hampod_log_start(void) {
+  pthread_once(&log_once, log_register);
+  if (atomic_load(&log_running)) {
+    return 0;
+  }
+
+  log_reset();
+  sem_init(&log_ready, 0, 0);
+
+  atomic_store(&log_running, 1);
+  if (pthread_create(&log_thread, NULL, log_thread_func, NULL) != 0) {
+    atomic_store(&log_running, 0);
+    return -1;
+  }
+  pthread_detach(log_thread);
+  return 0;
+}
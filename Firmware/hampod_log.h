@@ -0,0 +1,61 @@
+/* Asynchronous logging shared by Firmware and Software2
+ *
+ * printf() blocks the calling thread whenever whatever reads stdout is
+ * slow - under the systemd service that is journald - and the caller may
+ * be the keypad or audio thread. hampod_log() instead formats the message
+ * on the calling thread into a fixed-size record and queues it; a logger
+ * thread at the lowest priority (nice 19) writes it out.
+ *
+ * Any thread may log. A writer claims a record with a compare-and-swap and
+ * publishes it by storing its sequence number last, so the queue takes no
+ * lock, and a writer never waits: when the queue is full the message is
+ * dropped and counted, and the logger reports how many were lost.
+ *
+ * Messages are rate limited per call site: at most LOG_BURST from one site
+ * in LOG_INTERVAL_MS. The rest are counted, and the count is logged ahead
+ * of the next message that site lets through.
+ *
+ * Before hampod_log_start(), in a forked child until it starts its own
+ * logger, and in programs that never start one (tests, tools), messages
+ * are written at once, as before.
+ *
+ * Like hampod_trace, this is always its own object (hampod_log.o).
+ */
+#ifndef HAMPOD_LOG_H
+#define HAMPOD_LOG_H
+
+#include <stdatomic.h>
+
+#define LOG_QUEUE_RECORDS 256 /* Power of two; 64 KB per process */
+#define LOG_RECORD_LEN 256    /* Longer messages are cut short */
+#define LOG_BURST 20          /* Messages from one call site per interval */
+#define LOG_INTERVAL_MS 10000
+
+/* Rate limit state of one call site (HAMPOD_LOG() makes one per use) */
+typedef struct {
+  _Atomic long long window_ms; /* When the current interval began */
+  _Atomic int count;           /* Messages in it so far */
+  _Atomic int suppressed;      /* Over LOG_BURST, not yet reported */
+} Log_site;
+
+/* Queue a message for fd (1 or 2), printf style. Never blocks. */
+void hampod_log(Log_site *site, int fd, const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+/* Log from this call site */
+#define HAMPOD_LOG(fd, ...)                                                    \
+  do {                                                                         \
+    static Log_site hampod_log_site_;                                          \
+    hampod_log(&hampod_log_site_, (fd), __VA_ARGS__);                          \
+  } while (0)
+
+/* Start this process's logger thread; call again in a forked child to
+ * give it one of its own. What is still queued at exit() is written out.
+ * Returns 0, or -1 if the thread cannot be made; messages are then
+ * written at once. */
+int hampod_log_start(void);
+
+/* Write out everything queued so far, on the calling thread */
+void hampod_log_flush(void);
+
+#endif
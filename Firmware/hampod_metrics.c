@@ -0,0 +1,70 @@
+#include "hampod_metrics.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <unistd.h>
+
+Metric_registry *hampod_metrics = NULL;
+
+static const uint64_t bucket_limits_us[METRIC_BUCKETS - 1] =
+    METRIC_BUCKET_LIMITS_US;
+
+void hampod_metric_observe_us(Metric id, uint64_t us) {
+  if (hampod_metrics == NULL) {
+    return;
+  }
+  int bucket = 0;
+  while (bucket < METRIC_BUCKETS - 1 && us >= bucket_limits_us[bucket]) {
+    bucket++;
+  }
+  Metric_slot *slot = &hampod_metrics->slot[id];
+  atomic_fetch_add_explicit(&slot->buckets[bucket], 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&slot->sum_us, us, memory_order_relaxed);
+  atomic_fetch_add_explicit(&slot->value, 1, memory_order_relaxed);
+  hampod_metric_written(id);
+}
+
+void hampod_metrics_name_thread(const char *name) {
+  prctl(PR_SET_NAME, name, 0, 0, 0);
+}
+
+int hampod_metrics_open(const char *process) {
+  Metric_registry *old = hampod_metrics;
+  hampod_metrics = NULL;
+  if (old != NULL) {
+    munmap(old, sizeof(Metric_registry)); /* The parent's, after a fork */
+  }
+
+  char path[64];
+  snprintf(path, sizeof(path), "%s/%s%s", METRICS_DIR, METRICS_FILE_PREFIX,
+           process);
+  int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    perror(path);
+    return -1;
+  }
+  if (ftruncate(fd, sizeof(Metric_registry)) != 0) {
+    perror(path);
+    close(fd);
+    return -1;
+  }
+  Metric_registry *registry = mmap(NULL, sizeof(Metric_registry),
+                                   PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (registry == MAP_FAILED) {
+    perror(path);
+    return -1;
+  }
+
+  /* The file is new and zero-filled: every metric reads 0, unwritten */
+  registry->metrics = METRICS;
+  registry->pid = getpid();
+  strncpy(registry->process, process, sizeof(registry->process) - 1);
+  atomic_thread_fence(memory_order_release);
+  registry->magic = METRICS_MAGIC; /* Last: readers skip one without it */
+  hampod_metrics = registry;
+  return 0;
+}
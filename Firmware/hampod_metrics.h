@@ -0,0 +1,170 @@
+/* Runtime metrics shared by Firmware and Software2
+ *
+ * Counters, gauges and histograms that say how the system is doing right
+ * now: queue depths and drops, audio underruns, TTS cache hits, Hamlib
+ * call times, radio polls. Each process keeps its own registry in
+ * METRICS_DIR/hampod_metrics.<process>, a file in tmpfs holding one slot
+ * for every metric in HAMPOD_METRIC_LIST below; a process only writes the
+ * metrics it owns. Updates are relaxed atomic operations on the slot, with
+ * no lock and no system call, so they can sit on hot paths.
+ *
+ * metrics_dump (`hampod stats`) reads every registry, adds the CPU time of
+ * each thread from /proc, and prints them, or with -p in the Prometheus
+ * text format. metrics_dump -l PORT serves that format over HTTP for a
+ * Prometheus server to scrape.
+ *
+ * Like hampod_trace, this is always its own object (hampod_metrics.o).
+ */
+#ifndef HAMPOD_METRICS
+#define HAMPOD_METRICS
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define METRICS_DIR "/dev/shm"
+#define METRICS_FILE_PREFIX "hampod_metrics."
+#define METRICS_MAGIC 0x484d5452 /* "HMTR" */
+#define METRICS_PROCESS_MAX 16
+
+/* Histogram buckets: under 1, 2, 5, 10, 20, 50, 100, 200, 500 and 1000 ms,
+ * then the rest (as in Software2's radio_trace.h) */
+#define METRIC_BUCKETS 11
+#define METRIC_BUCKET_LIMITS_US                                                \
+  {1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000, 500000, 1000000}
+
+typedef enum { METRIC_COUNTER, METRIC_GAUGE, METRIC_HISTOGRAM } Metric_kind;
+
+/* Metrics: id, Prometheus name (without the hampod_ prefix), kind and
+ * help. Histograms are observed in microseconds and exported in seconds. */
+#define HAMPOD_METRIC_LIST(X)                                                  \
+  X(METRIC_KEYPAD_QUEUE_DEPTH, "keypad_queue_depth", METRIC_GAUGE,             \
+    "Requests queued for the keypad process")                                  \
+  X(METRIC_KEYPAD_QUEUE_DROPS, "keypad_queue_drops_total", METRIC_COUNTER,     \
+    "Requests dropped because the keypad queue was full")                      \
+  X(METRIC_KEYPAD_EVENT_DROPS, "keypad_event_drops_total", METRIC_COUNTER,     \
+    "Key events dropped because nobody read them")                             \
+  X(METRIC_AUDIO_QUEUE_DEPTH, "audio_queue_depth", METRIC_GAUGE,               \
+    "Requests queued for the audio process")                                   \
+  X(METRIC_AUDIO_QUEUE_DROPS, "audio_queue_drops_total", METRIC_COUNTER,       \
+    "Requests dropped because the audio queue was full")                       \
+  X(METRIC_AUDIO_BUSY, "audio_busy_total", METRIC_COUNTER,                     \
+    "Requests answered busy because a queue was full")                         \
+  X(METRIC_AUDIO_EXPIRED, "audio_expired_total", METRIC_COUNTER,               \
+    "Requests skipped because their deadline had passed")                      \
+  X(METRIC_AUDIO_REQUESTS, "audio_requests_total", METRIC_COUNTER,             \
+    "Audio requests played or refused")                                        \
+  X(METRIC_AUDIO_UNDERRUNS, "audio_underruns_total", METRIC_COUNTER,           \
+    "Playback buffer underruns")                                               \
+  X(METRIC_AUDIO_BUFFER_MS, "audio_buffer_ms", METRIC_GAUGE,                   \
+    "Playback buffer size in ms")                                              \
+  X(METRIC_AUDIO_REOPENS, "audio_device_reopens_total", METRIC_COUNTER,        \
+    "Audio device reopened after it was lost or replaced")                     \
+  X(METRIC_TTS_RAM_HITS, "tts_ram_hits_total", METRIC_COUNTER,                 \
+    "Speech played from the TTS cache in memory")                              \
+  X(METRIC_TTS_DISK_HITS, "tts_disk_hits_total", METRIC_COUNTER,               \
+    "Speech played from the TTS cache on disk")                                \
+  X(METRIC_TTS_MISSES, "tts_misses_total", METRIC_COUNTER,                     \
+    "Speech synthesized because it was not cached")                            \
+  X(METRIC_TTS_FIRST_AUDIO, "tts_first_audio_seconds", METRIC_HISTOGRAM,       \
+    "Time from a speak request to its first audio")                            \
+  X(METRIC_TTS_CRASHES, "tts_engine_crashes_total", METRIC_COUNTER,            \
+    "Speech engine processes that died and were replaced")                     \
+  X(METRIC_WATCHDOG_ACTIONS, "watchdog_actions_total", METRIC_COUNTER,         \
+    "Recovery steps taken for a stalled audio pipeline or link")               \
+  X(METRIC_SLO_MISSES, "slo_misses_total", METRIC_COUNTER,                     \
+    "Key to beep, key to first audio or radio poll age over its SLO")          \
+  X(METRIC_KEY_PUSH_DROPS, "key_push_drops_total", METRIC_COUNTER,             \
+    "Pushed key events dropped from a full queue")                             \
+  X(METRIC_SPEECH_QUEUE_DEPTH, "speech_queue_depth", METRIC_GAUGE,             \
+    "Announcements waiting in the speech queue")                               \
+  X(METRIC_SPEECH_DROPS, "speech_drops_total", METRIC_COUNTER,                 \
+    "Announcements dropped: speech queue full, or Firmware busy")              \
+  X(METRIC_SPEECH_EXPIRED, "speech_expired_total", METRIC_COUNTER,             \
+    "Announcements dropped unsaid after their time to live")                   \
+  X(METRIC_HAMLIB_CALL, "hamlib_call_seconds", METRIC_HISTOGRAM,               \
+    "Time spent in each Hamlib call")                                          \
+  X(METRIC_HAMLIB_ERRORS, "hamlib_errors_total", METRIC_COUNTER,               \
+    "Hamlib calls that failed")                                                \
+  X(METRIC_RADIO_POLLS, "radio_polls_total", METRIC_COUNTER,                   \
+    "Radio polls made")                                                        \
+  X(METRIC_IDLE_WAKEUPS, "idle_wakeups_total", METRIC_COUNTER,                 \
+    "Timed wakeups that found nothing to do")                                  \
+  X(METRIC_IDLE_WAKEUP_RATE, "idle_wakeups_per_second", METRIC_GAUGE,          \
+    "Timed wakeups that found nothing to do, per second of late")              \
+  X(METRIC_VOICE_COMMANDS, "voice_commands_total", METRIC_COUNTER,             \
+    "Spoken commands recognized")                                              \
+  X(METRIC_VOICE_REJECTS, "voice_rejects_total", METRIC_COUNTER,               \
+    "Utterances that were not a command")                                      \
+  X(METRIC_VOICE_RECOGNITION, "voice_recognition_seconds", METRIC_HISTOGRAM,   \
+    "Time to recognize an utterance once it ended")                            \
+  X(METRIC_REMOTE_FRAMES, "remote_audio_frames_total", METRIC_COUNTER,         \
+    "Opus frames streamed to the remote station")                              \
+  X(METRIC_REMOTE_DROPS, "remote_audio_drops_total", METRIC_COUNTER,           \
+    "Remote station audio dropped: stream behind, or send refused")            \
+  X(METRIC_REMOTE_KEYS, "remote_keys_total", METRIC_COUNTER,                   \
+    "Key events taken from the remote station")
+
+#define METRIC_ID(id, name, kind, help) id,
+typedef enum { HAMPOD_METRIC_LIST(METRIC_ID) METRICS } Metric;
+#undef METRIC_ID
+_Static_assert(METRICS <= 64, "Metric_registry.written has a bit per metric");
+
+typedef struct Metric_slot {
+  _Atomic uint64_t value; /* Counter, gauge (an int64_t) or histogram count */
+  _Atomic uint64_t sum_us; /* Histogram: sum of the observations */
+  _Atomic uint64_t buckets[METRIC_BUCKETS];
+} Metric_slot;
+
+typedef struct Metric_registry {
+  uint32_t magic;
+  uint32_t metrics; /* METRICS, so a reader from another build can tell */
+  int32_t pid;
+  char process[METRICS_PROCESS_MAX];
+  _Atomic uint64_t written; /* Bit per metric this process has written */
+  Metric_slot slot[METRICS];
+} Metric_registry;
+
+/* This process's registry, NULL until hampod_metrics_open() */
+extern Metric_registry *hampod_metrics;
+
+static inline void hampod_metric_written(Metric id) {
+  uint64_t bit = (uint64_t)1 << id;
+  if (!(atomic_load_explicit(&hampod_metrics->written, memory_order_relaxed) &
+        bit)) {
+    atomic_fetch_or_explicit(&hampod_metrics->written, bit,
+                             memory_order_relaxed);
+  }
+}
+
+/* Add n to a counter (or a gauge) */
+static inline void hampod_metric_add(Metric id, uint64_t n) {
+  if (hampod_metrics != NULL) {
+    atomic_fetch_add_explicit(&hampod_metrics->slot[id].value, n,
+                              memory_order_relaxed);
+    hampod_metric_written(id);
+  }
+}
+
+/* Set a gauge, or a counter kept elsewhere */
+static inline void hampod_metric_set(Metric id, int64_t value) {
+  if (hampod_metrics != NULL) {
+    atomic_store_explicit(&hampod_metrics->slot[id].value, (uint64_t)value,
+                          memory_order_relaxed);
+    hampod_metric_written(id);
+  }
+}
+
+/* Count one observation of us microseconds in a histogram */
+void hampod_metric_observe_us(Metric id, uint64_t us);
+
+/* Name the calling thread (up to 15 characters), so metrics_dump can tell
+ * the threads of a process apart */
+void hampod_metrics_name_thread(const char *name);
+
+/* Start (or restart) this process's registry under name. Call again in a
+ * forked child to give it a registry of its own. Returns 0, or -1 if the
+ * file cannot be made; the metrics are then not kept. */
+int hampod_metrics_open(const char *process);
+
+#endif
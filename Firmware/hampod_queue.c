@@ -1,67 +1,81 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "hampod_alloc.h"
 #include "hampod_firm_packet.h"
 #include "hampod_queue.h"
 
 Packet_queue *create_packet_queue() {
-  Packet_queue *new = malloc(sizeof(Packet_queue));
+  Packet_queue *new = hampod_malloc(ALLOC_QUEUE, sizeof(Packet_queue));
   if (!new) {
     perror("Queue memory allocation failed");
     exit(1);
   }
-  new->head = NULL;
-  new->tail = NULL;
+  new->first = 0;
+  new->count = 0;
+  new->held = 0;
+  new->high_water = 0;
+  new->dropped = 0;
+  for (int i = 0; i < PACKET_QUEUE_CAPACITY; i++) {
+    new->slots[i].packet.data = new->slots[i].payload;
+  }
   return new;
 }
 
-void enqueue(Packet_queue *queue, Inst_packet *packet) {
-  Node *new_node = malloc(sizeof(Node));
-  if (!new_node) {
-    perror("Node memory allocation failed");
-    exit(1);
+int enqueue(Packet_queue *queue, Packet_type type, unsigned short data_len,
+            const unsigned char *data, unsigned short tag,
+            unsigned short flags) {
+  if (queue->count == PACKET_QUEUE_CAPACITY ||
+      data_len > PACKET_QUEUE_DATA_MAX) {
+    queue->dropped++;
+    return -1;
   }
-  new_node->packet = packet;
-  new_node->next = NULL;
 
-  if (queue->tail == NULL) {
-    queue->head = new_node;
-    queue->tail = new_node;
-  } else {
-    queue->tail->next = new_node;
-    queue->tail = new_node;
+  Packet_slot *slot =
+      &queue->slots[(queue->first + queue->count) % PACKET_QUEUE_CAPACITY];
+  slot->packet.type = type;
+  slot->packet.data_len = data_len;
+  slot->packet.tag = tag;
+  slot->packet.flags = flags;
+  slot->packet.received_us = frame_clock_us();
+  memcpy(slot->payload, data, data_len);
+  slot->payload[data_len] = '\0';
+  queue->count++;
+
+  if (queue->count - queue->held > queue->high_water) {
+    queue->high_water = queue->count - queue->held;
   }
+  return 0;
 }
 
 Inst_packet *dequeue(Packet_queue *queue) {
-  if (queue->head == NULL) {
+  if (is_empty(queue)) {
     return NULL;
   }
 
-  Node *removed_node = queue->head;
-  Inst_packet *packet = removed_node->packet;
-  queue->head = removed_node->next;
-
-  if (queue->head == NULL) {
-    queue->tail = NULL;
-  }
-  free(removed_node);
-  return packet;
+  Packet_slot *slot =
+      &queue->slots[(queue->first + queue->held) % PACKET_QUEUE_CAPACITY];
+  queue->held++;
+  return &slot->packet;
 }
 
-void destroy_queue(Packet_queue *queue) {
-  while (queue->tail != NULL) {
-    Inst_packet *temp = dequeue(queue);
-    destroy_inst_packet(&temp);
+void release_packet(Packet_queue *queue, Inst_packet **packet) {
+  if (packet == NULL || *packet == NULL || queue->held == 0) {
+    return;
   }
-  free(queue);
+  queue->first = (queue->first + 1) % PACKET_QUEUE_CAPACITY;
+  queue->count--;
+  queue->held--;
+  *packet = NULL;
 }
 
-int is_empty(Packet_queue *queue) { return queue->head == NULL; }
+void destroy_queue(Packet_queue *queue) { hampod_free(queue); }
 
-void clear_queue(Packet_queue *queue) {
-  while (!is_empty(queue)) {
-    Inst_packet *temp = dequeue(queue);
-    destroy_inst_packet(&temp);
-  }
+int is_empty(Packet_queue *queue) { return queue->count == queue->held; }
+
+void clear_queue(Packet_queue *queue) { queue->count = queue->held; }
+
+int queue_depth(Packet_queue *queue) {
+  return (int)(queue->count - queue->held);
 }
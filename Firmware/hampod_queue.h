@@ -1,23 +1,63 @@
 #ifndef HAMPOD_QUEUE
 #define HAMPOD_QUEUE
 #include "hampod_firm_packet.h"
+#include "hampod_frame.h"
 
-typedef struct Node {
-  Inst_packet *packet;
-  struct Node *next;
-} Node;
+/* Bounded FIFO of preallocated packet slots.
+ *
+ * All storage, including every payload, is allocated once by
+ * create_packet_queue(), so enqueue/dequeue never touch the heap.
+ * enqueue() copies the payload into the next free slot (NUL-terminated
+ * one past data_len). dequeue() hands out a pointer into the slot, which
+ * stays reserved until release_packet() - the consumer can use the packet
+ * after dropping the queue lock. Callers still serialise access with their
+ * own mutex, as before; release_packet() must hold it too. */
+
+#define PACKET_QUEUE_CAPACITY 32
+#define PACKET_QUEUE_DATA_MAX FRAME_MAX_DATA
+
+typedef struct Packet_slot {
+  Inst_packet packet; /* packet.data points at payload */
+  unsigned char payload[PACKET_QUEUE_DATA_MAX + 1];
+} Packet_slot;
 
 typedef struct Packet_queue {
-  Node *head;
-  Node *tail;
+  unsigned int first;      /* Oldest occupied slot (held or queued) */
+  unsigned int count;      /* Occupied slots, including held ones */
+  unsigned int held;       /* Dequeued but not yet released */
+  unsigned int high_water; /* Deepest the queue has been */
+  unsigned long dropped;   /* Enqueues refused because the queue was full */
+  Packet_slot slots[PACKET_QUEUE_CAPACITY];
 } Packet_queue;
 
 Packet_queue *create_packet_queue();
-void enqueue(Packet_queue *queue, Inst_packet *packet);
+
+/* Local-only flag (never on the wire): the packet came in on a subsystem's
+ * direct Software channel, so its reply goes back on that channel */
+#define PACKET_FLAG_DIRECT 0x8000
+
+/* Copy a packet into the queue. Returns 0, or -1 if the queue is full or
+ * the payload is larger than PACKET_QUEUE_DATA_MAX (the packet is dropped
+ * and counted). flags are the frame's FRAME_FLAG_* bits. */
+int enqueue(Packet_queue *queue, Packet_type type, unsigned short data_len,
+            const unsigned char *data, unsigned short tag,
+            unsigned short flags);
+
+/* Oldest queued packet, or NULL if empty. Give it back with
+ * release_packet() once done. */
 Inst_packet *dequeue(Packet_queue *queue);
+
+/* Return the oldest dequeued packet's slot to the queue and NULL *packet. */
+void release_packet(Packet_queue *queue, Inst_packet **packet);
+
 void destroy_queue(Packet_queue *queue);
 int is_empty(Packet_queue *queue);
+
+/* Drop every queued packet (held packets stay valid until released). */
 void clear_queue(Packet_queue *queue);
+
+/* Number of queued (not yet dequeued) packets, for monitoring */
+int queue_depth(Packet_queue *queue);
 #ifndef SHAREDLIB
 #include "hampod_queue.c"
 #endif
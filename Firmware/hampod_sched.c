@@ -0,0 +1,135 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* CPU_SET / sched_setaffinity */
+#endif
+
+#include <errno.h>
+#include <malloc.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "hampod_sched.h"
+
+int sched_parse_cpus(const char *cpus, int *first, int *last) {
+  if (cpus == NULL || cpus[0] == '\0') {
+    return -1;
+  }
+  char *end;
+  long lo = strtol(cpus, &end, 10);
+  long hi = lo;
+  if (end == cpus) {
+    return -1;
+  }
+  if (*end == '-') {
+    const char *start = end + 1;
+    hi = strtol(start, &end, 10);
+    if (end == start) {
+      return -1;
+    }
+  }
+  if (*end != '\0' || lo < 0 || hi < lo || hi >= CPU_SETSIZE) {
+    return -1;
+  }
+  *first = (int)lo;
+  *last = (int)hi;
+  return 0;
+}
+
+int sched_pin_cpus(const char *cpus, const char *what) {
+  if (cpus == NULL || cpus[0] == '\0') {
+    return -1;
+  }
+  int first, last;
+  if (sched_parse_cpus(cpus, &first, &last) != 0) {
+    printf("Sched: %s: bad CPU range \"%s\", not pinned\n", what, cpus);
+    return -1;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu = first; cpu <= last; cpu++) {
+    CPU_SET(cpu, &set);
+  }
+  if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+    printf("Sched: %s: cannot pin to CPUs %s (%s)\n", what, cpus,
+           strerror(errno));
+    return -1;
+  }
+  printf("Sched: %s: pinned to CPUs %s\n", what, cpus);
+  return 0;
+}
+
+int sched_set_priority(pthread_t thread, int priority, const char *what) {
+  if (priority <= 0) {
+    return -1;
+  }
+  int min = sched_get_priority_min(SCHED_FIFO);
+  int max = sched_get_priority_max(SCHED_FIFO);
+  if (priority < min) {
+    priority = min;
+  } else if (priority > max) {
+    priority = max;
+  }
+  struct sched_param param = {.sched_priority = priority};
+  int rc = pthread_setschedparam(thread, SCHED_FIFO, &param);
+  if (rc != 0) {
+    printf("Sched: %s: cannot use SCHED_FIFO %d (%s)\n", what, priority,
+           strerror(rc));
+    return -1;
+  }
+  printf("Sched: %s: SCHED_FIFO priority %d\n", what, priority);
+  return 0;
+}
+
+/* Resident size of this process in bytes, or 0 if unknown */
+static unsigned long long resident_bytes(void) {
+  FILE *f = fopen("/proc/self/statm", "r");
+  long size = 0, resident = 0;
+  if (f != NULL) {
+    if (fscanf(f, "%ld %ld", &size, &resident) != 2) {
+      resident = 0;
+    }
+    fclose(f);
+  }
+  return (unsigned long long)resident * (unsigned long long)getpagesize();
+}
+
+/* Touch the next SCHED_STACK_PREFAULT bytes of the calling thread's stack
+ * so they are mapped, and with MCL_FUTURE locked, before they are needed */
+static void __attribute__((noinline)) prefault_stack(void) {
+  volatile unsigned char stack[SCHED_STACK_PREFAULT];
+  for (size_t i = 0; i < sizeof(stack); i += 4096) {
+    stack[i] = 0;
+  }
+}
+
+int sched_lock_memory(const char *what) {
+  /* Without CAP_IPC_LOCK everything locked counts against RLIMIT_MEMLOCK,
+   * and under MCL_FUTURE a mapping past the limit fails outright: a
+   * malloc or thread start would fail later instead of faulting */
+  struct rlimit limit;
+  unsigned long long needed =
+      resident_bytes() + ((unsigned long long)SCHED_LOCK_HEADROOM_MB << 20);
+  if (geteuid() != 0 && getrlimit(RLIMIT_MEMLOCK, &limit) == 0 &&
+      limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur < needed) {
+    printf("Sched: %s: not locking memory, memlock limit %llu kB is under "
+           "the %llu kB needed (raise it with ulimit -l or run as root)\n",
+           what, (unsigned long long)limit.rlim_cur >> 10, needed >> 10);
+    return -1;
+  }
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+    printf("Sched: %s: cannot lock memory (%s)\n", what, strerror(errno));
+    return -1;
+  }
+  /* Keep freed heap mapped, and so locked, rather than handing it back
+   * and faulting it in again on the next allocation */
+  mallopt(M_TRIM_THRESHOLD, -1);
+  mallopt(M_MMAP_MAX, 0);
+  prefault_stack();
+  printf("Sched: %s: memory locked (%llu kB resident)\n", what,
+         resident_bytes() >> 10);
+  return 0;
+}
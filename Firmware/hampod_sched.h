@@ -0,0 +1,81 @@
+/* Scheduling profile shared by Firmware and Software2
+ *
+ * The [scheduling] section of Software2's hampod.conf describes how the
+ * latency-critical threads should run: SCHED_FIFO priorities for the audio
+ * output and keypad threads, the cores I/O, Piper and the voice command
+ * recognizer are kept to, and
+ * whether the audio process and Software2 lock their memory, how much
+ * memory they plan for, whether they idle for battery operation and how
+ * the CPU frequency follows key and speech events.
+ * Software2 reads it with its config; run_hampod.sh passes it to
+ * firmware.elf as options.
+ *
+ * Every helper logs what it applied, or why it could not (real-time
+ * priorities and mlockall need root or the matching rlimits), and the
+ * caller carries on either way.
+ */
+#ifndef HAMPOD_SCHED
+#define HAMPOD_SCHED
+
+#include <pthread.h>
+
+#define SCHED_CPUS_MAX 16 /* Length of a CPU range string, with the NUL */
+
+typedef struct Sched_profile {
+  int audio_priority;  /* SCHED_FIFO priority of audio output; 0 = normal */
+  int keypad_priority; /* SCHED_FIFO priority of keypad input; 0 = normal */
+  char io_cpus[SCHED_CPUS_MAX];  /* "0", "1-3"; "" leaves it to the OS */
+  char tts_cpus[SCHED_CPUS_MAX]; /* CPUs for Piper */
+  char voice_cpus[SCHED_CPUS_MAX]; /* CPUs for voice commands (hal_voice.h) */
+  int mlock;                     /* mlockall() audio and Software2 */
+  int low_memory;                /* memory_profile = low */
+  int idle_mode;                 /* idle_mode = 1 */
+  int cpu_boost_ms; /* Full speed this long after an event; 0 = off */
+  char cpu_idle_governor[16]; /* Governor between boosts (hampod_cpufreq.h) */
+} Sched_profile;
+
+/* Limits of memory_profile = low, for 512 MB boards such as the Zero 2 W.
+ * Firmware and Software2 each apply their own; explicitly set HAMPOD_*
+ * variables still win over the Firmware ones. */
+#define MEMORY_LOW_PIPER_WORKERS 1 /* Each holds its own copy of the model */
+#define MEMORY_LOW_TTS_RAM_MB 2    /* Speech cache in RAM */
+#define MEMORY_LOW_TTS_DISK_MB 256 /* Speech cache on the SD card */
+#define MEMORY_LOW_SPEECH_QUEUE 16 /* Software2's speech queue, in items */
+
+/* idle_mode = 1, for battery operation. Threads always block on real
+ * events; in this mode Software2's periodic work (its housekeeping timer
+ * and the radio poll) also slows down once no key has been pressed for
+ * IDLE_MODE_AFTER_MS, and the audio device is kept running for
+ * IDLE_MODE_KEEPALIVE_S after the last sound instead of minutes. */
+#define IDLE_MODE_AFTER_MS 30000
+#define IDLE_MODE_KEEPALIVE_S 10
+
+/* Parse a CPU range ("2" or "1-3") into first..last. Returns 0 on
+ * success, -1 if it is empty or malformed. */
+int sched_parse_cpus(const char *cpus, int *first, int *last);
+
+/* Keep the calling thread, and the threads and processes it starts from
+ * now on, to cpus. An empty range does nothing. Returns 0 if applied. */
+int sched_pin_cpus(const char *cpus, const char *what);
+
+/* Run thread under SCHED_FIFO at priority (1-99); 0 does nothing.
+ * Returns 0 if applied. */
+int sched_set_priority(pthread_t thread, int priority, const char *what);
+
+/* Room left under RLIMIT_MEMLOCK for what a locked process maps later */
+#define SCHED_LOCK_HEADROOM_MB 32
+/* Stack of the locking thread touched in advance; threads started later
+ * get their whole stack mapped and locked by MCL_FUTURE */
+#define SCHED_STACK_PREFAULT (64 * 1024)
+
+/* mlockall() the current and future memory of this process, prefault the
+ * caller's stack and stop malloc returning memory to the kernel. Skipped
+ * when the memlock limit (root aside) cannot hold the resident set plus
+ * SCHED_LOCK_HEADROOM_MB. Call it before starting the real-time threads.
+ * Returns 0 if applied. */
+int sched_lock_memory(const char *what);
+
+#ifndef SHAREDLIB
+#include "hampod_sched.c"
+#endif
+#endif
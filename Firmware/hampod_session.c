@@ -0,0 +1,353 @@
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#include "hampod_frame.h"
+#include "hampod_session.h"
+
+#define SESSION_NO_OWNER 0
+#define SESSION_OWNER_INTERNAL 0xFF
+#define SESSION_REMAP_BASE 0xF000 /* | slot; never the keypad push tag */
+
+typedef struct Session {
+  Transport link;          /* rx_fd is -1 while the slot is free */
+  unsigned int generation; /* Counts the clients the slot has served */
+  Session_priority priority;
+  unsigned int speech_playing; /* Forwarded speech not yet answered */
+  int more_open;               /* A fragmented request is coming in */
+  unsigned short more_client_tag;
+  unsigned short more_tag;
+  pthread_mutex_t write_lock; /* Serialises sends with closing the link */
+} Session;
+
+/* A request in flight, in the slot of the tag it was forwarded under */
+typedef struct Session_tag {
+  unsigned char owner;  /* Session index + 1, or SESSION_OWNER_INTERNAL */
+  unsigned char speech; /* Counted in the owner's speech_playing */
+  unsigned short tag;   /* As forwarded */
+  unsigned short client_tag;
+  unsigned int stamp_ms;
+} Session_tag;
+
+static Session sessions[SESSION_MAX] = {
+    [0 ... SESSION_MAX - 1] = {.link = {TRANSPORT_FIFO, -1, -1},
+                               .write_lock = PTHREAD_MUTEX_INITIALIZER}};
+static Session_tag tags[SESSION_TAG_SLOTS];
+static unsigned int remap_cursor = 0;
+static int key_owner = -1; /* Session holding the keypad subscription */
+static pthread_mutex_t session_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned int session_clock_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned int)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+/* Caller holds session_lock */
+static int session_is_open(int index) {
+  return sessions[index].link.rx_fd != -1;
+}
+
+/* Caller holds session_lock */
+static int session_main(void) {
+  for (int i = 0; i < SESSION_MAX; i++) {
+    if (session_is_open(i) && sessions[i].priority == SESSION_PRIORITY_MAIN) {
+      return i;
+    }
+  }
+  for (int i = 0; i < SESSION_MAX; i++) {
+    if (session_is_open(i)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/* Free a slot, settling the owner's speech count. Caller holds
+ * session_lock. */
+static void tag_free(Session_tag *entry) {
+  if (entry->speech && entry->owner != SESSION_OWNER_INTERNAL &&
+      sessions[entry->owner - 1].speech_playing > 0) {
+    sessions[entry->owner - 1].speech_playing--;
+  }
+  entry->owner = SESSION_NO_OWNER;
+  entry->speech = 0;
+}
+
+/* Whether a slot can be taken, freeing it if its request has expired.
+ * Caller holds session_lock. */
+static int tag_available(Session_tag *entry, unsigned int now) {
+  if (entry->owner == SESSION_NO_OWNER) {
+    return 1;
+  }
+  if (now - entry->stamp_ms > SESSION_TAG_TTL_MS) {
+    tag_free(entry);
+    return 1;
+  }
+  return 0;
+}
+
+/* Take a slot for owner. Returns the forwarded tag. Caller holds
+ * session_lock. */
+static unsigned short tag_take(unsigned char owner, unsigned short client_tag,
+                               int keep) {
+  unsigned int now = session_clock_ms();
+  Session_tag *entry = &tags[client_tag % SESSION_TAG_SLOTS];
+  unsigned short tag = client_tag;
+  if (!keep || !tag_available(entry, now)) {
+    entry = NULL;
+    for (unsigned int n = 0; n < SESSION_TAG_SLOTS; n++) {
+      unsigned int slot = (remap_cursor + n) % SESSION_TAG_SLOTS;
+      if (tag_available(&tags[slot], now)) {
+        remap_cursor = slot + 1;
+        entry = &tags[slot];
+        tag = (unsigned short)(SESSION_REMAP_BASE | slot);
+        break;
+      }
+    }
+  }
+  if (entry == NULL) {
+    return client_tag; /* All in flight: the reply goes to the main session */
+  }
+  entry->owner = owner;
+  entry->speech = 0;
+  entry->tag = tag;
+  entry->client_tag = client_tag;
+  entry->stamp_ms = now;
+  return tag;
+}
+
+int session_open(const Transport *link) {
+  pthread_mutex_lock(&session_lock);
+  int index = -1;
+  for (int i = 0; i < SESSION_MAX && index == -1; i++) {
+    if (!session_is_open(i)) {
+      index = i;
+    }
+  }
+  if (index != -1) {
+    int main_open = 0;
+    for (int i = 0; i < SESSION_MAX; i++) {
+      main_open |= session_is_open(i) &&
+                   sessions[i].priority == SESSION_PRIORITY_MAIN;
+    }
+    Session *session = &sessions[index];
+    pthread_mutex_lock(&session->write_lock);
+    session->link = *link;
+    session->generation++;
+    pthread_mutex_unlock(&session->write_lock);
+    session->priority =
+        main_open ? SESSION_PRIORITY_NORMAL : SESSION_PRIORITY_MAIN;
+    session->speech_playing = 0;
+    session->more_open = 0;
+  }
+  pthread_mutex_unlock(&session_lock);
+  return index;
+}
+
+int session_close(int index) {
+  Session *session = &sessions[index];
+  pthread_mutex_lock(&session_lock);
+  pthread_mutex_lock(&session->write_lock);
+  transport_close(&session->link);
+  pthread_mutex_unlock(&session->write_lock);
+  for (int slot = 0; slot < SESSION_TAG_SLOTS; slot++) {
+    if (tags[slot].owner == index + 1) {
+      tag_free(&tags[slot]);
+    }
+  }
+  session->speech_playing = 0;
+  int held_keypad = key_owner == index;
+  if (held_keypad) {
+    key_owner = -1;
+  }
+  pthread_mutex_unlock(&session_lock);
+  return held_keypad;
+}
+
+int session_count(void) {
+  pthread_mutex_lock(&session_lock);
+  int count = 0;
+  for (int i = 0; i < SESSION_MAX; i++) {
+    count += session_is_open(i);
+  }
+  pthread_mutex_unlock(&session_lock);
+  return count;
+}
+
+unsigned short session_map_tag(int index, unsigned short client_tag,
+                               int more) {
+  Session *session = &sessions[index];
+  pthread_mutex_lock(&session_lock);
+  unsigned short tag;
+  if (session->more_open && session->more_client_tag == client_tag) {
+    tag = session->more_tag; /* A later fragment of the same request */
+    Session_tag *entry = &tags[tag % SESSION_TAG_SLOTS];
+    if (entry->owner == index + 1 && entry->tag == tag) {
+      entry->stamp_ms = session_clock_ms();
+    }
+  } else {
+    tag = tag_take((unsigned char)(index + 1), client_tag, 1);
+  }
+  session->more_open = more;
+  session->more_client_tag = client_tag;
+  session->more_tag = tag;
+  pthread_mutex_unlock(&session_lock);
+  return tag;
+}
+
+unsigned short session_internal_tag(void) {
+  pthread_mutex_lock(&session_lock);
+  unsigned short tag = tag_take(SESSION_OWNER_INTERNAL, 0, 0);
+  pthread_mutex_unlock(&session_lock);
+  return tag;
+}
+
+int session_route(unsigned short tag, unsigned short *client_tag,
+                  unsigned int *generation) {
+  pthread_mutex_lock(&session_lock);
+  Session_tag *entry = &tags[tag % SESSION_TAG_SLOTS];
+  int index;
+  *client_tag = tag;
+  if (entry->owner != SESSION_NO_OWNER && entry->tag == tag) {
+    index = entry->owner == SESSION_OWNER_INTERNAL ? SESSION_INTERNAL
+                                                   : entry->owner - 1;
+    *client_tag = entry->client_tag;
+    tag_free(entry);
+  } else {
+    index = session_main();
+  }
+  if (index >= 0) {
+    *generation = sessions[index].generation;
+  }
+  pthread_mutex_unlock(&session_lock);
+  return index;
+}
+
+int session_route_push(unsigned int *generation) {
+  pthread_mutex_lock(&session_lock);
+  int index = key_owner != -1 ? key_owner : session_main();
+  if (index >= 0) {
+    *generation = sessions[index].generation;
+  }
+  pthread_mutex_unlock(&session_lock);
+  return index;
+}
+
+int session_tag_owner(unsigned short tag) {
+  pthread_mutex_lock(&session_lock);
+  Session_tag *entry = &tags[tag % SESSION_TAG_SLOTS];
+  int index = -1;
+  if (entry->owner != SESSION_NO_OWNER &&
+      entry->owner != SESSION_OWNER_INTERNAL && entry->tag == tag) {
+    index = entry->owner - 1;
+  }
+  pthread_mutex_unlock(&session_lock);
+  return index;
+}
+
+int session_send(int index, unsigned int generation, int type,
+                 unsigned short tag, const void *data,
+                 unsigned short data_len) {
+  Session *session = &sessions[index];
+  pthread_mutex_lock(&session->write_lock);
+  int result = -1;
+  /* generation only changes with the link, under write_lock */
+  if (session->link.tx_fd != -1 && session->generation == generation) {
+    result = frame_write(session->link.tx_fd, type, tag, data, data_len);
+  }
+  pthread_mutex_unlock(&session->write_lock);
+  return result;
+}
+
+unsigned int session_generation(int index) {
+  pthread_mutex_lock(&session_lock);
+  unsigned int generation = sessions[index].generation;
+  pthread_mutex_unlock(&session_lock);
+  return generation;
+}
+
+Session_priority session_priority(int index) {
+  pthread_mutex_lock(&session_lock);
+  Session_priority priority = sessions[index].priority;
+  pthread_mutex_unlock(&session_lock);
+  return priority;
+}
+
+Session_priority session_set_priority(int index, Session_priority priority) {
+  if (priority > SESSION_PRIORITY_MAIN) {
+    priority = SESSION_PRIORITY_MAIN;
+  }
+  pthread_mutex_lock(&session_lock);
+  if (priority == SESSION_PRIORITY_MAIN) {
+    for (int i = 0; i < SESSION_MAX; i++) {
+      if (i != index && sessions[i].priority == SESSION_PRIORITY_MAIN) {
+        sessions[i].priority = SESSION_PRIORITY_NORMAL;
+      }
+    }
+  }
+  sessions[index].priority = priority;
+  pthread_mutex_unlock(&session_lock);
+  return priority;
+}
+
+int session_outranked(int index) {
+  pthread_mutex_lock(&session_lock);
+  int outranked = 0;
+  for (int i = 0; i < SESSION_MAX; i++) {
+    outranked |= session_is_open(i) && sessions[i].speech_playing > 0 &&
+                 sessions[i].priority > sessions[index].priority;
+  }
+  pthread_mutex_unlock(&session_lock);
+  return outranked;
+}
+
+int session_should_preempt(int index) {
+  pthread_mutex_lock(&session_lock);
+  int preempt = 0;
+  if (sessions[index].speech_playing == 0) {
+    for (int i = 0; i < SESSION_MAX; i++) {
+      preempt |= session_is_open(i) && sessions[i].speech_playing > 0 &&
+                 sessions[i].priority < sessions[index].priority;
+    }
+  }
+  pthread_mutex_unlock(&session_lock);
+  return preempt;
+}
+
+void session_note_speech(unsigned short tag) {
+  pthread_mutex_lock(&session_lock);
+  Session_tag *entry = &tags[tag % SESSION_TAG_SLOTS];
+  if (entry->owner != SESSION_NO_OWNER &&
+      entry->owner != SESSION_OWNER_INTERNAL && entry->tag == tag &&
+      !entry->speech) {
+    entry->speech = 1;
+    sessions[entry->owner - 1].speech_playing++;
+  }
+  pthread_mutex_unlock(&session_lock);
+}
+
+void session_clear_speech(void) {
+  pthread_mutex_lock(&session_lock);
+  for (int slot = 0; slot < SESSION_TAG_SLOTS; slot++) {
+    tags[slot].speech = 0; /* Their acks no longer count */
+  }
+  for (int i = 0; i < SESSION_MAX; i++) {
+    sessions[i].speech_playing = 0;
+  }
+  pthread_mutex_unlock(&session_lock);
+}
+
+int session_subscribe(int index, int on) {
+  pthread_mutex_lock(&session_lock);
+  int forward = 1;
+  if (on) {
+    key_owner = index;
+  } else if (key_owner == -1 || key_owner == index) {
+    key_owner = -1;
+  } else {
+    forward = 0; /* Another session subscribed since */
+  }
+  pthread_mutex_unlock(&session_lock);
+  return forward;
+}
@@ -0,0 +1,121 @@
+/* Client sessions of the Firmware controller
+ *
+ * With --socket the controller serves up to SESSION_MAX clients at once,
+ * each on its own connection: the main UI (Software2) and tools such as a
+ * CLI or a monitoring helper. Every session has its own reader thread, so
+ * no client waits behind another's requests.
+ *
+ * Clients number their requests independently, so two may use the same
+ * tag at once. A request keeps its tag on the way to the keypad and audio
+ * processes unless that tag is already in flight for someone else; then
+ * it is forwarded under a free one. Either way the reply is routed back to
+ * the session that asked, under the tag it asked with. Pushed key events
+ * go to the session that subscribed last.
+ *
+ * Audio is arbitrated by session priority:
+ *   - speech of the main session goes ahead of the others' in the
+ *     controller's queue, and cuts off lower-priority speech that is
+ *     playing when it starts;
+ *   - an interrupt cannot stop speech of a higher-priority session; it is
+ *     answered with -1 instead;
+ *   - only the main session's speech epochs (hampod_frame.h) reach the
+ *     audio process; the others' requests are stripped of theirs.
+ * The first client to connect is the main session, and a client may claim
+ * it (or step down) with CONFIG_SESSION_PRIORITY.
+ *
+ * The FIFO transport has a single peer, which is the main session.
+ * Replies with a tag that is not in flight (shared-memory ring speech,
+ * --direct channels) go to the main session, as before.
+ */
+#ifndef HAMPOD_SESSION
+#define HAMPOD_SESSION
+
+#include <pthread.h>
+
+#include "hampod_transport.h"
+
+#define SESSION_MAX 4
+
+/* CONFIG [0x07, priority]: set the sending session's priority. Answered
+ * by the controller with CONFIG_SESSION_PRIORITY and the priority now in
+ * effect. A session claiming SESSION_PRIORITY_MAIN demotes the previous
+ * main session to SESSION_PRIORITY_NORMAL. */
+#define CONFIG_SESSION_PRIORITY 0x07
+
+typedef enum {
+  SESSION_PRIORITY_LOW,    /* Logging and monitoring helpers */
+  SESSION_PRIORITY_NORMAL, /* Tools */
+  SESSION_PRIORITY_MAIN    /* The main UI */
+} Session_priority;
+
+/* Owner returned by session_route() for the controller's own requests */
+#define SESSION_INTERNAL (-2)
+/* Requests in flight at once; also the number of tags a reply is looked
+ * up among, so a remapped tag is always 0xF000 | slot */
+#define SESSION_TAG_SLOTS 1024
+/* A request unanswered this long no longer holds its tag (some requests,
+ * such as CONFIG 0x01, are never answered) */
+#define SESSION_TAG_TTL_MS 60000
+
+/* Start serving a new client. Returns its session index, or -1 if
+ * SESSION_MAX sessions are open. */
+int session_open(const Transport *link);
+
+/* Stop serving a session and close its link. Requests it has in flight
+ * are answered to nobody. Returns 1 if it held the keypad subscription,
+ * which the caller should then cancel. */
+int session_close(int index);
+
+/* Count the open sessions */
+int session_count(void);
+
+/* Tag to forward a request of session index under; fragments of one
+ * request (more set on all but the last) share it. Use
+ * session_internal_tag() for the controller's own requests. */
+unsigned short session_map_tag(int index, unsigned short client_tag,
+                               int more);
+unsigned short session_internal_tag(void);
+
+/* Route a reply carrying tag: returns the session to send it to, with
+ * *client_tag and *generation to pass to session_send(), SESSION_INTERNAL
+ * if the controller asked, or -1 if no session is open. The tag is freed. */
+int session_route(unsigned short tag, unsigned short *client_tag,
+                  unsigned int *generation);
+
+/* Session that pushed key events go to, as session_route() */
+int session_route_push(unsigned int *generation);
+
+/* Session a forwarded tag belongs to, or -1 */
+int session_tag_owner(unsigned short tag);
+
+/* Send a frame to a session, unless it has closed or its slot has been
+ * taken by a new client since generation was read. Returns 0 if sent. */
+int session_send(int index, unsigned int generation, int type,
+                 unsigned short tag, const void *data,
+                 unsigned short data_len);
+unsigned int session_generation(int index);
+
+Session_priority session_priority(int index);
+/* Returns the priority now in effect */
+Session_priority session_set_priority(int index, Session_priority priority);
+
+/* Whether a session with a higher priority than index has speech playing
+ * (an interrupt from index must not stop it) */
+int session_outranked(int index);
+/* Whether speech from index should cut off what is playing: it has none
+ * playing itself and a lower-priority session does */
+int session_should_preempt(int index);
+/* The speech request forwarded under tag is with the audio process */
+void session_note_speech(unsigned short tag);
+/* The audio process dropped all speech (an interrupt without an epoch) */
+void session_clear_speech(void);
+
+/* Record a keypad subscription change from index. Returns 1 if it should
+ * be forwarded to the keypad process, 0 if it must be answered here (an
+ * unsubscribe from a session that no longer holds the keypad). */
+int session_subscribe(int index, int on);
+
+#ifndef SHAREDLIB
+#include "hampod_session.c"
+#endif
+#endif
@@ -0,0 +1,181 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hampod_shm_ring.h"
+
+#define SHM_RING_MASK (SHM_RING_SLOTS - 1)
+
+/* kill(pid, 0) succeeds (or is refused) only if pid is still alive */
+static int shm_ring_pid_alive(pid_t pid) {
+  return pid > 0 && (kill(pid, 0) == 0 || errno == EPERM);
+}
+
+Shm_audio_ring *shm_ring_create(const char *name) {
+  shm_unlink(name); /* Drop a segment left behind by a crashed Firmware */
+  int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0666);
+  if (fd == -1) {
+    return NULL;
+  }
+  if (ftruncate(fd, sizeof(Shm_audio_ring)) == -1) {
+    close(fd);
+    shm_unlink(name);
+    return NULL;
+  }
+
+  Shm_audio_ring *ring = mmap(NULL, sizeof(Shm_audio_ring),
+                              PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (ring == MAP_FAILED) {
+    shm_unlink(name);
+    return NULL;
+  }
+
+  if (sem_init(&ring->ready, 1, 0) == -1) {
+    munmap(ring, sizeof(Shm_audio_ring));
+    shm_unlink(name);
+    return NULL;
+  }
+  ring->owner_pid = getpid();
+  atomic_init(&ring->producer_pid, 0);
+  atomic_init(&ring->head, 0);
+  atomic_init(&ring->tail, 0);
+  atomic_init(&ring->discard_to, 0);
+  /* Publish last so an early attach never sees a half-built ring */
+  atomic_thread_fence(memory_order_release);
+  ring->magic = SHM_RING_MAGIC;
+  return ring;
+}
+
+void shm_ring_destroy(Shm_audio_ring *ring, const char *name) {
+  if (ring != NULL) {
+    sem_destroy(&ring->ready);
+    munmap(ring, sizeof(Shm_audio_ring));
+  }
+  shm_unlink(name);
+}
+
+Shm_audio_ring *shm_ring_attach(const char *name) {
+  int fd = shm_open(name, O_RDWR, 0);
+  if (fd == -1) {
+    return NULL;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) == -1 || st.st_size < (off_t)sizeof(Shm_audio_ring)) {
+    close(fd);
+    return NULL;
+  }
+
+  Shm_audio_ring *ring = mmap(NULL, sizeof(Shm_audio_ring),
+                              PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (ring == MAP_FAILED) {
+    return NULL;
+  }
+
+  if (ring->magic != SHM_RING_MAGIC || !shm_ring_pid_alive(ring->owner_pid)) {
+    munmap(ring, sizeof(Shm_audio_ring));
+    return NULL;
+  }
+
+  /* Claim the producer end; take it over if the last owner died */
+  pid_t self = getpid();
+  pid_t current = atomic_load(&ring->producer_pid);
+  while (current == 0 || !shm_ring_pid_alive(current)) {
+    if (atomic_compare_exchange_weak(&ring->producer_pid, &current, self)) {
+      return ring;
+    }
+  }
+
+  munmap(ring, sizeof(Shm_audio_ring));
+  return NULL;
+}
+
+void shm_ring_detach(Shm_audio_ring *ring) {
+  if (ring == NULL) {
+    return;
+  }
+  pid_t self = getpid();
+  atomic_compare_exchange_strong(&ring->producer_pid, &self, 0);
+  munmap(ring, sizeof(Shm_audio_ring));
+}
+
+int shm_ring_push(Shm_audio_ring *ring, char type, unsigned short tag,
+                  unsigned char epoch, const char *text) {
+  size_t len = strlen(text);
+  if (len >= SHM_RING_TEXT_MAX) {
+    return -1;
+  }
+
+  uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+  if (head - tail >= SHM_RING_SLOTS) {
+    return -1;
+  }
+
+  Shm_audio_slot *slot = &ring->slots[head & SHM_RING_MASK];
+  slot->tag = tag;
+  slot->type = type;
+  slot->epoch = epoch;
+  memcpy(slot->text, text, len + 1);
+
+  atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+  sem_post(&ring->ready);
+  return 0;
+}
+
+void shm_ring_discard(Shm_audio_ring *ring) {
+  uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  atomic_store_explicit(&ring->discard_to, head, memory_order_release);
+}
+
+Shm_audio_slot *shm_ring_peek(Shm_audio_ring *ring) {
+  uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  uint32_t discard_to =
+      atomic_load_explicit(&ring->discard_to, memory_order_acquire);
+  if ((int32_t)(discard_to - tail) > 0) {
+    tail = discard_to;
+    atomic_store_explicit(&ring->tail, tail, memory_order_release);
+  }
+
+  uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  if (head == tail) {
+    return NULL;
+  }
+  return &ring->slots[tail & SHM_RING_MASK];
+}
+
+void shm_ring_pop(Shm_audio_ring *ring) {
+  uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+int shm_ring_wait(Shm_audio_ring *ring, long timeout_us) {
+  int rc;
+  if (timeout_us < 0) {
+    do {
+      rc = sem_wait(&ring->ready);
+    } while (rc == -1 && errno == EINTR);
+    return rc == 0 ? 0 : -1;
+  }
+
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_sec += timeout_us / 1000000;
+  deadline.tv_nsec += (timeout_us % 1000000) * 1000;
+  if (deadline.tv_nsec >= 1000000000) {
+    deadline.tv_sec += 1;
+    deadline.tv_nsec -= 1000000000;
+  }
+
+  do {
+    rc = sem_timedwait(&ring->ready, &deadline);
+  } while (rc == -1 && errno == EINTR);
+  return rc == 0 ? 0 : -1;
+}
@@ -0,0 +1,87 @@
+/* Shared-memory audio request ring between Software2 and Firmware
+ *
+ * When Firmware is started with --shm-audio it creates a POSIX shared
+ * memory segment (SHM_RING_NAME) before forking the audio process.
+ * Software2 maps the same segment in comm_init() and writes speak / play
+ * requests straight into fixed-size slots, which the audio process reads
+ * in place. The text is copied once, into the slot, instead of going
+ * CommPacket -> Firmware_i -> Inst_packet -> Speaker_i -> calloc/strcpy.
+ *
+ * The ring is single-producer (the Software2 speech path) and
+ * single-consumer (the audio process main loop): head is only written by
+ * the producer, tail only by the consumer. A process-shared semaphore
+ * wakes the consumer when a request is published.
+ *
+ * Only requests use the ring. Acks (and interrupts, beeps and queries)
+ * still travel on the pipes, tagged as before, so the router in Software2
+ * does not change.
+ */
+#ifndef HAMPOD_SHM_RING
+#define HAMPOD_SHM_RING
+
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define SHM_RING_NAME "/hampod_audio"
+#define SHM_RING_MAGIC 0x48414d50 /* "HAMP" */
+#define SHM_RING_SLOTS 16         /* Power of two */
+#define SHM_RING_TEXT_MAX 256
+
+typedef struct Shm_audio_slot {
+  unsigned short tag;  /* Echoed back in the ack on Firmware_o */
+  char type;           /* Audio type byte ('d', 'p', ...) */
+  unsigned char epoch; /* Speech epoch, as in a pipe request's flags */
+  char text[SHM_RING_TEXT_MAX];
+} Shm_audio_slot;
+
+typedef struct Shm_audio_ring {
+  uint32_t magic;
+  pid_t owner_pid;             /* Firmware that created the segment */
+  _Atomic pid_t producer_pid;  /* Attached Software2, 0 if none */
+  _Atomic uint32_t head;       /* Next slot the producer fills */
+  _Atomic uint32_t tail;       /* Next slot the consumer reads */
+  _Atomic uint32_t discard_to; /* Consumer skips slots before this */
+  sem_t ready;                 /* Posted once per published request */
+  Shm_audio_slot slots[SHM_RING_SLOTS];
+} Shm_audio_ring;
+
+/* Firmware side: create (or recreate) the segment and map it.
+ * Returns NULL on error. */
+Shm_audio_ring *shm_ring_create(const char *name);
+
+/* Firmware side: unmap and remove the segment. */
+void shm_ring_destroy(Shm_audio_ring *ring, const char *name);
+
+/* Software side: map an existing segment and claim the producer end.
+ * Returns NULL if there is no segment, its Firmware is gone, or another
+ * live process is already producing. */
+Shm_audio_ring *shm_ring_attach(const char *name);
+
+/* Software side: release the producer end and unmap. */
+void shm_ring_detach(Shm_audio_ring *ring);
+
+/* Producer: copy one request into the next slot and wake the consumer.
+ * Returns 0 on success, -1 if the ring is full or text does not fit. */
+int shm_ring_push(Shm_audio_ring *ring, char type, unsigned short tag,
+                  unsigned char epoch, const char *text);
+
+/* Producer: drop every request published so far (speech interrupt). */
+void shm_ring_discard(Shm_audio_ring *ring);
+
+/* Consumer: the oldest pending slot, or NULL if the ring is empty.
+ * The slot stays valid until shm_ring_pop(). */
+Shm_audio_slot *shm_ring_peek(Shm_audio_ring *ring);
+
+/* Consumer: release the slot returned by shm_ring_peek(). */
+void shm_ring_pop(Shm_audio_ring *ring);
+
+/* Consumer: sleep until a request is published or timeout_us passes
+ * (timeout_us < 0 waits forever). Returns 0 if woken, -1 on timeout. */
+int shm_ring_wait(Shm_audio_ring *ring, long timeout_us);
+
+#ifndef SHAREDLIB
+#include "hampod_shm_ring.c"
+#endif
+#endif
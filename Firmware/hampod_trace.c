@@ -0,0 +1,122 @@
+#include "hampod_trace.h"
+
+#ifndef HAMPOD_TRACE_OFF
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+Trace_ring *hampod_trace_ring = NULL;
+
+/* Cached per thread, so recording makes no system call; 0 until the
+ * thread's first record. Reset after fork by hampod_trace_open(). */
+static __thread uint16_t trace_thread = 0;
+static __thread pid_t trace_thread_pid = 0;
+
+/* hampod_trace_key_begin(): the last key number given out, and the key
+ * still waiting for its speech (0 once claimed) with when it began */
+static _Atomic uint32_t key_last = 0;
+static _Atomic uint32_t key_pending = 0;
+static _Atomic uint64_t key_pending_ns = 0;
+
+static uint64_t trace_clock_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+void hampod_trace_write(Trace_event event, uint32_t a, uint32_t b,
+                        uint32_t c) {
+  Trace_ring *ring = hampod_trace_ring;
+  if (trace_thread_pid != ring->pid) {
+    trace_thread = (uint16_t)syscall(SYS_gettid);
+    trace_thread_pid = ring->pid;
+  }
+
+  uint64_t time_ns = trace_clock_ns();
+  uint32_t index =
+      atomic_fetch_add_explicit(&ring->head, 1, memory_order_relaxed);
+  Trace_record *record = &ring->ring[index & (TRACE_RING_RECORDS - 1)];
+
+  /* Unpublish first, so a reader never takes a half-written record for
+   * the one before it */
+  atomic_store_explicit(&record->seq, 0, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  record->event = (uint16_t)event;
+  record->thread = trace_thread;
+  record->time_ns = time_ns;
+  record->arg[0] = a;
+  record->arg[1] = b;
+  record->arg[2] = c;
+  atomic_store_explicit(&record->seq, index + 1, memory_order_release);
+}
+
+int hampod_trace_open(const char *process) {
+  Trace_ring *old = hampod_trace_ring;
+  hampod_trace_ring = NULL;
+  if (old != NULL) {
+    munmap(old, sizeof(Trace_ring)); /* The parent's, after a fork */
+  }
+
+  char path[64];
+  snprintf(path, sizeof(path), "%s/%s%s", TRACE_DIR, TRACE_FILE_PREFIX,
+           process);
+  int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    perror(path);
+    return -1;
+  }
+  if (ftruncate(fd, sizeof(Trace_ring)) != 0) {
+    perror(path);
+    close(fd);
+    return -1;
+  }
+  Trace_ring *ring = mmap(NULL, sizeof(Trace_ring), PROT_READ | PROT_WRITE,
+                          MAP_SHARED, fd, 0);
+  close(fd);
+  if (ring == MAP_FAILED) {
+    perror(path);
+    return -1;
+  }
+
+  /* The file is new and zero-filled: every record is unpublished */
+  ring->records = TRACE_RING_RECORDS;
+  ring->pid = getpid();
+  strncpy(ring->process, process, sizeof(ring->process) - 1);
+  atomic_store(&ring->head, 0);
+  atomic_thread_fence(memory_order_release);
+  ring->magic = TRACE_MAGIC; /* Last: readers skip a ring without it */
+  hampod_trace_ring = ring;
+  return 0;
+}
+
+uint32_t hampod_trace_key_begin(void) {
+  if (hampod_trace_ring == NULL) {
+    return 0;
+  }
+  uint32_t key = atomic_fetch_add(&key_last, 1) + 1;
+  if (key == 0) {
+    key = atomic_fetch_add(&key_last, 1) + 1; /* 0 means no key */
+  }
+  atomic_store(&key_pending_ns, trace_clock_ns());
+  atomic_store(&key_pending, key);
+  return key;
+}
+
+uint32_t hampod_trace_key_claim(void) {
+  if (atomic_load_explicit(&key_pending, memory_order_relaxed) == 0) {
+    return 0;
+  }
+  uint32_t key = atomic_exchange(&key_pending, 0);
+  if (key != 0 && trace_clock_ns() - atomic_load(&key_pending_ns) >
+                      (uint64_t)TRACE_KEY_CLAIM_MS * 1000000u) {
+    return 0;
+  }
+  return key;
+}
+
+#endif
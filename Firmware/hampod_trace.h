@@ -0,0 +1,165 @@
+/* Binary event trace shared by Firmware and Software2
+ *
+ * Hot paths record what happens as fixed-size binary records instead of
+ * printing it: a timestamp, an event id and up to three small arguments,
+ * written into a ring that lives in TRACE_DIR/hampod_trace.<process>. A
+ * record costs a clock read and a few stores; there is no formatting, no
+ * lock and no system call, so tracing stays on in normal builds. Built
+ * with -DHAMPOD_TRACE_OFF (make TRACE=0 in Firmware and Software2) the
+ * calls compile to nothing.
+ *
+ * Any thread may record. A writer claims a slot with one atomic increment
+ * and publishes it by storing its sequence number last, so a reader can
+ * tell a finished record from one being overwritten. The ring keeps the
+ * newest TRACE_RING_RECORDS records; older ones are overwritten.
+ *
+ * The rings are files in tmpfs, so they can be read while HAMPOD runs and
+ * after a process dies. trace_dump (`hampod trace`) reads every ring and
+ * prints the records of all processes as one timeline, ordered by
+ * CLOCK_MONOTONIC.
+ *
+ * Key to sound: the key events carry how long after the kernel's key event
+ * they were recorded, and Software2 numbers each key it dispatches
+ * (hampod_trace_key_begin()). The first speech queued for it records that
+ * number with its audio request's tag, and the audio process records the
+ * tag when it starts the request and when its first sound goes to ALSA.
+ * trace_dump -k follows each key through those hops.
+ *
+ * Like hampod_alloc, this is always its own object (hampod_trace.o).
+ */
+#ifndef HAMPOD_TRACE
+#define HAMPOD_TRACE
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#define TRACE_DIR "/dev/shm"
+#define TRACE_FILE_PREFIX "hampod_trace."
+#define TRACE_MAGIC 0x48545243 /* "HTRC" */
+#define TRACE_RING_RECORDS 4096 /* Power of two; 128 KB per process */
+#define TRACE_PROCESS_MAX 16
+#define TRACE_KEY_CLAIM_MS 2000 /* Speech later than this answers no key */
+
+/* Events: id, name and how trace_dump prints the arguments (a printf
+ * format taking up to three unsigned ints) */
+#define HAMPOD_TRACE_EVENTS(X)                                                 \
+  X(TRACE_KEY, "key", "'%c' action %u, %u us after the key")                   \
+  X(TRACE_KEY_RECEIVED, "key received", "'%c' action %u, %u us after the key") \
+  X(TRACE_KEY_DISPATCH, "key dispatch", "'%c' key %u, %u us after the key")    \
+  X(TRACE_KEY_QUEUED, "key speech queued", "key %u speech %u")                 \
+  X(TRACE_KEY_SPEECH, "key speech sent", "key %u tag %u, took %u us")          \
+  X(TRACE_AUDIO_REQUEST, "audio request", "'%c' tag %u")                       \
+  X(TRACE_AUDIO_BEGIN, "audio begin", "tag %u")                                \
+  X(TRACE_AUDIO_SOUND, "audio sound", "tag %u")                                \
+  X(TRACE_AUDIO_ACK, "audio ack", "tag %u result %d")                          \
+  X(TRACE_AUDIO_INTERRUPT, "audio interrupt", "epoch %u")                      \
+  X(TRACE_BEEP, "beep", "type %u")                                             \
+  X(TRACE_TTS_SPEAK, "tts speak", "%u bytes")                                  \
+  X(TRACE_TTS_CACHE_HIT, "tts cache hit", "%u samples")                        \
+  X(TRACE_TTS_FIRST_AUDIO, "tts first audio", "%u ms, cached %u")              \
+  X(TRACE_TTS_SYNTHESIZED, "tts synthesized", "%u samples in %u ms")           \
+  X(TRACE_TTS_CACHED, "tts cached", "%u samples")                              \
+  X(TRACE_TTS_INTERRUPTED, "tts interrupted", "")                              \
+  X(TRACE_TTS_INTERRUPT, "tts interrupt", "")                                  \
+  X(TRACE_SPEECH_SEND, "speech send", "'%c' tag %u priority %u")               \
+  X(TRACE_SPEECH_DONE, "speech done", "tag %u result %d")                      \
+  X(TRACE_SPEECH_DROPPED, "speech dropped", "priority %u")                     \
+  X(TRACE_SPEECH_CUT_OFF, "speech cut off", "priority %u")                     \
+  X(TRACE_SPEECH_CLEARED, "speech cleared", "%u queued")                       \
+  X(TRACE_SPEECH_INTERRUPT, "speech interrupt", "%u in flight")              \
+  X(TRACE_CPU_BOOST, "cpu boost",                                              \
+    "governor switched after %u us, full speed after %u us")                   \
+  X(TRACE_CPU_IDLE, "cpu idle", "after %u ms boosted")
+
+#define TRACE_EVENT_ID(id, name, format) id,
+typedef enum { HAMPOD_TRACE_EVENTS(TRACE_EVENT_ID) TRACE_EVENTS } Trace_event;
+#undef TRACE_EVENT_ID
+
+typedef struct Trace_record {
+  _Atomic uint32_t seq; /* Index in the ring + 1 once written, 0 while not */
+  uint16_t event;
+  uint16_t thread;  /* Low 16 bits of the thread id */
+  uint64_t time_ns; /* CLOCK_MONOTONIC */
+  uint32_t arg[3];
+  uint32_t unused; /* Pads the record to 32 bytes */
+} Trace_record;
+
+typedef struct Trace_ring {
+  uint32_t magic;
+  uint32_t records; /* TRACE_RING_RECORDS */
+  int32_t pid;
+  char process[TRACE_PROCESS_MAX];
+  _Atomic uint32_t head; /* Records claimed so far; wraps */
+  Trace_record ring[TRACE_RING_RECORDS];
+} Trace_ring;
+
+#ifndef HAMPOD_TRACE_OFF
+
+/* Microseconds from a key event's kernel timestamp (evdev stamps them with
+ * CLOCK_REALTIME) to now, the last argument of the key events; 0 if the
+ * event has no timestamp */
+static inline uint32_t hampod_trace_key_age_us(uint64_t timestamp_us) {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  uint64_t now_us = (uint64_t)ts.tv_sec * 1000000u + ts.tv_nsec / 1000;
+  if (timestamp_us == 0 || now_us < timestamp_us) {
+    return 0;
+  }
+  return (uint32_t)(now_us - timestamp_us);
+}
+
+/* This process's ring, NULL until hampod_trace_open() */
+extern Trace_ring *hampod_trace_ring;
+
+void hampod_trace_write(Trace_event event, uint32_t a, uint32_t b,
+                        uint32_t c);
+
+/* Record an event; does nothing before hampod_trace_open() */
+static inline void hampod_trace(Trace_event event, uint32_t a, uint32_t b,
+                                uint32_t c) {
+  if (hampod_trace_ring != NULL) {
+    hampod_trace_write(event, a, b, c);
+  }
+}
+
+/* Start (or restart) this process's ring under name. Call again in a
+ * forked child to give it a ring of its own. Returns 0, or -1 if the file
+ * cannot be made; tracing is then off. */
+int hampod_trace_open(const char *process);
+
+/* Number a key about to be dispatched, and make it the key the next speech
+ * answers. Returns the number, or 0 before hampod_trace_open(). */
+uint32_t hampod_trace_key_begin(void);
+
+/* The key the speech being queued answers, or 0: the last key begun, once,
+ * if it was begun less than TRACE_KEY_CLAIM_MS ago */
+uint32_t hampod_trace_key_claim(void);
+
+#else
+
+static inline void hampod_trace(Trace_event event, uint32_t a, uint32_t b,
+                                uint32_t c) {
+  (void)event;
+  (void)a;
+  (void)b;
+  (void)c;
+}
+
+static inline int hampod_trace_open(const char *process) {
+  (void)process;
+  return 0;
+}
+
+static inline uint32_t hampod_trace_key_begin(void) { return 0; }
+
+static inline uint32_t hampod_trace_key_claim(void) { return 0; }
+
+static inline uint32_t hampod_trace_key_age_us(uint64_t timestamp_us) {
+  (void)timestamp_us;
+  return 0;
+}
+
+#endif
+#endif
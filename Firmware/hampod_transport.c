@@ -0,0 +1,90 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "hampod_transport.h"
+
+static int transport_fill_addr(struct sockaddr_un *addr, const char *path) {
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr->sun_path)) {
+    return -1;
+  }
+  strcpy(addr->sun_path, path);
+  return 0;
+}
+
+int transport_listen_seqpacket(const char *path) {
+  struct sockaddr_un addr;
+  if (transport_fill_addr(&addr, path) != 0) {
+    return -1;
+  }
+
+  int fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+  if (fd == -1) {
+    perror("socket");
+    return -1;
+  }
+
+  unlink(path); /* Remove stale socket if exists */
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+      listen(fd, 4) == -1) { /* SESSION_MAX clients (hampod_session.h) */
+    perror("bind/listen");
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int transport_accept(int listen_fd, Transport *transport) {
+  int fd;
+  do {
+    fd = accept(listen_fd, NULL, NULL);
+  } while (fd == -1 && errno == EINTR);
+
+  if (fd == -1) {
+    perror("accept");
+    return -1;
+  }
+
+  transport->kind = TRANSPORT_SEQPACKET;
+  transport->rx_fd = fd;
+  transport->tx_fd = fd;
+  return 0;
+}
+
+int transport_connect_seqpacket(const char *path, Transport *transport) {
+  struct sockaddr_un addr;
+  if (transport_fill_addr(&addr, path) != 0) {
+    return -1;
+  }
+
+  int fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+  if (fd == -1) {
+    return -1;
+  }
+
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+    close(fd);
+    return -1;
+  }
+
+  transport->kind = TRANSPORT_SEQPACKET;
+  transport->rx_fd = fd;
+  transport->tx_fd = fd;
+  return 0;
+}
+
+void transport_close(Transport *transport) {
+  if (transport->rx_fd != -1) {
+    close(transport->rx_fd);
+  }
+  if (transport->tx_fd != -1 && transport->tx_fd != transport->rx_fd) {
+    close(transport->tx_fd);
+  }
+  transport->rx_fd = -1;
+  transport->tx_fd = -1;
+}
@@ -0,0 +1,49 @@
+/* Transport selection for the Software <-> Firmware link
+ *
+ * Two backends carry the same hampod_frame.h frames:
+ *   - TRANSPORT_FIFO: the original Firmware_i / Firmware_o named pipes,
+ *     one fd per direction.
+ *   - TRANSPORT_SEQPACKET: a Unix domain SOCK_SEQPACKET socket. One fd
+ *     carries both directions, every frame is one record, and a dead peer
+ *     shows up as EOF immediately so the Firmware can accept a new client.
+ *
+ * The FIFO backend is still opened by the callers (startup order matters
+ * there); this module provides the socket side and a common close.
+ */
+#ifndef HAMPOD_TRANSPORT
+#define HAMPOD_TRANSPORT
+
+/* Relative to the Firmware directory, like the FIFOs */
+#define TRANSPORT_SOCKET_NAME "hampod.sock"
+
+/* With --direct the keypad and audio processes also listen on their own
+ * sockets, so Software can talk to each without the controller's relay */
+#define TRANSPORT_KEYPAD_SOCKET_NAME "hampod_keypad.sock"
+#define TRANSPORT_AUDIO_SOCKET_NAME "hampod_audio.sock"
+
+typedef enum { TRANSPORT_FIFO, TRANSPORT_SEQPACKET } Transport_kind;
+
+typedef struct Transport {
+  Transport_kind kind;
+  int rx_fd; /* Read frames from here */
+  int tx_fd; /* Write frames here (same fd as rx_fd for sockets) */
+} Transport;
+
+/* Create a listening SOCK_SEQPACKET socket at path (any stale socket file is
+ * removed first). Returns the listening fd, or -1 on error. */
+int transport_listen_seqpacket(const char *path);
+
+/* Block until a client connects. Returns 0 on success, -1 on error. */
+int transport_accept(int listen_fd, Transport *transport);
+
+/* Connect to a listening Firmware socket. Returns 0 on success, -1 if no
+ * Firmware is listening at path. */
+int transport_connect_seqpacket(const char *path, Transport *transport);
+
+/* Close both directions (once, if they share an fd) and mark closed. */
+void transport_close(Transport *transport);
+
+#ifndef SHAREDLIB
+#include "hampod_transport.c"
+#endif
+#endif
@@ -7,6 +7,7 @@
 #include <string.h>
 
 #include "hampod_firm_packet.h"
+#include "hampod_frame.h"
 
 #define INPUT_PIPE "Firmware_i"
 #define OUTPUT_PIPE "Firmware_o"
@@ -46,52 +47,22 @@ int index_getter(char keypad_input){
 }
 int input_pipe;
 int output_pipe;
+Frame_reader input_reader;
 void send_packet(Inst_packet* packet){
     printf("Message = %s\n", packet->data);
-    
-    // Serialize header explicitly to match Firmware reader
-    write(output_pipe, &packet->type, sizeof(Packet_type));
-    write(output_pipe, &packet->data_len, sizeof(unsigned short));
-    write(output_pipe, &packet->tag, sizeof(unsigned short));
-
-    unsigned char buffer[256];
-    memcpy(buffer, packet->data, packet->data_len);
-    printf("Message = %s\n", (char*)buffer);
-    write(output_pipe, buffer, packet->data_len);
+    frame_write(output_pipe, packet->type, packet->tag, packet->data, packet->data_len);
 }
 
 Inst_packet* read_from_pipe(){
-    unsigned char buffer[256];
-    Packet_type type;
-    unsigned short size;
-    unsigned short tag;
-    ssize_t bytes_read;
-    
-    bytes_read = read(input_pipe, &type, sizeof(Packet_type));
-    if (bytes_read <= 0) {
-        printf("ERROR: Pipe closed or read error (type)\n");
-        return NULL;
-    }
-    
-    bytes_read = read(input_pipe, &size, sizeof(unsigned short));
-    if (bytes_read <= 0) {
-        printf("ERROR: Pipe closed or read error (size)\n");
-        return NULL;
-    }
-    
-    bytes_read = read(input_pipe, &tag, sizeof(unsigned short));
-    if (bytes_read <= 0) {
-        printf("ERROR: Pipe closed or read error (tag)\n");
-        return NULL;
-    }
-    
-    bytes_read = read(input_pipe, buffer, size);
-    if (bytes_read <= 0) {
-        printf("ERROR: Pipe closed or read error (data)\n");
+    unsigned char buffer[FRAME_MAX_DATA];
+    Frame_header header;
+
+    if (frame_read(&input_reader, &header, buffer, sizeof(buffer)) != 0) {
+        printf("ERROR: Pipe closed or read error\n");
         return NULL;
     }
-    
-    Inst_packet* temp = create_inst_packet(type, size, buffer, tag);
+
+    Inst_packet* temp = create_inst_packet(header.type, header.data_len, buffer, header.tag);
     return temp;
 }
 
@@ -104,6 +75,7 @@ int main(){
         perror("open");
         exit(-1);
     }
+    frame_reader_init(&input_reader, input_pipe);
     printf("Attempting to connect to Firmware_i\n");
     // output_pipe; // Statement with no effect
     for(int i = 0; i < 1000; i++){
@@ -0,0 +1,591 @@
+/* IPC benchmark for the Software <-> Firmware link
+ *
+ * imitation_software drives the Firmware by hand; this drives it as hard
+ * as asked and measures it, so the transports (FIFO pair, --socket,
+ * --direct, --shm-audio) and changes to the queues can be compared on the
+ * same board. Run it from the Firmware directory against a running
+ * firmware.elf, in place of Software2.
+ *
+ * One sender thread per request kind paces requests at a rate, keeping at
+ * most a given number in flight:
+ *   keypad     KEYPAD "r" poll, answered with one byte
+ *   beep       AUDIO "bk", mixed in by the audio process's bypass
+ *   interrupt  AUDIO "i" with the next speech epoch
+ *   tts        AUDIO "d<text>" in the current epoch (over the shared-memory
+ *              ring with --shm), acked with the stage times
+ * A rate of 0 sends as fast as the in-flight limit allows.
+ *
+ * For each kind it reports packets/s answered, round trip percentiles,
+ * requests in flight (the queue depth the Firmware is holding for it),
+ * and losses: sends that failed, requests never answered, and speech
+ * refused because an interrupt overtook it. The speech acks also give
+ * the time to reach the audio process and the wait in its queue.
+ *
+ * Usage: ./ipc_benchmark [--socket] [--direct] [--shm] [--seconds N]
+ *                        [--keypad R[/C]] [--beep R[/C]]
+ *                        [--interrupt R[/C]] [--tts R[/C]]
+ *                        [--csv FILE] [--label NAME]
+ * R is requests per second and C the in-flight limit. --csv appends one
+ * row per kind, so runs with different settings collect in one file.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "audio_firmware.h"
+#include "hampod_firm_packet.h"
+#include "hampod_frame.h"
+#include "hampod_shm_ring.h"
+#include "hampod_transport.h"
+#include "keypad_firmware.h"
+
+#define INPUT_PIPE "Firmware_i"
+#define OUTPUT_PIPE "Firmware_o"
+
+#define BENCH_GRACE_MS 3000   /* Wait for answers after the last send */
+#define BENCH_SAMPLE_MS 10    /* Queue depth sampling period */
+#define BENCH_TAGS 0x10000
+
+typedef enum {
+  LOAD_KEYPAD,
+  LOAD_BEEP,
+  LOAD_INTERRUPT,
+  LOAD_TTS,
+  LOAD_KINDS
+} Load_kind;
+
+static const char *const load_names[LOAD_KINDS] = {"keypad", "beep",
+                                                   "interrupt", "tts"};
+
+/* Spoken in turn, short enough to keep the audio process busy without
+ * hiding the link behind synthesis */
+static const char *const tts_texts[] = {"14.250 megahertz", "Volume 5",
+                                        "Upper sideband", "Scan stopped"};
+#define TTS_TEXT_COUNT (int)(sizeof(tts_texts) / sizeof(tts_texts[0]))
+
+typedef struct Sample_list {
+  unsigned int *us;
+  int count;
+  int capacity;
+} Sample_list;
+
+typedef struct Load {
+  double rate;     /* Requests per second, 0 for as fast as allowed */
+  int concurrency; /* Most requests in flight */
+  int in_flight;
+  unsigned long sent;
+  unsigned long answered;
+  unsigned long send_failed;
+  unsigned long refused; /* Speech acked -1 before it started */
+  unsigned long depth_sum;
+  int depth_max;
+  Sample_list round_trip;
+  Sample_list transit;    /* tts: send to the audio process receiving it */
+  Sample_list queue_wait; /* tts: received to synthesis starting */
+  pthread_t thread;
+} Load;
+
+typedef struct Pending {
+  unsigned char in_use;
+  unsigned char kind;
+  unsigned int sent_us;
+} Pending;
+
+static Load loads[LOAD_KINDS] = {
+    {.rate = 100, .concurrency = 1},
+    {.rate = 20, .concurrency = 1},
+    {.rate = 2, .concurrency = 1},
+    {.rate = 5, .concurrency = 4},
+};
+
+/* Everything below is guarded by bench_lock */
+static Pending pending[BENCH_TAGS];
+static unsigned short next_tag = 1;
+static unsigned char epoch = 1;
+static unsigned long unmatched = 0;
+static int sending = 1;
+static int measuring = 1;
+static pthread_mutex_t bench_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t bench_changed = PTHREAD_COND_INITIALIZER;
+
+/* Links: the main one, and the direct keypad and audio channels */
+static Transport main_link = {TRANSPORT_FIFO, -1, -1};
+static Transport keypad_link = {TRANSPORT_SEQPACKET, -1, -1};
+static Transport audio_link = {TRANSPORT_SEQPACKET, -1, -1};
+static Shm_audio_ring *audio_ring = NULL;
+
+static void sample_add(Sample_list *list, unsigned int us) {
+  if (list->count == list->capacity) {
+    int capacity = list->capacity ? list->capacity * 2 : 1024;
+    unsigned int *grown = realloc(list->us, capacity * sizeof(unsigned int));
+    if (grown == NULL) {
+      return;
+    }
+    list->us = grown;
+    list->capacity = capacity;
+  }
+  list->us[list->count++] = us;
+}
+
+static int compare_uint(const void *a, const void *b) {
+  unsigned int x = *(const unsigned int *)a;
+  unsigned int y = *(const unsigned int *)b;
+  return (x > y) - (x < y);
+}
+
+static void sample_sort(Sample_list *list) {
+  qsort(list->us, list->count, sizeof(unsigned int), compare_uint);
+}
+
+/* Nearest-rank percentile in ms of a sorted list */
+static double percentile_ms(const Sample_list *list, int p) {
+  if (list->count == 0) {
+    return 0;
+  }
+  int rank = (p * list->count + 99) / 100;
+  if (rank < 1) {
+    rank = 1;
+  }
+  return list->us[rank - 1] / 1000.0;
+}
+
+/* Take a free tag and record the send. Call with bench_lock held. */
+static unsigned short claim_tag(Load_kind kind) {
+  while (next_tag == KEYPAD_PUSH_TAG || next_tag == 0 ||
+         pending[next_tag].in_use) {
+    next_tag++;
+  }
+  unsigned short tag = next_tag++;
+  pending[tag].in_use = 1;
+  pending[tag].kind = kind;
+  pending[tag].sent_us = frame_clock_us();
+  return tag;
+}
+
+static void release_tag(unsigned short tag) {
+  pending[tag].in_use = 0;
+  loads[pending[tag].kind].in_flight--;
+  pthread_cond_broadcast(&bench_changed);
+}
+
+static int send_request(Load_kind kind) {
+  pthread_mutex_lock(&bench_lock);
+  unsigned short tag = claim_tag(kind);
+  unsigned char request_epoch = epoch;
+  if (kind == LOAD_INTERRUPT) {
+    epoch = epoch % FRAME_EPOCH_MAX + 1;
+    request_epoch = epoch;
+  }
+  loads[kind].in_flight++;
+  loads[kind].sent++;
+  pthread_mutex_unlock(&bench_lock);
+
+  int result;
+  int audio_fd = audio_link.tx_fd != -1 ? audio_link.tx_fd : main_link.tx_fd;
+  char request[64];
+  switch (kind) {
+  case LOAD_KEYPAD: {
+    int fd = keypad_link.tx_fd != -1 ? keypad_link.tx_fd : main_link.tx_fd;
+    result = frame_write(fd, KEYPAD, tag, "r", 1);
+    break;
+  }
+  case LOAD_BEEP:
+    result = frame_write(audio_fd, AUDIO, tag, "bk", 3);
+    break;
+  case LOAD_INTERRUPT:
+    result = frame_write_flags(audio_fd, AUDIO,
+                               FRAME_FLAGS_EPOCH(request_epoch), tag, "i", 2);
+    break;
+  default: {
+    const char *text = tts_texts[tag % TTS_TEXT_COUNT];
+    if (audio_ring != NULL) {
+      result = shm_ring_push(audio_ring, 'd', tag, request_epoch, text);
+      break;
+    }
+    int len = snprintf(request, sizeof(request), "d%s", text);
+    result = frame_write_flags(audio_fd, AUDIO,
+                               FRAME_FLAGS_EPOCH(request_epoch), tag,
+                               request, (unsigned short)(len + 1));
+    break;
+  }
+  }
+
+  if (result != 0) {
+    pthread_mutex_lock(&bench_lock);
+    loads[kind].send_failed++;
+    release_tag(tag);
+    pthread_mutex_unlock(&bench_lock);
+  }
+  return result;
+}
+
+static void add_us(struct timespec *ts, long us) {
+  ts->tv_nsec += (us % 1000000) * 1000;
+  ts->tv_sec += us / 1000000 + ts->tv_nsec / 1000000000;
+  ts->tv_nsec %= 1000000000;
+}
+
+/* Send one kind at its rate, never more than its limit in flight */
+static void *sender_thread(void *arg) {
+  Load_kind kind = (Load_kind)(long)arg;
+  Load *load = &loads[kind];
+  long period_us = load->rate > 0 ? (long)(1000000 / load->rate) : 0;
+  struct timespec due;
+  clock_gettime(CLOCK_MONOTONIC, &due);
+
+  for (;;) {
+    pthread_mutex_lock(&bench_lock);
+    while (sending && load->in_flight >= load->concurrency) {
+      pthread_cond_wait(&bench_changed, &bench_lock);
+    }
+    int stop = !sending;
+    pthread_mutex_unlock(&bench_lock);
+    if (stop) {
+      break;
+    }
+
+    send_request(kind);
+    if (period_us > 0) {
+      /* Behind schedule (held back by the limit) sends at once, but does
+       * not try to make up the requests it missed */
+      add_us(&due, period_us);
+      struct timespec now;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      if (now.tv_sec > due.tv_sec ||
+          (now.tv_sec == due.tv_sec && now.tv_nsec > due.tv_nsec)) {
+        due = now;
+      } else {
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL);
+      }
+    }
+  }
+  return NULL;
+}
+
+static void handle_reply(const Frame_header *header,
+                         const unsigned char *data) {
+  if (header->tag == KEYPAD_PUSH_TAG) {
+    return;
+  }
+  unsigned int now = frame_clock_us();
+
+  pthread_mutex_lock(&bench_lock);
+  Pending *request = &pending[header->tag];
+  if (!request->in_use) {
+    unmatched += measuring;
+    pthread_mutex_unlock(&bench_lock);
+    return;
+  }
+  Load *load = &loads[request->kind];
+  if (measuring) {
+    load->answered++;
+    sample_add(&load->round_trip, now - request->sent_us);
+    if (request->kind == LOAD_TTS &&
+        header->data_len >= AUDIO_ACK_REPLY_INTS * sizeof(int)) {
+      int ack[AUDIO_ACK_REPLY_INTS];
+      memcpy(ack, data, sizeof(ack));
+      unsigned int received_us = (unsigned int)ack[1];
+      unsigned int speak_us = (unsigned int)ack[2];
+      sample_add(&load->transit, received_us - request->sent_us);
+      if (speak_us != 0) {
+        sample_add(&load->queue_wait, speak_us - received_us);
+      } else if (ack[0] == -1) {
+        load->refused++;
+      }
+    }
+  }
+  release_tag(header->tag);
+  pthread_mutex_unlock(&bench_lock);
+}
+
+static void *reader_thread(void *arg) {
+  Transport *link = arg;
+  Frame_reader reader;
+  unsigned char data[FRAME_MAX_DATA];
+  Frame_header header;
+
+  frame_reader_init(&reader, link->rx_fd);
+  while (frame_read(&reader, &header, data, sizeof(data)) == 0) {
+    handle_reply(&header, data);
+  }
+  return NULL;
+}
+
+/* Open the link and wait for the Firmware's ready packet */
+static int connect_firmware(int use_socket) {
+  if (use_socket) {
+    if (transport_connect_seqpacket(TRANSPORT_SOCKET_NAME, &main_link) != 0) {
+      printf("No Firmware socket; start it with --socket\n");
+      return -1;
+    }
+  } else {
+    main_link.rx_fd = open(OUTPUT_PIPE, O_RDONLY);
+    for (int i = 0; main_link.rx_fd != -1 && i < 100; i++) {
+      main_link.tx_fd = open(INPUT_PIPE, O_WRONLY);
+      if (main_link.tx_fd != -1) {
+        break;
+      }
+      usleep(10000);
+    }
+    if (main_link.rx_fd == -1 || main_link.tx_fd == -1) {
+      perror("open");
+      return -1;
+    }
+  }
+
+  Frame_reader reader;
+  unsigned char data[FRAME_MAX_DATA];
+  Frame_header header;
+  frame_reader_init(&reader, main_link.rx_fd);
+  do {
+    if (frame_read(&reader, &header, data, sizeof(data)) != 0) {
+      printf("Firmware closed the link before it was ready\n");
+      return -1;
+    }
+  } while (header.type != CONFIG || header.data_len == 0 || data[0] != 'R');
+  return 0;
+}
+
+/* "R" or "R/C" */
+static int parse_load(const char *text, Load *load) {
+  char *end;
+  load->rate = strtod(text, &end);
+  if (*end == '/') {
+    load->concurrency = atoi(end + 1);
+  } else if (*end != '\0') {
+    return -1;
+  }
+  return load->rate < 0 || load->concurrency < 0 ? -1 : 0;
+}
+
+static void print_usage(const char *program) {
+  printf("Usage: %s [--socket] [--direct] [--shm] [--seconds N]\n"
+         "          [--keypad R[/C]] [--beep R[/C]] [--interrupt R[/C]]\n"
+         "          [--tts R[/C]] [--csv FILE] [--label NAME]\n"
+         "R is requests per second (0: as fast as C allows), C the most\n"
+         "in flight; C of 0 turns the kind off. Defaults: keypad 100/1,\n"
+         "beep 20/1, interrupt 2/1, tts 5/4, 10 seconds.\n",
+         program);
+}
+
+static void write_csv(const char *path, const char *label, double seconds,
+                      long samples) {
+  struct stat st;
+  int fresh = stat(path, &st) != 0 || st.st_size == 0;
+  FILE *f = fopen(path, "a");
+  if (f == NULL) {
+    perror(path);
+    return;
+  }
+  if (fresh) {
+    fprintf(f, "label,kind,rate,concurrency,sent,answered,send_failed,lost,"
+               "refused,per_s,rtt_p50_ms,rtt_p90_ms,rtt_p99_ms,rtt_max_ms,"
+               "depth_mean,depth_max\n");
+  }
+  for (int kind = 0; kind < LOAD_KINDS; kind++) {
+    Load *load = &loads[kind];
+    if (load->concurrency == 0) {
+      continue;
+    }
+    unsigned long lost = load->sent - load->answered - load->send_failed;
+    double depth = load->depth_sum / (double)samples;
+    fprintf(f, "%s,%s,%.1f,%d,%lu,%lu,%lu,%lu,%lu,%.1f,%.3f,%.3f,%.3f,"
+               "%.3f,%.2f,%d\n",
+            label, load_names[kind], load->rate, load->concurrency,
+            load->sent, load->answered, load->send_failed, lost,
+            load->refused, load->answered / seconds,
+            percentile_ms(&load->round_trip, 50),
+            percentile_ms(&load->round_trip, 90),
+            percentile_ms(&load->round_trip, 99),
+            percentile_ms(&load->round_trip, 100), depth, load->depth_max);
+  }
+  fclose(f);
+}
+
+int main(int argc, char *argv[]) {
+  int use_socket = 0;
+  int use_direct = 0;
+  int use_shm = 0;
+  double seconds = 10;
+  const char *csv_path = NULL;
+  const char *label = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    int kind = -1;
+    for (int k = 0; k < LOAD_KINDS; k++) {
+      if (strncmp(argv[i], "--", 2) == 0 &&
+          strcmp(argv[i] + 2, load_names[k]) == 0) {
+        kind = k;
+      }
+    }
+    if (strcmp(argv[i], "--socket") == 0) {
+      use_socket = 1;
+    } else if (strcmp(argv[i], "--direct") == 0) {
+      use_direct = 1;
+    } else if (strcmp(argv[i], "--shm") == 0) {
+      use_shm = 1;
+    } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+      seconds = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc) {
+      csv_path = argv[++i];
+    } else if (strcmp(argv[i], "--label") == 0 && i + 1 < argc) {
+      label = argv[++i];
+    } else if (kind >= 0 && i + 1 < argc &&
+               parse_load(argv[++i], &loads[kind]) == 0) {
+      continue;
+    } else {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+  if (seconds <= 0) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  char default_label[64];
+  snprintf(default_label, sizeof(default_label), "%s%s%s",
+           use_socket ? "socket" : "fifo", use_direct ? "+direct" : "",
+           use_shm ? "+shm" : "");
+  if (label == NULL) {
+    label = default_label;
+  }
+
+  signal(SIGPIPE, SIG_IGN); /* A dead Firmware shows up as failed sends */
+  printf("Hampod IPC benchmark (%s), connecting to the Firmware\n", label);
+  if (connect_firmware(use_socket) != 0) {
+    return 1;
+  }
+  if (use_direct) {
+    if (transport_connect_seqpacket(TRANSPORT_KEYPAD_SOCKET_NAME,
+                                    &keypad_link) != 0 ||
+        transport_connect_seqpacket(TRANSPORT_AUDIO_SOCKET_NAME,
+                                    &audio_link) != 0) {
+      printf("No direct channels; start the Firmware with --direct\n");
+      return 1;
+    }
+  }
+  if (use_shm) {
+    audio_ring = shm_ring_attach(SHM_RING_NAME);
+    if (audio_ring == NULL) {
+      printf("No audio ring; start the Firmware with --shm-audio\n");
+      return 1;
+    }
+  }
+
+  pthread_t reader;
+  Transport *links[] = {&main_link, &keypad_link, &audio_link};
+  for (int i = 0; i < 3; i++) {
+    if (links[i]->rx_fd != -1) {
+      pthread_create(&reader, NULL, reader_thread, links[i]);
+      pthread_detach(reader);
+    }
+  }
+
+  printf("Running for %.0f s\n", seconds);
+  for (int kind = 0; kind < LOAD_KINDS; kind++) {
+    if (loads[kind].concurrency > 0) {
+      pthread_create(&loads[kind].thread, NULL, sender_thread,
+                     (void *)(long)kind);
+    }
+  }
+
+  /* Sample the depth of every kind until the time is up */
+  long samples = (long)(seconds * 1000 / BENCH_SAMPLE_MS);
+  struct timespec tick;
+  clock_gettime(CLOCK_MONOTONIC, &tick);
+  for (long n = 0; n < samples; n++) {
+    add_us(&tick, BENCH_SAMPLE_MS * 1000);
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &tick, NULL);
+    pthread_mutex_lock(&bench_lock);
+    for (int kind = 0; kind < LOAD_KINDS; kind++) {
+      Load *load = &loads[kind];
+      load->depth_sum += load->in_flight;
+      if (load->in_flight > load->depth_max) {
+        load->depth_max = load->in_flight;
+      }
+    }
+    pthread_mutex_unlock(&bench_lock);
+  }
+
+  pthread_mutex_lock(&bench_lock);
+  sending = 0;
+  pthread_cond_broadcast(&bench_changed);
+  pthread_mutex_unlock(&bench_lock);
+  for (int kind = 0; kind < LOAD_KINDS; kind++) {
+    if (loads[kind].concurrency > 0) {
+      pthread_join(loads[kind].thread, NULL);
+    }
+  }
+
+  /* What is still unanswered after the grace period was lost */
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  add_us(&deadline, BENCH_GRACE_MS * 1000L);
+  pthread_mutex_lock(&bench_lock);
+  for (;;) {
+    int outstanding = 0;
+    for (int kind = 0; kind < LOAD_KINDS; kind++) {
+      outstanding += loads[kind].in_flight;
+    }
+    if (outstanding == 0 ||
+        pthread_cond_timedwait(&bench_changed, &bench_lock, &deadline) ==
+            ETIMEDOUT) {
+      break;
+    }
+  }
+  measuring = 0;
+  pthread_mutex_unlock(&bench_lock);
+  for (int kind = 0; kind < LOAD_KINDS; kind++) {
+    sample_sort(&loads[kind].round_trip);
+    sample_sort(&loads[kind].transit);
+    sample_sort(&loads[kind].queue_wait);
+  }
+
+  unsigned long answered = 0;
+  printf("\n%-9s %7s %7s %6s %5s %7s %8s %8s %8s %8s %6s %5s\n", "Kind",
+         "Sent", "Answer", "Failed", "Lost", "Pkt/s", "p50 ms", "p90 ms",
+         "p99 ms", "max ms", "Depth", "Max");
+  for (int kind = 0; kind < LOAD_KINDS; kind++) {
+    Load *load = &loads[kind];
+    if (load->concurrency == 0) {
+      continue;
+    }
+    answered += load->answered;
+    printf("%-9s %7lu %7lu %6lu %5lu %7.1f %8.3f %8.3f %8.3f %8.3f %6.2f "
+           "%5d\n",
+           load_names[kind], load->sent, load->answered, load->send_failed,
+           load->sent - load->answered - load->send_failed,
+           load->answered / seconds, percentile_ms(&load->round_trip, 50),
+           percentile_ms(&load->round_trip, 90),
+           percentile_ms(&load->round_trip, 99),
+           percentile_ms(&load->round_trip, 100),
+           load->depth_sum / (double)samples, load->depth_max);
+  }
+  printf("Total %.1f packets/s answered, %lu replies matched no request\n",
+         answered / seconds, unmatched);
+
+  Load *tts = &loads[LOAD_TTS];
+  if (tts->transit.count > 0) {
+    printf("tts: to the audio process p50 %.3f ms, p99 %.3f ms; queued "
+           "p50 %.3f ms, p99 %.3f ms; %lu refused after an interrupt\n",
+           percentile_ms(&tts->transit, 50), percentile_ms(&tts->transit, 99),
+           percentile_ms(&tts->queue_wait, 50),
+           percentile_ms(&tts->queue_wait, 99), tts->refused);
+  }
+  if (csv_path != NULL) {
+    write_csv(csv_path, label, seconds, samples);
+    printf("Appended to %s\n", csv_path);
+  }
+
+  shm_ring_detach(audio_ring);
+  return 0;
+}
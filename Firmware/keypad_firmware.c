@@ -10,39 +10,334 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "hal/hal_keypad.h"
+#include "hal/hal_remote.h"
+#include "hal/hal_voice.h"
+#include "hampod_alloc.h"
+#include "hampod_boot.h"
+#include "hampod_channel.h"
+#include "hampod_cpufreq.h"
+#include "hampod_metrics.h"
 #include "hampod_firm_packet.h"
 #include "hampod_queue.h"
+#include "hampod_sched.h"
+#include "hampod_trace.h"
 #include "keypad_firmware.h"
 
 extern pid_t controller_pid;
+extern int direct_channels; /* --direct */
+extern int local_beep_fds[2];
+#ifdef HAMPOD_THREADED
+extern int keypad_channel_fds[2]; /* Keypad_i/o, make THREADED=1 */
+#endif
+extern Sched_profile sched_profile; /* [scheduling] options */
 
 unsigned char keypad_running = 1;
+unsigned char keypad_subscribed = 0;
+static unsigned char local_key_beep = 0; /* CONFIG_LOCAL_KEY_BEEP */
 
 pthread_mutex_t keypad_queue_lock;
-pthread_mutex_t keypad_queue_available;
+
+/* Every key event captured while nobody is subscribed, oldest first.
+ * Only the main loop touches it. Software drains it with 'e' (or 'r'). */
+static KeypadEvent keypad_ring[KEYPAD_RING_SIZE];
+static int keypad_ring_head = 0;
+static int keypad_ring_count = 0;
+
+/* Pushes the subscriber still has room for (KEYPAD_CREDIT), or -1 if it
+ * asked for no flow control. At 0 events wait in the ring until more
+ * credits come. Only the main loop touches it. */
+static int keypad_credits = -1;
+
+/* Credits granted (KEYPAD_CREDIT), for the main loop to add. Taken on the
+ * IO thread, so a full request queue never loses any. */
+static int credits_pending = 0;
+static pthread_mutex_t credits_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Software's direct channel (--direct), -1 while nobody is connected.
+ * keypad_push_direct: the subscription came in on it, so pushes go there. */
+static int keypad_direct_listen_fd = -1;
+static volatile int keypad_direct_fd = -1;
+static volatile unsigned char keypad_push_direct = 0;
+
+/* Commands the voice recognizer heard, for the main loop to deliver */
+#define VOICE_PENDING_MAX 8
+static VoiceCommand voice_pending[VOICE_PENDING_MAX];
+static int voice_pending_count = 0;
+static pthread_mutex_t voice_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Key events of the remote station, for the main loop to deliver */
+#define REMOTE_PENDING_MAX 16
+static KeypadEvent remote_pending[REMOTE_PENDING_MAX];
+static int remote_pending_count = 0;
+static pthread_mutex_t remote_lock = PTHREAD_MUTEX_INITIALIZER;
 
 void *keypad_io_thread(void *arg);
+static void keypad_io_loop(int i_pipe, Packet_queue *queue,
+                           unsigned short origin);
+
+/* Serve one direct Software connection at a time on the keypad socket */
+static void *keypad_direct_thread(void *arg) {
+  Packet_queue *queue = (Packet_queue *)arg;
+  while (keypad_running) {
+    Transport link;
+    if (transport_accept(keypad_direct_listen_fd, &link) != 0) {
+      break;
+    }
+    KEYPAD_IO_PRINTF("Direct channel connected\n");
+    keypad_direct_fd = link.tx_fd;
+    keypad_io_loop(link.rx_fd, queue, PACKET_FLAG_DIRECT);
+    keypad_direct_fd = -1;
+    if (keypad_push_direct) {
+      keypad_subscribed = 0; /* Subscriber is gone */
+      keypad_push_direct = 0;
+      hal_keypad_set_hold_threshold(0);
+      hal_keypad_wake();
+    }
+    transport_close(&link);
+    KEYPAD_IO_PRINTF("Direct channel closed\n");
+  }
+  return NULL;
+}
+
+/* Append to the ring, dropping the oldest event if it is full */
+static void keypad_ring_push(KeypadEvent event) {
+  if (keypad_ring_count == KEYPAD_RING_SIZE) {
+    KEYPAD_PRINTF("Event ring full, dropping oldest event\n");
+    hampod_metric_add(METRIC_KEYPAD_EVENT_DROPS, 1);
+    keypad_ring_head = (keypad_ring_head + 1) % KEYPAD_RING_SIZE;
+    keypad_ring_count--;
+  }
+  keypad_ring[(keypad_ring_head + keypad_ring_count) % KEYPAD_RING_SIZE] =
+      event;
+  keypad_ring_count++;
+}
+
+/* Pop the oldest event. Returns 0 if the ring was empty. */
+static int keypad_ring_pop(KeypadEvent *event) {
+  if (keypad_ring_count == 0) {
+    return 0;
+  }
+  *event = keypad_ring[keypad_ring_head];
+  keypad_ring_head = (keypad_ring_head + 1) % KEYPAD_RING_SIZE;
+  keypad_ring_count--;
+  return 1;
+}
+
+/* Have the audio process beep for a key-down, without Software */
+static void keypad_local_beep(void) {
+  /* Never block on (or get SIGPIPE from) a stalled audio process */
+  char kind = 'k';
+  if (local_beep_fds[1] != -1 &&
+      send(local_beep_fds[1], &kind, 1, MSG_DONTWAIT | MSG_NOSIGNAL) != 1) {
+    KEYPAD_PRINTF("Local beep not delivered, skipped\n");
+  }
+}
+
+/* One KEYPAD_EVENT_LEN byte record, see keypad_firmware.h */
+static void keypad_encode_event(unsigned char *out, KeypadEvent event) {
+  out[0] = (unsigned char)event.key;
+  out[1] = event.action;
+  memcpy(&out[2], &event.timestamp_us, sizeof(event.timestamp_us));
+}
+
+/* Push one HAL event to Software (subscription mode) */
+static void keypad_push_event(int output_pipe_fd, KeypadEvent event) {
+  unsigned char payload[KEYPAD_PUSH_LEN];
+  keypad_encode_event(payload, event);
+
+  KEYPAD_PRINTF("Pushing key '%c' action %d\n", event.key, event.action);
+  frame_write(output_pipe_fd, KEYPAD, KEYPAD_PUSH_TAG, payload,
+              KEYPAD_PUSH_LEN);
+}
+
+/* Answer 'e': as many ring events as fit in one reply, oldest first */
+static void keypad_send_ring(int reply_fd, unsigned short tag) {
+  unsigned char reply[1 + KEYPAD_DRAIN_MAX * KEYPAD_EVENT_LEN];
+  unsigned short len = 0;
+  reply[len++] = KEYPAD_DRAIN_ACK;
+
+  KeypadEvent event;
+  for (int n = 0; n < KEYPAD_DRAIN_MAX && keypad_ring_pop(&event); n++) {
+    keypad_encode_event(&reply[len], event);
+    len += KEYPAD_EVENT_LEN;
+  }
+
+  KEYPAD_PRINTF("Sending %d ring events\n", (len - 1) / KEYPAD_EVENT_LEN);
+  frame_write(reply_fd, KEYPAD, tag, reply, len);
+}
+
+/* Push events held in the ring while the subscriber had no credits, as
+ * far as its credits now go */
+static void keypad_push_held(int output_pipe_fd) {
+  int push_fd = keypad_push_direct ? keypad_direct_fd : output_pipe_fd;
+  KeypadEvent event;
+  while (keypad_subscribed && push_fd != -1 && keypad_credits != 0 &&
+         keypad_ring_pop(&event)) {
+    keypad_push_event(push_fd, event);
+    if (keypad_credits > 0) {
+      keypad_credits--;
+    }
+  }
+}
+
+/* Add the credits the IO thread took and push what they let through */
+static void keypad_take_credits(int output_pipe_fd) {
+  pthread_mutex_lock(&credits_lock);
+  int granted = credits_pending;
+  credits_pending = 0;
+  pthread_mutex_unlock(&credits_lock);
+  if (granted > 0 && keypad_credits >= 0) {
+    keypad_credits += granted;
+    keypad_push_held(output_pipe_fd);
+  }
+}
+
+/* A key event from the HAL, voice or the remote station: pushed to the
+ * subscriber, or kept in the ring (also while the subscriber is out of
+ * credits, behind any events already held there) */
+static void keypad_deliver(int output_pipe_fd, KeypadEvent event) {
+  cpufreq_boost();
+  hampod_trace(TRACE_KEY, (unsigned char)event.key, event.action,
+               hampod_trace_key_age_us(event.timestamp_us));
+  if (local_key_beep && event.action == KEYPAD_ACTION_PRESS) {
+    keypad_local_beep();
+  }
+  keypad_ring_push(event);
+  if (keypad_subscribed) {
+    keypad_push_held(output_pipe_fd);
+  }
+}
+
+#ifdef USE_VOICE_INPUT
+/* Recognizer thread: queue the command and wake the main loop */
+static void keypad_voice_command(const VoiceCommand *cmd) {
+  pthread_mutex_lock(&voice_lock);
+  if (voice_pending_count < VOICE_PENDING_MAX) {
+    voice_pending[voice_pending_count++] = *cmd;
+  }
+  pthread_mutex_unlock(&voice_lock);
+  hal_keypad_wake();
+}
+#endif
+
+/* Remote key receiver thread: queue the event and wake the main loop */
+static void keypad_remote_key(KeypadEvent event) {
+  pthread_mutex_lock(&remote_lock);
+  if (remote_pending_count < REMOTE_PENDING_MAX) {
+    remote_pending[remote_pending_count++] = event;
+  } else {
+    hampod_metric_add(METRIC_KEYPAD_EVENT_DROPS, 1);
+  }
+  pthread_mutex_unlock(&remote_lock);
+  hal_keypad_wake();
+}
+
+/* Deliver the remote station's key events, as if pressed here */
+static void keypad_deliver_remote(int output_pipe_fd) {
+  KeypadEvent events[REMOTE_PENDING_MAX];
+  pthread_mutex_lock(&remote_lock);
+  int count = remote_pending_count;
+  memcpy(events, remote_pending, sizeof(KeypadEvent) * count);
+  remote_pending_count = 0;
+  pthread_mutex_unlock(&remote_lock);
+
+  for (int i = 0; i < count; i++) {
+    keypad_deliver(output_pipe_fd, events[i]);
+  }
+}
+
+/* Deliver what was spoken: a key as a press and a release, stamped when
+ * the speech ended; any other command as a KEYPAD_VOICE_TAG push */
+static void keypad_deliver_voice(int output_pipe_fd) {
+  VoiceCommand cmds[VOICE_PENDING_MAX];
+  pthread_mutex_lock(&voice_lock);
+  int count = voice_pending_count;
+  memcpy(cmds, voice_pending, sizeof(VoiceCommand) * count);
+  voice_pending_count = 0;
+  pthread_mutex_unlock(&voice_lock);
+
+  for (int i = 0; i < count; i++) {
+    if (cmds[i].kind == VOICE_CMD_KEY) {
+      KeypadEvent event = {cmds[i].key, 0, 1, KEYPAD_ACTION_PRESS,
+                           cmds[i].spoken_us};
+      keypad_deliver(output_pipe_fd, event);
+      event.valid = 0;
+      event.action = KEYPAD_ACTION_RELEASE;
+      keypad_deliver(output_pipe_fd, event);
+      continue;
+    }
+
+    char payload[16];
+    int len = cmds[i].kind == VOICE_CMD_FREQUENCY
+                  ? snprintf(payload, sizeof(payload), "%c%u",
+                             KEYPAD_VOICE_FREQUENCY, cmds[i].freq_hz)
+                  : snprintf(payload, sizeof(payload), "%c%s",
+                             KEYPAD_VOICE_MODE, cmds[i].mode);
+    int push_fd = keypad_push_direct ? keypad_direct_fd : output_pipe_fd;
+    if (keypad_subscribed && push_fd != -1) {
+      KEYPAD_PRINTF("Pushing voice command %s\n", payload);
+      frame_write(push_fd, KEYPAD, KEYPAD_VOICE_TAG, payload,
+                  (unsigned short)len);
+    } else {
+      KEYPAD_PRINTF("Voice command %s dropped, nobody subscribed\n",
+                    payload);
+    }
+  }
+}
 
 // Debug print statements from this process are White (\033[0;m)
 void keypad_process() {
 
   KEYPAD_PRINTF("Keypad reader process launched\n");
+#ifndef HAMPOD_THREADED
+  hampod_alloc_dump_on_signal("keypad");
+  hampod_trace_open("keypad");
+  hampod_metrics_open("keypad");
+  hampod_log_start();
+#endif
+
+  /* Before any thread starts, so the keypad HAL's threads inherit it */
+  sched_set_priority(pthread_self(), sched_profile.keypad_priority,
+                     "Keypad process");
 
   // Initialize HAL
-  if (hal_keypad_init() != 0) {
+  long long init_started = boot_clock_ms();
+  int init_result = hal_keypad_init();
+  boot_log_phase("keypad", "hal-init", init_started);
+  if (init_result != 0) {
     KEYPAD_PRINTF("Failed to initialize keypad HAL\n");
-    // We continue anyway, maybe it will work later or user will plug it in
+    // Continue anyway: the HAL opens the keypad once it is plugged in
   } else {
     KEYPAD_PRINTF("Keypad HAL initialized: %s\n", hal_keypad_get_impl_name());
   }
 
+#ifndef HAMPOD_THREADED
+  if (local_beep_fds[0] != -1) {
+    close(local_beep_fds[0]); /* The audio process reads it */
+  }
+#endif
+
+  /* Listen before opening the pipes, see audio_process() */
+  if (direct_channels) {
+    keypad_direct_listen_fd =
+        transport_listen_seqpacket(TRANSPORT_KEYPAD_SOCKET_NAME);
+  }
+
   KEYPAD_PRINTF("Connecting to input/output pipes\n");
 
+#ifdef HAMPOD_THREADED
+  int input_pipe_fd = keypad_channel_fds[0];
+  int output_pipe_fd = keypad_channel_fds[1];
+  channel_connect(input_pipe_fd);
+  channel_connect(output_pipe_fd);
+#else
   int input_pipe_fd = open(KEYPAD_I, O_RDONLY);
   if (input_pipe_fd == -1) {
     perror("open");
@@ -56,6 +351,7 @@ void keypad_process() {
     // kill(controller_pid, SIGINT);
     exit(0);
   }
+#endif
 
   KEYPAD_PRINTF("Pipes successfully connected\n");
   KEYPAD_PRINTF("Creating input queue\n");
@@ -69,13 +365,6 @@ void keypad_process() {
     // kill(controller_pid, SIGINT);
     exit(1);
   }
-  KEYPAD_PRINTF("Creating queue availibility mutex lock\n");
-
-  if (pthread_mutex_init(&keypad_queue_available, NULL) != 0) {
-    perror("pthread_mutex_init");
-    // kill(controller_pid, SIGINT);
-    exit(1);
-  }
 
   pthread_t keypad_io_buffer;
 
@@ -91,54 +380,139 @@ void keypad_process() {
     // kill(controller_pid, SIGINT);
     exit(1);
   }
-  usleep(500000); // Half sec sleep to let child thread take control
+  if (keypad_direct_listen_fd != -1) {
+    pthread_t direct_thread;
+    KEYPAD_PRINTF("Launching direct channel thread\n");
+    if (pthread_create(&direct_thread, NULL, keypad_direct_thread,
+                       (void *)input_queue) != 0) {
+      perror("Keypad direct channel thread failed");
+      exit(1);
+    }
+    pthread_detach(direct_thread);
+  }
+
+  /* Once the pipes are up: loading the model must not hold up 'R' */
+  if (getenv(HAL_VOICE_MODEL_ENV) != NULL) {
+#ifdef USE_VOICE_INPUT
+    long long voice_started = boot_clock_ms();
+    if (hal_voice_start(keypad_voice_command, sched_profile.voice_cpus) !=
+        0) {
+      KEYPAD_PRINTF("Voice input not started\n");
+    }
+    boot_log_phase("keypad", "voice-init", voice_started);
+#else
+    fprintf(stderr, "Voice input is not built in (make VOICE_INPUT=whisper)\n");
+#endif
+  }
+  if (getenv(HAL_REMOTE_ENV) != NULL &&
+      hal_remote_keys_start(keypad_remote_key) != 0) {
+    KEYPAD_PRINTF("Remote keys not started\n");
+  }
+
   while (keypad_running) {
-    pthread_mutex_lock(&keypad_queue_available);
     pthread_mutex_lock(&keypad_queue_lock);
-    if (is_empty(input_queue)) {
-      pthread_mutex_unlock(&keypad_queue_available);
-      pthread_mutex_unlock(&keypad_queue_lock);
-      usleep(500);
-      continue;
-    }
     Inst_packet *received_packet = dequeue(input_queue);
+    hampod_metric_set(METRIC_KEYPAD_QUEUE_DEPTH, queue_depth(input_queue));
     pthread_mutex_unlock(&keypad_queue_lock);
-    pthread_mutex_unlock(&keypad_queue_available);
+    if (received_packet == NULL) {
+      keypad_take_credits(output_pipe_fd);
+      keypad_deliver_voice(output_pipe_fd);
+      keypad_deliver_remote(output_pipe_fd);
+      /* Sleeps in epoll until a key event, or until the IO thread queues
+       * a request, the recognizer a command or the remote station a key
+       * and calls hal_keypad_wake() */
+      KeypadEvent event = hal_keypad_wait(-1);
+      if (event.action == KEYPAD_ACTION_NONE || event.key == '-') {
+        continue; /* Wakeup or unmapped key */
+      }
+      keypad_deliver(output_pipe_fd, event);
+      continue;
+    }
 
-    if (received_packet->type == KEYPAD) {
+    int direct = (received_packet->flags & PACKET_FLAG_DIRECT) != 0;
+    int reply_fd = direct ? keypad_direct_fd : output_pipe_fd;
+
+    if (received_packet->type == KEYPAD &&
+        received_packet->data[0] == KEYPAD_SUBSCRIBE) {
+      keypad_subscribed =
+          (received_packet->data_len > 1) ? (received_packet->data[1] != 0) : 1;
+      keypad_push_direct = direct;
+      int hold_ms = 0;
+      if (keypad_subscribed && received_packet->data_len >= 4) {
+        hold_ms = received_packet->data[2] | (received_packet->data[3] << 8);
+      }
+      keypad_credits = -1;
+      pthread_mutex_lock(&credits_lock);
+      credits_pending = 0; /* Granted for an earlier subscription */
+      pthread_mutex_unlock(&credits_lock);
+      if (keypad_subscribed && received_packet->data_len >= 6) {
+        int credits =
+            received_packet->data[4] | (received_packet->data[5] << 8);
+        keypad_credits = credits > 0 ? credits : -1;
+      }
+      hal_keypad_set_hold_threshold(hold_ms);
+      if (keypad_subscribed) {
+        keypad_ring_count = 0; /* Pushes start from now */
+      }
+      KEYPAD_PRINTF("Push mode %s (hold %dms, credits %d)\n",
+                    keypad_subscribed ? "on" : "off", hold_ms,
+                    keypad_credits);
+      unsigned char ack[3] = {KEYPAD_SUBSCRIBE_ACK};
+      unsigned short ack_len = 1;
+      if (hold_ms > 0) {
+        ack[ack_len++] = KEYPAD_SUBSCRIBE_HOLDS;
+      }
+      if (keypad_credits > 0) {
+        ack[ack_len++] = KEYPAD_SUBSCRIBE_CREDITS;
+      }
+      frame_write(reply_fd, KEYPAD, received_packet->tag, ack, ack_len);
+    } else if (received_packet->type == KEYPAD &&
+               received_packet->data[0] == KEYPAD_DRAIN) {
+      keypad_send_ring(reply_fd, received_packet->tag);
+    } else if (received_packet->type == KEYPAD) {
       char read_value = -1;
       if (received_packet->data[0] == 'r') {
-        // Use HAL to read keypad
-        KeypadEvent event = hal_keypad_read();
-        if (event.valid) {
-          read_value = event.key;
-        } else {
-          read_value = '-'; // No key pressed
+        // Oldest captured press or repeat; releases only matter to 'e'
+        KeypadEvent event;
+        read_value = '-'; // No key pressed
+        while (keypad_ring_pop(&event)) {
+          if (event.valid) {
+            read_value = event.key;
+            break;
+          }
         }
       }
 
-      Inst_packet *packet_to_send = create_inst_packet(
-          KEYPAD, 1, (unsigned char *)&read_value, received_packet->tag);
       KEYPAD_PRINTF("Sending back value of %x ('%c')\n", read_value,
                     (char)read_value);
-      write(output_pipe_fd, packet_to_send, 8);
-      write(output_pipe_fd, packet_to_send->data, 1);
-
-      destroy_inst_packet(&packet_to_send);
+      frame_write(reply_fd, KEYPAD, received_packet->tag, &read_value, 1);
     } else if (received_packet->type == CONFIG) {
       if (received_packet->data_len >= 2 && received_packet->data[0] == 0x01) {
         KEYPAD_PRINTF("CONFIG: Setting phone layout to %d\n",
                       received_packet->data[1]);
         hal_keypad_set_phone_layout(received_packet->data[1]);
+      } else if (received_packet->data_len >= 2 &&
+                 received_packet->data[0] == CONFIG_LOCAL_KEY_BEEP) {
+        local_key_beep = received_packet->data[1] != 0;
+        KEYPAD_PRINTF("CONFIG: Local key beep %s\n",
+                      local_key_beep ? "on" : "off");
+        unsigned char ack[2] = {CONFIG_LOCAL_KEY_BEEP, local_key_beep};
+        frame_write(reply_fd, CONFIG, received_packet->tag, ack, 2);
       }
     }
-    destroy_inst_packet(&received_packet);
+    pthread_mutex_lock(&keypad_queue_lock);
+    release_packet(input_queue, &received_packet);
+    pthread_mutex_unlock(&keypad_queue_lock);
   }
   pthread_join(keypad_io_buffer, NULL);
   destroy_queue(input_queue);
   close(input_pipe_fd);
   close(output_pipe_fd); // Graceful closing is always nice :)
 
+#ifdef USE_VOICE_INPUT
+  hal_voice_stop();
+#endif
+  hal_remote_keys_stop();
   hal_keypad_cleanup();
   return;
 }
@@ -147,52 +521,36 @@ void keypad_process() {
 void *keypad_io_thread(void *arg) {
 
   KEYPAD_IO_PRINTF("Keypad IO thread created\n");
+  hampod_metrics_name_thread("keypad-io");
 
   keypad_io_packet *new_packet = (keypad_io_packet *)arg;
-  int i_pipe = new_packet->pipe_fd;
-  Packet_queue *queue = new_packet->queue;
-  unsigned char buffer[256];
+  keypad_io_loop(new_packet->pipe_fd, new_packet->queue, 0);
+  return NULL;
+}
+
+/* Queue requests from i_pipe until it closes, tagged with their origin */
+static void keypad_io_loop(int i_pipe, Packet_queue *queue,
+                           unsigned short origin) {
+  unsigned char buffer[FRAME_MAX_DATA];
+  Frame_reader reader;
+  frame_reader_init(&reader, i_pipe);
 
   KEYPAD_IO_PRINTF("Input pipe = %d, queue ptr = %p\n", i_pipe, queue);
 
   while (keypad_running) {
-    pthread_mutex_lock(&keypad_queue_lock);
-    int queue_empty = is_empty(queue);
-    pthread_mutex_unlock(&keypad_queue_lock);
-    if (queue_empty) {
-      KEYPAD_IO_PRINTF("Making queue inaccessible\n");
-      pthread_mutex_lock(&keypad_queue_available);
-    }
-
-    Packet_type type;
-    unsigned short size;
-    unsigned short tag;
-    ssize_t bytes_read;
-
-    /* Read packet header with error checking */
-    bytes_read = read(i_pipe, &type, sizeof(Packet_type));
-    if (bytes_read <= 0) {
-      KEYPAD_IO_PRINTF("Pipe closed or read error (type), exiting thread\n");
-      break;
-    }
-
-    bytes_read = read(i_pipe, &size, sizeof(unsigned short));
-    if (bytes_read <= 0) {
-      KEYPAD_IO_PRINTF("Pipe closed or read error (size), exiting thread\n");
-      break;
-    }
-
-    bytes_read = read(i_pipe, &tag, sizeof(unsigned short));
-    if (bytes_read <= 0) {
-      KEYPAD_IO_PRINTF("Pipe closed or read error (tag), exiting thread\n");
-      break;
+    Frame_header header;
+    int read_result = frame_read(&reader, &header, buffer, sizeof(buffer));
+    if (read_result == FRAME_DROPPED) {
+      HAMPOD_LOG(1, "Keypad: request of %u bytes dropped\n", header.data_len);
+      continue;
     }
-
-    bytes_read = read(i_pipe, buffer, size);
-    if (bytes_read <= 0) {
-      KEYPAD_IO_PRINTF("Pipe closed or read error (data), exiting thread\n");
+    if (read_result != 0) {
+      KEYPAD_IO_PRINTF("Pipe closed or read error, exiting thread\n");
       break;
     }
+    Packet_type type = (Packet_type)header.type;
+    unsigned short size = header.data_len;
+    unsigned short tag = header.tag;
 
     KEYPAD_IO_PRINTF("Found packet with type %d, size %d\n", type, size);
     KEYPAD_IO_PRINTF("Buffer holds: %s: with size %d\n", buffer, size);
@@ -201,23 +559,30 @@ void *keypad_io_thread(void *arg) {
       KEYPAD_IO_PRINTF("Packet not supported for Keypad firmware\n");
       continue;
     }
-
-    Inst_packet *new_packet = create_inst_packet(type, size, buffer, tag);
+    if (type == KEYPAD && size >= 3 && buffer[0] == KEYPAD_CREDIT) {
+      /* Not answered, and not queued behind requests */
+      pthread_mutex_lock(&credits_lock);
+      credits_pending += buffer[1] | (buffer[2] << 8);
+      pthread_mutex_unlock(&credits_lock);
+      hal_keypad_wake();
+      continue;
+    }
 
     KEYPAD_IO_PRINTF("Locking queue\n");
     pthread_mutex_lock(&keypad_queue_lock);
 
     KEYPAD_IO_PRINTF("Queueing packet\n");
-    enqueue(queue, new_packet);
+    if (enqueue(queue, type, size, buffer, tag, origin) != 0) {
+      KEYPAD_IO_PRINTF("Queue full (depth %d), dropped packet\n",
+                       queue_depth(queue));
+      hampod_metric_add(METRIC_KEYPAD_QUEUE_DROPS, 1);
+    }
+    hampod_metric_set(METRIC_KEYPAD_QUEUE_DEPTH, queue_depth(queue));
 
-    KEYPAD_IO_PRINTF("Releasing queue & making it accessible\n");
+    KEYPAD_IO_PRINTF("Releasing queue & waking main thread\n");
     pthread_mutex_unlock(&keypad_queue_lock);
-    if (queue_empty) {
-      pthread_mutex_unlock(&keypad_queue_available);
-    }
-    usleep(100);
+    hal_keypad_wake(); /* The main loop waits on the keypad */
   }
-  return NULL;
 }
 
 // Global fd for reading keypad in Software mode
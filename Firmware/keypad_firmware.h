@@ -17,6 +17,9 @@
 
 #include "hampod_queue.h"
 #include "hampod_firm_packet.h"
+#include "hampod_frame.h"
+#include "hampod_log.h"
+#include "hampod_transport.h"
 
 #define KEYPAD_O "../Firmware/Keypad_o"
 #define KEYPAD_I "../Firmware/Keypad_i"
@@ -24,20 +27,19 @@
 #define KEYPAD_THREAD_COLOR "\033[0;97mKeypad - Main: "
 #define KEYPAD_IO_THREAD_COLOR "\033[0;96mKeypad - IO: "
 
+/* Queued for the logger thread (hampod_log.h), never printed in place */
 #ifdef DEBUG
 #define KEYPAD_PRINTF(...) \
     do { \
         if(DEBUG) { \
-            printf(KEYPAD_THREAD_COLOR); \
-            printf(__VA_ARGS__); \
+            HAMPOD_LOG(1, KEYPAD_THREAD_COLOR __VA_ARGS__); \
         } \
     } while(0)
 
 #define KEYPAD_IO_PRINTF(...) \
     do { \
         if(DEBUG) { \
-            printf(KEYPAD_IO_THREAD_COLOR); \
-            printf(__VA_ARGS__); \
+            HAMPOD_LOG(1, KEYPAD_IO_THREAD_COLOR __VA_ARGS__); \
         } \
     } while(0)
 #else
@@ -50,6 +52,69 @@
 
 #endif
 
+/* Keypad subscription (push mode)
+ *
+ * Software sends KEYPAD "s<0|1>" to turn push mode off/on; the keypad process
+ * answers with a one-byte 'S' ack. While subscribed, every evdev event is
+ * pushed unsolicited as a KEYPAD packet with tag KEYPAD_PUSH_TAG and a
+ * KEYPAD_PUSH_LEN byte payload:
+ *   [0] key symbol, [1] KEYPAD_ACTION_*, [2..9] kernel timestamp (us, host
+ *   byte order)
+ * Polled 'r' replies are always 1 byte, so the two never get confused.
+ *
+ * "s1" may carry a hold threshold in ms as two more bytes (little endian).
+ * The keypad process then also pushes KEYPAD_ACTION_HOLD the moment a key
+ * has been down that long, and acks with "SH" so Software knows it does
+ * not need a hold timer of its own.
+ *
+ * Two bytes more (little endian, after the hold threshold, 0 for none)
+ * turn on flow control: the number of events Software has room for. Each
+ * push uses up a credit; at none left, events wait in the ring (oldest
+ * dropped when full) until Software grants more with KEYPAD "c" and a
+ * count (two bytes, little endian), which is not answered. The ack then
+ * carries a 'C' after the 'S' (and 'H'). Voice commands other than keys
+ * are rare and pushed regardless.
+ */
+#define KEYPAD_SUBSCRIBE 's'
+#define KEYPAD_SUBSCRIBE_ACK 'S'
+#define KEYPAD_SUBSCRIBE_HOLDS 'H'
+#define KEYPAD_SUBSCRIBE_CREDITS 'C'
+#define KEYPAD_CREDIT 'c'
+#define KEYPAD_PUSH_TAG 0xFFFF
+#define KEYPAD_PUSH_LEN 10
+
+/* Keypad event ring (batch drain)
+ *
+ * While nobody is subscribed, the keypad process keeps the last
+ * KEYPAD_RING_SIZE key events. KEYPAD "e" is answered with 'E' followed by
+ * up to KEYPAD_DRAIN_MAX records, oldest first, each laid out like a push
+ * payload (KEYPAD_EVENT_LEN bytes). A full reply means more may be waiting.
+ * 'r' still returns one key: the oldest press or repeat in the ring.
+ */
+#define KEYPAD_DRAIN 'e'
+#define KEYPAD_DRAIN_ACK 'E'
+#define KEYPAD_EVENT_LEN KEYPAD_PUSH_LEN
+#define KEYPAD_DRAIN_MAX 25 /* 1 + 25 * 10 fits Software's 256-byte packet */
+#define KEYPAD_RING_SIZE 128
+
+/* Voice commands (hal/hal_voice.h)
+ *
+ * A spoken key arrives like a key event: a press and a release, pushed or
+ * kept in the ring. Other spoken commands are only pushed, as KEYPAD
+ * packets with tag KEYPAD_VOICE_TAG and an ASCII payload: one kind byte
+ * and its argument, "f14250000" (frequency in Hz) or "mUSB" (mode: USB,
+ * LSB, CW, AM, FM or RTTY). Nothing is sent unless a model was given
+ * (--voice-model). */
+#define KEYPAD_VOICE_TAG 0xFFFE
+#define KEYPAD_VOICE_FREQUENCY 'f'
+#define KEYPAD_VOICE_MODE 'm'
+
+/* CONFIG 0x02 <0|1>: local key beep off/on. While on, the keypad process
+ * has the audio process play BEEP_KEYPRESS itself on every key-down, over
+ * local_beep_fds (firmware.c). It answers with the same two bytes so
+ * Software knows to stop sending its own keypress beeps. */
+#define CONFIG_LOCAL_KEY_BEEP 0x02
+
 typedef struct keypad_io_packet {
     int pipe_fd;
     Packet_queue* queue;
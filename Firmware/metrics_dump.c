@@ -0,0 +1,371 @@
+/* Print the HAMPOD metrics registries
+ *
+ * Reads every METRICS_DIR/hampod_metrics.<process> registry
+ * (hampod_metrics.h) and prints the metrics each process has written,
+ * with the CPU time of each of its threads from /proc. Safe to run while
+ * HAMPOD is running.
+ *
+ * Usage: metrics_dump [-p] [-l [ADDRESS:]PORT]
+ *   -p       Print in the Prometheus text format
+ *   -l PORT  Serve the Prometheus text format over HTTP on PORT, on
+ *            127.0.0.1 unless an ADDRESS is given (0.0.0.0 for any)
+ */
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "hampod_metrics.h"
+
+#define REGISTRIES_MAX 8
+#define THREADS_MAX 64
+
+typedef struct Thread_cpu {
+  int tid;
+  char name[32];
+  double seconds; /* User and system time */
+} Thread_cpu;
+
+typedef struct Registry {
+  Metric_registry copy;
+  int running;
+  int thread_count;
+  Thread_cpu threads[THREADS_MAX];
+} Registry;
+
+#define METRIC_NAME(id, name, kind, help) name,
+static const char *const metric_names[METRICS] = {
+    HAMPOD_METRIC_LIST(METRIC_NAME)};
+#undef METRIC_NAME
+
+#define METRIC_KIND(id, name, kind, help) kind,
+static const Metric_kind metric_kinds[METRICS] = {
+    HAMPOD_METRIC_LIST(METRIC_KIND)};
+#undef METRIC_KIND
+
+#define METRIC_HELP(id, name, kind, help) help,
+static const char *const metric_helps[METRICS] = {
+    HAMPOD_METRIC_LIST(METRIC_HELP)};
+#undef METRIC_HELP
+
+static const uint64_t bucket_limits_us[METRIC_BUCKETS - 1] =
+    METRIC_BUCKET_LIMITS_US;
+
+static Registry registries[REGISTRIES_MAX];
+static int registry_count = 0;
+
+/* CPU time of each thread of pid; 0 threads if it is gone */
+static void read_threads(Registry *registry) {
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/%d/task", registry->copy.pid);
+  DIR *dir = opendir(path);
+  if (dir == NULL) {
+    return;
+  }
+  long ticks = sysconf(_SC_CLK_TCK);
+  struct dirent *dirent;
+  while ((dirent = readdir(dir)) != NULL &&
+         registry->thread_count < THREADS_MAX) {
+    if (dirent->d_name[0] == '.') {
+      continue;
+    }
+    char stat_path[352];
+    snprintf(stat_path, sizeof(stat_path), "%s/%s/stat", path,
+             dirent->d_name);
+    FILE *f = fopen(stat_path, "r");
+    if (f == NULL) {
+      continue;
+    }
+    char line[512];
+    int got = fgets(line, sizeof(line), f) != NULL;
+    fclose(f);
+    /* tid (name) state ... utime stime are fields 14 and 15; the name
+     * may hold spaces and parentheses, so parse from the last ')' */
+    char *name_start = got ? strchr(line, '(') : NULL;
+    char *name_end = got ? strrchr(line, ')') : NULL;
+    unsigned long utime, stime;
+    if (name_start == NULL || name_end == NULL || name_end < name_start ||
+        sscanf(name_end + 2,
+               "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime,
+               &stime) != 2) {
+      continue;
+    }
+    Thread_cpu *thread = &registry->threads[registry->thread_count++];
+    thread->tid = atoi(dirent->d_name);
+    snprintf(thread->name, sizeof(thread->name), "%.*s",
+             (int)(name_end - name_start - 1), name_start + 1);
+    thread->seconds = (double)(utime + stime) / ticks;
+  }
+  closedir(dir);
+}
+
+/* Copy out one registry */
+static void read_registry(const char *path) {
+  if (registry_count == REGISTRIES_MAX) {
+    return;
+  }
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Metric_registry)) {
+    close(fd);
+    return;
+  }
+  Metric_registry *mapped =
+      mmap(NULL, sizeof(Metric_registry), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    return;
+  }
+  if (mapped->magic != METRICS_MAGIC || mapped->metrics != METRICS) {
+    munmap(mapped, sizeof(Metric_registry));
+    return;
+  }
+
+  Registry *registry = &registries[registry_count++];
+  memset(registry, 0, sizeof(*registry));
+  memcpy(&registry->copy, mapped, sizeof(Metric_registry));
+  munmap(mapped, sizeof(Metric_registry));
+  registry->copy.process[METRICS_PROCESS_MAX - 1] = '\0';
+  registry->running = kill(registry->copy.pid, 0) == 0;
+  if (registry->running) {
+    read_threads(registry);
+  }
+}
+
+static void read_registries(void) {
+  registry_count = 0;
+  DIR *dir = opendir(METRICS_DIR);
+  if (dir == NULL) {
+    return;
+  }
+  size_t prefix_len = strlen(METRICS_FILE_PREFIX);
+  struct dirent *dirent;
+  while ((dirent = readdir(dir)) != NULL) {
+    if (strncmp(dirent->d_name, METRICS_FILE_PREFIX, prefix_len) != 0) {
+      continue;
+    }
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", METRICS_DIR, dirent->d_name);
+    read_registry(path);
+  }
+  closedir(dir);
+}
+
+static int written(const Registry *registry, int id) {
+  return (registry->copy.written & ((uint64_t)1 << id)) != 0;
+}
+
+static void print_text(FILE *out) {
+  for (int r = 0; r < registry_count; r++) {
+    const Registry *registry = &registries[r];
+    fprintf(out, "%s (pid %d%s)\n", registry->copy.process, registry->copy.pid,
+            registry->running ? "" : ", not running");
+    for (int id = 0; id < METRICS; id++) {
+      if (!written(registry, id)) {
+        continue;
+      }
+      const Metric_slot *slot = &registry->copy.slot[id];
+      if (metric_kinds[id] == METRIC_GAUGE) {
+        fprintf(out, "  %-28s %lld\n", metric_names[id],
+                (long long)(int64_t)slot->value);
+      } else if (metric_kinds[id] == METRIC_COUNTER) {
+        fprintf(out, "  %-28s %llu\n", metric_names[id],
+                (unsigned long long)slot->value);
+      } else {
+        /* Histograms by their bucket limits in ms, as radio-latency */
+        fprintf(out, "  %-28s count %llu, mean %.1f ms\n   ", metric_names[id],
+                (unsigned long long)slot->value,
+                slot->value ? slot->sum_us / 1000.0 / slot->value : 0.0);
+        for (int b = 0; b < METRIC_BUCKETS; b++) {
+          if (b < METRIC_BUCKETS - 1) {
+            fprintf(out, " <%llu:%llu",
+                    (unsigned long long)bucket_limits_us[b] / 1000,
+                    (unsigned long long)slot->buckets[b]);
+          } else {
+            fprintf(out, " more:%llu\n", (unsigned long long)slot->buckets[b]);
+          }
+        }
+      }
+    }
+    for (int t = 0; t < registry->thread_count; t++) {
+      const Thread_cpu *thread = &registry->threads[t];
+      fprintf(out, "  cpu %-7d %-16s %10.2f s\n", thread->tid, thread->name,
+              thread->seconds);
+    }
+    fprintf(out, "\n");
+  }
+}
+
+static void print_prometheus(FILE *out) {
+  for (int id = 0; id < METRICS; id++) {
+    int header = 0;
+    for (int r = 0; r < registry_count; r++) {
+      const Registry *registry = &registries[r];
+      if (!registry->running || !written(registry, id)) {
+        continue;
+      }
+      if (!header) {
+        static const char *const types[] = {"counter", "gauge", "histogram"};
+        fprintf(out, "# HELP hampod_%s %s\n", metric_names[id],
+                metric_helps[id]);
+        fprintf(out, "# TYPE hampod_%s %s\n", metric_names[id],
+                types[metric_kinds[id]]);
+        header = 1;
+      }
+      const char *process = registry->copy.process;
+      const Metric_slot *slot = &registry->copy.slot[id];
+      if (metric_kinds[id] == METRIC_GAUGE) {
+        fprintf(out, "hampod_%s{process=\"%s\"} %lld\n", metric_names[id],
+                process, (long long)(int64_t)slot->value);
+      } else if (metric_kinds[id] == METRIC_COUNTER) {
+        fprintf(out, "hampod_%s{process=\"%s\"} %llu\n", metric_names[id],
+                process, (unsigned long long)slot->value);
+      } else {
+        /* Prometheus buckets are cumulative, in seconds */
+        uint64_t cumulative = 0;
+        for (int b = 0; b < METRIC_BUCKETS; b++) {
+          cumulative += slot->buckets[b];
+          if (b < METRIC_BUCKETS - 1) {
+            fprintf(out, "hampod_%s_bucket{process=\"%s\",le=\"%g\"} %llu\n",
+                    metric_names[id], process, bucket_limits_us[b] / 1e6,
+                    (unsigned long long)cumulative);
+          } else {
+            fprintf(out, "hampod_%s_bucket{process=\"%s\",le=\"+Inf\"} %llu\n",
+                    metric_names[id], process, (unsigned long long)cumulative);
+          }
+        }
+        fprintf(out, "hampod_%s_sum{process=\"%s\"} %g\n", metric_names[id],
+                process, slot->sum_us / 1e6);
+        fprintf(out, "hampod_%s_count{process=\"%s\"} %llu\n",
+                metric_names[id], process, (unsigned long long)slot->value);
+      }
+    }
+  }
+
+  fprintf(out, "# HELP hampod_thread_cpu_seconds_total CPU time of each "
+               "thread\n");
+  fprintf(out, "# TYPE hampod_thread_cpu_seconds_total counter\n");
+  for (int r = 0; r < registry_count; r++) {
+    const Registry *registry = &registries[r];
+    for (int t = 0; t < registry->thread_count; t++) {
+      const Thread_cpu *thread = &registry->threads[t];
+      fprintf(out,
+              "hampod_thread_cpu_seconds_total{process=\"%s\",thread=\"%s\","
+              "tid=\"%d\"} %.2f\n",
+              registry->copy.process, thread->name, thread->tid,
+              thread->seconds);
+    }
+  }
+}
+
+/* Answer every HTTP request with the Prometheus text, read afresh */
+static int serve(const char *listen_on) {
+  char address[64] = "127.0.0.1";
+  const char *port = listen_on;
+  const char *colon = strrchr(listen_on, ':');
+  if (colon != NULL) {
+    snprintf(address, sizeof(address), "%.*s", (int)(colon - listen_on),
+             listen_on);
+    port = colon + 1;
+  }
+  struct sockaddr_in addr = {.sin_family = AF_INET,
+                             .sin_port = htons((uint16_t)atoi(port))};
+  if (inet_pton(AF_INET, address, &addr.sin_addr) != 1) {
+    fprintf(stderr, "Bad address: %s\n", address);
+    return 1;
+  }
+  int server = socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  if (server < 0 ||
+      setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0 ||
+      bind(server, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+      listen(server, 4) != 0) {
+    perror(listen_on);
+    return 1;
+  }
+  signal(SIGPIPE, SIG_IGN);
+  printf("Serving metrics on http://%s:%s/metrics\n", address, port);
+
+  for (;;) {
+    int client = accept(server, NULL, NULL);
+    if (client < 0) {
+      continue;
+    }
+    /* The request itself doesn't matter; every path gets the metrics */
+    struct timeval timeout = {.tv_sec = 2};
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    char request[1024];
+    if (recv(client, request, sizeof(request), 0) <= 0) {
+      close(client);
+      continue;
+    }
+
+    char *body = NULL;
+    size_t body_len = 0;
+    FILE *out = open_memstream(&body, &body_len);
+    if (out == NULL) {
+      close(client);
+      continue;
+    }
+    read_registries();
+    print_prometheus(out);
+    fclose(out);
+
+    char header[160];
+    int header_len = snprintf(header, sizeof(header),
+                              "HTTP/1.0 200 OK\r\n"
+                              "Content-Type: text/plain; version=0.0.4\r\n"
+                              "Content-Length: %zu\r\n\r\n",
+                              body_len);
+    if (write(client, header, header_len) == header_len) {
+      if (write(client, body, body_len) < 0) {
+        /* The scraper went away; nothing to do */
+      }
+    }
+    free(body);
+    close(client);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  int prometheus = 0;
+  const char *listen_on = NULL;
+  int opt;
+  while ((opt = getopt(argc, argv, "pl:")) != -1) {
+    if (opt == 'p') {
+      prometheus = 1;
+    } else if (opt == 'l') {
+      listen_on = optarg;
+    } else {
+      fprintf(stderr, "Usage: %s [-p] [-l [ADDRESS:]PORT]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (listen_on != NULL) {
+    return serve(listen_on);
+  }
+
+  read_registries();
+  if (registry_count == 0) {
+    printf("No metrics in %s/%s*\n", METRICS_DIR, METRICS_FILE_PREFIX);
+    return 1;
+  }
+  if (prometheus) {
+    print_prometheus(stdout);
+  } else {
+    print_text(stdout);
+  }
+  return 0;
+}
@@ -0,0 +1,289 @@
+/* Remote station: a keypad and a headset for a HAMPOD over the network
+ *
+ * Runs on any Linux box with a USB keypad and a sound card (another Pi,
+ * a laptop) and talks to a firmware.elf started with --remote pointing
+ * back at it (hal/hal_remote.h). Its keys go to the HAMPOD as if pressed
+ * on its own keypad; what the HAMPOD says comes back as Opus over RTP and
+ * plays here out of a small jitter buffer.
+ *
+ * Three threads:
+ *   keys      reads the keypad HAL and sends each event, repeated 20 and
+ *             60 ms later with the events before it, so a lost datagram
+ *             neither loses a key nor leaves one held down
+ *   receive   puts arriving RTP packets into the jitter buffer
+ *   main      takes a packet every 20 ms, decodes it (recovering a lost
+ *             one from the next packet's FEC, or concealing it) and
+ *             writes it to ALSA with a 40 ms device buffer
+ * Mouth to ear the HAMPOD's speech is about the network delay plus the
+ * jitter buffer plus 40 ms behind the HAMPOD's own speaker, which itself
+ * plays from a buffer of 40 to 400 ms.
+ *
+ * Usage: ./remote_station HAMPOD:PORT [--device DEV] [--jitter MS]
+ *                         [--hold MS] [--phone-layout]
+ * PORT is the one given to firmware.elf --remote; both ends listen on it.
+ * --jitter is the audio queued before playout starts (default 40 ms; more
+ * for Wi-Fi or the internet), --hold the hold threshold the keypad HAL
+ * reports holds at (default 500 ms, as Software2's).
+ */
+#include <alsa/asoundlib.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/ip.h>
+#include <opus/opus.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hal/hal_keypad.h"
+#include "hal/hal_remote.h"
+
+#define STATION_JITTER_DEFAULT_MS 40
+#define STATION_HOLD_DEFAULT_MS 500
+#define STATION_DEVICE_LATENCY_US 40000
+#define STATION_TOS 0xB8 /* DSCP EF, as the HAMPOD's stream */
+
+static const int resend_after_ms[] = {20, 40}; /* After the event, then */
+#define RESENDS (int)(sizeof(resend_after_ms) / sizeof(resend_after_ms[0]))
+
+static volatile sig_atomic_t running = 1;
+static struct sockaddr_in hampod;
+static int sock = -1;
+
+static RemoteJitter jitter;
+static pthread_mutex_t jitter_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jitter_ready = PTHREAD_COND_INITIALIZER;
+
+static void print_usage(const char *name) {
+  fprintf(stderr,
+          "Usage: %s HAMPOD:PORT [--device DEV] [--jitter MS] [--hold MS]\n"
+          "       %*s [--phone-layout]\n",
+          name, (int)strlen(name), "");
+}
+
+static void stop_handler(int signum) {
+  (void)signum;
+  running = 0;
+  hal_keypad_wake();
+}
+
+static uint64_t realtime_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static void *keys_thread(void *arg) {
+  RemoteKeyEvent history[REMOTE_KEY_EVENTS];
+  unsigned char datagram[REMOTE_KEY_DATAGRAM_MAX];
+  size_t datagram_len = 0;
+  uint32_t session = (uint32_t)realtime_us() ^ (uint32_t)getpid();
+  uint32_t seq = 0;
+  int count = 0;
+  int resends = RESENDS; /* Of the last datagram, still to do */
+  (void)arg;
+
+  while (running) {
+    KeypadEvent event =
+        hal_keypad_wait(resends < RESENDS ? resend_after_ms[resends] : -1);
+    if (event.action == KEYPAD_ACTION_NONE || event.key == '-') {
+      if (resends < RESENDS && running) {
+        sendto(sock, datagram, datagram_len, 0, (struct sockaddr *)&hampod,
+               sizeof(hampod));
+        resends++;
+      }
+      continue;
+    }
+
+    if (count == REMOTE_KEY_EVENTS) {
+      memmove(history, &history[1], sizeof(history[0]) * (count - 1));
+      count--;
+    }
+    RemoteKeyEvent *key = &history[count++];
+    key->seq = ++seq;
+    key->timestamp_us = event.timestamp_us ? event.timestamp_us
+                                           : realtime_us();
+    key->key = event.key;
+    key->action = event.action;
+    datagram_len = hal_remote_encode_keys(session, history, count, datagram);
+    if (sendto(sock, datagram, datagram_len, 0, (struct sockaddr *)&hampod,
+               sizeof(hampod)) == -1) {
+      perror("sendto");
+    }
+    resends = 0;
+  }
+  return NULL;
+}
+
+static void *receive_thread(void *arg) {
+  unsigned char packet[REMOTE_PACKET_MAX + REMOTE_RTP_HEADER_LEN];
+  (void)arg;
+
+  while (running) {
+    struct sockaddr_in from;
+    socklen_t from_len = sizeof(from);
+    ssize_t len = recvfrom(sock, packet, sizeof(packet), 0,
+                           (struct sockaddr *)&from, &from_len);
+    if (len <= 0 || from.sin_addr.s_addr != hampod.sin_addr.s_addr) {
+      continue; /* Timed out, or someone else (the stream's source port is
+                 * the HAMPOD's choice, so only its address is checked) */
+    }
+    int marker;
+    uint16_t seq;
+    int offset = hal_remote_rtp_parse(packet, (size_t)len, &marker, &seq);
+    if (offset < 0) {
+      continue;
+    }
+    pthread_mutex_lock(&jitter_lock);
+    hal_remote_jitter_put(&jitter, seq, marker, &packet[offset],
+                          (size_t)len - (size_t)offset);
+    pthread_cond_signal(&jitter_ready);
+    pthread_mutex_unlock(&jitter_lock);
+  }
+  return NULL;
+}
+
+static snd_pcm_t *open_playback(const char *device) {
+  snd_pcm_t *pcm = NULL;
+  int err = snd_pcm_open(&pcm, device, SND_PCM_STREAM_PLAYBACK, 0);
+  if (err == 0) {
+    err = snd_pcm_set_params(pcm, SND_PCM_FORMAT_S16_LE,
+                             SND_PCM_ACCESS_RW_INTERLEAVED, 1,
+                             REMOTE_SAMPLE_RATE, 1, STATION_DEVICE_LATENCY_US);
+  }
+  if (err < 0) {
+    fprintf(stderr, "Cannot play on %s: %s\n", device, snd_strerror(err));
+    if (pcm != NULL) {
+      snd_pcm_close(pcm);
+    }
+    return NULL;
+  }
+  return pcm;
+}
+
+/* Play out the jitter buffer until stopped; ALSA paces it */
+static void playout(snd_pcm_t *pcm, OpusDecoder *decoder) {
+  unsigned char payload[REMOTE_PACKET_MAX];
+  int16_t frame[REMOTE_FRAME_SAMPLES];
+
+  while (running) {
+    size_t len = 0;
+    pthread_mutex_lock(&jitter_lock);
+    int got = hal_remote_jitter_get(&jitter, payload, &len);
+    if (got == REMOTE_JITTER_WAIT) {
+      struct timespec wake;
+      clock_gettime(CLOCK_REALTIME, &wake);
+      wake.tv_nsec += REMOTE_FRAME_MS * 1000000L;
+      if (wake.tv_nsec >= 1000000000L) {
+        wake.tv_sec++;
+        wake.tv_nsec -= 1000000000L;
+      }
+      pthread_cond_timedwait(&jitter_ready, &jitter_lock, &wake);
+      pthread_mutex_unlock(&jitter_lock);
+      continue;
+    }
+    /* A lost packet is rebuilt from the next one's FEC if that is here */
+    int fec = got == REMOTE_JITTER_MISSING &&
+              hal_remote_jitter_peek(&jitter, payload, &len);
+    pthread_mutex_unlock(&jitter_lock);
+
+    int samples = got == REMOTE_JITTER_PACKET || fec
+                      ? opus_decode(decoder, payload, (opus_int32)len, frame,
+                                    REMOTE_FRAME_SAMPLES, fec)
+                      : opus_decode(decoder, NULL, 0, frame,
+                                    REMOTE_FRAME_SAMPLES, 0); /* Concealed */
+    if (samples <= 0) {
+      continue;
+    }
+    snd_pcm_sframes_t written = snd_pcm_writei(pcm, frame, samples);
+    if (written < 0 && snd_pcm_recover(pcm, (int)written, 1) == 0) {
+      snd_pcm_writei(pcm, frame, samples); /* Ran dry between phrases */
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  const char *device = "default";
+  int jitter_ms = STATION_JITTER_DEFAULT_MS;
+  int hold_ms = STATION_HOLD_DEFAULT_MS;
+
+  if (argc < 2 || hal_remote_parse_address(argv[1], &hampod) != 0) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  for (int i = 2; i < argc; i++) {
+    if (strcmp(argv[i], "--device") == 0 && i + 1 < argc) {
+      device = argv[++i];
+    } else if (strcmp(argv[i], "--jitter") == 0 && i + 1 < argc) {
+      jitter_ms = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--hold") == 0 && i + 1 < argc) {
+      hold_ms = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--phone-layout") == 0) {
+      hal_keypad_set_phone_layout(1);
+    } else {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+
+  /* One socket, on the HAMPOD's port: its audio comes in, our keys go out */
+  struct sockaddr_in local = {0};
+  local.sin_family = AF_INET;
+  local.sin_addr.s_addr = htonl(INADDR_ANY);
+  local.sin_port = hampod.sin_port;
+  int tos = STATION_TOS;
+  sock = socket(AF_INET, SOCK_DGRAM, 0);
+  if (sock == -1 || bind(sock, (struct sockaddr *)&local, sizeof(local)) != 0) {
+    perror("socket");
+    return 1;
+  }
+  setsockopt(sock, IPPROTO_IP, IP_TOS, &tos, sizeof(tos));
+  /* Let the receive thread notice a stop request */
+  struct timeval poll_period = {0, 500000};
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &poll_period, sizeof(poll_period));
+
+  int err;
+  OpusDecoder *decoder = opus_decoder_create(REMOTE_SAMPLE_RATE, 1, &err);
+  if (decoder == NULL) {
+    fprintf(stderr, "Decoder failed: %s\n", opus_strerror(err));
+    return 1;
+  }
+  snd_pcm_t *pcm = open_playback(device);
+  if (pcm == NULL) {
+    opus_decoder_destroy(decoder);
+    return 1;
+  }
+  if (hal_keypad_init() != 0) {
+    fprintf(stderr, "No keypad yet; it is picked up once plugged in\n");
+  }
+  hal_keypad_set_hold_threshold(hold_ms);
+  hal_remote_jitter_init(&jitter, jitter_ms);
+
+  signal(SIGINT, stop_handler);
+  signal(SIGTERM, stop_handler);
+
+  pthread_t keys, receive;
+  if (pthread_create(&keys, NULL, keys_thread, NULL) != 0 ||
+      pthread_create(&receive, NULL, receive_thread, NULL) != 0) {
+    perror("pthread_create");
+    return 1;
+  }
+  printf("Remote station for %s, jitter buffer %d ms\n", argv[1],
+         jitter.target * REMOTE_FRAME_MS);
+
+  playout(pcm, decoder);
+
+  pthread_join(keys, NULL);
+  pthread_join(receive, NULL);
+  printf("\nPackets concealed: %d, late: %d\n", jitter.lost, jitter.late);
+
+  hal_keypad_cleanup();
+  snd_pcm_close(pcm);
+  opus_decoder_destroy(decoder);
+  close(sock);
+  return 0;
+}
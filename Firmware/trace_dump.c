@@ -0,0 +1,519 @@
+/* Print the HAMPOD trace rings as one timeline
+ *
+ * Reads every TRACE_DIR/hampod_trace.<process> ring (hampod_trace.h),
+ * keeps the records that were completely written, and prints them in
+ * CLOCK_MONOTONIC order with the process, thread and decoded arguments.
+ * Safe to run while HAMPOD is running: records being written are skipped.
+ *
+ * Usage: trace_dump [-n COUNT] [-a] [-k] [PROCESS...]
+ *   -n COUNT  Print the newest COUNT records (default 200), or with -k the
+ *             COUNT slowest keys (default 10)
+ *   -a        Print every record held
+ *   -k        Key-to-sound report instead of the timeline
+ *   PROCESS   Only these rings (firmware, keypad, audio, hampod)
+ *
+ * The key-to-sound report follows every key Software2 dispatched that is
+ * still in the rings, from the kernel's key event to the first sound of
+ * the speech it caused being written to ALSA, through these hops:
+ *   HAL    kernel event to the keypad process reading it
+ *   SW2    keypad process to Software2 receiving it
+ *   Disp   Software2 receiving it to dispatching it to the mode
+ *   Mode   dispatch to the mode queueing speech
+ *   Queue  speech queue, until the request was sent
+ *   Audio  request sent to the audio process starting it
+ *   TTS    start to the first audio from TTS or its cache
+ *   PCM    first audio to the first sound written to ALSA
+ * It prints a latency histogram per key, each hop's spread and the slowest
+ * keys hop by hop. A hop whose records are missing is counted in the next.
+ */
+#include <dirent.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hampod_trace.h"
+
+#define DEFAULT_COUNT 200
+#define DEFAULT_SLOWEST 10
+
+typedef struct Entry {
+  Trace_record record;
+  const char *process;
+} Entry;
+
+#define TRACE_EVENT_NAME(id, name, format) name,
+static const char *const event_names[TRACE_EVENTS] = {
+    HAMPOD_TRACE_EVENTS(TRACE_EVENT_NAME)};
+#undef TRACE_EVENT_NAME
+
+#define TRACE_EVENT_FORMAT(id, name, format) format,
+static const char *const event_formats[TRACE_EVENTS] = {
+    HAMPOD_TRACE_EVENTS(TRACE_EVENT_FORMAT)};
+#undef TRACE_EVENT_FORMAT
+
+static Entry *entries = NULL;
+static size_t entry_count = 0;
+static size_t entry_capacity = 0;
+
+static int add_entry(const Trace_record *record, const char *process) {
+  if (entry_count == entry_capacity) {
+    size_t capacity = entry_capacity ? entry_capacity * 2 : 4096;
+    Entry *grown = realloc(entries, capacity * sizeof(Entry));
+    if (grown == NULL) {
+      return -1;
+    }
+    entries = grown;
+    entry_capacity = capacity;
+  }
+  entries[entry_count].record = *record;
+  entries[entry_count].process = process;
+  entry_count++;
+  return 0;
+}
+
+/* Copy out the published records of one ring */
+static void read_ring(const char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Trace_ring)) {
+    close(fd);
+    return;
+  }
+  Trace_ring *ring =
+      mmap(NULL, sizeof(Trace_ring), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (ring == MAP_FAILED) {
+    return;
+  }
+  if (ring->magic != TRACE_MAGIC || ring->records != TRACE_RING_RECORDS) {
+    munmap(ring, sizeof(Trace_ring));
+    return;
+  }
+
+  char *process = strndup(ring->process, TRACE_PROCESS_MAX);
+  uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  uint32_t held = head < TRACE_RING_RECORDS ? head : TRACE_RING_RECORDS;
+  for (uint32_t n = 0; n < held; n++) {
+    uint32_t index = head - held + n;
+    const Trace_record *slot = &ring->ring[index & (TRACE_RING_RECORDS - 1)];
+    Trace_record copy;
+    uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    memcpy(&copy, slot, sizeof(copy));
+    atomic_thread_fence(memory_order_acquire);
+    /* Skip a record being written, or already overwritten by a newer one */
+    if (seq != index + 1 ||
+        atomic_load_explicit(&slot->seq, memory_order_relaxed) != seq ||
+        copy.event >= TRACE_EVENTS) {
+      continue;
+    }
+    add_entry(&copy, process);
+  }
+  munmap(ring, sizeof(Trace_ring));
+}
+
+static int compare_time(const void *a, const void *b) {
+  uint64_t x = ((const Entry *)a)->record.time_ns;
+  uint64_t y = ((const Entry *)b)->record.time_ns;
+  return (x > y) - (x < y);
+}
+
+static int wanted(const char *process, char **names, int name_count) {
+  if (name_count == 0) {
+    return 1;
+  }
+  for (int i = 0; i < name_count; i++) {
+    if (strcmp(process, names[i]) == 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* ========================================================================
+ * Key to sound (-k)
+ * ======================================================================== */
+
+/* Two key records with kernel times this close are the same key event */
+#define KEY_MATCH_NS 2000000
+
+/* The points a key's answer passes, in order; hop p ends at point p */
+enum {
+  KEY_KERNEL,
+  KEY_HAL,
+  KEY_RECEIVED,
+  KEY_DISPATCHED,
+  KEY_QUEUED,
+  KEY_SENT,
+  KEY_BEGUN,
+  KEY_FIRST_AUDIO,
+  KEY_SOUND,
+  KEY_POINTS
+};
+
+static const char *const hop_names[KEY_POINTS] = {
+    "", "HAL", "SW2", "Disp", "Mode", "Queue", "Audio", "TTS", "PCM"};
+
+/* Histogram bucket limits, in ms; the last bucket is the rest */
+#define KEY_BUCKETS 7
+static const double key_bucket_ms[KEY_BUCKETS - 1] = {20,  50,  100,
+                                                      200, 500, 1000};
+static const char *const key_bucket_names[KEY_BUCKETS] = {
+    "<20", "<50", "<100", "<200", "<500", "<1000", "more"};
+
+typedef struct Key_path {
+  char key;
+  uint64_t at[KEY_POINTS]; /* ns, 0 if not found */
+} Key_path;
+
+/* When the kernel stamped the key of a record whose last argument is its
+ * age (hampod_trace_key_age_us()), or 0 */
+static uint64_t kernel_time(const Trace_record *record) {
+  uint64_t age_ns = (uint64_t)record->arg[2] * 1000;
+  return record->arg[2] != 0 && age_ns < record->time_ns
+             ? record->time_ns - age_ns
+             : 0;
+}
+
+static uint64_t time_diff(uint64_t a, uint64_t b) {
+  return a > b ? a - b : b - a;
+}
+
+/* Newest record before index of event for the same key event */
+static size_t find_key_before(size_t index, Trace_event event, char key,
+                              uint64_t kernel_ns) {
+  for (size_t i = index; i-- > 0;) {
+    const Trace_record *record = &entries[i].record;
+    if (record->time_ns + KEY_MATCH_NS < kernel_ns) {
+      break; /* Before the key happened */
+    }
+    if (record->event == event && (char)record->arg[0] == key &&
+        time_diff(kernel_time(record), kernel_ns) <= KEY_MATCH_NS) {
+      return i;
+    }
+  }
+  return SIZE_MAX;
+}
+
+/* First record from index on of event with arg[0] equal to value */
+static size_t find_after(size_t index, Trace_event event, uint32_t value) {
+  for (size_t i = index; i < entry_count; i++) {
+    const Trace_record *record = &entries[i].record;
+    if (record->event == event && record->arg[0] == value) {
+      return i;
+    }
+  }
+  return SIZE_MAX;
+}
+
+/* Follow the key dispatched at index through the rings */
+static void follow_key(size_t index, Key_path *path) {
+  const Trace_record *dispatch = &entries[index].record;
+  memset(path, 0, sizeof(*path));
+  path->key = (char)dispatch->arg[0];
+  path->at[KEY_DISPATCHED] = dispatch->time_ns;
+
+  uint64_t kernel_ns = kernel_time(dispatch);
+  if (kernel_ns != 0) {
+    path->at[KEY_KERNEL] = kernel_ns;
+    size_t received =
+        find_key_before(index, TRACE_KEY_RECEIVED, path->key, kernel_ns);
+    if (received != SIZE_MAX) {
+      path->at[KEY_RECEIVED] = entries[received].record.time_ns;
+      index = received;
+    }
+    size_t read = find_key_before(index, TRACE_KEY, path->key, kernel_ns);
+    if (read != SIZE_MAX) {
+      path->at[KEY_HAL] = entries[read].record.time_ns;
+    }
+  }
+
+  uint32_t key_id = dispatch->arg[1];
+  size_t queued = find_after(index, TRACE_KEY_QUEUED, key_id);
+  if (key_id == 0 || queued == SIZE_MAX) {
+    return; /* No speech answered it */
+  }
+  path->at[KEY_QUEUED] = entries[queued].record.time_ns;
+  size_t sent = find_after(queued, TRACE_KEY_SPEECH, key_id);
+  if (sent == SIZE_MAX) {
+    return;
+  }
+  const Trace_record *speech = &entries[sent].record;
+  uint32_t tag = speech->arg[1];
+  path->at[KEY_SENT] = speech->time_ns - (uint64_t)speech->arg[2] * 1000;
+
+  /* The audio process may start the request before the send returns */
+  size_t begun = find_after(queued, TRACE_AUDIO_BEGIN, tag);
+  if (begun == SIZE_MAX) {
+    return;
+  }
+  path->at[KEY_BEGUN] = entries[begun].record.time_ns;
+  size_t sound = find_after(begun, TRACE_AUDIO_SOUND, tag);
+  for (size_t i = begun + 1; i < entry_count && i < sound; i++) {
+    const Trace_record *record = &entries[i].record;
+    if (entries[i].process != entries[begun].process) {
+      continue;
+    }
+    if (record->event == TRACE_AUDIO_BEGIN) {
+      break; /* The next request's */
+    }
+    if (record->event == TRACE_TTS_FIRST_AUDIO) {
+      path->at[KEY_FIRST_AUDIO] = record->time_ns;
+      break;
+    }
+  }
+  if (sound != SIZE_MAX) {
+    path->at[KEY_SOUND] = entries[sound].record.time_ns;
+  }
+}
+
+/* Hop p of a path in ms, from the last point found before it; -1 if its
+ * end was not found */
+static double hop_ms(const Key_path *path, int p) {
+  if (path->at[p] == 0) {
+    return -1;
+  }
+  for (int from = p - 1; from >= 0; from--) {
+    if (path->at[from] != 0) {
+      return path->at[p] > path->at[from]
+                 ? (path->at[p] - path->at[from]) / 1e6
+                 : 0;
+    }
+  }
+  return -1;
+}
+
+/* Key to sound in ms, from the first point found */
+static double total_ms(const Key_path *path) {
+  for (int p = 0; p < KEY_SOUND; p++) {
+    if (path->at[p] != 0) {
+      return (path->at[KEY_SOUND] - path->at[p]) / 1e6;
+    }
+  }
+  return 0;
+}
+
+static int compare_double(const void *a, const void *b) {
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+/* values[] sorted in place; prints p50, p90 and max */
+static void print_spread(double *values, size_t count) {
+  qsort(values, count, sizeof(double), compare_double);
+  printf(" %7.1f %7.1f %7.1f", values[count / 2], values[count * 9 / 10],
+         values[count - 1]);
+}
+
+static void print_key_row(const char *label, const Key_path *paths,
+                          size_t path_count, char key, double *scratch) {
+  size_t count = 0;
+  size_t buckets[KEY_BUCKETS] = {0};
+  for (size_t i = 0; i < path_count; i++) {
+    if (key != '\0' && paths[i].key != key) {
+      continue;
+    }
+    double ms = total_ms(&paths[i]);
+    int b = 0;
+    while (b < KEY_BUCKETS - 1 && ms >= key_bucket_ms[b]) {
+      b++;
+    }
+    buckets[b]++;
+    scratch[count++] = ms;
+  }
+  if (count == 0) {
+    return;
+  }
+  printf("%-4s %5zu", label, count);
+  print_spread(scratch, count);
+  for (int b = 0; b < KEY_BUCKETS; b++) {
+    printf(" %5zu", buckets[b]);
+  }
+  printf("\n");
+}
+
+/* Slowest first */
+static int compare_total(const void *a, const void *b) {
+  double x = total_ms((const Key_path *)a);
+  double y = total_ms((const Key_path *)b);
+  return (x < y) - (x > y);
+}
+
+static int key_report(size_t slowest) {
+  size_t dispatched = 0;
+  size_t path_count = 0;
+  Key_path *paths = malloc(entry_count * sizeof(Key_path));
+  double *scratch = malloc(entry_count * sizeof(double));
+  if (paths == NULL || scratch == NULL) {
+    perror("malloc");
+    return 1;
+  }
+  for (size_t i = 0; i < entry_count; i++) {
+    if (entries[i].record.event != TRACE_KEY_DISPATCH) {
+      continue;
+    }
+    dispatched++;
+    follow_key(i, &paths[path_count]);
+    if (paths[path_count].at[KEY_SOUND] != 0) {
+      path_count++;
+    }
+  }
+  if (dispatched == 0) {
+    printf("No dispatched keys in the trace rings\n");
+    return 1;
+  }
+  printf("Key to sound: %zu keys, %zu answered with sound\n", dispatched,
+         path_count);
+  if (path_count == 0) {
+    printf("(No speech queued within %d ms of a key, or its records were "
+           "overwritten)\n",
+           TRACE_KEY_CLAIM_MS);
+    return 0;
+  }
+
+  printf("\nKey to sound, ms:\n%-4s %5s %7s %7s %7s", "Key", "Count", "p50",
+         "p90", "max");
+  for (int b = 0; b < KEY_BUCKETS; b++) {
+    printf(" %5s", key_bucket_names[b]);
+  }
+  printf("\n");
+  int seen[256] = {0};
+  for (size_t i = 0; i < path_count; i++) {
+    unsigned char key = (unsigned char)paths[i].key;
+    if (!seen[key]) {
+      seen[key] = 1;
+      char label[2] = {(char)key, '\0'};
+      print_key_row(label, paths, path_count, (char)key, scratch);
+    }
+  }
+  print_key_row("All", paths, path_count, '\0', scratch);
+
+  printf("\nHops, ms:\n%-6s %5s %7s %7s %7s\n", "Hop", "Count", "p50", "p90",
+         "max");
+  for (int p = 1; p < KEY_POINTS; p++) {
+    size_t count = 0;
+    for (size_t i = 0; i < path_count; i++) {
+      double ms = hop_ms(&paths[i], p);
+      if (ms >= 0) {
+        scratch[count++] = ms;
+      }
+    }
+    printf("%-6s %5zu", hop_names[p], count);
+    if (count > 0) {
+      print_spread(scratch, count);
+    }
+    printf("\n");
+  }
+
+  qsort(paths, path_count, sizeof(Key_path), compare_total);
+  if (slowest > path_count) {
+    slowest = path_count;
+  }
+  printf("\nSlowest %zu (ms, - where a hop's records are missing):\n",
+         slowest);
+  printf("%10s %3s %8s", "Boot s", "Key", "Total");
+  for (int p = 1; p < KEY_POINTS; p++) {
+    printf(" %6s", hop_names[p]);
+  }
+  printf("\n");
+  for (size_t i = 0; i < slowest; i++) {
+    const Key_path *path = &paths[i];
+    printf("%10.3f %3c %8.1f", path->at[KEY_DISPATCHED] / 1e9, path->key,
+           total_ms(path));
+    for (int p = 1; p < KEY_POINTS; p++) {
+      double ms = hop_ms(path, p);
+      if (ms >= 0) {
+        printf(" %6.1f", ms);
+      } else {
+        printf(" %6s", "-");
+      }
+    }
+    printf("\n");
+  }
+  free(paths);
+  free(scratch);
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  size_t count = 0;
+  int all = 0;
+  int keys = 0;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:ak")) != -1) {
+    if (opt == 'n') {
+      count = (size_t)atol(optarg);
+    } else if (opt == 'a') {
+      all = 1;
+    } else if (opt == 'k') {
+      keys = 1;
+    } else {
+      fprintf(stderr, "Usage: %s [-n COUNT] [-a] [-k] [PROCESS...]\n",
+              argv[0]);
+      return 1;
+    }
+  }
+
+  DIR *dir = opendir(TRACE_DIR);
+  if (dir == NULL) {
+    perror(TRACE_DIR);
+    return 1;
+  }
+  size_t prefix_len = strlen(TRACE_FILE_PREFIX);
+  struct dirent *dirent;
+  while ((dirent = readdir(dir)) != NULL) {
+    const char *name = dirent->d_name;
+    if (strncmp(name, TRACE_FILE_PREFIX, prefix_len) != 0 ||
+        !wanted(name + prefix_len, argv + optind, argc - optind)) {
+      continue;
+    }
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", TRACE_DIR, name);
+    read_ring(path);
+  }
+  closedir(dir);
+
+  if (entry_count == 0) {
+    printf("No trace records in %s/%s*\n", TRACE_DIR, TRACE_FILE_PREFIX);
+    return 1;
+  }
+  qsort(entries, entry_count, sizeof(Entry), compare_time);
+  if (keys) {
+    return key_report(count != 0 ? count : DEFAULT_SLOWEST);
+  }
+  if (count == 0) {
+    count = DEFAULT_COUNT;
+  }
+
+  /* Times are printed relative to the newest record, and as seconds since
+   * boot so they line up with the journal's monotonic stamps */
+  uint64_t last_ns = entries[entry_count - 1].record.time_ns;
+  size_t first = all || count >= entry_count ? 0 : entry_count - count;
+  printf("%14s %10s  %-14s  %s\n", "Since boot s", "Ago ms",
+         "Process/thread", "Event");
+  for (size_t i = first; i < entry_count; i++) {
+    const Entry *entry = &entries[i];
+    const Trace_record *record = &entry->record;
+    char who[40];
+    snprintf(who, sizeof(who), "%s/%u", entry->process, record->thread);
+    printf("%14.6f %10.3f  %-14s  %s", record->time_ns / 1e9,
+           (last_ns - record->time_ns) / 1e6, who,
+           event_names[record->event]);
+    if (event_formats[record->event][0] != '\0') {
+      printf(" ");
+      printf(event_formats[record->event], record->arg[0], record->arg[1],
+             record->arg[2]);
+    }
+    printf("\n");
+  }
+  return 0;
+}
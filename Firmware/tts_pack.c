@@ -0,0 +1,90 @@
+/* Build and install TTS cache packs
+ *
+ * A unit's TTS cache otherwise fills by speaking: each prompt, announcement
+ * word and band number is synthesized the first time it is needed, or by
+ * the background pass after start-up. A cache pack (hal_tts_cache.h) holds
+ * all of them for one voice model and speed, synthesized once on a fast
+ * machine, so units it is installed on are warm from their first boot.
+ *
+ * Usage: tts_pack build PACK [SPEED]
+ *          Synthesize with this build's engine and voice model (the same
+ *          environment as firmware.elf: HAMPOD_TTS_ENGINE, the Piper model
+ *          ...) at SPEED (hampod.conf's speech_speed; the build's default
+ *          if not given), and write PACK. Run it from Firmware's
+ *          directory, where the prewarm manifest and models are.
+ *        tts_pack install PACK...
+ *          Add the packs' entries to this user's TTS cache
+ *          (HAMPOD_TTS_CACHE_DIR). Stop HAMPOD first.
+ *
+ * A pack only helps units with the same voice model file (name and size)
+ * and speed; its entries are otherwise never looked up, and make way as
+ * the cache evicts.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hal/hal_tts.h"
+#include "hal/hal_tts_cache.h"
+#include "hal/hal_tts_fragments.h"
+
+static int usage(const char *program) {
+  fprintf(stderr,
+          "Usage: %s build PACK [SPEED]\n"
+          "       %s install PACK...\n",
+          program, program);
+  return 1;
+}
+
+static int build(const char *path, const char *speed_arg) {
+  float speed = 0.0f;
+  if (speed_arg != NULL) {
+    speed = (float)atof(speed_arg);
+    if (speed < 0.1f || speed > 3.0f) { /* What the engines accept */
+      fprintf(stderr, "Speed must be 0.1 to 3.0: %s\n", speed_arg);
+      return 1;
+    }
+  } else {
+#ifdef PIPER_SPEED
+    speed = (float)atof(PIPER_SPEED);
+#else
+    speed = 1.0f;
+#endif
+  }
+
+  /* Set before the engine starts, so it does not warm up at another */
+  hal_tts_set_speed(speed);
+  if (hal_tts_init() != 0) {
+    fprintf(stderr, "Cannot start %s\n", hal_tts_get_impl_name());
+    return 1;
+  }
+  printf("Building %s with %s at speed %.2f\n", path, hal_tts_get_impl_name(),
+         speed);
+  int written = hal_tts_fragments_build_pack(path, speed);
+  hal_tts_cleanup();
+  hal_tts_cache_cleanup();
+  if (written < 0) {
+    return 1;
+  }
+  printf("%d entries written to %s\n", written, path);
+  return 0;
+}
+
+static int install(int count, char *paths[]) {
+  int failed = 0;
+  for (int i = 0; i < count; i++) {
+    failed |= hal_tts_cache_import(paths[i]) < 0;
+  }
+  hal_tts_cache_cleanup(); /* Waits for the writes */
+  return failed;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc >= 3 && argc <= 4 && strcmp(argv[1], "build") == 0) {
+    return build(argv[2], argc == 4 ? argv[3] : NULL);
+  }
+  if (argc >= 3 && strcmp(argv[1], "install") == 0) {
+    return install(argc - 2, &argv[2]);
+  }
+  return usage(argv[0]);
+}
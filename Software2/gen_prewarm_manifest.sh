@@ -0,0 +1,42 @@
+#!/bin/bash
+# =============================================================================
+# HAMPOD2026 - Generate the TTS prewarm manifest
+# =============================================================================
+# Collects the fixed phrases Software2 speaks - string literals passed to
+# speech_say_text(), speech_sequence_add_text(), announce_text() or
+# announce_label(), and literals without a format specifier printed into
+# a buffer with snprintf() - into the
+# manifest Firmware synthesizes into its TTS cache while idle, so a new
+# unit answers from the cache from the first keypress.
+#
+# Usage:
+#   cd ~/HAMPOD2026/Software2
+#   ./gen_prewarm_manifest.sh               # Writes ../Firmware/tts_prewarm.txt
+#   ./gen_prewarm_manifest.sh out.txt       # Writes out.txt
+#
+# Run it (or `make prewarm`) after adding or changing a spoken phrase.
+# =============================================================================
+
+set -euo pipefail
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+OUTPUT="${1:-$SCRIPT_DIR/../Firmware/tts_prewarm.txt}"
+
+# Everything the hampod binary is built from (main_phase0.c is a test)
+SOURCES=()
+for src in "$SCRIPT_DIR"/src/*.c; do
+    [ "$(basename "$src")" = "main_phase0.c" ] || SOURCES+=("$src")
+done
+
+{
+    echo "# TTS prewarm manifest: one phrase per line, '#' starts a comment."
+    echo "# Generated by Software2/gen_prewarm_manifest.sh - do not edit."
+    {
+        grep -ho 'speech_say_text(.*\|speech_sequence_add_text(.*\|announce_text(.*\|announce_label(.*' \
+            "${SOURCES[@]}" | grep -o '"[^"]*"' || true
+        grep -ho 'snprintf([^,]*, *sizeof([^)]*), *"[^"%]*")' \
+            "${SOURCES[@]}" | grep -o '"[^"]*"' || true
+    } | sed 's/^"//; s/"$//' | grep -v '^ *$' | LC_ALL=C sort -u
+} > "$OUTPUT"
+
+echo "Wrote $(grep -vc '^#' "$OUTPUT") phrases to $OUTPUT"
@@ -0,0 +1,115 @@
+#!/bin/bash
+# =============================================================================
+# HAMPOD2026 - Generate the built-in radio definitions
+# =============================================================================
+# Turns config/radios.conf into src/radio_defs_builtin.h, the static table
+# radio_defs.c starts from (see include/radio_defs.h). `make` runs it when
+# the file changes. A field name it does not know stops the build there,
+# as RADIO_FIELD_<NAME> is not declared.
+#
+# Usage:
+#   cd ~/HAMPOD2026/Software2
+#   ./gen_radio_defs.sh                              # Default paths
+#   ./gen_radio_defs.sh radios.conf out.h            # Other files
+# =============================================================================
+
+set -euo pipefail
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+INPUT="${1:-$SCRIPT_DIR/config/radios.conf}"
+OUTPUT="${2:-$SCRIPT_DIR/src/radio_defs_builtin.h}"
+
+awk '
+function fail(msg) {
+    printf "%s:%d: %s\n", FILENAME, FNR, msg > "/dev/stderr"
+    failed = 1
+    exit 1
+}
+function flag(value) {
+    if (value == "yes") return "RADIO_DEF_YES"
+    if (value == "no") return "RADIO_DEF_NO"
+    fail("expected yes or no, not \"" value "\"")
+}
+function mask(value,    n, names, i, out) {
+    n = split(value, names, /[ \t,]+/)
+    out = ""
+    for (i = 1; i <= n; i++) {
+        if (names[i] == "") continue
+        out = out (out == "" ? "" : " | ") \
+              "(1u << RADIO_FIELD_" toupper(names[i]) ")"
+    }
+    return out == "" ? "0" : out
+}
+function quote(value) {
+    gsub(/\\/, "\\\\", value)
+    gsub(/"/, "\\\"", value)
+    return "\"" value "\""
+}
+function close_entry() {
+    if (model != "") {
+        print "    {.model = " model ","
+        for (i = 1; i <= nfields; i++) {
+            print "     " fields[i] (i < nfields ? "," : "},")
+        }
+        if (nfields == 0) {
+            print "    },"
+        }
+    }
+    nfields = 0
+}
+BEGIN {
+    print "// Built-in radio definitions (radio_defs.h), from config/radios.conf."
+    print "// Generated by gen_radio_defs.sh - do not edit."
+    print ""
+    print "static const RadioDef g_builtin_defs[] = {"
+}
+{
+    sub(/#.*/, "")
+    gsub(/^[ \t]+|[ \t]+$/, "")
+}
+/^$/ { next }
+/^\[model [0-9]+\]$/ {
+    close_entry()
+    model = $2
+    sub(/\]/, "", model)
+    next
+}
+/^\[/ { fail("expected [model N]") }
+{
+    if (model == "") fail("setting before the first [model N]")
+    eq = index($0, "=")
+    if (eq == 0) fail("expected key = value")
+    key = substr($0, 1, eq - 1)
+    value = substr($0, eq + 1)
+    gsub(/^[ \t]+|[ \t]+$/, "", key)
+    gsub(/^[ \t]+|[ \t]+$/, "", value)
+
+    if (key == "name" || key ~ /^vfo_(a|b|current)$/) {
+        field = "." key " = " quote(value)
+    } else if (key == "no_get" || key == "no_set") {
+        field = "." key " = " mask(value)
+    } else if (key == "transceive" || key == "vfo_query") {
+        field = "." key " = " flag(value)
+    } else if (key == "poll_fast_ms" || key == "poll_idle_ms") {
+        if (value !~ /^[0-9]+$/) fail("expected milliseconds")
+        field = "." key " = " value
+    } else if (key == "health_probe") {
+        if (value != "freq" && value != "smeter") {
+            fail("expected freq or smeter")
+        }
+        field = ".health_probe = RADIO_PROBE_" toupper(value)
+    } else {
+        fail("unknown setting \"" key "\"")
+    }
+    fields[++nfields] = field
+}
+END {
+    if (failed) exit 1
+    close_entry()
+    print "    {.model = 0}, // End"
+    print "};"
+}
+' "$INPUT" > "$OUTPUT.tmp" || { rm -f "$OUTPUT.tmp"; exit 1; }
+mv "$OUTPUT.tmp" "$OUTPUT"
+
+echo "Wrote $(grep -c '^    {.model = [1-9]' "$OUTPUT") radio definitions to $OUTPUT"
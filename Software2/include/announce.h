@@ -0,0 +1,250 @@
+/**
+ * @file announce.h
+ * @brief Announcements built from typed segments, shared by all modes
+ *
+ * A mode says what an announcement is made of - a label, a number, a
+ * digit string, a unit, an enum word such as a mode name - and this
+ * module decides how each part is spoken:
+ *   - numbers, digits, units and enum words become word segments, which
+ *     Firmware plays from its per-word cache without TTS inference;
+ *   - labels and free text are spoken by TTS (prewarmed, see
+ *     gen_prewarm_manifest.sh);
+ *   - clips are pre-recorded files.
+ *
+ * Adjacent word segments are sent as one words run, so "14 point 2 5
+ * megahertz" is a single cached readout. Terse and verbose wording (unit
+ * names, trailing zeros, "VFO" prefixes, mode names, the level of a
+ * switch that is off) is decided here, in one place, by the style, which
+ * Config Mode switches live.
+ *
+ * Usage:
+ *   Announcement a;
+ *   announce_init(&a);
+ *   announce_label(&a, "Power set to", "Power");
+ *   announce_number(&a, 50);
+ *   announce_unit(&a, ANNOUNCE_UNIT_PERCENT);
+ *   announce_say(&a, SPEECH_INTERACTIVE);
+ */
+
+#ifndef ANNOUNCE_H
+#define ANNOUNCE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "speech.h"
+
+#define ANNOUNCE_MAX_SEGMENTS 16
+#define ANNOUNCE_SEGMENT_MAX 64
+
+/**
+ * @brief How much is said
+ */
+typedef enum {
+  ANNOUNCE_VERBOSE = 0, // Full labels and units (default)
+  ANNOUNCE_TERSE        // Short labels, short or no units
+} AnnounceStyle;
+
+/**
+ * @brief Kind of segment, which decides how it is spoken
+ */
+typedef enum {
+  ANNOUNCE_SEG_TEXT = 0, // TTS
+  ANNOUNCE_SEG_NUMBER,   // Word: "14", "minus 6"
+  ANNOUNCE_SEG_DIGITS,   // Words, one per digit: "2 5 0"
+  ANNOUNCE_SEG_UNIT,     // Word: "megahertz", "percent"
+  ANNOUNCE_SEG_WORD,     // Word: "on", "USB", "point"
+  ANNOUNCE_SEG_CLIP      // Pre-recorded file
+} AnnounceSegmentType;
+
+/**
+ * @brief Units, spoken in the current style
+ */
+typedef enum {
+  ANNOUNCE_UNIT_MEGAHERTZ = 0,
+  ANNOUNCE_UNIT_KILOHERTZ,
+  ANNOUNCE_UNIT_HERTZ,
+  ANNOUNCE_UNIT_PERCENT,
+  ANNOUNCE_UNIT_DECIBELS,
+  ANNOUNCE_UNIT_WATTS,
+  ANNOUNCE_UNIT_COUNT
+} AnnounceUnit;
+
+typedef struct {
+  AnnounceSegmentType type;
+  char text[ANNOUNCE_SEGMENT_MAX];
+} AnnounceSegment;
+
+typedef struct {
+  AnnounceSegment segments[ANNOUNCE_MAX_SEGMENTS];
+  int count;
+  bool overflow; // A segment did not fit; the announcement is refused
+} Announcement;
+
+// ============================================================================
+// Style
+// ============================================================================
+
+/**
+ * @brief Set how much every announcement says
+ */
+void announce_set_style(AnnounceStyle style);
+
+/**
+ * @brief Get the current style
+ */
+AnnounceStyle announce_get_style(void);
+
+// ============================================================================
+// Building
+// ============================================================================
+
+/**
+ * @brief Start an empty announcement
+ */
+void announce_init(Announcement *a);
+
+/**
+ * @brief Append free text, spoken by TTS
+ * @return HAMPOD_OK, or HAMPOD_ERROR if it does not fit
+ */
+int announce_text(Announcement *a, const char *text);
+
+/**
+ * @brief Append a label with its verbose and terse wording
+ *
+ * @param terse Terse wording; NULL uses the verbose one, "" says nothing
+ * @return HAMPOD_OK, or HAMPOD_ERROR if it does not fit
+ */
+int announce_label(Announcement *a, const char *verbose, const char *terse);
+
+/**
+ * @brief Append a whole number, as one cached word
+ * @return HAMPOD_OK, or HAMPOD_ERROR if it does not fit
+ */
+int announce_number(Announcement *a, long value);
+
+/**
+ * @brief Append a digit string, spoken one digit at a time
+ *
+ * Anything but digits is skipped, so "14.250" reads "1 4 2 5 0".
+ * @return HAMPOD_OK, or HAMPOD_ERROR if it does not fit
+ */
+int announce_digits(Announcement *a, const char *digits);
+
+/**
+ * @brief Append a unit, in the current style (may say nothing when terse)
+ * @return HAMPOD_OK, or HAMPOD_ERROR if it does not fit or is unknown
+ */
+int announce_unit(Announcement *a, AnnounceUnit unit);
+
+/**
+ * @brief Append a word from a fixed set (a mode, "on", "off"), as one
+ *        cached word
+ * @return HAMPOD_OK, or HAMPOD_ERROR if it does not fit
+ */
+int announce_word(Announcement *a, const char *word);
+
+/**
+ * @brief Append a pre-recorded clip (path as for speech_play_file())
+ * @return HAMPOD_OK, or HAMPOD_ERROR if it does not fit
+ */
+int announce_clip(Announcement *a, const char *filepath);
+
+/**
+ * @brief Append a frequency: "14 point 2 5 0 0 0 megahertz"
+ *
+ * Whole megahertz, then the five digits to 10 Hz, truncated like the
+ * radio's display. Terse drops trailing zeros and the unit.
+ * @return HAMPOD_OK, or HAMPOD_ERROR for a negative frequency (nothing
+ *         is appended) or if it does not fit
+ */
+int announce_frequency(Announcement *a, double freq_hz);
+
+/**
+ * @brief Append only what changed since the last frequency announced
+ *
+ * For dial updates. Within the same megahertz, a move across kilohertz
+ * reads the kilohertz within the megahertz ("253 point 5 kilohertz") and
+ * a smaller one the hertz within the kilohertz ("500 hertz"). The unit
+ * stays in terse style ("k"), as it tells the two apart. A new
+ * megahertz, or no last frequency, reads in full as announce_frequency().
+ * @param from_hz The frequency last announced, or <= 0 if none
+ * @return HAMPOD_OK, or HAMPOD_ERROR for a negative frequency (nothing
+ *         is appended) or if it does not fit
+ */
+int announce_frequency_change(Announcement *a, double from_hz,
+                              double to_hz);
+
+/**
+ * @brief Append "<label> on level <n>" or "<label> off level <n>"
+ *
+ * Terse says "<label> <n>" when on and only "<label> off" when off.
+ * @param level Level, or -1 if not known (terse then says "on")
+ * @return HAMPOD_OK, or HAMPOD_ERROR if it does not fit
+ */
+int announce_switch(Announcement *a, const char *label, bool on, int level);
+
+/**
+ * @brief Append an operating mode name ("USB", "CW Reverse") as words
+ *
+ * Terse shortens the long names: "CW R", "AM sync".
+ * @return HAMPOD_OK, or HAMPOD_ERROR if it does not fit
+ */
+int announce_mode(Announcement *a, const char *mode);
+
+/**
+ * @brief Append a VFO name ("VFO A.", "Current VFO")
+ *
+ * Terse drops the word "VFO": "A.", "Current".
+ * @return HAMPOD_OK, or HAMPOD_ERROR if it does not fit
+ */
+int announce_vfo(Announcement *a, const char *vfo);
+
+// ============================================================================
+// Speaking
+// ============================================================================
+
+/**
+ * @brief Turn an announcement into a speech sequence
+ *
+ * Adjacent number, digit, unit and word segments become one words
+ * segment (see speech_sequence_add_words()).
+ * @return HAMPOD_OK, or HAMPOD_ERROR if it is empty or does not fit
+ */
+int announce_render(const Announcement *a, SpeechSequence *seq);
+
+/**
+ * @brief What an announcement says, as one line of text (clips left out)
+ *
+ * For logs and tests.
+ * @return Length written
+ */
+int announce_to_text(const Announcement *a, char *buffer, size_t size);
+
+/**
+ * @brief Queue an announcement in a priority class
+ * @return HAMPOD_OK, or HAMPOD_ERROR if it is empty, does not fit or the
+ *         queue is full
+ */
+int announce_say(const Announcement *a, SpeechPriority priority);
+
+/**
+ * @brief Queue an announcement in a priority class and coalescing slot
+ *        (see speech_say_text_latest())
+ */
+int announce_say_latest(const Announcement *a, SpeechPriority priority,
+                        SpeechSlot slot, bool cut_off);
+
+/**
+ * @brief Have the words of an announcement synthesized ahead of time
+ *
+ * For an announcement that can be guessed before it is due (see
+ * speech_warm_words()); its text and clips are left alone, as they are
+ * prewarmed or recorded already.
+ * @return HAMPOD_OK, or HAMPOD_ERROR if it has no words or they could not
+ *         be sent
+ */
+int announce_warm(const Announcement *a);
+
+#endif // ANNOUNCE_H
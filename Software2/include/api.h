@@ -0,0 +1,61 @@
+/**
+ * @file api.h
+ * @brief Local control API: the radio's state and speech as a JSON stream
+ *
+ * With socket set in [api], a thread serves a Unix stream socket at that
+ * path. Every message either way is one JSON object on one line. A client
+ * is greeted with {"event":"hello","api":1} and a state event holding
+ * every field of the radio that is known, then gets an event for each
+ * change as it happens, with no polling:
+ *
+ *   {"event":"state","radio":{"freq":14074000,"mode":"USB",...}}
+ *   {"event":"radio","field":"freq","value":14074500}
+ *   {"event":"speech","type":"d","text":"14 point 0 7 4 5"}
+ *   {"event":"key","key":"5","hold":false}
+ *
+ * A client may send commands, each answered with a reply event:
+ *
+ *   {"cmd":"key","key":"5","hold":true}  - as if pressed on the keypad
+ *   {"cmd":"say","text":"hello"}         - speak, as a reply to a key
+ *   {"cmd":"state"}                      - a fresh state event
+ *
+ *   {"event":"reply","cmd":"key","ok":true}
+ *   {"event":"reply","cmd":"say","ok":false,"error":"speech not running"}
+ *
+ * Events are written without blocking; a client that does not keep up is
+ * disconnected rather than holding up speech or the radio. With no client
+ * connected an event costs one atomic load. WebSocket clients can reach
+ * it through a bridge such as "websocat -t ws-l:127.0.0.1:8080
+ * unix:/run/hampod/api.sock".
+ */
+
+#ifndef API_H
+#define API_H
+
+#include <stdbool.h>
+
+#define API_MAX_CLIENTS 8
+#define API_LINE_MAX 512 // Longest command line a client may send
+
+/**
+ * @brief Start serving the socket and streaming events
+ *
+ * Replaces a stale socket left at path. Sets the radio state and speech
+ * listeners (radio_state.h, speech.h).
+ *
+ * @param path Socket path
+ * @return HAMPOD_OK, or HAMPOD_ERROR if the socket or thread failed
+ */
+int api_start(const char *path);
+
+/**
+ * @brief Disconnect every client, stop the thread and remove the socket
+ */
+void api_stop(void);
+
+/**
+ * @brief Report a key event to the clients (repeats are not reported)
+ */
+void api_note_key(char key, bool is_hold);
+
+#endif // API_H
@@ -0,0 +1,107 @@
+/**
+ * @file band_stack.h
+ * @brief Per-band memory of the last frequency, mode and filter
+ *
+ * Like a rig's band stacking register: for each amateur band, where the
+ * operator last was. The polling callback remembers every frequency the
+ * radio reports, with the mode and passband the radio state cache holds
+ * at that moment, so leaving a band leaves its entry current.
+ *
+ * Recalling a band needs no radio read: normal_mode.c announces the
+ * stored values at once and queues one radio command that sets them.
+ * The memory is kept in RAM and written to BAND_STACK_DEFAULT_PATH when
+ * the operator changes band and at shutdown.
+ *
+ * The band memory has a lock of its own: the polling callback writes it
+ * while a band key reads it, and neither waits for the radio.
+ */
+
+#ifndef BAND_STACK_H
+#define BAND_STACK_H
+
+#include <stdbool.h>
+
+#define BAND_STACK_DEFAULT_PATH "config/band_stack.conf"
+
+/**
+ * @brief What is remembered for one band
+ */
+typedef struct {
+  double freq_hz;
+  int mode;        // Hamlib rmode_t, 0 to leave the radio's mode alone
+  int passband_hz; // 0 for the mode's normal passband
+} BandMemory;
+
+// ============================================================================
+// Lifecycle
+// ============================================================================
+
+/**
+ * @brief Load the memory saved by an earlier session
+ * @param path File to load and save, or NULL for BAND_STACK_DEFAULT_PATH
+ * @return 0 (a missing file leaves each band at its default frequency)
+ */
+int band_stack_init(const char *path);
+
+/**
+ * @brief Write the memory if it changed since it was last written
+ */
+void band_stack_save(void);
+
+// ============================================================================
+// Bands
+// ============================================================================
+
+/**
+ * @brief Number of bands, in frequency order
+ */
+int band_stack_count(void);
+
+/**
+ * @brief Band a frequency is in
+ * @return Band index, or -1 if outside every band
+ */
+int band_stack_find(double freq_hz);
+
+/**
+ * @brief Spoken band name ("20 meters")
+ * @return Name, or "Unknown band" for an invalid index
+ */
+const char *band_stack_name(int band);
+
+/**
+ * @brief A band's edges
+ * @return false for an invalid index
+ */
+bool band_stack_range(int band, double *low_hz, double *high_hz);
+
+/**
+ * @brief Band next to a frequency, wrapping around
+ *
+ * From outside every band, the nearest band in that direction.
+ *
+ * @param direction 1 for the next band up, -1 for the next one down
+ * @return Band index
+ */
+int band_stack_step(double freq_hz, int direction);
+
+// ============================================================================
+// Memory
+// ============================================================================
+
+/**
+ * @brief A band's remembered frequency, mode and passband
+ * @return false for an invalid index
+ */
+bool band_stack_get(int band, BandMemory *memory);
+
+/**
+ * @brief Remember a frequency in its band
+ *
+ * Takes the mode and passband from the radio state cache while they are
+ * fresh; otherwise the band keeps the ones it had. Outside every band it
+ * does nothing. Moving to another band writes the file.
+ */
+void band_stack_remember(double freq_hz);
+
+#endif // BAND_STACK_H
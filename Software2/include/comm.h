@@ -8,12 +8,24 @@
  * - Firmware_i: Software -> Firmware (we write audio requests)
  * - Keypad_o: (Legacy) Direct keypad output - NOT USED in packet mode
  *
+ * If Firmware was started with --socket, a Unix SOCK_SEQPACKET socket
+ * (Firmware/hampod.sock) replaces the Firmware_i/Firmware_o pair; see
+ * Firmware/hampod_transport.h. Set HAMPOD_TRANSPORT=fifo to force pipes.
+ *
+ * If Firmware was started with --shm-audio, TTS and file requests are
+ * written into a shared-memory ring (Firmware/hampod_shm_ring.h) instead
+ * of Firmware_i; their acks still arrive on Firmware_o. Set
+ * HAMPOD_SHM_AUDIO=0 to keep all audio on the pipe.
+ *
  * Communication uses binary packets (see Firmware/hampod_firm_packet.h):
  * - Packet_type (4 bytes): KEYPAD=0, AUDIO=1, SERIAL=2, CONFIG=3
  * - data_len (2 bytes): Length of payload
  * - tag (2 bytes): Sequence tag for matching requests/responses
  * - data (variable): Payload bytes
  *
+ * Framing is shared with Firmware via Firmware/hampod_frame.h: each packet
+ * goes out in one writev() and comes back through one buffered read().
+ *
  * Part of Phase 0: Core Infrastructure (Step 1.1, 1.2)
  */
 
@@ -39,11 +51,14 @@ typedef enum {
 // ============================================================================
 
 #define COMM_MAX_DATA_LEN 256
+#define COMM_MAX_TEXT_LEN 2048 // TTS text longer than a packet is fragmented
 
 typedef struct {
   PacketType type;
   unsigned short data_len;
   unsigned short tag;
+  unsigned short flags; // FRAME_FLAG_MORE: more fragments with this tag;
+                        // audio requests also carry their speech epoch
   unsigned char data[COMM_MAX_DATA_LEN];
 } CommPacket;
 
@@ -53,7 +68,8 @@ typedef struct {
 
 /**
  * Initialize communication with Firmware.
- * Opens Firmware_o (for reading) and Firmware_i (for writing).
+ * Connects to the Firmware socket if one is listening, otherwise opens
+ * Firmware_o (for reading) and Firmware_i (for writing).
  *
  * @return HAMPOD_OK on success, HAMPOD_ERROR on failure
  *
@@ -107,6 +123,135 @@ int comm_read_packet(CommPacket *packet);
  */
 int comm_read_keypad(char *key_out);
 
+// ============================================================================
+// Keypad Push Events (subscription mode)
+// ============================================================================
+
+// Mirrored from Firmware/keypad_firmware.h and Firmware/hal/hal_keypad.h
+#define COMM_KEYPAD_SUBSCRIBE 's'
+#define COMM_KEYPAD_SUBSCRIBE_ACK 'S'
+#define COMM_KEYPAD_SUBSCRIBE_HOLDS 'H'
+#define COMM_KEYPAD_SUBSCRIBE_CREDITS 'C'
+#define COMM_KEYPAD_CREDIT 'c'
+#define COMM_KEYPAD_PUSH_TAG 0xFFFF
+#define COMM_KEYPAD_PUSH_LEN 10
+
+#define COMM_KEY_ACTION_PRESS 1
+#define COMM_KEY_ACTION_RELEASE 2
+#define COMM_KEY_ACTION_REPEAT 3
+#define COMM_KEY_ACTION_HOLD 4
+
+/**
+ * Handler for keypad events pushed by Firmware.
+ *
+ * Runs on the router thread, so it must not block or wait for other
+ * Firmware responses - hand the event off to another thread instead.
+ *
+ * @param key Key symbol ('0'-'9', 'A'-'D', '*', '#')
+ * @param action COMM_KEY_ACTION_PRESS, _RELEASE, _REPEAT or _HOLD
+ * @param timestamp_us Kernel (evdev) event time in microseconds
+ */
+typedef void (*CommKeypadEventHandler)(char key, int action,
+                                       uint64_t timestamp_us);
+
+/**
+ * Register the handler for pushed keypad events (NULL to unregister).
+ *
+ * Pushed events that arrive with no handler registered are dropped.
+ */
+void comm_set_keypad_event_handler(CommKeypadEventHandler handler);
+
+/**
+ * Turn Firmware keypad push mode on or off.
+ *
+ * Must be called after comm_wait_ready() (the router must be running).
+ *
+ * @param enable true to have Firmware push key events as they happen
+ * @param hold_threshold_ms If > 0, ask Firmware to also push
+ *                          COMM_KEY_ACTION_HOLD once a key is down this long
+ * @param credits If > 0, the number of events Firmware may push before
+ *                it waits for comm_grant_keypad_credits(); 0 for no flow
+ *                control
+ * @param holds_out Set to whether Firmware agreed to push holds (may be NULL)
+ * @param credits_out Set to whether Firmware honours credits (may be NULL)
+ * @return HAMPOD_OK if Firmware acknowledged, HAMPOD_NOT_FOUND if Firmware
+ *         has no push support, HAMPOD_TIMEOUT if it did not answer,
+ *         HAMPOD_ERROR on failure
+ */
+int comm_subscribe_keypad(bool enable, int hold_threshold_ms, int credits,
+                          bool *holds_out, bool *credits_out);
+
+/**
+ * Let Firmware push more keypad events (after subscribing with credits).
+ *
+ * Firmware holds events in its ring while it has no credits, so grant as
+ * many as were taken off the receiving queue. Not answered, so it never
+ * waits and may be called on the event loop.
+ *
+ * @param credits Events to add, 1-65535
+ * @return HAMPOD_OK if sent, HAMPOD_ERROR otherwise
+ */
+int comm_grant_keypad_credits(int credits);
+
+// ============================================================================
+// Voice Commands
+// ============================================================================
+
+// Mirrored from Firmware/keypad_firmware.h
+#define COMM_VOICE_TAG 0xFFFE
+#define COMM_VOICE_FREQUENCY 'f'
+#define COMM_VOICE_MODE 'm'
+
+/**
+ * Handler for spoken commands pushed by Firmware. Spoken keys are not
+ * among them: they arrive as ordinary keypad events.
+ *
+ * Runs on the router thread, so it must not block or wait for other
+ * Firmware responses.
+ *
+ * @param kind COMM_VOICE_FREQUENCY or COMM_VOICE_MODE
+ * @param arg Its argument: the frequency in Hz, or a mode name ("USB")
+ */
+typedef void (*CommVoiceCommandHandler)(char kind, const char *arg);
+
+/**
+ * Register the handler for spoken commands (NULL to unregister).
+ *
+ * Commands that arrive with no handler registered are dropped.
+ */
+void comm_set_voice_command_handler(CommVoiceCommandHandler handler);
+
+// ============================================================================
+// Keypad Event Ring (batch drain)
+// ============================================================================
+
+// Mirrored from Firmware/keypad_firmware.h
+#define COMM_KEYPAD_DRAIN 'e'
+#define COMM_KEYPAD_DRAIN_ACK 'E'
+#define COMM_KEYPAD_EVENT_LEN COMM_KEYPAD_PUSH_LEN
+#define COMM_KEYPAD_DRAIN_MAX 25
+
+/** One key event from the Firmware event ring */
+typedef struct {
+  char key;              // Key symbol
+  int action;            // COMM_KEY_ACTION_*
+  uint64_t timestamp_us; // Kernel (evdev) event time
+} CommKeyEvent;
+
+/**
+ * Drain key events Firmware captured since the last call (polling mode).
+ *
+ * Events come back oldest first with their kernel timestamps, so presses
+ * that happened between two polls keep their order and durations.
+ *
+ * @param events Output array, at least COMM_KEYPAD_DRAIN_MAX entries
+ * @param count_out Number of events written; COMM_KEYPAD_DRAIN_MAX means
+ *                  more may be waiting
+ * @return HAMPOD_OK on success, HAMPOD_NOT_FOUND if Firmware has no event
+ *         ring, HAMPOD_TIMEOUT if it did not answer, HAMPOD_ERROR on failure
+ */
+int comm_read_keypad_events(CommKeyEvent *events, int *count_out);
+
 // ============================================================================
 // Writing to Firmware
 // ============================================================================
@@ -127,12 +272,47 @@ int comm_send_packet(const CommPacket *packet);
  * @param payload The text to speak or file path to play
  * @return HAMPOD_OK on success, HAMPOD_ERROR on failure
  *
+ * TTS and file requests use the shared-memory ring when one is attached
+ * (falling back to the pipe if it is full); an interrupt also drops any
+ * ring requests Firmware has not started.
+ *
+ * TTS text that does not fit one packet (up to COMM_MAX_TEXT_LEN) is sent
+ * on the pipe as several fragments under one tag, split at sentence or
+ * word boundaries. Firmware speaks each fragment as it arrives and acks
+ * only the last one.
+ *
  * Example:
  *   comm_send_audio(AUDIO_TYPE_TTS, "Hello World");
  *   comm_send_audio(AUDIO_TYPE_FILE, "pregen_audio/5");
  */
 int comm_send_audio(char audio_type, const char *payload);
 
+/**
+ * Interrupt current audio without waiting for Firmware.
+ *
+ * Starts a new speech epoch: Firmware stops what is playing and skips
+ * queued requests sent before this call, while requests sent after it
+ * are stamped with the new epoch and play even if they reach Firmware
+ * first. It is sent under COMM_NO_REPLY_TAG, whose ack the router drops.
+ *
+ * @return HAMPOD_OK if the interrupt was sent, HAMPOD_ERROR otherwise
+ */
+int comm_interrupt_audio(void);
+
+/**
+ * Wait until the audio Firmware has been sent so far has been heard.
+ *
+ * Speak/play requests are acked once their audio is queued, while it
+ * still plays. This sends a played request (AUDIO_TYPE_PLAYED), which
+ * Firmware acks only once everything queued before it has played out of
+ * the sound card or been cut off.
+ *
+ * @param timeout_ms How long to wait; -1 for COMM_AUDIO_TIMEOUT_MS
+ * @return HAMPOD_OK once played, HAMPOD_TIMEOUT if still playing,
+ *         HAMPOD_ERROR if the request could not be sent
+ */
+int comm_wait_played(int timeout_ms);
+
 /**
  * Send audio and wait for Firmware acknowledgment.
  *
@@ -145,6 +325,32 @@ int comm_send_audio(char audio_type, const char *payload);
  */
 int comm_send_audio_sync(char audio_type, const char *payload);
 
+/**
+ * Send an audio request and register for its acknowledgment.
+ *
+ * Returns as soon as the request is sent. The ack is kept for this tag
+ * only; collect it with comm_poll_response() or comm_wait_response().
+ * Several requests may be in flight at once (up to COMM_MAX_PENDING).
+ *
+ * @param audio_type Audio type character
+ * @param payload Text or file path
+ * @param tag_out Receives the tag identifying this request
+ * @return HAMPOD_OK on success, HAMPOD_ERROR if the send failed or too many
+ *         requests are already outstanding
+ */
+int comm_send_audio_request(char audio_type, const char *payload,
+                            unsigned short *tag_out);
+
+// Mirrored from Firmware/audio_firmware.h: a speak/play request's ack is its
+// result int, then when Firmware received it, started synthesizing it, had
+// its first audio out and finished it, as the low 32 bits of
+// CLOCK_MONOTONIC in microseconds (0 if it did not get that far)
+#define COMM_AUDIO_ACK_INTS 5
+// Result of a request Firmware had no room to queue, answered at once
+#define COMM_AUDIO_RESULT_BUSY (-2)
+// Result of a sequence past its deadline (AUDIO_SEQ_EXPIRES), not played
+#define COMM_AUDIO_RESULT_EXPIRED (-3)
+
 /**
  * Send a configuration packet to Firmware.
  *
@@ -154,6 +360,106 @@ int comm_send_audio_sync(char audio_type, const char *payload);
  */
 int comm_send_config_packet(uint8_t sub_cmd, uint8_t value);
 
+// Mirrored from Firmware/keypad_firmware.h
+#define COMM_CONFIG_LOCAL_KEY_BEEP 0x02
+
+/**
+ * Turn Firmware's own key-down beep on or off.
+ *
+ * While on, the keypad process has the audio process play the keypress
+ * beep the moment a key goes down; Software should then not send its own
+ * keypress beeps (hold and error beeps are unaffected).
+ * Must be called after comm_wait_ready() (the router must be running).
+ *
+ * @param enable true to have Firmware beep on key-down
+ * @return HAMPOD_OK if Firmware acknowledged, HAMPOD_TIMEOUT if it did not
+ *         answer (older Firmware ignores the request), HAMPOD_ERROR on
+ *         failure
+ */
+int comm_set_local_key_beep(bool enable);
+
+// Mirrored from Firmware/audio_firmware.h
+#define COMM_CONFIG_AUDIO_VOLUME 0x03
+
+/**
+ * Set the output volume.
+ *
+ * Firmware applies it as a software gain on everything it plays (no mixer
+ * control is touched, so every audio dongle behaves the same) and ramps
+ * to the new level within one 10ms period. Returns once Firmware has
+ * applied it, so speech sent afterwards plays at the new volume.
+ * Must be called after comm_wait_ready() (the router must be running).
+ *
+ * @param percent Volume, 0-100 (clamped)
+ * @return HAMPOD_OK if Firmware acknowledged, HAMPOD_TIMEOUT if it did not
+ *         answer (older Firmware), HAMPOD_ERROR on failure
+ */
+int comm_set_volume(int percent);
+
+// Mirrored from Firmware/audio_firmware.h
+#define COMM_CONFIG_AUDIO_SPEED 0x04
+#define COMM_CONFIG_AUDIO_TTS_RAM 0x05
+#define COMM_CONFIG_AUDIO_PRIORITY 0x06
+
+/**
+ * Set speech speed for TTS.
+ *
+ * Firmware applies it from the next utterance; speech already cached at
+ * other speeds stays cached. Lower values = faster speech. Returns once
+ * Firmware has applied it.
+ * Must be called after comm_wait_ready() (the router must be running).
+ *
+ * @param speed Speed multiplier (0.1-2.0, clamped; 0.5 = faster, 1.0 =
+ *              normal), sent in hundredths
+ * @return HAMPOD_OK if Firmware acknowledged, HAMPOD_TIMEOUT if it did not
+ *         answer, HAMPOD_ERROR on failure
+ */
+int comm_set_speech_speed(float speed);
+
+/**
+ * Set how much RAM Firmware's TTS cache may use.
+ *
+ * Lowering it evicts the least recently used speech at once.
+ * Must be called after comm_wait_ready() (the router must be running).
+ *
+ * @param megabytes 0-255 (clamped); 0 keeps no speech in RAM
+ * @return HAMPOD_OK if Firmware acknowledged, HAMPOD_TIMEOUT if it did not
+ *         answer, HAMPOD_ERROR on failure
+ */
+int comm_set_tts_ram(int megabytes);
+
+/**
+ * Set the SCHED_FIFO priority of Firmware's playback thread.
+ *
+ * Must be called after comm_wait_ready() (the router must be running).
+ *
+ * @param priority 1-99, or 0 for normal scheduling (clamped)
+ * @return HAMPOD_OK if Firmware applied it, HAMPOD_TIMEOUT if it did not
+ *         answer, HAMPOD_ERROR on failure (including lacking the
+ *         privilege)
+ */
+int comm_set_audio_priority(int priority);
+
+// Mirrored from Firmware/hampod_session.h
+#define COMM_CONFIG_SESSION_PRIORITY 0x07
+#define COMM_SESSION_PRIORITY_LOW 0
+#define COMM_SESSION_PRIORITY_NORMAL 1
+#define COMM_SESSION_PRIORITY_MAIN 2
+
+/**
+ * Set this client's session priority with a Firmware serving several
+ * clients over --socket.
+ *
+ * The main session's speech plays ahead of other clients' and cannot be
+ * interrupted by them. comm_wait_ready() claims COMM_SESSION_PRIORITY_MAIN
+ * on a socket connection.
+ *
+ * @param priority One of COMM_SESSION_PRIORITY_*
+ * @return HAMPOD_OK if Firmware applied it, HAMPOD_TIMEOUT if it did not
+ *         answer (older Firmware), HAMPOD_ERROR on failure
+ */
+int comm_set_session_priority(int priority);
+
 // ============================================================================
 // Beep Audio Feedback
 // ============================================================================
@@ -172,27 +478,73 @@ typedef enum {
 /**
  * Request a beep from Firmware (non-blocking).
  *
- * This sends a beep request to Firmware which plays a pre-generated
- * beep audio file. Used for keypad feedback.
+ * This sends a beep request to Firmware, which synthesizes the beep's
+ * tone and mixes it in at once. Used for keypad feedback.
  *
  * @param beep_type The type of beep to play
  * @return HAMPOD_OK on success, HAMPOD_ERROR on failure
- *
- * @note Beep audio files must exist on RPi. Generate with:
- *       cd ~/HAMPOD2026/Firmware/pregen_audio && ./generate_beeps.sh
  */
 int comm_play_beep(CommBeepType beep_type);
 
 /**
- * Set speech speed for TTS.
+ * Change the tone a beep type plays (waits for Firmware's answer).
+ *
+ * @param beep_type The beep to change
+ * @param spec Tone as HZ[+HZ2][/MS[/LEVEL[/RAMP]]], e.g. "1200/40/60"
+ *             (see Firmware/hal/hal_audio_synth.h); NULL or "" restores
+ *             the default
+ * @return HAMPOD_OK on success, HAMPOD_ERROR if Firmware refused the
+ *         spec or did not answer
+ */
+int comm_set_beep_tone(CommBeepType beep_type, const char *spec);
+
+/**
+ * Play a synthesized tone (non-blocking).
  *
- * Sends a speed setting to Firmware which restarts Piper with the new
- * --length_scale value. Lower values = faster speech.
+ * Mixed in at once like a beep, past the speech queue.
  *
- * @param speed Speed multiplier (0.5 = faster, 1.0 = normal, 2.0 = slower)
+ * @param spec Tone as HZ[+HZ2][/MS[/LEVEL[/RAMP]]], e.g. "697+1209/200"
  * @return HAMPOD_OK on success, HAMPOD_ERROR on failure
  */
-int comm_set_speech_speed(float speed);
+int comm_play_tone(const char *spec);
+
+/**
+ * Echo a typed key with a pre-recorded clip (non-blocking).
+ *
+ * Sent like a beep, past the speech queue: Firmware mixes the clip in
+ * from RAM at once and a newer echo cuts off the one still playing, so
+ * fast digit entry is heard as it is typed. A clip Firmware has not
+ * preloaded is played in turn like speech_play_file().
+ *
+ * @param clip Clip path without ".wav", e.g. "pregen_audio/5"
+ * @return HAMPOD_OK on success, HAMPOD_ERROR on failure
+ */
+int comm_play_echo(const char *clip);
+
+/**
+ * Have Firmware synthesize words into its TTS cache (non-blocking).
+ *
+ * Sent past the speech queue like a beep; nothing plays. Firmware warms
+ * them one at a time in the background, a newer request replacing words
+ * it has not reached yet, so a readout spoken soon after finds them all
+ * cached.
+ *
+ * @param words Space-separated words, as for speech_sequence_add_words()
+ * @return HAMPOD_OK on success, HAMPOD_ERROR on failure
+ */
+int comm_warm_words(const char *words);
+
+/**
+ * Set the tuning tone (non-blocking).
+ *
+ * Firmware mixes a continuous tone of this pitch over everything else,
+ * gliding to each new pitch. It fades out on its own if not set again
+ * within 2 seconds, so a caller keeping it on resends it regularly.
+ *
+ * @param hz Pitch in Hz (100-4000), or 0 to turn the tone off
+ * @return HAMPOD_OK on success, HAMPOD_ERROR on failure
+ */
+int comm_set_tone(int hz);
 
 /**
  * Query the audio card number from Firmware.
@@ -205,12 +557,94 @@ int comm_set_speech_speed(float speed);
  */
 int comm_query_audio_card_number(int *card_number_out);
 
+// Ints in Firmware's info reply (Firmware/audio_firmware.h)
+#define COMM_AUDIO_INFO_INTS 5
+
+/** Firmware playback statistics (see hal_audio_get_stats()) */
+typedef struct {
+  int underruns;   // Device starved while audio was queued
+  int buffer_ms;   // Current ALSA buffer size
+  int min_fill_ms; // Lowest buffer fill before a write, last window
+  int resizes;     // ALSA buffer size changes since Firmware started
+} CommAudioStats;
+
+/**
+ * Query playback statistics from Firmware.
+ *
+ * Uses the same AUDIO_TYPE_INFO request as comm_query_audio_card_number();
+ * Firmware appends the statistics after the card number.
+ *
+ * @param stats_out Receives the statistics
+ * @return HAMPOD_OK on success, HAMPOD_ERROR if Firmware sent none
+ */
+int comm_query_audio_stats(CommAudioStats *stats_out);
+
+// Ints in Firmware's TTS statistics reply (Firmware/audio_firmware.h)
+#define COMM_TTS_STATS_INTS 25
+// Buckets of each time-to-first-audio histogram: under 25, 50, 100, 200,
+// 400, 800 and 1600 ms, then the rest
+#define COMM_TTS_LATENCY_BUCKETS 8
+
+/** Firmware TTS counters since it started (see hal_tts_get_stats()) */
+typedef struct {
+  int ram_hits;  // Cache lookups served from RAM
+  int disk_hits; // Cache lookups served from the SD card
+  int streamed;  // Of those, played straight from the card
+  int misses;    // Cache lookups that had to synthesize
+  int entries;   // Phrases in the cache
+  int evicted;   // Phrases deleted to stay within the disk budget
+  int disk_kb;   // Size of the cache on the card
+  int ram_kb;    // Size of the RAM tier
+  int first_audio_hit[COMM_TTS_LATENCY_BUCKETS];  // Cached requests
+  int first_audio_miss[COMM_TTS_LATENCY_BUCKETS]; // Synthesized requests
+} CommTtsStats;
+
+/**
+ * Query TTS cache and time-to-first-audio counters from Firmware.
+ *
+ * Sends an AUDIO_TYPE_TTS_STATS request and waits for the reply.
+ *
+ * @param stats_out Receives the counters
+ * @return HAMPOD_OK on success, HAMPOD_ERROR if Firmware sent none
+ */
+int comm_query_tts_stats(CommTtsStats *stats_out);
+
+// Ints in Firmware's CW decoder reply, before its text
+// (Firmware/audio_firmware.h)
+#define COMM_CW_REPLY_INTS 3
+
+/**
+ * Start or stop Firmware's CW decoder on the radio's receive audio.
+ *
+ * @param on true to start decoding, false to stop
+ * @return HAMPOD_OK on success, HAMPOD_ERROR if Firmware has no receive
+ *         audio to decode or did not answer
+ */
+int comm_cw_decoder(bool on);
+
+/**
+ * Poll Firmware's CW decoder for the text decoded since the last poll.
+ *
+ * @param text Receives the text, NUL-terminated; each word ends in a space
+ * @param size Size of text
+ * @param wpm Receives the sending speed (may be NULL)
+ * @param pitch_hz Receives the pitch followed (may be NULL)
+ * @return HAMPOD_OK if the decoder is running, HAMPOD_ERROR if it is not
+ *         or Firmware did not answer
+ */
+int comm_read_cw(char *text, size_t size, int *wpm, int *pitch_hz);
+
 // ============================================================================
-// Router Thread (dispatches responses to type-specific queues)
+// Router Thread (hands each response to the caller waiting for its tag)
 // ============================================================================
 
-// Response queue size for each packet type
-#define COMM_RESPONSE_QUEUE_SIZE 16
+// Requests that can wait on their own tagged response at once
+#define COMM_MAX_PENDING 16
+
+// Tag of the requests nobody waits for (interrupts, beeps, tones): they
+// take no pending slot, so they can never crowd out an ack that is waited
+// for, and the router drops their acks
+#define COMM_NO_REPLY_TAG 0xFFFD
 
 // Timeout values for waiting on responses (in milliseconds)
 #define COMM_KEYPAD_TIMEOUT_MS 5000 // 5 seconds for keypad
@@ -219,9 +653,11 @@ int comm_query_audio_card_number(int *card_number_out);
 /**
  * Start the router thread.
  *
- * The router thread reads ALL packets from Firmware_o and dispatches them
- * to type-specific queues. This allows keypad and speech threads to operate
- * concurrently without packet conflicts.
+ * The router thread reads ALL packets from Firmware_o and hands each
+ * response to the caller that registered its tag, and each pushed key or
+ * spoken command to its handler. This allows keypad and speech threads to
+ * operate concurrently without packet conflicts. An ack nobody waits for
+ * is dropped.
  *
  * Called automatically by comm_init().
  *
@@ -243,23 +679,47 @@ void comm_stop_router(void);
 bool comm_router_is_running(void);
 
 /**
- * Wait for a KEYPAD response packet from the router queue.
+ * Check whether the response to a registered request has arrived.
  *
- * @param packet Pointer to packet structure to fill
- * @param timeout_ms Maximum time to wait (use COMM_KEYPAD_TIMEOUT_MS)
- * @return HAMPOD_OK on success, HAMPOD_TIMEOUT on timeout, HAMPOD_ERROR on
- * failure
+ * Responses whose tag was registered (comm_send_audio_request(), keypad
+ * reads) are routed to their caller.
+ *
+ * @param tag Tag returned when the request was sent
+ * @param packet Receives the response (may be NULL)
+ * @return HAMPOD_OK if it arrived (the tag is then released),
+ *         HAMPOD_TIMEOUT if still outstanding, HAMPOD_NOT_FOUND if the tag
+ *         is not registered
+ */
+int comm_poll_response(unsigned short tag, CommPacket *packet);
+
+/**
+ * Wait for the response to a registered request.
+ *
+ * @param tag Tag returned when the request was sent
+ * @param packet Receives the response (may be NULL)
+ * @param timeout_ms Maximum time to wait
+ * @return HAMPOD_OK on success, HAMPOD_TIMEOUT on timeout (the tag stays
+ *         registered - poll again or call comm_cancel_response()),
+ *         HAMPOD_NOT_FOUND if the tag is not registered, HAMPOD_ERROR if
+ *         the router stopped
  */
-int comm_wait_keypad_response(CommPacket *packet, int timeout_ms);
+int comm_wait_response(unsigned short tag, CommPacket *packet,
+                       int timeout_ms);
 
 /**
- * Wait for an AUDIO response packet from the router queue.
+ * Give up on the direct audio channel (--direct) after it stopped
+ * answering; audio traffic falls back to the main link, as when Firmware
+ * closes it.
  *
- * @param packet Pointer to packet structure to fill
- * @param timeout_ms Maximum time to wait (use COMM_AUDIO_TIMEOUT_MS)
- * @return HAMPOD_OK on success, HAMPOD_TIMEOUT on timeout, HAMPOD_ERROR on
- * failure
+ * @return HAMPOD_OK, or HAMPOD_NOT_FOUND if there is no direct channel
+ */
+int comm_reset_audio_link(void);
+
+/**
+ * Stop waiting for a registered request and release its tag.
+ *
+ * A response that arrives later is dropped.
  */
-int comm_wait_audio_response(CommPacket *packet, int timeout_ms);
+void comm_cancel_response(unsigned short tag);
 
 #endif // COMM_H
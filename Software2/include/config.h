@@ -4,8 +4,31 @@
  *
  * Provides:
  * - Load/save settings to INI file (auto-save on changes)
- * - 10-deep undo history
+ * - 10-deep undo history; repeated edits to one setting (volume
+ *   stepping) undo as one step
  * - Thread-safe getter/setter API
+ *
+ * Setters only change the settings in memory; a writer thread saves the
+ * file once no setter has run for CONFIG_SAVE_DELAY_MS, and
+ * config_cleanup() saves anything still pending, so a key press in
+ * Config Mode never waits on the SD card. The file is replaced with a
+ * rename, so a power cut while saving leaves the old settings intact.
+ * In tmpfs mode ([storage]) saves are also batched, at most one every
+ * writeback_s seconds.
+ *
+ * The audio getters, read on every key press and beep, take no lock:
+ * each change publishes an immutable copy of the settings, and they read
+ * the latest one.
+ *
+ * config_reload() takes in hand edits of the file (config_watch.h calls
+ * it when the file is saved) and says which live settings changed, so
+ * only those are pushed to Firmware.
+ *
+ * Each setting in the file is a row of the schema table in config.c:
+ * its section and key, type, range, default and ConfigChange bit. A
+ * value that is not a number, out of range or too long for its field is
+ * logged and ignored, leaving the default (or the value before a
+ * reload). A new setting is its field here and one row there.
  */
 
 #ifndef HAMPOD_CONFIG_H
@@ -16,6 +39,12 @@
 // Undo system depth
 #define CONFIG_UNDO_DEPTH 10
 
+// Edits to one setting this close together undo as one step
+#define CONFIG_UNDO_COALESCE_MS 2000
+
+// Quiet time after the last setter before the file is written
+#define CONFIG_SAVE_DELAY_MS 1000
+
 // Default values
 #define CONFIG_DEFAULT_RADIO_MODEL 3073 // IC-7300
 #define CONFIG_DEFAULT_RADIO_DEVICE "/dev/ttyUSB0"
@@ -23,11 +52,33 @@
 #define CONFIG_DEFAULT_VOLUME 25
 #define CONFIG_DEFAULT_SPEECH_SPEED 1.0f
 #define CONFIG_DEFAULT_KEY_BEEP true
+#define CONFIG_DEFAULT_FIRMWARE_BEEP false
+#define CONFIG_DEFAULT_TERSE false // Verbose announcements
+#define CONFIG_DEFAULT_TTS_RAM_MB 8 // Firmware's speech cache in RAM
+#define CONFIG_DEFAULT_SPELL_GAP_MS 150 // Silence between spelled characters
+#define CONFIG_DEFAULT_POLL_FAST_MS 50  // Radio poll rate while tuning
+#define CONFIG_DEFAULT_POLL_IDLE_MS 500 // Slowest radio poll rate when idle
+#define CONFIG_DEFAULT_WATCHDOG_MS 3000 // Audio stall before recovery
+#define CONFIG_DEFAULT_CPU_IDLE_GOVERNOR "schedutil" // Between CPU boosts
+#define CONFIG_DEFAULT_SCAN_STEP_HZ 5000    // Range scan channel spacing
+#define CONFIG_DEFAULT_SCAN_DWELL_MS 100    // Listening time per channel
+#define CONFIG_DEFAULT_SCAN_THRESHOLD_DB -24 // S5, in dB relative to S9
+#define CONFIG_DEFAULT_METER_SAMPLE_MS 100  // Meter sampling while in view
+#define CONFIG_DEFAULT_METER_WINDOW_MS 1000 // Average, min and max over this
+#define CONFIG_DEFAULT_METER_HOLD_MS 2000   // Peak held this long
+#define CONFIG_DEFAULT_METER_VIEW_S 30      // In view after the last reading
+#define CONFIG_DEFAULT_ROTOR_POLL_FAST_MS 250  // Rotor poll while it turns
+#define CONFIG_DEFAULT_ROTOR_POLL_IDLE_MS 5000 // Rotor poll while it is still
+#define CONFIG_DEFAULT_WRITEBACK_S 300 // tmpfs mode: batch SD writes this long
 
 // Default config file path (relative to Software2 directory)
 #define CONFIG_DEFAULT_PATH "config/hampod.conf"
 
 #define MAX_RADIOS 10
+#define MAX_VOICES 4 // Entries of [voices], as many as Firmware keeps ready
+#define MAX_PROFILES 8          // Entries of [profiles]
+#define CONFIG_PROFILE_NAME 24  // Longest profile name, with the NUL
+#define CONFIG_PROFILE_TEXT 160 // Longest list of settings, with the NUL
 
 /**
  * @brief Individual radio settings
@@ -40,6 +91,11 @@ typedef struct {
   int baud;           // Baud rate
   char port[128];     // Physical USB port path
   int detected_model; // Model ID detected at runtime
+  int poll_fast_ms;   // Poll interval while the dial moves (0 = default)
+  int poll_idle_ms;   // Poll interval once idle (0 = default)
+  char rigctld[64];   // "host:port" of a rigctld to share, instead of device
+  bool standby;       // Keep connected while another radio is active
+  bool native_cat;    // Hot commands in CI-V/Kenwood CAT (radio_cat.h)
 } RadioSettings;
 
 /**
@@ -53,6 +109,14 @@ typedef struct {
   int volume;                // 0-100
   float speech_speed;        // 0.5-2.0
   bool key_beep_enabled;
+  bool firmware_beep_enabled; // Keypress beep played by Firmware on key-down
+  bool terse;                 // Short announcements (see announce.h)
+  int tts_ram_mb;             // RAM for Firmware's speech cache, 0-255 MB
+  char beep_tone[3][24];      // Per CommBeepType, "" for Firmware's default
+  bool spell_phonetic;        // Spell letters as "Alfa", "Bravo", ...
+  int spell_gap_ms;           // Silence between spelled characters
+  char alert_voice[16];       // [voices] name for urgent speech, "" = default
+  bool frequency_diff;        // Dial changes say only what changed
 } AudioSettings;
 
 /**
@@ -64,6 +128,132 @@ typedef struct {
   char layout[16];       // "calculator" (default) or "phone"
 } KeypadSettings;
 
+/**
+ * @brief Real-time scheduling profile (read at startup only)
+ *
+ * Applied by Software2 and, through run_hampod.sh, by Firmware. Zero
+ * priorities and empty CPU ranges leave scheduling to the OS.
+ */
+typedef struct {
+  int audio_priority;  // SCHED_FIFO priority of audio output (0 = off)
+  int keypad_priority; // SCHED_FIFO priority of keypad input (0 = off)
+  char io_cpus[16];    // CPU range for I/O, e.g. "0"
+  char tts_cpus[16];   // CPU range for Piper, e.g. "1-3"
+  char voice_cpus[16]; // CPU range for the speech recognizer, e.g. "3"
+  bool mlock;          // Lock the audio process and Software2 in RAM
+  char memory_profile[8]; // "normal" (default) or "low" (Pi Zero 2 W)
+  bool idle_mode;         // Slow periodic work down when nothing happens
+  bool event_loop;        // Route, key handling and dial changes on one loop
+  int watchdog_ms; // Stall before the watchdog recovers audio (0 = off)
+  int cpu_boost_ms; // Full CPU speed after a key or speech (0 = off)
+  char cpu_idle_governor[16]; // cpufreq governor between boosts
+} SchedulingSettings;
+
+/**
+ * @brief Scan mode (see scan.h)
+ */
+typedef struct {
+  int step_hz;      // Channel spacing of a range scan
+  int dwell_ms;     // Time on each channel before the S-meter is read
+  int threshold_db; // Stop on a signal this strong (dB relative to S9)
+} ScanSettings;
+
+/**
+ * @brief Meter sampling (see meter.h)
+ */
+typedef struct {
+  int sample_ms; // Between samples while a meter is in view (0 = off)
+  int window_ms; // Average, minimum and maximum over this long
+  int hold_ms;   // Peak held this long
+  int view_s;    // Sampling stops this long after a meter was last read
+} MeterSettings;
+
+/**
+ * @brief Antenna rotor ([rotor], see rotor.h; read at startup only)
+ */
+typedef struct {
+  char name[64];    // Friendly name, "" for "Rotor"
+  int model;        // Hamlib rotator model ID, 0 for no rotor
+  char device[64];  // Serial device, or "host:port" of a rotctld
+  int baud;         // 0 for the model's default
+  int poll_fast_ms; // Position poll while it turns (0 = default)
+  int poll_idle_ms; // Position poll while it is still (0 = default)
+} RotorSettings;
+
+/**
+ * @brief A voice of the [voices] registry (read at startup only)
+ *
+ * run_hampod.sh hands them to Firmware, which keeps each model loaded;
+ * Software2 only picks them by name.
+ */
+typedef struct {
+  char name[16];   // Empty for an unused entry
+  char model[128]; // Piper model path, relative to Firmware
+} VoiceSettings;
+
+/**
+ * @brief Spoken command input (read at startup only)
+ *
+ * run_hampod.sh hands them to Firmware, which listens only if it was
+ * built with voice input and a model is set.
+ */
+typedef struct {
+  char model[128]; // whisper.cpp model path, relative to Firmware
+  char device[64]; // ALSA capture device, empty for "default"
+} VoiceInputSettings;
+
+/**
+ * @brief How Piper runs (read at startup only)
+ *
+ * run_hampod.sh hands them to Firmware, which falls back to the CPU and
+ * the built-in model if Piper does not start with them.
+ */
+typedef struct {
+  char model[128];     // Model replacing the default voice's, "" for none
+  char accelerator[8]; // "cpu" or "cuda", "" for the default (cpu)
+} TtsSettings;
+
+/**
+ * @brief Remote station (read at startup only)
+ *
+ * run_hampod.sh hands the address to Firmware, which then takes that
+ * station's keys and, if built with remote audio, streams it what plays.
+ */
+typedef struct {
+  char address[64]; // "host:port" of the remote station, empty for none
+} RemoteSettings;
+
+/**
+ * @brief Runtime storage ([storage]; read at startup only)
+ *
+ * In tmpfs mode run_hampod.sh keeps the logs and Firmware's speech cache
+ * in RAM, and the cache is copied to the SD card every writeback_s
+ * seconds and on a clean shutdown; Software2 saves this file at most that
+ * often too, and on the way out.
+ */
+typedef struct {
+  bool tmpfs;      // Hot files in RAM, written back to the card in batches
+  int writeback_s; // Seconds between write-backs (0 = only at shutdown)
+} StorageSettings;
+
+/**
+ * @brief Local control API ([api]; read at startup only, see api.h)
+ */
+typedef struct {
+  char socket[108]; // Unix socket path, empty for no API
+} ApiSettings;
+
+/**
+ * @brief A saved settings profile ([profiles], see profile.h)
+ *
+ * The settings are written as a keypad macro lists them (macro.h), e.g.
+ * "mode USB, passband 2400, power 100, agc fast, nb off".
+ */
+typedef struct {
+  char name[CONFIG_PROFILE_NAME];     // Empty for an unused entry
+  char settings[CONFIG_PROFILE_TEXT];
+} ProfileSettings;
+
 /**
  * @brief Main configuration structure
  */
@@ -71,6 +261,17 @@ typedef struct {
   RadioSettings radios[MAX_RADIOS];
   AudioSettings audio;
   KeypadSettings keypad;
+  SchedulingSettings scheduling;
+  ScanSettings scan;
+  MeterSettings meters;
+  RotorSettings rotor;
+  VoiceSettings voices[MAX_VOICES];
+  VoiceInputSettings voice_input;
+  TtsSettings tts;
+  RemoteSettings remote;
+  StorageSettings storage;
+  ApiSettings api;
+  ProfileSettings profiles[MAX_PROFILES];
 } HampodConfig;
 
 // ============================================================================
@@ -85,13 +286,51 @@ typedef struct {
 int config_init(const char *config_path);
 
 /**
- * @brief Save current configuration to file
+ * @brief Save current configuration to file now, without waiting for
+ *        the quiet period
  * @return 0 on success, -1 on error
  */
 int config_save(void);
 
 /**
- * @brief Cleanup configuration system
+ * @brief Live settings, as config_reload() reports them changed
+ */
+typedef enum {
+  CONFIG_CHANGED_VOLUME = 1 << 0,
+  CONFIG_CHANGED_SPEECH_SPEED = 1 << 1,
+  CONFIG_CHANGED_BEEP = 1 << 2,       // key_beep or firmware_beep
+  CONFIG_CHANGED_VERBOSITY = 1 << 3,  // terse or frequency_diff
+  CONFIG_CHANGED_TTS_RAM = 1 << 4,
+  CONFIG_CHANGED_LAYOUT = 1 << 5,     // Keypad layout
+  CONFIG_CHANGED_SCHEDULING = 1 << 6, // audio_priority or keypad_priority
+  CONFIG_CHANGED_SCAN = 1 << 7,       // Read at the next scan start
+  CONFIG_CHANGED_BEEP_TONE = 1 << 8,  // beep_keypress, beep_hold, beep_error
+  CONFIG_CHANGED_SPELL = 1 << 9,      // spell_phonetic or spell_gap_ms
+  CONFIG_CHANGED_VOICE = 1 << 10,     // alert_voice
+  CONFIG_CHANGED_METERS = 1 << 11     // Read when a meter comes into view
+} ConfigChange;
+
+/**
+ * @brief Read the file again after it was edited by hand
+ *
+ * Does nothing if the file is as this program last wrote or loaded it,
+ * so our own saves are not taken for edits. Otherwise the file's
+ * settings replace the ones in memory; changes made by setters and not
+ * yet saved are kept, except where the same live setting was edited in
+ * the file. Settings not in ConfigChange (radios, CPU ranges) apply at
+ * the next start.
+ *
+ * @return ConfigChange bits of the live settings whose value changed
+ */
+unsigned config_reload(void);
+
+/**
+ * @brief Path of the config file in use
+ */
+const char *config_get_path(void);
+
+/**
+ * @brief Save pending changes, stop the writer thread and clean up
  */
 void config_cleanup(void);
 
@@ -105,6 +344,15 @@ void config_cleanup(void);
  */
 int config_undo(void);
 
+/**
+ * @brief End the current undo step
+ *
+ * A change to the same setting after this is a step of its own, even
+ * within CONFIG_UNDO_COALESCE_MS, so undoing back to the step count taken
+ * here undoes exactly what came after.
+ */
+void config_undo_checkpoint(void);
+
 /**
  * @brief Get number of available undo steps
  * @return Number of undos available (0-10)
@@ -135,6 +383,20 @@ const RadioSettings *config_get_radio(int index);
  */
 void config_set_radio_enabled(int index, bool enabled);
 
+/**
+ * @brief Record how a radio was reached, as one undo step
+ *
+ * Only fields that differ are written; nothing is saved if none do.
+ *
+ * @param index Radio index (0 to MAX_RADIOS-1)
+ * @param device Serial device that answered
+ * @param baud Baud rate that answered
+ * @param port USB port of the device
+ * @param detected_model Hamlib model that answered
+ */
+void config_update_radio_connection(int index, const char *device, int baud,
+                                    const char *port, int detected_model);
+
 // ============================================================================
 // Radio Getters (Act on the currently active radio)
 // ============================================================================
@@ -145,6 +407,19 @@ int config_get_radio_baud(void);
 const char *config_get_radio_name(void);
 const char *config_get_radio_port(void);
 int config_get_radio_detected_model(void);
+const char *config_get_radio_rigctld(void);
+
+/**
+ * @brief Get a radio's poll interval limits
+ *
+ * Unset (0) values give CONFIG_DEFAULT_POLL_FAST_MS and
+ * CONFIG_DEFAULT_POLL_IDLE_MS; the idle interval is never below the fast one.
+ *
+ * @param index Radio index (0 to MAX_RADIOS-1)
+ * @param fast_ms Output: interval while the frequency is changing
+ * @param idle_ms Output: interval the poller backs off to when idle
+ */
+void config_get_radio_poll_limits(int index, int *fast_ms, int *idle_ms);
 
 // ============================================================================
 // Audio Getters
@@ -153,10 +428,21 @@ int config_get_radio_detected_model(void);
 int config_get_volume(void);
 float config_get_speech_speed(void);
 bool config_get_key_beep_enabled(void);
+bool config_get_firmware_beep_enabled(void);
+bool config_get_terse_enabled(void);
 const char *config_get_audio_preferred_device(void);
 const char *config_get_audio_device_name(void);
 const char *config_get_audio_port(void);
 int config_get_audio_card_number(void);
+int config_get_tts_ram_mb(void);
+/** Tone spec for a CommBeepType ("" = Firmware's default) */
+const char *config_get_beep_tone(int beep);
+bool config_get_spell_phonetic(void);
+int config_get_spell_gap_ms(void);
+/** Voice name for urgent speech ("" = the default voice) */
+const char *config_get_alert_voice(void);
+/** Dial changes soon after a readout say only what changed */
+bool config_get_frequency_diff(void);
 
 // ============================================================================
 // Keypad Getters
@@ -167,7 +453,62 @@ const char *config_get_keypad_device_name(void);
 const char *config_get_keypad_layout(void);
 
 // ============================================================================
-// Radio Setters (Act on the currently active radio, auto-save after each)
+// Scheduling Getters
+// ============================================================================
+
+/**
+ * @brief Get the scheduling profile
+ * @return Pointer to internal SchedulingSettings (read-only)
+ */
+const SchedulingSettings *config_get_scheduling(void);
+
+/**
+ * @brief Get the scan settings
+ * @return Pointer to internal ScanSettings (read-only)
+ */
+const ScanSettings *config_get_scan(void);
+
+/**
+ * @brief Get the meter sampling settings
+ * @return Pointer to internal MeterSettings (read-only)
+ */
+const MeterSettings *config_get_meters(void);
+
+/**
+ * @brief Get the rotor settings
+ * @return Pointer to internal RotorSettings (read-only)
+ */
+const RotorSettings *config_get_rotor(void);
+
+/**
+ * @brief Get the runtime storage settings
+ * @return Pointer to internal StorageSettings (read-only)
+ */
+const StorageSettings *config_get_storage(void);
+
+/**
+ * @brief Get the local control API settings
+ * @return Pointer to internal ApiSettings (read-only)
+ */
+const ApiSettings *config_get_api(void);
+
+/**
+ * @brief Get a settings profile by name
+ * @param profile Receives a copy
+ * @return false if there is no profile by that name
+ */
+bool config_get_profile(const char *name, ProfileSettings *profile);
+
+/**
+ * @brief Save a settings profile, replacing one by the same name
+ *
+ * Saved once it settles, as one undo step.
+ * @return 0, or -1 if all MAX_PROFILES are taken or an argument is bad
+ */
+int config_set_profile(const char *name, const char *settings);
+
+// ============================================================================
+// Radio Setters (Act on the currently active radio, saved once they settle)
 // ============================================================================
 
 void config_set_radio_model(int model);
@@ -178,18 +519,20 @@ void config_set_radio_port(const char *port);
 void config_set_radio_detected_model(int model);
 
 // ============================================================================
-// Audio Setters (auto-save after each)
+// Audio Setters (saved once they settle)
 // ============================================================================
 
 void config_set_volume(int volume);
 void config_set_speech_speed(float speed);
 void config_set_key_beep_enabled(bool enabled);
+void config_set_firmware_beep_enabled(bool enabled);
+void config_set_terse_enabled(bool enabled);
 void config_set_audio_device_name(const char *name);
 void config_set_audio_port(const char *port);
 void config_set_audio_card_number(int card);
 
 // ============================================================================
-// Keypad Setters (auto-save after each)
+// Keypad Setters (saved once they settle)
 // ============================================================================
 
 void config_set_keypad_port(const char *port);
@@ -24,6 +24,7 @@ typedef enum {
   CONFIG_PARAM_VOLUME,
   CONFIG_PARAM_SPEECH_SPEED,
   CONFIG_PARAM_LAYOUT,
+  CONFIG_PARAM_STYLE, // Verbose or terse announcements
   CONFIG_PARAM_VERSION,
   CONFIG_PARAM_SHUTDOWN,
   CONFIG_PARAM_COUNT // Must be last
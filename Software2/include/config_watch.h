@@ -0,0 +1,32 @@
+/**
+ * @file config_watch.h
+ * @brief Hot reload: hand edits of the config file apply without a restart
+ *
+ * A thread watches the config file's directory with inotify. When the
+ * file is written or renamed into place it calls config_reload() and, if
+ * a live setting changed, hands the ConfigChange bits to a callback, which
+ * pushes just those settings to Firmware. Our own saves change nothing,
+ * so they call nothing.
+ */
+
+#ifndef CONFIG_WATCH_H
+#define CONFIG_WATCH_H
+
+/**
+ * @brief Called on the watch thread with the ConfigChange bits of an edit
+ */
+typedef void (*ConfigWatchCallback)(unsigned changed);
+
+/**
+ * @brief Start watching the file config_init() loaded
+ * @param callback Receives the changes; not called when nothing changed
+ * @return 0 on success, -1 if inotify or the thread could not start
+ */
+int config_watch_start(ConfigWatchCallback callback);
+
+/**
+ * @brief Stop watching and wait for the watch thread
+ */
+void config_watch_stop(void);
+
+#endif // CONFIG_WATCH_H
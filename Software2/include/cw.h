@@ -0,0 +1,38 @@
+/**
+ * @file cw.h
+ * @brief CW decoder: Morse on the air read out as speech
+ *
+ * While on, Firmware decodes the Morse in the radio's receive audio
+ * (Firmware/hal/hal_cw.h) and a thread here polls it twice a second. Each
+ * whole word is spoken at background priority, so keypad readouts go
+ * first. Words decoded while a readout plays are spoken together once it
+ * ends, as one item, rather than one item each. If speech falls too far
+ * behind the sender, the oldest words are dropped.
+ */
+
+#ifndef CW_H
+#define CW_H
+
+#include <stdbool.h>
+
+#define CW_POLL_MS 500      // Between polls of Firmware's decoder
+#define CW_BACKLOG_MAX 160  // Decoded text waiting to be spoken, at most
+
+/**
+ * @brief Start Firmware's decoder and the thread reading it out
+ * @return 0 on success, -1 if Firmware has no receive audio to decode or
+ *         the thread could not start
+ */
+int cw_start(void);
+
+/**
+ * @brief Stop reading out and stop Firmware's decoder
+ */
+void cw_stop(void);
+
+/**
+ * @brief Whether the decoder is on
+ */
+bool cw_is_active(void);
+
+#endif // CW_H
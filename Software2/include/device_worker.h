@@ -0,0 +1,133 @@
+/**
+ * @file device_worker.h
+ * @brief Command worker for one device: its own thread and queue
+ *
+ * Each device Software2 controls (the radios through radio_worker.h, an
+ * antenna rotor through rotor.h) has a worker of its own, so a command
+ * stuck on one device's slow bus never holds up another's. A worker runs
+ * its commands one at a time, the highest priority first and oldest
+ * first within a priority, and calls a completion callback (on the
+ * worker thread) with the result.
+ *
+ * A command with a supersede key (not 0) replaces a queued, not yet
+ * started command with the same key, whose callback then gets
+ * DEVICE_CMD_CANCELLED. Keys and priorities mean what the device's
+ * module says they mean; a higher priority runs first.
+ */
+
+#ifndef DEVICE_WORKER_H
+#define DEVICE_WORKER_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define DEVICE_CMD_MAX_ARG 32   // Bytes of argument copied with a command
+#define DEVICE_CMD_CANCELLED -2 // Result of a superseded or dropped command
+#define DEVICE_QUEUE_SIZE 16
+
+/**
+ * @brief Talks to the device; runs on the worker thread
+ * @param arg Copy of the argument passed to device_worker_submit()
+ * @return Result handed to the completion callback (0 = success)
+ */
+typedef int (*DeviceCommandFn)(void *arg);
+
+/**
+ * @brief Called on the worker thread when a command finished or was
+ * cancelled
+ * @param result Command's return value, or DEVICE_CMD_CANCELLED
+ * @param arg Same copy of the argument the command got
+ */
+typedef void (*DeviceCommandDone)(int result, void *arg);
+
+typedef struct {
+  bool in_use;
+  bool cancelled; // Superseded: deliver DEVICE_CMD_CANCELLED, don't run
+  int priority;
+  int key;
+  unsigned int seq; // Submission order within a priority
+  DeviceCommandFn run;
+  DeviceCommandDone done;
+  unsigned char arg[DEVICE_CMD_MAX_ARG];
+} DeviceCommand;
+
+/**
+ * @brief A device's worker; define one per device with
+ * DEVICE_WORKER_INITIALIZER and leave the fields to this module
+ */
+typedef struct {
+  const char *name; // Thread name, in metrics and messages
+  DeviceCommand commands[DEVICE_QUEUE_SIZE];
+  int count;
+  unsigned int next_seq;
+  bool busy; // Worker is running a command
+  pthread_t thread;
+  volatile bool active;
+  pthread_mutex_t mutex;
+  pthread_cond_t wake;
+  pthread_cond_t idle;
+} DeviceWorker;
+
+#define DEVICE_WORKER_INITIALIZER(thread_name)                                 \
+  {                                                                            \
+    .name = (thread_name), .mutex = PTHREAD_MUTEX_INITIALIZER,                 \
+    .wake = PTHREAD_COND_INITIALIZER, .idle = PTHREAD_COND_INITIALIZER         \
+  }
+
+// ============================================================================
+// Lifecycle
+// ============================================================================
+
+/**
+ * @brief Start the worker thread
+ * @return 0 on success, -1 on error
+ */
+int device_worker_start(DeviceWorker *worker);
+
+/**
+ * @brief Finish the running command, cancel queued ones and stop
+ */
+void device_worker_stop(DeviceWorker *worker);
+
+/**
+ * @brief Get the worker thread, e.g. to set its scheduling priority
+ */
+pthread_t device_worker_get_thread(const DeviceWorker *worker);
+
+// ============================================================================
+// Submitting
+// ============================================================================
+
+/**
+ * @brief Queue a command (non-blocking)
+ *
+ * Without a running worker (tests, tools) the command runs at once on
+ * the calling thread.
+ *
+ * @param priority Higher runs first
+ * @param key Supersede key, 0 for none
+ * @param run Command to run
+ * @param done Completion callback, or NULL
+ * @param arg Argument, copied (at most DEVICE_CMD_MAX_ARG bytes), or NULL
+ * @param arg_size Size of arg
+ * @return 0 if queued, -1 if the queue is full or arg too large
+ */
+int device_worker_submit(DeviceWorker *worker, int priority, int key,
+                         DeviceCommandFn run, DeviceCommandDone done,
+                         const void *arg, size_t arg_size);
+
+/**
+ * @brief Cancel every queued command with this key
+ * @return Number of commands cancelled
+ */
+int device_worker_cancel(DeviceWorker *worker, int key);
+
+/**
+ * @brief Wait until nothing is queued or running
+ * @param timeout_ms Maximum wait, -1 for no limit
+ * @return true if idle
+ */
+bool device_worker_wait_idle(DeviceWorker *worker, int timeout_ms);
+
+#endif // DEVICE_WORKER_H
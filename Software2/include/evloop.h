@@ -0,0 +1,98 @@
+/**
+ * @file evloop.h
+ * @brief Optional single event loop (event_loop = 1 in [scheduling])
+ *
+ * One thread waits in epoll on Firmware's channels, on timerfds and on an
+ * eventfd for work posted from other threads. With it running, the
+ * router reads and dispatches Firmware's replies on it, and pushed key
+ * events are handled there too, so a key reaches its handler without
+ * passing between threads. Dial changes from the radio poller are posted
+ * to it. Hamlib calls never run here: they stay on the radio worker and
+ * pollers, and handlers must not block.
+ *
+ * A handler that needs a reply from Firmware (comm_wait_response()) is
+ * not stuck: waiting on the loop thread reads the Firmware channels
+ * meanwhile (evloop_pump()). Timers and posted work wait until the
+ * handler returns, so handlers never nest.
+ */
+
+#ifndef EVLOOP_H
+#define EVLOOP_H
+
+#include <pthread.h>
+#include <stdbool.h>
+
+/**
+ * @brief Work run on the loop thread
+ */
+typedef void (*EvloopHandler)(void *arg);
+
+/**
+ * @brief Start the loop thread
+ * @return 0 on success, -1 if epoll, the eventfd or the thread failed
+ */
+int evloop_start(void);
+
+/**
+ * @brief Stop the loop thread; registered channels and timers are dropped
+ */
+void evloop_stop(void);
+
+/**
+ * @brief Whether the loop is running
+ */
+bool evloop_running(void);
+
+/**
+ * @brief Whether the caller is the loop thread
+ */
+bool evloop_in_loop(void);
+
+/**
+ * @brief The loop thread, for scheduling priority
+ */
+pthread_t evloop_get_thread(void);
+
+/**
+ * @brief Call handler on the loop whenever fd is readable
+ *
+ * For Firmware channels: these are also served during evloop_pump().
+ *
+ * @return 0 on success, -1 if the table is full or epoll refused fd
+ */
+int evloop_add_io(int fd, EvloopHandler handler, void *arg);
+
+/**
+ * @brief Stop watching fd (before closing it); safe from its own handler
+ */
+void evloop_remove_io(int fd);
+
+/**
+ * @brief Create a one-shot timer that calls handler on the loop
+ * @return Timer id for evloop_arm_timer(), or -1 on failure
+ */
+int evloop_add_timer(EvloopHandler handler, void *arg);
+
+/**
+ * @brief Fire a timer after delay_ms (0 = as soon as possible), or
+ *        disarm it with a negative delay
+ */
+void evloop_arm_timer(int timer, int delay_ms);
+
+/**
+ * @brief Run handler on the loop, after what it is doing now
+ *
+ * From any thread; handlers posted from the loop itself need no syscall.
+ *
+ * @return 0 on success, -1 if the loop is not running or its queue is full
+ */
+int evloop_post(EvloopHandler handler, void *arg);
+
+/**
+ * @brief On the loop thread, serve the Firmware channels for up to
+ *        timeout_ms while a handler waits for a reply
+ * @return Number of channels served, -1 if not called on the loop
+ */
+int evloop_pump(int timeout_ms);
+
+#endif // EVLOOP_H
@@ -101,4 +101,23 @@ void frequency_mode_on_radio_change(double new_freq);
  */
 void frequency_mode_suppress_next_poll(void);
 
+/**
+ * @brief Tune the current VFO, as a submitted frequency entry would
+ *
+ * Used by spoken frequency commands. The frequency is read back and
+ * announced once the radio has it; failures are announced too.
+ *
+ * @param freq_hz Frequency in Hz
+ */
+void frequency_mode_tune(double freq_hz);
+
+/**
+ * @brief Announce the next polling report, even with announcements off
+ *
+ * Call when stepping the frequency from the keypad: polling reports a
+ * frequency once it has been stable for a while, so the operator hears
+ * where the steps settled, once.
+ */
+void frequency_mode_announce_next_poll(void);
+
 #endif // FREQUENCY_MODE_H
@@ -20,6 +20,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "hampod_log.h"
+
 // ============================================================================
 // Debug Configuration
 // ============================================================================
@@ -35,22 +37,24 @@
 #define DEBUG_LEVEL DEBUG_INFO
 #endif
 
-// Debug macros
+// Debug macros. Queued for the logger thread (hampod_log.h) once main()
+// has started it, so no caller blocks on a slow stdout; rate limited per
+// call site.
 #if DEBUG_LEVEL >= DEBUG_ERROR
-#define LOG_ERROR(fmt, ...) fprintf(stderr, "[ERROR] " fmt "\n", ##__VA_ARGS__)
+#define LOG_ERROR(fmt, ...) HAMPOD_LOG(2, "[ERROR] " fmt "\n", ##__VA_ARGS__)
 #else
 #define LOG_ERROR(fmt, ...)
 #endif
 
 #if DEBUG_LEVEL >= DEBUG_INFO
-#define LOG_INFO(fmt, ...) printf("[INFO] " fmt "\n", ##__VA_ARGS__)
+#define LOG_INFO(fmt, ...) HAMPOD_LOG(1, "[INFO] " fmt "\n", ##__VA_ARGS__)
 #else
 #define LOG_INFO(fmt, ...)
 #endif
 
 #if DEBUG_LEVEL >= DEBUG_DEBUG
-#define LOG_DEBUG(fmt, ...) printf("[DEBUG] " fmt "\n", ##__VA_ARGS__)
-#define DEBUG_PRINT(fmt, ...) printf("[DEBUG] " fmt, ##__VA_ARGS__)
+#define LOG_DEBUG(fmt, ...) HAMPOD_LOG(1, "[DEBUG] " fmt "\n", ##__VA_ARGS__)
+#define DEBUG_PRINT(fmt, ...) HAMPOD_LOG(1, "[DEBUG] " fmt, ##__VA_ARGS__)
 #else
 #define LOG_DEBUG(fmt, ...)
 #define DEBUG_PRINT(fmt, ...)
@@ -86,6 +90,7 @@ typedef struct {
   char key;        // The character pressed (e.g., '1', 'A', '#', '-' for none)
   int shiftAmount; // 0 = normal, 1+ = shifted (reserved for future use)
   bool isHold;     // true if this is a long press (held > HOLD_THRESHOLD_MS)
+  bool isRepeat;   // true for the repeats of a hold while the key stays down
 } KeyPressEvent;
 
 // Hold detection threshold (milliseconds)
@@ -102,9 +107,40 @@ typedef struct {
 #define AUDIO_TYPE_TTS 'd'       // Dynamic TTS: speak text
 #define AUDIO_TYPE_FILE 'p'      // Play pre-recorded WAV file
 #define AUDIO_TYPE_SPELL 's'     // Spell out text character by character
-#define AUDIO_TYPE_BEEP 'b'      // Play pre-cached beep
+#define AUDIO_TYPE_BEEP 'b'      // Play a beep (synthesized by Firmware)
 #define AUDIO_TYPE_INTERRUPT 'i' // Interrupt current playback
 #define AUDIO_TYPE_INFO 'q' // Query audio device info (returns card number)
+#define AUDIO_TYPE_SEQUENCE 'm'  // Several segments played back to back
+#define AUDIO_TYPE_TTS_STATS 't' // Query TTS cache and latency counters
+#define AUDIO_TYPE_ECHO 'e'      // Keypad echo: RAM clip mixed in at once
+#define AUDIO_TYPE_TONE 'o'      // One-shot tone, e.g. "o697+1209/200"
+#define AUDIO_TYPE_BEEP_TONE 'c' // Set a beep's tone, e.g. "ck1000/50/50"
+#define AUDIO_TYPE_WARM 'w'      // Cache a readout's words, nothing played
+#define AUDIO_TYPE_CW 'k'        // CW decoder: "k1" on, "k0" off, "k" poll
+#define AUDIO_TYPE_REPLAY 'r'    // Say again: "r1" the last announcement
+#define AUDIO_TYPE_HEARTBEAT 'a' // Link check, answered with watchdog steps
+#define AUDIO_TYPE_PLAYED 'f'    // Acked once what came before has played
+
+// Spell payload: <AUDIO_SPELL_LETTERS|AUDIO_SPELL_PHONETIC><gap ms>:<text>,
+// each character a pregenerated clip or cached word (bare text spells
+// letters). Example: "sn150:W1AW" = "Whiskey 1 Alfa Whiskey", 150 ms apart
+#define AUDIO_SPELL_LETTERS 'l'
+#define AUDIO_SPELL_PHONETIC 'n'
+#define AUDIO_SPELL_GAP_MAX_MS 2000
+
+// Sequence payload: segments joined by AUDIO_SEQ_SEPARATOR, each one
+// <kind><data> where kind is AUDIO_TYPE_TTS, AUDIO_SEQ_WORDS (spoken one
+// cached word at a time), AUDIO_TYPE_FILE, AUDIO_TYPE_BEEP (k/h/e),
+// AUDIO_TYPE_TONE (a tone spec), AUDIO_SEQ_GAP (silence, decimal ms) or
+// AUDIO_SEQ_VOICE (a voice name from [voices] the rest is spoken in);
+// a leading AUDIO_SEQ_EXPIRES (a CLOCK_MONOTONIC microsecond deadline, low
+// 32 bits, decimal) has Firmware skip the sequence if it comes up later
+// Example: "mdVFO A.\x1edPoint 5 megahertz" = one utterance, one ack
+#define AUDIO_SEQ_SEPARATOR '\x1e'
+#define AUDIO_SEQ_GAP 'g'
+#define AUDIO_SEQ_WORDS 'w'
+#define AUDIO_SEQ_VOICE 'v'
+#define AUDIO_SEQ_EXPIRES 'x'
 
 // ============================================================================
 // Common Return Codes
@@ -0,0 +1,72 @@
+/**
+ * @file idle.h
+ * @brief Idle mode: one housekeeping timer, slowed down when nothing happens
+ *
+ * Threads block on real events (a key, a queued phrase, a file change).
+ * What genuinely has to run periodically, such as looking for a radio's
+ * USB adapter, runs as a job on the one housekeeping timer thread instead
+ * of each thread waking itself. With idle_mode = 1 in [scheduling], once
+ * no key has been pressed for a while (IDLE_MODE_AFTER_MS) the jobs and
+ * the radio poll run at their idle periods, and the first key brings them
+ * back.
+ *
+ * Timed wakeups that found nothing to do are counted in the
+ * idle_wakeups_total metric, and their recent rate in
+ * idle_wakeups_per_second.
+ */
+
+#ifndef IDLE_H
+#define IDLE_H
+
+#include <stdbool.h>
+
+/**
+ * @brief A housekeeping job; returns whether it found anything to do
+ */
+typedef bool (*IdleJob)(void *arg);
+
+/**
+ * @brief Turn idle mode on or off (off: jobs always run at their period)
+ * @param after_ms How long without activity counts as idle
+ */
+void idle_set_mode(bool enabled, int after_ms);
+
+/**
+ * @brief Note user activity, ending the idle period
+ *
+ * Cheap enough for every key event. Wakes the timer if its jobs had slowed
+ * down, so they are back at their normal period at once.
+ */
+void idle_note_activity(void);
+
+/**
+ * @brief Whether idle mode is on and nothing has happened for a while
+ */
+bool idle_is_idle(void);
+
+/**
+ * @brief The interval to wait now: active_ms, or idle_ms when idle
+ */
+int idle_stretch_ms(int active_ms, int idle_ms);
+
+/**
+ * @brief Count a timed wakeup; those that were not useful are idle wakeups
+ */
+void idle_note_wakeup(bool useful);
+
+/**
+ * @brief Run a job on the housekeeping timer, starting it if needed
+ * @param job Called on the timer thread; must not block for long
+ * @param period_ms How often to run it
+ * @param idle_period_ms How often to run it when idle
+ * @return 0 on success, -1 if the job table is full or the thread
+ *         could not start
+ */
+int idle_add_job(IdleJob job, void *arg, int period_ms, int idle_period_ms);
+
+/**
+ * @brief Stop the housekeeping timer and forget its jobs
+ */
+void idle_shutdown(void);
+
+#endif // IDLE_H
@@ -0,0 +1,149 @@
+/**
+ * @file keymap.h
+ * @brief Which action each key runs, loaded from a keymap file
+ *
+ * The bindings of Normal Mode and of the keys main.c handles itself
+ * ([A] shift, [B] Set Mode, [D] held for the next device) are data, not
+ * code: a flat table indexed by (mode, key, hold, shift) that main.c and
+ * normal_mode.c look up once per key press. The built-in bindings are the
+ * standard HAMPOD layout; KEYMAP_DEFAULT_PATH can rebind keys for every
+ * radio, or for one rig model only, without a rebuild.
+ *
+ * File format - one binding per line, '#' starts a comment:
+ *
+ *   [default]                 # Every radio
+ *   normal 9 press power      # <mode> <key> <trigger> <action>
+ *   [model 3073]              # Only while a radio of this model is active
+ *   normal 9 press none       # "none" unbinds
+ *
+ * Triggers are press, hold, shift (shifted press) and shift_hold. A
+ * shifted key with no shifted binding of its own runs its unshifted one.
+ *
+ * A macro is a named list of radio settings (macro.h), bound to a key
+ * like any action. Macro names are shared by every section:
+ *
+ *   macro ft8 frequency 14.074, mode PKTUSB, power 30, preamp off
+ *   normal 1 shift_hold macro ft8
+ *
+ * Set Mode, Frequency Mode and Config Mode keep their own key handling:
+ * they are entry state machines, not per-key actions.
+ */
+
+#ifndef KEYMAP_H
+#define KEYMAP_H
+
+#include <stdbool.h>
+
+#define KEYMAP_DEFAULT_PATH "config/keymap.conf"
+
+#define KEYMAP_MACROS 16      // Named macros in the file, at most
+#define KEYMAP_MACRO_NAME 24  // Longest name, with the NUL
+#define KEYMAP_MACRO_TEXT 160 // Longest list of settings, with the NUL
+
+/**
+ * @brief Who looks a key up
+ */
+typedef enum {
+  KEYMAP_MODE_GLOBAL = 0, // main.c, before Frequency Mode
+  KEYMAP_MODE_NORMAL,     // normal_mode.c
+  KEYMAP_MODE_COUNT
+} KeymapMode;
+
+/**
+ * @brief What a key does (names as in the file)
+ */
+typedef enum {
+  KEYMAP_NONE = 0,
+  // Global
+  KEYMAP_SHIFT,          // "shift"
+  KEYMAP_SET_MODE,       // "set_mode"
+  // Normal Mode
+  KEYMAP_VFO_A,          // "vfo_a"
+  KEYMAP_VFO_B,          // "vfo_b"
+  KEYMAP_VOX_STATUS,     // "vox_status"
+  KEYMAP_FREQUENCY,      // "frequency"
+  KEYMAP_MODE,           // "mode"
+  KEYMAP_PREAMP,         // "preamp"
+  KEYMAP_AGC,            // "agc"
+  KEYMAP_ATTENUATION,    // "attenuation"
+  KEYMAP_NOISE_BLANKER,  // "noise_blanker"
+  KEYMAP_NOISE_REDUCTION, // "noise_reduction"
+  KEYMAP_MIC_GAIN,       // "mic_gain"
+  KEYMAP_COMPRESSION,    // "compression"
+  KEYMAP_POWER,          // "power"
+  KEYMAP_SMETER,         // "smeter"
+  KEYMAP_POWER_METER,    // "power_meter"
+  KEYMAP_TUNING_TONE,    // "tuning_tone"
+  KEYMAP_NEXT_RADIO,     // "next_radio"
+  KEYMAP_VERBOSITY,      // "verbosity"
+  KEYMAP_CONFIG_MODE,    // "config_mode"
+  KEYMAP_BAND_UP,        // "band_up"
+  KEYMAP_BAND_DOWN,      // "band_down"
+  KEYMAP_SCAN,           // "scan"
+  KEYMAP_SCAN_MEMORIES,  // "scan_memories"
+  KEYMAP_TUNE_UP,        // "tune_up"
+  KEYMAP_TUNE_DOWN,      // "tune_down"
+  KEYMAP_TUNE_STEP,      // "tune_step"
+  KEYMAP_NEXT_DEVICE,    // "next_device"
+  KEYMAP_MEMORIES,       // "memories"
+  KEYMAP_CW_DECODE,      // "cw_decode"
+  KEYMAP_SAY_AGAIN,      // "say_again"
+  KEYMAP_MACRO,          // "macro <name>"
+  KEYMAP_PROFILE,        // "profile <name>", restore it (profile.h)
+  KEYMAP_PROFILE_SAVE,   // "save_profile <name>"
+  KEYMAP_ACTION_COUNT
+} KeymapAction;
+
+/**
+ * @brief A macro as the file defines it
+ */
+typedef struct {
+  char name[KEYMAP_MACRO_NAME];
+  char steps[KEYMAP_MACRO_TEXT]; // Empty if bound but never defined
+} KeymapMacro;
+
+// ============================================================================
+// Lifecycle
+// ============================================================================
+
+/**
+ * @brief Load the keymap file and select the bindings for no model
+ * @param path File to load, or NULL for KEYMAP_DEFAULT_PATH
+ * @return 0 (a missing file leaves the built-in bindings)
+ */
+int keymap_init(const char *path);
+
+/**
+ * @brief Use the bindings for a rig model: the defaults, then its own
+ * @param model Hamlib model, or 0 for the defaults only
+ */
+void keymap_select_model(int model);
+
+// ============================================================================
+// Lookup
+// ============================================================================
+
+/**
+ * @brief The action bound to a key
+ * @return KEYMAP_NONE if the key is unbound in that mode
+ */
+KeymapAction keymap_lookup(KeymapMode mode, char key, bool is_hold,
+                           bool is_shifted);
+
+/**
+ * @brief The macro bound to a key
+ *
+ * For the profile actions, only the name is of use.
+ * @param macro Receives a copy of it
+ * @return false if the key's action takes no name (KEYMAP_MACRO,
+ *         KEYMAP_PROFILE, KEYMAP_PROFILE_SAVE)
+ */
+bool keymap_lookup_macro(KeymapMode mode, char key, bool is_hold,
+                         bool is_shifted, KeymapMacro *macro);
+
+/**
+ * @brief Action name, as in the file ("vfo_a", ...)
+ */
+const char *keymap_action_name(KeymapAction action);
+
+#endif // KEYMAP_H
@@ -19,6 +19,7 @@
 #define KEYPAD_H
 
 #include "hampod_core.h"
+#include <pthread.h>
 
 // ============================================================================
 // Callback Types
@@ -38,7 +39,8 @@ typedef void (*KeypadCallback)(const KeyPressEvent* event);
 /**
  * Initialize the keypad system.
  * 
- * Starts a background thread that polls for keypad input.
+ * Subscribes to Firmware-pushed key events when available, otherwise
+ * starts a background thread that polls for keypad input.
  * Must be called after comm_init() and comm_wait_ready().
  * 
  * @return HAMPOD_OK on success, HAMPOD_ERROR on failure
@@ -58,6 +60,26 @@ void keypad_shutdown(void);
  */
 bool keypad_is_running(void);
 
+/**
+ * Get the keypad polling thread, e.g. to raise its priority.
+ * Only valid while keypad_is_running().
+ */
+pthread_t keypad_get_thread(void);
+
+/**
+ * Inject a key event as if it came from the keypad.
+ *
+ * The event goes to the registered callback from the keypad thread (or the
+ * event loop), in turn with real key events, with the usual beep. Used by
+ * the local control API (api.h).
+ *
+ * @param key One of 0-9, A-D, * and #
+ * @param is_hold true for a hold, false for a press
+ * @return HAMPOD_OK if queued, HAMPOD_ERROR if the keypad is not running,
+ *         the key is unknown or too many injected keys are pending
+ */
+int keypad_inject(char key, bool is_hold);
+
 // ============================================================================
 // Callback Registration
 // ============================================================================
@@ -83,6 +105,9 @@ void keypad_register_callback(KeypadCallback callback);
  * as a "hold" event (isHold = true).
  * 
  * Default: 500ms (HOLD_THRESHOLD_MS from hampod_core.h)
+ *
+ * Call before keypad_init(): in push mode the threshold is handed to
+ * Firmware when subscribing.
  * 
  * @param ms Threshold in milliseconds
  */
@@ -91,7 +116,8 @@ void keypad_set_hold_threshold(int ms);
 /**
  * Set the polling interval.
  * 
- * How often to query the Firmware for key state.
+ * How often to query the Firmware for key state. Only used when Firmware
+ * does not support push mode (see keypad_init()).
  * Lower values = more responsive, but more CPU/pipe usage.
  * 
  * Default: 50ms
@@ -100,4 +126,24 @@ void keypad_set_hold_threshold(int ms);
  */
 void keypad_set_poll_interval(int ms);
 
+/**
+ * Set the auto-repeat interval.
+ *
+ * After a hold event, a key kept down fires a repeat event (isHold and
+ * isRepeat both true) this often until it is released.
+ *
+ * Default: 100ms
+ *
+ * @param ms Repeat interval in milliseconds, 0 for no repeats
+ */
+void keypad_set_repeat_interval(int ms);
+
+/**
+ * Apply changed key beep settings.
+ *
+ * Turns Firmware's key-down beep on or off to match the key_beep and
+ * firmware_beep settings, as keypad_init() does at startup.
+ */
+void keypad_update_beep(void);
+
 #endif // KEYPAD_H
@@ -0,0 +1,92 @@
+/**
+ * @file macro.h
+ * @brief Keypad macros: several radio settings from one key
+ *
+ * A macro is a named list of settings in the keymap file (keymap.h),
+ * bound to a key like any action:
+ *
+ *   macro ft8 frequency 14.074, mode PKTUSB, power 30, preamp off
+ *
+ * Running it compiles the list into one radio worker job. The job sets
+ * each in turn inside a single radio session (radio.h), with no
+ * announcement in between, and then says once that the macro is done,
+ * naming what the radio lacks. It stops at the first setting the radio
+ * does not take, and says which.
+ *
+ * Settings, run in the order given:
+ *   vfo a|b                  frequency <MHz with a point, or Hz>
+ *   mode <Hamlib name>       (USB, CW, PKTUSB...; USB-D, LSB-D, FM-D too)
+ *   power <percent>          preamp off|on|1|2
+ *   attenuation off|<dB>     agc off|fast|medium|slow
+ *   nb on|off                nr on|off
+ *   passband <Hz>            (0 for the mode's normal one)
+ *
+ * A passband right after a mode is set with it, in one command.
+ */
+
+#ifndef MACRO_H
+#define MACRO_H
+
+#include "keymap.h"
+
+#define MACRO_STEPS_MAX 8
+#define MACRO_JOBS 4 // Macros queued or running at once
+
+/**
+ * @brief What a step sets
+ */
+typedef enum {
+  MACRO_STEP_VFO,
+  MACRO_STEP_FREQUENCY,
+  MACRO_STEP_MODE,
+  MACRO_STEP_POWER,
+  MACRO_STEP_PREAMP,
+  MACRO_STEP_ATTENUATION,
+  MACRO_STEP_AGC,
+  MACRO_STEP_NB,
+  MACRO_STEP_NR,
+  MACRO_STEP_PASSBAND
+} MacroStepKind;
+
+typedef struct {
+  MacroStepKind kind;
+  long long value; // Hz, Hamlib rmode_t, percent, dB, RadioVfo, AgcSpeed...
+} MacroStep;
+
+/**
+ * @brief A macro ready to run
+ */
+typedef struct {
+  char name[KEYMAP_MACRO_NAME];
+  MacroStep steps[MACRO_STEPS_MAX];
+  int count;
+  bool changes_only; // Skip steps the radio state cache shows as set
+} Macro;
+
+/**
+ * @brief Turn a macro's list of settings into steps
+ * @param source As the keymap file defines it
+ * @param macro Receives the steps
+ * @return 0, or the number (from 1) of the first step that is not valid;
+ *         an undefined or empty macro fails at step 1
+ */
+int macro_compile(const KeymapMacro *source, Macro *macro);
+
+/**
+ * @brief Queue a macro on the radio worker (non-blocking)
+ *
+ * Says what is wrong instead if it does not compile or cannot be queued.
+ * @return 0 if queued, -1 if not
+ */
+int macro_run(const KeymapMacro *source);
+
+/**
+ * @brief Queue a compiled macro on the radio worker (non-blocking)
+ *
+ * As macro_run(), for steps built elsewhere (profile.h). With
+ * changes_only and nothing to send, it says "<name> already set".
+ * @return 0 if queued, -1 if not
+ */
+int macro_queue(const Macro *macro);
+
+#endif // MACRO_H
@@ -0,0 +1,132 @@
+/**
+ * @file memory_index.h
+ * @brief Local index of the active radio's memory channels
+ *
+ * Browsing the radio's memories with one rig_get_channel per step would
+ * cost a serial round trip per key press. Instead the memory channels
+ * are read in bulk into this index - frequency, mode and name of every
+ * channel in use - and browsing answers from it at once.
+ *
+ * The read runs in the background on the radio worker, a few channels
+ * per command in the background class, so key presses get the radio
+ * between chunks; the channels read so far can be browsed meanwhile.
+ * The index is written to a file per radio (MEMORY_INDEX_DEFAULT_PATH,
+ * %d the radio number) and loaded again on the next connect of the same
+ * model, so the radio is read once, not every session.
+ *
+ * Hamlib reports no edits of a memory, so the index stays until it is
+ * read again on demand, the radio's model changes, or
+ * memory_index_invalidate() says HAMPOD wrote a channel.
+ *
+ * Has its own lock; only the read talks to the radio.
+ */
+
+#ifndef MEMORY_INDEX_H
+#define MEMORY_INDEX_H
+
+#include "radio_queries.h"
+
+#include <stdbool.h>
+
+#define MEMORY_INDEX_DEFAULT_PATH "config/memories.%d.conf"
+#define MEMORY_INDEX_MAX 1000 // Channels in use kept per radio
+
+/**
+ * @brief Called on the radio worker when a read finished
+ * @param count Channels in use, or -1 if the radio's memories can't be
+ *        read
+ */
+typedef void (*MemoryIndexReadDone)(int count);
+
+// ============================================================================
+// Lifecycle
+// ============================================================================
+
+/**
+ * @brief Set where the index files are kept
+ * @param path_format File name with %d for the radio number (1 for
+ *        [radio.1]), or NULL for MEMORY_INDEX_DEFAULT_PATH
+ * @return 0
+ */
+int memory_index_init(const char *path_format);
+
+/**
+ * @brief Switch to a radio's index, loading its file
+ *
+ * A file written for another model is ignored: the index is then empty
+ * until it is read. Selecting the radio already selected does nothing.
+ *
+ * @param radio Radio index (radio.h)
+ * @param model Its Hamlib model
+ */
+void memory_index_select(int radio, int model);
+
+// ============================================================================
+// Reading
+// ============================================================================
+
+/**
+ * @brief Read the active radio's memories in the background
+ *
+ * Does nothing if the index is already complete (unless forced) or a
+ * read is under way; on_done then replaces the earlier read's callback.
+ *
+ * @param force Read again even if the index is complete
+ * @param on_done Called when the read finished, or NULL
+ * @return 0 if a read is under way or not needed, -1 if not queued
+ */
+int memory_index_read(bool force, MemoryIndexReadDone on_done);
+
+/**
+ * @brief Whether a read is under way
+ */
+bool memory_index_is_reading(void);
+
+/**
+ * @brief Whether every channel has been read (this session or an
+ *        earlier one)
+ */
+bool memory_index_is_complete(void);
+
+/**
+ * @brief Record channels as the radio holds them
+ *
+ * A channel with freq_hz 0 is removed. Once the index is complete, and
+ * outside a read, the file is written at once.
+ */
+void memory_index_store(const RadioMemory *memories, int count);
+
+/**
+ * @brief Note that HAMPOD changed a memory channel on the radio
+ *
+ * The channel is dropped and read again in the background.
+ *
+ * @param channel Channel number, or -1 to drop the whole index (and its
+ *        file) until the next read
+ */
+void memory_index_invalidate(int channel);
+
+// ============================================================================
+// Browsing (never talks to the radio)
+// ============================================================================
+
+/**
+ * @brief Number of channels in use in the index
+ */
+int memory_index_count(void);
+
+/**
+ * @brief A channel in the index
+ * @return false if it is not in use or not read yet
+ */
+bool memory_index_get(int channel, RadioMemory *memory);
+
+/**
+ * @brief The next channel in use after or before another, wrapping
+ * @param channel Channel to start from; -1 starts before the first
+ * @param direction 1 for up, -1 for down
+ * @return false if the index is empty
+ */
+bool memory_index_step(int channel, int direction, RadioMemory *memory);
+
+#endif // MEMORY_INDEX_H
@@ -0,0 +1,47 @@
+/**
+ * @file memory_mode.h
+ * @brief Memory Browse Mode: step through the radio's memory channels
+ *
+ * Entered from Normal Mode ([2] held). Each step is announced from the
+ * memory index (memory_index.h) at once, without asking the radio:
+ * - [6] next channel in use, [4] the one before; holding them repeats
+ * - [5] says the channel again
+ * - [#] sets the radio to the channel's frequency and mode and leaves
+ * - [0] held reads the radio's memories again
+ * - [D] leaves without changing anything
+ *
+ * If the index isn't complete, entering starts the read in the
+ * background; the channels already read can be browsed meanwhile.
+ */
+
+#ifndef MEMORY_MODE_H
+#define MEMORY_MODE_H
+
+#include <stdbool.h>
+
+/**
+ * @brief Enter Memory Browse Mode and say where it is
+ */
+void memory_mode_enter(void);
+
+/**
+ * @brief Whether Memory Browse Mode is active
+ */
+bool memory_mode_is_active(void);
+
+/**
+ * @brief Handle a key in Memory Browse Mode
+ * @param key The key character
+ * @param is_hold true if the key was held
+ * @return true if consumed, false if the key means nothing here
+ */
+bool memory_mode_handle_key(char key, bool is_hold);
+
+/**
+ * @brief Handle a repeat of a held key (see keypad.h): [4] and [6] step
+ *        again
+ * @return true if it stepped
+ */
+bool memory_mode_handle_repeat(char key);
+
+#endif // MEMORY_MODE_H
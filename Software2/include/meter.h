@@ -0,0 +1,76 @@
+/**
+ * @file meter.h
+ * @brief Meter sampling: averaged and peak-held radio meters
+ *
+ * A single meter read catches one instant, so a fading signal or SSB
+ * speech gives a different number every time. Once a meter is read for
+ * announcing (meter_use()), it is in view: for the next view_s seconds a
+ * thread queues a radio worker command every sample_ms (as set in
+ * [meters]) that samples it, in the background class so keys always get
+ * the radio first. The power meter brings SWR and ALC into view with it.
+ * A new command is only queued once the last one has run, so a slow CAT
+ * link samples less often rather than building a queue. Once nothing is
+ * in view the thread sleeps and the radio is left alone.
+ *
+ * Each meter keeps its recent samples. The S-meter and SWR are spoken as
+ * their average over window_ms, power and ALC as their peak over hold_ms
+ * (the peak envelope power of SSB speech, and the ALC's worst swing);
+ * meter_get_stats() has the lot. A frequency change starts the samples
+ * afresh, so a reading never mixes two signals. The tuning tone's reads
+ * are recorded too.
+ */
+
+#ifndef METER_H
+#define METER_H
+
+#include "radio_queries.h"
+
+#include <stdbool.h>
+
+#define METER_MAX_SAMPLES 128 // Per meter; older ones drop out early
+
+/**
+ * @brief A meter's recent samples, in the unit radio_read_meter() gives
+ */
+typedef struct {
+  double last;    // Latest sample
+  double average; // Over window_ms
+  double min;     // Over window_ms
+  double max;     // Over window_ms
+  double peak;    // Over hold_ms
+  int samples;    // In the window
+  int age_ms;     // Of the latest sample
+} MeterStats;
+
+/**
+ * @brief A meter is being read: keep it (and its group) sampled
+ *
+ * Starts the sampling thread if needed and reads the [meters] settings
+ * afresh. Does nothing with sample_ms = 0.
+ */
+void meter_use(RadioMeter meter);
+
+/**
+ * @brief Record a sample read elsewhere (the sampler, the tuning tone)
+ */
+void meter_record(RadioMeter meter, double value);
+
+/**
+ * @brief The reading to speak: average or peak, as listed above
+ * @return false without a recent sample on the current frequency, when
+ *         the caller should read the meter itself
+ */
+bool meter_reading(RadioMeter meter, double *value);
+
+/**
+ * @brief Every statistic for a meter
+ * @return false without a recent sample on the current frequency
+ */
+bool meter_get_stats(RadioMeter meter, MeterStats *stats);
+
+/**
+ * @brief Stop sampling and the thread, and forget the samples
+ */
+void meter_stop(void);
+
+#endif // METER_H
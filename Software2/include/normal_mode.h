@@ -43,6 +43,17 @@ void normal_mode_init(void);
  */
 bool normal_mode_handle_key(char key, bool is_hold, bool is_shifted);
 
+/**
+ * @brief Handle a repeat of a held key (see keypad.h)
+ *
+ * Only a held tuning key steps again; the repeat runs the action its
+ * hold ran, so a shifted hold keeps its direction after shift clears.
+ *
+ * @param key The key still held
+ * @return true if the repeat stepped the VFO
+ */
+bool normal_mode_handle_repeat(char key);
+
 // ============================================================================
 // Verbosity Control
 // ============================================================================
@@ -85,4 +96,18 @@ void normal_mode_on_mode_change(const char* new_mode);
  */
 void normal_mode_on_vfo_change(int new_vfo);
 
+/**
+ * @brief Warm the readouts likely to be asked for next
+ *
+ * Called with each frequency the radio settles on. When it lands in
+ * another band, or the cached mode or VFO has changed since, the words of
+ * the mode and frequency readouts, and in a new band those of the
+ * neighbouring bands' recalls, are sent to be synthesized in the
+ * background (announce_warm()), so asking for them plays from the cache
+ * in RAM. Otherwise it does nothing.
+ *
+ * @param freq_hz The frequency the radio settled on
+ */
+void normal_mode_warm_readouts(double freq_hz);
+
 #endif // NORMAL_MODE_H
@@ -0,0 +1,53 @@
+/**
+ * @file profile.h
+ * @brief Radio settings profiles: save the operating setup, put it back
+ *
+ * A profile ("contest", "dx", "ragchew"...) holds the mode, filter
+ * passband, power, AGC, noise blanker and reduction, preamp and
+ * attenuation. Saving reads them through the radio state cache (one
+ * radio session for whatever is stale) and stores them under [profiles]
+ * in hampod.conf as a macro's list of settings (macro.h):
+ *
+ *   contest = mode CW, passband 500, power 100, agc fast, nb on, ...
+ *
+ * Restoring compiles that list and runs it as one macro job that skips
+ * every setting the cache shows as already set, so only the differences
+ * reach the radio. Settings the radio can't report are left out of the
+ * profile.
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stddef.h>
+
+#include "radio_setters.h"
+
+/**
+ * @brief Write settings as a profile stores them
+ * @param mode Hamlib rmode_t, or 0 if not known
+ * @param passband_hz 0 if not known
+ * @param status As radio_read_status() gives it; -1 fields are left out
+ * @param out Receives the list, "" if nothing is known
+ * @return Number of settings written
+ */
+int profile_format(int mode, int passband_hz, const RadioStatus *status,
+                   char *out, size_t size);
+
+/**
+ * @brief Save the radio's settings as a profile (non-blocking)
+ *
+ * Runs on the radio worker, then says "<name> saved" or why not.
+ * @return 0 if queued, -1 if not
+ */
+int profile_save(const char *name);
+
+/**
+ * @brief Put a profile's settings back on the radio (non-blocking)
+ *
+ * Says "<name> not saved" for an unknown profile, otherwise as a macro.
+ * @return 0 if queued, -1 if not
+ */
+int profile_restore(const char *name);
+
+#endif // PROFILE_H
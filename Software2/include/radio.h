@@ -26,6 +26,14 @@
  * - config_get_radio_model()
  * - config_get_radio_device()
  * - config_get_radio_baud()
+ * - config_get_radio_port(): if set, the device on that USB port is used
+ *   even if it is no longer the configured node (saved when it changed)
+ *
+ * The USB port is learned on the first connect.
+ *
+ * Connects the enabled radio, which becomes the active one. Radios with
+ * standby = 1 are connected by radio_start_reconnect() and then polled
+ * in the background, so radio_select() can switch to them at once.
  *
  * @return 0 on success, -1 on error
  */
@@ -38,10 +46,38 @@ void radio_cleanup(void);
 
 /**
  * @brief Check if radio is connected
- * @return true if connected, false otherwise
+ * @return true if the active radio is connected, false otherwise
  */
 bool radio_is_connected(void);
 
+// ============================================================================
+// Radio Selection
+// ============================================================================
+
+/**
+ * @brief Make another radio the active one
+ *
+ * Every getter, setter and announcement then talks to it. Only the
+ * enabled radio and standby radios can be selected; they are already
+ * connected (or reconnecting) and their state cached, so this only waits
+ * for a command in flight on either radio. The choice is saved to config.
+ *
+ * @param index Radio index (0 to MAX_RADIOS-1)
+ * @return 0 on success, -1 if that radio isn't in use
+ */
+int radio_select(int index);
+
+/**
+ * @brief Select the next radio in use after the active one
+ * @return The new active radio's index, or -1 if there is no other
+ */
+int radio_select_next(void);
+
+/**
+ * @brief Get the active radio's index
+ */
+int radio_get_active(void);
+
 // ============================================================================
 // Frequency Operations
 // ============================================================================
@@ -65,6 +101,27 @@ double radio_get_frequency(void);
  */
 int radio_set_frequency(double freq_hz);
 
+// ============================================================================
+// Sessions
+// ============================================================================
+
+/**
+ * @brief Keep the active radio to this thread across several commands
+ *
+ * Until radio_session_end(), the getters and setters called from this
+ * thread run back to back on the bus, with no poll or other thread's
+ * command in between. For batched jobs on the radio worker (macro.h);
+ * sessions don't nest, and a session should not outlast the job.
+ *
+ * @return 0, or -1 if not connected (no session is open then)
+ */
+int radio_session_begin(void);
+
+/**
+ * @brief Let the polling thread and other threads back onto the radio
+ */
+void radio_session_end(void);
+
 // ============================================================================
 // Radio Polling
 // ============================================================================
@@ -79,9 +136,15 @@ typedef void (*radio_freq_change_callback)(double new_freq);
 /**
  * @brief Start polling radio for frequency changes
  *
- * Creates a background thread that polls the radio every 100ms.
- * When frequency changes and remains stable for 1 second, the
- * callback is invoked with the new frequency.
+ * Creates a background thread that polls the radio, every poll_fast_ms
+ * while the frequency is changing and backing off to poll_idle_ms while
+ * it isn't (per radio in config, 50 and 500 ms by default). When the
+ * frequency changes and remains stable for 1 second, the
+ * callback is invoked with the new frequency. If the rig supports
+ * Hamlib transceive mode, it reports frequency changes itself and is
+ * only queried every few seconds (HAMPOD_RADIO_TRANSCEIVE=0 disables).
+ * Connected standby radios get a poller too; it keeps their state fresh
+ * at the idle rate and never announces.
  *
  * @param on_change Callback function for frequency changes
  * @return 0 on success, -1 on error
@@ -99,6 +162,13 @@ void radio_stop_polling(void);
  */
 bool radio_is_polling(void);
 
+/**
+ * @brief Note user activity: poll the active radio now and fast again
+ *
+ * Called on every key press, since one often changes the frequency.
+ */
+void radio_poll_activity(void);
+
 // ============================================================================
 // Auto-Reconnect
 // ============================================================================
@@ -116,13 +186,16 @@ typedef void (*radio_disconnect_callback)(void);
 /**
  * @brief Start auto-reconnect monitoring
  *
- * Creates a background thread that:
- * - If radio is not connected: checks for USB device every few seconds
- *   and attempts radio_init() when the device appears.
+ * Creates a background thread per radio in use that:
+ * - If radio is not connected: looks for the USB serial adapter every
+ *   100 ms (by its USB port once known, so a re-enumerated ttyUSB1 is
+ *   found), connects the moment it appears and retries every second
+ *   while the radio doesn't answer, now and then trying other bauds.
+ *   A new device or baud that works is saved to config.
  * - If radio is connected: monitors for disconnect (repeated query failures).
  *
- * @param on_connect  Called when radio connects/reconnects
- * @param on_disconnect Called when radio disconnects
+ * @param on_connect  Called when the active radio connects/reconnects
+ * @param on_disconnect Called when the active radio disconnects
  * @return 0 on success, -1 on error
  */
 int radio_start_reconnect(radio_connect_callback on_connect,
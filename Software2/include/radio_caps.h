@@ -0,0 +1,96 @@
+/**
+ * @file radio_caps.h
+ * @brief What each radio can read and set, so unsupported calls never
+ * reach the serial port
+ *
+ * A profile per radio: for each cached field (radio_state.h), whether the
+ * rig can read it and whether it can set it. radio.c fills it in at
+ * connect from Hamlib's capability tables (rig_has_get_level() and
+ * friends), which costs no serial traffic. The getters and setters check
+ * here first and give up at once instead of waiting out a timeout.
+ *
+ * The tables aren't always right: a rig can still answer RIG_ENAVAIL or
+ * RIG_ENIMPL for something they list. Such a gap is learned, and saved
+ * per rig model in RADIO_CAPS_DEFAULT_PATH, so later sessions skip it
+ * from the start. Deleting the file forgets them.
+ *
+ * The profiles and the learned gaps share a lock of their own, so a
+ * getter can check a field without waiting for the radio.
+ */
+
+#ifndef RADIO_CAPS_H
+#define RADIO_CAPS_H
+
+#include "radio_state.h"
+
+#include <stdbool.h>
+
+#define RADIO_CAPS_DEFAULT_PATH "config/rig_caps.conf"
+
+/**
+ * @brief Reading or setting a field
+ */
+typedef enum { RADIO_CAP_GET = 0, RADIO_CAP_SET = 1 } RadioCapAccess;
+
+// ============================================================================
+// Lifecycle
+// ============================================================================
+
+/**
+ * @brief Load the gaps learned in earlier sessions
+ * @param path File to load and save, or NULL for RADIO_CAPS_DEFAULT_PATH
+ * @return 0 (a missing file is not an error)
+ */
+int radio_caps_init(const char *path);
+
+// ============================================================================
+// Profiles
+// ============================================================================
+
+/**
+ * @brief Start a radio's profile for a new connection
+ *
+ * Everything counts as supported except the gaps learned for the model.
+ *
+ * @param slot Radio (its radio_state slot)
+ * @param model Hamlib model, or 0 if unknown (rigctld): gaps learned
+ *              then only last for the session
+ */
+void radio_caps_begin(int slot, int model);
+
+/**
+ * @brief Record what Hamlib's capability tables say about a field
+ */
+void radio_caps_set_supported(int slot, RadioField field,
+                              RadioCapAccess access, bool supported);
+
+/**
+ * @brief Make a radio's profile the one radio_caps_has() answers from
+ */
+void radio_caps_select(int slot);
+
+// ============================================================================
+// Checks
+// ============================================================================
+
+/**
+ * @brief Whether the selected radio can read or set a field
+ * @return false only if the field is known to be unsupported
+ */
+bool radio_caps_has(RadioField field, RadioCapAccess access);
+
+/**
+ * @brief Note that the selected radio refused a field its tables list
+ *
+ * Call when a Hamlib call returns RIG_ENAVAIL or RIG_ENIMPL. Saved for
+ * the radio's model.
+ */
+void radio_caps_learn_missing(RadioField field, RadioCapAccess access);
+
+/**
+ * @brief The field a name in rig_caps.conf (or radios.conf) stands for
+ * @return It, or -1 for a name without a capability check
+ */
+int radio_caps_field_named(const char *name);
+
+#endif // RADIO_CAPS_H
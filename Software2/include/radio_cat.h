@@ -0,0 +1,95 @@
+/**
+ * @file radio_cat.h
+ * @brief Native CAT fast path for the hottest radio commands
+ *
+ * The 10 Hz frequency poll pays for Hamlib's command lookup, caching and
+ * retry handling on every call. For Icom (CI-V) and Kenwood radios, this
+ * talks to the rig directly on the port Hamlib already has open, with
+ * frames encoded once at connect and a parser that knows only the
+ * replies it asked for. Hamlib still opens, closes and does everything
+ * else; radio.c calls in here with the radio's lock held, so the two
+ * never share the bus at once.
+ *
+ * Covered, per protocol:
+ *   CI-V:    frequency read and set, S-meter read (raw 0-255)
+ *   Kenwood: frequency read (IF) and set (FA/FB)
+ *
+ * Off unless native_cat = 1 in the radio's [radio.N] section, and never
+ * used in transceive mode, where Hamlib reads the port on its own.
+ *
+ * Needs no Hamlib, so it can be tested against a fake rig on a pipe.
+ */
+
+#ifndef RADIO_CAT_H
+#define RADIO_CAT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define RADIO_CAT_FALLBACK 1    // Not handled here: make the Hamlib call
+#define RADIO_CAT_TIMEOUT_MS 200 // The Hamlib timeout radio.c sets
+#define RADIO_CAT_CIV_CONTROLLER 0xE0 // Our CI-V address, as Hamlib's
+#define RADIO_CAT_BUF 64
+
+typedef enum {
+  RADIO_CAT_NONE = 0,
+  RADIO_CAT_CIV,
+  RADIO_CAT_KENWOOD
+} RadioCatProtocol;
+
+/**
+ * @brief One radio's fast path; used only under that radio's lock
+ */
+typedef struct {
+  RadioCatProtocol protocol;
+  int fd;
+  unsigned char civ_addr; // The rig's CI-V address
+  int freq_bytes;         // CI-V BCD bytes per frequency, 0 until read
+
+  // Pre-encoded requests
+  unsigned char get_freq[8];
+  size_t get_freq_len;
+  unsigned char get_smeter[8];
+  size_t get_smeter_len;
+
+  // Bytes read past the last reply
+  unsigned char buf[RADIO_CAT_BUF];
+  size_t buf_len;
+} RadioCat;
+
+/**
+ * @brief Protocol for a Hamlib manufacturer name ("Icom", "Kenwood")
+ * @return RADIO_CAT_NONE for any other
+ */
+RadioCatProtocol radio_cat_protocol_for(const char *mfg_name);
+
+/**
+ * @brief Set up the fast path on an open port
+ * @param protocol RADIO_CAT_NONE leaves it off
+ * @param civ_addr The rig's CI-V address (CI-V only)
+ */
+void radio_cat_init(RadioCat *cat, RadioCatProtocol protocol, int fd,
+                    unsigned char civ_addr);
+
+/**
+ * @brief Read the current VFO's frequency
+ * @return 0, RADIO_CAT_FALLBACK, or -1 if the rig didn't answer
+ */
+int radio_cat_get_freq(RadioCat *cat, double *freq_hz);
+
+/**
+ * @brief Set the current VFO's frequency
+ * @param vfo_b The current VFO is B (Kenwood names the VFO it sets)
+ * @return 0, RADIO_CAT_FALLBACK, or -1 if the rig refused or didn't answer
+ */
+int radio_cat_set_freq(RadioCat *cat, double freq_hz, bool vfo_b);
+
+/**
+ * @brief Read the S-meter as the rig reports it (CI-V: 0-255)
+ *
+ * The caller converts it with the rig's calibration table.
+ * @return 0, RADIO_CAT_FALLBACK, or -1 if the rig didn't answer
+ */
+int radio_cat_get_smeter_raw(RadioCat *cat, int *raw);
+
+#endif // RADIO_CAT_H
@@ -0,0 +1,75 @@
+/**
+ * @file radio_defs.h
+ * @brief Per-model radio definitions: what sets each rig apart, as data
+ *
+ * One RadioDef per Hamlib model says which fields it cannot read or set,
+ * whether it reports its own changes (transceive), whether it can say
+ * which VFO is in use and what to call each VFO, its poll limits and how
+ * to tell it is still on. radio.c looks them up at connect, so the getters
+ * skip what a model lacks instead of trying it and waiting for an error.
+ *
+ * The definitions live in config/radios.conf. gen_radio_defs.sh turns it
+ * into radio_defs_builtin.h at build time; radio_defs_init() then reads
+ * the file again, so a section added or changed there takes effect at the
+ * next start without a rebuild. A model with no definition gets NULL and
+ * is handled from Hamlib's tables alone.
+ */
+
+#ifndef RADIO_DEFS_H
+#define RADIO_DEFS_H
+
+#include <stdint.h>
+
+#define RADIO_DEFS_DEFAULT_PATH "config/radios.conf"
+#define RADIO_DEFS_MAX 64 // Built-in and loaded together
+#define RADIO_DEF_NAME 24
+#define RADIO_DEF_WORDS 24
+
+/**
+ * @brief A yes/no property, or not stated (Hamlib's tables decide, or the
+ *        call is tried)
+ */
+typedef enum {
+  RADIO_DEF_UNSTATED = 0,
+  RADIO_DEF_NO,
+  RADIO_DEF_YES
+} RadioDefFlag;
+
+/**
+ * @brief How to tell the radio is still on
+ */
+typedef enum {
+  RADIO_PROBE_FREQ = 0, // A frequency read proves it (default)
+  RADIO_PROBE_SMETER    // Hamlib may cache the frequency: read the S-meter
+} RadioProbe;
+
+typedef struct {
+  int model; // Hamlib model
+  char name[RADIO_DEF_NAME];
+  uint32_t no_get; // Fields it cannot read, a bit per RadioField
+  uint32_t no_set; // Fields it cannot set
+  RadioDefFlag transceive; // Reports its own changes
+  RadioDefFlag vfo_query;  // Can say which VFO is in use
+  char vfo_a[RADIO_DEF_WORDS]; // Spoken for each VFO; "" for the default
+  char vfo_b[RADIO_DEF_WORDS];
+  char vfo_current[RADIO_DEF_WORDS];
+  int poll_fast_ms; // 0: [radio.N] or the default
+  int poll_idle_ms;
+  RadioProbe health_probe;
+} RadioDef;
+
+/**
+ * @brief Load the definitions file over the built-in ones
+ * @param path File, or NULL for RADIO_DEFS_DEFAULT_PATH
+ * @return Definitions loaded from it (a missing file is not an error)
+ */
+int radio_defs_init(const char *path);
+
+/**
+ * @brief A model's definition
+ * @return It, or NULL for a model with none (or 0). Valid until the next
+ *         radio_defs_init().
+ */
+const RadioDef *radio_defs_find(int model);
+
+#endif // RADIO_DEFS_H
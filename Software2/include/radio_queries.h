@@ -31,6 +31,14 @@ const char *radio_get_mode_string(void);
  */
 int radio_get_mode_raw(void);
 
+/**
+ * @brief Name a Hamlib mode without asking the radio
+ *
+ * @param mode Hamlib rmode_t value
+ * @return Mode string as radio_get_mode_string() gives it
+ */
+const char *radio_mode_name(int mode);
+
 // ============================================================================
 // VFO Operations
 // ============================================================================
@@ -73,7 +81,8 @@ const char *radio_get_vfo_string(void);
 /**
  * @brief Get S-meter reading
  *
- * The S-meter measures received signal strength.
+ * The S-meter measures received signal strength. While the S-meter is
+ * sampled (meter.h) this is the recent average.
  *
  * @return S-meter value in dB (typically -54 to +30), or -999.0 on error
  */
@@ -93,7 +102,8 @@ const char *radio_get_smeter_string(char *buffer, int buf_size);
 /**
  * @brief Get RF power meter reading
  *
- * Reads the transmit power level during transmission.
+ * Reads the transmit power level during transmission. While the power
+ * meter is sampled (meter.h) this is the recent peak.
  *
  * @return Power level 0.0-1.0 (normalized), or -1.0 on error
  */
@@ -108,6 +118,30 @@ double radio_get_power_meter(void);
  */
 const char *radio_get_power_string(char *buffer, int buf_size);
 
+/**
+ * @brief Meters radio_read_meter() can read
+ */
+typedef enum {
+  RADIO_METER_SMETER = 0, // dB relative to S9
+  RADIO_METER_SWR,        // 1.0 and up
+  RADIO_METER_POWER,      // 0.0-1.0
+  RADIO_METER_ALC,        // 0.0-1.0
+  RADIO_METER_COUNT
+} RadioMeter;
+
+/**
+ * @brief Read a meter from the radio now
+ *
+ * Unlike the getters above this always asks the radio (the reading is
+ * still stored in the cache), for callers sampling a meter several times
+ * a second.
+ *
+ * @param meter Meter to read
+ * @param value Set to the reading, in the unit listed for the meter
+ * @return 0 on success, -1 if not connected or the radio has no such meter
+ */
+int radio_read_meter(RadioMeter meter, double *value);
+
 // ============================================================================
 // VOX Operations
 // ============================================================================
@@ -119,4 +153,46 @@ const char *radio_get_power_string(char *buffer, int buf_size);
  */
 int radio_get_vox_status(void);
 
+// ============================================================================
+// Memory Channels
+// ============================================================================
+
+#define RADIO_MEMORY_NAME_LEN 24
+
+/**
+ * @brief One memory channel as the radio stores it
+ */
+typedef struct {
+  int channel;
+  double freq_hz; // 0 for an empty channel
+  int mode;       // Hamlib rmode_t, 0 if not stored
+  int passband_hz;
+  char name[RADIO_MEMORY_NAME_LEN]; // Empty if none
+} RadioMemory;
+
+/**
+ * @brief The active radio's memory channel numbers
+ *
+ * Only radios whose Hamlib backend reads a channel directly count:
+ * emulating it would switch the rig to every memory in turn.
+ *
+ * @param first Set to the lowest channel number
+ * @param last Set to the highest
+ * @return 0 on success, -1 if not connected or no memories can be read
+ */
+int radio_memory_range(int *first, int *last);
+
+/**
+ * @brief Read consecutive memory channels in one radio session
+ *
+ * Channels are read back to back under a single radio lock; a timeout
+ * ends the session early, like radio_read_status().
+ *
+ * @param first First channel number
+ * @param count Channels to read
+ * @param memories Output, count entries; empty channels have freq_hz 0
+ * @return Number of channels read, -1 if not connected
+ */
+int radio_read_memories(int first, int count, RadioMemory *memories);
+
 #endif // RADIO_QUERIES_H
@@ -14,6 +14,10 @@
 
 #include <stdbool.h>
 
+// Setters return this instead of -1 when the radio lacks the feature
+// (radio_caps.h), so callers can say so rather than "failed"
+#define RADIO_ERR_UNAVAILABLE -3
+
 // ============================================================================
 // Power and Gain Levels
 // ============================================================================
@@ -21,7 +25,7 @@
 /**
  * @brief Set transmit power level
  * @param level Power level 0-100 (percentage)
- * @return 0 on success, -1 on error
+ * @return 0 on success, RADIO_ERR_UNAVAILABLE if unsupported, -1 on error
  */
 int radio_set_power(int level);
 
@@ -34,7 +38,7 @@ int radio_get_power(void);
 /**
  * @brief Set microphone gain level
  * @param level Mic gain 0-100 (percentage)
- * @return 0 on success, -1 on error
+ * @return 0 on success, RADIO_ERR_UNAVAILABLE if unsupported, -1 on error
  */
 int radio_set_mic_gain(int level);
 
@@ -47,7 +51,7 @@ int radio_get_mic_gain(void);
 /**
  * @brief Set compression level
  * @param level Compression 0-100 or 0-10 depending on radio
- * @return 0 on success, -1 on error
+ * @return 0 on success, RADIO_ERR_UNAVAILABLE if unsupported, -1 on error
  */
 int radio_set_compression(int level);
 
@@ -60,7 +64,7 @@ int radio_get_compression(void);
 /**
  * @brief Enable/disable compression
  * @param enabled true to enable, false to disable
- * @return 0 on success, -1 on error
+ * @return 0 on success, RADIO_ERR_UNAVAILABLE if unsupported, -1 on error
  */
 int radio_set_compression_enabled(bool enabled);
 
@@ -78,7 +82,7 @@ bool radio_get_compression_enabled(void);
  * @brief Set Noise Blanker state and level
  * @param enabled true to enable, false to disable
  * @param level NB level 0-10 (only used when enabled)
- * @return 0 on success, -1 on error
+ * @return 0 on success, RADIO_ERR_UNAVAILABLE if unsupported, -1 on error
  */
 int radio_set_nb(bool enabled, int level);
 
@@ -98,7 +102,7 @@ int radio_get_nb_level(void);
  * @brief Set Noise Reduction state and level
  * @param enabled true to enable, false to disable
  * @param level NR level 0-10 (only used when enabled)
- * @return 0 on success, -1 on error
+ * @return 0 on success, RADIO_ERR_UNAVAILABLE if unsupported, -1 on error
  */
 int radio_set_nr(bool enabled, int level);
 
@@ -128,7 +132,7 @@ typedef enum {
 /**
  * @brief Set AGC speed
  * @param speed AGC_OFF, AGC_FAST, AGC_MEDIUM, or AGC_SLOW
- * @return 0 on success, -1 on error
+ * @return 0 on success, RADIO_ERR_UNAVAILABLE if unsupported, -1 on error
  */
 int radio_set_agc_speed(AgcSpeed speed);
 
@@ -144,6 +148,12 @@ AgcSpeed radio_get_agc_speed(void);
  */
 const char* radio_get_agc_string(void);
 
+/**
+ * @brief Name an AGC speed without asking the radio
+ * @return "Off", "Fast", "Medium", "Slow", or "Unknown"
+ */
+const char* radio_agc_speed_name(AgcSpeed speed);
+
 // ============================================================================
 // Preamp and Attenuation
 // ============================================================================
@@ -151,7 +161,7 @@ const char* radio_get_agc_string(void);
 /**
  * @brief Set preamp state
  * @param state 0=off, 1=preamp1, 2=preamp2
- * @return 0 on success, -1 on error
+ * @return 0 on success, RADIO_ERR_UNAVAILABLE if unsupported, -1 on error
  */
 int radio_set_preamp(int state);
 
@@ -164,7 +174,7 @@ int radio_get_preamp(void);
 /**
  * @brief Set attenuation level
  * @param db Attenuation in dB (0=off, typical values: 6, 12, 18, 20)
- * @return 0 on success, -1 on error
+ * @return 0 on success, RADIO_ERR_UNAVAILABLE if unsupported, -1 on error
  */
 int radio_set_attenuation(int db);
 
@@ -179,16 +189,61 @@ int radio_get_attenuation(void);
 // ============================================================================
 
 /**
- * @brief Cycle to next available operating mode
+ * @brief Cycle to the next operating mode the radio lists
  * @return 0 on success, -1 on error
  */
 int radio_cycle_mode(void);
 
 /**
  * @brief Set specific operating mode
- * @param mode_index Index into mode list (0=AM, 1=CW, 2=USB, 3=LSB, 4=FM, 5=RTTY)
- * @return 0 on success, -1 on error
+ * @param mode_index Index into mode list (0=USB, 1=LSB, 2=CW, 3=AM, 4=FM, 5=RTTY)
+ * @return 0 on success, RADIO_ERR_UNAVAILABLE if unsupported, -1 on error
  */
 int radio_set_mode_by_index(int mode_index);
 
+/**
+ * @brief Set an operating mode and passband as Hamlib numbers them
+ * @param mode Hamlib rmode_t value
+ * @param passband_hz Passband, or 0 for the mode's normal one
+ * @return 0 on success, RADIO_ERR_UNAVAILABLE if unsupported, -1 on error
+ */
+int radio_set_mode_raw(int mode, int passband_hz);
+
+// ============================================================================
+// Batched Status Read
+// ============================================================================
+
+/**
+ * @brief Everything Set Mode can adjust, as the radio reports it
+ *
+ * Each field is -1 if the radio can't report it or didn't answer.
+ * Toggles are 1/0; agc is an AgcSpeed.
+ */
+typedef struct {
+    int power;
+    int mic_gain;
+    int compression;
+    int compression_on;
+    int nb_on;
+    int nb_level;
+    int nr_on;
+    int nr_level;
+    int agc;
+    int preamp;
+    int attenuation;
+} RadioStatus;
+
+/**
+ * @brief Read all Set Mode parameters in one radio session
+ *
+ * Fresh values come from the radio state cache; the rest are queried
+ * back to back under a single radio lock and cached, so the
+ * getters above answer from the cache afterwards. Parameters the rig
+ * can't read are skipped, and a timeout ends the session early.
+ *
+ * @param status Output, may be NULL to only fill the cache
+ * @return Number of fields known, -1 if not connected
+ */
+int radio_read_status(RadioStatus *status);
+
 #endif // RADIO_SETTERS_H
@@ -0,0 +1,160 @@
+/**
+ * @file radio_state.h
+ * @brief Cached radio state with per-field age
+ *
+ * The last value read from (or reported by) the radio for each field,
+ * with when it was read. The radio getters answer from here while a value
+ * is fresh enough, so an announcement needs no serial round trip and
+ * doesn't wait for the radio's lock. The polling thread and transceive events
+ * keep the frequency (and, with events, the mode) current; setters drop
+ * the fields they change so the next read asks the radio.
+ *
+ * Has its own lock and never touches Hamlib, so it can be read while
+ * another thread holds the bus.
+ *
+ * There is one set of fields per configured radio. The plain functions
+ * act on the selected one (the active radio); the _for variants let a
+ * background radio's poller keep its own fields warm.
+ */
+
+#ifndef RADIO_STATE_H
+#define RADIO_STATE_H
+
+#include <stdbool.h>
+
+#define RADIO_STATE_SLOTS 10 // One per configured radio (MAX_RADIOS)
+
+// ============================================================================
+// Fields
+// ============================================================================
+
+/**
+ * @brief Cached fields, each in the unit its getter returns
+ */
+typedef enum {
+  RADIO_FIELD_FREQ = 0,    // Hz
+  RADIO_FIELD_MODE,        // Hamlib rmode_t
+  RADIO_FIELD_PASSBAND,    // Hz
+  RADIO_FIELD_VFO,         // RadioVfo
+  RADIO_FIELD_SMETER,      // dB relative to S9
+  RADIO_FIELD_POWER_METER, // 0.0-1.0
+  RADIO_FIELD_SWR,         // 1.0 and up
+  RADIO_FIELD_ALC,         // 0.0-1.0
+  RADIO_FIELD_POWER,       // 0-100
+  RADIO_FIELD_MIC_GAIN,    // 0-100
+  RADIO_FIELD_COMP,        // 0-100
+  RADIO_FIELD_COMP_ON,     // 0/1
+  RADIO_FIELD_NB_ON,       // 0/1
+  RADIO_FIELD_NB_LEVEL,    // 0-10
+  RADIO_FIELD_NR_ON,       // 0/1
+  RADIO_FIELD_NR_LEVEL,    // 0-10
+  RADIO_FIELD_AGC,         // AgcSpeed
+  RADIO_FIELD_PREAMP,      // 0/1/2
+  RADIO_FIELD_ATT,         // dB
+  RADIO_FIELD_VOX,         // 0/1
+  RADIO_FIELD_COUNT
+} RadioField;
+
+/**
+ * @brief Every field at one instant
+ */
+typedef struct {
+  double value[RADIO_FIELD_COUNT];
+  int age_ms[RADIO_FIELD_COUNT]; // -1 if not known
+} RadioStateSnapshot;
+
+// ============================================================================
+// Reads
+// ============================================================================
+
+/**
+ * @brief Get a field if it is fresh enough for announcing
+ *
+ * Tolerances: frequency 200 ms (the polling thread refreshes it every
+ * 100 ms), mode and VFO 1 s, meters 500 ms, levels and toggles 5 s.
+ *
+ * @param field Field to read
+ * @param value Set to the cached value
+ * @return true if known and within tolerance
+ */
+bool radio_state_get(RadioField field, double *value);
+
+/**
+ * @brief Get a field if it was read at most max_age_ms ago
+ *
+ * @param field Field to read
+ * @param max_age_ms Oldest acceptable value
+ * @param value Set to the cached value
+ * @return true if known and young enough
+ */
+bool radio_state_get_within(RadioField field, int max_age_ms, double *value);
+
+/**
+ * @brief Copy every field with its age under one lock
+ *
+ * @param snapshot Filled in
+ */
+void radio_state_snapshot(RadioStateSnapshot *snapshot);
+
+// ============================================================================
+// Updates
+// ============================================================================
+
+/**
+ * @brief Record a value just read from or reported by the radio
+ */
+void radio_state_store(RadioField field, double value);
+
+/**
+ * @brief Forget a field, e.g. after setting it, so the next read is live
+ */
+void radio_state_invalidate(RadioField field);
+
+/**
+ * @brief Forget everything (connect, disconnect, VFO switch)
+ */
+void radio_state_clear(void);
+
+/**
+ * @brief Called when a field of the selected radio changes
+ *
+ * With the new value, from the thread that stored it, outside the lock.
+ * A value stored again unchanged is not reported; nor is a field
+ * forgotten.
+ */
+typedef void (*RadioStateListener)(RadioField field, double value);
+
+/**
+ * @brief Set the one listener told about changes (NULL for none)
+ *
+ * Used by the local API (api.h) to stream the radio's state without
+ * polling it.
+ */
+void radio_state_set_listener(RadioStateListener listener);
+
+// ============================================================================
+// Radios
+// ============================================================================
+
+/**
+ * @brief Make a radio's fields the ones the plain functions use
+ * @param slot Radio index, 0 to RADIO_STATE_SLOTS-1
+ */
+void radio_state_select(int slot);
+
+/**
+ * @brief radio_state_store() for a given radio
+ */
+void radio_state_store_for(int slot, RadioField field, double value);
+
+/**
+ * @brief radio_state_invalidate() for a given radio
+ */
+void radio_state_invalidate_for(int slot, RadioField field);
+
+/**
+ * @brief radio_state_clear() for a given radio
+ */
+void radio_state_clear_for(int slot);
+
+#endif // RADIO_STATE_H
@@ -0,0 +1,133 @@
+/**
+ * @file radio_trace.h
+ * @brief Time spent in each Hamlib call, as per-operation histograms
+ *
+ * Every Hamlib call in radio.c, radio_queries.c and radio_setters.c goes
+ * through RADIO_TRACED(), which times it and records the result against
+ * its operation (rig_get_freq, rig_set_level, ...). The time the caller
+ * waited for the radio's lock before it is recorded with it, so a slow
+ * readout shows whether the rig was slow to answer or another thread
+ * held the radio. Error codes are counted per operation.
+ *
+ * Much quieter than rig_set_debug(RIG_DEBUG_TRACE): nothing is printed
+ * until radio_trace_report() is called, by `hampod radio-latency`
+ * (SIGUSR1) or at shutdown.
+ *
+ * The histograms have a lock of their own, held only while a call's
+ * counters are bumped, so a report never waits on a slow rig.
+ */
+
+#ifndef RADIO_TRACE_H
+#define RADIO_TRACE_H
+
+#include <stdio.h>
+
+#define RADIO_TRACE_FILE "/dev/shm/hampod_radio_latency"
+
+// Histogram buckets: under 1, 2, 5, 10, 20, 50, 100, 200, 500 and 1000 ms,
+// then the rest
+#define RADIO_TRACE_BUCKETS 11
+
+// Error codes counted one by one (Hamlib's rig_errcode_e); larger ones
+// share the last count
+#define RADIO_TRACE_CODES 24
+
+/**
+ * @brief Hamlib operation a call is recorded against
+ */
+typedef enum {
+  RADIO_OP_OPEN = 0,
+  RADIO_OP_GET_FREQ,
+  RADIO_OP_SET_FREQ,
+  RADIO_OP_GET_MODE,
+  RADIO_OP_SET_MODE,
+  RADIO_OP_GET_VFO,
+  RADIO_OP_SET_VFO,
+  RADIO_OP_GET_LEVEL,
+  RADIO_OP_SET_LEVEL,
+  RADIO_OP_GET_FUNC,
+  RADIO_OP_SET_FUNC,
+  RADIO_OP_SET_TRN,
+  RADIO_OP_GET_CHANNEL,
+  RADIO_OP_CAT_GET_FREQ, // The same, by the native fast path (radio_cat.h)
+  RADIO_OP_CAT_SET_FREQ,
+  RADIO_OP_CAT_GET_SMETER,
+  RADIO_OP_COUNT
+} RadioOp;
+
+/**
+ * @brief What was recorded for one operation
+ */
+typedef struct {
+  unsigned long calls;
+  unsigned long errors; // Calls that didn't return RIG_OK
+  unsigned long call_buckets[RADIO_TRACE_BUCKETS]; // Time in Hamlib
+  unsigned long wait_buckets[RADIO_TRACE_BUCKETS]; // Time waiting to lock
+  long long call_us_total;
+  long long call_us_max;
+  long long wait_us_total;
+  long long wait_us_max;
+  unsigned long codes[RADIO_TRACE_CODES]; // By -retcode; codes[0] unused
+} RadioTraceStats;
+
+// ============================================================================
+// Recording
+// ============================================================================
+
+/**
+ * @brief Time a Hamlib call and record it
+ *
+ * Evaluates to the call's return code:
+ *   int retcode = RADIO_TRACED(RADIO_OP_GET_FREQ, rig_get_freq(...));
+ */
+#define RADIO_TRACED(op, call)                                                 \
+  radio_trace_end((op), (radio_trace_begin(), (call)))
+
+/**
+ * @brief Note how long this thread just waited for a radio's lock
+ *
+ * Charged to the next call this thread records, then forgotten.
+ */
+void radio_trace_lock_waited(long long wait_us);
+
+/**
+ * @brief Start timing a call on this thread (see RADIO_TRACED())
+ */
+void radio_trace_begin(void);
+
+/**
+ * @brief Record the call started by radio_trace_begin()
+ * @return retcode, unchanged
+ */
+int radio_trace_end(RadioOp op, int retcode);
+
+// ============================================================================
+// Reading
+// ============================================================================
+
+/**
+ * @brief Get what was recorded for an operation
+ * @return 0 on success, -1 for an unknown operation
+ */
+int radio_trace_get(RadioOp op, RadioTraceStats *stats);
+
+/**
+ * @brief Operation name, as in the report ("get_freq", ...)
+ */
+const char *radio_trace_op_name(RadioOp op);
+
+/**
+ * Write, for each operation called so far, the calls, errors, mean and
+ * max times, then histograms of the time spent in Hamlib and waiting for
+ * the lock, then the error codes seen.
+ *
+ * @param out Stream to write to
+ */
+void radio_trace_report(FILE *out);
+
+/**
+ * @brief Forget everything recorded
+ */
+void radio_trace_reset(void);
+
+#endif // RADIO_TRACE_H
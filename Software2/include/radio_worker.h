@@ -0,0 +1,132 @@
+/**
+ * @file radio_worker.h
+ * @brief Radio command worker: runs radio commands off the keypad thread
+ *
+ * Setting something on the radio holds the radio lock across one or more
+ * serial transactions, each up to the 200 ms Hamlib timeout, and longer
+ * while the polling thread has the bus. The mode modules queue such
+ * commands here instead; one worker thread runs them in order and calls
+ * a completion callback (on the worker thread) with the result, so key
+ * handling never waits on the serial port.
+ *
+ * A command with a supersede key replaces a queued, not yet started
+ * command with the same key (e.g. typing a second frequency before the
+ * first was set), whose callback then gets RADIO_CMD_CANCELLED.
+ *
+ * This is the radios' device worker (device_worker.h); every radio shares
+ * it, since commands talk to the active one.
+ */
+
+#ifndef RADIO_WORKER_H
+#define RADIO_WORKER_H
+
+#include "device_worker.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// ============================================================================
+// Commands
+// ============================================================================
+
+#define RADIO_CMD_MAX_ARG DEVICE_CMD_MAX_ARG
+#define RADIO_CMD_CANCELLED DEVICE_CMD_CANCELLED
+
+/**
+ * @brief Which queued commands run first
+ */
+typedef enum {
+  RADIO_CMD_BACKGROUND = 0, // Housekeeping, runs when nothing else waits
+  RADIO_CMD_USER = 1        // A key press is waiting for the result
+} RadioCommandPriority;
+
+/**
+ * @brief Supersede keys: a new command replaces a queued one with its key
+ */
+typedef enum {
+  RADIO_KEY_NONE = 0, // Never superseded (e.g. relative changes)
+  RADIO_KEY_FREQUENCY,
+  RADIO_KEY_VFO,
+  RADIO_KEY_MODE,
+  RADIO_KEY_POWER,
+  RADIO_KEY_MIC_GAIN,
+  RADIO_KEY_COMPRESSION,
+  RADIO_KEY_NB,
+  RADIO_KEY_NR,
+  RADIO_KEY_AGC,
+  RADIO_KEY_PREAMP,
+  RADIO_KEY_ATTENUATION,
+  RADIO_KEY_STATUS, // Batched status read
+  RADIO_KEY_SCAN,   // One scan step (scan.c)
+  RADIO_KEY_MEMORY, // One chunk of the memory channel read (memory_index.c)
+  RADIO_KEY_METER   // One round of meter samples (meter.c)
+} RadioCommandKey;
+
+/**
+ * @brief Talks to the radio; runs on the worker thread
+ */
+typedef DeviceCommandFn RadioCommandFn;
+
+/**
+ * @brief Called on the worker thread when a command finished or was
+ * cancelled. May call radio getters and queue speech.
+ */
+typedef DeviceCommandDone RadioCommandDone;
+
+// ============================================================================
+// Lifecycle
+// ============================================================================
+
+/**
+ * @brief Start the worker thread
+ * @return 0 on success, -1 on error
+ */
+int radio_worker_start(void);
+
+/**
+ * @brief Finish the running command, cancel queued ones and stop
+ */
+void radio_worker_stop(void);
+
+/**
+ * @brief Get the worker thread, e.g. to set its scheduling priority
+ */
+pthread_t radio_worker_get_thread(void);
+
+// ============================================================================
+// Submitting
+// ============================================================================
+
+/**
+ * @brief Queue a command (non-blocking)
+ *
+ * Without a running worker (tests, tools) the command runs at once on
+ * the calling thread.
+ *
+ * @param priority RADIO_CMD_USER or RADIO_CMD_BACKGROUND
+ * @param key Supersede key, RADIO_KEY_NONE for none
+ * @param run Command to run
+ * @param done Completion callback, or NULL
+ * @param arg Argument, copied (at most RADIO_CMD_MAX_ARG bytes), or NULL
+ * @param arg_size Size of arg
+ * @return 0 if queued, -1 if the queue is full or arg too large
+ */
+int radio_worker_submit(RadioCommandPriority priority, RadioCommandKey key,
+                        RadioCommandFn run, RadioCommandDone done,
+                        const void *arg, size_t arg_size);
+
+/**
+ * @brief Cancel every queued command with this key
+ * @return Number of commands cancelled
+ */
+int radio_worker_cancel(RadioCommandKey key);
+
+/**
+ * @brief Wait until nothing is queued or running
+ * @param timeout_ms Maximum wait, -1 for no limit
+ * @return true if idle
+ */
+bool radio_worker_wait_idle(int timeout_ms);
+
+#endif // RADIO_WORKER_H
@@ -0,0 +1,111 @@
+/**
+ * @file rotor.h
+ * @brief Antenna rotor control through Hamlib's rotator API
+ *
+ * The rotor configured in [rotor] is a device of its own beside the
+ * radios: its own Hamlib handle and lock, its own command worker
+ * (device_worker.h), its own poll thread and a cached position. Turning
+ * the antenna never waits on a radio's serial bus, nor a radio command
+ * on the rotor's.
+ *
+ * The poll thread connects the rotor, reconnecting it whenever it stops
+ * answering, and reads its position every poll_fast_ms while it turns
+ * and every poll_idle_ms while it is still. When it comes to rest after
+ * turning, for a command or by hand on its control box, the stop callback
+ * gets the bearing.
+ *
+ * Commands that talk to the rotor (rotor_set_azimuth(), rotor_halt()) run
+ * on its worker: queue them with rotor_submit().
+ */
+
+#ifndef ROTOR_H
+#define ROTOR_H
+
+#include "device_worker.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Supersede keys of rotor commands
+ */
+typedef enum {
+  ROTOR_KEY_NONE = 0,
+  ROTOR_KEY_POSITION // Turn or stop: the latest one wins
+} RotorCommandKey;
+
+/**
+ * @brief Called on the poll thread when the rotor comes to rest
+ * @param azimuth Bearing in degrees
+ */
+typedef void (*RotorStopCallback)(double azimuth);
+
+// ============================================================================
+// Lifecycle
+// ============================================================================
+
+/**
+ * @brief Start the rotor's worker and poll thread, if one is configured
+ *
+ * Returns at once; the poll thread connects in the background.
+ *
+ * @param on_stop Called when the rotor comes to rest, or NULL
+ * @return 0 if started, -1 if no rotor is configured or it failed
+ */
+int rotor_init(RotorStopCallback on_stop);
+
+/**
+ * @brief Stop the worker and poll thread and close the rotor
+ */
+void rotor_cleanup(void);
+
+/**
+ * @brief Whether rotor_init() started a rotor
+ */
+bool rotor_is_configured(void);
+
+/**
+ * @brief Whether the rotor is connected and answering
+ */
+bool rotor_is_connected(void);
+
+// ============================================================================
+// Cached State (never blocks)
+// ============================================================================
+
+/**
+ * @brief The last position read
+ * @return false if none has been read since it connected
+ */
+bool rotor_get_position(double *azimuth, double *elevation);
+
+/**
+ * @brief Whether the rotor was turning at the last poll
+ */
+bool rotor_is_moving(void);
+
+// ============================================================================
+// Commands
+// ============================================================================
+
+/**
+ * @brief Queue a command on the rotor's worker (non-blocking)
+ * @return 0 if queued, -1 if not (no rotor, queue full)
+ */
+int rotor_submit(RotorCommandKey key, DeviceCommandFn run,
+                 DeviceCommandDone done, const void *arg, size_t arg_size);
+
+/**
+ * @brief Turn to a bearing, keeping the elevation (worker thread)
+ * @param azimuth Degrees, 0 to 360
+ * @return 0 on success, -1 on error or if not connected
+ */
+int rotor_set_azimuth(double azimuth);
+
+/**
+ * @brief Stop turning (worker thread)
+ * @return 0 on success, -1 on error or if not connected
+ */
+int rotor_halt(void);
+
+#endif // ROTOR_H
@@ -0,0 +1,48 @@
+/**
+ * @file rotor_mode.h
+ * @brief Keypad context for the antenna rotor
+ *
+ * The device-select key ([D] held) moves the keypad between the radio and
+ * the rotor. While the rotor has it:
+ * - Digits enter a bearing, echoed as they are typed
+ * - [#] turns to the bearing entered, or says where the antenna points
+ * - [*] clears the digits entered, or stops the rotor if there are none
+ *
+ * The rotor is announced when it comes to rest, whichever context the
+ * keypad is in.
+ */
+
+#ifndef ROTOR_MODE_H
+#define ROTOR_MODE_H
+
+#include <stdbool.h>
+
+/**
+ * @brief Give the keypad to the rotor and say where it points
+ */
+void rotor_mode_enter(void);
+
+/**
+ * @brief Give the keypad back to the radio, dropping any digits entered
+ */
+void rotor_mode_exit(void);
+
+/**
+ * @brief Whether the keypad is on the rotor
+ */
+bool rotor_mode_is_active(void);
+
+/**
+ * @brief Handle a key while the rotor has the keypad
+ * @param key The key character
+ * @param is_hold true if the key was held
+ * @return true if consumed, false if the key means nothing here
+ */
+bool rotor_mode_handle_key(char key, bool is_hold);
+
+/**
+ * @brief Stop callback for rotor_init(): say the bearing it stopped at
+ */
+void rotor_mode_on_stop(double azimuth);
+
+#endif // ROTOR_MODE_H
@@ -0,0 +1,76 @@
+/**
+ * @file scan.h
+ * @brief Scan: step through channels until a signal breaks the squelch
+ *
+ * Steps through the current band (from the current frequency, by the
+ * configured step, wrapping at the band edge) or through the band stack
+ * memories. On each channel it listens for the configured dwell time,
+ * reads the S-meter, and stops on the first reading at or above the
+ * threshold, announcing where and how strong.
+ *
+ * Each step is one radio worker command, so the keypad thread never
+ * waits on the serial port: it reads the S-meter on the channel just
+ * listened to and, unless that was a hit, sets the next channel in the
+ * same command, with no round trip in between. A scan thread only times
+ * the dwell between commands, so a step costs the dwell plus one meter
+ * read and one frequency set on the CAT link. Steps are queued in the
+ * background class, so a key press always gets the radio first.
+ *
+ * Progress is announced every couple of seconds and hits at once, both
+ * in SPEECH_SLOT_SCAN, so only the latest frequency is ever spoken.
+ */
+
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stdbool.h>
+
+/**
+ * @brief What to scan
+ */
+typedef enum {
+  SCAN_BAND = 0, // The current band, by the configured step
+  SCAN_MEMORIES  // Each band's remembered frequency (band_stack.h)
+} ScanSource;
+
+// ============================================================================
+// Channels
+// ============================================================================
+
+/**
+ * @brief Channel after a frequency in a range, wrapping to the bottom
+ *
+ * Channels are the multiples of step_hz inside low_hz..high_hz, so a
+ * scan started off the grid lands on it at the first step.
+ *
+ * @return Next channel in Hz
+ */
+double scan_next_channel(double freq_hz, double low_hz, double high_hz,
+                         int step_hz);
+
+// ============================================================================
+// Control
+// ============================================================================
+
+/**
+ * @brief Start scanning, or restart from the current frequency
+ * @param source What to scan
+ * @return 0 on success, -1 if the radio is outside every band (for
+ *         SCAN_BAND) or the scan thread could not start
+ */
+int scan_start(ScanSource source);
+
+/**
+ * @brief Stop scanning and wait for the scan thread
+ *
+ * A step already running on the radio worker finishes but sets no
+ * further channel.
+ */
+void scan_stop(void);
+
+/**
+ * @brief Whether a scan is running
+ */
+bool scan_is_active(void);
+
+#endif // SCAN_H
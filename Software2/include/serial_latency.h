@@ -0,0 +1,50 @@
+/**
+ * @file serial_latency.h
+ * @brief Low-latency tuning of a radio's USB-serial adapter
+ *
+ * FTDI adapters hold received bytes for up to latency_timer ms (16 by
+ * default) before handing them to the host, and the tty layer may defer
+ * them again; both add to every CAT reply. On connect, radio.c sets the
+ * adapter's latency_timer to 1 ms through sysfs (FTDI; CP210x has none
+ * and is left alone) and ASYNC_LOW_LATENCY on the open port, then puts
+ * both back when the radio is closed.
+ *
+ * Each step is best effort: an adapter without the setting, or no
+ * permission to change it, only leaves the latency as it was.
+ */
+
+#ifndef SERIAL_LATENCY_H
+#define SERIAL_LATENCY_H
+
+#include <stdbool.h>
+
+#define SERIAL_LATENCY_SYSFS "/sys/class/tty"
+#define SERIAL_LATENCY_TIMER_MS 1
+
+/**
+ * @brief What was changed, to put back
+ */
+typedef struct {
+  char timer_path[160]; // sysfs latency_timer, "" if untouched
+  int timer_ms;         // Its value before
+  bool low_latency;     // ASYNC_LOW_LATENCY was set by us
+} SerialLatency;
+
+/**
+ * @brief Tune a serial port for low latency
+ * @param saved Receives what to restore
+ * @param sysfs_tty SERIAL_LATENCY_SYSFS (a test's own tree otherwise)
+ * @param device The port, e.g. "/dev/ttyUSB0"
+ * @param fd The port open, or -1 to change only sysfs
+ * @return true if anything was changed
+ */
+bool serial_latency_tune(SerialLatency *saved, const char *sysfs_tty,
+                         const char *device, int fd);
+
+/**
+ * @brief Put back what serial_latency_tune() changed
+ * @param fd The port still open, or -1 if it is closed
+ */
+void serial_latency_restore(SerialLatency *saved, int fd);
+
+#endif // SERIAL_LATENCY_H
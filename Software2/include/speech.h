@@ -12,6 +12,10 @@
  *   // ... speech plays in background ...
  *   speech_shutdown();                // Stop speech thread
  *
+ * Items are queued in a priority class (SpeechPriority); the plain calls
+ * use SPEECH_INTERACTIVE. Readouts that go stale are queued in a slot
+ * (SpeechSlot), where a newer one replaces them.
+ *
  * Part of Phase 0: Core Infrastructure (Step 2.1)
  */
 
@@ -19,6 +23,8 @@
 #define SPEECH_H
 
 #include "hampod_core.h"
+#include <pthread.h>
+#include <stdio.h>
 
 // ============================================================================
 // Initialization & Cleanup
@@ -48,29 +54,138 @@ void speech_shutdown(void);
  */
 bool speech_is_running(void);
 
+/**
+ * Get the speech thread, e.g. to raise its priority.
+ * Only valid while speech_is_running().
+ */
+pthread_t speech_get_thread(void);
+
 // ============================================================================
 // Speech Queue API
 // ============================================================================
 
+/**
+ * Priority classes, highest first.
+ *
+ * The highest class with anything queued is spoken first, oldest item
+ * first. Queuing above the class that is playing cuts it off (Firmware is
+ * sent an interrupt). When the queue is full, the oldest item of a lower
+ * class is dropped to make room; background items are dropped rather
+ * than waiting for room.
+ */
+typedef enum {
+  SPEECH_URGENT,      // Must reach the operator now, e.g. radio lost
+  SPEECH_INTERACTIVE, // Replies to the operator's keys
+  SPEECH_BACKGROUND,  // Announcements nobody asked for, e.g. dial changes
+  SPEECH_PRIORITY_COUNT
+} SpeechPriority;
+
+/**
+ * Coalescing slots for readouts that a newer value makes stale.
+ *
+ * At most one item per slot is queued: queuing another replaces it, in
+ * place if it is of the same class. Optionally it also cuts off the one
+ * playing, so spinning the dial only ever reads out where it is now.
+ */
+typedef enum {
+  SPEECH_SLOT_NONE, // Not coalesced
+  SPEECH_SLOT_FREQUENCY,
+  SPEECH_SLOT_MODE,
+  SPEECH_SLOT_VFO,
+  SPEECH_SLOT_METER, // S-meter and power meter readings
+  SPEECH_SLOT_SCAN,  // Scan progress and hits
+  SPEECH_SLOT_COUNT
+} SpeechSlot;
+
 /**
  * Queue text for speech synthesis (non-blocking).
  *
  * The text is added to a queue and spoken in the background.
  * This call returns immediately.
  *
+ * @param text The text to speak, at most COMM_MAX_TEXT_LEN bytes
+ * @return HAMPOD_OK on success, HAMPOD_ERROR if queue is full or the text
+ *         too long
+ */
+int speech_say_text(const char *text);
+
+/**
+ * Queue text for speech synthesis in a priority class (non-blocking,
+ * except that an urgent or interactive item waits for room while the
+ * queue is full of its own class and higher ones).
+ *
  * @param text The text to speak
+ * @param priority Its class
  * @return HAMPOD_OK on success, HAMPOD_ERROR if queue is full
  */
-int speech_say_text(const char *text);
+int speech_say_text_priority(const char *text, SpeechPriority priority);
+
+/**
+ * Queue text in a priority class and coalescing slot (non-blocking).
+ *
+ * @param text The text to speak
+ * @param priority Its class
+ * @param slot Its slot; the item queued there is replaced
+ * @param cut_off Also cut off the slot's item if it is playing
+ * @return HAMPOD_OK on success, HAMPOD_ERROR if queue is full
+ */
+int speech_say_text_latest(const char *text, SpeechPriority priority,
+                           SpeechSlot slot, bool cut_off);
+
+/**
+ * Queue text that is only worth saying soon, e.g. a meter reading
+ * (non-blocking).
+ *
+ * If it has not started playing ttl_ms after being queued, it is dropped
+ * unsaid: by the speech thread while it is queued, or by Firmware before
+ * synthesizing it. Either way it is counted (speech_expired_total or
+ * audio_expired_total, hampod_metrics.h) and done for speech_wait_item().
+ * It goes to Firmware as a sequence, so it is not merged with others.
+ *
+ * @param text The text to speak
+ * @param priority Its class
+ * @param slot Its slot, or SPEECH_SLOT_NONE
+ * @param cut_off Also cut off the slot's item if it is playing
+ * @param ttl_ms Time to live, 0 for none
+ * @return HAMPOD_OK on success, HAMPOD_ERROR if queue is full
+ */
+int speech_say_text_ttl(const char *text, SpeechPriority priority,
+                        SpeechSlot slot, bool cut_off, int ttl_ms);
 
 /**
  * Queue text to be spelled out character by character (non-blocking).
  *
+ * Firmware plays each character as a pregenerated clip or cached word, in
+ * the style speech_set_spell_style() set.
+ *
  * @param text The text to spell
  * @return HAMPOD_OK on success, HAMPOD_ERROR if queue is full
  */
 int speech_spell_text(const char *text);
 
+/**
+ * Set how speech_spell_text() spells from now on.
+ *
+ * @param phonetic Letters as the NATO phonetic alphabet ("Alfa", "Bravo")
+ *                 instead of their names
+ * @param gap_ms Silence between characters, 0-AUDIO_SPELL_GAP_MAX_MS
+ */
+void speech_set_spell_style(bool phonetic, int gap_ms);
+
+#define SPEECH_VOICE_NAME_MAX 16 // Voice names, with the NUL
+
+/**
+ * Speak a class's text and sequences in a voice of the [voices] registry
+ * from now on, e.g. urgent alerts in a voice of their own.
+ *
+ * Items are sent as a sequence that selects the voice first; one too long
+ * for that is spoken in the default voice.
+ *
+ * @param priority The class
+ * @param voice Voice name, or NULL or "" for the default voice
+ */
+void speech_set_priority_voice(SpeechPriority priority, const char *voice);
+
 /**
  * Queue an audio file for playback (non-blocking).
  *
@@ -79,13 +194,238 @@ int speech_spell_text(const char *text);
  */
 int speech_play_file(const char *filepath);
 
+/**
+ * Say the last announcement again (non-blocking).
+ *
+ * Firmware keeps the audio of the last few announcements and plays it back
+ * as it was heard, so this speaks at once even where the announcement took
+ * a while to synthesize; a reading is repeated, not read again. Firmware
+ * refuses it if nothing has been said yet.
+ */
+void speech_say_again(void);
+
+// ============================================================================
+// Speak Sequences
+// ============================================================================
+
+#define SPEECH_SEQUENCE_MAX 254 // Payload bytes that fit one audio packet
+
+/**
+ * An announcement built from several parts, sent as one audio packet.
+ *
+ * Firmware plays the segments back to back and acks once, and speaks
+ * adjacent text segments as a single utterance, so there is no pause
+ * between e.g. an item name and its value.
+ *
+ * Usage:
+ *   SpeechSequence seq;
+ *   speech_sequence_init(&seq);
+ *   speech_sequence_add_text(&seq, "VFO A.");
+ *   speech_sequence_add_text(&seq, "14 point 2 megahertz");
+ *   speech_say_sequence(&seq);
+ */
+typedef struct {
+  char payload[SPEECH_SEQUENCE_MAX + 1];
+  int length;
+  bool overflow; // A segment did not fit; the sequence is refused
+} SpeechSequence;
+
+/**
+ * Start an empty sequence.
+ */
+void speech_sequence_init(SpeechSequence *seq);
+
+/**
+ * Append a TTS text segment.
+ * @return HAMPOD_OK, or HAMPOD_ERROR if it does not fit
+ */
+int speech_sequence_add_text(SpeechSequence *seq, const char *text);
+
+/**
+ * Append a readout spoken one word at a time, e.g. "14 point 2 megahertz".
+ *
+ * Firmware caches each word on its own, so digits, units and modes are
+ * synthesized once and a new frequency or meter value plays at once
+ * instead of waiting for a whole new utterance.
+ * @return HAMPOD_OK, or HAMPOD_ERROR if it does not fit
+ */
+int speech_sequence_add_words(SpeechSequence *seq, const char *words);
+
+/**
+ * Append a pre-recorded clip (path as for speech_play_file()).
+ * @return HAMPOD_OK, or HAMPOD_ERROR if it does not fit
+ */
+int speech_sequence_add_file(SpeechSequence *seq, const char *filepath);
+
+/**
+ * Append a cached beep: 'k' keypress, 'h' hold, 'e' error.
+ * @return HAMPOD_OK, or HAMPOD_ERROR if it does not fit
+ */
+int speech_sequence_add_beep(SpeechSequence *seq, char beep);
+
+/**
+ * Append a silent gap (Firmware caps it at 2 seconds).
+ * @return HAMPOD_OK, or HAMPOD_ERROR if it does not fit
+ */
+int speech_sequence_add_gap(SpeechSequence *seq, int ms);
+
+/**
+ * Speak the rest of the sequence in a voice of the [voices] registry
+ * ("" for the default voice; Firmware uses the default for unknown ones).
+ * @return HAMPOD_OK, or HAMPOD_ERROR if it does not fit
+ */
+int speech_sequence_add_voice(SpeechSequence *seq, const char *voice);
+
+/**
+ * Queue a sequence for playback (non-blocking).
+ *
+ * @param seq Sequence built with the speech_sequence_* functions
+ * @return HAMPOD_OK on success, HAMPOD_ERROR if it is empty, overflowed
+ *         or the queue is full
+ */
+int speech_say_sequence(const SpeechSequence *seq);
+
+/**
+ * Queue a sequence in a priority class (see speech_say_text_priority()).
+ */
+int speech_say_sequence_priority(const SpeechSequence *seq,
+                                 SpeechPriority priority);
+
+/**
+ * Queue a sequence in a priority class and coalescing slot (see
+ * speech_say_text_latest()).
+ */
+int speech_say_sequence_latest(const SpeechSequence *seq,
+                               SpeechPriority priority, SpeechSlot slot,
+                               bool cut_off);
+
+/**
+ * Queue a sequence with a time to live (see speech_say_text_ttl()).
+ */
+int speech_say_sequence_ttl(const SpeechSequence *seq,
+                            SpeechPriority priority, SpeechSlot slot,
+                            bool cut_off, int ttl_ms);
+
+/**
+ * Queue a one-segment sequence of words (see speech_sequence_add_words()).
+ *
+ * For frequency, meter and mode readouts.
+ * @return HAMPOD_OK on success, HAMPOD_ERROR if it does not fit or the
+ *         queue is full
+ */
+int speech_say_words(const char *words);
+
+/**
+ * Queue a one-segment sequence of words in a priority class.
+ */
+int speech_say_words_priority(const char *words, SpeechPriority priority);
+
+/**
+ * Queue a one-segment sequence of words in a priority class and
+ * coalescing slot (see speech_say_text_latest()).
+ */
+int speech_say_words_latest(const char *words, SpeechPriority priority,
+                            SpeechSlot slot, bool cut_off);
+
+/**
+ * Queue words with a time to live (see speech_say_text_ttl()).
+ */
+int speech_say_words_ttl(const char *words, SpeechPriority priority,
+                         SpeechSlot slot, bool cut_off, int ttl_ms);
+
+/**
+ * Have Firmware synthesize words into its cache before they are spoken.
+ *
+ * For a readout that can be guessed ahead of time, such as the read-back
+ * of a frequency still being typed. Nothing is queued or played, and a
+ * wrong guess only costs the synthesis. Returns at once.
+ * @return HAMPOD_OK on success, HAMPOD_ERROR if it could not be sent
+ */
+int speech_warm_words(const char *words);
+
+// ============================================================================
+// Completion
+// ============================================================================
+
+/**
+ * Called once a queued item is done: played, cut off or dropped.
+ *
+ * @param id Item id, from speech_last_id()
+ * @param context As passed to speech_on_complete()
+ */
+typedef void (*SpeechCompleteCallback)(unsigned int id, void *context);
+
 /**
  * Wait for all queued speech to complete (blocking).
  *
- * Blocks until the speech queue is empty.
+ * Same as speech_wait_idle(-1).
  */
 void speech_wait_complete(void);
 
+/**
+ * Wait until nothing is queued and Firmware has acknowledged (finished)
+ * everything sent to it.
+ *
+ * @param timeout_ms How long to wait; -1 for no limit, 0 to only check
+ * @return HAMPOD_OK when idle, HAMPOD_TIMEOUT if still speaking
+ */
+int speech_wait_idle(int timeout_ms);
+
+/**
+ * Id of the item the calling thread queued last, for speech_wait_item()
+ * and speech_on_complete(). A readout replaced in its slot gets a new id
+ * and its old one is done.
+ *
+ * @return Item id, or 0 if this thread has queued nothing
+ */
+unsigned int speech_last_id(void);
+
+/**
+ * Wait until one item is done: played, cut off or dropped.
+ *
+ * Firmware acks an item once its audio is queued, so after the ack this
+ * waits for that audio to be heard (comm_wait_played()), along with
+ * anything queued behind it. With timeout 0 it only checks for the ack.
+ *
+ * @param id Item id from speech_last_id()
+ * @param timeout_ms How long to wait; -1 for no limit, 0 to only check
+ * @return HAMPOD_OK when done, HAMPOD_TIMEOUT if still queued or playing
+ */
+int speech_wait_item(unsigned int id, int timeout_ms);
+
+/**
+ * Have callback run on the speech thread once an item is done (at once,
+ * on the calling thread, if it already is). Callbacks still pending at
+ * speech_shutdown() are run then. Keep them short, and don't wait on
+ * speech in them.
+ *
+ * @param id Item id from speech_last_id()
+ * @param callback Function to call
+ * @param context Passed to callback
+ * @return HAMPOD_OK, or HAMPOD_ERROR if 8 callbacks are already pending
+ */
+int speech_on_complete(unsigned int id, SpeechCompleteCallback callback,
+                       void *context);
+
+/**
+ * Called with each request as it goes to Firmware: the audio type ('d'
+ * text, 'w' words, 'p' a file, ...) and its payload. Runs on the speech
+ * thread; must not block or queue speech.
+ */
+typedef void (*SpeechSentListener)(char type, const char *payload);
+
+/**
+ * Set the one listener told about every request sent (NULL for none).
+ * Used by the local API (api.h) to stream what is spoken.
+ *
+ * @param listener Function to call
+ */
+void speech_set_sent_listener(SpeechSentListener listener);
+
+// ============================================================================
+// Queue Control
+// ============================================================================
+
 /**
  * Clear the speech queue, discarding all pending items.
  */
@@ -97,10 +437,19 @@ void speech_clear_queue(void);
  */
 int speech_queue_size(void);
 
+/**
+ * How long the oldest request in flight has waited for Firmware's ack.
+ * An item is acked once played, so a long one waits long too.
+ * @return Milliseconds, or 0 with nothing in flight
+ */
+int speech_ack_wait_ms(void);
+
 /**
  * Interrupt current speech immediately.
  *
  * Clears the queue AND sends an interrupt command to the audio hardware.
+ * Does not wait for Firmware to acknowledge it (see comm_interrupt_audio()),
+ * so it is safe to call from the keypad callback.
  */
 void speech_interrupt(void);
 
@@ -109,11 +458,51 @@ void speech_interrupt(void);
 // ============================================================================
 
 /**
- * Set maximum queue size.
- * Default is 32 items.
+ * Set maximum queue size, all priority classes together.
+ * Default is 32 items. Their text shares 256 bytes per item (at least
+ * twice the longest, COMM_MAX_TEXT_LEN), so many short items or a few
+ * long ones fit.
  *
  * @param size Maximum number of items in the queue
  */
 void speech_set_max_queue_size(int size);
 
+/**
+ * Set how many requests the speech thread keeps in flight to Firmware, so
+ * items of an announcement play back to back. Default is 3, at most 8;
+ * 1 sends each item only once the one before has played. Call before
+ * speech_init(); HAMPOD_SPEECH_WINDOW overrides it there.
+ *
+ * @param requests Maximum number of unacknowledged requests
+ */
+void speech_set_window(int requests);
+
+/**
+ * Set how long the speech thread holds a lone text prompt, with nothing
+ * playing, for more to merge with it. Plain text items (speech_say_text())
+ * queued back to back in one class go to Firmware as one request, which
+ * still caches each one separately. Default is 10 ms; 0 merges only what
+ * is already queued. Call before speech_init().
+ *
+ * @param ms Milliseconds to wait
+ */
+void speech_set_merge_window(int ms);
+
+// ============================================================================
+// Latency
+// ============================================================================
+
+#define SPEECH_LATENCY_FILE "/dev/shm/hampod_speech_latency"
+
+/**
+ * Write a table of how long the last 256 acknowledged items spent in each
+ * stage: queued, handed to comm, in transit, in Firmware's queue, being
+ * synthesized, playing and being acked, plus queued to first audio and
+ * the total. Percentiles are in milliseconds. Items Firmware didn't play
+ * (interrupted or failed) are not counted.
+ *
+ * @param out Stream to write to
+ */
+void speech_report_latency(FILE *out);
+
 #endif // SPEECH_H
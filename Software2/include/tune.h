@@ -0,0 +1,57 @@
+/**
+ * @file tune.h
+ * @brief Keypad tuning: step the VFO up or down by a selectable step
+ *
+ * Each step sets the frequency through the radio worker under the
+ * frequency supersede key, so a step queued while the radio is still
+ * busy replaces the one before it: however slow the serial link, a held
+ * key's repeats (keypad.h) cost one rig_set_freq per bus turnaround, to
+ * the newest target. Steps go on from the last target while a set is
+ * outstanding, not from the radio, so none is lost.
+ *
+ * Nothing is said per step. The poller reports the frequency once it has
+ * stopped changing, and that report is announced even with automatic
+ * announcements off.
+ */
+
+#ifndef TUNE_H
+#define TUNE_H
+
+// ============================================================================
+// Steps
+// ============================================================================
+
+/**
+ * @brief Frequency one step from another, on the step's grid
+ *
+ * An off-grid frequency moves to the nearest grid point that way, as
+ * rigs do, so 14.0743 MHz up by 1 kHz is 14.075 MHz.
+ *
+ * @param direction 1 for up, -1 for down
+ * @return Next frequency in Hz, or freq_hz if stepping down would reach 0
+ */
+double tune_next_frequency(double freq_hz, int step_hz, int direction);
+
+/**
+ * @brief Current step size in Hz (1 kHz at startup)
+ */
+int tune_get_step_hz(void);
+
+/**
+ * @brief Select the next step size: 10 Hz, 100 Hz, 1 kHz, 5 kHz, 10 kHz,
+ *        100 kHz, then 10 Hz again
+ * @return New step size in Hz
+ */
+int tune_cycle_step(void);
+
+// ============================================================================
+// Tuning
+// ============================================================================
+
+/**
+ * @brief Step the VFO (non-blocking)
+ * @param direction 1 for up, -1 for down
+ */
+void tune_step(int direction);
+
+#endif // TUNE_H
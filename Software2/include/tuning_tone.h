@@ -0,0 +1,70 @@
+/**
+ * @file tuning_tone.h
+ * @brief Tuning tone: a radio meter heard as a continuous pitch
+ *
+ * While on, a thread reads one meter from the radio every 50 ms and has
+ * Firmware play a tone whose pitch follows it - higher for a stronger
+ * signal, more output power or a worse SWR - so peaking an antenna or
+ * nulling a tuner needs no speech at all. Only a changed pitch is sent,
+ * plus a refresh well inside Firmware's 2 second tone timeout. A meter
+ * that can't be read silences the tone until it can.
+ */
+
+#ifndef TUNING_TONE_H
+#define TUNING_TONE_H
+
+// ============================================================================
+// Meters
+// ============================================================================
+
+#define TUNING_TONE_MIN_HZ 300  // Pitch at the bottom of a meter's range
+#define TUNING_TONE_MAX_HZ 1500 // Pitch at the top
+
+/**
+ * @brief Meter the tone follows
+ */
+typedef enum {
+  TUNING_TONE_OFF = 0,
+  TUNING_TONE_SMETER, // S0 (-54 dB) to S9+60 dB
+  TUNING_TONE_SWR,    // 1.0 to 3.0
+  TUNING_TONE_POWER,  // 0 to 100 percent
+  TUNING_TONE_COUNT
+} TuningToneMeter;
+
+/**
+ * @brief Pitch for a meter reading
+ * @param meter Meter the value came from (not TUNING_TONE_OFF)
+ * @param value Reading, in the unit radio_read_meter() returns
+ * @return Pitch in Hz, clamped to TUNING_TONE_MIN_HZ..TUNING_TONE_MAX_HZ,
+ *         or 0 for TUNING_TONE_OFF
+ */
+int tuning_tone_pitch(TuningToneMeter meter, double value);
+
+// ============================================================================
+// Control
+// ============================================================================
+
+/**
+ * @brief Start the tone, or switch it to another meter
+ * @param meter Meter to follow; TUNING_TONE_OFF stops the tone
+ * @return 0 on success, -1 if the thread could not start
+ */
+int tuning_tone_start(TuningToneMeter meter);
+
+/**
+ * @brief Stop the tone and its thread
+ */
+void tuning_tone_stop(void);
+
+/**
+ * @brief Step to the next meter: off, S-meter, SWR, power, off
+ * @return Meter now followed
+ */
+TuningToneMeter tuning_tone_cycle(void);
+
+/**
+ * @brief Get the meter the tone follows, TUNING_TONE_OFF if none
+ */
+TuningToneMeter tuning_tone_get_meter(void);
+
+#endif // TUNING_TONE_H
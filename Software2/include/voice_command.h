@@ -0,0 +1,22 @@
+/**
+ * @file voice_command.h
+ * @brief Spoken frequency and mode commands
+ *
+ * With voice input built into Firmware, spoken keys arrive as ordinary
+ * keypad events. Spoken frequencies ("frequency 14 250") and modes
+ * ("mode USB") are pushed as commands of their own, and this module
+ * carries them out on the radio worker and announces the result, as the
+ * keypad would.
+ */
+
+#ifndef VOICE_COMMAND_H
+#define VOICE_COMMAND_H
+
+/**
+ * @brief Start taking spoken commands from Firmware
+ *
+ * Call once at startup, after the radio worker is running.
+ */
+void voice_command_init(void);
+
+#endif // VOICE_COMMAND_H
@@ -0,0 +1,66 @@
+/**
+ * @file watchdog.h
+ * @brief Latency SLOs and the audio link watchdog
+ *
+ * Three service levels are checked as the system runs: a key's beep sent
+ * within WATCHDOG_KEY_BEEP_MS of the key, an announcement's first audio
+ * within WATCHDOG_FIRST_AUDIO_MS of it being queued, and the radio's
+ * frequency read within WATCHDOG_POLL_AGE_MS while it is connected. Each
+ * miss is counted in slo_misses_total and logged.
+ *
+ * When the oldest speech request has waited watchdog_ms ([scheduling])
+ * for its ack, a heartbeat is sent to Firmware's audio process, which
+ * answers it at once however stuck its playback is (it recovers that by
+ * itself, see audio_firmware.h). With no answer in WATCHDOG_PROBE_MS the
+ * direct audio channel is dropped, so audio falls back to the main link,
+ * and speech is restarted; each such step counts in watchdog_actions_total.
+ */
+
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include <stdint.h>
+
+#define WATCHDOG_KEY_BEEP_MS 50       // Key to its beep being sent
+#define WATCHDOG_FIRST_AUDIO_MS 1000  // Queued to first audio out
+#define WATCHDOG_POLL_AGE_MS 10000    // Twice the slowest frequency read
+#define WATCHDOG_PROBE_MS 1000        // Heartbeat answer, once sent
+#define WATCHDOG_CHECK_MS 500         // Housekeeping job period
+#define WATCHDOG_IDLE_CHECK_MS 2000   // ... when idle
+
+typedef enum {
+  WATCHDOG_SLO_KEY_BEEP,
+  WATCHDOG_SLO_FIRST_AUDIO,
+  WATCHDOG_SLO_POLL_AGE,
+  WATCHDOG_SLOS
+} WatchdogSlo;
+
+/**
+ * @brief Start checking the radio poll age and the audio link
+ * @param stall_ms Ack wait before the link is checked (0 = never)
+ * @return 0 on success, -1 if the housekeeping timer has no room
+ */
+int watchdog_start(int stall_ms);
+
+/**
+ * @brief Note a key's beep sent now
+ * @param timestamp_us The key event's kernel time (CLOCK_REALTIME), or 0
+ *        if it has none
+ */
+void watchdog_note_key(uint64_t timestamp_us);
+
+/**
+ * @brief Note an announcement's first audio
+ * @param queued_us When it was queued, low 32 bits of CLOCK_MONOTONIC in
+ *        microseconds as in Firmware's acks
+ * @param first_audio_us When its first audio was out, or 0 if it had none
+ */
+void watchdog_note_first_audio(unsigned int queued_us,
+                               unsigned int first_audio_us);
+
+/**
+ * @brief Misses of one SLO so far
+ */
+unsigned int watchdog_slo_misses(WatchdogSlo slo);
+
+#endif // WATCHDOG_H
@@ -2,17 +2,46 @@
 # =============================================================================
 # HAMPOD2026 - Run All Unit Tests
 # =============================================================================
-# Runs the 5 active Software2 tests:
+# Runs the 28 active Software2 tests:
 #
 #   Phase 1: Unit tests (self-contained, no hardware needed)
 #     - test_compile          Build smoke test
 #     - test_comm_queue       Response queue FIFO, timeout, overflow
+#     - test_comm_frame       Shared framing over pipes and seqpacket sockets
+#     - test_comm_shm_ring    Shared-memory audio request ring
+#     - test_speech_sequence  Speak sequence payload builder
+#     - test_announce         Announcement segments, frequencies, terse style
 #     - test_config           Config load/save, undo, clamping
+#     - test_config_watch     Config file hot reload
+#     - test_radio_state      Radio state cache freshness
+#     - test_radio_caps       Radio capability profiles, learned gaps
+#     - test_radio_cat        Native CI-V/Kenwood frames against a fake rig
+#     - test_serial_latency   USB-serial latency timer tuning and restore
+#     - test_radio_trace      Hamlib call histograms, lock wait, error codes
+#     - test_radio_worker     Radio command queue, priority, supersede
 #     - test_frequency_mode   Frequency mode state machine (mock-based)
+#     - test_keymap           Key bindings, shift fallback, per-model files
+#     - test_macro            Keypad macro settings and their errors
+#     - test_profile          Profile settings written as macro steps
+#     - test_band_stack       Per-band memory, stepping, save on band change
+#     - test_scan             Scan channel stepping and wrap
+#     - test_tune             Keypad tuning steps and step sizes
+#     - test_tuning_tone      Meter readings mapped to tuning tone pitch
+#     - test_device_worker    Per-device workers, queues kept apart
+#     - test_memory_index     Memory channel index, bulk read, browsing
+#     - test_watchdog         Latency SLOs and audio link watchdog
+#     - test_radio_defs       Radio definition table and lookup
+#     - test_api              Local JSON API socket, events and commands
+#     - test_meter            Averaged and peak-held meter sampling
 #
 #   Phase 2: Radio test (needs physical radio connected via USB)
 #     - test_radio            Hamlib radio connection (no Firmware needed)
 #
+#   Phase 3: Performance tier (with --perf)
+#     - perf_firmware         Firmware hot-path timings against the stored
+#                             baseline for this machine model (see
+#                             Firmware/BUILD.md, "Performance Tier")
+#
 # Deprecated tests (in tests/deprecated/):
 #   test_comm_read, test_comm_write, test_keypad_events, test_speech_queue
 #   These were Phase 0 integration tests that used blocking pipe I/O to
@@ -26,6 +55,7 @@
 #   ./run_all_unit_tests.sh --all        # Run everything automatically
 #   ./run_all_unit_tests.sh --unit-only  # Run only unit tests (Phase 1)
 #   ./run_all_unit_tests.sh --no-build   # Skip the build step
+#   ./run_all_unit_tests.sh --perf       # Also run the performance tier
 #
 # =============================================================================
 
@@ -36,10 +66,12 @@ set -euo pipefail
 SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
 SOFTWARE2_DIR="$SCRIPT_DIR"
 BIN_DIR="$SOFTWARE2_DIR/bin"
+PERF_DIR="$SOFTWARE2_DIR/../Firmware/hal/tests"
 
 UNIT_ONLY=false
 RUN_ALL=false
 SKIP_BUILD=false
+RUN_PERF=false
 
 # Parse arguments
 for arg in "$@"; do
@@ -47,8 +79,9 @@ for arg in "$@"; do
         --unit-only)  UNIT_ONLY=true ;;
         --all)        RUN_ALL=true ;;
         --no-build)   SKIP_BUILD=true ;;
+        --perf)       RUN_PERF=true ;;
         -h|--help)
-            head -30 "$0" | tail -25
+            sed -n '2,/^$/p' "$0" | sed 's/^# \{0,1\}//'
             exit 0
             ;;
         *)
@@ -166,8 +199,32 @@ cd "$SOFTWARE2_DIR"
 
 run_test "test_compile"        "Build smoke test"
 run_test "test_comm_queue"     "Response queue logic"
+run_test "test_comm_frame"     "Pipe packet framing"
+run_test "test_comm_shm_ring"  "Shared-memory audio ring"
+run_test "test_speech_sequence" "Speak sequence builder"
+run_test "test_announce"       "Announcement builder"
 run_test "test_config"         "Config load/save/undo"
+run_test "test_config_watch"   "Config file hot reload"
+run_test "test_radio_state"    "Radio state cache"
+run_test "test_radio_caps"     "Radio capability profiles"
+run_test "test_radio_cat"      "Native CAT fast path"
+run_test "test_serial_latency" "Serial port latency tuning"
+run_test "test_radio_trace"    "Hamlib call tracing"
+run_test "test_radio_worker"   "Radio command worker"
 run_test "test_frequency_mode" "Frequency mode state machine"
+run_test "test_keymap"         "Key binding table"
+run_test "test_macro"          "Keypad macro compiler"
+run_test "test_profile"        "Settings profiles"
+run_test "test_band_stack"     "Per-band memory"
+run_test "test_scan"           "Scan channel stepping"
+run_test "test_tune"           "Keypad tuning steps"
+run_test "test_tuning_tone"    "Tuning tone pitch"
+run_test "test_device_worker"  "Per-device command workers"
+run_test "test_memory_index"   "Memory channel index"
+run_test "test_watchdog"       "Latency SLOs and link watchdog"
+run_test "test_radio_defs"     "Radio definitions"
+run_test "test_api"            "Local JSON API"
+run_test "test_meter"          "Meter sampling"
 
 echo ""
 
@@ -200,6 +257,29 @@ fi
 
 echo ""
 
+# =============================================================================
+# Phase 3: Performance Tier (optional, needs an otherwise idle machine)
+# =============================================================================
+
+echo -e "${BOLD}Phase 3: Performance Tier${NC} (compared with the stored baseline)"
+echo ""
+
+if [ "$RUN_PERF" = true ]; then
+    make -C "$PERF_DIR" perf_firmware > /tmp/make_perf.log 2>&1 || {
+        echo -e "  ${RED}Build failed!${NC}"
+        tail -20 /tmp/make_perf.log
+        exit 1
+    }
+    BIN_DIR="$PERF_DIR"
+    cd "$PERF_DIR"
+    run_test "perf_firmware" "Firmware hot-path timings"
+    cd "$SOFTWARE2_DIR"
+else
+    skip_test "perf_firmware" "(needs --perf)"
+fi
+
+echo ""
+
 # =============================================================================
 # Summary
 # =============================================================================
@@ -0,0 +1,402 @@
+/**
+ * @file announce.c
+ * @brief Segment-based announcement builder implementation
+ */
+
+#include "announce.h"
+#include "hampod_core.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+// ============================================================================
+// State
+// ============================================================================
+
+// Set at startup and from Config Mode, read on the keypad thread
+static AnnounceStyle g_style = ANNOUNCE_VERBOSE;
+
+// Verbose and terse wording of each unit; "" says nothing
+static const char *const g_unit_words[ANNOUNCE_UNIT_COUNT][2] = {
+    [ANNOUNCE_UNIT_MEGAHERTZ] = {"megahertz", "meg"},
+    [ANNOUNCE_UNIT_KILOHERTZ] = {"kilohertz", "k"},
+    [ANNOUNCE_UNIT_HERTZ] = {"hertz", "hertz"},
+    [ANNOUNCE_UNIT_PERCENT] = {"percent", ""},
+    [ANNOUNCE_UNIT_DECIBELS] = {"D B", "D B"},
+    [ANNOUNCE_UNIT_WATTS] = {"watts", "watts"},
+};
+
+// Mode names terse style shortens; the rest are short already
+static const char *const g_terse_modes[][2] = {
+    {"CW Reverse", "CW R"},
+    {"RTTY Reverse", "RTTY R"},
+    {"AM Synchronous", "AM sync"},
+    {"FM Narrow", "FM N"},
+    {"Wide FM", "W FM"},
+};
+#define TERSE_MODE_COUNT (int)(sizeof(g_terse_modes) / sizeof(g_terse_modes[0]))
+
+// ============================================================================
+// Internal Functions
+// ============================================================================
+
+static int append(Announcement *a, AnnounceSegmentType type,
+                  const char *text) {
+  if (a->count >= ANNOUNCE_MAX_SEGMENTS ||
+      strlen(text) >= ANNOUNCE_SEGMENT_MAX) {
+    a->overflow = true;
+    return HAMPOD_ERROR;
+  }
+  AnnounceSegment *seg = &a->segments[a->count++];
+  seg->type = type;
+  strcpy(seg->text, text);
+  return HAMPOD_OK;
+}
+
+static bool is_word(AnnounceSegmentType type) {
+  return type == ANNOUNCE_SEG_NUMBER || type == ANNOUNCE_SEG_DIGITS ||
+         type == ANNOUNCE_SEG_UNIT || type == ANNOUNCE_SEG_WORD;
+}
+
+// Join text onto buffer with a space; false if it does not fit
+static bool join(char *buffer, size_t size, size_t *length,
+                 const char *text) {
+  int written = snprintf(buffer + *length, size - *length, "%s%s",
+                         *length > 0 ? " " : "", text);
+  if (written < 0 || (size_t)written >= size - *length) {
+    return false;
+  }
+  *length += (size_t)written;
+  return true;
+}
+
+// ============================================================================
+// Style
+// ============================================================================
+
+void announce_set_style(AnnounceStyle style) { g_style = style; }
+
+AnnounceStyle announce_get_style(void) { return g_style; }
+
+// ============================================================================
+// Building
+// ============================================================================
+
+void announce_init(Announcement *a) {
+  a->count = 0;
+  a->overflow = false;
+}
+
+int announce_text(Announcement *a, const char *text) {
+  if (text == NULL) {
+    LOG_ERROR("announce_text: NULL text");
+    return HAMPOD_ERROR;
+  }
+  return append(a, ANNOUNCE_SEG_TEXT, text);
+}
+
+int announce_label(Announcement *a, const char *verbose, const char *terse) {
+  const char *text =
+      (g_style == ANNOUNCE_TERSE && terse != NULL) ? terse : verbose;
+  if (text == NULL) {
+    LOG_ERROR("announce_label: NULL label");
+    return HAMPOD_ERROR;
+  }
+  if (text[0] == '\0') {
+    return HAMPOD_OK;
+  }
+  return append(a, ANNOUNCE_SEG_TEXT, text);
+}
+
+int announce_number(Announcement *a, long value) {
+  char text[32];
+  if (value < 0) {
+    snprintf(text, sizeof(text), "minus %ld", -value);
+  } else {
+    snprintf(text, sizeof(text), "%ld", value);
+  }
+  return append(a, ANNOUNCE_SEG_NUMBER, text);
+}
+
+int announce_digits(Announcement *a, const char *digits) {
+  if (digits == NULL) {
+    LOG_ERROR("announce_digits: NULL digits");
+    return HAMPOD_ERROR;
+  }
+
+  char text[ANNOUNCE_SEGMENT_MAX];
+  size_t length = 0;
+  for (const char *p = digits; *p != '\0'; p++) {
+    if (!isdigit((unsigned char)*p)) {
+      continue;
+    }
+    char digit[2] = {*p, '\0'};
+    if (!join(text, sizeof(text), &length, digit)) {
+      a->overflow = true;
+      return HAMPOD_ERROR;
+    }
+  }
+  if (length == 0) {
+    return HAMPOD_OK;
+  }
+  return append(a, ANNOUNCE_SEG_DIGITS, text);
+}
+
+int announce_unit(Announcement *a, AnnounceUnit unit) {
+  if (unit < 0 || unit >= ANNOUNCE_UNIT_COUNT) {
+    LOG_ERROR("announce_unit: unknown unit %d", unit);
+    return HAMPOD_ERROR;
+  }
+  const char *text = g_unit_words[unit][g_style == ANNOUNCE_TERSE ? 1 : 0];
+  if (text[0] == '\0') {
+    return HAMPOD_OK;
+  }
+  return append(a, ANNOUNCE_SEG_UNIT, text);
+}
+
+int announce_word(Announcement *a, const char *word) {
+  if (word == NULL) {
+    LOG_ERROR("announce_word: NULL word");
+    return HAMPOD_ERROR;
+  }
+  return append(a, ANNOUNCE_SEG_WORD, word);
+}
+
+int announce_clip(Announcement *a, const char *filepath) {
+  if (filepath == NULL) {
+    LOG_ERROR("announce_clip: NULL filepath");
+    return HAMPOD_ERROR;
+  }
+  return append(a, ANNOUNCE_SEG_CLIP, filepath);
+}
+
+// Whole megahertz and the five decimals to 10 Hz
+static void split_frequency(double freq_hz, long *mhz_part, int *decimals) {
+  double freq_mhz = freq_hz / 1000000.0;
+  *mhz_part = (long)freq_mhz;
+
+  // 5 decimal places for 10 Hz resolution, truncated (not rounded) to
+  // match the radio's display; the epsilon absorbs floating-point error
+  // (e.g. 12345.0 represented as 12344.99999...)
+  *decimals = (int)((freq_mhz - *mhz_part) * 100000 + 0.0001);
+}
+
+int announce_frequency(Announcement *a, double freq_hz) {
+  if (freq_hz < 0) {
+    return HAMPOD_ERROR;
+  }
+
+  long mhz_part;
+  int decimals;
+  split_frequency(freq_hz, &mhz_part, &decimals);
+
+  int result = announce_number(a, mhz_part);
+  if (decimals != 0) {
+    char digits[8];
+    snprintf(digits, sizeof(digits), "%05d", decimals);
+    if (g_style == ANNOUNCE_TERSE) {
+      for (int i = (int)strlen(digits) - 1; i > 0 && digits[i] == '0'; i--) {
+        digits[i] = '\0';
+      }
+    }
+    result |= announce_word(a, "point");
+    result |= announce_digits(a, digits);
+  }
+  if (g_style != ANNOUNCE_TERSE) {
+    result |= announce_unit(a, ANNOUNCE_UNIT_MEGAHERTZ);
+  }
+  return result == HAMPOD_OK ? HAMPOD_OK : HAMPOD_ERROR;
+}
+
+int announce_frequency_change(Announcement *a, double from_hz,
+                              double to_hz) {
+  if (to_hz < 0) {
+    return HAMPOD_ERROR;
+  }
+  long from_mhz, to_mhz;
+  int from_decimals, to_decimals;
+  split_frequency(from_hz, &from_mhz, &from_decimals);
+  split_frequency(to_hz, &to_mhz, &to_decimals);
+  if (from_hz <= 0 || from_mhz != to_mhz) {
+    return announce_frequency(a, to_hz);
+  }
+
+  int result;
+  if (from_decimals / 100 == to_decimals / 100) {
+    // Same kilohertz: the hertz within it, "500 hertz"
+    result = announce_number(a, (to_decimals % 100) * 10);
+    result |= announce_unit(a, ANNOUNCE_UNIT_HERTZ);
+  } else {
+    // The kilohertz within the megahertz, "253 point 5 kilohertz"
+    result = announce_number(a, to_decimals / 100);
+    if (to_decimals % 100 != 0) {
+      char digits[4];
+      snprintf(digits, sizeof(digits), "%02d", to_decimals % 100);
+      if (digits[1] == '0') {
+        digits[1] = '\0';
+      }
+      result |= announce_word(a, "point");
+      result |= announce_digits(a, digits);
+    }
+    result |= announce_unit(a, ANNOUNCE_UNIT_KILOHERTZ);
+  }
+  return result == HAMPOD_OK ? HAMPOD_OK : HAMPOD_ERROR;
+}
+
+int announce_switch(Announcement *a, const char *label, bool on, int level) {
+  int result = announce_text(a, label);
+  if (g_style == ANNOUNCE_TERSE) {
+    // The level of something switched off is noise
+    if (!on) {
+      result |= announce_word(a, "off");
+    } else if (level >= 0) {
+      result |= announce_number(a, level);
+    } else {
+      result |= announce_word(a, "on");
+    }
+  } else {
+    result |= announce_word(a, on ? "on" : "off");
+    result |= announce_word(a, "level");
+    result |= announce_number(a, level >= 0 ? level : 0);
+  }
+  return result == HAMPOD_OK ? HAMPOD_OK : HAMPOD_ERROR;
+}
+
+int announce_mode(Announcement *a, const char *mode) {
+  if (mode == NULL) {
+    LOG_ERROR("announce_mode: NULL mode");
+    return HAMPOD_ERROR;
+  }
+  if (g_style == ANNOUNCE_TERSE) {
+    for (int i = 0; i < TERSE_MODE_COUNT; i++) {
+      if (strcmp(mode, g_terse_modes[i][0]) == 0) {
+        return announce_word(a, g_terse_modes[i][1]);
+      }
+    }
+  }
+  return announce_word(a, mode);
+}
+
+int announce_vfo(Announcement *a, const char *vfo) {
+  if (vfo == NULL) {
+    LOG_ERROR("announce_vfo: NULL VFO");
+    return HAMPOD_ERROR;
+  }
+  if (g_style != ANNOUNCE_TERSE) {
+    return append(a, ANNOUNCE_SEG_TEXT, vfo);
+  }
+
+  // Drop "VFO" as a whole word, wherever it is
+  char text[ANNOUNCE_SEGMENT_MAX];
+  size_t length = 0;
+  char copy[ANNOUNCE_SEGMENT_MAX];
+  snprintf(copy, sizeof(copy), "%s", vfo);
+  char *saveptr = NULL;
+  for (char *word = strtok_r(copy, " ", &saveptr); word != NULL;
+       word = strtok_r(NULL, " ", &saveptr)) {
+    if (strcmp(word, "VFO") == 0 || strcmp(word, "VFO.") == 0) {
+      continue;
+    }
+    if (!join(text, sizeof(text), &length, word)) {
+      a->overflow = true;
+      return HAMPOD_ERROR;
+    }
+  }
+  if (length == 0) {
+    return append(a, ANNOUNCE_SEG_TEXT, vfo); // Nothing but "VFO"
+  }
+  return append(a, ANNOUNCE_SEG_TEXT, text);
+}
+
+// ============================================================================
+// Speaking
+// ============================================================================
+
+int announce_render(const Announcement *a, SpeechSequence *seq) {
+  speech_sequence_init(seq);
+  if (a == NULL || a->count == 0 || a->overflow) {
+    LOG_ERROR("announce_render: empty or overflowed announcement");
+    return HAMPOD_ERROR;
+  }
+
+  int i = 0;
+  while (i < a->count) {
+    const AnnounceSegment *seg = &a->segments[i];
+    int result;
+
+    if (is_word(seg->type)) {
+      // One words run for every adjacent cached word
+      char words[SPEECH_SEQUENCE_MAX + 1];
+      size_t length = 0;
+      for (; i < a->count && is_word(a->segments[i].type); i++) {
+        if (!join(words, sizeof(words), &length, a->segments[i].text)) {
+          return HAMPOD_ERROR;
+        }
+      }
+      result = speech_sequence_add_words(seq, words);
+    } else {
+      result = seg->type == ANNOUNCE_SEG_CLIP
+                   ? speech_sequence_add_file(seq, seg->text)
+                   : speech_sequence_add_text(seq, seg->text);
+      i++;
+    }
+
+    if (result != HAMPOD_OK) {
+      return HAMPOD_ERROR;
+    }
+  }
+  return HAMPOD_OK;
+}
+
+int announce_to_text(const Announcement *a, char *buffer, size_t size) {
+  if (size == 0) {
+    return 0;
+  }
+  buffer[0] = '\0';
+  size_t length = 0;
+  for (int i = 0; i < a->count; i++) {
+    if (a->segments[i].type == ANNOUNCE_SEG_CLIP) {
+      continue;
+    }
+    if (!join(buffer, size, &length, a->segments[i].text)) {
+      break;
+    }
+  }
+  return (int)length;
+}
+
+int announce_say(const Announcement *a, SpeechPriority priority) {
+  SpeechSequence seq;
+  if (announce_render(a, &seq) != HAMPOD_OK) {
+    return HAMPOD_ERROR;
+  }
+  return speech_say_sequence_priority(&seq, priority);
+}
+
+int announce_say_latest(const Announcement *a, SpeechPriority priority,
+                        SpeechSlot slot, bool cut_off) {
+  SpeechSequence seq;
+  if (announce_render(a, &seq) != HAMPOD_OK) {
+    return HAMPOD_ERROR;
+  }
+  return speech_say_sequence_latest(&seq, priority, slot, cut_off);
+}
+
+int announce_warm(const Announcement *a) {
+  if (a == NULL || a->overflow) {
+    return HAMPOD_ERROR;
+  }
+  char words[SPEECH_SEQUENCE_MAX + 1];
+  size_t length = 0;
+  for (int i = 0; i < a->count; i++) {
+    if (is_word(a->segments[i].type) &&
+        !join(words, sizeof(words), &length, a->segments[i].text)) {
+      return HAMPOD_ERROR;
+    }
+  }
+  if (length == 0) {
+    return HAMPOD_ERROR;
+  }
+  return speech_warm_words(words);
+}
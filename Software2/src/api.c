@@ -0,0 +1,542 @@
+/**
+ * @file api.c
+ * @brief Local control API implementation
+ */
+
+#include "api.h"
+#include "hampod_core.h"
+#include "keypad.h"
+#include "radio_state.h"
+#include "speech.h"
+
+#include <ctype.h>
+#include <hamlib/rig.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define API_VERSION 1
+#define API_EVENT_MAX 2048 // Longest event line (a state event)
+
+// ============================================================================
+// State
+// ============================================================================
+
+typedef struct {
+  int fd;                // -1 for a free slot
+  bool dead;             // Dropped by a writer; the thread closes it
+  char in[API_LINE_MAX]; // Partial command line
+  size_t in_len;
+} ApiClient;
+
+// Names of the RadioField values, as the events give them
+static const char *const k_field_names[RADIO_FIELD_COUNT] = {
+    "freq", "mode", "passband", "vfo", "smeter", "power_meter", "swr",
+    "alc", "power", "mic_gain", "comp", "comp_on", "nb_on", "nb_level",
+    "nr_on", "nr_level", "agc", "preamp", "att", "vox"};
+
+static ApiClient g_clients[API_MAX_CLIENTS];
+static int g_client_count = 0; // Atomic; lets events skip the lock
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER; // g_clients
+static char g_path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+static int g_listen_fd = -1;
+static int g_stop_pipe[2] = {-1, -1}; // api_stop() writes to [1]
+static volatile bool g_running = false;
+static pthread_t g_thread;
+
+// ============================================================================
+// JSON
+// ============================================================================
+
+// Append in to out as the body of a JSON string
+static void json_escape(char *out, size_t size, const char *in) {
+  size_t n = 0;
+  for (; *in != '\0' && n + 7 < size; in++) {
+    unsigned char c = (unsigned char)*in;
+    if (c == '"' || c == '\\') {
+      out[n++] = '\\';
+      out[n++] = (char)c;
+    } else if (c < 0x20) {
+      n += (size_t)snprintf(out + n, size - n, "\\u%04x", c);
+    } else {
+      out[n++] = (char)c;
+    }
+  }
+  out[n] = '\0';
+}
+
+// Find "key": in a flat object and return what follows the colon. Only a
+// string right after '{' or ',' is a key, so "key": inside a value is not.
+static const char *json_value(const char *line, const char *key) {
+  size_t key_len = strlen(key);
+  char prev = '\0'; // Last character outside a string, blanks skipped
+  for (const char *p = line; *p != '\0'; p++) {
+    if (*p == ' ' || *p == '\t') {
+      continue;
+    }
+    if (*p != '"') {
+      prev = *p;
+      continue;
+    }
+    const char *start = p + 1;
+    const char *end = start;
+    while (*end != '"' && *end != '\0') {
+      end += (*end == '\\' && end[1] != '\0') ? 2 : 1;
+    }
+    if (*end == '\0') {
+      return NULL; // Unterminated string
+    }
+    const char *after = end + 1 + strspn(end + 1, " \t");
+    if ((prev == '{' || prev == ',') && *after == ':' &&
+        (size_t)(end - start) == key_len &&
+        strncmp(start, key, key_len) == 0) {
+      after++;
+      return after + strspn(after, " \t");
+    }
+    prev = '"';
+    p = end;
+  }
+  return NULL;
+}
+
+// Four hex digits after a \u, or -1 if fewer
+static int json_hex4(const char *p) {
+  int code = 0;
+  for (int i = 0; i < 4; i++) {
+    if (!isxdigit((unsigned char)p[i])) {
+      return -1;
+    }
+    code = code * 16 + (isdigit((unsigned char)p[i])
+                            ? p[i] - '0'
+                            : tolower((unsigned char)p[i]) - 'a' + 10);
+  }
+  return code;
+}
+
+// A string member, unescaped (\uXXXX only for ASCII, others become '?').
+// False if missing or malformed.
+static bool json_string(const char *line, const char *key, char *out,
+                        size_t size) {
+  const char *p = json_value(line, key);
+  if (p == NULL || *p != '"') {
+    return false;
+  }
+  size_t n = 0;
+  for (p++; *p != '"' && *p != '\0' && n + 1 < size; p++) {
+    if (*p != '\\') {
+      out[n++] = *p;
+      continue;
+    }
+    p++;
+    if (*p == 'n') {
+      out[n++] = '\n';
+    } else if (*p == 't') {
+      out[n++] = '\t';
+    } else if (*p == 'u') {
+      int code = json_hex4(p + 1);
+      if (code < 0) {
+        return false;
+      }
+      out[n++] = code < 0x80 ? (char)code : '?';
+      p += 4;
+    } else if (*p != '\0') {
+      out[n++] = *p; // \" \\ \/
+    } else {
+      break;
+    }
+  }
+  out[n] = '\0';
+  return *p == '"';
+}
+
+static bool json_true(const char *line, const char *key) {
+  const char *p = json_value(line, key);
+  return p != NULL && strncmp(p, "true", 4) == 0;
+}
+
+// "field":value for a radio field, the mode by name
+static int format_field(char *out, size_t size, RadioField field,
+                        double value) {
+  if (field == RADIO_FIELD_MODE) {
+    return snprintf(out, size, "\"%s\":\"%s\"", k_field_names[field],
+                    rig_strrmode((rmode_t)value));
+  }
+  return snprintf(out, size, "\"%s\":%.10g", k_field_names[field], value);
+}
+
+static void format_state(char *out, size_t size) {
+  RadioStateSnapshot snapshot;
+  radio_state_snapshot(&snapshot);
+  const char close[] = "}}\n";
+  int len = snprintf(out, size, "{\"event\":\"state\",\"radio\":{");
+  if (len < 0 || (size_t)len + sizeof(close) > size) {
+    out[0] = '\0';
+    return;
+  }
+  // Fields that would not leave room to close the object are left out
+  size_t n = (size_t)len;
+  for (int f = 0; f < RADIO_FIELD_COUNT; f++) {
+    if (snapshot.age_ms[f] < 0) {
+      continue;
+    }
+    size_t comma = out[n - 1] == '{' ? 0 : 1;
+    size_t room = size - sizeof(close) - n;
+    if (room <= comma) {
+      break;
+    }
+    len = format_field(out + n + comma, room - comma, (RadioField)f,
+                       snapshot.value[f]);
+    if (len < 0 || (size_t)len >= room - comma) {
+      break;
+    }
+    if (comma) {
+      out[n] = ',';
+    }
+    n += comma + (size_t)len;
+  }
+  memcpy(out + n, close, sizeof(close));
+}
+
+// ============================================================================
+// Clients
+// ============================================================================
+
+// Write a whole line without blocking, or mark the client dead: a half
+// written line would garble the stream. Called with g_lock held.
+static void send_line(ApiClient *client, const char *line) {
+  if (client->fd < 0 || client->dead) {
+    return;
+  }
+  size_t len = strlen(line);
+  if (send(client->fd, line, len, MSG_DONTWAIT | MSG_NOSIGNAL) !=
+      (ssize_t)len) {
+    LOG_ERROR("api: Client not keeping up, disconnecting");
+    client->dead = true;
+    shutdown(client->fd, SHUT_RDWR); // Wakes the thread to close it
+  }
+}
+
+static void broadcast(const char *line) {
+  if (__atomic_load_n(&g_client_count, __ATOMIC_ACQUIRE) == 0) {
+    return;
+  }
+  pthread_mutex_lock(&g_lock);
+  for (int i = 0; i < API_MAX_CLIENTS; i++) {
+    send_line(&g_clients[i], line);
+  }
+  pthread_mutex_unlock(&g_lock);
+}
+
+static void reply(ApiClient *client, const char *cmd_text,
+                  const char *error) {
+  char cmd[64];
+  json_escape(cmd, sizeof(cmd), cmd_text);
+  char line[256];
+  if (error == NULL) {
+    snprintf(line, sizeof(line),
+             "{\"event\":\"reply\",\"cmd\":\"%s\",\"ok\":true}\n", cmd);
+  } else {
+    snprintf(line, sizeof(line),
+             "{\"event\":\"reply\",\"cmd\":\"%s\",\"ok\":false,"
+             "\"error\":\"%s\"}\n",
+             cmd, error);
+  }
+  pthread_mutex_lock(&g_lock);
+  send_line(client, line);
+  pthread_mutex_unlock(&g_lock);
+}
+
+static void handle_command(ApiClient *client, const char *line) {
+  char cmd[16];
+  if (!json_string(line, "cmd", cmd, sizeof(cmd))) {
+    reply(client, "", "no cmd");
+    return;
+  }
+
+  if (strcmp(cmd, "key") == 0) {
+    char key[4];
+    if (!json_string(line, "key", key, sizeof(key)) || strlen(key) != 1) {
+      reply(client, cmd, "key must be one character");
+    } else if (keypad_inject(key[0], json_true(line, "hold")) != HAMPOD_OK) {
+      reply(client, cmd, "keypad not running, busy or no such key");
+    } else {
+      reply(client, cmd, NULL);
+    }
+  } else if (strcmp(cmd, "say") == 0) {
+    char text[API_LINE_MAX];
+    if (!json_string(line, "text", text, sizeof(text)) || text[0] == '\0') {
+      reply(client, cmd, "no text");
+    } else if (!speech_is_running()) {
+      reply(client, cmd, "speech not running");
+    } else if (speech_say_text_priority(text, SPEECH_INTERACTIVE) !=
+               HAMPOD_OK) {
+      reply(client, cmd, "speech queue full");
+    } else {
+      reply(client, cmd, NULL);
+    }
+  } else if (strcmp(cmd, "state") == 0) {
+    char state[API_EVENT_MAX];
+    pthread_mutex_lock(&g_lock);
+    format_state(state, sizeof(state));
+    send_line(client, state);
+    pthread_mutex_unlock(&g_lock);
+  } else {
+    reply(client, cmd, "unknown cmd");
+  }
+}
+
+// Greet a new client with the state as it is now. Under g_lock, so no
+// change is broadcast between the snapshot and the client joining.
+static void accept_client(void) {
+  int fd = accept(g_listen_fd, NULL, NULL);
+  if (fd < 0) {
+    return;
+  }
+  pthread_mutex_lock(&g_lock);
+  ApiClient *client = NULL;
+  for (int i = 0; i < API_MAX_CLIENTS && client == NULL; i++) {
+    if (g_clients[i].fd < 0) {
+      client = &g_clients[i];
+    }
+  }
+  if (client == NULL) {
+    pthread_mutex_unlock(&g_lock);
+    LOG_ERROR("api: %d clients already connected, refusing one",
+              API_MAX_CLIENTS);
+    close(fd);
+    return;
+  }
+  client->fd = fd;
+  client->dead = false;
+  client->in_len = 0;
+  // Counted before the greeting: a client that has read it must not miss
+  // the next change. That broadcast waits on g_lock, so it comes after.
+  __atomic_add_fetch(&g_client_count, 1, __ATOMIC_RELEASE);
+
+  char line[API_EVENT_MAX];
+  snprintf(line, sizeof(line), "{\"event\":\"hello\",\"api\":%d}\n",
+           API_VERSION);
+  send_line(client, line);
+  format_state(line, sizeof(line));
+  send_line(client, line);
+  pthread_mutex_unlock(&g_lock);
+}
+
+static void close_client(ApiClient *client) {
+  pthread_mutex_lock(&g_lock);
+  close(client->fd);
+  client->fd = -1;
+  client->dead = false;
+  __atomic_sub_fetch(&g_client_count, 1, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&g_lock);
+}
+
+// Read what the client sent and run each complete line. False once the
+// client has gone.
+static bool read_client(ApiClient *client) {
+  ssize_t got = recv(client->fd, client->in + client->in_len,
+                     sizeof(client->in) - client->in_len, MSG_DONTWAIT);
+  if (got <= 0) {
+    return false;
+  }
+  client->in_len += (size_t)got;
+
+  char *start = client->in;
+  char *newline;
+  while ((newline = memchr(start, '\n',
+                           client->in_len - (size_t)(start - client->in))) !=
+         NULL) {
+    *newline = '\0';
+    handle_command(client, start);
+    start = newline + 1;
+  }
+  client->in_len -= (size_t)(start - client->in);
+  memmove(client->in, start, client->in_len);
+  if (client->in_len == sizeof(client->in)) {
+    LOG_ERROR("api: Command longer than %d bytes, disconnecting",
+              API_LINE_MAX);
+    return false;
+  }
+  return true;
+}
+
+static void *api_thread_func(void *arg) {
+  (void)arg;
+
+  while (g_running) {
+    // Only this thread adds or closes clients, so the fds stay valid
+    struct pollfd pfds[API_MAX_CLIENTS + 2] = {
+        {g_stop_pipe[0], POLLIN, 0}, {g_listen_fd, POLLIN, 0}};
+    ApiClient *polled[API_MAX_CLIENTS];
+    int count = 2;
+    for (int i = 0; i < API_MAX_CLIENTS; i++) {
+      if (g_clients[i].fd >= 0) {
+        pfds[count].fd = g_clients[i].fd;
+        pfds[count].events = POLLIN;
+        pfds[count].revents = 0;
+        polled[count - 2] = &g_clients[i];
+        count++;
+      }
+    }
+    if (poll(pfds, (nfds_t)count, -1) <= 0 || pfds[0].revents != 0) {
+      continue;
+    }
+
+    for (int i = 2; i < count; i++) {
+      ApiClient *client = polled[i - 2];
+      if (pfds[i].revents != 0 && (client->dead || !read_client(client))) {
+        close_client(client);
+      }
+    }
+    if (pfds[1].revents & POLLIN) {
+      accept_client();
+    }
+  }
+  return NULL;
+}
+
+// ============================================================================
+// Listeners
+// ============================================================================
+
+static void on_radio_change(RadioField field, double value) {
+  if (__atomic_load_n(&g_client_count, __ATOMIC_ACQUIRE) == 0) {
+    return;
+  }
+  char value_json[96];
+  format_field(value_json, sizeof(value_json), field, value);
+  // "field":value becomes "field":"name","value":value
+  char *colon = strchr(value_json, ':');
+  *colon = '\0';
+  char line[160];
+  snprintf(line, sizeof(line),
+           "{\"event\":\"radio\",\"field\":%s,\"value\":%s}\n", value_json,
+           colon + 1);
+  broadcast(line);
+}
+
+static void on_speech_sent(char type, const char *payload) {
+  if (__atomic_load_n(&g_client_count, __ATOMIC_ACQUIRE) == 0) {
+    return;
+  }
+  char text[API_EVENT_MAX - 64];
+  json_escape(text, sizeof(text), payload);
+  char line[API_EVENT_MAX];
+  snprintf(line, sizeof(line),
+           "{\"event\":\"speech\",\"type\":\"%c\",\"text\":\"%s\"}\n", type,
+           text);
+  broadcast(line);
+}
+
+void api_note_key(char key, bool is_hold) {
+  if (__atomic_load_n(&g_client_count, __ATOMIC_ACQUIRE) == 0) {
+    return;
+  }
+  char key_json[8];
+  char key_text[2] = {key, '\0'};
+  json_escape(key_json, sizeof(key_json), key_text);
+  char line[96];
+  snprintf(line, sizeof(line),
+           "{\"event\":\"key\",\"key\":\"%s\",\"hold\":%s}\n", key_json,
+           is_hold ? "true" : "false");
+  broadcast(line);
+}
+
+// ============================================================================
+// Control
+// ============================================================================
+
+int api_start(const char *path) {
+  if (g_running || path == NULL || path[0] == '\0') {
+    return HAMPOD_ERROR;
+  }
+  if (strlen(path) >= sizeof(g_path)) {
+    LOG_ERROR("api: Socket path too long: %s", path);
+    return HAMPOD_ERROR;
+  }
+
+  // A socket left behind by a crash is replaced; anything else is not
+  struct stat st;
+  if (lstat(path, &st) == 0) {
+    if (!S_ISSOCK(st.st_mode)) {
+      LOG_ERROR("api: %s exists and is not a socket", path);
+      return HAMPOD_ERROR;
+    }
+    unlink(path);
+  }
+
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+  g_listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (g_listen_fd < 0 ||
+      bind(g_listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+      listen(g_listen_fd, API_MAX_CLIENTS) != 0) {
+    LOG_ERROR("api: Cannot listen on %s", path);
+    if (g_listen_fd >= 0) {
+      close(g_listen_fd);
+      g_listen_fd = -1;
+    }
+    return HAMPOD_ERROR;
+  }
+  chmod(path, 0660); // The owner and the group only
+  snprintf(g_path, sizeof(g_path), "%s", path);
+
+  if (pipe(g_stop_pipe) != 0) {
+    LOG_ERROR("api: Cannot create stop pipe");
+    close(g_listen_fd);
+    g_listen_fd = -1;
+    unlink(g_path);
+    return HAMPOD_ERROR;
+  }
+
+  for (int i = 0; i < API_MAX_CLIENTS; i++) {
+    g_clients[i].fd = -1;
+    g_clients[i].dead = false;
+  }
+  __atomic_store_n(&g_client_count, 0, __ATOMIC_RELEASE);
+  radio_state_set_listener(on_radio_change);
+  speech_set_sent_listener(on_speech_sent);
+
+  g_running = true;
+  if (pthread_create(&g_thread, NULL, api_thread_func, NULL) != 0) {
+    LOG_ERROR("api: pthread_create failed");
+    g_running = false;
+    api_stop();
+    return HAMPOD_ERROR;
+  }
+  LOG_INFO("api: Listening on %s", g_path);
+  return HAMPOD_OK;
+}
+
+void api_stop(void) {
+  if (g_listen_fd < 0) {
+    return;
+  }
+  radio_state_set_listener(NULL);
+  speech_set_sent_listener(NULL);
+  if (g_running) {
+    g_running = false;
+    if (write(g_stop_pipe[1], "", 1) < 0) {
+      LOG_ERROR("api: Cannot wake the API thread");
+    }
+    pthread_join(g_thread, NULL);
+  }
+
+  for (int i = 0; i < API_MAX_CLIENTS; i++) {
+    if (g_clients[i].fd >= 0) {
+      close_client(&g_clients[i]);
+    }
+  }
+  close(g_listen_fd);
+  g_listen_fd = -1;
+  close(g_stop_pipe[0]);
+  close(g_stop_pipe[1]);
+  g_stop_pipe[0] = g_stop_pipe[1] = -1;
+  unlink(g_path);
+}
@@ -0,0 +1,231 @@
+/**
+ * @file band_stack.c
+ * @brief Per-band memory implementation
+ */
+
+#include "band_stack.h"
+#include "hampod_core.h"
+#include "radio_state.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+// ============================================================================
+// State
+// ============================================================================
+
+typedef struct {
+  const char *key;  // In the file
+  const char *name; // Spoken
+  double low_hz;
+  double high_hz;
+  double default_hz; // Until the operator has been there
+} Band;
+
+// Amateur bands (IARU Region 2 edges), in frequency order
+static const Band g_bands[] = {
+    {"160m", "160 meters", 1800000, 2000000, 1900000},
+    {"80m", "80 meters", 3500000, 4000000, 3750000},
+    {"60m", "60 meters", 5330000, 5410000, 5357000},
+    {"40m", "40 meters", 7000000, 7300000, 7150000},
+    {"30m", "30 meters", 10100000, 10150000, 10125000},
+    {"20m", "20 meters", 14000000, 14350000, 14200000},
+    {"17m", "17 meters", 18068000, 18168000, 18130000},
+    {"15m", "15 meters", 21000000, 21450000, 21300000},
+    {"12m", "12 meters", 24890000, 24990000, 24950000},
+    {"10m", "10 meters", 28000000, 29700000, 28400000},
+    {"6m", "6 meters", 50000000, 54000000, 50125000},
+    {"2m", "2 meters", 144000000, 148000000, 146520000},
+};
+#define BAND_COUNT (int)(sizeof(g_bands) / sizeof(g_bands[0]))
+
+static BandMemory g_memory[BAND_COUNT];
+static int g_last_band = -1; // Band of the last frequency remembered
+static bool g_dirty = false; // Changed since the file was written
+
+static char g_band_path[256] = BAND_STACK_DEFAULT_PATH;
+static pthread_mutex_t g_band_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// ============================================================================
+// Internal Functions
+// ============================================================================
+
+static bool valid_band(int band) { return band >= 0 && band < BAND_COUNT; }
+
+static int find_band(double freq_hz) {
+  for (int i = 0; i < BAND_COUNT; i++) {
+    if (freq_hz >= g_bands[i].low_hz && freq_hz <= g_bands[i].high_hz) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static void set_defaults(void) {
+  for (int i = 0; i < BAND_COUNT; i++) {
+    g_memory[i] = (BandMemory){g_bands[i].default_hz, 0, 0};
+  }
+}
+
+// Write every band. Call with g_band_mutex held.
+static void save_memory(void) {
+  char tmp_path[sizeof(g_band_path) + 4];
+  snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", g_band_path);
+  FILE *out = fopen(tmp_path, "w");
+  if (out == NULL) {
+    fprintf(stderr, "band_stack: Cannot write %s\n", tmp_path);
+    return;
+  }
+
+  fprintf(out, "# Last frequency, mode and passband on each band.\n");
+  fprintf(out, "# Mode is a Hamlib mode number, 0 to keep the radio's.\n");
+  fprintf(out, "# band freq_hz mode passband_hz\n");
+  for (int i = 0; i < BAND_COUNT; i++) {
+    fprintf(out, "%s %.0f %d %d\n", g_bands[i].key, g_memory[i].freq_hz,
+            g_memory[i].mode, g_memory[i].passband_hz);
+  }
+  fclose(out);
+  rename(tmp_path, g_band_path);
+  g_dirty = false;
+}
+
+// ============================================================================
+// Lifecycle
+// ============================================================================
+
+int band_stack_init(const char *path) {
+  pthread_mutex_lock(&g_band_mutex);
+  snprintf(g_band_path, sizeof(g_band_path), "%s",
+           path ? path : BAND_STACK_DEFAULT_PATH);
+  set_defaults();
+  g_last_band = -1;
+  g_dirty = false;
+
+  FILE *in = fopen(g_band_path, "r");
+  if (in == NULL) {
+    pthread_mutex_unlock(&g_band_mutex);
+    return 0; // Nowhere been yet
+  }
+
+  char line[128];
+  int loaded = 0;
+  while (fgets(line, sizeof(line), in)) {
+    char key[16];
+    double freq_hz;
+    int mode;
+    int passband_hz;
+    if (line[0] == '#' || sscanf(line, "%15s %lf %d %d", key, &freq_hz,
+                                 &mode, &passband_hz) != 4) {
+      continue;
+    }
+    for (int i = 0; i < BAND_COUNT; i++) {
+      // A frequency outside its band would recall somewhere else
+      if (strcmp(key, g_bands[i].key) == 0 && find_band(freq_hz) == i) {
+        g_memory[i] = (BandMemory){freq_hz, mode > 0 ? mode : 0,
+                                   passband_hz > 0 ? passband_hz : 0};
+        loaded++;
+      }
+    }
+  }
+  fclose(in);
+
+  DEBUG_PRINT("band_stack_init: %d bands from %s\n", loaded, g_band_path);
+  pthread_mutex_unlock(&g_band_mutex);
+  return 0;
+}
+
+void band_stack_save(void) {
+  pthread_mutex_lock(&g_band_mutex);
+  if (g_dirty) {
+    save_memory();
+  }
+  pthread_mutex_unlock(&g_band_mutex);
+}
+
+// ============================================================================
+// Bands
+// ============================================================================
+
+int band_stack_count(void) { return BAND_COUNT; }
+
+int band_stack_find(double freq_hz) { return find_band(freq_hz); }
+
+const char *band_stack_name(int band) {
+  return valid_band(band) ? g_bands[band].name : "Unknown band";
+}
+
+bool band_stack_range(int band, double *low_hz, double *high_hz) {
+  if (!valid_band(band)) {
+    return false;
+  }
+  *low_hz = g_bands[band].low_hz;
+  *high_hz = g_bands[band].high_hz;
+  return true;
+}
+
+int band_stack_step(double freq_hz, int direction) {
+  int band = find_band(freq_hz);
+  if (band >= 0) {
+    return (band + (direction > 0 ? 1 : BAND_COUNT - 1)) % BAND_COUNT;
+  }
+
+  // Between bands: the nearest one that way
+  if (direction > 0) {
+    for (int i = 0; i < BAND_COUNT; i++) {
+      if (g_bands[i].low_hz > freq_hz) {
+        return i;
+      }
+    }
+    return 0;
+  }
+  for (int i = BAND_COUNT - 1; i >= 0; i--) {
+    if (g_bands[i].high_hz < freq_hz) {
+      return i;
+    }
+  }
+  return BAND_COUNT - 1;
+}
+
+// ============================================================================
+// Memory
+// ============================================================================
+
+bool band_stack_get(int band, BandMemory *memory) {
+  if (!valid_band(band)) {
+    return false;
+  }
+
+  pthread_mutex_lock(&g_band_mutex);
+  *memory = g_memory[band];
+  pthread_mutex_unlock(&g_band_mutex);
+  return true;
+}
+
+void band_stack_remember(double freq_hz) {
+  int band = find_band(freq_hz);
+  if (band < 0) {
+    return;
+  }
+
+  double mode;
+  double passband;
+  bool have_mode = radio_state_get(RADIO_FIELD_MODE, &mode);
+  bool have_passband = radio_state_get(RADIO_FIELD_PASSBAND, &passband);
+
+  pthread_mutex_lock(&g_band_mutex);
+  BandMemory *memory = &g_memory[band];
+  memory->freq_hz = freq_hz;
+  if (have_mode && mode > 0) {
+    memory->mode = (int)mode;
+    memory->passband_hz = have_passband && passband > 0 ? (int)passband : 0;
+  }
+  g_dirty = true;
+
+  // Leaving a band is when its entry is final
+  if (g_last_band >= 0 && band != g_last_band) {
+    save_memory();
+  }
+  g_last_band = band;
+  pthread_mutex_unlock(&g_band_mutex);
+}
@@ -10,14 +10,25 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <pthread.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
 #include <time.h>
 #include <unistd.h>
 
 #include "comm.h"
+#include "evloop.h"
+
+// Shared wire-format framing (Firmware/hampod_frame.h). Software2 does not
+// define SHAREDLIB, so this also pulls in the implementation.
+#include "hampod_frame.h"
+#include "hampod_metrics.h"
+#include "hampod_shm_ring.h"
+#include "hampod_transport.h"
 
 // ============================================================================
 // Pipe Paths (relative to Software2 directory)
@@ -26,6 +37,9 @@
 // From Software2's perspective, Firmware is ../Firmware
 #define FIRMWARE_INPUT_PIPE "../Firmware/Firmware_i"  // We write to this
 #define FIRMWARE_OUTPUT_PIPE "../Firmware/Firmware_o" // We read from this
+#define FIRMWARE_SOCKET "../Firmware/" TRANSPORT_SOCKET_NAME // firmware --socket
+#define KEYPAD_SOCKET "../Firmware/" TRANSPORT_KEYPAD_SOCKET_NAME // --direct
+#define AUDIO_SOCKET "../Firmware/" TRANSPORT_AUDIO_SOCKET_NAME   // --direct
 
 // ============================================================================
 // Module State
@@ -33,118 +47,277 @@
 
 static int fd_firmware_out = -1; // File descriptor for reading from Firmware
 static int fd_firmware_in = -1;  // File descriptor for writing to Firmware
+                                 // (same fd as fd_firmware_out on a socket)
 static unsigned short packet_tag = 0; // Incrementing tag for packet matching
+static Frame_reader firmware_reader;  // Buffered framing for fd_firmware_out
+static Shm_audio_ring *audio_ring = NULL; // Firmware --shm-audio, else NULL
+static unsigned char audio_epoch = 0; // Speech epoch (under pending_mutex)
+
+// Direct channels to the keypad and audio processes (firmware --direct).
+// While connected, that subsystem's requests and replies skip the
+// Firmware controller; rx_fd == -1 means use the main link.
+static Transport keypad_link = {TRANSPORT_SEQPACKET, -1, -1};
+static Transport audio_link = {TRANSPORT_SEQPACKET, -1, -1};
+static Frame_reader keypad_reader;
+static Frame_reader audio_reader;
 
 // ============================================================================
-// Response Queue Structure (Thread-safe circular buffer)
+// Routed Events
 // ============================================================================
 
+// Payload bytes kept inline: key events, acks and most config replies
+#define COMM_EVENT_INLINE_LEN 16
+
+// What the router hands to a waiter: a packet's header and, when it fits,
+// its payload. Larger payloads (key drains, long config values) go to the
+// side buffer of the slot the event sits in, so a key or an ack moves a
+// few dozen bytes instead of a whole CommPacket.
 typedef struct {
-  CommPacket packets[COMM_RESPONSE_QUEUE_SIZE];
-  int head;                 // Index of first item
-  int tail;                 // Index of next empty slot
-  int count;                // Current number of items
-  pthread_mutex_t mutex;    // Protects queue access
-  pthread_cond_t not_empty; // Signaled when item added
-} ResponseQueue;
-
-// Response queues for each packet type
-static ResponseQueue keypad_queue;
-static ResponseQueue audio_queue;
-static ResponseQueue config_queue;
+  PacketType type;
+  unsigned short tag;
+  unsigned short flags;
+  unsigned short data_len;
+  unsigned char data[COMM_EVENT_INLINE_LEN];
+} CommEvent;
+
+static void event_store(CommEvent *event, unsigned char *side,
+                        const CommPacket *packet) {
+  event->type = packet->type;
+  event->tag = packet->tag;
+  event->flags = packet->flags;
+  event->data_len = packet->data_len;
+  memcpy(packet->data_len <= COMM_EVENT_INLINE_LEN ? event->data : side,
+         packet->data, packet->data_len);
+}
+
+static void event_load(const CommEvent *event, const unsigned char *side,
+                       CommPacket *packet) {
+  packet->type = event->type;
+  packet->tag = event->tag;
+  packet->flags = event->flags;
+  packet->data_len = event->data_len;
+  memcpy(packet->data,
+         event->data_len <= COMM_EVENT_INLINE_LEN ? event->data : side,
+         event->data_len);
+}
 
 // Router thread state
 static pthread_t router_thread;
 static volatile bool router_running = false;
+static bool router_on_loop = false; // Routing on the event loop instead
+
+// Receiver for keypad events pushed by Firmware (subscription mode)
+static CommKeypadEventHandler keypad_event_handler = NULL;
+
+// Receiver for spoken commands pushed by Firmware
+static CommVoiceCommandHandler voice_command_handler = NULL;
 
 // ============================================================================
-// Response Queue Functions
+// Pending Response Table (per-tag completion slots)
 // ============================================================================
 
-static void response_queue_init(ResponseQueue *q) {
-  q->head = 0;
-  q->tail = 0;
-  q->count = 0;
-  pthread_mutex_init(&q->mutex, NULL);
-  pthread_cond_init(&q->not_empty, NULL);
-}
-
-static void response_queue_destroy(ResponseQueue *q) {
-  pthread_mutex_destroy(&q->mutex);
-  pthread_cond_destroy(&q->not_empty);
-}
+typedef struct {
+  bool in_use;         // Slot holds an outstanding request
+  bool done;           // Response has arrived
+  bool discard;        // Cancelled: drop the response on arrival
+  PacketType type;     // Type the response must carry
+  unsigned short tag;  // Tag the response must carry
+  CommEvent response;  // Filled by the router when done
+  unsigned char side[COMM_MAX_DATA_LEN]; // Its payload, if not inline
+} PendingSlot;
+
+// Also guards packet_tag, so tags are unique across calling threads
+static pthread_mutex_t pending_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pending_done; // On CLOCK_MONOTONIC, see pending_init
+static pthread_once_t pending_once = PTHREAD_ONCE_INIT;
+static PendingSlot pending[COMM_MAX_PENDING];
 
-static int response_queue_push(ResponseQueue *q, const CommPacket *packet) {
-  pthread_mutex_lock(&q->mutex);
+// ============================================================================
+// Pending Response Functions
+// ============================================================================
 
-  if (q->count >= COMM_RESPONSE_QUEUE_SIZE) {
-    // Queue full - drop oldest packet (overwrite head)
-    LOG_ERROR("Response queue full, dropping oldest packet");
-    q->head = (q->head + 1) % COMM_RESPONSE_QUEUE_SIZE;
-    q->count--;
+// Next free tag. Never hands out the keypad push, voice or no-reply tags
+// or a tag that still has a slot waiting. Caller holds pending_mutex.
+static unsigned short next_tag_locked(void) {
+  for (;;) {
+    unsigned short tag = packet_tag++;
+    if (tag == COMM_KEYPAD_PUSH_TAG || tag == COMM_VOICE_TAG ||
+        tag == COMM_NO_REPLY_TAG) {
+      continue;
+    }
+    bool busy = false;
+    for (int i = 0; i < COMM_MAX_PENDING; i++) {
+      if (pending[i].in_use && pending[i].tag == tag) {
+        busy = true;
+        break;
+      }
+    }
+    if (!busy) {
+      return tag;
+    }
   }
+}
 
-  // Add packet to tail
-  q->packets[q->tail] = *packet;
-  q->tail = (q->tail + 1) % COMM_RESPONSE_QUEUE_SIZE;
-  q->count++;
+static unsigned short next_packet_tag(void) {
+  pthread_mutex_lock(&pending_mutex);
+  unsigned short tag = next_tag_locked();
+  pthread_mutex_unlock(&pending_mutex);
+  return tag;
+}
 
-  // Signal that queue is not empty
-  pthread_cond_signal(&q->not_empty);
+// Allocate a tag and a slot for its response (before the request is sent,
+// so the router can never see the response first). When the table is full,
+// a cancelled slot is reclaimed - its response may never come (an
+// interrupt drops queued requests without an ack).
+static int pending_register(PacketType type, unsigned short *tag_out) {
+  pthread_mutex_lock(&pending_mutex);
+  PendingSlot *slot = NULL;
+  for (int i = 0; i < COMM_MAX_PENDING && slot == NULL; i++) {
+    if (!pending[i].in_use) {
+      slot = &pending[i];
+    }
+  }
+  for (int i = 0; i < COMM_MAX_PENDING && slot == NULL; i++) {
+    if (pending[i].discard) {
+      slot = &pending[i];
+    }
+  }
+  if (slot == NULL) {
+    pthread_mutex_unlock(&pending_mutex);
+    return HAMPOD_ERROR;
+  }
 
-  pthread_mutex_unlock(&q->mutex);
+  slot->in_use = false; // Don't let next_tag_locked() skip our own old tag
+  slot->tag = next_tag_locked();
+  slot->in_use = true;
+  slot->done = false;
+  slot->discard = false;
+  slot->type = type;
+  *tag_out = slot->tag;
+  pthread_mutex_unlock(&pending_mutex);
   return HAMPOD_OK;
 }
 
-static int response_queue_pop_timeout(ResponseQueue *q, CommPacket *packet,
-                                      int timeout_ms) {
-  pthread_mutex_lock(&q->mutex);
-
-  // Wait for item with timeout
-  while (q->count == 0 && router_running) {
-    struct timespec timeout;
-    clock_gettime(CLOCK_REALTIME, &timeout);
-
-    // Add timeout_ms to current time
-    timeout.tv_sec += timeout_ms / 1000;
-    timeout.tv_nsec += (timeout_ms % 1000) * 1000000;
-    if (timeout.tv_nsec >= 1000000000) {
-      timeout.tv_sec += 1;
-      timeout.tv_nsec -= 1000000000;
-    }
-
-    int result = pthread_cond_timedwait(&q->not_empty, &q->mutex, &timeout);
-    if (result == ETIMEDOUT) {
-      pthread_mutex_unlock(&q->mutex);
-      return HAMPOD_TIMEOUT;
+static PendingSlot *pending_find_locked(unsigned short tag) {
+  for (int i = 0; i < COMM_MAX_PENDING; i++) {
+    if (pending[i].in_use && pending[i].tag == tag) {
+      return &pending[i];
     }
   }
+  return NULL;
+}
 
-  if (!router_running && q->count == 0) {
-    pthread_mutex_unlock(&q->mutex);
-    return HAMPOD_ERROR;
+// Router side: hand a response to the slot waiting for its tag.
+// Returns false if nobody registered the tag.
+static bool pending_complete(const CommPacket *packet) {
+  pthread_mutex_lock(&pending_mutex);
+  PendingSlot *slot = pending_find_locked(packet->tag);
+  if (slot == NULL || slot->type != packet->type) {
+    pthread_mutex_unlock(&pending_mutex);
+    return false;
   }
 
-  if (q->count == 0) {
-    pthread_mutex_unlock(&q->mutex);
-    return HAMPOD_NOT_FOUND;
+  if (slot->discard) {
+    slot->in_use = false;
+  } else {
+    event_store(&slot->response, slot->side, packet);
+    slot->done = true;
+    pthread_cond_broadcast(&pending_done);
   }
+  pthread_mutex_unlock(&pending_mutex);
+  return true;
+}
 
-  // Remove packet from head
-  *packet = q->packets[q->head];
-  q->head = (q->head + 1) % COMM_RESPONSE_QUEUE_SIZE;
-  q->count--;
+static void pending_init(void) {
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&pending_done, &attr);
+  pthread_condattr_destroy(&attr);
+}
 
-  pthread_mutex_unlock(&q->mutex);
-  return HAMPOD_OK;
+// Wait on pending_done until timeout (CLOCK_MONOTONIC). On the event loop
+// thread nobody else reads Firmware's replies, so serve its channels
+// meanwhile instead.
+// Called and returns with pending_mutex held.
+static int pending_wait_locked(const struct timespec *timeout) {
+  if (!evloop_in_loop()) {
+    return pthread_cond_timedwait(&pending_done, &pending_mutex, timeout);
+  }
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  long long remaining_ms = (long long)(timeout->tv_sec - now.tv_sec) * 1000 +
+                           (timeout->tv_nsec - now.tv_nsec) / 1000000;
+  if (remaining_ms <= 0) {
+    return ETIMEDOUT;
+  }
+  pthread_mutex_unlock(&pending_mutex);
+  evloop_pump((int)remaining_ms);
+  pthread_mutex_lock(&pending_mutex);
+  return 0;
 }
 
 // ============================================================================
-// Router Thread
+// Router
 // ============================================================================
 
+static int comm_read_frame(Frame_reader *reader, CommPacket *packet);
+
+// Hand one packet from Firmware to whoever waits for it
+static void router_dispatch(const CommPacket *packet) {
+  if (packet->tag == COMM_NO_REPLY_TAG) {
+    return; // Ack of a request nobody waits for
+  }
+
+  // Responses somebody registered for go straight to that caller
+  if (packet->tag != COMM_KEYPAD_PUSH_TAG && packet->tag != COMM_VOICE_TAG &&
+      pending_complete(packet)) {
+    return;
+  }
+
+  switch (packet->type) {
+  case PACKET_KEYPAD:
+    if (packet->tag == COMM_KEYPAD_PUSH_TAG &&
+        packet->data_len == COMM_KEYPAD_PUSH_LEN) {
+      // Unsolicited key event
+      CommKeypadEventHandler handler = keypad_event_handler;
+      if (handler != NULL) {
+        uint64_t timestamp_us;
+        memcpy(&timestamp_us, &packet->data[2], sizeof(timestamp_us));
+        handler((char)packet->data[0], packet->data[1], timestamp_us);
+      }
+      break;
+    }
+    if (packet->tag == COMM_VOICE_TAG && packet->data_len >= 1) {
+      // Spoken command - "<kind><argument>"
+      CommVoiceCommandHandler handler = voice_command_handler;
+      if (handler != NULL) {
+        char arg[32];
+        int len = packet->data_len - 1 < (int)sizeof(arg) - 1
+                      ? packet->data_len - 1
+                      : (int)sizeof(arg) - 1;
+        memcpy(arg, &packet->data[1], (size_t)len);
+        arg[len] = '\0';
+        handler((char)packet->data[0], arg);
+      }
+      break;
+    }
+    // Nobody registered the tag, or its wait timed out or was cancelled:
+    // nothing would ever read the ack, so it is dropped here
+    break;
+  case PACKET_AUDIO:
+  case PACKET_CONFIG:
+    break; // Likewise an ack nobody waits for
+  default:
+    LOG_ERROR("Router: Unknown packet type %d", packet->type);
+    break;
+  }
+}
+
 static void *router_thread_func(void *arg) {
   (void)arg;
+  hampod_metrics_name_thread("router");
 
   LOG_INFO("Router thread started");
 
@@ -159,33 +332,56 @@ static void *router_thread_func(void *arg) {
       usleep(100000); // 100ms before retry
       continue;
     }
-
-    switch (packet.type) {
-    case PACKET_KEYPAD:
-      if (response_queue_push(&keypad_queue, &packet) != HAMPOD_OK) {
-        LOG_ERROR("Router: Keypad queue full, dropping packet");
-      }
-      break;
-    case PACKET_AUDIO:
-      if (response_queue_push(&audio_queue, &packet) != HAMPOD_OK) {
-        LOG_ERROR("Router: Audio queue full, dropping packet");
-      }
-      break;
-    case PACKET_CONFIG:
-      if (response_queue_push(&config_queue, &packet) != HAMPOD_OK) {
-        LOG_ERROR("Router: Config queue full, dropping packet");
-      }
-      break;
-    default:
-      LOG_ERROR("Router: Unknown packet type %d", packet.type);
-      break;
-    }
+    router_dispatch(&packet);
   }
 
   LOG_INFO("Router thread exiting");
   return NULL;
 }
 
+// Event loop: a Firmware channel is readable. Reads its frame and any
+// more already buffered, which epoll would not report.
+static void router_link_ready(void *arg) {
+  Frame_reader *reader = arg;
+  do {
+    CommPacket packet;
+    int result = comm_read_frame(reader, &packet);
+    if (result == HAMPOD_ERROR) {
+      // The main link is gone; stop watching rather than spin on EOF
+      LOG_ERROR("Router: Firmware link failed");
+      evloop_remove_io(reader->fd);
+      return;
+    }
+    if (result == HAMPOD_OK) {
+      router_dispatch(&packet);
+    } else if (result != HAMPOD_TIMEOUT) {
+      return; // A direct channel closed
+    }
+  } while (router_running && reader->start != reader->end);
+}
+
+// Event loop: watch the channels the router thread would poll
+static int router_watch_links(void) {
+  if (evloop_add_io(fd_firmware_out, router_link_ready, &firmware_reader) !=
+      0) {
+    return HAMPOD_ERROR;
+  }
+  if (keypad_link.rx_fd != -1 &&
+      evloop_add_io(keypad_link.rx_fd, router_link_ready, &keypad_reader) !=
+          0) {
+    transport_close(&keypad_link); // Its traffic uses the main link
+  }
+  if (audio_link.rx_fd != -1 &&
+      evloop_add_io(audio_link.rx_fd, router_link_ready, &audio_reader) != 0) {
+    transport_close(&audio_link);
+  }
+  // Frames read ahead with the ready packet
+  if (firmware_reader.start != firmware_reader.end) {
+    evloop_post(router_link_ready, &firmware_reader);
+  }
+  return HAMPOD_OK;
+}
+
 int comm_start_router(void) {
   if (router_running) {
     LOG_ERROR("Router already running");
@@ -194,13 +390,20 @@ int comm_start_router(void) {
 
   LOG_INFO("Starting router thread...");
 
-  // Initialize response queues
-  response_queue_init(&keypad_queue);
-  response_queue_init(&audio_queue);
-  response_queue_init(&config_queue);
+  pthread_once(&pending_once, pending_init);
 
-  // Start router thread
+  // With the event loop running, route on it instead of a thread
   router_running = true;
+  if (evloop_running()) {
+    if (router_watch_links() != HAMPOD_OK) {
+      LOG_ERROR("Failed to route on the event loop");
+      router_running = false;
+      return HAMPOD_ERROR;
+    }
+    router_on_loop = true;
+    LOG_INFO("Router running on the event loop");
+    return HAMPOD_OK;
+  }
   if (pthread_create(&router_thread, NULL, router_thread_func, NULL) != 0) {
     LOG_ERROR("Failed to create router thread");
     router_running = false;
@@ -219,43 +422,175 @@ void comm_stop_router(void) {
   LOG_INFO("Stopping router thread...");
 
   // Signal thread to stop
+  bool on_loop = router_on_loop;
   router_running = false;
+  router_on_loop = false;
 
-  // Wake up any threads waiting on queues
-  pthread_cond_broadcast(&keypad_queue.not_empty);
-  pthread_cond_broadcast(&audio_queue.not_empty);
-  pthread_cond_broadcast(&config_queue.not_empty);
+  pthread_mutex_lock(&pending_mutex);
+  pthread_cond_broadcast(&pending_done);
+  pthread_mutex_unlock(&pending_mutex);
 
   // Wait for thread to finish
   // Note: pthread_join is blocking, but router_running=false should cause
   // the thread to exit quickly after its next read attempt
-  pthread_join(router_thread, NULL);
-
-  // Destroy queues
-  response_queue_destroy(&keypad_queue);
-  response_queue_destroy(&audio_queue);
-  response_queue_destroy(&config_queue);
+  if (on_loop) {
+    evloop_remove_io(fd_firmware_out);
+    evloop_remove_io(keypad_link.rx_fd);
+    evloop_remove_io(audio_link.rx_fd);
+  } else {
+    pthread_join(router_thread, NULL);
+  }
 
   LOG_INFO("Router thread stopped");
 }
 
 bool comm_router_is_running(void) { return router_running; }
 
-int comm_wait_keypad_response(CommPacket *packet, int timeout_ms) {
-  return response_queue_pop_timeout(&keypad_queue, packet, timeout_ms);
+int comm_poll_response(unsigned short tag, CommPacket *packet) {
+  pthread_mutex_lock(&pending_mutex);
+  PendingSlot *slot = pending_find_locked(tag);
+  if (slot == NULL || slot->discard) {
+    pthread_mutex_unlock(&pending_mutex);
+    return HAMPOD_NOT_FOUND;
+  }
+  if (!slot->done) {
+    pthread_mutex_unlock(&pending_mutex);
+    return HAMPOD_TIMEOUT;
+  }
+  if (packet != NULL) {
+    event_load(&slot->response, slot->side, packet);
+  }
+  slot->in_use = false;
+  pthread_mutex_unlock(&pending_mutex);
+  return HAMPOD_OK;
 }
 
-int comm_wait_audio_response(CommPacket *packet, int timeout_ms) {
-  return response_queue_pop_timeout(&audio_queue, packet, timeout_ms);
+int comm_wait_response(unsigned short tag, CommPacket *packet,
+                       int timeout_ms) {
+  struct timespec timeout;
+  clock_gettime(CLOCK_MONOTONIC, &timeout);
+  timeout.tv_sec += timeout_ms / 1000;
+  timeout.tv_nsec += (timeout_ms % 1000) * 1000000;
+  if (timeout.tv_nsec >= 1000000000) {
+    timeout.tv_sec += 1;
+    timeout.tv_nsec -= 1000000000;
+  }
+
+  pthread_mutex_lock(&pending_mutex);
+  PendingSlot *slot = pending_find_locked(tag);
+  if (slot == NULL || slot->discard) {
+    pthread_mutex_unlock(&pending_mutex);
+    return HAMPOD_NOT_FOUND;
+  }
+
+  // A cancelled slot may be reclaimed for another tag while we sleep
+  while (slot->in_use && slot->tag == tag && !slot->discard && !slot->done &&
+         router_running) {
+    if (pending_wait_locked(&timeout) == ETIMEDOUT) {
+      // Keep the slot: the caller may poll again or cancel
+      pthread_mutex_unlock(&pending_mutex);
+      return HAMPOD_TIMEOUT;
+    }
+  }
+
+  if (!slot->in_use || slot->tag != tag || slot->discard) {
+    // comm_cancel_response() from another thread; the slot is no longer ours
+    pthread_mutex_unlock(&pending_mutex);
+    return HAMPOD_ERROR;
+  }
+
+  int result = HAMPOD_ERROR; // Router stopped before the response came
+  if (slot->done) {
+    if (packet != NULL) {
+      event_load(&slot->response, slot->side, packet);
+    }
+    result = HAMPOD_OK;
+  }
+  slot->in_use = false;
+  pthread_mutex_unlock(&pending_mutex);
+  return result;
+}
+
+void comm_cancel_response(unsigned short tag) {
+  pthread_mutex_lock(&pending_mutex);
+  PendingSlot *slot = pending_find_locked(tag);
+  if (slot != NULL) {
+    // Keep swallowing the late response, but let the slot be reclaimed
+    slot->discard = true;
+    if (slot->done) {
+      slot->in_use = false;
+    }
+    pthread_cond_broadcast(&pending_done); // Wake a waiter on this tag
+  }
+  pthread_mutex_unlock(&pending_mutex);
 }
 
 // ============================================================================
 // Initialization & Cleanup
 // ============================================================================
 
+// Connect the direct keypad/audio channels if Firmware offers them.
+// HAMPOD_DIRECT=0 keeps everything on the main link.
+static void comm_connect_direct(void) {
+  const char *direct_env = getenv("HAMPOD_DIRECT");
+  if (direct_env != NULL && strcmp(direct_env, "0") == 0) {
+    return;
+  }
+
+  if (transport_connect_seqpacket(KEYPAD_SOCKET, &keypad_link) == 0) {
+    frame_reader_init(&keypad_reader, keypad_link.rx_fd);
+    LOG_INFO("Direct keypad channel %s (fd=%d)", KEYPAD_SOCKET,
+             keypad_link.rx_fd);
+  }
+  if (transport_connect_seqpacket(AUDIO_SOCKET, &audio_link) == 0) {
+    frame_reader_init(&audio_reader, audio_link.rx_fd);
+    LOG_INFO("Direct audio channel %s (fd=%d)", AUDIO_SOCKET,
+             audio_link.rx_fd);
+  }
+
+  // A subsystem restarting must not kill us mid-write; the router sees EOF
+  // and falls back to the main link instead
+  if (keypad_link.tx_fd != -1 || audio_link.tx_fd != -1) {
+    signal(SIGPIPE, SIG_IGN);
+  }
+}
+
+// Map the Firmware's shared-memory audio ring if it created one.
+// HAMPOD_SHM_AUDIO=0 keeps every audio request on the pipe.
+static void comm_attach_audio_ring(void) {
+  const char *shm_env = getenv("HAMPOD_SHM_AUDIO");
+  if (shm_env != NULL && strcmp(shm_env, "0") == 0) {
+    return;
+  }
+
+  audio_ring = shm_ring_attach(SHM_RING_NAME);
+  if (audio_ring != NULL) {
+    LOG_INFO("Using shared-memory audio ring %s", SHM_RING_NAME);
+  } else {
+    LOG_DEBUG("No shared-memory audio ring, audio requests use the pipe");
+  }
+}
+
 int comm_init(void) {
   LOG_INFO("Initializing Firmware communication...");
 
+  // Prefer the seqpacket socket when Firmware was started with --socket.
+  // HAMPOD_TRANSPORT=fifo forces the named pipes.
+  const char *transport_env = getenv("HAMPOD_TRANSPORT");
+  if (transport_env == NULL || strcmp(transport_env, "fifo") != 0) {
+    Transport link;
+    if (transport_connect_seqpacket(FIRMWARE_SOCKET, &link) == 0) {
+      fd_firmware_out = link.rx_fd;
+      fd_firmware_in = link.tx_fd;
+      frame_reader_init(&firmware_reader, fd_firmware_out);
+      LOG_INFO("Connected to Firmware socket %s (fd=%d)", FIRMWARE_SOCKET,
+               fd_firmware_out);
+      comm_attach_audio_ring();
+      return HAMPOD_OK;
+    }
+    LOG_DEBUG("No Firmware socket at %s, using named pipes", FIRMWARE_SOCKET);
+  }
+
   // Open Firmware_o for reading (Firmware -> Software)
   LOG_DEBUG("Opening %s for reading...", FIRMWARE_OUTPUT_PIPE);
   fd_firmware_out = open(FIRMWARE_OUTPUT_PIPE, O_RDONLY);
@@ -266,6 +601,7 @@ int comm_init(void) {
     return HAMPOD_ERROR;
   }
   LOG_DEBUG("Opened %s (fd=%d)", FIRMWARE_OUTPUT_PIPE, fd_firmware_out);
+  frame_reader_init(&firmware_reader, fd_firmware_out);
 
   // Open Firmware_i for writing (Software -> Firmware)
   // Retry loop since Firmware may not have opened its read end yet
@@ -289,6 +625,8 @@ int comm_init(void) {
   }
   LOG_DEBUG("Opened %s (fd=%d)", FIRMWARE_INPUT_PIPE, fd_firmware_in);
 
+  comm_attach_audio_ring();
+
   LOG_INFO("Firmware communication initialized successfully");
 
   // Note: Router is NOT started here - it's started after comm_wait_ready()
@@ -304,19 +642,30 @@ void comm_close(void) {
     comm_stop_router();
   }
 
-  if (fd_firmware_out != -1) {
-    close(fd_firmware_out);
-    fd_firmware_out = -1;
-  }
+  Transport link = {TRANSPORT_FIFO, fd_firmware_out, fd_firmware_in};
+  transport_close(&link);
+  fd_firmware_out = -1;
+  fd_firmware_in = -1;
+  transport_close(&keypad_link);
+  transport_close(&audio_link);
 
-  if (fd_firmware_in != -1) {
-    close(fd_firmware_in);
-    fd_firmware_in = -1;
-  }
+  shm_ring_detach(audio_ring);
+  audio_ring = NULL;
 
   LOG_INFO("Firmware communication closed");
 }
 
+int comm_reset_audio_link(void) {
+  int fd = audio_link.rx_fd;
+  if (fd == -1) {
+    return HAMPOD_NOT_FOUND;
+  }
+  // The router sees it close and drops it, as when Firmware closes it
+  LOG_INFO("comm_reset_audio_link: Shutting down direct audio channel");
+  shutdown(fd, SHUT_RDWR);
+  return HAMPOD_OK;
+}
+
 bool comm_is_connected(void) {
   return (fd_firmware_out != -1 && fd_firmware_in != -1);
 }
@@ -340,12 +689,21 @@ int comm_wait_ready(void) {
   if (packet.data_len > 0 && packet.data[0] == 'R') {
     LOG_INFO("Firmware ready!");
 
+    // The subsystem processes are listening by the time Firmware is ready
+    comm_connect_direct();
+
     // NOW start the router thread (after ready signal received)
     if (comm_start_router() != HAMPOD_OK) {
       LOG_ERROR("Failed to start router thread");
       return HAMPOD_ERROR;
     }
 
+    // Over a socket Firmware may serve other clients too; this one is the UI
+    if (fd_firmware_out == fd_firmware_in &&
+        comm_set_session_priority(COMM_SESSION_PRIORITY_MAIN) != HAMPOD_OK) {
+      LOG_DEBUG("Firmware did not take the main session priority");
+    }
+
     return HAMPOD_OK;
   }
 
@@ -357,54 +715,93 @@ int comm_wait_ready(void) {
 // Reading from Firmware
 // ============================================================================
 
-int comm_read_packet(CommPacket *packet) {
-  if (!comm_is_connected()) {
-    LOG_ERROR("comm_read_packet: Not connected");
-    return HAMPOD_ERROR;
+// The link with a frame to read. Without direct channels this is always
+// the main link, read blocking as before.
+static Frame_reader *comm_ready_reader(void) {
+  if (keypad_link.rx_fd == -1 && audio_link.rx_fd == -1) {
+    return &firmware_reader;
+  }
+  if (firmware_reader.start != firmware_reader.end) {
+    return &firmware_reader; // Frames already buffered from the FIFO
   }
 
-  if (packet == NULL) {
-    LOG_ERROR("comm_read_packet: NULL packet pointer");
-    return HAMPOD_ERROR;
+  struct pollfd fds[3] = {{keypad_link.rx_fd, POLLIN, 0},
+                          {audio_link.rx_fd, POLLIN, 0},
+                          {fd_firmware_out, POLLIN, 0}};
+  int rc;
+  do {
+    rc = poll(fds, 3, -1);
+  } while (rc == -1 && errno == EINTR);
+  if (rc <= 0) {
+    return NULL;
   }
 
-  // Read packet header fields (matching Firmware's write order)
-  // 1. Packet_type (enum, typically 4 bytes on 32/64-bit systems)
-  ssize_t n = read(fd_firmware_out, &packet->type, sizeof(PacketType));
-  if (n != sizeof(PacketType)) {
-    LOG_ERROR("comm_read_packet: Failed to read type (%zd bytes)", n);
-    return HAMPOD_ERROR;
+  // Keypad first: its replies are small and the user is waiting on them
+  if (fds[0].revents != 0) {
+    return &keypad_reader;
+  }
+  if (fds[1].revents != 0) {
+    return &audio_reader;
   }
+  return &firmware_reader;
+}
 
-  // 2. data_len (unsigned short, 2 bytes)
-  n = read(fd_firmware_out, &packet->data_len, sizeof(unsigned short));
-  if (n != sizeof(unsigned short)) {
-    LOG_ERROR("comm_read_packet: Failed to read data_len");
+int comm_read_packet(CommPacket *packet) {
+  if (!comm_is_connected()) {
+    LOG_ERROR("comm_read_packet: Not connected");
     return HAMPOD_ERROR;
   }
 
-  // 3. tag (unsigned short, 2 bytes)
-  n = read(fd_firmware_out, &packet->tag, sizeof(unsigned short));
-  if (n != sizeof(unsigned short)) {
-    LOG_ERROR("comm_read_packet: Failed to read tag");
+  if (packet == NULL) {
+    LOG_ERROR("comm_read_packet: NULL packet pointer");
     return HAMPOD_ERROR;
   }
 
-  // 4. data (variable length)
-  if (packet->data_len > 0) {
-    if (packet->data_len > COMM_MAX_DATA_LEN) {
-      LOG_ERROR("comm_read_packet: data_len %u exceeds max %d",
-                packet->data_len, COMM_MAX_DATA_LEN);
+  for (;;) {
+    Frame_reader *reader = comm_ready_reader();
+    if (reader == NULL) {
+      LOG_ERROR("comm_read_packet: poll failed: %s", strerror(errno));
       return HAMPOD_ERROR;
     }
+    int result = comm_read_frame(reader, packet);
+    if (result != HAMPOD_NOT_FOUND && result != HAMPOD_TIMEOUT) {
+      return result;
+    }
+  }
+}
 
-    n = read(fd_firmware_out, packet->data, packet->data_len);
-    if (n != packet->data_len) {
-      LOG_ERROR("comm_read_packet: Failed to read data (expected %u, got %zd)",
-                packet->data_len, n);
+// One buffered read per frame (header + data, see hampod_frame.h). A
+// direct channel that closed is dropped, its traffic falling back to the
+// main link, and reported as HAMPOD_NOT_FOUND. A frame too large for a
+// CommPacket, or a corrupt one, is skipped and reported as HAMPOD_TIMEOUT:
+// nothing was read, but the link is fine.
+static int comm_read_frame(Frame_reader *reader, CommPacket *packet) {
+  Frame_header header = {0};
+  int result = frame_read(reader, &header, packet->data, COMM_MAX_DATA_LEN);
+  if (result == FRAME_DROPPED) {
+    LOG_ERROR("comm_read_packet: Dropped a frame (type=%d, len=%u)",
+              header.type, header.data_len);
+    return HAMPOD_TIMEOUT;
+  }
+  if (result != 0) {
+    if (reader == &firmware_reader) {
+      LOG_ERROR("comm_read_packet: Failed to read frame (len=%u)",
+                header.data_len);
       return HAMPOD_ERROR;
     }
+
+    // A subsystem went away; its traffic falls back to the main link
+    Transport *link = (reader == &keypad_reader) ? &keypad_link : &audio_link;
+    LOG_ERROR("comm_read_packet: Direct %s channel closed",
+              (reader == &keypad_reader) ? "keypad" : "audio");
+    evloop_remove_io(link->rx_fd);
+    transport_close(link);
+    return HAMPOD_NOT_FOUND;
   }
+  packet->type = (PacketType)header.type;
+  packet->data_len = header.data_len;
+  packet->tag = header.tag;
+  packet->flags = header.flags;
 
   LOG_DEBUG("comm_read_packet: type=%d, len=%u, tag=%u", packet->type,
             packet->data_len, packet->tag);
@@ -420,20 +817,27 @@ int comm_read_keypad(char *key_out) {
 
   // Send a keypad request to Firmware
   CommPacket request = {
-      .type = PACKET_KEYPAD, .data_len = 1, .tag = packet_tag++, .data = {'r'}
+      .type = PACKET_KEYPAD, .data_len = 1, .data = {'r'}
       // 'r' = read request
   };
+  if (pending_register(PACKET_KEYPAD, &request.tag) != HAMPOD_OK) {
+    LOG_ERROR("comm_read_keypad: Too many requests in flight");
+    return HAMPOD_ERROR;
+  }
 
   if (comm_send_packet(&request) != HAMPOD_OK) {
+    comm_cancel_response(request.tag);
     return HAMPOD_ERROR;
   }
 
-  // Wait for response from router queue
+  // Wait for the response carrying our tag
   CommPacket response;
-  int result = comm_wait_keypad_response(&response, COMM_KEYPAD_TIMEOUT_MS);
+  int result = comm_wait_response(request.tag, &response,
+                                  COMM_KEYPAD_TIMEOUT_MS);
 
   if (result == HAMPOD_TIMEOUT) {
     LOG_ERROR("comm_read_keypad: Timeout waiting for response");
+    comm_cancel_response(request.tag);
     return HAMPOD_TIMEOUT;
   }
 
@@ -454,6 +858,151 @@ int comm_read_keypad(char *key_out) {
   return HAMPOD_OK;
 }
 
+// ============================================================================
+// Keypad Push Events
+// ============================================================================
+
+void comm_set_keypad_event_handler(CommKeypadEventHandler handler) {
+  keypad_event_handler = handler;
+}
+
+void comm_set_voice_command_handler(CommVoiceCommandHandler handler) {
+  voice_command_handler = handler;
+}
+
+int comm_subscribe_keypad(bool enable, int hold_threshold_ms, int credits,
+                          bool *holds_out, bool *credits_out) {
+  CommPacket request = {.type = PACKET_KEYPAD,
+                        .data_len = 2,
+                        .data = {COMM_KEYPAD_SUBSCRIBE, enable ? 1 : 0}};
+  if (holds_out != NULL) {
+    *holds_out = false;
+  }
+  if (credits_out != NULL) {
+    *credits_out = false;
+  }
+  if (enable && hold_threshold_ms > 0) {
+    if (hold_threshold_ms > 0xFFFF) {
+      hold_threshold_ms = 0xFFFF;
+    }
+    request.data[2] = (unsigned char)(hold_threshold_ms & 0xFF);
+    request.data[3] = (unsigned char)(hold_threshold_ms >> 8);
+    request.data_len = 4;
+  }
+  if (enable && credits > 0) {
+    if (credits > 0xFFFF) {
+      credits = 0xFFFF;
+    }
+    request.data[4] = (unsigned char)(credits & 0xFF);
+    request.data[5] = (unsigned char)(credits >> 8);
+    request.data_len = 6; // Hold bytes stay 0 without a threshold
+  }
+  if (pending_register(PACKET_KEYPAD, &request.tag) != HAMPOD_OK) {
+    return HAMPOD_ERROR;
+  }
+
+  if (comm_send_packet(&request) != HAMPOD_OK) {
+    comm_cancel_response(request.tag);
+    return HAMPOD_ERROR;
+  }
+
+  // Older Firmware treats 's' like 'r' and answers with a key (or '-')
+  CommPacket response;
+  int result = comm_wait_response(request.tag, &response, 500);
+  if (result != HAMPOD_OK) {
+    if (result == HAMPOD_TIMEOUT) {
+      comm_cancel_response(request.tag);
+    }
+    return result;
+  }
+
+  if (response.data_len >= 1 &&
+      response.data[0] == COMM_KEYPAD_SUBSCRIBE_ACK) {
+    // Firmware without hold or credit support acks with the bare 'S'
+    bool holds = false;
+    bool credited = false;
+    for (int i = 1; i < response.data_len; i++) {
+      holds |= response.data[i] == COMM_KEYPAD_SUBSCRIBE_HOLDS;
+      credited |= response.data[i] == COMM_KEYPAD_SUBSCRIBE_CREDITS;
+    }
+    if (holds_out != NULL) {
+      *holds_out = holds;
+    }
+    if (credits_out != NULL) {
+      *credits_out = credited;
+    }
+    LOG_INFO("Keypad push mode %s%s%s", enable ? "enabled" : "disabled",
+             holds ? " (Firmware hold events)" : "",
+             credited ? " (flow controlled)" : "");
+    return HAMPOD_OK;
+  }
+
+  LOG_INFO("Firmware does not support keypad push mode");
+  return HAMPOD_NOT_FOUND;
+}
+
+int comm_grant_keypad_credits(int credits) {
+  if (credits <= 0 || credits > 0xFFFF) {
+    return HAMPOD_ERROR;
+  }
+  CommPacket request = {.type = PACKET_KEYPAD,
+                        .tag = COMM_NO_REPLY_TAG,
+                        .data_len = 3,
+                        .data = {COMM_KEYPAD_CREDIT,
+                                 (unsigned char)(credits & 0xFF),
+                                 (unsigned char)(credits >> 8)}};
+  return comm_send_packet(&request);
+}
+
+int comm_read_keypad_events(CommKeyEvent *events, int *count_out) {
+  if (events == NULL || count_out == NULL) {
+    LOG_ERROR("comm_read_keypad_events: NULL pointer");
+    return HAMPOD_ERROR;
+  }
+  *count_out = 0;
+
+  CommPacket request = {
+      .type = PACKET_KEYPAD, .data_len = 1, .data = {COMM_KEYPAD_DRAIN}};
+  if (pending_register(PACKET_KEYPAD, &request.tag) != HAMPOD_OK) {
+    LOG_ERROR("comm_read_keypad_events: Too many requests in flight");
+    return HAMPOD_ERROR;
+  }
+
+  if (comm_send_packet(&request) != HAMPOD_OK) {
+    comm_cancel_response(request.tag);
+    return HAMPOD_ERROR;
+  }
+
+  CommPacket response;
+  int result = comm_wait_response(request.tag, &response,
+                                  COMM_KEYPAD_TIMEOUT_MS);
+  if (result != HAMPOD_OK) {
+    if (result == HAMPOD_TIMEOUT) {
+      comm_cancel_response(request.tag);
+    }
+    return result;
+  }
+
+  // Older Firmware answers 'e' with a single key byte
+  if (response.data_len < 1 || response.data[0] != COMM_KEYPAD_DRAIN_ACK) {
+    return HAMPOD_NOT_FOUND;
+  }
+
+  int count = (response.data_len - 1) / COMM_KEYPAD_EVENT_LEN;
+  if (count > COMM_KEYPAD_DRAIN_MAX) {
+    count = COMM_KEYPAD_DRAIN_MAX;
+  }
+  for (int i = 0; i < count; i++) {
+    const unsigned char *record =
+        &response.data[1 + i * COMM_KEYPAD_EVENT_LEN];
+    events[i].key = (char)record[0];
+    events[i].action = record[1];
+    memcpy(&events[i].timestamp_us, &record[2], sizeof(uint64_t));
+  }
+  *count_out = count;
+  return HAMPOD_OK;
+}
+
 // ============================================================================
 // Writing to Firmware
 // ============================================================================
@@ -472,52 +1021,141 @@ int comm_send_packet(const CommPacket *packet) {
   LOG_DEBUG("comm_send_packet: type=%d, len=%u, tag=%u", packet->type,
             packet->data_len, packet->tag);
 
-  // Write packet header fields (matching Firmware's read order)
-  // 1. Packet_type
-  ssize_t n = write(fd_firmware_in, &packet->type, sizeof(PacketType));
-  if (n != sizeof(PacketType)) {
-    LOG_ERROR("comm_send_packet: Failed to write type");
-    return HAMPOD_ERROR;
+  // Keypad and audio requests take their direct channel when there is one
+  int fd = fd_firmware_in;
+  if (packet->type == PACKET_KEYPAD && keypad_link.tx_fd != -1) {
+    fd = keypad_link.tx_fd;
+  } else if (packet->type == PACKET_AUDIO && audio_link.tx_fd != -1) {
+    fd = audio_link.tx_fd;
   }
 
-  // 2. data_len
-  n = write(fd_firmware_in, &packet->data_len, sizeof(unsigned short));
-  if (n != sizeof(unsigned short)) {
-    LOG_ERROR("comm_send_packet: Failed to write data_len");
+  // Whole frame in a single writev() so it lands atomically on the pipe
+  if (frame_write_flags(fd, packet->type, packet->flags, packet->tag,
+                        packet->data, packet->data_len) != 0) {
+    LOG_ERROR("comm_send_packet: Failed to write frame: %s", strerror(errno));
     return HAMPOD_ERROR;
   }
 
-  // 3. tag
-  n = write(fd_firmware_in, &packet->tag, sizeof(unsigned short));
-  if (n != sizeof(unsigned short)) {
-    LOG_ERROR("comm_send_packet: Failed to write tag");
-    return HAMPOD_ERROR;
+  return HAMPOD_OK;
+}
+
+// Length of the next fragment of text: the last sentence end in the
+// window if it is past halfway, else the last space, else the whole window
+static size_t fragment_length(const char *text, size_t len, size_t window) {
+  if (len <= window) {
+    return len;
   }
 
-  // 4. data
-  if (packet->data_len > 0) {
-    n = write(fd_firmware_in, packet->data, packet->data_len);
-    if (n != packet->data_len) {
-      LOG_ERROR("comm_send_packet: Failed to write data");
+  size_t space = 0;
+  for (size_t i = window; i > 0; i--) {
+    if (text[i] != ' ') {
+      continue;
+    }
+    char prev = text[i - 1];
+    if (prev == '.' || prev == ',' || prev == '?' || prev == '!') {
+      if (i > window / 2) {
+        return i;
+      }
+    }
+    if (space == 0) {
+      space = i;
+    }
+  }
+  return space > 0 ? space : window;
+}
+
+// Speech epoch to stamp on an audio request. Every interrupt starts the
+// next one, so Firmware can tell speech queued after the interrupt (which
+// it must play) from speech the interrupt cut off, without an ack round
+// trip. Stays 0 (unstamped) until the first interrupt.
+static unsigned char audio_request_epoch(char audio_type) {
+  pthread_mutex_lock(&pending_mutex);
+  if (audio_type == AUDIO_TYPE_INTERRUPT) {
+    audio_epoch = (unsigned char)(audio_epoch % FRAME_EPOCH_MAX + 1);
+  }
+  unsigned char epoch = audio_epoch;
+  pthread_mutex_unlock(&pending_mutex);
+  return epoch;
+}
+
+// Send TTS text too long for one packet as several "d<text>" fragments
+// sharing one tag; all but the last carry FRAME_FLAG_MORE
+static int send_audio_fragments(char audio_type, const char *payload,
+                                size_t payload_len, unsigned short tag,
+                                unsigned char epoch) {
+  const size_t window = COMM_MAX_DATA_LEN - 2; // Type byte + terminator
+  int fragments = 0;
+
+  while (payload_len > 0) {
+    size_t len = fragment_length(payload, payload_len, window);
+
+    CommPacket packet = {.type = PACKET_AUDIO,
+                         .data_len = (unsigned short)(len + 2),
+                         .tag = tag,
+                         .flags = FRAME_FLAGS_EPOCH(epoch)};
+    packet.data[0] = (unsigned char)audio_type;
+    memcpy(packet.data + 1, payload, len);
+    packet.data[len + 1] = '\0';
+
+    // Skip the space we split on
+    payload += len;
+    payload_len -= len;
+    while (payload_len > 0 && *payload == ' ') {
+      payload++;
+      payload_len--;
+    }
+    if (payload_len > 0) {
+      packet.flags |= FRAME_FLAG_MORE;
+    }
+
+    if (comm_send_packet(&packet) != HAMPOD_OK) {
       return HAMPOD_ERROR;
     }
+    fragments++;
   }
 
+  LOG_DEBUG("comm_send_audio: type='%c' sent as %d fragments, tag=%u",
+            audio_type, fragments, tag);
   return HAMPOD_OK;
 }
 
-int comm_send_audio(char audio_type, const char *payload) {
+// Send one audio request carrying the given tag
+static int send_audio_tagged(char audio_type, const char *payload,
+                             unsigned short tag) {
   if (payload == NULL) {
     LOG_ERROR("comm_send_audio: NULL payload");
     return HAMPOD_ERROR;
   }
 
+  unsigned char epoch = audio_request_epoch(audio_type);
+  if (audio_ring != NULL) {
+    if (audio_type == AUDIO_TYPE_TTS || audio_type == AUDIO_TYPE_FILE ||
+        audio_type == AUDIO_TYPE_SEQUENCE) {
+      // Speak/play requests go straight into shared memory; the ack still
+      // comes back through the router with this tag
+      if (shm_ring_push(audio_ring, audio_type, tag, epoch, payload) == 0) {
+        LOG_DEBUG("comm_send_audio: type='%c', payload='%s' via ring, tag=%u",
+                  audio_type, payload, tag);
+        return HAMPOD_OK;
+      }
+      LOG_DEBUG("comm_send_audio: ring full or text too long, using pipe");
+    } else if (audio_type == AUDIO_TYPE_INTERRUPT) {
+      // Drop ring requests the Firmware has not started yet, like the
+      // interrupt clears its Speaker_i queue
+      shm_ring_discard(audio_ring);
+    }
+  }
+
   // Build audio packet: first byte is type, rest is payload + null terminator
   // Format: <type><payload>\0
   // Example: "dHello World\0" for TTS
   size_t payload_len = strlen(payload);
 
   // +1 for audio_type byte, +1 for payload, +1 for null terminator
+  if (payload_len + 2 > COMM_MAX_DATA_LEN && audio_type == AUDIO_TYPE_TTS &&
+      payload_len <= COMM_MAX_TEXT_LEN) {
+    return send_audio_fragments(audio_type, payload, payload_len, tag, epoch);
+  }
   if (payload_len + 2 > COMM_MAX_DATA_LEN) {
     LOG_ERROR("comm_send_audio: Payload too long (%zu bytes)", payload_len);
     return HAMPOD_ERROR;
@@ -526,7 +1164,8 @@ int comm_send_audio(char audio_type, const char *payload) {
   CommPacket packet = {
       .type = PACKET_AUDIO,
       .data_len = (unsigned short)(payload_len + 2), // +1 for type, +1 for null
-      .tag = packet_tag++};
+      .tag = tag,
+      .flags = FRAME_FLAGS_EPOCH(epoch)};
 
   // First byte is audio type, then payload, then null terminator
   packet.data[0] = (unsigned char)audio_type;
@@ -539,6 +1178,52 @@ int comm_send_audio(char audio_type, const char *payload) {
   return comm_send_packet(&packet);
 }
 
+int comm_send_audio(char audio_type, const char *payload) {
+  return send_audio_tagged(audio_type, payload, next_packet_tag());
+}
+
+int comm_send_audio_request(char audio_type, const char *payload,
+                            unsigned short *tag_out) {
+  if (tag_out == NULL) {
+    LOG_ERROR("comm_send_audio_request: NULL tag_out pointer");
+    return HAMPOD_ERROR;
+  }
+  if (pending_register(PACKET_AUDIO, tag_out) != HAMPOD_OK) {
+    LOG_ERROR("comm_send_audio_request: Too many requests in flight");
+    return HAMPOD_ERROR;
+  }
+
+  if (send_audio_tagged(audio_type, payload, *tag_out) != HAMPOD_OK) {
+    comm_cancel_response(*tag_out);
+    return HAMPOD_ERROR;
+  }
+  return HAMPOD_OK;
+}
+
+// Send an audio request whose ack nobody waits for. It takes no pending
+// slot, however many are in use; the router drops the ack.
+static int send_audio_no_reply(char audio_type, const char *payload) {
+  return send_audio_tagged(audio_type, payload, COMM_NO_REPLY_TAG);
+}
+
+int comm_interrupt_audio(void) {
+  return send_audio_no_reply(AUDIO_TYPE_INTERRUPT, "");
+}
+
+int comm_wait_played(int timeout_ms) {
+  unsigned short tag;
+  if (comm_send_audio_request(AUDIO_TYPE_PLAYED, "", &tag) != HAMPOD_OK) {
+    return HAMPOD_ERROR;
+  }
+  int result = comm_wait_response(
+      tag, NULL, timeout_ms < 0 ? COMM_AUDIO_TIMEOUT_MS : timeout_ms);
+  if (result == HAMPOD_TIMEOUT) {
+    comm_cancel_response(tag);
+    return HAMPOD_TIMEOUT;
+  }
+  return result == HAMPOD_OK ? HAMPOD_OK : HAMPOD_ERROR;
+}
+
 int comm_send_audio_sync(char audio_type, const char *payload) {
   // Send the audio request
   if (comm_send_audio(audio_type, payload) != HAMPOD_OK) {
@@ -597,26 +1282,110 @@ int comm_play_beep(CommBeepType beep_type) {
   LOG_DEBUG("comm_play_beep: Sending beep type='%c'", beep_char);
 
   // Send beep request (non-blocking - don't wait for ack)
-  return comm_send_audio('b', payload);
+  return send_audio_no_reply('b', payload);
 }
 
-int comm_set_speech_speed(float speed) {
+int comm_set_beep_tone(CommBeepType beep_type, const char *spec) {
+  static const char beep_chars[] = {'k', 'h', 'e'};
+  if (beep_type < COMM_BEEP_KEYPRESS || beep_type > COMM_BEEP_ERROR) {
+    LOG_ERROR("comm_set_beep_tone: Unknown beep type %d", beep_type);
+    return HAMPOD_ERROR;
+  }
+
+  // Protocol: 'c' + beep_type_char + spec ("ck1000/50/50", "ck" = default)
+  char payload[64];
+  snprintf(payload, sizeof(payload), "%c%s", beep_chars[beep_type],
+           spec != NULL ? spec : "");
+
+  unsigned short tag;
+  if (comm_send_audio_request(AUDIO_TYPE_BEEP_TONE, payload, &tag) !=
+      HAMPOD_OK) {
+    return HAMPOD_ERROR;
+  }
+  CommPacket response;
+  int result = comm_wait_response(tag, &response, 500);
+  if (result == HAMPOD_TIMEOUT) {
+    comm_cancel_response(tag);
+  }
+  if (result != HAMPOD_OK || response.data_len < sizeof(int)) {
+    LOG_ERROR("comm_set_beep_tone: No answer from Firmware");
+    return HAMPOD_ERROR;
+  }
+  int applied;
+  memcpy(&applied, response.data, sizeof(int));
+  if (applied != 0) {
+    LOG_ERROR("comm_set_beep_tone: Firmware refused '%s'", payload);
+    return HAMPOD_ERROR;
+  }
+  return HAMPOD_OK;
+}
+
+int comm_play_tone(const char *spec) {
+  if (spec == NULL) {
+    LOG_ERROR("comm_play_tone: NULL spec");
+    return HAMPOD_ERROR;
+  }
+  return send_audio_no_reply(AUDIO_TYPE_TONE, spec);
+}
+
+int comm_play_echo(const char *clip) {
+  if (clip == NULL) {
+    LOG_ERROR("comm_play_echo: NULL clip");
+    return HAMPOD_ERROR;
+  }
+  return send_audio_no_reply(AUDIO_TYPE_ECHO, clip);
+}
+
+int comm_warm_words(const char *words) {
+  if (words == NULL) {
+    LOG_ERROR("comm_warm_words: NULL words");
+    return HAMPOD_ERROR;
+  }
+  return send_audio_no_reply(AUDIO_TYPE_WARM, words);
+}
+
+int comm_set_tone(int hz) {
   /*
-   * Sends a speed setting to Firmware using the 's' audio type.
-   * Protocol: 's' + speed_string (e.g. "s1.0" or "s0.8")
+   * Sends a tuning tone pitch to Firmware using the 't' audio type.
+   * Protocol: 't' + hz_string (e.g. "t880", "t0" for off). Sent many
+   * times a second, so it is not logged.
    */
   char payload[16];
-  snprintf(payload, sizeof(payload), "%.2f", speed);
+  snprintf(payload, sizeof(payload), "%d", hz);
 
-  LOG_INFO("comm_set_speech_speed: Setting speed to %s", payload);
-
-  return comm_send_audio('s', payload);
+  return send_audio_no_reply('t', payload);
 }
 
 // ============================================================================
 // Audio Device Query
 // ============================================================================
 
+// Send a query of the given audio type and copy up to max ints of the
+// reply into out. Returns the number of ints received, -1 if no reply came
+// or -2 if the query could not be sent.
+static int query_audio(char type, int *out, int max) {
+  unsigned short tag;
+  if (comm_send_audio_request(type, "", &tag) != HAMPOD_OK) {
+    return -2;
+  }
+
+  // Wait for the response to this query (not some other audio ack)
+  CommPacket response;
+  int result = comm_wait_response(tag, &response, 5000);
+  if (result == HAMPOD_TIMEOUT) {
+    comm_cancel_response(tag);
+  }
+  if (result != HAMPOD_OK || response.data_len < sizeof(int)) {
+    return -1;
+  }
+  int count = response.data_len / sizeof(int);
+  if (count > max) {
+    count = max;
+  }
+  memcpy(out, response.data, count * sizeof(int));
+  return count;
+}
+
 int comm_query_audio_card_number(int *card_number_out) {
   if (card_number_out == NULL) {
     LOG_ERROR("comm_query_audio_card_number: NULL output pointer");
@@ -626,21 +1395,16 @@ int comm_query_audio_card_number(int *card_number_out) {
   // Send audio info query (non-blocking)
   LOG_DEBUG("comm_query_audio_card_number: Querying Firmware...");
 
-  if (comm_send_audio(AUDIO_TYPE_INFO, "") != HAMPOD_OK) {
+  int received = query_audio(AUDIO_TYPE_INFO, card_number_out, 1);
+  if (received == -2) {
     LOG_ERROR("comm_query_audio_card_number: Send failed");
     *card_number_out = 2; // Fallback
     return HAMPOD_ERROR;
   }
-
-  // Wait for response from router
-  CommPacket response;
-  if (comm_wait_audio_response(&response, 5000) == HAMPOD_OK) {
-    if (response.data_len >= sizeof(int)) {
-      *card_number_out = *(int *)response.data;
-      LOG_DEBUG("comm_query_audio_card_number: Got card number %d",
-                *card_number_out);
-      return HAMPOD_OK;
-    }
+  if (received == 1) {
+    LOG_DEBUG("comm_query_audio_card_number: Got card number %d",
+              *card_number_out);
+    return HAMPOD_OK;
   }
 
   // Fallback - use a reasonable default
@@ -649,13 +1413,107 @@ int comm_query_audio_card_number(int *card_number_out) {
   return HAMPOD_OK;
 }
 
+int comm_query_audio_stats(CommAudioStats *stats_out) {
+  if (stats_out == NULL) {
+    LOG_ERROR("comm_query_audio_stats: NULL output pointer");
+    return HAMPOD_ERROR;
+  }
+
+  int reply[COMM_AUDIO_INFO_INTS];
+  if (query_audio(AUDIO_TYPE_INFO, reply, COMM_AUDIO_INFO_INTS) !=
+      COMM_AUDIO_INFO_INTS) {
+    LOG_ERROR("comm_query_audio_stats: Firmware sent no statistics");
+    return HAMPOD_ERROR;
+  }
+  stats_out->underruns = reply[1];
+  stats_out->buffer_ms = reply[2];
+  stats_out->min_fill_ms = reply[3];
+  stats_out->resizes = reply[4];
+  return HAMPOD_OK;
+}
+
+int comm_query_tts_stats(CommTtsStats *stats_out) {
+  if (stats_out == NULL) {
+    LOG_ERROR("comm_query_tts_stats: NULL output pointer");
+    return HAMPOD_ERROR;
+  }
+
+  int reply[COMM_TTS_STATS_INTS];
+  if (query_audio(AUDIO_TYPE_TTS_STATS, reply, COMM_TTS_STATS_INTS) !=
+      COMM_TTS_STATS_INTS) {
+    LOG_ERROR("comm_query_tts_stats: Firmware sent no statistics");
+    return HAMPOD_ERROR;
+  }
+  // reply[0] is the ack value; the counters follow in CommTtsStats order
+  memcpy(stats_out, reply + 1, sizeof(*stats_out));
+  return HAMPOD_OK;
+}
+
+int comm_cw_decoder(bool on) {
+  unsigned short tag;
+  if (comm_send_audio_request(AUDIO_TYPE_CW, on ? "1" : "0", &tag) !=
+      HAMPOD_OK) {
+    return HAMPOD_ERROR;
+  }
+  CommPacket response;
+  int result = comm_wait_response(tag, &response, 2000);
+  if (result == HAMPOD_TIMEOUT) {
+    comm_cancel_response(tag);
+  }
+  if (result != HAMPOD_OK || response.data_len < sizeof(int)) {
+    LOG_ERROR("comm_cw_decoder: No answer from Firmware");
+    return HAMPOD_ERROR;
+  }
+  int started;
+  memcpy(&started, response.data, sizeof(int));
+  return started == 0 ? HAMPOD_OK : HAMPOD_ERROR;
+}
+
+int comm_read_cw(char *text, size_t size, int *wpm, int *pitch_hz) {
+  if (text == NULL || size == 0) {
+    LOG_ERROR("comm_read_cw: No room for the text");
+    return HAMPOD_ERROR;
+  }
+  text[0] = '\0';
+
+  unsigned short tag;
+  if (comm_send_audio_request(AUDIO_TYPE_CW, "", &tag) != HAMPOD_OK) {
+    return HAMPOD_ERROR;
+  }
+  CommPacket response;
+  int result = comm_wait_response(tag, &response, 2000);
+  if (result == HAMPOD_TIMEOUT) {
+    comm_cancel_response(tag);
+  }
+  int status[COMM_CW_REPLY_INTS];
+  if (result != HAMPOD_OK || response.data_len < sizeof(status)) {
+    return HAMPOD_ERROR;
+  }
+  memcpy(status, response.data, sizeof(status));
+  if (wpm != NULL) {
+    *wpm = status[1];
+  }
+  if (pitch_hz != NULL) {
+    *pitch_hz = status[2];
+  }
+
+  // The text after the ints, NUL-terminated by Firmware; not trusted to be
+  size_t len = response.data_len - sizeof(status);
+  if (len >= size) {
+    len = size - 1;
+  }
+  memcpy(text, response.data + sizeof(status), len);
+  text[len] = '\0';
+  return status[0] == 0 ? HAMPOD_OK : HAMPOD_ERROR;
+}
+
 // ============================================================================
 // Configuration Pass-through to Firmware
 // ============================================================================
 
 int comm_send_config_packet(uint8_t sub_cmd, uint8_t value) {
   CommPacket packet = {
-      .type = PACKET_CONFIG, .data_len = 2, .tag = packet_tag++};
+      .type = PACKET_CONFIG, .data_len = 2, .tag = next_packet_tag()};
 
   packet.data[0] = sub_cmd;
   packet.data[1] = value;
@@ -664,3 +1522,143 @@ int comm_send_config_packet(uint8_t sub_cmd, uint8_t value) {
             value);
   return comm_send_packet(&packet);
 }
+
+// Send a CONFIG sub-command that Firmware answers with the sub-command and
+// the value now in effect
+static int config_request(uint8_t sub_cmd, uint8_t value, uint8_t *applied) {
+  CommPacket request = {
+      .type = PACKET_CONFIG, .data_len = 2, .data = {sub_cmd, value}};
+  if (pending_register(PACKET_CONFIG, &request.tag) != HAMPOD_OK) {
+    return HAMPOD_ERROR;
+  }
+
+  if (comm_send_packet(&request) != HAMPOD_OK) {
+    comm_cancel_response(request.tag);
+    return HAMPOD_ERROR;
+  }
+
+  // Older Firmware drops unknown CONFIG sub-commands without answering
+  CommPacket response;
+  int result = comm_wait_response(request.tag, &response, 500);
+  if (result != HAMPOD_OK) {
+    if (result == HAMPOD_TIMEOUT) {
+      comm_cancel_response(request.tag);
+    }
+    return result;
+  }
+
+  if (response.data_len < 2 || response.data[0] != sub_cmd) {
+    return HAMPOD_ERROR;
+  }
+  *applied = response.data[1];
+  return HAMPOD_OK;
+}
+
+int comm_set_local_key_beep(bool enable) {
+  uint8_t applied;
+  int result =
+      config_request(COMM_CONFIG_LOCAL_KEY_BEEP, enable ? 1 : 0, &applied);
+  if (result != HAMPOD_OK) {
+    return result;
+  }
+  if (applied != (enable ? 1 : 0)) {
+    return HAMPOD_ERROR;
+  }
+  LOG_INFO("Firmware key beep %s", enable ? "enabled" : "disabled");
+  return HAMPOD_OK;
+}
+
+int comm_set_volume(int percent) {
+  if (percent < 0) {
+    percent = 0;
+  } else if (percent > 100) {
+    percent = 100;
+  }
+
+  uint8_t applied;
+  int result = config_request(COMM_CONFIG_AUDIO_VOLUME, (uint8_t)percent,
+                              &applied);
+  if (result != HAMPOD_OK) {
+    LOG_ERROR("comm_set_volume: Firmware did not apply volume %d%%",
+              percent);
+    return result;
+  }
+  LOG_DEBUG("comm_set_volume: Volume %d%%", applied);
+  return HAMPOD_OK;
+}
+
+int comm_set_speech_speed(float speed) {
+  int hundredths = (int)(speed * 100.0f + 0.5f);
+  if (hundredths < 10) {
+    hundredths = 10;
+  } else if (hundredths > 200) {
+    hundredths = 200;
+  }
+
+  LOG_INFO("comm_set_speech_speed: Setting speed to %.2f", hundredths / 100.0);
+  uint8_t applied;
+  int result =
+      config_request(COMM_CONFIG_AUDIO_SPEED, (uint8_t)hundredths, &applied);
+  if (result == HAMPOD_OK && applied != hundredths) {
+    result = HAMPOD_ERROR;
+  }
+  if (result != HAMPOD_OK) {
+    LOG_ERROR("comm_set_speech_speed: Firmware did not apply speed %.2f",
+              hundredths / 100.0);
+  }
+  return result;
+}
+
+int comm_set_tts_ram(int megabytes) {
+  if (megabytes < 0) {
+    megabytes = 0;
+  } else if (megabytes > 255) {
+    megabytes = 255;
+  }
+
+  uint8_t applied;
+  int result =
+      config_request(COMM_CONFIG_AUDIO_TTS_RAM, (uint8_t)megabytes, &applied);
+  if (result != HAMPOD_OK) {
+    LOG_ERROR("comm_set_tts_ram: Firmware did not apply %dMB", megabytes);
+    return result;
+  }
+  LOG_DEBUG("comm_set_tts_ram: TTS cache RAM %dMB", applied);
+  return HAMPOD_OK;
+}
+
+int comm_set_audio_priority(int priority) {
+  if (priority < 0) {
+    priority = 0;
+  } else if (priority > 99) {
+    priority = 99;
+  }
+
+  uint8_t applied;
+  int result = config_request(COMM_CONFIG_AUDIO_PRIORITY, (uint8_t)priority,
+                              &applied);
+  if (result == HAMPOD_OK && applied != priority) {
+    result = HAMPOD_ERROR; // Firmware lacks the privilege
+  }
+  if (result != HAMPOD_OK) {
+    LOG_ERROR("comm_set_audio_priority: Firmware did not apply priority %d",
+              priority);
+  }
+  return result;
+}
+
+int comm_set_session_priority(int priority) {
+  if (priority < COMM_SESSION_PRIORITY_LOW) {
+    priority = COMM_SESSION_PRIORITY_LOW;
+  } else if (priority > COMM_SESSION_PRIORITY_MAIN) {
+    priority = COMM_SESSION_PRIORITY_MAIN;
+  }
+
+  uint8_t applied;
+  int result = config_request(COMM_CONFIG_SESSION_PRIORITY, (uint8_t)priority,
+                              &applied);
+  if (result == HAMPOD_OK && applied != priority) {
+    result = HAMPOD_ERROR;
+  }
+  return result;
+}
@@ -4,38 +4,289 @@
  */
 
 #include "config.h"
+#include <errno.h>
+#include <limits.h>
 #include <pthread.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 // ============================================================================
 // Internal State
 // ============================================================================
 
-// Undo history buffer
+// Undo history. A step keeps only the old values of the fields its
+// setter changed, not a copy of the whole config.
+#define UNDO_STEP_FIELDS MAX_RADIOS // Most fields one setter changes
+#define UNDO_STEP_BYTES 256         // Room for their old values
+
+typedef struct {
+  unsigned short offset[UNDO_STEP_FIELDS]; // Into HampodConfig
+  unsigned short size[UNDO_STEP_FIELDS];
+  unsigned char old[UNDO_STEP_BYTES]; // Old values, back to back
+  int fields;
+  int bytes;
+  long long changed_ms; // Last change made in this step
+} ConfigStep;
+
 typedef struct {
-  HampodConfig snapshots[CONFIG_UNDO_DEPTH];
+  ConfigStep steps[CONFIG_UNDO_DEPTH];
   int head;  // Next write position
-  int count; // Number of valid snapshots (0 to CONFIG_UNDO_DEPTH)
+  int count; // Number of valid steps (0 to CONFIG_UNDO_DEPTH)
+  bool open; // Newest step is one field and may take more edits to it
 } ConfigHistory;
 
 // Global state
 static HampodConfig g_config;
+static HampodConfig g_saved; // The file as last loaded or written
 static ConfigHistory g_history;
 static char g_config_path[256];
 static pthread_mutex_t g_config_mutex = PTHREAD_MUTEX_INITIALIZER;
 static bool g_initialized = false;
 
+// Deferred saving: setters only mark the config dirty, and the writer
+// thread saves it once no setter has run for CONFIG_SAVE_DELAY_MS, and in
+// tmpfs mode no sooner than writeback_s after the last save
+static bool g_dirty = false;        // Guarded by g_config_mutex
+static long long g_changed_ms = 0;  // Guarded by g_config_mutex
+static long long g_written_ms = 0;  // Guarded by g_config_mutex
+static bool g_writer_stop = false;  // Guarded by g_config_mutex
+static bool g_writer_running = false;
+static pthread_t g_writer_thread;
+static pthread_cond_t g_writer_wake = PTHREAD_COND_INITIALIZER;
+
+// One write at a time (they share the temporary file); taken before
+// g_config_mutex
+static pthread_mutex_t g_write_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Published copies of g_config for the lock-free getters. Each change
+// fills the slot after the current one and then bumps g_version, so a
+// reader copies from slot g_version % CONFIG_SNAPSHOTS and only retries
+// if the writers have come all the way round to that slot meanwhile.
+#define CONFIG_SNAPSHOTS 8
+static HampodConfig g_snapshots[CONFIG_SNAPSHOTS];
+static unsigned g_version = 0; // Written with g_config_mutex held
+
+// The settings in the file, one row each. Parsing, range checks, the
+// defaults, writing and config_reload() all go by this table, so a new
+// setting is its field in config.h and a row here. [voices] and
+// [profiles] are free-form lists, read and written by hand.
+typedef enum {
+  FIELD_INT,    // int, from min to max
+  FIELD_BOOL,   // bool: 1/0, true/false, yes/no or on/off
+  FIELD_FLOAT,  // float, from min to max, written with 2 decimals
+  FIELD_STRING, // char[size]; a longer value is refused, not cut short
+} FieldType;
+
+#define FIELD_SPARSE 0x1    // Written only when not its default
+#define FIELD_PER_RADIO 0x2 // In each [radio.N], offset into RadioSettings
+#define FIELD_LEGACY 0x4    // Read but never written (the old [radio])
+
+typedef struct {
+  const char *section;
+  const char *key;
+  FieldType type;
+  unsigned short offset; // Into HampodConfig, or RadioSettings
+  unsigned short size;
+  double min, max;      // FIELD_INT and FIELD_FLOAT
+  double def;           // Default, but for FIELD_STRING
+  const char *def_text; // FIELD_STRING default, NULL for ""
+  unsigned live;        // ConfigChange bit, 0 if only read at startup
+  unsigned flags;
+} ConfigField;
+
+#define AT(field)                                                              \
+  offsetof(HampodConfig, field), sizeof(((HampodConfig *)0)->field)
+#define RADIO_AT(field)                                                        \
+  offsetof(RadioSettings, field), sizeof(((RadioSettings *)0)->field)
+
+#define INT_FIELD(section, key, at, range, def, live, flags)                   \
+  {section, key, FIELD_INT, at, range, def, NULL, live, flags}
+#define BOOL_FIELD(section, key, at, def, live, flags)                         \
+  {section, key, FIELD_BOOL, at, 0, 1, def, NULL, live, flags}
+#define FLOAT_FIELD(section, key, at, range, def, live)                        \
+  {section, key, FIELD_FLOAT, at, range, def, NULL, live, 0}
+#define STRING_FIELD(section, key, at, def, live, flags)                       \
+  {section, key, FIELD_STRING, at, 0, 0, 0, def, live, flags}
+
+#define RANGE(min, max) min, max
+#define ANY RANGE(INT_MIN, INT_MAX)
+#define NATURAL RANGE(0, INT_MAX)  // Zero or more
+#define POSITIVE RANGE(1, INT_MAX) // One or more
+
+// Sections are written in this order; a section's rows stay together.
+// Radio 1's defaults are set by hand in config_set_defaults().
+static const ConfigField g_fields[] = {
+    BOOL_FIELD("radio.N", "enabled", RADIO_AT(enabled), 0, 0,
+               FIELD_PER_RADIO),
+    STRING_FIELD("radio.N", "name", RADIO_AT(name), NULL, 0, FIELD_PER_RADIO),
+    INT_FIELD("radio.N", "model", RADIO_AT(model), NATURAL, 0, 0,
+              FIELD_PER_RADIO),
+    STRING_FIELD("radio.N", "device", RADIO_AT(device), NULL, 0,
+                 FIELD_PER_RADIO),
+    INT_FIELD("radio.N", "baud", RADIO_AT(baud), NATURAL, 0, 0,
+              FIELD_PER_RADIO),
+    STRING_FIELD("radio.N", "port", RADIO_AT(port), NULL, 0, FIELD_PER_RADIO),
+    INT_FIELD("radio.N", "detected_model", RADIO_AT(detected_model), NATURAL,
+              0, 0, FIELD_PER_RADIO),
+    // Poll limits are only written once tuned for this radio
+    INT_FIELD("radio.N", "poll_fast_ms", RADIO_AT(poll_fast_ms), NATURAL, 0,
+              0, FIELD_PER_RADIO | FIELD_SPARSE),
+    INT_FIELD("radio.N", "poll_idle_ms", RADIO_AT(poll_idle_ms), NATURAL, 0,
+              0, FIELD_PER_RADIO | FIELD_SPARSE),
+    STRING_FIELD("radio.N", "rigctld", RADIO_AT(rigctld), NULL, 0,
+                 FIELD_PER_RADIO | FIELD_SPARSE),
+    BOOL_FIELD("radio.N", "standby", RADIO_AT(standby), 0, 0,
+               FIELD_PER_RADIO | FIELD_SPARSE),
+    BOOL_FIELD("radio.N", "native_cat", RADIO_AT(native_cat), 0, 0,
+               FIELD_PER_RADIO | FIELD_SPARSE),
+
+    INT_FIELD("radio", "model", AT(radios[0].model), NATURAL, 0, 0,
+              FIELD_LEGACY),
+    STRING_FIELD("radio", "device", AT(radios[0].device), NULL, 0,
+                 FIELD_LEGACY),
+    INT_FIELD("radio", "baud", AT(radios[0].baud), NATURAL, 0, 0,
+              FIELD_LEGACY),
+
+    STRING_FIELD("audio", "preferred_device", AT(audio.preferred_device),
+                 "USB2.0 Device", 0, 0),
+    STRING_FIELD("audio", "device_name", AT(audio.device_name), NULL, 0, 0),
+    STRING_FIELD("audio", "port", AT(audio.port), NULL, 0, 0),
+    INT_FIELD("audio", "card_number", AT(audio.card_number),
+              RANGE(-1, INT_MAX), -1, 0, 0),
+    INT_FIELD("audio", "volume", AT(audio.volume), RANGE(0, 100),
+              CONFIG_DEFAULT_VOLUME, CONFIG_CHANGED_VOLUME, 0),
+    FLOAT_FIELD("audio", "speech_speed", AT(audio.speech_speed),
+                RANGE(0.1, 2.0), CONFIG_DEFAULT_SPEECH_SPEED,
+                CONFIG_CHANGED_SPEECH_SPEED),
+    BOOL_FIELD("audio", "key_beep", AT(audio.key_beep_enabled),
+               CONFIG_DEFAULT_KEY_BEEP, CONFIG_CHANGED_BEEP, 0),
+    BOOL_FIELD("audio", "firmware_beep", AT(audio.firmware_beep_enabled),
+               CONFIG_DEFAULT_FIRMWARE_BEEP, CONFIG_CHANGED_BEEP, 0),
+    BOOL_FIELD("audio", "terse", AT(audio.terse), CONFIG_DEFAULT_TERSE,
+               CONFIG_CHANGED_VERBOSITY, 0),
+    INT_FIELD("audio", "tts_ram_mb", AT(audio.tts_ram_mb), RANGE(0, 255),
+              CONFIG_DEFAULT_TTS_RAM_MB, CONFIG_CHANGED_TTS_RAM, 0),
+    STRING_FIELD("audio", "beep_keypress", AT(audio.beep_tone[0]), NULL,
+                 CONFIG_CHANGED_BEEP_TONE, 0),
+    STRING_FIELD("audio", "beep_hold", AT(audio.beep_tone[1]), NULL,
+                 CONFIG_CHANGED_BEEP_TONE, 0),
+    STRING_FIELD("audio", "beep_error", AT(audio.beep_tone[2]), NULL,
+                 CONFIG_CHANGED_BEEP_TONE, 0),
+    BOOL_FIELD("audio", "spell_phonetic", AT(audio.spell_phonetic), 0,
+               CONFIG_CHANGED_SPELL, 0),
+    INT_FIELD("audio", "spell_gap_ms", AT(audio.spell_gap_ms), NATURAL,
+              CONFIG_DEFAULT_SPELL_GAP_MS, CONFIG_CHANGED_SPELL, 0),
+    STRING_FIELD("audio", "alert_voice", AT(audio.alert_voice), NULL,
+                 CONFIG_CHANGED_VOICE, 0),
+    BOOL_FIELD("audio", "frequency_diff", AT(audio.frequency_diff), 0,
+               CONFIG_CHANGED_VERBOSITY, 0),
+
+    STRING_FIELD("keypad", "layout", AT(keypad.layout), "calculator",
+                 CONFIG_CHANGED_LAYOUT, 0),
+    STRING_FIELD("keypad", "port", AT(keypad.port), NULL, 0, 0),
+    STRING_FIELD("keypad", "device_name", AT(keypad.device_name), NULL, 0, 0),
+
+    // SCHED_FIFO priorities run from 1 to 99
+    INT_FIELD("scheduling", "audio_priority", AT(scheduling.audio_priority),
+              RANGE(0, 99), 0, CONFIG_CHANGED_SCHEDULING, 0),
+    INT_FIELD("scheduling", "keypad_priority", AT(scheduling.keypad_priority),
+              RANGE(0, 99), 0, CONFIG_CHANGED_SCHEDULING, 0),
+    STRING_FIELD("scheduling", "io_cpus", AT(scheduling.io_cpus), NULL, 0, 0),
+    STRING_FIELD("scheduling", "tts_cpus", AT(scheduling.tts_cpus), NULL, 0,
+                 0),
+    STRING_FIELD("scheduling", "voice_cpus", AT(scheduling.voice_cpus), NULL,
+                 0, 0),
+    BOOL_FIELD("scheduling", "mlock", AT(scheduling.mlock), 0, 0, 0),
+    STRING_FIELD("scheduling", "memory_profile", AT(scheduling.memory_profile),
+                 "normal", 0, 0),
+    BOOL_FIELD("scheduling", "idle_mode", AT(scheduling.idle_mode), 0, 0, 0),
+    BOOL_FIELD("scheduling", "event_loop", AT(scheduling.event_loop), 0, 0,
+               0),
+    INT_FIELD("scheduling", "watchdog_ms", AT(scheduling.watchdog_ms), NATURAL,
+              CONFIG_DEFAULT_WATCHDOG_MS, 0, 0),
+    INT_FIELD("scheduling", "cpu_boost_ms", AT(scheduling.cpu_boost_ms),
+              NATURAL, 0, 0, 0),
+    STRING_FIELD("scheduling", "cpu_idle_governor",
+                 AT(scheduling.cpu_idle_governor),
+                 CONFIG_DEFAULT_CPU_IDLE_GOVERNOR, 0, 0),
+
+    INT_FIELD("scan", "step_hz", AT(scan.step_hz), POSITIVE,
+              CONFIG_DEFAULT_SCAN_STEP_HZ, CONFIG_CHANGED_SCAN, 0),
+    INT_FIELD("scan", "dwell_ms", AT(scan.dwell_ms), NATURAL,
+              CONFIG_DEFAULT_SCAN_DWELL_MS, CONFIG_CHANGED_SCAN, 0),
+    INT_FIELD("scan", "threshold_db", AT(scan.threshold_db), ANY,
+              CONFIG_DEFAULT_SCAN_THRESHOLD_DB, CONFIG_CHANGED_SCAN, 0),
+
+    INT_FIELD("meters", "sample_ms", AT(meters.sample_ms), NATURAL,
+              CONFIG_DEFAULT_METER_SAMPLE_MS, CONFIG_CHANGED_METERS, 0),
+    INT_FIELD("meters", "window_ms", AT(meters.window_ms), POSITIVE,
+              CONFIG_DEFAULT_METER_WINDOW_MS, CONFIG_CHANGED_METERS, 0),
+    INT_FIELD("meters", "hold_ms", AT(meters.hold_ms), NATURAL,
+              CONFIG_DEFAULT_METER_HOLD_MS, CONFIG_CHANGED_METERS, 0),
+    INT_FIELD("meters", "view_s", AT(meters.view_s), POSITIVE,
+              CONFIG_DEFAULT_METER_VIEW_S, CONFIG_CHANGED_METERS, 0),
+
+    // Sections from here on are left out while nothing in them is set
+    STRING_FIELD("rotor", "name", AT(rotor.name), NULL, 0, FIELD_SPARSE),
+    INT_FIELD("rotor", "model", AT(rotor.model), NATURAL, 0, 0, FIELD_SPARSE),
+    STRING_FIELD("rotor", "device", AT(rotor.device), NULL, 0, FIELD_SPARSE),
+    INT_FIELD("rotor", "baud", AT(rotor.baud), NATURAL, 0, 0, FIELD_SPARSE),
+    INT_FIELD("rotor", "poll_fast_ms", AT(rotor.poll_fast_ms), NATURAL, 0, 0,
+              FIELD_SPARSE),
+    INT_FIELD("rotor", "poll_idle_ms", AT(rotor.poll_idle_ms), NATURAL, 0, 0,
+              FIELD_SPARSE),
+
+    STRING_FIELD("voice_input", "model", AT(voice_input.model), NULL, 0,
+                 FIELD_SPARSE),
+    STRING_FIELD("voice_input", "device", AT(voice_input.device), NULL, 0,
+                 FIELD_SPARSE),
+
+    STRING_FIELD("tts", "model", AT(tts.model), NULL, 0, FIELD_SPARSE),
+    STRING_FIELD("tts", "accelerator", AT(tts.accelerator), NULL, 0,
+                 FIELD_SPARSE),
+
+    STRING_FIELD("remote", "address", AT(remote.address), NULL, 0,
+                 FIELD_SPARSE),
+
+    BOOL_FIELD("storage", "tmpfs", AT(storage.tmpfs), 0, 0, FIELD_SPARSE),
+    INT_FIELD("storage", "writeback_s", AT(storage.writeback_s), NATURAL,
+              CONFIG_DEFAULT_WRITEBACK_S, 0, FIELD_SPARSE),
+
+    STRING_FIELD("api", "socket", AT(api.socket), NULL, 0, FIELD_SPARSE),
+};
+#define CONFIG_FIELD_COUNT (sizeof(g_fields) / sizeof(g_fields[0]))
+
+// Rows by "section.key", open addressed; built once
+#define FIELD_HASH_SIZE 256 // Power of two, well over CONFIG_FIELD_COUNT
+static unsigned char g_field_hash[FIELD_HASH_SIZE]; // Row + 1, 0 for empty
+static pthread_once_t g_field_hash_once = PTHREAD_ONCE_INIT;
+
+// Record a field's value before a setter changes it
+#define HISTORY_PUSH(field) history_push_field(&(field), sizeof(field))
+#define HISTORY_SAVE(field) history_save(&(field), sizeof(field))
+
 // ============================================================================
 // Internal Functions (forward declarations)
 // ============================================================================
 
-static void config_set_defaults(void);
-static void history_push(const HampodConfig *config);
-static int history_pop(HampodConfig *config);
-static int config_parse_file(const char *path);
-static int config_write_file(const char *path);
+static void config_set_defaults(HampodConfig *c);
+static void field_set_default(const ConfigField *f, void *field);
+static long long now_ms(void);
+static void history_begin(void);
+static void history_save(const void *field, size_t size);
+static void history_push_field(const void *field, size_t size);
+static int history_pop(void);
+static int config_parse_file(HampodConfig *c, const char *path);
+static int config_write_file(const HampodConfig *c, const char *path);
+static void publish_snapshot(void);
+static AudioSettings snapshot_audio(void);
+static void mark_dirty(void);
+static int flush_config(void);
+static void *writer_thread_func(void *arg);
 
 // ============================================================================
 // Core Functions
@@ -45,11 +296,12 @@ int config_init(const char *config_path) {
   pthread_mutex_lock(&g_config_mutex);
 
   // Set defaults first
-  config_set_defaults();
+  config_set_defaults(&g_config);
 
   // Clear history
   g_history.head = 0;
   g_history.count = 0;
+  g_history.open = false;
 
   // Store config path
   if (config_path) {
@@ -61,11 +313,25 @@ int config_init(const char *config_path) {
   }
 
   // Try to load from file (overrides defaults if file exists)
-  config_parse_file(g_config_path);
+  config_parse_file(&g_config, g_config_path);
+  g_saved = g_config;
+  publish_snapshot();
 
+  g_dirty = false;
+  g_written_ms = now_ms(); // The first batch waits its period too
+  g_writer_stop = false;
   g_initialized = true;
   pthread_mutex_unlock(&g_config_mutex);
 
+  if (!g_writer_running) {
+    if (pthread_create(&g_writer_thread, NULL, writer_thread_func, NULL) ==
+        0) {
+      g_writer_running = true;
+    } else {
+      fprintf(stderr, "config_init: pthread_create failed, saving at once\n");
+    }
+  }
+
   return 0;
 }
 
@@ -73,14 +339,84 @@ int config_save(void) {
   if (!g_initialized)
     return -1;
 
+  return flush_config();
+}
+
+unsigned config_reload(void) {
+  if (!g_initialized)
+    return 0;
+
+  // After any save in progress, so this does not read back our own
+  // half-recorded write as an edit
+  pthread_mutex_lock(&g_write_mutex);
+  HampodConfig file;
+  config_set_defaults(&file);
+  char path[sizeof(g_config_path)];
   pthread_mutex_lock(&g_config_mutex);
-  int result = config_write_file(g_config_path);
+  memcpy(path, g_config_path, sizeof(path));
   pthread_mutex_unlock(&g_config_mutex);
+  if (config_parse_file(&file, path) != 0) {
+    pthread_mutex_unlock(&g_write_mutex);
+    return 0;
+  }
 
-  return result;
+  pthread_mutex_lock(&g_config_mutex);
+  unsigned changed = 0;
+  if (memcmp(&file, &g_saved, sizeof(file)) != 0) {
+    HampodConfig old = g_config;
+    if (!g_dirty) {
+      g_config = file;
+    } else {
+      // Keep the setters' unsaved changes; take only the live settings
+      // edited in the file
+      for (size_t i = 0; i < CONFIG_FIELD_COUNT; i++) {
+        const ConfigField *f = &g_fields[i];
+        if (f->live != 0 &&
+            memcmp((char *)&file + f->offset, (char *)&g_saved + f->offset,
+                   f->size) != 0) {
+          memcpy((char *)&g_config + f->offset, (char *)&file + f->offset,
+                 f->size);
+        }
+      }
+    }
+    g_saved = file;
+    g_history.open = false;
+    publish_snapshot();
+
+    for (size_t i = 0; i < CONFIG_FIELD_COUNT; i++) {
+      const ConfigField *f = &g_fields[i];
+      if (f->live != 0 &&
+          memcmp((char *)&old + f->offset, (char *)&g_config + f->offset,
+                 f->size) != 0) {
+        changed |= f->live;
+      }
+    }
+  }
+  pthread_mutex_unlock(&g_config_mutex);
+  pthread_mutex_unlock(&g_write_mutex);
+  return changed;
 }
 
+const char *config_get_path(void) { return g_config_path; }
+
 void config_cleanup(void) {
+  if (g_writer_running) {
+    pthread_mutex_lock(&g_config_mutex);
+    g_writer_stop = true;
+    pthread_cond_signal(&g_writer_wake);
+    pthread_mutex_unlock(&g_config_mutex);
+    pthread_join(g_writer_thread, NULL);
+    g_writer_running = false;
+  }
+
+  // Whatever the writer had not got to yet
+  pthread_mutex_lock(&g_config_mutex);
+  bool dirty = g_dirty && g_initialized;
+  pthread_mutex_unlock(&g_config_mutex);
+  if (dirty) {
+    flush_config();
+  }
+
   pthread_mutex_lock(&g_config_mutex);
   g_initialized = false;
   g_history.count = 0;
@@ -97,17 +433,21 @@ int config_undo(void) {
 
   pthread_mutex_lock(&g_config_mutex);
 
-  HampodConfig prev;
-  int result = history_pop(&prev);
+  int result = history_pop();
   if (result == 0) {
-    g_config = prev;
-    config_write_file(g_config_path); // Auto-save after undo
+    mark_dirty(); // Auto-save after undo
   }
 
   pthread_mutex_unlock(&g_config_mutex);
   return result;
 }
 
+void config_undo_checkpoint(void) {
+  pthread_mutex_lock(&g_config_mutex);
+  g_history.open = false;
+  pthread_mutex_unlock(&g_config_mutex);
+}
+
 int config_get_undo_count(void) {
   pthread_mutex_lock(&g_config_mutex);
   int count = g_history.count;
@@ -143,7 +483,10 @@ void config_set_radio_enabled(int index, bool enabled) {
     return;
 
   pthread_mutex_lock(&g_config_mutex);
-  history_push(&g_config);
+  history_begin();
+  for (int i = 0; i < MAX_RADIOS; i++) {
+    HISTORY_SAVE(g_config.radios[i].enabled);
+  }
 
   // If enabling, disable all others
   if (enabled) {
@@ -153,7 +496,33 @@ void config_set_radio_enabled(int index, bool enabled) {
   }
   g_config.radios[index].enabled = enabled;
 
-  config_write_file(g_config_path);
+  mark_dirty();
+  pthread_mutex_unlock(&g_config_mutex);
+}
+
+void config_update_radio_connection(int index, const char *device, int baud,
+                                    const char *port, int detected_model) {
+  if (!g_initialized || index < 0 || index >= MAX_RADIOS || !device || !port)
+    return;
+
+  pthread_mutex_lock(&g_config_mutex);
+  RadioSettings *radio = &g_config.radios[index];
+  if (strcmp(radio->device, device) != 0 || radio->baud != baud ||
+      strcmp(radio->port, port) != 0 ||
+      radio->detected_model != detected_model) {
+    history_begin();
+    HISTORY_SAVE(radio->device);
+    HISTORY_SAVE(radio->baud);
+    HISTORY_SAVE(radio->port);
+    HISTORY_SAVE(radio->detected_model);
+    strncpy(radio->device, device, 63);
+    radio->device[63] = '\0';
+    radio->baud = baud;
+    strncpy(radio->port, port, 127);
+    radio->port[127] = '\0';
+    radio->detected_model = detected_model;
+    mark_dirty();
+  }
   pthread_mutex_unlock(&g_config_mutex);
 }
 
@@ -197,6 +566,10 @@ const char *config_get_radio_port(void) {
   return get_active_radio_internal()->port;
 }
 
+const char *config_get_radio_rigctld(void) {
+  return get_active_radio_internal()->rigctld;
+}
+
 int config_get_radio_detected_model(void) {
   pthread_mutex_lock(&g_config_mutex);
   int val = get_active_radio_internal()->detected_model;
@@ -204,31 +577,40 @@ int config_get_radio_detected_model(void) {
   return val;
 }
 
-// ============================================================================
-// Audio Getters
-// ============================================================================
+void config_get_radio_poll_limits(int index, int *fast_ms, int *idle_ms) {
+  if (index < 0 || index >= MAX_RADIOS)
+    index = 0;
 
-int config_get_volume(void) {
   pthread_mutex_lock(&g_config_mutex);
-  int val = g_config.audio.volume;
+  const RadioSettings *radio = &g_config.radios[index];
+  int fast = radio->poll_fast_ms > 0 ? radio->poll_fast_ms
+                                     : CONFIG_DEFAULT_POLL_FAST_MS;
+  int idle = radio->poll_idle_ms > 0 ? radio->poll_idle_ms
+                                     : CONFIG_DEFAULT_POLL_IDLE_MS;
   pthread_mutex_unlock(&g_config_mutex);
-  return val;
-}
 
-float config_get_speech_speed(void) {
-  pthread_mutex_lock(&g_config_mutex);
-  float val = g_config.audio.speech_speed;
-  pthread_mutex_unlock(&g_config_mutex);
-  return val;
+  *fast_ms = fast;
+  *idle_ms = idle < fast ? fast : idle;
 }
 
+// ============================================================================
+// Audio Getters (lock-free: read on every key press and beep)
+// ============================================================================
+
+int config_get_volume(void) { return snapshot_audio().volume; }
+
+float config_get_speech_speed(void) { return snapshot_audio().speech_speed; }
+
 bool config_get_key_beep_enabled(void) {
-  pthread_mutex_lock(&g_config_mutex);
-  bool val = g_config.audio.key_beep_enabled;
-  pthread_mutex_unlock(&g_config_mutex);
-  return val;
+  return snapshot_audio().key_beep_enabled;
 }
 
+bool config_get_firmware_beep_enabled(void) {
+  return snapshot_audio().firmware_beep_enabled;
+}
+
+bool config_get_terse_enabled(void) { return snapshot_audio().terse; }
+
 const char *config_get_audio_preferred_device(void) {
   return g_config.audio.preferred_device;
 }
@@ -239,11 +621,26 @@ const char *config_get_audio_device_name(void) {
 
 const char *config_get_audio_port(void) { return g_config.audio.port; }
 
-int config_get_audio_card_number(void) {
-  pthread_mutex_lock(&g_config_mutex);
-  int val = g_config.audio.card_number;
-  pthread_mutex_unlock(&g_config_mutex);
-  return val;
+int config_get_audio_card_number(void) { return snapshot_audio().card_number; }
+
+int config_get_tts_ram_mb(void) { return snapshot_audio().tts_ram_mb; }
+
+const char *config_get_beep_tone(int beep) {
+  if (beep < 0 || beep >= 3)
+    return "";
+  return g_config.audio.beep_tone[beep];
+}
+
+bool config_get_spell_phonetic(void) {
+  return snapshot_audio().spell_phonetic;
+}
+
+int config_get_spell_gap_ms(void) { return snapshot_audio().spell_gap_ms; }
+
+const char *config_get_alert_voice(void) { return g_config.audio.alert_voice; }
+
+bool config_get_frequency_diff(void) {
+  return snapshot_audio().frequency_diff;
 }
 
 // ============================================================================
@@ -263,16 +660,78 @@ const char *config_get_keypad_layout(void) {
 }
 
 // ============================================================================
-// Radio Setters (Act on the currently active radio, auto-save after each)
+// Scheduling Getters
+// ============================================================================
+
+const SchedulingSettings *config_get_scheduling(void) {
+  return &g_config.scheduling;
+}
+
+const ScanSettings *config_get_scan(void) { return &g_config.scan; }
+
+const MeterSettings *config_get_meters(void) { return &g_config.meters; }
+
+const RotorSettings *config_get_rotor(void) { return &g_config.rotor; }
+
+const StorageSettings *config_get_storage(void) { return &g_config.storage; }
+
+const ApiSettings *config_get_api(void) { return &g_config.api; }
+
+bool config_get_profile(const char *name, ProfileSettings *profile) {
+  bool found = false;
+  pthread_mutex_lock(&g_config_mutex);
+  for (int i = 0; i < MAX_PROFILES && !found; i++) {
+    if (g_config.profiles[i].name[0] != '\0' &&
+        strcmp(g_config.profiles[i].name, name) == 0) {
+      *profile = g_config.profiles[i];
+      found = true;
+    }
+  }
+  pthread_mutex_unlock(&g_config_mutex);
+  return found;
+}
+
+int config_set_profile(const char *name, const char *settings) {
+  if (!g_initialized || !name || name[0] == '\0' || !settings ||
+      strlen(name) >= CONFIG_PROFILE_NAME)
+    return -1;
+
+  pthread_mutex_lock(&g_config_mutex);
+  ProfileSettings *slot = NULL;
+  for (int i = 0; i < MAX_PROFILES; i++) {
+    ProfileSettings *p = &g_config.profiles[i];
+    if (strcmp(p->name, name) == 0) {
+      slot = p;
+      break;
+    }
+    if (!slot && p->name[0] == '\0') {
+      slot = p;
+    }
+  }
+  if (!slot) {
+    pthread_mutex_unlock(&g_config_mutex);
+    return -1;
+  }
+  history_begin();
+  HISTORY_SAVE(*slot);
+  snprintf(slot->name, sizeof(slot->name), "%s", name);
+  snprintf(slot->settings, sizeof(slot->settings), "%s", settings);
+  mark_dirty();
+  pthread_mutex_unlock(&g_config_mutex);
+  return 0;
+}
+
+// ============================================================================
+// Radio Setters (Act on the currently active radio, saved once they settle)
 // ============================================================================
 
 void config_set_radio_model(int model) {
   if (!g_initialized)
     return;
   pthread_mutex_lock(&g_config_mutex);
-  history_push(&g_config);
+  HISTORY_PUSH(get_active_radio_internal()->model);
   get_active_radio_internal()->model = model;
-  config_write_file(g_config_path);
+  mark_dirty();
   pthread_mutex_unlock(&g_config_mutex);
 }
 
@@ -280,10 +739,10 @@ void config_set_radio_device(const char *device) {
   if (!g_initialized || !device)
     return;
   pthread_mutex_lock(&g_config_mutex);
-  history_push(&g_config);
+  HISTORY_PUSH(get_active_radio_internal()->device);
   strncpy(get_active_radio_internal()->device, device, 63);
   get_active_radio_internal()->device[63] = '\0';
-  config_write_file(g_config_path);
+  mark_dirty();
   pthread_mutex_unlock(&g_config_mutex);
 }
 
@@ -291,9 +750,9 @@ void config_set_radio_baud(int baud) {
   if (!g_initialized)
     return;
   pthread_mutex_lock(&g_config_mutex);
-  history_push(&g_config);
+  HISTORY_PUSH(get_active_radio_internal()->baud);
   get_active_radio_internal()->baud = baud;
-  config_write_file(g_config_path);
+  mark_dirty();
   pthread_mutex_unlock(&g_config_mutex);
 }
 
@@ -301,10 +760,10 @@ void config_set_radio_name(const char *name) {
   if (!g_initialized || !name)
     return;
   pthread_mutex_lock(&g_config_mutex);
-  history_push(&g_config);
+  HISTORY_PUSH(get_active_radio_internal()->name);
   strncpy(get_active_radio_internal()->name, name, 63);
   get_active_radio_internal()->name[63] = '\0';
-  config_write_file(g_config_path);
+  mark_dirty();
   pthread_mutex_unlock(&g_config_mutex);
 }
 
@@ -312,10 +771,10 @@ void config_set_radio_port(const char *port) {
   if (!g_initialized || !port)
     return;
   pthread_mutex_lock(&g_config_mutex);
-  history_push(&g_config);
+  HISTORY_PUSH(get_active_radio_internal()->port);
   strncpy(get_active_radio_internal()->port, port, 127);
   get_active_radio_internal()->port[127] = '\0';
-  config_write_file(g_config_path);
+  mark_dirty();
   pthread_mutex_unlock(&g_config_mutex);
 }
 
@@ -323,14 +782,14 @@ void config_set_radio_detected_model(int model) {
   if (!g_initialized)
     return;
   pthread_mutex_lock(&g_config_mutex);
-  history_push(&g_config);
+  HISTORY_PUSH(get_active_radio_internal()->detected_model);
   get_active_radio_internal()->detected_model = model;
-  config_write_file(g_config_path);
+  mark_dirty();
   pthread_mutex_unlock(&g_config_mutex);
 }
 
 // ============================================================================
-// Audio Setters (auto-save after each)
+// Audio Setters (saved once they settle)
 // ============================================================================
 
 void config_set_volume(int volume) {
@@ -341,9 +800,9 @@ void config_set_volume(int volume) {
   if (volume > 100)
     volume = 100;
   pthread_mutex_lock(&g_config_mutex);
-  history_push(&g_config);
+  HISTORY_PUSH(g_config.audio.volume);
   g_config.audio.volume = volume;
-  config_write_file(g_config_path);
+  mark_dirty();
   pthread_mutex_unlock(&g_config_mutex);
 }
 
@@ -355,9 +814,9 @@ void config_set_speech_speed(float speed) {
   if (speed > 2.0f)
     speed = 2.0f;
   pthread_mutex_lock(&g_config_mutex);
-  history_push(&g_config);
+  HISTORY_PUSH(g_config.audio.speech_speed);
   g_config.audio.speech_speed = speed;
-  config_write_file(g_config_path);
+  mark_dirty();
   pthread_mutex_unlock(&g_config_mutex);
 }
 
@@ -365,9 +824,29 @@ void config_set_key_beep_enabled(bool enabled) {
   if (!g_initialized)
     return;
   pthread_mutex_lock(&g_config_mutex);
-  history_push(&g_config);
+  HISTORY_PUSH(g_config.audio.key_beep_enabled);
   g_config.audio.key_beep_enabled = enabled;
-  config_write_file(g_config_path);
+  mark_dirty();
+  pthread_mutex_unlock(&g_config_mutex);
+}
+
+void config_set_firmware_beep_enabled(bool enabled) {
+  if (!g_initialized)
+    return;
+  pthread_mutex_lock(&g_config_mutex);
+  HISTORY_PUSH(g_config.audio.firmware_beep_enabled);
+  g_config.audio.firmware_beep_enabled = enabled;
+  mark_dirty();
+  pthread_mutex_unlock(&g_config_mutex);
+}
+
+void config_set_terse_enabled(bool enabled) {
+  if (!g_initialized)
+    return;
+  pthread_mutex_lock(&g_config_mutex);
+  HISTORY_PUSH(g_config.audio.terse);
+  g_config.audio.terse = enabled;
+  mark_dirty();
   pthread_mutex_unlock(&g_config_mutex);
 }
 
@@ -375,10 +854,10 @@ void config_set_audio_device_name(const char *name) {
   if (!g_initialized || !name)
     return;
   pthread_mutex_lock(&g_config_mutex);
-  history_push(&g_config);
+  HISTORY_PUSH(g_config.audio.device_name);
   strncpy(g_config.audio.device_name, name, 127);
   g_config.audio.device_name[127] = '\0';
-  config_write_file(g_config_path);
+  mark_dirty();
   pthread_mutex_unlock(&g_config_mutex);
 }
 
@@ -386,10 +865,10 @@ void config_set_audio_port(const char *port) {
   if (!g_initialized || !port)
     return;
   pthread_mutex_lock(&g_config_mutex);
-  history_push(&g_config);
+  HISTORY_PUSH(g_config.audio.port);
   strncpy(g_config.audio.port, port, 127);
   g_config.audio.port[127] = '\0';
-  config_write_file(g_config_path);
+  mark_dirty();
   pthread_mutex_unlock(&g_config_mutex);
 }
 
@@ -397,24 +876,24 @@ void config_set_audio_card_number(int card) {
   if (!g_initialized)
     return;
   pthread_mutex_lock(&g_config_mutex);
-  history_push(&g_config);
+  HISTORY_PUSH(g_config.audio.card_number);
   g_config.audio.card_number = card;
-  config_write_file(g_config_path);
+  mark_dirty();
   pthread_mutex_unlock(&g_config_mutex);
 }
 
 // ============================================================================
-// Keypad Setters (auto-save after each)
+// Keypad Setters (saved once they settle)
 // ============================================================================
 
 void config_set_keypad_port(const char *port) {
   if (!g_initialized || !port)
     return;
   pthread_mutex_lock(&g_config_mutex);
-  history_push(&g_config);
+  HISTORY_PUSH(g_config.keypad.port);
   strncpy(g_config.keypad.port, port, 127);
   g_config.keypad.port[127] = '\0';
-  config_write_file(g_config_path);
+  mark_dirty();
   pthread_mutex_unlock(&g_config_mutex);
 }
 
@@ -422,10 +901,10 @@ void config_set_keypad_device_name(const char *name) {
   if (!g_initialized || !name)
     return;
   pthread_mutex_lock(&g_config_mutex);
-  history_push(&g_config);
+  HISTORY_PUSH(g_config.keypad.device_name);
   strncpy(g_config.keypad.device_name, name, 127);
   g_config.keypad.device_name[127] = '\0';
-  config_write_file(g_config_path);
+  mark_dirty();
   pthread_mutex_unlock(&g_config_mutex);
 }
 
@@ -433,10 +912,10 @@ void config_set_keypad_layout(const char *layout) {
   if (!g_initialized || !layout)
     return;
   pthread_mutex_lock(&g_config_mutex);
-  history_push(&g_config);
+  HISTORY_PUSH(g_config.keypad.layout);
   strncpy(g_config.keypad.layout, layout, 15);
   g_config.keypad.layout[15] = '\0';
-  config_write_file(g_config_path);
+  mark_dirty();
   pthread_mutex_unlock(&g_config_mutex);
 }
 
@@ -444,52 +923,390 @@ void config_set_keypad_layout(const char *layout) {
 // Internal Functions
 // ============================================================================
 
-static void config_set_defaults(void) {
-  memset(&g_config, 0, sizeof(HampodConfig));
+static long long now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
 
-  // Default radio 1
-  g_config.radios[0].enabled = true;
-  strcpy(g_config.radios[0].name, "Primary Radio");
-  g_config.radios[0].model = CONFIG_DEFAULT_RADIO_MODEL;
-  strcpy(g_config.radios[0].device, CONFIG_DEFAULT_RADIO_DEVICE);
-  g_config.radios[0].baud = CONFIG_DEFAULT_RADIO_BAUD;
+// Publish g_config for the lock-free getters. Call with g_config_mutex
+// held.
+static void publish_snapshot(void) {
+  unsigned next = g_version + 1;
 
-  // Audio defaults
-  strcpy(g_config.audio.preferred_device, "USB2.0 Device");
-  g_config.audio.volume = CONFIG_DEFAULT_VOLUME;
-  g_config.audio.speech_speed = CONFIG_DEFAULT_SPEECH_SPEED;
-  g_config.audio.key_beep_enabled = CONFIG_DEFAULT_KEY_BEEP;
-  g_config.audio.card_number = -1;
+  // Readers that see any of the new slot contents also see that the
+  // version has moved on to the slot's previous user, and retry
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  g_snapshots[next % CONFIG_SNAPSHOTS] = g_config;
+  __atomic_store_n(&g_version, next, __ATOMIC_RELEASE);
+}
 
-  // Keypad defaults
-  strcpy(g_config.keypad.layout, "calculator");
+// The audio settings as last published, without taking a lock
+static AudioSettings snapshot_audio(void) {
+  AudioSettings audio;
+  unsigned version;
+  do {
+    version = __atomic_load_n(&g_version, __ATOMIC_ACQUIRE);
+    audio = g_snapshots[version % CONFIG_SNAPSHOTS].audio;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  } while (__atomic_load_n(&g_version, __ATOMIC_RELAXED) - version >=
+           CONFIG_SNAPSHOTS - 1);
+  return audio;
+}
+
+// Publish a change and schedule a save. Call with g_config_mutex held.
+static void mark_dirty(void) {
+  publish_snapshot();
+  g_dirty = true;
+  g_changed_ms = now_ms();
+  if (g_writer_running) {
+    pthread_cond_signal(&g_writer_wake);
+  } else {
+    // No writer thread: save at once, as before
+    g_dirty = config_write_file(&g_config, g_config_path) != 0;
+  }
 }
 
-static void history_push(const HampodConfig *config) {
-  g_history.snapshots[g_history.head] = *config;
+// Write the current config. Call without g_config_mutex held.
+static int flush_config(void) {
+  pthread_mutex_lock(&g_write_mutex);
+
+  // Write a copy, so setters and getters never wait on the SD card
+  pthread_mutex_lock(&g_config_mutex);
+  HampodConfig snapshot = g_config;
+  char path[sizeof(g_config_path)];
+  memcpy(path, g_config_path, sizeof(path));
+  g_dirty = false;
+  pthread_mutex_unlock(&g_config_mutex);
+
+  int result = config_write_file(&snapshot, path);
+  if (result != 0) {
+    fprintf(stderr, "config: Cannot save %s\n", path);
+    pthread_mutex_lock(&g_config_mutex);
+    g_dirty = true; // Try again after another quiet period
+    g_changed_ms = now_ms();
+    pthread_mutex_unlock(&g_config_mutex);
+  } else {
+    // As config_reload() will read it back, rounding and all
+    config_set_defaults(&snapshot);
+    config_parse_file(&snapshot, path);
+    pthread_mutex_lock(&g_config_mutex);
+    g_saved = snapshot;
+    g_written_ms = now_ms();
+    pthread_mutex_unlock(&g_config_mutex);
+  }
+
+  pthread_mutex_unlock(&g_write_mutex);
+  return result;
+}
+
+static void *writer_thread_func(void *arg) {
+  (void)arg;
+
+  pthread_mutex_lock(&g_config_mutex);
+  while (!g_writer_stop) {
+    if (!g_dirty) {
+      pthread_cond_wait(&g_writer_wake, &g_config_mutex);
+      continue;
+    }
+
+    if (g_config.storage.tmpfs && g_config.storage.writeback_s == 0) {
+      // Saved only on the way out
+      pthread_cond_wait(&g_writer_wake, &g_config_mutex);
+      continue;
+    }
+
+    // Wait until the setters have been quiet for a while, and in tmpfs
+    // mode until the batch is due
+    long long due_ms = g_changed_ms + CONFIG_SAVE_DELAY_MS;
+    if (g_config.storage.tmpfs &&
+        g_written_ms + g_config.storage.writeback_s * 1000LL > due_ms) {
+      due_ms = g_written_ms + g_config.storage.writeback_s * 1000LL;
+    }
+    long long wait_ms = due_ms - now_ms();
+    if (wait_ms > 0) {
+      struct timespec wake;
+      clock_gettime(CLOCK_REALTIME, &wake);
+      wake.tv_sec += wait_ms / 1000;
+      wake.tv_nsec += (wait_ms % 1000) * 1000000L;
+      if (wake.tv_nsec >= 1000000000L) {
+        wake.tv_sec++;
+        wake.tv_nsec -= 1000000000L;
+      }
+      pthread_cond_timedwait(&g_writer_wake, &g_config_mutex, &wake);
+      continue;
+    }
+
+    pthread_mutex_unlock(&g_config_mutex);
+    flush_config();
+    pthread_mutex_lock(&g_config_mutex);
+  }
+  pthread_mutex_unlock(&g_config_mutex);
+  return NULL;
+}
+
+static void config_set_defaults(HampodConfig *c) {
+  memset(c, 0, sizeof(HampodConfig));
+  for (size_t i = 0; i < CONFIG_FIELD_COUNT; i++) {
+    const ConfigField *f = &g_fields[i];
+    if (f->flags & FIELD_PER_RADIO) {
+      for (int r = 0; r < MAX_RADIOS; r++) {
+        field_set_default(f, (char *)&c->radios[r] + f->offset);
+      }
+    } else if (!(f->flags & FIELD_LEGACY)) {
+      field_set_default(f, (char *)c + f->offset);
+    }
+  }
+
+  // Default radio 1
+  c->radios[0].enabled = true;
+  strcpy(c->radios[0].name, "Primary Radio");
+  c->radios[0].model = CONFIG_DEFAULT_RADIO_MODEL;
+  strcpy(c->radios[0].device, CONFIG_DEFAULT_RADIO_DEVICE);
+  c->radios[0].baud = CONFIG_DEFAULT_RADIO_BAUD;
+}
+
+static ConfigStep *history_newest(void) {
+  int newest = (g_history.head - 1 + CONFIG_UNDO_DEPTH) % CONFIG_UNDO_DEPTH;
+  return &g_history.steps[newest];
+}
+
+// Start an undo step, dropping the oldest if the history is full. Call
+// with g_config_mutex held, then history_save() each field before the
+// setter changes it.
+static void history_begin(void) {
+  ConfigStep *step = &g_history.steps[g_history.head];
+  step->fields = 0;
+  step->bytes = 0;
+  step->changed_ms = now_ms();
   g_history.head = (g_history.head + 1) % CONFIG_UNDO_DEPTH;
   if (g_history.count < CONFIG_UNDO_DEPTH) {
     g_history.count++;
   }
+  g_history.open = false;
+}
+
+static void history_save(const void *field, size_t size) {
+  ConfigStep *step = history_newest();
+  if (step->fields == UNDO_STEP_FIELDS ||
+      step->bytes + (int)size > UNDO_STEP_BYTES) {
+    fprintf(stderr, "config: Undo step full, change not undoable\n");
+    return;
+  }
+  step->offset[step->fields] =
+      (unsigned short)((const char *)field - (const char *)&g_config);
+  step->size[step->fields] = (unsigned short)size;
+  memcpy(step->old + step->bytes, field, size);
+  step->fields++;
+  step->bytes += (int)size;
+}
+
+// A setter changing one field. Repeated edits to that field, each within
+// CONFIG_UNDO_COALESCE_MS of the last, make one step that undoes to the
+// value before the first.
+static void history_push_field(const void *field, size_t size) {
+  long long now = now_ms();
+  if (g_history.open && g_history.count > 0) {
+    ConfigStep *step = history_newest();
+    if ((const char *)field - (const char *)&g_config == step->offset[0] &&
+        now - step->changed_ms < CONFIG_UNDO_COALESCE_MS) {
+      step->changed_ms = now;
+      return;
+    }
+  }
+  history_begin();
+  history_save(field, size);
+  g_history.open = true;
 }
 
-static int history_pop(HampodConfig *config) {
+static int history_pop(void) {
   if (g_history.count == 0)
     return -1;
   g_history.head = (g_history.head - 1 + CONFIG_UNDO_DEPTH) % CONFIG_UNDO_DEPTH;
   g_history.count--;
-  *config = g_history.snapshots[g_history.head];
+  g_history.open = false;
+
+  // Last saved first, so a field saved twice ends up at its oldest value
+  ConfigStep *step = &g_history.steps[g_history.head];
+  int bytes = step->bytes;
+  for (int i = step->fields - 1; i >= 0; i--) {
+    bytes -= step->size[i];
+    memcpy((char *)&g_config + step->offset[i], step->old + bytes,
+           step->size[i]);
+  }
   return 0;
 }
 
+// ============================================================================
+// Schema
+// ============================================================================
+
+// FNV-1a of "section.key"
+static unsigned field_hash(const char *section, const char *key) {
+  unsigned hash = 2166136261u;
+  for (const char *p = section; *p != '\0'; p++) {
+    hash = (hash ^ (unsigned char)*p) * 16777619u;
+  }
+  hash = (hash ^ '.') * 16777619u;
+  for (const char *p = key; *p != '\0'; p++) {
+    hash = (hash ^ (unsigned char)*p) * 16777619u;
+  }
+  return hash;
+}
+
+static void build_field_hash(void) {
+  for (size_t i = 0; i < CONFIG_FIELD_COUNT; i++) {
+    unsigned slot = field_hash(g_fields[i].section, g_fields[i].key);
+    while (g_field_hash[slot % FIELD_HASH_SIZE] != 0) {
+      slot++;
+    }
+    g_field_hash[slot % FIELD_HASH_SIZE] = (unsigned char)(i + 1);
+  }
+}
+
+static const ConfigField *find_field(const char *section, const char *key) {
+  pthread_once(&g_field_hash_once, build_field_hash);
+  for (unsigned slot = field_hash(section, key);; slot++) {
+    int row = g_field_hash[slot % FIELD_HASH_SIZE];
+    if (row == 0) {
+      return NULL;
+    }
+    const ConfigField *f = &g_fields[row - 1];
+    if (strcmp(f->key, key) == 0 && strcmp(f->section, section) == 0) {
+      return f;
+    }
+  }
+}
+
+static void field_set_default(const ConfigField *f, void *field) {
+  switch (f->type) {
+  case FIELD_INT:
+    *(int *)field = (int)f->def;
+    break;
+  case FIELD_BOOL:
+    *(bool *)field = f->def != 0;
+    break;
+  case FIELD_FLOAT:
+    *(float *)field = (float)f->def;
+    break;
+  case FIELD_STRING:
+    snprintf(field, f->size, "%s", f->def_text ? f->def_text : "");
+    break;
+  }
+}
+
+static bool field_is_default(const ConfigField *f, const void *field) {
+  switch (f->type) {
+  case FIELD_INT:
+    return *(const int *)field == (int)f->def;
+  case FIELD_BOOL:
+    return *(const bool *)field == (f->def != 0);
+  case FIELD_FLOAT:
+    return *(const float *)field == (float)f->def;
+  case FIELD_STRING:
+    return strcmp(field, f->def_text ? f->def_text : "") == 0;
+  }
+  return false;
+}
+
+// Store a value read from the file. Returns why it was refused, leaving
+// the field as it was, or NULL once stored.
+static const char *field_parse(const ConfigField *f, const char *value,
+                               void *field) {
+  char *end;
+  switch (f->type) {
+  case FIELD_INT: {
+    errno = 0;
+    long number = strtol(value, &end, 10);
+    if (end == value || *end != '\0') {
+      return "is not a whole number";
+    }
+    if (errno == ERANGE || number < f->min || number > f->max) {
+      return "is out of range";
+    }
+    *(int *)field = (int)number;
+    return NULL;
+  }
+  case FIELD_BOOL:
+    if (strcmp(value, "1") == 0 || strcmp(value, "true") == 0 ||
+        strcmp(value, "yes") == 0 || strcmp(value, "on") == 0) {
+      *(bool *)field = true;
+    } else if (strcmp(value, "0") == 0 || strcmp(value, "false") == 0 ||
+               strcmp(value, "no") == 0 || strcmp(value, "off") == 0) {
+      *(bool *)field = false;
+    } else {
+      return "is not 1 or 0";
+    }
+    return NULL;
+  case FIELD_FLOAT: {
+    float number = strtof(value, &end);
+    if (end == value || *end != '\0') {
+      return "is not a number";
+    }
+    if (!(number >= f->min && number <= f->max)) {
+      return "is out of range";
+    }
+    *(float *)field = number;
+    return NULL;
+  }
+  case FIELD_STRING:
+    if (strlen(value) >= f->size) {
+      return "is too long";
+    }
+    memcpy(field, value, strlen(value) + 1);
+    return NULL;
+  }
+  return "has an unknown type";
+}
+
+static void field_write(FILE *fp, const ConfigField *f, const void *field) {
+  switch (f->type) {
+  case FIELD_INT:
+    fprintf(fp, "%s = %d\n", f->key, *(const int *)field);
+    break;
+  case FIELD_BOOL:
+    fprintf(fp, "%s = %d\n", f->key, *(const bool *)field ? 1 : 0);
+    break;
+  case FIELD_FLOAT:
+    fprintf(fp, "%s = %.2f\n", f->key, *(const float *)field);
+    break;
+  case FIELD_STRING:
+    fprintf(fp, "%s = %s\n", f->key, (const char *)field);
+    break;
+  }
+}
+
+// Write the rows from first to before end (one section) under header,
+// reading the fields from base. A section with nothing to write is left
+// out.
+static void write_section(FILE *fp, size_t first, size_t end,
+                          const char *header, const char *base) {
+  bool started = false;
+  for (size_t i = first; i < end; i++) {
+    const ConfigField *f = &g_fields[i];
+    const char *field = base + f->offset;
+    if ((f->flags & FIELD_SPARSE) && field_is_default(f, field)) {
+      continue;
+    }
+    if (!started) {
+      fprintf(fp, "[%s]\n", header);
+      started = true;
+    }
+    field_write(fp, f, field);
+  }
+  if (started) {
+    fprintf(fp, "\n");
+  }
+}
+
 // ============================================================================
 // File I/O (INI format)
 // ============================================================================
 
-static int config_parse_file(const char *path) {
+static int config_parse_file(HampodConfig *c, const char *path) {
   FILE *fp = fopen(path, "r");
   if (!fp)
-    return 0;
+    return -1;
 
   char line[512];
   char section[64] = "";
@@ -525,61 +1342,62 @@ static int config_parse_file(const char *path) {
     while (*value == ' ' || *value == '\t')
       value++;
     char *v_end = value + strlen(value) - 1;
-    while (v_end > value && (*v_end == ' ' || *v_end == '\t' ||
-                             *v_end == '\n' || *v_end == '\r'))
+    while (v_end >= value && (*v_end == ' ' || *v_end == '\t' ||
+                              *v_end == '\n' || *v_end == '\r'))
       *v_end-- = '\0';
 
-    // Handle [radio.X]
+    if (strcmp(section, "profiles") == 0) {
+      for (int i = 0; i < MAX_PROFILES; i++) {
+        if (c->profiles[i].name[0] == '\0') {
+          strncpy(c->profiles[i].name, key, CONFIG_PROFILE_NAME - 1);
+          strncpy(c->profiles[i].settings, value, CONFIG_PROFILE_TEXT - 1);
+          break;
+        }
+      }
+      continue;
+    }
+    if (strcmp(section, "voices") == 0) {
+      for (int i = 0; i < MAX_VOICES; i++) {
+        if (c->voices[i].name[0] == '\0') {
+          strncpy(c->voices[i].name, key, 15);
+          strncpy(c->voices[i].model, value, 127);
+          break;
+        }
+      }
+      continue;
+    }
+
+    // [radio.N] rows are kept once, for every radio
+    const char *lookup = section;
+    char *base = (char *)c;
     if (strncmp(section, "radio.", 6) == 0) {
       int idx = atoi(section + 6) - 1;
-      if (idx >= 0 && idx < MAX_RADIOS) {
-        if (strcmp(key, "enabled") == 0)
-          g_config.radios[idx].enabled =
-              (strcmp(value, "true") == 0 || atoi(value) != 0);
-        else if (strcmp(key, "name") == 0)
-          strncpy(g_config.radios[idx].name, value, 63);
-        else if (strcmp(key, "model") == 0)
-          g_config.radios[idx].model = atoi(value);
-        else if (strcmp(key, "device") == 0)
-          strncpy(g_config.radios[idx].device, value, 63);
-        else if (strcmp(key, "baud") == 0)
-          g_config.radios[idx].baud = atoi(value);
-        else if (strcmp(key, "port") == 0)
-          strncpy(g_config.radios[idx].port, value, 127);
-        else if (strcmp(key, "detected_model") == 0)
-          g_config.radios[idx].detected_model = atoi(value);
+      if (idx < 0 || idx >= MAX_RADIOS)
+        continue;
+      lookup = "radio.N";
+      base = (char *)&c->radios[idx];
+    }
+
+    // Unknown keys are skipped, so an older build reads a newer file
+    const ConfigField *f = find_field(lookup, key);
+    if (!f)
+      continue;
+
+    // A comment after the value ("layout = phone  # or calculator")
+    for (char *p = value; *p != '\0'; p++) {
+      if (*p == '#' && p > value && (p[-1] == ' ' || p[-1] == '\t')) {
+        *p = '\0';
+        break;
       }
     }
-    // Backward compatibility for old [radio] section
-    else if (strcmp(section, "radio") == 0) {
-      if (strcmp(key, "model") == 0)
-        g_config.radios[0].model = atoi(value);
-      else if (strcmp(key, "device") == 0)
-        strncpy(g_config.radios[0].device, value, 63);
-      else if (strcmp(key, "baud") == 0)
-        g_config.radios[0].baud = atoi(value);
-    } else if (strcmp(section, "audio") == 0) {
-      if (strcmp(key, "preferred_device") == 0)
-        strncpy(g_config.audio.preferred_device, value, 63);
-      else if (strcmp(key, "device_name") == 0)
-        strncpy(g_config.audio.device_name, value, 127);
-      else if (strcmp(key, "port") == 0)
-        strncpy(g_config.audio.port, value, 127);
-      else if (strcmp(key, "volume") == 0)
-        g_config.audio.volume = atoi(value);
-      else if (strcmp(key, "speech_speed") == 0)
-        g_config.audio.speech_speed = (float)atof(value);
-      else if (strcmp(key, "key_beep") == 0)
-        g_config.audio.key_beep_enabled = (atoi(value) != 0);
-      else if (strcmp(key, "card_number") == 0)
-        g_config.audio.card_number = atoi(value);
-    } else if (strcmp(section, "keypad") == 0) {
-      if (strcmp(key, "port") == 0)
-        strncpy(g_config.keypad.port, value, 127);
-      else if (strcmp(key, "device_name") == 0)
-        strncpy(g_config.keypad.device_name, value, 127);
-      else if (strcmp(key, "layout") == 0)
-        strncpy(g_config.keypad.layout, value, 15);
+    v_end = value + strlen(value) - 1;
+    while (v_end >= value && (*v_end == ' ' || *v_end == '\t'))
+      *v_end-- = '\0';
+
+    const char *refused = field_parse(f, value, base + f->offset);
+    if (refused) {
+      fprintf(stderr, "config: [%s] %s = %s %s, ignored\n", section, key,
+              value, refused);
     }
   }
 
@@ -587,42 +1405,62 @@ static int config_parse_file(const char *path) {
   return 0;
 }
 
-static int config_write_file(const char *path) {
-  FILE *fp = fopen(path, "w");
+// Write to a temporary file and rename it over the config, so a power
+// cut leaves either the old file or the new one, never half of one
+static int config_write_file(const HampodConfig *c, const char *path) {
+  char tmp_path[sizeof(g_config_path) + 4];
+  snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+  FILE *fp = fopen(tmp_path, "w");
   if (!fp)
     return -1;
 
   fprintf(fp, "# HAMPOD Configuration\n# Auto-generated - edit with care\n\n");
 
-  for (int i = 0; i < MAX_RADIOS; i++) {
-    // Only write radio sections that are either enabled or have a name/model
-    // set
-    if (g_config.radios[i].enabled || g_config.radios[i].model != 0) {
-      fprintf(fp, "[radio.%d]\n", i + 1);
-      fprintf(fp, "enabled = %d\n", g_config.radios[i].enabled ? 1 : 0);
-      fprintf(fp, "name = %s\n", g_config.radios[i].name);
-      fprintf(fp, "model = %d\n", g_config.radios[i].model);
-      fprintf(fp, "device = %s\n", g_config.radios[i].device);
-      fprintf(fp, "baud = %d\n", g_config.radios[i].baud);
-      fprintf(fp, "port = %s\n", g_config.radios[i].port);
-      fprintf(fp, "detected_model = %d\n\n", g_config.radios[i].detected_model);
-    }
-  }
-
-  fprintf(fp, "[audio]\n");
-  fprintf(fp, "preferred_device = %s\n", g_config.audio.preferred_device);
-  fprintf(fp, "device_name = %s\n", g_config.audio.device_name);
-  fprintf(fp, "port = %s\n", g_config.audio.port);
-  fprintf(fp, "card_number = %d\n", g_config.audio.card_number);
-  fprintf(fp, "volume = %d\n", g_config.audio.volume);
-  fprintf(fp, "speech_speed = %.2f\n", g_config.audio.speech_speed);
-  fprintf(fp, "key_beep = %d\n\n", g_config.audio.key_beep_enabled ? 1 : 0);
-
-  fprintf(fp, "[keypad]\n");
-  fprintf(fp, "layout = %s\n", g_config.keypad.layout);
-  fprintf(fp, "port = %s\n", g_config.keypad.port);
-  fprintf(fp, "device_name = %s\n", g_config.keypad.device_name);
+  for (size_t first = 0, end; first < CONFIG_FIELD_COUNT; first = end) {
+    const ConfigField *f = &g_fields[first];
+    for (end = first + 1; end < CONFIG_FIELD_COUNT &&
+                          strcmp(g_fields[end].section, f->section) == 0;
+         end++) {
+    }
 
-  fclose(fp);
+    if (f->flags & FIELD_PER_RADIO) {
+      // Only radios that are enabled or have a model set
+      for (int i = 0; i < MAX_RADIOS; i++) {
+        if (c->radios[i].enabled || c->radios[i].model != 0) {
+          char header[16];
+          snprintf(header, sizeof(header), "radio.%d", i + 1);
+          write_section(fp, first, end, header, (const char *)&c->radios[i]);
+        }
+      }
+    } else if (!(f->flags & FIELD_LEGACY)) {
+      write_section(fp, first, end, f->section, (const char *)c);
+    }
+  }
+
+  if (c->voices[0].name[0] != '\0') {
+    fprintf(fp, "[voices]\n");
+    for (int i = 0; i < MAX_VOICES && c->voices[i].name[0] != '\0'; i++) {
+      fprintf(fp, "%s = %s\n", c->voices[i].name, c->voices[i].model);
+    }
+    fprintf(fp, "\n");
+  }
+
+  if (c->profiles[0].name[0] != '\0') {
+    fprintf(fp, "[profiles]\n");
+    for (int i = 0; i < MAX_PROFILES; i++) {
+      if (c->profiles[i].name[0] != '\0') {
+        fprintf(fp, "%s = %s\n", c->profiles[i].name,
+                c->profiles[i].settings);
+      }
+    }
+    fprintf(fp, "\n");
+  }
+
+  // On the card before the rename makes it the config
+  bool written = fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+  if (fclose(fp) != 0 || !written || rename(tmp_path, path) != 0) {
+    unlink(tmp_path);
+    return -1;
+  }
   return 0;
 }
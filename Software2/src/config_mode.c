@@ -6,6 +6,7 @@
  */
 
 #include "config_mode.h"
+#include "announce.h"
 #include "comm.h"
 #include "config.h"
 #include "hampod_core.h"
@@ -26,6 +27,9 @@
 #define GIT_BRANCH_COUNT 0
 #endif
 
+// Longest to wait for "Rebooting" / "Shutting down" to be spoken
+#define POWER_ANNOUNCE_TIMEOUT_MS 5000
+
 // ============================================================================
 // Module State
 // ============================================================================
@@ -44,6 +48,7 @@ static int g_undo_depth_on_entry = 0;
 
 static void announce_param_value(ConfigModeParameter param);
 static void apply_volume_live(int vol);
+static void apply_style_live(bool terse);
 
 // ============================================================================
 // Initialization
@@ -74,6 +79,7 @@ void config_mode_enter(void) {
     g_state = CONFIG_MODE_BROWSING;
     g_current_param = CONFIG_PARAM_VOLUME;
     g_reboot_selected = true;
+    config_undo_checkpoint();
     g_undo_depth_on_entry = config_get_undo_count();
     speech_say_text("Configuration Mode");
     announce_param_value(g_current_param);
@@ -106,6 +112,7 @@ void config_mode_exit_discard(void) {
     // Must manually re-apply the live settings to audio/piper
     apply_volume_live(config_get_volume());
     comm_set_speech_speed(config_get_speech_speed());
+    apply_style_live(config_get_terse_enabled());
 
     const char *layout = config_get_keypad_layout();
     comm_send_config_packet(0x01, (strcmp(layout, "phone") == 0) ? 1 : 0);
@@ -132,22 +139,13 @@ void config_mode_exit_no_save(void) {
 // ============================================================================
 
 static void apply_volume_live(int vol) {
-  int card = config_get_audio_card_number();
-  char vol_cmd[256];
-  if (card >= 0) {
-    snprintf(vol_cmd, sizeof(vol_cmd),
-             "amixer -c %d -q sset Speaker %d%% 2>/dev/null || "
-             "amixer -c %d -q sset PCM %d%% 2>/dev/null || "
-             "amixer -c %d -q sset Master %d%% 2>/dev/null",
-             card, vol, card, vol, card, vol);
-  } else {
-    snprintf(vol_cmd, sizeof(vol_cmd),
-             "amixer -q sset Speaker %d%% 2>/dev/null || "
-             "amixer -q sset PCM %d%% 2>/dev/null || "
-             "amixer -q sset Master %d%% 2>/dev/null",
-             vol, vol, vol);
-  }
-  system(vol_cmd);
+  // Firmware's software gain; takes effect before the announcement plays
+  comm_set_volume(vol);
+}
+
+static void apply_style_live(bool terse) {
+  // Every announcement built from here on, in every mode
+  announce_set_style(terse ? ANNOUNCE_TERSE : ANNOUNCE_VERBOSE);
 }
 
 // ============================================================================
@@ -155,45 +153,60 @@ static void apply_volume_live(int vol) {
 // ============================================================================
 
 static void announce_param_value(ConfigModeParameter param) {
-  char buffer[64];
+  Announcement a;
+  announce_init(&a);
 
   switch (param) {
   case CONFIG_PARAM_VOLUME:
-    snprintf(buffer, sizeof(buffer), "Volume, %d percent", config_get_volume());
+    announce_text(&a, "Volume,");
+    announce_number(&a, config_get_volume());
+    announce_unit(&a, ANNOUNCE_UNIT_PERCENT);
     break;
 
   case CONFIG_PARAM_SPEECH_SPEED: {
     float speed = config_get_speech_speed();
     int speed_whole = (int)speed;
     int speed_frac = (int)((speed - speed_whole) * 10 + 0.5);
-    snprintf(buffer, sizeof(buffer), "Speed, %d point %d", speed_whole,
-             speed_frac);
+    char frac[4];
+    snprintf(frac, sizeof(frac), "%d", speed_frac);
+    announce_text(&a, "Speed,");
+    announce_number(&a, speed_whole);
+    announce_word(&a, "point");
+    announce_digits(&a, frac);
   } break;
 
-  case CONFIG_PARAM_LAYOUT: {
-    const char *layout = config_get_keypad_layout();
-    snprintf(buffer, sizeof(buffer), "Keypad Layout, %s", layout);
-  } break;
+  case CONFIG_PARAM_LAYOUT:
+    announce_text(&a, "Keypad Layout,");
+    announce_text(&a, config_get_keypad_layout());
+    break;
 
-  case CONFIG_PARAM_VERSION:
-    snprintf(buffer, sizeof(buffer), "System version %s zero point %d point %d",
-             GIT_BRANCH, GIT_MAIN_COUNT, GIT_BRANCH_COUNT);
+  case CONFIG_PARAM_STYLE:
+    announce_text(&a, "Announcements,");
+    announce_word(&a, config_get_terse_enabled() ? "terse" : "verbose");
     break;
 
+  case CONFIG_PARAM_VERSION: {
+    char version[64];
+    snprintf(version, sizeof(version),
+             "System version %s zero point %d point %d", GIT_BRANCH,
+             GIT_MAIN_COUNT, GIT_BRANCH_COUNT);
+    announce_text(&a, version);
+  } break;
+
   case CONFIG_PARAM_SHUTDOWN:
     if (g_reboot_selected) {
-      snprintf(buffer, sizeof(buffer), "System Reboot, press Enter to confirm");
+      announce_text(&a, "System Reboot, press Enter to confirm");
     } else {
-      snprintf(buffer, sizeof(buffer), "System Shutdown, press Enter to confirm");
+      announce_text(&a, "System Shutdown, press Enter to confirm");
     }
     break;
 
   default:
-    snprintf(buffer, sizeof(buffer), "Unknown parameter");
+    announce_text(&a, "Unknown parameter");
     break;
   }
 
-  speech_say_text(buffer);
+  announce_say(&a, SPEECH_INTERACTIVE);
 }
 
 static void change_param_value(ConfigModeParameter param, bool increment) {
@@ -238,6 +251,13 @@ static void change_param_value(ConfigModeParameter param, bool increment) {
     announce_param_value(param);
   } break;
 
+  case CONFIG_PARAM_STYLE: {
+    bool terse = !config_get_terse_enabled();
+    config_set_terse_enabled(terse);
+    apply_style_live(terse);
+    announce_param_value(param);
+  } break;
+
   case CONFIG_PARAM_VERSION:
     announce_param_value(param);
     break;
@@ -319,11 +339,14 @@ bool config_mode_handle_key(char key, bool is_hold) {
 
   // Shutdown execution
   if (key == '#' && g_current_param == CONFIG_PARAM_SHUTDOWN) {
+    // Let the announcement finish before the system goes down under it
     if (g_reboot_selected) {
       speech_say_text("Rebooting");
+      speech_wait_item(speech_last_id(), POWER_ANNOUNCE_TIMEOUT_MS);
       system("sudo reboot");
     } else {
       speech_say_text("Shutting down");
+      speech_wait_item(speech_last_id(), POWER_ANNOUNCE_TIMEOUT_MS);
       system("sudo shutdown -h now");
     }
     return true;
@@ -0,0 +1,147 @@
+/**
+ * @file config_watch.c
+ * @brief Config file hot reload implementation
+ */
+
+#include "config_watch.h"
+#include "config.h"
+#include "hampod_core.h"
+
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+// ============================================================================
+// State
+// ============================================================================
+
+static ConfigWatchCallback g_callback = NULL;
+static char g_name[256]; // File name inside the watched directory
+static int g_inotify_fd = -1;
+static int g_stop_pipe[2] = {-1, -1}; // config_watch_stop() writes to [1]
+static volatile bool g_running = false;
+static pthread_t g_watch_thread;
+
+// ============================================================================
+// Internal Functions
+// ============================================================================
+
+// Whether a batch of events includes the config file being written or
+// renamed into place
+static bool events_touch_config(const char *buffer, ssize_t length) {
+  bool touched = false;
+  const char *p = buffer;
+  while (p < buffer + length) {
+    const struct inotify_event *event = (const struct inotify_event *)p;
+    if (event->len > 0 && strcmp(event->name, g_name) == 0) {
+      touched = true;
+    }
+    p += sizeof(struct inotify_event) + event->len;
+  }
+  return touched;
+}
+
+static void *watch_thread_func(void *arg) {
+  (void)arg;
+  char buffer[4096]
+      __attribute__((aligned(__alignof__(struct inotify_event))));
+
+  while (g_running) {
+    // No timeout: an edit or config_watch_stop() wakes the thread
+    struct pollfd pfds[2] = {{g_inotify_fd, POLLIN, 0},
+                             {g_stop_pipe[0], POLLIN, 0}};
+    if (poll(pfds, 2, -1) <= 0 || !(pfds[0].revents & POLLIN)) {
+      continue;
+    }
+    ssize_t length = read(g_inotify_fd, buffer, sizeof(buffer));
+    if (length <= 0 || !events_touch_config(buffer, length)) {
+      continue;
+    }
+
+    unsigned changed = config_reload();
+    if (changed != 0) {
+      LOG_INFO("config_watch: %s edited, applying changes 0x%02X", g_name,
+               changed);
+      g_callback(changed);
+    }
+  }
+  return NULL;
+}
+
+// ============================================================================
+// Control
+// ============================================================================
+
+int config_watch_start(ConfigWatchCallback callback) {
+  if (g_running || callback == NULL) {
+    return -1;
+  }
+
+  // Watch the directory: saves replace the file, which would end a watch
+  // on the file itself
+  const char *path = config_get_path();
+  char dir[256];
+  const char *slash = strrchr(path, '/');
+  if (slash != NULL) {
+    snprintf(dir, sizeof(dir), "%.*s", (int)(slash - path), path);
+    snprintf(g_name, sizeof(g_name), "%s", slash + 1);
+  } else {
+    snprintf(dir, sizeof(dir), ".");
+    snprintf(g_name, sizeof(g_name), "%s", path);
+  }
+
+  g_inotify_fd = inotify_init1(IN_CLOEXEC);
+  if (g_inotify_fd < 0) {
+    LOG_ERROR("config_watch: inotify unavailable, edits need a restart");
+    return -1;
+  }
+  if (inotify_add_watch(g_inotify_fd, dir[0] ? dir : "/",
+                        IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+    LOG_ERROR("config_watch: Cannot watch %s", dir);
+    close(g_inotify_fd);
+    g_inotify_fd = -1;
+    return -1;
+  }
+
+  if (pipe(g_stop_pipe) != 0) {
+    LOG_ERROR("config_watch: Cannot create stop pipe");
+    close(g_inotify_fd);
+    g_inotify_fd = -1;
+    return -1;
+  }
+
+  g_callback = callback;
+  g_running = true;
+  if (pthread_create(&g_watch_thread, NULL, watch_thread_func, NULL) != 0) {
+    LOG_ERROR("config_watch: pthread_create failed");
+    g_running = false;
+    close(g_inotify_fd);
+    g_inotify_fd = -1;
+    close(g_stop_pipe[0]);
+    close(g_stop_pipe[1]);
+    g_stop_pipe[0] = g_stop_pipe[1] = -1;
+    return -1;
+  }
+  DEBUG_PRINT("config_watch: Watching %s\n", path);
+  return 0;
+}
+
+void config_watch_stop(void) {
+  if (!g_running) {
+    return;
+  }
+  g_running = false;
+  if (write(g_stop_pipe[1], "", 1) < 0) {
+    LOG_ERROR("config_watch: Cannot wake the watch thread");
+  }
+  pthread_join(g_watch_thread, NULL);
+  close(g_inotify_fd);
+  g_inotify_fd = -1;
+  close(g_stop_pipe[0]);
+  close(g_stop_pipe[1]);
+  g_stop_pipe[0] = g_stop_pipe[1] = -1;
+}
@@ -0,0 +1,150 @@
+/**
+ * @file cw.c
+ * @brief CW decoder readout implementation
+ */
+
+#include "cw.h"
+#include "comm.h"
+#include "hampod_core.h"
+#include "speech.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// ============================================================================
+// State
+// ============================================================================
+
+static bool g_active = false; // Guarded by g_cw_mutex
+static bool g_thread_running = false; // Guarded by g_control_mutex
+static pthread_t g_cw_thread;
+static pthread_mutex_t g_cw_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_cw_wake = PTHREAD_COND_INITIALIZER;
+
+// Keeps Firmware's decoder and the reading thread switched on and off
+// together: held while the decoder is told and the thread started or
+// joined
+static pthread_mutex_t g_control_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// ============================================================================
+// Internal Functions
+// ============================================================================
+
+// Drop the oldest words until the backlog fits CW_BACKLOG_MAX
+static void trim_backlog(char *backlog, size_t *len) {
+  if (*len <= CW_BACKLOG_MAX) {
+    return;
+  }
+  size_t cut = *len - CW_BACKLOG_MAX;
+  while (cut < *len && backlog[cut - 1] != ' ') {
+    cut++; // Not half a word
+  }
+  memmove(backlog, backlog + cut, *len - cut + 1);
+  *len -= cut;
+}
+
+static void *cw_thread_func(void *arg) {
+  (void)arg;
+  char backlog[CW_BACKLOG_MAX + COMM_MAX_DATA_LEN + 1] = "";
+  size_t len = 0;
+  unsigned int spoken_id = 0; // The last words queued, 0 if none
+
+  DEBUG_PRINT("cw: Started\n");
+
+  pthread_mutex_lock(&g_cw_mutex);
+  while (g_active) {
+    pthread_mutex_unlock(&g_cw_mutex);
+
+    char text[COMM_MAX_DATA_LEN];
+    if (comm_read_cw(text, sizeof(text), NULL, NULL) == HAMPOD_OK &&
+        text[0] != '\0') {
+      size_t n = strlen(text);
+      memcpy(backlog + len, text, n + 1);
+      len += n;
+      trim_backlog(backlog, &len);
+    }
+
+    // Whole words, once the words before them are done
+    char *end = strrchr(backlog, ' ');
+    if (end != NULL &&
+        (spoken_id == 0 || speech_wait_item(spoken_id, 0) == HAMPOD_OK)) {
+      *end = '\0';
+      if (end > backlog &&
+          speech_say_text_priority(backlog, SPEECH_BACKGROUND) == HAMPOD_OK) {
+        spoken_id = speech_last_id();
+      }
+      len -= (size_t)(end + 1 - backlog);
+      memmove(backlog, end + 1, len + 1);
+    }
+
+    struct timespec wake;
+    clock_gettime(CLOCK_REALTIME, &wake);
+    wake.tv_nsec += CW_POLL_MS * 1000000L;
+    if (wake.tv_nsec >= 1000000000L) {
+      wake.tv_sec++;
+      wake.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&g_cw_mutex);
+    if (g_active) {
+      pthread_cond_timedwait(&g_cw_wake, &g_cw_mutex, &wake);
+    }
+  }
+  pthread_mutex_unlock(&g_cw_mutex);
+
+  DEBUG_PRINT("cw: Stopped\n");
+  return NULL;
+}
+
+// ============================================================================
+// Control
+// ============================================================================
+
+int cw_start(void) {
+  pthread_mutex_lock(&g_control_mutex);
+  int result = 0;
+  if (!g_thread_running) {
+    if (comm_cw_decoder(true) != HAMPOD_OK) {
+      result = -1;
+    } else {
+      pthread_mutex_lock(&g_cw_mutex);
+      g_active = true;
+      pthread_mutex_unlock(&g_cw_mutex);
+      if (pthread_create(&g_cw_thread, NULL, cw_thread_func, NULL) == 0) {
+        g_thread_running = true;
+      } else {
+        fprintf(stderr, "cw_start: pthread_create failed\n");
+        pthread_mutex_lock(&g_cw_mutex);
+        g_active = false;
+        pthread_mutex_unlock(&g_cw_mutex);
+        comm_cw_decoder(false);
+        result = -1;
+      }
+    }
+  }
+  pthread_mutex_unlock(&g_control_mutex);
+  return result;
+}
+
+void cw_stop(void) {
+  pthread_mutex_lock(&g_control_mutex);
+  if (g_thread_running) {
+    pthread_mutex_lock(&g_cw_mutex);
+    g_active = false;
+    pthread_cond_signal(&g_cw_wake);
+    pthread_mutex_unlock(&g_cw_mutex);
+
+    pthread_join(g_cw_thread, NULL);
+    g_thread_running = false;
+    comm_cw_decoder(false);
+  }
+  pthread_mutex_unlock(&g_control_mutex);
+}
+
+bool cw_is_active(void) {
+  pthread_mutex_lock(&g_cw_mutex);
+  bool active = g_active;
+  pthread_mutex_unlock(&g_cw_mutex);
+  return active;
+}
@@ -0,0 +1,223 @@
+/**
+ * @file device_worker.c
+ * @brief Device command worker implementation
+ */
+
+#include "device_worker.h"
+#include "hampod_core.h"
+#include "hampod_metrics.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// ============================================================================
+// Internal Functions
+// ============================================================================
+
+// Next command to handle: cancelled ones first (they're quick), then the
+// highest priority, oldest first. Call with worker->mutex held.
+static int next_command(const DeviceWorker *worker) {
+  int best = -1;
+  for (int i = 0; i < DEVICE_QUEUE_SIZE; i++) {
+    const DeviceCommand *cmd = &worker->commands[i];
+    if (!cmd->in_use) {
+      continue;
+    }
+    if (cmd->cancelled) {
+      return i;
+    }
+    if (best < 0 || cmd->priority > worker->commands[best].priority ||
+        (cmd->priority == worker->commands[best].priority &&
+         (int)(cmd->seq - worker->commands[best].seq) < 0)) {
+      best = i;
+    }
+  }
+  return best;
+}
+
+// Mark queued commands with key cancelled. Call with worker->mutex held.
+static int cancel_key(DeviceWorker *worker, int key) {
+  int cancelled = 0;
+  for (int i = 0; i < DEVICE_QUEUE_SIZE; i++) {
+    DeviceCommand *cmd = &worker->commands[i];
+    if (cmd->in_use && !cmd->cancelled && cmd->key == key) {
+      cmd->cancelled = true;
+      cancelled++;
+    }
+  }
+  return cancelled;
+}
+
+static void *worker_thread_func(void *arg) {
+  DeviceWorker *worker = arg;
+  hampod_metrics_name_thread(worker->name);
+
+  DEBUG_PRINT("%s: Started\n", worker->name);
+
+  pthread_mutex_lock(&worker->mutex);
+  while (worker->active || worker->count > 0) {
+    int index = next_command(worker);
+    if (index < 0) {
+      pthread_cond_broadcast(&worker->idle);
+      pthread_cond_wait(&worker->wake, &worker->mutex);
+      continue;
+    }
+
+    // Run it with the queue unlocked so keys can queue more meanwhile
+    DeviceCommand cmd = worker->commands[index];
+    worker->commands[index].in_use = false;
+    worker->count--;
+    worker->busy = true;
+    bool stopping = !worker->active;
+    pthread_mutex_unlock(&worker->mutex);
+
+    int result = DEVICE_CMD_CANCELLED;
+    if (!cmd.cancelled && !stopping) {
+      result = cmd.run(cmd.arg);
+    }
+    if (cmd.done) {
+      cmd.done(result, cmd.arg);
+    }
+
+    pthread_mutex_lock(&worker->mutex);
+    worker->busy = false;
+  }
+  pthread_cond_broadcast(&worker->idle);
+  pthread_mutex_unlock(&worker->mutex);
+
+  DEBUG_PRINT("%s: Stopped\n", worker->name);
+  return NULL;
+}
+
+// ============================================================================
+// Lifecycle
+// ============================================================================
+
+int device_worker_start(DeviceWorker *worker) {
+  if (worker->active) {
+    fprintf(stderr, "device_worker_start: %s already running\n",
+            worker->name);
+    return -1;
+  }
+
+  worker->active = true;
+  int ret = pthread_create(&worker->thread, NULL, worker_thread_func, worker);
+  if (ret != 0) {
+    fprintf(stderr, "device_worker_start: pthread_create failed\n");
+    worker->active = false;
+    return -1;
+  }
+
+  DEBUG_PRINT("device_worker_start: %s started\n", worker->name);
+  return 0;
+}
+
+void device_worker_stop(DeviceWorker *worker) {
+  if (!worker->active) {
+    return;
+  }
+
+  pthread_mutex_lock(&worker->mutex);
+  worker->active = false;
+  pthread_cond_signal(&worker->wake);
+  pthread_mutex_unlock(&worker->mutex);
+  pthread_join(worker->thread, NULL);
+
+  DEBUG_PRINT("device_worker_stop: %s stopped\n", worker->name);
+}
+
+pthread_t device_worker_get_thread(const DeviceWorker *worker) {
+  return worker->thread;
+}
+
+// ============================================================================
+// Submitting
+// ============================================================================
+
+int device_worker_submit(DeviceWorker *worker, int priority, int key,
+                         DeviceCommandFn run, DeviceCommandDone done,
+                         const void *arg, size_t arg_size) {
+  if (run == NULL || arg_size > DEVICE_CMD_MAX_ARG) {
+    fprintf(stderr, "device_worker_submit: Bad command for %s\n",
+            worker->name);
+    return -1;
+  }
+
+  DeviceCommand cmd = {true, false, priority, key, 0, run, done, {0}};
+  if (arg != NULL && arg_size > 0) {
+    memcpy(cmd.arg, arg, arg_size);
+  }
+
+  pthread_mutex_lock(&worker->mutex);
+  if (!worker->active) {
+    pthread_mutex_unlock(&worker->mutex);
+    int result = run(cmd.arg);
+    if (done) {
+      done(result, cmd.arg);
+    }
+    return 0;
+  }
+
+  if (key != 0 && cancel_key(worker, key) > 0) {
+    DEBUG_PRINT("device_worker_submit: %s superseded command %d\n",
+                worker->name, key);
+  }
+
+  int slot = -1;
+  for (int i = 0; i < DEVICE_QUEUE_SIZE; i++) {
+    if (!worker->commands[i].in_use) {
+      slot = i;
+      break;
+    }
+  }
+  if (slot < 0) {
+    pthread_mutex_unlock(&worker->mutex);
+    fprintf(stderr, "device_worker_submit: %s queue full\n", worker->name);
+    return -1;
+  }
+
+  cmd.seq = worker->next_seq++;
+  worker->commands[slot] = cmd;
+  worker->count++;
+  pthread_cond_signal(&worker->wake);
+  pthread_mutex_unlock(&worker->mutex);
+  return 0;
+}
+
+int device_worker_cancel(DeviceWorker *worker, int key) {
+  pthread_mutex_lock(&worker->mutex);
+  int cancelled = cancel_key(worker, key);
+  if (cancelled > 0) {
+    pthread_cond_signal(&worker->wake);
+  }
+  pthread_mutex_unlock(&worker->mutex);
+  return cancelled;
+}
+
+bool device_worker_wait_idle(DeviceWorker *worker, int timeout_ms) {
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  if (timeout_ms > 0) {
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000L;
+    }
+  }
+
+  pthread_mutex_lock(&worker->mutex);
+  int rc = 0;
+  while ((worker->count > 0 || worker->busy) && rc != ETIMEDOUT) {
+    if (timeout_ms < 0) {
+      pthread_cond_wait(&worker->idle, &worker->mutex);
+    } else {
+      rc = pthread_cond_timedwait(&worker->idle, &worker->mutex, &deadline);
+    }
+  }
+  bool idle = worker->count == 0 && !worker->busy;
+  pthread_mutex_unlock(&worker->mutex);
+  return idle;
+}
@@ -0,0 +1,337 @@
+/**
+ * @file evloop.c
+ * @brief Single event loop implementation
+ */
+
+#include "evloop.h"
+#include "hampod_core.h"
+#include "hampod_metrics.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+// ============================================================================
+// State
+// ============================================================================
+
+#define EVLOOP_MAX_IO 4     // Main link and the direct keypad/audio channels
+#define EVLOOP_MAX_TIMERS 4
+#define EVLOOP_MAX_POSTS 32
+
+// What a g_epfd event is about: the Firmware channel set, the wake eventfd
+// or timer (n - EVLOOP_KEY_TIMER)
+#define EVLOOP_KEY_IO 0
+#define EVLOOP_KEY_WAKE 1
+#define EVLOOP_KEY_TIMER 2
+
+typedef struct {
+  int fd; // -1 when free
+  EvloopHandler handler;
+  void *arg;
+} EvloopSource;
+
+// Two epoll sets: the Firmware channels in g_io_epfd, which sits in g_epfd
+// with the timers and the wake eventfd, so evloop_pump() can wait on the
+// channels alone
+static int g_epfd = -1;
+static int g_io_epfd = -1;
+static int g_wake_fd = -1;
+static volatile bool g_running = false;
+static pthread_t g_thread;
+static __thread bool t_in_loop = false;
+
+// Guarded by g_mutex
+static pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
+static EvloopSource g_io[EVLOOP_MAX_IO];
+static EvloopSource g_timers[EVLOOP_MAX_TIMERS];
+static int g_timer_count = 0;
+static struct {
+  EvloopHandler handler;
+  void *arg;
+} g_posts[EVLOOP_MAX_POSTS];
+static int g_post_head = 0;
+static int g_post_count = 0;
+static bool g_wake_pending = false; // g_wake_fd written, not read yet
+
+// ============================================================================
+// Internal Functions
+// ============================================================================
+
+// Run the handlers of the readable Firmware channels
+static int serve_io(int timeout_ms) {
+  struct epoll_event events[EVLOOP_MAX_IO];
+  int n = epoll_wait(g_io_epfd, events, EVLOOP_MAX_IO, timeout_ms);
+  for (int i = 0; i < n; i++) {
+    // The fd is in the key too: a slot freed by an earlier handler in
+    // this batch (a channel closed) may hold another fd by now
+    int slot = (int)(events[i].data.u64 & 0xFF);
+    int fd = (int)(events[i].data.u64 >> 8);
+    pthread_mutex_lock(&g_mutex);
+    EvloopSource io = g_io[slot];
+    pthread_mutex_unlock(&g_mutex);
+    if (io.fd == fd) {
+      io.handler(io.arg);
+    }
+  }
+  return n > 0 ? n : 0;
+}
+
+// Run what was posted before this pass; what those post runs next pass
+static void run_posts(void) {
+  pthread_mutex_lock(&g_mutex);
+  int count = g_post_count;
+  pthread_mutex_unlock(&g_mutex);
+
+  while (count-- > 0) {
+    pthread_mutex_lock(&g_mutex);
+    EvloopHandler handler = g_posts[g_post_head].handler;
+    void *arg = g_posts[g_post_head].arg;
+    g_post_head = (g_post_head + 1) % EVLOOP_MAX_POSTS;
+    g_post_count--;
+    pthread_mutex_unlock(&g_mutex);
+    handler(arg);
+  }
+}
+
+static void *evloop_thread_func(void *arg) {
+  (void)arg;
+  t_in_loop = true;
+  hampod_metrics_name_thread("evloop");
+  LOG_INFO("Event loop started");
+
+  while (g_running) {
+    // Work posted by the last pass's posts is not waited for
+    pthread_mutex_lock(&g_mutex);
+    int timeout_ms = g_post_count > 0 ? 0 : -1;
+    pthread_mutex_unlock(&g_mutex);
+
+    struct epoll_event events[2 + EVLOOP_MAX_TIMERS];
+    int n = epoll_wait(g_epfd, events, 2 + EVLOOP_MAX_TIMERS, timeout_ms);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LOG_ERROR("Event loop: epoll_wait failed: %s", strerror(errno));
+      break;
+    }
+
+    for (int i = 0; i < n; i++) {
+      uint32_t key = events[i].data.u32;
+      uint64_t value;
+      if (key == EVLOOP_KEY_IO) {
+        serve_io(0);
+      } else if (key == EVLOOP_KEY_WAKE) {
+        pthread_mutex_lock(&g_mutex);
+        g_wake_pending = false;
+        pthread_mutex_unlock(&g_mutex);
+        if (read(g_wake_fd, &value, sizeof(value)) < 0) {
+          LOG_DEBUG("Event loop: Nothing to read on the wake fd");
+        }
+      } else {
+        pthread_mutex_lock(&g_mutex);
+        EvloopSource timer = g_timers[key - EVLOOP_KEY_TIMER];
+        pthread_mutex_unlock(&g_mutex);
+        // Not expired after all if it was re-armed meanwhile
+        if (read(timer.fd, &value, sizeof(value)) == sizeof(value)) {
+          timer.handler(timer.arg);
+        }
+      }
+    }
+    run_posts();
+  }
+
+  LOG_INFO("Event loop exiting");
+  return NULL;
+}
+
+static int epoll_add(int epfd, int fd, uint64_t key) {
+  struct epoll_event event = {.events = EPOLLIN, .data.u64 = key};
+  return epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &event);
+}
+
+static void close_fd(int *fd) {
+  if (*fd >= 0) {
+    close(*fd);
+    *fd = -1;
+  }
+}
+
+// ============================================================================
+// Control
+// ============================================================================
+
+int evloop_start(void) {
+  if (g_running) {
+    return -1;
+  }
+
+  g_epfd = epoll_create1(EPOLL_CLOEXEC);
+  g_io_epfd = epoll_create1(EPOLL_CLOEXEC);
+  g_wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (g_epfd < 0 || g_io_epfd < 0 || g_wake_fd < 0 ||
+      epoll_add(g_epfd, g_io_epfd, EVLOOP_KEY_IO) != 0 ||
+      epoll_add(g_epfd, g_wake_fd, EVLOOP_KEY_WAKE) != 0) {
+    LOG_ERROR("Event loop: Cannot set up epoll: %s", strerror(errno));
+    close_fd(&g_epfd);
+    close_fd(&g_io_epfd);
+    close_fd(&g_wake_fd);
+    return -1;
+  }
+
+  for (int i = 0; i < EVLOOP_MAX_IO; i++) {
+    g_io[i].fd = -1;
+  }
+  g_timer_count = 0;
+  g_post_head = 0;
+  g_post_count = 0;
+  g_wake_pending = false;
+
+  g_running = true;
+  if (pthread_create(&g_thread, NULL, evloop_thread_func, NULL) != 0) {
+    LOG_ERROR("Event loop: pthread_create failed");
+    g_running = false;
+    close_fd(&g_epfd);
+    close_fd(&g_io_epfd);
+    close_fd(&g_wake_fd);
+    return -1;
+  }
+  return 0;
+}
+
+void evloop_stop(void) {
+  if (!g_running) {
+    return;
+  }
+
+  g_running = false;
+  uint64_t one = 1;
+  if (write(g_wake_fd, &one, sizeof(one)) < 0) {
+    LOG_ERROR("Event loop: Cannot wake the loop thread");
+  }
+  pthread_join(g_thread, NULL);
+
+  pthread_mutex_lock(&g_mutex);
+  for (int i = 0; i < g_timer_count; i++) {
+    close_fd(&g_timers[i].fd);
+  }
+  g_timer_count = 0;
+  g_post_count = 0;
+  pthread_mutex_unlock(&g_mutex);
+  close_fd(&g_epfd);
+  close_fd(&g_io_epfd);
+  close_fd(&g_wake_fd);
+}
+
+bool evloop_running(void) { return g_running; }
+
+bool evloop_in_loop(void) { return t_in_loop; }
+
+pthread_t evloop_get_thread(void) { return g_thread; }
+
+// ============================================================================
+// Sources
+// ============================================================================
+
+int evloop_add_io(int fd, EvloopHandler handler, void *arg) {
+  pthread_mutex_lock(&g_mutex);
+  int slot = 0;
+  while (slot < EVLOOP_MAX_IO && g_io[slot].fd != -1) {
+    slot++;
+  }
+  if (!g_running || slot == EVLOOP_MAX_IO ||
+      epoll_add(g_io_epfd, fd, ((uint64_t)fd << 8) | (uint64_t)slot) != 0) {
+    pthread_mutex_unlock(&g_mutex);
+    LOG_ERROR("Event loop: Cannot watch fd %d", fd);
+    return -1;
+  }
+  g_io[slot] = (EvloopSource){fd, handler, arg};
+  pthread_mutex_unlock(&g_mutex);
+  return 0;
+}
+
+void evloop_remove_io(int fd) {
+  pthread_mutex_lock(&g_mutex);
+  for (int i = 0; i < EVLOOP_MAX_IO; i++) {
+    if (g_io[i].fd == fd && fd >= 0) {
+      epoll_ctl(g_io_epfd, EPOLL_CTL_DEL, fd, NULL);
+      g_io[i].fd = -1;
+    }
+  }
+  pthread_mutex_unlock(&g_mutex);
+}
+
+int evloop_add_timer(EvloopHandler handler, void *arg) {
+  pthread_mutex_lock(&g_mutex);
+  int timer = g_timer_count;
+  int fd = -1;
+  if (g_running && timer < EVLOOP_MAX_TIMERS) {
+    fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+  }
+  if (fd < 0 || epoll_add(g_epfd, fd, EVLOOP_KEY_TIMER + timer) != 0) {
+    pthread_mutex_unlock(&g_mutex);
+    if (fd >= 0) {
+      close(fd);
+    }
+    LOG_ERROR("Event loop: Cannot add a timer");
+    return -1;
+  }
+  g_timers[timer] = (EvloopSource){fd, handler, arg};
+  g_timer_count++;
+  pthread_mutex_unlock(&g_mutex);
+  return timer;
+}
+
+void evloop_arm_timer(int timer, int delay_ms) {
+  if (timer < 0 || timer >= g_timer_count) {
+    return;
+  }
+  // A zero it_value disarms, so "now" is one nanosecond
+  struct itimerspec spec = {0};
+  if (delay_ms > 0) {
+    spec.it_value.tv_sec = delay_ms / 1000;
+    spec.it_value.tv_nsec = (long)(delay_ms % 1000) * 1000000L;
+  } else if (delay_ms == 0) {
+    spec.it_value.tv_nsec = 1;
+  }
+  timerfd_settime(g_timers[timer].fd, 0, &spec, NULL);
+}
+
+int evloop_post(EvloopHandler handler, void *arg) {
+  pthread_mutex_lock(&g_mutex);
+  if (!g_running || g_post_count >= EVLOOP_MAX_POSTS) {
+    pthread_mutex_unlock(&g_mutex);
+    return -1;
+  }
+  int tail = (g_post_head + g_post_count) % EVLOOP_MAX_POSTS;
+  g_posts[tail].handler = handler;
+  g_posts[tail].arg = arg;
+  g_post_count++;
+
+  // The loop runs posts after every pass, so it only needs waking from
+  // other threads
+  bool wake = !t_in_loop && !g_wake_pending;
+  if (wake) {
+    g_wake_pending = true;
+  }
+  pthread_mutex_unlock(&g_mutex);
+
+  uint64_t one = 1;
+  if (wake && write(g_wake_fd, &one, sizeof(one)) < 0) {
+    LOG_ERROR("Event loop: Cannot wake the loop thread");
+  }
+  return 0;
+}
+
+int evloop_pump(int timeout_ms) {
+  if (!t_in_loop) {
+    return -1;
+  }
+  return serve_io(timeout_ms);
+}
@@ -6,12 +6,14 @@
  */
 
 #include "frequency_mode.h"
+#include "announce.h"
 #include "comm.h"
 #include "config.h"
 #include "hampod_core.h"
 #include "normal_mode.h"
 #include "radio.h"
 #include "radio_queries.h"
+#include "radio_worker.h"
 #include "speech.h"
 
 #include <ctype.h>
@@ -40,6 +42,15 @@ static time_t g_last_activity = 0;
 // Suppress polling announcement after user sets frequency
 static bool g_suppress_next_poll = false;
 
+// Announce the next one even with auto-announcements off (keypad tuning)
+static bool g_announce_next_poll = false;
+
+// Last frequency read out, which frequency_diff announces dial changes
+// against. After a pause this long the next change is read in full.
+#define FREQ_DIFF_RESYNC_MS 5000
+static double g_last_said_hz = 0;
+static long long g_last_said_ms = 0;
+
 // ============================================================================
 // Internal Helpers
 // ============================================================================
@@ -63,49 +74,43 @@ static void clear_freq_buffer(void) {
   g_has_decimal = false;
 }
 
-static void announce_digit(char digit) {
-  char text[16];
-  snprintf(text, sizeof(text), "%c", digit);
-  speech_say_text(text);
+// Echo a typed digit, or "POINT", from Firmware's RAM clips at beep
+// latency; each echo cuts off the one before
+static void echo_key(const char *clip_name) {
+  char clip[32];
+  snprintf(clip, sizeof(clip), "pregen_audio/%s", clip_name);
+  comm_play_echo(clip);
 }
 
-static void announce_frequency(double freq_hz) {
-  // Convert Hz to MHz and format for speech
-  // Need 5 decimal places for 10 Hz resolution (e.g., 14.25000)
-  double freq_mhz = freq_hz / 1000000.0;
-
-  // Format as "14 point 2 5 0 0 0 megahertz" (spell out decimals)
-  char text[128];
-  int mhz_part = (int)freq_mhz;
-
-  // Get 5 decimal places (10 Hz resolution = 5 digits after decimal)
-  // e.g., 14.250000 MHz -> decimals = 25000
-  // Use truncation (not rounding) to match radio display behavior
-  // Add tiny epsilon to handle floating-point representation errors
-  // (e.g., 12345.0 represented as 12344.99999...)
-  int decimals = (int)((freq_mhz - mhz_part) * 100000 + 0.0001);
+static void announce_digit(char digit) {
+  char name[2] = {digit, '\0'};
+  echo_key(name);
+}
 
-  if (decimals == 0) {
-    snprintf(text, sizeof(text), "%d megahertz", mhz_part);
-  } else {
-    // Spell out each decimal digit for clarity
-    // e.g., 14.25000 -> "14 point 2 5 0 0 0 megahertz"
-    char decimal_str[16];
-    snprintf(decimal_str, sizeof(decimal_str), "%05d", decimals);
-
-    // Build spoken string with spaces between digits
-    char spoken_decimals[32] = "";
-    for (int i = 0; i < 5; i++) {
-      char digit[4];
-      snprintf(digit, sizeof(digit), "%c ", decimal_str[i]);
-      strcat(spoken_decimals, digit);
-    }
+static long long now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
 
-    snprintf(text, sizeof(text), "%d point %s megahertz", mhz_part,
-             spoken_decimals);
+// A dial change with frequency_diff on, soon after the last readout, only
+// says what changed (announce_frequency_change())
+static void say_frequency(double freq_hz, SpeechPriority priority,
+                          bool diff) {
+  Announcement a;
+  announce_init(&a);
+  int result = diff ? announce_frequency_change(&a, g_last_said_hz, freq_hz)
+                    : announce_frequency(&a, freq_hz);
+  if (result != HAMPOD_OK) {
+    return;
   }
+  g_last_said_hz = freq_hz;
+  g_last_said_ms = now_ms();
 
-  speech_say_text(text);
+  // Only the latest readout is worth hearing; one from the dial also
+  // cuts off the one it makes stale
+  announce_say_latest(&a, priority, SPEECH_SLOT_FREQUENCY,
+                      priority == SPEECH_BACKGROUND);
 }
 
 static double parse_frequency(void) {
@@ -143,55 +148,106 @@ static double parse_frequency(void) {
   return freq_mhz * 1000000.0; // Convert to Hz
 }
 
-static void submit_frequency(void) {
+// Have the read-back of what has been typed so far synthesized while the
+// operator goes on typing. Most of its words (digits, "point", the unit)
+// are cached from start-up; the whole megahertz, such as "144", is
+// usually not, and would otherwise be synthesized after the submit. If
+// the radio reads back something else, that is synthesized as usual.
+static void anticipate_readback(void) {
   double freq_hz = parse_frequency();
-
   if (freq_hz < 0) {
-    if (config_get_key_beep_enabled()) {
-      comm_play_beep(COMM_BEEP_ERROR);
-    }
-    speech_say_text("Invalid frequency");
-    clear_freq_buffer();
-    g_state = FREQ_MODE_IDLE;
     return;
   }
+  Announcement a;
+  announce_init(&a);
+  if (announce_frequency(&a, freq_hz) == HAMPOD_OK) {
+    announce_warm(&a);
+  }
+}
 
-  DEBUG_PRINT("submit_frequency: %.3f MHz to %s\n", freq_hz / 1000000.0,
-              vfo_name(g_selected_vfo));
+// Radio command for a submitted frequency, run on the radio worker
+typedef struct {
+  double freq_hz;
+  VfoSelection vfo;
+} FreqCommand;
 
-  // Suppress the polling announcement for this frequency change
-  g_suppress_next_poll = true;
+#define FREQ_CMD_VFO_FAILED 1 // Result when the VFO switch failed
+
+static int run_set_frequency(void *arg) {
+  const FreqCommand *cmd = arg;
 
   // Switch to selected VFO first (if not current)
-  if (g_selected_vfo != VFO_CURRENT) {
-    RadioVfo target_vfo = (g_selected_vfo == VFO_A) ? RADIO_VFO_A : RADIO_VFO_B;
+  if (cmd->vfo != VFO_CURRENT) {
+    RadioVfo target_vfo = (cmd->vfo == VFO_A) ? RADIO_VFO_A : RADIO_VFO_B;
     if (radio_set_vfo(target_vfo) != 0) {
-      if (config_get_key_beep_enabled()) {
-        comm_play_beep(COMM_BEEP_ERROR);
-      }
-      speech_say_text("VFO switch failed");
-      clear_freq_buffer();
-      g_state = FREQ_MODE_IDLE;
-      return;
+      return FREQ_CMD_VFO_FAILED;
     }
   }
 
-  // Set frequency on radio
-  if (radio_set_frequency(freq_hz) == 0) {
+  return radio_set_frequency(cmd->freq_hz);
+}
+
+static void set_frequency_done(int result, void *arg) {
+  const FreqCommand *cmd = arg;
+
+  if (result == RADIO_CMD_CANCELLED) {
+    return;
+  }
+  if (result == 0) {
     // Read back from radio to confirm what was actually set
     double actual_freq = radio_get_frequency();
     if (actual_freq > 0) {
-      announce_frequency(actual_freq);
+      say_frequency(actual_freq, SPEECH_INTERACTIVE, false);
     } else {
       // Fallback to announcing what we sent if readback fails
-      announce_frequency(freq_hz);
+      say_frequency(cmd->freq_hz, SPEECH_INTERACTIVE, false);
     }
-  } else {
+    return;
+  }
+
+  if (config_get_key_beep_enabled()) {
+    comm_play_beep(COMM_BEEP_ERROR);
+  }
+  speech_say_text_priority(result == FREQ_CMD_VFO_FAILED
+                               ? "VFO switch failed"
+                               : "Failed to set frequency",
+                           SPEECH_URGENT);
+}
+
+static void set_frequency(double freq_hz, VfoSelection vfo) {
+  DEBUG_PRINT("set_frequency: %.3f MHz to %s\n", freq_hz / 1000000.0,
+              vfo_name(vfo));
+
+  // Suppress the polling announcement for this frequency change
+  g_suppress_next_poll = true;
+
+  // Set it on the radio worker; a newer frequency replaces this one if it
+  // hasn't been sent yet
+  FreqCommand cmd = {freq_hz, vfo};
+  if (radio_worker_submit(RADIO_CMD_USER, RADIO_KEY_FREQUENCY,
+                          run_set_frequency, set_frequency_done, &cmd,
+                          sizeof(cmd)) != 0) {
     if (config_get_key_beep_enabled()) {
       comm_play_beep(COMM_BEEP_ERROR);
     }
-    speech_say_text("Failed to set frequency");
+    speech_say_text_priority("Failed to set frequency", SPEECH_URGENT);
   }
+}
+
+static void submit_frequency(void) {
+  double freq_hz = parse_frequency();
+
+  if (freq_hz < 0) {
+    if (config_get_key_beep_enabled()) {
+      comm_play_beep(COMM_BEEP_ERROR);
+    }
+    speech_say_text("Invalid frequency");
+    clear_freq_buffer();
+    g_state = FREQ_MODE_IDLE;
+    return;
+  }
+
+  set_frequency(freq_hz, g_selected_vfo);
 
   clear_freq_buffer();
   g_state = FREQ_MODE_IDLE;
@@ -205,6 +261,8 @@ void frequency_mode_init(void) {
   g_state = FREQ_MODE_IDLE;
   g_selected_vfo = VFO_CURRENT;
   clear_freq_buffer();
+  g_last_said_hz = 0;
+  g_last_said_ms = 0;
   DEBUG_PRINT("frequency_mode_init: Initialized\n");
 }
 
@@ -246,7 +304,10 @@ bool frequency_mode_handle_key(char key, bool is_hold) {
     if (key == '#') {
       // Cycle VFO selection
       g_selected_vfo = (g_selected_vfo + 1) % 3;
-      speech_say_text(vfo_name(g_selected_vfo));
+      Announcement a;
+      announce_init(&a);
+      announce_vfo(&a, vfo_name(g_selected_vfo));
+      announce_say(&a, SPEECH_INTERACTIVE);
       return true;
     }
     if (isdigit(key)) {
@@ -255,6 +316,7 @@ bool frequency_mode_handle_key(char key, bool is_hold) {
       g_freq_buffer[g_freq_len++] = key;
       g_freq_buffer[g_freq_len] = '\0';
       announce_digit(key);
+      anticipate_readback();
       return true;
     }
     if (key == '*') {
@@ -284,6 +346,7 @@ bool frequency_mode_handle_key(char key, bool is_hold) {
         g_freq_buffer[g_freq_len++] = key;
         g_freq_buffer[g_freq_len] = '\0';
         announce_digit(key);
+        anticipate_readback();
       }
       return true;
     }
@@ -294,7 +357,7 @@ bool frequency_mode_handle_key(char key, bool is_hold) {
           g_freq_buffer[g_freq_len++] = '.';
           g_freq_buffer[g_freq_len] = '\0';
           g_has_decimal = true;
-          speech_say_text("point");
+          echo_key("POINT");
         }
       } else {
         // Second * cancels
@@ -352,7 +415,9 @@ void frequency_mode_on_radio_change(double new_freq) {
     }
 
     // Check if announcements are enabled (from normal_mode)
-    if (!normal_mode_get_verbosity()) {
+    bool forced = g_announce_next_poll;
+    g_announce_next_poll = false;
+    if (!forced && !normal_mode_get_verbosity()) {
       DEBUG_PRINT(
           "frequency_mode_on_radio_change: Suppressed (verbosity off)\n");
       return;
@@ -360,7 +425,10 @@ void frequency_mode_on_radio_change(double new_freq) {
 
     DEBUG_PRINT("frequency_mode_on_radio_change: %.3f MHz\n",
                 new_freq / 1000000.0);
-    announce_frequency(new_freq);
+    // The first change after a pause is read in full
+    bool diff = config_get_frequency_diff() &&
+                now_ms() - g_last_said_ms < FREQ_DIFF_RESYNC_MS;
+    say_frequency(new_freq, SPEECH_BACKGROUND, diff);
   }
 }
 
@@ -368,3 +436,12 @@ void frequency_mode_suppress_next_poll(void) {
   g_suppress_next_poll = true;
   DEBUG_PRINT("frequency_mode_suppress_next_poll: armed\n");
 }
+
+void frequency_mode_tune(double freq_hz) {
+  set_frequency(freq_hz, VFO_CURRENT);
+}
+
+void frequency_mode_announce_next_poll(void) {
+  g_suppress_next_poll = false;
+  g_announce_next_poll = true;
+}
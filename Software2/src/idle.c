@@ -0,0 +1,251 @@
+/**
+ * @file idle.c
+ * @brief Housekeeping timer and idle mode implementation
+ */
+
+#include "idle.h"
+#include "hampod_core.h"
+#include "hampod_metrics.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+// ============================================================================
+// State
+// ============================================================================
+
+#define IDLE_MAX_JOBS 8
+#define IDLE_RATE_PERIOD_MS 10000 // Between idle_wakeups_per_second updates
+
+typedef struct {
+  IdleJob job;
+  void *arg;
+  int period_ms;
+  int idle_period_ms;
+  long long last_ms; // When it last ran
+  long long next_ms; // When it runs next
+} IdleEntry;
+
+static bool g_enabled = false;
+static int g_after_ms = 0;
+static long long g_activity_ms = 0; // Atomic; last idle_note_activity()
+static unsigned long long g_idle_wakeups = 0; // Atomic
+
+// Guarded by g_mutex
+static IdleEntry g_jobs[IDLE_MAX_JOBS];
+static int g_job_count = 0;
+static bool g_running = false;
+static bool g_was_idle = false; // The last schedule used the idle periods
+static bool g_reschedule = false;
+static pthread_t g_thread;
+static pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_wake; // On CLOCK_MONOTONIC, set up at start
+
+// ============================================================================
+// Internal Functions
+// ============================================================================
+
+static long long now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Publish the idle wakeup rate since the last run
+static bool publish_rate(void *arg) {
+  (void)arg;
+  static unsigned long long last_count = 0;
+  static long long last_ms = 0;
+
+  unsigned long long count =
+      __atomic_load_n(&g_idle_wakeups, __ATOMIC_RELAXED);
+  long long now = now_ms();
+  if (last_ms != 0 && now > last_ms) {
+    hampod_metric_set(METRIC_IDLE_WAKEUP_RATE,
+                      (int64_t)((count - last_count) * 1000 / (now - last_ms)));
+  }
+  last_count = count;
+  last_ms = now;
+  return true;
+}
+
+static void *idle_thread_func(void *arg) {
+  (void)arg;
+  hampod_metrics_name_thread("idle-timer");
+  DEBUG_PRINT("idle: Timer started\n");
+
+  pthread_mutex_lock(&g_mutex);
+  while (g_running) {
+    long long now = now_ms();
+    bool idle = idle_is_idle();
+
+    // Back from idle: whatever was put off to the idle period is due at
+    // its normal one
+    if (g_reschedule || g_was_idle != idle) {
+      for (int i = 0; i < g_job_count && !idle; i++) {
+        IdleEntry *e = &g_jobs[i];
+        if (e->last_ms + e->period_ms < e->next_ms) {
+          e->next_ms = e->last_ms + e->period_ms;
+        }
+      }
+      g_reschedule = false;
+      g_was_idle = idle;
+    }
+
+    long long next_ms = now + IDLE_RATE_PERIOD_MS;
+    bool ran = false;
+    bool useful = false;
+    for (int i = 0; i < g_job_count; i++) {
+      IdleEntry *e = &g_jobs[i];
+      if (e->next_ms <= now) {
+        IdleJob job = e->job;
+        void *job_arg = e->arg;
+        pthread_mutex_unlock(&g_mutex);
+        useful |= job(job_arg);
+        pthread_mutex_lock(&g_mutex);
+        ran = true;
+        e->last_ms = now;
+        e->next_ms = now + idle_stretch_ms(e->period_ms, e->idle_period_ms);
+      }
+      if (e->next_ms < next_ms) {
+        next_ms = e->next_ms;
+      }
+    }
+    if (ran) {
+      idle_note_wakeup(useful);
+    }
+
+    struct timespec deadline = {.tv_sec = next_ms / 1000,
+                                .tv_nsec = (next_ms % 1000) * 1000000L};
+    if (g_running && !g_reschedule) {
+      pthread_cond_timedwait(&g_wake, &g_mutex, &deadline);
+    }
+  }
+  pthread_mutex_unlock(&g_mutex);
+
+  DEBUG_PRINT("idle: Timer stopped\n");
+  return NULL;
+}
+
+// Called holding g_mutex
+static int idle_start_locked(void) {
+  if (g_running) {
+    return 0;
+  }
+
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&g_wake, &attr);
+  pthread_condattr_destroy(&attr);
+
+  g_running = true;
+  if (pthread_create(&g_thread, NULL, idle_thread_func, NULL) != 0) {
+    fprintf(stderr, "idle: pthread_create failed\n");
+    g_running = false;
+    pthread_cond_destroy(&g_wake);
+    return -1;
+  }
+  return 0;
+}
+
+// Called holding g_mutex
+static int idle_add_locked(IdleJob job, void *arg, int period_ms,
+                           int idle_period_ms) {
+  if (g_job_count >= IDLE_MAX_JOBS) {
+    fprintf(stderr, "idle: Too many housekeeping jobs\n");
+    return -1;
+  }
+  long long now = now_ms();
+  g_jobs[g_job_count++] = (IdleEntry){
+      .job = job,
+      .arg = arg,
+      .period_ms = period_ms,
+      .idle_period_ms = idle_period_ms < period_ms ? period_ms : idle_period_ms,
+      .last_ms = now,
+      .next_ms = now + period_ms,
+  };
+  return 0;
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+void idle_set_mode(bool enabled, int after_ms) {
+  __atomic_store_n(&g_after_ms, after_ms, __ATOMIC_RELAXED);
+  __atomic_store_n(&g_enabled, enabled, __ATOMIC_RELAXED);
+  idle_note_activity();
+}
+
+void idle_note_activity(void) {
+  __atomic_store_n(&g_activity_ms, now_ms(), __ATOMIC_RELAXED);
+
+  pthread_mutex_lock(&g_mutex);
+  if (g_was_idle && g_running) {
+    g_reschedule = true;
+    pthread_cond_signal(&g_wake);
+  }
+  pthread_mutex_unlock(&g_mutex);
+}
+
+bool idle_is_idle(void) {
+  return __atomic_load_n(&g_enabled, __ATOMIC_RELAXED) &&
+         now_ms() - __atomic_load_n(&g_activity_ms, __ATOMIC_RELAXED) >=
+             __atomic_load_n(&g_after_ms, __ATOMIC_RELAXED);
+}
+
+int idle_stretch_ms(int active_ms, int idle_ms) {
+  return idle_is_idle() && idle_ms > active_ms ? idle_ms : active_ms;
+}
+
+void idle_note_wakeup(bool useful) {
+  if (!useful) {
+    __atomic_add_fetch(&g_idle_wakeups, 1, __ATOMIC_RELAXED);
+    hampod_metric_add(METRIC_IDLE_WAKEUPS, 1);
+  }
+}
+
+int idle_add_job(IdleJob job, void *arg, int period_ms, int idle_period_ms) {
+  pthread_mutex_lock(&g_mutex);
+  int result = 0;
+  if (g_job_count == 0) {
+    result = idle_add_locked(publish_rate, NULL, IDLE_RATE_PERIOD_MS,
+                             IDLE_RATE_PERIOD_MS);
+  }
+  if (result == 0) {
+    result = idle_add_locked(job, arg, period_ms, idle_period_ms);
+  }
+  if (result == 0) {
+    result = idle_start_locked();
+  }
+  if (g_running) {
+    pthread_cond_signal(&g_wake); // Schedule the new job
+  }
+  pthread_mutex_unlock(&g_mutex);
+  return result;
+}
+
+void idle_shutdown(void) {
+  pthread_mutex_lock(&g_mutex);
+  bool running = g_running;
+  g_running = false;
+  if (running) {
+    pthread_cond_signal(&g_wake);
+  }
+  pthread_mutex_unlock(&g_mutex);
+
+  if (running) {
+    pthread_join(g_thread, NULL);
+    pthread_cond_destroy(&g_wake);
+  }
+
+  pthread_mutex_lock(&g_mutex);
+  g_job_count = 0;
+  g_was_idle = false;
+  g_reschedule = false;
+  pthread_mutex_unlock(&g_mutex);
+  hampod_metric_set(METRIC_IDLE_WAKEUP_RATE, 0);
+}
@@ -0,0 +1,368 @@
+/**
+ * @file keymap.c
+ * @brief Key binding table implementation
+ */
+
+#include "keymap.h"
+#include "hampod_core.h"
+
+#include <ctype.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ============================================================================
+// State
+// ============================================================================
+
+#define KEYMAP_KEYS 16      // 0-9, A-D, * and #
+#define KEYMAP_BINDINGS 256 // Built-in and file bindings, all models
+
+static const char g_keys[KEYMAP_KEYS + 1] = "0123456789ABCD*#";
+
+typedef struct {
+  int model; // 0 for every radio
+  uint8_t mode;
+  uint8_t key;
+  bool hold;
+  bool shift;
+  uint8_t action;
+  uint8_t macro; // g_macros index, for an action that takes a name
+} Binding;
+
+// Everything loaded, in order: built-in first, then the file
+static Binding g_bindings[KEYMAP_BINDINGS];
+static int g_binding_count = 0;
+
+// Macros named in the file, defined or only bound
+static KeymapMacro g_macros[KEYMAP_MACROS];
+static int g_macro_count = 0;
+
+// The selected model's bindings, one lookup per key press
+static uint8_t g_table[KEYMAP_MODE_COUNT][KEYMAP_KEYS][2][2];
+static uint8_t g_macro_table[KEYMAP_MODE_COUNT][KEYMAP_KEYS][2][2];
+
+static pthread_mutex_t g_keymap_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *const g_mode_names[KEYMAP_MODE_COUNT] = {
+    [KEYMAP_MODE_GLOBAL] = "global",
+    [KEYMAP_MODE_NORMAL] = "normal",
+};
+
+static const char *const g_action_names[KEYMAP_ACTION_COUNT] = {
+    [KEYMAP_NONE] = "none",
+    [KEYMAP_SHIFT] = "shift",
+    [KEYMAP_SET_MODE] = "set_mode",
+    [KEYMAP_VFO_A] = "vfo_a",
+    [KEYMAP_VFO_B] = "vfo_b",
+    [KEYMAP_VOX_STATUS] = "vox_status",
+    [KEYMAP_FREQUENCY] = "frequency",
+    [KEYMAP_MODE] = "mode",
+    [KEYMAP_PREAMP] = "preamp",
+    [KEYMAP_AGC] = "agc",
+    [KEYMAP_ATTENUATION] = "attenuation",
+    [KEYMAP_NOISE_BLANKER] = "noise_blanker",
+    [KEYMAP_NOISE_REDUCTION] = "noise_reduction",
+    [KEYMAP_MIC_GAIN] = "mic_gain",
+    [KEYMAP_COMPRESSION] = "compression",
+    [KEYMAP_POWER] = "power",
+    [KEYMAP_SMETER] = "smeter",
+    [KEYMAP_POWER_METER] = "power_meter",
+    [KEYMAP_TUNING_TONE] = "tuning_tone",
+    [KEYMAP_NEXT_RADIO] = "next_radio",
+    [KEYMAP_VERBOSITY] = "verbosity",
+    [KEYMAP_CONFIG_MODE] = "config_mode",
+    [KEYMAP_BAND_UP] = "band_up",
+    [KEYMAP_BAND_DOWN] = "band_down",
+    [KEYMAP_SCAN] = "scan",
+    [KEYMAP_SCAN_MEMORIES] = "scan_memories",
+    [KEYMAP_TUNE_UP] = "tune_up",
+    [KEYMAP_TUNE_DOWN] = "tune_down",
+    [KEYMAP_TUNE_STEP] = "tune_step",
+    [KEYMAP_NEXT_DEVICE] = "next_device",
+    [KEYMAP_MEMORIES] = "memories",
+    [KEYMAP_CW_DECODE] = "cw_decode",
+    [KEYMAP_SAY_AGAIN] = "say_again",
+    [KEYMAP_MACRO] = "macro",
+    [KEYMAP_PROFILE] = "profile",
+    [KEYMAP_PROFILE_SAVE] = "save_profile",
+};
+
+// The standard layout, in the file's format
+static const char *const g_builtin[] = {
+    "global A press shift",
+    "global B press set_mode",
+    "global D hold next_device",
+    "normal 1 press vfo_a",
+    "normal 1 hold vfo_b",
+    "normal 1 shift vox_status",
+    "normal 2 press frequency",
+    "normal 2 hold memories",
+    "normal 0 press mode",
+    "normal 0 hold cw_decode",
+    "normal 3 press tune_up",
+    "normal 3 hold tune_up",
+    "normal 3 shift tune_down",
+    "normal 3 shift_hold tune_down",
+    "normal 4 press preamp",
+    "normal 4 hold agc",
+    "normal 4 shift attenuation",
+    "normal 5 press scan",
+    "normal 5 hold scan_memories",
+    "normal 6 press band_up",
+    "normal 6 hold band_down",
+    "normal 7 press noise_blanker",
+    "normal 7 hold tune_step",
+    "normal 8 press noise_reduction",
+    "normal 8 hold mic_gain",
+    "normal 9 hold power",
+    "normal 9 shift compression",
+    "normal * press smeter",
+    "normal * hold power_meter",
+    "normal * shift tuning_tone",
+    "normal D press next_radio",
+    "normal C press verbosity",
+    "normal C hold config_mode",
+};
+#define BUILTIN_COUNT (int)(sizeof(g_builtin) / sizeof(g_builtin[0]))
+
+// ============================================================================
+// Internal Functions
+// ============================================================================
+
+static int name_index(const char *const *names, int count, const char *name) {
+  for (int i = 0; i < count; i++) {
+    if (names[i] && strcmp(names[i], name) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static int key_index(char key) {
+  const char *p = key != '\0' ? strchr(g_keys, key) : NULL;
+  return p ? (int)(p - g_keys) : -1;
+}
+
+// Actions bound with a name after them, kept in g_macros
+static bool takes_name(int action) {
+  return action == KEYMAP_MACRO || action == KEYMAP_PROFILE ||
+         action == KEYMAP_PROFILE_SAVE;
+}
+
+// The macro with this name, added if new; -1 if there is no room
+static int macro_index(const char *name) {
+  for (int i = 0; i < g_macro_count; i++) {
+    if (strcmp(g_macros[i].name, name) == 0) {
+      return i;
+    }
+  }
+  if (g_macro_count == KEYMAP_MACROS) {
+    return -1;
+  }
+  KeymapMacro *macro = &g_macros[g_macro_count];
+  snprintf(macro->name, sizeof(macro->name), "%s", name);
+  macro->steps[0] = '\0';
+  return g_macro_count++;
+}
+
+// "macro <name> <steps>": define a macro; false if it is not valid
+static bool parse_macro(const char *line) {
+  char name[KEYMAP_MACRO_NAME];
+  int steps = 0;
+  if (sscanf(line, " macro %23s %n", name, &steps) != 1 || steps == 0 ||
+      line[steps] == '\0') {
+    return false;
+  }
+  int m = macro_index(name);
+  if (m < 0) {
+    return false;
+  }
+  char *text = g_macros[m].steps;
+  snprintf(text, KEYMAP_MACRO_TEXT, "%s", line + steps);
+  size_t len = strlen(text);
+  while (len > 0 && isspace((unsigned char)text[len - 1])) {
+    text[--len] = '\0'; // The line's end
+  }
+  return true;
+}
+
+// Parse one line under section *model; false if it is not valid
+static bool parse_line(char *line, int *model) {
+  char *comment = strchr(line, '#');
+  if (comment) {
+    *comment = '\0';
+  }
+
+  char word[32];
+  if (sscanf(line, " %31s", word) != 1) {
+    return true; // Blank
+  }
+  if (strcmp(word, "[default]") == 0) {
+    *model = 0;
+    return true;
+  }
+  if (sscanf(line, " [model %d]", model) == 1) {
+    return true;
+  }
+  if (strcmp(word, "macro") == 0) {
+    return parse_macro(line);
+  }
+
+  char mode[16], key[4], trigger[16], action[32];
+  char name[KEYMAP_MACRO_NAME] = "";
+  int fields = sscanf(line, " %15s %3s %15s %31s %23s", mode, key, trigger,
+                      action, name);
+  if (fields < 4 || key[1] != '\0') {
+    return false;
+  }
+  int m = name_index(g_mode_names, KEYMAP_MODE_COUNT, mode);
+  int k = key_index(key[0]);
+  int a = name_index(g_action_names, KEYMAP_ACTION_COUNT, action);
+  bool shift = strncmp(trigger, "shift", 5) == 0;
+  const char *rest = shift ? trigger + 5 : trigger;
+  bool hold = strcmp(rest, "hold") == 0 || strcmp(rest, "_hold") == 0;
+  bool press = strcmp(rest, "press") == 0 || (shift && rest[0] == '\0');
+  if (m < 0 || k < 0 || a < 0 || !(hold || press) ||
+      takes_name(a) != (fields == 5) ||
+      g_binding_count >= KEYMAP_BINDINGS) {
+    return false;
+  }
+  int macro = takes_name(a) ? macro_index(name) : 0;
+  if (macro < 0) {
+    return false;
+  }
+
+  g_bindings[g_binding_count++] = (Binding){
+      *model, (uint8_t)m, (uint8_t)k, hold, shift, (uint8_t)a, (uint8_t)macro};
+  return true;
+}
+
+// ============================================================================
+// Lifecycle
+// ============================================================================
+
+int keymap_init(const char *path) {
+  if (path == NULL) {
+    path = KEYMAP_DEFAULT_PATH;
+  }
+
+  pthread_mutex_lock(&g_keymap_mutex);
+  g_binding_count = 0;
+  g_macro_count = 0;
+  int model = 0;
+  for (int i = 0; i < BUILTIN_COUNT; i++) {
+    char line[64];
+    snprintf(line, sizeof(line), "%s", g_builtin[i]);
+    parse_line(line, &model);
+  }
+
+  FILE *in = fopen(path, "r");
+  if (in) {
+    char line[256];
+    int line_no = 0;
+    model = 0;
+    while (fgets(line, sizeof(line), in)) {
+      line_no++;
+      if (!parse_line(line, &model)) {
+        LOG_ERROR("keymap: %s:%d: ignoring bad binding", path, line_no);
+      }
+    }
+    fclose(in);
+  }
+  DEBUG_PRINT("keymap_init: %d bindings (%s%s)\n", g_binding_count,
+              in ? "" : "built-in, no ", path);
+  pthread_mutex_unlock(&g_keymap_mutex);
+
+  keymap_select_model(0);
+  return 0;
+}
+
+void keymap_select_model(int model) {
+  uint8_t table[KEYMAP_MODE_COUNT][KEYMAP_KEYS][2][2];
+  uint8_t macros[KEYMAP_MODE_COUNT][KEYMAP_KEYS][2][2];
+  bool shift_bound[KEYMAP_MODE_COUNT][KEYMAP_KEYS][2];
+  memset(table, KEYMAP_NONE, sizeof(table));
+  memset(macros, 0, sizeof(macros));
+  memset(shift_bound, 0, sizeof(shift_bound));
+
+  pthread_mutex_lock(&g_keymap_mutex);
+
+  // Every radio's bindings, then the model's own on top
+  for (int pass = 0; pass < 2; pass++) {
+    int wanted = pass == 0 ? 0 : model;
+    if (pass == 1 && model == 0) {
+      break;
+    }
+    for (int i = 0; i < g_binding_count; i++) {
+      const Binding *b = &g_bindings[i];
+      if (b->model != wanted) {
+        continue;
+      }
+      table[b->mode][b->key][b->hold][b->shift] = b->action;
+      macros[b->mode][b->key][b->hold][b->shift] = b->macro;
+      if (b->shift) {
+        shift_bound[b->mode][b->key][b->hold] = true;
+      }
+    }
+  }
+
+  // A shifted key without a binding of its own runs the unshifted one
+  for (int m = 0; m < KEYMAP_MODE_COUNT; m++) {
+    for (int k = 0; k < KEYMAP_KEYS; k++) {
+      for (int h = 0; h < 2; h++) {
+        if (!shift_bound[m][k][h]) {
+          table[m][k][h][1] = table[m][k][h][0];
+          macros[m][k][h][1] = macros[m][k][h][0];
+        }
+      }
+    }
+  }
+
+  memcpy(g_table, table, sizeof(g_table));
+  memcpy(g_macro_table, macros, sizeof(g_macro_table));
+  pthread_mutex_unlock(&g_keymap_mutex);
+  DEBUG_PRINT("keymap_select_model: %d\n", model);
+}
+
+// ============================================================================
+// Lookup
+// ============================================================================
+
+KeymapAction keymap_lookup(KeymapMode mode, char key, bool is_hold,
+                           bool is_shifted) {
+  int k = key_index(key);
+  if (mode < 0 || mode >= KEYMAP_MODE_COUNT || k < 0) {
+    return KEYMAP_NONE;
+  }
+
+  pthread_mutex_lock(&g_keymap_mutex);
+  KeymapAction action = g_table[mode][k][is_hold][is_shifted];
+  pthread_mutex_unlock(&g_keymap_mutex);
+  return action;
+}
+
+bool keymap_lookup_macro(KeymapMode mode, char key, bool is_hold,
+                         bool is_shifted, KeymapMacro *macro) {
+  int k = key_index(key);
+  if (mode < 0 || mode >= KEYMAP_MODE_COUNT || k < 0) {
+    return false;
+  }
+
+  pthread_mutex_lock(&g_keymap_mutex);
+  bool found = takes_name(g_table[mode][k][is_hold][is_shifted]);
+  if (found) {
+    *macro = g_macros[g_macro_table[mode][k][is_hold][is_shifted]];
+  }
+  pthread_mutex_unlock(&g_keymap_mutex);
+  return found;
+}
+
+const char *keymap_action_name(KeymapAction action) {
+  if (action < 0 || action >= KEYMAP_ACTION_COUNT) {
+    return "unknown";
+  }
+  return g_action_names[action];
+}
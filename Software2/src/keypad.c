@@ -11,6 +11,36 @@
  * 2. While key is being reported, check if held > threshold -> fire hold event
  * 3. When key is released (we see '-'), fire press/hold based on duration
  *
+ * Push Mode:
+ * If Firmware supports it, keypad_init() subscribes to pushed key events
+ * instead of polling. The router thread hands press/release/repeat events to
+ * us through a small queue; the keypad thread runs the same press/hold rules
+ * using the kernel timestamps and a hold timer, with no per-poll IPC.
+ * With the event loop running (evloop.h) there is no keypad thread: the
+ * events are handled on the loop that routed them, with a loop timer.
+ *
+ * Newer Firmware also classifies holds itself: it is given the hold threshold
+ * when we subscribe and pushes a hold event the moment a key has been down
+ * that long. A press then fires as soon as the key comes up and a hold
+ * exactly at the threshold, with no timer on our side.
+ *
+ * Batch Mode:
+ * Without push mode, Firmware that keeps a key event ring is drained once
+ * per poll instead of asked for the current key. Every press and release
+ * since the last poll comes back in order with its kernel timestamp and runs
+ * through the push mode rules, so fast key bursts are neither merged nor
+ * delayed until the next key shows up.
+ *
+ * Auto-repeat:
+ * Once a hold has fired, a key still down fires a repeat event (isHold and
+ * isRepeat set, no beep) every repeat interval until it is released, from a
+ * timer on our side in every mode. Handlers that don't step something
+ * ignore repeats.
+ *
+ * Firmware Key Beep:
+ * With `firmware_beep` set in the config, the keypress beep is played by
+ * Firmware itself on key-down and fire_event() only sends hold beeps.
+ *
  * Part of Phase 0: Core Infrastructure (Step 3.1)
  */
 
@@ -23,7 +53,12 @@
 
 #include "comm.h"
 #include "config.h"
+#include "evloop.h"
+#include "hampod_metrics.h"
+#include "hampod_trace.h"
+#include "idle.h"
 #include "keypad.h"
+#include "watchdog.h"
 
 // ============================================================================
 // Configuration Defaults
@@ -31,6 +66,8 @@
 
 #define DEFAULT_HOLD_THRESHOLD_MS 500
 #define DEFAULT_POLL_INTERVAL_MS 50
+#define IDLE_POLL_INTERVAL_MS 250 // Batch and poll modes, in idle mode
+#define DEFAULT_REPEAT_INTERVAL_MS 100
 
 // ============================================================================
 // Module State
@@ -43,11 +80,54 @@ static KeypadCallback user_callback = NULL;
 // Configuration
 static int hold_threshold_ms = DEFAULT_HOLD_THRESHOLD_MS;
 static int poll_interval_ms = DEFAULT_POLL_INTERVAL_MS;
+static int repeat_interval_ms = DEFAULT_REPEAT_INTERVAL_MS;
 
 // Hold detection state
 static char last_key = '-';            // Last key seen (or '-' for none)
 static struct timespec key_press_time; // When the key was first pressed
 static bool hold_event_fired = false;  // Have we already fired a hold event?
+static long next_repeat_ms = 0;        // When the held key next repeats
+
+// Push mode state (events handed over from the comm router thread)
+#define PUSH_QUEUE_SIZE 64
+#define PUSH_CREDIT_BATCH 16 // Credits given back to Firmware at a time
+
+typedef struct {
+  char key;
+  int action;
+  uint64_t timestamp_us;
+} PushEvent;
+
+static bool push_mode = false;
+static bool firmware_holds = false; // Firmware pushes COMM_KEY_ACTION_HOLD
+static bool push_credited = false;  // Firmware pushes only what we grant
+static int push_credits_owed = 0;   // Popped but not granted back yet
+static bool batch_mode = false;     // Polling via the Firmware event ring
+static bool firmware_beeps = false; // Firmware beeps on key-down itself
+static PushEvent push_queue[PUSH_QUEUE_SIZE];
+static int push_head = 0;
+static int push_count = 0;
+static pthread_mutex_t push_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t push_cond = PTHREAD_COND_INITIALIZER;
+static uint64_t key_press_timestamp_us = 0; // Kernel time of the press
+
+// Keys injected through keypad_inject(), fired by the keypad thread (or the
+// loop) so callbacks never run on two threads at once. Under push_mutex.
+#define INJECT_QUEUE_SIZE 8
+#define INJECT_KEYS "0123456789ABCD*#"
+
+typedef struct {
+  char key;
+  bool is_hold;
+} InjectedKey;
+
+static InjectedKey inject_queue[INJECT_QUEUE_SIZE];
+static int inject_count = 0;
+
+// Event loop mode: push events are handled on the loop, which is also where
+// the router hands them over, and the hold/repeat timer is a loop timer
+static bool loop_mode = false;
+static int loop_timer = -1;
 
 // ============================================================================
 // Private Helper Functions
@@ -68,26 +148,31 @@ static long elapsed_since_press(void) {
          (now.tv_nsec - key_press_time.tv_nsec) / 1000000;
 }
 
-// Fire a key event to the registered callback
-static void fire_event(char key, bool is_hold) {
+// Fire a key event to the registered callback. timestamp_us is the kernel
+// time of the event that fired it, 0 if a timer did.
+static void fire_event(char key, bool is_hold, uint64_t timestamp_us) {
   if (user_callback == NULL) {
     return;
   }
+  hampod_trace(TRACE_KEY_DISPATCH, (unsigned char)key, hampod_trace_key_begin(),
+               hampod_trace_key_age_us(timestamp_us));
 
   // Play beep feedback if enabled
   if (config_get_key_beep_enabled()) {
     if (is_hold) {
       // Lower-pitch beep for hold events
       comm_play_beep(COMM_BEEP_HOLD);
-    } else {
-      // Standard beep for press events
+    } else if (!firmware_beeps) {
+      // Standard beep for press events (Firmware already beeped otherwise)
       comm_play_beep(COMM_BEEP_KEYPRESS);
+      watchdog_note_key(timestamp_us);
     }
   }
 
   KeyPressEvent event = {.key = key,
                          .shiftAmount = 0, // Reserved for future use
-                         .isHold = is_hold};
+                         .isHold = is_hold,
+                         .isRepeat = false};
 
   LOG_DEBUG("Firing key event: key='%c', isHold=%s", key,
             is_hold ? "YES" : "NO");
@@ -95,6 +180,319 @@ static void fire_event(char key, bool is_hold) {
   user_callback(&event);
 }
 
+// Fire the hold event for the key that is down and start its repeats
+static void fire_hold(uint64_t timestamp_us) {
+  fire_event(last_key, true, timestamp_us);
+  hold_event_fired = true;
+  next_repeat_ms = get_time_ms() + repeat_interval_ms;
+}
+
+// Fire a repeat once the held key's interval has passed (no beep)
+static void check_repeat_timer(void) {
+  if (repeat_interval_ms <= 0 || last_key == '-' || !hold_event_fired ||
+      user_callback == NULL) {
+    return;
+  }
+
+  long now = get_time_ms();
+  if (now < next_repeat_ms) {
+    return;
+  }
+  // A slow handler skips repeats rather than firing a burst of them
+  next_repeat_ms += repeat_interval_ms;
+  if (next_repeat_ms <= now) {
+    next_repeat_ms = now + repeat_interval_ms;
+  }
+
+  KeyPressEvent event = {.key = last_key,
+                         .shiftAmount = 0,
+                         .isHold = true,
+                         .isRepeat = true};
+  user_callback(&event);
+}
+
+// Shorten a wait to the held key's next repeat
+static int wait_for_repeat(int wait_ms) {
+  if (repeat_interval_ms > 0 && last_key != '-' && hold_event_fired) {
+    long remaining = next_repeat_ms - get_time_ms();
+    if (wait_ms < 0 || remaining < wait_ms) {
+      wait_ms = remaining > 0 ? (int)remaining : 0;
+    }
+  }
+  return wait_ms;
+}
+
+// ============================================================================
+// Push Mode
+// ============================================================================
+
+static void keypad_loop_step(void *arg);
+
+// Called on the router thread - only queue the event, never block. On the
+// event loop, the events are handled once the current handler returns.
+static void on_push_event(char key, int action, uint64_t timestamp_us) {
+  hampod_trace(TRACE_KEY_RECEIVED, (unsigned char)key, (uint32_t)action,
+               hampod_trace_key_age_us(timestamp_us));
+  pthread_mutex_lock(&push_mutex);
+  if (push_count >= PUSH_QUEUE_SIZE) {
+    LOG_ERROR("Keypad push queue full, dropping oldest event");
+    hampod_metric_add(METRIC_KEY_PUSH_DROPS, 1);
+    push_head = (push_head + 1) % PUSH_QUEUE_SIZE;
+    push_count--;
+  }
+  int tail = (push_head + push_count) % PUSH_QUEUE_SIZE;
+  push_queue[tail].key = key;
+  push_queue[tail].action = action;
+  push_queue[tail].timestamp_us = timestamp_us;
+  push_count++;
+  bool first = push_count == 1;
+  pthread_cond_signal(&push_cond);
+  pthread_mutex_unlock(&push_mutex);
+
+  if (loop_mode && first) {
+    evloop_post(keypad_loop_step, NULL);
+  }
+}
+
+// Wait up to timeout_ms for a pushed event. Returns true if one was popped.
+// A negative timeout waits for the next event (or keypad_shutdown()), zero
+// not at all.
+static bool push_event_pop(PushEvent *out, int timeout_ms) {
+  pthread_mutex_lock(&push_mutex);
+
+  bool idle = push_count == 0 && inject_count == 0 && running;
+  if (idle && timeout_ms < 0) {
+    pthread_cond_wait(&push_cond, &push_mutex);
+  } else if (idle && timeout_ms > 0) {
+    struct timespec timeout;
+    clock_gettime(CLOCK_REALTIME, &timeout);
+    timeout.tv_sec += timeout_ms / 1000;
+    timeout.tv_nsec += (timeout_ms % 1000) * 1000000L;
+    if (timeout.tv_nsec >= 1000000000L) {
+      timeout.tv_sec += 1;
+      timeout.tv_nsec -= 1000000000L;
+    }
+    pthread_cond_timedwait(&push_cond, &push_mutex, &timeout);
+  }
+
+  bool got = false;
+  if (push_count > 0) {
+    *out = push_queue[push_head];
+    push_head = (push_head + 1) % PUSH_QUEUE_SIZE;
+    push_count--;
+    got = true;
+  }
+
+  // Hand the room back to Firmware in batches, or at once when drained
+  int grant = 0;
+  if (push_credited && got) {
+    push_credits_owed++;
+    if (push_credits_owed >= PUSH_CREDIT_BATCH || push_count == 0) {
+      grant = push_credits_owed;
+      push_credits_owed = 0;
+    }
+  }
+
+  pthread_mutex_unlock(&push_mutex);
+  if (grant > 0 && comm_grant_keypad_credits(grant) != HAMPOD_OK) {
+    LOG_ERROR("Failed to grant %d keypad credits", grant);
+  }
+  return got;
+}
+
+// Duration of the current press, preferring kernel timestamps
+static long press_duration_ms(uint64_t release_timestamp_us) {
+  if (key_press_timestamp_us != 0 &&
+      release_timestamp_us >= key_press_timestamp_us) {
+    return (long)((release_timestamp_us - key_press_timestamp_us) / 1000);
+  }
+  return elapsed_since_press();
+}
+
+// Fire the keys keypad_inject() queued. They never go down or up, so a key
+// held on the keypad meanwhile is not disturbed.
+static void drain_injected(void) {
+  InjectedKey keys[INJECT_QUEUE_SIZE];
+  pthread_mutex_lock(&push_mutex);
+  int count = inject_count;
+  memcpy(keys, inject_queue, sizeof(keys[0]) * (size_t)count);
+  inject_count = 0;
+  pthread_mutex_unlock(&push_mutex);
+
+  for (int i = 0; i < count; i++) {
+    idle_note_activity();
+    fire_event(keys[i].key, keys[i].is_hold, 0);
+  }
+}
+
+static void handle_push_event(const PushEvent *ev) {
+  idle_note_activity();
+  if (ev->action == COMM_KEY_ACTION_HOLD) {
+    if (ev->key == last_key && !hold_event_fired) {
+      fire_hold(ev->timestamp_us);
+    }
+    return;
+  }
+
+  if (ev->action == COMM_KEY_ACTION_RELEASE) {
+    if (ev->key == last_key) {
+      long hold_time = press_duration_ms(ev->timestamp_us);
+      if (!hold_event_fired) {
+        fire_event(last_key, hold_time >= hold_threshold_ms, ev->timestamp_us);
+      }
+      LOG_DEBUG("Key up: '%c' (held for %ldms)", last_key, hold_time);
+      last_key = '-';
+    }
+    return;
+  }
+
+  // Press, or a repeat for a key whose press we never saw
+  if (ev->key == last_key) {
+    return; // Auto-repeat - the hold timer does the work
+  }
+
+  if (last_key != '-' && !hold_event_fired) {
+    fire_event(last_key, false, ev->timestamp_us); // New key before release
+  }
+
+  last_key = ev->key;
+  clock_gettime(CLOCK_MONOTONIC, &key_press_time);
+  key_press_timestamp_us = ev->timestamp_us;
+  hold_event_fired = false;
+  LOG_DEBUG("Key down: '%c'", last_key);
+}
+
+// Fire the hold event once a key has been down for the threshold
+static void check_hold_timer(void) {
+  if (!firmware_holds && last_key != '-' && !hold_event_fired &&
+      elapsed_since_press() >= hold_threshold_ms) {
+    fire_hold(0);
+  }
+}
+
+// How long push mode may sleep: until the next event, or until a held key
+// crosses the threshold (unless Firmware tells us about holds itself) or
+// repeats. -1 with no key down, when only an event wakes us.
+static int push_wait_ms(void) {
+  int wait_ms = -1;
+  if (!firmware_holds && last_key != '-' && !hold_event_fired) {
+    long remaining = hold_threshold_ms - elapsed_since_press();
+    wait_ms = remaining > 0 ? (int)remaining : 0;
+  }
+  return wait_for_repeat(wait_ms);
+}
+
+// Event loop mode: handle the queued events and the hold/repeat timer,
+// then arm it for the next deadline
+static void keypad_loop_step(void *arg) {
+  (void)arg;
+  if (!running) {
+    return;
+  }
+  PushEvent ev;
+  while (push_event_pop(&ev, 0)) {
+    handle_push_event(&ev);
+  }
+  drain_injected();
+  check_hold_timer();
+  check_repeat_timer();
+  evloop_arm_timer(loop_timer, push_wait_ms());
+}
+
+static void *keypad_push_thread_func(void *arg) {
+  (void)arg;
+
+  LOG_INFO("Keypad thread started (push mode)");
+  hampod_metrics_name_thread("keypad");
+
+  while (running) {
+    PushEvent ev;
+    bool got = push_event_pop(&ev, push_wait_ms());
+    drain_injected();
+    if (got) {
+      handle_push_event(&ev);
+      check_repeat_timer(); // Kernel auto-repeat events keep coming
+      continue;
+    }
+
+    check_hold_timer();
+    check_repeat_timer();
+  }
+
+  LOG_INFO("Keypad thread exiting");
+
+  return NULL;
+}
+
+// ============================================================================
+// Batch Mode
+// ============================================================================
+
+static void *keypad_batch_thread_func(void *arg) {
+  (void)arg;
+
+  LOG_INFO("Keypad thread started (batch mode)");
+  hampod_metrics_name_thread("keypad");
+
+  int consecutive_errors = 0;
+
+  while (running) {
+    CommKeyEvent events[COMM_KEYPAD_DRAIN_MAX];
+    int count = 0;
+    int read_result = comm_read_keypad_events(events, &count);
+    if (read_result == HAMPOD_TIMEOUT) {
+      LOG_ERROR("Keypad read timeout, retrying...");
+      consecutive_errors = 0;
+      continue;
+    }
+    if (read_result != HAMPOD_OK) {
+      consecutive_errors++;
+      LOG_ERROR("Failed to read keypad events (%d consecutive errors)",
+                consecutive_errors);
+      if (consecutive_errors >= 3) {
+        LOG_ERROR("Too many keypad errors, stopping");
+        break;
+      }
+      usleep(100000); /* 100ms backoff before retry */
+      continue;
+    }
+    consecutive_errors = 0;
+
+    for (int i = 0; i < count; i++) {
+      PushEvent ev = {.key = events[i].key,
+                      .action = events[i].action,
+                      .timestamp_us = events[i].timestamp_us};
+      hampod_trace(TRACE_KEY_RECEIVED, (unsigned char)ev.key,
+                   (uint32_t)ev.action,
+                   hampod_trace_key_age_us(ev.timestamp_us));
+      handle_push_event(&ev);
+    }
+    drain_injected();
+    if (count == COMM_KEYPAD_DRAIN_MAX) {
+      continue; // Ring not empty yet
+    }
+
+    check_hold_timer();
+    check_repeat_timer();
+    idle_note_wakeup(count > 0 || last_key != '-');
+
+    // Sleep until the next poll (later when idle), or until a held key
+    // crosses the threshold or repeats
+    int wait_ms = idle_stretch_ms(poll_interval_ms, IDLE_POLL_INTERVAL_MS);
+    if (last_key != '-' && !hold_event_fired) {
+      long remaining = hold_threshold_ms - elapsed_since_press();
+      if (remaining < wait_ms) {
+        wait_ms = remaining > 0 ? (int)remaining : 0;
+      }
+    }
+    usleep(wait_for_repeat(wait_ms) * 1000);
+  }
+
+  LOG_INFO("Keypad thread exiting");
+
+  return NULL;
+}
+
 // ============================================================================
 // Keypad Thread
 // ============================================================================
@@ -103,6 +501,7 @@ static void *keypad_thread_func(void *arg) {
   (void)arg;
 
   LOG_INFO("Keypad thread started");
+  hampod_metrics_name_thread("keypad");
 
   /* Number of consecutive no-key polls before considering key released.
    * Linux key repeat has gaps between events, so we need debouncing. */
@@ -146,6 +545,7 @@ static void *keypad_thread_func(void *arg) {
 
       if (last_key == '-') {
         // First time seeing this key - record it and the time
+        idle_note_activity();
         last_key = key;
         clock_gettime(CLOCK_MONOTONIC, &key_press_time);
         hold_event_fired = false;
@@ -154,14 +554,13 @@ static void *keypad_thread_func(void *arg) {
       } else if (last_key == key) {
         // Same key still being reported - check for hold
         if (!hold_event_fired && elapsed_since_press() >= hold_threshold_ms) {
-          fire_event(key, true); // Hold event
-          hold_event_fired = true;
+          fire_hold(0);
         }
 
       } else {
         // Different key - handle as release of old + press of new
         if (!hold_event_fired) {
-          fire_event(last_key, false); // Press event for old key
+          fire_event(last_key, false, 0); // Press event for old key
         }
         last_key = key;
         clock_gettime(CLOCK_MONOTONIC, &key_press_time);
@@ -176,8 +575,7 @@ static void *keypad_thread_func(void *arg) {
 
         // Check for hold while waiting for release confirmation
         if (!hold_event_fired && elapsed_since_press() >= hold_threshold_ms) {
-          fire_event(last_key, true); // Hold event
-          hold_event_fired = true;
+          fire_hold(0);
         }
 
         // Only consider truly released after threshold
@@ -187,9 +585,9 @@ static void *keypad_thread_func(void *arg) {
           if (!hold_event_fired) {
             // Determine if it was a hold or press based on duration
             if (hold_time >= hold_threshold_ms) {
-              fire_event(last_key, true); // Hold
+              fire_event(last_key, true, 0); // Hold
             } else {
-              fire_event(last_key, false); // Press
+              fire_event(last_key, false, 0); // Press
             }
           }
 
@@ -200,8 +598,12 @@ static void *keypad_thread_func(void *arg) {
       }
     }
 
-    // Sleep between polls
-    usleep(poll_interval_ms * 1000);
+    drain_injected();
+    check_repeat_timer();
+    idle_note_wakeup(key_pressed || last_key != '-');
+
+    // Sleep between polls, longer when idle
+    usleep(idle_stretch_ms(poll_interval_ms, IDLE_POLL_INTERVAL_MS) * 1000);
   }
 
   LOG_INFO("Keypad thread exiting");
@@ -224,18 +626,70 @@ int keypad_init(void) {
   // Reset state
   last_key = '-';
   hold_event_fired = false;
+  push_head = 0;
+  push_count = 0;
+  push_credits_owed = 0;
+  inject_count = 0;
+
+  // Prefer Firmware push events; fall back to polling on older Firmware.
+  // Firmware never pushes more than the queue has room for.
+  comm_set_keypad_event_handler(on_push_event);
+  push_mode = (comm_subscribe_keypad(true, hold_threshold_ms, PUSH_QUEUE_SIZE,
+                                     &firmware_holds,
+                                     &push_credited) == HAMPOD_OK);
+  if (!push_mode) {
+    comm_set_keypad_event_handler(NULL);
+
+    // Next best: drain the Firmware event ring. This first drain only
+    // probes for support, so its (stale) events are dropped.
+    CommKeyEvent stale[COMM_KEYPAD_DRAIN_MAX];
+    int stale_count;
+    batch_mode = (comm_read_keypad_events(stale, &stale_count) == HAMPOD_OK);
+  }
+
+  // Opt-in: let Firmware play the keypress beep on key-down
+  firmware_beeps = config_get_key_beep_enabled() &&
+                   config_get_firmware_beep_enabled() &&
+                   comm_set_local_key_beep(true) == HAMPOD_OK;
+
+  // Pushed events need no thread of their own on the event loop
+  loop_timer = -1;
+  if (push_mode && evloop_running()) {
+    loop_timer = evloop_add_timer(keypad_loop_step, NULL);
+  }
+  loop_mode = loop_timer >= 0;
+  if (loop_mode) {
+    running = true;
+    evloop_post(keypad_loop_step, NULL); // Any pushed before loop_mode
+    LOG_INFO("Keypad system initialized (hold threshold: %dms, push mode on "
+             "the event loop%s)",
+             hold_threshold_ms, firmware_holds ? ", Firmware holds" : "");
+    return HAMPOD_OK;
+  }
 
   // Start keypad thread
+  void *(*thread_func)(void *) = keypad_thread_func;
+  if (push_mode) {
+    thread_func = keypad_push_thread_func;
+  } else if (batch_mode) {
+    thread_func = keypad_batch_thread_func;
+  }
   running = true;
-  if (pthread_create(&keypad_thread, NULL, keypad_thread_func, NULL) != 0) {
+  if (pthread_create(&keypad_thread, NULL, thread_func, NULL) != 0) {
     LOG_ERROR("Failed to create keypad thread");
     running = false;
     return HAMPOD_ERROR;
   }
 
-  LOG_INFO(
-      "Keypad system initialized (hold threshold: %dms, poll interval: %dms)",
-      hold_threshold_ms, poll_interval_ms);
+  if (push_mode) {
+    LOG_INFO("Keypad system initialized (hold threshold: %dms, push mode%s)",
+             hold_threshold_ms, firmware_holds ? ", Firmware holds" : "");
+  } else {
+    LOG_INFO("Keypad system initialized (hold threshold: %dms, poll interval: "
+             "%dms%s)",
+             hold_threshold_ms, poll_interval_ms,
+             batch_mode ? ", batch mode" : "");
+  }
   return HAMPOD_OK;
 }
 
@@ -249,14 +703,78 @@ void keypad_shutdown(void) {
   // Signal thread to stop
   running = false;
 
+  if (push_mode) {
+    comm_subscribe_keypad(false, 0, 0, NULL, NULL);
+    comm_set_keypad_event_handler(NULL);
+    pthread_mutex_lock(&push_mutex);
+    pthread_cond_broadcast(&push_cond);
+    pthread_mutex_unlock(&push_mutex);
+  }
+
+  if (firmware_beeps) {
+    comm_set_local_key_beep(false);
+    firmware_beeps = false;
+  }
+
   // Wait for thread to finish
-  pthread_join(keypad_thread, NULL);
+  if (loop_mode) {
+    evloop_arm_timer(loop_timer, -1);
+    loop_mode = false;
+  } else {
+    pthread_join(keypad_thread, NULL);
+  }
+  push_mode = false;
+  firmware_holds = false;
+  push_credited = false;
+  batch_mode = false;
 
   LOG_INFO("Keypad system shutdown complete");
 }
 
 bool keypad_is_running(void) { return running; }
 
+int keypad_inject(char key, bool is_hold) {
+  if (!running || key == '\0' || strchr(INJECT_KEYS, key) == NULL) {
+    return HAMPOD_ERROR;
+  }
+  pthread_mutex_lock(&push_mutex);
+  if (inject_count == INJECT_QUEUE_SIZE) {
+    pthread_mutex_unlock(&push_mutex);
+    return HAMPOD_ERROR;
+  }
+  inject_queue[inject_count].key = key;
+  inject_queue[inject_count].is_hold = is_hold;
+  inject_count++;
+  pthread_cond_signal(&push_cond);
+  pthread_mutex_unlock(&push_mutex);
+
+  if (loop_mode) {
+    evloop_post(keypad_loop_step, NULL);
+  }
+  return HAMPOD_OK;
+}
+
+void keypad_update_beep(void) {
+  if (!running) {
+    return;
+  }
+  bool wanted =
+      config_get_key_beep_enabled() && config_get_firmware_beep_enabled();
+  if (wanted == firmware_beeps) {
+    return;
+  }
+  if (wanted) {
+    firmware_beeps = comm_set_local_key_beep(true) == HAMPOD_OK;
+  } else {
+    firmware_beeps = false; // Beep ourselves from the next key
+    comm_set_local_key_beep(false);
+  }
+}
+
+pthread_t keypad_get_thread(void) {
+  return loop_mode ? evloop_get_thread() : keypad_thread;
+}
+
 // ============================================================================
 // Public API - Callback Registration
 // ============================================================================
@@ -288,3 +806,10 @@ void keypad_set_poll_interval(int ms) {
     LOG_INFO("Keypad poll interval set to %dms", ms);
   }
 }
+
+void keypad_set_repeat_interval(int ms) {
+  if (ms >= 0) {
+    repeat_interval_ms = ms;
+    LOG_INFO("Keypad repeat interval set to %dms", ms);
+  }
+}
@@ -0,0 +1,394 @@
+/**
+ * @file macro.c
+ * @brief Keypad macro implementation
+ */
+
+#include "macro.h"
+#include "announce.h"
+#include "comm.h"
+#include "config.h"
+#include "frequency_mode.h"
+#include "hampod_core.h"
+#include "radio.h"
+#include "radio_queries.h"
+#include "radio_setters.h"
+#include "radio_state.h"
+#include "radio_worker.h"
+#include "speech.h"
+
+#include <ctype.h>
+#include <hamlib/rig.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+// ============================================================================
+// State
+// ============================================================================
+
+#define MACRO_NOT_CONNECTED 1 // Job result: no radio to run it on
+
+// A queued or running macro and what became of its steps. The radio
+// worker's argument is too small for a macro, so it carries the slot.
+typedef struct {
+  bool busy;
+  Macro macro;
+  int failed;                  // Step the radio did not take, or -1
+  int sent;                    // Steps sent, the rest were already set
+  bool lacks[MACRO_STEPS_MAX]; // Steps the radio has no control for
+} MacroJob;
+
+static MacroJob g_jobs[MACRO_JOBS];
+static pthread_mutex_t g_jobs_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *const g_step_names[] = {
+    [MACRO_STEP_VFO] = "vfo",
+    [MACRO_STEP_FREQUENCY] = "frequency",
+    [MACRO_STEP_MODE] = "mode",
+    [MACRO_STEP_POWER] = "power",
+    [MACRO_STEP_PREAMP] = "preamp",
+    [MACRO_STEP_ATTENUATION] = "attenuation",
+    [MACRO_STEP_AGC] = "agc",
+    [MACRO_STEP_NB] = "nb",
+    [MACRO_STEP_NR] = "nr",
+    [MACRO_STEP_PASSBAND] = "passband",
+};
+#define STEP_KIND_COUNT (int)(sizeof(g_step_names) / sizeof(g_step_names[0]))
+
+// Spoken
+static const char *const g_step_words[] = {
+    [MACRO_STEP_VFO] = "VFO",
+    [MACRO_STEP_FREQUENCY] = "frequency",
+    [MACRO_STEP_MODE] = "mode",
+    [MACRO_STEP_POWER] = "power",
+    [MACRO_STEP_PREAMP] = "preamp",
+    [MACRO_STEP_ATTENUATION] = "attenuation",
+    [MACRO_STEP_AGC] = "AGC",
+    [MACRO_STEP_NB] = "noise blanker",
+    [MACRO_STEP_NR] = "noise reduction",
+    [MACRO_STEP_PASSBAND] = "passband",
+};
+
+// Where the radio state cache keeps what a step sets
+static const RadioField g_step_fields[] = {
+    [MACRO_STEP_VFO] = RADIO_FIELD_VFO,
+    [MACRO_STEP_FREQUENCY] = RADIO_FIELD_FREQ,
+    [MACRO_STEP_MODE] = RADIO_FIELD_MODE,
+    [MACRO_STEP_POWER] = RADIO_FIELD_POWER,
+    [MACRO_STEP_PREAMP] = RADIO_FIELD_PREAMP,
+    [MACRO_STEP_ATTENUATION] = RADIO_FIELD_ATT,
+    [MACRO_STEP_AGC] = RADIO_FIELD_AGC,
+    [MACRO_STEP_NB] = RADIO_FIELD_NB_ON,
+    [MACRO_STEP_NR] = RADIO_FIELD_NR_ON,
+    [MACRO_STEP_PASSBAND] = RADIO_FIELD_PASSBAND,
+};
+
+// Icom's names for the data modes
+static const char *const g_mode_aliases[][2] = {
+    {"USB-D", "PKTUSB"},
+    {"LSB-D", "PKTLSB"},
+    {"FM-D", "PKTFM"},
+};
+
+// ============================================================================
+// Compiling
+// ============================================================================
+
+static bool parse_switch(const char *value, long long *out) {
+  if (strcasecmp(value, "on") == 0) {
+    *out = 1;
+  } else if (strcasecmp(value, "off") == 0) {
+    *out = 0;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+static bool parse_number(const char *value, long long min, long long max,
+                         long long *out) {
+  char *end;
+  long n = strtol(value, &end, 10);
+  if (end == value || *end != '\0' || n < min || n > max) {
+    return false;
+  }
+  *out = n;
+  return true;
+}
+
+static bool parse_mode(const char *value, long long *out) {
+  for (size_t i = 0; i < sizeof(g_mode_aliases) / sizeof(g_mode_aliases[0]);
+       i++) {
+    if (strcasecmp(value, g_mode_aliases[i][0]) == 0) {
+      value = g_mode_aliases[i][1];
+    }
+  }
+  char upper[16];
+  size_t n = 0;
+  for (; value[n] != '\0' && n < sizeof(upper) - 1; n++) {
+    upper[n] = (char)toupper((unsigned char)value[n]);
+  }
+  upper[n] = '\0';
+  rmode_t mode = rig_parse_mode(upper);
+  if (mode == RIG_MODE_NONE) {
+    return false;
+  }
+  *out = (long long)mode;
+  return true;
+}
+
+static bool parse_value(MacroStepKind kind, const char *value,
+                        long long *out) {
+  switch (kind) {
+  case MACRO_STEP_VFO:
+    if (strcasecmp(value, "a") == 0 || strcasecmp(value, "b") == 0) {
+      *out = tolower((unsigned char)value[0]) == 'a' ? RADIO_VFO_A
+                                                      : RADIO_VFO_B;
+      return true;
+    }
+    return false;
+  case MACRO_STEP_FREQUENCY: {
+    // As typed in Frequency Mode: megahertz with a point, else hertz
+    char *end;
+    double freq = strtod(value, &end);
+    if (end == value || *end != '\0' || freq <= 0) {
+      return false;
+    }
+    *out = (long long)(strchr(value, '.') ? freq * 1000000.0 + 0.5 : freq);
+    return true;
+  }
+  case MACRO_STEP_MODE:
+    return parse_mode(value, out);
+  case MACRO_STEP_POWER:
+    return parse_number(value, 0, 100, out);
+  case MACRO_STEP_PREAMP:
+    if (parse_switch(value, out)) {
+      return true;
+    }
+    return parse_number(value, 1, 2, out);
+  case MACRO_STEP_ATTENUATION:
+    if (strcasecmp(value, "off") == 0) {
+      *out = 0;
+      return true;
+    }
+    return parse_number(value, 0, 60, out);
+  case MACRO_STEP_AGC:
+    for (AgcSpeed speed = AGC_OFF; speed <= AGC_SLOW; speed++) {
+      if (strcasecmp(value, radio_agc_speed_name(speed)) == 0) {
+        *out = speed;
+        return true;
+      }
+    }
+    return false;
+  case MACRO_STEP_NB:
+  case MACRO_STEP_NR:
+    return parse_switch(value, out);
+  case MACRO_STEP_PASSBAND:
+    return parse_number(value, 0, 100000, out);
+  }
+  return false;
+}
+
+int macro_compile(const KeymapMacro *source, Macro *macro) {
+  snprintf(macro->name, sizeof(macro->name), "%s", source->name);
+  macro->count = 0;
+  macro->changes_only = false;
+
+  char text[KEYMAP_MACRO_TEXT];
+  snprintf(text, sizeof(text), "%s", source->steps);
+  char *save = NULL;
+  int number = 1;
+  for (char *step = strtok_r(text, ",", &save); step != NULL;
+       step = strtok_r(NULL, ",", &save), number++) {
+    char kind[16], value[32], extra[2];
+    if (sscanf(step, " %15s %31s %1s", kind, value, extra) != 2 ||
+        macro->count == MACRO_STEPS_MAX) {
+      return number;
+    }
+    int k = 0;
+    while (k < STEP_KIND_COUNT && strcasecmp(kind, g_step_names[k]) != 0) {
+      k++;
+    }
+    MacroStep *out = &macro->steps[macro->count];
+    out->kind = (MacroStepKind)k;
+    if (k == STEP_KIND_COUNT || !parse_value(out->kind, value, &out->value)) {
+      return number;
+    }
+    macro->count++;
+  }
+  return macro->count > 0 ? 0 : 1;
+}
+
+// ============================================================================
+// Running
+// ============================================================================
+
+// Whether the radio, as last seen, already has what a step sets
+static bool step_is_set(const MacroStep *step) {
+  double value;
+  return radio_state_get(g_step_fields[step->kind], &value) &&
+         (long long)(value + 0.5) == step->value;
+}
+
+// passband: the step after a mode step if it sets the passband, else NULL
+static int apply_step(const MacroStep *step, const MacroStep *passband) {
+  switch (step->kind) {
+  case MACRO_STEP_VFO:
+    return radio_set_vfo((RadioVfo)step->value);
+  case MACRO_STEP_FREQUENCY:
+    return radio_set_frequency((double)step->value);
+  case MACRO_STEP_MODE:
+    return radio_set_mode_raw((int)step->value,
+                              passband ? (int)passband->value : 0);
+  case MACRO_STEP_POWER:
+    return radio_set_power((int)step->value);
+  case MACRO_STEP_PREAMP:
+    return radio_set_preamp((int)step->value);
+  case MACRO_STEP_ATTENUATION:
+    return radio_set_attenuation((int)step->value);
+  case MACRO_STEP_AGC:
+    return radio_set_agc_speed((AgcSpeed)step->value);
+  case MACRO_STEP_NB:
+    return radio_set_nb(step->value != 0, -1);
+  case MACRO_STEP_NR:
+    return radio_set_nr(step->value != 0, -1);
+  case MACRO_STEP_PASSBAND: {
+    int mode = radio_get_mode_raw();
+    return mode != 0 ? radio_set_mode_raw(mode, (int)step->value) : -1;
+  }
+  }
+  return -1;
+}
+
+/**
+ * @brief Radio command: every step back to back in one radio session
+ *        (run on the radio worker)
+ */
+static int run_macro(void *arg) {
+  MacroJob *job = &g_jobs[*(const int *)arg];
+  if (radio_session_begin() != 0) {
+    return MACRO_NOT_CONNECTED;
+  }
+  const Macro *macro = &job->macro;
+  for (int i = 0; i < macro->count; i++) {
+    const MacroStep *step = &macro->steps[i];
+    const MacroStep *passband = NULL;
+    if (step->kind == MACRO_STEP_MODE && i + 1 < macro->count &&
+        macro->steps[i + 1].kind == MACRO_STEP_PASSBAND) {
+      passband = &macro->steps[i + 1];
+    }
+    if (macro->changes_only && step_is_set(step) &&
+        (!passband || step_is_set(passband))) {
+      i += passband != NULL;
+      continue;
+    }
+
+    int result = apply_step(step, passband);
+    job->sent++;
+    if (result == RADIO_ERR_UNAVAILABLE) {
+      job->lacks[i] = true;
+    } else if (result != 0) {
+      job->failed = i; // The rest may depend on it
+      break;
+    }
+    i += passband != NULL;
+  }
+  radio_session_end();
+  return 0;
+}
+
+static void macro_done(int result, void *arg) {
+  int slot = *(const int *)arg;
+  MacroJob *job = &g_jobs[slot];
+
+  if (result != RADIO_CMD_CANCELLED) {
+    bool failed = result != 0 || job->failed >= 0;
+    Announcement a;
+    announce_init(&a);
+    announce_text(&a, job->macro.name);
+    if (result == MACRO_NOT_CONNECTED) {
+      announce_text(&a, "failed, radio not connected");
+    } else if (result != 0) {
+      announce_text(&a, "failed");
+    } else if (job->failed >= 0) {
+      announce_text(&a, "stopped at");
+      announce_text(&a, g_step_words[job->macro.steps[job->failed].kind]);
+    } else if (job->sent == 0 && job->macro.changes_only) {
+      announce_text(&a, "already set");
+    } else {
+      announce_text(&a, "done");
+    }
+    for (int i = 0; i < job->macro.count; i++) {
+      if (job->lacks[i]) {
+        announce_text(&a, "no");
+        announce_text(&a, g_step_words[job->macro.steps[i].kind]);
+      }
+    }
+    if (failed && config_get_key_beep_enabled()) {
+      comm_play_beep(COMM_BEEP_ERROR);
+    }
+    announce_say(&a, failed ? SPEECH_URGENT : SPEECH_INTERACTIVE);
+  }
+
+  pthread_mutex_lock(&g_jobs_mutex);
+  job->busy = false;
+  pthread_mutex_unlock(&g_jobs_mutex);
+}
+
+int macro_run(const KeymapMacro *source) {
+  Macro macro;
+  int bad = macro_compile(source, &macro);
+  if (bad != 0) {
+    LOG_ERROR("macro: %s: step %d is not valid", source->name, bad);
+    if (config_get_key_beep_enabled()) {
+      comm_play_beep(COMM_BEEP_ERROR);
+    }
+    Announcement a;
+    announce_init(&a);
+    announce_text(&a, "Macro");
+    announce_text(&a, source->name);
+    announce_text(&a, source->steps[0] ? "not valid" : "not defined");
+    announce_say(&a, SPEECH_INTERACTIVE);
+    return -1;
+  }
+  return macro_queue(&macro);
+}
+
+int macro_queue(const Macro *macro) {
+  pthread_mutex_lock(&g_jobs_mutex);
+  int slot = 0;
+  while (slot < MACRO_JOBS && g_jobs[slot].busy) {
+    slot++;
+  }
+  if (slot < MACRO_JOBS) {
+    MacroJob *job = &g_jobs[slot];
+    job->busy = true;
+    job->macro = *macro;
+    job->failed = -1;
+    job->sent = 0;
+    memset(job->lacks, 0, sizeof(job->lacks));
+  }
+  pthread_mutex_unlock(&g_jobs_mutex);
+  if (slot == MACRO_JOBS) {
+    speech_say_text("Macros busy");
+    return -1;
+  }
+
+  DEBUG_PRINT("macro_queue: %s, %d steps\n", macro->name, macro->count);
+  for (int i = 0; i < macro->count; i++) {
+    MacroStepKind kind = macro->steps[i].kind;
+    if (kind == MACRO_STEP_FREQUENCY || kind == MACRO_STEP_VFO) {
+      // The summary stands for it; the poller would announce it again
+      frequency_mode_suppress_next_poll();
+      break;
+    }
+  }
+  if (radio_worker_submit(RADIO_CMD_USER, RADIO_KEY_NONE, run_macro,
+                          macro_done, &slot, sizeof(slot)) != 0) {
+    macro_done(-1, &slot);
+    return -1;
+  }
+  return 0;
+}
@@ -15,6 +15,10 @@
  * Part of Phase 1/2/3: Frequency Mode, Normal Mode, Set Mode
  */
 
+#define _GNU_SOURCE // sched_setaffinity in hampod_sched.c
+
+#include <pthread.h>
+#include <semaphore.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -22,27 +26,87 @@
 #include <string.h>
 #include <time.h>
 
+#include "announce.h"
+#include "api.h"
+#include "band_stack.h"
 #include "comm.h"
 #include "config.h"
 #include "config_mode.h"
+#include "config_watch.h"
+#include "cw.h"
+#include "evloop.h"
 #include "frequency_mode.h"
+#include "hampod_alloc.h"
+// Shared start-up timing (Firmware/hampod_boot.h): watchdog.o already
+// carries the implementation
+#define SHAREDLIB
+#include "hampod_boot.h"
+#undef SHAREDLIB
 #include "hampod_core.h"
+#include "hampod_metrics.h"
+// Shared scheduling helpers (Firmware/hampod_sched.h), built into this TU
+#include "hampod_sched.h"
+#include "hampod_trace.h"
+#include "idle.h"
+#include "keymap.h"
 #include "keypad.h"
+#include "memory_index.h"
+#include "memory_mode.h"
+#include "meter.h"
 #include "normal_mode.h"
 #include "radio.h"
+#include "radio_caps.h"
+#include "radio_defs.h"
+#include "radio_trace.h"
+#include "radio_worker.h"
+#include "rotor.h"
+#include "rotor_mode.h"
+#include "scan.h"
 #include "set_mode.h"
 #include "speech.h"
+#include "tuning_tone.h"
+#include "voice_command.h"
+#include "watchdog.h"
 
 // ============================================================================
 // Signal Handling
 // ============================================================================
 
 static volatile bool g_running = true;
+static volatile sig_atomic_t g_latency_wanted = 0;
+static sem_t g_main_wake; // Posted by the handlers; the main loop waits
 
 static void signal_handler(int sig) {
   (void)sig;
   printf("\nShutting down...\n");
   g_running = false;
+  sem_post(&g_main_wake);
+}
+
+static void latency_signal_handler(int sig) {
+  (void)sig;
+  g_latency_wanted = 1;
+  sem_post(&g_main_wake);
+}
+
+// Write a report where the CLI reads it, whole or not at all
+static void write_report(const char *path, void (*report)(FILE *)) {
+  char tmp_path[128];
+  snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+  FILE *out = fopen(tmp_path, "w");
+  if (out == NULL) {
+    LOG_ERROR("Cannot write %s", path);
+    return;
+  }
+  report(out);
+  fclose(out);
+  rename(tmp_path, path);
+}
+
+// For `hampod speech-latency` and `hampod radio-latency`
+static void write_latency_report(void) {
+  write_report(SPEECH_LATENCY_FILE, speech_report_latency);
+  write_report(RADIO_TRACE_FILE, radio_trace_report);
 }
 
 // ============================================================================
@@ -52,10 +116,37 @@ static void signal_handler(int sig) {
 // Shift state for Set Mode (toggled by [A] key)
 static bool g_shift_active = false;
 
+// A key no mode took: say which it was, unless it is no longer news
+#define KEY_ECHO_TTL_MS 1500
+static void announce_unhandled_key(const KeyPressEvent *kp) {
+  char text[32];
+  snprintf(text, sizeof(text), "%s %c", kp->isHold ? "Held" : "Pressed",
+           kp->key);
+  speech_say_text_ttl(text, SPEECH_INTERACTIVE, SPEECH_SLOT_NONE, false,
+                      KEY_ECHO_TTL_MS);
+}
+
 static void on_keypress(const KeyPressEvent *kp) {
+  // Repeats of a held key only step a held tuning key, silently, or a
+  // held browse key
+  if (kp->isRepeat) {
+    if (memory_mode_is_active()) {
+      memory_mode_handle_repeat(kp->key);
+    } else if (!config_mode_is_active() && !set_mode_is_active() &&
+               !frequency_mode_is_active() && !rotor_mode_is_active() &&
+               normal_mode_handle_repeat(kp->key)) {
+      radio_poll_activity();
+    }
+    return;
+  }
+  api_note_key(kp->key, kp->isHold);
+
   // Interrupt any ongoing speech immediately for better responsiveness
   speech_interrupt();
 
+  // A key press often changes the frequency: watch the radio closely again
+  radio_poll_activity();
+
   DEBUG_PRINT("main: Key '%c' hold=%d shift=%d\n", kp->key, kp->isHold,
               kp->shiftAmount);
 
@@ -63,6 +154,15 @@ static void on_keypress(const KeyPressEvent *kp) {
   // use)
   bool was_shifted = g_shift_active;
 
+  // Any key stops a scan, and does nothing else
+  if (scan_is_active()) {
+    scan_stop();
+    speech_say_text_latest("Scan stopped", SPEECH_INTERACTIVE,
+                           SPEECH_SLOT_SCAN, true);
+    g_shift_active = false;
+    return;
+  }
+
   // Route to config mode first (top priority for settings/shutdown)
   if (config_mode_is_active()) {
     if (config_mode_handle_key(kp->key, kp->isHold)) {
@@ -84,20 +184,58 @@ static void on_keypress(const KeyPressEvent *kp) {
     }
   }
 
-  // Handle [A] key for shift toggle (only when NOT in set mode)
-  if (kp->key == 'A' && !kp->isHold) {
+  // Keys bound outside any mode (keymap.c): [A] shift, [B] Set Mode,
+  // [D] held for the next device
+  KeymapAction action =
+      keymap_lookup(KEYMAP_MODE_GLOBAL, kp->key, kp->isHold, was_shifted);
+  switch (action) {
+  case KEYMAP_SHIFT:
     g_shift_active = !g_shift_active;
     speech_say_text(g_shift_active ? "Shift" : "Shift off");
     return;
+  case KEYMAP_SET_MODE:
+    if (!set_mode_is_active()) {
+      set_mode_enter();
+      // Clear shift when entering Set Mode
+      if (was_shifted) {
+        g_shift_active = false;
+      }
+      return;
+    }
+    break;
+  case KEYMAP_NEXT_DEVICE:
+    if (frequency_mode_is_active()) {
+      break; // [D] there cancels the entry
+    }
+    if (rotor_mode_is_active()) {
+      rotor_mode_exit();
+      speech_say_text("Radio");
+    } else if (rotor_is_configured()) {
+      rotor_mode_enter();
+    } else {
+      speech_say_text("No other device");
+    }
+    g_shift_active = false;
+    return;
+  default:
+    break;
   }
 
-  // [B] key enters Set Mode when not active
-  if (kp->key == 'B' && !kp->isHold && !set_mode_is_active()) {
-    set_mode_enter();
-    // Clear shift when entering Set Mode
-    if (was_shifted) {
-      g_shift_active = false;
+  // The rotor has the keypad: radio modes don't see its keys
+  if (rotor_mode_is_active()) {
+    if (!rotor_mode_handle_key(kp->key, kp->isHold)) {
+      announce_unhandled_key(kp);
     }
+    g_shift_active = false;
+    return;
+  }
+
+  // Memory Browse Mode has the radio keys while it is active
+  if (memory_mode_is_active()) {
+    if (!memory_mode_handle_key(kp->key, kp->isHold)) {
+      announce_unhandled_key(kp);
+    }
+    g_shift_active = false;
     return;
   }
 
@@ -120,13 +258,7 @@ static void on_keypress(const KeyPressEvent *kp) {
   }
 
   // Key not consumed by any mode - announce it
-  char text[32];
-  if (kp->isHold) {
-    snprintf(text, sizeof(text), "Held %c", kp->key);
-  } else {
-    snprintf(text, sizeof(text), "Pressed %c", kp->key);
-  }
-  speech_say_text(text);
+  announce_unhandled_key(kp);
 
   // Even unhandled keys clear shift
   if (was_shifted) {
@@ -138,13 +270,66 @@ static void on_keypress(const KeyPressEvent *kp) {
 // Radio Connect/Disconnect Callbacks
 // ============================================================================
 
+// The active radio's Hamlib model, which picks its key bindings
+static int active_radio_model(void) {
+  int model = config_get_radio_detected_model();
+  return model > 0 ? model : config_get_radio_model();
+}
+
+// Every frequency the radio reports: remembered in its band, then
+// announced. A scan announces its own channels.
+static void on_radio_frequency(double new_freq) {
+  if (scan_is_active()) {
+    return;
+  }
+  band_stack_remember(new_freq);
+  frequency_mode_on_radio_change(new_freq);
+  normal_mode_warm_readouts(new_freq);
+}
+
+// With the event loop, dial changes are handled there, in order with the
+// keys that touch the same frequency mode state. Only the latest counts.
+static double g_loop_freq;              // Atomic
+static bool g_loop_freq_posted = false; // Atomic
+
+static void on_radio_frequency_loop(void *arg) {
+  (void)arg;
+  __atomic_store_n(&g_loop_freq_posted, false, __ATOMIC_RELEASE);
+  double freq;
+  __atomic_load(&g_loop_freq, &freq, __ATOMIC_ACQUIRE);
+  on_radio_frequency(freq);
+}
+
+static void on_radio_frequency_changed(double new_freq) {
+  if (!evloop_running()) {
+    on_radio_frequency(new_freq);
+    return;
+  }
+  __atomic_store(&g_loop_freq, &new_freq, __ATOMIC_RELEASE);
+  if (!__atomic_exchange_n(&g_loop_freq_posted, true, __ATOMIC_ACQ_REL) &&
+      evloop_post(on_radio_frequency_loop, NULL) != 0) {
+    __atomic_store_n(&g_loop_freq_posted, false, __ATOMIC_RELEASE);
+    on_radio_frequency(new_freq);
+  }
+}
+
+// Memories are browsed from a local index: read it now, in the background,
+// unless an earlier session did
+static void read_memory_index(void) {
+  memory_index_select(radio_get_active(), active_radio_model());
+  memory_index_read(false, NULL);
+}
+
 static void on_radio_connected(void) {
   printf("Radio connected!\n");
   speech_say_text("Radio connected");
+  keymap_select_model(active_radio_model());
+
+  read_memory_index();
 
   // Start polling for VFO dial changes
   if (!radio_is_polling()) {
-    if (radio_start_polling(frequency_mode_on_radio_change) == 0) {
+    if (radio_start_polling(on_radio_frequency_changed) == 0) {
       printf("Radio polling started (1-second debounce)\n");
     }
   }
@@ -152,7 +337,134 @@ static void on_radio_connected(void) {
 
 static void on_radio_disconnected(void) {
   printf("Radio disconnected.\n");
-  speech_say_text("Radio disconnected");
+  speech_say_text_priority("Radio disconnected", SPEECH_URGENT);
+}
+
+// ============================================================================
+// Startup
+// ============================================================================
+
+// The radio connects on a thread of its own while Firmware comes up, since
+// a rig that is off or on the wrong port can hold the serial open for
+// seconds. It needs only the config; the announcement waits for speech.
+static pthread_t g_radio_connect_thread;
+static bool g_radio_connecting = false;
+static int g_radio_connect_result = -1;
+
+static void *radio_connect_thread(void *arg) {
+  long long started = boot_clock_ms();
+  g_radio_connect_result = radio_init(*(const bool *)arg);
+  boot_log_phase("hampod", "radio-connect", started);
+  return NULL;
+}
+
+// Boot log: when main() began, and when "Ready" has been said
+static long long g_boot_started = 0;
+
+static void on_ready_spoken(unsigned int id, void *context) {
+  (void)id;
+  (void)context;
+  boot_log_phase("hampod", "first-speech", g_boot_started);
+}
+
+static void radio_connect_begin(const bool *debug_mode) {
+  printf("Connecting to radio...\n");
+  g_radio_connecting = pthread_create(&g_radio_connect_thread, NULL,
+                                      radio_connect_thread,
+                                      (void *)debug_mode) == 0;
+  if (!g_radio_connecting) {
+    g_radio_connect_result = radio_init(*debug_mode);
+  }
+}
+
+// Wait for radio_connect_begin(); 0 if the radio connected
+static int radio_connect_finish(void) {
+  if (g_radio_connecting) {
+    pthread_join(g_radio_connect_thread, NULL);
+    g_radio_connecting = false;
+  }
+  return g_radio_connect_result;
+}
+
+// ============================================================================
+// Memory Profile
+// ============================================================================
+
+static bool low_memory_profile(void) {
+  return strcmp(config_get_scheduling()->memory_profile, "low") == 0;
+}
+
+// The configured speech cache RAM, held down on a low-memory board. Firmware
+// caps its own defaults (run_hampod.sh --memory-profile); this one is sent.
+static int tts_ram_mb(void) {
+  int mb = config_get_tts_ram_mb();
+  if (low_memory_profile() && mb > MEMORY_LOW_TTS_RAM_MB) {
+    mb = MEMORY_LOW_TTS_RAM_MB;
+  }
+  return mb;
+}
+
+// Send the beep tones set in hampod.conf. At startup (all false) a beep
+// left unset keeps Firmware's default without a round trip.
+static void apply_beep_tones(bool all) {
+  for (int beep = COMM_BEEP_KEYPRESS; beep <= COMM_BEEP_ERROR; beep++) {
+    const char *spec = config_get_beep_tone(beep);
+    if (!all && spec[0] == '\0') {
+      continue;
+    }
+    if (comm_set_beep_tone((CommBeepType)beep, spec) != HAMPOD_OK) {
+      printf("WARNING: Firmware did not apply beep tone '%s'\n", spec);
+    }
+  }
+}
+
+// ============================================================================
+// Config File Edits
+// ============================================================================
+
+// Push the settings an edit of hampod.conf changed (on the watch thread).
+// Lowering a priority to 0 only takes effect in Software2 at restart.
+static void on_config_changed(unsigned changed) {
+  if (changed & CONFIG_CHANGED_VOLUME) {
+    comm_set_volume(config_get_volume());
+  }
+  if (changed & CONFIG_CHANGED_SPEECH_SPEED) {
+    comm_set_speech_speed(config_get_speech_speed());
+  }
+  if (changed & CONFIG_CHANGED_BEEP) {
+    keypad_update_beep();
+  }
+  if (changed & CONFIG_CHANGED_VERBOSITY) {
+    announce_set_style(config_get_terse_enabled() ? ANNOUNCE_TERSE
+                                                  : ANNOUNCE_VERBOSE);
+  }
+  if (changed & CONFIG_CHANGED_TTS_RAM) {
+    comm_set_tts_ram(tts_ram_mb());
+  }
+  if (changed & CONFIG_CHANGED_BEEP_TONE) {
+    apply_beep_tones(true);
+  }
+  if (changed & CONFIG_CHANGED_SPELL) {
+    speech_set_spell_style(config_get_spell_phonetic(),
+                           config_get_spell_gap_ms());
+  }
+  if (changed & CONFIG_CHANGED_VOICE) {
+    speech_set_priority_voice(SPEECH_URGENT, config_get_alert_voice());
+  }
+  if (changed & CONFIG_CHANGED_LAYOUT) {
+    const char *layout = config_get_keypad_layout();
+    comm_send_config_packet(0x01, strcmp(layout, "phone") == 0 ? 1 : 0);
+  }
+  if (changed & CONFIG_CHANGED_SCHEDULING) {
+    const SchedulingSettings *sched = config_get_scheduling();
+    comm_set_audio_priority(sched->audio_priority);
+    sched_set_priority(speech_get_thread(), sched->audio_priority,
+                       "Speech thread");
+    sched_set_priority(keypad_get_thread(), sched->keypad_priority,
+                       "Keypad thread");
+    sched_set_priority(radio_worker_get_thread(), sched->keypad_priority,
+                       "Radio worker");
+  }
 }
 
 // ============================================================================
@@ -160,11 +472,18 @@ static void on_radio_disconnected(void) {
 // ============================================================================
 
 int main(int argc, char *argv[]) {
+  g_boot_started = boot_clock_ms();
   printf("=== HAMPOD2026 Frequency/Normal Mode ===\n\n");
 
   // Set up signal handler for clean shutdown
+  sem_init(&g_main_wake, 0, 0);
   signal(SIGINT, signal_handler);
   signal(SIGTERM, signal_handler);
+  signal(SIGUSR1, latency_signal_handler);
+  hampod_alloc_dump_on_signal("hampod");
+  hampod_trace_open("hampod");
+  hampod_metrics_open("hampod");
+  hampod_log_start();
 
   // Check args
   bool skip_radio = false;
@@ -180,30 +499,83 @@ int main(int argc, char *argv[]) {
   }
 
   // Initialize config
+  long long phase_started = boot_clock_ms();
   printf("Initializing config...\n");
   if (config_init(NULL) != 0) {
     printf("WARNING: Config init failed, using defaults\n");
   }
 
+  // What sets each rig model apart, then the features earlier sessions
+  // found missing on it
+  radio_defs_init(NULL);
+  radio_caps_init(NULL);
+
+  // Key bindings: built-in, then the keymap file's for this radio
+  keymap_init(NULL);
+  keymap_select_model(active_radio_model());
+
+  // Where the operator last was on each band
+  band_stack_init(NULL);
+  memory_index_init(NULL);
+
+  // Keep I/O to its cores; the speech and keypad threads inherit this
+  const SchedulingSettings *sched = config_get_scheduling();
+  sched_pin_cpus(sched->io_cpus, "Software2");
+  if (sched->mlock) {
+    // Before the keypad and speech threads start, so their stacks are
+    // mapped and locked whole: a key press never waits on swap
+    sched_lock_memory("Software2");
+  }
+  if (low_memory_profile()) {
+    printf("Memory profile low: speech queue %d, TTS cache %d MB RAM\n",
+           MEMORY_LOW_SPEECH_QUEUE, tts_ram_mb());
+    speech_set_max_queue_size(MEMORY_LOW_SPEECH_QUEUE);
+  }
+  if (sched->idle_mode) {
+    printf("Idle mode: housekeeping slows down after %d s without keys\n",
+           IDLE_MODE_AFTER_MS / 1000);
+  }
+  idle_set_mode(sched->idle_mode, IDLE_MODE_AFTER_MS);
+  if (sched->event_loop) {
+    // Before comm: the router starts on it once Firmware is ready
+    if (evloop_start() == 0) {
+      printf("Event loop: Firmware replies, keys and dial changes\n");
+    } else {
+      printf("WARNING: Event loop not started, using threads\n");
+    }
+  }
+  boot_log_phase("hampod", "config", phase_started);
+
+  // Start on the radio now; it is waited for once speech and keys are up
+  if (!skip_radio) {
+    radio_connect_begin(&debug_mode);
+  }
+
   // Initialize comm (Firmware pipes)
   printf("Connecting to Firmware...\n");
+  phase_started = boot_clock_ms();
   if (comm_init() != 0) {
     fprintf(stderr, "ERROR: Could not connect to Firmware\n");
     fprintf(stderr, "Is firmware.elf running?\n");
+    radio_connect_finish();
     config_cleanup();
     return 1;
   }
 
   // Wait for Firmware ready
+  boot_log_phase("hampod", "comm", phase_started);
   printf("Waiting for Firmware ready signal...\n");
+  phase_started = boot_clock_ms();
   if (comm_wait_ready() != 0) {
     fprintf(stderr, "ERROR: Firmware not ready\n");
+    radio_connect_finish();
     comm_close();
     config_cleanup();
     return 1;
   }
 
-  // Apply volume setting to USB audio
+  boot_log_phase("hampod", "firmware-ready", phase_started);
+
   // Query the actual card number from Firmware (determined at startup)
   int card_number = 2; // Default fallback
   if (comm_query_audio_card_number(&card_number) == 0) {
@@ -220,56 +592,74 @@ int main(int argc, char *argv[]) {
   comm_set_speech_speed(speech_speed);
 
   int volume = config_get_volume();
-  printf("Setting volume to %d%% on card %d...\n", volume, card_number);
-  char vol_cmd[256];
-  snprintf(vol_cmd, sizeof(vol_cmd),
-           "amixer -c %d -q sset Speaker %d%% 2>/dev/null || "
-           "amixer -c %d -q sset PCM %d%% 2>/dev/null || "
-           "amixer -c %d -q sset Master %d%% 2>/dev/null",
-           card_number, volume, card_number, volume, card_number, volume);
-  if (system(vol_cmd) != 0) {
-    printf("WARNING: Volume command failed, trying default device\n");
-    snprintf(vol_cmd, sizeof(vol_cmd),
-             "amixer -q sset Speaker %d%% 2>/dev/null || "
-             "amixer -q sset PCM %d%% 2>/dev/null || "
-             "amixer -q sset Master %d%% 2>/dev/null",
-             volume, volume, volume);
-    system(vol_cmd);
+  printf("Setting volume to %d%%\n", volume);
+  if (comm_set_volume(volume) != HAMPOD_OK) {
+    printf("WARNING: Firmware did not apply the volume\n");
   }
 
+  if (comm_set_tts_ram(tts_ram_mb()) != HAMPOD_OK) {
+    printf("WARNING: Firmware did not apply the TTS cache size\n");
+  }
+  apply_beep_tones(false);
+
+  announce_set_style(config_get_terse_enabled() ? ANNOUNCE_TERSE
+                                                : ANNOUNCE_VERBOSE);
+  speech_set_spell_style(config_get_spell_phonetic(),
+                         config_get_spell_gap_ms());
+  speech_set_priority_voice(SPEECH_URGENT, config_get_alert_voice());
+
   // Initialize speech
   printf("Initializing speech...\n");
+  phase_started = boot_clock_ms();
   if (speech_init() != 0) {
     fprintf(stderr, "ERROR: Speech init failed\n");
+    radio_connect_finish();
     comm_close();
     config_cleanup();
     return 1;
   }
+  sched_set_priority(speech_get_thread(), sched->audio_priority,
+                     "Speech thread");
+  boot_log_phase("hampod", "speech", phase_started);
+
+  // Radio commands from key presses run here, not on the keypad thread
+  if (radio_worker_start() == 0) {
+    sched_set_priority(radio_worker_get_thread(), sched->keypad_priority,
+                       "Radio worker");
+  } else {
+    printf("WARNING: Radio worker not started, radio commands block keys\n");
+  }
 
   // Initialize keypad
   printf("Initializing keypad...\n");
+  phase_started = boot_clock_ms();
   if (keypad_init() != 0) {
     fprintf(stderr, "ERROR: Keypad init failed\n");
+    radio_connect_finish();
+    radio_worker_stop();
     speech_shutdown();
     comm_close();
     config_cleanup();
     return 1;
   }
+  sched_set_priority(keypad_get_thread(), sched->keypad_priority,
+                     "Keypad thread");
   keypad_register_callback(on_keypress);
+  boot_log_phase("hampod", "keypad", phase_started);
 
-  // Initialize radio with auto-reconnect
+  // Radio connected meanwhile (radio_connect_begin); now it can be heard
   if (!skip_radio) {
-    printf("Connecting to radio...\n");
-    if (radio_init(debug_mode) != 0) {
+    if (radio_connect_finish() != 0) {
       printf(
           "WARNING: Could not connect to radio (will retry automatically)\n");
       speech_say_text("Radio not found. Will retry.");
     } else {
       printf("Radio connected!\n");
       speech_say_text("Radio connected");
+      read_memory_index();
 
       // Start polling for VFO dial changes
-      if (radio_start_polling(frequency_mode_on_radio_change) == 0) {
+      if (radio_start_polling(on_radio_frequency_changed) == 0) {
         printf("Radio polling started (1-second debounce)\n");
       }
     }
@@ -278,6 +668,11 @@ int main(int argc, char *argv[]) {
     radio_start_reconnect(on_radio_connected, on_radio_disconnected);
   }
 
+  // Latency SLOs, and the audio link check should Firmware stop answering
+  if (watchdog_start(sched->watchdog_ms) != 0) {
+    printf("WARNING: Watchdog not started\n");
+  }
+
   // Initialize frequency mode
   frequency_mode_init();
 
@@ -290,31 +685,81 @@ int main(int argc, char *argv[]) {
   // Initialize config mode
   config_mode_init();
 
+  // Spoken frequency and mode commands (Firmware built with voice input)
+  voice_command_init();
+
+  // Antenna rotor, if [rotor] names one: its own worker and poll thread
+  if (rotor_init(rotor_mode_on_stop) == 0) {
+    printf("Rotor started ([D] held selects it)\n");
+  }
+
+  // Hand edits of hampod.conf from here on apply at once
+  if (config_watch_start(on_config_changed) != 0) {
+    printf("WARNING: Config edits will need a restart\n");
+  }
+
+  // Local control API, if [api] names a socket
+  const char *api_socket = config_get_api()->socket;
+  if (api_socket[0] != '\0' && api_start(api_socket) != HAMPOD_OK) {
+    printf("WARNING: Control API not started\n");
+  }
+
   // Announce startup
   printf("\nStartup complete. Normal mode active.\n");
   printf("Press [#] to enter frequency mode.\n");
   printf("Press Ctrl+C to exit.\n\n");
   speech_say_text("Ready");
+  boot_log_phase("hampod", "ready", g_boot_started);
+  speech_on_complete(speech_last_id(), on_ready_spoken, NULL);
 
-  // Main loop - just keep running while keypad thread handles input
+  // Main loop - the keypad thread handles input; sleep until a signal
   while (g_running) {
-    // Sleep to avoid busy-waiting
-    struct timespec ts = {0, 100000000}; // 100ms
-    nanosleep(&ts, NULL);
+    sem_wait(&g_main_wake);
+
+    if (g_latency_wanted) {
+      g_latency_wanted = 0;
+      write_latency_report();
+    }
   }
 
   // Cleanup
   printf("\nCleaning up...\n");
 
+  api_stop();
+  config_watch_stop();
+  tuning_tone_stop();
+  cw_stop();
+  scan_stop();
+  meter_stop();
+  rotor_cleanup();
+  radio_worker_stop();
+
   radio_stop_reconnect();
   if (radio_is_connected()) {
     radio_stop_polling();
     radio_cleanup();
   }
+  idle_shutdown();
+  band_stack_save();
+
+  CommAudioStats audio_stats;
+  if (comm_query_audio_stats(&audio_stats) == HAMPOD_OK) {
+    printf("Audio: %d underruns, ALSA buffer %d ms after %d resizes\n",
+           audio_stats.underruns, audio_stats.buffer_ms, audio_stats.resizes);
+  }
+  CommTtsStats tts_stats;
+  if (comm_query_tts_stats(&tts_stats) == HAMPOD_OK) {
+    printf("TTS cache: %d RAM hits, %d disk hits, %d misses, %d entries\n",
+           tts_stats.ram_hits, tts_stats.disk_hits, tts_stats.misses,
+           tts_stats.entries);
+  }
+  speech_report_latency(stdout);
+  radio_trace_report(stdout);
 
   keypad_shutdown();
   speech_shutdown();
   comm_close();
+  evloop_stop();
   config_cleanup();
 
   printf("Goodbye!\n");
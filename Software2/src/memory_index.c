@@ -0,0 +1,437 @@
+/**
+ * @file memory_index.c
+ * @brief Memory channel index implementation
+ */
+
+#include "memory_index.h"
+#include "hampod_core.h"
+#include "radio.h"
+#include "radio_worker.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+// ============================================================================
+// State
+// ============================================================================
+
+#define READ_CHUNK 8 // Channels per radio command
+
+// Guarded by g_index_mutex. g_memories is sorted by channel number and
+// holds only channels in use.
+static RadioMemory g_memories[MEMORY_INDEX_MAX];
+static int g_count = 0;
+static int g_radio = -1; // Radio whose index this is
+static int g_model = 0;
+static bool g_complete = false;
+static bool g_reading = false;
+static unsigned int g_generation = 0; // Bumped to drop a read under way
+static MemoryIndexReadDone g_read_done = NULL;
+
+static char g_path_format[256] = MEMORY_INDEX_DEFAULT_PATH;
+static pthread_mutex_t g_index_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief A chunk of the bulk read, the command's argument
+ */
+typedef struct {
+  unsigned int generation;
+  int radio;
+  int next; // Next channel to read, -1 before the range is known
+  int last;
+} ReadChunk;
+
+static RadioMemory g_chunk[READ_CHUNK]; // Radio worker only
+
+// ============================================================================
+// Internal Functions
+// ============================================================================
+
+static void index_path(int radio, char *path, size_t size) {
+  snprintf(path, size, g_path_format, radio + 1);
+}
+
+// Position of a channel, or where it would go. Call with g_index_mutex held.
+static int find_slot(int channel, bool *found) {
+  int low = 0;
+  int high = g_count;
+  while (low < high) {
+    int mid = (low + high) / 2;
+    if (g_memories[mid].channel < channel) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  *found = low < g_count && g_memories[low].channel == channel;
+  return low;
+}
+
+// Call with g_index_mutex held
+static void store_one(const RadioMemory *memory) {
+  bool found;
+  int slot = find_slot(memory->channel, &found);
+
+  if (memory->freq_hz <= 0) {
+    if (found) {
+      memmove(&g_memories[slot], &g_memories[slot + 1],
+              (g_count - slot - 1) * sizeof(RadioMemory));
+      g_count--;
+    }
+    return;
+  }
+  if (!found) {
+    if (g_count == MEMORY_INDEX_MAX) {
+      return;
+    }
+    memmove(&g_memories[slot + 1], &g_memories[slot],
+            (g_count - slot) * sizeof(RadioMemory));
+    g_count++;
+  }
+  g_memories[slot] = *memory;
+}
+
+// Write the index. Call with g_index_mutex held.
+static void save_index(void) {
+  char path[sizeof(g_path_format) + 16];
+  char tmp_path[sizeof(path) + 4];
+  index_path(g_radio, path, sizeof(path));
+  snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+  FILE *out = fopen(tmp_path, "w");
+  if (out == NULL) {
+    fprintf(stderr, "memory_index: Cannot write %s\n", tmp_path);
+    return;
+  }
+
+  fprintf(out, "# Memory channels of radio %d, as last read from it.\n",
+          g_radio + 1);
+  fprintf(out, "# Mode is a Hamlib mode number; the name runs to the end.\n");
+  fprintf(out, "model %d\n", g_model);
+  fprintf(out, "# channel freq_hz mode passband_hz name\n");
+  for (int i = 0; i < g_count; i++) {
+    const RadioMemory *m = &g_memories[i];
+    fprintf(out, "%d %.0f %d %d %s\n", m->channel, m->freq_hz, m->mode,
+            m->passband_hz, m->name);
+  }
+  fclose(out);
+  rename(tmp_path, path);
+}
+
+// Load the selected radio's file. Call with g_index_mutex held.
+static void load_index(void) {
+  char path[sizeof(g_path_format) + 16];
+  index_path(g_radio, path, sizeof(path));
+  FILE *in = fopen(path, "r");
+  if (in == NULL) {
+    return; // Never read
+  }
+
+  char line[128];
+  bool model_matches = false;
+  while (fgets(line, sizeof(line), in)) {
+    int model;
+    RadioMemory memory;
+    int name_at = 0;
+    if (line[0] == '#') {
+      continue;
+    }
+    if (sscanf(line, "model %d", &model) == 1) {
+      model_matches = model == g_model;
+      if (!model_matches) {
+        break; // Another rig on this port now: read it again
+      }
+      continue;
+    }
+    memset(&memory, 0, sizeof(memory));
+    if (!model_matches ||
+        sscanf(line, "%d %lf %d %d %n", &memory.channel, &memory.freq_hz,
+               &memory.mode, &memory.passband_hz, &name_at) != 4) {
+      continue;
+    }
+    line[strcspn(line, "\r\n")] = '\0';
+    snprintf(memory.name, sizeof(memory.name), "%s", line + name_at);
+    store_one(&memory);
+  }
+  fclose(in);
+
+  g_complete = model_matches;
+  if (!model_matches) {
+    g_count = 0;
+  }
+  DEBUG_PRINT("memory_index: %d channels from %s\n", g_count, path);
+}
+
+// ============================================================================
+// Radio Commands
+// ============================================================================
+
+/**
+ * @brief Radio command: read the next chunk of memories (run on the radio
+ *        worker)
+ */
+static int run_read_chunk(void *arg) {
+  ReadChunk *chunk = arg;
+
+  if (radio_get_active() != chunk->radio || !radio_is_connected()) {
+    return -1; // Switched radios; selecting this one again reads it
+  }
+  if (chunk->next < 0 &&
+      radio_memory_range(&chunk->next, &chunk->last) != 0) {
+    return -1; // No memories Hamlib can read directly
+  }
+
+  int count = chunk->last - chunk->next + 1;
+  if (count > READ_CHUNK) {
+    count = READ_CHUNK;
+  }
+  int read = radio_read_memories(chunk->next, count, g_chunk);
+  if (read <= 0) {
+    return -1;
+  }
+
+  pthread_mutex_lock(&g_index_mutex);
+  if (chunk->generation == g_generation) {
+    for (int i = 0; i < read; i++) {
+      store_one(&g_chunk[i]);
+    }
+  }
+  pthread_mutex_unlock(&g_index_mutex);
+  chunk->next += read;
+  return 0;
+}
+
+static void read_chunk_done(int result, void *arg) {
+  const ReadChunk *chunk = arg;
+
+  pthread_mutex_lock(&g_index_mutex);
+  if (chunk->generation != g_generation) {
+    pthread_mutex_unlock(&g_index_mutex);
+    return; // Dropped, or superseded by another read
+  }
+
+  if (result == 0 && chunk->next <= chunk->last) {
+    pthread_mutex_unlock(&g_index_mutex);
+    if (radio_worker_submit(RADIO_CMD_BACKGROUND, RADIO_KEY_MEMORY,
+                            run_read_chunk, read_chunk_done, chunk,
+                            sizeof(*chunk)) == 0) {
+      return;
+    }
+    pthread_mutex_lock(&g_index_mutex);
+    result = -1;
+  }
+
+  g_reading = false;
+  int count = -1;
+  if (result == 0) {
+    g_complete = true;
+    count = g_count;
+    save_index();
+  }
+  MemoryIndexReadDone on_done = g_read_done;
+  g_read_done = NULL;
+  pthread_mutex_unlock(&g_index_mutex);
+
+  printf("memory_index: Radio %d: %s\n", chunk->radio + 1,
+         result == 0 ? "memories read" : "memories not read");
+  if (on_done) {
+    on_done(count);
+  }
+}
+
+/**
+ * @brief Radio command: read one channel again (run on the radio worker)
+ */
+static int run_reread(void *arg) {
+  const ReadChunk *chunk = arg;
+  RadioMemory memory;
+
+  if (radio_get_active() != chunk->radio ||
+      radio_read_memories(chunk->next, 1, &memory) != 1) {
+    return -1;
+  }
+  pthread_mutex_lock(&g_index_mutex);
+  if (chunk->generation == g_generation) {
+    store_one(&memory);
+    if (!g_reading && g_complete) {
+      save_index();
+    }
+  }
+  pthread_mutex_unlock(&g_index_mutex);
+  return 0;
+}
+
+// ============================================================================
+// Lifecycle
+// ============================================================================
+
+int memory_index_init(const char *path_format) {
+  pthread_mutex_lock(&g_index_mutex);
+  snprintf(g_path_format, sizeof(g_path_format), "%s",
+           path_format ? path_format : MEMORY_INDEX_DEFAULT_PATH);
+  g_radio = -1;
+  g_model = 0;
+  g_count = 0;
+  g_complete = false;
+  g_reading = false;
+  g_generation++;
+  pthread_mutex_unlock(&g_index_mutex);
+  return 0;
+}
+
+void memory_index_select(int radio, int model) {
+  pthread_mutex_lock(&g_index_mutex);
+  if (radio == g_radio && model == g_model) {
+    pthread_mutex_unlock(&g_index_mutex);
+    return;
+  }
+
+  g_generation++; // A read of the other radio is no use to this one
+  g_reading = false;
+  g_read_done = NULL;
+  g_radio = radio;
+  g_model = model;
+  g_count = 0;
+  g_complete = false;
+  load_index();
+  pthread_mutex_unlock(&g_index_mutex);
+}
+
+// ============================================================================
+// Reading
+// ============================================================================
+
+int memory_index_read(bool force, MemoryIndexReadDone on_done) {
+  pthread_mutex_lock(&g_index_mutex);
+  if (g_radio < 0 || (g_complete && !force)) {
+    pthread_mutex_unlock(&g_index_mutex);
+    return g_radio < 0 ? -1 : 0;
+  }
+  if (g_reading) {
+    g_read_done = on_done;
+    pthread_mutex_unlock(&g_index_mutex);
+    return 0;
+  }
+
+  ReadChunk chunk = {++g_generation, g_radio, -1, -1};
+  g_reading = true;
+  g_read_done = on_done;
+  pthread_mutex_unlock(&g_index_mutex);
+
+  DEBUG_PRINT("memory_index_read: radio %d\n", chunk.radio + 1);
+  if (radio_worker_submit(RADIO_CMD_BACKGROUND, RADIO_KEY_MEMORY,
+                          run_read_chunk, read_chunk_done, &chunk,
+                          sizeof(chunk)) != 0) {
+    pthread_mutex_lock(&g_index_mutex);
+    if (chunk.generation == g_generation) {
+      g_reading = false;
+      g_read_done = NULL;
+    }
+    pthread_mutex_unlock(&g_index_mutex);
+    return -1;
+  }
+  return 0;
+}
+
+bool memory_index_is_reading(void) {
+  pthread_mutex_lock(&g_index_mutex);
+  bool reading = g_reading;
+  pthread_mutex_unlock(&g_index_mutex);
+  return reading;
+}
+
+bool memory_index_is_complete(void) {
+  pthread_mutex_lock(&g_index_mutex);
+  bool complete = g_complete;
+  pthread_mutex_unlock(&g_index_mutex);
+  return complete;
+}
+
+void memory_index_store(const RadioMemory *memories, int count) {
+  pthread_mutex_lock(&g_index_mutex);
+  for (int i = 0; i < count; i++) {
+    store_one(&memories[i]);
+  }
+  if (!g_reading && g_complete) {
+    save_index();
+  }
+  pthread_mutex_unlock(&g_index_mutex);
+}
+
+void memory_index_invalidate(int channel) {
+  pthread_mutex_lock(&g_index_mutex);
+  if (g_radio < 0) {
+    pthread_mutex_unlock(&g_index_mutex);
+    return;
+  }
+
+  if (channel < 0) {
+    char path[sizeof(g_path_format) + 16];
+    index_path(g_radio, path, sizeof(path));
+    unlink(path);
+    g_generation++;
+    g_reading = false;
+    g_read_done = NULL;
+    g_count = 0;
+    g_complete = false;
+    pthread_mutex_unlock(&g_index_mutex);
+    return;
+  }
+
+  RadioMemory gone = {.channel = channel};
+  store_one(&gone);
+  ReadChunk chunk = {g_generation, g_radio, channel, channel};
+  pthread_mutex_unlock(&g_index_mutex);
+
+  // Not under RADIO_KEY_MEMORY: that would supersede a chunk of a read
+  radio_worker_submit(RADIO_CMD_BACKGROUND, RADIO_KEY_NONE, run_reread, NULL,
+                      &chunk, sizeof(chunk));
+}
+
+// ============================================================================
+// Browsing
+// ============================================================================
+
+int memory_index_count(void) {
+  pthread_mutex_lock(&g_index_mutex);
+  int count = g_count;
+  pthread_mutex_unlock(&g_index_mutex);
+  return count;
+}
+
+bool memory_index_get(int channel, RadioMemory *memory) {
+  pthread_mutex_lock(&g_index_mutex);
+  bool found;
+  int slot = find_slot(channel, &found);
+  if (found) {
+    *memory = g_memories[slot];
+  }
+  pthread_mutex_unlock(&g_index_mutex);
+  return found;
+}
+
+bool memory_index_step(int channel, int direction, RadioMemory *memory) {
+  pthread_mutex_lock(&g_index_mutex);
+  if (g_count == 0) {
+    pthread_mutex_unlock(&g_index_mutex);
+    return false;
+  }
+
+  int slot;
+  if (channel < 0) {
+    slot = direction > 0 ? 0 : g_count - 1;
+  } else {
+    bool found;
+    slot = find_slot(channel, &found);
+    if (direction > 0) {
+      slot = found ? slot + 1 : slot; // The first one above it
+    } else {
+      slot--; // The first one below it
+    }
+    slot = (slot + g_count) % g_count;
+  }
+  *memory = g_memories[slot];
+  pthread_mutex_unlock(&g_index_mutex);
+  return true;
+}
@@ -0,0 +1,227 @@
+/**
+ * @file memory_mode.c
+ * @brief Memory Browse Mode implementation
+ */
+
+#include "memory_mode.h"
+#include "announce.h"
+#include "config.h"
+#include "frequency_mode.h"
+#include "hampod_core.h"
+#include "memory_index.h"
+#include "radio.h"
+#include "radio_queries.h"
+#include "radio_setters.h"
+#include "radio_worker.h"
+#include "speech.h"
+
+#include <stdio.h>
+
+// ============================================================================
+// State
+// ============================================================================
+
+static bool g_active = false; // Read on the radio worker by read_done()
+static int g_channel = -1;    // Keypad thread only; -1 before the first
+
+/**
+ * @brief What a recall sets, the command's argument
+ */
+typedef struct {
+  double freq_hz;
+  int mode;
+  int passband_hz;
+} MemoryRecall;
+
+// ============================================================================
+// Internal Functions
+// ============================================================================
+
+static bool is_active(void) {
+  return __atomic_load_n(&g_active, __ATOMIC_RELAXED);
+}
+
+static void set_active(bool active) {
+  __atomic_store_n(&g_active, active, __ATOMIC_RELAXED);
+}
+
+static void announce_memory(const RadioMemory *memory) {
+  Announcement a;
+  announce_init(&a);
+  announce_label(&a, "Channel", "");
+  announce_number(&a, memory->channel);
+  if (memory->name[0] != '\0') {
+    announce_text(&a, memory->name);
+  }
+  announce_frequency(&a, memory->freq_hz);
+  if (memory->mode > 0) {
+    announce_mode(&a, radio_mode_name(memory->mode));
+  }
+  announce_say_latest(&a, SPEECH_INTERACTIVE, SPEECH_SLOT_FREQUENCY, true);
+}
+
+static void step(int direction) {
+  RadioMemory memory;
+  if (!memory_index_step(g_channel, direction, &memory)) {
+    speech_say_text(memory_index_is_reading() ? "Reading memories"
+                                              : "No memories");
+    return;
+  }
+  g_channel = memory.channel;
+  announce_memory(&memory);
+}
+
+static void repeat_channel(void) {
+  RadioMemory memory;
+  if (g_channel >= 0 && memory_index_get(g_channel, &memory)) {
+    announce_memory(&memory);
+  } else {
+    step(1);
+  }
+}
+
+/**
+ * @brief Called on the radio worker when the memory read finished
+ */
+static void read_done(int count) {
+  if (!is_active()) {
+    return;
+  }
+  if (count < 0) {
+    speech_say_text("Memories not available");
+    return;
+  }
+  Announcement a;
+  announce_init(&a);
+  announce_number(&a, count);
+  announce_text(&a, "memories");
+  announce_say(&a, SPEECH_INTERACTIVE);
+}
+
+static void read_memories(bool force) {
+  if (memory_index_read(force, read_done) != 0) {
+    speech_say_text("Memories not available");
+  } else if (memory_index_is_reading()) {
+    speech_say_text("Reading memories");
+  }
+}
+
+/**
+ * @brief Radio command: tune to a memory's frequency and mode (run on the
+ *        radio worker)
+ */
+static int run_recall(void *arg) {
+  const MemoryRecall *recall = arg;
+  if (radio_set_frequency(recall->freq_hz) != 0) {
+    return -1;
+  }
+  if (recall->mode > 0 &&
+      radio_set_mode_raw(recall->mode, recall->passband_hz) == -1) {
+    return -1;
+  }
+  return 0;
+}
+
+static void recall_done(int result, void *arg) {
+  (void)arg;
+  if (result != 0 && result != RADIO_CMD_CANCELLED) {
+    speech_say_text_priority("Recall failed", SPEECH_URGENT);
+  }
+}
+
+static void recall(void) {
+  RadioMemory memory;
+  if (g_channel < 0 || !memory_index_get(g_channel, &memory)) {
+    speech_say_text("No channel");
+    return;
+  }
+
+  MemoryRecall args = {memory.freq_hz, memory.mode, memory.passband_hz};
+  set_active(false);
+  DEBUG_PRINT("memory_mode: recall channel %d\n", memory.channel);
+
+  // Said here already; the poller would announce it again
+  frequency_mode_suppress_next_poll();
+  speech_say_text("Recalled");
+  if (radio_worker_submit(RADIO_CMD_USER, RADIO_KEY_FREQUENCY, run_recall,
+                          recall_done, &args, sizeof(args)) != 0) {
+    recall_done(-1, &args);
+  }
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+void memory_mode_enter(void) {
+  int radio = radio_get_active();
+  const RadioSettings *settings = config_get_radio(radio);
+  int model = 0;
+  if (settings != NULL) {
+    model = settings->detected_model > 0 ? settings->detected_model
+                                         : settings->model;
+  }
+  memory_index_select(radio, model);
+  set_active(true);
+
+  RadioMemory memory;
+  if (g_channel >= 0 && memory_index_get(g_channel, &memory)) {
+    announce_memory(&memory); // Where the last browse left off
+  } else if (memory_index_step(-1, 1, &memory)) {
+    g_channel = memory.channel;
+    announce_memory(&memory);
+  } else if (!memory_index_is_complete()) {
+    read_memories(false);
+    return;
+  } else {
+    speech_say_text("No memories");
+  }
+
+  // The channels read so far are browsed while the rest are read
+  if (!memory_index_is_complete()) {
+    memory_index_read(false, read_done);
+  }
+}
+
+bool memory_mode_is_active(void) { return is_active(); }
+
+bool memory_mode_handle_key(char key, bool is_hold) {
+  if (!is_active()) {
+    return false;
+  }
+
+  switch (key) {
+  case '6':
+    step(1);
+    return true;
+  case '4':
+    step(-1);
+    return true;
+  case '5':
+    repeat_channel();
+    return true;
+  case '#':
+    recall();
+    return true;
+  case '0':
+    if (!is_hold) {
+      return false;
+    }
+    read_memories(true);
+    return true;
+  case 'D':
+    set_active(false);
+    speech_say_text("Memories closed");
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool memory_mode_handle_repeat(char key) {
+  if (!is_active() || (key != '6' && key != '4')) {
+    return false;
+  }
+  step(key == '6' ? 1 : -1);
+  return true;
+}
@@ -0,0 +1,354 @@
+/**
+ * @file meter.c
+ * @brief Meter sampling implementation
+ */
+
+#include "meter.h"
+#include "config.h"
+#include "hampod_core.h"
+#include "radio_state.h"
+#include "radio_worker.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// ============================================================================
+// State
+// ============================================================================
+
+#define METER_FREQ_MAX_AGE_MS 60000 // Frequency trusted to match the samples
+
+typedef struct {
+  double value;
+  long long ms;
+} MeterSample;
+
+// Newest at (head + count - 1) % METER_MAX_SAMPLES
+typedef struct {
+  MeterSample samples[METER_MAX_SAMPLES];
+  int head;
+  int count;
+} MeterRing;
+
+// One round of samples, run on the radio worker
+typedef struct {
+  unsigned meters; // Bit per RadioMeter
+} MeterRound;
+
+// Meters sampled together: the receive meter alone, the transmit ones as
+// a group
+#define METER_TRANSMIT_GROUP                                                   \
+  ((1u << RADIO_METER_POWER) | (1u << RADIO_METER_SWR) |                       \
+   (1u << RADIO_METER_ALC))
+
+static const unsigned g_groups[RADIO_METER_COUNT] = {
+    [RADIO_METER_SMETER] = 1u << RADIO_METER_SMETER,
+    [RADIO_METER_SWR] = METER_TRANSMIT_GROUP,
+    [RADIO_METER_POWER] = METER_TRANSMIT_GROUP,
+    [RADIO_METER_ALC] = METER_TRANSMIT_GROUP,
+};
+
+// Meters spoken as their peak rather than their average
+static const bool g_peak_reading[RADIO_METER_COUNT] = {
+    [RADIO_METER_POWER] = true,
+    [RADIO_METER_ALC] = true,
+};
+
+// Guarded by g_meter_mutex
+static MeterRing g_rings[RADIO_METER_COUNT];
+static double g_freq = -1; // Frequency the samples were taken on
+static MeterSettings g_settings;
+static bool g_have_settings = false;
+static long long g_view_until[RADIO_METER_COUNT]; // 0 when not in view
+static bool g_active = false;   // The thread keeps running
+static bool g_pending = false;  // A round is queued or running
+static long long g_next_ms = 0; // When the next round is due
+
+static bool g_thread_running = false; // Guarded by g_control_mutex
+static pthread_t g_meter_thread;
+static pthread_mutex_t g_meter_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_meter_wake = PTHREAD_COND_INITIALIZER;
+
+// Owns g_thread_running and the thread's lifetime. meter_stop() holds it
+// through the join, so a meter_use() meanwhile waits and starts afresh.
+static pthread_mutex_t g_control_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// ============================================================================
+// Internal Functions
+// ============================================================================
+
+static long long now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static bool valid_meter(RadioMeter meter) {
+  return meter >= 0 && meter < RADIO_METER_COUNT;
+}
+
+// The radio's frequency, -1 if not known
+static double current_freq(void) {
+  double freq;
+  if (radio_state_get_within(RADIO_FIELD_FREQ, METER_FREQ_MAX_AGE_MS,
+                             &freq)) {
+    return freq;
+  }
+  return -1;
+}
+
+// Call with g_meter_mutex held
+static void load_settings(void) {
+  g_settings = *config_get_meters();
+  g_have_settings = true;
+}
+
+// Call with g_meter_mutex held
+static void clear_samples(void) {
+  memset(g_rings, 0, sizeof(g_rings));
+}
+
+// Meters in view at now, as bits. Call with g_meter_mutex held.
+static unsigned meters_in_view(long long now) {
+  unsigned meters = 0;
+  for (int m = 0; m < RADIO_METER_COUNT; m++) {
+    if (g_view_until[m] > now) {
+      meters |= 1u << m;
+    }
+  }
+  return meters;
+}
+
+// Wait for a signal, or until deadline_ms (-1: no deadline). Call with
+// g_meter_mutex held.
+static void wait_until(long long deadline_ms) {
+  if (deadline_ms < 0) {
+    pthread_cond_wait(&g_meter_wake, &g_meter_mutex);
+    return;
+  }
+  long long wait_ms = deadline_ms - now_ms();
+  if (wait_ms <= 0) {
+    return;
+  }
+  struct timespec wake;
+  clock_gettime(CLOCK_REALTIME, &wake);
+  wake.tv_sec += wait_ms / 1000;
+  wake.tv_nsec += (wait_ms % 1000) * 1000000L;
+  if (wake.tv_nsec >= 1000000000L) {
+    wake.tv_sec++;
+    wake.tv_nsec -= 1000000000L;
+  }
+  pthread_cond_timedwait(&g_meter_wake, &g_meter_mutex, &wake);
+}
+
+/**
+ * @brief Radio command: sample each meter of a round (run on the radio
+ *        worker)
+ */
+static int run_round(void *arg) {
+  const MeterRound *round = arg;
+  for (int m = 0; m < RADIO_METER_COUNT; m++) {
+    double value;
+    if ((round->meters & (1u << m)) &&
+        radio_read_meter((RadioMeter)m, &value) == 0) {
+      meter_record((RadioMeter)m, value);
+    }
+  }
+  return 0;
+}
+
+static void round_done(int result, void *arg) {
+  (void)result;
+  (void)arg;
+  pthread_mutex_lock(&g_meter_mutex);
+  g_pending = false;
+  pthread_cond_signal(&g_meter_wake);
+  pthread_mutex_unlock(&g_meter_mutex);
+}
+
+static void *meter_thread_func(void *arg) {
+  (void)arg;
+  DEBUG_PRINT("meter: Started\n");
+
+  pthread_mutex_lock(&g_meter_mutex);
+  while (g_active) {
+    long long now = now_ms();
+    unsigned meters = meters_in_view(now);
+    if (meters == 0 || g_pending) {
+      wait_until(-1); // meter_use() or the round's completion
+      continue;
+    }
+    if (now < g_next_ms) {
+      wait_until(g_next_ms);
+      continue;
+    }
+
+    MeterRound round = {meters};
+    g_pending = true;
+    g_next_ms = now + g_settings.sample_ms;
+    pthread_mutex_unlock(&g_meter_mutex);
+
+    int queued = radio_worker_submit(RADIO_CMD_BACKGROUND, RADIO_KEY_METER,
+                                     run_round, round_done, &round,
+                                     sizeof(round));
+
+    pthread_mutex_lock(&g_meter_mutex);
+    if (queued != 0) {
+      g_pending = false; // Queue full: try again next period
+    }
+  }
+  pthread_mutex_unlock(&g_meter_mutex);
+
+  DEBUG_PRINT("meter: Stopped\n");
+  return NULL;
+}
+
+// ============================================================================
+// Samples
+// ============================================================================
+
+void meter_record(RadioMeter meter, double value) {
+  if (!valid_meter(meter)) {
+    return;
+  }
+  double freq = current_freq();
+
+  pthread_mutex_lock(&g_meter_mutex);
+  if (!g_have_settings) {
+    load_settings();
+  }
+  if (freq > 0 && freq != g_freq) {
+    clear_samples(); // Another signal
+    g_freq = freq;
+  }
+  MeterRing *ring = &g_rings[meter];
+  int tail = (ring->head + ring->count) % METER_MAX_SAMPLES;
+  ring->samples[tail].value = value;
+  ring->samples[tail].ms = now_ms();
+  if (ring->count < METER_MAX_SAMPLES) {
+    ring->count++;
+  } else {
+    ring->head = (ring->head + 1) % METER_MAX_SAMPLES;
+  }
+  pthread_mutex_unlock(&g_meter_mutex);
+}
+
+bool meter_get_stats(RadioMeter meter, MeterStats *stats) {
+  if (!valid_meter(meter)) {
+    return false;
+  }
+  double freq = current_freq();
+  long long now = now_ms();
+
+  pthread_mutex_lock(&g_meter_mutex);
+  const MeterRing *ring = &g_rings[meter];
+  const MeterSample *newest =
+      &ring->samples[(ring->head + ring->count + METER_MAX_SAMPLES - 1) %
+                     METER_MAX_SAMPLES];
+  if (ring->count == 0 || now - newest->ms > g_settings.window_ms ||
+      (freq > 0 && g_freq > 0 && freq != g_freq)) {
+    pthread_mutex_unlock(&g_meter_mutex);
+    return false;
+  }
+
+  stats->last = stats->min = stats->max = stats->peak = newest->value;
+  stats->age_ms = (int)(now - newest->ms);
+  double sum = 0;
+  int samples = 0;
+  for (int i = ring->count - 1; i >= 0; i--) {
+    const MeterSample *sample =
+        &ring->samples[(ring->head + i) % METER_MAX_SAMPLES];
+    long long age = now - sample->ms;
+    if (age <= g_settings.window_ms) {
+      sum += sample->value;
+      samples++;
+      if (sample->value < stats->min) {
+        stats->min = sample->value;
+      }
+      if (sample->value > stats->max) {
+        stats->max = sample->value;
+      }
+    }
+    if (age <= g_settings.hold_ms && sample->value > stats->peak) {
+      stats->peak = sample->value;
+    }
+  }
+  stats->average = sum / samples;
+  stats->samples = samples;
+  pthread_mutex_unlock(&g_meter_mutex);
+  return true;
+}
+
+bool meter_reading(RadioMeter meter, double *value) {
+  MeterStats stats;
+  if (!meter_get_stats(meter, &stats)) {
+    return false;
+  }
+  *value = g_peak_reading[meter] ? stats.peak : stats.average;
+  return true;
+}
+
+// ============================================================================
+// Control
+// ============================================================================
+
+void meter_use(RadioMeter meter) {
+  if (!valid_meter(meter)) {
+    return;
+  }
+
+  pthread_mutex_lock(&g_control_mutex);
+  pthread_mutex_lock(&g_meter_mutex);
+  load_settings();
+  if (g_settings.sample_ms <= 0) {
+    pthread_mutex_unlock(&g_meter_mutex);
+    pthread_mutex_unlock(&g_control_mutex);
+    return;
+  }
+  long long until = now_ms() + g_settings.view_s * 1000LL;
+  for (int m = 0; m < RADIO_METER_COUNT; m++) {
+    if (g_groups[meter] & (1u << m)) {
+      g_view_until[m] = until;
+    }
+  }
+  g_active = true;
+  pthread_cond_signal(&g_meter_wake);
+  pthread_mutex_unlock(&g_meter_mutex);
+
+  if (!g_thread_running) {
+    if (pthread_create(&g_meter_thread, NULL, meter_thread_func, NULL) == 0) {
+      g_thread_running = true;
+    } else {
+      fprintf(stderr, "meter_use: pthread_create failed\n");
+      pthread_mutex_lock(&g_meter_mutex);
+      g_active = false;
+      pthread_mutex_unlock(&g_meter_mutex);
+    }
+  }
+  pthread_mutex_unlock(&g_control_mutex);
+}
+
+void meter_stop(void) {
+  pthread_mutex_lock(&g_control_mutex);
+  pthread_mutex_lock(&g_meter_mutex);
+  g_active = false;
+  pthread_cond_signal(&g_meter_wake);
+  pthread_mutex_unlock(&g_meter_mutex);
+
+  if (g_thread_running) {
+    pthread_join(g_meter_thread, NULL);
+    g_thread_running = false;
+  }
+  radio_worker_cancel(RADIO_KEY_METER);
+
+  pthread_mutex_lock(&g_meter_mutex);
+  clear_samples();
+  memset(g_view_until, 0, sizeof(g_view_until));
+  g_freq = -1;
+  g_pending = false;
+  g_next_ms = 0;
+  pthread_mutex_unlock(&g_meter_mutex);
+  pthread_mutex_unlock(&g_control_mutex);
+}
@@ -6,13 +6,27 @@
  */
 
 #include "normal_mode.h"
+#include "announce.h"
+#include "band_stack.h"
+#include "config.h"
 #include "config_mode.h"
+#include "cw.h"
 #include "frequency_mode.h"
 #include "hampod_core.h"
+#include "keymap.h"
+#include "macro.h"
+#include "memory_mode.h"
+#include "meter.h"
+#include "profile.h"
 #include "radio.h"
 #include "radio_queries.h"
 #include "radio_setters.h"
+#include "radio_state.h"
+#include "radio_worker.h"
+#include "scan.h"
 #include "speech.h"
+#include "tune.h"
+#include "tuning_tone.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -21,264 +35,513 @@
 // Module State
 // ============================================================================
 
+// A meter reading not started by then is stale and dropped unsaid
+#define METER_READING_TTL_MS 2000
+
 static bool g_verbosity_enabled = true; // Auto-announcements on by default
 
+// Band being recalled, until the radio worker has set it; stepping again
+// goes on from there rather than from the old frequency. -1 if none.
+static int g_recalling_band = -1;
+
+// Held key whose repeats run its action again, and that action; only the
+// tuning steps repeat
+static char g_repeat_key = '\0';
+static KeymapAction g_repeat_action = KEYMAP_NONE;
+
+// Band, mode and VFO the readouts were last warmed for (-1: none yet)
+static int g_warmed_band = -1;
+static int g_warmed_mode = -1;
+static int g_warmed_vfo = -1;
+
 // ============================================================================
 // Internal Helpers
 // ============================================================================
 
+/**
+ * @brief Add the current frequency, or that there is none
+ */
+static void add_frequency(Announcement *a) {
+  if (announce_frequency(a, radio_get_frequency()) != HAMPOD_OK) {
+    announce_text(a, "Frequency not available");
+  }
+}
+
 /**
  * @brief Announce the current frequency as speech
  */
-static void announce_frequency(void) {
-  double freq_hz = radio_get_frequency();
-  if (freq_hz < 0) {
-    speech_say_text("Frequency not available");
+static void announce_current_frequency(void) {
+  Announcement a;
+  announce_init(&a);
+  add_frequency(&a);
+  announce_say_latest(&a, SPEECH_INTERACTIVE, SPEECH_SLOT_FREQUENCY, false);
+}
+
+/**
+ * @brief Announce a VFO or radio name followed by its frequency as one
+ *        sequence
+ */
+static void announce_name_frequency(const char *name, bool is_vfo) {
+  Announcement a;
+  announce_init(&a);
+  if (is_vfo) {
+    announce_vfo(&a, name);
+  } else {
+    announce_text(&a, name);
+  }
+  add_frequency(&a);
+  announce_say(&a, SPEECH_INTERACTIVE);
+}
+
+/**
+ * @brief Announce "<label> <value> <unit>", or that it is not available
+ */
+static void announce_reading(const char *label, int value, AnnounceUnit unit) {
+  Announcement a;
+  announce_init(&a);
+  announce_text(&a, label);
+  if (value < 0) {
+    announce_text(&a, "not available");
+  } else {
+    announce_number(&a, value);
+    announce_unit(&a, unit);
+  }
+  announce_say(&a, SPEECH_INTERACTIVE);
+}
+
+/**
+ * @brief Announce "<label> on/off, level <n>" (see announce_switch())
+ */
+static void announce_switch_level(const char *label, bool on, int level) {
+  Announcement a;
+  announce_init(&a);
+  announce_switch(&a, label, on, level);
+  announce_say(&a, SPEECH_INTERACTIVE);
+}
+
+/**
+ * @brief Radio command: switch VFO (run on the radio worker)
+ */
+static int run_select_vfo(void *arg) {
+  return radio_set_vfo(*(const RadioVfo *)arg);
+}
+
+static void select_vfo_done(int result, void *arg) {
+  bool vfo_a = *(const RadioVfo *)arg == RADIO_VFO_A;
+
+  if (result == RADIO_CMD_CANCELLED) {
     return;
   }
+  if (result == 0) {
+    announce_name_frequency(vfo_a ? "VFO A." : "VFO B.", true);
+  } else {
+    speech_say_text(vfo_a ? "VFO A. Not available" : "VFO B. Not available");
+  }
+}
 
-  // Convert Hz to MHz and format
-  double freq_mhz = freq_hz / 1000000.0;
-  int mhz_part = (int)freq_mhz;
+static void select_vfo(RadioVfo vfo) {
+  // Suppress polling announcement since we'll announce ourselves
+  frequency_mode_suppress_next_poll();
+  if (radio_worker_submit(RADIO_CMD_USER, RADIO_KEY_VFO, run_select_vfo,
+                          select_vfo_done, &vfo, sizeof(vfo)) != 0) {
+    select_vfo_done(-1, &vfo);
+  }
+}
 
-  // Get 5 decimal places for 10 Hz resolution
-  // Use truncation (not rounding) to match radio display behavior
-  // Add tiny epsilon to handle floating-point representation errors
-  int decimals = (int)((freq_mhz - mhz_part) * 100000 + 0.0001);
+/**
+ * @brief Radio command: switch to the next radio (run on the radio worker)
+ */
+static int run_select_next_radio(void *arg) {
+  (void)arg;
+  return radio_select_next();
+}
+
+static void select_next_radio_done(int result, void *arg) {
+  (void)arg;
+
+  if (result == RADIO_CMD_CANCELLED) {
+    return;
+  }
+  if (result < 0) {
+    speech_say_text("No other radio");
+    return;
+  }
 
-  char text[128];
-  if (decimals == 0) {
-    snprintf(text, sizeof(text), "%d megahertz", mhz_part);
+  char name[80];
+  const RadioSettings *radio = config_get_radio(result);
+  if (radio != NULL) {
+    keymap_select_model(radio->detected_model > 0 ? radio->detected_model
+                                                  : radio->model);
+  }
+  if (radio != NULL && radio->name[0] != '\0') {
+    snprintf(name, sizeof(name), "%s.", radio->name);
   } else {
-    // Spell out each decimal digit for clarity
-    char decimal_str[16];
-    snprintf(decimal_str, sizeof(decimal_str), "%05d", decimals);
-
-    char spoken_decimals[32] = "";
-    for (int i = 0; i < 5; i++) {
-      char digit[4];
-      snprintf(digit, sizeof(digit), "%c ", decimal_str[i]);
-      strcat(spoken_decimals, digit);
-    }
+    snprintf(name, sizeof(name), "Radio %d.", result + 1);
+  }
+
+  if (!radio_is_connected()) {
+    SpeechSequence seq;
+    speech_sequence_init(&seq);
+    speech_sequence_add_text(&seq, name);
+    speech_sequence_add_text(&seq, "Not connected");
+    speech_say_sequence(&seq);
+    return;
+  }
+  announce_name_frequency(name, false);
+}
+
+static void select_next_radio(void) {
+  if (radio_worker_submit(RADIO_CMD_USER, RADIO_KEY_NONE,
+                          run_select_next_radio, select_next_radio_done, NULL,
+                          0) != 0) {
+    select_next_radio_done(-1, NULL);
+  }
+}
 
-    snprintf(text, sizeof(text), "%d point %s megahertz", mhz_part,
-             spoken_decimals);
+/**
+ * @brief Radio command: set a band's memory (run on the radio worker)
+ */
+static int run_recall_band(void *arg) {
+  const BandMemory *memory = arg;
+  if (radio_set_frequency(memory->freq_hz) != 0) {
+    return -1;
   }
+  if (memory->mode > 0 &&
+      radio_set_mode_raw(memory->mode, memory->passband_hz) == -1) {
+    return -1;
+  }
+  return 0;
+}
+
+static void recall_band_done(int result, void *arg) {
+  (void)arg;
 
-  speech_say_text(text);
+  if (result == RADIO_CMD_CANCELLED) {
+    return; // A later recall replaced it
+  }
+  g_recalling_band = -1;
+  if (result != 0) {
+    speech_say_text_priority("Band change failed", SPEECH_URGENT);
+  }
+}
+
+/**
+ * @brief Step to the next band up or down and recall its memory
+ *
+ * Says the stored band, frequency and mode right away; the radio is set
+ * behind it by one queued command, without waiting for a read-back.
+ */
+static void recall_band(int direction) {
+  BandMemory memory;
+  double from = radio_get_frequency();
+  int band = g_recalling_band;
+
+  if (band >= 0 && band_stack_get(band, &memory)) {
+    from = memory.freq_hz;
+  } else if (from > 0) {
+    band_stack_remember(from); // Where we leave this band
+  }
+  band = band_stack_step(from, direction);
+  band_stack_get(band, &memory);
+
+  Announcement a;
+  announce_init(&a);
+  announce_text(&a, band_stack_name(band));
+  announce_frequency(&a, memory.freq_hz);
+  if (memory.mode > 0) {
+    announce_mode(&a, radio_mode_name(memory.mode));
+  }
+  announce_say_latest(&a, SPEECH_INTERACTIVE, SPEECH_SLOT_FREQUENCY, true);
+
+  // The poller would announce the new frequency again
+  frequency_mode_suppress_next_poll();
+  g_recalling_band = band;
+  if (radio_worker_submit(RADIO_CMD_USER, RADIO_KEY_FREQUENCY,
+                          run_recall_band, recall_band_done, &memory,
+                          sizeof(memory)) != 0) {
+    recall_band_done(-1, &memory);
+  }
 }
 
 /**
  * @brief Announce S-meter reading
  */
 static void announce_smeter(void) {
+  meter_use(RADIO_METER_SMETER);
   char buffer[32];
   const char *reading = radio_get_smeter_string(buffer, sizeof(buffer));
-  speech_say_text(reading);
+  speech_say_words_ttl(reading, SPEECH_INTERACTIVE, SPEECH_SLOT_METER, false,
+                       METER_READING_TTL_MS);
+}
+
+/**
+ * @brief Step the tuning tone to its next meter and say which
+ */
+static void cycle_tuning_tone(void) {
+  static const char *const names[TUNING_TONE_COUNT] = {
+      [TUNING_TONE_OFF] = "Tone off",
+      [TUNING_TONE_SMETER] = "Tone S meter",
+      [TUNING_TONE_SWR] = "Tone SWR",
+      [TUNING_TONE_POWER] = "Tone power",
+  };
+  speech_say_text(names[tuning_tone_cycle()]);
+}
+
+/**
+ * @brief Turn the CW decoder on or off and say which
+ */
+static void toggle_cw_decoder(void) {
+  if (cw_is_active()) {
+    cw_stop();
+    speech_say_text("CW decoder off");
+  } else if (cw_start() == 0) {
+    speech_say_text("CW decoder on");
+  } else {
+    speech_say_text("CW decoder not available");
+  }
 }
 
 /**
  * @brief Announce power meter reading
  */
 static void announce_power_meter(void) {
+  meter_use(RADIO_METER_POWER);
   char buffer[32];
   const char *reading = radio_get_power_string(buffer, sizeof(buffer));
-  speech_say_text(reading);
+  speech_say_words_ttl(reading, SPEECH_INTERACTIVE, SPEECH_SLOT_METER, false,
+                       METER_READING_TTL_MS);
 }
 
 // ============================================================================
-// Initialization
+// Key Actions (bound to keys in keymap.c)
 // ============================================================================
 
-void normal_mode_init(void) {
-  g_verbosity_enabled = true;
-  DEBUG_PRINT("normal_mode_init: Initialized\n");
-}
+static void action_vfo_a(void) { select_vfo(RADIO_VFO_A); }
 
-// ============================================================================
-// Key Handling
-// ============================================================================
+static void action_vfo_b(void) { select_vfo(RADIO_VFO_B); }
 
-bool normal_mode_handle_key(char key, bool is_hold, bool is_shifted) {
-  DEBUG_PRINT("normal_mode_handle_key: key='%c' hold=%d shift=%d\n", key,
-              is_hold, is_shifted);
-
-  // [1] - VFO selection / [Shift+1] - VOX status query
-  if (key == '1') {
-    if (is_shifted && !is_hold) {
-      // [Shift]+[1] - VOX status query
-      int vox = radio_get_vox_status();
-      if (vox < 0) {
-        speech_say_text("VOX status unavailable");
-      } else if (vox == 1) {
-        speech_say_text("VOX is on");
-      } else {
-        speech_say_text("VOX is off");
-      }
-      return true;
-    } else if (!is_hold) {
-      // Select VFO A
-      // Suppress polling announcement since we'll announce ourselves
-      frequency_mode_suppress_next_poll();
-      if (radio_set_vfo(RADIO_VFO_A) == 0) {
-        speech_say_text("VFO A.");
-        announce_frequency();
-      } else {
-        speech_say_text("VFO A. Not available");
-      }
-    } else {
-      // Select VFO B
-      frequency_mode_suppress_next_poll();
-      if (radio_set_vfo(RADIO_VFO_B) == 0) {
-        speech_say_text("VFO B.");
-        announce_frequency();
-      } else {
-        speech_say_text("VFO B. Not available");
-      }
-    }
-    return true;
+static void action_vox_status(void) {
+  int vox = radio_get_vox_status();
+  if (vox < 0) {
+    speech_say_text("VOX status unavailable");
+  } else if (vox == 1) {
+    speech_say_text("VOX is on");
+  } else {
+    speech_say_text("VOX is off");
   }
+}
 
-  // [2] - Announce current frequency
-  if (key == '2' && !is_hold) {
-    announce_frequency();
-    return true;
+static void action_mode(void) {
+  Announcement a;
+  announce_init(&a);
+  announce_mode(&a, radio_get_mode_string());
+  announce_say(&a, SPEECH_INTERACTIVE);
+}
+
+static void action_preamp(void) {
+  Announcement a;
+  announce_init(&a);
+  int preamp = radio_get_preamp();
+  if (preamp == 0) {
+    announce_text(&a, "Pre amp off");
+  } else if (preamp > 0) {
+    announce_text(&a, "Pre amp");
+    announce_number(&a, preamp);
+  } else {
+    announce_text(&a, "Pre amp not available");
   }
+  announce_say(&a, SPEECH_INTERACTIVE);
+}
 
-  // [0] - Announce current mode
-  if (key == '0' && !is_hold) {
-    const char *mode = radio_get_mode_string();
-    speech_say_text(mode);
-    return true;
+static void action_agc(void) {
+  Announcement a;
+  announce_init(&a);
+  announce_text(&a, "A G C");
+  announce_word(&a, radio_get_agc_string());
+  announce_say(&a, SPEECH_INTERACTIVE);
+}
+
+static void action_attenuation(void) {
+  Announcement a;
+  announce_init(&a);
+  int atten = radio_get_attenuation();
+  if (atten == 0) {
+    announce_text(&a, "Attenuation off");
+  } else if (atten > 0) {
+    announce_text(&a, "Attenuation");
+    announce_number(&a, atten);
+    announce_unit(&a, ANNOUNCE_UNIT_DECIBELS);
+  } else {
+    announce_text(&a, "Attenuation not available");
   }
+  announce_say(&a, SPEECH_INTERACTIVE);
+}
 
-  // [4] - PreAmp (press) / AGC (hold) / Attenuation (shift+press)
-  if (key == '4') {
-    char buffer[64];
-    if (is_shifted && !is_hold) {
-      // [Shift]+[4] - Attenuation query
-      int atten = radio_get_attenuation();
-      if (atten == 0) {
-        snprintf(buffer, sizeof(buffer), "Attenuation off");
-      } else if (atten > 0) {
-        snprintf(buffer, sizeof(buffer), "Attenuation %d D B", atten);
-      } else {
-        snprintf(buffer, sizeof(buffer), "Attenuation not available");
-      }
-      speech_say_text(buffer);
-      return true;
-    } else if (is_hold) {
-      // [4] Hold - AGC query
-      snprintf(buffer, sizeof(buffer), "A G C %s", radio_get_agc_string());
-      speech_say_text(buffer);
-      return true;
-    } else {
-      // [4] Press - PreAmp query
-      int preamp = radio_get_preamp();
-      if (preamp == 0) {
-        snprintf(buffer, sizeof(buffer), "Pre amp off");
-      } else if (preamp > 0) {
-        snprintf(buffer, sizeof(buffer), "Pre amp %d", preamp);
-      } else {
-        snprintf(buffer, sizeof(buffer), "Pre amp not available");
-      }
-      speech_say_text(buffer);
-      return true;
-    }
+static void action_noise_blanker(void) {
+  announce_switch_level("Noise blanker", radio_get_nb_enabled(),
+                        radio_get_nb_level());
+}
+
+static void action_noise_reduction(void) {
+  announce_switch_level("Noise reduction", radio_get_nr_enabled(),
+                        radio_get_nr_level());
+}
+
+static void action_mic_gain(void) {
+  announce_reading("Mic gain", radio_get_mic_gain(), ANNOUNCE_UNIT_PERCENT);
+}
+
+static void action_compression(void) {
+  int comp = radio_get_compression();
+  if (comp >= 0) {
+    announce_switch_level("Compression", radio_get_compression_enabled(),
+                          comp);
+  } else {
+    speech_say_text("Compression not available");
   }
+}
 
-  // [7] - Noise Blanker query
-  if (key == '7' && !is_hold) {
-    char buffer[64];
-    bool nb_on = radio_get_nb_enabled();
-    int nb_level = radio_get_nb_level();
-    snprintf(buffer, sizeof(buffer), "Noise blanker %s, level %d",
-             nb_on ? "on" : "off", nb_level >= 0 ? nb_level : 0);
-    speech_say_text(buffer);
-    return true;
+static void action_power(void) {
+  announce_reading("Power", radio_get_power(), ANNOUNCE_UNIT_PERCENT);
+}
+
+static void action_band_up(void) { recall_band(1); }
+
+static void action_band_down(void) { recall_band(-1); }
+
+static void action_scan(void) {
+  Announcement a;
+  announce_init(&a);
+  if (scan_start(SCAN_BAND) != 0) {
+    announce_text(&a, "Scan not available outside a band");
+  } else {
+    announce_text(&a, "Scanning");
+    announce_text(&a, band_stack_name(band_stack_find(radio_get_frequency())));
   }
+  announce_say_latest(&a, SPEECH_INTERACTIVE, SPEECH_SLOT_SCAN, true);
+}
 
-  // [8] - Noise Reduction (press) / Mic Gain (hold)
-  if (key == '8') {
-    char buffer[64];
-    if (is_hold) {
-      // [8] Hold - Mic Gain query
-      int mic = radio_get_mic_gain();
-      if (mic >= 0) {
-        snprintf(buffer, sizeof(buffer), "Mic gain %d percent", mic);
-      } else {
-        snprintf(buffer, sizeof(buffer), "Mic gain not available");
-      }
-      speech_say_text(buffer);
-      return true;
-    } else {
-      // [8] Press - Noise Reduction query
-      bool nr_on = radio_get_nr_enabled();
-      int nr_level = radio_get_nr_level();
-      snprintf(buffer, sizeof(buffer), "Noise reduction %s, level %d",
-               nr_on ? "on" : "off", nr_level >= 0 ? nr_level : 0);
-      speech_say_text(buffer);
-      return true;
-    }
+static void action_scan_memories(void) {
+  if (scan_start(SCAN_MEMORIES) != 0) {
+    speech_say_text("Scan not available");
+  } else {
+    speech_say_text_latest("Scanning memories", SPEECH_INTERACTIVE,
+                           SPEECH_SLOT_SCAN, true);
   }
+}
 
-  // [9] - Compression (shift+press) / Power (hold)
-  if (key == '9') {
-    char buffer[64];
-    if (is_shifted && !is_hold) {
-      // [Shift]+[9] - Compression query
-      int comp = radio_get_compression();
-      bool comp_on = radio_get_compression_enabled();
-      if (comp >= 0) {
-        snprintf(buffer, sizeof(buffer), "Compression %s, level %d",
-                 comp_on ? "on" : "off", comp);
-      } else {
-        snprintf(buffer, sizeof(buffer), "Compression not available");
-      }
-      speech_say_text(buffer);
-      return true;
-    } else if (is_hold) {
-      // [9] Hold - Power level query
-      int power = radio_get_power();
-      if (power >= 0) {
-        snprintf(buffer, sizeof(buffer), "Power %d percent", power);
-      } else {
-        snprintf(buffer, sizeof(buffer), "Power not available");
-      }
-      speech_say_text(buffer);
-      return true;
-    }
-    // [9] Press alone - not assigned, fall through
+static void action_tune_up(void) { tune_step(1); }
+
+static void action_tune_down(void) { tune_step(-1); }
+
+static void action_tune_step(void) {
+  int step_hz = tune_cycle_step();
+  Announcement a;
+  announce_init(&a);
+  announce_text(&a, "Step");
+  if (step_hz >= 1000) {
+    announce_number(&a, step_hz / 1000);
+    announce_unit(&a, ANNOUNCE_UNIT_KILOHERTZ);
+  } else {
+    announce_number(&a, step_hz);
+    announce_unit(&a, ANNOUNCE_UNIT_HERTZ);
   }
+  announce_say(&a, SPEECH_INTERACTIVE);
+}
 
-  // [*] - S-meter (press) / Power meter (hold)
-  if (key == '*') {
-    if (!is_hold) {
-      announce_smeter();
-    } else {
-      announce_power_meter();
-    }
-    return true;
+static void action_verbosity(void) {
+  g_verbosity_enabled = !g_verbosity_enabled;
+  if (g_verbosity_enabled) {
+    speech_say_text("Announcements on");
+  } else {
+    speech_say_text("Announcements off");
   }
+}
+
+// Normal Mode's actions; the others are handled elsewhere
+static void (*const g_actions[KEYMAP_ACTION_COUNT])(void) = {
+    [KEYMAP_VFO_A] = action_vfo_a,
+    [KEYMAP_VFO_B] = action_vfo_b,
+    [KEYMAP_VOX_STATUS] = action_vox_status,
+    [KEYMAP_FREQUENCY] = announce_current_frequency,
+    [KEYMAP_MODE] = action_mode,
+    [KEYMAP_PREAMP] = action_preamp,
+    [KEYMAP_AGC] = action_agc,
+    [KEYMAP_ATTENUATION] = action_attenuation,
+    [KEYMAP_NOISE_BLANKER] = action_noise_blanker,
+    [KEYMAP_NOISE_REDUCTION] = action_noise_reduction,
+    [KEYMAP_MIC_GAIN] = action_mic_gain,
+    [KEYMAP_COMPRESSION] = action_compression,
+    [KEYMAP_POWER] = action_power,
+    [KEYMAP_SMETER] = announce_smeter,
+    [KEYMAP_POWER_METER] = announce_power_meter,
+    [KEYMAP_TUNING_TONE] = cycle_tuning_tone,
+    [KEYMAP_NEXT_RADIO] = select_next_radio,
+    [KEYMAP_VERBOSITY] = action_verbosity,
+    [KEYMAP_CONFIG_MODE] = config_mode_enter,
+    [KEYMAP_BAND_UP] = action_band_up,
+    [KEYMAP_BAND_DOWN] = action_band_down,
+    [KEYMAP_SCAN] = action_scan,
+    [KEYMAP_SCAN_MEMORIES] = action_scan_memories,
+    [KEYMAP_TUNE_UP] = action_tune_up,
+    [KEYMAP_TUNE_DOWN] = action_tune_down,
+    [KEYMAP_TUNE_STEP] = action_tune_step,
+    [KEYMAP_MEMORIES] = memory_mode_enter,
+    [KEYMAP_CW_DECODE] = toggle_cw_decoder,
+    [KEYMAP_SAY_AGAIN] = speech_say_again,
+};
 
-  // [C] - Toggle verbosity (press) / Config mode entry (hold)
-  if (key == 'C') {
-    if (is_hold) {
-      config_mode_enter();
-      return true;
-    } else {
-      g_verbosity_enabled = !g_verbosity_enabled;
-      if (g_verbosity_enabled) {
-        speech_say_text("Announcements on");
+// ============================================================================
+// Initialization
+// ============================================================================
+
+void normal_mode_init(void) {
+  g_verbosity_enabled = true;
+  DEBUG_PRINT("normal_mode_init: Initialized\n");
+}
+
+// ============================================================================
+// Key Handling
+// ============================================================================
+
+bool normal_mode_handle_key(char key, bool is_hold, bool is_shifted) {
+  KeymapAction action =
+      keymap_lookup(KEYMAP_MODE_NORMAL, key, is_hold, is_shifted);
+  DEBUG_PRINT("normal_mode_handle_key: key='%c' hold=%d shift=%d -> %s\n",
+              key, is_hold, is_shifted, keymap_action_name(action));
+
+  bool repeats = action == KEYMAP_TUNE_UP || action == KEYMAP_TUNE_DOWN;
+  g_repeat_key = is_hold && repeats ? key : '\0';
+  g_repeat_action = action;
+
+  if (action == KEYMAP_MACRO || action == KEYMAP_PROFILE ||
+      action == KEYMAP_PROFILE_SAVE) {
+    KeymapMacro macro;
+    if (keymap_lookup_macro(KEYMAP_MODE_NORMAL, key, is_hold, is_shifted,
+                            &macro)) {
+      if (action == KEYMAP_PROFILE) {
+        profile_restore(macro.name);
+      } else if (action == KEYMAP_PROFILE_SAVE) {
+        profile_save(macro.name);
       } else {
-        speech_say_text("Announcements off");
+        macro_run(&macro);
       }
-      return true;
     }
+    return true;
+  }
+  if (g_actions[action] == NULL) {
+    return false; // Not bound in Normal Mode
   }
+  g_actions[action]();
+  return true;
+}
 
-  // Key not handled by normal mode
-  return false;
+bool normal_mode_handle_repeat(char key) {
+  if (key == '\0' || key != g_repeat_key) {
+    return false;
+  }
+  g_actions[g_repeat_action]();
+  return true;
 }
 
 // ============================================================================
@@ -307,7 +570,10 @@ void normal_mode_on_mode_change(const char *new_mode) {
   }
 
   DEBUG_PRINT("normal_mode_on_mode_change: %s\n", new_mode);
-  speech_say_text(new_mode);
+  Announcement a;
+  announce_init(&a);
+  announce_mode(&a, new_mode);
+  announce_say_latest(&a, SPEECH_BACKGROUND, SPEECH_SLOT_MODE, true);
 }
 
 void normal_mode_on_vfo_change(int new_vfo) {
@@ -321,6 +587,47 @@ void normal_mode_on_vfo_change(int new_vfo) {
   }
 
   DEBUG_PRINT("normal_mode_on_vfo_change: %d\n", new_vfo);
-  const char *vfo_name = radio_get_vfo_string();
-  speech_say_text(vfo_name);
+  Announcement a;
+  announce_init(&a);
+  announce_vfo(&a, radio_get_vfo_string());
+  announce_say_latest(&a, SPEECH_BACKGROUND, SPEECH_SLOT_VFO, true);
+}
+
+void normal_mode_warm_readouts(double freq_hz) {
+  double mode = 0;
+  double vfo = -1;
+  radio_state_get(RADIO_FIELD_MODE, &mode);
+  radio_state_get(RADIO_FIELD_VFO, &vfo);
+  int band = band_stack_find(freq_hz);
+  if (band == g_warmed_band && (int)mode == g_warmed_mode &&
+      (int)vfo == g_warmed_vfo) {
+    return;
+  }
+  bool new_band = band != g_warmed_band;
+  g_warmed_band = band;
+  g_warmed_mode = (int)mode;
+  g_warmed_vfo = (int)vfo;
+
+  // What [0] and [2] say now
+  Announcement a;
+  announce_init(&a);
+  if (mode > 0) {
+    announce_mode(&a, radio_mode_name((int)mode));
+  }
+  announce_frequency(&a, freq_hz);
+  // In a new band, what [6] and [6] held would say next
+  if (new_band && band >= 0) {
+    for (int direction = 1; direction >= -1; direction -= 2) {
+      BandMemory memory;
+      if (band_stack_get(band_stack_step(freq_hz, direction), &memory)) {
+        announce_frequency(&a, memory.freq_hz);
+        if (memory.mode > 0) {
+          announce_mode(&a, radio_mode_name(memory.mode));
+        }
+      }
+    }
+  }
+  DEBUG_PRINT("normal_mode_warm_readouts: band %d mode %d vfo %d\n", band,
+              (int)mode, (int)vfo);
+  announce_warm(&a);
 }
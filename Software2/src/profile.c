@@ -0,0 +1,195 @@
+/**
+ * @file profile.c
+ * @brief Radio settings profile implementation
+ */
+
+#include "profile.h"
+#include "announce.h"
+#include "comm.h"
+#include "config.h"
+#include "hampod_core.h"
+#include "macro.h"
+#include "radio.h"
+#include "radio_queries.h"
+#include "radio_state.h"
+#include "radio_worker.h"
+#include "speech.h"
+
+#include <hamlib/rig.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+// Save job results
+#define PROFILE_NOT_CONNECTED 1 // No radio to read
+#define PROFILE_FULL 2          // No room in [profiles]
+#define PROFILE_UNKNOWN 3       // The radio reported none of the settings
+
+// ============================================================================
+// Formatting
+// ============================================================================
+
+// As a macro spells them
+static const char *const g_agc_words[] = {
+    [AGC_OFF] = "off",
+    [AGC_FAST] = "fast",
+    [AGC_MEDIUM] = "medium",
+    [AGC_SLOW] = "slow",
+};
+
+// Append one setting to the list
+static void add_setting(char *out, size_t size, int *count,
+                        const char *format, ...) {
+  size_t len = strlen(out);
+  if (*count > 0 && len < size) {
+    len += snprintf(out + len, size - len, ", ");
+  }
+  if (len < size) {
+    va_list args;
+    va_start(args, format);
+    vsnprintf(out + len, size - len, format, args);
+    va_end(args);
+  }
+  (*count)++;
+}
+
+int profile_format(int mode, int passband_hz, const RadioStatus *status,
+                   char *out, size_t size) {
+  int count = 0;
+  out[0] = '\0';
+
+  if (mode > 0) {
+    add_setting(out, size, &count, "mode %s", rig_strrmode((rmode_t)mode));
+    if (passband_hz > 0) {
+      add_setting(out, size, &count, "passband %d", passband_hz);
+    }
+  }
+  if (status->power >= 0) {
+    add_setting(out, size, &count, "power %d", status->power);
+  }
+  if (status->agc >= AGC_OFF && status->agc <= AGC_SLOW) {
+    add_setting(out, size, &count, "agc %s", g_agc_words[status->agc]);
+  }
+  if (status->nb_on >= 0) {
+    add_setting(out, size, &count, "nb %s", status->nb_on ? "on" : "off");
+  }
+  if (status->nr_on >= 0) {
+    add_setting(out, size, &count, "nr %s", status->nr_on ? "on" : "off");
+  }
+  if (status->preamp == 0) {
+    add_setting(out, size, &count, "preamp off");
+  } else if (status->preamp > 0) {
+    add_setting(out, size, &count, "preamp %d", status->preamp);
+  }
+  if (status->attenuation == 0) {
+    add_setting(out, size, &count, "attenuation off");
+  } else if (status->attenuation > 0) {
+    add_setting(out, size, &count, "attenuation %d", status->attenuation);
+  }
+  return count;
+}
+
+// ============================================================================
+// Saving
+// ============================================================================
+
+/**
+ * @brief Radio command: read the settings and store them
+ *        (run on the radio worker)
+ */
+static int save_profile(void *arg) {
+  const char *name = arg;
+  if (radio_session_begin() != 0) {
+    return PROFILE_NOT_CONNECTED;
+  }
+  RadioStatus status;
+  int known = radio_read_status(&status);
+  int mode = radio_get_mode_raw();
+  double passband; // Cached by the mode read
+  if (mode == 0 || !radio_state_get(RADIO_FIELD_PASSBAND, &passband)) {
+    passband = 0;
+  }
+  radio_session_end();
+  if (known < 0) {
+    return PROFILE_NOT_CONNECTED;
+  }
+
+  char settings[CONFIG_PROFILE_TEXT];
+  if (profile_format(mode, (int)passband, &status, settings,
+                     sizeof(settings)) == 0) {
+    return PROFILE_UNKNOWN;
+  }
+  DEBUG_PRINT("profile_save: %s = %s\n", name, settings);
+  return config_set_profile(name, settings) == 0 ? 0 : PROFILE_FULL;
+}
+
+static void save_done(int result, void *arg) {
+  if (result == RADIO_CMD_CANCELLED) {
+    return;
+  }
+  Announcement a;
+  announce_init(&a);
+  announce_text(&a, (const char *)arg);
+  if (result == 0) {
+    announce_text(&a, "saved");
+  } else if (result == PROFILE_NOT_CONNECTED) {
+    announce_text(&a, "not saved, radio not connected");
+  } else if (result == PROFILE_FULL) {
+    announce_text(&a, "not saved, profiles full");
+  } else {
+    announce_text(&a, "not saved");
+  }
+  if (result != 0 && config_get_key_beep_enabled()) {
+    comm_play_beep(COMM_BEEP_ERROR);
+  }
+  announce_say(&a, result != 0 ? SPEECH_URGENT : SPEECH_INTERACTIVE);
+}
+
+int profile_save(const char *name) {
+  char arg[CONFIG_PROFILE_NAME];
+  if (name[0] == '\0' || strlen(name) >= sizeof(arg)) {
+    return -1;
+  }
+  snprintf(arg, sizeof(arg), "%s", name);
+  if (radio_worker_submit(RADIO_CMD_USER, RADIO_KEY_NONE, save_profile,
+                          save_done, arg, sizeof(arg)) != 0) {
+    save_done(-1, arg);
+    return -1;
+  }
+  return 0;
+}
+
+// ============================================================================
+// Restoring
+// ============================================================================
+
+int profile_restore(const char *name) {
+  ProfileSettings profile;
+  KeymapMacro source;
+  Macro macro;
+  int bad = 1;
+  bool saved = config_get_profile(name, &profile);
+  if (saved) {
+    snprintf(source.name, sizeof(source.name), "%s", profile.name);
+    snprintf(source.steps, sizeof(source.steps), "%s", profile.settings);
+    bad = macro_compile(&source, &macro);
+  }
+  if (bad != 0) {
+    if (saved) {
+      LOG_ERROR("profile: %s: step %d is not valid", name, bad);
+    }
+    if (config_get_key_beep_enabled()) {
+      comm_play_beep(COMM_BEEP_ERROR);
+    }
+    Announcement a;
+    announce_init(&a);
+    announce_text(&a, name);
+    announce_text(&a, saved ? "profile not valid" : "not saved");
+    announce_say(&a, SPEECH_INTERACTIVE);
+    return -1;
+  }
+
+  DEBUG_PRINT("profile_restore: %s = %s\n", name, profile.settings);
+  macro.changes_only = true;
+  return macro_queue(&macro);
+}
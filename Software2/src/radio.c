@@ -8,84 +8,400 @@
 #include "radio.h"
 #include "config.h"
 #include "hampod_core.h"
-
+#include "hampod_metrics.h"
+#include "idle.h"
+#include "radio_caps.h"
+#include "radio_cat.h"
+#include "radio_defs.h"
+#include "radio_state.h"
+#include "radio_trace.h"
+#include "serial_latency.h"
+
+#include <dirent.h>
 #include <fcntl.h>
 #include <hamlib/rig.h>
+#include <limits.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 // ============================================================================
 // State Variables
 // ============================================================================
 
-RIG *g_rig = NULL;
-bool g_connected = false;
-pthread_mutex_t g_rig_mutex = PTHREAD_MUTEX_INITIALIZER;
-static bool g_radio_debug_mode = false;
+// One context per configured radio ([radio.N]). The getters and setters
+// talk to the active one; radios with standby = 1 stay connected, polled
+// and cached in the background, so switching to them is instant.
+typedef struct {
+  int index;   // Config radio index, also its radio_state slot
+  bool in_use; // Active or standby: connected and kept connected
+  RIG *rig;
+  bool connected;
+  pthread_mutex_t lock; // Held across every Hamlib call on rig
+
+  // Polling state; poll_wake wakes the poller early (key press, switch)
+  pthread_t poll_thread;
+  volatile bool polling;
+  pthread_mutex_t poll_mutex;
+  pthread_cond_t poll_wake;
+  bool poll_activity;
+
+  // Transceive state: whether the rig reports its own changes, the last
+  // frequency it (or a resync) reported in Hz, -1 if none yet, and the
+  // last mode report with a count of them. Written from Hamlib's event
+  // handlers, which may run in a signal handler.
+  bool event_mode;
+  long long event_freq_hz;
+  long long event_mode_raw;
+  long long event_width_hz;
+  unsigned int event_mode_seq;
+
+  // Native CAT fast path (radio_cat.h); protocol RADIO_CAT_NONE if off
+  RadioCat cat;
+
+  // Its model's definition (radio_defs.h), NULL if none or behind rigctld
+  const RadioDef *def;
+
+  // Low-latency port settings to put back on close (serial_latency.h)
+  SerialLatency latency;
+
+  // Health state: when the rig last provably answered (CLOCK_MONOTONIC
+  // ms), and whether a frequency read counts as proof (Hamlib's frequency
+  // cache is off). Also written from the event handlers.
+  long long last_reply_ms;
+  bool freq_uncached;
+
+  // Reconnect state. The housekeeping job looks for the device and sets
+  // reconnect_kick (under poll_mutex) when the thread has work; it alone
+  // uses device_seen and attempt_ms.
+  pthread_t reconnect_thread;
+  volatile bool reconnecting;
+  pthread_cond_t reconnect_wake;
+  bool reconnect_kick;
+  bool device_seen;     // Adapter seen on the last check
+  long long attempt_ms; // When the thread was last sent to connect
+} RadioContext;
+
+static RadioContext g_radios[MAX_RADIOS] = {
+    [0 ... MAX_RADIOS - 1] = {.lock = PTHREAD_MUTEX_INITIALIZER,
+                              .poll_mutex = PTHREAD_MUTEX_INITIALIZER,
+                              .poll_wake = PTHREAD_COND_INITIALIZER,
+                              .reconnect_wake = PTHREAD_COND_INITIALIZER,
+                              .event_freq_hz = -1}};
+
+// Changed only holding both the old and the new radio's lock, so holding
+// either one keeps it stable
+static RadioContext *g_active = &g_radios[0];
+
+// The active radio's context while this thread holds its lock
+static __thread RadioContext *t_locked = NULL;
+
+// Set between radio_session_begin() and radio_session_end(): this thread
+// keeps the radio's lock, and radio_lock()/radio_unlock() leave it be
+static __thread RadioContext *t_session = NULL;
 
-// Polling state
-static pthread_t g_poll_thread;
-static volatile bool g_polling_active = false;
+static bool g_radio_debug_mode = false;
+static bool g_polling_wanted = false; // radio_start_polling() was called
 static radio_freq_change_callback g_freq_callback = NULL;
-
-// Reconnect state
-static pthread_t g_reconnect_thread;
-static volatile bool g_reconnect_active = false;
 static radio_connect_callback g_connect_callback = NULL;
 static radio_disconnect_callback g_disconnect_callback = NULL;
+static bool g_reconnect_job_added = false;
 
-// Polling parameters
-#define POLL_INTERVAL_MS 100
+// Polling parameters (the interval limits come from config, per radio)
 #define DEBOUNCE_TIME_MS 1000
+#define POLL_BACKOFF_PERCENT 150 // Each quiet poll waits this much longer
 #define DISCONNECT_THRESHOLD                                                   \
   3 // consecutive failures before declaring disconnect
 #define RECONNECT_INTERVAL_SEC 1 // seconds between reconnect attempts
+#define RECONNECT_CHECK_MS 100   // Device checks on the housekeeping timer
+#define RECONNECT_IDLE_CHECK_MS 2000 // The same, in idle mode
+#define POLL_IDLE_MODE_MS 2000   // Slowest poll in idle mode
+#define HEALTH_CHECK_MS 1000     // Silence before an S-meter probe
+#define EVENT_RESYNC_MS 5000     // Frequency query in transceive mode
+#define RECONNECT_BAUD_SCAN_EVERY 10 // Attempts between baud scans
+
+// Bauds tried when the configured one gets no answer, most common first
+static const int g_probe_bauds[] = {19200, 9600, 4800, 38400, 57600, 115200};
+#define PROBE_BAUD_COUNT (int)(sizeof(g_probe_bauds) / sizeof(g_probe_bauds[0]))
+
+// ============================================================================
+// Internal Helpers
+// ============================================================================
+
+static long long radio_now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// The rig just sent something. Safe in a signal handler.
+static void radio_note_reply(RadioContext *ctx) {
+  __atomic_store_n(&ctx->last_reply_ms, radio_now_ms(), __ATOMIC_RELAXED);
+}
+
+static RadioContext *radio_active(void) {
+  return __atomic_load_n(&g_active, __ATOMIC_ACQUIRE);
+}
+
+// Lock a radio to call Hamlib, charging the wait to the next traced call
+static void radio_lock_for_call(RadioContext *ctx) {
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  pthread_mutex_lock(&ctx->lock);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  radio_trace_lock_waited((long long)(end.tv_sec - start.tv_sec) * 1000000 +
+                          (end.tv_nsec - start.tv_nsec) / 1000);
+}
+
+// Lock the active radio, whether or not it is connected
+static RadioContext *radio_lock_active(void) {
+  for (;;) {
+    RadioContext *ctx = radio_active();
+    radio_lock_for_call(ctx);
+    if (ctx == g_active) {
+      return ctx;
+    }
+    pthread_mutex_unlock(&ctx->lock); // Switched meanwhile
+  }
+}
+
+// Close a radio's rig and forget its state. Call with ctx->lock held.
+static void radio_close_rig(RadioContext *ctx) {
+  if (ctx->rig) {
+    serial_latency_restore(&ctx->latency, ctx->rig->state.rigport.fd);
+    rig_close(ctx->rig);
+    rig_cleanup(ctx->rig);
+    ctx->rig = NULL;
+  }
+  radio_cat_init(&ctx->cat, RADIO_CAT_NONE, -1, 0);
+  ctx->connected = false;
+  radio_state_clear_for(ctx->index);
+}
+
+// A radio dropped: tell the UI if it is the active one
+static void radio_lost(RadioContext *ctx) {
+  if (ctx == radio_active()) {
+    if (g_disconnect_callback) {
+      g_disconnect_callback();
+    }
+  } else {
+    printf("radio: Standby radio %d disconnected\n", ctx->index + 1);
+  }
+}
+
+// The radio's fast path, or NULL to make the Hamlib call. Not in
+// transceive mode, where Hamlib reads the port by itself. Call with
+// ctx->lock held.
+static RadioCat *radio_fast_path(RadioContext *ctx) {
+  if (ctx->cat.protocol == RADIO_CAT_NONE || ctx->event_mode) {
+    return NULL;
+  }
+  return &ctx->cat;
+}
+
+// Time a fast path call like a Hamlib one, unless it fell back to
+// Hamlib. Evaluates to a Hamlib code, or RADIO_CAT_FALLBACK.
+#define RADIO_CAT_TRACED(op, call)                                             \
+  radio_cat_trace_end((op), (radio_trace_begin(), (call)))
+
+static int radio_cat_trace_end(RadioOp op, int result) {
+  if (result == RADIO_CAT_FALLBACK) {
+    return result;
+  }
+  return radio_trace_end(op, result == 0 ? RIG_OK : -RIG_EIO);
+}
+
+// S-meter in dB relative to S9, by the fast path if the radio has one
+// and a calibration table to read it with. Call with ctx->lock held.
+static int radio_read_strength(RadioContext *ctx, int *db) {
+  RadioCat *cat = radio_fast_path(ctx);
+  int raw;
+  int retcode = RADIO_CAT_FALLBACK;
+  if (cat && ctx->rig->caps->str_cal.size > 0) {
+    retcode = RADIO_CAT_TRACED(RADIO_OP_CAT_GET_SMETER,
+                               radio_cat_get_smeter_raw(cat, &raw));
+  }
+  if (retcode == RIG_OK) {
+    *db = (int)rig_raw2val(raw, &ctx->rig->caps->str_cal);
+  } else if (retcode == RADIO_CAT_FALLBACK) {
+    value_t val;
+    retcode = RADIO_TRACED(RADIO_OP_GET_LEVEL,
+                           rig_get_level(ctx->rig, RIG_VFO_CURR,
+                                         RIG_LEVEL_STRENGTH, &val));
+    if (retcode == RIG_OK) {
+      *db = val.i;
+    }
+  }
+  return retcode;
+}
+
+// ============================================================================
+// Active Radio Access (radio_setters.c, radio_queries.c)
+// ============================================================================
+
+RIG *radio_lock(void) {
+  if (t_session) {
+    t_locked = t_session;
+    return t_session->connected ? t_session->rig : NULL;
+  }
+  RadioContext *ctx = radio_lock_active();
+  if (!ctx->connected || !ctx->rig) {
+    pthread_mutex_unlock(&ctx->lock);
+    return NULL;
+  }
+  t_locked = ctx;
+  return ctx->rig;
+}
+
+const RadioDef *radio_active_def(void) {
+  return __atomic_load_n(&radio_active()->def, __ATOMIC_ACQUIRE);
+}
+
+void radio_unlock(void) {
+  if (t_session) {
+    return; // Dropped by radio_session_end()
+  }
+  RadioContext *ctx = t_locked;
+  t_locked = NULL;
+  if (ctx) {
+    pthread_mutex_unlock(&ctx->lock);
+  }
+}
+
+int radio_session_begin(void) {
+  if (!radio_lock()) {
+    return -1;
+  }
+  t_session = t_locked;
+  return 0;
+}
+
+void radio_session_end(void) {
+  if (!t_session) {
+    return;
+  }
+  t_session = NULL;
+  radio_unlock();
+}
+
+int radio_locked_get_strength(int *db) {
+  return radio_read_strength(t_locked, db);
+}
 
 // ============================================================================
 // Initialization & Cleanup
 // ============================================================================
 
-int radio_init(bool debug_mode) {
-  pthread_mutex_lock(&g_rig_mutex);
+// USB port a tty hangs off, as "/sys/bus/usb/devices/1-1.4" (the form
+// config keeps for audio and keypad too). Returns 0, or -1 if not USB.
+static int radio_tty_port(const char *device, char *port, size_t len) {
+  const char *name = strrchr(device, '/');
+  name = name ? name + 1 : device;
 
-  // Store debug mode for auto-reconnects
-  g_radio_debug_mode = debug_mode;
+  char sysfs_path[128];
+  char real[PATH_MAX];
+  snprintf(sysfs_path, sizeof(sysfs_path), "/sys/class/tty/%s/device", name);
+  if (realpath(sysfs_path, real) == NULL) {
+    return -1;
+  }
 
-  if (g_connected) {
-    pthread_mutex_unlock(&g_rig_mutex);
-    fprintf(stderr, "radio_init: Already connected\n");
+  // The interface directory ("1-1.4:1.0") is the last component that
+  // looks like bus-port:config.interface
+  char *interface = NULL;
+  char *save = NULL;
+  for (char *c = strtok_r(real, "/", &save); c != NULL;
+       c = strtok_r(NULL, "/", &save)) {
+    if (c[0] >= '1' && c[0] <= '9' && strchr(c, '-') && strchr(c, ':')) {
+      interface = c;
+    }
+  }
+  if (interface == NULL) {
     return -1;
   }
-  pthread_mutex_unlock(&g_rig_mutex);
 
-  int model = config_get_radio_model();
-  const char *device = config_get_radio_device();
-  int baud = config_get_radio_baud();
+  *strchr(interface, ':') = '\0';
+  snprintf(port, len, "/sys/bus/usb/devices/%s", interface);
+  return 0;
+}
+
+// Serial device to open: the configured one, unless a port is on record
+// and the adapter there now has another node (re-enumerated as ttyUSB1,
+// or another adapter took ttyUSB0). Returns whether a device was found.
+static bool radio_find_device(const char *configured, const char *port,
+                              char *device, size_t len) {
+  char found_port[128];
+  bool exists = access(configured, F_OK) == 0;
+  if (port[0] == '\0' ||
+      (exists && radio_tty_port(configured, found_port, sizeof(found_port)) == 0 &&
+       strcmp(found_port, port) == 0)) {
+    snprintf(device, len, "%s", configured);
+    return exists;
+  }
 
-  DEBUG_PRINT("radio_init: model=%d device=%s baud=%d\n", model, device, baud);
+  DIR *dir = opendir("/sys/class/tty");
+  if (dir == NULL) {
+    snprintf(device, len, "%s", configured);
+    return exists;
+  }
+
+  bool found = false;
+  struct dirent *entry;
+  while (!found && (entry = readdir(dir)) != NULL) {
+    if (strncmp(entry->d_name, "ttyUSB", 6) != 0 &&
+        strncmp(entry->d_name, "ttyACM", 6) != 0) {
+      continue;
+    }
+    char candidate[64];
+    snprintf(candidate, sizeof(candidate), "/dev/%.32s", entry->d_name);
+    if (radio_tty_port(candidate, found_port, sizeof(found_port)) == 0 &&
+        strcmp(found_port, port) == 0) {
+      snprintf(device, len, "%s", candidate);
+      found = true;
+    }
+  }
+  closedir(dir);
+
+  if (!found) {
+    snprintf(device, len, "%s", configured);
+    return exists;
+  }
+  if (strcmp(device, configured) != 0) {
+    printf("radio: Radio adapter on %s is now %s\n", port, device);
+  }
+  return true;
+}
+
+// Open model on device at baud and check that the rig answers. Returns the
+// open rig, or NULL. Doesn't touch the shared state.
+static RIG *radio_open_rig(int model, const char *device, int baud,
+                           bool *freq_uncached) {
+  DEBUG_PRINT("radio_open_rig: model=%d device=%s baud=%d\n", model, device,
+              baud);
 
   // Initialize Hamlib rig locally first
   RIG *temp_rig = rig_init(model);
   if (!temp_rig) {
     fprintf(stderr, "radio_init: rig_init failed for model %d\n", model);
-    return -1;
+    return NULL;
   }
 
   // Silence Hamlib verbose output to prevent console spam
   // (It logs every polling event by default, printing 100+ lines/sec)
-  if (!debug_mode) {
+  if (!g_radio_debug_mode) {
     rig_set_debug(RIG_DEBUG_NONE);
   } else {
     rig_set_debug(RIG_DEBUG_TRACE);
   }
 
-  // Configure serial port
+  // Configure serial port (or "host:port" for rigctld, baud 0)
   strncpy(temp_rig->state.rigport.pathname, device,
           sizeof(temp_rig->state.rigport.pathname) - 1);
-  temp_rig->state.rigport.parm.serial.rate = baud;
+  if (baud > 0) {
+    temp_rig->state.rigport.parm.serial.rate = baud;
+  }
 
   // Dramatically reduce Hamlib timeout latency to prevent UI freezes on disconnect
   // Using explicit API token configuration so backends don't override with defaults
@@ -100,203 +416,781 @@ int radio_init(bool debug_mode) {
 
   // Open connection (can block for several seconds on timeout)
   // We do NOT hold the g_rig_mutex during this time to avoid blocking UI keys
-  int retcode = rig_open(temp_rig);
+  int retcode = RADIO_TRACED(RADIO_OP_OPEN, rig_open(temp_rig));
 
   if (retcode == RIG_OK) {
+    // Bypass Hamlib's frequency cache. Some backends (Kenwood TS-570)
+    // answer rig_get_freq() from it even with the rig powered off; an
+    // uncached read that succeeds proves the rig is there.
+    *freq_uncached =
+        rig_set_cache_timeout_ms(temp_rig, HAMLIB_CACHE_FREQ, 0) == RIG_OK;
+
     // Actively verify the radio is responding (powered on).
     // An active USB-serial adapter might succeed in rig_open, but will time out here.
     freq_t test_freq;
-    retcode = rig_get_freq(temp_rig, RIG_VFO_CURR, &test_freq);
+    retcode = RADIO_TRACED(RADIO_OP_GET_FREQ,
+                           rig_get_freq(temp_rig, RIG_VFO_CURR, &test_freq));
     if (retcode != RIG_OK) {
       DEBUG_PRINT("radio_init: rig_open succeeded, but radio isn't responding (off?).\n");
       rig_close(temp_rig); // Close since open succeeded
     }
   }
 
-  // Re-acquire mutex to update global state
-  pthread_mutex_lock(&g_rig_mutex);
-
   if (retcode != RIG_OK) {
-    fprintf(stderr, "radio_init: Connection to radio failed: %s\n", rigerror(retcode));
+    DEBUG_PRINT("radio_open_rig: %s at %d baud: %s\n", device, baud,
+                rigerror(retcode));
     rig_cleanup(temp_rig);
-    pthread_mutex_unlock(&g_rig_mutex);
+    return NULL;
+  }
+  return temp_rig;
+}
+
+// Hamlib settings behind the fields with a capability check
+static const struct {
+  RadioField field;
+  bool is_func; // A rig function (on/off) rather than a level
+  setting_t setting;
+} g_cap_settings[] = {
+    {RADIO_FIELD_SMETER, false, RIG_LEVEL_STRENGTH},
+    {RADIO_FIELD_POWER_METER, false, RIG_LEVEL_RFPOWER_METER},
+    {RADIO_FIELD_SWR, false, RIG_LEVEL_SWR},
+    {RADIO_FIELD_ALC, false, RIG_LEVEL_ALC},
+    {RADIO_FIELD_POWER, false, RIG_LEVEL_RFPOWER},
+    {RADIO_FIELD_MIC_GAIN, false, RIG_LEVEL_MICGAIN},
+    {RADIO_FIELD_COMP, false, RIG_LEVEL_COMP},
+    {RADIO_FIELD_COMP_ON, true, RIG_FUNC_COMP},
+    {RADIO_FIELD_NB_ON, true, RIG_FUNC_NB},
+    {RADIO_FIELD_NB_LEVEL, false, RIG_LEVEL_NB},
+    {RADIO_FIELD_NR_ON, true, RIG_FUNC_NR},
+    {RADIO_FIELD_NR_LEVEL, false, RIG_LEVEL_NR},
+    {RADIO_FIELD_AGC, false, RIG_LEVEL_AGC},
+    {RADIO_FIELD_PREAMP, false, RIG_LEVEL_PREAMP},
+    {RADIO_FIELD_ATT, false, RIG_LEVEL_ATT},
+    {RADIO_FIELD_VOX, true, RIG_FUNC_VOX},
+};
+#define CAP_SETTING_COUNT                                                      \
+  (int)(sizeof(g_cap_settings) / sizeof(g_cap_settings[0]))
+
+// Build a radio's capability profile from Hamlib's tables (no serial I/O).
+// model is 0 behind rigctld, where it says nothing about the rig.
+static void radio_build_caps(RadioContext *ctx, RIG *rig, int model) {
+  radio_caps_begin(ctx->index, model);
+  int missing = 0;
+  for (int i = 0; i < CAP_SETTING_COUNT; i++) {
+    setting_t setting = g_cap_settings[i].setting;
+    bool get = g_cap_settings[i].is_func ? rig_has_get_func(rig, setting) != 0
+                                         : rig_has_get_level(rig, setting) != 0;
+    bool set = g_cap_settings[i].is_func ? rig_has_set_func(rig, setting) != 0
+                                         : rig_has_set_level(rig, setting) != 0;
+    radio_caps_set_supported(ctx->index, g_cap_settings[i].field,
+                             RADIO_CAP_GET, get);
+    radio_caps_set_supported(ctx->index, g_cap_settings[i].field,
+                             RADIO_CAP_SET, set);
+    missing += !get;
+  }
+
+  // What its definition says it lacks, Hamlib's tables notwithstanding
+  const RadioDef *def = ctx->def;
+  for (int f = 0; def && f < RADIO_FIELD_COUNT; f++) {
+    if (def->no_get & (1u << f)) {
+      radio_caps_set_supported(ctx->index, f, RADIO_CAP_GET, false);
+    }
+    if (def->no_set & (1u << f)) {
+      radio_caps_set_supported(ctx->index, f, RADIO_CAP_SET, false);
+    }
+  }
+  DEBUG_PRINT("radio_build_caps: Radio %d can't read %d of %d fields\n",
+              ctx->index + 1, missing, CAP_SETTING_COUNT);
+}
+
+// Set up the fast path on an opened rig's port, if configured and the rig
+// speaks a protocol it knows. Only on a serial port: not behind rigctld.
+static void radio_attach_cat(RadioContext *ctx, RIG *rig) {
+  RadioCatProtocol protocol = radio_cat_protocol_for(rig->caps->mfg_name);
+  if (!config_get_radio(ctx->index)->native_cat ||
+      rig->state.rigport.type.rig != RIG_PORT_SERIAL) {
+    protocol = RADIO_CAT_NONE;
+  }
+
+  int civ_addr = 0;
+  if (protocol == RADIO_CAT_CIV) {
+    char value[16] = "";
+    token_t t_civaddr = rig_token_lookup(rig, "civaddr");
+    if (t_civaddr == RIG_CONF_END ||
+        rig_get_conf(rig, t_civaddr, value) != RIG_OK ||
+        (civ_addr = atoi(value)) <= 0 || civ_addr > 0xDF) {
+      protocol = RADIO_CAT_NONE; // Without the address, Hamlib only
+    }
+  }
+
+  radio_cat_init(&ctx->cat, protocol, rig->state.rigport.fd,
+                 (unsigned char)civ_addr);
+  if (protocol != RADIO_CAT_NONE) {
+    printf("radio: Radio %d uses native %s commands\n", ctx->index + 1,
+           protocol == RADIO_CAT_CIV ? "CI-V" : "Kenwood CAT");
+  }
+}
+
+// Time one frequency read, in ms, or -1 if the rig didn't answer
+static double radio_time_round_trip(RIG *rig) {
+  struct timespec start, end;
+  freq_t freq;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  int retcode = RADIO_TRACED(RADIO_OP_GET_FREQ,
+                             rig_get_freq(rig, RIG_VFO_CURR, &freq));
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  if (retcode != RIG_OK) {
+    return -1.0;
+  }
+  return (end.tv_sec - start.tv_sec) * 1000.0 +
+         (end.tv_nsec - start.tv_nsec) / 1000000.0;
+}
+
+// Tune a newly opened rig's serial port for low latency, timing a
+// frequency read before and after. Hamlib opens the port, so this can
+// only follow rig_open(); the rig isn't shared yet.
+static void radio_tune_port(RIG *rig, const char *device,
+                            SerialLatency *latency) {
+  double before_ms = radio_time_round_trip(rig);
+  if (!serial_latency_tune(latency, SERIAL_LATENCY_SYSFS, device,
+                           rig->state.rigport.fd)) {
+    DEBUG_PRINT("radio: %s round trip %.1f ms, nothing to tune\n", device,
+                before_ms);
+    return;
+  }
+  double after_ms = radio_time_round_trip(rig);
+  printf("radio: %s round trip %.1f ms, %.1f ms tuned for low latency\n",
+         device, before_ms, after_ms);
+}
+
+// Make an opened rig a radio's connected one; latency is what was tuned
+// on its port, if anything
+static void radio_attach(RadioContext *ctx, RIG *rig, bool freq_uncached,
+                         int model, const SerialLatency *latency) {
+  pthread_mutex_lock(&ctx->lock);
+  ctx->rig = rig;
+  if (latency) {
+    ctx->latency = *latency;
+  } else {
+    memset(&ctx->latency, 0, sizeof(ctx->latency));
+  }
+  ctx->connected = true;
+  __atomic_store_n(&ctx->def, radio_defs_find(model), __ATOMIC_RELEASE);
+  // A model whose backend answers the frequency from a cache it won't
+  // give up is probed with the S-meter instead
+  ctx->freq_uncached =
+      freq_uncached &&
+      !(ctx->def && ctx->def->health_probe == RADIO_PROBE_SMETER);
+  radio_note_reply(ctx);
+  radio_state_clear_for(ctx->index);
+  radio_build_caps(ctx, rig, model);
+  radio_attach_cat(ctx, rig);
+  DEBUG_PRINT("radio_init: Connected to radio %d\n", ctx->index + 1);
+  pthread_mutex_unlock(&ctx->lock);
+}
+
+static bool radio_ctx_connected(RadioContext *ctx) {
+  pthread_mutex_lock(&ctx->lock);
+  bool connected = ctx->connected;
+  pthread_mutex_unlock(&ctx->lock);
+  return connected;
+}
+
+// Connect to a configured radio, finding its adapter by USB port and, if
+// scan_bauds, trying the common bauds after the configured one. What
+// worked is written back to config.
+static int radio_connect(RadioContext *ctx, bool scan_bauds) {
+  if (radio_ctx_connected(ctx)) {
+    fprintf(stderr, "radio_init: Already connected\n");
+    return -1;
+  }
+
+  const RadioSettings *settings = config_get_radio(ctx->index);
+
+  // Shared through rigctld: Hamlib's NET rigctl backend keeps one TCP
+  // connection open until rig_close(). The radio's model, device and
+  // baud are rigctld's settings, so there is nothing to find or probe.
+  // HAMPOD_RADIO_RIGCTLD overrides it for every radio, e.g. to run against
+  // Testing/simulated_radio without editing the config
+  const char *rigctld_env = getenv("HAMPOD_RADIO_RIGCTLD");
+  char rigctld[64];
+  snprintf(rigctld, sizeof(rigctld), "%s",
+           rigctld_env && rigctld_env[0] ? rigctld_env : settings->rigctld);
+  if (rigctld[0] != '\0') {
+    bool freq_uncached = false;
+    RIG *temp_rig =
+        radio_open_rig(RIG_MODEL_NETRIGCTL, rigctld, 0, &freq_uncached);
+    if (!temp_rig) {
+      fprintf(stderr, "radio_init: No answer from rigctld at %s\n", rigctld);
+      return -1;
+    }
+    radio_attach(ctx, temp_rig, freq_uncached, 0, NULL);
+    return 0;
+  }
+
+  int model = settings->model;
+  int baud = settings->baud;
+  char configured[64];
+  char port[128];
+  char device[64];
+  snprintf(configured, sizeof(configured), "%s", settings->device);
+  snprintf(port, sizeof(port), "%s", settings->port);
+
+  if (!radio_find_device(configured, port, device, sizeof(device))) {
+    fprintf(stderr, "radio_init: Device %s not found\n", configured);
+    return -1;
+  }
+
+  bool freq_uncached = false;
+  RIG *temp_rig = radio_open_rig(model, device, baud, &freq_uncached);
+  for (int i = 0; scan_bauds && !temp_rig && i < PROBE_BAUD_COUNT; i++) {
+    if (g_probe_bauds[i] != baud &&
+        (temp_rig = radio_open_rig(model, device, g_probe_bauds[i],
+                                   &freq_uncached)) != NULL) {
+      printf("radio: Radio answers at %d baud, not %d\n", g_probe_bauds[i],
+             baud);
+      baud = g_probe_bauds[i];
+    }
+  }
+  if (!temp_rig) {
+    fprintf(stderr, "radio_init: Connection to radio on %s failed\n", device);
     return -1;
   }
 
-  g_rig = temp_rig;
-  g_connected = true;
-  DEBUG_PRINT("radio_init: Connected to radio\n");
+  SerialLatency latency;
+  radio_tune_port(temp_rig, device, &latency);
+  radio_attach(ctx, temp_rig, freq_uncached, model, &latency);
 
-  pthread_mutex_unlock(&g_rig_mutex);
+  // Remember what worked (only on change: each write is an undo step)
+  char found_port[128];
+  if (radio_tty_port(device, found_port, sizeof(found_port)) != 0) {
+    snprintf(found_port, sizeof(found_port), "%s", port);
+  }
+  config_update_radio_connection(ctx->index, device, baud, found_port, model);
   return 0;
 }
 
+int radio_init(bool debug_mode) {
+  // Store debug mode for auto-reconnects
+  g_radio_debug_mode = debug_mode;
+
+  // The enabled radio is active; standby ones come up in the background
+  // (radio_start_reconnect)
+  int active = config_get_active_radio_index();
+  if (active < 0) {
+    active = 0;
+  }
+  for (int i = 0; i < MAX_RADIOS; i++) {
+    g_radios[i].index = i;
+    g_radios[i].in_use = i == active || config_get_radio(i)->standby;
+  }
+  __atomic_store_n(&g_active, &g_radios[active], __ATOMIC_RELEASE);
+  radio_state_select(active);
+  radio_caps_select(active);
+
+  return radio_connect(&g_radios[active], false);
+}
+
 void radio_cleanup(void) {
   // Stop polling first
   radio_stop_polling();
 
-  pthread_mutex_lock(&g_rig_mutex);
+  for (int i = 0; i < MAX_RADIOS; i++) {
+    RadioContext *ctx = &g_radios[i];
+    pthread_mutex_lock(&ctx->lock);
+    radio_close_rig(ctx);
+    pthread_mutex_unlock(&ctx->lock);
+  }
+  DEBUG_PRINT("radio_cleanup: Disconnected from radio\n");
+}
 
-  if (g_rig) {
-    rig_close(g_rig);
-    rig_cleanup(g_rig);
-    g_rig = NULL;
+bool radio_is_connected(void) {
+  RIG *rig = radio_lock();
+  if (rig) {
+    radio_unlock();
   }
+  return rig != NULL;
+}
 
-  g_connected = false;
-  DEBUG_PRINT("radio_cleanup: Disconnected from radio\n");
+// ============================================================================
+// Radio Selection
+// ============================================================================
+
+int radio_select(int index) {
+  if (index < 0 || index >= MAX_RADIOS || !g_radios[index].in_use) {
+    return -1;
+  }
+
+  // Hold both radios' locks (lowest index first), so nobody is talking to
+  // either while the active one changes
+  RadioContext *next = &g_radios[index];
+  RadioContext *old;
+  for (;;) {
+    old = radio_active();
+    RadioContext *first = old->index < next->index ? old : next;
+    RadioContext *second = first == old ? next : old;
+    pthread_mutex_lock(&first->lock);
+    if (second != first) {
+      pthread_mutex_lock(&second->lock);
+    }
+    if (old == g_active) {
+      break;
+    }
+    if (second != first) {
+      pthread_mutex_unlock(&second->lock);
+    }
+    pthread_mutex_unlock(&first->lock); // Switched meanwhile
+  }
+  if (next != old) {
+    __atomic_store_n(&g_active, next, __ATOMIC_RELEASE);
+    radio_state_select(index);
+    radio_caps_select(index);
+    pthread_mutex_unlock(&next->lock);
+  }
+  pthread_mutex_unlock(&old->lock);
 
-  pthread_mutex_unlock(&g_rig_mutex);
+  if (next != old) {
+    // Poll the new radio now, and fast while it is active
+    radio_poll_activity();
+    if (config_get_active_radio_index() != index) {
+      config_set_radio_enabled(index, true);
+    }
+    printf("radio: Switched to radio %d\n", index + 1);
+  }
+  return 0;
 }
 
-bool radio_is_connected(void) {
-  pthread_mutex_lock(&g_rig_mutex);
-  bool connected = g_connected;
-  pthread_mutex_unlock(&g_rig_mutex);
-  return connected;
+int radio_select_next(void) {
+  int active = radio_get_active();
+  for (int i = 1; i < MAX_RADIOS; i++) {
+    int index = (active + i) % MAX_RADIOS;
+    if (g_radios[index].in_use) {
+      return radio_select(index) == 0 ? index : -1;
+    }
+  }
+  return -1;
 }
 
+int radio_get_active(void) { return radio_active()->index; }
+
 // ============================================================================
 // Frequency Operations
 // ============================================================================
 
-double radio_get_frequency(void) {
-  pthread_mutex_lock(&g_rig_mutex);
+// Ask the radio, and cache the answer
+static double radio_query_frequency(RadioContext *ctx) {
+  radio_lock_for_call(ctx);
 
-  if (!g_connected || !g_rig) {
-    pthread_mutex_unlock(&g_rig_mutex);
+  if (!ctx->connected || !ctx->rig) {
+    pthread_mutex_unlock(&ctx->lock);
     return -1.0;
   }
 
   freq_t freq;
-  int retcode = rig_get_freq(g_rig, RIG_VFO_CURR, &freq);
+  RadioCat *cat = radio_fast_path(ctx);
+  int retcode = cat ? RADIO_CAT_TRACED(RADIO_OP_CAT_GET_FREQ,
+                                       radio_cat_get_freq(cat, &freq))
+                    : RADIO_CAT_FALLBACK;
+  if (retcode == RIG_OK) {
+    radio_note_reply(ctx); // No cache in the way
+  } else if (retcode == RADIO_CAT_FALLBACK) {
+    retcode = RADIO_TRACED(RADIO_OP_GET_FREQ,
+                           rig_get_freq(ctx->rig, RIG_VFO_CURR, &freq));
+    if (retcode == RIG_OK && ctx->freq_uncached) {
+      radio_note_reply(ctx);
+    }
+  }
 
-  pthread_mutex_unlock(&g_rig_mutex);
+  pthread_mutex_unlock(&ctx->lock);
 
   if (retcode != RIG_OK) {
     fprintf(stderr, "radio_get_frequency: %s\n", rigerror(retcode));
     return -1.0;
   }
 
+  radio_state_store_for(ctx->index, RADIO_FIELD_FREQ, (double)freq);
   return (double)freq;
 }
 
+double radio_get_frequency(void) {
+  double freq;
+  if (radio_state_get(RADIO_FIELD_FREQ, &freq)) {
+    return freq;
+  }
+  return radio_query_frequency(radio_active());
+}
+
 int radio_set_frequency(double freq_hz) {
-  pthread_mutex_lock(&g_rig_mutex);
+  RIG *rig = radio_lock();
 
-  if (!g_connected || !g_rig) {
-    pthread_mutex_unlock(&g_rig_mutex);
+  if (!rig) {
     return -1;
   }
+  RadioContext *ctx = t_locked;
+
+  // Kenwood names the VFO it sets: the one Hamlib last saw selected
+  RadioCat *cat = radio_fast_path(ctx);
+  vfo_t vfo = rig->state.current_vfo;
+  int retcode = cat && vfo != RIG_VFO_MEM
+                    ? RADIO_CAT_TRACED(RADIO_OP_CAT_SET_FREQ,
+                                       radio_cat_set_freq(cat, freq_hz,
+                                                          vfo == RIG_VFO_B))
+                    : RADIO_CAT_FALLBACK;
+  if (retcode == RADIO_CAT_FALLBACK) {
+    retcode = RADIO_TRACED(RADIO_OP_SET_FREQ,
+                           rig_set_freq(rig, RIG_VFO_CURR, (freq_t)freq_hz));
+  }
 
-  int retcode = rig_set_freq(g_rig, RIG_VFO_CURR, (freq_t)freq_hz);
-
-  pthread_mutex_unlock(&g_rig_mutex);
+  radio_unlock();
 
+  // Read back what the radio made of it; a rig in transceive mode may not
+  // report a change it was told to make
+  radio_state_invalidate_for(ctx->index, RADIO_FIELD_FREQ);
   if (retcode != RIG_OK) {
     fprintf(stderr, "radio_set_frequency: %s\n", rigerror(retcode));
     return -1;
   }
+  if (ctx->event_mode) {
+    __atomic_store_n(&ctx->event_freq_hz, (long long)freq_hz,
+                     __ATOMIC_RELAXED);
+  }
 
   DEBUG_PRINT("radio_set_frequency: Set to %.3f Hz\n", freq_hz);
   return 0;
 }
 
+// ============================================================================
+// Transceive (Event) Mode
+// ============================================================================
+
+// Hamlib's frequency event callback. Only stores the value: with SIGIO
+// based backends this runs in a signal handler.
+static int radio_freq_event(RIG *rig, vfo_t vfo, freq_t freq, rig_ptr_t arg) {
+  (void)rig;
+  (void)vfo;
+  RadioContext *ctx = arg;
+  __atomic_store_n(&ctx->event_freq_hz, (long long)freq, __ATOMIC_RELAXED);
+  radio_note_reply(ctx);
+  return RIG_OK;
+}
+
+// Hamlib's mode event callback, stored the same way
+static int radio_mode_event(RIG *rig, vfo_t vfo, rmode_t mode,
+                            pbwidth_t width, rig_ptr_t arg) {
+  (void)rig;
+  (void)vfo;
+  RadioContext *ctx = arg;
+  __atomic_store_n(&ctx->event_mode_raw, (long long)mode, __ATOMIC_RELAXED);
+  __atomic_store_n(&ctx->event_width_hz, (long long)width, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&ctx->event_mode_seq, 1, __ATOMIC_RELEASE);
+  radio_note_reply(ctx);
+  return RIG_OK;
+}
+
+// Ask the rig to report frequency changes itself (CI-V transceive, Kenwood
+// AI, ...) so the polling thread needn't query it. HAMPOD_RADIO_TRANSCEIVE=0
+// keeps polling. Returns whether the rig accepted.
+static bool radio_enable_events(RadioContext *ctx) {
+  const char *trn_env = getenv("HAMPOD_RADIO_TRANSCEIVE");
+  if (trn_env != NULL && strcmp(trn_env, "0") == 0) {
+    return false;
+  }
+
+  if (ctx->def && ctx->def->transceive == RADIO_DEF_NO) {
+    return false; // Known not to, so not tried
+  }
+
+  radio_lock_for_call(ctx);
+  int retcode = -RIG_EINVAL;
+  if (ctx->rig && ctx->rig->caps->transceive != RIG_TRN_OFF) {
+    rig_set_freq_callback(ctx->rig, radio_freq_event, ctx);
+    rig_set_mode_callback(ctx->rig, radio_mode_event, ctx);
+    retcode = RADIO_TRACED(RADIO_OP_SET_TRN,
+                           rig_set_trn(ctx->rig, RIG_TRN_RIG));
+    if (retcode != RIG_OK) {
+      rig_set_freq_callback(ctx->rig, NULL, NULL);
+      rig_set_mode_callback(ctx->rig, NULL, NULL);
+    }
+  }
+  pthread_mutex_unlock(&ctx->lock);
+
+  if (retcode != RIG_OK) {
+    DEBUG_PRINT("radio_enable_events: Not supported, polling instead\n");
+    return false;
+  }
+  printf("Radio %d reports frequency changes itself (transceive mode)\n",
+         ctx->index + 1);
+  return true;
+}
+
+static void radio_disable_events(RadioContext *ctx) {
+  radio_lock_for_call(ctx);
+  if (ctx->rig) {
+    RADIO_TRACED(RADIO_OP_SET_TRN, rig_set_trn(ctx->rig, RIG_TRN_OFF));
+    rig_set_freq_callback(ctx->rig, NULL, NULL);
+    rig_set_mode_callback(ctx->rig, NULL, NULL);
+  }
+  pthread_mutex_unlock(&ctx->lock);
+}
+
+// Frequency for this poll: queried in polling mode; in transceive mode the
+// last one reported, queried only every EVENT_RESYNC_MS (and until the
+// first report) in case an event was lost. *resync_ms is when it was last
+// queried, 0 to query now.
+static double radio_current_frequency(RadioContext *ctx, long long now,
+                                      long long *resync_ms) {
+  if (!ctx->event_mode) {
+    return radio_query_frequency(ctx);
+  }
+
+  long long event_freq =
+      __atomic_load_n(&ctx->event_freq_hz, __ATOMIC_RELAXED);
+  if (event_freq > 0 && now - *resync_ms < EVENT_RESYNC_MS) {
+    radio_state_store_for(ctx->index, RADIO_FIELD_FREQ, (double)event_freq);
+    return (double)event_freq;
+  }
+
+  *resync_ms = now;
+  double freq = radio_query_frequency(ctx);
+  if (freq > 0) {
+    __atomic_store_n(&ctx->event_freq_hz, (long long)freq, __ATOMIC_RELAXED);
+  }
+  return freq;
+}
+
+// Cache the mode the rig last reported, if it reported one since *seen
+static void radio_note_mode_event(RadioContext *ctx, unsigned int *seen) {
+  unsigned int seq = __atomic_load_n(&ctx->event_mode_seq, __ATOMIC_ACQUIRE);
+  if (seq == *seen) {
+    return;
+  }
+  *seen = seq;
+  radio_state_store_for(
+      ctx->index, RADIO_FIELD_MODE,
+      (double)__atomic_load_n(&ctx->event_mode_raw, __ATOMIC_RELAXED));
+  radio_state_store_for(
+      ctx->index, RADIO_FIELD_PASSBAND,
+      (double)__atomic_load_n(&ctx->event_width_hz, __ATOMIC_RELAXED));
+}
+
+// Sleep up to interval_ms; returns true if a key press cut it short
+static bool radio_poll_wait(RadioContext *ctx, int interval_ms) {
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_sec += interval_ms / 1000;
+  deadline.tv_nsec += (long)(interval_ms % 1000) * 1000000L;
+  if (deadline.tv_nsec >= 1000000000L) {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000L;
+  }
+
+  pthread_mutex_lock(&ctx->poll_mutex);
+  int rc = 0;
+  while (!ctx->poll_activity && ctx->polling && rc == 0) {
+    rc = pthread_cond_timedwait(&ctx->poll_wake, &ctx->poll_mutex, &deadline);
+  }
+  bool activity = ctx->poll_activity;
+  ctx->poll_activity = false;
+  pthread_mutex_unlock(&ctx->poll_mutex);
+  return activity;
+}
+
 // ============================================================================
 // Radio Polling Thread
 // ============================================================================
 
+// One per connected radio. Only the active radio's poller announces and
+// polls fast; a standby radio's just keeps its state warm at the idle rate.
+// Poll limits from [radio.N], else from the model's definition, else the
+// defaults
+static void radio_poll_limits(RadioContext *ctx, int *fast_ms, int *idle_ms) {
+  config_get_radio_poll_limits(ctx->index, fast_ms, idle_ms);
+  const RadioSettings *settings = config_get_radio(ctx->index);
+  const RadioDef *def = ctx->def;
+  if (def && settings->poll_fast_ms <= 0 && def->poll_fast_ms > 0) {
+    *fast_ms = def->poll_fast_ms;
+  }
+  if (def && settings->poll_idle_ms <= 0 && def->poll_idle_ms > 0) {
+    *idle_ms = def->poll_idle_ms;
+  }
+  if (*idle_ms < *fast_ms) {
+    *idle_ms = *fast_ms;
+  }
+}
+
 static void *polling_thread_func(void *arg) {
-  (void)arg; // Unused
+  RadioContext *ctx = arg;
+  hampod_metrics_name_thread("radio-poll");
 
   double last_freq = -1.0;
   double stable_freq = -1.0;
-  int stable_count = 0;
-  int debounce_ticks = DEBOUNCE_TIME_MS / POLL_INTERVAL_MS;
+  bool pending = false;     // Changed and not announced yet
+  long long changed_ms = 0; // When last_freq last changed
   int fail_count = 0;
-
-  DEBUG_PRINT("polling_thread: Started (debounce=%d ticks)\n", debounce_ticks);
-
-  while (g_polling_active) {
-    double current_freq = radio_get_frequency();
+  long long resync_ms = 0;
+  unsigned int mode_seq =
+      __atomic_load_n(&ctx->event_mode_seq, __ATOMIC_ACQUIRE);
+
+  // Poll fast while the dial moves, then back off toward the idle interval
+  int fast_ms, idle_ms;
+  radio_poll_limits(ctx, &fast_ms, &idle_ms);
+  int interval_ms = fast_ms;
+
+  DEBUG_PRINT("polling_thread: Radio %d started (every %d-%d ms, %s)\n",
+              ctx->index + 1, fast_ms, idle_ms,
+              ctx->event_mode ? "transceive" : "polling");
+
+  while (ctx->polling) {
+    hampod_metric_add(METRIC_RADIO_POLLS, 1);
+    int slowest_ms = idle_stretch_ms(idle_ms, POLL_IDLE_MODE_MS);
+    bool active = ctx == radio_active();
+    long long now = radio_now_ms();
+    double current_freq = radio_current_frequency(ctx, now, &resync_ms);
+    if (ctx->event_mode) {
+      radio_note_mode_event(ctx, &mode_seq);
+    }
 
     // Health check: Hamlib aggressively caches frequencies on some radios (Kenwood TS570).
     // If the cache hits, rig_get_freq() endlessly returns success even when powered off.
-    // Every 1 second (10 iterations), poll the S-meter (doesn't cache) to verify connection.
-    static int health_check_ticks = 0;
-    if (current_freq > 0 && ++health_check_ticks >= 10) {
-        health_check_ticks = 0;
-        pthread_mutex_lock(&g_rig_mutex);
-        if (g_rig) {
-            value_t val;
-            int ret = rig_get_level(g_rig, RIG_VFO_CURR, RIG_LEVEL_STRENGTH, &val);
+    // With that cache off, each poll's frequency read already proves the rig answers, and
+    // in transceive mode every event does. Only after HEALTH_CHECK_MS without either (a
+    // quiet rig in transceive mode, or a cache we couldn't turn off) probe the S-meter,
+    // which doesn't cache.
+    long long last_reply =
+        __atomic_load_n(&ctx->last_reply_ms, __ATOMIC_RELAXED);
+    if (current_freq > 0 && now - last_reply >= HEALTH_CHECK_MS) {
+        radio_lock_for_call(ctx);
+        if (ctx->rig) {
+            // One its definition says has no S-meter isn't asked
+            int db;
+            bool no_smeter = ctx->def &&
+                             ctx->def->no_get & (1u << RADIO_FIELD_SMETER);
+            int ret = no_smeter ? -RIG_ENAVAIL : radio_read_strength(ctx, &db);
             // -11 is RIG_ENAVAIL (radio doesn't support S-Meter). Anything else under 0 is a timeout/error!
             if (ret < 0 && ret != -11) {
                 current_freq = -1.0; // Force a failure exactly as if freq timed out
+            } else {
+                // Without an S-meter there's nothing better to probe with;
+                // don't retry every poll
+                radio_note_reply(ctx);
+                if (ret == RIG_OK) {
+                    radio_state_store_for(ctx->index, RADIO_FIELD_SMETER,
+                                          (double)db);
+                }
             }
         }
-        pthread_mutex_unlock(&g_rig_mutex);
+        pthread_mutex_unlock(&ctx->lock);
     }
 
+    bool changed = false;
     if (current_freq > 0) {
       fail_count = 0; // Reset on success
 
       if (current_freq != last_freq) {
-        // Frequency changed, reset debounce
+        // Frequency changed, reset debounce (a standby radio's changes
+        // aren't announced, not even after switching to it)
         stable_freq = current_freq;
-        stable_count = 0;
         last_freq = current_freq;
-      } else {
-        // Frequency stable
-        stable_count++;
-
-        if (stable_count == debounce_ticks && g_freq_callback) {
-          // Debounce complete, announce
+        changed_ms = now;
+        pending = active;
+        changed = true;
+        if (active) {
+          idle_note_activity(); // The dial turned
+        }
+      } else if (pending && now - changed_ms >= DEBOUNCE_TIME_MS) {
+        // Debounce complete, announce
+        pending = false;
+        if (active && g_freq_callback) {
           DEBUG_PRINT("polling_thread: Stable at %.3f Hz\n", stable_freq);
           g_freq_callback(stable_freq);
         }
       }
     } else {
-      // Query failed
+      // Query failed; in transceive mode query again next poll rather
+      // than trusting the last event
       fail_count++;
+      resync_ms = 0;
       if (fail_count >= DISCONNECT_THRESHOLD) {
-        printf("polling_thread: %d consecutive failures, radio disconnected\n",
-               fail_count);
+        printf("polling_thread: %d consecutive failures, radio %d "
+               "disconnected\n",
+               fail_count, ctx->index + 1);
 
         // Directly close rig and mark disconnected (can't call radio_cleanup
         // here because it calls radio_stop_polling which would try to join
         // this thread on itself = deadlock)
-        pthread_mutex_lock(&g_rig_mutex);
-        if (g_rig) {
-          rig_close(g_rig);
-          rig_cleanup(g_rig);
-          g_rig = NULL;
-        }
-        g_connected = false;
-        pthread_mutex_unlock(&g_rig_mutex);
+        pthread_mutex_lock(&ctx->lock);
+        radio_close_rig(ctx);
+        pthread_mutex_unlock(&ctx->lock);
 
         // Stop this polling thread (reconnect thread will restart it)
-        g_polling_active = false;
+        ctx->polling = false;
 
         // Notify via callback (after releasing locks)
-        if (g_disconnect_callback) {
-          g_disconnect_callback();
-        }
+        radio_lost(ctx);
         break;
       }
     }
 
-    // Sleep for poll interval
-    struct timespec ts = {0, POLL_INTERVAL_MS * 1000000};
-    nanosleep(&ts, NULL);
+    // Back to fast on a change or failure, otherwise slow down gradually.
+    // In the background, stay at the idle rate (slower still in idle mode).
+    idle_note_wakeup(changed || pending || fail_count > 0);
+    if (!active) {
+      interval_ms = slowest_ms;
+    } else if (changed || fail_count > 0) {
+      interval_ms = fast_ms;
+    } else {
+      interval_ms = interval_ms * POLL_BACKOFF_PERCENT / 100;
+      if (interval_ms > slowest_ms) {
+        interval_ms = slowest_ms;
+      }
+    }
+
+    // A key press (e.g. a frequency entered) also means fast again
+    if (radio_poll_wait(ctx, interval_ms)) {
+      interval_ms = fast_ms;
+    }
   }
 
-  DEBUG_PRINT("polling_thread: Stopped\n");
+  DEBUG_PRINT("polling_thread: Radio %d stopped\n", ctx->index + 1);
   return NULL;
 }
 
+static int radio_start_context_polling(RadioContext *ctx) {
+  __atomic_store_n(&ctx->event_freq_hz, -1LL, __ATOMIC_RELAXED);
+  ctx->event_mode = radio_enable_events(ctx);
+  ctx->polling = true;
+
+  int ret = pthread_create(&ctx->poll_thread, NULL, polling_thread_func, ctx);
+  if (ret != 0) {
+    fprintf(stderr, "radio_start_polling: pthread_create failed\n");
+    ctx->polling = false;
+    if (ctx->event_mode) {
+      radio_disable_events(ctx);
+      ctx->event_mode = false;
+    }
+    return -1;
+  }
+  return 0;
+}
+
+static void radio_stop_context_polling(RadioContext *ctx) {
+  if (!ctx->polling) {
+    return;
+  }
+
+  pthread_mutex_lock(&ctx->poll_mutex);
+  ctx->polling = false;
+  pthread_cond_signal(&ctx->poll_wake);
+  pthread_mutex_unlock(&ctx->poll_mutex);
+  pthread_join(ctx->poll_thread, NULL);
+  if (ctx->event_mode) {
+    radio_disable_events(ctx);
+    ctx->event_mode = false;
+  }
+}
+
 int radio_start_polling(radio_freq_change_callback on_change) {
-  if (g_polling_active) {
+  if (radio_active()->polling) {
     fprintf(stderr, "radio_start_polling: Already polling\n");
     return -1;
   }
@@ -307,124 +1201,235 @@ int radio_start_polling(radio_freq_change_callback on_change) {
   }
 
   g_freq_callback = on_change;
-  g_polling_active = true;
-
-  int ret = pthread_create(&g_poll_thread, NULL, polling_thread_func, NULL);
-  if (ret != 0) {
-    fprintf(stderr, "radio_start_polling: pthread_create failed\n");
-    g_polling_active = false;
-    return -1;
+  g_polling_wanted = true;
+
+  // The active radio, and any standby one that is connected but idle
+  int result = 0;
+  for (int i = 0; i < MAX_RADIOS; i++) {
+    RadioContext *ctx = &g_radios[i];
+    if ((ctx == radio_active() || ctx->in_use) && !ctx->polling &&
+        radio_ctx_connected(ctx) && radio_start_context_polling(ctx) != 0 &&
+        ctx == radio_active()) {
+      result = -1;
+    }
   }
 
   DEBUG_PRINT("radio_start_polling: Started\n");
-  return 0;
+  return result;
 }
 
 void radio_stop_polling(void) {
-  if (!g_polling_active) {
-    return;
+  g_polling_wanted = false;
+  for (int i = 0; i < MAX_RADIOS; i++) {
+    radio_stop_context_polling(&g_radios[i]);
   }
-
-  g_polling_active = false;
-  pthread_join(g_poll_thread, NULL);
   g_freq_callback = NULL;
 
   DEBUG_PRINT("radio_stop_polling: Stopped\n");
 }
 
-bool radio_is_polling(void) { return g_polling_active; }
+bool radio_is_polling(void) { return radio_active()->polling; }
+
+void radio_poll_activity(void) {
+  RadioContext *ctx = radio_active();
+  pthread_mutex_lock(&ctx->poll_mutex);
+  ctx->poll_activity = true;
+  pthread_cond_signal(&ctx->poll_wake);
+  pthread_mutex_unlock(&ctx->poll_mutex);
+}
 
 // ============================================================================
 // Auto-Reconnect Thread
 // ============================================================================
 
-static void *reconnect_thread_func(void *arg) {
+// Housekeeping job: the cheap device checks for every radio, which wake a
+// radio's reconnect thread only when it has something to do
+static bool radio_reconnect_job(void *arg) {
   (void)arg;
+  bool kicked = false;
+  long long now = radio_now_ms();
 
-  DEBUG_PRINT("reconnect_thread: Started\n");
-
-  while (g_reconnect_active) {
-    if (radio_is_connected()) {
+  for (int i = 0; i < MAX_RADIOS; i++) {
+    RadioContext *ctx = &g_radios[i];
+    if (!ctx->reconnecting) {
+      continue;
+    }
+    const RadioSettings *settings = config_get_radio(ctx->index);
+    // Through rigctld there's no local device to watch for
+    bool networked = settings->rigctld[0] != '\0';
+    char configured[64];
+    snprintf(configured, sizeof(configured), "%s", settings->device);
+
+    bool due;
+    if (radio_ctx_connected(ctx)) {
       // Monitor for USB device disappearance (handles the case where
       // Hamlib's serial calls hang on a dead file descriptor, preventing
       // the polling thread's failure detection from triggering)
-      const char *device = config_get_radio_device();
-      if (access(device, F_OK) != 0) {
+      ctx->device_seen = true;
+      due = !networked && access(configured, F_OK) != 0;
+    } else {
+      // Look for the adapter before attempting (avoids Hamlib spam). Try
+      // the moment it appears, then every RECONNECT_INTERVAL_SEC.
+      char port[128];
+      char device[64];
+      snprintf(port, sizeof(port), "%s", settings->port);
+      bool present = networked || radio_find_device(configured, port, device,
+                                                    sizeof(device));
+      due = present && (!ctx->device_seen ||
+                        now - ctx->attempt_ms >= RECONNECT_INTERVAL_SEC * 1000);
+      ctx->device_seen = present;
+      if (due) {
+        ctx->attempt_ms = now;
+      }
+    }
+
+    if (due) {
+      pthread_mutex_lock(&ctx->poll_mutex);
+      ctx->reconnect_kick = true;
+      pthread_cond_signal(&ctx->reconnect_wake);
+      pthread_mutex_unlock(&ctx->poll_mutex);
+      kicked = true;
+    }
+  }
+  return kicked;
+}
+
+// One per radio in use, so a standby radio that is slow to answer never
+// holds up the active one. Sleeps until radio_reconnect_job() wakes it.
+static void *reconnect_thread_func(void *arg) {
+  RadioContext *ctx = arg;
+  const RadioSettings *settings = config_get_radio(ctx->index);
+
+  DEBUG_PRINT("reconnect_thread: Radio %d started\n", ctx->index + 1);
+
+  int attempts = 0; // Since the last disconnect
+
+  while (ctx->reconnecting) {
+    pthread_mutex_lock(&ctx->poll_mutex);
+    while (!ctx->reconnect_kick && ctx->reconnecting) {
+      pthread_cond_wait(&ctx->reconnect_wake, &ctx->poll_mutex);
+    }
+    ctx->reconnect_kick = false;
+    pthread_mutex_unlock(&ctx->poll_mutex);
+    if (!ctx->reconnecting) {
+      break;
+    }
+
+    bool networked = settings->rigctld[0] != '\0';
+
+    if (radio_ctx_connected(ctx)) {
+      const char *device = settings->device;
+      if (!networked && access(device, F_OK) != 0) {
         printf(
             "reconnect_thread: USB device %s disappeared, forcing disconnect\n",
             device);
 
         // Stop polling first (it may be stuck in a blocking serial read)
-        g_polling_active = false;
+        ctx->polling = false;
 
         // Close rig and mark disconnected
-        pthread_mutex_lock(&g_rig_mutex);
-        if (g_rig) {
-          rig_close(g_rig);
-          rig_cleanup(g_rig);
-          g_rig = NULL;
-        }
-        g_connected = false;
-        pthread_mutex_unlock(&g_rig_mutex);
+        pthread_mutex_lock(&ctx->lock);
+        radio_close_rig(ctx);
+        pthread_mutex_unlock(&ctx->lock);
 
         // Notify
-        if (g_disconnect_callback) {
-          g_disconnect_callback();
-        }
-      }
-    } else {
-      // Check if USB device exists before attempting (avoids Hamlib spam)
-      const char *device = config_get_radio_device();
-      if (access(device, F_OK) == 0) {
-        DEBUG_PRINT("reconnect_thread: Device %s found, attempting connect\n",
-                    device);
-
-        if (radio_init(g_radio_debug_mode) == 0) {
-          printf("reconnect_thread: Radio connected!\n");
-
-          // Notify via callback
-          if (g_connect_callback) {
-            g_connect_callback();
-          }
-        } else {
-          // Device exists but Hamlib can't open it.
-          // Wait and let the loop naturally retry. 
-          // The aggressive USBDEVFS_RESET has been removed because it causes
-          // serial RS-232 adapters (like TS570) to disconnect and re-enumerate 
-          // as a different node (e.g., ttyUSB1), permanently breaking the connection.
-          DEBUG_PRINT("reconnect_thread: Device %s exists but init failed. Retrying on next cycle.\n", device);
-        }
+        radio_lost(ctx);
       }
+      continue;
     }
 
-    // Sleep between attempts
-    for (int i = 0; i < RECONNECT_INTERVAL_SEC * 10 && g_reconnect_active;
-         i++) {
-      struct timespec ts = {0, 100000000}; // 100ms
-      nanosleep(&ts, NULL);
+    // Find the adapter again, by its USB port if known, so a
+    // re-enumerated node is found too
+    char configured[64];
+    char port[128];
+    char device[64];
+    snprintf(configured, sizeof(configured), "%s", settings->device);
+    snprintf(port, sizeof(port), "%s", settings->port);
+    if (networked) {
+      snprintf(device, sizeof(device), "%s", settings->rigctld);
+    } else if (!radio_find_device(configured, port, device, sizeof(device))) {
+      continue; // Gone again
+    }
+
+    // Scan the bauds on the second attempt and every
+    // RECONNECT_BAUD_SCAN_EVERY after that
+    DEBUG_PRINT("reconnect_thread: Device %s found, attempting connect\n",
+                device);
+    bool scan_bauds = attempts++ % RECONNECT_BAUD_SCAN_EVERY == 1;
+
+    if (radio_connect(ctx, scan_bauds) != 0) {
+      // Device exists but Hamlib can't open it.
+      // Wait and let the loop naturally retry.
+      // The aggressive USBDEVFS_RESET has been removed because it causes
+      // serial RS-232 adapters (like TS570) to disconnect and re-enumerate
+      // as a different node (e.g., ttyUSB1), permanently breaking the
+      // connection.
+      DEBUG_PRINT("reconnect_thread: Device %s exists but init failed. "
+                  "Retrying on next cycle.\n",
+                  device);
+    } else if (ctx == radio_active()) {
+      attempts = 0;
+      printf("reconnect_thread: Radio connected!\n");
+
+      // Notify via callback
+      if (g_connect_callback) {
+        g_connect_callback();
+      }
+    } else {
+      attempts = 0;
+      printf("reconnect_thread: Standby radio %d connected\n",
+             ctx->index + 1);
+      if (g_polling_wanted && !ctx->polling) {
+        radio_start_context_polling(ctx);
+      }
     }
   }
 
-  DEBUG_PRINT("reconnect_thread: Stopped\n");
+  DEBUG_PRINT("reconnect_thread: Radio %d stopped\n", ctx->index + 1);
   return NULL;
 }
 
 int radio_start_reconnect(radio_connect_callback on_connect,
                           radio_disconnect_callback on_disconnect) {
-  if (g_reconnect_active) {
-    fprintf(stderr, "radio_start_reconnect: Already running\n");
-    return -1;
+  for (int i = 0; i < MAX_RADIOS; i++) {
+    if (g_radios[i].reconnecting) {
+      fprintf(stderr, "radio_start_reconnect: Already running\n");
+      return -1;
+    }
   }
 
   g_connect_callback = on_connect;
   g_disconnect_callback = on_disconnect;
-  g_reconnect_active = true;
 
-  int ret =
-      pthread_create(&g_reconnect_thread, NULL, reconnect_thread_func, NULL);
-  if (ret != 0) {
-    fprintf(stderr, "radio_start_reconnect: pthread_create failed\n");
-    g_reconnect_active = false;
+  // One job checks the devices of every radio
+  if (!g_reconnect_job_added) {
+    if (idle_add_job(radio_reconnect_job, NULL, RECONNECT_CHECK_MS,
+                     RECONNECT_IDLE_CHECK_MS) != 0) {
+      fprintf(stderr, "radio_start_reconnect: No housekeeping timer\n");
+      return -1;
+    }
+    g_reconnect_job_added = true;
+  }
+
+  int started = 0;
+  for (int i = 0; i < MAX_RADIOS; i++) {
+    RadioContext *ctx = &g_radios[i];
+    if (!ctx->in_use && ctx != radio_active()) {
+      continue;
+    }
+    ctx->device_seen = true;
+    ctx->attempt_ms = radio_now_ms();
+    ctx->reconnect_kick = false;
+    ctx->reconnecting = true;
+    if (pthread_create(&ctx->reconnect_thread, NULL, reconnect_thread_func,
+                       ctx) != 0) {
+      fprintf(stderr, "radio_start_reconnect: pthread_create failed\n");
+      ctx->reconnecting = false;
+    } else {
+      started++;
+    }
+  }
+  if (started == 0) {
     return -1;
   }
 
@@ -433,12 +1438,21 @@ int radio_start_reconnect(radio_connect_callback on_connect,
 }
 
 void radio_stop_reconnect(void) {
-  if (!g_reconnect_active) {
-    return;
+  // Stop them all first: each may be in the middle of a connect attempt
+  bool running[MAX_RADIOS];
+  for (int i = 0; i < MAX_RADIOS; i++) {
+    RadioContext *ctx = &g_radios[i];
+    running[i] = ctx->reconnecting;
+    pthread_mutex_lock(&ctx->poll_mutex);
+    ctx->reconnecting = false;
+    pthread_cond_signal(&ctx->reconnect_wake);
+    pthread_mutex_unlock(&ctx->poll_mutex);
+  }
+  for (int i = 0; i < MAX_RADIOS; i++) {
+    if (running[i]) {
+      pthread_join(g_radios[i].reconnect_thread, NULL);
+    }
   }
-
-  g_reconnect_active = false;
-  pthread_join(g_reconnect_thread, NULL);
   g_connect_callback = NULL;
   g_disconnect_callback = NULL;
 
@@ -0,0 +1,248 @@
+/**
+ * @file radio_caps.c
+ * @brief Radio capability profile implementation
+ */
+
+#include "radio_caps.h"
+#include "hampod_core.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// ============================================================================
+// State
+// ============================================================================
+
+_Static_assert(RADIO_FIELD_COUNT <= 32, "Field masks are 32 bits");
+
+#define RADIO_CAPS_MODELS 32 // Rig models with learned gaps
+
+// Per radio: fields known to be unsupported, one mask per access
+typedef struct {
+  int model;
+  uint32_t missing[2];
+} RadioCaps;
+
+static RadioCaps g_caps[RADIO_STATE_SLOTS];
+static RadioCaps *g_selected = &g_caps[0];
+
+// Gaps learned per model, as saved in the file
+static RadioCaps g_learned[RADIO_CAPS_MODELS];
+static int g_learned_count = 0;
+
+static char g_caps_path[256] = RADIO_CAPS_DEFAULT_PATH;
+static pthread_mutex_t g_caps_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// File names of the fields worth a capability check
+static const char *const g_field_names[RADIO_FIELD_COUNT] = {
+    [RADIO_FIELD_SMETER] = "smeter",
+    [RADIO_FIELD_POWER_METER] = "power_meter",
+    [RADIO_FIELD_SWR] = "swr",
+    [RADIO_FIELD_ALC] = "alc",
+    [RADIO_FIELD_POWER] = "power",
+    [RADIO_FIELD_MIC_GAIN] = "mic_gain",
+    [RADIO_FIELD_COMP] = "comp",
+    [RADIO_FIELD_COMP_ON] = "comp_on",
+    [RADIO_FIELD_NB_ON] = "nb_on",
+    [RADIO_FIELD_NB_LEVEL] = "nb_level",
+    [RADIO_FIELD_NR_ON] = "nr_on",
+    [RADIO_FIELD_NR_LEVEL] = "nr_level",
+    [RADIO_FIELD_AGC] = "agc",
+    [RADIO_FIELD_PREAMP] = "preamp",
+    [RADIO_FIELD_ATT] = "att",
+    [RADIO_FIELD_VOX] = "vox",
+};
+
+static const char *const g_access_names[2] = {"get", "set"};
+
+// ============================================================================
+// Internal Functions
+// ============================================================================
+
+static bool valid_field(RadioField field) {
+  return field >= 0 && field < RADIO_FIELD_COUNT;
+}
+
+static bool valid_access(RadioCapAccess access) {
+  return access == RADIO_CAP_GET || access == RADIO_CAP_SET;
+}
+
+static bool valid_slot(int slot) {
+  return slot >= 0 && slot < RADIO_STATE_SLOTS;
+}
+
+// A model's learned gaps, added if create. Call with g_caps_mutex held.
+static RadioCaps *learned_for(int model, bool create) {
+  for (int i = 0; i < g_learned_count; i++) {
+    if (g_learned[i].model == model) {
+      return &g_learned[i];
+    }
+  }
+  if (!create || g_learned_count == RADIO_CAPS_MODELS) {
+    return NULL;
+  }
+  RadioCaps *entry = &g_learned[g_learned_count++];
+  entry->model = model;
+  entry->missing[RADIO_CAP_GET] = 0;
+  entry->missing[RADIO_CAP_SET] = 0;
+  return entry;
+}
+
+// Write every learned gap. Call with g_caps_mutex held.
+static void save_learned(void) {
+  char tmp_path[sizeof(g_caps_path) + 4];
+  snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", g_caps_path);
+  FILE *out = fopen(tmp_path, "w");
+  if (out == NULL) {
+    fprintf(stderr, "radio_caps: Cannot write %s\n", tmp_path);
+    return;
+  }
+
+  fprintf(out, "# Features these rig models refused although Hamlib lists "
+               "them.\n");
+  fprintf(out, "# Delete a line (or this file) to try one again.\n");
+  fprintf(out, "# model access field\n");
+  for (int i = 0; i < g_learned_count; i++) {
+    for (int a = 0; a < 2; a++) {
+      for (int f = 0; f < RADIO_FIELD_COUNT; f++) {
+        if (g_learned[i].missing[a] & (1u << f) && g_field_names[f]) {
+          fprintf(out, "%d %s %s\n", g_learned[i].model, g_access_names[a],
+                  g_field_names[f]);
+        }
+      }
+    }
+  }
+  fclose(out);
+  rename(tmp_path, g_caps_path);
+}
+
+// ============================================================================
+// Lifecycle
+// ============================================================================
+
+int radio_caps_init(const char *path) {
+  pthread_mutex_lock(&g_caps_mutex);
+  snprintf(g_caps_path, sizeof(g_caps_path), "%s",
+           path ? path : RADIO_CAPS_DEFAULT_PATH);
+  g_learned_count = 0;
+
+  FILE *in = fopen(g_caps_path, "r");
+  if (in == NULL) {
+    pthread_mutex_unlock(&g_caps_mutex);
+    return 0; // Nothing learned yet
+  }
+
+  char line[128];
+  while (fgets(line, sizeof(line), in)) {
+    int model;
+    char access[8];
+    char field[32];
+    if (line[0] == '#' ||
+        sscanf(line, "%d %7s %31s", &model, access, field) != 3) {
+      continue;
+    }
+    int a = strcmp(access, "set") == 0 ? RADIO_CAP_SET : RADIO_CAP_GET;
+    int f = radio_caps_field_named(field);
+    RadioCaps *entry = f >= 0 ? learned_for(model, true) : NULL;
+    if (entry) {
+      entry->missing[a] |= 1u << f;
+    }
+  }
+  fclose(in);
+
+  DEBUG_PRINT("radio_caps_init: Gaps for %d models from %s\n",
+              g_learned_count, g_caps_path);
+  pthread_mutex_unlock(&g_caps_mutex);
+  return 0;
+}
+
+// ============================================================================
+// Profiles
+// ============================================================================
+
+void radio_caps_begin(int slot, int model) {
+  if (!valid_slot(slot)) {
+    return;
+  }
+
+  pthread_mutex_lock(&g_caps_mutex);
+  RadioCaps *caps = &g_caps[slot];
+  const RadioCaps *learned = model > 0 ? learned_for(model, false) : NULL;
+  caps->model = model;
+  for (int a = 0; a < 2; a++) {
+    caps->missing[a] = learned ? learned->missing[a] : 0;
+  }
+  pthread_mutex_unlock(&g_caps_mutex);
+}
+
+void radio_caps_set_supported(int slot, RadioField field,
+                              RadioCapAccess access, bool supported) {
+  if (!valid_slot(slot) || !valid_field(field) || !valid_access(access)) {
+    return;
+  }
+
+  pthread_mutex_lock(&g_caps_mutex);
+  if (!supported) {
+    g_caps[slot].missing[access] |= 1u << field;
+  }
+  pthread_mutex_unlock(&g_caps_mutex);
+}
+
+void radio_caps_select(int slot) {
+  if (!valid_slot(slot)) {
+    return;
+  }
+
+  pthread_mutex_lock(&g_caps_mutex);
+  g_selected = &g_caps[slot];
+  pthread_mutex_unlock(&g_caps_mutex);
+}
+
+// ============================================================================
+// Checks
+// ============================================================================
+
+bool radio_caps_has(RadioField field, RadioCapAccess access) {
+  if (!valid_field(field) || !valid_access(access)) {
+    return false;
+  }
+
+  pthread_mutex_lock(&g_caps_mutex);
+  bool has = (g_selected->missing[access] & (1u << field)) == 0;
+  pthread_mutex_unlock(&g_caps_mutex);
+  return has;
+}
+
+void radio_caps_learn_missing(RadioField field, RadioCapAccess access) {
+  if (!valid_field(field) || !valid_access(access)) {
+    return;
+  }
+
+  pthread_mutex_lock(&g_caps_mutex);
+  uint32_t bit = 1u << field;
+  if ((g_selected->missing[access] & bit) == 0) {
+    g_selected->missing[access] |= bit;
+    printf("radio: Radio can't %s %s, skipping it from now on\n",
+           g_access_names[access],
+           g_field_names[field] ? g_field_names[field] : "field");
+
+    RadioCaps *learned =
+        g_selected->model > 0 ? learned_for(g_selected->model, true) : NULL;
+    if (learned && g_field_names[field]) {
+      learned->missing[access] |= bit;
+      save_learned();
+    }
+  }
+  pthread_mutex_unlock(&g_caps_mutex);
+}
+
+int radio_caps_field_named(const char *name) {
+  for (int f = 0; f < RADIO_FIELD_COUNT; f++) {
+    if (g_field_names[f] && strcmp(name, g_field_names[f]) == 0) {
+      return f;
+    }
+  }
+  return -1;
+}
@@ -0,0 +1,354 @@
+/**
+ * @file radio_cat.c
+ * @brief Native CAT fast path implementation
+ */
+
+#include "radio_cat.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+// ============================================================================
+// Protocol Constants
+// ============================================================================
+
+#define CIV_PREAMBLE 0xFE
+#define CIV_END 0xFD
+#define CIV_OK 0xFB
+#define CIV_NG 0xFA
+#define CIV_GET_FREQ 0x03
+#define CIV_SET_FREQ 0x05
+#define CIV_METER 0x15
+#define CIV_METER_S 0x02
+#define CIV_FREQ_BYTES_MAX 6 // 5 on HF rigs, 6 above 10 GHz
+
+#define KENWOOD_END ';'
+#define KENWOOD_FREQ_DIGITS 11
+
+// ============================================================================
+// Port I/O
+// ============================================================================
+
+static long long now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Drop anything stale, as Hamlib does before each command, then send
+static int send_request(RadioCat *cat, const void *data, size_t len) {
+  tcflush(cat->fd, TCIFLUSH); // Fails harmlessly on a pipe
+  cat->buf_len = 0;
+  const unsigned char *p = data;
+  while (len > 0) {
+    ssize_t n = write(cat->fd, p, len);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return -1;
+    }
+    p += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+// Read more into cat->buf, waiting until deadline_ms at most
+static int fill(RadioCat *cat, long long deadline_ms) {
+  if (cat->buf_len == sizeof(cat->buf)) {
+    cat->buf_len = 0; // Garbage with no frame end: start over
+  }
+  int wait_ms = (int)(deadline_ms - now_ms());
+  if (wait_ms <= 0) {
+    return -1;
+  }
+  struct pollfd pfd = {cat->fd, POLLIN, 0};
+  if (poll(&pfd, 1, wait_ms) <= 0) {
+    return -1;
+  }
+  ssize_t n = read(cat->fd, cat->buf + cat->buf_len,
+                   sizeof(cat->buf) - cat->buf_len);
+  if (n < 0 && errno == EINTR) {
+    return 0;
+  }
+  if (n <= 0) {
+    return -1;
+  }
+  cat->buf_len += (size_t)n;
+  return 0;
+}
+
+// Take the first len bytes off cat->buf into out (if not NULL)
+static void consume(RadioCat *cat, size_t len, void *out) {
+  if (out) {
+    memcpy(out, cat->buf, len);
+  }
+  memmove(cat->buf, cat->buf + len, cat->buf_len - len);
+  cat->buf_len -= len;
+}
+
+// Next message ending in end, without its end byte. Returns its length.
+static int next_message(RadioCat *cat, unsigned char end, unsigned char *out,
+                        size_t cap, long long deadline_ms) {
+  for (;;) {
+    unsigned char *stop = memchr(cat->buf, end, cat->buf_len);
+    if (stop) {
+      size_t len = (size_t)(stop - cat->buf);
+      if (len > cap) {
+        consume(cat, len + 1, NULL); // Not one of ours
+        continue;
+      }
+      consume(cat, len, out);
+      consume(cat, 1, NULL);
+      return (int)len;
+    }
+    if (fill(cat, deadline_ms) != 0) {
+      return -1;
+    }
+  }
+}
+
+// ============================================================================
+// CI-V
+// ============================================================================
+
+static size_t civ_frame(const RadioCat *cat, unsigned char *frame,
+                        const unsigned char *body, size_t len) {
+  frame[0] = CIV_PREAMBLE;
+  frame[1] = CIV_PREAMBLE;
+  frame[2] = cat->civ_addr;
+  frame[3] = RADIO_CAT_CIV_CONTROLLER;
+  memcpy(frame + 4, body, len);
+  frame[4 + len] = CIV_END;
+  return len + 5;
+}
+
+// Send a request and wait for the rig's reply to us. Our own request
+// echoed back (the rig's USB echo or a shared CI-V bus) and frames to
+// anyone else are skipped. Returns the reply's body length: its command,
+// any subcommand and data, or just CIV_OK/CIV_NG.
+static int civ_transact(RadioCat *cat, const unsigned char *request,
+                        size_t len, unsigned char *body, size_t cap) {
+  if (send_request(cat, request, len) != 0) {
+    return -1;
+  }
+  long long deadline_ms = now_ms() + RADIO_CAT_TIMEOUT_MS;
+  unsigned char frame[RADIO_CAT_BUF];
+  for (;;) {
+    int n = next_message(cat, CIV_END, frame, sizeof(frame), deadline_ms);
+    if (n < 0) {
+      return -1;
+    }
+    // Noise or a collision can leave extra preamble bytes in front
+    int start = 0;
+    while (start + 1 < n && frame[start + 1] == CIV_PREAMBLE) {
+      start++;
+    }
+    if (start == 0 || n - start < 4 || frame[start] != CIV_PREAMBLE ||
+        frame[start + 1] != RADIO_CAT_CIV_CONTROLLER ||
+        frame[start + 2] != cat->civ_addr) {
+      continue;
+    }
+    int body_len = n - start - 3;
+    if ((size_t)body_len > cap) {
+      continue;
+    }
+    memcpy(body, frame + start + 3, (size_t)body_len);
+    return body_len;
+  }
+}
+
+static bool civ_bcd_digits(unsigned char byte) {
+  return (byte & 0x0F) <= 9 && (byte >> 4) <= 9;
+}
+
+static int civ_get_freq(RadioCat *cat, double *freq_hz) {
+  unsigned char body[1 + CIV_FREQ_BYTES_MAX];
+  int n = civ_transact(cat, cat->get_freq, cat->get_freq_len, body,
+                       sizeof(body));
+  if (n < 0) {
+    return -1;
+  }
+  if (body[0] != CIV_GET_FREQ || n < 5) {
+    return RADIO_CAT_FALLBACK; // Not the reply we know
+  }
+  // Little-endian BCD, two digits a byte, lowest first
+  long long hz = 0;
+  for (int i = n - 1; i >= 1; i--) {
+    if (!civ_bcd_digits(body[i])) {
+      return RADIO_CAT_FALLBACK;
+    }
+    hz = hz * 100 + (body[i] >> 4) * 10 + (body[i] & 0x0F);
+  }
+  cat->freq_bytes = n - 1;
+  *freq_hz = (double)hz;
+  return 0;
+}
+
+static int civ_set_freq(RadioCat *cat, double freq_hz) {
+  if (cat->freq_bytes == 0) {
+    return RADIO_CAT_FALLBACK; // Length unknown until a read
+  }
+  unsigned char body[1 + CIV_FREQ_BYTES_MAX];
+  body[0] = CIV_SET_FREQ;
+  long long hz = (long long)(freq_hz + 0.5);
+  for (int i = 1; i <= cat->freq_bytes; i++) {
+    body[i] = (unsigned char)(((hz / 10 % 10) << 4) | (hz % 10));
+    hz /= 100;
+  }
+  if (hz != 0) {
+    return -1; // Out of the rig's range
+  }
+  unsigned char request[RADIO_CAT_BUF];
+  size_t len = civ_frame(cat, request, body, 1 + (size_t)cat->freq_bytes);
+  unsigned char reply[RADIO_CAT_BUF];
+  int n = civ_transact(cat, request, len, reply, sizeof(reply));
+  return n == 1 && reply[0] == CIV_OK ? 0 : -1;
+}
+
+static int civ_get_smeter_raw(RadioCat *cat, int *raw) {
+  unsigned char body[8];
+  int n = civ_transact(cat, cat->get_smeter, cat->get_smeter_len, body,
+                       sizeof(body));
+  if (n < 0) {
+    return -1;
+  }
+  if (n != 4 || body[0] != CIV_METER || body[1] != CIV_METER_S ||
+      !civ_bcd_digits(body[2]) || !civ_bcd_digits(body[3])) {
+    return RADIO_CAT_FALLBACK;
+  }
+  // Big-endian BCD, 0000 to 0255
+  *raw = (body[2] >> 4) * 1000 + (body[2] & 0x0F) * 100 +
+         (body[3] >> 4) * 10 + (body[3] & 0x0F);
+  return 0;
+}
+
+// ============================================================================
+// Kenwood
+// ============================================================================
+
+// Send a query and wait for the answer starting with its two letters,
+// skipping anything else the rig volunteers
+static int kenwood_query(RadioCat *cat, const char *query, char *answer,
+                         size_t cap) {
+  if (send_request(cat, query, strlen(query)) != 0) {
+    return -1;
+  }
+  long long deadline_ms = now_ms() + RADIO_CAT_TIMEOUT_MS;
+  for (;;) {
+    int n = next_message(cat, KENWOOD_END, (unsigned char *)answer, cap - 1,
+                         deadline_ms);
+    if (n < 0) {
+      return -1;
+    }
+    answer[n] = '\0';
+    if (answer[0] == '?') {
+      return RADIO_CAT_FALLBACK; // Busy or not understood
+    }
+    if (n >= 2 && strncmp(answer, query, 2) == 0) {
+      return n;
+    }
+  }
+}
+
+static int kenwood_get_freq(RadioCat *cat, double *freq_hz) {
+  // IF starts with the current VFO's frequency on every Kenwood
+  char answer[RADIO_CAT_BUF];
+  int n = kenwood_query(cat, (const char *)cat->get_freq, answer,
+                        sizeof(answer));
+  if (n < 0 || n == RADIO_CAT_FALLBACK) {
+    return n;
+  }
+  if (n < 2 + KENWOOD_FREQ_DIGITS) {
+    return RADIO_CAT_FALLBACK;
+  }
+  long long hz = 0;
+  for (int i = 2; i < 2 + KENWOOD_FREQ_DIGITS; i++) {
+    if (answer[i] < '0' || answer[i] > '9') {
+      return RADIO_CAT_FALLBACK;
+    }
+    hz = hz * 10 + (answer[i] - '0');
+  }
+  *freq_hz = (double)hz;
+  return 0;
+}
+
+static int kenwood_set_freq(RadioCat *cat, double freq_hz, bool vfo_b) {
+  // Kenwood sets don't answer; the poll's next read shows what took
+  char command[24];
+  int len = snprintf(command, sizeof(command), "%s%011lld;",
+                     vfo_b ? "FB" : "FA", (long long)(freq_hz + 0.5));
+  if (len != 2 + KENWOOD_FREQ_DIGITS + 1) {
+    return -1;
+  }
+  return send_request(cat, command, (size_t)len);
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+RadioCatProtocol radio_cat_protocol_for(const char *mfg_name) {
+  if (mfg_name && strcasecmp(mfg_name, "Icom") == 0) {
+    return RADIO_CAT_CIV;
+  }
+  if (mfg_name && strcasecmp(mfg_name, "Kenwood") == 0) {
+    return RADIO_CAT_KENWOOD;
+  }
+  return RADIO_CAT_NONE;
+}
+
+void radio_cat_init(RadioCat *cat, RadioCatProtocol protocol, int fd,
+                    unsigned char civ_addr) {
+  memset(cat, 0, sizeof(*cat));
+  cat->protocol = fd >= 0 ? protocol : RADIO_CAT_NONE;
+  cat->fd = fd;
+  cat->civ_addr = civ_addr;
+
+  if (cat->protocol == RADIO_CAT_CIV) {
+    static const unsigned char freq[] = {CIV_GET_FREQ};
+    static const unsigned char smeter[] = {CIV_METER, CIV_METER_S};
+    cat->get_freq_len = civ_frame(cat, cat->get_freq, freq, sizeof(freq));
+    cat->get_smeter_len =
+        civ_frame(cat, cat->get_smeter, smeter, sizeof(smeter));
+  } else if (cat->protocol == RADIO_CAT_KENWOOD) {
+    memcpy(cat->get_freq, "IF;", 4);
+    cat->get_freq_len = 3;
+  }
+}
+
+int radio_cat_get_freq(RadioCat *cat, double *freq_hz) {
+  switch (cat->protocol) {
+  case RADIO_CAT_CIV:
+    return civ_get_freq(cat, freq_hz);
+  case RADIO_CAT_KENWOOD:
+    return kenwood_get_freq(cat, freq_hz);
+  default:
+    return RADIO_CAT_FALLBACK;
+  }
+}
+
+int radio_cat_set_freq(RadioCat *cat, double freq_hz, bool vfo_b) {
+  switch (cat->protocol) {
+  case RADIO_CAT_CIV:
+    return civ_set_freq(cat, freq_hz);
+  case RADIO_CAT_KENWOOD:
+    return kenwood_set_freq(cat, freq_hz, vfo_b);
+  default:
+    return RADIO_CAT_FALLBACK;
+  }
+}
+
+int radio_cat_get_smeter_raw(RadioCat *cat, int *raw) {
+  if (cat->protocol != RADIO_CAT_CIV) {
+    return RADIO_CAT_FALLBACK; // Kenwood's SM differs by model
+  }
+  return civ_get_smeter_raw(cat, raw);
+}
@@ -0,0 +1,205 @@
+/**
+ * @file radio_defs.c
+ * @brief Per-model radio definitions implementation
+ */
+
+#include "radio_defs.h"
+#include "hampod_core.h"
+#include "radio_caps.h"
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "radio_defs_builtin.h"
+
+// ============================================================================
+// State
+// ============================================================================
+
+// Built-in definitions, then those added by the file. Written only by
+// radio_defs_init(), before any radio connects.
+static RadioDef g_defs[RADIO_DEFS_MAX];
+static int g_def_count = 0;
+
+// ============================================================================
+// Internal Functions
+// ============================================================================
+
+static char *trim(char *text) {
+  while (isspace((unsigned char)*text)) {
+    text++;
+  }
+  char *end = text + strlen(text);
+  while (end > text && isspace((unsigned char)end[-1])) {
+    *--end = '\0';
+  }
+  return text;
+}
+
+static void load_builtin(void) {
+  g_def_count = 0;
+  for (int i = 0; g_builtin_defs[i].model != 0 && g_def_count < RADIO_DEFS_MAX;
+       i++) {
+    g_defs[g_def_count++] = g_builtin_defs[i];
+  }
+}
+
+// A model's entry, emptied, replacing the built-in one; NULL if full
+static RadioDef *entry_for(int model) {
+  RadioDef *def = NULL;
+  for (int i = 0; i < g_def_count && def == NULL; i++) {
+    if (g_defs[i].model == model) {
+      def = &g_defs[i];
+    }
+  }
+  if (def == NULL) {
+    if (g_def_count == RADIO_DEFS_MAX) {
+      return NULL;
+    }
+    def = &g_defs[g_def_count++];
+  }
+  memset(def, 0, sizeof(*def));
+  def->model = model;
+  return def;
+}
+
+// Fields named in value, a bit each; -1 if one is unknown
+static long long parse_mask(char *value) {
+  uint32_t mask = 0;
+  for (char *name = strtok(value, " \t,"); name != NULL;
+       name = strtok(NULL, " \t,")) {
+    int field = radio_caps_field_named(name);
+    if (field < 0) {
+      return -1;
+    }
+    mask |= 1u << field;
+  }
+  return mask;
+}
+
+static bool parse_flag(const char *value, RadioDefFlag *flag) {
+  if (strcmp(value, "yes") == 0) {
+    *flag = RADIO_DEF_YES;
+  } else if (strcmp(value, "no") == 0) {
+    *flag = RADIO_DEF_NO;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Apply one key = value line to def; false if it is not valid
+static bool parse_setting(RadioDef *def, const char *key, char *value) {
+  long long mask;
+  if (strcmp(key, "name") == 0) {
+    snprintf(def->name, sizeof(def->name), "%s", value);
+  } else if (strcmp(key, "vfo_a") == 0) {
+    snprintf(def->vfo_a, sizeof(def->vfo_a), "%s", value);
+  } else if (strcmp(key, "vfo_b") == 0) {
+    snprintf(def->vfo_b, sizeof(def->vfo_b), "%s", value);
+  } else if (strcmp(key, "vfo_current") == 0) {
+    snprintf(def->vfo_current, sizeof(def->vfo_current), "%s", value);
+  } else if (strcmp(key, "no_get") == 0 || strcmp(key, "no_set") == 0) {
+    if ((mask = parse_mask(value)) < 0) {
+      return false;
+    }
+    if (strcmp(key, "no_get") == 0) {
+      def->no_get = (uint32_t)mask;
+    } else {
+      def->no_set = (uint32_t)mask;
+    }
+  } else if (strcmp(key, "transceive") == 0) {
+    return parse_flag(value, &def->transceive);
+  } else if (strcmp(key, "vfo_query") == 0) {
+    return parse_flag(value, &def->vfo_query);
+  } else if (strcmp(key, "poll_fast_ms") == 0) {
+    def->poll_fast_ms = atoi(value);
+  } else if (strcmp(key, "poll_idle_ms") == 0) {
+    def->poll_idle_ms = atoi(value);
+  } else if (strcmp(key, "health_probe") == 0) {
+    if (strcmp(value, "smeter") == 0) {
+      def->health_probe = RADIO_PROBE_SMETER;
+    } else if (strcmp(value, "freq") == 0) {
+      def->health_probe = RADIO_PROBE_FREQ;
+    } else {
+      return false;
+    }
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+int radio_defs_init(const char *path) {
+  load_builtin();
+  if (path == NULL) {
+    path = RADIO_DEFS_DEFAULT_PATH;
+  }
+  FILE *in = fopen(path, "r");
+  if (in == NULL) {
+    return 0; // Built-in definitions only
+  }
+
+  int loaded = 0;
+  int line_number = 0;
+  RadioDef *def = NULL;
+  char line[256];
+  while (fgets(line, sizeof(line), in)) {
+    line_number++;
+    char *comment = strchr(line, '#');
+    if (comment) {
+      *comment = '\0';
+    }
+    char *text = trim(line);
+    int model;
+    if (text[0] == '\0') {
+      continue;
+    }
+    if (sscanf(text, "[model %d]", &model) == 1) {
+      def = model > 0 ? entry_for(model) : NULL;
+      loaded += def != NULL;
+      if (def == NULL) {
+        LOG_ERROR("radio_defs: %s:%d: model %d skipped", path, line_number,
+                  model);
+      }
+      continue;
+    }
+
+    char *eq = strchr(text, '=');
+    if (def == NULL || eq == NULL) {
+      continue; // Outside a usable section, or not a setting
+    }
+    *eq = '\0';
+    if (!parse_setting(def, trim(text), trim(eq + 1))) {
+      LOG_ERROR("radio_defs: %s:%d: not a valid setting", path,
+                line_number);
+    }
+  }
+  fclose(in);
+
+  DEBUG_PRINT("radio_defs_init: %d radio definitions, %d from %s\n",
+              g_def_count, loaded, path);
+  return loaded;
+}
+
+const RadioDef *radio_defs_find(int model) {
+  if (model <= 0) {
+    return NULL;
+  }
+  if (g_def_count == 0) {
+    load_builtin(); // radio_defs_init() not called
+  }
+  for (int i = 0; i < g_def_count; i++) {
+    if (g_defs[i].model == model) {
+      return &g_defs[i];
+    }
+  }
+  return NULL;
+}
@@ -0,0 +1,16 @@
+// Built-in radio definitions (radio_defs.h), from config/radios.conf.
+// Generated by gen_radio_defs.sh - do not edit.
+
+static const RadioDef g_builtin_defs[] = {
+    {.model = 3073,
+     .name = "IC-7300",
+     .transceive = RADIO_DEF_YES,
+     .vfo_query = RADIO_DEF_NO,
+     .vfo_current = "Current VFO"},
+    {.model = 2004,
+     .name = "TS-570",
+     .health_probe = RADIO_PROBE_SMETER},
+    {.model = 2014,
+     .name = "TS-2000"},
+    {.model = 0}, // End
+};
@@ -7,7 +7,12 @@
 
 #include "radio_queries.h"
 #include "hampod_core.h"
+#include "meter.h"
 #include "radio.h"
+#include "radio_caps.h"
+#include "radio_defs.h"
+#include "radio_state.h"
+#include "radio_trace.h"
 
 #include <hamlib/rig.h>
 #include <pthread.h>
@@ -18,10 +23,23 @@
 // External Access to Radio Handle
 // ============================================================================
 
-// Defined in radio.c - we need access for extended queries
-extern RIG *g_rig;
-extern bool g_connected;
-extern pthread_mutex_t g_rig_mutex;
+// Defined in radio.c - we need access for extended queries. radio_lock()
+// returns the active radio's rig with its lock held, or NULL (not held)
+// if it isn't connected; radio_unlock() releases it.
+// radio_locked_get_strength() reads the held radio's S-meter, in dB over
+// S9, natively if it can (radio_cat.h), and returns a Hamlib code.
+// radio_active_def() is the active radio's definition, or NULL.
+RIG *radio_lock(void);
+void radio_unlock(void);
+int radio_locked_get_strength(int *db);
+const RadioDef *radio_active_def(void);
+
+// A read the radio has no answer for at all is never asked again
+static void note_refusal(RadioField field, int retcode) {
+  if (retcode == -RIG_ENAVAIL || retcode == -RIG_ENIMPL) {
+    radio_caps_learn_missing(field, RADIO_CAP_GET);
+  }
+}
 
 // ============================================================================
 // Mode Operations
@@ -81,43 +99,58 @@ static const char *mode_to_string(rmode_t mode) {
   }
 }
 
-const char *radio_get_mode_string(void) {
-  pthread_mutex_lock(&g_rig_mutex);
+/**
+ * @brief Current mode, cached or from the radio
+ *
+ * @return 1 on success, 0 if not connected, -1 on error
+ */
+static int read_mode(rmode_t *mode) {
+  double cached;
+  if (radio_state_get(RADIO_FIELD_MODE, &cached)) {
+    *mode = (rmode_t)cached;
+    return 1;
+  }
 
-  if (!g_connected || !g_rig) {
-    pthread_mutex_unlock(&g_rig_mutex);
-    return "Not connected";
+  RIG *rig = radio_lock();
+
+  if (!rig) {
+    return 0;
   }
 
-  rmode_t mode;
   pbwidth_t width;
-  int retcode = rig_get_mode(g_rig, RIG_VFO_CURR, &mode, &width);
+  int retcode = RADIO_TRACED(RADIO_OP_GET_MODE,
+                             rig_get_mode(rig, RIG_VFO_CURR, mode, &width));
 
-  pthread_mutex_unlock(&g_rig_mutex);
+  radio_unlock();
 
   if (retcode != RIG_OK) {
-    DEBUG_PRINT("radio_get_mode_string: %s\n", rigerror(retcode));
-    return "Error";
+    DEBUG_PRINT("radio_get_mode: %s\n", rigerror(retcode));
+    return -1;
   }
 
-  return mode_to_string(mode);
+  radio_state_store(RADIO_FIELD_MODE, (double)*mode);
+  radio_state_store(RADIO_FIELD_PASSBAND, (double)width);
+  return 1;
 }
 
-int radio_get_mode_raw(void) {
-  pthread_mutex_lock(&g_rig_mutex);
-
-  if (!g_connected || !g_rig) {
-    pthread_mutex_unlock(&g_rig_mutex);
-    return 0;
+const char *radio_get_mode_string(void) {
+  rmode_t mode;
+  int result = read_mode(&mode);
+  if (result == 0) {
+    return "Not connected";
+  }
+  if (result < 0) {
+    return "Error";
   }
 
-  rmode_t mode;
-  pbwidth_t width;
-  int retcode = rig_get_mode(g_rig, RIG_VFO_CURR, &mode, &width);
+  return mode_to_string(mode);
+}
 
-  pthread_mutex_unlock(&g_rig_mutex);
+const char *radio_mode_name(int mode) { return mode_to_string((rmode_t)mode); }
 
-  if (retcode != RIG_OK) {
+int radio_get_mode_raw(void) {
+  rmode_t mode;
+  if (read_mode(&mode) != 1) {
     return 0;
   }
 
@@ -129,37 +162,48 @@ int radio_get_mode_raw(void) {
 // ============================================================================
 
 RadioVfo radio_get_vfo(void) {
-  pthread_mutex_lock(&g_rig_mutex);
+  double cached;
+  if (radio_state_get(RADIO_FIELD_VFO, &cached)) {
+    return (RadioVfo)(int)cached;
+  }
+
+  // A radio that can't say (most Icoms) isn't asked
+  const RadioDef *def = radio_active_def();
+  if (def && def->vfo_query == RADIO_DEF_NO) {
+    return RADIO_VFO_CURRENT;
+  }
+
+  RIG *rig = radio_lock();
 
-  if (!g_connected || !g_rig) {
-    pthread_mutex_unlock(&g_rig_mutex);
+  if (!rig) {
     return RADIO_VFO_CURRENT;
   }
 
   vfo_t vfo;
-  int retcode = rig_get_vfo(g_rig, &vfo);
+  int retcode = RADIO_TRACED(RADIO_OP_GET_VFO, rig_get_vfo(rig, &vfo));
 
-  pthread_mutex_unlock(&g_rig_mutex);
+  radio_unlock();
 
   if (retcode != RIG_OK) {
     DEBUG_PRINT("radio_get_vfo: %s\n", rigerror(retcode));
     return RADIO_VFO_CURRENT;
   }
 
+  RadioVfo result = RADIO_VFO_CURRENT;
   if (vfo == RIG_VFO_A || vfo == RIG_VFO_MAIN) {
-    return RADIO_VFO_A;
+    result = RADIO_VFO_A;
   } else if (vfo == RIG_VFO_B || vfo == RIG_VFO_SUB) {
-    return RADIO_VFO_B;
+    result = RADIO_VFO_B;
   }
 
-  return RADIO_VFO_CURRENT;
+  radio_state_store(RADIO_FIELD_VFO, result);
+  return result;
 }
 
 int radio_set_vfo(RadioVfo vfo) {
-  pthread_mutex_lock(&g_rig_mutex);
+  RIG *rig = radio_lock();
 
-  if (!g_connected || !g_rig) {
-    pthread_mutex_unlock(&g_rig_mutex);
+  if (!rig) {
     return -1;
   }
 
@@ -179,9 +223,11 @@ int radio_set_vfo(RadioVfo vfo) {
     break;
   }
 
-  int retcode = rig_set_vfo(g_rig, hamlib_vfo);
+  int retcode = RADIO_TRACED(RADIO_OP_SET_VFO, rig_set_vfo(rig, hamlib_vfo));
 
-  pthread_mutex_unlock(&g_rig_mutex);
+  // Frequency, mode and levels may all differ on the other VFO
+  radio_state_clear();
+  radio_unlock();
 
   if (retcode != RIG_OK) {
     DEBUG_PRINT("radio_set_vfo: %s\n", rigerror(retcode));
@@ -194,13 +240,14 @@ int radio_set_vfo(RadioVfo vfo) {
 
 const char *radio_get_vfo_string(void) {
   RadioVfo vfo = radio_get_vfo();
+  const RadioDef *def = radio_active_def();
   switch (vfo) {
   case RADIO_VFO_A:
-    return "VFO A.";
+    return def && def->vfo_a[0] ? def->vfo_a : "VFO A.";
   case RADIO_VFO_B:
-    return "VFO B.";
+    return def && def->vfo_b[0] ? def->vfo_b : "VFO B.";
   case RADIO_VFO_CURRENT:
-    return "Current VFO";
+    return def && def->vfo_current[0] ? def->vfo_current : "Current VFO";
   default:
     return "VFO";
   }
@@ -211,25 +258,36 @@ const char *radio_get_vfo_string(void) {
 // ============================================================================
 
 double radio_get_smeter(void) {
-  pthread_mutex_lock(&g_rig_mutex);
+  double cached;
+  if (meter_reading(RADIO_METER_SMETER, &cached) ||
+      radio_state_get(RADIO_FIELD_SMETER, &cached)) {
+    return cached;
+  }
 
-  if (!g_connected || !g_rig) {
-    pthread_mutex_unlock(&g_rig_mutex);
+  if (!radio_caps_has(RADIO_FIELD_SMETER, RADIO_CAP_GET)) {
     return -999.0;
   }
 
-  value_t val;
-  int retcode = rig_get_level(g_rig, RIG_VFO_CURR, RIG_LEVEL_STRENGTH, &val);
+  RIG *rig = radio_lock();
+
+  if (!rig) {
+    return -999.0;
+  }
+
+  int db;
+  int retcode = radio_locked_get_strength(&db);
 
-  pthread_mutex_unlock(&g_rig_mutex);
+  radio_unlock();
 
   if (retcode != RIG_OK) {
     DEBUG_PRINT("radio_get_smeter: %s\n", rigerror(retcode));
+    note_refusal(RADIO_FIELD_SMETER, retcode);
     return -999.0;
   }
 
-  // val.i is signal strength in dB (S9 = 0dB reference in most radios)
-  return (double)val.i;
+  // Signal strength in dB (S9 = 0dB reference in most radios)
+  radio_state_store(RADIO_FIELD_SMETER, (double)db);
+  return (double)db;
 }
 
 const char *radio_get_smeter_string(char *buffer, int buf_size) {
@@ -260,25 +318,38 @@ const char *radio_get_smeter_string(char *buffer, int buf_size) {
 }
 
 double radio_get_power_meter(void) {
-  pthread_mutex_lock(&g_rig_mutex);
+  double cached;
+  if (meter_reading(RADIO_METER_POWER, &cached) ||
+      radio_state_get(RADIO_FIELD_POWER_METER, &cached)) {
+    return cached;
+  }
+
+  if (!radio_caps_has(RADIO_FIELD_POWER_METER, RADIO_CAP_GET)) {
+    return -1.0;
+  }
+
+  RIG *rig = radio_lock();
 
-  if (!g_connected || !g_rig) {
-    pthread_mutex_unlock(&g_rig_mutex);
+  if (!rig) {
     return -1.0;
   }
 
   value_t val;
   int retcode =
-      rig_get_level(g_rig, RIG_VFO_CURR, RIG_LEVEL_RFPOWER_METER, &val);
+      RADIO_TRACED(RADIO_OP_GET_LEVEL,
+                   rig_get_level(rig, RIG_VFO_CURR, RIG_LEVEL_RFPOWER_METER,
+                                 &val));
 
-  pthread_mutex_unlock(&g_rig_mutex);
+  radio_unlock();
 
   if (retcode != RIG_OK) {
     DEBUG_PRINT("radio_get_power_meter: %s\n", rigerror(retcode));
+    note_refusal(RADIO_FIELD_POWER_METER, retcode);
     return -1.0;
   }
 
   // val.f is 0.0-1.0 normalized
+  radio_state_store(RADIO_FIELD_POWER_METER, val.f);
   return val.f;
 }
 
@@ -296,6 +367,61 @@ const char *radio_get_power_string(char *buffer, int buf_size) {
   return buffer;
 }
 
+int radio_read_meter(RadioMeter meter, double *value) {
+  setting_t level;
+  RadioField field;
+  switch (meter) {
+  case RADIO_METER_SMETER:
+    level = RIG_LEVEL_STRENGTH;
+    field = RADIO_FIELD_SMETER;
+    break;
+  case RADIO_METER_SWR:
+    level = RIG_LEVEL_SWR;
+    field = RADIO_FIELD_SWR;
+    break;
+  case RADIO_METER_POWER:
+    level = RIG_LEVEL_RFPOWER_METER;
+    field = RADIO_FIELD_POWER_METER;
+    break;
+  case RADIO_METER_ALC:
+    level = RIG_LEVEL_ALC;
+    field = RADIO_FIELD_ALC;
+    break;
+  default:
+    return -1;
+  }
+
+  if (!radio_caps_has(field, RADIO_CAP_GET)) {
+    return -1;
+  }
+
+  RIG *rig = radio_lock();
+
+  if (!rig) {
+    return -1;
+  }
+
+  value_t val;
+  int retcode = meter == RADIO_METER_SMETER
+                    ? radio_locked_get_strength(&val.i)
+                    : RADIO_TRACED(RADIO_OP_GET_LEVEL,
+                                   rig_get_level(rig, RIG_VFO_CURR, level,
+                                                 &val));
+
+  radio_unlock();
+
+  if (retcode != RIG_OK) {
+    DEBUG_PRINT("radio_read_meter: %s\n", rigerror(retcode));
+    note_refusal(field, retcode);
+    return -1;
+  }
+
+  // STRENGTH is an integer level, the others are floats
+  *value = meter == RADIO_METER_SMETER ? (double)val.i : val.f;
+  radio_state_store(field, *value);
+  return 0;
+}
+
 // ============================================================================
 // VOX Operations
 // ============================================================================
@@ -306,22 +432,115 @@ const char *radio_get_power_string(char *buffer, int buf_size) {
  * @return 1 if VOX is on, 0 if off, -1 on error
  */
 int radio_get_vox_status(void) {
-  pthread_mutex_lock(&g_rig_mutex);
+  double cached;
+  if (radio_state_get(RADIO_FIELD_VOX, &cached)) {
+    return (int)cached;
+  }
 
-  if (!g_connected || !g_rig) {
-    pthread_mutex_unlock(&g_rig_mutex);
+  if (!radio_caps_has(RADIO_FIELD_VOX, RADIO_CAP_GET)) {
+    return -1;
+  }
+
+  RIG *rig = radio_lock();
+
+  if (!rig) {
     return -1;
   }
 
   int status = 0;
-  int retcode = rig_get_func(g_rig, RIG_VFO_CURR, RIG_FUNC_VOX, &status);
+  int retcode = RADIO_TRACED(RADIO_OP_GET_FUNC,
+                             rig_get_func(rig, RIG_VFO_CURR, RIG_FUNC_VOX,
+                                          &status));
 
-  pthread_mutex_unlock(&g_rig_mutex);
+  radio_unlock();
 
   if (retcode != RIG_OK) {
     DEBUG_PRINT("radio_get_vox_status: %s\n", rigerror(retcode));
+    note_refusal(RADIO_FIELD_VOX, retcode);
     return -1;
   }
 
+  radio_state_store(RADIO_FIELD_VOX, status ? 1 : 0);
   return status ? 1 : 0;
 }
+
+// ============================================================================
+// Memory Channels
+// ============================================================================
+
+int radio_memory_range(int *first, int *last) {
+  RIG *rig = radio_lock();
+
+  if (!rig) {
+    return -1;
+  }
+
+  int low = -1;
+  int high = -1;
+  if (rig->caps->get_channel != NULL) {
+    for (int i = 0; i < HAMLIB_CHANLSTSIZ; i++) {
+      const chan_t *list = &rig->caps->chan_list[i];
+      if (RIG_IS_CHAN_END(*list)) {
+        break;
+      }
+      if (list->type != RIG_MTYPE_MEM) {
+        continue; // Call channels, band edges, satellite memories...
+      }
+      if (low < 0 || list->startc < low) {
+        low = list->startc;
+      }
+      if (list->endc > high) {
+        high = list->endc;
+      }
+    }
+  }
+
+  radio_unlock();
+
+  if (low < 0 || high < low) {
+    return -1;
+  }
+  *first = low;
+  *last = high;
+  return 0;
+}
+
+int radio_read_memories(int first, int count, RadioMemory *memories) {
+  RIG *rig = radio_lock();
+
+  if (!rig) {
+    return -1;
+  }
+
+  int read = 0;
+  for (int i = 0; i < count; i++) {
+    channel_t chan;
+    memset(&chan, 0, sizeof(chan));
+    chan.vfo = RIG_VFO_MEM;
+    chan.channel_num = first + i;
+    int retcode = RADIO_TRACED(RADIO_OP_GET_CHANNEL,
+                               rig_get_channel(rig, RIG_VFO_MEM, &chan, 1));
+
+    RadioMemory *memory = &memories[i];
+    memset(memory, 0, sizeof(*memory));
+    memory->channel = first + i;
+    if (retcode == RIG_OK) {
+      memory->freq_hz = chan.freq;
+      memory->mode = (int)chan.mode;
+      memory->passband_hz = chan.width > 0 ? (int)chan.width : 0;
+      // Rigs allow longer names than are spoken; keep the start
+      snprintf(memory->name, sizeof(memory->name), "%.*s",
+               (int)sizeof(memory->name) - 1, chan.channel_desc);
+    } else if (retcode == -RIG_ETIMEOUT) {
+      // The rig stopped answering: don't wait out a timeout per channel
+      DEBUG_PRINT("radio_read_memories (%d): %s\n", first + i,
+                  rigerror(retcode));
+      break;
+    }
+    // Any other error is an empty or unreadable channel
+    read++;
+  }
+
+  radio_unlock();
+  return read;
+}
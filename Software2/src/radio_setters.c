@@ -9,19 +9,40 @@
 
 #include "radio_setters.h"
 #include "hampod_core.h"
+#include "radio_caps.h"
+#include "radio_state.h"
+#include "radio_trace.h"
 
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 #include <pthread.h>
 #include <hamlib/rig.h>
 
 // ============================================================================
-// External Hamlib State (from radio.c)
+// Active Radio (from radio.c)
 // ============================================================================
 
-extern RIG* g_rig;
-extern bool g_connected;
-extern pthread_mutex_t g_rig_mutex;
+// The active radio's rig, locked, or NULL (not locked) if not connected
+RIG* radio_lock(void);
+void radio_unlock(void);
+
+// Getters answer from radio_state while it is fresh. Setters drop the
+// fields they touch before talking to the radio, so the next read shows
+// what the radio actually took (it may clamp or round).
+//
+// Both check radio_caps first: what the radio can't do is refused without
+// a serial round trip.
+
+// A call the capability profile allowed failed. If the rig said it can't
+// do that at all, remember it and return RADIO_ERR_UNAVAILABLE, else -1.
+static int refused(RadioField field, RadioCapAccess access, int retcode) {
+    if (retcode == -RIG_ENAVAIL || retcode == -RIG_ENIMPL) {
+        radio_caps_learn_missing(field, access);
+        return RADIO_ERR_UNAVAILABLE;
+    }
+    return -1;
+}
 
 // ============================================================================
 // Mode List for Cycling
@@ -42,13 +63,18 @@ static const int mode_count = sizeof(mode_list) / sizeof(mode_list[0]);
 // ============================================================================
 
 int radio_set_power(int level) {
-    pthread_mutex_lock(&g_rig_mutex);
+    if (!radio_caps_has(RADIO_FIELD_POWER, RADIO_CAP_SET)) {
+        return RADIO_ERR_UNAVAILABLE;
+    }
+
+    RIG *rig = radio_lock();
     
-    if (!g_connected || !g_rig) {
-        pthread_mutex_unlock(&g_rig_mutex);
+    if (!rig) {
         return -1;
     }
     
+    radio_state_invalidate(RADIO_FIELD_POWER);
+    
     // Clamp level to 0-100
     if (level < 0) level = 0;
     if (level > 100) level = 100;
@@ -57,13 +83,15 @@ int radio_set_power(int level) {
     value_t val;
     val.f = level / 100.0f;
     
-    int retcode = rig_set_level(g_rig, RIG_VFO_CURR, RIG_LEVEL_RFPOWER, val);
+    int retcode = RADIO_TRACED(RADIO_OP_SET_LEVEL,
+                               rig_set_level(rig, RIG_VFO_CURR,
+                                             RIG_LEVEL_RFPOWER, val));
     
-    pthread_mutex_unlock(&g_rig_mutex);
+    radio_unlock();
     
     if (retcode != RIG_OK) {
         DEBUG_PRINT("radio_set_power: %s\n", rigerror(retcode));
-        return -1;
+        return refused(RADIO_FIELD_POWER, RADIO_CAP_SET, retcode);
     }
     
     DEBUG_PRINT("radio_set_power: Set to %d%%\n", level);
@@ -71,47 +99,67 @@ int radio_set_power(int level) {
 }
 
 int radio_get_power(void) {
-    pthread_mutex_lock(&g_rig_mutex);
+    double cached;
+    if (radio_state_get(RADIO_FIELD_POWER, &cached)) {
+        return (int)cached;
+    }
+
+    if (!radio_caps_has(RADIO_FIELD_POWER, RADIO_CAP_GET)) {
+        return -1;
+    }
+
+    RIG *rig = radio_lock();
     
-    if (!g_connected || !g_rig) {
-        pthread_mutex_unlock(&g_rig_mutex);
+    if (!rig) {
         return -1;
     }
     
     value_t val;
-    int retcode = rig_get_level(g_rig, RIG_VFO_CURR, RIG_LEVEL_RFPOWER, &val);
+    int retcode = RADIO_TRACED(RADIO_OP_GET_LEVEL,
+                               rig_get_level(rig, RIG_VFO_CURR,
+                                             RIG_LEVEL_RFPOWER, &val));
     
-    pthread_mutex_unlock(&g_rig_mutex);
+    radio_unlock();
     
     if (retcode != RIG_OK) {
         DEBUG_PRINT("radio_get_power: %s\n", rigerror(retcode));
+        refused(RADIO_FIELD_POWER, RADIO_CAP_GET, retcode);
         return -1;
     }
     
-    return (int)(val.f * 100.0f + 0.5f);
+    int level = (int)(val.f * 100.0f + 0.5f);
+    radio_state_store(RADIO_FIELD_POWER, level);
+    return level;
 }
 
 int radio_set_mic_gain(int level) {
-    pthread_mutex_lock(&g_rig_mutex);
+    if (!radio_caps_has(RADIO_FIELD_MIC_GAIN, RADIO_CAP_SET)) {
+        return RADIO_ERR_UNAVAILABLE;
+    }
+
+    RIG *rig = radio_lock();
     
-    if (!g_connected || !g_rig) {
-        pthread_mutex_unlock(&g_rig_mutex);
+    if (!rig) {
         return -1;
     }
     
+    radio_state_invalidate(RADIO_FIELD_MIC_GAIN);
+    
     if (level < 0) level = 0;
     if (level > 100) level = 100;
     
     value_t val;
     val.f = level / 100.0f;
     
-    int retcode = rig_set_level(g_rig, RIG_VFO_CURR, RIG_LEVEL_MICGAIN, val);
+    int retcode = RADIO_TRACED(RADIO_OP_SET_LEVEL,
+                               rig_set_level(rig, RIG_VFO_CURR,
+                                             RIG_LEVEL_MICGAIN, val));
     
-    pthread_mutex_unlock(&g_rig_mutex);
+    radio_unlock();
     
     if (retcode != RIG_OK) {
         DEBUG_PRINT("radio_set_mic_gain: %s\n", rigerror(retcode));
-        return -1;
+        return refused(RADIO_FIELD_MIC_GAIN, RADIO_CAP_SET, retcode);
     }
     
     DEBUG_PRINT("radio_set_mic_gain: Set to %d%%\n", level);
@@ -119,34 +167,52 @@ int radio_set_mic_gain(int level) {
 }
 
 int radio_get_mic_gain(void) {
-    pthread_mutex_lock(&g_rig_mutex);
+    double cached;
+    if (radio_state_get(RADIO_FIELD_MIC_GAIN, &cached)) {
+        return (int)cached;
+    }
+
+    if (!radio_caps_has(RADIO_FIELD_MIC_GAIN, RADIO_CAP_GET)) {
+        return -1;
+    }
+
+    RIG *rig = radio_lock();
     
-    if (!g_connected || !g_rig) {
-        pthread_mutex_unlock(&g_rig_mutex);
+    if (!rig) {
         return -1;
     }
     
     value_t val;
-    int retcode = rig_get_level(g_rig, RIG_VFO_CURR, RIG_LEVEL_MICGAIN, &val);
+    int retcode = RADIO_TRACED(RADIO_OP_GET_LEVEL,
+                               rig_get_level(rig, RIG_VFO_CURR,
+                                             RIG_LEVEL_MICGAIN, &val));
     
-    pthread_mutex_unlock(&g_rig_mutex);
+    radio_unlock();
     
     if (retcode != RIG_OK) {
         DEBUG_PRINT("radio_get_mic_gain: %s\n", rigerror(retcode));
+        refused(RADIO_FIELD_MIC_GAIN, RADIO_CAP_GET, retcode);
         return -1;
     }
     
-    return (int)(val.f * 100.0f + 0.5f);
+    int level = (int)(val.f * 100.0f + 0.5f);
+    radio_state_store(RADIO_FIELD_MIC_GAIN, level);
+    return level;
 }
 
 int radio_set_compression(int level) {
-    pthread_mutex_lock(&g_rig_mutex);
+    if (!radio_caps_has(RADIO_FIELD_COMP, RADIO_CAP_SET)) {
+        return RADIO_ERR_UNAVAILABLE;
+    }
+
+    RIG *rig = radio_lock();
     
-    if (!g_connected || !g_rig) {
-        pthread_mutex_unlock(&g_rig_mutex);
+    if (!rig) {
         return -1;
     }
     
+    radio_state_invalidate(RADIO_FIELD_COMP);
+    
     // Compression level varies by radio (0-10 or 0-100)
     // Use 0-100 range and let Hamlib normalize
     if (level < 0) level = 0;
@@ -155,13 +221,15 @@ int radio_set_compression(int level) {
     value_t val;
     val.f = level / 100.0f;
     
-    int retcode = rig_set_level(g_rig, RIG_VFO_CURR, RIG_LEVEL_COMP, val);
+    int retcode = RADIO_TRACED(RADIO_OP_SET_LEVEL,
+                               rig_set_level(rig, RIG_VFO_CURR, RIG_LEVEL_COMP,
+                                             val));
     
-    pthread_mutex_unlock(&g_rig_mutex);
+    radio_unlock();
     
     if (retcode != RIG_OK) {
         DEBUG_PRINT("radio_set_compression: %s\n", rigerror(retcode));
-        return -1;
+        return refused(RADIO_FIELD_COMP, RADIO_CAP_SET, retcode);
     }
     
     DEBUG_PRINT("radio_set_compression: Set to %d\n", level);
@@ -169,41 +237,61 @@ int radio_set_compression(int level) {
 }
 
 int radio_get_compression(void) {
-    pthread_mutex_lock(&g_rig_mutex);
+    double cached;
+    if (radio_state_get(RADIO_FIELD_COMP, &cached)) {
+        return (int)cached;
+    }
+
+    if (!radio_caps_has(RADIO_FIELD_COMP, RADIO_CAP_GET)) {
+        return -1;
+    }
+
+    RIG *rig = radio_lock();
     
-    if (!g_connected || !g_rig) {
-        pthread_mutex_unlock(&g_rig_mutex);
+    if (!rig) {
         return -1;
     }
     
     value_t val;
-    int retcode = rig_get_level(g_rig, RIG_VFO_CURR, RIG_LEVEL_COMP, &val);
+    int retcode = RADIO_TRACED(RADIO_OP_GET_LEVEL,
+                               rig_get_level(rig, RIG_VFO_CURR, RIG_LEVEL_COMP,
+                                             &val));
     
-    pthread_mutex_unlock(&g_rig_mutex);
+    radio_unlock();
     
     if (retcode != RIG_OK) {
         DEBUG_PRINT("radio_get_compression: %s\n", rigerror(retcode));
+        refused(RADIO_FIELD_COMP, RADIO_CAP_GET, retcode);
         return -1;
     }
     
-    return (int)(val.f * 100.0f + 0.5f);
+    int level = (int)(val.f * 100.0f + 0.5f);
+    radio_state_store(RADIO_FIELD_COMP, level);
+    return level;
 }
 
 int radio_set_compression_enabled(bool enabled) {
-    pthread_mutex_lock(&g_rig_mutex);
+    if (!radio_caps_has(RADIO_FIELD_COMP_ON, RADIO_CAP_SET)) {
+        return RADIO_ERR_UNAVAILABLE;
+    }
+
+    RIG *rig = radio_lock();
     
-    if (!g_connected || !g_rig) {
-        pthread_mutex_unlock(&g_rig_mutex);
+    if (!rig) {
         return -1;
     }
     
-    int retcode = rig_set_func(g_rig, RIG_VFO_CURR, RIG_FUNC_COMP, enabled ? 1 : 0);
+    radio_state_invalidate(RADIO_FIELD_COMP_ON);
     
-    pthread_mutex_unlock(&g_rig_mutex);
+    int retcode = RADIO_TRACED(RADIO_OP_SET_FUNC,
+                               rig_set_func(rig, RIG_VFO_CURR, RIG_FUNC_COMP,
+                                            enabled ? 1 : 0));
+    
+    radio_unlock();
     
     if (retcode != RIG_OK) {
         DEBUG_PRINT("radio_set_compression_enabled: %s\n", rigerror(retcode));
-        return -1;
+        return refused(RADIO_FIELD_COMP_ON, RADIO_CAP_SET, retcode);
     }
     
     DEBUG_PRINT("radio_set_compression_enabled: %s\n", enabled ? "on" : "off");
@@ -211,23 +299,35 @@ int radio_set_compression_enabled(bool enabled) {
 }
 
 bool radio_get_compression_enabled(void) {
-    pthread_mutex_lock(&g_rig_mutex);
+    double cached;
+    if (radio_state_get(RADIO_FIELD_COMP_ON, &cached)) {
+        return cached != 0;
+    }
+
+    if (!radio_caps_has(RADIO_FIELD_COMP_ON, RADIO_CAP_GET)) {
+        return false;
+    }
+
+    RIG *rig = radio_lock();
     
-    if (!g_connected || !g_rig) {
-        pthread_mutex_unlock(&g_rig_mutex);
+    if (!rig) {
         return false;
     }
     
     int status = 0;
-    int retcode = rig_get_func(g_rig, RIG_VFO_CURR, RIG_FUNC_COMP, &status);
+    int retcode = RADIO_TRACED(RADIO_OP_GET_FUNC,
+                               rig_get_func(rig, RIG_VFO_CURR, RIG_FUNC_COMP,
+                                            &status));
     
-    pthread_mutex_unlock(&g_rig_mutex);
+    radio_unlock();
     
     if (retcode != RIG_OK) {
         DEBUG_PRINT("radio_get_compression_enabled: %s\n", rigerror(retcode));
+        refused(RADIO_FIELD_COMP_ON, RADIO_CAP_GET, retcode);
         return false;
     }
     
+    radio_state_store(RADIO_FIELD_COMP_ON, status != 0);
     return status != 0;
 }
 
@@ -236,175 +336,262 @@ bool radio_get_compression_enabled(void) {
 // ============================================================================
 
 int radio_set_nb(bool enabled, int level) {
-    pthread_mutex_lock(&g_rig_mutex);
+    if (!radio_caps_has(RADIO_FIELD_NB_ON, RADIO_CAP_SET)) {
+        return RADIO_ERR_UNAVAILABLE;
+    }
+
+    RIG *rig = radio_lock();
     
-    if (!g_connected || !g_rig) {
-        pthread_mutex_unlock(&g_rig_mutex);
+    if (!rig) {
         return -1;
     }
     
+    radio_state_invalidate(RADIO_FIELD_NB_ON);
+    radio_state_invalidate(RADIO_FIELD_NB_LEVEL);
+    
     int retcode;
     
     // Set on/off state
-    retcode = rig_set_func(g_rig, RIG_VFO_CURR, RIG_FUNC_NB, enabled ? 1 : 0);
+    retcode = RADIO_TRACED(RADIO_OP_SET_FUNC,
+                           rig_set_func(rig, RIG_VFO_CURR, RIG_FUNC_NB,
+                                        enabled ? 1 : 0));
     if (retcode != RIG_OK) {
-        pthread_mutex_unlock(&g_rig_mutex);
+        radio_unlock();
         DEBUG_PRINT("radio_set_nb (func): %s\n", rigerror(retcode));
-        return -1;
+        return refused(RADIO_FIELD_NB_ON, RADIO_CAP_SET, retcode);
     }
     
-    // Set level if enabled
-    if (enabled && level >= 0) {
+    // Set level if enabled (and the radio has one)
+    if (enabled && level >= 0 &&
+        radio_caps_has(RADIO_FIELD_NB_LEVEL, RADIO_CAP_SET)) {
         if (level > 10) level = 10;
         value_t val;
         val.f = level / 10.0f;
-        retcode = rig_set_level(g_rig, RIG_VFO_CURR, RIG_LEVEL_NB, val);
+        retcode = RADIO_TRACED(RADIO_OP_SET_LEVEL,
+                               rig_set_level(rig, RIG_VFO_CURR, RIG_LEVEL_NB,
+                                             val));
         if (retcode != RIG_OK) {
-            pthread_mutex_unlock(&g_rig_mutex);
+            radio_unlock();
             DEBUG_PRINT("radio_set_nb (level): %s\n", rigerror(retcode));
-            return -1;
+            return refused(RADIO_FIELD_NB_LEVEL, RADIO_CAP_SET, retcode);
         }
     }
     
-    pthread_mutex_unlock(&g_rig_mutex);
+    radio_unlock();
     
     DEBUG_PRINT("radio_set_nb: enabled=%d level=%d\n", enabled, level);
     return 0;
 }
 
 bool radio_get_nb_enabled(void) {
-    pthread_mutex_lock(&g_rig_mutex);
+    double cached;
+    if (radio_state_get(RADIO_FIELD_NB_ON, &cached)) {
+        return cached != 0;
+    }
+
+    if (!radio_caps_has(RADIO_FIELD_NB_ON, RADIO_CAP_GET)) {
+        return false;
+    }
+
+    RIG *rig = radio_lock();
     
-    if (!g_connected || !g_rig) {
-        pthread_mutex_unlock(&g_rig_mutex);
+    if (!rig) {
         return false;
     }
     
     int status = 0;
-    int retcode = rig_get_func(g_rig, RIG_VFO_CURR, RIG_FUNC_NB, &status);
+    int retcode = RADIO_TRACED(RADIO_OP_GET_FUNC,
+                               rig_get_func(rig, RIG_VFO_CURR, RIG_FUNC_NB,
+                                            &status));
     
-    pthread_mutex_unlock(&g_rig_mutex);
+    radio_unlock();
     
     if (retcode != RIG_OK) {
         DEBUG_PRINT("radio_get_nb_enabled: %s\n", rigerror(retcode));
+        refused(RADIO_FIELD_NB_ON, RADIO_CAP_GET, retcode);
         return false;
     }
     
+    radio_state_store(RADIO_FIELD_NB_ON, status != 0);
     return status != 0;
 }
 
 int radio_get_nb_level(void) {
-    pthread_mutex_lock(&g_rig_mutex);
+    double cached;
+    if (radio_state_get(RADIO_FIELD_NB_LEVEL, &cached)) {
+        return (int)cached;
+    }
+
+    if (!radio_caps_has(RADIO_FIELD_NB_LEVEL, RADIO_CAP_GET)) {
+        return -1;
+    }
+
+    RIG *rig = radio_lock();
     
-    if (!g_connected || !g_rig) {
-        pthread_mutex_unlock(&g_rig_mutex);
+    if (!rig) {
         return -1;
     }
     
     value_t val;
-    int retcode = rig_get_level(g_rig, RIG_VFO_CURR, RIG_LEVEL_NB, &val);
+    int retcode = RADIO_TRACED(RADIO_OP_GET_LEVEL,
+                               rig_get_level(rig, RIG_VFO_CURR, RIG_LEVEL_NB,
+                                             &val));
     
-    pthread_mutex_unlock(&g_rig_mutex);
+    radio_unlock();
     
     if (retcode != RIG_OK) {
         DEBUG_PRINT("radio_get_nb_level: %s\n", rigerror(retcode));
+        refused(RADIO_FIELD_NB_LEVEL, RADIO_CAP_GET, retcode);
         return -1;
     }
     
-    return (int)(val.f * 10.0f + 0.5f);
+    int level = (int)(val.f * 10.0f + 0.5f);
+    radio_state_store(RADIO_FIELD_NB_LEVEL, level);
+    return level;
 }
 
 int radio_set_nr(bool enabled, int level) {
-    pthread_mutex_lock(&g_rig_mutex);
+    if (!radio_caps_has(RADIO_FIELD_NR_ON, RADIO_CAP_SET)) {
+        return RADIO_ERR_UNAVAILABLE;
+    }
+
+    RIG *rig = radio_lock();
     
-    if (!g_connected || !g_rig) {
-        pthread_mutex_unlock(&g_rig_mutex);
+    if (!rig) {
         return -1;
     }
     
+    radio_state_invalidate(RADIO_FIELD_NR_ON);
+    radio_state_invalidate(RADIO_FIELD_NR_LEVEL);
+    
     int retcode;
     
     // Set on/off state
-    retcode = rig_set_func(g_rig, RIG_VFO_CURR, RIG_FUNC_NR, enabled ? 1 : 0);
+    retcode = RADIO_TRACED(RADIO_OP_SET_FUNC,
+                           rig_set_func(rig, RIG_VFO_CURR, RIG_FUNC_NR,
+                                        enabled ? 1 : 0));
     if (retcode != RIG_OK) {
-        pthread_mutex_unlock(&g_rig_mutex);
+        radio_unlock();
         DEBUG_PRINT("radio_set_nr (func): %s\n", rigerror(retcode));
-        return -1;
+        return refused(RADIO_FIELD_NR_ON, RADIO_CAP_SET, retcode);
     }
     
-    // Set level if enabled
-    if (enabled && level >= 0) {
+    // Set level if enabled (and the radio has one)
+    if (enabled && level >= 0 &&
+        radio_caps_has(RADIO_FIELD_NR_LEVEL, RADIO_CAP_SET)) {
         if (level > 10) level = 10;
         value_t val;
         val.f = level / 10.0f;
-        retcode = rig_set_level(g_rig, RIG_VFO_CURR, RIG_LEVEL_NR, val);
+        retcode = RADIO_TRACED(RADIO_OP_SET_LEVEL,
+                               rig_set_level(rig, RIG_VFO_CURR, RIG_LEVEL_NR,
+                                             val));
         if (retcode != RIG_OK) {
-            pthread_mutex_unlock(&g_rig_mutex);
+            radio_unlock();
             DEBUG_PRINT("radio_set_nr (level): %s\n", rigerror(retcode));
-            return -1;
+            return refused(RADIO_FIELD_NR_LEVEL, RADIO_CAP_SET, retcode);
         }
     }
     
-    pthread_mutex_unlock(&g_rig_mutex);
+    radio_unlock();
     
     DEBUG_PRINT("radio_set_nr: enabled=%d level=%d\n", enabled, level);
     return 0;
 }
 
 bool radio_get_nr_enabled(void) {
-    pthread_mutex_lock(&g_rig_mutex);
+    double cached;
+    if (radio_state_get(RADIO_FIELD_NR_ON, &cached)) {
+        return cached != 0;
+    }
+
+    if (!radio_caps_has(RADIO_FIELD_NR_ON, RADIO_CAP_GET)) {
+        return false;
+    }
+
+    RIG *rig = radio_lock();
     
-    if (!g_connected || !g_rig) {
-        pthread_mutex_unlock(&g_rig_mutex);
+    if (!rig) {
         return false;
     }
     
     int status = 0;
-    int retcode = rig_get_func(g_rig, RIG_VFO_CURR, RIG_FUNC_NR, &status);
+    int retcode = RADIO_TRACED(RADIO_OP_GET_FUNC,
+                               rig_get_func(rig, RIG_VFO_CURR, RIG_FUNC_NR,
+                                            &status));
     
-    pthread_mutex_unlock(&g_rig_mutex);
+    radio_unlock();
     
     if (retcode != RIG_OK) {
         DEBUG_PRINT("radio_get_nr_enabled: %s\n", rigerror(retcode));
+        refused(RADIO_FIELD_NR_ON, RADIO_CAP_GET, retcode);
         return false;
     }
     
+    radio_state_store(RADIO_FIELD_NR_ON, status != 0);
     return status != 0;
 }
 
 int radio_get_nr_level(void) {
-    pthread_mutex_lock(&g_rig_mutex);
+    double cached;
+    if (radio_state_get(RADIO_FIELD_NR_LEVEL, &cached)) {
+        return (int)cached;
+    }
+
+    if (!radio_caps_has(RADIO_FIELD_NR_LEVEL, RADIO_CAP_GET)) {
+        return -1;
+    }
+
+    RIG *rig = radio_lock();
     
-    if (!g_connected || !g_rig) {
-        pthread_mutex_unlock(&g_rig_mutex);
+    if (!rig) {
         return -1;
     }
     
     value_t val;
-    int retcode = rig_get_level(g_rig, RIG_VFO_CURR, RIG_LEVEL_NR, &val);
+    int retcode = RADIO_TRACED(RADIO_OP_GET_LEVEL,
+                               rig_get_level(rig, RIG_VFO_CURR, RIG_LEVEL_NR,
+                                             &val));
     
-    pthread_mutex_unlock(&g_rig_mutex);
+    radio_unlock();
     
     if (retcode != RIG_OK) {
         DEBUG_PRINT("radio_get_nr_level: %s\n", rigerror(retcode));
+        refused(RADIO_FIELD_NR_LEVEL, RADIO_CAP_GET, retcode);
         return -1;
     }
     
-    return (int)(val.f * 10.0f + 0.5f);
+    int level = (int)(val.f * 10.0f + 0.5f);
+    radio_state_store(RADIO_FIELD_NR_LEVEL, level);
+    return level;
 }
 
 // ============================================================================
 // AGC (Automatic Gain Control)
 // ============================================================================
 
+static AgcSpeed agc_from_hamlib(int level) {
+    switch (level) {
+        case RIG_AGC_OFF:    return AGC_OFF;
+        case RIG_AGC_FAST:   return AGC_FAST;
+        case RIG_AGC_MEDIUM: return AGC_MEDIUM;
+        case RIG_AGC_SLOW:   return AGC_SLOW;
+        default:             return AGC_MEDIUM;  // Default for AUTO etc.
+    }
+}
+
 int radio_set_agc_speed(AgcSpeed speed) {
-    pthread_mutex_lock(&g_rig_mutex);
+    if (!radio_caps_has(RADIO_FIELD_AGC, RADIO_CAP_SET)) {
+        return RADIO_ERR_UNAVAILABLE;
+    }
+
+    RIG *rig = radio_lock();
     
-    if (!g_connected || !g_rig) {
-        pthread_mutex_unlock(&g_rig_mutex);
+    if (!rig) {
         return -1;
     }
     
+    radio_state_invalidate(RADIO_FIELD_AGC);
+    
     value_t val;
     // Hamlib uses integer AGC constants
     switch (speed) {
@@ -415,13 +602,15 @@ int radio_set_agc_speed(AgcSpeed speed) {
         default:         val.i = RIG_AGC_AUTO; break;
     }
     
-    int retcode = rig_set_level(g_rig, RIG_VFO_CURR, RIG_LEVEL_AGC, val);
+    int retcode = RADIO_TRACED(RADIO_OP_SET_LEVEL,
+                               rig_set_level(rig, RIG_VFO_CURR, RIG_LEVEL_AGC,
+                                             val));
     
-    pthread_mutex_unlock(&g_rig_mutex);
+    radio_unlock();
     
     if (retcode != RIG_OK) {
         DEBUG_PRINT("radio_set_agc_speed: %s\n", rigerror(retcode));
-        return -1;
+        return refused(RADIO_FIELD_AGC, RADIO_CAP_SET, retcode);
     }
     
     DEBUG_PRINT("radio_set_agc_speed: %d\n", speed);
@@ -429,34 +618,44 @@ int radio_set_agc_speed(AgcSpeed speed) {
 }
 
 AgcSpeed radio_get_agc_speed(void) {
-    pthread_mutex_lock(&g_rig_mutex);
+    double cached;
+    if (radio_state_get(RADIO_FIELD_AGC, &cached)) {
+        return (AgcSpeed)(int)cached;
+    }
+
+    if (!radio_caps_has(RADIO_FIELD_AGC, RADIO_CAP_GET)) {
+        return AGC_OFF;
+    }
+
+    RIG *rig = radio_lock();
     
-    if (!g_connected || !g_rig) {
-        pthread_mutex_unlock(&g_rig_mutex);
+    if (!rig) {
         return AGC_OFF;
     }
     
     value_t val;
-    int retcode = rig_get_level(g_rig, RIG_VFO_CURR, RIG_LEVEL_AGC, &val);
+    int retcode = RADIO_TRACED(RADIO_OP_GET_LEVEL,
+                               rig_get_level(rig, RIG_VFO_CURR, RIG_LEVEL_AGC,
+                                             &val));
     
-    pthread_mutex_unlock(&g_rig_mutex);
+    radio_unlock();
     
     if (retcode != RIG_OK) {
         DEBUG_PRINT("radio_get_agc_speed: %s\n", rigerror(retcode));
+        refused(RADIO_FIELD_AGC, RADIO_CAP_GET, retcode);
         return AGC_OFF;
     }
     
-    switch (val.i) {
-        case RIG_AGC_OFF:    return AGC_OFF;
-        case RIG_AGC_FAST:   return AGC_FAST;
-        case RIG_AGC_MEDIUM: return AGC_MEDIUM;
-        case RIG_AGC_SLOW:   return AGC_SLOW;
-        default:             return AGC_MEDIUM;  // Default for AUTO etc.
-    }
+    AgcSpeed speed = agc_from_hamlib(val.i);
+    radio_state_store(RADIO_FIELD_AGC, speed);
+    return speed;
 }
 
 const char* radio_get_agc_string(void) {
-    AgcSpeed speed = radio_get_agc_speed();
+    return radio_agc_speed_name(radio_get_agc_speed());
+}
+
+const char* radio_agc_speed_name(AgcSpeed speed) {
     switch (speed) {
         case AGC_OFF:    return "Off";
         case AGC_FAST:   return "Fast";
@@ -471,25 +670,32 @@ const char* radio_get_agc_string(void) {
 // ============================================================================
 
 int radio_set_preamp(int state) {
-    pthread_mutex_lock(&g_rig_mutex);
+    if (!radio_caps_has(RADIO_FIELD_PREAMP, RADIO_CAP_SET)) {
+        return RADIO_ERR_UNAVAILABLE;
+    }
+
+    RIG *rig = radio_lock();
     
-    if (!g_connected || !g_rig) {
-        pthread_mutex_unlock(&g_rig_mutex);
+    if (!rig) {
         return -1;
     }
     
+    radio_state_invalidate(RADIO_FIELD_PREAMP);
+    
     // Hamlib preamp is typically 0=off, 10=preamp1, 20=preamp2 (dB values)
     // But many radios just use 0, 1, 2 indices
     value_t val;
     val.i = state * 10;  // Convert 0/1/2 to 0/10/20
     
-    int retcode = rig_set_level(g_rig, RIG_VFO_CURR, RIG_LEVEL_PREAMP, val);
+    int retcode = RADIO_TRACED(RADIO_OP_SET_LEVEL,
+                               rig_set_level(rig, RIG_VFO_CURR,
+                                             RIG_LEVEL_PREAMP, val));
     
-    pthread_mutex_unlock(&g_rig_mutex);
+    radio_unlock();
     
     if (retcode != RIG_OK) {
         DEBUG_PRINT("radio_set_preamp: %s\n", rigerror(retcode));
-        return -1;
+        return refused(RADIO_FIELD_PREAMP, RADIO_CAP_SET, retcode);
     }
     
     DEBUG_PRINT("radio_set_preamp: %d\n", state);
@@ -497,45 +703,65 @@ int radio_set_preamp(int state) {
 }
 
 int radio_get_preamp(void) {
-    pthread_mutex_lock(&g_rig_mutex);
+    double cached;
+    if (radio_state_get(RADIO_FIELD_PREAMP, &cached)) {
+        return (int)cached;
+    }
+
+    if (!radio_caps_has(RADIO_FIELD_PREAMP, RADIO_CAP_GET)) {
+        return -1;
+    }
+
+    RIG *rig = radio_lock();
     
-    if (!g_connected || !g_rig) {
-        pthread_mutex_unlock(&g_rig_mutex);
+    if (!rig) {
         return -1;
     }
     
     value_t val;
-    int retcode = rig_get_level(g_rig, RIG_VFO_CURR, RIG_LEVEL_PREAMP, &val);
+    int retcode = RADIO_TRACED(RADIO_OP_GET_LEVEL,
+                               rig_get_level(rig, RIG_VFO_CURR,
+                                             RIG_LEVEL_PREAMP, &val));
     
-    pthread_mutex_unlock(&g_rig_mutex);
+    radio_unlock();
     
     if (retcode != RIG_OK) {
         DEBUG_PRINT("radio_get_preamp: %s\n", rigerror(retcode));
+        refused(RADIO_FIELD_PREAMP, RADIO_CAP_GET, retcode);
         return -1;
     }
     
     // Convert dB back to 0/1/2
-    return val.i / 10;
+    int state = val.i / 10;
+    radio_state_store(RADIO_FIELD_PREAMP, state);
+    return state;
 }
 
 int radio_set_attenuation(int db) {
-    pthread_mutex_lock(&g_rig_mutex);
+    if (!radio_caps_has(RADIO_FIELD_ATT, RADIO_CAP_SET)) {
+        return RADIO_ERR_UNAVAILABLE;
+    }
+
+    RIG *rig = radio_lock();
     
-    if (!g_connected || !g_rig) {
-        pthread_mutex_unlock(&g_rig_mutex);
+    if (!rig) {
         return -1;
     }
     
+    radio_state_invalidate(RADIO_FIELD_ATT);
+    
     value_t val;
     val.i = db;
     
-    int retcode = rig_set_level(g_rig, RIG_VFO_CURR, RIG_LEVEL_ATT, val);
+    int retcode = RADIO_TRACED(RADIO_OP_SET_LEVEL,
+                               rig_set_level(rig, RIG_VFO_CURR, RIG_LEVEL_ATT,
+                                             val));
     
-    pthread_mutex_unlock(&g_rig_mutex);
+    radio_unlock();
     
     if (retcode != RIG_OK) {
         DEBUG_PRINT("radio_set_attenuation: %s\n", rigerror(retcode));
-        return -1;
+        return refused(RADIO_FIELD_ATT, RADIO_CAP_SET, retcode);
     }
     
     DEBUG_PRINT("radio_set_attenuation: %d dB\n", db);
@@ -543,23 +769,35 @@ int radio_set_attenuation(int db) {
 }
 
 int radio_get_attenuation(void) {
-    pthread_mutex_lock(&g_rig_mutex);
+    double cached;
+    if (radio_state_get(RADIO_FIELD_ATT, &cached)) {
+        return (int)cached;
+    }
+
+    if (!radio_caps_has(RADIO_FIELD_ATT, RADIO_CAP_GET)) {
+        return -1;
+    }
+
+    RIG *rig = radio_lock();
     
-    if (!g_connected || !g_rig) {
-        pthread_mutex_unlock(&g_rig_mutex);
+    if (!rig) {
         return -1;
     }
     
     value_t val;
-    int retcode = rig_get_level(g_rig, RIG_VFO_CURR, RIG_LEVEL_ATT, &val);
+    int retcode = RADIO_TRACED(RADIO_OP_GET_LEVEL,
+                               rig_get_level(rig, RIG_VFO_CURR, RIG_LEVEL_ATT,
+                                             &val));
     
-    pthread_mutex_unlock(&g_rig_mutex);
+    radio_unlock();
     
     if (retcode != RIG_OK) {
         DEBUG_PRINT("radio_get_attenuation: %s\n", rigerror(retcode));
+        refused(RADIO_FIELD_ATT, RADIO_CAP_GET, retcode);
         return -1;
     }
     
+    radio_state_store(RADIO_FIELD_ATT, val.i);
     return val.i;
 }
 
@@ -567,21 +805,32 @@ int radio_get_attenuation(void) {
 // Mode Control
 // ============================================================================
 
+// Whether the rig's capabilities list a mode. An empty list (as over
+// rigctld with an old server) tells nothing, so every mode passes.
+static bool rig_lists_mode(RIG *rig, rmode_t mode) {
+    rmode_t modes = rig->state.mode_list;
+    return modes == 0 || (modes & mode) != 0;
+}
+
 int radio_cycle_mode(void) {
-    pthread_mutex_lock(&g_rig_mutex);
+    RIG *rig = radio_lock();
     
-    if (!g_connected || !g_rig) {
-        pthread_mutex_unlock(&g_rig_mutex);
+    if (!rig) {
         return -1;
     }
     
+    radio_state_invalidate(RADIO_FIELD_MODE);
+    radio_state_invalidate(RADIO_FIELD_PASSBAND);
+    
     // Get current mode
     rmode_t current_mode;
     pbwidth_t current_width;
-    int retcode = rig_get_mode(g_rig, RIG_VFO_CURR, &current_mode, &current_width);
+    int retcode = RADIO_TRACED(RADIO_OP_GET_MODE,
+                               rig_get_mode(rig, RIG_VFO_CURR, &current_mode,
+                                            &current_width));
     
     if (retcode != RIG_OK) {
-        pthread_mutex_unlock(&g_rig_mutex);
+        radio_unlock();
         DEBUG_PRINT("radio_cycle_mode (get): %s\n", rigerror(retcode));
         return -1;
     }
@@ -599,17 +848,22 @@ int radio_cycle_mode(void) {
     for (int i = 0; i < mode_count; i++) {
         int next_index = (current_index + 1 + i) % mode_count;
         rmode_t next_mode = mode_list[next_index];
-        pbwidth_t width = rig_passband_normal(g_rig, next_mode);
+        if (!rig_lists_mode(rig, next_mode)) {
+            continue;
+        }
+        pbwidth_t width = rig_passband_normal(rig, next_mode);
         
-        retcode = rig_set_mode(g_rig, RIG_VFO_CURR, next_mode, width);
+        retcode = RADIO_TRACED(RADIO_OP_SET_MODE,
+                               rig_set_mode(rig, RIG_VFO_CURR, next_mode,
+                                            width));
         if (retcode == RIG_OK) {
-            pthread_mutex_unlock(&g_rig_mutex);
+            radio_unlock();
             DEBUG_PRINT("radio_cycle_mode: Set to %s\n", rig_strrmode(next_mode));
             return 0;
         }
     }
     
-    pthread_mutex_unlock(&g_rig_mutex);
+    radio_unlock();
     DEBUG_PRINT("radio_cycle_mode: No mode available\n");
     return -1;
 }
@@ -619,19 +873,26 @@ int radio_set_mode_by_index(int mode_index) {
         return -1;
     }
     
-    pthread_mutex_lock(&g_rig_mutex);
+    radio_state_invalidate(RADIO_FIELD_MODE);
+    radio_state_invalidate(RADIO_FIELD_PASSBAND);
     
-    if (!g_connected || !g_rig) {
-        pthread_mutex_unlock(&g_rig_mutex);
+    RIG *rig = radio_lock();
+    
+    if (!rig) {
         return -1;
     }
     
     rmode_t mode = mode_list[mode_index];
-    pbwidth_t width = rig_passband_normal(g_rig, mode);
+    if (!rig_lists_mode(rig, mode)) {
+        radio_unlock();
+        return RADIO_ERR_UNAVAILABLE;
+    }
+    pbwidth_t width = rig_passband_normal(rig, mode);
     
-    int retcode = rig_set_mode(g_rig, RIG_VFO_CURR, mode, width);
+    int retcode = RADIO_TRACED(RADIO_OP_SET_MODE,
+                               rig_set_mode(rig, RIG_VFO_CURR, mode, width));
     
-    pthread_mutex_unlock(&g_rig_mutex);
+    radio_unlock();
     
     if (retcode != RIG_OK) {
         DEBUG_PRINT("radio_set_mode_by_index: %s\n", rigerror(retcode));
@@ -641,3 +902,148 @@ int radio_set_mode_by_index(int mode_index) {
     DEBUG_PRINT("radio_set_mode_by_index: Set to %s\n", rig_strrmode(mode));
     return 0;
 }
+
+int radio_set_mode_raw(int mode, int passband_hz) {
+    radio_state_invalidate(RADIO_FIELD_MODE);
+    radio_state_invalidate(RADIO_FIELD_PASSBAND);
+    
+    RIG *rig = radio_lock();
+    
+    if (!rig) {
+        return -1;
+    }
+    
+    if (!rig_lists_mode(rig, (rmode_t)mode)) {
+        radio_unlock();
+        return RADIO_ERR_UNAVAILABLE;
+    }
+    pbwidth_t width = passband_hz > 0
+                          ? (pbwidth_t)passband_hz
+                          : rig_passband_normal(rig, (rmode_t)mode);
+    
+    int retcode = RADIO_TRACED(RADIO_OP_SET_MODE,
+                               rig_set_mode(rig, RIG_VFO_CURR, (rmode_t)mode,
+                                            width));
+    
+    radio_unlock();
+    
+    if (retcode != RIG_OK) {
+        DEBUG_PRINT("radio_set_mode_raw: %s\n", rigerror(retcode));
+        return -1;
+    }
+    
+    DEBUG_PRINT("radio_set_mode_raw: Set to %s\n",
+                rig_strrmode((rmode_t)mode));
+    return 0;
+}
+
+// ============================================================================
+// Batched Status Read
+// ============================================================================
+
+// The reads behind each RadioStatus field
+static const struct {
+    RadioField field;
+    bool is_func;      // rig_get_func rather than rig_get_level
+    setting_t setting;
+    size_t offset;     // Where it goes in RadioStatus
+} status_reads[] = {
+    {RADIO_FIELD_POWER,    false, RIG_LEVEL_RFPOWER, offsetof(RadioStatus, power)},
+    {RADIO_FIELD_MIC_GAIN, false, RIG_LEVEL_MICGAIN, offsetof(RadioStatus, mic_gain)},
+    {RADIO_FIELD_COMP,     false, RIG_LEVEL_COMP,    offsetof(RadioStatus, compression)},
+    {RADIO_FIELD_COMP_ON,  true,  RIG_FUNC_COMP,     offsetof(RadioStatus, compression_on)},
+    {RADIO_FIELD_NB_ON,    true,  RIG_FUNC_NB,       offsetof(RadioStatus, nb_on)},
+    {RADIO_FIELD_NB_LEVEL, false, RIG_LEVEL_NB,      offsetof(RadioStatus, nb_level)},
+    {RADIO_FIELD_NR_ON,    true,  RIG_FUNC_NR,       offsetof(RadioStatus, nr_on)},
+    {RADIO_FIELD_NR_LEVEL, false, RIG_LEVEL_NR,      offsetof(RadioStatus, nr_level)},
+    {RADIO_FIELD_AGC,      false, RIG_LEVEL_AGC,     offsetof(RadioStatus, agc)},
+    {RADIO_FIELD_PREAMP,   false, RIG_LEVEL_PREAMP,  offsetof(RadioStatus, preamp)},
+    {RADIO_FIELD_ATT,      false, RIG_LEVEL_ATT,     offsetof(RadioStatus, attenuation)},
+};
+#define STATUS_READ_COUNT (int)(sizeof(status_reads) / sizeof(status_reads[0]))
+
+// Convert a Hamlib level to the units the getters above return
+static int status_level_value(RadioField field, value_t val) {
+    switch (field) {
+        case RADIO_FIELD_NB_LEVEL:
+        case RADIO_FIELD_NR_LEVEL: return (int)(val.f * 10.0f + 0.5f);
+        case RADIO_FIELD_AGC:      return agc_from_hamlib(val.i);
+        case RADIO_FIELD_PREAMP:   return val.i / 10;
+        case RADIO_FIELD_ATT:      return val.i;
+        default:                   return (int)(val.f * 100.0f + 0.5f);
+    }
+}
+
+int radio_read_status(RadioStatus *status) {
+    RadioStatus result;
+    int known = 0;
+    int queried = 0;
+
+    RIG *rig = radio_lock();
+
+    if (!rig) {
+        return -1;
+    }
+
+    bool timed_out = false;
+    for (int i = 0; i < STATUS_READ_COUNT; i++) {
+        RadioField field = status_reads[i].field;
+        setting_t setting = status_reads[i].setting;
+        int *value = (int *)((char *)&result + status_reads[i].offset);
+        *value = -1;
+
+        double cached;
+        if (radio_state_get(field, &cached)) {
+            *value = (int)cached;
+            known++;
+            continue;
+        }
+
+        // Once the rig stopped answering, don't wait out a timeout per field
+        if (timed_out) {
+            continue;
+        }
+
+        // Asking for something the rig lacks can cost a full timeout too
+        if (!radio_caps_has(field, RADIO_CAP_GET)) {
+            continue;
+        }
+        int retcode;
+        if (status_reads[i].is_func) {
+            int on = 0;
+            retcode = RADIO_TRACED(RADIO_OP_GET_FUNC,
+                                   rig_get_func(rig, RIG_VFO_CURR, setting,
+                                                &on));
+            if (retcode == RIG_OK) {
+                *value = on != 0;
+            }
+        } else {
+            value_t val;
+            retcode = RADIO_TRACED(RADIO_OP_GET_LEVEL,
+                                   rig_get_level(rig, RIG_VFO_CURR, setting,
+                                                 &val));
+            if (retcode == RIG_OK) {
+                *value = status_level_value(field, val);
+            }
+        }
+        queried++;
+
+        if (retcode == RIG_OK) {
+            radio_state_store(field, *value);
+            known++;
+        } else {
+            DEBUG_PRINT("radio_read_status (%d): %s\n", i, rigerror(retcode));
+            refused(field, RADIO_CAP_GET, retcode);
+            timed_out = retcode == -RIG_ETIMEOUT;
+        }
+    }
+
+    radio_unlock();
+
+    DEBUG_PRINT("radio_read_status: %d known, %d queried\n", known, queried);
+
+    if (status) {
+        *status = result;
+    }
+    return known;
+}
@@ -0,0 +1,205 @@
+/**
+ * @file radio_state.c
+ * @brief Cached radio state implementation
+ */
+
+#include "radio_state.h"
+
+#include <pthread.h>
+#include <time.h>
+
+// ============================================================================
+// State
+// ============================================================================
+
+typedef struct {
+  double value;
+  long long read_ms; // CLOCK_MONOTONIC ms when read, 0 if not known
+} RadioStateField;
+
+static RadioStateField g_slots[RADIO_STATE_SLOTS][RADIO_FIELD_COUNT];
+static RadioStateField *g_fields = g_slots[0]; // Selected radio's
+static pthread_mutex_t g_state_mutex = PTHREAD_MUTEX_INITIALIZER;
+static RadioStateListener g_listener = NULL; // Atomic
+
+// How old a value radio_state_get() still returns, per field
+static const int g_tolerance_ms[RADIO_FIELD_COUNT] = {
+    [RADIO_FIELD_FREQ] = 200,        [RADIO_FIELD_MODE] = 1000,
+    [RADIO_FIELD_PASSBAND] = 1000,   [RADIO_FIELD_VFO] = 1000,
+    [RADIO_FIELD_SMETER] = 500,      [RADIO_FIELD_POWER_METER] = 500,
+    [RADIO_FIELD_SWR] = 500,         [RADIO_FIELD_ALC] = 500,
+    [RADIO_FIELD_POWER] = 5000,      [RADIO_FIELD_MIC_GAIN] = 5000,
+    [RADIO_FIELD_COMP] = 5000,       [RADIO_FIELD_COMP_ON] = 5000,
+    [RADIO_FIELD_NB_ON] = 5000,      [RADIO_FIELD_NB_LEVEL] = 5000,
+    [RADIO_FIELD_NR_ON] = 5000,      [RADIO_FIELD_NR_LEVEL] = 5000,
+    [RADIO_FIELD_AGC] = 5000,        [RADIO_FIELD_PREAMP] = 5000,
+    [RADIO_FIELD_ATT] = 5000,        [RADIO_FIELD_VOX] = 5000,
+};
+
+// ============================================================================
+// Internal Functions
+// ============================================================================
+
+static long long now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static bool valid_field(RadioField field) {
+  return field >= 0 && field < RADIO_FIELD_COUNT;
+}
+
+static bool valid_slot(int slot) {
+  return slot >= 0 && slot < RADIO_STATE_SLOTS;
+}
+
+// Field updates; call with g_state_mutex held. Returns whether the value
+// is new.
+static bool store_field(RadioStateField *fields, RadioField field,
+                        double value, long long now) {
+  bool changed = fields[field].read_ms == 0 || fields[field].value != value;
+  fields[field].value = value;
+  fields[field].read_ms = now;
+  return changed;
+}
+
+// Tell the listener about a change; call without g_state_mutex
+static void notify(RadioField field, double value) {
+  RadioStateListener listener =
+      __atomic_load_n(&g_listener, __ATOMIC_ACQUIRE);
+  if (listener != NULL) {
+    listener(field, value);
+  }
+}
+
+static void clear_fields(RadioStateField *fields) {
+  for (int i = 0; i < RADIO_FIELD_COUNT; i++) {
+    fields[i].read_ms = 0;
+  }
+}
+
+// ============================================================================
+// Reads
+// ============================================================================
+
+bool radio_state_get(RadioField field, double *value) {
+  if (!valid_field(field)) {
+    return false;
+  }
+  return radio_state_get_within(field, g_tolerance_ms[field], value);
+}
+
+bool radio_state_get_within(RadioField field, int max_age_ms, double *value) {
+  if (!valid_field(field)) {
+    return false;
+  }
+
+  long long now = now_ms();
+  pthread_mutex_lock(&g_state_mutex);
+  const RadioStateField *f = &g_fields[field];
+  bool fresh = f->read_ms != 0 && now - f->read_ms <= max_age_ms;
+  if (fresh) {
+    *value = f->value;
+  }
+  pthread_mutex_unlock(&g_state_mutex);
+  return fresh;
+}
+
+void radio_state_snapshot(RadioStateSnapshot *snapshot) {
+  long long now = now_ms();
+  pthread_mutex_lock(&g_state_mutex);
+  for (int i = 0; i < RADIO_FIELD_COUNT; i++) {
+    snapshot->value[i] = g_fields[i].value;
+    snapshot->age_ms[i] =
+        g_fields[i].read_ms != 0 ? (int)(now - g_fields[i].read_ms) : -1;
+  }
+  pthread_mutex_unlock(&g_state_mutex);
+}
+
+// ============================================================================
+// Updates
+// ============================================================================
+
+void radio_state_store(RadioField field, double value) {
+  if (!valid_field(field)) {
+    return;
+  }
+
+  long long now = now_ms();
+  pthread_mutex_lock(&g_state_mutex);
+  bool changed = store_field(g_fields, field, value, now);
+  pthread_mutex_unlock(&g_state_mutex);
+  if (changed) {
+    notify(field, value);
+  }
+}
+
+void radio_state_invalidate(RadioField field) {
+  if (!valid_field(field)) {
+    return;
+  }
+
+  pthread_mutex_lock(&g_state_mutex);
+  g_fields[field].read_ms = 0;
+  pthread_mutex_unlock(&g_state_mutex);
+}
+
+void radio_state_clear(void) {
+  pthread_mutex_lock(&g_state_mutex);
+  clear_fields(g_fields);
+  pthread_mutex_unlock(&g_state_mutex);
+}
+
+void radio_state_set_listener(RadioStateListener listener) {
+  __atomic_store_n(&g_listener, listener, __ATOMIC_RELEASE);
+}
+
+// ============================================================================
+// Radios
+// ============================================================================
+
+void radio_state_select(int slot) {
+  if (!valid_slot(slot)) {
+    return;
+  }
+
+  pthread_mutex_lock(&g_state_mutex);
+  g_fields = g_slots[slot];
+  pthread_mutex_unlock(&g_state_mutex);
+}
+
+void radio_state_store_for(int slot, RadioField field, double value) {
+  if (!valid_slot(slot) || !valid_field(field)) {
+    return;
+  }
+
+  long long now = now_ms();
+  pthread_mutex_lock(&g_state_mutex);
+  bool changed = store_field(g_slots[slot], field, value, now) &&
+                 g_fields == g_slots[slot];
+  pthread_mutex_unlock(&g_state_mutex);
+  if (changed) {
+    notify(field, value);
+  }
+}
+
+void radio_state_invalidate_for(int slot, RadioField field) {
+  if (!valid_slot(slot) || !valid_field(field)) {
+    return;
+  }
+
+  pthread_mutex_lock(&g_state_mutex);
+  g_slots[slot][field].read_ms = 0;
+  pthread_mutex_unlock(&g_state_mutex);
+}
+
+void radio_state_clear_for(int slot) {
+  if (!valid_slot(slot)) {
+    return;
+  }
+
+  pthread_mutex_lock(&g_state_mutex);
+  clear_fields(g_slots[slot]);
+  pthread_mutex_unlock(&g_state_mutex);
+}
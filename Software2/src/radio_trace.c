@@ -0,0 +1,200 @@
+/**
+ * @file radio_trace.c
+ * @brief Hamlib call tracing implementation
+ */
+
+#include "radio_trace.h"
+#include "hampod_metrics.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+// ============================================================================
+// State
+// ============================================================================
+
+static RadioTraceStats g_stats[RADIO_OP_COUNT];
+static pthread_mutex_t g_trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Upper bounds of all but the last bucket, in microseconds
+static const long long g_bucket_us[RADIO_TRACE_BUCKETS - 1] = {
+    1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000, 500000, 1000000};
+
+static const char *const g_op_names[RADIO_OP_COUNT] = {
+    [RADIO_OP_OPEN] = "open",          [RADIO_OP_GET_FREQ] = "get_freq",
+    [RADIO_OP_SET_FREQ] = "set_freq",  [RADIO_OP_GET_MODE] = "get_mode",
+    [RADIO_OP_SET_MODE] = "set_mode",  [RADIO_OP_GET_VFO] = "get_vfo",
+    [RADIO_OP_SET_VFO] = "set_vfo",    [RADIO_OP_GET_LEVEL] = "get_level",
+    [RADIO_OP_SET_LEVEL] = "set_level", [RADIO_OP_GET_FUNC] = "get_func",
+    [RADIO_OP_SET_FUNC] = "set_func",  [RADIO_OP_SET_TRN] = "set_trn",
+    [RADIO_OP_GET_CHANNEL] = "get_channel",
+    [RADIO_OP_CAT_GET_FREQ] = "cat_get_freq",
+    [RADIO_OP_CAT_SET_FREQ] = "cat_set_freq",
+    [RADIO_OP_CAT_GET_SMETER] = "cat_smeter",
+};
+
+// This thread's call in progress, and its lock wait not yet charged
+static __thread long long t_start_us = 0;
+static __thread long long t_wait_us = 0;
+
+// ============================================================================
+// Internal Functions
+// ============================================================================
+
+static long long now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int bucket_for(long long us) {
+  int bucket = 0;
+  while (bucket < RADIO_TRACE_BUCKETS - 1 && us >= g_bucket_us[bucket]) {
+    bucket++;
+  }
+  return bucket;
+}
+
+static void write_histogram(FILE *out, const char *name,
+                            const unsigned long *buckets) {
+  fprintf(out, "%-10s", name);
+  for (int b = 0; b < RADIO_TRACE_BUCKETS; b++) {
+    fprintf(out, " %6lu", buckets[b]);
+  }
+  fprintf(out, "\n");
+}
+
+static void write_histogram_header(FILE *out, const char *title) {
+  fprintf(out, "\n%-10s", title);
+  for (int b = 0; b < RADIO_TRACE_BUCKETS - 1; b++) {
+    fprintf(out, " %6lld", g_bucket_us[b] / 1000);
+  }
+  fprintf(out, " %6s\n", "more");
+}
+
+// ============================================================================
+// Recording
+// ============================================================================
+
+void radio_trace_lock_waited(long long wait_us) { t_wait_us = wait_us; }
+
+void radio_trace_begin(void) { t_start_us = now_us(); }
+
+int radio_trace_end(RadioOp op, int retcode) {
+  long long call_us = now_us() - t_start_us;
+  long long wait_us = t_wait_us;
+  t_wait_us = 0;
+  if (op < 0 || op >= RADIO_OP_COUNT) {
+    return retcode;
+  }
+
+  hampod_metric_observe_us(METRIC_HAMLIB_CALL, (uint64_t)call_us);
+  if (retcode != 0) {
+    hampod_metric_add(METRIC_HAMLIB_ERRORS, 1);
+  }
+
+  pthread_mutex_lock(&g_trace_mutex);
+  RadioTraceStats *stats = &g_stats[op];
+  stats->calls++;
+  stats->call_buckets[bucket_for(call_us)]++;
+  stats->wait_buckets[bucket_for(wait_us)]++;
+  stats->call_us_total += call_us;
+  stats->wait_us_total += wait_us;
+  if (call_us > stats->call_us_max) {
+    stats->call_us_max = call_us;
+  }
+  if (wait_us > stats->wait_us_max) {
+    stats->wait_us_max = wait_us;
+  }
+  if (retcode != 0) {
+    int code = retcode < 0 ? -retcode : retcode;
+    stats->errors++;
+    stats->codes[code < RADIO_TRACE_CODES ? code : RADIO_TRACE_CODES - 1]++;
+  }
+  pthread_mutex_unlock(&g_trace_mutex);
+  return retcode;
+}
+
+// ============================================================================
+// Reading
+// ============================================================================
+
+int radio_trace_get(RadioOp op, RadioTraceStats *stats) {
+  if (op < 0 || op >= RADIO_OP_COUNT || stats == NULL) {
+    return -1;
+  }
+
+  pthread_mutex_lock(&g_trace_mutex);
+  *stats = g_stats[op];
+  pthread_mutex_unlock(&g_trace_mutex);
+  return 0;
+}
+
+const char *radio_trace_op_name(RadioOp op) {
+  if (op < 0 || op >= RADIO_OP_COUNT) {
+    return "unknown";
+  }
+  return g_op_names[op];
+}
+
+void radio_trace_report(FILE *out) {
+  RadioTraceStats stats[RADIO_OP_COUNT];
+  pthread_mutex_lock(&g_trace_mutex);
+  memcpy(stats, g_stats, sizeof(stats));
+  pthread_mutex_unlock(&g_trace_mutex);
+
+  fprintf(out, "%-10s %6s %6s %8s %8s %8s %8s\n", "op", "calls", "errors",
+          "mean ms", "max ms", "wait ms", "wait max");
+  for (int op = 0; op < RADIO_OP_COUNT; op++) {
+    const RadioTraceStats *s = &stats[op];
+    if (s->calls == 0) {
+      continue;
+    }
+    fprintf(out, "%-10s %6lu %6lu %8.1f %8.1f %8.1f %8.1f\n", g_op_names[op],
+            s->calls, s->errors, s->call_us_total / 1000.0 / s->calls,
+            s->call_us_max / 1000.0, s->wait_us_total / 1000.0 / s->calls,
+            s->wait_us_max / 1000.0);
+  }
+
+  write_histogram_header(out, "call <ms");
+  for (int op = 0; op < RADIO_OP_COUNT; op++) {
+    if (stats[op].calls > 0) {
+      write_histogram(out, g_op_names[op], stats[op].call_buckets);
+    }
+  }
+
+  write_histogram_header(out, "wait <ms");
+  for (int op = 0; op < RADIO_OP_COUNT; op++) {
+    if (stats[op].calls > 0) {
+      write_histogram(out, g_op_names[op], stats[op].wait_buckets);
+    }
+  }
+
+  bool any_errors = false;
+  for (int op = 0; op < RADIO_OP_COUNT; op++) {
+    if (stats[op].errors == 0) {
+      continue;
+    }
+    if (!any_errors) {
+      fprintf(out, "\nerrors (Hamlib code x count)\n");
+      any_errors = true;
+    }
+    fprintf(out, "%-10s", g_op_names[op]);
+    for (int code = 1; code < RADIO_TRACE_CODES; code++) {
+      if (stats[op].codes[code] > 0) {
+        fprintf(out, " -%d%s x%lu", code,
+                code == RADIO_TRACE_CODES - 1 ? "+" : "",
+                stats[op].codes[code]);
+      }
+    }
+    fprintf(out, "\n");
+  }
+}
+
+void radio_trace_reset(void) {
+  pthread_mutex_lock(&g_trace_mutex);
+  memset(g_stats, 0, sizeof(g_stats));
+  pthread_mutex_unlock(&g_trace_mutex);
+}
@@ -0,0 +1,31 @@
+/**
+ * @file radio_worker.c
+ * @brief Radio command worker: the radios' device worker
+ */
+
+#include "radio_worker.h"
+
+static DeviceWorker g_worker = DEVICE_WORKER_INITIALIZER("radio-worker");
+
+int radio_worker_start(void) { return device_worker_start(&g_worker); }
+
+void radio_worker_stop(void) { device_worker_stop(&g_worker); }
+
+pthread_t radio_worker_get_thread(void) {
+  return device_worker_get_thread(&g_worker);
+}
+
+int radio_worker_submit(RadioCommandPriority priority, RadioCommandKey key,
+                        RadioCommandFn run, RadioCommandDone done,
+                        const void *arg, size_t arg_size) {
+  return device_worker_submit(&g_worker, priority, key, run, done, arg,
+                              arg_size);
+}
+
+int radio_worker_cancel(RadioCommandKey key) {
+  return device_worker_cancel(&g_worker, key);
+}
+
+bool radio_worker_wait_idle(int timeout_ms) {
+  return device_worker_wait_idle(&g_worker, timeout_ms);
+}
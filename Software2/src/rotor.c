@@ -0,0 +1,364 @@
+/**
+ * @file rotor.c
+ * @brief Antenna rotor control implementation
+ */
+
+#include "rotor.h"
+#include "config.h"
+#include "hampod_core.h"
+#include "hampod_metrics.h"
+#include "idle.h"
+
+#include <hamlib/rotator.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// ============================================================================
+// State Variables
+// ============================================================================
+
+#define ROTOR_RECONNECT_MS 2000  // Between connect attempts
+#define ROTOR_IDLE_MODE_MS 30000 // Slowest poll in idle mode
+#define ROTOR_FAIL_THRESHOLD 3   // Failed reads before it counts as gone
+#define ROTOR_STILL_POLLS 2      // Polls without movement: at rest
+#define ROTOR_START_MS 5000      // How long a turn may take to get going
+#define ROTOR_MOVE_DEGREES 0.5   // Smaller changes are read noise
+
+static ROT *g_rot = NULL;
+static pthread_mutex_t g_rot_lock = PTHREAD_MUTEX_INITIALIZER; // Hamlib calls
+static DeviceWorker g_worker = DEVICE_WORKER_INITIALIZER("rotor-worker");
+static bool g_configured = false;
+static RotorStopCallback g_stop_callback = NULL;
+
+// Cached state: written by the poll thread and commands, read anywhere
+static bool g_connected = false;     // Atomic
+static bool g_have_position = false; // Atomic; set after the position
+static double g_azimuth;             // Atomic
+static double g_elevation;           // Atomic
+static bool g_moving = false;        // Atomic
+
+// Poll thread; poll_kick wakes it early, turn_pending keeps it fast
+// until a commanded turn has started and stopped
+static pthread_t g_poll_thread;
+static volatile bool g_polling = false;
+static pthread_mutex_t g_poll_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_poll_wake = PTHREAD_COND_INITIALIZER;
+static bool g_poll_kick = false;
+static bool g_turn_pending = false;
+static long long g_turn_started_ms = 0;
+
+// ============================================================================
+// Internal Helpers
+// ============================================================================
+
+static long long rotor_now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void rotor_set_conf(ROT *rot, const char *name, const char *value) {
+  token_t token = rot_token_lookup(rot, name);
+  if (token != RIG_CONF_END) {
+    rot_set_conf(rot, token, value);
+  }
+}
+
+// Open the configured rotor and check that it answers. Returns the open
+// rotor, or NULL. Doesn't touch the shared state.
+static ROT *rotor_open(const RotorSettings *settings) {
+  ROT *rot = rot_init(settings->model);
+  if (!rot) {
+    fprintf(stderr, "rotor: rot_init failed for model %d\n", settings->model);
+    return NULL;
+  }
+
+  // Serial device, or "host:port" for rotctld; short timeouts as for the
+  // radios, so a rotor that is off doesn't hold its lock for long
+  char baud[16];
+  rotor_set_conf(rot, "rot_pathname", settings->device);
+  if (settings->baud > 0) {
+    snprintf(baud, sizeof(baud), "%d", settings->baud);
+    rotor_set_conf(rot, "serial_speed", baud);
+  }
+  rotor_set_conf(rot, "timeout", "200");
+  rotor_set_conf(rot, "retry", "0");
+
+  int ret = rot_open(rot);
+  if (ret == RIG_OK) {
+    azimuth_t azimuth;
+    elevation_t elevation;
+    ret = rot_get_position(rot, &azimuth, &elevation);
+    if (ret != RIG_OK) {
+      rot_close(rot); // The port opened, but nothing answers
+    }
+  }
+  if (ret != RIG_OK) {
+    DEBUG_PRINT("rotor_open: %s: %s\n", settings->device, rigerror(ret));
+    rot_cleanup(rot);
+    return NULL;
+  }
+  return rot;
+}
+
+static void rotor_close(void) {
+  pthread_mutex_lock(&g_rot_lock);
+  if (g_rot) {
+    rot_close(g_rot);
+    rot_cleanup(g_rot);
+    g_rot = NULL;
+  }
+  __atomic_store_n(&g_connected, false, __ATOMIC_RELEASE);
+  __atomic_store_n(&g_have_position, false, __ATOMIC_RELEASE);
+  __atomic_store_n(&g_moving, false, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&g_rot_lock);
+}
+
+// Read the position into the cache; false if the rotor didn't answer
+static bool rotor_read(double *azimuth) {
+  azimuth_t az;
+  elevation_t el;
+  pthread_mutex_lock(&g_rot_lock);
+  int ret = g_rot ? rot_get_position(g_rot, &az, &el) : -1;
+  pthread_mutex_unlock(&g_rot_lock);
+  if (ret != RIG_OK) {
+    return false;
+  }
+
+  double elevation = el;
+  *azimuth = az;
+  __atomic_store(&g_azimuth, azimuth, __ATOMIC_RELAXED);
+  __atomic_store(&g_elevation, &elevation, __ATOMIC_RELAXED);
+  __atomic_store_n(&g_have_position, true, __ATOMIC_RELEASE);
+  return true;
+}
+
+// Wake the poll thread now; after a turn, keep it fast until it stops
+static void rotor_kick(bool turning) {
+  pthread_mutex_lock(&g_poll_mutex);
+  g_poll_kick = true;
+  if (turning) {
+    g_turn_pending = true;
+    g_turn_started_ms = rotor_now_ms();
+  }
+  pthread_cond_signal(&g_poll_wake);
+  pthread_mutex_unlock(&g_poll_mutex);
+}
+
+// Wait up to ms for a kick or a stop
+static void rotor_wait(int ms) {
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_sec += ms / 1000;
+  deadline.tv_nsec += (long)(ms % 1000) * 1000000L;
+  if (deadline.tv_nsec >= 1000000000L) {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000L;
+  }
+
+  pthread_mutex_lock(&g_poll_mutex);
+  int rc = 0;
+  while (!g_poll_kick && g_polling && rc == 0) {
+    rc = pthread_cond_timedwait(&g_poll_wake, &g_poll_mutex, &deadline);
+  }
+  g_poll_kick = false;
+  pthread_mutex_unlock(&g_poll_mutex);
+}
+
+// Whether a commanded turn is still expected to start or finish
+static bool rotor_turn_pending(bool moving) {
+  pthread_mutex_lock(&g_poll_mutex);
+  if (g_turn_pending && !moving &&
+      rotor_now_ms() - g_turn_started_ms >= ROTOR_START_MS) {
+    g_turn_pending = false; // Already there, or it won't turn
+  }
+  bool pending = g_turn_pending;
+  pthread_mutex_unlock(&g_poll_mutex);
+  return pending;
+}
+
+// ============================================================================
+// Poll Thread
+// ============================================================================
+
+static void *rotor_poll_func(void *arg) {
+  (void)arg;
+  hampod_metrics_name_thread("rotor-poll");
+
+  const RotorSettings *settings = config_get_rotor();
+  int fast_ms = settings->poll_fast_ms > 0 ? settings->poll_fast_ms
+                                           : CONFIG_DEFAULT_ROTOR_POLL_FAST_MS;
+  int idle_ms = settings->poll_idle_ms > 0 ? settings->poll_idle_ms
+                                           : CONFIG_DEFAULT_ROTOR_POLL_IDLE_MS;
+  double last_azimuth = -1.0;
+  int still_polls = 0;
+  int fail_count = 0;
+
+  while (g_polling) {
+    if (!rotor_is_connected()) {
+      ROT *rot = rotor_open(settings);
+      idle_note_wakeup(rot != NULL);
+      if (rot == NULL) {
+        rotor_wait(idle_stretch_ms(ROTOR_RECONNECT_MS, ROTOR_IDLE_MODE_MS));
+        continue;
+      }
+      pthread_mutex_lock(&g_rot_lock);
+      g_rot = rot;
+      __atomic_store_n(&g_connected, true, __ATOMIC_RELEASE);
+      pthread_mutex_unlock(&g_rot_lock);
+      printf("rotor: Connected on %s\n", settings->device);
+      last_azimuth = -1.0;
+      fail_count = 0;
+    }
+
+    double azimuth;
+    bool moved = false;
+    if (rotor_read(&azimuth)) {
+      fail_count = 0;
+      double turned = azimuth - last_azimuth;
+      moved = last_azimuth >= 0 && (turned >= ROTOR_MOVE_DEGREES ||
+                                    turned <= -ROTOR_MOVE_DEGREES);
+      last_azimuth = azimuth;
+      if (moved) {
+        still_polls = 0;
+        __atomic_store_n(&g_moving, true, __ATOMIC_RELAXED);
+      } else if (rotor_is_moving() && ++still_polls >= ROTOR_STILL_POLLS) {
+        __atomic_store_n(&g_moving, false, __ATOMIC_RELAXED);
+        pthread_mutex_lock(&g_poll_mutex);
+        g_turn_pending = false;
+        pthread_mutex_unlock(&g_poll_mutex);
+        DEBUG_PRINT("rotor: At rest at %.0f degrees\n", azimuth);
+        if (g_stop_callback) {
+          g_stop_callback(azimuth);
+        }
+      }
+    } else if (++fail_count >= ROTOR_FAIL_THRESHOLD) {
+      printf("rotor: %d failed reads, disconnected\n", fail_count);
+      rotor_close();
+      continue;
+    }
+
+    // Fast while it turns or is about to, slow while it stands still
+    bool moving = rotor_is_moving();
+    bool pending = rotor_turn_pending(moving);
+    idle_note_wakeup(moved || pending);
+    rotor_wait(moving || pending || fail_count > 0
+                   ? fast_ms
+                   : idle_stretch_ms(idle_ms, ROTOR_IDLE_MODE_MS));
+  }
+  return NULL;
+}
+
+// ============================================================================
+// Lifecycle
+// ============================================================================
+
+int rotor_init(RotorStopCallback on_stop) {
+  const RotorSettings *settings = config_get_rotor();
+  if (settings->model <= 0 || g_configured) {
+    return -1;
+  }
+
+  g_stop_callback = on_stop;
+  if (device_worker_start(&g_worker) != 0) {
+    return -1;
+  }
+  g_polling = true;
+  if (pthread_create(&g_poll_thread, NULL, rotor_poll_func, NULL) != 0) {
+    fprintf(stderr, "rotor_init: pthread_create failed\n");
+    g_polling = false;
+    device_worker_stop(&g_worker);
+    return -1;
+  }
+
+  g_configured = true;
+  printf("rotor: Model %d on %s\n", settings->model, settings->device);
+  return 0;
+}
+
+void rotor_cleanup(void) {
+  if (!g_configured) {
+    return;
+  }
+  device_worker_stop(&g_worker);
+
+  pthread_mutex_lock(&g_poll_mutex);
+  g_polling = false;
+  pthread_cond_signal(&g_poll_wake);
+  pthread_mutex_unlock(&g_poll_mutex);
+  pthread_join(g_poll_thread, NULL);
+
+  rotor_close();
+  g_configured = false;
+}
+
+bool rotor_is_configured(void) { return g_configured; }
+
+bool rotor_is_connected(void) {
+  return __atomic_load_n(&g_connected, __ATOMIC_ACQUIRE);
+}
+
+// ============================================================================
+// Cached State
+// ============================================================================
+
+bool rotor_get_position(double *azimuth, double *elevation) {
+  if (!__atomic_load_n(&g_have_position, __ATOMIC_ACQUIRE)) {
+    return false;
+  }
+  if (azimuth) {
+    __atomic_load(&g_azimuth, azimuth, __ATOMIC_RELAXED);
+  }
+  if (elevation) {
+    __atomic_load(&g_elevation, elevation, __ATOMIC_RELAXED);
+  }
+  return true;
+}
+
+bool rotor_is_moving(void) {
+  return __atomic_load_n(&g_moving, __ATOMIC_RELAXED);
+}
+
+// ============================================================================
+// Commands
+// ============================================================================
+
+int rotor_submit(RotorCommandKey key, DeviceCommandFn run,
+                 DeviceCommandDone done, const void *arg, size_t arg_size) {
+  if (!g_configured) {
+    return -1;
+  }
+  // Every rotor command is the user's, so they share one priority
+  return device_worker_submit(&g_worker, 0, key, run, done, arg, arg_size);
+}
+
+int rotor_set_azimuth(double azimuth) {
+  double elevation = 0.0;
+  rotor_get_position(NULL, &elevation);
+
+  pthread_mutex_lock(&g_rot_lock);
+  int ret = g_rot ? rot_set_position(g_rot, (azimuth_t)azimuth,
+                                     (elevation_t)elevation)
+                  : -1;
+  pthread_mutex_unlock(&g_rot_lock);
+  if (ret != RIG_OK) {
+    DEBUG_PRINT("rotor_set_azimuth: %.0f failed (%d)\n", azimuth, ret);
+    return -1;
+  }
+  rotor_kick(true);
+  return 0;
+}
+
+int rotor_halt(void) {
+  pthread_mutex_lock(&g_rot_lock);
+  int ret = g_rot ? rot_stop(g_rot) : -1;
+  pthread_mutex_unlock(&g_rot_lock);
+  if (ret != RIG_OK) {
+    DEBUG_PRINT("rotor_halt: Failed (%d)\n", ret);
+    return -1;
+  }
+  rotor_kick(false); // Poll now, to hear where it stopped
+  return 0;
+}
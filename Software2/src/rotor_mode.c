@@ -0,0 +1,175 @@
+/**
+ * @file rotor_mode.c
+ * @brief Keypad context for the antenna rotor
+ */
+
+#include "rotor_mode.h"
+#include "comm.h"
+#include "hampod_core.h"
+#include "rotor.h"
+#include "speech.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ============================================================================
+// State (keypad thread only)
+// ============================================================================
+
+#define BEARING_DIGITS 3
+
+static bool g_active = false;
+static char g_bearing[BEARING_DIGITS + 1];
+static int g_bearing_len = 0;
+
+// ============================================================================
+// Internal Functions
+// ============================================================================
+
+static int round_degrees(double degrees) {
+  int rounded = (int)(degrees + 0.5);
+  return rounded >= 360 ? rounded - 360 : rounded;
+}
+
+static void clear_bearing(void) {
+  memset(g_bearing, 0, sizeof(g_bearing));
+  g_bearing_len = 0;
+}
+
+static void announce_position(void) {
+  double azimuth = 0;
+  char text[64];
+
+  if (!rotor_is_connected() || !rotor_get_position(&azimuth, NULL)) {
+    speech_say_text("Rotor not connected");
+    return;
+  }
+  snprintf(text, sizeof(text), "%s %d degrees",
+           rotor_is_moving() ? "Turning, at" : "Rotor at",
+           round_degrees(azimuth));
+  speech_say_text(text);
+}
+
+/**
+ * @brief Rotor command: turn to a bearing (run on the rotor worker)
+ */
+static int run_turn(void *arg) {
+  return rotor_set_azimuth(*(const double *)arg);
+}
+
+/**
+ * @brief Rotor command: stop turning (run on the rotor worker)
+ */
+static int run_halt(void *arg) {
+  (void)arg;
+  return rotor_halt();
+}
+
+static void turn_done(int result, void *arg) {
+  char text[64];
+
+  // A turn superseded by a newer one or a stop is not a failure
+  if (result == DEVICE_CMD_CANCELLED) {
+    return;
+  }
+  if (result != 0) {
+    speech_say_text_priority("Rotor failed", SPEECH_URGENT);
+    return;
+  }
+  snprintf(text, sizeof(text), "Turning to %d degrees",
+           round_degrees(*(const double *)arg));
+  speech_say_text(text);
+}
+
+static void halt_done(int result, void *arg) {
+  (void)arg;
+  if (result == DEVICE_CMD_CANCELLED) {
+    return;
+  }
+  speech_say_text_priority(result == 0 ? "Rotor stopped" : "Rotor failed",
+                           result == 0 ? SPEECH_INTERACTIVE : SPEECH_URGENT);
+}
+
+static void submit_turn(void) {
+  int bearing = atoi(g_bearing);
+  clear_bearing();
+
+  if (bearing > 360) {
+    speech_say_text("Invalid bearing");
+    return;
+  }
+  double azimuth = bearing;
+  DEBUG_PRINT("rotor_mode: turn to %d\n", bearing);
+  if (rotor_submit(ROTOR_KEY_POSITION, run_turn, turn_done, &azimuth,
+                   sizeof(azimuth)) != 0) {
+    speech_say_text_priority("Rotor busy", SPEECH_URGENT);
+  }
+}
+
+static void submit_halt(void) {
+  DEBUG_PRINT("rotor_mode: halt\n");
+  if (rotor_submit(ROTOR_KEY_POSITION, run_halt, halt_done, NULL, 0) != 0) {
+    speech_say_text_priority("Rotor busy", SPEECH_URGENT);
+  }
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+void rotor_mode_enter(void) {
+  g_active = true;
+  clear_bearing();
+  announce_position();
+}
+
+void rotor_mode_exit(void) {
+  g_active = false;
+  clear_bearing();
+}
+
+bool rotor_mode_is_active(void) { return g_active; }
+
+bool rotor_mode_handle_key(char key, bool is_hold) {
+  if (!g_active || is_hold) {
+    return false;
+  }
+
+  if (key >= '0' && key <= '9') {
+    if (g_bearing_len < BEARING_DIGITS) {
+      char clip[32];
+      g_bearing[g_bearing_len++] = key;
+      snprintf(clip, sizeof(clip), "pregen_audio/%c", key);
+      comm_play_echo(clip);
+    }
+    return true;
+  }
+
+  if (key == '#') {
+    if (g_bearing_len > 0) {
+      submit_turn();
+    } else {
+      announce_position();
+    }
+    return true;
+  }
+
+  if (key == '*') {
+    if (g_bearing_len > 0) {
+      clear_bearing();
+      speech_say_text("Cleared");
+    } else {
+      submit_halt();
+    }
+    return true;
+  }
+
+  return false;
+}
+
+void rotor_mode_on_stop(double azimuth) {
+  char text[64];
+  snprintf(text, sizeof(text), "Rotor at %d degrees", round_degrees(azimuth));
+  speech_say_text_priority(text, SPEECH_BACKGROUND);
+}
@@ -0,0 +1,307 @@
+/**
+ * @file scan.c
+ * @brief Scan implementation
+ */
+
+#include "scan.h"
+#include "announce.h"
+#include "band_stack.h"
+#include "config.h"
+#include "hampod_core.h"
+#include "radio.h"
+#include "radio_queries.h"
+#include "radio_state.h"
+#include "radio_worker.h"
+#include "speech.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+
+// ============================================================================
+// State
+// ============================================================================
+
+#define SCAN_PROGRESS_MS 2000 // Between progress announcements
+
+// One step, run on the radio worker
+typedef struct {
+  double next_hz;      // Channel to set after the reading
+  double level;        // S-meter reading, dB relative to S9
+  unsigned generation; // Scan it belongs to
+  int threshold_db;    // Hit at or above this
+  bool measure;        // Read the S-meter first (not on the first step)
+  bool hit;            // Reading at or above the threshold
+} ScanStep;
+
+// Guarded by g_scan_mutex
+static bool g_active = false;
+static unsigned g_generation = 0; // Bumped by each start and stop
+static ScanSource g_source = SCAN_BAND;
+static ScanSettings g_settings;
+static double g_low_hz = 0;   // Band being scanned
+static double g_high_hz = 0;
+static int g_memory = -1;     // Memory being scanned
+static double g_freq = -1;    // Channel set last, or where the scan began
+static bool g_on_channel = false; // g_freq is a channel, not the start
+static bool g_step_pending = false;
+static long long g_set_ms = 0; // When g_freq was set
+static long long g_progress_ms = 0;
+
+static bool g_thread_running = false; // Guarded by g_control_mutex
+static pthread_t g_scan_thread;
+static pthread_mutex_t g_scan_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_scan_wake = PTHREAD_COND_INITIALIZER;
+
+// Held from stopping the old scan thread to starting the new one, so a
+// restarted scan never runs beside the scan it replaces
+static pthread_mutex_t g_control_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// ============================================================================
+// Internal Functions
+// ============================================================================
+
+static long long now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Channel after g_freq. Call with g_scan_mutex held.
+static double next_channel(void) {
+  if (g_source == SCAN_BAND) {
+    return scan_next_channel(g_freq, g_low_hz, g_high_hz, g_settings.step_hz);
+  }
+
+  g_memory = (g_memory + 1) % band_stack_count();
+  BandMemory memory;
+  band_stack_get(g_memory, &memory);
+  return memory.freq_hz;
+}
+
+/**
+ * @brief Radio command: read the channel just listened to, then set the
+ *        next one (run on the radio worker)
+ */
+static int run_step(void *arg) {
+  ScanStep *step = arg;
+
+  if (step->measure) {
+    if (radio_read_meter(RADIO_METER_SMETER, &step->level) != 0) {
+      return -1;
+    }
+    step->hit = step->level >= step->threshold_db;
+    if (step->hit) {
+      return 0; // Stay on it
+    }
+  }
+
+  pthread_mutex_lock(&g_scan_mutex);
+  bool current = g_active && step->generation == g_generation;
+  pthread_mutex_unlock(&g_scan_mutex);
+  if (!current) {
+    return 0; // Stopped while it waited for the meter
+  }
+
+  if (radio_set_frequency(step->next_hz) != 0) {
+    return -1;
+  }
+  // The last reading was of the old channel
+  radio_state_invalidate(RADIO_FIELD_SMETER);
+  return 0;
+}
+
+static void step_done(int result, void *arg) {
+  const ScanStep *step = arg;
+  if (result == RADIO_CMD_CANCELLED) {
+    return; // Stopped
+  }
+
+  pthread_mutex_lock(&g_scan_mutex);
+  if (!g_active || step->generation != g_generation) {
+    pthread_mutex_unlock(&g_scan_mutex);
+    return;
+  }
+  g_step_pending = false;
+
+  long long now = now_ms();
+  double freq = g_freq;
+  bool progress = false;
+  if (result != 0 || step->hit) {
+    g_active = false;
+  } else {
+    g_freq = freq = step->next_hz;
+    g_on_channel = true;
+    g_set_ms = now;
+    if (now - g_progress_ms >= SCAN_PROGRESS_MS) {
+      g_progress_ms = now;
+      progress = true;
+    }
+  }
+  pthread_cond_signal(&g_scan_wake);
+  pthread_mutex_unlock(&g_scan_mutex);
+
+  Announcement a;
+  announce_init(&a);
+  if (result != 0) {
+    DEBUG_PRINT("scan: Step failed, stopping\n");
+    announce_text(&a, "Scan stopped, radio not responding");
+    announce_say_latest(&a, SPEECH_URGENT, SPEECH_SLOT_SCAN, true);
+  } else if (step->hit) {
+    DEBUG_PRINT("scan: Signal %.0f dB on %.0f Hz\n", step->level, freq);
+    char buffer[32];
+    band_stack_remember(freq); // main.c skips the poller while scanning
+    announce_text(&a, "Signal");
+    announce_frequency(&a, freq);
+    announce_text(&a, radio_get_smeter_string(buffer, sizeof(buffer)));
+    announce_say_latest(&a, SPEECH_INTERACTIVE, SPEECH_SLOT_SCAN, true);
+  } else if (progress) {
+    announce_frequency(&a, freq);
+    announce_say_latest(&a, SPEECH_BACKGROUND, SPEECH_SLOT_SCAN, false);
+  }
+}
+
+static void *scan_thread_func(void *arg) {
+  (void)arg;
+  DEBUG_PRINT("scan: Started\n");
+
+  pthread_mutex_lock(&g_scan_mutex);
+  while (g_active) {
+    if (g_step_pending) {
+      pthread_cond_wait(&g_scan_wake, &g_scan_mutex);
+      continue;
+    }
+
+    // Listen to the channel for the dwell, then queue the next step
+    long long due = g_set_ms + g_settings.dwell_ms;
+    if (g_on_channel && now_ms() < due) {
+      struct timespec wake;
+      clock_gettime(CLOCK_REALTIME, &wake);
+      long long wait_ms = due - now_ms();
+      wake.tv_sec += wait_ms / 1000;
+      wake.tv_nsec += (wait_ms % 1000) * 1000000L;
+      if (wake.tv_nsec >= 1000000000L) {
+        wake.tv_sec++;
+        wake.tv_nsec -= 1000000000L;
+      }
+      pthread_cond_timedwait(&g_scan_wake, &g_scan_mutex, &wake);
+      continue;
+    }
+
+    ScanStep step = {next_channel(), 0.0, g_generation,
+                     g_settings.threshold_db, g_on_channel, false};
+    g_step_pending = true;
+    pthread_mutex_unlock(&g_scan_mutex);
+
+    int queued = radio_worker_submit(RADIO_CMD_BACKGROUND, RADIO_KEY_SCAN,
+                                     run_step, step_done, &step,
+                                     sizeof(step));
+
+    pthread_mutex_lock(&g_scan_mutex);
+    if (queued != 0 && step.generation == g_generation) {
+      g_step_pending = false;
+      g_set_ms = now_ms(); // Queue full: try again after a dwell
+    }
+  }
+  pthread_mutex_unlock(&g_scan_mutex);
+
+  DEBUG_PRINT("scan: Stopped\n");
+  return NULL;
+}
+
+// Stop and join the scan thread. Call with g_control_mutex held.
+static void stop_thread(void) {
+  pthread_mutex_lock(&g_scan_mutex);
+  g_active = false;
+  g_generation++;
+  pthread_cond_signal(&g_scan_wake);
+  pthread_mutex_unlock(&g_scan_mutex);
+
+  if (g_thread_running) {
+    pthread_join(g_scan_thread, NULL);
+    g_thread_running = false;
+  }
+  radio_worker_cancel(RADIO_KEY_SCAN);
+}
+
+// ============================================================================
+// Channels
+// ============================================================================
+
+double scan_next_channel(double freq_hz, double low_hz, double high_hz,
+                         int step_hz) {
+  long long step = step_hz > 0 ? step_hz : 1;
+  long long first = ((long long)low_hz + step - 1) / step * step;
+  if (first > high_hz) {
+    return low_hz; // Step wider than the range
+  }
+
+  long long next = ((long long)freq_hz / step + 1) * step;
+  if (next < first || next > high_hz) {
+    return (double)first;
+  }
+  return (double)next;
+}
+
+// ============================================================================
+// Control
+// ============================================================================
+
+int scan_start(ScanSource source) {
+  double freq = radio_get_frequency();
+
+  pthread_mutex_lock(&g_control_mutex);
+  stop_thread();
+
+  pthread_mutex_lock(&g_scan_mutex);
+  g_source = source;
+  g_settings = *config_get_scan();
+  if (source == SCAN_BAND) {
+    int band = band_stack_find(freq);
+    if (freq <= 0 || !band_stack_range(band, &g_low_hz, &g_high_hz)) {
+      pthread_mutex_unlock(&g_scan_mutex);
+      pthread_mutex_unlock(&g_control_mutex);
+      return -1;
+    }
+  } else {
+    // From the band above the current one
+    g_memory = band_stack_step(freq > 0 ? freq : 0, 1) - 1;
+  }
+  // The first step sets the channel after the current frequency at once,
+  // without a reading
+  g_freq = freq;
+  g_on_channel = false;
+  g_step_pending = false;
+  g_progress_ms = now_ms();
+  g_active = true;
+  pthread_mutex_unlock(&g_scan_mutex);
+
+  int result = 0;
+  if (pthread_create(&g_scan_thread, NULL, scan_thread_func, NULL) == 0) {
+    g_thread_running = true;
+  } else {
+    fprintf(stderr, "scan_start: pthread_create failed\n");
+    pthread_mutex_lock(&g_scan_mutex);
+    g_active = false;
+    pthread_mutex_unlock(&g_scan_mutex);
+    result = -1;
+  }
+  pthread_mutex_unlock(&g_control_mutex);
+
+  DEBUG_PRINT("scan_start: %s from %.0f Hz\n",
+              source == SCAN_BAND ? "band" : "memories", freq);
+  return result;
+}
+
+void scan_stop(void) {
+  pthread_mutex_lock(&g_control_mutex);
+  stop_thread();
+  pthread_mutex_unlock(&g_control_mutex);
+}
+
+bool scan_is_active(void) {
+  pthread_mutex_lock(&g_scan_mutex);
+  bool active = g_active;
+  pthread_mutex_unlock(&g_scan_mutex);
+  return active;
+}
@@ -0,0 +1,87 @@
+/**
+ * @file serial_latency.c
+ * @brief Low-latency tuning of a radio's USB-serial adapter
+ */
+
+#include "serial_latency.h"
+#include "hampod_core.h"
+
+#include <linux/serial.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+
+// ============================================================================
+// Internal Functions
+// ============================================================================
+
+static int read_timer(const char *path) {
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    return -1;
+  }
+  int ms = -1;
+  if (fscanf(f, "%d", &ms) != 1) {
+    ms = -1;
+  }
+  fclose(f);
+  return ms;
+}
+
+static bool write_timer(const char *path, int ms) {
+  FILE *f = fopen(path, "w");
+  if (!f) {
+    return false;
+  }
+  bool ok = fprintf(f, "%d\n", ms) > 0;
+  return fclose(f) == 0 && ok;
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+bool serial_latency_tune(SerialLatency *saved, const char *sysfs_tty,
+                         const char *device, int fd) {
+  memset(saved, 0, sizeof(*saved));
+  const char *name = strrchr(device, '/');
+  name = name ? name + 1 : device;
+
+  // The USB-serial driver's setting, under the tty's device (FTDI only)
+  char path[sizeof(saved->timer_path)];
+  snprintf(path, sizeof(path), "%s/%s/device/latency_timer", sysfs_tty,
+           name);
+  int timer_ms = read_timer(path);
+  if (timer_ms > SERIAL_LATENCY_TIMER_MS) {
+    if (write_timer(path, SERIAL_LATENCY_TIMER_MS)) {
+      snprintf(saved->timer_path, sizeof(saved->timer_path), "%s", path);
+      saved->timer_ms = timer_ms;
+    } else {
+      DEBUG_PRINT("serial_latency: Can't write %s\n", path);
+    }
+  }
+
+  struct serial_struct serial;
+  if (fd >= 0 && ioctl(fd, TIOCGSERIAL, &serial) == 0 &&
+      !(serial.flags & ASYNC_LOW_LATENCY)) {
+    serial.flags |= ASYNC_LOW_LATENCY;
+    saved->low_latency = ioctl(fd, TIOCSSERIAL, &serial) == 0;
+  }
+
+  return saved->timer_path[0] != '\0' || saved->low_latency;
+}
+
+void serial_latency_restore(SerialLatency *saved, int fd) {
+  if (saved->timer_path[0] != '\0') {
+    // Gone with an unplugged adapter; then there is nothing to put back
+    write_timer(saved->timer_path, saved->timer_ms);
+    saved->timer_path[0] = '\0';
+  }
+
+  struct serial_struct serial;
+  if (saved->low_latency && fd >= 0 && ioctl(fd, TIOCGSERIAL, &serial) == 0) {
+    serial.flags &= ~ASYNC_LOW_LATENCY;
+    ioctl(fd, TIOCSSERIAL, &serial);
+  }
+  saved->low_latency = false;
+}
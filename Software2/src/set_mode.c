@@ -6,8 +6,11 @@
  */
 
 #include "set_mode.h"
+#include "announce.h"
 #include "radio_setters.h"
 #include "radio_queries.h"
+#include "radio_state.h"
+#include "radio_worker.h"
 #include "speech.h"
 #include "hampod_core.h"
 #include "comm.h"
@@ -30,6 +33,10 @@ static SetModeParameter g_current_param = SET_PARAM_NONE;
 static char g_value_buffer[MAX_VALUE_DIGITS + 1];
 static int g_value_len = 0;
 
+// How old a prefetched value may be and still be announced on selection;
+// past the getters' tolerance it is re-read and corrected if it changed
+#define CACHED_VALUE_MAX_MS 60000
+
 // ============================================================================
 // Internal Helpers
 // ============================================================================
@@ -68,190 +75,470 @@ static const char* param_name(SetModeParameter param) {
     }
 }
 
-static void announce_current_value(SetModeParameter param) {
-    char buffer[64];
+// "<label> <value> <unit>", or "<label> not available"
+static void add_reading(Announcement *a, const char *label, int value,
+                        AnnounceUnit unit) {
+    announce_text(a, label);
+    if (value < 0) {
+        announce_text(a, "not available");
+        return;
+    }
+    announce_number(a, value);
+    announce_unit(a, unit);
+}
+
+// A parameter's value as announced on selection
+typedef struct {
+    SetModeParameter param;
+    bool announced; // From the cache; only a different live value is said
+    bool changed;   // Set by run_read_value()
+    int on;
     int value;
-    
+} ParamReading;
+
+// The cached fields a parameter's value is read from, on being
+// RADIO_FIELD_COUNT if it has no switch. Mode isn't cached by name, so
+// it is always read on the worker.
+static bool param_fields(SetModeParameter param, RadioField *value,
+                         RadioField *on) {
+    *on = RADIO_FIELD_COUNT;
     switch (param) {
+        case SET_PARAM_POWER:       *value = RADIO_FIELD_POWER; return true;
+        case SET_PARAM_MIC_GAIN:    *value = RADIO_FIELD_MIC_GAIN; return true;
+        case SET_PARAM_AGC:         *value = RADIO_FIELD_AGC; return true;
+        case SET_PARAM_PREAMP:      *value = RADIO_FIELD_PREAMP; return true;
+        case SET_PARAM_ATTENUATION: *value = RADIO_FIELD_ATT; return true;
+        case SET_PARAM_COMPRESSION:
+            *value = RADIO_FIELD_COMP;
+            *on = RADIO_FIELD_COMP_ON;
+            return true;
+        case SET_PARAM_NB:
+            *value = RADIO_FIELD_NB_LEVEL;
+            *on = RADIO_FIELD_NB_ON;
+            return true;
+        case SET_PARAM_NR:
+            *value = RADIO_FIELD_NR_LEVEL;
+            *on = RADIO_FIELD_NR_ON;
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Fill a reading from what set_mode_enter() prefetched. False if a field
+// isn't cached; *stale if one is older than the getters would accept.
+static bool cached_reading(ParamReading *reading, bool *stale) {
+    RadioField fields[2];
+    int *values[2] = {&reading->value, &reading->on};
+
+    if (!param_fields(reading->param, &fields[0], &fields[1])) {
+        return false;
+    }
+    *stale = false;
+    for (int i = 0; i < 2; i++) {
+        double cached;
+        if (fields[i] == RADIO_FIELD_COUNT) {
+            continue;
+        }
+        if (!radio_state_get_within(fields[i], CACHED_VALUE_MAX_MS,
+                                    &cached)) {
+            return false;
+        }
+        *values[i] = (int)cached;
+        if (!radio_state_get(fields[i], &cached)) {
+            *stale = true;
+        }
+    }
+    return true;
+}
+
+static void announce_value(const ParamReading *reading) {
+    Announcement a;
+    int value = reading->value;
+
+    announce_init(&a);
+    switch (reading->param) {
         case SET_PARAM_POWER:
-            value = radio_get_power();
-            if (value >= 0) {
-                snprintf(buffer, sizeof(buffer), "Power %d percent", value);
-            } else {
-                snprintf(buffer, sizeof(buffer), "Power not available");
-            }
+            add_reading(&a, "Power", value, ANNOUNCE_UNIT_PERCENT);
             break;
             
         case SET_PARAM_MIC_GAIN:
-            value = radio_get_mic_gain();
-            if (value >= 0) {
-                snprintf(buffer, sizeof(buffer), "Mic gain %d percent", value);
-            } else {
-                snprintf(buffer, sizeof(buffer), "Mic gain not available");
-            }
+            add_reading(&a, "Mic gain", value, ANNOUNCE_UNIT_PERCENT);
             break;
             
         case SET_PARAM_COMPRESSION:
-            value = radio_get_compression();
             if (value >= 0) {
-                bool enabled = radio_get_compression_enabled();
-                snprintf(buffer, sizeof(buffer), "Compression %s, level %d", 
-                         enabled ? "on" : "off", value);
+                announce_switch(&a, "Compression", reading->on > 0, value);
             } else {
-                snprintf(buffer, sizeof(buffer), "Compression not available");
+                announce_text(&a, "Compression not available");
             }
             break;
             
         case SET_PARAM_NB:
-            {
-                bool enabled = radio_get_nb_enabled();
-                int level = radio_get_nb_level();
-                snprintf(buffer, sizeof(buffer), "Noise blanker %s, level %d", 
-                         enabled ? "on" : "off", level >= 0 ? level : 0);
-            }
+            announce_switch(&a, "Noise blanker", reading->on > 0, value);
             break;
             
         case SET_PARAM_NR:
-            {
-                bool enabled = radio_get_nr_enabled();
-                int level = radio_get_nr_level();
-                snprintf(buffer, sizeof(buffer), "Noise reduction %s, level %d", 
-                         enabled ? "on" : "off", level >= 0 ? level : 0);
-            }
+            announce_switch(&a, "Noise reduction", reading->on > 0, value);
             break;
             
         case SET_PARAM_AGC:
-            snprintf(buffer, sizeof(buffer), "A G C %s", radio_get_agc_string());
+            announce_text(&a, "A G C");
+            announce_word(&a, radio_agc_speed_name((AgcSpeed)value));
             break;
             
         case SET_PARAM_PREAMP:
-            value = radio_get_preamp();
             if (value == 0) {
-                snprintf(buffer, sizeof(buffer), "Pre amp off");
-            } else if (value == 1) {
-                snprintf(buffer, sizeof(buffer), "Pre amp 1");
-            } else if (value == 2) {
-                snprintf(buffer, sizeof(buffer), "Pre amp 2");
+                announce_text(&a, "Pre amp off");
+            } else if (value == 1 || value == 2) {
+                announce_text(&a, "Pre amp");
+                announce_number(&a, value);
             } else {
-                snprintf(buffer, sizeof(buffer), "Pre amp not available");
+                announce_text(&a, "Pre amp not available");
             }
             break;
             
         case SET_PARAM_ATTENUATION:
-            value = radio_get_attenuation();
             if (value == 0) {
-                snprintf(buffer, sizeof(buffer), "Attenuation off");
-            } else if (value > 0) {
-                snprintf(buffer, sizeof(buffer), "Attenuation %d D B", value);
+                announce_text(&a, "Attenuation off");
             } else {
-                snprintf(buffer, sizeof(buffer), "Attenuation not available");
+                add_reading(&a, "Attenuation", value, ANNOUNCE_UNIT_DECIBELS);
             }
             break;
             
         case SET_PARAM_MODE:
-            {
-                const char* mode = radio_get_mode_string();
-                snprintf(buffer, sizeof(buffer), "Mode %s", mode);
-            }
+            // Only announced from the worker: this asks the radio
+            announce_text(&a, "Mode");
+            announce_mode(&a, radio_get_mode_string());
             break;
             
         default:
-            snprintf(buffer, sizeof(buffer), "Select parameter");
+            announce_text(&a, "Select parameter");
             break;
     }
     
-    speech_say_text(buffer);
+    announce_say(&a, SPEECH_INTERACTIVE);
 }
 
-static void apply_value(void) {
-    int value = get_value_as_int();
+static void announce_failure(void) {
+    if (config_get_key_beep_enabled()) {
+        comm_play_beep(COMM_BEEP_ERROR);
+    }
+    speech_say_text_priority("Failed", SPEECH_URGENT);
+}
+
+// A command the radio ran and failed. One it can't do at all is named.
+static void announce_command_failure(SetModeParameter param, int result) {
+    if (result != RADIO_ERR_UNAVAILABLE) {
+        announce_failure();
+        return;
+    }
+
     char buffer[64];
-    int result = -1;
-    
-    switch (g_current_param) {
+    snprintf(buffer, sizeof(buffer), "%s not available", param_name(param));
+    if (config_get_key_beep_enabled()) {
+        comm_play_beep(COMM_BEEP_ERROR);
+    }
+    speech_say_text_priority(buffer, SPEECH_URGENT);
+}
+
+// Leave Set Mode without announcing it
+static void leave_set_mode(void) {
+    g_state = SET_MODE_OFF;
+    g_current_param = SET_PARAM_NONE;
+    clear_value_buffer();
+}
+
+static RadioCommandKey param_key(SetModeParameter param) {
+    switch (param) {
+        case SET_PARAM_POWER:       return RADIO_KEY_POWER;
+        case SET_PARAM_MIC_GAIN:    return RADIO_KEY_MIC_GAIN;
+        case SET_PARAM_COMPRESSION: return RADIO_KEY_COMPRESSION;
+        case SET_PARAM_NB:          return RADIO_KEY_NB;
+        case SET_PARAM_NR:          return RADIO_KEY_NR;
+        case SET_PARAM_AGC:         return RADIO_KEY_AGC;
+        case SET_PARAM_PREAMP:      return RADIO_KEY_PREAMP;
+        case SET_PARAM_ATTENUATION: return RADIO_KEY_ATTENUATION;
+        default:                    return RADIO_KEY_NONE;
+    }
+}
+
+// ============================================================================
+// Radio Commands (run on the radio worker, see radio_worker.h)
+// ============================================================================
+
+typedef struct {
+    SetModeParameter param;
+    int value;
+} SetCommand;
+
+static int run_apply(void *arg) {
+    const SetCommand *cmd = arg;
+    switch (cmd->param) {
+        case SET_PARAM_POWER:       return radio_set_power(cmd->value);
+        case SET_PARAM_MIC_GAIN:    return radio_set_mic_gain(cmd->value);
+        case SET_PARAM_COMPRESSION: return radio_set_compression(cmd->value);
+        case SET_PARAM_NB:          return radio_set_nb(true, cmd->value);
+        case SET_PARAM_NR:          return radio_set_nr(true, cmd->value);
+        case SET_PARAM_PREAMP:      return radio_set_preamp(cmd->value);
+        case SET_PARAM_ATTENUATION: return radio_set_attenuation(cmd->value);
+        default:                    return -1;
+    }
+}
+
+static void apply_done(int result, void *arg) {
+    const SetCommand *cmd = arg;
+    int value = cmd->value;
+    Announcement a;
+
+    if (result == RADIO_CMD_CANCELLED) {
+        return;
+    }
+    if (result != 0) {
+        announce_command_failure(cmd->param, result);
+        speech_say_text("Set Off");
+        return;
+    }
+
+    announce_init(&a);
+    switch (cmd->param) {
         case SET_PARAM_POWER:
-            if (value >= 0 && value <= 100) {
-                result = radio_set_power(value);
-                if (result == 0) {
-                    snprintf(buffer, sizeof(buffer), "Power set to %d", value);
-                }
-            }
+            announce_label(&a, "Power set to", "Power");
+            announce_number(&a, value);
             break;
-            
         case SET_PARAM_MIC_GAIN:
-            if (value >= 0 && value <= 100) {
-                result = radio_set_mic_gain(value);
-                if (result == 0) {
-                    snprintf(buffer, sizeof(buffer), "Mic gain set to %d", value);
-                }
-            }
+            announce_label(&a, "Mic gain set to", "Mic gain");
+            announce_number(&a, value);
             break;
-            
         case SET_PARAM_COMPRESSION:
-            if (value >= 0 && value <= 100) {
-                result = radio_set_compression(value);
-                if (result == 0) {
-                    snprintf(buffer, sizeof(buffer), "Compression set to %d", value);
-                }
-            }
+            announce_label(&a, "Compression set to", "Compression");
+            announce_number(&a, value);
             break;
-            
         case SET_PARAM_NB:
-            if (value >= 0 && value <= 10) {
-                result = radio_set_nb(true, value);
-                if (result == 0) {
-                    snprintf(buffer, sizeof(buffer), "Noise blanker level %d", value);
-                }
-            }
+            announce_text(&a, "Noise blanker");
+            announce_word(&a, "level");
+            announce_number(&a, value);
             break;
-            
         case SET_PARAM_NR:
-            if (value >= 0 && value <= 10) {
-                result = radio_set_nr(true, value);
-                if (result == 0) {
-                    snprintf(buffer, sizeof(buffer), "Noise reduction level %d", value);
-                }
-            }
+            announce_text(&a, "Noise reduction");
+            announce_word(&a, "level");
+            announce_number(&a, value);
             break;
-            
         case SET_PARAM_PREAMP:
-            if (value >= 0 && value <= 2) {
-                result = radio_set_preamp(value);
-                if (result == 0) {
-                    if (value == 0) {
-                        snprintf(buffer, sizeof(buffer), "Pre amp off");
-                    } else {
-                        snprintf(buffer, sizeof(buffer), "Pre amp %d", value);
-                    }
-                }
+            if (value == 0) {
+                announce_text(&a, "Pre amp off");
+            } else {
+                announce_text(&a, "Pre amp");
+                announce_number(&a, value);
             }
             break;
-            
         case SET_PARAM_ATTENUATION:
-            result = radio_set_attenuation(value);
-            if (result == 0) {
-                if (value == 0) {
-                    snprintf(buffer, sizeof(buffer), "Attenuation off");
-                } else {
-                    snprintf(buffer, sizeof(buffer), "Attenuation %d D B", value);
-                }
+            if (value == 0) {
+                announce_text(&a, "Attenuation off");
+            } else {
+                announce_text(&a, "Attenuation");
+                announce_number(&a, value);
+                announce_unit(&a, ANNOUNCE_UNIT_DECIBELS);
             }
             break;
-            
         default:
             break;
     }
-    
-    if (result == 0) {
-        speech_say_text(buffer);
-    } else {
-        if (config_get_key_beep_enabled()) {
-            comm_play_beep(COMM_BEEP_ERROR);
-        }
-        speech_say_text("Failed");
+    if (a.count > 0) {
+        announce_say(&a, SPEECH_INTERACTIVE);
     }
-    
-    // Return to Normal mode after applying (per spec: [#] submits and exits)
+    speech_say_text("Set Off");
+}
+
+// Toggles read the level on the worker too, to switch on at the same level
+static int run_toggle(void *arg) {
+    const SetCommand *cmd = arg;
+    bool enable = cmd->value != 0;
+    int level;
+
+    switch (cmd->param) {
+        case SET_PARAM_NB:
+            level = radio_get_nb_level();
+            if (level < 0) level = 5;  // Default level
+            return radio_set_nb(enable, level);
+        case SET_PARAM_NR:
+            level = radio_get_nr_level();
+            if (level < 0) level = 5;  // Default level
+            return radio_set_nr(enable, level);
+        case SET_PARAM_COMPRESSION:
+            return radio_set_compression_enabled(enable);
+        default:
+            return -1;
+    }
+}
+
+static void toggle_done(int result, void *arg) {
+    const SetCommand *cmd = arg;
+    bool enable = cmd->value != 0;
+
+    if (result == RADIO_CMD_CANCELLED) {
+        return;
+    }
+    if (result != 0) {
+        announce_command_failure(cmd->param, result);
+        return;
+    }
+
+    switch (cmd->param) {
+        case SET_PARAM_NB:
+            speech_say_text(enable ? "Noise blanker on" : "Noise blanker off");
+            break;
+        case SET_PARAM_NR:
+            speech_say_text(enable ? "Noise reduction on" : "Noise reduction off");
+            break;
+        case SET_PARAM_COMPRESSION:
+            speech_say_text(enable ? "Compression on" : "Compression off");
+            break;
+        default:
+            break;
+    }
+}
+
+static int run_agc(void *arg) {
+    return radio_set_agc_speed(*(const AgcSpeed *)arg);
+}
+
+static void agc_done(int result, void *arg) {
+    AgcSpeed speed = *(const AgcSpeed *)arg;
+
+    if (result == RADIO_CMD_CANCELLED) {
+        return;
+    }
+    if (result != 0) {
+        announce_command_failure(SET_PARAM_AGC, result);
+        return;
+    }
+
+    Announcement a;
+    announce_init(&a);
+    announce_text(&a, "A G C");
+    announce_word(&a, radio_agc_speed_name(speed));
+    announce_say(&a, SPEECH_INTERACTIVE);
+}
+
+// Read a parameter's value live (the getters still answer from the cache
+// while it is fresh) and note whether it differs from the cached one
+static int run_read_value(void *arg) {
+    ParamReading *reading = arg;
+    int on = reading->on;
+    int value = reading->value;
+
+    switch (reading->param) {
+        case SET_PARAM_POWER:
+            reading->value = radio_get_power();
+            break;
+        case SET_PARAM_MIC_GAIN:
+            reading->value = radio_get_mic_gain();
+            break;
+        case SET_PARAM_COMPRESSION:
+            reading->value = radio_get_compression();
+            reading->on = radio_get_compression_enabled();
+            break;
+        case SET_PARAM_NB:
+            reading->value = radio_get_nb_level();
+            reading->on = radio_get_nb_enabled();
+            break;
+        case SET_PARAM_NR:
+            reading->value = radio_get_nr_level();
+            reading->on = radio_get_nr_enabled();
+            break;
+        case SET_PARAM_AGC:
+            reading->value = radio_get_agc_speed();
+            break;
+        case SET_PARAM_PREAMP:
+            reading->value = radio_get_preamp();
+            break;
+        case SET_PARAM_ATTENUATION:
+            reading->value = radio_get_attenuation();
+            break;
+        default:
+            break; // Mode is read as it is announced
+    }
+    reading->changed = reading->on != on || reading->value != value;
+    return 0;
+}
+
+static void read_value_done(int result, void *arg) {
+    const ParamReading *reading = arg;
+
+    if (result == RADIO_CMD_CANCELLED) {
+        return;
+    }
+    // Moved on to something else, or the cached value was right
+    if (g_state != SET_MODE_EDITING || g_current_param != reading->param ||
+        (reading->announced && !reading->changed)) {
+        return;
+    }
+    announce_value(reading);
+}
+
+static int run_cycle_mode(void *arg) {
+    (void)arg;
+    return radio_cycle_mode();
+}
+
+static void cycle_mode_done(int result, void *arg) {
+    (void)arg;
+
+    if (result == RADIO_CMD_CANCELLED) {
+        return;
+    }
+    if (result != 0) {
+        announce_failure();
+        return;
+    }
+
+    Announcement a;
+    announce_init(&a);
+    announce_mode(&a, radio_get_mode_string());
+    announce_say(&a, SPEECH_INTERACTIVE);
+}
+
+// ============================================================================
+// Applying Values
+// ============================================================================
+
+static void apply_value(void) {
+    SetCommand cmd = {g_current_param, get_value_as_int()};
+    bool valid;
+
+    switch (g_current_param) {
+        case SET_PARAM_POWER:
+        case SET_PARAM_MIC_GAIN:
+        case SET_PARAM_COMPRESSION:
+            valid = cmd.value >= 0 && cmd.value <= 100;
+            break;
+        case SET_PARAM_NB:
+        case SET_PARAM_NR:
+            valid = cmd.value >= 0 && cmd.value <= 10;
+            break;
+        case SET_PARAM_PREAMP:
+            valid = cmd.value >= 0 && cmd.value <= 2;
+            break;
+        case SET_PARAM_ATTENUATION:
+            valid = true;
+            break;
+        default:
+            valid = false;
+            break;
+    }
+
+    // Return to Normal mode after applying (per spec: [#] submits and exits).
+    // The worker announces the result, then "Set Off".
+    if (valid && radio_worker_submit(RADIO_CMD_USER, param_key(cmd.param),
+                                     run_apply, apply_done, &cmd,
+                                     sizeof(cmd)) == 0) {
+        leave_set_mode();
+        DEBUG_PRINT("set_mode: Applying %d\n", cmd.value);
+        return;
+    }
+
+    announce_failure();
     set_mode_exit();
 }
 
@@ -265,7 +552,24 @@ static bool select_parameter(SetModeParameter param) {
     clear_value_buffer();
     
     DEBUG_PRINT("set_mode: Selected %s\n", param_name(param));
-    announce_current_value(param);
+
+    // Say the prefetched value at once. If it isn't cached yet or has gone
+    // stale, read it on the worker (after the prefetch, if that is still
+    // running) and say what the radio reports if it differs.
+    ParamReading reading = {param, false, false, 1, -1};
+    bool stale = true;
+    if (cached_reading(&reading, &stale)) {
+        announce_value(&reading);
+        reading.announced = true;
+    }
+    if (stale &&
+        radio_worker_submit(RADIO_CMD_USER, RADIO_KEY_NONE, run_read_value,
+                            read_value_done, &reading,
+                            sizeof(reading)) != 0 &&
+        !reading.announced) {
+        run_read_value(&reading);
+        announce_value(&reading);
+    }
     
     return true;
 }
@@ -274,43 +578,24 @@ static bool select_parameter(SetModeParameter param) {
 // Toggle Handlers (for NB, NR, Compression)
 // ============================================================================
 
-static void toggle_nb(bool enable) {
-    int level = radio_get_nb_level();
-    if (level < 0) level = 5;  // Default level
-    
-    if (radio_set_nb(enable, level) == 0) {
-        speech_say_text(enable ? "Noise blanker on" : "Noise blanker off");
-    } else {
-        if (config_get_key_beep_enabled()) {
-            comm_play_beep(COMM_BEEP_ERROR);
-        }
-        speech_say_text("Failed");
+static void toggle(SetModeParameter param, bool enable) {
+    SetCommand cmd = {param, enable ? 1 : 0};
+    if (radio_worker_submit(RADIO_CMD_USER, param_key(param), run_toggle,
+                            toggle_done, &cmd, sizeof(cmd)) != 0) {
+        announce_failure();
     }
 }
 
+static void toggle_nb(bool enable) {
+    toggle(SET_PARAM_NB, enable);
+}
+
 static void toggle_nr(bool enable) {
-    int level = radio_get_nr_level();
-    if (level < 0) level = 5;  // Default level
-    
-    if (radio_set_nr(enable, level) == 0) {
-        speech_say_text(enable ? "Noise reduction on" : "Noise reduction off");
-    } else {
-        if (config_get_key_beep_enabled()) {
-            comm_play_beep(COMM_BEEP_ERROR);
-        }
-        speech_say_text("Failed");
-    }
+    toggle(SET_PARAM_NR, enable);
 }
 
 static void toggle_compression(bool enable) {
-    if (radio_set_compression_enabled(enable) == 0) {
-        speech_say_text(enable ? "Compression on" : "Compression off");
-    } else {
-        if (config_get_key_beep_enabled()) {
-            comm_play_beep(COMM_BEEP_ERROR);
-        }
-        speech_say_text("Failed");
-    }
+    toggle(SET_PARAM_COMPRESSION, enable);
 }
 
 // ============================================================================
@@ -318,16 +603,9 @@ static void toggle_compression(bool enable) {
 // ============================================================================
 
 static void set_agc(AgcSpeed speed) {
-    if (radio_set_agc_speed(speed) == 0) {
-        const char* names[] = {"Off", "Fast", "Medium", "Slow"};
-        char buffer[32];
-        snprintf(buffer, sizeof(buffer), "A G C %s", names[speed]);
-        speech_say_text(buffer);
-    } else {
-        if (config_get_key_beep_enabled()) {
-            comm_play_beep(COMM_BEEP_ERROR);
-        }
-        speech_say_text("Failed");
+    if (radio_worker_submit(RADIO_CMD_USER, RADIO_KEY_AGC, run_agc, agc_done,
+                            &speed, sizeof(speed)) != 0) {
+        announce_failure();
     }
 }
 
@@ -362,20 +640,28 @@ SetModeParameter set_mode_get_parameter(void) {
 // Mode Entry/Exit
 // ============================================================================
 
+// Read every parameter into the radio state cache in one session, so
+// selecting one announces its value from the cache without waiting on
+// the radio (see select_parameter())
+static int run_read_status(void *arg) {
+    (void)arg;
+    return radio_read_status(NULL) < 0 ? -1 : 0;
+}
+
 void set_mode_enter(void) {
     if (g_state == SET_MODE_OFF) {
         g_state = SET_MODE_IDLE;
         g_current_param = SET_PARAM_NONE;
         clear_value_buffer();
         speech_say_text("Set");
+        radio_worker_submit(RADIO_CMD_BACKGROUND, RADIO_KEY_STATUS,
+                            run_read_status, NULL, NULL, 0);
         DEBUG_PRINT("set_mode_enter: Entered Set Mode\n");
     }
 }
 
 void set_mode_exit(void) {
-    g_state = SET_MODE_OFF;
-    g_current_param = SET_PARAM_NONE;
-    clear_value_buffer();
+    leave_set_mode();
     speech_say_text("Set Off");
     DEBUG_PRINT("set_mode_exit: Exited Set Mode\n");
 }
@@ -572,14 +858,11 @@ bool set_mode_handle_key(char key, bool is_hold, bool is_shifted) {
         
         // Mode-specific: [0] cycles mode
         if (g_current_param == SET_PARAM_MODE && key == '0' && !is_hold) {
-            if (radio_cycle_mode() == 0) {
-                const char* mode = radio_get_mode_string();
-                speech_say_text(mode);
-            } else {
-                if (config_get_key_beep_enabled()) {
-                    comm_play_beep(COMM_BEEP_ERROR);
-                }
-                speech_say_text("Failed");
+            // Each press cycles once more, so never superseded
+            if (radio_worker_submit(RADIO_CMD_USER, RADIO_KEY_NONE,
+                                    run_cycle_mode, cycle_mode_done,
+                                    NULL, 0) != 0) {
+                announce_failure();
             }
             return true;
         }
@@ -3,51 +3,142 @@
  *
  * Implements a thread-safe speech queue using pthreads.
  * The speech thread runs in the background, dequeueing items
- * and sending them to Firmware via comm_send_audio_sync().
+ * and sending them to Firmware via comm_send_audio_request(), keeping up
+ * to a window of them in flight so Firmware has the next one queued and
+ * plays them back to back, and matching each ack to its request by tag.
+ *
+ * Each priority class has its own ring buffer; the thread always takes the
+ * oldest item of the highest class. Items in flight are all of one class,
+ * so queuing above it cuts them all off: the thread interrupts Firmware
+ * before it sends the next item, so the interrupt cannot cut off what
+ * follows.
+ *
+ * Firmware answers a request it has no room for at once with
+ * COMM_AUDIO_RESULT_BUSY instead of dropping it. The item is then dropped
+ * here and the window halved, growing back by one with every request
+ * played, so an overloaded Firmware slows speech down instead of leaving
+ * the thread waiting out COMM_AUDIO_TIMEOUT_MS.
+ *
+ * An item queued in a SpeechSlot replaces the one queued in that slot, so
+ * only the latest value of a readout is spoken.
  *
  * Part of Phase 0: Core Infrastructure (Step 2.1)
  */
 
+#include <errno.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "comm.h"
+#include "hampod_alloc.h"
+#include "hampod_metrics.h"
+#include "hampod_trace.h"
 #include "speech.h"
+#include "watchdog.h"
 
 // ============================================================================
 // Constants
 // ============================================================================
 
 #define DEFAULT_MAX_QUEUE_SIZE 32
-#define MAX_TEXT_LENGTH 256
+#define DEFAULT_WINDOW 3     // Requests in flight at once
+#define MAX_WINDOW 8         // Leaves COMM_MAX_PENDING tags for the rest
+#define ACK_SLICE_MS 50      // Wait for an ack this long before topping up
+#define MAX_WATCHES 8        // speech_on_complete() callbacks pending at once
+#define DEFAULT_MERGE_WINDOW_MS 10 // Wait this long for a prompt to merge with
+#define LATENCY_SAMPLES 256  // Latest items kept per stage for percentiles
+#define MAX_TEXT_LENGTH COMM_MAX_TEXT_LEN // comm.c fragments long text
+#define ARENA_BYTES_PER_ITEM 256 // Payload space, on average, per queued item
+#define DEFAULT_SPELL_GAP_MS 150 // Silence between spelled characters
 
 // ============================================================================
 // Audio Packet Types
 // ============================================================================
 
 typedef struct {
-  char type; // AUDIO_TYPE_TTS, AUDIO_TYPE_SPELL, AUDIO_TYPE_FILE
-  char payload[MAX_TEXT_LENGTH]; // Text or file path
+  char type; // AUDIO_TYPE_TTS, AUDIO_TYPE_SPELL, AUDIO_TYPE_FILE, ..._SEQUENCE
+  SpeechSlot slot; // At most one queued item per slot, bar SPEECH_SLOT_NONE
+  unsigned int id; // From queuing until played, cut off or dropped
+  unsigned int first_id; // Merged prompts carry ids first_id to id
+  unsigned int queued_us; // clock_us() when queued (the first, if merged)
+  unsigned int expires_us; // clock_us() past which it is stale, or 0
+  unsigned int key; // Key it answers, for the trace (hampod_trace.h), or 0
+  char *payload;   // Text or file path, in the queue's arena
 } SpeechItem;
 
 // ============================================================================
-// Queue Data Structure (Circular Buffer)
+// Queue Data Structure (Circular Buffer per Priority Class)
 // ============================================================================
 
+// Header of a payload in the arena. Payloads are allocated at the head and
+// reclaimed from the tail; one freed out of turn (superseded, dropped) stays
+// until those before it are freed too.
 typedef struct {
-  SpeechItem *items;        // Array of items
-  int capacity;             // Maximum size
-  int head;                 // Index of first item
-  int tail;                 // Index of next empty slot
-  int count;                // Current number of items
+  unsigned int size; // Bytes including this header, a multiple of 8
+  unsigned int live; // 0 once freed, or for padding up to the end
+} ArenaBlock;
+
+typedef struct {
+  SpeechItem *items; // Array of items, SpeechQueue.capacity of them
+  int head;          // Index of first item
+  int tail;          // Index of next empty slot
+  int count;         // Current number of items
+} SpeechRing;
+
+// A request sent to Firmware and not yet acked
+typedef struct {
+  unsigned short tag;
+  SpeechPriority priority;
+  SpeechItem item; // To put back in the queue if cut off before it played
+  unsigned int dequeued_us; // clock_us() when the speech thread took it
+  unsigned int sent_us;     // clock_us() when handed to comm
+} SpeechFlight;
+
+// Stages of an item's way to sound (speech_report_latency()), each from the
+// end of the one before, then two end to end
+typedef enum {
+  STAGE_QUEUE,       // Queued until the speech thread takes it
+  STAGE_DISPATCH,    // Until handed to comm
+  STAGE_TRANSIT,     // Until Firmware's audio process has it
+  STAGE_FW_QUEUE,    // Until it starts synthesizing
+  STAGE_SYNTH,       // Until its first audio is out
+  STAGE_PLAYBACK,    // Until Firmware is done with it
+  STAGE_ACK,         // Until the speech thread sees the ack
+  STAGE_TO_AUDIO,    // Queued until first audio
+  STAGE_TOTAL,       // Queued until the ack
+  STAGE_COUNT
+} SpeechStage;
+
+static const char *const stage_names[STAGE_COUNT] = {
+    "queue",    "dispatch", "transit",  "fw_queue", "synth",
+    "playback", "ack",      "to_audio", "total"};
+
+typedef struct {
+  SpeechRing rings[SPEECH_PRIORITY_COUNT]; // Indexed by SpeechPriority
+  int capacity;             // Maximum size, all classes together
+  int count;                // Current number of items, all classes
+  char *arena;              // Payloads of the items queued and in flight
+  size_t arena_size;        // Bytes, a multiple of 8
+  size_t arena_head;        // Offset of the next block
+  size_t arena_tail;        // Offset of the oldest block
+  size_t arena_used;        // Bytes from tail to head, padding included
   pthread_mutex_t mutex;    // Protects queue access
   pthread_cond_t not_empty; // Signaled when item added
   pthread_cond_t not_full;  // Signaled when item removed
+  pthread_cond_t done;      // Broadcast when items finish or are dropped
 } SpeechQueue;
 
+// A speech_on_complete() callback waiting for its item
+typedef struct {
+  unsigned int id;
+  SpeechCompleteCallback callback;
+  void *context;
+} SpeechWatch;
+
 // ============================================================================
 // Module State
 // ============================================================================
@@ -57,48 +148,548 @@ static pthread_t speech_thread;
 static volatile bool running = false;
 static int max_queue_size = DEFAULT_MAX_QUEUE_SIZE;
 
+static int window = DEFAULT_WINDOW;
+// Window in effect, at most window: halved when Firmware is busy and grown
+// back by one per request played (guarded by queue.mutex)
+static int send_window = DEFAULT_WINDOW;
+static int merge_window_ms = DEFAULT_MERGE_WINDOW_MS;
+
+// Spelling style (speech_set_spell_style()), read when a spell is queued
+static volatile bool spell_phonetic = false;
+static volatile int spell_gap_ms = DEFAULT_SPELL_GAP_MS;
+
+// Voice of each class (speech_set_priority_voice()), "" for the default;
+// read when an item is queued
+static char priority_voice[SPEECH_PRIORITY_COUNT][SPEECH_VOICE_NAME_MAX];
+static pthread_mutex_t voice_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Item ids (guarded by queue.mutex): the last one handed out, those of the
+// item between queue_pop() and the window, and what the calling thread
+// queued last
+static unsigned int last_id = 0;
+static unsigned int sending_first_id = 0;
+static unsigned int sending_id = 0;
+static __thread unsigned int thread_last_id = 0;
+
+// Latest stage times in microseconds, a ring per stage (guarded by
+// queue.mutex)
+static int latency[STAGE_COUNT][LATENCY_SAMPLES];
+static unsigned long latency_total[STAGE_COUNT];
+
+// speech_on_complete() callbacks (guarded by queue.mutex), run by the speech
+// thread once it is told some may be due
+static SpeechWatch watches[MAX_WATCHES];
+static int watch_count = 0;
+static bool watch_due = false;
+
+// Requests in flight, oldest (playing) first, all of one class (guarded by
+// queue.mutex), so speech_interrupt() and preemption can release them, and
+// whether the speech thread is to interrupt Firmware before sending more
+static SpeechFlight flight[MAX_WINDOW];
+static int flight_count = 0;
+static bool interrupt_wanted = false;
+
+// speech_set_sent_listener(), called by the speech thread (atomic)
+static SpeechSentListener sent_listener = NULL;
+
 // ============================================================================
 // Private Functions
 // ============================================================================
 
+// Low 32 bits of CLOCK_MONOTONIC in microseconds, as in Firmware's acks
+// (never 0, which there means "did not happen")
+static unsigned int clock_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  unsigned int us = (unsigned int)((unsigned long long)ts.tv_sec * 1000000ULL +
+                                   (unsigned long long)ts.tv_nsec / 1000ULL);
+  return us != 0 ? us : 1;
+}
+
+// Whether an item is past its time to live at clock_us() now
+static bool item_expired(const SpeechItem *item, unsigned int now) {
+  return item->expires_us != 0 && (int)(now - item->expires_us) >= 0;
+}
+
+// Count the time between two clock_us() stamps, unless either is missing.
+// Call with queue.mutex held.
+static void latency_note(SpeechStage stage, unsigned int from,
+                         unsigned int to) {
+  if (from == 0 || to == 0) {
+    return;
+  }
+  int us = (int)(to - from); // Wraps every 71 minutes
+  latency[stage][latency_total[stage]++ % LATENCY_SAMPLES] = us > 0 ? us : 0;
+}
+
+// Count the stages of a request Firmware has acked with response. Call
+// with queue.mutex held.
+static void latency_note_ack(const SpeechFlight *f,
+                             const CommPacket *response) {
+  unsigned int acked_us = clock_us();
+  unsigned int fw[COMM_AUDIO_ACK_INTS] = {0};
+  if (response->data_len >= sizeof(fw)) {
+    memcpy(fw, response->data, sizeof(fw));
+  }
+  unsigned int received_us = fw[1];
+  unsigned int synth_us = fw[2];
+  unsigned int first_audio_us = fw[3];
+  unsigned int done_us = fw[4];
+
+  latency_note(STAGE_QUEUE, f->item.queued_us, f->dequeued_us);
+  latency_note(STAGE_DISPATCH, f->dequeued_us, f->sent_us);
+  latency_note(STAGE_TRANSIT, f->sent_us, received_us);
+  latency_note(STAGE_FW_QUEUE, received_us, synth_us);
+  latency_note(STAGE_SYNTH, synth_us, first_audio_us);
+  latency_note(STAGE_PLAYBACK, first_audio_us, done_us);
+  latency_note(STAGE_ACK, done_us, acked_us);
+  latency_note(STAGE_TO_AUDIO, f->item.queued_us, first_audio_us);
+  latency_note(STAGE_TOTAL, f->item.queued_us, acked_us);
+  watchdog_note_first_audio(f->item.queued_us, first_audio_us);
+}
+
 static int queue_init(int capacity) {
-  queue.items = (SpeechItem *)malloc(capacity * sizeof(SpeechItem));
-  if (queue.items == NULL) {
+  // Payload space scales with the queue, but always fits the longest item
+  size_t arena_size = (size_t)capacity * ARENA_BYTES_PER_ITEM;
+  size_t arena_min = 2 * (sizeof(ArenaBlock) + MAX_TEXT_LENGTH + 8);
+  queue.arena_size = (arena_size > arena_min ? arena_size : arena_min) &
+                     ~(size_t)7;
+  queue.arena = (char *)hampod_malloc(ALLOC_SPEECH, queue.arena_size);
+  queue.arena_head = 0;
+  queue.arena_tail = 0;
+  queue.arena_used = 0;
+  if (queue.arena == NULL) {
     LOG_ERROR("Failed to allocate speech queue");
     return HAMPOD_ERROR;
   }
 
+  // Each class may hold the whole queue
+  for (int c = 0; c < SPEECH_PRIORITY_COUNT; c++) {
+    SpeechRing *ring = &queue.rings[c];
+    ring->items = (SpeechItem *)hampod_malloc(ALLOC_SPEECH,
+                                              capacity * sizeof(SpeechItem));
+    ring->head = 0;
+    ring->tail = 0;
+    ring->count = 0;
+    if (ring->items == NULL) {
+      LOG_ERROR("Failed to allocate speech queue");
+      while (c-- > 0) {
+        hampod_free(queue.rings[c].items);
+        queue.rings[c].items = NULL;
+      }
+      hampod_free(queue.arena);
+      queue.arena = NULL;
+      return HAMPOD_ERROR;
+    }
+  }
+
   queue.capacity = capacity;
-  queue.head = 0;
-  queue.tail = 0;
   queue.count = 0;
 
   pthread_mutex_init(&queue.mutex, NULL);
   pthread_cond_init(&queue.not_empty, NULL);
   pthread_cond_init(&queue.not_full, NULL);
+  pthread_cond_init(&queue.done, NULL);
 
   return HAMPOD_OK;
 }
 
 static void queue_destroy(void) {
   pthread_mutex_lock(&queue.mutex);
-  if (queue.items != NULL) {
-    free(queue.items);
-    queue.items = NULL;
+  for (int c = 0; c < SPEECH_PRIORITY_COUNT; c++) {
+    hampod_free(queue.rings[c].items);
+    queue.rings[c].items = NULL;
+    queue.rings[c].count = 0;
   }
   queue.count = 0;
+  hampod_free(queue.arena);
+  queue.arena = NULL;
+  flight_count = 0;
   pthread_mutex_unlock(&queue.mutex);
 
   pthread_mutex_destroy(&queue.mutex);
   pthread_cond_destroy(&queue.not_empty);
   pthread_cond_destroy(&queue.not_full);
+  pthread_cond_destroy(&queue.done);
+}
+
+// Copy payload into the arena, or return NULL if it has no room for it
+// yet. Call with queue.mutex held.
+static char *arena_copy(const char *payload, size_t len) {
+  size_t need = (sizeof(ArenaBlock) + len + 1 + 7) & ~(size_t)7;
+
+  if (queue.arena_used == 0) {
+    queue.arena_head = 0;
+    queue.arena_tail = 0;
+  }
+
+  size_t at = queue.arena_head;
+  size_t padding = 0;
+  if (queue.arena_used > 0 && queue.arena_head <= queue.arena_tail) {
+    // Free space is the gap between head and tail
+    if (queue.arena_tail - queue.arena_head < need) {
+      return NULL;
+    }
+  } else if (queue.arena_size - queue.arena_head < need) {
+    // No room before the end: pad it out and start again at the front
+    if (queue.arena_tail < need) {
+      return NULL;
+    }
+    padding = queue.arena_size - queue.arena_head;
+    at = 0;
+  }
+
+  if (padding > 0) {
+    ArenaBlock *pad = (ArenaBlock *)(queue.arena + queue.arena_head);
+    pad->size = (unsigned int)padding;
+    pad->live = 0;
+  }
+  ArenaBlock *block = (ArenaBlock *)(queue.arena + at);
+  block->size = (unsigned int)need;
+  block->live = 1;
+  char *copy = (char *)(block + 1);
+  memcpy(copy, payload, len);
+  copy[len] = '\0';
+
+  queue.arena_head = (at + need) % queue.arena_size;
+  queue.arena_used += padding + need;
+  return copy;
+}
+
+// Free a payload from the arena, and reclaim what is free at the tail.
+// Call with queue.mutex held.
+static void arena_free(char *payload) {
+  ArenaBlock *block = (ArenaBlock *)payload - 1;
+  block->live = 0;
+
+  while (queue.arena_used > 0) {
+    ArenaBlock *tail = (ArenaBlock *)(queue.arena + queue.arena_tail);
+    if (tail->live) {
+      break;
+    }
+    queue.arena_used -= tail->size;
+    queue.arena_tail = (queue.arena_tail + tail->size) % queue.arena_size;
+  }
+  pthread_cond_broadcast(&queue.not_full);
+}
+
+static bool item_holds(const SpeechItem *item, unsigned int id) {
+  return id >= item->first_id && id <= item->id;
+}
+
+// Whether item id is still queued, being sent or in flight. An item queued
+// between prompts that were merged counts as pending as long as they do.
+// Call with queue.mutex held.
+static bool queue_pending(unsigned int id) {
+  if (id == 0 || (id >= sending_first_id && id <= sending_id)) {
+    return id != 0;
+  }
+  for (int i = 0; i < flight_count; i++) {
+    if (item_holds(&flight[i].item, id)) {
+      return true;
+    }
+  }
+  for (int c = 0; c < SPEECH_PRIORITY_COUNT; c++) {
+    SpeechRing *ring = &queue.rings[c];
+    for (int i = 0; i < ring->count; i++) {
+      if (item_holds(&ring->items[(ring->head + i) % queue.capacity], id)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+static bool queue_idle(void) {
+  return queue.count == 0 && flight_count == 0 && sending_id == 0;
+}
+
+// Items have been played, cut off or dropped: wake the waiters, and the
+// speech thread if callbacks may be due. Call with queue.mutex held.
+static void queue_finished(void) {
+  pthread_cond_broadcast(&queue.done);
+  if (watch_count > 0) {
+    watch_due = true;
+    pthread_cond_signal(&queue.not_empty);
+  }
+}
+
+// Run the callbacks whose items are done (all of them once shutting down)
+static void watches_run(void) {
+  SpeechWatch due[MAX_WATCHES];
+  int due_count = 0;
+
+  pthread_mutex_lock(&queue.mutex);
+  if (!watch_due && running) {
+    pthread_mutex_unlock(&queue.mutex);
+    return;
+  }
+  watch_due = false;
+  int kept = 0;
+  for (int i = 0; i < watch_count; i++) {
+    if (running && queue_pending(watches[i].id)) {
+      watches[kept++] = watches[i];
+    } else {
+      due[due_count++] = watches[i];
+    }
+  }
+  watch_count = kept;
+  pthread_mutex_unlock(&queue.mutex);
+
+  for (int i = 0; i < due_count; i++) {
+    due[i].callback(due[i].id, due[i].context);
+  }
+}
+
+// Drop the oldest item of the lowest class below priority, to make room
+// for one of priority. Call with queue.mutex held.
+static bool queue_drop_below(SpeechPriority priority) {
+  for (int c = SPEECH_PRIORITY_COUNT - 1; c > (int)priority; c--) {
+    SpeechRing *ring = &queue.rings[c];
+    if (ring->count > 0) {
+      hampod_trace(TRACE_SPEECH_DROPPED, (uint32_t)c, 0, 0);
+      hampod_metric_add(METRIC_SPEECH_DROPS, 1);
+      arena_free(ring->items[ring->head].payload);
+      ring->head = (ring->head + 1) % queue.capacity;
+      ring->count--;
+      queue.count--;
+      queue_finished();
+      return true;
+    }
+  }
+  return false;
+}
+
+// Take the item at offset i from the head out of the ring. Call with
+// queue.mutex held.
+static void ring_remove(SpeechRing *ring, int i) {
+  for (; i < ring->count - 1; i++) {
+    ring->items[(ring->head + i) % queue.capacity] =
+        ring->items[(ring->head + i + 1) % queue.capacity];
+  }
+  ring->tail = (ring->tail + queue.capacity - 1) % queue.capacity;
+  ring->count--;
+  queue.count--;
+}
+
+// Put an item at offset i from the head of the ring (i == count for the
+// tail). Call with queue.mutex held.
+static void ring_insert(SpeechRing *ring, int i, const SpeechItem *item) {
+  for (int j = ring->count; j > i; j--) {
+    ring->items[(ring->head + j) % queue.capacity] =
+        ring->items[(ring->head + j - 1) % queue.capacity];
+  }
+  ring->items[(ring->head + i) % queue.capacity] = *item;
+  ring->tail = (ring->tail + 1) % queue.capacity;
+  ring->count++;
+  queue.count++;
+}
+
+// Drop the items past their time to live (speech_say_text_ttl()). Call
+// with queue.mutex held.
+static void queue_expire(void) {
+  unsigned int now = clock_us();
+  int expired = 0;
+  for (int c = 0; c < SPEECH_PRIORITY_COUNT; c++) {
+    SpeechRing *ring = &queue.rings[c];
+    for (int i = 0; i < ring->count;) {
+      SpeechItem *item = &ring->items[(ring->head + i) % queue.capacity];
+      if (!item_expired(item, now)) {
+        i++;
+        continue;
+      }
+      LOG_DEBUG("Expired queued speech: %s", item->payload);
+      arena_free(item->payload);
+      ring_remove(ring, i);
+      expired++;
+    }
+  }
+  if (expired > 0) {
+    hampod_metric_add(METRIC_SPEECH_EXPIRED, expired);
+    hampod_metric_set(METRIC_SPEECH_QUEUE_DEPTH, queue.count);
+    pthread_cond_signal(&queue.not_full);
+    queue_finished();
+  }
+}
+
+// Take out the item queued in slot, returning its place in line if it is of
+// priority (for the new one to take), or -1. Call with queue.mutex held.
+static int queue_supersede(SpeechPriority priority, SpeechSlot slot) {
+  for (int c = 0; c < SPEECH_PRIORITY_COUNT; c++) {
+    SpeechRing *ring = &queue.rings[c];
+    for (int i = 0; i < ring->count; i++) {
+      SpeechItem *item = &ring->items[(ring->head + i) % queue.capacity];
+      if (item->slot != slot) {
+        continue;
+      }
+      LOG_DEBUG("Superseded queued speech: %s", item->payload);
+      arena_free(item->payload);
+      ring_remove(ring, i);
+      queue_finished();
+      return c == (int)priority ? i : -1;
+    }
+  }
+  return -1;
+}
+
+// Put an item back at the head of its class, or free it if there is no
+// room. Call with queue.mutex held.
+static void ring_push_front(SpeechPriority priority, const SpeechItem *item) {
+  SpeechRing *ring = &queue.rings[priority];
+  if (queue.count < queue.capacity) {
+    ring->head = (ring->head + queue.capacity - 1) % queue.capacity;
+    ring->items[ring->head] = *item;
+    ring->count++;
+    queue.count++;
+  } else {
+    arena_free(item->payload);
+  }
+}
+
+static bool queue_has_slot(SpeechSlot slot) {
+  for (int c = 0; c < SPEECH_PRIORITY_COUNT; c++) {
+    SpeechRing *ring = &queue.rings[c];
+    for (int i = 0; i < ring->count; i++) {
+      if (ring->items[(ring->head + i) % queue.capacity].slot == slot) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// Put back an item sent but stopped by an interrupt before it played,
+// unless a newer one has replaced it in its slot. Call with queue.mutex
+// held.
+static void queue_requeue(const SpeechFlight *f) {
+  if (f->item.slot == SPEECH_SLOT_NONE || !queue_has_slot(f->item.slot)) {
+    ring_push_front(f->priority, &f->item);
+  } else {
+    arena_free(f->item.payload);
+  }
+}
+
+// Cut off what is playing if it is outranked by priority or, with cut_off,
+// is stale in slot: release the tags in flight, put back the items queued
+// behind it in Firmware, and have the speech thread interrupt Firmware
+// before it sends anything else. Call with queue.mutex held.
+static void queue_preempt(SpeechPriority priority, SpeechSlot slot,
+                          bool cut_off) {
+  if (flight_count == 0 ||
+      (priority >= flight[0].priority &&
+       !(cut_off && slot != SPEECH_SLOT_NONE && flight[0].item.slot == slot))) {
+    return;
+  }
+  hampod_trace(TRACE_SPEECH_CUT_OFF, flight[0].priority, 0, 0);
+  comm_cancel_response(flight[0].tag);
+  arena_free(flight[0].item.payload);
+  for (int i = flight_count - 1; i > 0; i--) {
+    comm_cancel_response(flight[i].tag);
+    queue_requeue(&flight[i]);
+  }
+  flight_count = 0;
+  interrupt_wanted = true;
+  queue_finished();
+  pthread_cond_signal(&queue.not_empty);
+}
+
+// Put a text or sequence payload in the voice of its class, as a sequence
+// that selects the voice first. Returns false, leaving the payload as it
+// is, for the default voice or if the result would not fit one packet.
+static bool voice_payload(char type, const char *payload,
+                          SpeechPriority priority, char *out) {
+  char voice[SPEECH_VOICE_NAME_MAX];
+  pthread_mutex_lock(&voice_mutex);
+  memcpy(voice, priority_voice[priority], sizeof(voice));
+  pthread_mutex_unlock(&voice_mutex);
+  if (voice[0] == '\0' ||
+      (type != AUDIO_TYPE_TTS && type != AUDIO_TYPE_SEQUENCE)) {
+    return false;
+  }
+
+  int len = type == AUDIO_TYPE_TTS
+                ? snprintf(out, SPEECH_SEQUENCE_MAX + 1, "%c%s%c%c%s",
+                           AUDIO_SEQ_VOICE, voice, AUDIO_SEQ_SEPARATOR,
+                           AUDIO_TYPE_TTS, payload)
+                : snprintf(out, SPEECH_SEQUENCE_MAX + 1, "%c%s%c%s",
+                           AUDIO_SEQ_VOICE, voice, AUDIO_SEQ_SEPARATOR,
+                           payload);
+  if (len > SPEECH_SEQUENCE_MAX) {
+    LOG_DEBUG("Speech too long for voice %s, using the default", voice);
+    return false;
+  }
+  return true;
 }
 
-static int queue_push(char type, const char *payload) {
+// Put a deadline in front of a text or sequence payload, as a sequence
+// Firmware skips if it comes up later. Returns false, leaving the payload
+// as it is (expiring only while queued here), if the result would not fit
+// one packet.
+static bool expiring_payload(char type, const char *payload,
+                             unsigned int expires_us, char *out) {
+  if (type != AUDIO_TYPE_TTS && type != AUDIO_TYPE_SEQUENCE) {
+    return false;
+  }
+  int len = type == AUDIO_TYPE_TTS
+                ? snprintf(out, SPEECH_SEQUENCE_MAX + 1, "%c%u%c%c%s",
+                           AUDIO_SEQ_EXPIRES, expires_us, AUDIO_SEQ_SEPARATOR,
+                           AUDIO_TYPE_TTS, payload)
+                : snprintf(out, SPEECH_SEQUENCE_MAX + 1, "%c%u%c%s",
+                           AUDIO_SEQ_EXPIRES, expires_us, AUDIO_SEQ_SEPARATOR,
+                           payload);
+  return len <= SPEECH_SEQUENCE_MAX;
+}
+
+// Queue a payload; ttl_ms is its time to live, 0 for none
+static int queue_push_latest(char type, const char *payload,
+                             SpeechPriority priority, SpeechSlot slot,
+                             bool cut_off, int ttl_ms) {
+  char voiced[SPEECH_SEQUENCE_MAX + 1];
+  if (voice_payload(type, payload, priority, voiced)) {
+    type = AUDIO_TYPE_SEQUENCE;
+    payload = voiced;
+  }
+  unsigned int expires_us = 0;
+  char expiring[SPEECH_SEQUENCE_MAX + 1];
+  if (ttl_ms > 0) {
+    expires_us = clock_us() + (unsigned int)ttl_ms * 1000U;
+    expires_us += expires_us == 0; // 0 is none
+    if (expiring_payload(type, payload, expires_us, expiring)) {
+      type = AUDIO_TYPE_SEQUENCE;
+      payload = expiring;
+    }
+  }
+
+  size_t len = strlen(payload);
+  if (len > MAX_TEXT_LENGTH) {
+    LOG_ERROR("Speech too long for Firmware (%zu bytes) - dropping: %.40s...",
+              len, payload);
+    return HAMPOD_ERROR;
+  }
+
   pthread_mutex_lock(&queue.mutex);
 
-  // Wait if queue is full (with timeout to check running flag)
-  while (queue.count >= queue.capacity && running) {
+  // A newer readout takes the place in line of the one queued in its slot
+  SpeechRing *ring = &queue.rings[priority];
+  int place = -1;
+  if (slot != SPEECH_SLOT_NONE && running) {
+    place = queue_supersede(priority, slot);
+  }
+
+  // Make room by dropping lower classes; failing that, wait (with timeout
+  // to check running flag), except for background items, which are dropped
+  char *copy = NULL;
+  while (running) {
+    if (queue.count < queue.capacity &&
+        (copy = arena_copy(payload, len)) != NULL) {
+      break;
+    }
+    if (queue_drop_below(priority)) {
+      continue;
+    }
+    if (priority == SPEECH_BACKGROUND) {
+      break;
+    }
     struct timespec timeout;
     clock_gettime(CLOCK_REALTIME, &timeout);
     timeout.tv_nsec += 100000000; // 100ms timeout
@@ -110,50 +701,122 @@ static int queue_push(char type, const char *payload) {
   }
 
   if (!running) {
+    if (copy != NULL) {
+      arena_free(copy);
+    }
     pthread_mutex_unlock(&queue.mutex);
     return HAMPOD_ERROR;
   }
 
-  if (queue.count >= queue.capacity) {
+  if (copy == NULL) {
     pthread_mutex_unlock(&queue.mutex);
     LOG_ERROR("Speech queue is full (count=%d, capacity=%d) - dropping: %s",
               queue.count, queue.capacity, payload);
+    hampod_metric_add(METRIC_SPEECH_DROPS, 1);
     return HAMPOD_ERROR;
   }
 
-  // Add item to tail
-  SpeechItem *item = &queue.items[queue.tail];
-  item->type = type;
-  strncpy(item->payload, payload, MAX_TEXT_LENGTH - 1);
-  item->payload[MAX_TEXT_LENGTH - 1] = '\0';
+  // Add item to tail of its class, or the superseded item's place
+  unsigned int id = ++last_id;
+  unsigned int key = hampod_trace_key_claim();
+  SpeechItem item = {type, slot, id, id, clock_us(), expires_us, key, copy};
+  if (key != 0) {
+    hampod_trace(TRACE_KEY_QUEUED, key, id, 0);
+  }
+  thread_last_id = item.id;
+  ring_insert(ring, place >= 0 && place < ring->count ? place : ring->count,
+              &item);
 
-  queue.tail = (queue.tail + 1) % queue.capacity;
-  queue.count++;
+  // Cut off a lower class, or a stale readout, that is playing
+  queue_preempt(priority, slot, cut_off);
+
+  hampod_metric_set(METRIC_SPEECH_QUEUE_DEPTH, queue.count);
 
   // Signal that queue is not empty
   pthread_cond_signal(&queue.not_empty);
 
   pthread_mutex_unlock(&queue.mutex);
 
-  LOG_DEBUG("Queued speech: type='%c', payload='%s' (queue size=%d)", type,
-            payload, queue.count);
+  LOG_DEBUG("Queued speech: type='%c', priority=%d, payload='%s' (queue "
+            "size=%d)",
+            type, (int)priority, payload, queue.count);
 
   return HAMPOD_OK;
 }
 
-static int queue_pop(SpeechItem *item) {
-  pthread_mutex_lock(&queue.mutex);
+static int queue_push(char type, const char *payload,
+                      SpeechPriority priority) {
+  return queue_push_latest(type, payload, priority, SPEECH_SLOT_NONE, false,
+                           0);
+}
 
-  // Wait if queue is empty (with timeout to check running flag)
-  while (queue.count == 0 && running) {
-    struct timespec timeout;
-    clock_gettime(CLOCK_REALTIME, &timeout);
-    timeout.tv_nsec += 100000000; // 100ms timeout
-    if (timeout.tv_nsec >= 1000000000) {
-      timeout.tv_sec += 1;
-      timeout.tv_nsec -= 1000000000;
+// Whether an item can be merged with the prompts either side of it
+static bool item_mergeable(const SpeechItem *item) {
+  return item->type == AUDIO_TYPE_TTS && item->slot == SPEECH_SLOT_NONE;
+}
+
+// Merge the plain prompts at the head of ring into one request, a line
+// each so Firmware still synthesizes and caches them one by one (see
+// hal_tts_phrase.h), and return it in item. One request is one round trip
+// and lets Firmware synthesize each while the one before plays. Returns
+// how many items from the head it stands for. Call with queue.mutex held.
+static int queue_merge(SpeechRing *ring, SpeechItem *item) {
+  *item = ring->items[ring->head];
+  if (!item_mergeable(item)) {
+    return 1;
+  }
+
+  char text[MAX_TEXT_LENGTH + 1];
+  size_t len = strlen(item->payload);
+  memcpy(text, item->payload, len);
+  unsigned int first_id = item->first_id;
+  unsigned int id = item->id;
+  unsigned int key = item->key;
+  int n = 1;
+  for (; n < ring->count; n++) {
+    const SpeechItem *next = &ring->items[(ring->head + n) % queue.capacity];
+    size_t next_len = strlen(next->payload);
+    if (!item_mergeable(next) || len + 1 + next_len > MAX_TEXT_LENGTH) {
+      break;
     }
-    pthread_cond_timedwait(&queue.not_empty, &queue.mutex, &timeout);
+    text[len++] = '\n';
+    memcpy(text + len, next->payload, next_len);
+    len += next_len;
+    first_id = next->first_id < first_id ? next->first_id : first_id;
+    id = next->id > id ? next->id : id;
+    key = key != 0 ? key : next->key;
+  }
+  if (n == 1) {
+    return 1;
+  }
+
+  char *copy = arena_copy(text, len);
+  if (copy == NULL) {
+    return 1; // No room for the merged text: send them one at a time
+  }
+  for (int i = 0; i < n; i++) {
+    arena_free(ring->items[(ring->head + i) % queue.capacity].payload);
+  }
+  LOG_DEBUG("Merged %d prompts into one request", n);
+  item->payload = copy;
+  item->first_id = first_id;
+  item->id = id;
+  item->key = key;
+  return n;
+}
+
+// Take the next item to send. With nothing in flight, waits for one;
+// otherwise only tops up the window, with items of the class in flight that
+// are not in a slot (those stay queued, where a newer one can replace them,
+// until they would play at once).
+static int queue_pop(SpeechItem *item, SpeechPriority *priority) {
+  pthread_mutex_lock(&queue.mutex);
+
+  // Sleep until there is work: each of these is signaled under the mutex,
+  // and speech_shutdown() broadcasts
+  while (queue.count == 0 && flight_count == 0 && !interrupt_wanted &&
+         !watch_due && running) {
+    pthread_cond_wait(&queue.not_empty, &queue.mutex);
   }
 
   if (!running && queue.count == 0) {
@@ -161,15 +824,52 @@ static int queue_pop(SpeechItem *item) {
     return HAMPOD_ERROR;
   }
 
-  if (queue.count == 0) {
-    pthread_mutex_unlock(&queue.mutex);
-    return HAMPOD_NOT_FOUND;
+  bool merge_waited = false;
+  int c;
+  SpeechRing *ring;
+  for (;;) {
+    queue_expire();
+
+    // Highest class with any
+    c = 0;
+    while (c < SPEECH_PRIORITY_COUNT && queue.rings[c].count == 0) {
+      c++;
+    }
+    ring = &queue.rings[c < SPEECH_PRIORITY_COUNT ? c : 0];
+    if (c == SPEECH_PRIORITY_COUNT || interrupt_wanted ||
+        (flight_count > 0 &&
+         (flight_count >= send_window || c != (int)flight[0].priority ||
+          ring->items[ring->head].slot != SPEECH_SLOT_NONE))) {
+      pthread_mutex_unlock(&queue.mutex);
+      return HAMPOD_NOT_FOUND;
+    }
+
+    // A lone prompt with nothing playing is usually the first of a burst
+    // ("Set mode", "Power", "50"): give the rest a moment to be queued
+    if (merge_waited || merge_window_ms == 0 || flight_count > 0 ||
+        ring->count > 1 || !item_mergeable(&ring->items[ring->head])) {
+      break;
+    }
+    merge_waited = true;
+    struct timespec timeout;
+    clock_gettime(CLOCK_REALTIME, &timeout);
+    timeout.tv_nsec += (long)merge_window_ms * 1000000;
+    while (timeout.tv_nsec >= 1000000000) {
+      timeout.tv_sec += 1;
+      timeout.tv_nsec -= 1000000000;
+    }
+    pthread_cond_timedwait(&queue.not_empty, &queue.mutex, &timeout);
   }
 
-  // Remove item from head
-  *item = queue.items[queue.head];
-  queue.head = (queue.head + 1) % queue.capacity;
-  queue.count--;
+  // Remove item from head, with the prompts merged into it
+  int taken = queue_merge(ring, item);
+  *priority = (SpeechPriority)c;
+  sending_first_id = item->first_id;
+  sending_id = item->id;
+  ring->head = (ring->head + taken) % queue.capacity;
+  ring->count -= taken;
+  queue.count -= taken;
+  hampod_metric_set(METRIC_SPEECH_QUEUE_DEPTH, queue.count);
 
   // Signal that queue is not full
   pthread_cond_signal(&queue.not_full);
@@ -183,39 +883,148 @@ static int queue_pop(SpeechItem *item) {
 // Speech Thread
 // ============================================================================
 
+// Send an item taken from the queue at dequeued_us and add it to the window
+static void speech_send(const SpeechItem *item, SpeechPriority priority,
+                        unsigned int dequeued_us) {
+  LOG_DEBUG("Speaking: type='%c', payload='%s'", item->type, item->payload);
+
+  // Send audio request to Firmware
+  unsigned short tag;
+  unsigned int sent_us = clock_us();
+  int sent = comm_send_audio_request(item->type, item->payload, &tag);
+  hampod_trace(TRACE_SPEECH_SEND, (unsigned char)item->type, tag, priority);
+  if (item->key != 0 && sent == HAMPOD_OK) {
+    hampod_trace(TRACE_KEY_SPEECH, item->key, tag, clock_us() - sent_us);
+  }
+  SpeechSentListener listener =
+      __atomic_load_n(&sent_listener, __ATOMIC_ACQUIRE);
+  if (listener != NULL && sent == HAMPOD_OK) {
+    listener(item->type, item->payload);
+  }
+
+  pthread_mutex_lock(&queue.mutex);
+  sending_first_id = 0;
+  sending_id = 0;
+  if (sent != HAMPOD_OK) {
+    LOG_ERROR("Failed to send audio: %s", item->payload);
+    arena_free(item->payload);
+    queue_finished();
+    pthread_mutex_unlock(&queue.mutex);
+    return;
+  }
+  if (interrupt_wanted || flight_count >= send_window) {
+    // Cut off while it was being sent (or speech_interrupt() ran): the
+    // interrupt about to go out would stop it, so try it again after
+    comm_cancel_response(tag);
+    SpeechFlight cut = {tag, priority, *item, dequeued_us, sent_us};
+    if (interrupt_wanted) {
+      queue_requeue(&cut);
+    } else {
+      arena_free(item->payload);
+    }
+    queue_finished();
+  } else {
+    SpeechFlight *f = &flight[flight_count++];
+    f->tag = tag;
+    f->priority = priority;
+    f->item = *item;
+    f->dequeued_us = dequeued_us;
+    f->sent_us = sent_us;
+  }
+  pthread_mutex_unlock(&queue.mutex);
+}
+
 static void *speech_thread_func(void *arg) {
   (void)arg;
+  hampod_metrics_name_thread("speech");
+  unsigned short waited_tag = 0; // Oldest request in flight, when waited on
+  int waited_ms = 0;             // How long its ack has been waited for
 
   LOG_INFO("Speech thread started");
 
   while (running) {
-    SpeechItem item;
+    watches_run();
 
-    if (queue_pop(&item) != HAMPOD_OK) {
-      // Queue empty or shutting down
-      continue;
+    // Stop what was cut off before sending anything new, which then
+    // belongs to the new speech epoch and is not cut off
+    pthread_mutex_lock(&queue.mutex);
+    bool interrupt = interrupt_wanted;
+    interrupt_wanted = false;
+    pthread_mutex_unlock(&queue.mutex);
+    if (interrupt && comm_interrupt_audio() != HAMPOD_OK) {
+      LOG_ERROR("Failed to send interrupt command to Firmware");
     }
 
-    LOG_DEBUG("Speaking: type='%c', payload='%s'", item.type, item.payload);
-
-    // Send audio request to Firmware
-    if (comm_send_audio(item.type, item.payload) != HAMPOD_OK) {
-      LOG_ERROR("Failed to send audio: %s", item.payload);
+    // Top up the window, so Firmware has the next item queued
+    SpeechItem item;
+    SpeechPriority priority;
+    int popped = queue_pop(&item, &priority);
+    if (popped == HAMPOD_OK) {
+      speech_send(&item, priority, clock_us());
       continue;
     }
 
-    // Wait for audio acknowledgment from router queue
-    // This ensures proper sequencing without blocking keypad thread
-    CommPacket response;
-    int result = comm_wait_audio_response(&response, COMM_AUDIO_TIMEOUT_MS);
+    pthread_mutex_lock(&queue.mutex);
+    bool waiting = flight_count > 0 && !interrupt_wanted;
+    unsigned short tag = waiting ? flight[0].tag : 0;
+    pthread_mutex_unlock(&queue.mutex);
+    if (!waiting) {
+      continue; // Queue empty or shutting down
+    }
+    if (tag != waited_tag) {
+      waited_tag = tag;
+      waited_ms = 0;
+    }
 
+    // Wait for the oldest acknowledgment, a slice at a time so the window
+    // is topped up as items are queued
+    CommPacket response;
+    int result = comm_wait_response(tag, &response, ACK_SLICE_MS);
     if (result == HAMPOD_TIMEOUT) {
-      LOG_ERROR("Timeout waiting for audio acknowledgment: %s", item.payload);
-    } else if (result != HAMPOD_OK) {
-      LOG_ERROR("Failed to get audio acknowledgment: %s", item.payload);
-    } else {
-      LOG_DEBUG("Audio acknowledged: %s", item.payload);
+      waited_ms += ACK_SLICE_MS;
+      if (waited_ms < COMM_AUDIO_TIMEOUT_MS) {
+        continue;
+      }
+      comm_cancel_response(tag);
+    }
+
+    pthread_mutex_lock(&queue.mutex);
+    if (flight_count > 0 && flight[0].tag == tag) {
+      // Not cut off meanwhile (that releases the tags itself)
+      hampod_trace(TRACE_SPEECH_DONE, tag, (uint32_t)result, 0);
+      int fw_result = 0;
+      if (result == HAMPOD_OK && response.data_len >= sizeof(fw_result)) {
+        memcpy(&fw_result, response.data, sizeof(fw_result));
+      }
+      if (result == HAMPOD_TIMEOUT) {
+        LOG_ERROR("Timeout waiting for audio acknowledgment: %s",
+                  flight[0].item.payload);
+        send_window = send_window > 1 ? send_window / 2 : 1;
+      } else if (result != HAMPOD_OK) {
+        LOG_ERROR("Failed to get audio acknowledgment: %s",
+                  flight[0].item.payload);
+      } else if (fw_result == COMM_AUDIO_RESULT_EXPIRED) {
+        // Stale by the time Firmware came to it (counted there)
+        LOG_DEBUG("Audio expired: %s", flight[0].item.payload);
+      } else if (fw_result == COMM_AUDIO_RESULT_BUSY) {
+        // Firmware had no room for it: slow down rather than resend
+        LOG_ERROR("Firmware busy, dropped: %s", flight[0].item.payload);
+        hampod_metric_add(METRIC_SPEECH_DROPS, 1);
+        hampod_trace(TRACE_SPEECH_DROPPED, flight[0].priority, 0, 0);
+        send_window = send_window > 1 ? send_window / 2 : 1;
+      } else {
+        LOG_DEBUG("Audio acknowledged: %s", flight[0].item.payload);
+        latency_note_ack(&flight[0], &response);
+        if (send_window < window) {
+          send_window++;
+        }
+      }
+      arena_free(flight[0].item.payload);
+      flight_count--;
+      memmove(&flight[0], &flight[1], flight_count * sizeof(SpeechFlight));
+      queue_finished();
     }
+    pthread_mutex_unlock(&queue.mutex);
   }
 
   LOG_INFO("Speech thread exiting");
@@ -235,6 +1044,13 @@ int speech_init(void) {
 
   LOG_INFO("Initializing speech system...");
 
+  // HAMPOD_SPEECH_WINDOW=1 sends one request at a time
+  const char *window_env = getenv("HAMPOD_SPEECH_WINDOW");
+  if (window_env != NULL && atoi(window_env) > 0) {
+    window = atoi(window_env) < MAX_WINDOW ? atoi(window_env) : MAX_WINDOW;
+  }
+  send_window = window;
+
   // Initialize queue
   if (queue_init(max_queue_size) != HAMPOD_OK) {
     return HAMPOD_ERROR;
@@ -263,13 +1079,19 @@ void speech_shutdown(void) {
   // Signal thread to stop
   running = false;
 
-  // Wake up the thread if it's waiting
+  // Wake up the thread and speech_wait_*() callers if they're waiting
+  pthread_mutex_lock(&queue.mutex);
   pthread_cond_broadcast(&queue.not_empty);
   pthread_cond_broadcast(&queue.not_full);
+  pthread_cond_broadcast(&queue.done);
+  pthread_mutex_unlock(&queue.mutex);
 
   // Wait for thread to finish
   pthread_join(speech_thread, NULL);
 
+  // What is left will not play; callbacks still hear it is over
+  watches_run();
+
   // Clean up queue
   queue_destroy();
 
@@ -278,16 +1100,41 @@ void speech_shutdown(void) {
 
 bool speech_is_running(void) { return running; }
 
+pthread_t speech_get_thread(void) { return speech_thread; }
+
 // ============================================================================
 // Public API - Queue Operations
 // ============================================================================
 
 int speech_say_text(const char *text) {
+  return speech_say_text_priority(text, SPEECH_INTERACTIVE);
+}
+
+int speech_say_text_priority(const char *text, SpeechPriority priority) {
   if (text == NULL) {
     LOG_ERROR("speech_say_text: NULL text");
     return HAMPOD_ERROR;
   }
-  return queue_push(AUDIO_TYPE_TTS, text);
+  return queue_push(AUDIO_TYPE_TTS, text, priority);
+}
+
+int speech_say_text_latest(const char *text, SpeechPriority priority,
+                           SpeechSlot slot, bool cut_off) {
+  if (text == NULL) {
+    LOG_ERROR("speech_say_text_latest: NULL text");
+    return HAMPOD_ERROR;
+  }
+  return queue_push_latest(AUDIO_TYPE_TTS, text, priority, slot, cut_off, 0);
+}
+
+int speech_say_text_ttl(const char *text, SpeechPriority priority,
+                        SpeechSlot slot, bool cut_off, int ttl_ms) {
+  if (text == NULL) {
+    LOG_ERROR("speech_say_text_ttl: NULL text");
+    return HAMPOD_ERROR;
+  }
+  return queue_push_latest(AUDIO_TYPE_TTS, text, priority, slot, cut_off,
+                           ttl_ms);
 }
 
 int speech_spell_text(const char *text) {
@@ -295,7 +1142,31 @@ int speech_spell_text(const char *text) {
     LOG_ERROR("speech_spell_text: NULL text");
     return HAMPOD_ERROR;
   }
-  return queue_push(AUDIO_TYPE_SPELL, text);
+  char payload[MAX_TEXT_LENGTH + 1];
+  snprintf(payload, sizeof(payload), "%c%d:%s",
+           spell_phonetic ? AUDIO_SPELL_PHONETIC : AUDIO_SPELL_LETTERS,
+           spell_gap_ms, text);
+  return queue_push(AUDIO_TYPE_SPELL, payload, SPEECH_INTERACTIVE);
+}
+
+void speech_set_spell_style(bool phonetic, int gap_ms) {
+  if (gap_ms < 0) {
+    gap_ms = 0;
+  } else if (gap_ms > AUDIO_SPELL_GAP_MAX_MS) {
+    gap_ms = AUDIO_SPELL_GAP_MAX_MS;
+  }
+  spell_phonetic = phonetic;
+  spell_gap_ms = gap_ms;
+}
+
+void speech_set_priority_voice(SpeechPriority priority, const char *voice) {
+  if (priority < 0 || priority >= SPEECH_PRIORITY_COUNT) {
+    return;
+  }
+  pthread_mutex_lock(&voice_mutex);
+  snprintf(priority_voice[priority], SPEECH_VOICE_NAME_MAX, "%s",
+           voice != NULL ? voice : "");
+  pthread_mutex_unlock(&voice_mutex);
 }
 
 int speech_play_file(const char *filepath) {
@@ -303,25 +1174,272 @@ int speech_play_file(const char *filepath) {
     LOG_ERROR("speech_play_file: NULL filepath");
     return HAMPOD_ERROR;
   }
-  return queue_push(AUDIO_TYPE_FILE, filepath);
+  return queue_push(AUDIO_TYPE_FILE, filepath, SPEECH_INTERACTIVE);
+}
+
+void speech_say_again(void) {
+  queue_push(AUDIO_TYPE_REPLAY, "1", SPEECH_INTERACTIVE);
+}
+
+// ============================================================================
+// Public API - Speak Sequences
+// ============================================================================
+
+void speech_sequence_init(SpeechSequence *seq) {
+  seq->payload[0] = '\0';
+  seq->length = 0;
+  seq->overflow = false;
+}
+
+// Append one <kind><data> segment, with a separator before all but the first
+static int sequence_append(SpeechSequence *seq, char kind, const char *data) {
+  size_t data_len = strlen(data);
+  size_t needed = data_len + 1 + (seq->length > 0 ? 1 : 0);
+
+  if (seq->overflow || seq->length + needed > SPEECH_SEQUENCE_MAX) {
+    LOG_ERROR("Speech sequence full - dropping segment: %s", data);
+    seq->overflow = true;
+    return HAMPOD_ERROR;
+  }
+
+  if (seq->length > 0) {
+    seq->payload[seq->length++] = AUDIO_SEQ_SEPARATOR;
+  }
+  seq->payload[seq->length++] = kind;
+  memcpy(seq->payload + seq->length, data, data_len + 1);
+  seq->length += (int)data_len;
+  return HAMPOD_OK;
 }
 
-void speech_wait_complete(void) {
-  // Poll queue size until empty
-  while (speech_queue_size() > 0 && running) {
-    usleep(50000); // 50ms
+int speech_sequence_add_text(SpeechSequence *seq, const char *text) {
+  if (text == NULL) {
+    LOG_ERROR("speech_sequence_add_text: NULL text");
+    return HAMPOD_ERROR;
   }
+  return sequence_append(seq, AUDIO_TYPE_TTS, text);
+}
+
+int speech_sequence_add_words(SpeechSequence *seq, const char *words) {
+  if (words == NULL) {
+    LOG_ERROR("speech_sequence_add_words: NULL words");
+    return HAMPOD_ERROR;
+  }
+  return sequence_append(seq, AUDIO_SEQ_WORDS, words);
+}
+
+int speech_sequence_add_file(SpeechSequence *seq, const char *filepath) {
+  if (filepath == NULL) {
+    LOG_ERROR("speech_sequence_add_file: NULL filepath");
+    return HAMPOD_ERROR;
+  }
+  return sequence_append(seq, AUDIO_TYPE_FILE, filepath);
+}
+
+int speech_sequence_add_beep(SpeechSequence *seq, char beep) {
+  char data[2] = {beep, '\0'};
+  return sequence_append(seq, AUDIO_TYPE_BEEP, data);
+}
+
+int speech_sequence_add_gap(SpeechSequence *seq, int ms) {
+  char data[16];
+  snprintf(data, sizeof(data), "%d", ms > 0 ? ms : 0);
+  return sequence_append(seq, AUDIO_SEQ_GAP, data);
+}
+
+int speech_sequence_add_voice(SpeechSequence *seq, const char *voice) {
+  return sequence_append(seq, AUDIO_SEQ_VOICE, voice != NULL ? voice : "");
+}
+
+int speech_say_sequence(const SpeechSequence *seq) {
+  return speech_say_sequence_priority(seq, SPEECH_INTERACTIVE);
+}
+
+int speech_say_sequence_priority(const SpeechSequence *seq,
+                                 SpeechPriority priority) {
+  if (seq == NULL || seq->length == 0 || seq->overflow) {
+    LOG_ERROR("speech_say_sequence: empty or overflowed sequence");
+    return HAMPOD_ERROR;
+  }
+  return queue_push(AUDIO_TYPE_SEQUENCE, seq->payload, priority);
+}
+
+int speech_say_sequence_latest(const SpeechSequence *seq,
+                               SpeechPriority priority, SpeechSlot slot,
+                               bool cut_off) {
+  if (seq == NULL || seq->length == 0 || seq->overflow) {
+    LOG_ERROR("speech_say_sequence_latest: empty or overflowed sequence");
+    return HAMPOD_ERROR;
+  }
+  return queue_push_latest(AUDIO_TYPE_SEQUENCE, seq->payload, priority, slot,
+                           cut_off, 0);
+}
+
+int speech_say_sequence_ttl(const SpeechSequence *seq,
+                            SpeechPriority priority, SpeechSlot slot,
+                            bool cut_off, int ttl_ms) {
+  if (seq == NULL || seq->length == 0 || seq->overflow) {
+    LOG_ERROR("speech_say_sequence_ttl: empty or overflowed sequence");
+    return HAMPOD_ERROR;
+  }
+  return queue_push_latest(AUDIO_TYPE_SEQUENCE, seq->payload, priority, slot,
+                           cut_off, ttl_ms);
+}
+
+int speech_say_words(const char *words) {
+  return speech_say_words_priority(words, SPEECH_INTERACTIVE);
+}
+
+int speech_say_words_priority(const char *words, SpeechPriority priority) {
+  SpeechSequence seq;
+  speech_sequence_init(&seq);
+  if (speech_sequence_add_words(&seq, words) != HAMPOD_OK) {
+    return HAMPOD_ERROR;
+  }
+  return speech_say_sequence_priority(&seq, priority);
+}
+
+int speech_say_words_latest(const char *words, SpeechPriority priority,
+                            SpeechSlot slot, bool cut_off) {
+  SpeechSequence seq;
+  speech_sequence_init(&seq);
+  if (speech_sequence_add_words(&seq, words) != HAMPOD_OK) {
+    return HAMPOD_ERROR;
+  }
+  return speech_say_sequence_latest(&seq, priority, slot, cut_off);
+}
+
+int speech_say_words_ttl(const char *words, SpeechPriority priority,
+                         SpeechSlot slot, bool cut_off, int ttl_ms) {
+  SpeechSequence seq;
+  speech_sequence_init(&seq);
+  if (speech_sequence_add_words(&seq, words) != HAMPOD_OK) {
+    return HAMPOD_ERROR;
+  }
+  return speech_say_sequence_ttl(&seq, priority, slot, cut_off, ttl_ms);
+}
+
+int speech_warm_words(const char *words) {
+  if (words == NULL || words[0] == '\0') {
+    return HAMPOD_ERROR;
+  }
+  // Past the queue: it plays nothing, so there is nothing to order
+  return comm_warm_words(words);
+}
+
+// Wait until item id is done, or with id 0 until nothing is queued or in
+// flight
+static int queue_wait(unsigned int id, int timeout_ms) {
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  if (timeout_ms > 0) {
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+      deadline.tv_sec += 1;
+      deadline.tv_nsec -= 1000000000;
+    }
+  }
+
+  int result = HAMPOD_OK;
+  pthread_mutex_lock(&queue.mutex);
+  while (running && (id != 0 ? queue_pending(id) : !queue_idle())) {
+    if (timeout_ms < 0) {
+      pthread_cond_wait(&queue.done, &queue.mutex);
+    } else if (timeout_ms == 0 ||
+               pthread_cond_timedwait(&queue.done, &queue.mutex, &deadline) ==
+                   ETIMEDOUT) {
+      result = HAMPOD_TIMEOUT;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&queue.mutex);
+  return result;
+}
+
+void speech_wait_complete(void) { speech_wait_idle(-1); }
+
+int speech_wait_idle(int timeout_ms) {
+  if (!running) {
+    return HAMPOD_OK;
+  }
+  return queue_wait(0, timeout_ms);
+}
+
+int speech_wait_item(unsigned int id, int timeout_ms) {
+  if (!running || id == 0) {
+    return HAMPOD_OK;
+  }
+  unsigned int started_us = clock_us();
+  int result = queue_wait(id, timeout_ms);
+  if (result != HAMPOD_OK || timeout_ms == 0) {
+    return result;
+  }
+
+  // Acked means queued in Firmware, not heard yet: wait for it to play out
+  int left_ms = -1;
+  if (timeout_ms > 0) {
+    int spent_ms = (int)((clock_us() - started_us) / 1000);
+    left_ms = spent_ms < timeout_ms ? timeout_ms - spent_ms : 0;
+  }
+  return comm_wait_played(left_ms) == HAMPOD_TIMEOUT ? HAMPOD_TIMEOUT
+                                                     : HAMPOD_OK;
+}
+
+unsigned int speech_last_id(void) { return thread_last_id; }
+
+int speech_on_complete(unsigned int id, SpeechCompleteCallback callback,
+                       void *context) {
+  if (callback == NULL) {
+    LOG_ERROR("speech_on_complete: NULL callback");
+    return HAMPOD_ERROR;
+  }
+
+  if (running) {
+    pthread_mutex_lock(&queue.mutex);
+    if (queue_pending(id)) {
+      if (watch_count == MAX_WATCHES) {
+        pthread_mutex_unlock(&queue.mutex);
+        LOG_ERROR("Too many speech completion callbacks");
+        return HAMPOD_ERROR;
+      }
+      SpeechWatch *watch = &watches[watch_count++];
+      watch->id = id;
+      watch->callback = callback;
+      watch->context = context;
+      pthread_mutex_unlock(&queue.mutex);
+      return HAMPOD_OK;
+    }
+    pthread_mutex_unlock(&queue.mutex);
+  }
+
+  // Already done
+  callback(id, context);
+  return HAMPOD_OK;
+}
+
+void speech_set_sent_listener(SpeechSentListener listener) {
+  __atomic_store_n(&sent_listener, listener, __ATOMIC_RELEASE);
 }
 
 void speech_clear_queue(void) {
   pthread_mutex_lock(&queue.mutex);
-  queue.head = 0;
-  queue.tail = 0;
+  for (int c = 0; c < SPEECH_PRIORITY_COUNT; c++) {
+    SpeechRing *ring = &queue.rings[c];
+    for (int i = 0; i < ring->count; i++) {
+      arena_free(ring->items[(ring->head + i) % queue.capacity].payload);
+    }
+    queue.rings[c].head = 0;
+    queue.rings[c].tail = 0;
+    queue.rings[c].count = 0;
+  }
+  int cleared = queue.count;
   queue.count = 0;
+  hampod_metric_set(METRIC_SPEECH_QUEUE_DEPTH, 0);
   pthread_cond_broadcast(&queue.not_full);
+  queue_finished();
   pthread_mutex_unlock(&queue.mutex);
 
-  LOG_INFO("Speech queue cleared");
+  hampod_trace(TRACE_SPEECH_CLEARED, (uint32_t)cleared, 0, 0);
 }
 
 int speech_queue_size(void) {
@@ -331,31 +1449,79 @@ int speech_queue_size(void) {
   return size;
 }
 
+int speech_ack_wait_ms(void) {
+  pthread_mutex_lock(&queue.mutex);
+  int waited = flight_count > 0 ? (int)(clock_us() - flight[0].sent_us) : 0;
+  pthread_mutex_unlock(&queue.mutex);
+  return waited > 0 ? waited / 1000 : 0;
+}
+
 void speech_interrupt(void) {
   if (!running) {
     return;
   }
 
-  LOG_INFO("Interrupting current speech...");
+  hampod_trace(TRACE_SPEECH_INTERRUPT, (uint32_t)flight_count, 0, 0);
 
   // 1. Clear the local queue
   speech_clear_queue();
 
-  // 2. Send interrupt command to Firmware and WAIT for acknowledgment
-  // This ensures the interrupt is processed before we queue new speech
-  if (comm_send_audio(AUDIO_TYPE_INTERRUPT, "") != HAMPOD_OK) {
+  // 2. Tell Firmware to stop. This starts a new speech epoch, so whatever
+  // we queue next cannot be cut off by the interrupt even if it overtakes
+  // it - no need to hold up the keypad thread waiting for the ack
+  if (comm_interrupt_audio() != HAMPOD_OK) {
     LOG_ERROR("Failed to send interrupt command to Firmware");
     return;
   }
 
-  // 3. Wait for acknowledgment from firmware (with short timeout)
-  // This blocks until firmware confirms interrupt was processed
-  CommPacket ack;
-  if (comm_wait_audio_response(&ack, 100) == HAMPOD_OK) {
-    LOG_DEBUG("Interrupt acknowledged by firmware");
-  } else {
-    LOG_ERROR("Interrupt acknowledgment timeout");
+  // 3. Release the speech thread: the requests in flight belong to the old
+  // epoch, so don't sit out the full audio timeout for their acks
+  pthread_mutex_lock(&queue.mutex);
+  for (int i = 0; i < flight_count; i++) {
+    comm_cancel_response(flight[i].tag);
+    arena_free(flight[i].item.payload);
   }
+  flight_count = 0;
+  queue_finished();
+  pthread_mutex_unlock(&queue.mutex);
+}
+
+// ============================================================================
+// Public API - Latency
+// ============================================================================
+
+static int compare_ints(const void *a, const void *b) {
+  int x = *(const int *)a;
+  int y = *(const int *)b;
+  return (x > y) - (x < y);
+}
+
+void speech_report_latency(FILE *out) {
+  static int samples[LATENCY_SAMPLES];
+  static pthread_mutex_t report_lock = PTHREAD_MUTEX_INITIALIZER;
+
+  pthread_mutex_lock(&report_lock);
+  fprintf(out, "%-10s %6s %8s %8s %8s %8s\n", "stage", "items", "p50 ms",
+          "p90 ms", "p99 ms", "max ms");
+  for (int stage = 0; stage < STAGE_COUNT; stage++) {
+    pthread_mutex_lock(&queue.mutex);
+    unsigned long total = latency_total[stage];
+    int n = total < LATENCY_SAMPLES ? (int)total : LATENCY_SAMPLES;
+    memcpy(samples, latency[stage], n * sizeof(int));
+    pthread_mutex_unlock(&queue.mutex);
+
+    if (n == 0) {
+      fprintf(out, "%-10s %6lu %8s %8s %8s %8s\n", stage_names[stage], total,
+              "-", "-", "-", "-");
+      continue;
+    }
+    qsort(samples, n, sizeof(int), compare_ints);
+    fprintf(out, "%-10s %6lu %8.1f %8.1f %8.1f %8.1f\n", stage_names[stage],
+            total, samples[(n - 1) * 50 / 100] / 1000.0,
+            samples[(n - 1) * 90 / 100] / 1000.0,
+            samples[(n - 1) * 99 / 100] / 1000.0, samples[n - 1] / 1000.0);
+  }
+  pthread_mutex_unlock(&report_lock);
 }
 
 // ============================================================================
@@ -367,3 +1533,15 @@ void speech_set_max_queue_size(int size) {
     max_queue_size = size;
   }
 }
+
+void speech_set_merge_window(int ms) {
+  if (!running && ms >= 0) {
+    merge_window_ms = ms;
+  }
+}
+
+void speech_set_window(int requests) {
+  if (!running && requests > 0) {
+    window = requests < MAX_WINDOW ? requests : MAX_WINDOW;
+  }
+}
@@ -0,0 +1,109 @@
+/**
+ * @file tune.c
+ * @brief Keypad tuning implementation
+ */
+
+#include "tune.h"
+#include "frequency_mode.h"
+#include "hampod_core.h"
+#include "radio.h"
+#include "radio_worker.h"
+#include "speech.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+
+// ============================================================================
+// State
+// ============================================================================
+
+static const int g_steps[] = {10, 100, 1000, 5000, 10000, 100000};
+#define STEP_COUNT (int)(sizeof(g_steps) / sizeof(g_steps[0]))
+#define DEFAULT_STEP 2 // 1 kHz
+
+static int g_step = DEFAULT_STEP; // Keypad thread only
+
+// Guarded by g_tune_mutex
+static double g_target = 0; // Newest frequency asked for
+static int g_pending = 0;   // Sets queued or running, superseded included
+static pthread_mutex_t g_tune_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// ============================================================================
+// Internal Functions
+// ============================================================================
+
+/**
+ * @brief Radio command: set the frequency (run on the radio worker)
+ */
+static int run_tune(void *arg) {
+  return radio_set_frequency(*(const double *)arg);
+}
+
+static void tune_done(int result, void *arg) {
+  (void)arg;
+
+  pthread_mutex_lock(&g_tune_mutex);
+  g_pending--;
+  bool last = g_pending == 0;
+  pthread_mutex_unlock(&g_tune_mutex);
+
+  // A superseded step is not a failure; a failed newest one is
+  if (result != 0 && result != RADIO_CMD_CANCELLED && last) {
+    speech_say_text_priority("Tuning failed", SPEECH_URGENT);
+  }
+}
+
+// ============================================================================
+// Steps
+// ============================================================================
+
+double tune_next_frequency(double freq_hz, int step_hz, int direction) {
+  long long step = step_hz > 0 ? step_hz : 1;
+  long long freq = (long long)(freq_hz + 0.5);
+  long long next;
+  if (direction > 0) {
+    next = (freq / step + 1) * step;
+  } else {
+    next = ((freq + step - 1) / step - 1) * step;
+  }
+  return next > 0 ? (double)next : freq_hz;
+}
+
+int tune_get_step_hz(void) { return g_steps[g_step]; }
+
+int tune_cycle_step(void) {
+  g_step = (g_step + 1) % STEP_COUNT;
+  return g_steps[g_step];
+}
+
+// ============================================================================
+// Tuning
+// ============================================================================
+
+void tune_step(int direction) {
+  pthread_mutex_lock(&g_tune_mutex);
+  double from = g_pending > 0 ? g_target : 0;
+  pthread_mutex_unlock(&g_tune_mutex);
+
+  if (from <= 0) {
+    from = radio_get_frequency();
+  }
+  if (from <= 0) {
+    speech_say_text("Frequency not available");
+    return;
+  }
+
+  double target = tune_next_frequency(from, g_steps[g_step], direction);
+  pthread_mutex_lock(&g_tune_mutex);
+  g_target = target;
+  g_pending++;
+  pthread_mutex_unlock(&g_tune_mutex);
+  DEBUG_PRINT("tune_step: %.0f Hz\n", target);
+
+  // Said once, when polling sees the steps have settled
+  frequency_mode_announce_next_poll();
+  if (radio_worker_submit(RADIO_CMD_USER, RADIO_KEY_FREQUENCY, run_tune,
+                          tune_done, &target, sizeof(target)) != 0) {
+    tune_done(-1, &target);
+  }
+}
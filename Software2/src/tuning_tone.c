@@ -0,0 +1,179 @@
+/**
+ * @file tuning_tone.c
+ * @brief Tuning tone implementation
+ */
+
+#include "tuning_tone.h"
+#include "comm.h"
+#include "hampod_core.h"
+#include "meter.h"
+#include "radio_queries.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+// ============================================================================
+// State
+// ============================================================================
+
+#define TUNING_TONE_SAMPLE_MS 50   // Between meter reads
+#define TUNING_TONE_REFRESH_MS 500 // Resend an unchanged pitch this often
+
+static TuningToneMeter g_meter = TUNING_TONE_OFF; // Guarded by g_tone_mutex
+static bool g_thread_running = false;             // Guarded by g_control_mutex
+static pthread_t g_tone_thread;
+static pthread_mutex_t g_tone_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_tone_wake = PTHREAD_COND_INITIALIZER;
+
+// Owns g_thread_running. Held through the join in tuning_tone_stop(), so
+// a meter cycled meanwhile starts a new thread only once the old one is
+// gone.
+static pthread_mutex_t g_control_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Each meter's range, mapped linearly onto the pitch range
+static const struct {
+  RadioMeter meter;
+  double low;
+  double high;
+} g_ranges[TUNING_TONE_COUNT] = {
+    [TUNING_TONE_SMETER] = {RADIO_METER_SMETER, -54.0, 60.0},
+    [TUNING_TONE_SWR] = {RADIO_METER_SWR, 1.0, 3.0},
+    [TUNING_TONE_POWER] = {RADIO_METER_POWER, 0.0, 1.0},
+};
+
+// ============================================================================
+// Internal Functions
+// ============================================================================
+
+static long long now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void *tone_thread_func(void *arg) {
+  (void)arg;
+  int sent_hz = -1;
+  long long sent_ms = 0;
+
+  DEBUG_PRINT("tuning_tone: Started\n");
+
+  pthread_mutex_lock(&g_tone_mutex);
+  while (g_meter != TUNING_TONE_OFF) {
+    TuningToneMeter meter = g_meter;
+    pthread_mutex_unlock(&g_tone_mutex);
+
+    double value;
+    int hz = 0; // Silent while the meter can't be read
+    if (radio_read_meter(g_ranges[meter].meter, &value) == 0) {
+      hz = tuning_tone_pitch(meter, value);
+      meter_record(g_ranges[meter].meter, value);
+    }
+    long long now = now_ms();
+    if (hz != sent_hz || now - sent_ms >= TUNING_TONE_REFRESH_MS) {
+      comm_set_tone(hz);
+      sent_hz = hz;
+      sent_ms = now;
+    }
+
+    struct timespec wake;
+    clock_gettime(CLOCK_REALTIME, &wake);
+    wake.tv_nsec += TUNING_TONE_SAMPLE_MS * 1000000L;
+    if (wake.tv_nsec >= 1000000000L) {
+      wake.tv_sec++;
+      wake.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&g_tone_mutex);
+    if (g_meter == meter) {
+      pthread_cond_timedwait(&g_tone_wake, &g_tone_mutex, &wake);
+    }
+  }
+  pthread_mutex_unlock(&g_tone_mutex);
+
+  comm_set_tone(0);
+  DEBUG_PRINT("tuning_tone: Stopped\n");
+  return NULL;
+}
+
+// ============================================================================
+// Meters
+// ============================================================================
+
+int tuning_tone_pitch(TuningToneMeter meter, double value) {
+  if (meter <= TUNING_TONE_OFF || meter >= TUNING_TONE_COUNT) {
+    return 0;
+  }
+
+  double low = g_ranges[meter].low;
+  double fraction = (value - low) / (g_ranges[meter].high - low);
+  if (fraction < 0.0) {
+    fraction = 0.0;
+  } else if (fraction > 1.0) {
+    fraction = 1.0;
+  }
+  return TUNING_TONE_MIN_HZ +
+         (int)(fraction * (TUNING_TONE_MAX_HZ - TUNING_TONE_MIN_HZ) + 0.5);
+}
+
+// ============================================================================
+// Control
+// ============================================================================
+
+int tuning_tone_start(TuningToneMeter meter) {
+  if (meter <= TUNING_TONE_OFF || meter >= TUNING_TONE_COUNT) {
+    tuning_tone_stop();
+    return 0;
+  }
+
+  pthread_mutex_lock(&g_control_mutex);
+  pthread_mutex_lock(&g_tone_mutex);
+  g_meter = meter;
+  pthread_cond_signal(&g_tone_wake);
+  pthread_mutex_unlock(&g_tone_mutex);
+
+  int result = 0;
+  if (!g_thread_running) {
+    if (pthread_create(&g_tone_thread, NULL, tone_thread_func, NULL) == 0) {
+      g_thread_running = true;
+    } else {
+      fprintf(stderr, "tuning_tone_start: pthread_create failed\n");
+      pthread_mutex_lock(&g_tone_mutex);
+      g_meter = TUNING_TONE_OFF;
+      pthread_mutex_unlock(&g_tone_mutex);
+      result = -1;
+    }
+  }
+  pthread_mutex_unlock(&g_control_mutex);
+  return result;
+}
+
+void tuning_tone_stop(void) {
+  pthread_mutex_lock(&g_control_mutex);
+  if (g_thread_running) {
+    pthread_mutex_lock(&g_tone_mutex);
+    g_meter = TUNING_TONE_OFF;
+    pthread_cond_signal(&g_tone_wake);
+    pthread_mutex_unlock(&g_tone_mutex);
+
+    pthread_join(g_tone_thread, NULL);
+    g_thread_running = false;
+  }
+  pthread_mutex_unlock(&g_control_mutex);
+}
+
+TuningToneMeter tuning_tone_cycle(void) {
+  TuningToneMeter next = (tuning_tone_get_meter() + 1) % TUNING_TONE_COUNT;
+  if (tuning_tone_start(next) != 0) {
+    return TUNING_TONE_OFF;
+  }
+  return next;
+}
+
+TuningToneMeter tuning_tone_get_meter(void) {
+  pthread_mutex_lock(&g_tone_mutex);
+  TuningToneMeter meter = g_meter;
+  pthread_mutex_unlock(&g_tone_mutex);
+  return meter;
+}
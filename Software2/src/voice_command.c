@@ -0,0 +1,103 @@
+/**
+ * @file voice_command.c
+ * @brief Spoken frequency and mode commands
+ */
+
+#include "voice_command.h"
+#include "announce.h"
+#include "comm.h"
+#include "config.h"
+#include "frequency_mode.h"
+#include "hampod_core.h"
+#include "idle.h"
+#include "radio_queries.h"
+#include "radio_setters.h"
+#include "radio_worker.h"
+#include "speech.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Mode names as Firmware sends them, in radio_set_mode_by_index() order
+static const char *const MODE_NAMES[] = {"USB", "LSB", "CW",
+                                         "AM",  "FM",  "RTTY"};
+
+// ============================================================================
+// Mode
+// ============================================================================
+
+static int run_set_mode(void *arg) {
+  return radio_set_mode_by_index(*(const int *)arg);
+}
+
+static void set_mode_done(int result, void *arg) {
+  (void)arg;
+
+  if (result == RADIO_CMD_CANCELLED) {
+    return; // A later mode replaced it
+  }
+  if (result == 0) {
+    Announcement a;
+    announce_init(&a);
+    announce_mode(&a, radio_get_mode_string());
+    announce_say(&a, SPEECH_INTERACTIVE);
+    return;
+  }
+
+  if (config_get_key_beep_enabled()) {
+    comm_play_beep(COMM_BEEP_ERROR);
+  }
+  speech_say_text_priority(result == RADIO_ERR_UNAVAILABLE
+                               ? "Mode not available"
+                               : "Failed to set mode",
+                           SPEECH_URGENT);
+}
+
+static void set_mode(const char *name) {
+  int index = -1;
+  for (int i = 0; i < (int)(sizeof(MODE_NAMES) / sizeof(MODE_NAMES[0]));
+       i++) {
+    if (strcmp(name, MODE_NAMES[i]) == 0) {
+      index = i;
+    }
+  }
+  if (index < 0) {
+    DEBUG_PRINT("voice_command: Unknown mode %s\n", name);
+    return;
+  }
+
+  if (radio_worker_submit(RADIO_CMD_USER, RADIO_KEY_MODE, run_set_mode,
+                          set_mode_done, &index, sizeof(index)) != 0) {
+    set_mode_done(-1, NULL);
+  }
+}
+
+// ============================================================================
+// Dispatch
+// ============================================================================
+
+// Runs on the router thread; both commands only queue radio work
+static void on_voice_command(char kind, const char *arg) {
+  DEBUG_PRINT("voice_command: %c %s\n", kind, arg);
+  idle_note_activity();
+
+  switch (kind) {
+  case COMM_VOICE_FREQUENCY: {
+    double freq_hz = atof(arg);
+    if (freq_hz > 0) {
+      frequency_mode_tune(freq_hz);
+    }
+    break;
+  }
+  case COMM_VOICE_MODE:
+    set_mode(arg);
+    break;
+  default:
+    DEBUG_PRINT("voice_command: Unknown command %c\n", kind);
+    break;
+  }
+}
+
+void voice_command_init(void) {
+  comm_set_voice_command_handler(on_voice_command);
+}
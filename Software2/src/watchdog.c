@@ -0,0 +1,176 @@
+/**
+ * @file watchdog.c
+ * @brief Latency SLO accounting and audio link watchdog implementation
+ */
+
+#include "watchdog.h"
+#include "comm.h"
+// Software2 does not define SHAREDLIB, so this also pulls in the
+// start-up timing implementation (main.c uses the declarations only)
+#include "hampod_boot.h"
+#include "hampod_core.h"
+#include "hampod_metrics.h"
+#include "idle.h"
+#include "radio.h"
+#include "radio_state.h"
+#include "speech.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// ============================================================================
+// State
+// ============================================================================
+
+static unsigned int g_misses[WATCHDOG_SLOS]; // Atomic
+
+// Used by the housekeeping job only
+static int g_stall_ms = 0;
+static bool g_started = false;
+static bool g_poll_stale = false; // Counted once per stale stretch
+static bool g_probing = false;
+static unsigned short g_probe_tag = 0;
+static long long g_probe_ms = 0; // When the last heartbeat was sent
+
+// ============================================================================
+// SLOs
+// ============================================================================
+
+static void slo_miss(WatchdogSlo slo) {
+  __atomic_add_fetch(&g_misses[slo], 1, __ATOMIC_RELAXED);
+  hampod_metric_add(METRIC_SLO_MISSES, 1);
+}
+
+void watchdog_note_key(uint64_t timestamp_us) {
+  if (timestamp_us == 0) {
+    return;
+  }
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  uint64_t now_us = (uint64_t)ts.tv_sec * 1000000u + ts.tv_nsec / 1000;
+  if (now_us < timestamp_us) {
+    return;
+  }
+  int ms = (int)((now_us - timestamp_us) / 1000);
+  if (ms > WATCHDOG_KEY_BEEP_MS) {
+    slo_miss(WATCHDOG_SLO_KEY_BEEP);
+    LOG_INFO("watchdog: Key beep sent %d ms after the key (SLO %d ms)", ms,
+             WATCHDOG_KEY_BEEP_MS);
+  }
+}
+
+void watchdog_note_first_audio(unsigned int queued_us,
+                               unsigned int first_audio_us) {
+  if (queued_us == 0 || first_audio_us == 0) {
+    return;
+  }
+  int us = (int)(first_audio_us - queued_us); // Wraps every 71 minutes
+  if (us > WATCHDOG_FIRST_AUDIO_MS * 1000) {
+    slo_miss(WATCHDOG_SLO_FIRST_AUDIO);
+    LOG_INFO("watchdog: First audio %d ms after queuing (SLO %d ms)",
+             us / 1000, WATCHDOG_FIRST_AUDIO_MS);
+  }
+}
+
+unsigned int watchdog_slo_misses(WatchdogSlo slo) {
+  return __atomic_load_n(&g_misses[slo], __ATOMIC_RELAXED);
+}
+
+// Whether the radio's frequency is older than its SLO while connected
+static bool check_poll_age(void) {
+  if (!radio_is_connected()) {
+    g_poll_stale = false;
+    return false;
+  }
+  RadioStateSnapshot snap;
+  radio_state_snapshot(&snap);
+  int age_ms = snap.age_ms[RADIO_FIELD_FREQ];
+  bool stale = age_ms > WATCHDOG_POLL_AGE_MS;
+  if (stale && !g_poll_stale) {
+    slo_miss(WATCHDOG_SLO_POLL_AGE);
+    LOG_INFO("watchdog: Radio frequency %d ms old (SLO %d ms)", age_ms,
+             WATCHDOG_POLL_AGE_MS);
+  }
+  g_poll_stale = stale;
+  return stale;
+}
+
+// ============================================================================
+// Audio Link
+// ============================================================================
+
+// Firmware did not answer a heartbeat: give up on the direct channel and
+// restart speech, whose requests in flight may never be acked
+static void recover_link(long long waited_ms) {
+  bool dropped = comm_reset_audio_link() == HAMPOD_OK;
+  speech_interrupt();
+  hampod_metric_add(METRIC_WATCHDOG_ACTIONS, 1);
+  LOG_ERROR("watchdog: No heartbeat from Firmware in %lld ms, %s", waited_ms,
+            dropped ? "direct audio channel dropped, speech restarted"
+                    : "speech restarted");
+}
+
+// Send a heartbeat while speech waits long on an ack, and act on its answer
+static bool check_link(void) {
+  long long now = boot_clock_ms();
+  if (g_probing) {
+    CommPacket reply;
+    int result = comm_poll_response(g_probe_tag, &reply);
+    if (result == HAMPOD_TIMEOUT && now - g_probe_ms < WATCHDOG_PROBE_MS) {
+      return true;
+    }
+    g_probing = false;
+    if (result == HAMPOD_OK) {
+      int steps = 0;
+      if (reply.data_len >= sizeof(steps)) {
+        memcpy(&steps, reply.data, sizeof(steps));
+      }
+      if (steps > 0) {
+        LOG_INFO("watchdog: Firmware is recovering its audio (%d steps)",
+                 steps);
+      }
+    } else if (result == HAMPOD_TIMEOUT) {
+      comm_cancel_response(g_probe_tag);
+      recover_link(now - g_probe_ms);
+    }
+    return true;
+  }
+
+  // One heartbeat per stall_ms of waiting; a long announcement is acked
+  // only once played, so a healthy Firmware just answers
+  if (speech_ack_wait_ms() < g_stall_ms || now - g_probe_ms < g_stall_ms) {
+    return false;
+  }
+  if (comm_send_audio_request(AUDIO_TYPE_HEARTBEAT, "", &g_probe_tag) !=
+      HAMPOD_OK) {
+    return false;
+  }
+  g_probing = true;
+  g_probe_ms = now;
+  return true;
+}
+
+static bool watchdog_job(void *arg) {
+  (void)arg;
+  bool useful = check_poll_age();
+  if (g_stall_ms > 0 && check_link()) {
+    useful = true;
+  }
+  return useful;
+}
+
+int watchdog_start(int stall_ms) {
+  if (g_started) {
+    return 0;
+  }
+  g_stall_ms = stall_ms;
+  if (idle_add_job(watchdog_job, NULL, WATCHDOG_CHECK_MS,
+                   WATCHDOG_IDLE_CHECK_MS) != 0) {
+    LOG_ERROR("watchdog_start: No housekeeping timer");
+    return -1;
+  }
+  g_started = true;
+  return 0;
+}
@@ -0,0 +1,230 @@
+/**
+ * test_announce.c - Test Announcement Builder
+ *
+ * Verifies how typed segments become speech:
+ * 1. Numbers, digits, units and words form one words run between texts
+ * 2. Frequencies read "14 point 2 5 0 0 0 megahertz", truncated
+ * 3. Terse style shortens labels, units, frequencies, modes and VFOs,
+ *    and leaves out the level of a switch that is off
+ * 4. A segment that does not fit refuses the announcement
+ *
+ * Note: This test runs WITHOUT Firmware and without the speech thread.
+ *
+ * Usage:
+ *   make tests
+ *   ./bin/test_announce
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "announce.h"
+#include "hampod_core.h"
+
+// ============================================================================
+// Test Framework
+// ============================================================================
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, msg) do { \
+    if (condition) { \
+        printf("  ✓ PASS: %s\n", msg); \
+        tests_passed++; \
+    } else { \
+        printf("  ✗ FAIL: %s\n", msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+// What an announcement says, as text
+static const char *spoken(const Announcement *a) {
+    static char text[256];
+    announce_to_text(a, text, sizeof(text));
+    return text;
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+static void test_segments(void) {
+    printf("\nTest: Segments\n");
+    announce_set_style(ANNOUNCE_VERBOSE);
+
+    Announcement a;
+    announce_init(&a);
+    announce_text(&a, "Noise blanker");
+    announce_word(&a, "on");
+    announce_word(&a, "level");
+    announce_number(&a, 5);
+    TEST_ASSERT(strcmp(spoken(&a), "Noise blanker on level 5") == 0,
+                "Segments read in order");
+
+    SpeechSequence seq;
+    TEST_ASSERT(announce_render(&a, &seq) == HAMPOD_OK, "Renders");
+    TEST_ASSERT(strcmp(seq.payload, "dNoise blanker\x1e" "won level 5") == 0,
+                "Adjacent words become one words run");
+
+    announce_init(&a);
+    announce_number(&a, -6);
+    announce_digits(&a, "1.25");
+    TEST_ASSERT(strcmp(spoken(&a), "minus 6 1 2 5") == 0,
+                "Negative number and digit string");
+}
+
+static void test_frequency(void) {
+    printf("\nTest: Frequency\n");
+    announce_set_style(ANNOUNCE_VERBOSE);
+
+    Announcement a;
+    announce_init(&a);
+    announce_frequency(&a, 14250000.0);
+    TEST_ASSERT(strcmp(spoken(&a), "14 point 2 5 0 0 0 megahertz") == 0,
+                "Decimals spelled out");
+
+    announce_init(&a);
+    announce_frequency(&a, 7000000.0);
+    TEST_ASSERT(strcmp(spoken(&a), "7 megahertz") == 0, "Whole megahertz");
+
+    announce_init(&a);
+    announce_frequency(&a, 14074019.0);
+    TEST_ASSERT(strcmp(spoken(&a), "14 point 0 7 4 0 1 megahertz") == 0,
+                "Truncated to 10 Hz");
+
+    announce_init(&a);
+    TEST_ASSERT(announce_frequency(&a, -1.0) == HAMPOD_ERROR && a.count == 0,
+                "No frequency appends nothing");
+}
+
+static void test_frequency_change(void) {
+    printf("\nTest: Frequency change\n");
+    announce_set_style(ANNOUNCE_VERBOSE);
+
+    Announcement a;
+    announce_init(&a);
+    announce_frequency_change(&a, 14250000.0, 14253000.0);
+    TEST_ASSERT(strcmp(spoken(&a), "253 kilohertz") == 0,
+                "Kilohertz within the megahertz");
+
+    announce_init(&a);
+    announce_frequency_change(&a, 14253000.0, 14254520.0);
+    TEST_ASSERT(strcmp(spoken(&a), "254 point 5 2 kilohertz") == 0,
+                "Hundreds and tens of hertz after the point");
+
+    announce_init(&a);
+    announce_frequency_change(&a, 14253000.0, 14253500.0);
+    TEST_ASSERT(strcmp(spoken(&a), "500 hertz") == 0,
+                "Hertz within the same kilohertz");
+
+    announce_init(&a);
+    announce_frequency_change(&a, 14253000.0, 7074000.0);
+    TEST_ASSERT(strcmp(spoken(&a), "7 point 0 7 4 0 0 megahertz") == 0,
+                "New megahertz in full");
+
+    announce_init(&a);
+    announce_frequency_change(&a, 0.0, 14253000.0);
+    TEST_ASSERT(strcmp(spoken(&a), "14 point 2 5 3 0 0 megahertz") == 0,
+                "No last frequency in full");
+
+    announce_set_style(ANNOUNCE_TERSE);
+    announce_init(&a);
+    announce_frequency_change(&a, 14250000.0, 14253000.0);
+    TEST_ASSERT(strcmp(spoken(&a), "253 k") == 0, "Terse keeps the unit");
+    announce_set_style(ANNOUNCE_VERBOSE);
+}
+
+static void test_terse(void) {
+    printf("\nTest: Terse style\n");
+    announce_set_style(ANNOUNCE_TERSE);
+
+    Announcement a;
+    announce_init(&a);
+    announce_label(&a, "Power set to", "Power");
+    announce_number(&a, 50);
+    announce_unit(&a, ANNOUNCE_UNIT_PERCENT);
+    TEST_ASSERT(strcmp(spoken(&a), "Power 50") == 0,
+                "Short label, percent left out");
+
+    announce_init(&a);
+    announce_frequency(&a, 14250000.0);
+    TEST_ASSERT(strcmp(spoken(&a), "14 point 2 5") == 0,
+                "Trailing zeros and unit left out");
+
+    announce_init(&a);
+    announce_switch(&a, "Noise blanker", false, 5);
+    TEST_ASSERT(strcmp(spoken(&a), "Noise blanker off") == 0,
+                "Level of a switch that is off left out");
+
+    announce_init(&a);
+    announce_switch(&a, "Noise blanker", true, 5);
+    TEST_ASSERT(strcmp(spoken(&a), "Noise blanker 5") == 0,
+                "Level of a switch that is on");
+
+    announce_init(&a);
+    announce_mode(&a, "CW Reverse");
+    announce_vfo(&a, "VFO A.");
+    announce_vfo(&a, "Current VFO");
+    TEST_ASSERT(strcmp(spoken(&a), "CW R A. Current") == 0,
+                "Mode name shortened, VFO prefix dropped");
+
+    announce_set_style(ANNOUNCE_VERBOSE);
+    announce_init(&a);
+    announce_label(&a, "Power set to", "Power");
+    TEST_ASSERT(strcmp(spoken(&a), "Power set to") == 0, "Verbose label");
+
+    announce_init(&a);
+    announce_switch(&a, "Noise blanker", false, 5);
+    announce_mode(&a, "CW Reverse");
+    announce_vfo(&a, "VFO A.");
+    TEST_ASSERT(strcmp(spoken(&a),
+                       "Noise blanker off level 5 CW Reverse VFO A.") == 0,
+                "Verbose switch, mode and VFO");
+}
+
+static void test_overflow(void) {
+    printf("\nTest: Overflow\n");
+
+    Announcement a;
+    announce_init(&a);
+    for (int i = 0; i < ANNOUNCE_MAX_SEGMENTS; i++) {
+        announce_number(&a, i);
+    }
+    TEST_ASSERT(announce_number(&a, 99) == HAMPOD_ERROR && a.overflow,
+                "Segment past the limit refused");
+
+    SpeechSequence seq;
+    TEST_ASSERT(announce_render(&a, &seq) == HAMPOD_ERROR,
+                "Overflowed announcement refused");
+
+    announce_init(&a);
+    TEST_ASSERT(announce_render(&a, &seq) == HAMPOD_ERROR,
+                "Empty announcement refused");
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main() {
+    printf("=== Announce Tests ===\n");
+
+    test_segments();
+    test_frequency();
+    test_frequency_change();
+    test_terse();
+    test_overflow();
+
+    printf("\n=== Results: %d passed, %d failed ===\n", tests_passed,
+           tests_failed);
+
+    if (tests_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
@@ -0,0 +1,204 @@
+/**
+ * test_api.c - Test the Local Control API
+ *
+ * Verifies the JSON socket:
+ * 1. A client is greeted with hello and the known radio state
+ * 2. Radio state changes and key events are streamed, repeats of a value
+ *    are not
+ * 3. Commands are answered, with errors while the keypad and speech are
+ *    not running
+ * 4. A path that is not a socket is left alone
+ *
+ * Note: This test runs WITHOUT Firmware.
+ *
+ * Usage:
+ *   make tests
+ *   ./bin/test_api
+ */
+
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "api.h"
+#include "hampod_core.h"
+#include "radio_state.h"
+
+// ============================================================================
+// Test Framework
+// ============================================================================
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, msg) do { \
+    if (condition) { \
+        printf("  ✓ PASS: %s\n", msg); \
+        tests_passed++; \
+    } else { \
+        printf("  ✗ FAIL: %s\n", msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+#define TEST_SOCKET "/tmp/hampod_test_api.sock"
+#define TEST_FILE "/tmp/hampod_test_api.file"
+
+static int connect_client(void) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", TEST_SOCKET);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Read one line, waiting up to a second. Empty if none came.
+static void read_line(int fd, char *line, size_t size) {
+    size_t n = 0;
+    while (n + 1 < size) {
+        struct pollfd pfd = {fd, POLLIN, 0};
+        if (poll(&pfd, 1, 1000) <= 0 || read(fd, &line[n], 1) != 1 ||
+            line[n] == '\n') {
+            break;
+        }
+        n++;
+    }
+    line[n] = '\0';
+}
+
+static void send_command(int fd, const char *command) {
+    if (write(fd, command, strlen(command)) < 0) {
+        perror("write");
+    }
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+static void test_greeting(int fd) {
+    printf("\nTest: Greeting\n");
+    char line[API_LINE_MAX];
+    read_line(fd, line, sizeof(line));
+    TEST_ASSERT(strcmp(line, "{\"event\":\"hello\",\"api\":1}") == 0,
+                "Hello first");
+    read_line(fd, line, sizeof(line));
+    TEST_ASSERT(strcmp(line, "{\"event\":\"state\",\"radio\":"
+                             "{\"freq\":14074000,\"power\":50}}") == 0,
+                "Then the known fields");
+}
+
+static void test_events(int fd) {
+    printf("\nTest: Events\n");
+    char line[API_LINE_MAX];
+
+    radio_state_store(RADIO_FIELD_FREQ, 14074000.0); // Unchanged
+    radio_state_store(RADIO_FIELD_FREQ, 14074500.0);
+    read_line(fd, line, sizeof(line));
+    TEST_ASSERT(strcmp(line, "{\"event\":\"radio\",\"field\":\"freq\","
+                             "\"value\":14074500}") == 0,
+                "Change streamed, unchanged value not");
+
+    api_note_key('#', true);
+    read_line(fd, line, sizeof(line));
+    TEST_ASSERT(strcmp(line, "{\"event\":\"key\",\"key\":\"#\","
+                             "\"hold\":true}") == 0,
+                "Key event streamed");
+}
+
+static void test_commands(int fd) {
+    printf("\nTest: Commands\n");
+    char line[API_LINE_MAX];
+
+    send_command(fd, "{\"cmd\":\"key\",\"key\":\"5\"}\n");
+    read_line(fd, line, sizeof(line));
+    TEST_ASSERT(strstr(line, "\"cmd\":\"key\",\"ok\":false") != NULL,
+                "Key refused without the keypad");
+
+    send_command(fd, "{\"cmd\": \"say\", \"text\": \"a \\\"quote\\\"\"}\n");
+    read_line(fd, line, sizeof(line));
+    TEST_ASSERT(strstr(line, "\"error\":\"speech not running\"") != NULL,
+                "Say refused without speech");
+
+    send_command(fd, "{\"cmd\":\"say\",\"text\":\"\\u0041\"}\n");
+    read_line(fd, line, sizeof(line));
+    TEST_ASSERT(strstr(line, "\"error\":\"speech not running\"") != NULL,
+                "Escaped text accepted");
+
+    // A \u with fewer than four hex digits must not be read past
+    send_command(fd, "{\"cmd\":\"say\",\"text\":\"\\u41\"}\n");
+    read_line(fd, line, sizeof(line));
+    TEST_ASSERT(strstr(line, "\"error\":\"no text\"") != NULL,
+                "Truncated escape refused");
+
+    // A value spelling a key name is not taken for the key
+    send_command(fd, "{\"text\":\"cmd\", \"cmd\":\"state\"}\n");
+    read_line(fd, line, sizeof(line));
+    TEST_ASSERT(strncmp(line, "{\"event\":\"state\"", 16) == 0,
+                "Key found after a value of the same name");
+
+    // Two commands in one write, the second split across two
+    send_command(fd, "{\"cmd\":\"state\"}\n{\"cmd\":\"nope\"");
+    read_line(fd, line, sizeof(line));
+    TEST_ASSERT(strncmp(line, "{\"event\":\"state\"", 16) == 0,
+                "State on request");
+    send_command(fd, "}\n");
+    read_line(fd, line, sizeof(line));
+    TEST_ASSERT(strstr(line, "\"error\":\"unknown cmd\"") != NULL,
+                "Unknown command answered");
+}
+
+static void test_not_a_socket(void) {
+    printf("\nTest: Not a socket\n");
+    FILE *out = fopen(TEST_FILE, "w");
+    fclose(out);
+    TEST_ASSERT(api_start(TEST_FILE) == HAMPOD_ERROR, "Refused");
+    TEST_ASSERT(access(TEST_FILE, F_OK) == 0, "File left alone");
+    unlink(TEST_FILE);
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main() {
+    printf("=== API Tests ===\n");
+
+    radio_state_store(RADIO_FIELD_FREQ, 14074000.0);
+    radio_state_store(RADIO_FIELD_POWER, 50.0);
+
+    if (api_start(TEST_SOCKET) != HAMPOD_OK) {
+        printf("✗ Cannot start the API on %s\n", TEST_SOCKET);
+        return 1;
+    }
+    int fd = connect_client();
+    TEST_ASSERT(fd >= 0, "Client connected");
+    if (fd >= 0) {
+        test_greeting(fd);
+        test_events(fd);
+        test_commands(fd);
+        close(fd);
+    }
+    api_stop();
+    TEST_ASSERT(access(TEST_SOCKET, F_OK) != 0, "Socket removed on stop");
+
+    test_not_a_socket();
+
+    printf("\n=== Results: %d passed, %d failed ===\n", tests_passed,
+           tests_failed);
+
+    if (tests_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
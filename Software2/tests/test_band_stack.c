@@ -0,0 +1,150 @@
+/**
+ * test_band_stack.c - Test Per-Band Memory
+ *
+ * Verifies the band stacking memory:
+ * 1. Frequencies map to bands; stepping wraps and works between bands
+ * 2. Remembering keeps the frequency, and the mode while it is fresh
+ * 3. Leaving a band writes the file; a new session loads it back
+ * 4. Out-of-band or malformed file lines are ignored
+ *
+ * Note: This test runs WITHOUT a radio.
+ *
+ * Usage:
+ *   make tests
+ *   ./bin/test_band_stack
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "band_stack.h"
+#include "radio_state.h"
+
+// ============================================================================
+// Test Framework
+// ============================================================================
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, msg) do { \
+    if (condition) { \
+        printf("  ✓ PASS: %s\n", msg); \
+        tests_passed++; \
+    } else { \
+        printf("  ✗ FAIL: %s\n", msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+#define TEST_BANDS "/tmp/hampod_test_band_stack.conf"
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+static void test_bands(void) {
+    printf("\nTest: Bands\n");
+    unlink(TEST_BANDS);
+    band_stack_init(TEST_BANDS);
+
+    int b20 = band_stack_find(14074000);
+    TEST_ASSERT(b20 >= 0 && strcmp(band_stack_name(b20), "20 meters") == 0,
+                "14.074 MHz is 20 meters");
+    TEST_ASSERT(band_stack_find(12000000) == -1, "12 MHz is in no band");
+    double low, high;
+    TEST_ASSERT(band_stack_range(b20, &low, &high) && low == 14000000 &&
+                high == 14350000, "20 meters edges");
+    TEST_ASSERT(!band_stack_range(-1, &low, &high), "No edges for no band");
+    TEST_ASSERT(strcmp(band_stack_name(band_stack_step(14074000, 1)),
+                       "17 meters") == 0, "Up from 20 meters is 17");
+    TEST_ASSERT(strcmp(band_stack_name(band_stack_step(14074000, -1)),
+                       "30 meters") == 0, "Down from 20 meters is 30");
+    TEST_ASSERT(strcmp(band_stack_name(band_stack_step(12000000, 1)),
+                       "20 meters") == 0, "Up from between bands");
+    TEST_ASSERT(band_stack_step(1900000, -1) == band_stack_count() - 1,
+                "Down from the lowest band wraps");
+
+    BandMemory memory;
+    TEST_ASSERT(band_stack_get(b20, &memory) &&
+                memory.freq_hz == 14200000 && memory.mode == 0,
+                "Default frequency, radio's mode");
+}
+
+static void test_remember(void) {
+    printf("\nTest: Remember\n");
+    unlink(TEST_BANDS);
+    band_stack_init(TEST_BANDS);
+    radio_state_clear();
+
+    int b20 = band_stack_find(14074000);
+    BandMemory memory;
+
+    band_stack_remember(14074000);
+    band_stack_get(b20, &memory);
+    TEST_ASSERT(memory.freq_hz == 14074000 && memory.mode == 0,
+                "Frequency kept, unknown mode left alone");
+
+    radio_state_store(RADIO_FIELD_MODE, 2);
+    radio_state_store(RADIO_FIELD_PASSBAND, 2400);
+    band_stack_remember(14250000);
+    band_stack_get(b20, &memory);
+    TEST_ASSERT(memory.freq_hz == 14250000 && memory.mode == 2 &&
+                memory.passband_hz == 2400, "Fresh mode and passband kept");
+
+    TEST_ASSERT(access(TEST_BANDS, F_OK) != 0,
+                "Nothing written while on the band");
+    radio_state_clear();
+    band_stack_remember(7074000);
+    TEST_ASSERT(access(TEST_BANDS, F_OK) == 0, "Leaving the band writes");
+}
+
+static void test_reload(void) {
+    printf("\nTest: Reload\n");
+    band_stack_init(TEST_BANDS);
+
+    BandMemory memory;
+    band_stack_get(band_stack_find(14000000), &memory);
+    TEST_ASSERT(memory.freq_hz == 14250000 && memory.mode == 2 &&
+                memory.passband_hz == 2400, "20 meters loaded back");
+
+    FILE *out = fopen(TEST_BANDS, "w");
+    fputs("# comment\n"
+          "40m 14074000 1 0\n"
+          "garbage\n"
+          "80m 3573000 1 500\n", out);
+    fclose(out);
+    band_stack_init(TEST_BANDS);
+
+    band_stack_get(band_stack_find(7000000), &memory);
+    TEST_ASSERT(memory.freq_hz == 7150000, "Out-of-band entry ignored");
+    band_stack_get(band_stack_find(3500000), &memory);
+    TEST_ASSERT(memory.freq_hz == 3573000 && memory.passband_hz == 500,
+                "Valid entry loaded");
+    unlink(TEST_BANDS);
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main() {
+    printf("=== Band Stack Tests ===\n");
+
+    test_bands();
+    test_remember();
+    test_reload();
+
+    printf("\n=== Results: %d passed, %d failed ===\n", tests_passed,
+           tests_failed);
+
+    if (tests_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
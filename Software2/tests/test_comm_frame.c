@@ -0,0 +1,304 @@
+/**
+ * test_comm_frame.c - Test Shared Packet Framing
+ *
+ * Verifies the framed packet encoder/decoder in Firmware/hampod_frame.h,
+ * which both Firmware and Software2 use on the named pipes:
+ * 1. Single frame round-trip (header fields and payload)
+ * 2. Several frames delivered by one read() are split correctly
+ * 3. Header-only (zero-length) frames
+ * 4. Oversized frames are rejected on write
+ * 5. Payloads larger than the caller's buffer and corrupt headers are
+ *    dropped, and the stream stays in sync
+ * 6. Frames over the SOCK_SEQPACKET transport (Firmware/hampod_transport.h)
+ * 7. Fragment flags travel in the type word and are split back out
+ * 8. Speech epochs share the flags with fragments and compare across wrap
+ *
+ * Note: This test runs WITHOUT Firmware - it uses an anonymous pipe and a
+ * temporary socket in /tmp.
+ *
+ * Usage:
+ *   make tests
+ *   ./bin/test_comm_frame
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "hampod_core.h"
+#include "comm.h"
+
+// comm.o already carries the frame implementation
+#define SHAREDLIB
+#include "hampod_frame.h"
+#include "hampod_transport.h"
+
+// ============================================================================
+// Test Framework
+// ============================================================================
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, msg) do { \
+    if (condition) { \
+        printf("  ✓ PASS: %s\n", msg); \
+        tests_passed++; \
+    } else { \
+        printf("  ✗ FAIL: %s\n", msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+static int fds[2];
+static Frame_reader reader;
+
+static void setup_pipe(void) {
+    if (pipe(fds) != 0) {
+        perror("pipe");
+        exit(1);
+    }
+    frame_reader_init(&reader, fds[0]);
+}
+
+static void teardown_pipe(void) {
+    close(fds[0]);
+    close(fds[1]);
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+static void test_round_trip(void) {
+    printf("\nTest: Single frame round-trip\n");
+    setup_pipe();
+
+    const char *text = "dHello World";
+    int rc = frame_write(fds[1], PACKET_AUDIO, 42, text, strlen(text) + 1);
+    TEST_ASSERT(rc == 0, "frame_write succeeds");
+
+    Frame_header header;
+    unsigned char data[COMM_MAX_DATA_LEN];
+    rc = frame_read(&reader, &header, data, sizeof(data));
+    TEST_ASSERT(rc == 0, "frame_read succeeds");
+    TEST_ASSERT(header.type == PACKET_AUDIO, "Type preserved");
+    TEST_ASSERT(header.tag == 42, "Tag preserved");
+    TEST_ASSERT(header.data_len == strlen(text) + 1, "Length preserved");
+    TEST_ASSERT(strcmp((char *)data, text) == 0, "Payload preserved");
+
+    teardown_pipe();
+}
+
+static void test_back_to_back(void) {
+    printf("\nTest: Back-to-back frames in one read\n");
+    setup_pipe();
+
+    // Queue three frames before reading anything, so the first read()
+    // pulls all of them into the reader buffer at once
+    for (unsigned short i = 1; i <= 3; i++) {
+        unsigned char key = (unsigned char)('0' + i);
+        frame_write(fds[1], PACKET_KEYPAD, i, &key, 1);
+    }
+
+    Frame_header header;
+    unsigned char data[COMM_MAX_DATA_LEN];
+    int ok = 1;
+    for (unsigned short i = 1; i <= 3; i++) {
+        if (frame_read(&reader, &header, data, sizeof(data)) != 0 ||
+            header.tag != i || data[0] != '0' + i) {
+            ok = 0;
+        }
+    }
+    TEST_ASSERT(ok, "Three frames decoded in order");
+    TEST_ASSERT(reader.start == reader.end, "Reader buffer fully consumed");
+
+    teardown_pipe();
+}
+
+static void test_empty_payload(void) {
+    printf("\nTest: Zero-length frame\n");
+    setup_pipe();
+
+    TEST_ASSERT(frame_write(fds[1], PACKET_CONFIG, 7, NULL, 0) == 0,
+                "Header-only frame written");
+
+    Frame_header header;
+    unsigned char data[4];
+    TEST_ASSERT(frame_read(&reader, &header, data, sizeof(data)) == 0,
+                "Header-only frame read");
+    TEST_ASSERT(header.data_len == 0 && header.tag == 7, "Header intact");
+
+    teardown_pipe();
+}
+
+static void test_oversized_write(void) {
+    printf("\nTest: Oversized frame rejected\n");
+    setup_pipe();
+
+    static unsigned char big[FRAME_MAX_DATA + 1];
+    TEST_ASSERT(frame_write(fds[1], PACKET_AUDIO, 1, big, sizeof(big)) == -1,
+                "Frame larger than PIPE_BUF is refused");
+
+    teardown_pipe();
+}
+
+static void test_skip_large_payload(void) {
+    printf("\nTest: Payload larger than caller buffer\n");
+    setup_pipe();
+
+    unsigned char big[64];
+    memset(big, 'x', sizeof(big));
+    unsigned char small = 'k';
+    frame_write(fds[1], PACKET_AUDIO, 1, big, sizeof(big));
+    frame_write(fds[1], PACKET_AUDIO, 2, &small, 1);
+
+    Frame_header header;
+    unsigned char data[8];
+    TEST_ASSERT(frame_read(&reader, &header, data, sizeof(data)) ==
+                    FRAME_DROPPED,
+                "Large payload reported as dropped");
+    TEST_ASSERT(frame_read(&reader, &header, data, sizeof(data)) == 0 &&
+                    header.tag == 2 && data[0] == 'k',
+                "Next frame still decodes");
+
+    // A header claiming more than a frame can hold
+    unsigned char corrupt[FRAME_HEADER_SIZE] = {0};
+    corrupt[4] = 0xFF;
+    corrupt[5] = 0xFF;
+    TEST_ASSERT(write(fds[1], corrupt, sizeof(corrupt)) ==
+                    (ssize_t)sizeof(corrupt),
+                "Corrupt header written");
+    TEST_ASSERT(frame_read(&reader, &header, data, sizeof(data)) ==
+                    FRAME_DROPPED,
+                "Corrupt header reported as dropped");
+    frame_write(fds[1], PACKET_AUDIO, 3, &small, 1);
+    TEST_ASSERT(frame_read(&reader, &header, data, sizeof(data)) == 0 &&
+                    header.tag == 3,
+                "Frames after it decode");
+
+    teardown_pipe();
+}
+
+static void test_fragment_flags(void) {
+    printf("\nTest: Fragment flags\n");
+    setup_pipe();
+
+    const char *first = "dThe first half,";
+    const char *last = "dand the rest.";
+    frame_write_flags(fds[1], PACKET_AUDIO, FRAME_FLAG_MORE, 9, first,
+                      strlen(first) + 1);
+    frame_write(fds[1], PACKET_AUDIO, 9, last, strlen(last) + 1);
+
+    Frame_header header;
+    unsigned char data[COMM_MAX_DATA_LEN];
+    TEST_ASSERT(frame_read(&reader, &header, data, sizeof(data)) == 0 &&
+                    header.type == PACKET_AUDIO &&
+                    header.flags == FRAME_FLAG_MORE && header.tag == 9,
+                "First fragment flagged, type unchanged");
+    TEST_ASSERT(frame_read(&reader, &header, data, sizeof(data)) == 0 &&
+                    header.type == PACKET_AUDIO && header.flags == 0 &&
+                    strcmp((char *)data, last) == 0,
+                "Last fragment unflagged");
+
+    teardown_pipe();
+}
+
+static void test_speech_epoch(void) {
+    printf("\nTest: Speech epoch flags\n");
+    setup_pipe();
+
+    const char *text = "dPart one,";
+    frame_write_flags(fds[1], PACKET_AUDIO,
+                      FRAME_FLAG_MORE | FRAME_FLAGS_EPOCH(FRAME_EPOCH_MAX), 5,
+                      text, strlen(text) + 1);
+
+    Frame_header header;
+    unsigned char data[COMM_MAX_DATA_LEN];
+    TEST_ASSERT(frame_read(&reader, &header, data, sizeof(data)) == 0 &&
+                    header.type == PACKET_AUDIO &&
+                    (header.flags & FRAME_FLAG_MORE) &&
+                    FRAME_EPOCH(header.flags) == FRAME_EPOCH_MAX,
+                "Epoch and fragment flag both survive");
+    TEST_ASSERT(FRAME_EPOCH(FRAME_FLAGS_EPOCH(0)) == 0, "Epoch 0 is unstamped");
+
+    TEST_ASSERT(frame_epoch_newer(2, 1) && !frame_epoch_newer(1, 2),
+                "Later epoch is newer");
+    TEST_ASSERT(!frame_epoch_newer(7, 7), "Same epoch is not newer");
+    TEST_ASSERT(frame_epoch_newer(1, FRAME_EPOCH_MAX) &&
+                    !frame_epoch_newer(FRAME_EPOCH_MAX, 1),
+                "Epoch after the last wraps to 1");
+
+    teardown_pipe();
+}
+
+static void test_seqpacket_transport(void) {
+    printf("\nTest: Seqpacket transport\n");
+
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/hampod_test_%d.sock", (int)getpid());
+
+    int listen_fd = transport_listen_seqpacket(path);
+    TEST_ASSERT(listen_fd != -1, "Listening socket created");
+
+    Transport client, server;
+    TEST_ASSERT(transport_connect_seqpacket(path, &client) == 0,
+                "Client connects");
+    TEST_ASSERT(transport_accept(listen_fd, &server) == 0, "Server accepts");
+    TEST_ASSERT(client.rx_fd == client.tx_fd, "One fd for both directions");
+
+    // Two records back to back still decode as two frames
+    unsigned char key = '5';
+    int code = 0;
+    frame_write(server.tx_fd, PACKET_KEYPAD, 3, &key, 1);
+    frame_write(server.tx_fd, PACKET_AUDIO, 4, &code, sizeof(code));
+
+    Frame_reader client_reader;
+    frame_reader_init(&client_reader, client.rx_fd);
+    Frame_header header;
+    unsigned char data[COMM_MAX_DATA_LEN];
+    TEST_ASSERT(frame_read(&client_reader, &header, data, sizeof(data)) == 0 &&
+                    header.tag == 3 && data[0] == '5',
+                "First record decoded");
+    TEST_ASSERT(frame_read(&client_reader, &header, data, sizeof(data)) == 0 &&
+                    header.tag == 4 && header.data_len == sizeof(int),
+                "Second record decoded");
+
+    // Peer close is seen as EOF right away
+    transport_close(&server);
+    TEST_ASSERT(frame_read(&client_reader, &header, data, sizeof(data)) == -1,
+                "Closed peer reads as EOF");
+
+    transport_close(&client);
+    close(listen_fd);
+    unlink(path);
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main() {
+    printf("=== Packet Framing Tests ===\n");
+
+    test_round_trip();
+    test_back_to_back();
+    test_empty_payload();
+    test_oversized_write();
+    test_skip_large_payload();
+    test_fragment_flags();
+    test_speech_epoch();
+    test_seqpacket_transport();
+
+    printf("\n=== Results: %d passed, %d failed ===\n", tests_passed,
+           tests_failed);
+
+    if (tests_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
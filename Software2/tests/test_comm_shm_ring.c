@@ -0,0 +1,187 @@
+/**
+ * test_comm_shm_ring.c - Test Shared-Memory Audio Ring
+ *
+ * Verifies the request ring in Firmware/hampod_shm_ring.h that Software2
+ * uses instead of Firmware_i when Firmware runs with --shm-audio:
+ * 1. Attach fails when no Firmware created a segment
+ * 2. Push / peek / pop round-trip (type, tag, epoch and text in place)
+ * 3. Only one live producer may attach
+ * 4. The ring reports full instead of overwriting
+ * 5. Discard (speech interrupt) drops pending requests only
+ * 6. Semaphore wakeup and timeout
+ *
+ * Note: This test runs WITHOUT Firmware - it plays both the Firmware
+ * (consumer) and Software2 (producer) side on a private segment name.
+ *
+ * Usage:
+ *   make tests
+ *   ./bin/test_comm_shm_ring
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "hampod_core.h"
+
+// comm.o already carries the ring implementation
+#define SHAREDLIB
+#include "hampod_shm_ring.h"
+
+// ============================================================================
+// Test Framework
+// ============================================================================
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, msg) do { \
+    if (condition) { \
+        printf("  ✓ PASS: %s\n", msg); \
+        tests_passed++; \
+    } else { \
+        printf("  ✗ FAIL: %s\n", msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+static char ring_name[64];
+static Shm_audio_ring *consumer;
+static Shm_audio_ring *producer;
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+static void test_attach_missing(void) {
+    printf("\nTest: Attach without Firmware\n");
+    TEST_ASSERT(shm_ring_attach(ring_name) == NULL,
+                "No segment means no ring");
+}
+
+static void test_round_trip(void) {
+    printf("\nTest: Push / peek / pop round-trip\n");
+
+    TEST_ASSERT(shm_ring_peek(consumer) == NULL, "New ring is empty");
+    TEST_ASSERT(shm_ring_push(producer, AUDIO_TYPE_TTS, 21, 5, "Hello World") == 0,
+                "Request pushed");
+
+    Shm_audio_slot *slot = shm_ring_peek(consumer);
+    TEST_ASSERT(slot != NULL, "Consumer sees the request");
+    TEST_ASSERT(slot != NULL && slot->type == AUDIO_TYPE_TTS && slot->tag == 21,
+                "Type and tag preserved");
+    TEST_ASSERT(slot != NULL && slot->epoch == 5, "Speech epoch preserved");
+    TEST_ASSERT(slot != NULL && strcmp(slot->text, "Hello World") == 0,
+                "Text readable in place");
+
+    shm_ring_pop(consumer);
+    TEST_ASSERT(shm_ring_peek(consumer) == NULL, "Ring empty after pop");
+
+    static char too_long[SHM_RING_TEXT_MAX + 1];
+    memset(too_long, 'x', SHM_RING_TEXT_MAX);
+    TEST_ASSERT(shm_ring_push(producer, AUDIO_TYPE_TTS, 1, 0, too_long) == -1,
+                "Text longer than a slot is refused");
+}
+
+static void test_single_producer(void) {
+    printf("\nTest: Single producer\n");
+    TEST_ASSERT(shm_ring_attach(ring_name) == NULL,
+                "Second attach refused while producer is alive");
+}
+
+static void test_full(void) {
+    printf("\nTest: Full ring\n");
+
+    int pushed = 0;
+    for (int i = 0; i < SHM_RING_SLOTS; i++) {
+        if (shm_ring_push(producer, AUDIO_TYPE_FILE, (unsigned short)i, 0,
+                          "pregen_audio/5") == 0) {
+            pushed++;
+        }
+    }
+    TEST_ASSERT(pushed == SHM_RING_SLOTS, "Every slot accepted a request");
+    TEST_ASSERT(shm_ring_push(producer, AUDIO_TYPE_FILE, 99, 0, "x") == -1,
+                "Push into a full ring fails");
+
+    int in_order = 1;
+    for (int i = 0; i < SHM_RING_SLOTS; i++) {
+        Shm_audio_slot *slot = shm_ring_peek(consumer);
+        if (slot == NULL || slot->tag != i) {
+            in_order = 0;
+            break;
+        }
+        shm_ring_pop(consumer);
+    }
+    TEST_ASSERT(in_order, "Requests come out in order");
+}
+
+static void test_discard(void) {
+    printf("\nTest: Discard pending requests\n");
+
+    shm_ring_push(producer, AUDIO_TYPE_TTS, 1, 0, "old one");
+    shm_ring_push(producer, AUDIO_TYPE_TTS, 2, 0, "old two");
+    shm_ring_discard(producer);
+    shm_ring_push(producer, AUDIO_TYPE_TTS, 3, 0, "new");
+
+    Shm_audio_slot *slot = shm_ring_peek(consumer);
+    TEST_ASSERT(slot != NULL && slot->tag == 3,
+                "Requests before the discard are skipped");
+    shm_ring_pop(consumer);
+    TEST_ASSERT(shm_ring_peek(consumer) == NULL, "Nothing left afterwards");
+}
+
+static void test_wakeup(void) {
+    printf("\nTest: Consumer wakeup\n");
+
+    // Drain the posts left over from earlier pushes
+    while (shm_ring_wait(consumer, 0) == 0) {
+    }
+
+    TEST_ASSERT(shm_ring_wait(consumer, 1000) == -1,
+                "Wait times out on an idle ring");
+    shm_ring_push(producer, AUDIO_TYPE_TTS, 4, 0, "wake");
+    TEST_ASSERT(shm_ring_wait(consumer, 1000000) == 0,
+                "Push wakes the consumer");
+    shm_ring_pop(consumer);
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main() {
+    printf("=== Shared-Memory Audio Ring Tests ===\n");
+
+    snprintf(ring_name, sizeof(ring_name), "/hampod_test_%d", (int)getpid());
+
+    test_attach_missing();
+
+    consumer = shm_ring_create(ring_name);
+    producer = shm_ring_attach(ring_name);
+    if (consumer == NULL || producer == NULL) {
+        printf("  ✗ FAIL: Could not create/attach test ring\n");
+        shm_ring_destroy(consumer, ring_name);
+        return 1;
+    }
+
+    test_round_trip();
+    test_single_producer();
+    test_full();
+    test_discard();
+    test_wakeup();
+
+    shm_ring_detach(producer);
+    shm_ring_destroy(consumer, ring_name);
+
+    printf("\n=== Results: %d passed, %d failed ===\n", tests_passed,
+           tests_failed);
+
+    if (tests_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
@@ -5,9 +5,11 @@
 
 #include "config.h"
 #include <assert.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #define TEST_CONFIG_PATH "/tmp/test_hampod.conf"
@@ -112,6 +114,85 @@ void test_auto_save(void) {
   PASS();
 }
 
+void test_deferred_save(void) {
+  TEST("setters save after a quiet period, atomically");
+
+  unlink(TEST_CONFIG_PATH);
+  config_init(TEST_CONFIG_PATH);
+
+  // A burst of steps is one write, after the last of them
+  for (int volume = 30; volume <= 50; volume += 5) {
+    config_set_volume(volume);
+  }
+  if (access(TEST_CONFIG_PATH, F_OK) == 0) {
+    FAIL("written before the quiet period");
+    config_cleanup();
+    unlink(TEST_CONFIG_PATH);
+    return;
+  }
+
+  usleep((CONFIG_SAVE_DELAY_MS + 500) * 1000);
+  if (access(TEST_CONFIG_PATH, F_OK) != 0 ||
+      access(TEST_CONFIG_PATH ".tmp", F_OK) == 0) {
+    FAIL("not written after the quiet period, or temp file left");
+    config_cleanup();
+    unlink(TEST_CONFIG_PATH);
+    return;
+  }
+
+  config_cleanup();
+  config_init(TEST_CONFIG_PATH);
+  if (config_get_volume() != 50) {
+    FAIL("last value not saved");
+    config_cleanup();
+    unlink(TEST_CONFIG_PATH);
+    return;
+  }
+
+  config_cleanup();
+  unlink(TEST_CONFIG_PATH);
+  PASS();
+}
+
+static volatile bool g_stop_setter = false;
+
+static void *volume_setter(void *arg) {
+  (void)arg;
+  for (int i = 0; !g_stop_setter; i++) {
+    config_set_volume(i % 2 ? 20 : 80);
+  }
+  return NULL;
+}
+
+void test_snapshot_getters(void) {
+  TEST("getters see whole published values while a setter runs");
+
+  unlink(TEST_CONFIG_PATH);
+  config_init(TEST_CONFIG_PATH);
+  config_set_volume(20);
+
+  pthread_t setter;
+  g_stop_setter = false;
+  pthread_create(&setter, NULL, volume_setter, NULL);
+  bool torn = false;
+  for (int i = 0; i < 200000; i++) {
+    int volume = config_get_volume();
+    if (volume != 20 && volume != 80) {
+      torn = true;
+    }
+  }
+  g_stop_setter = true;
+  pthread_join(setter, NULL);
+
+  config_cleanup();
+  unlink(TEST_CONFIG_PATH);
+  if (torn) {
+    FAIL("read a value no setter wrote");
+    return;
+  }
+  PASS();
+}
+
 void test_undo_single(void) {
   TEST("undo restores previous value");
 
@@ -166,8 +247,8 @@ void test_undo_count(void) {
     return;
   }
 
-  config_set_volume(20);
-  config_set_volume(30);
+  config_set_speech_speed(1.5f);
+  config_set_key_beep_enabled(false);
   if (config_get_undo_count() != 3) {
     FAIL("undo count not 3 after three sets");
     config_cleanup();
@@ -185,9 +266,13 @@ void test_undo_max_depth(void) {
   unlink(TEST_CONFIG_PATH);
   config_init(TEST_CONFIG_PATH);
 
-  // Make 15 changes
+  // Make 15 changes, alternating settings so none coalesce
   for (int i = 0; i < 15; i++) {
-    config_set_volume(i);
+    if (i % 2 == 0) {
+      config_set_volume(i);
+    } else {
+      config_set_speech_speed(0.5f + i * 0.1f);
+    }
   }
 
   // Should only have CONFIG_UNDO_DEPTH (10) undos
@@ -221,6 +306,70 @@ void test_undo_max_depth(void) {
   PASS();
 }
 
+void test_undo_coalesce(void) {
+  TEST("repeated edits to one setting undo as one step");
+
+  unlink(TEST_CONFIG_PATH);
+  config_init(TEST_CONFIG_PATH);
+  int original = config_get_volume();
+
+  // Volume stepped up key press by key press
+  for (int v = 30; v <= 60; v += 5) {
+    config_set_volume(v);
+  }
+  if (config_get_undo_count() != 1) {
+    FAIL("volume steps not one undo step");
+    config_cleanup();
+    return;
+  }
+
+  // Another setting in between ends the step
+  config_set_speech_speed(1.5f);
+  config_set_volume(70);
+  if (config_get_undo_count() != 3) {
+    FAIL("edit after another setting coalesced");
+    config_cleanup();
+    return;
+  }
+
+  // So does a checkpoint
+  config_undo_checkpoint();
+  config_set_volume(75);
+  if (config_get_undo_count() != 4) {
+    FAIL("edit after checkpoint coalesced");
+    config_cleanup();
+    return;
+  }
+
+  config_undo();
+  config_undo();
+  config_undo();
+  if (config_get_volume() != 60) {
+    FAIL("undo did not restore end of first run");
+    config_cleanup();
+    return;
+  }
+  config_undo();
+  if (config_get_volume() != original) {
+    FAIL("undo did not restore value before the steps");
+    config_cleanup();
+    return;
+  }
+
+  // A radio switch changes several fields and undoes them all
+  config_set_radio_enabled(1, true);
+  config_undo();
+  if (config_get_active_radio_index() != 0) {
+    FAIL("radio switch not undone");
+    config_cleanup();
+    return;
+  }
+
+  config_cleanup();
+  unlink(TEST_CONFIG_PATH);
+  PASS();
+}
+
 void test_value_clamping(void) {
   TEST("setters clamp values to valid range");
 
@@ -279,6 +428,8 @@ void test_file_parsing(void) {
   fprintf(fp, "volume = 65\n");
   fprintf(fp, "speech_speed = 1.2\n");
   fprintf(fp, "key_beep = 0\n");
+  fprintf(fp, "firmware_beep = 1\n");
+  fprintf(fp, "terse = 1\n");
   fclose(fp);
 
   config_init(TEST_CONFIG_PATH);
@@ -313,6 +464,491 @@ void test_file_parsing(void) {
     unlink(TEST_CONFIG_PATH);
     return;
   }
+  if (config_get_firmware_beep_enabled() != true) {
+    FAIL("firmware_beep not parsed");
+    config_cleanup();
+    unlink(TEST_CONFIG_PATH);
+    return;
+  }
+  if (config_get_terse_enabled() != true) {
+    FAIL("terse not parsed");
+    config_cleanup();
+    unlink(TEST_CONFIG_PATH);
+    return;
+  }
+
+  config_cleanup();
+  unlink(TEST_CONFIG_PATH);
+  PASS();
+}
+
+void test_scheduling_survives_save(void) {
+  TEST("[scheduling] is parsed and kept on save");
+
+  FILE *fp = fopen(TEST_CONFIG_PATH, "w");
+  if (!fp) {
+    FAIL("could not create test file");
+    return;
+  }
+  fprintf(fp, "[scheduling]\n");
+  fprintf(fp, "audio_priority = 70\n");
+  fprintf(fp, "keypad_priority = 60\n");
+  fprintf(fp, "io_cpus = 0\n");
+  fprintf(fp, "tts_cpus = 1-3\n");
+  fprintf(fp, "mlock = 1\n");
+  fprintf(fp, "memory_profile = low\n");
+  fclose(fp);
+
+  // A setter rewrites the whole file from memory
+  config_init(TEST_CONFIG_PATH);
+  config_set_volume(40);
+  config_cleanup();
+  config_init(TEST_CONFIG_PATH);
+
+  const SchedulingSettings *sched = config_get_scheduling();
+  if (sched->audio_priority != 70 || sched->keypad_priority != 60 ||
+      strcmp(sched->io_cpus, "0") != 0 ||
+      strcmp(sched->tts_cpus, "1-3") != 0 || !sched->mlock ||
+      strcmp(sched->memory_profile, "low") != 0) {
+    FAIL("scheduling profile lost");
+    config_cleanup();
+    unlink(TEST_CONFIG_PATH);
+    return;
+  }
+
+  config_cleanup();
+  unlink(TEST_CONFIG_PATH);
+  PASS();
+}
+
+void test_tts_survives_save(void) {
+  TEST("[tts] survives a save");
+
+  FILE *fp = fopen(TEST_CONFIG_PATH, "w");
+  if (!fp) {
+    FAIL("could not create test file");
+    return;
+  }
+  fprintf(fp, "[tts]\nmodel = models/en_US-lessac-low.int8.onnx\n");
+  fprintf(fp, "accelerator = cuda\n");
+  fclose(fp);
+
+  // Only run_hampod.sh reads it, so Software2 must write it back as found
+  config_init(TEST_CONFIG_PATH);
+  config_set_volume(40);
+  config_cleanup();
+
+  char line[160];
+  bool model = false, accelerator = false;
+  fp = fopen(TEST_CONFIG_PATH, "r");
+  while (fp != NULL && fgets(line, sizeof(line), fp) != NULL) {
+    model |= strcmp(line, "model = models/en_US-lessac-low.int8.onnx\n") == 0;
+    accelerator |= strcmp(line, "accelerator = cuda\n") == 0;
+  }
+  if (fp != NULL) {
+    fclose(fp);
+  }
+  unlink(TEST_CONFIG_PATH);
+  if (!model || !accelerator) {
+    FAIL("[tts] lost");
+    return;
+  }
+  PASS();
+}
+
+void test_watchdog_ms(void) {
+  TEST("watchdog_ms default, 0 and save");
+
+  unlink(TEST_CONFIG_PATH);
+  config_init(TEST_CONFIG_PATH);
+  int fallback = config_get_scheduling()->watchdog_ms;
+  config_cleanup();
+
+  FILE *fp = fopen(TEST_CONFIG_PATH, "w");
+  if (!fp) {
+    FAIL("could not create test file");
+    return;
+  }
+  fprintf(fp, "[scheduling]\nwatchdog_ms = 0\n");
+  fclose(fp);
+  config_init(TEST_CONFIG_PATH);
+  int off = config_get_scheduling()->watchdog_ms;
+  config_set_volume(40);
+  config_cleanup();
+  config_init(TEST_CONFIG_PATH);
+  int saved = config_get_scheduling()->watchdog_ms;
+  config_cleanup();
+  unlink(TEST_CONFIG_PATH);
+
+  if (fallback != CONFIG_DEFAULT_WATCHDOG_MS || off != 0 || saved != 0) {
+    FAIL("watchdog_ms not kept");
+    return;
+  }
+  PASS();
+}
+
+void test_storage_batches_saves(void) {
+  TEST("[storage] tmpfs mode batches saves");
+
+  FILE *fp = fopen(TEST_CONFIG_PATH, "w");
+  if (!fp) {
+    FAIL("could not create test file");
+    return;
+  }
+  fprintf(fp, "[storage]\ntmpfs = 1\nwriteback_s = 60\n");
+  fclose(fp);
+
+  config_init(TEST_CONFIG_PATH);
+  const StorageSettings *storage = config_get_storage();
+  bool parsed = storage->tmpfs && storage->writeback_s == 60;
+  config_set_volume(40);
+  usleep((CONFIG_SAVE_DELAY_MS + 500) * 1000);
+  struct stat st;
+  bool held = stat(TEST_CONFIG_PATH, &st) == 0 && st.st_size < 64;
+  config_cleanup(); // Writes the batch
+  config_init(TEST_CONFIG_PATH);
+  bool saved = config_get_volume() == 40 && config_get_storage()->tmpfs &&
+               config_get_storage()->writeback_s == 60;
+  config_cleanup();
+  unlink(TEST_CONFIG_PATH);
+
+  if (!parsed) {
+    FAIL("[storage] not parsed");
+  } else if (!held) {
+    FAIL("saved before the batch was due");
+  } else if (!saved) {
+    FAIL("not saved on the way out, or [storage] lost");
+  } else {
+    PASS();
+  }
+}
+
+void test_reload(void) {
+  TEST("reload takes hand edits, not our own saves");
+
+  unlink(TEST_CONFIG_PATH);
+  config_init(TEST_CONFIG_PATH);
+  config_set_volume(40);
+  config_save();
+  if (config_reload() != 0) {
+    FAIL("own save reported as an edit");
+    config_cleanup();
+    unlink(TEST_CONFIG_PATH);
+    return;
+  }
+
+  // Edit two live settings and a radio by hand
+  FILE *fp = fopen(TEST_CONFIG_PATH, "w");
+  if (!fp) {
+    FAIL("could not create test file");
+    config_cleanup();
+    return;
+  }
+  fprintf(fp, "[radio.1]\nenabled = 1\nmodel = 2014\n");
+  fprintf(fp, "[audio]\nvolume = 60\nspeech_speed = 1.00\n");
+  fprintf(fp, "key_beep = 1\ntts_ram_mb = 16\nspell_phonetic = 1\n");
+  fclose(fp);
+
+  unsigned changed = config_reload();
+  unsigned expected =
+      CONFIG_CHANGED_VOLUME | CONFIG_CHANGED_TTS_RAM | CONFIG_CHANGED_SPELL;
+  if (changed != expected) {
+    char msg[64];
+    snprintf(msg, sizeof(msg), "changes 0x%02X, expected 0x%02X", changed,
+             expected);
+    FAIL(msg);
+    config_cleanup();
+    unlink(TEST_CONFIG_PATH);
+    return;
+  }
+  if (config_get_volume() != 60 || config_get_tts_ram_mb() != 16 ||
+      !config_get_spell_phonetic() || config_get_radio_model() != 2014) {
+    FAIL("edited values not taken");
+    config_cleanup();
+    unlink(TEST_CONFIG_PATH);
+    return;
+  }
+  if (config_reload() != 0) {
+    FAIL("same file reported twice");
+    config_cleanup();
+    unlink(TEST_CONFIG_PATH);
+    return;
+  }
+
+  // An unsaved setter change survives an edit of another setting
+  config_set_terse_enabled(true);
+  fp = fopen(TEST_CONFIG_PATH, "w");
+  fprintf(fp, "[radio.1]\nenabled = 1\nmodel = 2014\n");
+  fprintf(fp, "[audio]\nvolume = 70\ntts_ram_mb = 16\nspell_phonetic = 1\n");
+  fclose(fp);
+  changed = config_reload();
+  if (changed != CONFIG_CHANGED_VOLUME || config_get_volume() != 70 ||
+      !config_get_terse_enabled()) {
+    FAIL("unsaved change lost or edit not taken");
+    config_cleanup();
+    unlink(TEST_CONFIG_PATH);
+    return;
+  }
+
+  config_cleanup();
+  unlink(TEST_CONFIG_PATH);
+  PASS();
+}
+
+void test_scan_settings(void) {
+  TEST("[scan]: defaults, parsing, kept on save");
+
+  unlink(TEST_CONFIG_PATH);
+  config_init(TEST_CONFIG_PATH);
+  const ScanSettings *scan = config_get_scan();
+  if (scan->step_hz != CONFIG_DEFAULT_SCAN_STEP_HZ ||
+      scan->dwell_ms != CONFIG_DEFAULT_SCAN_DWELL_MS ||
+      scan->threshold_db != CONFIG_DEFAULT_SCAN_THRESHOLD_DB) {
+    FAIL("wrong scan defaults");
+    config_cleanup();
+    unlink(TEST_CONFIG_PATH);
+    return;
+  }
+  config_cleanup();
+
+  FILE *fp = fopen(TEST_CONFIG_PATH, "w");
+  if (!fp) {
+    FAIL("could not create test file");
+    return;
+  }
+  fprintf(fp, "[scan]\n");
+  fprintf(fp, "step_hz = 12500\n");
+  fprintf(fp, "dwell_ms = 250\n");
+  fprintf(fp, "threshold_db = 0\n");
+  fclose(fp);
+
+  config_init(TEST_CONFIG_PATH);
+  config_set_volume(40);
+  config_cleanup();
+  config_init(TEST_CONFIG_PATH);
+
+  scan = config_get_scan();
+  if (scan->step_hz != 12500 || scan->dwell_ms != 250 ||
+      scan->threshold_db != 0) {
+    FAIL("scan settings lost");
+    config_cleanup();
+    unlink(TEST_CONFIG_PATH);
+    return;
+  }
+
+  config_cleanup();
+  unlink(TEST_CONFIG_PATH);
+  PASS();
+}
+
+void test_radio_poll_limits(void) {
+  TEST("Radio poll limits: defaults, parsing, kept on save");
+
+  FILE *fp = fopen(TEST_CONFIG_PATH, "w");
+  if (!fp) {
+    FAIL("could not create test file");
+    return;
+  }
+  fprintf(fp, "[radio.1]\n");
+  fprintf(fp, "enabled = 1\n");
+  fprintf(fp, "model = 2004\n");
+  fprintf(fp, "poll_fast_ms = 120\n");
+  fprintf(fp, "poll_idle_ms = 80\n\n");
+  fprintf(fp, "[radio.2]\n");
+  fprintf(fp, "model = 3073\n");
+  fclose(fp);
+
+  // Idle below fast is raised to fast; a setter rewrites the file
+  config_init(TEST_CONFIG_PATH);
+  config_set_volume(40);
+  config_cleanup();
+  config_init(TEST_CONFIG_PATH);
+
+  int fast_ms = 0, idle_ms = 0;
+  config_get_radio_poll_limits(0, &fast_ms, &idle_ms);
+  if (fast_ms != 120 || idle_ms != 120) {
+    FAIL("poll limits not parsed or not kept");
+    config_cleanup();
+    unlink(TEST_CONFIG_PATH);
+    return;
+  }
+
+  config_get_radio_poll_limits(1, &fast_ms, &idle_ms);
+  if (fast_ms != CONFIG_DEFAULT_POLL_FAST_MS ||
+      idle_ms != CONFIG_DEFAULT_POLL_IDLE_MS) {
+    FAIL("unset poll limits should give defaults");
+    config_cleanup();
+    unlink(TEST_CONFIG_PATH);
+    return;
+  }
+
+  config_cleanup();
+  unlink(TEST_CONFIG_PATH);
+  PASS();
+}
+
+void test_radio_standby_and_connection(void) {
+  TEST("Radio standby flag and connection update");
+
+  FILE *fp = fopen(TEST_CONFIG_PATH, "w");
+  if (!fp) {
+    FAIL("could not create test file");
+    return;
+  }
+  fprintf(fp, "[radio.1]\n");
+  fprintf(fp, "enabled = 1\n");
+  fprintf(fp, "model = 2004\n");
+  fprintf(fp, "device = /dev/ttyUSB0\n");
+  fprintf(fp, "baud = 19200\n\n");
+  fprintf(fp, "[radio.2]\n");
+  fprintf(fp, "model = 3073\n");
+  fprintf(fp, "standby = 1\n");
+  fclose(fp);
+  config_init(TEST_CONFIG_PATH);
+
+  if (config_get_radio(0)->standby || !config_get_radio(1)->standby) {
+    FAIL("standby not parsed");
+    config_cleanup();
+    unlink(TEST_CONFIG_PATH);
+    return;
+  }
+
+  // Unchanged values write nothing, changed ones are one undo step
+  config_update_radio_connection(0, "/dev/ttyUSB0", 19200, "", 0);
+  config_update_radio_connection(1, "/dev/ttyUSB1", 9600,
+                                 "/sys/bus/usb/devices/1-1.3", 3073);
+  if (config_get_undo_count() != 1) {
+    FAIL("expected exactly one undo step");
+    config_cleanup();
+    unlink(TEST_CONFIG_PATH);
+    return;
+  }
+
+  // Both survive a reload
+  config_cleanup();
+  config_init(TEST_CONFIG_PATH);
+  const RadioSettings *radio = config_get_radio(1);
+  if (!radio->standby || strcmp(radio->device, "/dev/ttyUSB1") != 0 ||
+      radio->baud != 9600 || radio->detected_model != 3073 ||
+      strcmp(config_get_radio_device(), "/dev/ttyUSB0") != 0) {
+    FAIL("connection or standby not saved");
+    config_cleanup();
+    unlink(TEST_CONFIG_PATH);
+    return;
+  }
+
+  config_cleanup();
+  unlink(TEST_CONFIG_PATH);
+  PASS();
+}
+
+void test_profiles(void) {
+  TEST("settings profiles saved and replaced");
+
+  unlink(TEST_CONFIG_PATH);
+  config_init(TEST_CONFIG_PATH);
+
+  ProfileSettings profile;
+  config_set_profile("contest", "mode CW, passband 500, power 100");
+  config_set_profile("dx", "mode USB, agc slow");
+  config_set_profile("contest", "mode CW, power 50");
+  if (config_get_undo_count() != 3 || config_get_profile("ragchew", &profile)) {
+    FAIL("wrong undo count or unknown profile found");
+    config_cleanup();
+    unlink(TEST_CONFIG_PATH);
+    return;
+  }
+
+  for (int i = 0; i < MAX_PROFILES; i++) {
+    char name[16];
+    snprintf(name, sizeof(name), "extra%d", i);
+    config_set_profile(name, "power 5");
+  }
+  if (config_set_profile("one_more", "power 5") != -1) {
+    FAIL("profile stored past MAX_PROFILES");
+    config_cleanup();
+    unlink(TEST_CONFIG_PATH);
+    return;
+  }
+
+  // Replaced in place, and both survive a reload
+  config_cleanup();
+  config_init(TEST_CONFIG_PATH);
+  if (!config_get_profile("contest", &profile) ||
+      strcmp(profile.settings, "mode CW, power 50") != 0 ||
+      !config_get_profile("dx", &profile) ||
+      strcmp(profile.settings, "mode USB, agc slow") != 0) {
+    FAIL("profiles not saved");
+    config_cleanup();
+    unlink(TEST_CONFIG_PATH);
+    return;
+  }
+
+  config_cleanup();
+  unlink(TEST_CONFIG_PATH);
+  PASS();
+}
+
+void test_invalid_values(void) {
+  TEST("invalid values refused, defaults kept");
+
+  FILE *fp = fopen(TEST_CONFIG_PATH, "w");
+  if (!fp) {
+    FAIL("could not create test file");
+    return;
+  }
+  fprintf(fp, "[audio]\n");
+  fprintf(fp, "volume = 150\n");
+  fprintf(fp, "speech_speed = fast\n");
+  fprintf(fp, "terse = true\n");
+  fprintf(fp, "tts_ram_mb = 12  # MB\n\n");
+  fprintf(fp, "[keypad]\n");
+  fprintf(fp, "layout = a_layout_name_too_long_to_fit\n\n");
+  fprintf(fp, "[scan]\n");
+  fprintf(fp, "step_hz = 0\n");
+  fprintf(fp, "dwell_ms = 250ms\n");
+  fclose(fp);
+  config_init(TEST_CONFIG_PATH);
+
+  if (config_get_volume() != CONFIG_DEFAULT_VOLUME ||
+      config_get_speech_speed() != CONFIG_DEFAULT_SPEECH_SPEED ||
+      strcmp(config_get_keypad_layout(), "calculator") != 0 ||
+      config_get_scan()->step_hz != CONFIG_DEFAULT_SCAN_STEP_HZ ||
+      config_get_scan()->dwell_ms != CONFIG_DEFAULT_SCAN_DWELL_MS) {
+    FAIL("invalid value taken");
+    config_cleanup();
+    unlink(TEST_CONFIG_PATH);
+    return;
+  }
+  if (!config_get_terse_enabled() || config_get_tts_ram_mb() != 12) {
+    FAIL("valid value beside them lost");
+    config_cleanup();
+    unlink(TEST_CONFIG_PATH);
+    return;
+  }
+
+  // Sections with nothing set are not written
+  config_set_volume(40);
+  config_save();
+  char line[256];
+  bool rotor = false;
+  fp = fopen(TEST_CONFIG_PATH, "r");
+  while (fp != NULL && fgets(line, sizeof(line), fp) != NULL) {
+    if (strcmp(line, "[rotor]\n") == 0) {
+      rotor = true;
+    }
+  }
+  if (fp != NULL) {
+    fclose(fp);
+  }
+  config_cleanup();
+  config_init(TEST_CONFIG_PATH);
+  if (rotor || config_get_volume() != 40 || !config_get_terse_enabled()) {
+    FAIL("save wrote an unset section or lost a value");
+    config_cleanup();
+    unlink(TEST_CONFIG_PATH);
+    return;
+  }
 
   config_cleanup();
   unlink(TEST_CONFIG_PATH);
@@ -329,11 +965,24 @@ int main(void) {
   test_init_defaults();
   test_setters_update_values();
   test_auto_save();
+  test_deferred_save();
+  test_snapshot_getters();
   test_undo_single();
   test_undo_count();
   test_undo_max_depth();
+  test_undo_coalesce();
   test_value_clamping();
   test_file_parsing();
+  test_scheduling_survives_save();
+  test_tts_survives_save();
+  test_watchdog_ms();
+  test_storage_batches_saves();
+  test_scan_settings();
+  test_reload();
+  test_radio_poll_limits();
+  test_radio_standby_and_connection();
+  test_profiles();
+  test_invalid_values();
 
   printf("\n=== Results ===\n");
   printf("Passed: %d\n", tests_passed);
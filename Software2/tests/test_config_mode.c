@@ -10,6 +10,7 @@
 int config_init(const char *config_path) { return 0; }
 int config_save(void) { return 0; }
 int config_undo(void) { return 0; }
+void config_undo_checkpoint(void) {}
 int config_get_undo_count(void) { return 0; }
 
 static int g_vol = 50;
@@ -24,15 +25,36 @@ static char g_layout[32] = "calculator";
 const char *config_get_keypad_layout(void) { return g_layout; }
 void config_set_keypad_layout(const char *layout) { strcpy(g_layout, layout); }
 
+static bool g_terse = false;
+bool config_get_terse_enabled(void) { return g_terse; }
+void config_set_terse_enabled(bool enabled) { g_terse = enabled; }
+
 bool config_get_key_beep_enabled(void) { return false; }
 int config_get_audio_card_number(void) { return 2; }
 
 void speech_say_text(const char *text) {
   // printf("SPEECH: %s\n", text);
 }
+void speech_sequence_init(void *seq) {}
+int speech_sequence_add_text(void *seq, const char *text) { return 0; }
+int speech_sequence_add_words(void *seq, const char *words) { return 0; }
+int speech_sequence_add_file(void *seq, const char *filepath) { return 0; }
+int speech_say_sequence_priority(const void *seq, int priority) { return 0; }
+int speech_say_sequence_latest(const void *seq, int priority, int slot,
+                               bool cut_off) {
+  return 0;
+}
+unsigned int speech_last_id(void) { return 0; }
+int speech_wait_item(unsigned int id, int timeout_ms) { return 0; }
+int speech_warm_words(const char *words) { return 0; }
 int comm_set_speech_speed(float speed) { return 0; }
 int comm_play_beep(int type) { return 0; }
 int comm_send_config_packet(unsigned char sc, unsigned char v) { return 0; }
+int comm_set_volume(int percent) { return 0; }
+
+// From announce.h, which can't be included: its speech.h prototypes clash
+// with the stubs above. 0 is verbose, 1 terse.
+int announce_get_style(void);
 
 // Test Helpers
 void test_entry(void) {
@@ -53,10 +75,27 @@ void test_exit_save(void) {
   printf("test_exit_save passed\n");
 }
 
+void test_style_live(void) {
+  config_mode_init();
+  config_mode_enter();
+  while (config_mode_get_parameter() != CONFIG_PARAM_STYLE) {
+    config_mode_handle_key('A', false);
+  }
+  config_mode_handle_key('C', false); // Toggle
+  assert(g_terse);
+  assert(announce_get_style() == 1);
+  config_mode_handle_key('C', false);
+  assert(!g_terse);
+  assert(announce_get_style() == 0);
+  config_mode_handle_key('C', true);
+  printf("test_style_live passed\n");
+}
+
 int main(void) {
   printf("Running config mode tests...\n");
   test_entry();
   test_exit_save();
+  test_style_live();
   printf("All config mode tests passed!\n");
   return 0;
 }
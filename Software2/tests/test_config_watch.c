@@ -0,0 +1,117 @@
+/**
+ * test_config_watch.c - Test Config File Hot Reload
+ *
+ * Verifies the config file watcher:
+ * 1. A hand edit of the file reaches the callback with its changes
+ * 2. Our own saves do not
+ * 3. Other files in the directory are ignored
+ *
+ * Note: This test runs WITHOUT Firmware.
+ *
+ * Usage:
+ *   make tests
+ *   ./bin/test_config_watch
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "config_watch.h"
+
+// ============================================================================
+// Test Framework
+// ============================================================================
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, msg) do { \
+    if (condition) { \
+        printf("  ✓ PASS: %s\n", msg); \
+        tests_passed++; \
+    } else { \
+        printf("  ✗ FAIL: %s\n", msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+#define TEST_CONFIG "/tmp/hampod_test_config_watch.conf"
+#define TEST_OTHER "/tmp/hampod_test_config_watch.other"
+
+static volatile unsigned g_changed = 0;
+static volatile int g_calls = 0;
+
+static void on_changed(unsigned changed) {
+    g_changed = changed;
+    g_calls++;
+}
+
+// Wait up to a second for the callback to have run calls times
+static int wait_calls(int calls) {
+    for (int i = 0; i < 100 && g_calls < calls; i++) {
+        struct timespec ts = {0, 10000000}; // 10ms
+        nanosleep(&ts, NULL);
+    }
+    return g_calls;
+}
+
+static void write_file(const char *path, const char *text) {
+    FILE *out = fopen(path, "w");
+    fputs(text, out);
+    fclose(out);
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+static void test_edits(void) {
+    printf("\nTest: Edits\n");
+    write_file(TEST_CONFIG, "[audio]\nvolume = 30\n");
+    config_init(TEST_CONFIG);
+    TEST_ASSERT(config_watch_start(on_changed) == 0, "Watch started");
+
+    write_file(TEST_CONFIG, "[audio]\nvolume = 55\nterse = 1\n");
+    TEST_ASSERT(wait_calls(1) == 1, "Hand edit calls back");
+    TEST_ASSERT(g_changed ==
+                (CONFIG_CHANGED_VOLUME | CONFIG_CHANGED_VERBOSITY),
+                "With volume and verbosity changed");
+    TEST_ASSERT(config_get_volume() == 55 && config_get_terse_enabled(),
+                "New values in effect");
+
+    config_set_volume(20);
+    config_save();
+    write_file(TEST_OTHER, "[audio]\nvolume = 90\n");
+    TEST_ASSERT(wait_calls(2) == 1, "Own save and other files ignored");
+    TEST_ASSERT(config_get_volume() == 20, "Setter value kept");
+
+    config_watch_stop();
+    config_cleanup();
+    unlink(TEST_CONFIG);
+    unlink(TEST_OTHER);
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main() {
+    printf("=== Config Watch Tests ===\n");
+
+    test_edits();
+
+    printf("\n=== Results: %d passed, %d failed ===\n", tests_passed,
+           tests_failed);
+
+    if (tests_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
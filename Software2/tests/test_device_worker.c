@@ -0,0 +1,183 @@
+/**
+ * test_device_worker.c - Test Device Command Workers
+ *
+ * Verifies that each device's worker is independent:
+ * 1. A command stuck on one device doesn't hold up another device's
+ * 2. Supersede keys only reach commands of the same device
+ * 3. Stopping one worker leaves the other running
+ *
+ * Note: This test runs WITHOUT devices - the commands only record calls.
+ *
+ * Usage:
+ *   make tests
+ *   ./bin/test_device_worker
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "device_worker.h"
+
+// ============================================================================
+// Test Framework
+// ============================================================================
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, msg) do { \
+    if (condition) { \
+        printf("  ✓ PASS: %s\n", msg); \
+        tests_passed++; \
+    } else { \
+        printf("  ✗ FAIL: %s\n", msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+static void sleep_ms(int ms) {
+    struct timespec ts = {ms / 1000, (ms % 1000) * 1000000L};
+    nanosleep(&ts, NULL);
+}
+
+static long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// ============================================================================
+// Devices
+// ============================================================================
+
+static DeviceWorker g_radio = DEVICE_WORKER_INITIALIZER("test-radio");
+static DeviceWorker g_rotor = DEVICE_WORKER_INITIALIZER("test-rotor");
+
+// Completion order: the command's id, negated if it was cancelled
+static int g_order[32];
+static int g_order_len = 0;
+static pthread_mutex_t g_order_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int run_blocked(void *arg) {
+    sleep_ms(300); // A radio that doesn't answer: one Hamlib timeout or more
+    return *(int *)arg;
+}
+
+static int run_quick(void *arg) {
+    return *(int *)arg;
+}
+
+static void record_done(int result, void *arg) {
+    pthread_mutex_lock(&g_order_mutex);
+    g_order[g_order_len++] =
+        result == DEVICE_CMD_CANCELLED ? -*(int *)arg : result;
+    pthread_mutex_unlock(&g_order_mutex);
+}
+
+static void submit(DeviceWorker *worker, DeviceCommandFn run, int key, int id) {
+    device_worker_submit(worker, 1, key, run, record_done, &id, sizeof(id));
+}
+
+static void reset_order(void) {
+    pthread_mutex_lock(&g_order_mutex);
+    g_order_len = 0;
+    pthread_mutex_unlock(&g_order_mutex);
+}
+
+static bool order_is(const int *expected, int count) {
+    pthread_mutex_lock(&g_order_mutex);
+    bool same = g_order_len == count &&
+                memcmp(g_order, expected, count * sizeof(int)) == 0;
+    pthread_mutex_unlock(&g_order_mutex);
+    return same;
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+static void test_independent(void) {
+    printf("\nTest: Devices don't wait on each other\n");
+    reset_order();
+    device_worker_start(&g_radio);
+    device_worker_start(&g_rotor);
+
+    submit(&g_radio, run_blocked, 0, 1); // Starts right away
+    sleep_ms(10);
+    long long started = now_ms();
+    submit(&g_rotor, run_quick, 0, 2);
+    TEST_ASSERT(device_worker_wait_idle(&g_rotor, 1000),
+                "Rotor worker goes idle");
+    TEST_ASSERT(now_ms() - started < 200,
+                "Rotor command ran while the radio was blocked");
+    TEST_ASSERT(device_worker_wait_idle(&g_radio, 1000),
+                "Radio worker goes idle");
+    const int expected[] = {2, 1};
+    TEST_ASSERT(order_is(expected, 2), "Rotor finished first");
+}
+
+static void test_keys_per_device(void) {
+    printf("\nTest: Supersede keys stay with their device\n");
+    reset_order();
+
+    submit(&g_radio, run_blocked, 0, 3);
+    submit(&g_rotor, run_blocked, 0, 4);
+    sleep_ms(10);
+    submit(&g_radio, run_quick, 1, 5);
+    submit(&g_rotor, run_quick, 1, 6);
+    submit(&g_rotor, run_quick, 1, 7); // Replaces 6 only
+    TEST_ASSERT(device_worker_cancel(&g_radio, 2) == 0,
+                "No radio command has another key");
+
+    TEST_ASSERT(device_worker_wait_idle(&g_radio, 1000) &&
+                    device_worker_wait_idle(&g_rotor, 1000),
+                "Both idle");
+    pthread_mutex_lock(&g_order_mutex);
+    bool found5 = false, cancelled6 = false, found7 = false;
+    for (int i = 0; i < g_order_len; i++) {
+        found5 |= g_order[i] == 5;
+        cancelled6 |= g_order[i] == -6;
+        found7 |= g_order[i] == 7;
+    }
+    pthread_mutex_unlock(&g_order_mutex);
+    TEST_ASSERT(found5 && cancelled6 && found7,
+                "Only the rotor's own queued command was superseded");
+}
+
+static void test_stop_one(void) {
+    printf("\nTest: Stop one worker\n");
+    reset_order();
+
+    device_worker_stop(&g_radio);
+    submit(&g_rotor, run_quick, 0, 8);
+    TEST_ASSERT(device_worker_wait_idle(&g_rotor, 1000),
+                "Rotor still runs commands");
+    const int expected[] = {8};
+    TEST_ASSERT(order_is(expected, 1), "Rotor command ran on its worker");
+    device_worker_stop(&g_rotor);
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main() {
+    printf("=== Device Command Worker Tests ===\n");
+
+    test_independent();
+    test_keys_per_device();
+    test_stop_one();
+
+    printf("\n=== Results: %d passed, %d failed ===\n", tests_passed,
+           tests_failed);
+
+    if (tests_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
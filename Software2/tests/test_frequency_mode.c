@@ -57,6 +57,77 @@ void speech_say_text(const char *text) {
   printf("[SPEECH] %s\n", text);
 }
 
+void speech_say_words(const char *words) { speech_say_text(words); }
+
+void speech_say_text_priority(const char *text, int priority) {
+  (void)priority;
+  speech_say_text(text);
+}
+
+void speech_say_words_latest(const char *words, int priority, int slot,
+                             bool cut_off) {
+  (void)priority;
+  (void)slot;
+  (void)cut_off;
+  speech_say_text(words);
+}
+
+// Mock speak sequences (announce.c builds one at a time) - said as the
+// text of their segments
+static char mock_sequence[256];
+
+void speech_sequence_init(void *seq) {
+  (void)seq;
+  mock_sequence[0] = '\0';
+}
+
+static int mock_sequence_add(const char *text) {
+  size_t len = strlen(mock_sequence);
+  snprintf(mock_sequence + len, sizeof(mock_sequence) - len, "%s%s",
+           len > 0 ? " " : "", text);
+  return 0;
+}
+
+int speech_sequence_add_text(void *seq, const char *text) {
+  (void)seq;
+  return mock_sequence_add(text);
+}
+
+int speech_sequence_add_words(void *seq, const char *words) {
+  (void)seq;
+  return mock_sequence_add(words);
+}
+
+int speech_sequence_add_file(void *seq, const char *filepath) {
+  (void)seq;
+  (void)filepath;
+  return 0;
+}
+
+int speech_say_sequence_priority(const void *seq, int priority) {
+  (void)seq;
+  (void)priority;
+  speech_say_text(mock_sequence);
+  return 0;
+}
+
+int speech_say_sequence_latest(const void *seq, int priority, int slot,
+                               bool cut_off) {
+  (void)slot;
+  (void)cut_off;
+  return speech_say_sequence_priority(seq, priority);
+}
+
+// Mock speech_warm_words - track the read-back warmed while typing
+static char last_warmed[256];
+static int warm_call_count = 0;
+
+int speech_warm_words(const char *words) {
+  strncpy(last_warmed, words, sizeof(last_warmed) - 1);
+  warm_call_count++;
+  return 0;
+}
+
 int speech_init(void) { return 0; }
 void speech_cleanup(void) {}
 
@@ -88,10 +159,23 @@ int config_get_radio_model(void) { return 3073; }
 const char *config_get_radio_device(void) { return "/dev/ttyUSB0"; }
 int config_get_radio_baud(void) { return 19200; }
 bool config_get_key_beep_enabled(void) { return false; }
+static bool mock_frequency_diff = false;
+bool config_get_frequency_diff(void) { return mock_frequency_diff; }
 
 // Mock comm_play_beep
 void comm_play_beep(const char *beep_type) { (void)beep_type; }
 
+// Mock comm_play_echo - track the typed digits echoed
+static char last_echo[64];
+static int echo_call_count = 0;
+
+int comm_play_echo(const char *clip) {
+  strncpy(last_echo, clip, sizeof(last_echo) - 1);
+  echo_call_count++;
+  printf("[ECHO] %s\n", clip);
+  return 0;
+}
+
 // Mock radio_queries (for radio_set_vfo used in submit_frequency)
 #include "radio_queries.h"
 int radio_set_vfo(RadioVfo vfo) {
@@ -100,6 +184,22 @@ int radio_set_vfo(RadioVfo vfo) {
   return 0;
 }
 
+// Mock radio worker - runs each command at once, as without a worker thread
+#include "radio_worker.h"
+int radio_worker_submit(RadioCommandPriority priority, RadioCommandKey key,
+                        RadioCommandFn run, RadioCommandDone done,
+                        const void *arg, size_t arg_size) {
+  (void)priority;
+  (void)key;
+  unsigned char copy[RADIO_CMD_MAX_ARG];
+  memcpy(copy, arg, arg_size);
+  int result = run(copy);
+  if (done) {
+    done(result, copy);
+  }
+  return 0;
+}
+
 // Mock normal_mode (for normal_mode_get_verbosity used in on_radio_change)
 bool normal_mode_get_verbosity(void) { return true; }
 
@@ -144,7 +244,7 @@ TEST(cycle_vfo) {
 
 TEST(enter_digits) {
   frequency_mode_init();
-  speech_call_count = 0;
+  echo_call_count = 0;
 
   // Enter mode
   frequency_mode_handle_key('#', false);
@@ -157,8 +257,9 @@ TEST(enter_digits) {
   frequency_mode_handle_key('4', false);
   ASSERT_EQ(frequency_mode_get_state(), FREQ_MODE_ENTERING);
 
-  // Should have announced each digit
-  ASSERT_TRUE(speech_call_count >= 3); // VFO + 2 digits
+  // Each digit echoed from its clip, not spoken
+  ASSERT_EQ(echo_call_count, 2);
+  ASSERT_EQ(strcmp(last_echo, "pregen_audio/4"), 0);
 }
 
 TEST(decimal_point) {
@@ -172,6 +273,7 @@ TEST(decimal_point) {
   // Insert decimal
   frequency_mode_handle_key('*', false);
   ASSERT_EQ(frequency_mode_get_state(), FREQ_MODE_ENTERING);
+  ASSERT_EQ(strcmp(last_echo, "pregen_audio/POINT"), 0);
 
   // More digits after decimal
   frequency_mode_handle_key('2', false);
@@ -212,6 +314,37 @@ TEST(submit_frequency) {
   ASSERT_TRUE(diff < 1000); // Allow 1 kHz tolerance
 }
 
+TEST(readback_warmed_while_typing) {
+  frequency_mode_init();
+  warm_call_count = 0;
+
+  // 144 typed: the read-back of 144 MHz, whose "144" is not a cached word
+  frequency_mode_handle_key('#', false);
+  frequency_mode_handle_key('1', false);
+  frequency_mode_handle_key('4', false);
+  frequency_mode_handle_key('4', false);
+  ASSERT_EQ(warm_call_count, 3);
+  ASSERT_EQ(strcmp(last_warmed, "144 megahertz"), 0);
+
+  // The decimal point alone does not change it
+  frequency_mode_handle_key('*', false);
+  ASSERT_EQ(warm_call_count, 3);
+
+  frequency_mode_handle_key('2', false);
+  ASSERT_EQ(strcmp(last_warmed, "144 point 2 0 0 0 0 megahertz"), 0);
+
+  // 600 MHz is out of range: nothing to warm for the last digit
+  frequency_mode_init();
+  warm_call_count = 0;
+  frequency_mode_handle_key('#', false);
+  frequency_mode_handle_key('6', false);
+  frequency_mode_handle_key('0', false);
+  frequency_mode_handle_key('0', false);
+  ASSERT_EQ(warm_call_count, 2);
+  ASSERT_EQ(strcmp(last_warmed, "60 megahertz"), 0);
+  frequency_mode_cancel();
+}
+
 TEST(cancel_with_double_star) {
   frequency_mode_init();
 
@@ -286,6 +419,31 @@ TEST(force_cancel) {
   ASSERT_FALSE(frequency_mode_is_active());
 }
 
+TEST(dial_changes_as_differences) {
+  frequency_mode_init();
+  mock_frequency_diff = true;
+
+  // The first change read in full
+  frequency_mode_announce_next_poll();
+  frequency_mode_on_radio_change(14250000.0);
+  ASSERT_EQ(strcmp(last_speech, "14 point 2 5 0 0 0 megahertz"), 0);
+
+  // Then only what changed
+  frequency_mode_on_radio_change(14253000.0);
+  ASSERT_EQ(strcmp(last_speech, "253 kilohertz"), 0);
+  frequency_mode_on_radio_change(14253500.0);
+  ASSERT_EQ(strcmp(last_speech, "500 hertz"), 0);
+
+  // A new band in full
+  frequency_mode_on_radio_change(7074000.0);
+  ASSERT_EQ(strcmp(last_speech, "7 point 0 7 4 0 0 megahertz"), 0);
+
+  // Off: every change in full
+  mock_frequency_diff = false;
+  frequency_mode_on_radio_change(7075000.0);
+  ASSERT_EQ(strcmp(last_speech, "7 point 0 7 5 0 0 megahertz"), 0);
+}
+
 // ============================================================================
 // Main
 // ============================================================================
@@ -299,11 +457,13 @@ int main(void) {
   RUN_TEST(enter_digits);
   RUN_TEST(decimal_point);
   RUN_TEST(submit_frequency);
+  RUN_TEST(readback_warmed_while_typing);
   RUN_TEST(cancel_with_double_star);
   RUN_TEST(cancel_with_d);
   RUN_TEST(cancel_from_vfo_select);
   RUN_TEST(key_not_consumed_when_idle);
   RUN_TEST(force_cancel);
+  RUN_TEST(dial_changes_as_differences);
 
   printf("\n=== Results: %d/%d tests passed ===\n", tests_passed, tests_run);
 
@@ -0,0 +1,194 @@
+/**
+ * test_keymap.c - Test Key Binding Table
+ *
+ * Verifies the (mode, key, hold, shift) -> action table:
+ * 1. Built-in bindings are the standard layout, with no file
+ * 2. A shifted key without its own binding runs the unshifted one
+ * 3. A file rebinds keys for every radio and per rig model
+ * 4. "none" unbinds; bad lines are skipped
+ * 5. Macros are defined by name and bound to keys
+ *
+ * Note: This test runs WITHOUT a radio or keypad.
+ *
+ * Usage:
+ *   make tests
+ *   ./bin/test_keymap
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "keymap.h"
+
+// ============================================================================
+// Test Framework
+// ============================================================================
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, msg) do { \
+    if (condition) { \
+        printf("  ✓ PASS: %s\n", msg); \
+        tests_passed++; \
+    } else { \
+        printf("  ✗ FAIL: %s\n", msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+#define TEST_KEYMAP "/tmp/hampod_test_keymap.conf"
+
+static void write_keymap(const char *text) {
+    FILE *out = fopen(TEST_KEYMAP, "w");
+    fputs(text, out);
+    fclose(out);
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+static void test_builtin(void) {
+    printf("\nTest: Built-in bindings\n");
+    keymap_init("/nonexistent/keymap.conf");
+
+    TEST_ASSERT(keymap_lookup(KEYMAP_MODE_NORMAL, '1', false, false) ==
+                KEYMAP_VFO_A, "[1] selects VFO A");
+    TEST_ASSERT(keymap_lookup(KEYMAP_MODE_NORMAL, '1', true, false) ==
+                KEYMAP_VFO_B, "[1] held selects VFO B");
+    TEST_ASSERT(keymap_lookup(KEYMAP_MODE_NORMAL, '1', false, true) ==
+                KEYMAP_VOX_STATUS, "Shift [1] reads VOX");
+    TEST_ASSERT(keymap_lookup(KEYMAP_MODE_GLOBAL, 'A', false, false) ==
+                KEYMAP_SHIFT, "[A] is shift");
+    TEST_ASSERT(keymap_lookup(KEYMAP_MODE_NORMAL, '6', true, false) ==
+                KEYMAP_BAND_DOWN, "[6] held steps a band down");
+    TEST_ASSERT(keymap_lookup(KEYMAP_MODE_NORMAL, '5', true, false) ==
+                KEYMAP_SCAN_MEMORIES, "[5] held scans the memories");
+    TEST_ASSERT(keymap_lookup(KEYMAP_MODE_NORMAL, '3', true, true) ==
+                KEYMAP_TUNE_DOWN, "[Shift]+[3] held tunes down");
+    TEST_ASSERT(keymap_lookup(KEYMAP_MODE_NORMAL, '9', false, false) ==
+                KEYMAP_NONE, "[9] alone unbound");
+    TEST_ASSERT(keymap_lookup(KEYMAP_MODE_NORMAL, 'x', false, false) ==
+                KEYMAP_NONE, "Unknown key unbound");
+}
+
+static void test_shift_fallback(void) {
+    printf("\nTest: Shift falls back\n");
+    keymap_init("/nonexistent/keymap.conf");
+
+    TEST_ASSERT(keymap_lookup(KEYMAP_MODE_NORMAL, '2', false, true) ==
+                KEYMAP_FREQUENCY, "Shift [2] reads the frequency");
+    TEST_ASSERT(keymap_lookup(KEYMAP_MODE_NORMAL, '4', true, true) ==
+                KEYMAP_AGC, "Shift [4] held reads AGC");
+}
+
+static void test_file(void) {
+    printf("\nTest: Keymap file\n");
+    write_keymap("# Test keymap\n"
+                 "[default]\n"
+                 "normal 9 press power   # rebind\n"
+                 "normal 7 press none\n"
+                 "normal 7 press launch_rockets\n"
+                 "normal 77 press power\n"
+                 "normal 0 shift say_again\n"
+                 "[model 2004]\n"
+                 "normal 9 press mic_gain\n"
+                 "normal B shift_hold mode\n");
+    keymap_init(TEST_KEYMAP);
+
+    TEST_ASSERT(keymap_lookup(KEYMAP_MODE_NORMAL, '9', false, false) ==
+                KEYMAP_POWER, "Default section rebinds");
+    TEST_ASSERT(keymap_lookup(KEYMAP_MODE_NORMAL, '7', false, false) ==
+                KEYMAP_NONE, "none unbinds, bad lines skipped");
+    TEST_ASSERT(keymap_lookup(KEYMAP_MODE_NORMAL, '0', false, true) ==
+                KEYMAP_SAY_AGAIN, "Say again bound");
+    TEST_ASSERT(keymap_lookup(KEYMAP_MODE_NORMAL, 'B', true, true) ==
+                KEYMAP_NONE, "Model section not used for other radios");
+
+    keymap_select_model(2004);
+    TEST_ASSERT(keymap_lookup(KEYMAP_MODE_NORMAL, '9', false, false) ==
+                KEYMAP_MIC_GAIN, "Model section on top");
+    TEST_ASSERT(keymap_lookup(KEYMAP_MODE_NORMAL, 'B', true, true) ==
+                KEYMAP_MODE, "shift_hold trigger");
+    TEST_ASSERT(keymap_lookup(KEYMAP_MODE_NORMAL, '1', false, false) ==
+                KEYMAP_VFO_A, "Built-in kept");
+
+    keymap_select_model(3073);
+    TEST_ASSERT(keymap_lookup(KEYMAP_MODE_NORMAL, '9', false, false) ==
+                KEYMAP_POWER, "Another model drops it");
+
+    unlink(TEST_KEYMAP);
+}
+
+static void test_macros(void) {
+    printf("\nTest: Macros\n");
+    write_keymap("normal 1 shift_hold macro ft8\n"
+                 "macro ft8 frequency 14.074, mode PKTUSB # data\n"
+                 "normal 9 press macro\n"
+                 "normal 7 press power extra\n"
+                 "normal 2 shift profile contest\n"
+                 "normal 2 shift_hold save_profile contest\n"
+                 "[model 2004]\n"
+                 "normal 9 hold macro ghost\n");
+    keymap_init(TEST_KEYMAP);
+
+    KeymapMacro macro;
+    TEST_ASSERT(keymap_lookup(KEYMAP_MODE_NORMAL, '1', true, true) ==
+                KEYMAP_MACRO, "Bound before it is defined");
+    TEST_ASSERT(keymap_lookup_macro(KEYMAP_MODE_NORMAL, '1', true, true,
+                                    &macro) &&
+                strcmp(macro.name, "ft8") == 0 &&
+                strcmp(macro.steps, "frequency 14.074, mode PKTUSB") == 0,
+                "Name and steps, without the comment");
+    TEST_ASSERT(keymap_lookup(KEYMAP_MODE_NORMAL, '9', false, false) ==
+                KEYMAP_NONE, "macro needs a name");
+    TEST_ASSERT(keymap_lookup(KEYMAP_MODE_NORMAL, '7', false, false) ==
+                KEYMAP_NOISE_BLANKER, "Other actions take no name");
+    TEST_ASSERT(!keymap_lookup_macro(KEYMAP_MODE_NORMAL, '1', false, false,
+                                     &macro), "Not a macro key");
+    TEST_ASSERT(keymap_lookup(KEYMAP_MODE_NORMAL, '2', false, true) ==
+                KEYMAP_PROFILE &&
+                keymap_lookup_macro(KEYMAP_MODE_NORMAL, '2', false, true,
+                                    &macro) &&
+                strcmp(macro.name, "contest") == 0, "Profile by name");
+    TEST_ASSERT(keymap_lookup(KEYMAP_MODE_NORMAL, '2', true, true) ==
+                KEYMAP_PROFILE_SAVE &&
+                keymap_lookup_macro(KEYMAP_MODE_NORMAL, '2', true, true,
+                                    &macro) &&
+                strcmp(macro.name, "contest") == 0, "Saved by name");
+
+    keymap_select_model(2004);
+    TEST_ASSERT(keymap_lookup_macro(KEYMAP_MODE_NORMAL, '9', true, false,
+                                    &macro) &&
+                strcmp(macro.name, "ghost") == 0 && macro.steps[0] == '\0',
+                "Undefined macro bound with no steps");
+
+    unlink(TEST_KEYMAP);
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main() {
+    printf("=== Keymap Tests ===\n");
+
+    test_builtin();
+    test_shift_fallback();
+    test_file();
+    test_macros();
+
+    printf("\n=== Results: %d passed, %d failed ===\n", tests_passed,
+           tests_failed);
+
+    if (tests_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
@@ -0,0 +1,126 @@
+/**
+ * test_macro.c - Test Keypad Macro Compiling
+ *
+ * Verifies that a macro's list of settings compiles into steps:
+ * 1. Each setting, with its units and spellings
+ * 2. Steps keep their order
+ * 3. The first bad step is reported by number
+ * 4. An undefined macro does not compile
+ *
+ * Note: This test runs WITHOUT a radio; nothing is queued or run.
+ *
+ * Usage:
+ *   make tests
+ *   ./bin/test_macro
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <hamlib/rig.h>
+
+#include "macro.h"
+#include "radio_queries.h"
+#include "radio_setters.h"
+
+// ============================================================================
+// Test Framework
+// ============================================================================
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, msg) do { \
+    if (condition) { \
+        printf("  ✓ PASS: %s\n", msg); \
+        tests_passed++; \
+    } else { \
+        printf("  ✗ FAIL: %s\n", msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+static int compile(const char *steps, Macro *macro) {
+    KeymapMacro source;
+    snprintf(source.name, sizeof(source.name), "test");
+    snprintf(source.steps, sizeof(source.steps), "%s", steps);
+    return macro_compile(&source, macro);
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+static void test_settings(void) {
+    printf("\nTest: Settings\n");
+    Macro macro;
+
+    TEST_ASSERT(compile("frequency 14.074, mode PKTUSB, power 30, "
+                        "preamp off", &macro) == 0 && macro.count == 4,
+                "The example compiles to four steps");
+    TEST_ASSERT(strcmp(macro.name, "test") == 0, "Named after the source");
+    TEST_ASSERT(macro.steps[0].kind == MACRO_STEP_FREQUENCY &&
+                macro.steps[0].value == 14074000, "MHz with a point");
+    TEST_ASSERT(macro.steps[1].kind == MACRO_STEP_MODE &&
+                macro.steps[1].value == RIG_MODE_PKTUSB, "Hamlib mode name");
+    TEST_ASSERT(macro.steps[2].kind == MACRO_STEP_POWER &&
+                macro.steps[2].value == 30, "Power percent");
+    TEST_ASSERT(macro.steps[3].kind == MACRO_STEP_PREAMP &&
+                macro.steps[3].value == 0, "Preamp off");
+
+    TEST_ASSERT(compile("frequency 7074000", &macro) == 0 &&
+                macro.steps[0].value == 7074000, "Hz without a point");
+    TEST_ASSERT(compile("mode usb-d", &macro) == 0 &&
+                macro.steps[0].value == RIG_MODE_PKTUSB, "Icom data alias");
+    TEST_ASSERT(compile("vfo B, agc slow, nb on, nr off, attenuation 12",
+                        &macro) == 0 && macro.count == 5 &&
+                macro.steps[0].value == RADIO_VFO_B &&
+                macro.steps[1].value == AGC_SLOW &&
+                macro.steps[2].value == 1 && macro.steps[3].value == 0 &&
+                macro.steps[4].value == 12, "Order and case kept");
+    TEST_ASSERT(compile("mode CW, passband 500", &macro) == 0 &&
+                macro.steps[1].kind == MACRO_STEP_PASSBAND &&
+                macro.steps[1].value == 500, "Passband in Hz");
+    TEST_ASSERT(!macro.changes_only, "Every step is sent");
+}
+
+static void test_errors(void) {
+    printf("\nTest: Errors\n");
+    Macro macro;
+
+    TEST_ASSERT(compile("power 30, power 150", &macro) == 2,
+                "Out of range at step 2");
+    TEST_ASSERT(compile("mode SSB", &macro) == 1, "Unknown mode");
+    TEST_ASSERT(compile("passband wide", &macro) == 1,
+                "Passband is a number");
+    TEST_ASSERT(compile("launch rockets", &macro) == 1, "Unknown setting");
+    TEST_ASSERT(compile("power 30 now", &macro) == 1, "One value per step");
+    TEST_ASSERT(compile("frequency 14.074,, mode CW", &macro) == 0 &&
+                macro.count == 2, "Empty steps skipped");
+    TEST_ASSERT(compile("", &macro) == 1, "Undefined macro");
+    TEST_ASSERT(compile("nb on, nb off, nb on, nb off, nb on, nb off, "
+                        "nb on, nb off, nb on", &macro) ==
+                MACRO_STEPS_MAX + 1, "Too many steps");
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main() {
+    printf("=== Macro Tests ===\n");
+
+    test_settings();
+    test_errors();
+
+    printf("\n=== Results: %d passed, %d failed ===\n", tests_passed,
+           tests_failed);
+
+    if (tests_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
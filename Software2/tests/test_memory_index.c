@@ -0,0 +1,181 @@
+/**
+ * test_memory_index.c - Test the Memory Channel Index
+ *
+ * Verifies the local index of memory channels:
+ * 1. Browsing steps through channels in use in order, wrapping
+ * 2. A saved index loads back for the same model only
+ * 3. Stores after a complete read are written at once
+ * 4. Invalidating drops a channel, or the whole index and its file
+ *
+ * Note: This test runs WITHOUT a radio - reads from it fail, so the
+ * index only holds what the test stores or writes.
+ *
+ * Usage:
+ *   make tests
+ *   ./bin/test_memory_index
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "memory_index.h"
+
+// ============================================================================
+// Test Framework
+// ============================================================================
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, msg) do { \
+    if (condition) { \
+        printf("  ✓ PASS: %s\n", msg); \
+        tests_passed++; \
+    } else { \
+        printf("  ✗ FAIL: %s\n", msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+#define TEST_FORMAT "/tmp/hampod_test_memories.%d.conf"
+#define TEST_FILE_1 "/tmp/hampod_test_memories.1.conf"
+#define TEST_FILE_2 "/tmp/hampod_test_memories.2.conf"
+#define TEST_MODEL 3073
+
+static RadioMemory memory_at(int channel, double freq_hz, const char *name) {
+    RadioMemory memory;
+    memset(&memory, 0, sizeof(memory));
+    memory.channel = channel;
+    memory.freq_hz = freq_hz;
+    memory.mode = 2;
+    snprintf(memory.name, sizeof(memory.name), "%s", name);
+    return memory;
+}
+
+static void write_file(const char *path, const char *contents) {
+    FILE *out = fopen(path, "w");
+    if (out) {
+        fputs(contents, out);
+        fclose(out);
+    }
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+static void test_browse(void) {
+    printf("\nTest: Browsing\n");
+    unlink(TEST_FILE_1);
+    memory_index_init(TEST_FORMAT);
+    memory_index_select(0, TEST_MODEL);
+
+    RadioMemory memory;
+    TEST_ASSERT(memory_index_count() == 0 && !memory_index_is_complete(),
+                "Never read: empty and not complete");
+    TEST_ASSERT(!memory_index_step(-1, 1, &memory), "Nothing to step to");
+
+    RadioMemory stored[] = {
+        memory_at(12, 7074000, "FT8 40"),
+        memory_at(3, 14074000, "FT8 20"),
+        memory_at(40, 146520000, "Simplex"),
+    };
+    memory_index_store(stored, 3);
+    TEST_ASSERT(memory_index_count() == 3, "Three channels in use");
+
+    TEST_ASSERT(memory_index_step(-1, 1, &memory) && memory.channel == 3,
+                "Up from the start: lowest channel");
+    TEST_ASSERT(memory_index_step(3, 1, &memory) && memory.channel == 12,
+                "Up: next channel in use");
+    TEST_ASSERT(memory_index_step(40, 1, &memory) && memory.channel == 3,
+                "Up from the highest wraps");
+    TEST_ASSERT(memory_index_step(3, -1, &memory) && memory.channel == 40,
+                "Down from the lowest wraps");
+    TEST_ASSERT(memory_index_step(20, -1, &memory) && memory.channel == 12,
+                "Down from an empty channel: the one below");
+    TEST_ASSERT(memory_index_get(40, &memory) &&
+                    strcmp(memory.name, "Simplex") == 0 &&
+                    memory.freq_hz == 146520000,
+                "Channel read back");
+
+    RadioMemory cleared = memory_at(12, 0, "");
+    memory_index_store(&cleared, 1);
+    TEST_ASSERT(!memory_index_get(12, &memory) && memory_index_count() == 2,
+                "Cleared channel removed");
+    TEST_ASSERT(access(TEST_FILE_1, F_OK) != 0,
+                "Incomplete index not written");
+}
+
+static void test_persist(void) {
+    printf("\nTest: Saved index\n");
+    write_file(TEST_FILE_1, "# Saved\n"
+                            "model 3073\n"
+                            "1 3573000 2 0 FT8 80\n"
+                            "5 14250000 2 2400 Net\n"
+                            "bad line\n");
+    memory_index_select(1, TEST_MODEL);
+    memory_index_select(0, TEST_MODEL);
+
+    RadioMemory memory;
+    TEST_ASSERT(memory_index_is_complete() && memory_index_count() == 2,
+                "Loaded complete, malformed line skipped");
+    TEST_ASSERT(memory_index_get(1, &memory) &&
+                    strcmp(memory.name, "FT8 80") == 0,
+                "Name with a space loaded");
+    TEST_ASSERT(memory_index_get(5, &memory) && memory.passband_hz == 2400,
+                "Passband loaded");
+
+    RadioMemory added = memory_at(9, 21074000, "FT8 15");
+    memory_index_store(&added, 1);
+    memory_index_select(1, TEST_MODEL);
+    memory_index_select(0, TEST_MODEL);
+    TEST_ASSERT(memory_index_get(9, &memory) && memory_index_count() == 3,
+                "Store after a complete read written at once");
+
+    memory_index_select(0, 2004);
+    TEST_ASSERT(memory_index_count() == 0 && !memory_index_is_complete(),
+                "Index of another model ignored");
+}
+
+static void test_invalidate(void) {
+    printf("\nTest: Invalidating\n");
+    memory_index_select(0, TEST_MODEL);
+
+    RadioMemory memory;
+    memory_index_invalidate(5);
+    TEST_ASSERT(!memory_index_get(5, &memory) && memory_index_count() == 2,
+                "Written channel dropped until read again");
+
+    memory_index_invalidate(-1);
+    TEST_ASSERT(memory_index_count() == 0 && !memory_index_is_complete(),
+                "Whole index dropped");
+    TEST_ASSERT(access(TEST_FILE_1, F_OK) != 0, "Its file removed");
+
+    unlink(TEST_FILE_1);
+    unlink(TEST_FILE_2);
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main() {
+    printf("=== Memory Index Tests ===\n");
+
+    test_browse();
+    test_persist();
+    test_invalidate();
+
+    printf("\n=== Results: %d passed, %d failed ===\n", tests_passed,
+           tests_failed);
+
+    if (tests_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
@@ -0,0 +1,167 @@
+/**
+ * test_meter.c - Test Meter Sampling Statistics
+ *
+ * Verifies the meter sample windows:
+ * 1. Average, minimum and maximum over the window
+ * 2. The S-meter spoken as its average, power as its peak
+ * 3. The peak held past the window, samples dropped after it
+ * 4. A frequency change starts the samples afresh
+ * 5. Sampling starts and stops without a radio
+ *
+ * Note: This test runs WITHOUT Firmware or a radio.
+ *
+ * Usage:
+ *   make tests
+ *   ./bin/test_meter
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "meter.h"
+#include "radio_state.h"
+
+// ============================================================================
+// Test Framework
+// ============================================================================
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, msg) do { \
+    if (condition) { \
+        printf("  ✓ PASS: %s\n", msg); \
+        tests_passed++; \
+    } else { \
+        printf("  ✗ FAIL: %s\n", msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+#define TEST_CONFIG "/tmp/hampod_test_meter.conf"
+
+static bool near(double a, double b) { return a - b < 1e-9 && b - a < 1e-9; }
+
+static void sleep_ms(int ms) {
+    struct timespec ts = {ms / 1000, (ms % 1000) * 1000000L};
+    nanosleep(&ts, NULL);
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+static void test_window(void) {
+    printf("\nTest: Window\n");
+    double value;
+    TEST_ASSERT(!meter_reading(RADIO_METER_SMETER, &value),
+                "Nothing without samples");
+
+    meter_record(RADIO_METER_SMETER, -10.0);
+    meter_record(RADIO_METER_SMETER, -30.0);
+    meter_record(RADIO_METER_SMETER, -20.0);
+    MeterStats stats;
+    TEST_ASSERT(meter_get_stats(RADIO_METER_SMETER, &stats), "Stats");
+    TEST_ASSERT(stats.samples == 3 && near(stats.average, -20.0) &&
+                    near(stats.min, -30.0) && near(stats.max, -10.0) &&
+                    near(stats.last, -20.0),
+                "Average, minimum, maximum and last");
+    TEST_ASSERT(meter_reading(RADIO_METER_SMETER, &value) &&
+                    near(value, -20.0),
+                "S-meter read as the average");
+
+    meter_record(RADIO_METER_POWER, 0.2);
+    meter_record(RADIO_METER_POWER, 0.9);
+    meter_record(RADIO_METER_POWER, 0.3);
+    TEST_ASSERT(meter_reading(RADIO_METER_POWER, &value) && near(value, 0.9),
+                "Power read as the peak");
+    TEST_ASSERT(!meter_reading(RADIO_METER_SWR, &value),
+                "Other meters unaffected");
+}
+
+static void test_hold(void) {
+    printf("\nTest: Peak hold\n");
+    double value;
+    sleep_ms(400); // Past the 300 ms window, inside the 1000 ms hold
+    TEST_ASSERT(!meter_reading(RADIO_METER_SMETER, &value),
+                "Stale once the window has passed");
+
+    meter_record(RADIO_METER_POWER, 0.1);
+    MeterStats stats;
+    TEST_ASSERT(meter_get_stats(RADIO_METER_POWER, &stats) &&
+                    stats.samples == 1 && near(stats.average, 0.1),
+                "Window holds only the new sample");
+    TEST_ASSERT(near(stats.peak, 0.9), "Peak still held");
+}
+
+static void test_frequency_change(void) {
+    printf("\nTest: Frequency change\n");
+    double value;
+    meter_record(RADIO_METER_SMETER, -6.0);
+    radio_state_store(RADIO_FIELD_FREQ, 7100000.0);
+    TEST_ASSERT(!meter_reading(RADIO_METER_SMETER, &value),
+                "Old frequency's samples not read");
+
+    meter_record(RADIO_METER_SMETER, -40.0);
+    MeterStats stats;
+    TEST_ASSERT(meter_get_stats(RADIO_METER_SMETER, &stats) &&
+                    stats.samples == 1 && near(stats.average, -40.0),
+                "Samples start afresh");
+    TEST_ASSERT(!meter_reading(RADIO_METER_POWER, &value),
+                "For every meter");
+}
+
+static void test_sampling(void) {
+    printf("\nTest: Sampling\n");
+    MeterStats stats;
+    meter_record(RADIO_METER_SMETER, -12.0);
+    meter_use(RADIO_METER_POWER);
+    sleep_ms(50); // A few rounds, each failing without a radio
+    TEST_ASSERT(meter_get_stats(RADIO_METER_SMETER, &stats) &&
+                    stats.samples == 2 && near(stats.last, -12.0) &&
+                    !meter_get_stats(RADIO_METER_POWER, &stats),
+                "Failed rounds record nothing");
+    meter_stop();
+    double value;
+    TEST_ASSERT(!meter_reading(RADIO_METER_SMETER, &value),
+                "Stopped, samples forgotten");
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main() {
+    printf("=== Meter Tests ===\n");
+
+    FILE *out = fopen(TEST_CONFIG, "w");
+    fputs("[meters]\nsample_ms = 10\nwindow_ms = 300\nhold_ms = 1000\n"
+          "view_s = 1\n",
+          out);
+    fclose(out);
+    config_init(TEST_CONFIG);
+    radio_state_store(RADIO_FIELD_FREQ, 14200000.0);
+
+    test_window();
+    test_hold();
+    test_frequency_change();
+    test_sampling();
+
+    config_cleanup();
+    unlink(TEST_CONFIG);
+
+    printf("\n=== Results: %d passed, %d failed ===\n", tests_passed,
+           tests_failed);
+
+    if (tests_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
@@ -0,0 +1,128 @@
+/**
+ * test_profile.c - Test Radio Settings Profiles
+ *
+ * Verifies how a profile's settings are written down:
+ * 1. Every known setting, in the order restored
+ * 2. Settings the radio did not report are left out
+ * 3. The list compiles back into the same values as a macro
+ *
+ * Note: This test runs WITHOUT a radio; nothing is saved or restored.
+ *
+ * Usage:
+ *   make tests
+ *   ./bin/test_profile
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <hamlib/rig.h>
+
+#include "macro.h"
+#include "profile.h"
+
+// ============================================================================
+// Test Framework
+// ============================================================================
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, msg) do { \
+    if (condition) { \
+        printf("  ✓ PASS: %s\n", msg); \
+        tests_passed++; \
+    } else { \
+        printf("  ✗ FAIL: %s\n", msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+// A radio that reports nothing
+static RadioStatus unknown_status(void) {
+    RadioStatus status;
+    memset(&status, -1, sizeof(status));
+    return status;
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+static void test_format(void) {
+    printf("\nTest: Format\n");
+    char text[160];
+    RadioStatus status = unknown_status();
+    status.power = 100;
+    status.agc = AGC_FAST;
+    status.nb_on = 1;
+    status.nr_on = 0;
+    status.preamp = 2;
+    status.attenuation = 0;
+
+    TEST_ASSERT(profile_format(RIG_MODE_CW, 500, &status, text,
+                               sizeof(text)) == 8, "Eight settings");
+    TEST_ASSERT(strcmp(text, "mode CW, passband 500, power 100, agc fast, "
+                             "nb on, nr off, preamp 2, attenuation off") == 0,
+                "Written as a macro lists them");
+
+    status = unknown_status();
+    status.power = 5;
+    TEST_ASSERT(profile_format(RIG_MODE_USB, 0, &status, text,
+                               sizeof(text)) == 2 &&
+                strcmp(text, "mode USB, power 5") == 0,
+                "Unknown settings left out");
+    TEST_ASSERT(profile_format(0, 2400, &status, text, sizeof(text)) == 1 &&
+                strcmp(text, "power 5") == 0, "No passband without a mode");
+
+    status = unknown_status();
+    TEST_ASSERT(profile_format(0, 0, &status, text, sizeof(text)) == 0 &&
+                text[0] == '\0', "Nothing known");
+}
+
+static void test_round_trip(void) {
+    printf("\nTest: Round trip\n");
+    RadioStatus status = unknown_status();
+    status.power = 30;
+    status.agc = AGC_SLOW;
+    status.preamp = 0;
+    status.attenuation = 12;
+
+    KeymapMacro source;
+    snprintf(source.name, sizeof(source.name), "dx");
+    profile_format(RIG_MODE_PKTUSB, 2400, &status, source.steps,
+                   sizeof(source.steps));
+    Macro macro;
+    TEST_ASSERT(macro_compile(&source, &macro) == 0 && macro.count == 6,
+                "Compiles as a macro");
+    TEST_ASSERT(macro.steps[0].kind == MACRO_STEP_MODE &&
+                macro.steps[0].value == RIG_MODE_PKTUSB &&
+                macro.steps[1].kind == MACRO_STEP_PASSBAND &&
+                macro.steps[1].value == 2400, "Mode with its passband");
+    TEST_ASSERT(macro.steps[2].value == 30 &&
+                macro.steps[3].value == AGC_SLOW &&
+                macro.steps[4].value == 0 && macro.steps[5].value == 12,
+                "Levels kept");
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main() {
+    printf("=== Profile Tests ===\n");
+
+    test_format();
+    test_round_trip();
+
+    printf("\n=== Results: %d passed, %d failed ===\n", tests_passed,
+           tests_failed);
+
+    if (tests_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
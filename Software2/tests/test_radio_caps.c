@@ -0,0 +1,147 @@
+/**
+ * test_radio_caps.c - Test Radio Capability Profiles
+ *
+ * Verifies what radio_caps answers for each radio:
+ * 1. Everything counts as supported until the tables say otherwise
+ * 2. A learned gap is saved for the model and loaded next session
+ * 3. Gaps on an unknown model (rigctld) last only for the session
+ * 4. Each radio slot keeps its own profile
+ *
+ * Note: This test runs WITHOUT a radio - it writes its file under /tmp.
+ *
+ * Usage:
+ *   make tests
+ *   ./bin/test_radio_caps
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "radio_caps.h"
+
+// ============================================================================
+// Test Framework
+// ============================================================================
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, msg) do { \
+    if (condition) { \
+        printf("  ✓ PASS: %s\n", msg); \
+        tests_passed++; \
+    } else { \
+        printf("  ✗ FAIL: %s\n", msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+static char caps_path[64];
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+static void test_profile(void) {
+    printf("\nTest: Profile from the tables\n");
+
+    radio_caps_begin(0, 1001);
+    radio_caps_select(0);
+    TEST_ASSERT(radio_caps_has(RADIO_FIELD_SWR, RADIO_CAP_GET),
+                "Supported until told otherwise");
+
+    radio_caps_set_supported(0, RADIO_FIELD_SWR, RADIO_CAP_GET, false);
+    radio_caps_set_supported(0, RADIO_FIELD_POWER, RADIO_CAP_SET, true);
+    TEST_ASSERT(!radio_caps_has(RADIO_FIELD_SWR, RADIO_CAP_GET),
+                "Unsupported read refused");
+    TEST_ASSERT(radio_caps_has(RADIO_FIELD_SWR, RADIO_CAP_SET),
+                "Set checked apart from get");
+    TEST_ASSERT(radio_caps_has(RADIO_FIELD_POWER, RADIO_CAP_SET),
+                "Supported set allowed");
+    TEST_ASSERT(!radio_caps_has(RADIO_FIELD_COUNT, RADIO_CAP_GET),
+                "Unknown field refused");
+}
+
+static void test_learned(void) {
+    printf("\nTest: Learned gaps persist per model\n");
+
+    radio_caps_begin(0, 1001);
+    radio_caps_select(0);
+    radio_caps_learn_missing(RADIO_FIELD_NB_LEVEL, RADIO_CAP_SET);
+    TEST_ASSERT(!radio_caps_has(RADIO_FIELD_NB_LEVEL, RADIO_CAP_SET),
+                "Learned gap refused at once");
+
+    // A new session reads the file back
+    radio_caps_init(caps_path);
+    radio_caps_begin(0, 1001);
+    TEST_ASSERT(!radio_caps_has(RADIO_FIELD_NB_LEVEL, RADIO_CAP_SET),
+                "Gap remembered for the model");
+    TEST_ASSERT(radio_caps_has(RADIO_FIELD_NB_LEVEL, RADIO_CAP_GET),
+                "Only the access that failed");
+
+    radio_caps_begin(0, 2002);
+    TEST_ASSERT(radio_caps_has(RADIO_FIELD_NB_LEVEL, RADIO_CAP_SET),
+                "Other models unaffected");
+}
+
+static void test_unknown_model(void) {
+    printf("\nTest: Unknown model\n");
+
+    radio_caps_begin(0, 0);
+    radio_caps_select(0);
+    radio_caps_learn_missing(RADIO_FIELD_VOX, RADIO_CAP_GET);
+    TEST_ASSERT(!radio_caps_has(RADIO_FIELD_VOX, RADIO_CAP_GET),
+                "Gap kept for the session");
+
+    radio_caps_init(caps_path);
+    radio_caps_begin(0, 0);
+    TEST_ASSERT(radio_caps_has(RADIO_FIELD_VOX, RADIO_CAP_GET),
+                "Not saved without a model");
+}
+
+static void test_slots(void) {
+    printf("\nTest: Slots\n");
+
+    radio_caps_begin(0, 1001);
+    radio_caps_begin(1, 2002);
+    radio_caps_set_supported(1, RADIO_FIELD_ATT, RADIO_CAP_SET, false);
+
+    radio_caps_select(0);
+    TEST_ASSERT(radio_caps_has(RADIO_FIELD_ATT, RADIO_CAP_SET),
+                "First radio keeps its profile");
+    radio_caps_select(1);
+    TEST_ASSERT(!radio_caps_has(RADIO_FIELD_ATT, RADIO_CAP_SET),
+                "Second radio answers from its own");
+    radio_caps_select(0);
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main() {
+    printf("=== Radio Caps Tests ===\n");
+
+    snprintf(caps_path, sizeof(caps_path), "/tmp/test_rig_caps_%d.conf",
+             (int)getpid());
+    radio_caps_init(caps_path);
+
+    test_profile();
+    test_learned();
+    test_unknown_model();
+    test_slots();
+
+    unlink(caps_path);
+
+    printf("\n=== Results: %d passed, %d failed ===\n", tests_passed,
+           tests_failed);
+
+    if (tests_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
@@ -0,0 +1,210 @@
+/**
+ * test_radio_cat.c - Test Native CAT Fast Path
+ *
+ * Verifies the CI-V and Kenwood frames against a fake rig on a socket:
+ * 1. Frequency and S-meter replies are parsed, BCD and decimal
+ * 2. Sets are encoded for the rig's frequency length and VFO
+ * 3. Echoes and frames for other controllers are skipped
+ * 4. A refusal or silence is an error, anything unknown goes to Hamlib
+ *
+ * Note: This test runs WITHOUT a radio or Hamlib.
+ *
+ * Usage:
+ *   make tests
+ *   ./bin/test_radio_cat
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "radio_cat.h"
+
+// ============================================================================
+// Test Framework
+// ============================================================================
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, msg) do { \
+    if (condition) { \
+        printf("  ✓ PASS: %s\n", msg); \
+        tests_passed++; \
+    } else { \
+        printf("  ✗ FAIL: %s\n", msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+// ============================================================================
+// Fake Rig
+// ============================================================================
+
+#define RIG_ADDR 0x94 // IC-7300
+
+static int g_ours = -1;  // Our end of the line
+static int g_rigs = -1;  // The fake rig's end
+static pthread_t g_rig_thread;
+
+// What the fake rig was sent, and what it answers
+static unsigned char g_request[64];
+static size_t g_request_len;
+static unsigned char g_reply[64];
+static size_t g_reply_len;
+
+static void *rig_thread(void *arg) {
+    (void)arg;
+    ssize_t n = read(g_rigs, g_request, sizeof(g_request));
+    g_request_len = n > 0 ? (size_t)n : 0;
+    if (g_reply_len > 0 && write(g_rigs, g_reply, g_reply_len) < 0) {
+        perror("rig_thread");
+    }
+    return NULL;
+}
+
+// Answer the next request with reply (NULL: stay silent)
+static void rig_answer(const void *reply, size_t len) {
+    g_reply_len = reply ? len : 0;
+    if (reply) {
+        memcpy(g_reply, reply, len);
+    }
+    g_request_len = 0;
+    pthread_create(&g_rig_thread, NULL, rig_thread, NULL);
+}
+
+static void rig_done(void) { pthread_join(g_rig_thread, NULL); }
+
+static bool request_is(const void *expected, size_t len) {
+    return g_request_len == len && memcmp(g_request, expected, len) == 0;
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+static void test_civ(void) {
+    printf("\nTest: CI-V\n");
+    RadioCat cat;
+    radio_cat_init(&cat, RADIO_CAT_CIV, g_ours, RIG_ADDR);
+    double freq = 0;
+
+    TEST_ASSERT(radio_cat_set_freq(&cat, 7074000, false) == RADIO_CAT_FALLBACK,
+                "No set before the frequency length is known");
+
+    // Our request echoed back, then the answer: 14.074 MHz
+    static const unsigned char get[] = {0xFE, 0xFE, RIG_ADDR, 0xE0, 0x03, 0xFD};
+    static const unsigned char freq_reply[] = {
+        0xFE, 0xFE, RIG_ADDR, 0xE0, 0x03, 0xFD,
+        0xFE, 0xFE, 0xE0, RIG_ADDR, 0x03, 0x00, 0x40, 0x07, 0x14, 0x00, 0xFD};
+    rig_answer(freq_reply, sizeof(freq_reply));
+    int rc = radio_cat_get_freq(&cat, &freq);
+    rig_done();
+    TEST_ASSERT(request_is(get, sizeof(get)), "Frequency request encoded");
+    TEST_ASSERT(rc == 0 && freq == 14074000.0, "Echo skipped, BCD decoded");
+    TEST_ASSERT(cat.freq_bytes == 5, "Frequency length learned");
+
+    static const unsigned char set[] = {
+        0xFE, 0xFE, RIG_ADDR, 0xE0, 0x05, 0x00, 0x40, 0x07, 0x07, 0x00, 0xFD};
+    static const unsigned char ok[] = {0xFE, 0xFE, 0xE0, RIG_ADDR, 0xFB, 0xFD};
+    rig_answer(ok, sizeof(ok));
+    rc = radio_cat_set_freq(&cat, 7074000, false);
+    rig_done();
+    TEST_ASSERT(request_is(set, sizeof(set)) && rc == 0, "Set acknowledged");
+
+    static const unsigned char ng[] = {0xFE, 0xFE, 0xE0, RIG_ADDR, 0xFA, 0xFD};
+    rig_answer(ng, sizeof(ng));
+    TEST_ASSERT(radio_cat_set_freq(&cat, 7074000, false) == -1,
+                "Set refused");
+    rig_done();
+
+    // Another rig's transceive report first, then the S-meter at 0120
+    static const unsigned char meter[] = {
+        0xFE, 0xFE, 0x00, 0x98, 0x00, 0x00, 0x40, 0x07, 0x14, 0x00, 0xFD,
+        0xFE, 0xFE, 0xE0, RIG_ADDR, 0x15, 0x02, 0x01, 0x20, 0xFD};
+    int raw = -1;
+    rig_answer(meter, sizeof(meter));
+    rc = radio_cat_get_smeter_raw(&cat, &raw);
+    rig_done();
+    TEST_ASSERT(rc == 0 && raw == 120, "S-meter decoded past other traffic");
+
+    rig_answer(NULL, 0);
+    TEST_ASSERT(radio_cat_get_freq(&cat, &freq) == -1, "Silence times out");
+    rig_done();
+}
+
+static void test_kenwood(void) {
+    printf("\nTest: Kenwood\n");
+    RadioCat cat;
+    radio_cat_init(&cat, RADIO_CAT_KENWOOD, g_ours, 0);
+    double freq = 0;
+
+    static const char reply[] = "FA00007074000;"
+                                "IF00014074000     +00000000002000000;";
+    rig_answer(reply, sizeof(reply) - 1);
+    int rc = radio_cat_get_freq(&cat, &freq);
+    rig_done();
+    TEST_ASSERT(request_is("IF;", 3), "Frequency read by IF");
+    TEST_ASSERT(rc == 0 && freq == 14074000.0, "Other answers skipped");
+
+    rig_answer(NULL, 0);
+    rc = radio_cat_set_freq(&cat, 7074000, true);
+    rig_done();
+    TEST_ASSERT(rc == 0 && request_is("FB00007074000;", 14),
+                "Set names VFO B");
+
+    int raw;
+    TEST_ASSERT(radio_cat_get_smeter_raw(&cat, &raw) == RADIO_CAT_FALLBACK,
+                "S-meter left to Hamlib");
+}
+
+static void test_protocols(void) {
+    printf("\nTest: Protocols\n");
+    TEST_ASSERT(radio_cat_protocol_for("Icom") == RADIO_CAT_CIV, "Icom");
+    TEST_ASSERT(radio_cat_protocol_for("Kenwood") == RADIO_CAT_KENWOOD,
+                "Kenwood");
+    TEST_ASSERT(radio_cat_protocol_for("Yaesu") == RADIO_CAT_NONE &&
+                radio_cat_protocol_for(NULL) == RADIO_CAT_NONE,
+                "Others use Hamlib");
+
+    RadioCat cat;
+    double freq;
+    radio_cat_init(&cat, RADIO_CAT_NONE, g_ours, 0);
+    TEST_ASSERT(radio_cat_get_freq(&cat, &freq) == RADIO_CAT_FALLBACK,
+                "Off falls back");
+    radio_cat_init(&cat, RADIO_CAT_CIV, -1, RIG_ADDR);
+    TEST_ASSERT(cat.protocol == RADIO_CAT_NONE, "No port, no fast path");
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main() {
+    printf("=== Native CAT Tests ===\n");
+
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        perror("socketpair");
+        return 1;
+    }
+    g_ours = fds[0];
+    g_rigs = fds[1];
+
+    test_civ();
+    test_protocols();
+    test_kenwood();
+
+    printf("\n=== Results: %d passed, %d failed ===\n", tests_passed,
+           tests_failed);
+
+    if (tests_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
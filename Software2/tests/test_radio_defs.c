@@ -0,0 +1,134 @@
+/**
+ * test_radio_defs.c - Test Per-Model Radio Definitions
+ *
+ * Verifies the radio definition table:
+ * 1. The built-in definitions (from config/radios.conf) are found by model
+ * 2. A file read at startup replaces a built-in model and adds new ones
+ * 3. Field lists become masks; settings that are not valid are skipped
+ *
+ * Note: This test runs WITHOUT a radio.
+ *
+ * Usage:
+ *   make tests
+ *   ./bin/test_radio_defs
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "radio_defs.h"
+#include "radio_state.h"
+
+#define TEST_DEFS_PATH "/tmp/hampod_test_radios.conf"
+
+// ============================================================================
+// Test Framework
+// ============================================================================
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, msg) do { \
+    if (condition) { \
+        printf("  ✓ PASS: %s\n", msg); \
+        tests_passed++; \
+    } else { \
+        printf("  ✗ FAIL: %s\n", msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+static void test_builtin(void) {
+    printf("\nTest: Built-in definitions\n");
+    unlink(TEST_DEFS_PATH);
+    TEST_ASSERT(radio_defs_init(TEST_DEFS_PATH) == 0,
+                "No file, nothing loaded");
+
+    const RadioDef *ic7300 = radio_defs_find(3073);
+    TEST_ASSERT(ic7300 != NULL && strcmp(ic7300->name, "IC-7300") == 0,
+                "IC-7300 built in");
+    TEST_ASSERT(ic7300 != NULL && ic7300->vfo_query == RADIO_DEF_NO &&
+                ic7300->transceive == RADIO_DEF_YES,
+                "IC-7300 in transceive mode, VFO not queried");
+    const RadioDef *ts570 = radio_defs_find(2004);
+    TEST_ASSERT(ts570 != NULL && ts570->health_probe == RADIO_PROBE_SMETER,
+                "TS-570 probed with the S-meter");
+    TEST_ASSERT(radio_defs_find(1) == NULL && radio_defs_find(0) == NULL,
+                "Unknown model has none");
+}
+
+static void test_file(void) {
+    printf("\nTest: Definitions file\n");
+    FILE *fp = fopen(TEST_DEFS_PATH, "w");
+    if (fp == NULL) {
+        TEST_ASSERT(0, "Test file written");
+        return;
+    }
+    fprintf(fp, "# Test radios\n");
+    fprintf(fp, "[model 3073]\n");
+    fprintf(fp, "name = IC-7300 test  # Replaced\n");
+    fprintf(fp, "[model 9999]\n");
+    fprintf(fp, "name = Test rig\n");
+    fprintf(fp, "no_get = vox, swr\n");
+    fprintf(fp, "no_set = power\n");
+    fprintf(fp, "transceive = no\n");
+    fprintf(fp, "vfo_current = Main\n");
+    fprintf(fp, "poll_idle_ms = 800\n");
+    fprintf(fp, "health_probe = sometimes\n");
+    fprintf(fp, "no_get = vox bogus\n");
+    fclose(fp);
+
+    TEST_ASSERT(radio_defs_init(TEST_DEFS_PATH) == 2, "Two loaded");
+    const RadioDef *ic7300 = radio_defs_find(3073);
+    TEST_ASSERT(ic7300 != NULL && strcmp(ic7300->name, "IC-7300 test") == 0 &&
+                ic7300->vfo_query == RADIO_DEF_UNSTATED,
+                "Section replaces the built-in one whole");
+    TEST_ASSERT(radio_defs_find(2004) != NULL, "Others kept");
+
+    const RadioDef *added = radio_defs_find(9999);
+    TEST_ASSERT(added != NULL && strcmp(added->name, "Test rig") == 0,
+                "New model added");
+    TEST_ASSERT(added != NULL &&
+                added->no_get == ((1u << RADIO_FIELD_VOX) |
+                                  (1u << RADIO_FIELD_SWR)) &&
+                added->no_set == (1u << RADIO_FIELD_POWER),
+                "Field lists as masks, bad list skipped");
+    TEST_ASSERT(added != NULL && added->transceive == RADIO_DEF_NO &&
+                strcmp(added->vfo_current, "Main") == 0 &&
+                added->poll_idle_ms == 800 &&
+                added->health_probe == RADIO_PROBE_FREQ,
+                "Settings read, bad value skipped");
+
+    unlink(TEST_DEFS_PATH);
+    radio_defs_init(TEST_DEFS_PATH);
+    TEST_ASSERT(radio_defs_find(9999) == NULL &&
+                strcmp(radio_defs_find(3073)->name, "IC-7300") == 0,
+                "Built-in again without the file");
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main() {
+    printf("=== Radio Definition Tests ===\n");
+
+    test_builtin();
+    test_file();
+
+    printf("\n=== Results: %d passed, %d failed ===\n", tests_passed,
+           tests_failed);
+
+    if (tests_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
@@ -0,0 +1,185 @@
+/**
+ * test_radio_state.c - Test Cached Radio State
+ *
+ * Verifies the radio state cache that the radio getters answer from:
+ * 1. Stored values are returned while fresh, with their age
+ * 2. Values older than the tolerance are not returned
+ * 3. Invalidating one field or clearing all forgets values
+ * 4. Out-of-range fields are refused
+ * 5. Each radio keeps its own fields; selecting one switches the view
+ *
+ * Note: This test runs WITHOUT a radio - it only exercises the cache.
+ *
+ * Usage:
+ *   make tests
+ *   ./bin/test_radio_state
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "radio_state.h"
+
+// ============================================================================
+// Test Framework
+// ============================================================================
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, msg) do { \
+    if (condition) { \
+        printf("  ✓ PASS: %s\n", msg); \
+        tests_passed++; \
+    } else { \
+        printf("  ✗ FAIL: %s\n", msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+static void sleep_ms(int ms) {
+    struct timespec ts = {ms / 1000, (ms % 1000) * 1000000L};
+    nanosleep(&ts, NULL);
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+static void test_store_and_get(void) {
+    printf("\nTest: Store and get\n");
+    radio_state_clear();
+
+    double value = 0;
+    TEST_ASSERT(!radio_state_get(RADIO_FIELD_FREQ, &value),
+                "Nothing cached at first");
+
+    radio_state_store(RADIO_FIELD_FREQ, 14250000.0);
+    radio_state_store(RADIO_FIELD_POWER, 50);
+    TEST_ASSERT(radio_state_get(RADIO_FIELD_FREQ, &value) &&
+                value == 14250000.0, "Frequency returned while fresh");
+    TEST_ASSERT(radio_state_get(RADIO_FIELD_POWER, &value) && value == 50,
+                "Level returned while fresh");
+    TEST_ASSERT(!radio_state_get(RADIO_FIELD_MODE, &value),
+                "Other fields still unknown");
+}
+
+static void test_tolerance(void) {
+    printf("\nTest: Freshness tolerance\n");
+    radio_state_clear();
+
+    double value = 0;
+    radio_state_store(RADIO_FIELD_FREQ, 7074000.0);
+    radio_state_store(RADIO_FIELD_POWER, 75);
+    sleep_ms(300);
+
+    TEST_ASSERT(!radio_state_get(RADIO_FIELD_FREQ, &value),
+                "Frequency stale after 300 ms");
+    TEST_ASSERT(radio_state_get(RADIO_FIELD_POWER, &value) && value == 75,
+                "Level still fresh after 300 ms");
+    TEST_ASSERT(radio_state_get_within(RADIO_FIELD_FREQ, 1000, &value) &&
+                value == 7074000.0, "Stale frequency within a wider bound");
+    TEST_ASSERT(!radio_state_get_within(RADIO_FIELD_POWER, 100, &value),
+                "Level too old for a tighter bound");
+}
+
+static void test_invalidate_and_clear(void) {
+    printf("\nTest: Invalidate and clear\n");
+    radio_state_clear();
+
+    double value = 0;
+    radio_state_store(RADIO_FIELD_NB_ON, 1);
+    radio_state_store(RADIO_FIELD_NB_LEVEL, 5);
+    radio_state_invalidate(RADIO_FIELD_NB_ON);
+    TEST_ASSERT(!radio_state_get(RADIO_FIELD_NB_ON, &value),
+                "Invalidated field forgotten");
+    TEST_ASSERT(radio_state_get(RADIO_FIELD_NB_LEVEL, &value) && value == 5,
+                "Neighbouring field kept");
+
+    radio_state_clear();
+    TEST_ASSERT(!radio_state_get(RADIO_FIELD_NB_LEVEL, &value),
+                "Clear forgets everything");
+}
+
+static void test_snapshot(void) {
+    printf("\nTest: Snapshot\n");
+    radio_state_clear();
+
+    radio_state_store(RADIO_FIELD_MODE, 2);
+    sleep_ms(50);
+    radio_state_store(RADIO_FIELD_VFO, 1);
+
+    RadioStateSnapshot snapshot;
+    radio_state_snapshot(&snapshot);
+    TEST_ASSERT(snapshot.value[RADIO_FIELD_MODE] == 2 &&
+                snapshot.value[RADIO_FIELD_VFO] == 1, "Values copied");
+    TEST_ASSERT(snapshot.age_ms[RADIO_FIELD_MODE] >= 50 &&
+                snapshot.age_ms[RADIO_FIELD_VFO] < 50, "Ages per field");
+    TEST_ASSERT(snapshot.age_ms[RADIO_FIELD_FREQ] == -1,
+                "Unknown fields have age -1");
+}
+
+static void test_bad_field(void) {
+    printf("\nTest: Out-of-range field\n");
+
+    double value = 0;
+    radio_state_store(RADIO_FIELD_COUNT, 1);
+    TEST_ASSERT(!radio_state_get(RADIO_FIELD_COUNT, &value),
+                "Field past the end refused");
+    TEST_ASSERT(!radio_state_get_within((RadioField)-1, 1000, &value),
+                "Negative field refused");
+}
+
+static void test_radios(void) {
+    printf("\nTest: Per-radio fields\n");
+    radio_state_select(0);
+    radio_state_clear();
+    radio_state_clear_for(1);
+
+    double value = 0;
+    radio_state_store(RADIO_FIELD_FREQ, 14074000.0);
+    radio_state_store_for(1, RADIO_FIELD_FREQ, 7074000.0);
+    TEST_ASSERT(radio_state_get(RADIO_FIELD_FREQ, &value) &&
+                value == 14074000.0, "Selected radio unaffected by another");
+
+    radio_state_select(1);
+    TEST_ASSERT(radio_state_get(RADIO_FIELD_FREQ, &value) &&
+                value == 7074000.0, "Switching shows the other radio's value");
+
+    radio_state_invalidate_for(0, RADIO_FIELD_FREQ);
+    radio_state_select(0);
+    TEST_ASSERT(!radio_state_get(RADIO_FIELD_FREQ, &value),
+                "Invalidate for a radio forgets only its field");
+
+    radio_state_store_for(RADIO_STATE_SLOTS, RADIO_FIELD_FREQ, 1.0);
+    radio_state_select(RADIO_STATE_SLOTS);
+    TEST_ASSERT(!radio_state_get(RADIO_FIELD_FREQ, &value),
+                "Radio past the end refused");
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main() {
+    printf("=== Radio State Cache Tests ===\n");
+
+    test_store_and_get();
+    test_tolerance();
+    test_invalidate_and_clear();
+    test_snapshot();
+    test_bad_field();
+    test_radios();
+
+    printf("\n=== Results: %d passed, %d failed ===\n", tests_passed,
+           tests_failed);
+
+    if (tests_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
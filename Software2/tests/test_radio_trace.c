@@ -0,0 +1,153 @@
+/**
+ * test_radio_trace.c - Test Hamlib Call Tracing
+ *
+ * Verifies what radio_trace records for each operation:
+ * 1. RADIO_TRACED() passes the call's return code through
+ * 2. Call time lands in the right histogram bucket
+ * 3. A lock wait is charged to the next call only
+ * 4. Error codes are counted per code
+ * 5. The report lists only operations that were called
+ *
+ * Note: This test runs WITHOUT a radio - the "calls" are stand-ins.
+ *
+ * Usage:
+ *   make tests
+ *   ./bin/test_radio_trace
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "radio_trace.h"
+
+// ============================================================================
+// Test Framework
+// ============================================================================
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, msg) do { \
+    if (condition) { \
+        printf("  ✓ PASS: %s\n", msg); \
+        tests_passed++; \
+    } else { \
+        printf("  ✗ FAIL: %s\n", msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+// A Hamlib call that takes ms milliseconds and returns retcode
+static int fake_call(int ms, int retcode) {
+    struct timespec ts = {0, ms * 1000000L};
+    nanosleep(&ts, NULL);
+    return retcode;
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+static void test_passthrough(void) {
+    printf("\nTest: Return code\n");
+    radio_trace_reset();
+
+    TEST_ASSERT(RADIO_TRACED(RADIO_OP_GET_FREQ, fake_call(0, 0)) == 0,
+                "Success passed through");
+    TEST_ASSERT(RADIO_TRACED(RADIO_OP_GET_FREQ, fake_call(0, -5)) == -5,
+                "Error passed through");
+
+    RadioTraceStats stats;
+    radio_trace_get(RADIO_OP_GET_FREQ, &stats);
+    TEST_ASSERT(stats.calls == 2, "Both calls counted");
+    TEST_ASSERT(stats.errors == 1, "One error counted");
+}
+
+static void test_call_time(void) {
+    printf("\nTest: Call time\n");
+    radio_trace_reset();
+
+    RADIO_TRACED(RADIO_OP_SET_LEVEL, fake_call(12, 0));
+
+    RadioTraceStats stats;
+    radio_trace_get(RADIO_OP_SET_LEVEL, &stats);
+    TEST_ASSERT(stats.call_buckets[4] == 1, "12 ms lands in 10-20 ms");
+    TEST_ASSERT(stats.call_us_max >= 12000, "Max at least 12 ms");
+    TEST_ASSERT(stats.wait_buckets[0] == 1, "No lock wait");
+}
+
+static void test_lock_wait(void) {
+    printf("\nTest: Lock wait\n");
+    radio_trace_reset();
+
+    radio_trace_lock_waited(30000);
+    RADIO_TRACED(RADIO_OP_GET_MODE, fake_call(0, 0));
+    RADIO_TRACED(RADIO_OP_GET_MODE, fake_call(0, 0));
+
+    RadioTraceStats stats;
+    radio_trace_get(RADIO_OP_GET_MODE, &stats);
+    TEST_ASSERT(stats.wait_buckets[5] == 1, "30 ms wait in 20-50 ms");
+    TEST_ASSERT(stats.wait_buckets[0] == 1, "Second call didn't wait");
+    TEST_ASSERT(stats.wait_us_total == 30000, "Wait charged once");
+}
+
+static void test_error_codes(void) {
+    printf("\nTest: Error codes\n");
+    radio_trace_reset();
+
+    RADIO_TRACED(RADIO_OP_GET_LEVEL, fake_call(0, -5));
+    RADIO_TRACED(RADIO_OP_GET_LEVEL, fake_call(0, -5));
+    RADIO_TRACED(RADIO_OP_GET_LEVEL, fake_call(0, -11));
+    RADIO_TRACED(RADIO_OP_GET_LEVEL, fake_call(0, -99));
+
+    RadioTraceStats stats;
+    radio_trace_get(RADIO_OP_GET_LEVEL, &stats);
+    TEST_ASSERT(stats.codes[5] == 2, "Timeouts counted");
+    TEST_ASSERT(stats.codes[11] == 1, "Unavailable counted");
+    TEST_ASSERT(stats.codes[RADIO_TRACE_CODES - 1] == 1,
+                "Unknown code in the last count");
+    TEST_ASSERT(radio_trace_get(RADIO_OP_COUNT, &stats) == -1,
+                "Unknown operation rejected");
+}
+
+static void test_report(void) {
+    printf("\nTest: Report\n");
+    radio_trace_reset();
+
+    RADIO_TRACED(RADIO_OP_SET_FREQ, fake_call(0, 0));
+
+    char buffer[4096];
+    FILE *out = fmemopen(buffer, sizeof(buffer), "w");
+    radio_trace_report(out);
+    fclose(out);
+    TEST_ASSERT(strstr(buffer, "set_freq") != NULL, "Called operation listed");
+    TEST_ASSERT(strstr(buffer, "get_freq") == NULL, "Others left out");
+    TEST_ASSERT(strstr(buffer, "errors (") == NULL, "No error section");
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main() {
+    printf("=== Radio Trace Tests ===\n");
+
+    test_passthrough();
+    test_call_time();
+    test_lock_wait();
+    test_error_codes();
+    test_report();
+
+    printf("\n=== Results: %d passed, %d failed ===\n", tests_passed,
+           tests_failed);
+
+    if (tests_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
@@ -0,0 +1,163 @@
+/**
+ * test_radio_worker.c - Test Radio Command Worker
+ *
+ * Verifies the queue that runs radio commands off the keypad thread:
+ * 1. Without a worker thread, commands run at once on the caller
+ * 2. User commands run before background ones, each class in order
+ * 3. A command with a supersede key replaces a queued one with that key
+ * 4. Stopping finishes the running command and cancels the rest
+ *
+ * Note: This test runs WITHOUT a radio - the commands only record calls.
+ *
+ * Usage:
+ *   make tests
+ *   ./bin/test_radio_worker
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "radio_worker.h"
+
+// ============================================================================
+// Test Framework
+// ============================================================================
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, msg) do { \
+    if (condition) { \
+        printf("  ✓ PASS: %s\n", msg); \
+        tests_passed++; \
+    } else { \
+        printf("  ✗ FAIL: %s\n", msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+static void sleep_ms(int ms) {
+    struct timespec ts = {ms / 1000, (ms % 1000) * 1000000L};
+    nanosleep(&ts, NULL);
+}
+
+// ============================================================================
+// Recording Commands
+// ============================================================================
+
+// Completion order: the command's id, negated if it was cancelled
+static int g_order[32];
+static int g_order_len = 0;
+static pthread_mutex_t g_order_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int run_slow(void *arg) {
+    sleep_ms(50);
+    return *(int *)arg;
+}
+
+static void record_done(int result, void *arg) {
+    pthread_mutex_lock(&g_order_mutex);
+    g_order[g_order_len++] =
+        result == RADIO_CMD_CANCELLED ? -*(int *)arg : result;
+    pthread_mutex_unlock(&g_order_mutex);
+}
+
+static void submit(RadioCommandPriority priority, RadioCommandKey key, int id) {
+    radio_worker_submit(priority, key, run_slow, record_done, &id, sizeof(id));
+}
+
+static void reset_order(void) {
+    pthread_mutex_lock(&g_order_mutex);
+    g_order_len = 0;
+    pthread_mutex_unlock(&g_order_mutex);
+}
+
+static bool order_is(const int *expected, int count) {
+    pthread_mutex_lock(&g_order_mutex);
+    bool same = g_order_len == count &&
+                memcmp(g_order, expected, count * sizeof(int)) == 0;
+    pthread_mutex_unlock(&g_order_mutex);
+    return same;
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+static void test_without_worker(void) {
+    printf("\nTest: No worker thread\n");
+    reset_order();
+
+    submit(RADIO_CMD_USER, RADIO_KEY_FREQUENCY, 1);
+    submit(RADIO_CMD_USER, RADIO_KEY_FREQUENCY, 2);
+    const int expected[] = {1, 2};
+    TEST_ASSERT(order_is(expected, 2), "Commands run at once, none superseded");
+}
+
+static void test_priority_and_supersede(void) {
+    printf("\nTest: Priority and supersede\n");
+    reset_order();
+    radio_worker_start();
+
+    submit(RADIO_CMD_USER, RADIO_KEY_NONE, 1); // Starts right away
+    sleep_ms(10);
+    submit(RADIO_CMD_BACKGROUND, RADIO_KEY_NONE, 2);
+    submit(RADIO_CMD_USER, RADIO_KEY_FREQUENCY, 3);
+    submit(RADIO_CMD_USER, RADIO_KEY_FREQUENCY, 4); // Replaces 3
+    submit(RADIO_CMD_USER, RADIO_KEY_NONE, 5);
+
+    TEST_ASSERT(radio_worker_wait_idle(2000), "Worker goes idle");
+    const int expected[] = {1, -3, 4, 5, 2};
+    TEST_ASSERT(order_is(expected, 5),
+                "User commands first, superseded one cancelled");
+
+    reset_order();
+    submit(RADIO_CMD_USER, RADIO_KEY_NONE, 6);
+    sleep_ms(10);
+    submit(RADIO_CMD_USER, RADIO_KEY_POWER, 7);
+    TEST_ASSERT(radio_worker_cancel(RADIO_KEY_POWER) == 1,
+                "Cancel by key finds the queued command");
+    TEST_ASSERT(radio_worker_wait_idle(2000), "Worker idle again");
+    const int cancelled[] = {6, -7};
+    TEST_ASSERT(order_is(cancelled, 2),
+                "Running command finishes, cancelled one is reported");
+}
+
+static void test_stop(void) {
+    printf("\nTest: Stop\n");
+    reset_order();
+
+    submit(RADIO_CMD_USER, RADIO_KEY_NONE, 8); // Running when stopped
+    sleep_ms(10);
+    submit(RADIO_CMD_USER, RADIO_KEY_NONE, 9);
+    radio_worker_stop();
+
+    const int expected[] = {8, -9};
+    TEST_ASSERT(order_is(expected, 2),
+                "Running command finishes, queued one cancelled");
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main() {
+    printf("=== Radio Command Worker Tests ===\n");
+
+    test_without_worker();
+    test_priority_and_supersede();
+    test_stop();
+
+    printf("\n=== Results: %d passed, %d failed ===\n", tests_passed,
+           tests_failed);
+
+    if (tests_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
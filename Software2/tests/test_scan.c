@@ -0,0 +1,87 @@
+/**
+ * test_scan.c - Test Scan Channels
+ *
+ * Verifies the channels a band scan steps through:
+ * 1. Each step goes to the next multiple of the step size
+ * 2. A frequency off the grid lands on it at the first step
+ * 3. Stepping past the top of the range wraps to its first channel
+ * 4. A step wider than the range stays at its bottom edge
+ *
+ * Note: This test runs WITHOUT a radio - it never starts a scan.
+ *
+ * Usage:
+ *   make tests
+ *   ./bin/test_scan
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "scan.h"
+
+// ============================================================================
+// Test Framework
+// ============================================================================
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, msg) do { \
+    if (condition) { \
+        printf("  ✓ PASS: %s\n", msg); \
+        tests_passed++; \
+    } else { \
+        printf("  ✗ FAIL: %s\n", msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+static void test_steps(void) {
+    printf("\nTest: Steps\n");
+    TEST_ASSERT(scan_next_channel(14000000, 14000000, 14350000, 5000) ==
+                14005000, "Next channel up");
+    TEST_ASSERT(scan_next_channel(14074000, 14000000, 14350000, 5000) ==
+                14075000, "Off the grid lands on it");
+    TEST_ASSERT(scan_next_channel(14075000, 14000000, 14350000, 12500) ==
+                14087500, "Other step sizes");
+}
+
+static void test_wrap(void) {
+    printf("\nTest: Wrap\n");
+    TEST_ASSERT(scan_next_channel(14350000, 14000000, 14350000, 5000) ==
+                14000000, "Top of the band wraps to the bottom");
+    TEST_ASSERT(scan_next_channel(5407000, 5330000, 5410000, 5000) ==
+                5410000, "Top edge is a channel");
+    TEST_ASSERT(scan_next_channel(5410000, 5330000, 5410000, 12500) ==
+                5337500, "Wraps to the first channel on the grid");
+    TEST_ASSERT(scan_next_channel(1800000, 1810000, 1820000, 5000) ==
+                1810000, "Below the range goes to its first channel");
+    TEST_ASSERT(scan_next_channel(5331000, 5330000, 5332000, 5000) ==
+                5330000, "Step wider than the range stays at its edge");
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main() {
+    printf("=== Scan Tests ===\n");
+
+    test_steps();
+    test_wrap();
+
+    printf("\n=== Results: %d passed, %d failed ===\n", tests_passed,
+           tests_failed);
+
+    if (tests_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
@@ -0,0 +1,138 @@
+/**
+ * test_serial_latency.c - Test Serial Port Latency Tuning
+ *
+ * Verifies the USB-serial latency_timer handling on a fake sysfs tree:
+ * 1. An FTDI-style timer above 1 ms is set to 1 and restored
+ * 2. An adapter without a timer (CP210x) is left alone
+ * 3. A timer already at 1 ms is not touched
+ *
+ * Note: This test runs WITHOUT an adapter; the port ioctls are skipped.
+ *
+ * Usage:
+ *   make tests
+ *   ./bin/test_serial_latency
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "serial_latency.h"
+
+// ============================================================================
+// Test Framework
+// ============================================================================
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, msg) do { \
+    if (condition) { \
+        printf("  ✓ PASS: %s\n", msg); \
+        tests_passed++; \
+    } else { \
+        printf("  ✗ FAIL: %s\n", msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+#define TEST_SYSFS "/tmp/hampod_test_sysfs_tty"
+
+// Create a tty in the fake tree, with a latency_timer unless ms < 0
+static void make_tty(const char *name, int ms) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s/device", TEST_SYSFS, name);
+    char command[300];
+    snprintf(command, sizeof(command), "mkdir -p %s", path);
+    if (system(command) != 0) {
+        perror("mkdir");
+    }
+    if (ms >= 0) {
+        strcat(path, "/latency_timer");
+        FILE *f = fopen(path, "w");
+        fprintf(f, "%d\n", ms);
+        fclose(f);
+    }
+}
+
+static int timer_of(const char *name) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s/device/latency_timer", TEST_SYSFS,
+             name);
+    FILE *f = fopen(path, "r");
+    int ms = -1;
+    if (f) {
+        if (fscanf(f, "%d", &ms) != 1) {
+            ms = -1;
+        }
+        fclose(f);
+    }
+    return ms;
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+static void test_ftdi(void) {
+    printf("\nTest: FTDI latency timer\n");
+    make_tty("ttyUSB0", 16);
+    SerialLatency saved;
+
+    TEST_ASSERT(serial_latency_tune(&saved, TEST_SYSFS, "/dev/ttyUSB0", -1),
+                "Tuned");
+    TEST_ASSERT(timer_of("ttyUSB0") == SERIAL_LATENCY_TIMER_MS,
+                "Timer at 1 ms");
+    TEST_ASSERT(saved.timer_ms == 16, "Old value kept");
+
+    serial_latency_restore(&saved, -1);
+    TEST_ASSERT(timer_of("ttyUSB0") == 16, "Restored to 16 ms");
+    serial_latency_restore(&saved, -1);
+    TEST_ASSERT(timer_of("ttyUSB0") == 16, "Restoring twice is harmless");
+}
+
+static void test_others(void) {
+    printf("\nTest: Other adapters\n");
+    SerialLatency saved;
+
+    make_tty("ttyUSB1", -1);
+    TEST_ASSERT(!serial_latency_tune(&saved, TEST_SYSFS, "/dev/ttyUSB1", -1),
+                "No timer, nothing to tune");
+
+    make_tty("ttyUSB2", 1);
+    TEST_ASSERT(!serial_latency_tune(&saved, TEST_SYSFS, "/dev/ttyUSB2", -1),
+                "Already at 1 ms");
+    serial_latency_restore(&saved, -1);
+    TEST_ASSERT(timer_of("ttyUSB2") == 1, "Left as it was");
+
+    TEST_ASSERT(!serial_latency_tune(&saved, TEST_SYSFS, "/dev/ttyS9", -1),
+                "Unknown tty");
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main() {
+    printf("=== Serial Latency Tests ===\n");
+
+    if (system("rm -rf " TEST_SYSFS) != 0) {
+        perror("rm");
+    }
+    test_ftdi();
+    test_others();
+    if (system("rm -rf " TEST_SYSFS) != 0) {
+        perror("rm");
+    }
+
+    printf("\n=== Results: %d passed, %d failed ===\n", tests_passed,
+           tests_failed);
+
+    if (tests_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
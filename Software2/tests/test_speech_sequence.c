@@ -0,0 +1,154 @@
+/**
+ * test_speech_sequence.c - Test Speak Sequence Builder
+ *
+ * Verifies the payload that speech_say_sequence() hands to Firmware as one
+ * AUDIO_TYPE_SEQUENCE packet:
+ * 1. Segments are <kind><data> joined by AUDIO_SEQ_SEPARATOR
+ * 2. Beep and gap segments encode their argument; words keep their own kind
+ * 3. A voice segment switches the voice for the segments after it
+ * 4. A segment that does not fit marks the sequence as overflowed
+ * 5. Empty or overflowed sequences are refused
+ *
+ * Note: This test runs WITHOUT Firmware and without the speech thread.
+ *
+ * Usage:
+ *   make tests
+ *   ./bin/test_speech_sequence
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hampod_core.h"
+#include "speech.h"
+
+// ============================================================================
+// Test Framework
+// ============================================================================
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, msg) do { \
+    if (condition) { \
+        printf("  ✓ PASS: %s\n", msg); \
+        tests_passed++; \
+    } else { \
+        printf("  ✗ FAIL: %s\n", msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+static void test_text_segments(void) {
+    printf("\nTest: Text segments\n");
+
+    SpeechSequence seq;
+    speech_sequence_init(&seq);
+    TEST_ASSERT(seq.length == 0 && seq.payload[0] == '\0', "Starts empty");
+
+    speech_sequence_add_text(&seq, "VFO A.");
+    speech_sequence_add_text(&seq, "14 megahertz");
+    TEST_ASSERT(strcmp(seq.payload, "dVFO A.\x1e" "d14 megahertz") == 0,
+                "Segments joined by the separator");
+    TEST_ASSERT(seq.length == (int)strlen(seq.payload), "Length tracks payload");
+}
+
+static void test_mixed_segments(void) {
+    printf("\nTest: Clip, beep and gap segments\n");
+
+    SpeechSequence seq;
+    speech_sequence_init(&seq);
+    speech_sequence_add_beep(&seq, 'k');
+    speech_sequence_add_gap(&seq, 150);
+    speech_sequence_add_file(&seq, "pregen_audio/5");
+    speech_sequence_add_gap(&seq, -3);
+    TEST_ASSERT(strcmp(seq.payload,
+                       "bk\x1eg150\x1eppregen_audio/5\x1eg0") == 0,
+                "Kinds and arguments encoded, negative gap clamped");
+}
+
+static void test_word_segments(void) {
+    printf("\nTest: Word segments\n");
+
+    SpeechSequence seq;
+    speech_sequence_init(&seq);
+    speech_sequence_add_text(&seq, "VFO A.");
+    speech_sequence_add_words(&seq, "14 point 2 5 megahertz");
+    TEST_ASSERT(strcmp(seq.payload,
+                       "dVFO A.\x1ew14 point 2 5 megahertz") == 0,
+                "Words kept as one segment of their own kind");
+    TEST_ASSERT(speech_sequence_add_words(&seq, NULL) == HAMPOD_ERROR,
+                "NULL words refused");
+}
+
+static void test_voice_segment(void) {
+    printf("\nTest: Voice segment\n");
+
+    SpeechSequence seq;
+    speech_sequence_init(&seq);
+    speech_sequence_add_voice(&seq, "alert");
+    speech_sequence_add_text(&seq, "Hello");
+    TEST_ASSERT(strcmp(seq.payload, "valert\x1e" "dHello") == 0,
+                "Voice named ahead of the text it applies to");
+    speech_sequence_add_voice(&seq, NULL);
+    TEST_ASSERT(strcmp(seq.payload, "valert\x1e" "dHello\x1ev") == 0,
+                "NULL voice goes back to the default");
+}
+
+static void test_overflow(void) {
+    printf("\nTest: Overflow\n");
+
+    SpeechSequence seq;
+    speech_sequence_init(&seq);
+
+    char chunk[100];
+    memset(chunk, 'x', sizeof(chunk) - 1);
+    chunk[sizeof(chunk) - 1] = '\0';
+
+    TEST_ASSERT(speech_sequence_add_text(&seq, chunk) == HAMPOD_OK,
+                "First segment fits");
+    TEST_ASSERT(speech_sequence_add_text(&seq, chunk) == HAMPOD_OK,
+                "Second segment fits");
+    TEST_ASSERT(speech_sequence_add_text(&seq, chunk) == HAMPOD_ERROR,
+                "Third segment refused");
+    TEST_ASSERT(seq.overflow && seq.length <= SPEECH_SEQUENCE_MAX,
+                "Overflow flagged, payload still bounded");
+    TEST_ASSERT(speech_sequence_add_gap(&seq, 1) == HAMPOD_ERROR,
+                "Nothing appended after overflow");
+    TEST_ASSERT(speech_say_sequence(&seq) == HAMPOD_ERROR,
+                "Overflowed sequence is not queued");
+
+    speech_sequence_init(&seq);
+    TEST_ASSERT(speech_say_sequence(&seq) == HAMPOD_ERROR,
+                "Empty sequence is not queued");
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main() {
+    printf("=== Speak Sequence Tests ===\n");
+
+    test_text_segments();
+    test_mixed_segments();
+    test_word_segments();
+    test_voice_segment();
+    test_overflow();
+
+    printf("\n=== Results: %d passed, %d failed ===\n", tests_passed,
+           tests_failed);
+
+    if (tests_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
@@ -0,0 +1,89 @@
+/**
+ * test_tune.c - Test Keypad Tuning Steps
+ *
+ * Verifies the frequencies a tuning step goes to:
+ * 1. Steps up and down land on the step's grid
+ * 2. An off-grid frequency moves to the nearest grid point that way
+ * 3. Stepping down never reaches 0 Hz
+ * 4. The step size cycles through its values and wraps
+ *
+ * Note: This test runs WITHOUT a radio - it never sets a frequency.
+ *
+ * Usage:
+ *   make tests
+ *   ./bin/test_tune
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "tune.h"
+
+// ============================================================================
+// Test Framework
+// ============================================================================
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, msg) do { \
+    if (condition) { \
+        printf("  ✓ PASS: %s\n", msg); \
+        tests_passed++; \
+    } else { \
+        printf("  ✗ FAIL: %s\n", msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+static void test_steps(void) {
+    printf("\nTest: Steps\n");
+    TEST_ASSERT(tune_next_frequency(14074000, 1000, 1) == 14075000,
+                "Up one step");
+    TEST_ASSERT(tune_next_frequency(14074000, 1000, -1) == 14073000,
+                "Down one step");
+    TEST_ASSERT(tune_next_frequency(14074300, 1000, 1) == 14075000,
+                "Off the grid, up to the next grid point");
+    TEST_ASSERT(tune_next_frequency(14074300, 1000, -1) == 14074000,
+                "Off the grid, down to the next grid point");
+    TEST_ASSERT(tune_next_frequency(14074000, 10, 1) == 14074010,
+                "Small steps");
+    TEST_ASSERT(tune_next_frequency(50000, 100000, -1) == 50000,
+                "Never down to 0 Hz");
+}
+
+static void test_step_sizes(void) {
+    printf("\nTest: Step Sizes\n");
+    TEST_ASSERT(tune_get_step_hz() == 1000, "1 kHz at startup");
+    TEST_ASSERT(tune_cycle_step() == 5000, "Then 5 kHz");
+    tune_cycle_step();
+    tune_cycle_step();
+    TEST_ASSERT(tune_cycle_step() == 10, "Wraps to 10 Hz");
+    TEST_ASSERT(tune_get_step_hz() == 10, "Selected step kept");
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main() {
+    printf("=== Tune Tests ===\n");
+
+    test_steps();
+    test_step_sizes();
+
+    printf("\n=== Results: %d passed, %d failed ===\n", tests_passed,
+           tests_failed);
+
+    if (tests_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
@@ -0,0 +1,113 @@
+/**
+ * test_tuning_tone.c - Test Tuning Tone Pitch
+ *
+ * Verifies how meter readings map onto the tuning tone's pitch:
+ * 1. Each meter's range spans the pitch range, linearly
+ * 2. Readings outside a range are clamped
+ * 3. A worse SWR and a stronger signal both sound higher
+ * 4. Off (or an unknown meter) is silence
+ *
+ * Note: This test runs WITHOUT a radio - it never starts the tone.
+ *
+ * Usage:
+ *   make tests
+ *   ./bin/test_tuning_tone
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "tuning_tone.h"
+
+// ============================================================================
+// Test Framework
+// ============================================================================
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, msg) do { \
+    if (condition) { \
+        printf("  ✓ PASS: %s\n", msg); \
+        tests_passed++; \
+    } else { \
+        printf("  ✗ FAIL: %s\n", msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+static void test_ranges(void) {
+    printf("\nTest: Meter ranges\n");
+
+    TEST_ASSERT(tuning_tone_pitch(TUNING_TONE_SMETER, -54) ==
+                TUNING_TONE_MIN_HZ, "S0 is the lowest pitch");
+    TEST_ASSERT(tuning_tone_pitch(TUNING_TONE_SMETER, 60) ==
+                TUNING_TONE_MAX_HZ, "S9+60 is the highest pitch");
+    TEST_ASSERT(tuning_tone_pitch(TUNING_TONE_SWR, 2.0) ==
+                (TUNING_TONE_MIN_HZ + TUNING_TONE_MAX_HZ) / 2,
+                "SWR 2 is mid range");
+    TEST_ASSERT(tuning_tone_pitch(TUNING_TONE_POWER, 0.25) ==
+                TUNING_TONE_MIN_HZ +
+                    (TUNING_TONE_MAX_HZ - TUNING_TONE_MIN_HZ) / 4,
+                "Quarter power a quarter of the way up");
+}
+
+static void test_clamping(void) {
+    printf("\nTest: Clamping\n");
+
+    TEST_ASSERT(tuning_tone_pitch(TUNING_TONE_SMETER, -80) ==
+                TUNING_TONE_MIN_HZ, "Below S0 clamped");
+    TEST_ASSERT(tuning_tone_pitch(TUNING_TONE_SWR, 9.9) ==
+                TUNING_TONE_MAX_HZ, "High SWR clamped");
+    TEST_ASSERT(tuning_tone_pitch(TUNING_TONE_POWER, 1.5) ==
+                TUNING_TONE_MAX_HZ, "Over full power clamped");
+}
+
+static void test_direction(void) {
+    printf("\nTest: Direction\n");
+
+    TEST_ASSERT(tuning_tone_pitch(TUNING_TONE_SWR, 1.2) <
+                tuning_tone_pitch(TUNING_TONE_SWR, 1.5),
+                "Worse SWR sounds higher");
+    TEST_ASSERT(tuning_tone_pitch(TUNING_TONE_SMETER, -12) <
+                tuning_tone_pitch(TUNING_TONE_SMETER, -6),
+                "Stronger signal sounds higher");
+}
+
+static void test_off(void) {
+    printf("\nTest: Off\n");
+
+    TEST_ASSERT(tuning_tone_pitch(TUNING_TONE_OFF, 0) == 0, "Off is silent");
+    TEST_ASSERT(tuning_tone_pitch(TUNING_TONE_COUNT, 0) == 0,
+                "Unknown meter is silent");
+    TEST_ASSERT(tuning_tone_get_meter() == TUNING_TONE_OFF,
+                "Tone starts off");
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main() {
+    printf("=== Tuning Tone Tests ===\n");
+
+    test_ranges();
+    test_clamping();
+    test_direction();
+    test_off();
+
+    printf("\n=== Results: %d passed, %d failed ===\n", tests_passed,
+           tests_failed);
+
+    if (tests_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
@@ -0,0 +1,109 @@
+/**
+ * test_watchdog.c - Test Latency SLO Accounting
+ *
+ * Verifies which timings count as SLO misses:
+ * 1. A key's beep over WATCHDOG_KEY_BEEP_MS after the key
+ * 2. First audio over WATCHDOG_FIRST_AUDIO_MS after queuing, across the
+ *    32-bit clock wrap
+ * 3. Missing timestamps are not counted
+ *
+ * Note: This test runs WITHOUT Firmware or a radio; the link check is not
+ * started.
+ *
+ * Usage:
+ *   make tests
+ *   ./bin/test_watchdog
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "watchdog.h"
+
+// ============================================================================
+// Test Framework
+// ============================================================================
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, msg) do { \
+    if (condition) { \
+        printf("  ✓ PASS: %s\n", msg); \
+        tests_passed++; \
+    } else { \
+        printf("  ✗ FAIL: %s\n", msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+// A key event's kernel timestamp, ms milliseconds ago
+static uint64_t key_time_ago(int ms) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + ts.tv_nsec / 1000 -
+           (uint64_t)ms * 1000;
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+static void test_key_beep(void) {
+    printf("\nTest: Key to beep\n");
+    unsigned int before = watchdog_slo_misses(WATCHDOG_SLO_KEY_BEEP);
+
+    watchdog_note_key(key_time_ago(0));
+    TEST_ASSERT(watchdog_slo_misses(WATCHDOG_SLO_KEY_BEEP) == before,
+                "Prompt beep is no miss");
+    watchdog_note_key(key_time_ago(WATCHDOG_KEY_BEEP_MS + 20));
+    TEST_ASSERT(watchdog_slo_misses(WATCHDOG_SLO_KEY_BEEP) == before + 1,
+                "Late beep counted");
+    watchdog_note_key(0);
+    TEST_ASSERT(watchdog_slo_misses(WATCHDOG_SLO_KEY_BEEP) == before + 1,
+                "Key without a timestamp ignored");
+}
+
+static void test_first_audio(void) {
+    printf("\nTest: First audio\n");
+    unsigned int before = watchdog_slo_misses(WATCHDOG_SLO_FIRST_AUDIO);
+    unsigned int slo_us = WATCHDOG_FIRST_AUDIO_MS * 1000;
+
+    watchdog_note_first_audio(1000, 1000 + slo_us);
+    TEST_ASSERT(watchdog_slo_misses(WATCHDOG_SLO_FIRST_AUDIO) == before,
+                "At the SLO is no miss");
+    watchdog_note_first_audio(1000, 1000 + slo_us + 1);
+    TEST_ASSERT(watchdog_slo_misses(WATCHDOG_SLO_FIRST_AUDIO) == before + 1,
+                "Over the SLO counted");
+    watchdog_note_first_audio(0xFFFFFF00u, 0xFFFFFF00u + 2 * slo_us);
+    TEST_ASSERT(watchdog_slo_misses(WATCHDOG_SLO_FIRST_AUDIO) == before + 2,
+                "Counted across the clock wrap");
+    watchdog_note_first_audio(1000, 0);
+    TEST_ASSERT(watchdog_slo_misses(WATCHDOG_SLO_FIRST_AUDIO) == before + 2,
+                "No first audio ignored");
+    TEST_ASSERT(watchdog_slo_misses(WATCHDOG_SLO_POLL_AGE) == 0,
+                "Other SLOs untouched");
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main() {
+    printf("=== Watchdog Tests ===\n");
+
+    test_key_beep();
+    test_first_audio();
+
+    printf("\n=== Results: %d passed, %d failed ===\n", tests_passed,
+           tests_failed);
+
+    if (tests_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
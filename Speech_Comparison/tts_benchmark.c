@@ -0,0 +1,453 @@
+/**
+ * @file tts_benchmark.c
+ * @brief Non-interactive TTS latency benchmark over the Firmware HAL
+ *
+ * Where speech_latency_test times one engine invocation per key press,
+ * this runs a fixed corpus through the same HAL the firmware speaks with
+ * (hal_tts_speak(), its phrase splitting, cache and Piper pool) and
+ * reports, per case and class of text:
+ *
+ * - TTFA: time from hal_tts_speak() to its first audio reaching the
+ *   audio HAL (hal_tts_request_times())
+ * - Total: time hal_tts_speak() took
+ * - RTF: total time over the length of the audio it made
+ *
+ * Cases:
+ * - cold: the first request after hal_tts_init(), cache empty
+ * - miss: warm engine, cache empty
+ * - hit:  the same corpus again, served from the cache
+ *
+ * Every sample goes to a CSV file and the p50/p90/p99/max of each case and
+ * class to a JSON file, both tagged with the host model, engine and speed,
+ * so runs on different Pis, speeds and engines can be put side by side.
+ *
+ * Usage: ./tts_benchmark [--speed S] [--rounds N] [--cold N]
+ *                        [--csv FILE] [--json FILE]
+ *
+ * The engine is picked as the firmware picks it (HAMPOD_TTS_ENGINE). The
+ * cache lives in a scratch directory of its own, so the real one is left
+ * alone.
+ */
+
+#define _GNU_SOURCE
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "hal_audio.h"
+#include "hal_tts.h"
+#include "hal_tts_cache.h"
+#include "hal_tts_phrase.h"
+
+#define SAMPLE_RATE 16000
+
+/* Corpus: what the HAMPOD says most, by class */
+typedef enum {
+    CLASS_WORD,
+    CLASS_FREQUENCY,
+    CLASS_SENTENCE,
+    CLASS_COUNT
+} TextClass;
+
+static const char *class_names[CLASS_COUNT] = {"word", "frequency",
+                                               "sentence"};
+
+typedef struct {
+    TextClass text_class;
+    const char *text;
+} CorpusEntry;
+
+static const CorpusEntry corpus[] = {
+    {CLASS_WORD, "Volume"},
+    {CLASS_WORD, "Mode"},
+    {CLASS_WORD, "Upper sideband"},
+    {CLASS_WORD, "Scan stopped"},
+    {CLASS_WORD, "Memory three"},
+    {CLASS_WORD, "Squelch"},
+    {CLASS_FREQUENCY, "14.250 megahertz"},
+    {CLASS_FREQUENCY, "7.074 megahertz"},
+    {CLASS_FREQUENCY, "146.520 megahertz"},
+    {CLASS_FREQUENCY, "3.985 megahertz"},
+    {CLASS_FREQUENCY, "28.400 megahertz"},
+    {CLASS_FREQUENCY, "432.100 megahertz"},
+    {CLASS_SENTENCE,
+     "Frequency mode. Enter a frequency on the keypad, then press pound to "
+     "set it, or star for a decimal point."},
+    {CLASS_SENTENCE,
+     "Signal 14.205 megahertz, S meter 9 plus 10 decibels. Press C to "
+     "resume scanning or D to stay on this frequency."},
+    {CLASS_SENTENCE,
+     "Radio not responding. Check that the radio is switched on and the "
+     "cable is connected, then press A to try again."},
+};
+
+#define CORPUS_SIZE (int)(sizeof(corpus) / sizeof(corpus[0]))
+
+typedef enum { CASE_COLD, CASE_MISS, CASE_HIT, CASE_COUNT } BenchCase;
+
+static const char *case_names[CASE_COUNT] = {"cold", "miss", "hit"};
+
+typedef struct {
+    BenchCase bench_case;
+    TextClass text_class;
+    const char *text;
+    double ttfa_ms;  /* < 0 if no audio came out */
+    double total_ms;
+    double audio_ms; /* 0 if the cache could not say */
+} Sample;
+
+static Sample *samples = NULL;
+static int sample_count = 0;
+static int sample_capacity = 0;
+
+static char host_model[128] = "unknown";
+static char cache_dir[] = "/tmp/hampod_bench.XXXXXX";
+
+/* Get current time in milliseconds, to the microsecond */
+static double current_time_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void read_host_model(void) {
+    FILE *f = fopen("/proc/device-tree/model", "r");
+    if (f == NULL) {
+        return;
+    }
+    size_t len = fread(host_model, 1, sizeof(host_model) - 1, f);
+    fclose(f);
+    host_model[len] = '\0';
+    /* The device tree string is NUL-terminated; drop newlines and commas
+     * so it stays one CSV field */
+    for (char *c = host_model; *c; c++) {
+        if (*c == '\n' || *c == ',' || *c == '"') {
+            *c = ' ';
+        }
+    }
+}
+
+static void wait_for_silence(void) {
+    while (hal_audio_is_playing()) {
+        usleep(10000);
+    }
+    usleep(100000); /* Let the device drain before timing the next one */
+}
+
+/*
+ * Length of the audio text was spoken as, from the cache, phrase by phrase
+ * as the Piper backends store it. 0 if any phrase is missing.
+ */
+static double audio_length_ms(const char *text, float speed) {
+    size_t total = 0;
+    char phrase[HAL_TTS_PHRASE_MAX + 1];
+    const char *start;
+    size_t len;
+    while ((start = hal_tts_next_phrase(text, &len, &text)) != NULL) {
+        memcpy(phrase, start, len);
+        phrase[len] = '\0';
+        const int16_t *pcm;
+        size_t count;
+        if (hal_tts_cache_lookup(phrase, speed, &pcm, &count) != 0) {
+            return 0;
+        }
+        hal_tts_cache_release(pcm);
+        total += count;
+    }
+    return total * 1000.0 / SAMPLE_RATE;
+}
+
+static int run_one(BenchCase bench_case, const CorpusEntry *entry,
+                   float speed) {
+    if (sample_count == sample_capacity) {
+        int capacity = sample_capacity ? sample_capacity * 2 : 64;
+        Sample *grown = realloc(samples, capacity * sizeof(Sample));
+        if (grown == NULL) {
+            return -1;
+        }
+        samples = grown;
+        sample_capacity = capacity;
+    }
+
+    unsigned int speak_us = 0;
+    unsigned int first_us = 0;
+    hal_tts_request_begin();
+    double start = current_time_ms();
+    int result = hal_tts_speak(entry->text, NULL);
+    double total = current_time_ms() - start;
+    hal_tts_request_times(&speak_us, &first_us);
+    wait_for_silence();
+    if (result != 0) {
+        fprintf(stderr, "WARNING: Speaking \"%s\" failed\n", entry->text);
+        return 0;
+    }
+
+    Sample *s = &samples[sample_count++];
+    s->bench_case = bench_case;
+    s->text_class = entry->text_class;
+    s->text = entry->text;
+    s->total_ms = total;
+    /* Microsecond stamps wrap every 71 minutes; unsigned subtraction
+     * still gives the difference */
+    s->ttfa_ms = (speak_us && first_us) ? (first_us - speak_us) / 1000.0
+                                        : -1;
+    s->audio_ms = audio_length_ms(entry->text, speed);
+    return 0;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile of a sorted array */
+static double percentile(const double *sorted, int count, double p) {
+    int rank = (int)(p / 100.0 * count + 0.999999);
+    if (rank < 1) {
+        rank = 1;
+    }
+    return sorted[(rank > count ? count : rank) - 1];
+}
+
+typedef struct {
+    int count;
+    double p50, p90, p99, max;
+} Summary;
+
+typedef enum { METRIC_TTFA, METRIC_TOTAL, METRIC_RTF, METRIC_COUNT } Metric;
+
+static const char *metric_names[METRIC_COUNT] = {"ttfa_ms", "total_ms",
+                                                 "rtf"};
+
+static Summary summarize(BenchCase bench_case, TextClass text_class,
+                         Metric metric) {
+    Summary summary = {0};
+    double *values = malloc((sample_count + 1) * sizeof(double));
+    if (values == NULL) {
+        return summary;
+    }
+    int count = 0;
+    for (int i = 0; i < sample_count; i++) {
+        const Sample *s = &samples[i];
+        if (s->bench_case != bench_case || s->text_class != text_class) {
+            continue;
+        }
+        if (metric == METRIC_TTFA && s->ttfa_ms >= 0) {
+            values[count++] = s->ttfa_ms;
+        } else if (metric == METRIC_TOTAL) {
+            values[count++] = s->total_ms;
+        } else if (metric == METRIC_RTF && s->audio_ms > 0) {
+            values[count++] = s->total_ms / s->audio_ms;
+        }
+    }
+    if (count > 0) {
+        qsort(values, count, sizeof(double), compare_double);
+        summary.count = count;
+        summary.p50 = percentile(values, count, 50);
+        summary.p90 = percentile(values, count, 90);
+        summary.p99 = percentile(values, count, 99);
+        summary.max = values[count - 1];
+    }
+    free(values);
+    return summary;
+}
+
+static int write_csv(const char *path, const char *engine, float speed) {
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        perror(path);
+        return -1;
+    }
+    fprintf(f, "host,engine,speed,case,class,text,ttfa_ms,total_ms,"
+               "audio_ms,rtf\n");
+    for (int i = 0; i < sample_count; i++) {
+        const Sample *s = &samples[i];
+        fprintf(f, "%s,%s,%.2f,%s,%s,\"%s\",", host_model, engine, speed,
+                case_names[s->bench_case], class_names[s->text_class],
+                s->text);
+        if (s->ttfa_ms >= 0) {
+            fprintf(f, "%.2f", s->ttfa_ms);
+        }
+        fprintf(f, ",%.2f,", s->total_ms);
+        if (s->audio_ms > 0) {
+            fprintf(f, "%.1f,%.3f\n", s->audio_ms, s->total_ms / s->audio_ms);
+        } else {
+            fprintf(f, ",\n");
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+static int write_json(const char *path, const char *engine, float speed,
+                      long long load_ms, long long warm_ms) {
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        perror(path);
+        return -1;
+    }
+    fprintf(f, "{\n  \"host\": \"%s\",\n  \"engine\": \"%s\",\n", host_model,
+            engine);
+    fprintf(f, "  \"speed\": %.2f,\n  \"init_load_ms\": %lld,\n"
+               "  \"init_warm_ms\": %lld,\n  \"results\": [",
+            speed, load_ms, warm_ms);
+    const char *separator = "\n";
+    for (int c = 0; c < CASE_COUNT; c++) {
+        for (int t = 0; t < CLASS_COUNT; t++) {
+            for (int m = 0; m < METRIC_COUNT; m++) {
+                Summary s = summarize(c, t, m);
+                if (s.count == 0) {
+                    continue;
+                }
+                fprintf(f, "%s    {\"case\": \"%s\", \"class\": \"%s\", "
+                           "\"metric\": \"%s\", \"n\": %d, \"p50\": %.3f, "
+                           "\"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f}",
+                        separator, case_names[c], class_names[t],
+                        metric_names[m], s.count, s.p50, s.p90, s.p99,
+                        s.max);
+                separator = ",\n";
+            }
+        }
+    }
+    fprintf(f, "\n  ]\n}\n");
+    fclose(f);
+    return 0;
+}
+
+static void print_table(void) {
+    printf("\n%-5s %-10s %-9s %5s %9s %9s %9s %9s\n", "Case", "Class",
+           "Metric", "N", "p50", "p90", "p99", "max");
+    for (int c = 0; c < CASE_COUNT; c++) {
+        for (int t = 0; t < CLASS_COUNT; t++) {
+            for (int m = 0; m < METRIC_COUNT; m++) {
+                Summary s = summarize(c, t, m);
+                if (s.count == 0) {
+                    continue;
+                }
+                printf("%-5s %-10s %-9s %5d %9.2f %9.2f %9.2f %9.2f\n",
+                       case_names[c], class_names[t], metric_names[m],
+                       s.count, s.p50, s.p90, s.p99, s.max);
+            }
+        }
+    }
+}
+
+static int remove_entry(const char *path, const struct stat *st, int flag,
+                        struct FTW *ftw) {
+    (void)st;
+    (void)flag;
+    (void)ftw;
+    remove(path);
+    return 0;
+}
+
+static void usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [--speed S] [--rounds N] [--cold N] [--csv FILE] "
+            "[--json FILE]\n"
+            "  --speed S   Length scale, as in the config (default 1.0)\n"
+            "  --rounds N  Miss and hit passes over the corpus (default 3)\n"
+            "  --cold N    Engine restarts to time the first request of "
+            "(default 3)\n"
+            "  --csv FILE  Every sample (default tts_benchmark.csv)\n"
+            "  --json FILE Percentiles (default tts_benchmark.json)\n",
+            program);
+}
+
+int main(int argc, char *argv[]) {
+    float speed = 1.0f;
+    int rounds = 3;
+    int cold_runs = 3;
+    const char *csv_path = "tts_benchmark.csv";
+    const char *json_path = "tts_benchmark.json";
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+            speed = strtof(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc) {
+            rounds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--cold") == 0 && i + 1 < argc) {
+            cold_runs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc) {
+            csv_path = argv[++i];
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_path = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (speed <= 0 || rounds < 1 || cold_runs < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    printf("=== HAMPOD TTS Benchmark ===\n");
+    read_host_model();
+    if (mkdtemp(cache_dir) == NULL) {
+        perror("mkdtemp");
+        return 1;
+    }
+    setenv("HAMPOD_TTS_CACHE_DIR", cache_dir, 1);
+
+    if (hal_audio_init() != 0) {
+        fprintf(stderr, "ERROR: Failed to initialize audio\n");
+        return 1;
+    }
+    hal_tts_set_speed(speed);
+    /* The key the cache files speech under, as the engines round it */
+    char speed_text[16];
+    snprintf(speed_text, sizeof(speed_text), "%.2f", speed);
+    speed = strtof(speed_text, NULL);
+
+    /* Cold: the first request after each start, nothing cached */
+    long long load_ms = 0;
+    long long warm_ms = 0;
+    for (int run = 0; run < cold_runs; run++) {
+        if (hal_tts_init() != 0) {
+            fprintf(stderr, "ERROR: Failed to initialize TTS\n");
+            hal_audio_cleanup();
+            return 1;
+        }
+        hal_tts_init_times(&load_ms, &warm_ms);
+        hal_tts_cache_clear();
+        const CorpusEntry *entry = &corpus[run % CORPUS_SIZE];
+        run_one(CASE_COLD, entry, speed);
+        if (run + 1 < cold_runs) {
+            hal_tts_cleanup();
+        }
+    }
+    const char *engine = hal_tts_get_impl_name();
+    printf("Host: %s\nEngine: %s, speed %.2f\n", host_model, engine, speed);
+    printf("Start-up: %lld ms loading, %lld ms warming\n", load_ms, warm_ms);
+
+    /* Miss then hit, each over the whole corpus */
+    for (int round = 0; round < rounds; round++) {
+        printf("Round %d of %d...\n", round + 1, rounds);
+        hal_tts_cache_clear();
+        for (int i = 0; i < CORPUS_SIZE; i++) {
+            run_one(CASE_MISS, &corpus[i], speed);
+        }
+        for (int i = 0; i < CORPUS_SIZE; i++) {
+            run_one(CASE_HIT, &corpus[i], speed);
+        }
+    }
+
+    print_table();
+    int result = 0;
+    if (write_csv(csv_path, engine, speed) != 0 ||
+        write_json(json_path, engine, speed, load_ms, warm_ms) != 0) {
+        result = 1;
+    } else {
+        printf("\nSamples: %s\nSummary: %s\n", csv_path, json_path);
+    }
+
+    hal_tts_cleanup();
+    hal_audio_cleanup();
+    nftw(cache_dir, remove_entry, 8, FTW_DEPTH | FTW_PHYS);
+    free(samples);
+    return result;
+}
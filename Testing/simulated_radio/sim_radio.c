@@ -0,0 +1,752 @@
+/**
+ * @file sim_radio.c
+ * @brief Simulated radio speaking the rigctld network protocol
+ *
+ * Stands in for `rigctld` and a real rig, so Software2 (or test_radio)
+ * can run with `rigctld = localhost:4532` and no hardware. Hamlib's NET
+ * rigctl backend talks to it exactly as it would to rigctld.
+ *
+ * For benchmarking it can add a fixed latency and random jitter to every
+ * reply, drop replies (the client times out) or answer with errors, and
+ * play a script of frequency, mode and level changes. "off" reproduces
+ * a powered-off TS-570 behind a caching backend: the frequency is still
+ * answered, from the cache, and nothing else is.
+ *
+ * Usage: see README.md, or sim_radio -h
+ */
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+// ============================================================================
+// Radio State
+// ============================================================================
+
+#define SIM_MAX_CLIENTS 8
+#define SIM_LINE_MAX 256
+#define SIM_SCRIPT_MAX 256
+
+// Hamlib's rig_errcode_e values sent back in "RPRT -n" replies
+#define SIM_RIG_OK 0
+#define SIM_RIG_EINVAL 1
+#define SIM_RIG_ETIMEOUT 5
+#define SIM_RIG_ENAVAIL 11
+
+typedef struct {
+  const char *name;
+  unsigned long mask; // Hamlib's RIG_MODE_* bit
+  int width;          // Normal passband, Hz
+} SimMode;
+
+static const SimMode g_modes[] = {
+    {"AM", 0x1, 6000},   {"CW", 0x2, 500},   {"USB", 0x4, 2400},
+    {"LSB", 0x8, 2400},  {"RTTY", 0x10, 500}, {"FM", 0x20, 15000},
+};
+#define SIM_MODE_COUNT (int)(sizeof(g_modes) / sizeof(g_modes[0]))
+
+typedef struct {
+  const char *name;
+  int bit;      // Hamlib's RIG_LEVEL_* or RIG_FUNC_* bit number
+  bool is_float;
+  bool settable;
+  double value;
+  bool refused; // Answer RIG_ENAVAIL, as a rig lacking it would
+} SimSetting;
+
+static SimSetting g_levels[] = {
+    {"PREAMP", 0, false, true, 0, false},
+    {"ATT", 1, false, true, 0, false},
+    {"NR", 8, true, true, 0.5, false},
+    {"RFPOWER", 12, true, true, 1.0, false},
+    {"MICGAIN", 13, true, true, 0.5, false},
+    {"COMP", 16, true, true, 0.3, false},
+    {"AGC", 17, false, true, 2, false}, // RIG_AGC_FAST
+    {"SWR", 28, true, false, 1.2, false},
+    {"STRENGTH", 30, false, false, -20, false},
+    {"RFPOWER_METER", 32, true, false, 0, false},
+    {"NB", 38, true, true, 0.5, false},
+};
+#define SIM_LEVEL_COUNT (int)(sizeof(g_levels) / sizeof(g_levels[0]))
+
+static SimSetting g_funcs[] = {
+    {"NB", 1, false, true, 0, false},
+    {"COMP", 2, false, true, 0, false},
+    {"VOX", 3, false, true, 0, false},
+    {"NR", 9, false, true, 0, false},
+};
+#define SIM_FUNC_COUNT (int)(sizeof(g_funcs) / sizeof(g_funcs[0]))
+
+static struct {
+  double freq;
+  int mode; // Index into g_modes
+  int width;
+  const char *vfo;
+  int ptt;
+  bool powered;
+} g_rig = {14074000.0, 2, 2400, "VFOA", 0, true};
+
+// Faults and delays, changeable from the script or stdin
+static struct {
+  int latency_ms;
+  int jitter_ms;
+  int drop_percent;  // No reply at all
+  int error_percent; // "RPRT -5" at once
+} g_faults;
+
+// A dial being turned: frequency steps until the end is reached
+static struct {
+  bool active;
+  double to;
+  double step;
+  int interval_ms;
+  long long next_ms;
+} g_sweep;
+
+static struct {
+  unsigned long commands;
+  unsigned long dropped;
+  unsigned long errors;
+  unsigned long unanswered; // While powered off
+} g_stats;
+
+static bool g_verbose = false;
+static volatile sig_atomic_t g_running = 1;
+
+// ============================================================================
+// Script
+// ============================================================================
+
+typedef struct {
+  long long at_ms;
+  char command[SIM_LINE_MAX];
+} SimEvent;
+
+static SimEvent g_script[SIM_SCRIPT_MAX];
+static int g_script_count = 0;
+static long long g_loop_ms = 0; // Restart the script this often, 0 = once
+static int g_script_next = 0;
+static long long g_script_start_ms = 0;
+
+// ============================================================================
+// Internal Functions
+// ============================================================================
+
+static long long now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void sleep_ms(int ms) {
+  if (ms <= 0) {
+    return;
+  }
+  struct timespec ts = {ms / 1000, (ms % 1000) * 1000000L};
+  nanosleep(&ts, NULL);
+}
+
+static bool chance(int percent) {
+  return percent > 0 && rand() % 100 < percent;
+}
+
+static SimSetting *find_setting(SimSetting *table, int count,
+                                const char *name) {
+  for (int i = 0; i < count; i++) {
+    if (strcasecmp(table[i].name, name) == 0) {
+      return &table[i];
+    }
+  }
+  return NULL;
+}
+
+static int find_mode(const char *name) {
+  for (int i = 0; i < SIM_MODE_COUNT; i++) {
+    if (strcasecmp(g_modes[i].name, name) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static unsigned long long setting_mask(const SimSetting *table, int count,
+                                       bool settable_only) {
+  unsigned long long mask = 0;
+  for (int i = 0; i < count; i++) {
+    if (!settable_only || table[i].settable) {
+      mask |= 1ULL << table[i].bit;
+    }
+  }
+  return mask;
+}
+
+static void print_stats(void) {
+  printf("sim_radio: %lu commands, %lu dropped, %lu errors, %lu while off\n",
+         g_stats.commands, g_stats.dropped, g_stats.errors,
+         g_stats.unanswered);
+}
+
+// What `rigctld` sends for \dump_state, protocol version 1
+static void write_dump_state(FILE *out) {
+  unsigned long modes = 0;
+  for (int i = 0; i < SIM_MODE_COUNT; i++) {
+    modes |= g_modes[i].mask;
+  }
+
+  fprintf(out, "1\n");     // Protocol version
+  fprintf(out, "1\n");     // Rig model (Hamlib's dummy)
+  fprintf(out, "0\n");     // ITU region
+  fprintf(out, "100000 30000000 0x%lx -1 -1 0x3 0x0\n", modes);
+  fprintf(out, "144000000 148000000 0x%lx -1 -1 0x3 0x0\n", modes);
+  fprintf(out, "0 0 0 0 0 0 0\n");
+  fprintf(out, "1800000 30000000 0x%lx 5000 100000 0x3 0x0\n", modes);
+  fprintf(out, "0 0 0 0 0 0 0\n");
+  fprintf(out, "0x%lx 10\n", modes); // Tuning steps
+  fprintf(out, "0 0\n");
+  for (int i = 0; i < SIM_MODE_COUNT; i++) { // Filters
+    fprintf(out, "0x%lx %d\n", g_modes[i].mask, g_modes[i].width);
+  }
+  fprintf(out, "0 0\n");
+  fprintf(out, "9990\n9990\n0\n0\n"); // max_rit, max_xit, ifshift, announces
+  fprintf(out, "10 20\n");            // Preamps, dB
+  fprintf(out, "6 12 18\n");          // Attenuators, dB
+  fprintf(out, "0x%llx\n", setting_mask(g_funcs, SIM_FUNC_COUNT, false));
+  fprintf(out, "0x%llx\n", setting_mask(g_funcs, SIM_FUNC_COUNT, true));
+  fprintf(out, "0x%llx\n", setting_mask(g_levels, SIM_LEVEL_COUNT, false));
+  fprintf(out, "0x%llx\n", setting_mask(g_levels, SIM_LEVEL_COUNT, true));
+  fprintf(out, "0x0\n0x0\n"); // Parameters
+  fprintf(out, "done\n");
+}
+
+// ============================================================================
+// Control Commands (script and stdin)
+// ============================================================================
+
+static void start_script(void) {
+  g_script_next = 0;
+  g_script_start_ms = now_ms();
+}
+
+// Returns false for an unknown command
+static bool run_control(const char *line, int *drop_clients) {
+  char cmd[32];
+  char name[32];
+  double a = 0, b = 0, c = 0, d = 0;
+  int n = sscanf(line, "%31s", cmd);
+  if (n != 1 || cmd[0] == '#') {
+    return true;
+  }
+
+  if (strcmp(cmd, "freq") == 0 && sscanf(line, "%*s %lf", &a) == 1) {
+    g_rig.freq = a;
+    g_sweep.active = false;
+  } else if (strcmp(cmd, "mode") == 0 &&
+             sscanf(line, "%*s %31s %lf", name, &a) >= 1) {
+    int mode = find_mode(name);
+    if (mode < 0) {
+      return false;
+    }
+    g_rig.mode = mode;
+    g_rig.width = a > 0 ? (int)a : g_modes[mode].width;
+  } else if (strcmp(cmd, "level") == 0 &&
+             sscanf(line, "%*s %31s %lf", name, &a) == 2) {
+    SimSetting *level = find_setting(g_levels, SIM_LEVEL_COUNT, name);
+    if (level == NULL) {
+      return false;
+    }
+    level->value = a;
+  } else if (strcmp(cmd, "func") == 0 &&
+             sscanf(line, "%*s %31s %lf", name, &a) == 2) {
+    SimSetting *func = find_setting(g_funcs, SIM_FUNC_COUNT, name);
+    if (func == NULL) {
+      return false;
+    }
+    func->value = a != 0;
+  } else if ((strcmp(cmd, "refuse") == 0 || strcmp(cmd, "accept") == 0) &&
+             sscanf(line, "%*s %31s", name) == 1) {
+    SimSetting *level = find_setting(g_levels, SIM_LEVEL_COUNT, name);
+    SimSetting *func = find_setting(g_funcs, SIM_FUNC_COUNT, name);
+    if (level == NULL && func == NULL) {
+      return false;
+    }
+    bool refused = cmd[0] == 'r';
+    if (level) {
+      level->refused = refused;
+    }
+    if (func) {
+      func->refused = refused;
+    }
+  } else if (strcmp(cmd, "sweep") == 0 &&
+             sscanf(line, "%*s %lf %lf %lf %lf", &a, &b, &c, &d) == 4) {
+    g_rig.freq = a;
+    g_sweep.to = b;
+    g_sweep.step = b >= a ? c : -c;
+    g_sweep.interval_ms = d > 0 ? (int)d : 50;
+    g_sweep.next_ms = now_ms() + g_sweep.interval_ms;
+    g_sweep.active = c > 0;
+  } else if (strcmp(cmd, "off") == 0) {
+    g_rig.powered = false;
+  } else if (strcmp(cmd, "on") == 0) {
+    g_rig.powered = true;
+  } else if (strcmp(cmd, "drop") == 0) {
+    *drop_clients = 1;
+  } else if (strcmp(cmd, "latency") == 0 && sscanf(line, "%*s %lf", &a) == 1) {
+    g_faults.latency_ms = (int)a;
+  } else if (strcmp(cmd, "jitter") == 0 && sscanf(line, "%*s %lf", &a) == 1) {
+    g_faults.jitter_ms = (int)a;
+  } else if (strcmp(cmd, "drops") == 0 && sscanf(line, "%*s %lf", &a) == 1) {
+    g_faults.drop_percent = (int)a;
+  } else if (strcmp(cmd, "errors") == 0 && sscanf(line, "%*s %lf", &a) == 1) {
+    g_faults.error_percent = (int)a;
+  } else if (strcmp(cmd, "stats") == 0) {
+    print_stats();
+  } else if (strcmp(cmd, "quit") == 0) {
+    g_running = 0;
+  } else {
+    return false;
+  }
+
+  if (g_verbose) {
+    printf("sim_radio: %s\n", line);
+  }
+  return true;
+}
+
+static int load_script(const char *path) {
+  FILE *in = fopen(path, "r");
+  if (in == NULL) {
+    fprintf(stderr, "sim_radio: Cannot open %s\n", path);
+    return -1;
+  }
+
+  char line[SIM_LINE_MAX];
+  int line_no = 0;
+  while (fgets(line, sizeof(line), in)) {
+    line_no++;
+    line[strcspn(line, "\r\n")] = '\0';
+    char *text = line + strspn(line, " \t");
+    if (text[0] == '\0' || text[0] == '#') {
+      continue;
+    }
+
+    long long at;
+    int used;
+    if (sscanf(text, "loop %lld", &at) == 1) {
+      g_loop_ms = at;
+    } else if (sscanf(text, "%lld %n", &at, &used) == 1 &&
+               g_script_count < SIM_SCRIPT_MAX) {
+      g_script[g_script_count].at_ms = at;
+      snprintf(g_script[g_script_count].command, SIM_LINE_MAX, "%s",
+               text + used);
+      g_script_count++;
+    } else {
+      fprintf(stderr, "sim_radio: %s:%d: Expected \"<ms> <command>\"\n",
+              path, line_no);
+    }
+  }
+  fclose(in);
+  return 0;
+}
+
+// Run what is due; returns ms until the next event, or -1 if none
+static int run_due(int *drop_clients) {
+  long long now = now_ms();
+  int wait = -1;
+
+  while (g_script_next < g_script_count &&
+         g_script[g_script_next].at_ms <= now - g_script_start_ms) {
+    if (!run_control(g_script[g_script_next].command, drop_clients)) {
+      fprintf(stderr, "sim_radio: Bad script command: %s\n",
+              g_script[g_script_next].command);
+    }
+    g_script_next++;
+  }
+  if (g_script_next == g_script_count && g_loop_ms > 0 &&
+      now - g_script_start_ms >= g_loop_ms) {
+    start_script();
+  }
+  if (g_script_next < g_script_count) {
+    wait = (int)(g_script_start_ms + g_script[g_script_next].at_ms - now);
+  } else if (g_loop_ms > 0) {
+    wait = (int)(g_script_start_ms + g_loop_ms - now);
+  }
+
+  while (g_sweep.active && g_sweep.next_ms <= now) {
+    g_rig.freq += g_sweep.step;
+    if ((g_sweep.step > 0 && g_rig.freq >= g_sweep.to) ||
+        (g_sweep.step < 0 && g_rig.freq <= g_sweep.to)) {
+      g_rig.freq = g_sweep.to;
+      g_sweep.active = false;
+    }
+    g_sweep.next_ms += g_sweep.interval_ms;
+  }
+  if (g_sweep.active) {
+    int sweep_wait = (int)(g_sweep.next_ms - now);
+    if (wait < 0 || sweep_wait < wait) {
+      wait = sweep_wait;
+    }
+  }
+  return wait < 0 ? -1 : wait;
+}
+
+// ============================================================================
+// Protocol (what rigctld answers)
+// ============================================================================
+
+static void reply_code(FILE *out, int code) {
+  fprintf(out, "RPRT %d\n", code == 0 ? 0 : -code);
+}
+
+static void reply_setting_get(FILE *out, SimSetting *table, int count,
+                              const char *name) {
+  SimSetting *setting = find_setting(table, count, name);
+  if (setting == NULL) {
+    reply_code(out, SIM_RIG_EINVAL);
+  } else if (setting->refused) {
+    reply_code(out, SIM_RIG_ENAVAIL);
+  } else if (setting->is_float) {
+    fprintf(out, "%f\n", setting->value);
+  } else {
+    fprintf(out, "%d\n", (int)setting->value);
+  }
+}
+
+static void reply_setting_set(FILE *out, SimSetting *table, int count,
+                              const char *name, const char *value) {
+  SimSetting *setting = find_setting(table, count, name);
+  if (setting == NULL || value == NULL || !setting->settable) {
+    reply_code(out, SIM_RIG_EINVAL);
+  } else if (setting->refused) {
+    reply_code(out, SIM_RIG_ENAVAIL);
+  } else {
+    setting->value = strtod(value, NULL);
+    reply_code(out, SIM_RIG_OK);
+  }
+}
+
+// Answer one command line. Returns false if the client asked to quit.
+static bool answer(FILE *out, char *line) {
+  char *cmd = strtok(line, " \t");
+  char *arg1 = strtok(NULL, " \t");
+  char *arg2 = strtok(NULL, " \t");
+  if (cmd == NULL) {
+    return true;
+  }
+  if (strcmp(cmd, "q") == 0 || strcmp(cmd, "Q") == 0 ||
+      strcmp(cmd, "\\quit") == 0) {
+    return false;
+  }
+  g_stats.commands++;
+
+  bool get_freq = strcmp(cmd, "f") == 0 || strcmp(cmd, "\\get_freq") == 0;
+  // Powered off behind a caching backend: only the frequency is answered
+  if (!g_rig.powered && !get_freq) {
+    g_stats.unanswered++;
+    return true;
+  }
+  if (chance(g_faults.drop_percent)) {
+    g_stats.dropped++;
+    return true;
+  }
+
+  int delay = g_faults.latency_ms;
+  if (g_faults.jitter_ms > 0) {
+    delay += rand() % (2 * g_faults.jitter_ms + 1) - g_faults.jitter_ms;
+  }
+  sleep_ms(delay);
+
+  if (chance(g_faults.error_percent)) {
+    g_stats.errors++;
+    reply_code(out, SIM_RIG_ETIMEOUT);
+    return true;
+  }
+
+  if (get_freq) {
+    fprintf(out, "%.0f\n", g_rig.freq);
+  } else if (strcmp(cmd, "F") == 0 || strcmp(cmd, "\\set_freq") == 0) {
+    if (arg1 == NULL) {
+      reply_code(out, SIM_RIG_EINVAL);
+    } else {
+      g_rig.freq = strtod(arg1, NULL);
+      g_sweep.active = false;
+      reply_code(out, SIM_RIG_OK);
+    }
+  } else if (strcmp(cmd, "m") == 0 || strcmp(cmd, "\\get_mode") == 0) {
+    fprintf(out, "%s\n%d\n", g_modes[g_rig.mode].name, g_rig.width);
+  } else if (strcmp(cmd, "M") == 0 || strcmp(cmd, "\\set_mode") == 0) {
+    int mode = arg1 ? find_mode(arg1) : -1;
+    if (mode < 0) {
+      reply_code(out, SIM_RIG_EINVAL);
+    } else {
+      int width = arg2 ? atoi(arg2) : 0;
+      g_rig.mode = mode;
+      g_rig.width = width > 0 ? width : g_modes[mode].width;
+      reply_code(out, SIM_RIG_OK);
+    }
+  } else if (strcmp(cmd, "v") == 0 || strcmp(cmd, "\\get_vfo") == 0) {
+    fprintf(out, "%s\n", g_rig.vfo);
+  } else if (strcmp(cmd, "V") == 0 || strcmp(cmd, "\\set_vfo") == 0) {
+    if (arg1 && (strcmp(arg1, "VFOA") == 0 || strcmp(arg1, "VFOB") == 0)) {
+      g_rig.vfo = arg1[3] == 'A' ? "VFOA" : "VFOB";
+      reply_code(out, SIM_RIG_OK);
+    } else {
+      reply_code(out, SIM_RIG_EINVAL);
+    }
+  } else if (strcmp(cmd, "l") == 0 || strcmp(cmd, "\\get_level") == 0) {
+    reply_setting_get(out, g_levels, SIM_LEVEL_COUNT, arg1 ? arg1 : "");
+  } else if (strcmp(cmd, "L") == 0 || strcmp(cmd, "\\set_level") == 0) {
+    reply_setting_set(out, g_levels, SIM_LEVEL_COUNT, arg1 ? arg1 : "", arg2);
+  } else if (strcmp(cmd, "u") == 0 || strcmp(cmd, "\\get_func") == 0) {
+    reply_setting_get(out, g_funcs, SIM_FUNC_COUNT, arg1 ? arg1 : "");
+  } else if (strcmp(cmd, "U") == 0 || strcmp(cmd, "\\set_func") == 0) {
+    reply_setting_set(out, g_funcs, SIM_FUNC_COUNT, arg1 ? arg1 : "", arg2);
+  } else if (strcmp(cmd, "t") == 0 || strcmp(cmd, "\\get_ptt") == 0) {
+    fprintf(out, "%d\n", g_rig.ptt);
+  } else if (strcmp(cmd, "T") == 0 || strcmp(cmd, "\\set_ptt") == 0) {
+    g_rig.ptt = arg1 ? atoi(arg1) != 0 : 0;
+    reply_code(out, SIM_RIG_OK);
+  } else if (strcmp(cmd, "\\get_powerstat") == 0) {
+    fprintf(out, "1\n");
+  } else if (strcmp(cmd, "\\chk_vfo") == 0) {
+    fprintf(out, "0\n"); // Commands carry no VFO argument
+  } else if (strcmp(cmd, "\\dump_state") == 0) {
+    write_dump_state(out);
+  } else {
+    reply_code(out, SIM_RIG_EINVAL);
+  }
+  return true;
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+typedef struct {
+  int fd;
+  FILE *out;
+  char buffer[SIM_LINE_MAX];
+  size_t used;
+} SimClient;
+
+static SimClient g_clients[SIM_MAX_CLIENTS];
+static int g_client_count = 0;
+
+static void close_client(int i) {
+  fclose(g_clients[i].out); // Closes the socket too
+  g_clients[i] = g_clients[--g_client_count];
+  if (g_verbose) {
+    printf("sim_radio: Client left\n");
+  }
+}
+
+// Read what a client sent and answer each whole line
+static bool serve_client(SimClient *client) {
+  ssize_t n = read(client->fd, client->buffer + client->used,
+                   sizeof(client->buffer) - 1 - client->used);
+  if (n <= 0) {
+    return false;
+  }
+  client->used += (size_t)n;
+
+  char *start = client->buffer;
+  char *newline;
+  bool keep = true;
+  while (keep && (newline = memchr(start, '\n',
+                                   client->used - (start - client->buffer)))) {
+    *newline = '\0';
+    if (newline > start && newline[-1] == '\r') {
+      newline[-1] = '\0';
+    }
+    if (g_verbose) {
+      printf("sim_radio: < %s\n", start);
+    }
+    keep = answer(client->out, start);
+    fflush(client->out);
+    start = newline + 1;
+  }
+
+  size_t rest = client->used - (start - client->buffer);
+  if (rest == sizeof(client->buffer) - 1) {
+    rest = 0; // A line too long for the buffer: discard it
+  }
+  memmove(client->buffer, start, rest);
+  client->used = rest;
+  return keep;
+}
+
+static int open_listener(int port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    perror("sim_radio: socket");
+    return -1;
+  }
+  int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+  struct sockaddr_in addr = {0};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons((unsigned short)port);
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+      listen(fd, SIM_MAX_CLIENTS) != 0) {
+    perror("sim_radio: bind");
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static void usage(const char *name) {
+  printf("Usage: %s [options]\n", name);
+  printf("  -p PORT     Listen on PORT (default 4532, like rigctld)\n");
+  printf("  -l MS       Delay every reply by MS\n");
+  printf("  -j MS       Add up to +/- MS of random jitter\n");
+  printf("  -d PERCENT  Drop this share of replies (client times out)\n");
+  printf("  -e PERCENT  Answer this share with a timeout error\n");
+  printf("  -s FILE     Play a script of timed commands\n");
+  printf("  -r SEED     Seed for drops, errors and jitter\n");
+  printf("  -v          Log every command\n");
+  printf("Commands on stdin take effect at once (see README.md).\n");
+}
+
+static void stop(int sig) {
+  (void)sig;
+  g_running = 0;
+}
+
+int main(int argc, char *argv[]) {
+  int port = 4532;
+  unsigned int seed = (unsigned int)time(NULL);
+  const char *script = NULL;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "p:l:j:d:e:s:r:vh")) != -1) {
+    switch (opt) {
+    case 'p':
+      port = atoi(optarg);
+      break;
+    case 'l':
+      g_faults.latency_ms = atoi(optarg);
+      break;
+    case 'j':
+      g_faults.jitter_ms = atoi(optarg);
+      break;
+    case 'd':
+      g_faults.drop_percent = atoi(optarg);
+      break;
+    case 'e':
+      g_faults.error_percent = atoi(optarg);
+      break;
+    case 's':
+      script = optarg;
+      break;
+    case 'r':
+      seed = (unsigned int)strtoul(optarg, NULL, 10);
+      break;
+    case 'v':
+      g_verbose = true;
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  srand(seed);
+
+  if (script && load_script(script) != 0) {
+    return 1;
+  }
+  int listener = open_listener(port);
+  if (listener < 0) {
+    return 1;
+  }
+
+  signal(SIGINT, stop);
+  signal(SIGTERM, stop);
+  signal(SIGPIPE, SIG_IGN);
+  setvbuf(stdout, NULL, _IOLBF, 0);
+  printf("sim_radio: Listening on port %d (%d ms latency, %d ms jitter, "
+         "%d%% drops, %d%% errors)\n",
+         port, g_faults.latency_ms, g_faults.jitter_ms, g_faults.drop_percent,
+         g_faults.error_percent);
+
+  start_script();
+  bool stdin_open = true;
+  while (g_running) {
+    int drop_clients = 0;
+    int wait = run_due(&drop_clients);
+
+    struct pollfd fds[SIM_MAX_CLIENTS + 2];
+    int nfds = 0;
+    fds[nfds++] = (struct pollfd){listener, POLLIN, 0};
+    fds[nfds++] = (struct pollfd){stdin_open ? STDIN_FILENO : -1, POLLIN, 0};
+    for (int i = 0; i < g_client_count; i++) {
+      fds[nfds++] = (struct pollfd){g_clients[i].fd, POLLIN, 0};
+    }
+
+    if (poll(fds, nfds, wait) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("sim_radio: poll");
+      break;
+    }
+
+    if (fds[1].revents & (POLLIN | POLLHUP)) {
+      char line[SIM_LINE_MAX];
+      if (fgets(line, sizeof(line), stdin) == NULL) {
+        stdin_open = false; // Running in the background
+      } else {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (!run_control(line, &drop_clients)) {
+          fprintf(stderr, "sim_radio: Unknown command: %s\n", line);
+        }
+      }
+    }
+
+    // Back to front, since closing moves the last client into the slot
+    for (int i = g_client_count - 1; i >= 0; i--) {
+      if (fds[i + 2].revents & (POLLIN | POLLHUP | POLLERR)) {
+        if (!serve_client(&g_clients[i])) {
+          close_client(i);
+        }
+      }
+    }
+    if (drop_clients) {
+      while (g_client_count > 0) {
+        close_client(g_client_count - 1);
+      }
+    }
+
+    if (fds[0].revents & POLLIN) {
+      int fd = accept(listener, NULL, NULL);
+      if (fd >= 0 && g_client_count < SIM_MAX_CLIENTS) {
+        SimClient *client = &g_clients[g_client_count++];
+        client->fd = fd;
+        client->out = fdopen(fd, "w");
+        client->used = 0;
+        if (g_verbose) {
+          printf("sim_radio: Client connected\n");
+        }
+      } else if (fd >= 0) {
+        close(fd);
+      }
+    }
+  }
+
+  while (g_client_count > 0) {
+    close_client(g_client_count - 1);
+  }
+  close(listener);
+  print_stats();
+  return 0;
+}
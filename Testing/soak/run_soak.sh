@@ -0,0 +1,89 @@
+#!/bin/bash
+# =============================================================================
+# HAMPOD soak test
+# =============================================================================
+# Starts the whole stack without hardware and runs soak against it:
+#   - sim_radio playing scenarios/soak.txt, in place of the radio
+#   - firmware.elf taking keys from this host (--remote) and playing into
+#     an ALSA loopback card if snd-aloop is loaded (paced like a sound
+#     card), else into ALSA's null device (not paced: speech is gone as
+#     soon as it is made)
+#   - Software2 talking to sim_radio over the rigctld protocol
+# Firmware and Software2 must be built. Everything started is stopped
+# again when soak ends, or on Ctrl+C.
+#
+# Usage: ./run_soak.sh [soak options]
+#   e.g. ./run_soak.sh --hours 8 --speed 60     # 8 hours in 8 minutes
+#        ./run_soak.sh --hours 12               # overnight, in real time
+# Logs go to /tmp/soak_*.log.
+# =============================================================================
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+REPO_ROOT="$(cd "$SCRIPT_DIR/../.." && pwd)"
+FIRMWARE_DIR="$REPO_ROOT/Firmware"
+SOFTWARE2_DIR="$REPO_ROOT/Software2"
+SIM_DIR="$REPO_ROOT/Testing/simulated_radio"
+REMOTE_PORT=${SOAK_REMOTE_PORT:-5088}
+RIG_PORT=${SOAK_RIG_PORT:-4532}
+
+PIDS=""
+cleanup() {
+    for PID in $PIDS; do
+        kill "$PID" 2>/dev/null
+    done
+    wait 2>/dev/null
+}
+trap cleanup EXIT
+trap 'exit 130' INT TERM
+
+if [ ! -x "$FIRMWARE_DIR/firmware.elf" ] ||
+   [ ! -x "$SOFTWARE2_DIR/bin/hampod" ]; then
+    echo "ERROR: Build Firmware (make) and Software2 (make) first"
+    exit 1
+fi
+make -s -C "$SIM_DIR" sim_radio && make -s -C "$SCRIPT_DIR" soak || exit 1
+
+if [ -z "$HAMPOD_AUDIO_DEVICE" ]; then
+    if grep -q Loopback /proc/asound/cards 2>/dev/null; then
+        export HAMPOD_AUDIO_DEVICE="plughw:Loopback,0"
+    else
+        export HAMPOD_AUDIO_DEVICE="null"
+    fi
+fi
+echo "Audio: $HAMPOD_AUDIO_DEVICE"
+
+# 1. The radio
+"$SIM_DIR/sim_radio" -p "$RIG_PORT" -l 10 -j 5 -r 1 \
+    -s "$SIM_DIR/scenarios/soak.txt" < /dev/null > /tmp/soak_radio.log 2>&1 &
+PIDS="$PIDS $!"
+
+# 2. Firmware, its keys coming from soak over the loopback
+cd "$FIRMWARE_DIR" || exit 1
+rm -f Firmware_i Firmware_o Speaker_i Speaker_o Keypad_i Keypad_o
+./firmware.elf --remote "127.0.0.1:$REMOTE_PORT" > /tmp/soak_firmware.log 2>&1 &
+PIDS="$PIDS $!"
+for i in $(seq 1 50); do
+    [ -p Firmware_o ] && break
+    sleep 0.2
+done
+if [ ! -p Firmware_o ]; then
+    echo "ERROR: Firmware did not start; see /tmp/soak_firmware.log"
+    exit 1
+fi
+
+# 3. Software2, until its startup is complete
+cd "$SOFTWARE2_DIR" || exit 1
+HAMPOD_RADIO_RIGCTLD="localhost:$RIG_PORT" stdbuf -oL ./bin/hampod \
+    > /tmp/soak_hampod.log 2>&1 &
+PIDS="$PIDS $!"
+for i in $(seq 1 150); do
+    grep -q "Startup complete" /tmp/soak_hampod.log && break
+    sleep 0.2
+done
+sleep 2
+
+# 4. The load and the checks
+cd "$SCRIPT_DIR" || exit 1
+./soak --remote "127.0.0.1:$REMOTE_PORT" \
+    --config "$SOFTWARE2_DIR/config/hampod.conf" "$@"
+exit $?
@@ -0,0 +1,867 @@
+/* Soak and stress test of a running HAMPOD
+ *
+ * Drives the whole stack - firmware.elf, its keypad and audio processes
+ * and Software2 - for hours, the way a busy operator would and worse,
+ * and watches it for the faults that only show up after a long run.
+ * run_soak.sh starts the stack against the simulated radio and a null
+ * audio device and runs this; it can also be pointed at a stack started
+ * by hand.
+ *
+ * The load, each at random intervals around a mean:
+ *   burst      a few readout keys 60-200 ms apart
+ *   hold       a key held past the hold threshold
+ *   storm      one key pressed every 25 ms, each press cutting off the
+ *              speech of the one before (interrupt storm)
+ *   flood      readout keys every 150 ms for 10 s while the simulated
+ *              radio's dial moves, so most speech is new text for the TTS
+ *   config     volume, speech_speed and key_beep changed in hampod.conf,
+ *              which Software2 applies at once (config_watch.h)
+ * Keys go in as the remote station's (hal/hal_remote.h), so they take
+ * the keypad process's path from there on: firmware.elf must run with
+ * --remote pointing at this host.
+ *
+ * The checks, from the trace rings, the metrics registries and /proc:
+ *   drops      any of the drop and underrun counters going up
+ *   ordering   every key sent is traced, in the order sent, by the keypad
+ *              process (TRACE_KEY) and by Software2 (TRACE_KEY_RECEIVED);
+ *              one missing after SOAK_KEY_TIMEOUT_MS is lost
+ *   latency    a key reaching Software2 later than --key-ms, or speech
+ *              whose first audio came later than --speech-ms
+ *   leaks      resident memory and open files of every process, sampled
+ *              through the run; after the warm-up, growth beyond
+ *              --leak-kb per hour of load or a rising file count fails
+ *   restarts   a process that died or was replaced
+ *
+ * --speed N compresses the run: the gaps between episodes (and the
+ * sampling and warm-up) shrink N times, so an 8 hour schedule at --speed
+ * 60 runs in 8 minutes. What happens inside an episode keeps real time.
+ *
+ * Usage: ./soak [--remote HOST:PORT] [--hours H] [--speed N]
+ *               [--config FILE] [--key-ms MS] [--speech-ms MS]
+ *               [--leak-kb KB] [--seed N] [--csv FILE]
+ * --remote defaults to HAMPOD_REMOTE, as for firmware.elf. --config is
+ * the hampod.conf Software2 watches (default ../../Software2/config/
+ * hampod.conf; "" for no config changes); it is put back as it was when
+ * the run ends. --csv appends a row per sample. Exits 1 on any violation.
+ */
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hal/hal_keypad.h"
+#include "hal/hal_remote.h"
+#include "hampod_metrics.h"
+#include "hampod_trace.h"
+
+#define SOAK_CONFIG_DEFAULT "../../Software2/config/hampod.conf"
+#define SOAK_KEY_MS_DEFAULT 50
+#define SOAK_SPEECH_MS_DEFAULT 500
+#define SOAK_LEAK_KB_DEFAULT 512
+#define SOAK_KEY_TIMEOUT_MS 2000 /* A key not traced by then is lost */
+#define SOAK_POLL_MS 20          /* Trace rings read this often */
+#define SOAK_SAMPLE_S 60         /* Scaled by --speed */
+#define SOAK_WARMUP_S 600        /* Scaled; memory before it is not a leak */
+#define SOAK_HOLD_MS 600         /* Software2 holds at 500 ms */
+#define SOAK_SENT_MAX 8192       /* Power of two */
+#define SOAK_SAMPLES_MAX 4096
+#define SOAK_REPORTS_MAX 20      /* Violations printed one by one */
+
+/* Keys that only read something out in Normal Mode; none of them enters
+ * a mode the load would then have to leave */
+static const char readout_keys[] = "120*4678";
+static const char hold_keys[] = "4*8";
+static const char *const speech_speeds[] = {"0.1", "0.5", "1.0", "1.5"};
+#define SPEECH_SPEED_COUNT                                                     \
+  (int)(sizeof(speech_speeds) / sizeof(speech_speeds[0]))
+
+typedef enum {
+  EPISODE_BURST,
+  EPISODE_HOLD,
+  EPISODE_STORM,
+  EPISODE_FLOOD,
+  EPISODE_CONFIG,
+  EPISODES
+} Episode;
+
+static const char *const episode_names[EPISODES] = {"burst", "hold", "storm",
+                                                    "flood", "config"};
+
+/* Mean seconds between episodes of each kind, before --speed */
+static const double episode_mean_s[EPISODES] = {20, 45, 300, 180, 600};
+
+/* Processes watched: their registries and rings are named after them */
+#define PROCESSES 4
+static const char *const process_names[PROCESSES] = {"firmware", "keypad",
+                                                     "audio", "hampod"};
+
+/* Drop counters: none of them may go up */
+static const Metric drop_metrics[] = {
+    METRIC_KEYPAD_QUEUE_DROPS, METRIC_KEYPAD_EVENT_DROPS,
+    METRIC_AUDIO_QUEUE_DROPS,  METRIC_AUDIO_UNDERRUNS,
+    METRIC_KEY_PUSH_DROPS,     METRIC_SPEECH_DROPS};
+#define DROP_METRICS (int)(sizeof(drop_metrics) / sizeof(drop_metrics[0]))
+
+#define METRIC_NAME(id, name, kind, help) name,
+static const char *const metric_names[METRICS] = {
+    HAMPOD_METRIC_LIST(METRIC_NAME)};
+#undef METRIC_NAME
+
+static const uint64_t bucket_limits_us[METRIC_BUCKETS - 1] =
+    METRIC_BUCKET_LIMITS_US;
+
+typedef struct Sent_key {
+  char key;
+  unsigned char action;
+  uint64_t sent_ms;
+} Sent_key;
+
+/* One hop a key is traced at: which ring, which event, and how far the
+ * sent keys have been matched */
+typedef struct Key_stage {
+  int process; /* Index in process_names */
+  Trace_event event;
+  uint32_t read; /* Ring records consumed */
+  uint64_t next; /* Sent key expected next */
+  uint64_t seen;
+  uint64_t lost;
+  uint64_t out_of_order;
+  uint64_t late;
+  uint32_t max_age_us;
+} Key_stage;
+
+/* What is watched of one process */
+typedef struct Watched {
+  int pid;
+  Trace_ring *ring;
+  Metric_registry *registry;
+  uint64_t drops[DROP_METRICS]; /* Counter values at the start */
+  uint64_t slow_speech;         /* First audio slower than --speech-ms */
+  long rss_kb[SOAK_SAMPLES_MAX];
+  int fds[SOAK_SAMPLES_MAX]; /* -1 when /proc/PID/fd cannot be read */
+  int restarts;
+} Watched;
+
+static volatile sig_atomic_t running = 1;
+
+/* Options */
+static double hours = 4;
+static double speed = 1;
+static const char *config_path = SOAK_CONFIG_DEFAULT;
+static unsigned key_ms = SOAK_KEY_MS_DEFAULT;
+static unsigned speech_ms = SOAK_SPEECH_MS_DEFAULT;
+static unsigned leak_kb = SOAK_LEAK_KB_DEFAULT;
+static const char *csv_path = NULL;
+
+/* Key sender, and the keys sent so far */
+static int sock = -1;
+static struct sockaddr_in hampod;
+static uint32_t session;
+static RemoteKeyEvent window[REMOTE_KEY_EVENTS]; /* Last events, resent */
+static int window_count = 0;
+static Sent_key sent[SOAK_SENT_MAX];
+static uint64_t sent_count = 0;
+static pthread_mutex_t sent_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t episode_count[EPISODES];
+
+/* Checker */
+static Watched watched[PROCESSES];
+static Key_stage stages[] = {
+    {1, TRACE_KEY, 0, 0, 0, 0, 0, 0, 0},
+    {3, TRACE_KEY_RECEIVED, 0, 0, 0, 0, 0, 0, 0},
+};
+#define STAGES (int)(sizeof(stages) / sizeof(stages[0]))
+static double sample_hours[SOAK_SAMPLES_MAX]; /* Hours of load at each */
+static int sample_count = 0;
+static int violations = 0;
+
+/* Config file as it was, put back at the end */
+static char *config_original = NULL;
+static size_t config_length = 0;
+
+static void on_signal(int sig) {
+  (void)sig;
+  running = 0;
+}
+
+static uint64_t now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static uint64_t realtime_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static void sleep_ms(unsigned ms) {
+  struct timespec pause = {ms / 1000, (long)(ms % 1000) * 1000000L};
+  nanosleep(&pause, NULL);
+}
+
+static unsigned random_between(unsigned low, unsigned high) {
+  return low + (unsigned)(rand() % (int)(high - low + 1));
+}
+
+__attribute__((format(printf, 1, 2))) static void
+violation(const char *format, ...) {
+  violations++;
+  if (violations <= SOAK_REPORTS_MAX) {
+    va_list args;
+    va_start(args, format);
+    printf("VIOLATION: ");
+    vprintf(format, args);
+    printf("\n");
+    va_end(args);
+  } else if (violations == SOAK_REPORTS_MAX + 1) {
+    printf("(further violations are only counted)\n");
+  }
+  fflush(stdout);
+}
+
+/* ========================================================================
+ * Load
+ * ======================================================================== */
+
+/* Send one key event, with the events before it in the same datagram */
+static void send_key(char key, unsigned char action) {
+  static uint32_t seq = 0;
+  if (window_count == REMOTE_KEY_EVENTS) {
+    memmove(window, window + 1, sizeof(window[0]) * (REMOTE_KEY_EVENTS - 1));
+    window_count--;
+  }
+  RemoteKeyEvent event = {++seq, realtime_us(), key, action};
+  window[window_count++] = event;
+
+  pthread_mutex_lock(&sent_lock);
+  Sent_key *entry = &sent[sent_count & (SOAK_SENT_MAX - 1)];
+  entry->key = key;
+  entry->action = action;
+  entry->sent_ms = now_ms();
+  sent_count++;
+  pthread_mutex_unlock(&sent_lock);
+
+  unsigned char datagram[REMOTE_KEY_DATAGRAM_MAX];
+  size_t length =
+      hal_remote_encode_keys(session, window, window_count, datagram);
+  sendto(sock, datagram, length, 0, (struct sockaddr *)&hampod,
+         sizeof(hampod));
+}
+
+static void press(char key, unsigned down_ms) {
+  send_key(key, KEYPAD_ACTION_PRESS);
+  sleep_ms(down_ms);
+  send_key(key, KEYPAD_ACTION_RELEASE);
+}
+
+static void hold(char key) {
+  send_key(key, KEYPAD_ACTION_PRESS);
+  sleep_ms(SOAK_HOLD_MS);
+  send_key(key, KEYPAD_ACTION_HOLD);
+  sleep_ms(100);
+  send_key(key, KEYPAD_ACTION_RELEASE);
+}
+
+static char any_of(const char *keys) {
+  return keys[rand() % (int)strlen(keys)];
+}
+
+/* Set one "name = value" line of the config file's text */
+static char *config_set(char *text, const char *name, const char *value) {
+  size_t name_length = strlen(name);
+  for (char *line = text; line != NULL && *line != '\0';) {
+    char *end = strchr(line, '\n');
+    size_t line_length = end != NULL ? (size_t)(end - line) : strlen(line);
+    if (strncmp(line, name, name_length) == 0 &&
+        (line[name_length] == ' ' || line[name_length] == '=')) {
+      size_t head = (size_t)(line - text);
+      size_t tail_length = strlen(line + line_length);
+      size_t size = head + name_length + 3 + strlen(value) + tail_length + 1;
+      char *changed = malloc(size);
+      if (changed == NULL) {
+        return text;
+      }
+      snprintf(changed, size, "%.*s%s = %s%s", (int)head, text, name, value,
+               line + line_length);
+      free(text);
+      return changed;
+    }
+    line = end != NULL ? end + 1 : NULL;
+  }
+  return text;
+}
+
+/* Write the config text the way an editor does: a new file renamed over
+ * the old one */
+static int config_write(const char *text, size_t length) {
+  char temporary[4096];
+  snprintf(temporary, sizeof(temporary), "%s.soak", config_path);
+  FILE *out = fopen(temporary, "w");
+  if (out == NULL) {
+    return -1;
+  }
+  int ok = fwrite(text, 1, length, out) == length;
+  ok = fclose(out) == 0 && ok;
+  if (!ok || rename(temporary, config_path) != 0) {
+    unlink(temporary);
+    return -1;
+  }
+  return 0;
+}
+
+static void change_config(void) {
+  if (config_original == NULL) {
+    return;
+  }
+  char *text = strndup(config_original, config_length);
+  if (text == NULL) {
+    return;
+  }
+  char volume[8];
+  snprintf(volume, sizeof(volume), "%u", random_between(20, 60));
+  text = config_set(text, "volume", volume);
+  text = config_set(text, "speech_speed",
+                    speech_speeds[rand() % SPEECH_SPEED_COUNT]);
+  text = config_set(text, "key_beep", rand() % 2 ? "1" : "0");
+  if (config_write(text, strlen(text)) != 0) {
+    perror("soak: Config change");
+  }
+  free(text);
+}
+
+static void run_episode(Episode episode) {
+  switch (episode) {
+  case EPISODE_BURST: {
+    int count = (int)random_between(3, 12);
+    for (int i = 0; i < count && running; i++) {
+      press(any_of(readout_keys), 40);
+      sleep_ms(random_between(20, 160));
+    }
+    break;
+  }
+  case EPISODE_HOLD:
+    hold(any_of(hold_keys));
+    break;
+  case EPISODE_STORM:
+    for (int i = 0; i < 40 && running; i++) {
+      press('2', 10);
+      sleep_ms(15);
+    }
+    break;
+  case EPISODE_FLOOD: {
+    uint64_t until = now_ms() + 10000;
+    while (now_ms() < until && running) {
+      press(any_of(readout_keys), 40);
+      sleep_ms(110);
+    }
+    break;
+  }
+  case EPISODE_CONFIG:
+    change_config();
+    break;
+  default:
+    break;
+  }
+  episode_count[episode]++;
+}
+
+/* A gap around the mean, in real milliseconds */
+static uint64_t next_gap_ms(Episode episode) {
+  double scaled_ms = episode_mean_s[episode] * 1000.0 / speed;
+  return (uint64_t)(scaled_ms * random_between(50, 150) / 100.0);
+}
+
+/* Load thread: the next episode due, one at a time */
+static void *load_thread(void *arg) {
+  uint64_t until = *(const uint64_t *)arg;
+  uint64_t due[EPISODES];
+  uint64_t start = now_ms();
+  for (int e = 0; e < EPISODES; e++) {
+    due[e] = start + next_gap_ms((Episode)e);
+  }
+  while (running && now_ms() < until) {
+    int next = 0;
+    for (int e = 1; e < EPISODES; e++) {
+      if (due[e] < due[next]) {
+        next = e;
+      }
+    }
+    uint64_t now = now_ms();
+    if (due[next] > now) {
+      uint64_t wait = due[next] - now;
+      sleep_ms(wait < 100 ? (unsigned)wait : 100);
+      continue;
+    }
+    run_episode((Episode)next);
+    due[next] = now_ms() + next_gap_ms((Episode)next);
+  }
+  return NULL;
+}
+
+/* ========================================================================
+ * Checks
+ * ======================================================================== */
+
+static void *map_file(const char *prefix, const char *process, size_t size) {
+  char path[256];
+  snprintf(path, sizeof(path), "%s/%s%s", TRACE_DIR, prefix, process);
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  struct stat st;
+  void *mapped = NULL;
+  if (fstat(fd, &st) == 0 && (size_t)st.st_size >= size) {
+    mapped = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED) {
+      mapped = NULL;
+    }
+  }
+  close(fd);
+  return mapped;
+}
+
+/* Map a process's ring and registry again; they are made anew when it
+ * restarts */
+static void attach(int p) {
+  Watched *w = &watched[p];
+  if (w->ring != NULL) {
+    munmap(w->ring, sizeof(Trace_ring));
+  }
+  if (w->registry != NULL) {
+    munmap(w->registry, sizeof(Metric_registry));
+  }
+  w->ring = map_file(TRACE_FILE_PREFIX, process_names[p], sizeof(Trace_ring));
+  w->registry = map_file(METRICS_FILE_PREFIX, process_names[p],
+                         sizeof(Metric_registry));
+  if (w->ring != NULL && w->ring->magic != TRACE_MAGIC) {
+    munmap(w->ring, sizeof(Trace_ring));
+    w->ring = NULL;
+  }
+  if (w->registry != NULL && (w->registry->magic != METRICS_MAGIC ||
+                              w->registry->metrics != METRICS)) {
+    munmap(w->registry, sizeof(Metric_registry));
+    w->registry = NULL;
+  }
+  w->pid = w->registry != NULL ? w->registry->pid : 0;
+  for (int d = 0; d < DROP_METRICS; d++) {
+    w->drops[d] = w->registry != NULL
+                      ? atomic_load(&w->registry->slot[drop_metrics[d]].value)
+                      : 0;
+  }
+  for (int s = 0; s < STAGES; s++) {
+    if (stages[s].process == p) {
+      stages[s].read =
+          w->ring != NULL ? atomic_load(&w->ring->head) : 0;
+    }
+  }
+}
+
+static int alive(int pid) {
+  return pid > 0 && (kill(pid, 0) == 0 || errno == EPERM);
+}
+
+/* Read a stage's new records and match them against the keys sent */
+static void check_stage(Key_stage *stage) {
+  Trace_ring *ring = watched[stage->process].ring;
+  if (ring == NULL) {
+    return;
+  }
+  uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  if (head - stage->read > TRACE_RING_RECORDS) {
+    violation("%s: trace ring overran, %u records unread",
+              process_names[stage->process],
+              head - stage->read - TRACE_RING_RECORDS);
+    stage->read = head - TRACE_RING_RECORDS;
+  }
+
+  pthread_mutex_lock(&sent_lock);
+  uint64_t count = sent_count;
+  for (; stage->read != head; stage->read++) {
+    const Trace_record *slot =
+        &ring->ring[stage->read & (TRACE_RING_RECORDS - 1)];
+    Trace_record copy;
+    uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    memcpy(&copy, slot, sizeof(copy));
+    atomic_thread_fence(memory_order_acquire);
+    if (seq != stage->read + 1 ||
+        atomic_load_explicit(&slot->seq, memory_order_relaxed) != seq) {
+      break; /* Still being written: read it next time */
+    }
+    if (copy.event != stage->event) {
+      continue;
+    }
+
+    /* The oldest key not matched yet, or one sent after it: keys in
+     * between were lost or overtaken */
+    uint64_t match = stage->next;
+    while (match < count) {
+      const Sent_key *k = &sent[match & (SOAK_SENT_MAX - 1)];
+      if ((unsigned char)k->key == copy.arg[0] && k->action == copy.arg[1]) {
+        break;
+      }
+      match++;
+    }
+    if (match == count) {
+      stage->out_of_order++;
+      violation("%s: key '%c' traced but not sent next (or twice)",
+                process_names[stage->process], (char)copy.arg[0]);
+      continue;
+    }
+    if (match > stage->next) {
+      stage->out_of_order += match - stage->next;
+      violation("%s: %llu keys lost or overtaken by key %llu",
+                process_names[stage->process],
+                (unsigned long long)(match - stage->next),
+                (unsigned long long)match);
+    }
+    stage->next = match + 1;
+    stage->seen++;
+    if (copy.arg[2] > stage->max_age_us) {
+      stage->max_age_us = copy.arg[2];
+    }
+    if (copy.arg[2] > key_ms * 1000) {
+      stage->late++;
+      violation("%s: key %llu came %u us after it was sent",
+                process_names[stage->process], (unsigned long long)match,
+                copy.arg[2]);
+    }
+  }
+
+  /* Keys still missing after the timeout are lost */
+  uint64_t now = now_ms();
+  while (stage->next < count &&
+         sent[stage->next & (SOAK_SENT_MAX - 1)].sent_ms +
+                 SOAK_KEY_TIMEOUT_MS <
+             now) {
+    stage->lost++;
+    violation("%s: key %llu lost", process_names[stage->process],
+              (unsigned long long)stage->next);
+    stage->next++;
+  }
+  pthread_mutex_unlock(&sent_lock);
+}
+
+/* Count the observations of a histogram at or over limit_us */
+static uint64_t histogram_over(const Metric_slot *slot, unsigned limit_us) {
+  uint64_t over = 0;
+  for (int b = 0; b < METRIC_BUCKETS; b++) {
+    /* A bucket counts if everything in it is over the limit */
+    uint64_t floor_us = b == 0 ? 0 : bucket_limits_us[b - 1];
+    if (floor_us >= limit_us) {
+      over += atomic_load(&slot->buckets[b]);
+    }
+  }
+  return over;
+}
+
+static void check_metrics(int p) {
+  Watched *w = &watched[p];
+  if (w->registry == NULL) {
+    return;
+  }
+  for (int d = 0; d < DROP_METRICS; d++) {
+    uint64_t value = atomic_load(&w->registry->slot[drop_metrics[d]].value);
+    if (value > w->drops[d]) {
+      violation("%s: %s up by %llu", process_names[p],
+                metric_names[drop_metrics[d]],
+                (unsigned long long)(value - w->drops[d]));
+      w->drops[d] = value;
+    }
+  }
+  uint64_t slow =
+      histogram_over(&w->registry->slot[METRIC_TTS_FIRST_AUDIO], speech_ms);
+  if (slow > w->slow_speech) {
+    violation("%s: %llu speech requests reached audio after %u ms",
+              process_names[p], (unsigned long long)(slow - w->slow_speech),
+              speech_ms);
+    w->slow_speech = slow;
+  }
+}
+
+static long read_rss_kb(int pid) {
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/%d/status", pid);
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    return -1;
+  }
+  char line[256];
+  long kb = -1;
+  while (fgets(line, sizeof(line), f) != NULL) {
+    if (sscanf(line, "VmRSS: %ld", &kb) == 1) {
+      break;
+    }
+  }
+  fclose(f);
+  return kb;
+}
+
+static int count_fds(int pid) {
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/%d/fd", pid);
+  DIR *dir = opendir(path);
+  if (dir == NULL) {
+    return -1; /* Another user's process (firmware.elf under sudo) */
+  }
+  int count = 0;
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL) {
+    count += entry->d_name[0] != '.';
+  }
+  closedir(dir);
+  return count;
+}
+
+static void sample(double load_hours, FILE *csv) {
+  if (sample_count == SOAK_SAMPLES_MAX) {
+    return;
+  }
+  int n = sample_count++;
+  sample_hours[n] = load_hours;
+  for (int p = 0; p < PROCESSES; p++) {
+    Watched *w = &watched[p];
+    w->rss_kb[n] = w->pid > 0 ? read_rss_kb(w->pid) : -1;
+    w->fds[n] = w->pid > 0 ? count_fds(w->pid) : -1;
+  }
+  if (csv != NULL) {
+    fprintf(csv, "%.3f", load_hours);
+    for (int p = 0; p < PROCESSES; p++) {
+      fprintf(csv, ",%ld,%d", watched[p].rss_kb[n], watched[p].fds[n]);
+    }
+    fprintf(csv, ",%llu,%llu,%d\n",
+            (unsigned long long)stages[0].seen,
+            (unsigned long long)stages[1].seen, violations);
+    fflush(csv);
+  }
+}
+
+/* Growth in KB per hour of load after the warm-up: the least-squares
+ * slope of the resident memory samples */
+static double rss_slope(const Watched *w, int first) {
+  double n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+  for (int i = first; i < sample_count; i++) {
+    if (w->rss_kb[i] < 0) {
+      continue;
+    }
+    double x = sample_hours[i], y = (double)w->rss_kb[i];
+    n++;
+    sx += x;
+    sy += y;
+    sxx += x * x;
+    sxy += x * y;
+  }
+  double d = n * sxx - sx * sx;
+  return n < 3 || d <= 0 ? 0 : (n * sxy - sx * sy) / d;
+}
+
+static void check_leaks(double warmup_hours) {
+  int first = 0;
+  while (first < sample_count && sample_hours[first] < warmup_hours) {
+    first++;
+  }
+  if (sample_count - first < 3) {
+    printf("Leaks: too few samples after the warm-up to judge\n");
+    return;
+  }
+  for (int p = 0; p < PROCESSES; p++) {
+    const Watched *w = &watched[p];
+    double slope = rss_slope(w, first);
+    int fds_first = w->fds[first], fds_last = w->fds[sample_count - 1];
+    printf("%-8s  RSS %ld -> %ld KB (%+.0f KB/h)  files %d -> %d\n",
+           process_names[p], w->rss_kb[first], w->rss_kb[sample_count - 1],
+           slope, fds_first, fds_last);
+    if (slope > leak_kb) {
+      violation("%s: resident memory grows %.0f KB per hour (limit %u)",
+                process_names[p], slope, leak_kb);
+    }
+    if (fds_first >= 0 && fds_last > fds_first) {
+      violation("%s: open files grew from %d to %d", process_names[p],
+                fds_first, fds_last);
+    }
+  }
+}
+
+static void print_summary(double load_hours) {
+  printf("\n=== Soak: %.2f hours of load in %.1f minutes ===\n", load_hours,
+         load_hours * 60 / speed);
+  for (int e = 0; e < EPISODES; e++) {
+    printf("%-7s %llu\n", episode_names[e],
+           (unsigned long long)episode_count[e]);
+  }
+  printf("Keys sent %llu\n", (unsigned long long)sent_count);
+  for (int s = 0; s < STAGES; s++) {
+    const Key_stage *st = &stages[s];
+    printf("%-8s  seen %llu, lost %llu, out of order %llu, "
+           "over %u ms %llu (max %u us)\n",
+           process_names[st->process], (unsigned long long)st->seen,
+           (unsigned long long)st->lost, (unsigned long long)st->out_of_order,
+           key_ms, (unsigned long long)st->late, st->max_age_us);
+  }
+}
+
+/* ========================================================================
+ * Main
+ * ======================================================================== */
+
+static int load_config(void) {
+  if (config_path[0] == '\0') {
+    return 0;
+  }
+  FILE *in = fopen(config_path, "r");
+  if (in == NULL) {
+    perror(config_path);
+    return -1;
+  }
+  size_t capacity = 0;
+  char chunk[4096];
+  size_t got;
+  while ((got = fread(chunk, 1, sizeof(chunk), in)) > 0) {
+    char *grown = realloc(config_original, capacity + got + 1);
+    if (grown == NULL) {
+      fclose(in);
+      return -1;
+    }
+    config_original = grown;
+    memcpy(config_original + capacity, chunk, got);
+    capacity += got;
+    config_original[capacity] = '\0';
+  }
+  fclose(in);
+  config_length = capacity;
+  return config_original != NULL ? 0 : -1;
+}
+
+static void print_usage(const char *program) {
+  fprintf(stderr,
+          "Usage: %s [--remote HOST:PORT] [--hours H] [--speed N]\n"
+          "          [--config FILE] [--key-ms MS] [--speech-ms MS]\n"
+          "          [--leak-kb KB] [--seed N] [--csv FILE]\n",
+          program);
+}
+
+int main(int argc, char *argv[]) {
+  const char *remote = getenv(HAL_REMOTE_ENV);
+  unsigned seed = (unsigned)time(NULL);
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--remote") == 0 && i + 1 < argc) {
+      remote = argv[++i];
+    } else if (strcmp(argv[i], "--hours") == 0 && i + 1 < argc) {
+      hours = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+      speed = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--config") == 0 && i + 1 < argc) {
+      config_path = argv[++i];
+    } else if (strcmp(argv[i], "--key-ms") == 0 && i + 1 < argc) {
+      key_ms = (unsigned)atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--speech-ms") == 0 && i + 1 < argc) {
+      speech_ms = (unsigned)atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--leak-kb") == 0 && i + 1 < argc) {
+      leak_kb = (unsigned)atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      seed = (unsigned)atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc) {
+      csv_path = argv[++i];
+    } else {
+      print_usage(argv[0]);
+      return 2;
+    }
+  }
+  if (remote == NULL || hal_remote_parse_address(remote, &hampod) != 0 ||
+      hours <= 0 || speed <= 0) {
+    print_usage(argv[0]);
+    return 2;
+  }
+  srand(seed);
+  session = (uint32_t)rand();
+  if (load_config() != 0) {
+    return 1;
+  }
+
+  sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (sock < 0) {
+    perror("soak: Socket");
+    return 1;
+  }
+  for (int p = 0; p < PROCESSES; p++) {
+    attach(p);
+    if (watched[p].registry == NULL || !alive(watched[p].pid)) {
+      fprintf(stderr, "soak: No %s process running\n", process_names[p]);
+      return 1;
+    }
+  }
+  FILE *csv = csv_path != NULL ? fopen(csv_path, "a") : NULL;
+  if (csv_path != NULL && csv == NULL) {
+    perror(csv_path);
+  }
+
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+  printf("Soak: %.2f hours of load at %.0fx to %s, seed %u\n", hours, speed,
+         remote, seed);
+
+  uint64_t start = now_ms();
+  uint64_t until = start + (uint64_t)(hours * 3600000.0 / speed);
+  pthread_t loader;
+  if (pthread_create(&loader, NULL, load_thread, &until) != 0) {
+    return 1;
+  }
+
+  uint64_t sample_every = (uint64_t)(SOAK_SAMPLE_S * 1000.0 / speed);
+  uint64_t next_sample = start;
+  double load_hours = 0;
+  while (running && now_ms() < until + SOAK_KEY_TIMEOUT_MS) {
+    for (int p = 0; p < PROCESSES; p++) {
+      Watched *w = &watched[p];
+      if (w->pid > 0 && !alive(w->pid)) {
+        w->restarts++;
+        violation("%s: process %d gone", process_names[p], w->pid);
+        w->pid = 0;
+      }
+      if (w->pid == 0) {
+        attach(p); /* Until it is back */
+      }
+      check_metrics(p);
+    }
+    for (int s = 0; s < STAGES; s++) {
+      check_stage(&stages[s]);
+    }
+    uint64_t now = now_ms();
+    load_hours = now < until ? (double)(now - start) * speed / 3600000.0
+                             : hours;
+    if (now >= next_sample) {
+      sample(load_hours, csv);
+      next_sample += sample_every;
+    }
+    sleep_ms(SOAK_POLL_MS);
+  }
+  running = 0;
+  pthread_join(loader, NULL);
+
+  if (config_original != NULL &&
+      config_write(config_original, config_length) != 0) {
+    perror("soak: Restoring the config");
+  }
+  if (csv != NULL) {
+    fclose(csv);
+  }
+
+  print_summary(load_hours);
+  check_leaks(SOAK_WARMUP_S / 3600.0);
+  printf("\n%s: %d violations\n", violations == 0 ? "PASS" : "FAIL",
+         violations);
+  return violations == 0 ? 0 : 1;
+}